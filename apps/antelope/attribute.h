@@ -57,6 +57,23 @@ typedef enum {
 #define ATTRIBUTE_FLAG_PRIMARY_KEY	0x4
 #define ATTRIBUTE_FLAG_UNIQUE		0x8
 
+#if DB_FEATURE_VIEWS
+/* Aggregates of a set of values of an attribute, maintained as the
+   values are inserted. */
+struct attribute_summary {
+  uint32_t count;
+  long sum;
+  long min;
+  long max;
+};
+
+/* The summary of all values of the attribute in its relation is unknown,
+   being computed by a query that scans the relation, or exact. */
+#define ATTRIBUTE_SUMMARY_INVALID	0
+#define ATTRIBUTE_SUMMARY_BUILDING	1
+#define ATTRIBUTE_SUMMARY_VALID		2
+#endif /* DB_FEATURE_VIEWS */
+
 struct attribute {
   struct attribute *next;
   void *index;
@@ -66,6 +83,10 @@ struct attribute {
   uint8_t element_size;
   uint8_t flags;
   char name[ATTRIBUTE_NAME_LENGTH + 1];
+#if DB_FEATURE_VIEWS
+  struct attribute_summary summary;
+  uint8_t summary_state;
+#endif /* DB_FEATURE_VIEWS */
 };
 
 typedef struct attribute attribute_t;
@@ -69,6 +69,20 @@
 #define DB_FEATURE_INTEGRITY		0
 #endif /* DB_FEATURE_INTEGRITY */
 
+/* Maintain aggregates of the attributes on insertion, so that aggregate
+   queries without a condition do not scan the relation, and support
+   continuous aggregate queries over time windows (view.h). */
+#ifndef DB_FEATURE_VIEWS
+#define DB_FEATURE_VIEWS		0
+#endif /* DB_FEATURE_VIEWS */
+
+/* Support buffered insertions (relation_bulk_insert), which store the
+   tuples with one write per buffer and insert them into the indexes
+   in the order of their keys. */
+#ifndef DB_FEATURE_BULK_INSERT
+#define DB_FEATURE_BULK_INSERT		0
+#endif /* DB_FEATURE_BULK_INSERT */
+
 /*----------------------------------------------------------------------------*/
 
 /* Configuration parameters that may be trimmed to save space. */
@@ -98,6 +112,11 @@
 #define DB_MAX_ATTRIBUTES_PER_RELATION	6
 #endif /* DB_MAX_ATTRIBUTES_PER_RELATION */
 
+/* The size of the buffer of relation_bulk_insert. */
+#ifndef DB_BULK_BUFFER_SIZE
+#define DB_BULK_BUFFER_SIZE		256
+#endif /* DB_BULK_BUFFER_SIZE */
+
 /* The maximum physical storage size on an attribute value. */
 #ifndef DB_MAX_ELEMENT_SIZE
 #define DB_MAX_ELEMENT_SIZE		16
@@ -201,11 +220,20 @@
 #define DB_HEAP_INDEX_LIMIT		1
 #endif /* DB_HEAP_INDEX_LIMIT */
 
-/* The maximum number of buckets cached in the MaxHeap index. */
+/* The maximum number of buckets cached in the MaxHeap index. Each
+   cached bucket takes 512 bytes of RAM. The least recently used
+   bucket is replaced when the cache is full. */
 #ifndef DB_HEAP_CACHE_LIMIT
 #define DB_HEAP_CACHE_LIMIT		1
 #endif /* DB_HEAP_CACHE_LIMIT */
 
+/* Keep the pairs inserted into a cached bucket in RAM until the
+   bucket is replaced or the index is released, instead of writing
+   them to storage at once. Pairs not written are lost on a reboot. */
+#ifndef DB_HEAP_CACHE_WRITE_BACK
+#define DB_HEAP_CACHE_WRITE_BACK	0
+#endif /* DB_HEAP_CACHE_WRITE_BACK */
+
 /*----------------------------------------------------------------------------*/
 
 /* LVM options. */
@@ -108,19 +108,29 @@ struct heap {
 };
 typedef struct heap heap_t;
 
+/* A bucket_cache entry is clean when dirty_slot is CLEAN_BUCKET. */
+#define CLEAN_BUCKET	BUCKET_SIZE
+
 struct bucket_cache {
   heap_t *heap;
   uint16_t bucket_id;
+  /* The value of cache_clock when the bucket was last used. */
+  uint16_t last_use;
+  /* The first pair not written to storage. */
+  uint8_t dirty_slot;
   bucket_t bucket;
 };
 
 /* Keep a cache of buckets read from storage. */
 static struct bucket_cache bucket_cache[DB_HEAP_CACHE_LIMIT];
+static uint16_t cache_clock;
+static struct index_maxheap_stats stats;
 MEMB(heaps, heap_t, DB_HEAP_INDEX_LIMIT);
 
 static struct bucket_cache *get_cache(heap_t *, int);
 static struct bucket_cache *get_cache_free(void);
-static void invalidate_cache(void);
+static int write_back(struct bucket_cache *);
+static void invalidate_cache(heap_t *);
 static maxheap_key_t transform_key(maxheap_key_t);
 static int heap_read(heap_t *, int, heap_node_t *);
 static int heap_write(heap_t *, int, heap_node_t *);
@@ -161,34 +171,79 @@ get_cache(heap_t *heap, int bucket_id)
 
   for(i = 0; i < DB_HEAP_CACHE_LIMIT; i++) {
     if(bucket_cache[i].heap == heap && bucket_cache[i].bucket_id == bucket_id) {
+      bucket_cache[i].last_use = ++cache_clock;
       return &bucket_cache[i];
     }
   }
   return NULL;
 }
 
+/* Returns an unused entry, or else the least recently used one after
+   writing it back. */
 static struct bucket_cache *
 get_cache_free(void)
 {
   int i;
+  struct bucket_cache *lru;
 
+  lru = NULL;
   for(i = 0; i < DB_HEAP_CACHE_LIMIT; i++) {
     if(bucket_cache[i].heap == NULL) {
       return &bucket_cache[i];
     }
+    /* Ages are compared modulo the clock range. */
+    if(lru == NULL ||
+       (uint16_t)(cache_clock - bucket_cache[i].last_use) >
+       (uint16_t)(cache_clock - lru->last_use)) {
+      lru = &bucket_cache[i];
+    }
   }
-  return NULL;
+
+  if(write_back(lru) == 0) {
+    return NULL;
+  }
+  lru->heap = NULL;
+  return lru;
 }
 
+static int
+write_back(struct bucket_cache *cache)
+{
+  heap_t *heap;
+  unsigned long offset;
+  unsigned slot;
+
+  heap = cache->heap;
+  slot = cache->dirty_slot;
+  if(slot == CLEAN_BUCKET) {
+    return 1;
+  }
+
+  offset = (unsigned long)cache->bucket_id * sizeof(bucket_t);
+  offset += slot * sizeof(struct key_value_pair);
+
+  if(DB_ERROR(storage_write(heap->bucket_storage, &cache->bucket.pairs[slot],
+                            offset, (heap->next_free_slot[cache->bucket_id] - slot) *
+                            sizeof(struct key_value_pair)))) {
+    PRINTF("DB: Failed to write back bucket %u\n", (unsigned)cache->bucket_id);
+    return 0;
+  }
+
+  cache->dirty_slot = CLEAN_BUCKET;
+  stats.write_backs++;
+  return 1;
+}
+
+/* Writes back and drops the cached buckets of a heap. */
 static void
-invalidate_cache(void)
+invalidate_cache(heap_t *heap)
 {
   int i;
 
   for(i = 0; i < DB_HEAP_CACHE_LIMIT; i++) {
-    if(bucket_cache[i].heap != NULL) {
+    if(bucket_cache[i].heap == heap) {
+      write_back(&bucket_cache[i]);
       bucket_cache[i].heap = NULL;
-      break;
     }
   }
 }
@@ -356,16 +411,14 @@ bucket_load(heap_t *heap, int bucket_id)
 
   cache = get_cache(heap, bucket_id);
   if(cache != NULL) {
+    stats.hits++;
     return cache;
   }
+  stats.misses++;
 
   cache = get_cache_free();
   if(cache == NULL) {
-    invalidate_cache();
-    cache = get_cache_free();
-    if(cache == NULL) {
-      return NULL;
-    }
+    return NULL;
   }
 
   if(bucket_read(heap, bucket_id, &cache->bucket) == 0) {
@@ -374,6 +427,8 @@ bucket_load(heap_t *heap, int bucket_id)
 
   cache->heap = heap;
   cache->bucket_id = bucket_id;
+  cache->last_use = ++cache_clock;
+  cache->dirty_slot = CLEAN_BUCKET;
 
   if(heap->next_free_slot[bucket_id] == 0) {
     for(i = 0; i < BUCKET_SIZE; i++) {
@@ -395,14 +450,35 @@ static int
 bucket_append(heap_t *heap, int bucket_id, struct key_value_pair *pair)
 {
   unsigned long offset;
+  struct bucket_cache *cache;
+  unsigned slot;
 
-  if(heap->next_free_slot[bucket_id] >= BUCKET_SIZE) {
+  /* The free slot of a bucket is not known until it has been loaded. */
+  if(heap->next_free_slot[bucket_id] == 0) {
+    cache = bucket_load(heap, bucket_id);
+  } else {
+    cache = get_cache(heap, bucket_id);
+  }
+
+  slot = heap->next_free_slot[bucket_id];
+  if(slot >= BUCKET_SIZE) {
     PRINTF("DB: Invalid write attempt to the full bucket %d\n", bucket_id);
     return 0;
   }
 
+  if(cache != NULL) {
+    cache->bucket.pairs[slot] = *pair;
+#if DB_HEAP_CACHE_WRITE_BACK
+    if(cache->dirty_slot > slot) {
+      cache->dirty_slot = slot;
+    }
+    heap->next_free_slot[bucket_id]++;
+    return 1;
+#endif /* DB_HEAP_CACHE_WRITE_BACK */
+  }
+
   offset = (unsigned long)bucket_id * sizeof(bucket_t);
-  offset += heap->next_free_slot[bucket_id] * sizeof(struct key_value_pair);
+  offset += slot * sizeof(struct key_value_pair);
 
   if(DB_ERROR(storage_write(heap->bucket_storage, pair, offset, sizeof(*pair)))) {
     return 0;
@@ -635,6 +711,7 @@ release(index_t *index)
 
   heap = index->opaque_data;
 
+  invalidate_cache(heap);
   storage_close(heap->bucket_storage);
   storage_close(heap->heap_storage);
   memb_free(&heaps, index->opaque_data);
@@ -665,6 +742,12 @@ delete(index_t *index, attribute_value_t *value)
   return DB_INDEX_ERROR;
 }
 
+void
+index_maxheap_get_stats(struct index_maxheap_stats *copy)
+{
+  *copy = stats;
+}
+
 static tuple_id_t
 get_next(index_iterator_t *iterator)
 {
@@ -98,6 +98,14 @@ extern index_api_t index_inline;
 extern index_api_t index_maxheap;
 extern index_api_t index_memhash;
 
+/* Bucket cache statistics of the max-heap index, since the boot. */
+struct index_maxheap_stats {
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long write_backs;
+};
+void index_maxheap_get_stats(struct index_maxheap_stats *);
+
 void index_init(void);
 db_result_t index_create(index_type_t, relation_t *, attribute_t *);
 db_result_t index_destroy(index_t *);
@@ -51,6 +51,7 @@
 #include "result.h"
 #include "storage.h"
 #include "aql.h"
+#include "view.h"
 
 /*
  * The source_dest_map structure is used for mapping the pointers to 
@@ -68,6 +69,18 @@ struct source_dest_map {
 
 static struct source_dest_map attr_map[AQL_ATTRIBUTE_LIMIT];
 
+/* The number of tuples aggregated by the current selection. */
+static tuple_id_t aggregated_tuples;
+
+#if DB_FEATURE_BULK_INSERT
+/* Tuples inserted through relation_bulk_insert, not yet stored. */
+static relation_t *bulk_rel;
+static unsigned char bulk_rows[DB_BULK_BUFFER_SIZE];
+static uint8_t bulk_order[DB_BULK_BUFFER_SIZE / 4];
+static unsigned bulk_count;
+static tuple_id_t bulk_first;
+#endif /* DB_FEATURE_BULK_INSERT */
+
 #if DB_FEATURE_JOIN
 /*
  * The source_map structure is used for mapping attributes to
@@ -266,6 +279,9 @@ relation_release(relation_t *rel)
   }
 
   if(rel->references == 0) {
+#if DB_FEATURE_BULK_INSERT
+    relation_bulk_flush(rel);
+#endif /* DB_FEATURE_BULK_INSERT */
     storage_unload(rel);
   }
 
@@ -360,6 +376,12 @@ relation_attribute_add(relation_t *rel, db_direction_t dir, char *name,
   attribute->aggregator = 0;
   attribute->index = NULL;
   attribute->flags = 0 /*ATTRIBUTE_FLAG_UNIQUE*/;
+#if DB_FEATURE_VIEWS
+  /* The cardinality of a relation loaded from storage is unknown. */
+  view_summary_clear(&attribute->summary);
+  attribute->summary_state = rel->cardinality == 0 ?
+    ATTRIBUTE_SUMMARY_VALID : ATTRIBUTE_SUMMARY_INVALID;
+#endif /* DB_FEATURE_VIEWS */
 
   rel->row_length += element_size;
 
@@ -467,16 +489,25 @@ relation_remove(char *name, int remove_tuples)
     return DB_BUSY_ERROR;
   }
 
+#if DB_FEATURE_BULK_INSERT
+  if(bulk_rel == rel) {
+    bulk_rel = NULL;
+    bulk_count = 0;
+  }
+#endif /* DB_FEATURE_BULK_INSERT */
+
   result = storage_drop_relation(rel, remove_tuples);
   relation_free(rel);
   return result;
 }
 
-db_result_t
-relation_insert(relation_t *rel, attribute_value_t *values)
+/* Converts values into a row for storage, and inserts them into the
+   indexes for the tuple_id, unless it is INVALID_TUPLE. */
+static db_result_t
+encode_row(relation_t *rel, attribute_value_t *values, unsigned char *record,
+           tuple_id_t tuple_id)
 {
   attribute_t *attr;
-  unsigned char record[rel->row_length];
   unsigned char *ptr;
   attribute_value_t *value;
   db_result_t result;
@@ -533,8 +564,8 @@ relation_insert(relation_t *rel, attribute_value_t *values)
 #endif /* DEBUG */
 
     ptr += attr->element_size;
-    if(attr->index != NULL) {
-      if(DB_ERROR(index_insert(attr->index, value, rel->next_row))) {
+    if(attr->index != NULL && tuple_id != INVALID_TUPLE) {
+      if(DB_ERROR(index_insert(attr->index, value, tuple_id))) {
         return DB_INDEX_ERROR;
       }
     }
@@ -542,11 +573,158 @@ relation_insert(relation_t *rel, attribute_value_t *values)
 
   PRINTF(")\n");
 
+  return DB_OK;
+}
+
+db_result_t
+relation_insert(relation_t *rel, attribute_value_t *values)
+{
+  unsigned char record[rel->row_length];
+  db_result_t result;
+
+#if DB_FEATURE_BULK_INSERT
+  /* Keep the tuples in the order of their identifiers. */
+  if(DB_ERROR(relation_bulk_flush(rel))) {
+    return DB_STORAGE_ERROR;
+  }
+#endif /* DB_FEATURE_BULK_INSERT */
+
+  result = encode_row(rel, values, record, rel->next_row);
+  if(DB_ERROR(result)) {
+    return result;
+  }
+
+  rel->cardinality++;
+  rel->next_row++;
+  result = storage_put_row(rel, record);
+#if DB_FEATURE_VIEWS
+  if(DB_SUCCESS(result)) {
+    view_insert(rel, record);
+  }
+#endif /* DB_FEATURE_VIEWS */
+  return result;
+}
+
+#if DB_FEATURE_BULK_INSERT
+static long
+bulk_key(relation_t *rel, int offset, attribute_t *attr, unsigned row_no)
+{
+  attribute_value_t value;
+
+  db_phy_to_value(&value, attr, bulk_rows + row_no * rel->row_length + offset);
+  return db_value_to_long(&value);
+}
+
+/* Inserts the buffered tuples into an index in the order of their keys. */
+static db_result_t
+bulk_index(relation_t *rel, attribute_t *attr)
+{
+  attribute_value_t value;
+  long key;
+  int offset;
+  unsigned i;
+  int j;
+  uint8_t row_no;
+
+  offset = get_attribute_value_offset(rel, attr);
+  if(offset < 0) {
+    return DB_IMPLEMENTATION_ERROR;
+  }
+
+  for(i = 0; i < bulk_count; i++) {
+    row_no = i;
+    key = bulk_key(rel, offset, attr, row_no);
+    for(j = i; j > 0 && bulk_key(rel, offset, attr, bulk_order[j - 1]) > key; j--) {
+      bulk_order[j] = bulk_order[j - 1];
+    }
+    bulk_order[j] = row_no;
+  }
+
+  for(i = 0; i < bulk_count; i++) {
+    row_no = bulk_order[i];
+    db_phy_to_value(&value, attr, bulk_rows + row_no * rel->row_length + offset);
+    if(DB_ERROR(index_insert(attr->index, &value, bulk_first + row_no))) {
+      return DB_INDEX_ERROR;
+    }
+  }
+
+  return DB_OK;
+}
+
+db_result_t
+relation_bulk_insert(relation_t *rel, attribute_value_t *values)
+{
+  unsigned limit;
+  db_result_t result;
+
+  limit = sizeof(bulk_rows) / rel->row_length;
+  if(limit > sizeof(bulk_order)) {
+    limit = sizeof(bulk_order);
+  }
+  if(limit == 0) {
+    return relation_insert(rel, values);
+  }
+
+  if(bulk_rel != NULL && (bulk_rel != rel || bulk_count == limit)) {
+    if(DB_ERROR(relation_bulk_flush(bulk_rel))) {
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  result = encode_row(rel, values, bulk_rows + bulk_count * rel->row_length,
+                      INVALID_TUPLE);
+  if(DB_ERROR(result)) {
+    return result;
+  }
+
+  if(bulk_count == 0) {
+    bulk_rel = rel;
+    bulk_first = rel->next_row;
+  }
+#if DB_FEATURE_VIEWS
+  view_insert(rel, bulk_rows + bulk_count * rel->row_length);
+#endif /* DB_FEATURE_VIEWS */
+  bulk_count++;
   rel->cardinality++;
   rel->next_row++;
-  return storage_put_row(rel, record);
+
+  return DB_OK;
 }
 
+db_result_t
+relation_bulk_flush(relation_t *rel)
+{
+  attribute_t *attr;
+  db_result_t result;
+
+  if(rel != bulk_rel || bulk_count == 0) {
+    return DB_OK;
+  }
+
+  PRINTF("DB: Flushing %u tuples into relation %s\n", bulk_count, rel->name);
+
+  result = DB_OK;
+  for(attr = list_head(rel->attributes); attr != NULL; attr = attr->next) {
+    if(attr->index != NULL && DB_ERROR(bulk_index(rel, attr))) {
+      result = DB_INDEX_ERROR;
+      break;
+    }
+  }
+
+  if(DB_SUCCESS(result)) {
+    result = storage_put_rows(rel, bulk_rows, bulk_count);
+  }
+  if(DB_ERROR(result)) {
+    /* The buffered tuples are lost; count the stored ones again. */
+    rel->cardinality = INVALID_TUPLE;
+  }
+
+  bulk_rel = NULL;
+  bulk_count = 0;
+  return result;
+}
+#endif /* DB_FEATURE_BULK_INSERT */
+
 static void
 aggregate(attribute_t *attr, attribute_value_t *value)
 {
@@ -571,6 +749,8 @@ aggregate(attribute_t *attr, attribute_value_t *value)
     attr->aggregation_value += long_value;
     break;
   case AQL_MEAN:
+    /* Divided by the number of aggregated tuples in the end. */
+    attr->aggregation_value += long_value;
     break;
   case AQL_MEDIAN:
     break;
@@ -627,6 +807,66 @@ generate_attribute_map(struct source_dest_map *attr_map, unsigned attribute_coun
   return DB_OK;
 }
 
+#if DB_FEATURE_VIEWS
+/* Returns whether no earlier mapping has the same source attribute. */
+static int
+first_mapping(struct source_dest_map *attr_map_ptr)
+{
+  struct source_dest_map *ptr;
+
+  for(ptr = attr_map; ptr < attr_map_ptr; ptr++) {
+    if(ptr->from_attr == attr_map_ptr->from_attr) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* Takes the aggregates of an unconditional selection from the attribute
+   summaries if they are exact, or has them computed by the scan. */
+static void
+use_summaries(db_handle_t *handle, relation_t *rel)
+{
+  attribute_t *attr;
+  attribute_t *from_attr;
+  int valid;
+
+  valid = 1;
+  for(attr = list_head(handle->result_rel->attributes);
+      attr != NULL;
+      attr = attr->next) {
+    from_attr = relation_attribute_get(rel, attr->name);
+    if(from_attr->summary_state != ATTRIBUTE_SUMMARY_VALID ||
+       attr->aggregator == AQL_MEDIAN) {
+      valid = 0;
+    }
+  }
+
+  for(attr = list_head(handle->result_rel->attributes);
+      attr != NULL;
+      attr = attr->next) {
+    from_attr = relation_attribute_get(rel, attr->name);
+    if(!valid) {
+      if(from_attr->summary_state != ATTRIBUTE_SUMMARY_VALID) {
+        view_summary_clear(&from_attr->summary);
+        from_attr->summary_state = ATTRIBUTE_SUMMARY_BUILDING;
+      }
+      continue;
+    }
+    /* The mean is divided at the end of the aggregation. */
+    view_summary_get(&from_attr->summary,
+                     attr->aggregator == AQL_MEAN ? AQL_SUM : attr->aggregator,
+                     &attr->aggregation_value);
+    aggregated_tuples = from_attr->summary.count;
+  }
+
+  if(valid) {
+    PRINTF("DB: Aggregates of %s taken from the summaries\n", rel->name);
+    handle->flags |= DB_HANDLE_FLAG_SUMMARY;
+  }
+}
+#endif /* DB_FEATURE_VIEWS */
+
 static void
 select_index(db_handle_t *handle, lvm_instance_t *lvm_instance)
 {
@@ -753,6 +993,15 @@ relation_process_select(void *handle_ptr)
   attribute_count = handle->result_rel->attribute_count;
   attr_map_end = attr_map + attribute_count;
 
+#if DB_FEATURE_VIEWS
+  if(handle->flags & DB_HANDLE_FLAG_SUMMARY) {
+    if(AQL_GET_FLAGS(adt) & AQL_FLAG_AGGREGATE) {
+      goto end_aggregation;
+    }
+    return DB_FINISHED;
+  }
+#endif /* DB_FEATURE_VIEWS */
+
   if(handle->flags & DB_HANDLE_FLAG_SEARCH_INDEX) {
     handle->tuple_id = index_get_next(&handle->index_iterator);
     if(handle->tuple_id == INVALID_TUPLE) {
@@ -822,6 +1071,7 @@ relation_process_select(void *handle_ptr)
   if(adt->lvm_instance == NULL ||
      lvm_execute(adt->lvm_instance) == wanted_result) {
     if(AQL_GET_FLAGS(adt) & AQL_FLAG_AGGREGATE) {
+      aggregated_tuples++;
       for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
         from_ptr = row + attr_map_ptr->from_offset;
         result = db_phy_to_value(&value, attr_map_ptr->to_attr, from_ptr);
@@ -829,6 +1079,15 @@ relation_process_select(void *handle_ptr)
 	  return result;
         }
         aggregate(attr_map_ptr->to_attr, &value);
+#if DB_FEATURE_VIEWS
+        if(attr_map_ptr->from_attr->summary_state == ATTRIBUTE_SUMMARY_BUILDING &&
+           first_mapping(attr_map_ptr) &&
+           DB_SUCCESS(db_phy_to_value(&value, attr_map_ptr->from_attr, from_ptr)) &&
+           (value.domain == DOMAIN_INT || value.domain == DOMAIN_LONG)) {
+          view_summary_add(&attr_map_ptr->from_attr->summary,
+                           db_value_to_long(&value));
+        }
+#endif /* DB_FEATURE_VIEWS */
       }
     } else {
       if(AQL_GET_FLAGS(adt) & AQL_FLAG_ASSIGN) {
@@ -850,6 +1109,17 @@ end_aggregation:
     result_attr = attr_map_ptr->to_attr;
     to_ptr = result_row + attr_map_ptr->to_offset;
 
+    if(result_attr->aggregator == AQL_MEAN) {
+      result_attr->aggregation_value = aggregated_tuples == 0 ? 0 :
+        result_attr->aggregation_value / (long)aggregated_tuples;
+    }
+#if DB_FEATURE_VIEWS
+    if(attr_map_ptr->from_attr->summary_state == ATTRIBUTE_SUMMARY_BUILDING) {
+      /* The scan is complete. */
+      attr_map_ptr->from_attr->summary_state = ATTRIBUTE_SUMMARY_VALID;
+    }
+#endif /* DB_FEATURE_VIEWS */
+
     intbuf[0] = result_attr->aggregation_value >> 8;
     intbuf[1] = result_attr->aggregation_value & 0xff;
     from_ptr = intbuf;
@@ -886,6 +1156,13 @@ relation_select(void *handle_ptr, relation_t *rel, void *adt_ptr)
   handle = (db_handle_t *)handle_ptr;
   handle->rel = rel;
   handle->adt = adt;
+  aggregated_tuples = 0;
+
+#if DB_FEATURE_BULK_INSERT
+  if(DB_ERROR(relation_bulk_flush(rel))) {
+    return DB_STORAGE_ERROR;
+  }
+#endif /* DB_FEATURE_BULK_INSERT */
 
   if(AQL_GET_FLAGS(adt) & AQL_FLAG_ASSIGN) {
     name = adt->relations[0];
@@ -955,6 +1232,12 @@ relation_select(void *handle_ptr, relation_t *rel, void *adt_ptr)
      return DB_RELATIONAL_ERROR;
   }
 
+#if DB_FEATURE_VIEWS
+  if((AQL_GET_FLAGS(adt) & AQL_FLAG_AGGREGATE) && adt->lvm_instance == NULL) {
+    use_summaries(handle, rel);
+  }
+#endif /* DB_FEATURE_VIEWS */
+
   return generate_selection_result(handle, rel, adt);
 }
 
@@ -1129,6 +1412,13 @@ relation_join(void *query_result, void *adt_ptr)
   handle->adt = adt;
   handle->flags = DB_HANDLE_FLAG_INDEX_STEP;
 
+#if DB_FEATURE_BULK_INSERT
+  if(DB_ERROR(relation_bulk_flush(handle->left_rel)) ||
+     DB_ERROR(relation_bulk_flush(handle->right_rel))) {
+    return DB_STORAGE_ERROR;
+  }
+#endif /* DB_FEATURE_BULK_INSERT */
+
   if(AQL_GET_FLAGS(adt) & AQL_FLAG_ASSIGN) {
     name = adt->relations[0];
     dir = DB_STORAGE;
@@ -95,6 +95,12 @@ db_result_t relation_attribute_remove(relation_t *, char *);
 db_result_t relation_set_primary_key(relation_t *, char *);
 db_result_t relation_remove(char *, int);
 db_result_t relation_insert(relation_t *, attribute_value_t *);
+#if DB_FEATURE_BULK_INSERT
+/* Buffers the tuple in RAM, until the buffer is full, the relation is
+   released or queried, or relation_bulk_flush is called. */
+db_result_t relation_bulk_insert(relation_t *, attribute_value_t *);
+db_result_t relation_bulk_flush(relation_t *);
+#endif /* DB_FEATURE_BULK_INSERT */
 db_result_t relation_select(void *, relation_t *, void *);
 db_result_t relation_join(void *, void *);
 tuple_id_t relation_cardinality(relation_t *);
@@ -439,11 +439,19 @@ storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row)
 
 db_result_t
 storage_put_row(relation_t *rel, storage_row_t row)
+{
+  return storage_put_rows(rel, row, 1);
+}
+
+/* Appends count consecutive rows with a single write. */
+db_result_t
+storage_put_rows(relation_t *rel, storage_row_t rows, unsigned count)
 {
   cfs_offset_t end;
   unsigned remaining;
+  unsigned i;
   int r;
-  unsigned char *last_byte;
+  storage_row_t row;
 #if DB_FEATURE_INTEGRITY
   int missing_bytes;
   char buf[rel->row_length];
@@ -467,26 +475,29 @@ storage_put_row(relation_t *rel, storage_row_t row)
 
   /* Ensure that last written byte is separated from 0, to make file
      lengths correct in Coffee. */
-  last_byte = row + rel->row_length - 1;
-  *last_byte ^= ROW_XOR;
+  for(i = 1; i <= count; i++) {
+    rows[i * rel->row_length - 1] ^= ROW_XOR;
+  }
 
-  remaining = rel->row_length;
+  row = rows;
+  remaining = count * rel->row_length;
   do {
     r = cfs_write(rel->tuple_storage, row, remaining);
     if(r < 0) {
       PRINTF("DB: Failed to store %u bytes\n", remaining);
-      *last_byte ^= ROW_XOR;
-      return DB_STORAGE_ERROR;
+      break;
     }
     row += r;
     remaining -= r;
   } while(remaining > 0);
 
-  PRINTF("DB: Stored a of %d bytes\n", rel->row_length);
+  PRINTF("DB: Stored %u rows of %d bytes\n", count, rel->row_length);
 
-  *last_byte ^= ROW_XOR;
+  for(i = 1; i <= count; i++) {
+    rows[i * rel->row_length - 1] ^= ROW_XOR;
+  }
 
-  return DB_OK;
+  return remaining > 0 ? DB_STORAGE_ERROR : DB_OK;
 }
 
 db_result_t
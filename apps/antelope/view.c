@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *	Aggregates maintained on insertion, and continuous queries.
+ */
+
+#include <limits.h>
+#include <string.h>
+
+#include "contiki.h"
+#include "lib/list.h"
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+#include "aql.h"
+#include "result.h"
+#include "view.h"
+
+#if DB_FEATURE_VIEWS
+
+LIST(views);
+
+void
+view_summary_clear(struct attribute_summary *summary)
+{
+  summary->count = 0;
+  summary->sum = 0;
+  summary->min = LONG_MAX;
+  summary->max = LONG_MIN;
+}
+
+void
+view_summary_add(struct attribute_summary *summary, long value)
+{
+  summary->count++;
+  summary->sum += value;
+  if(value < summary->min) {
+    summary->min = value;
+  }
+  if(value > summary->max) {
+    summary->max = value;
+  }
+}
+
+db_result_t
+view_summary_get(struct attribute_summary *summary, uint8_t aggregator,
+                 long *value)
+{
+  switch(aggregator) {
+  case AQL_COUNT:
+    *value = summary->count;
+    break;
+  case AQL_SUM:
+    *value = summary->sum;
+    break;
+  case AQL_MIN:
+    *value = summary->min;
+    break;
+  case AQL_MAX:
+    *value = summary->max;
+    break;
+  case AQL_MEAN:
+    *value = summary->count > 0 ? summary->sum / (long)summary->count : 0;
+    break;
+  default:
+    return DB_IMPLEMENTATION_ERROR;
+  }
+
+  return DB_OK;
+}
+
+static void
+view_update(struct db_view *view, long value)
+{
+  unsigned long now;
+
+  now = clock_seconds();
+  if(view->window.count > 0 && now - view->start >= view->period) {
+    PRINTF("DB: View %s.%s: window of %lu values\n",
+           view->relation, view->attribute, (unsigned long)view->window.count);
+    view->callback(view, &view->window);
+    view_summary_clear(&view->window);
+  }
+  if(view->window.count == 0) {
+    view->start = now;
+  }
+  view_summary_add(&view->window, value);
+}
+
+/* Values are read back from the stored row, as a scan would read them. */
+void
+view_insert(relation_t *rel, unsigned char *row)
+{
+  attribute_t *attr;
+  attribute_value_t value;
+  struct db_view *view;
+  long long_value;
+
+  for(attr = list_head(rel->attributes);
+      attr != NULL;
+      row += attr->element_size, attr = attr->next) {
+    if((attr->domain != DOMAIN_INT && attr->domain != DOMAIN_LONG) ||
+       DB_ERROR(db_phy_to_value(&value, attr, row))) {
+      continue;
+    }
+    long_value = db_value_to_long(&value);
+
+    if(attr->summary_state == ATTRIBUTE_SUMMARY_VALID) {
+      view_summary_add(&attr->summary, long_value);
+    } else {
+      /* A scan in progress may or may not see the new tuple. */
+      attr->summary_state = ATTRIBUTE_SUMMARY_INVALID;
+    }
+
+    for(view = list_head(views); view != NULL; view = view->next) {
+      if(strcmp(view->relation, rel->name) == 0 &&
+         strcmp(view->attribute, attr->name) == 0) {
+        view_update(view, long_value);
+      }
+    }
+  }
+}
+
+db_result_t
+db_view_register(struct db_view *view, char *relation, char *attribute,
+                 unsigned long period, db_view_callback_t callback)
+{
+  if(strlen(relation) > RELATION_NAME_LENGTH ||
+     strlen(attribute) > ATTRIBUTE_NAME_LENGTH ||
+     period == 0 || callback == NULL) {
+    return DB_ARGUMENT_ERROR;
+  }
+
+  strcpy(view->relation, relation);
+  strcpy(view->attribute, attribute);
+  view->period = period;
+  view->callback = callback;
+  view_summary_clear(&view->window);
+
+  list_add(views, view);
+  return DB_OK;
+}
+
+void
+db_view_unregister(struct db_view *view)
+{
+  list_remove(views, view);
+}
+
+#endif /* DB_FEATURE_VIEWS */
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *	Aggregates maintained on insertion, with DB_FEATURE_VIEWS.
+ *
+ *	Every attribute keeps the count, sum, minimum and maximum of its
+ *	values. They are exact for relations created since boot, and for
+ *	the others once an aggregate query without a condition has scanned
+ *	the relation; from then on, such queries are answered without
+ *	reading the relation.
+ *
+ *	A continuous query (struct db_view) aggregates the values of an
+ *	attribute inserted during consecutive windows of a given period,
+ *	and passes every completed window to a callback, e.g., to send a
+ *	summary instead of the samples. A window is completed by the
+ *	first insertion after its period.
+ */
+
+#ifndef VIEW_H
+#define VIEW_H
+
+#include "lib/list.h"
+
+#include "db-options.h"
+#include "db-types.h"
+#include "attribute.h"
+#include "relation.h"
+
+#if DB_FEATURE_VIEWS
+
+struct db_view;
+
+typedef void (*db_view_callback_t)(struct db_view *,
+                                   const struct attribute_summary *);
+
+struct db_view {
+  struct db_view *next;
+  char relation[RELATION_NAME_LENGTH + 1];
+  char attribute[ATTRIBUTE_NAME_LENGTH + 1];
+  unsigned long period;
+  unsigned long start;
+  struct attribute_summary window;
+  db_view_callback_t callback;
+};
+
+/* API for continuous queries. The period is in seconds. */
+db_result_t db_view_register(struct db_view *view, char *relation,
+                             char *attribute, unsigned long period,
+                             db_view_callback_t callback);
+void db_view_unregister(struct db_view *view);
+
+/* Internal API, used by relation.c. */
+void view_summary_clear(struct attribute_summary *summary);
+void view_summary_add(struct attribute_summary *summary, long value);
+db_result_t view_summary_get(struct attribute_summary *summary,
+                             uint8_t aggregator, long *value);
+void view_insert(relation_t *rel, unsigned char *row);
+
+#endif /* DB_FEATURE_VIEWS */
+
+#endif /* !VIEW_H */
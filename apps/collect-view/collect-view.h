@@ -22,6 +22,10 @@ struct collect_view_data_msg {
   uint16_t sensors[10];
 };
 
+/* The last sensor slot, not used by the platforms, holds the occupancy
+   of the collect forwarding queue (%) */
+#define COLLECT_VIEW_QUEUE_SENSOR 9
+
 void collect_view_construct_message(struct collect_view_data_msg *msg,
                                     const linkaddr_t *parent,
                                     uint16_t etx_to_parent,
@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Centralized scheduling at the root, see central-schedule.h
+ */
+
+#include "contiki-conf.h"
+#include "deployment.h"
+#include "central-schedule.h"
+#include "link-map.h"
+#include "net/mac/tsch/tsch-schedule.h"
+#include "dev/serial-line.h"
+#include "sys/ctimer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if WITH_DEPLOYMENT
+
+#define DEPTH_UNKNOWN 0xff
+
+struct cs_node {
+  uint16_t id;
+  uint16_t parent;
+  /* Cells per slotframe generated by the node */
+  uint8_t demand;
+  /* Computed: hops to the root, and cells needed to the parent */
+  uint8_t depth;
+  uint16_t load;
+};
+
+/* A cell from tx to rx */
+struct cs_cell {
+  uint16_t timeslot;
+  uint8_t channel_offset;
+  uint16_t tx;
+  uint16_t rx;
+};
+
+static struct cs_node nodes[CENTRAL_SCHEDULE_MAX_NODES];
+static uint8_t nodes_count;
+static struct cs_cell cells[CENTRAL_SCHEDULE_MAX_CELLS];
+static uint16_t cells_count;
+static uint16_t schedule_size;
+static uint16_t cs_root_id;
+
+/* Progress of the push: node, next cell, and whether the node got its
+ * first message, which replaces its schedule */
+static struct ctimer push_timer;
+static uint8_t push_node;
+static uint16_t push_cell;
+static int push_started;
+
+PROCESS(central_schedule_process, "Central schedule");
+
+/*---------------------------------------------------------------------------*/
+static struct cs_node *
+find_node(uint16_t id, int create)
+{
+  int i;
+  for(i = 0; i < nodes_count; i++) {
+    if(nodes[i].id == id) {
+      return &nodes[i];
+    }
+  }
+  if(!create || id == 0 || nodes_count == CENTRAL_SCHEDULE_MAX_NODES) {
+    return NULL;
+  }
+  nodes[nodes_count].id = id;
+  nodes[nodes_count].parent = 0;
+  nodes[nodes_count].demand = CENTRAL_SCHEDULE_DEFAULT_DEMAND;
+  return &nodes[nodes_count++];
+}
+/*---------------------------------------------------------------------------*/
+void
+central_schedule_set_parent(uint16_t node, uint16_t parent)
+{
+  struct cs_node *n = find_node(node, 1);
+  if(n != NULL && n->parent != parent) {
+    n->parent = parent;
+    LOG("CentralSchedule: %u parent %u\n", node, parent);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+central_schedule_set_demand(uint16_t node, uint8_t demand)
+{
+  struct cs_node *n = find_node(node, 1);
+  if(n != NULL) {
+    n->demand = demand;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Computes the depth of every node, DEPTH_UNKNOWN for the nodes with no
+ * path to the root */
+static void
+compute_depths(void)
+{
+  int i;
+  for(i = 0; i < nodes_count; i++) {
+    struct cs_node *n = &nodes[i];
+    uint8_t depth = 0;
+    while(n != NULL && n->id != cs_root_id && depth < nodes_count) {
+      n = find_node(n->parent, 0);
+      depth++;
+    }
+    nodes[i].depth = (n != NULL && n->id == cs_root_id) ? depth : DEPTH_UNKNOWN;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the first timeslot where neither tx nor rx is scheduled and a
+ * channel offset is left, -1 if none */
+static int
+find_timeslot(uint16_t tx, uint16_t rx, uint8_t *channel_offset)
+{
+  uint16_t ts;
+  for(ts = 0; ts < schedule_size; ts++) {
+    uint8_t used = 0;
+    int i;
+    for(i = 0; i < cells_count; i++) {
+      if(cells[i].timeslot == ts) {
+        if(cells[i].tx == tx || cells[i].rx == tx
+           || cells[i].tx == rx || cells[i].rx == rx) {
+          break;
+        }
+        used++;
+      }
+    }
+    if(i == cells_count && used < CENTRAL_SCHEDULE_CHANNEL_OFFSETS) {
+      *channel_offset = 1 + used;
+      return ts;
+    }
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+int
+central_schedule_compute(uint16_t sf_size)
+{
+  uint8_t order[CENTRAL_SCHEDULE_MAX_NODES];
+  int i, j;
+
+  schedule_size = sf_size > 0 ? sf_size : CENTRAL_SCHEDULE_SLOTFRAME_SIZE;
+  cells_count = 0;
+  compute_depths();
+
+  /* The load of a node is the demand of its subtree */
+  for(i = 0; i < nodes_count; i++) {
+    nodes[i].load = 0;
+  }
+  for(i = 0; i < nodes_count; i++) {
+    struct cs_node *n = &nodes[i];
+    if(n->depth == DEPTH_UNKNOWN) {
+      continue;
+    }
+    while(n->id != cs_root_id) {
+      n->load += nodes[i].demand;
+      n = find_node(n->parent, 0);
+    }
+  }
+
+  /* Deepest first: the first free timeslots go to the leaves, and
+   * every parent then forwards in a later timeslot of the same slotframe */
+  for(i = 0; i < nodes_count; i++) {
+    for(j = i; j > 0 && nodes[order[j - 1]].depth < nodes[i].depth; j--) {
+      order[j] = order[j - 1];
+    }
+    order[j] = i;
+  }
+
+  for(i = 0; i < nodes_count; i++) {
+    struct cs_node *n = &nodes[order[i]];
+    uint16_t k;
+    if(n->depth == DEPTH_UNKNOWN || n->id == cs_root_id) {
+      continue;
+    }
+    for(k = 0; k < n->load; k++) {
+      uint8_t channel_offset;
+      int ts = find_timeslot(n->id, n->parent, &channel_offset);
+      if(ts < 0 || cells_count == CENTRAL_SCHEDULE_MAX_CELLS) {
+        LOG("CentralSchedule:! demand does not fit, %u cells\n", cells_count);
+        cells_count = 0;
+        return -1;
+      }
+      cells[cells_count].timeslot = ts;
+      cells[cells_count].channel_offset = channel_offset;
+      cells[cells_count].tx = n->id;
+      cells[cells_count].rx = n->parent;
+      cells_count++;
+    }
+  }
+
+  LOG("CentralSchedule: %u cells, slotframe %u\n", cells_count, schedule_size);
+  for(i = 0; i < cells_count; i++) {
+    LOG("CentralSchedule: cell %u %u %u->%u\n", cells[i].timeslot,
+        cells[i].channel_offset, cells[i].tx, cells[i].rx);
+  }
+  return cells_count;
+}
+/*---------------------------------------------------------------------------*/
+/* Sends the next message of the push: the cells of the current node, at
+ * most LINK_MAP_MAX_LINKS at a time */
+static void
+push_next(void *ptr)
+{
+  struct link_map_link links[LINK_MAP_MAX_LINKS];
+  uint16_t id;
+  uint8_t count = 0;
+
+  if(push_node == nodes_count) {
+    LOG("CentralSchedule: schedule pushed\n");
+    return;
+  }
+
+  id = nodes[push_node].id;
+  for(; push_cell < cells_count && count < LINK_MAP_MAX_LINKS; push_cell++) {
+    const struct cs_cell *c = &cells[push_cell];
+    if(c->tx == id || c->rx == id) {
+      links[count].timeslot = c->timeslot;
+      links[count].channel_offset = c->channel_offset;
+      links[count].link_options = c->tx == id ? LINK_OPTION_TX : LINK_OPTION_RX;
+      links[count].neighbor = c->tx == id ? c->rx : c->tx;
+      count++;
+    }
+  }
+
+  if(!push_started) {
+    /* Nodes with no cells get an empty schedule, dropping their last one */
+    link_map_push_schedule(id, schedule_size, links, count);
+    push_started = 1;
+  } else if(count > 0) {
+    link_map_add_links(id, links, count);
+  }
+  if(push_cell == cells_count) {
+    push_node++;
+    push_cell = 0;
+    push_started = 0;
+  }
+  ctimer_set(&push_timer, CENTRAL_SCHEDULE_PUSH_INTERVAL, push_next, NULL);
+}
+/*---------------------------------------------------------------------------*/
+void
+central_schedule_push(void)
+{
+  push_node = 0;
+  push_cell = 0;
+  push_started = 0;
+  ctimer_set(&push_timer, 0, push_next, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+command(char *line)
+{
+  char *p;
+  unsigned long a, b;
+
+  if(strncmp(line, "cs ", 3) != 0) {
+    return;
+  }
+  line += 3;
+  if(!strncmp(line, "node ", 5)) {
+    a = strtoul(line + 5, &p, 10);
+    b = strtoul(p, &p, 10);
+    central_schedule_set_parent(a, b);
+    if(*p == ' ') {
+      central_schedule_set_demand(a, strtoul(p, &p, 10));
+    }
+  } else if(!strncmp(line, "demand ", 7)) {
+    a = strtoul(line + 7, &p, 10);
+    b = strtoul(p, &p, 10);
+    central_schedule_set_demand(a, b);
+  } else if(!strcmp(line, "clear")) {
+    ctimer_stop(&push_timer);
+    nodes_count = 0;
+    cells_count = 0;
+    find_node(cs_root_id, 1);
+    p = "";
+  } else if(!strncmp(line, "compute", 7)) {
+    a = strtoul(line + 7, &p, 10);
+    central_schedule_compute(a);
+  } else if(!strcmp(line, "push")) {
+    central_schedule_push();
+    p = "";
+  } else {
+    p = line;
+  }
+  if(*p != '\0') {
+    LOG("CentralSchedule:! bad command\n");
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(central_schedule_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == serial_line_event_message && data != NULL);
+    command((char *)data);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+central_schedule_init(uint16_t root_id)
+{
+  cs_root_id = root_id;
+  find_node(root_id, 1);
+  process_start(&central_schedule_process, NULL);
+}
+
+#endif /* WITH_DEPLOYMENT */
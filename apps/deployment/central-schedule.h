@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Centralized scheduling at the root. The root keeps the routing
+ *         tree, as reported by the nodes through the link map, and the
+ *         traffic demand of every node, in cells per slotframe. From them it
+ *         computes a conflict-free convergecast schedule: every node gets
+ *         enough cells to its parent to forward the demand of its whole
+ *         subtree, no node is scheduled twice in a timeslot, and cells of
+ *         a timeslot use distinct channel offsets. The schedule is then
+ *         pushed to the nodes, see link-map.h.
+ *
+ *         Driven from the serial line of the root, by hand or by a host tool:
+ *         cs node <id> <parent> [<demand>]   sets a node, e.g. from a host topology
+ *         cs demand <id> <demand>            sets the demand of a node
+ *         cs clear                           forgets all nodes
+ *         cs compute [<slotframe size>]      computes and prints the schedule
+ *         cs push                            pushes the schedule to all nodes
+ *
+ *         Started from deployment_init at the root with WITH_CENTRAL_SCHEDULE,
+ *         which needs WITH_LINK_MAP.
+ */
+
+#ifndef CENTRAL_SCHEDULE_H
+#define CENTRAL_SCHEDULE_H
+
+#include "contiki-conf.h"
+#include "deployment.h"
+
+#ifdef CENTRAL_SCHEDULE_CONF_MAX_NODES
+#define CENTRAL_SCHEDULE_MAX_NODES CENTRAL_SCHEDULE_CONF_MAX_NODES
+#else
+#define CENTRAL_SCHEDULE_MAX_NODES MAX_NODES
+#endif
+
+/* Maximum number of cells of a schedule */
+#ifdef CENTRAL_SCHEDULE_CONF_MAX_CELLS
+#define CENTRAL_SCHEDULE_MAX_CELLS CENTRAL_SCHEDULE_CONF_MAX_CELLS
+#else
+#define CENTRAL_SCHEDULE_MAX_CELLS 64
+#endif
+
+#ifdef CENTRAL_SCHEDULE_CONF_SLOTFRAME_SIZE
+#define CENTRAL_SCHEDULE_SLOTFRAME_SIZE CENTRAL_SCHEDULE_CONF_SLOTFRAME_SIZE
+#else
+#define CENTRAL_SCHEDULE_SLOTFRAME_SIZE 47
+#endif
+
+/* Channel offsets used, from 1 up, leaving 0 to broadcast slotframes */
+#ifdef CENTRAL_SCHEDULE_CONF_CHANNEL_OFFSETS
+#define CENTRAL_SCHEDULE_CHANNEL_OFFSETS CENTRAL_SCHEDULE_CONF_CHANNEL_OFFSETS
+#else
+#define CENTRAL_SCHEDULE_CHANNEL_OFFSETS 4
+#endif
+
+/* Cells per slotframe generated by a node, unless set otherwise */
+#ifdef CENTRAL_SCHEDULE_CONF_DEFAULT_DEMAND
+#define CENTRAL_SCHEDULE_DEFAULT_DEMAND CENTRAL_SCHEDULE_CONF_DEFAULT_DEMAND
+#else
+#define CENTRAL_SCHEDULE_DEFAULT_DEMAND 1
+#endif
+
+/* Delay between two pushed messages, not to flood the network */
+#ifdef CENTRAL_SCHEDULE_CONF_PUSH_INTERVAL
+#define CENTRAL_SCHEDULE_PUSH_INTERVAL CENTRAL_SCHEDULE_CONF_PUSH_INTERVAL
+#else
+#define CENTRAL_SCHEDULE_PUSH_INTERVAL (2 * CLOCK_SECOND)
+#endif
+
+/* Starts the scheduler, at the root */
+void central_schedule_init(uint16_t root_id);
+/* Sets the parent of a node, 0 if none. Meant as LINK_MAP_CALLBACK_PARENT */
+void central_schedule_set_parent(uint16_t node, uint16_t parent);
+/* Sets the demand of a node, in cells per slotframe */
+void central_schedule_set_demand(uint16_t node, uint8_t demand);
+/* Computes the schedule. Returns the number of cells, -1 if the demand
+ * did not fit */
+int central_schedule_compute(uint16_t sf_size);
+/* Pushes the last computed schedule to all nodes */
+void central_schedule_push(void);
+
+#endif /* CENTRAL_SCHEDULE_H */
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Delta images, see delta-patch.h
+ */
+
+#include "contiki-conf.h"
+#include "deployment.h"
+#include "delta-patch.h"
+#include "cfs/cfs.h"
+#include "lib/crc16.h"
+#include <stdio.h>
+#include <string.h>
+
+#if WITH_DEPLOYMENT
+
+static uint8_t buf[DELTA_PATCH_BUFFER_SIZE];
+
+/*---------------------------------------------------------------------------*/
+#ifndef DELTA_PATCH_READ_BASE
+#define BASE_FROM_FILE 1
+static int base_fd = -1;
+
+static int
+read_base(uint32_t offset, uint8_t *data, uint16_t len)
+{
+  if(cfs_seek(base_fd, offset, CFS_SEEK_SET) != (cfs_offset_t)offset) {
+    return -1;
+  }
+  return cfs_read(base_fd, data, len);
+}
+#define DELTA_PATCH_READ_BASE read_base
+#endif /* DELTA_PATCH_READ_BASE */
+/*---------------------------------------------------------------------------*/
+static uint32_t
+get32(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | (p[2] << 8) | p[3];
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+get16(const uint8_t *p)
+{
+  return (p[0] << 8) | p[1];
+}
+/*---------------------------------------------------------------------------*/
+/* CRC of the first size bytes of the base, -1 if it is shorter */
+static int32_t
+base_crc(uint32_t size)
+{
+  uint16_t crc = 0;
+  uint32_t offset;
+  for(offset = 0; offset < size; offset += sizeof(buf)) {
+    uint16_t len = size - offset < sizeof(buf) ? size - offset : sizeof(buf);
+    if(DELTA_PATCH_READ_BASE(offset, buf, len) != len) {
+      return -1;
+    }
+    crc = crc16_data(buf, len, crc);
+  }
+  return crc;
+}
+/*---------------------------------------------------------------------------*/
+/* The operations: copies from the base and additions, written in order.
+ * Returns the CRC of what was written, -1 on failure */
+static int32_t
+apply(int delta_fd, int new_fd, uint32_t base_size, uint32_t new_size)
+{
+  uint32_t written = 0;
+  uint16_t crc = 0;
+  uint8_t op[7];
+
+  while(written < new_size) {
+    uint32_t offset = 0;
+    uint16_t len;
+
+    if(cfs_read(delta_fd, op, 3) != 3) {
+      return -1;
+    }
+    if(op[0] == DELTA_COPY) {
+      if(cfs_read(delta_fd, op + 3, 4) != 4) {
+        return -1;
+      }
+      offset = get32(op + 1);
+      len = get16(op + 5);
+      if(offset > base_size || len > base_size - offset) {
+        return -1;
+      }
+    } else if(op[0] == DELTA_ADD) {
+      len = get16(op + 1);
+    } else {
+      return -1;
+    }
+    if(len == 0 || len > new_size - written) {
+      return -1;
+    }
+
+    while(len > 0) {
+      uint16_t chunk = len < sizeof(buf) ? len : sizeof(buf);
+      int r = op[0] == DELTA_COPY ? DELTA_PATCH_READ_BASE(offset, buf, chunk)
+                                  : cfs_read(delta_fd, buf, chunk);
+      if(r != chunk || cfs_write(new_fd, buf, chunk) != chunk) {
+        return -1;
+      }
+      crc = crc16_data(buf, chunk, crc);
+      offset += chunk;
+      written += chunk;
+      len -= chunk;
+    }
+  }
+  return crc;
+}
+/*---------------------------------------------------------------------------*/
+int32_t
+delta_patch(const char *delta_file, const char *new_file, uint16_t *new_crc)
+{
+  uint8_t header[DELTA_HEADER_LEN];
+  uint32_t base_size, new_size;
+  int32_t crc = -1;
+  int delta_fd, new_fd;
+
+  delta_fd = cfs_open(delta_file, CFS_READ);
+  if(delta_fd < 0) {
+    return -1;
+  }
+  if(cfs_read(delta_fd, header, sizeof(header)) != sizeof(header)
+     || memcmp(header, DELTA_MAGIC, 4) != 0) {
+    LOG("Delta:! bad header\n");
+    cfs_close(delta_fd);
+    return -1;
+  }
+  base_size = get32(header + 4);
+  new_size = get32(header + 8);
+
+#if BASE_FROM_FILE
+  if(strcmp(new_file, DELTA_PATCH_BASE_FILE) == 0
+     || (base_fd = cfs_open(DELTA_PATCH_BASE_FILE, CFS_READ)) < 0) {
+    cfs_close(delta_fd);
+    return -1;
+  }
+#endif /* BASE_FROM_FILE */
+
+  if(base_crc(base_size) != get16(header + 12)) {
+    LOG("Delta:! delta for another base\n");
+  } else {
+    cfs_remove(new_file);
+    new_fd = cfs_open(new_file, CFS_WRITE);
+    if(new_fd >= 0) {
+      crc = apply(delta_fd, new_fd, base_size, new_size);
+      cfs_close(new_fd);
+    }
+    if(crc != get16(header + 14)) {
+      LOG("Delta:! patch failed\n");
+      cfs_remove(new_file);
+      crc = -1;
+    }
+  }
+
+#if BASE_FROM_FILE
+  cfs_close(base_fd);
+  base_fd = -1;
+#endif /* BASE_FROM_FILE */
+  cfs_close(delta_fd);
+  if(crc < 0) {
+    return -1;
+  }
+  if(new_crc != NULL) {
+    *new_crc = crc;
+  }
+  return new_size;
+}
+/*---------------------------------------------------------------------------*/
+void
+delta_patch_complete(const char *file, uint16_t version)
+{
+  uint16_t crc;
+  int32_t size = delta_patch(file, DELTA_PATCH_NEW_FILE, &crc);
+  if(size < 0) {
+    return;
+  }
+  LOG("Delta: version %u built, %lu bytes, crc %04x\n",
+      version, (unsigned long)size, crc);
+#ifdef DELTA_PATCH_CALLBACK_INSTALL
+  DELTA_PATCH_CALLBACK_INSTALL(DELTA_PATCH_NEW_FILE, size, crc);
+#endif /* DELTA_PATCH_CALLBACK_INSTALL */
+}
+
+#endif /* WITH_DEPLOYMENT */
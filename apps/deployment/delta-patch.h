@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Delta images: a new firmware image is rebuilt on the node from
+ *         the image it runs (the base) and a delta made on the host by
+ *         tools/delta-image, so that only the delta is disseminated.
+ *
+ *         A delta is a 16-byte header, then a list of operations:
+ *         "DLT1", base size (4 bytes), new size (4 bytes), base CRC16 and
+ *         new CRC16 (2 bytes each), all big-endian, then
+ *         DELTA_COPY, base offset (4 bytes), length (2 bytes): copy from the base
+ *         DELTA_ADD, length (2 bytes), bytes: new bytes
+ *
+ *         The delta is read and the new image written in one sequential
+ *         pass, with DELTA_PATCH_BUFFER_SIZE bytes of RAM. The base is read
+ *         through DELTA_PATCH_READ_BASE, e.g. straight from program flash,
+ *         so that the node does not stage a copy of it. Both CRCs are
+ *         checked: a delta made for another base, or a corrupted image,
+ *         is not installed.
+ *
+ *         With the dissemination service, set in project-conf.h:
+ *         #define DISSEMINATION_CALLBACK_COMPLETE delta_patch_complete
+ *         and point DELTA_PATCH_CALLBACK_INSTALL to the code that hands the
+ *         new image over to the bootloader.
+ */
+
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include "contiki-conf.h"
+
+#define DELTA_MAGIC "DLT1"
+#define DELTA_HEADER_LEN 16
+/* Operations */
+#define DELTA_COPY 0
+#define DELTA_ADD 1
+
+/* File the base is read from, unless DELTA_PATCH_CONF_READ_BASE is set */
+#ifdef DELTA_PATCH_CONF_BASE_FILE
+#define DELTA_PATCH_BASE_FILE DELTA_PATCH_CONF_BASE_FILE
+#else
+#define DELTA_PATCH_BASE_FILE "base.img"
+#endif
+
+/* Reads len bytes of the base at offset into buf, returns the number of
+ * bytes read. Defaults to reading DELTA_PATCH_BASE_FILE */
+#ifdef DELTA_PATCH_CONF_READ_BASE
+#define DELTA_PATCH_READ_BASE DELTA_PATCH_CONF_READ_BASE
+int DELTA_PATCH_READ_BASE(uint32_t offset, uint8_t *buf, uint16_t len);
+#endif
+
+/* File of the new image, built by delta_patch_complete */
+#ifdef DELTA_PATCH_CONF_NEW_FILE
+#define DELTA_PATCH_NEW_FILE DELTA_PATCH_CONF_NEW_FILE
+#else
+#define DELTA_PATCH_NEW_FILE "new.img"
+#endif
+
+#ifdef DELTA_PATCH_CONF_BUFFER_SIZE
+#define DELTA_PATCH_BUFFER_SIZE DELTA_PATCH_CONF_BUFFER_SIZE
+#else
+#define DELTA_PATCH_BUFFER_SIZE 64
+#endif
+
+/* Called with a new image that passed the checks, e.g. to write its size
+ * and CRC where the bootloader looks for an update, and reboot */
+#ifdef DELTA_PATCH_CALLBACK_INSTALL
+void DELTA_PATCH_CALLBACK_INSTALL(const char *file, uint32_t size, uint16_t crc);
+#endif
+
+/* Builds new_file from the base and delta_file, and sets *new_crc (if not
+ * NULL) to its CRC16. Returns the size of the new image, -1 on failure:
+ * bad delta, other base, or CRC mismatch */
+int32_t delta_patch(const char *delta_file, const char *new_file, uint16_t *new_crc);
+/* Patches a delta just disseminated into DELTA_PATCH_NEW_FILE, and
+ * installs it. Meant as DISSEMINATION_CALLBACK_COMPLETE */
+void delta_patch_complete(const char *file, uint16_t version);
+
+#endif /* DELTA_PATCH_H */
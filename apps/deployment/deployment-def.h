@@ -69,7 +69,11 @@
 #define MAX_NODES 25
 #else
 #define ROOT_ID 1
+#ifdef DEPLOYMENT_CONF_MAX_NODES
+#define MAX_NODES DEPLOYMENT_CONF_MAX_NODES
+#else
 #define MAX_NODES 9
 #endif
+#endif
 
 #endif /* DEPLOYMENT_DEF_H */
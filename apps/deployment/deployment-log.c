@@ -39,15 +39,29 @@
 #include "net/rpl/rpl-private.h"
 #include "net/packetbuf.h"
 #include "net/queuebuf.h"
+#include "net/ipv6/sicslowpan.h"
+#include "net/mac/tsch/tsch-schedule.h"
+#include "net/mac/tsch/tsch-queue.h"
+#include "lib/ringbufindex.h"
 #include "deployment-log.h"
 #include "simple-energest.h"
 #include <stdio.h>
 #include <string.h>
+#include <stdarg.h>
 
 #if WITH_DEPLOYMENT
 #include "deployment.h"
 #endif /* WITH_DEPLOYMENT */
 
+#if WITH_ORCHESTRA
+#include "orchestra.h"
+#endif /* WITH_ORCHESTRA */
+
+#if defined(CONFIG_CONTIKIMAC) && CONFIG == CONFIG_CONTIKIMAC
+#include "net/mac/contikimac/contikimac.h"
+#endif /* CONFIG == CONFIG_CONTIKIMAC */
+#include "net/mac/csma.h"
+
 #if WITH_LOG
 
 #if WITH_RPL
@@ -71,6 +85,36 @@ rpl_print_neighbor_list()
       );
       p = nbr_table_next(rpl_parents, p);
     }
+#if RPL_CONF_PROBING
+    printf("RPL: probes %u, data %u, over budget %u\n",
+        rpl_probing_stats.sent, rpl_probing_stats.coalesced, rpl_probing_stats.over_budget);
+#endif /* RPL_CONF_PROBING */
+#if RPL_DIO_ADAPTIVE_REDUNDANCY
+    printf("RPL: dio int %u, sent %u, suppressed %u, last heard %u k %u %s\n",
+        rpl_trickle_stats.intervals, rpl_trickle_stats.sent, rpl_trickle_stats.suppressed,
+        rpl_trickle_stats.last_heard, rpl_trickle_stats.last_k,
+        rpl_trickle_stats.last_sent ? "sent" : "suppressed");
+#endif /* RPL_DIO_ADAPTIVE_REDUNDANCY */
+#if RPL_LOOP_STATS
+    {
+      static const char *loop_event_names[] = { "rank", "rank-repair", "fwd-rx", "fwd-tx" };
+      uint8_t i;
+      printf("RPL: loops %u, repairs %u, fwd err rx %u tx %u, dropped %u\n",
+          rpl_loop_stats.count[RPL_LOOP_RANK_ERROR],
+          rpl_loop_stats.count[RPL_LOOP_RANK_ERROR_REPAIR],
+          rpl_loop_stats.count[RPL_LOOP_FWD_ERROR_RECEIVED],
+          rpl_loop_stats.count[RPL_LOOP_FWD_ERROR_SENT],
+          rpl_loop_stats.dropped);
+      /* Each event is printed once */
+      for(i = 0; i < rpl_loop_stats.history_count; i++) {
+        struct rpl_loop_event *e = &rpl_loop_stats.history[i];
+        printf("RPL: loop %s from %u, rank %u -> %u, %u s after switch\n",
+            loop_event_names[e->type], LOG_NODEID_FROM_LINKADDR(&e->sender),
+            e->sender_rank, e->rank, e->since_switch);
+      }
+      rpl_loop_stats.history_count = 0;
+    }
+#endif /* RPL_LOOP_STATS */
     printf("RPL: eol\n");
   }
 }
@@ -123,6 +167,16 @@ appdataptr_from_queuebuf(const void *q)
 {
   return appdataptr_from_buffer(queuebuf_dataptr((struct queuebuf *)q), queuebuf_datalen((struct queuebuf *)q));
 }
+/* Timestamp for origin_asn */
+uint32_t
+appdata_timestamp(void)
+{
+#if WITH_TSCH
+  return current_asn.ls4b;
+#else
+  return clock_time();
+#endif
+}
 /* Log information about a data packet along with RPL routing information */
 void
 log_appdataptr(void *dataptr)
@@ -140,6 +194,10 @@ log_appdataptr(void *dataptr)
           UIP_HTONS(data.src),
           UIP_HTONS(data.dest)
       );
+#if WITH_LOG_LATENCY
+      /* Slots since the origin, or clock ticks without TSCH */
+      printf(" lat %lu", (unsigned long)(appdata_timestamp() - UIP_HTONL(data.origin_asn)));
+#endif /* WITH_LOG_LATENCY */
 
     }
   }
@@ -147,11 +205,380 @@ log_appdataptr(void *dataptr)
   printf("\n");
 
 }
+#if WITH_DEPLOYMENT && DEPLOYMENT_LOG_BINARY
+
+#if (DEPLOYMENT_LOG_BINARY_NUM & (DEPLOYMENT_LOG_BINARY_NUM - 1)) != 0
+#error DEPLOYMENT_LOG_BINARY_NUM must be power of two
+#endif
+
+/* A queued event. The timestamp is the ASN with TSCH, the clock time
+ * otherwise */
+struct log_binary_record {
+  struct asn_t asn;
+  int32_t args[DEPLOYMENT_LOG_BINARY_ARGS];
+  uint32_t seqno;
+  uint16_t src;
+  uint16_t dest;
+#if WITH_LOG_LATENCY
+  uint32_t latency;
+#endif /* WITH_LOG_LATENCY */
+  uint8_t hop;
+  uint8_t fmt;
+  uint8_t nargs;
+  uint8_t flags;
+};
+
+/* Largest binary record, before SLIP escaping */
+#define BINARY_RECORD_MAX_LEN (9 + 4 * DEPLOYMENT_LOG_BINARY_ARGS + 9 + 4)
+/* Longest string record */
+#define BINARY_STRING_MAX_LEN 64
+
+#define SLIP_END     0300
+#define SLIP_ESC     0333
+#define SLIP_ESC_END 0334
+#define SLIP_ESC_ESC 0335
+
+PROCESS(log_binary_process, "Binary logging process");
+
+static struct ringbufindex log_binary_ringbuf;
+static struct log_binary_record log_binary_array[DEPLOYMENT_LOG_BINARY_NUM];
+/* The formats and string arguments seen so far, their index is their id
+ * in the records. Only the first strings_sent were output */
+static const char *strings[DEPLOYMENT_LOG_BINARY_MAX_STRINGS];
+static uint8_t strings_count;
+static uint8_t strings_sent;
+static uint16_t log_binary_dropped;
+static uint16_t last_log_binary_dropped;
+/* Set when the process was asked to run */
+static uint8_t drain_pending;
+
+/* Get the id of a string, adding it if new. Returns -1 if the table is full */
+static int
+string_id(const char *s)
+{
+  int i;
+  for(i = 0; i < strings_count; i++) {
+    if(strings[i] == s) {
+      return i;
+    }
+  }
+  if(strings_count == DEPLOYMENT_LOG_BINARY_MAX_STRINGS) {
+    return -1;
+  }
+  strings[strings_count] = s;
+  return strings_count++;
+}
+/* Write a record to the console, SLIP-framed. The leading END
+ * separates the record from any text output that preceded it */
+static void
+binary_write(const uint8_t *buf, int len)
+{
+  putchar(SLIP_END);
+  while(len-- > 0) {
+    if(*buf == SLIP_END) {
+      putchar(SLIP_ESC);
+      putchar(SLIP_ESC_END);
+    } else if(*buf == SLIP_ESC) {
+      putchar(SLIP_ESC);
+      putchar(SLIP_ESC_ESC);
+    } else {
+      putchar(*buf);
+    }
+    buf++;
+  }
+  putchar(SLIP_END);
+}
+/* Little-endian field writers, return the new write pointer */
+static uint8_t *
+put_u16(uint8_t *p, uint16_t v)
+{
+  *p++ = v & 0xff;
+  *p++ = v >> 8;
+  return p;
+}
+static uint8_t *
+put_u32(uint8_t *p, uint32_t v)
+{
+  p = put_u16(p, v & 0xffff);
+  return put_u16(p, v >> 16);
+}
+/* Encode and output an event. Layout (little endian): magic, type,
+ * asn (5), format id, flags, number of arguments, the arguments (4 each),
+ * then seqno (4), hop, source (2) and destination (2) of the appdata
+ * and the latency (4) */
+static void
+binary_event(const struct log_binary_record *r)
+{
+  uint8_t buf[BINARY_RECORD_MAX_LEN];
+  uint8_t *p = buf;
+  int i;
+
+  *p++ = DEPLOYMENT_LOG_BINARY_MAGIC;
+  *p++ = DEPLOYMENT_LOG_BINARY_EVENT;
+  *p++ = r->asn.ms1b;
+  p = put_u32(p, r->asn.ls4b);
+  *p++ = r->fmt;
+  *p++ = r->flags;
+  *p++ = r->nargs;
+  for(i = 0; i < r->nargs; i++) {
+    p = put_u32(p, r->args[i]);
+  }
+  if(r->flags & DEPLOYMENT_LOG_BINARY_FLAG_APPDATA) {
+    p = put_u32(p, r->seqno);
+    *p++ = r->hop;
+    p = put_u16(p, r->src);
+    p = put_u16(p, r->dest);
+  }
+#if WITH_LOG_LATENCY
+  if(r->flags & DEPLOYMENT_LOG_BINARY_FLAG_LATENCY) {
+    p = put_u32(p, r->latency);
+  }
+#endif /* WITH_LOG_LATENCY */
+  binary_write(buf, p - buf);
+}
+/* Output a string and its id. The text is not nul-terminated, its length
+ * is given by the frame */
+static void
+binary_string(uint8_t id)
+{
+  uint8_t buf[BINARY_STRING_MAX_LEN];
+  int len = strlen(strings[id]);
+
+  buf[0] = DEPLOYMENT_LOG_BINARY_MAGIC;
+  buf[1] = DEPLOYMENT_LOG_BINARY_STRING;
+  buf[2] = id;
+  len = MIN(len, BINARY_STRING_MAX_LEN - 3);
+  memcpy(buf + 3, strings[id], len);
+  binary_write(buf, len + 3);
+}
+/* Output the total number of dropped records */
+static void
+binary_dropped(uint16_t dropped)
+{
+  uint8_t buf[4];
+  buf[0] = DEPLOYMENT_LOG_BINARY_MAGIC;
+  buf[1] = DEPLOYMENT_LOG_BINARY_DROPPED;
+  put_u16(buf + 2, dropped);
+  binary_write(buf, 4);
+}
+/* Have the process run once the events already posted are handled */
+static void
+drain_request(void)
+{
+  if(!drain_pending
+      && process_post(&log_binary_process, PROCESS_EVENT_CONTINUE, NULL) == PROCESS_ERR_OK) {
+    drain_pending = 1;
+  }
+}
+/* Output the new strings and a batch of records.
+ * Returns 1 if records are left */
+static int
+drain(void)
+{
+  int16_t index;
+  int n;
+
+  while(strings_sent < strings_count) {
+    binary_string(strings_sent++);
+  }
+  if(log_binary_dropped != last_log_binary_dropped) {
+    last_log_binary_dropped = log_binary_dropped;
+    binary_dropped(last_log_binary_dropped);
+  }
+  for(n = 0; n < DEPLOYMENT_LOG_BINARY_BATCH
+      && (index = ringbufindex_peek_get(&log_binary_ringbuf)) != -1; n++) {
+    binary_event(&log_binary_array[index]);
+    ringbufindex_get(&log_binary_ringbuf);
+  }
+  return ringbufindex_elements(&log_binary_ringbuf) > 0;
+}
+/* Queue an event for binary logging */
+void
+log_binary_add(void *dataptr, const char *fmt, ...)
+{
+  struct log_binary_record *r;
+  struct app_data data;
+  int16_t index;
+  int id;
+  va_list ap;
+
+  index = ringbufindex_peek_put(&log_binary_ringbuf);
+  if(index == -1 || (id = string_id(fmt)) == -1) {
+    log_binary_dropped++;
+    return;
+  }
+  r = &log_binary_array[index];
+#if WITH_TSCH
+  r->asn = current_asn;
+#else
+  ASN_INIT(r->asn, 0, clock_time());
+#endif
+  r->fmt = id;
+  r->nargs = 0;
+  r->flags = 0;
+
+  /* Fetch the arguments as the format says, %s ones are stored as the id
+   * of the string */
+  va_start(ap, fmt);
+  while(*fmt != '\0' && r->nargs < DEPLOYMENT_LOG_BINARY_ARGS) {
+    int is_long = 0;
+    if(*fmt++ != '%') {
+      continue;
+    }
+    while(*fmt != '\0' && strchr("-+ #0123456789.", *fmt) != NULL) {
+      fmt++;
+    }
+    while(*fmt == 'l') {
+      is_long = 1;
+      fmt++;
+    }
+    switch(*fmt) {
+      case 'd':
+      case 'i':
+        r->args[r->nargs++] = is_long ? va_arg(ap, long) : va_arg(ap, int);
+        break;
+      case 'u':
+      case 'x':
+      case 'X':
+      case 'o':
+      case 'c':
+        r->args[r->nargs++] = is_long ? va_arg(ap, unsigned long) : va_arg(ap, unsigned);
+        break;
+      case 's':
+        if((id = string_id(va_arg(ap, const char *))) == -1) {
+          va_end(ap);
+          log_binary_dropped++;
+          return;
+        }
+        r->args[r->nargs++] = id;
+        break;
+    }
+    if(*fmt != '\0') {
+      fmt++;
+    }
+  }
+  va_end(ap);
+
+  if(dataptr != NULL) {
+    appdata_copy(&data, dataptr);
+    if(data.magic == UIP_HTONL(LOG_MAGIC)) {
+      r->flags |= DEPLOYMENT_LOG_BINARY_FLAG_APPDATA;
+      r->seqno = UIP_HTONL(data.seqno);
+      r->hop = data.hop;
+      r->src = UIP_HTONS(data.src);
+      r->dest = UIP_HTONS(data.dest);
+#if WITH_LOG_LATENCY
+      r->flags |= DEPLOYMENT_LOG_BINARY_FLAG_LATENCY;
+      r->latency = appdata_timestamp() - UIP_HTONL(data.origin_asn);
+#endif /* WITH_LOG_LATENCY */
+    }
+  }
+
+  ringbufindex_put(&log_binary_ringbuf);
+  drain_request();
+}
+/* Drains the ring in batches, letting other processes run in between */
+PROCESS_THREAD(log_binary_process, ev, data)
+{
+  static struct etimer periodic;
+  PROCESS_BEGIN();
+  etimer_set(&periodic, CLOCK_SECOND);
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_CONTINUE || etimer_expired(&periodic));
+    if(etimer_expired(&periodic)) {
+      etimer_reset(&periodic);
+    }
+    if(ev == PROCESS_EVENT_CONTINUE) {
+      drain_pending = 0;
+    }
+    if(drain()) {
+      drain_request();
+    }
+  }
+
+  PROCESS_END();
+}
+#endif /* WITH_DEPLOYMENT && DEPLOYMENT_LOG_BINARY */
+#if SICSLOWPAN_UDP_PROFILES
+/* Compressed appdata: seqno, src, dest, hop and ping, and the origin ASN
+ * with WITH_LOG_LATENCY. The magic is implied by the profile and the
+ * padding is not sent. */
+#if WITH_LOG_LATENCY
+#define APPDATA_COMPRESSED_LEN 14
+#else
+#define APPDATA_COMPRESSED_LEN 10
+#endif
+/* 6LoWPAN profile compressing the appdata at the end of a payload */
+static int
+appdata_compress(uint8_t *compressed, const uint8_t *payload, uint16_t len)
+{
+  struct app_data data;
+  uint16_t head;
+
+  if(appdataptr_from_buffer(payload, len) == NULL) {
+    return -1;
+  }
+  head = len - sizeof(struct app_data);
+  appdata_copy(&data, (uint8_t *)payload + head);
+  memcpy(compressed, payload, head);
+  compressed += head;
+  memcpy(compressed, &data.seqno, 4);
+  memcpy(compressed + 4, &data.src, 2);
+  memcpy(compressed + 6, &data.dest, 2);
+  compressed[8] = data.hop;
+  compressed[9] = data.ping;
+#if WITH_LOG_LATENCY
+  memcpy(compressed + 10, &data.origin_asn, 4);
+#endif
+  return head + APPDATA_COMPRESSED_LEN;
+}
+static int
+appdata_uncompress(uint8_t *payload, const uint8_t *compressed, uint16_t len, uint16_t max)
+{
+  struct app_data data;
+  uint16_t head;
+
+  if(len < APPDATA_COMPRESSED_LEN
+      || len - APPDATA_COMPRESSED_LEN + sizeof(struct app_data) > max) {
+    return -1;
+  }
+  head = len - APPDATA_COMPRESSED_LEN;
+  memcpy(payload, compressed, head);
+  compressed += head;
+  data.magic = UIP_HTONL(LOG_MAGIC);
+  memcpy(&data.seqno, compressed, 4);
+  memcpy(&data.src, compressed + 4, 2);
+  memcpy(&data.dest, compressed + 6, 2);
+  data.hop = compressed[8];
+  data.ping = compressed[9];
+  data.dummy_for_padding = 0;
+#if WITH_LOG_LATENCY
+  memcpy(&data.origin_asn, compressed + 10, 4);
+#endif
+#if WITH_DEPLOYMENT && WITH_LOG_HOP_COUNT
+  /* The frame had no appdata for LOG_INC_HOPCOUNT_FROM_PACKETBUF to find */
+  data.hop++;
+#endif
+  appdata_copy(payload + head, &data);
+  return head + sizeof(struct app_data);
+}
+static const struct sicslowpan_udp_profile appdata_profile = {
+  SICSLOWPAN_UDP_PROFILE_APPDATA, 0, appdata_compress, appdata_uncompress
+};
+#endif /* SICSLOWPAN_UDP_PROFILES */
 PROCESS(log_process, "Logging process");
 /* Starts logging process */
 void
 log_start()
 {
+#if SICSLOWPAN_UDP_PROFILES
+  sicslowpan_udp_profile_register(&appdata_profile);
+#endif /* SICSLOWPAN_UDP_PROFILES */
+#if WITH_DEPLOYMENT && DEPLOYMENT_LOG_BINARY
+  ringbufindex_init(&log_binary_ringbuf, DEPLOYMENT_LOG_BINARY_NUM);
+  process_start(&log_binary_process, NULL);
+#endif /* WITH_DEPLOYMENT && DEPLOYMENT_LOG_BINARY */
   process_start(&log_process, NULL);
 }
 /* The logging process */
@@ -165,10 +592,35 @@ PROCESS_THREAD(log_process, ev, data)
   while(1) {
     PROCESS_WAIT_UNTIL(etimer_expired(&periodic));
     etimer_reset(&periodic);
+#if WITH_DEPLOYMENT && DEPLOYMENT_LOG_BINARY
+    /* Output the strings again, for decoders started since */
+    strings_sent = 0;
+#endif /* WITH_DEPLOYMENT && DEPLOYMENT_LOG_BINARY */
     simple_energest_step(!(WITH_RPL == 1 && default_instance == NULL));
 #if WITH_RPL
     rpl_print_neighbor_list();
 #endif /* WITH_RPL */
+#if WITH_TSCH && TSCH_SCHEDULE_WITH_LINK_STATS
+    tsch_schedule_print();
+#endif /* WITH_TSCH && TSCH_SCHEDULE_WITH_LINK_STATS */
+#if WITH_TSCH && TSCH_QUEUE_WITH_STATS
+    tsch_queue_print_stats();
+#endif /* WITH_TSCH && TSCH_QUEUE_WITH_STATS */
+#if WITH_ORCHESTRA && ORCHESTRA_WITH_STATS
+    orchestra_print_stats();
+#endif /* WITH_ORCHESTRA && ORCHESTRA_WITH_STATS */
+#if !WITH_TSCH && CSMA_WITH_STATS
+    csma_print_stats();
+#endif /* !WITH_TSCH && CSMA_WITH_STATS */
+#if defined(CONFIG_CONTIKIMAC) && CONFIG == CONFIG_CONTIKIMAC
+    /* Phase-lock hit rate and strobe time (ticks), since boot */
+    printf("Cmac: phase known %lu hits %lu strobe %lu, unknown %lu strobe %lu\n",
+        (unsigned long)contikimac_phase_stats.known,
+        (unsigned long)contikimac_phase_stats.hits,
+        (unsigned long)contikimac_phase_stats.known_strobe_time,
+        (unsigned long)contikimac_phase_stats.unknown,
+        (unsigned long)contikimac_phase_stats.unknown_strobe_time);
+#endif /* CONFIG == CONFIG_CONTIKIMAC */
   }
 
   PROCESS_END();
@@ -42,6 +42,50 @@
 /* Used to identify packets carrying RPL log */
 #define LOG_MAGIC 0xcafebabe
 
+/* Queue LOGA, LOGU and LOGP events as binary records in a RAM ring, drained
+ * in batches by a process, instead of printing them right away.
+ * Decode on the host with tools/deployment-log-decode */
+#ifdef DEPLOYMENT_LOG_CONF_BINARY
+#define DEPLOYMENT_LOG_BINARY DEPLOYMENT_LOG_CONF_BINARY
+#else
+#define DEPLOYMENT_LOG_BINARY 0
+#endif
+
+/* Number of records in the ring, a power of two */
+#ifdef DEPLOYMENT_LOG_CONF_BINARY_NUM
+#define DEPLOYMENT_LOG_BINARY_NUM DEPLOYMENT_LOG_CONF_BINARY_NUM
+#else
+#define DEPLOYMENT_LOG_BINARY_NUM 16
+#endif
+
+/* Number of records written per run of the process */
+#ifdef DEPLOYMENT_LOG_CONF_BINARY_BATCH
+#define DEPLOYMENT_LOG_BINARY_BATCH DEPLOYMENT_LOG_CONF_BINARY_BATCH
+#else
+#define DEPLOYMENT_LOG_BINARY_BATCH 4
+#endif
+
+/* Number of distinct formats and string arguments. A record whose
+ * strings do not fit is dropped */
+#ifdef DEPLOYMENT_LOG_CONF_BINARY_MAX_STRINGS
+#define DEPLOYMENT_LOG_BINARY_MAX_STRINGS DEPLOYMENT_LOG_CONF_BINARY_MAX_STRINGS
+#else
+#define DEPLOYMENT_LOG_BINARY_MAX_STRINGS 48
+#endif
+
+/* Number of arguments stored with a record, the following ones are lost */
+#define DEPLOYMENT_LOG_BINARY_ARGS 5
+
+/* Binary record framing (SLIP, as the TSCH binary logs) and header */
+#define DEPLOYMENT_LOG_BINARY_MAGIC 0xa6
+/* Record types */
+#define DEPLOYMENT_LOG_BINARY_EVENT 0
+#define DEPLOYMENT_LOG_BINARY_STRING 1
+#define DEPLOYMENT_LOG_BINARY_DROPPED 2
+/* Flags in event records */
+#define DEPLOYMENT_LOG_BINARY_FLAG_APPDATA 0x01
+#define DEPLOYMENT_LOG_BINARY_FLAG_LATENCY 0x02
+
 /* Data structure copied at the end of all data packets, making it possible
  * to trace packets at every hop, from every layer. */
 struct app_data {
@@ -52,6 +96,10 @@ struct app_data {
   uint8_t hop;
   uint8_t ping;
   uint16_t dummy_for_padding;
+#if WITH_LOG_LATENCY
+  /* Time the packet was sent at its origin, see appdata_timestamp() */
+  uint32_t origin_asn;
+#endif /* WITH_LOG_LATENCY */
 };
 
 /* Copy an appdata to another with no assumption that the addresses are aligned */
@@ -64,8 +112,16 @@ struct app_data *appdataptr_from_buffer(const void *b, int len);
 struct app_data *appdataptr_from_packetbuf();
 /* Get dataptr from a queuebuf */
 struct app_data *appdataptr_from_queuebuf(const void *q);
-/* Log information about a data packet along with RPL routing information */
+/* Log information about a data packet along with RPL routing information.
+ * With WITH_LOG_LATENCY, also logs the time elapsed since its origin */
 void log_appdataptr(void *dataptr);
+/* Timestamp for origin_asn: the ASN with TSCH, network-wide, and the
+ * clock time otherwise */
+uint32_t appdata_timestamp(void);
+/* Queue an event for binary logging: a printf-like format with up to
+ * DEPLOYMENT_LOG_BINARY_ARGS integer or string arguments, followed by the
+ * appdata. String arguments must be constant, as the format */
+void log_binary_add(void *dataptr, const char *fmt, ...);
 /* Starts logging process */
 void log_start();
 /* Print all neighbors (RPL "parents"), their link metric and rank */
@@ -73,7 +129,15 @@ void rpl_print_neighbor_list();
 
 #if WITH_DEPLOYMENT
 #define LOG(...) printf(__VA_ARGS__)
-#define LOGA(appdataptr, ...) { printf(__VA_ARGS__); log_appdataptr(appdataptr); }
+/* Completes a line started with LOG, always printed as text */
+#define LOGA_TEXT(appdataptr, ...) { printf(__VA_ARGS__); log_appdataptr(appdataptr); }
+/* Same, with nothing to print before the appdata */
+#define LOGA_END(appdataptr) log_appdataptr(appdataptr)
+#if DEPLOYMENT_LOG_BINARY
+#define LOGA(appdataptr, ...) log_binary_add(appdataptr, __VA_ARGS__)
+#else
+#define LOGA(appdataptr, ...) LOGA_TEXT(appdataptr, __VA_ARGS__)
+#endif
 #define LOGU(...) LOGA(appdataptr_from_uip(), __VA_ARGS__)
 #define LOGP(...) LOGA(appdataptr_from_packetbuf(), __VA_ARGS__)
 #define LOG_IPADDR(addr) uip_debug_ipaddr_print(addr)
@@ -97,6 +161,8 @@ void rpl_print_neighbor_list();
 #define LOG(...) printf(__VA_ARGS__)
 #define LOG_NL(...) { printf(__VA_ARGS__); printf("\n"); }
 #define LOGA(appdataptr, ...) LOG_NL(__VA_ARGS__)
+#define LOGA_TEXT(appdataptr, ...) LOG_NL(__VA_ARGS__)
+#define LOGA_END(appdataptr) printf("\n")
 #define LOGU(...) LOG_NL(__VA_ARGS__)
 #define LOGP(...) LOG_NL(__VA_ARGS__)
 #define LOG_IPADDR(addr) uip_debug_ipaddr_print(addr)
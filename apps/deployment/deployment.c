@@ -42,6 +42,10 @@
 #include "net/mac/tsch/tsch.h"
 #include "net/ip/uip-debug.h"
 #include "random.h"
+#include "link-map.h"
+#include "health-report.h"
+#include "central-schedule.h"
+#include "dissemination.h"
 #include <string.h>
 #include <stdio.h>
 #if CONTIKI_TARGET_SKY || CONTIKI_TARGET_Z1
@@ -70,6 +74,26 @@
 #define WITH_TSCH 1
 #endif
 
+/* Look nodes up by MAC address in a table generated at build time from
+ * id_mac_list by tools/deployment-slot-map, which fails the build on
+ * conflicting MAC suffixes or node indices. Enabled by setting
+ * DEPLOYMENT_WITH_SLOT_MAP=1 in the Makefile. Never while generating it */
+#if defined(DEPLOYMENT_CONF_WITH_SLOT_MAP) && !DEPLOYMENT_SLOT_MAP_GEN
+#define DEPLOYMENT_WITH_SLOT_MAP DEPLOYMENT_CONF_WITH_SLOT_MAP
+#else
+#define DEPLOYMENT_WITH_SLOT_MAP 0
+#endif
+
+/* Slotframe length whose timeslots (node index modulo length) the
+ * generator checks for conflicts, 0 for none */
+#ifdef DEPLOYMENT_CONF_SLOT_MAP_PERIOD
+#define DEPLOYMENT_SLOT_MAP_PERIOD DEPLOYMENT_CONF_SLOT_MAP_PERIOD
+#elif defined(ORCHESTRA_UNICAST_PERIOD)
+#define DEPLOYMENT_SLOT_MAP_PERIOD ORCHESTRA_UNICAST_PERIOD
+#else
+#define DEPLOYMENT_SLOT_MAP_PERIOD 0
+#endif
+
 /* Our absolute index in the id_mac table */
 uint16_t node_index = 0xffff;
 
@@ -82,7 +106,8 @@ struct id_mac {
   linkaddr_t mac;
 };
 
-/* List of ID<->MAC mapping used for different deployments */
+/* List of ID<->MAC mapping used for different deployments.
+ * Keep sorted by id, with unique 16-bit MAC suffixes, for lookups */
 static const struct id_mac id_mac_list[] = {
 #if IN_INDRIYA
     {  1, {{0x00,0x12,0x74,0x00,0x14,0x6e,0xb3,0xae}}},
@@ -243,6 +268,111 @@ static const struct id_mac id_mac_list[] = {
   { 0, { { 0 } } }
 };
 
+#if DEPLOYMENT_SLOT_MAP_GEN
+/* Read by tools/deployment-slot-map from the preprocessed file, which is
+ * never compiled */
+deployment_slot_map_params NODE_INDEX_SUFFLE ; NODE_INDEX_SUFFLE_MULTIPLICATOR ;
+    NODE_INDEX_SUFFLE_MODULUS ; DEPLOYMENT_SLOT_MAP_PERIOD ;
+#endif /* DEPLOYMENT_SLOT_MAP_GEN */
+
+#if !IN_COOJA
+/* Number of entries in id_mac_list, which must be sorted by id */
+#define ID_MAC_COUNT (sizeof(id_mac_list) / sizeof(id_mac_list[0]) - 1)
+
+#define MAC_SUFFIX(mac) (((uint16_t)(mac)->u8[6] << 8) | (mac)->u8[7])
+
+#if DEPLOYMENT_WITH_SLOT_MAP
+/* A node of id_mac_list, with its node index */
+struct deployment_slot_map {
+  uint16_t mac_suffix;
+  uint16_t id;
+  uint16_t index; /* As returned by nodex_index_map */
+};
+/* deployment_slot_map[], sorted by MAC suffix */
+#include "deployment-slot-map.h"
+
+/* Binary search of a linkaddr by its 16-bit suffix in the generated
+ * table. Returns NULL if not found */
+static const struct deployment_slot_map *
+slot_map_from_linkaddr(const linkaddr_t *addr)
+{
+  uint16_t suffix = MAC_SUFFIX(addr);
+  uint16_t low = 0;
+  uint16_t high = DEPLOYMENT_SLOT_MAP_COUNT;
+  while(low < high) {
+    uint16_t mid = (low + high) / 2;
+    if(deployment_slot_map[mid].mac_suffix < suffix) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return (low < DEPLOYMENT_SLOT_MAP_COUNT && deployment_slot_map[low].mac_suffix == suffix)
+      ? &deployment_slot_map[low] : NULL;
+}
+#else /* DEPLOYMENT_WITH_SLOT_MAP */
+/* Indices of id_mac_list sorted by 16-bit MAC suffix, built on first use */
+static uint8_t mac_order[ID_MAC_COUNT + 1];
+static uint8_t mac_order_ready;
+
+/* Sort the table indices by MAC suffix, once, by insertion */
+static void
+mac_order_init(void)
+{
+  uint16_t i, j;
+  for(i = 0; i < ID_MAC_COUNT; i++) {
+    uint16_t suffix = MAC_SUFFIX(&id_mac_list[i].mac);
+    for(j = i; j > 0 && MAC_SUFFIX(&id_mac_list[mac_order[j - 1]].mac) > suffix; j--) {
+      mac_order[j] = mac_order[j - 1];
+    }
+    mac_order[j] = i;
+  }
+  mac_order_ready = 1;
+}
+/* Binary search of a linkaddr by its 16-bit suffix, assumed network-wide
+ * unique. Returns NULL if not found */
+static const struct id_mac *
+id_mac_from_linkaddr(const linkaddr_t *addr)
+{
+  uint16_t suffix = MAC_SUFFIX(addr);
+  uint16_t low = 0;
+  uint16_t high = ID_MAC_COUNT;
+  if(!mac_order_ready) {
+    mac_order_init();
+  }
+  while(low < high) {
+    uint16_t mid = (low + high) / 2;
+    if(MAC_SUFFIX(&id_mac_list[mac_order[mid]].mac) < suffix) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  if(low < ID_MAC_COUNT && MAC_SUFFIX(&id_mac_list[mac_order[low]].mac) == suffix) {
+    return &id_mac_list[mac_order[low]];
+  }
+  return NULL;
+}
+#endif /* DEPLOYMENT_WITH_SLOT_MAP */
+
+/* Binary search of a node-id in id_mac_list. Returns NULL if not found */
+static const struct id_mac *
+id_mac_from_id(uint16_t id)
+{
+  uint16_t low = 0;
+  uint16_t high = ID_MAC_COUNT;
+  while(low < high) {
+    uint16_t mid = (low + high) / 2;
+    if(id_mac_list[mid].id < id) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return (low < ID_MAC_COUNT && id_mac_list[low].id == id) ? &id_mac_list[low] : NULL;
+}
+#endif /* !IN_COOJA */
+
 uint16_t
 nodex_index_map(uint16_t index)
 {
@@ -260,6 +390,9 @@ get_node_id()
 #if CONTIKI_TARGET_Z1 || CONTIKI_TARGET_JN5168
   extern unsigned char node_mac[8];
   return node_id_from_linkaddr((const linkaddr_t *)node_mac);
+#elif CONTIKI_TARGET_NATIVE
+  /* Set by the native platform, from the id given by tsch-sim */
+  return node_id_from_linkaddr(&linkaddr_node_addr);
 #else
   extern unsigned char ds2411_id[8];
   return node_id_from_linkaddr((const linkaddr_t *)&ds2411_id);
@@ -290,15 +423,13 @@ node_index_from_linkaddr(const linkaddr_t *addr)
   if(addr == NULL) {
     return 0xffff;
   }
-  const struct id_mac *curr = id_mac_list;
-  while(curr->id != 0) {
-    /* Assume network-wide unique 16-bit MAC addresses */
-    if(curr->mac.u8[6] == addr->u8[6] && curr->mac.u8[7] == addr->u8[7]) {
-      return nodex_index_map(curr - id_mac_list);
-    }
-    curr++;
-  }
-  return 0xffff;
+#if DEPLOYMENT_WITH_SLOT_MAP
+  const struct deployment_slot_map *curr = slot_map_from_linkaddr(addr);
+  return curr != NULL ? curr->index : 0xffff;
+#else /* DEPLOYMENT_WITH_SLOT_MAP */
+  const struct id_mac *curr = id_mac_from_linkaddr(addr);
+  return curr != NULL ? nodex_index_map(curr - id_mac_list) : 0xffff;
+#endif /* DEPLOYMENT_WITH_SLOT_MAP */
 #endif /* IN_COOJA */
 }
 /* Returns a node-id from a node's linkaddr */
@@ -309,21 +440,19 @@ node_id_from_linkaddr(const linkaddr_t *addr)
   if(addr == NULL) {
     return 0;
   } else {
-    return addr->u8[7];
+    /* The high byte of ids above 255 (native simulation) is in byte 6 */
+    return addr->u8[7] | ((addr->u8[6] ^ addr->u8[7]) << 8);
   }
 #else /* IN_COOJA */
   if(addr == NULL) {
     return 0;
   }
-  const struct id_mac *curr = id_mac_list;
-  while(curr->id != 0) {
-    /* Assume network-wide unique 16-bit MAC addresses */
-    if(curr->mac.u8[6] == addr->u8[6] && curr->mac.u8[7] == addr->u8[7]) {
-      return curr->id;
-    }
-    curr++;
-  }
-  return 0;
+#if DEPLOYMENT_WITH_SLOT_MAP
+  const struct deployment_slot_map *curr = slot_map_from_linkaddr(addr);
+#else /* DEPLOYMENT_WITH_SLOT_MAP */
+  const struct id_mac *curr = id_mac_from_linkaddr(addr);
+#endif /* DEPLOYMENT_WITH_SLOT_MAP */
+  return curr != NULL ? curr->id : 0;
 #endif /* IN_COOJA */
 }
 /* Returns a node-id from a node's IPv6 address */
@@ -331,6 +460,9 @@ uint16_t
 node_id_from_ipaddr(const uip_ipaddr_t *addr)
 {
   uip_lladdr_t lladdr;
+  if(addr == NULL) {
+    return 0;
+  }
   lladdr_from_ipaddr_uuid(&lladdr, addr);
   return node_id_from_linkaddr((const linkaddr_t *)&lladdr);
 }
@@ -341,14 +473,8 @@ get_node_index_from_id(uint16_t id)
 #if IN_COOJA
   return nodex_index_map(id - 1);
 #else
-  const struct id_mac *curr = id_mac_list;
-  while(curr->id != 0) {
-    if(curr->id == id) {
-      return nodex_index_map(curr - id_mac_list);
-    }
-    curr++;
-  }
-  return 0xffff;
+  const struct id_mac *curr = id_mac_from_id(id);
+  return curr != NULL ? nodex_index_map(curr - id_mac_list) : 0xffff;
 #endif
 }
 /* Sets an IPv6 from a node-id */
@@ -372,19 +498,15 @@ set_linkaddr_from_id(linkaddr_t *lladdr, uint16_t id)
   lladdr->u8[3] = id;
   lladdr->u8[4] = 0x00;
   lladdr->u8[5] = id;
-  lladdr->u8[6] = id;
+  lladdr->u8[6] = (id & 0xff) ^ (id >> 8);
   lladdr->u8[7] = id;
 #else
   if(id == 0 || lladdr == NULL) {
     return;
   }
-  const struct id_mac *curr = id_mac_list;
-  while(curr->id != 0) {
-    if(curr->id == id) {
-      linkaddr_copy(lladdr, &curr->mac);
-      return;
-    }
-    curr++;
+  const struct id_mac *curr = id_mac_from_id(id);
+  if(curr != NULL) {
+    linkaddr_copy(lladdr, &curr->mac);
   }
 #endif
 }
@@ -431,6 +553,30 @@ deployment_init(uip_ipaddr_t *ipaddr, uip_ipaddr_t *br_prefix, int root_id)
   log_start();
 #endif /* WITH_LOG */
 
+#if WITH_LINK_MAP
+  if(WITH_RPL && root_id > 0) {
+    link_map_init(root_id);
+  }
+#endif /* WITH_LINK_MAP */
+
+#if WITH_HEALTH_REPORT
+  if(WITH_RPL && root_id > 0) {
+    health_report_init(root_id);
+  }
+#endif /* WITH_HEALTH_REPORT */
+
+#if WITH_CENTRAL_SCHEDULE
+  if(WITH_RPL && node_id == root_id) {
+    central_schedule_init(root_id);
+  }
+#endif /* WITH_CENTRAL_SCHEDULE */
+
+#if WITH_DISSEMINATION
+  if(WITH_RPL) {
+    dissemination_init();
+  }
+#endif /* WITH_DISSEMINATION */
+
   NETSTACK_MAC.on();
 
   return 1;
@@ -0,0 +1,626 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Dissemination of a file down the DODAG, see dissemination.h
+ */
+
+#include "contiki-conf.h"
+#include "deployment.h"
+#include "dissemination.h"
+#include "simple-udp.h"
+#include "cfs/cfs.h"
+#include "net/rpl/rpl.h"
+#include "dev/serial-line.h"
+#include "sys/ctimer.h"
+#include "lib/random.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if WITH_DEPLOYMENT
+
+#if DISSEMINATION_PAGE_PACKETS > 32
+#error DISSEMINATION_PAGE_PACKETS must be at most 32
+#endif
+
+/* Message types, the first byte of every datagram */
+#define DISSEMINATION_ADV  0
+#define DISSEMINATION_REQ  1
+#define DISSEMINATION_DATA 2
+
+/* Advertisement: type, version (2 bytes), pages (2 bytes), complete
+ * pages (2 bytes), image size (4 bytes) */
+#define ADV_LEN 11
+/* Request: type, version (2 bytes), page (2 bytes), bitmap of the
+ * packets missing (4 bytes) */
+#define REQ_LEN 9
+/* Data: type, version (2 bytes), page (2 bytes), packet, payload */
+#define DATA_HEADER_LEN 6
+
+#define PAGE_SIZE ((uint32_t)DISSEMINATION_PAGE_PACKETS * DISSEMINATION_PACKET_SIZE)
+#define FILE_NAME_LEN 16
+
+/* A child's request, kept until DISSEMINATION_BULK_LINGER after the
+ * last packet it asked for is sent */
+struct dis_request {
+  uip_ipaddr_t addr;
+  uint16_t id;
+  uint16_t page;
+  uint32_t missing;
+  clock_time_t last;
+};
+
+/* Meta file: version, pages and size of the last complete image */
+struct dis_meta {
+  uint16_t version;
+  uint16_t pages;
+  uint32_t size;
+};
+
+static struct simple_udp_connection dis_connection;
+
+/* The image we have: pages 0 to complete - 1 are complete */
+static uint16_t version;
+static uint16_t pages;
+static uint16_t complete;
+static uint32_t size;
+static char image_file[FILE_NAME_LEN];
+static int image_fd = -1;
+
+/* Reception of page complete: the parent we request from (0 if none)
+ * and the packets we miss */
+static uint16_t rx_parent;
+static uint32_t rx_missing;
+static uint8_t retries;
+static struct ctimer request_timer;
+
+/* Requests of our children */
+static struct dis_request requests[DISSEMINATION_MAX_REQUESTS];
+static uint8_t requests_count;
+static struct ctimer send_timer;
+
+static clock_time_t adv_interval;
+static struct ctimer adv_timer;
+
+PROCESS(dissemination_process, "Dissemination");
+
+static void send_next(void *ptr);
+
+/*---------------------------------------------------------------------------*/
+static void
+put16(uint8_t *p, uint16_t v)
+{
+  p[0] = v >> 8;
+  p[1] = v & 0xff;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+get16(const uint8_t *p)
+{
+  return (p[0] << 8) | p[1];
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+get32(const uint8_t *p)
+{
+  return ((uint32_t)get16(p) << 16) | get16(p + 2);
+}
+/*---------------------------------------------------------------------------*/
+/* Bitmap of the packets of a page */
+static uint32_t
+page_mask(uint16_t page)
+{
+  uint32_t left = size - page * PAGE_SIZE;
+  uint8_t count = DISSEMINATION_PAGE_PACKETS;
+  if(left < PAGE_SIZE) {
+    count = (left + DISSEMINATION_PACKET_SIZE - 1) / DISSEMINATION_PACKET_SIZE;
+  }
+  return count == 32 ? 0xffffffff : ((uint32_t)1 << count) - 1;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+packet_len(uint16_t page, uint8_t packet)
+{
+  uint32_t offset = page * PAGE_SIZE + packet * DISSEMINATION_PACKET_SIZE;
+  return size - offset < DISSEMINATION_PACKET_SIZE ? size - offset : DISSEMINATION_PACKET_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+bulk_start(uint16_t id, int tx)
+{
+#ifdef DISSEMINATION_CALLBACK_BULK_START
+  linkaddr_t addr;
+  set_linkaddr_from_id(&addr, id);
+  DISSEMINATION_CALLBACK_BULK_START(&addr, tx);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+static void
+bulk_stop(uint16_t id)
+{
+#ifdef DISSEMINATION_CALLBACK_BULK_STOP
+  linkaddr_t addr;
+  set_linkaddr_from_id(&addr, id);
+  DISSEMINATION_CALLBACK_BULK_STOP(&addr);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+/* Our preferred parent, NULL if none */
+static rpl_parent_t *
+preferred_parent(void)
+{
+  rpl_dag_t *dag = rpl_get_any_dag();
+  return dag != NULL ? dag->preferred_parent : NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_adv(void *ptr)
+{
+  uint8_t buf[ADV_LEN];
+  uip_ipaddr_t addr;
+
+  buf[0] = DISSEMINATION_ADV;
+  put16(buf + 1, version);
+  put16(buf + 3, pages);
+  put16(buf + 5, complete);
+  put16(buf + 7, size >> 16);
+  put16(buf + 9, size & 0xffff);
+  uip_create_linklocal_allnodes_mcast(&addr);
+  simple_udp_sendto(&dis_connection, buf, sizeof(buf), &addr);
+
+  if(adv_interval < DISSEMINATION_ADV_MAX / 2) {
+    adv_interval *= 2;
+  } else {
+    adv_interval = DISSEMINATION_ADV_MAX;
+  }
+  ctimer_set(&adv_timer, adv_interval / 2 + random_rand() % (adv_interval / 2),
+             send_adv, NULL);
+}
+/*---------------------------------------------------------------------------*/
+/* Advertise soon, after a change or on hearing an other version */
+static void
+adv_reset(void)
+{
+  if(adv_interval > DISSEMINATION_ADV_MIN) {
+    adv_interval = DISSEMINATION_ADV_MIN;
+    ctimer_set(&adv_timer, adv_interval / 2 + random_rand() % (adv_interval / 2),
+               send_adv, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+serve(void)
+{
+  if(requests_count > 0 && ctimer_expired(&send_timer)) {
+    ctimer_set(&send_timer, DISSEMINATION_PACKET_INTERVAL, send_next, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+clear_requests(void)
+{
+  while(requests_count > 0) {
+    bulk_stop(requests[--requests_count].id);
+  }
+  ctimer_stop(&send_timer);
+}
+/*---------------------------------------------------------------------------*/
+static void
+stop_reception(void)
+{
+  ctimer_stop(&request_timer);
+  if(rx_parent != 0) {
+    bulk_stop(rx_parent);
+    rx_parent = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+request_timeout(void *ptr)
+{
+  rpl_parent_t *parent = preferred_parent();
+  uint8_t buf[REQ_LEN];
+
+  if(complete >= pages || parent == NULL) {
+    stop_reception();
+    return;
+  }
+  if(rx_parent != node_id_from_ipaddr(rpl_get_parent_ipaddr(parent))) {
+    /* Switch to our new parent */
+    stop_reception();
+    rx_parent = node_id_from_ipaddr(rpl_get_parent_ipaddr(parent));
+    bulk_start(rx_parent, 0);
+    retries = 0;
+  } else if(++retries > DISSEMINATION_MAX_RETRIES) {
+    /* Wait for the next advertisement */
+    LOG("Dissemination:! no data from %u\n", rx_parent);
+    stop_reception();
+    return;
+  }
+
+  buf[0] = DISSEMINATION_REQ;
+  put16(buf + 1, version);
+  put16(buf + 3, complete);
+  put16(buf + 5, rx_missing >> 16);
+  put16(buf + 7, rx_missing & 0xffff);
+  simple_udp_sendto(&dis_connection, buf, sizeof(buf), rpl_get_parent_ipaddr(parent));
+  ctimer_set(&request_timer, DISSEMINATION_REQUEST_TIMEOUT, request_timeout, NULL);
+}
+/*---------------------------------------------------------------------------*/
+/* Requests the next page from our parent now */
+static void
+send_request(void)
+{
+  retries = 0;
+  request_timeout(NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+save_meta(void)
+{
+  struct dis_meta meta;
+  int fd;
+
+  meta.version = version;
+  meta.pages = pages;
+  meta.size = size;
+  cfs_remove(DISSEMINATION_META_FILE);
+  fd = cfs_open(DISSEMINATION_META_FILE, CFS_WRITE);
+  if(fd >= 0) {
+    cfs_write(fd, &meta, sizeof(meta));
+    cfs_close(fd);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+page_complete(void)
+{
+  complete++;
+  adv_reset();
+  serve();
+  if(complete < pages) {
+    rx_missing = page_mask(complete);
+    send_request();
+  } else {
+    stop_reception();
+    save_meta();
+    LOG("Dissemination: version %u complete, %lu bytes\n",
+        version, (unsigned long)size);
+#ifdef DISSEMINATION_CALLBACK_COMPLETE
+    DISSEMINATION_CALLBACK_COMPLETE(image_file, version);
+#endif
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Drops our image for a new version, of which we have nothing yet */
+static void
+new_image(uint16_t new_version, uint16_t new_pages, uint32_t new_size)
+{
+  stop_reception();
+  clear_requests();
+  if(image_fd >= 0) {
+    cfs_close(image_fd);
+  }
+  strcpy(image_file, DISSEMINATION_FILE);
+  cfs_remove(image_file);
+  image_fd = cfs_open(image_file, CFS_READ | CFS_WRITE);
+
+  version = new_version;
+  pages = new_pages;
+  size = new_size;
+  complete = 0;
+  rx_missing = page_mask(0);
+  LOG("Dissemination: fetching version %u, %u pages\n", version, pages);
+  adv_reset();
+}
+/*---------------------------------------------------------------------------*/
+static void
+adv_input(uint16_t src, const uip_ipaddr_t *sender_addr, const uint8_t *data)
+{
+  rpl_parent_t *parent = preferred_parent();
+  uint16_t adv_version = get16(data + 1);
+  uint16_t adv_pages = get16(data + 3);
+  uint16_t adv_complete = get16(data + 5);
+  uint32_t adv_size = get32(data + 7);
+
+  if(adv_version != version) {
+    adv_reset();
+  }
+  if(parent == NULL || !uip_ipaddr_cmp(sender_addr, rpl_get_parent_ipaddr(parent))) {
+    return;
+  }
+  if((int16_t)(adv_version - version) > 0 && adv_pages > 0
+     && adv_size <= (uint32_t)adv_pages * PAGE_SIZE
+     && adv_size > (uint32_t)(adv_pages - 1) * PAGE_SIZE) {
+    new_image(adv_version, adv_pages, adv_size);
+  }
+  /* A parent still fetching keeps our request until it has the page */
+  if(adv_version == version && (adv_complete > complete || adv_complete < pages)
+     && complete < pages && (rx_parent != src || ctimer_expired(&request_timer))) {
+    send_request();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+req_input(uint16_t src, const uip_ipaddr_t *sender_addr, const uint8_t *data)
+{
+  struct dis_request *r;
+  uint16_t page = get16(data + 3);
+  int i;
+
+  if(get16(data + 1) != version || page >= pages || src == 0) {
+    return;
+  }
+  for(i = 0; i < requests_count; i++) {
+    if(requests[i].id == src) {
+      break;
+    }
+  }
+  r = &requests[i];
+  if(i == requests_count) {
+    if(requests_count == DISSEMINATION_MAX_REQUESTS) {
+      return;
+    }
+    requests_count++;
+    r->id = src;
+    bulk_start(src, 1);
+  }
+  uip_ipaddr_copy(&r->addr, sender_addr);
+  r->page = page;
+  r->missing = get32(data + 5) & page_mask(page);
+  r->last = clock_time();
+  serve();
+}
+/*---------------------------------------------------------------------------*/
+static void
+data_input(uint16_t src, const uint8_t *data, uint16_t datalen)
+{
+  uint16_t page = get16(data + 3);
+  uint8_t packet = data[5];
+  uint16_t len;
+
+  if(get16(data + 1) != version || page != complete || src != rx_parent
+     || packet >= DISSEMINATION_PAGE_PACKETS || image_fd < 0) {
+    return;
+  }
+  len = packet_len(page, packet);
+  if(!(rx_missing & ((uint32_t)1 << packet)) || datalen != DATA_HEADER_LEN + len) {
+    return;
+  }
+  if(cfs_seek(image_fd, page * PAGE_SIZE + packet * DISSEMINATION_PACKET_SIZE,
+              CFS_SEEK_SET) < 0
+     || cfs_write(image_fd, data + DATA_HEADER_LEN, len) != len) {
+    LOG("Dissemination:! write failed\n");
+    return;
+  }
+  rx_missing &= ~((uint32_t)1 << packet);
+  retries = 0;
+  ctimer_set(&request_timer, DISSEMINATION_REQUEST_TIMEOUT, request_timeout, NULL);
+  if(rx_missing == 0) {
+    page_complete();
+  } else if((rx_missing >> packet) == 0) {
+    /* Packets are sent in order: the ones we miss were lost */
+    send_request();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_data(struct dis_request *r, uint8_t packet)
+{
+  static uint8_t buf[DATA_HEADER_LEN + DISSEMINATION_PACKET_SIZE];
+  uint16_t len = packet_len(r->page, packet);
+
+  buf[0] = DISSEMINATION_DATA;
+  put16(buf + 1, version);
+  put16(buf + 3, r->page);
+  buf[5] = packet;
+  if(cfs_seek(image_fd, r->page * PAGE_SIZE + packet * DISSEMINATION_PACKET_SIZE,
+              CFS_SEEK_SET) < 0
+     || cfs_read(image_fd, buf + DATA_HEADER_LEN, len) != len) {
+    LOG("Dissemination:! read failed\n");
+    return;
+  }
+  simple_udp_sendto(&dis_connection, buf, DATA_HEADER_LEN + len, &r->addr);
+}
+/*---------------------------------------------------------------------------*/
+/* Sends one packet to every child, as each has cells of its own, and
+ * drops the requests served DISSEMINATION_BULK_LINGER ago */
+static void
+send_next(void *ptr)
+{
+  clock_time_t now = clock_time();
+  int sent = 0;
+  int i;
+
+  for(i = 0; i < requests_count; i++) {
+    struct dis_request *r = &requests[i];
+    if(r->missing != 0 && r->page < complete) {
+      uint8_t packet = 0;
+      while(!(r->missing & ((uint32_t)1 << packet))) {
+        packet++;
+      }
+      r->missing &= ~((uint32_t)1 << packet);
+      r->last = now;
+      send_data(r, packet);
+      sent = 1;
+    }
+  }
+
+  for(i = 0; i < requests_count; i++) {
+    if(now - requests[i].last > DISSEMINATION_BULK_LINGER) {
+      bulk_stop(requests[i].id);
+      /* Replace with the last request */
+      requests[i--] = requests[--requests_count];
+    }
+  }
+
+  if(requests_count > 0) {
+    ctimer_set(&send_timer, sent ? DISSEMINATION_PACKET_INTERVAL : CLOCK_SECOND,
+               send_next, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+receiver(struct simple_udp_connection *c,
+         const uip_ipaddr_t *sender_addr,
+         uint16_t sender_port,
+         const uip_ipaddr_t *receiver_addr,
+         uint16_t receiver_port,
+         const uint8_t *data,
+         uint16_t datalen)
+{
+  uint16_t src = node_id_from_ipaddr(sender_addr);
+
+  if(datalen < 1) {
+    return;
+  }
+  switch(data[0]) {
+    case DISSEMINATION_ADV:
+      if(datalen == ADV_LEN) {
+        adv_input(src, sender_addr, data);
+      }
+      break;
+    case DISSEMINATION_REQ:
+      if(datalen == REQ_LEN) {
+        req_input(src, sender_addr, data);
+      }
+      break;
+    case DISSEMINATION_DATA:
+      if(datalen > DATA_HEADER_LEN) {
+        data_input(src, data, datalen);
+      }
+      break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+dissemination_start(const char *file, uint16_t new_version)
+{
+  cfs_offset_t file_size;
+  int fd;
+
+  if(strlen(file) >= FILE_NAME_LEN || (int16_t)(new_version - version) <= 0) {
+    return 0;
+  }
+  fd = cfs_open(file, CFS_READ);
+  if(fd < 0) {
+    return 0;
+  }
+  file_size = cfs_seek(fd, 0, CFS_SEEK_END);
+  if(file_size <= 0 || (file_size + PAGE_SIZE - 1) / PAGE_SIZE > 0xffff) {
+    cfs_close(fd);
+    return 0;
+  }
+
+  stop_reception();
+  clear_requests();
+  if(image_fd >= 0) {
+    cfs_close(image_fd);
+  }
+  image_fd = fd;
+  strcpy(image_file, file);
+  version = new_version;
+  size = file_size;
+  pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+  complete = pages;
+  LOG("Dissemination: starting version %u, %u pages\n", version, pages);
+  adv_reset();
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+dissemination_print(void)
+{
+  LOG("Dissemination: version %u, %u/%u pages, parent %u, %u children\n",
+      version, complete, pages, rx_parent, requests_count);
+}
+/*---------------------------------------------------------------------------*/
+static void
+command(char *line)
+{
+  char *p;
+
+  if(!strcmp(line, "dis show")) {
+    dissemination_print();
+  } else if(!strncmp(line, "dis start ", 10)) {
+    p = strchr(line + 10, ' ');
+    if(p == NULL) {
+      LOG("Dissemination:! bad command\n");
+      return;
+    }
+    *p++ = '\0';
+    if(!dissemination_start(line + 10, strtoul(p, NULL, 10))) {
+      LOG("Dissemination:! cannot start %s\n", line + 10);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(dissemination_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == serial_line_event_message && data != NULL);
+    command((char *)data);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+dissemination_init(void)
+{
+  struct dis_meta meta;
+  int fd;
+
+  /* Resume with the last complete image */
+  fd = cfs_open(DISSEMINATION_META_FILE, CFS_READ);
+  if(fd >= 0) {
+    if(cfs_read(fd, &meta, sizeof(meta)) == sizeof(meta)) {
+      strcpy(image_file, DISSEMINATION_FILE);
+      image_fd = cfs_open(image_file, CFS_READ | CFS_WRITE);
+      if(image_fd >= 0) {
+        version = meta.version;
+        pages = complete = meta.pages;
+        size = meta.size;
+      }
+    }
+    cfs_close(fd);
+  }
+
+  simple_udp_register(&dis_connection, DISSEMINATION_PORT,
+                      NULL, DISSEMINATION_PORT, receiver);
+  process_start(&dissemination_process, NULL);
+  adv_interval = 2 * DISSEMINATION_ADV_MIN;
+  adv_reset();
+}
+
+#endif /* WITH_DEPLOYMENT */
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Dissemination of a file, e.g. a firmware image, down the DODAG,
+ *         after Deluge. The image is split in pages of
+ *         DISSEMINATION_PAGE_PACKETS packets. Every node advertises the
+ *         version it has and how many of its pages are complete, in
+ *         broadcast, at an interval that doubles from DISSEMINATION_ADV_MIN
+ *         to DISSEMINATION_ADV_MAX and is reset on every change. A node
+ *         whose preferred parent has a newer version, or more pages,
+ *         requests its next page from the parent, with the bitmap of the
+ *         packets it misses, and the parent unicasts them. Pages are
+ *         requested in order, as soon as the previous one is complete: a
+ *         parent still receiving a page keeps the request and serves it
+ *         when the page is in, so that consecutive pages travel down the
+ *         tree at once, one hop apart.
+ *
+ *         While a transfer lasts, the scheduler is asked for dedicated
+ *         cells to the child (DISSEMINATION_CALLBACK_BULK_START), which are
+ *         released DISSEMINATION_BULK_LINGER after the last request. With
+ *         Orchestra, set in project-conf.h:
+ *         #define DISSEMINATION_CALLBACK_BULK_START orchestra_bulk_start
+ *         #define DISSEMINATION_CALLBACK_BULK_STOP orchestra_bulk_stop
+ *         and add &bulk to the rules, see orchestra-conf.h.
+ *
+ *         Nodes store the image in DISSEMINATION_FILE, and its version in
+ *         DISSEMINATION_META_FILE once complete, so that it is not fetched
+ *         again after a reboot. The root starts a dissemination from code,
+ *         or from the serial line:
+ *         dis start <file> <version>
+ *         dis show
+ *
+ *         Started from deployment_init with WITH_DISSEMINATION. Needs RPL.
+ */
+
+#ifndef DISSEMINATION_H
+#define DISSEMINATION_H
+
+#include "contiki-conf.h"
+#include "net/linkaddr.h"
+
+/* UDP port of advertisements, requests and data */
+#ifdef DISSEMINATION_CONF_PORT
+#define DISSEMINATION_PORT DISSEMINATION_CONF_PORT
+#else
+#define DISSEMINATION_PORT 0xf0b3
+#endif
+
+#ifdef DISSEMINATION_CONF_FILE
+#define DISSEMINATION_FILE DISSEMINATION_CONF_FILE
+#else
+#define DISSEMINATION_FILE "dis.img"
+#endif
+
+#ifdef DISSEMINATION_CONF_META_FILE
+#define DISSEMINATION_META_FILE DISSEMINATION_CONF_META_FILE
+#else
+#define DISSEMINATION_META_FILE "dis.meta"
+#endif
+
+/* Payload bytes per data packet, to fit in a single frame */
+#ifdef DISSEMINATION_CONF_PACKET_SIZE
+#define DISSEMINATION_PACKET_SIZE DISSEMINATION_CONF_PACKET_SIZE
+#else
+#define DISSEMINATION_PACKET_SIZE 64
+#endif
+
+/* Packets per page, at most 32 */
+#ifdef DISSEMINATION_CONF_PAGE_PACKETS
+#define DISSEMINATION_PAGE_PACKETS DISSEMINATION_CONF_PAGE_PACKETS
+#else
+#define DISSEMINATION_PAGE_PACKETS 16
+#endif
+
+#ifdef DISSEMINATION_CONF_ADV_MIN
+#define DISSEMINATION_ADV_MIN DISSEMINATION_CONF_ADV_MIN
+#else
+#define DISSEMINATION_ADV_MIN (2 * CLOCK_SECOND)
+#endif
+
+#ifdef DISSEMINATION_CONF_ADV_MAX
+#define DISSEMINATION_ADV_MAX DISSEMINATION_CONF_ADV_MAX
+#else
+#define DISSEMINATION_ADV_MAX (10 * 60 * CLOCK_SECOND)
+#endif
+
+/* Delay between two data packets sent. Match it with the rate of the
+ * bulk cells, not to overflow the TSCH queue */
+#ifdef DISSEMINATION_CONF_PACKET_INTERVAL
+#define DISSEMINATION_PACKET_INTERVAL DISSEMINATION_CONF_PACKET_INTERVAL
+#else
+#define DISSEMINATION_PACKET_INTERVAL (CLOCK_SECOND / 16)
+#endif
+
+/* A request is sent again after this long without data, up to
+ * DISSEMINATION_MAX_RETRIES times before waiting for the next
+ * advertisement */
+#ifdef DISSEMINATION_CONF_REQUEST_TIMEOUT
+#define DISSEMINATION_REQUEST_TIMEOUT DISSEMINATION_CONF_REQUEST_TIMEOUT
+#else
+#define DISSEMINATION_REQUEST_TIMEOUT (2 * CLOCK_SECOND)
+#endif
+
+#ifdef DISSEMINATION_CONF_MAX_RETRIES
+#define DISSEMINATION_MAX_RETRIES DISSEMINATION_CONF_MAX_RETRIES
+#else
+#define DISSEMINATION_MAX_RETRIES 8
+#endif
+
+/* Bulk cells to a child are kept this long after its last request */
+#ifdef DISSEMINATION_CONF_BULK_LINGER
+#define DISSEMINATION_BULK_LINGER DISSEMINATION_CONF_BULK_LINGER
+#else
+#define DISSEMINATION_BULK_LINGER (10 * CLOCK_SECOND)
+#endif
+
+/* Children served at once */
+#ifdef DISSEMINATION_CONF_MAX_REQUESTS
+#define DISSEMINATION_MAX_REQUESTS DISSEMINATION_CONF_MAX_REQUESTS
+#else
+#define DISSEMINATION_MAX_REQUESTS 4
+#endif
+
+/* Asks the scheduler for cells to (tx) or from a neighbor, and releases
+ * them. Return values are ignored */
+#ifdef DISSEMINATION_CALLBACK_BULK_START
+int DISSEMINATION_CALLBACK_BULK_START(const linkaddr_t *addr, int tx);
+#endif
+#ifdef DISSEMINATION_CALLBACK_BULK_STOP
+void DISSEMINATION_CALLBACK_BULK_STOP(const linkaddr_t *addr);
+#endif
+
+/* Called when a new version is complete, e.g. to install it */
+#ifdef DISSEMINATION_CALLBACK_COMPLETE
+void DISSEMINATION_CALLBACK_COMPLETE(const char *file, uint16_t version);
+#endif
+
+/* Starts the service */
+void dissemination_init(void);
+/* Disseminates file as the given version, newer than the current one.
+ * Returns 1 if started, 0 otherwise */
+int dissemination_start(const char *file, uint16_t version);
+/* Prints the version we have and its progress */
+void dissemination_print(void);
+
+#endif /* DISSEMINATION_H */
@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Network health telemetry, see health-report.h
+ */
+
+#include "contiki-conf.h"
+#include "deployment.h"
+#include "health-report.h"
+#include "simple-udp.h"
+#include "net/ipv6/uip-ds6.h"
+#include "net/mac/tsch/tsch.h"
+#include "net/mac/tsch/tsch-queue.h"
+#include "net/mac/tsch/tsch-adaptive-timesync.h"
+#include "net/rpl/rpl.h"
+#include "net/rpl/rpl-private.h"
+#include "lib/random.h"
+#include <stdio.h>
+#include <string.h>
+
+#if WITH_DEPLOYMENT
+
+#ifndef WITH_TSCH
+#define WITH_TSCH 1
+#endif
+
+/* Message: type, seqno, duty cycle, drops, deadline misses, drift,
+ * parent, rank, ETX (2 bytes each), load */
+#define HEALTH_REPORT_MSG 0
+#define REPORT_LEN 17
+
+static struct simple_udp_connection health_connection;
+static uint16_t health_root_id;
+static uint8_t seqno;
+
+/* Cumulative counters at the last report */
+static uint32_t last_radio, last_time;
+static uint32_t last_drops, last_dl_misses;
+
+PROCESS(health_report_process, "Health report");
+
+/*---------------------------------------------------------------------------*/
+static void
+health_report_log(uint16_t node, const struct health_report *r)
+{
+  LOG("Health: %u seq %u dc %u drop %u dlmiss %u drift %d parent %u rank %u etx %u load %u\n",
+      node, r->seqno, r->duty_cycle, r->drops, r->dl_misses, r->drift,
+      r->parent, r->rank, r->etx, r->load);
+#ifdef HEALTH_REPORT_CALLBACK
+  HEALTH_REPORT_CALLBACK(node, r);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+/* Packets dropped by all TSCH queues since boot. Statistics go with the
+ * neighbors that are freed, the total can decrease */
+static uint32_t
+queue_drops(void)
+{
+  uint32_t drops = 0;
+#if WITH_TSCH && TSCH_QUEUE_WITH_STATS
+  struct tsch_neighbor *n;
+  for(n = tsch_queue_first_nbr(); n != NULL; n = tsch_queue_next_nbr(n)) {
+    drops += n->stats.drop_full + n->stats.drop_retries + n->stats.drop_aqm;
+  }
+#endif /* WITH_TSCH && TSCH_QUEUE_WITH_STATS */
+  return drops;
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+dl_misses(void)
+{
+#if WITH_TSCH && TSCH_WITH_DL_MISS_STATS
+  return tsch_dl_miss_get_stats()->total;
+#else
+  return 0;
+#endif /* WITH_TSCH && TSCH_WITH_DL_MISS_STATS */
+}
+/*---------------------------------------------------------------------------*/
+/* Fill in a report. With update, start a new period */
+static void
+health_report_get(struct health_report *r, int update)
+{
+  rpl_dag_t *dag = rpl_get_any_dag();
+  uint32_t radio, time;
+  uint32_t drops = queue_drops();
+  uint32_t misses = dl_misses();
+
+  energest_flush();
+  radio = energest_type_time(ENERGEST_TYPE_TRANSMIT) + energest_type_time(ENERGEST_TYPE_LISTEN);
+  time = energest_type_time(ENERGEST_TYPE_CPU) + energest_type_time(ENERGEST_TYPE_LPM);
+
+  memset(r, 0, sizeof(*r));
+  r->seqno = seqno;
+  if(time != last_time) {
+    r->duty_cycle = (uint64_t)(radio - last_radio) * 1000 / (time - last_time);
+  }
+  r->drops = drops >= last_drops ? drops - last_drops : drops;
+  r->dl_misses = misses - last_dl_misses;
+#if WITH_TSCH && TSCH_ADAPTIVE_TIMESYNC
+  r->drift = tsch_timesync_get_drift_ppm();
+#endif /* WITH_TSCH && TSCH_ADAPTIVE_TIMESYNC */
+  if(dag != NULL) {
+    r->rank = dag->rank;
+    if(dag->preferred_parent != NULL) {
+      r->parent = node_id_from_ipaddr(rpl_get_parent_ipaddr(dag->preferred_parent));
+      r->etx = (uint32_t)dag->preferred_parent->link_metric * 100 / RPL_DAG_MC_ETX_DIVISOR;
+    }
+  }
+#if WITH_TSCH
+  r->load = tsch_queue_get_load();
+#endif /* WITH_TSCH */
+
+  if(update) {
+    seqno++;
+    last_radio = radio;
+    last_time = time;
+    last_drops = drops;
+    last_dl_misses = misses;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+put16(uint8_t *p, uint16_t v)
+{
+  p[0] = v >> 8;
+  p[1] = v & 0xff;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+get16(const uint8_t *p)
+{
+  return (p[0] << 8) | p[1];
+}
+/*---------------------------------------------------------------------------*/
+static void
+receiver(struct simple_udp_connection *c,
+         const uip_ipaddr_t *sender_addr,
+         uint16_t sender_port,
+         const uip_ipaddr_t *receiver_addr,
+         uint16_t receiver_port,
+         const uint8_t *data,
+         uint16_t datalen)
+{
+  struct health_report r;
+
+  if(node_id != health_root_id || datalen != REPORT_LEN
+     || data[0] != HEALTH_REPORT_MSG) {
+    return;
+  }
+  r.seqno = data[1];
+  r.duty_cycle = get16(data + 2);
+  r.drops = get16(data + 4);
+  r.dl_misses = get16(data + 6);
+  r.drift = (int16_t)get16(data + 8);
+  r.parent = get16(data + 10);
+  r.rank = get16(data + 12);
+  r.etx = get16(data + 14);
+  r.load = data[16];
+  health_report_log(node_id_from_ipaddr(sender_addr), &r);
+}
+/*---------------------------------------------------------------------------*/
+/* Send our report, or log it at the root. Returns 0 if postponed */
+static int
+send_report(void)
+{
+  static uint8_t buf[REPORT_LEN];
+  struct health_report r;
+  uip_ipaddr_t root_addr;
+
+  if(node_id == health_root_id) {
+    health_report_get(&r, 1);
+    health_report_log(node_id, &r);
+    return 1;
+  }
+  if(uip_ds6_defrt_choose() == NULL) {
+    return 0;
+  }
+  health_report_get(&r, 0);
+  if(r.load >= HEALTH_REPORT_MAX_LOAD) {
+    return 0;
+  }
+  health_report_get(&r, 1);
+  buf[0] = HEALTH_REPORT_MSG;
+  buf[1] = r.seqno;
+  put16(buf + 2, r.duty_cycle);
+  put16(buf + 4, r.drops);
+  put16(buf + 6, r.dl_misses);
+  put16(buf + 8, r.drift);
+  put16(buf + 10, r.parent);
+  put16(buf + 12, r.rank);
+  put16(buf + 14, r.etx);
+  buf[16] = r.load;
+  set_ipaddr_from_id(&root_addr, health_root_id);
+  simple_udp_sendto(&health_connection, buf, sizeof(buf), &root_addr);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+health_report_print(void)
+{
+  struct health_report r;
+  health_report_get(&r, 0);
+  health_report_log(node_id, &r);
+}
+/*---------------------------------------------------------------------------*/
+/* A random time within a period */
+static clock_time_t
+random_offset(void)
+{
+  return (uint64_t)random_rand() * (HEALTH_REPORT_PERIOD - 1) / RANDOM_RAND_MAX;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(health_report_process, ev, data)
+{
+  static struct etimer period_timer;
+  static struct etimer send_timer;
+
+  PROCESS_BEGIN();
+
+  etimer_set(&period_timer, HEALTH_REPORT_PERIOD);
+  etimer_set(&send_timer, random_offset());
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER);
+    if(data == &period_timer) {
+      etimer_reset(&period_timer);
+      /* At a random time of the period, to spread reports of all nodes */
+      etimer_set(&send_timer, random_offset());
+    } else if(data == &send_timer) {
+      if(!send_report()) {
+        LOG("Health:! report postponed\n");
+      }
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+health_report_init(uint16_t root_id)
+{
+  health_root_id = root_id;
+  simple_udp_register(&health_connection, HEALTH_REPORT_PORT,
+                      NULL, HEALTH_REPORT_PORT, receiver);
+  process_start(&health_report_process, NULL);
+}
+
+#endif /* WITH_DEPLOYMENT */
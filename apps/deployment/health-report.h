@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Network health telemetry. Every node periodically sends a
+ *         compact report of its TSCH and RPL state to the root: duty
+ *         cycle, TSCH queue drops, deadline misses and clock drift,
+ *         preferred parent, rank and ETX to the parent. Counters are
+ *         deltas since the previous report. The reports are rate-limited:
+ *         one per period, postponed to the next period while our own TSCH
+ *         queues are loaded, so that telemetry does not compete with data.
+ *         The root logs them, and its own, as
+ *         "Health: <node> seq <n> dc <permil> drop <n> dlmiss <n> drift <ppm> parent <node> rank <r> etx <x100> load <%>"
+ *         lines, which tunslip6 passes to its standard output, for fleet
+ *         monitoring by host tools.
+ *
+ *         Started from deployment_init with WITH_HEALTH_REPORT. Needs RPL.
+ *         Deadline misses need TSCH_CONF_WITH_DL_MISS_STATS, queue drops
+ *         TSCH_QUEUE_CONF_WITH_STATS and drift TSCH_CONF_ADAPTIVE_TIMESYNC;
+ *         they are reported as 0 otherwise.
+ */
+
+#ifndef HEALTH_REPORT_H
+#define HEALTH_REPORT_H
+
+#include "contiki-conf.h"
+
+/* UDP port of the reports */
+#ifdef HEALTH_REPORT_CONF_PORT
+#define HEALTH_REPORT_PORT HEALTH_REPORT_CONF_PORT
+#else
+#define HEALTH_REPORT_PORT 0xf0b4
+#endif
+
+/* Reports are sent once per period, at a random time within it */
+#ifdef HEALTH_REPORT_CONF_PERIOD
+#define HEALTH_REPORT_PERIOD HEALTH_REPORT_CONF_PERIOD
+#else
+#define HEALTH_REPORT_PERIOD (5 * 60 * CLOCK_SECOND)
+#endif
+
+/* A report is postponed to the next period when the TSCH queue load
+ * (tsch_queue_get_load, in %) is at least this. 100: never postponed */
+#ifdef HEALTH_REPORT_CONF_MAX_LOAD
+#define HEALTH_REPORT_MAX_LOAD HEALTH_REPORT_CONF_MAX_LOAD
+#else
+#define HEALTH_REPORT_MAX_LOAD 50
+#endif
+
+/* A node's report */
+struct health_report {
+  uint8_t seqno;
+  /* Radio duty cycle over the period, in 1/1000th */
+  uint16_t duty_cycle;
+  /* Packets dropped by the TSCH queues, all causes */
+  uint16_t drops;
+  /* Missed TSCH deadlines */
+  uint16_t dl_misses;
+  /* Learned clock drift, in ppm */
+  int16_t drift;
+  /* Preferred parent, 0 if none */
+  uint16_t parent;
+  uint16_t rank;
+  /* ETX of the link to the preferred parent, x100 */
+  uint16_t etx;
+  /* TSCH queue load at the time of the report, in % */
+  uint8_t load;
+};
+
+/* Called at the root for every report, including its own */
+#ifdef HEALTH_REPORT_CALLBACK
+void HEALTH_REPORT_CALLBACK(uint16_t node, const struct health_report *report);
+#endif
+
+/* Starts the service. The root is the destination of the reports */
+void health_report_init(uint16_t root_id);
+/* Prints our current state, as a report would be logged by the root */
+void health_report_print(void);
+
+#endif /* HEALTH_REPORT_H */
@@ -0,0 +1,537 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Link-quality map service, see link-map.h
+ */
+
+#include "contiki-conf.h"
+#include "deployment.h"
+#include "link-map.h"
+#include "simple-udp.h"
+#include "net/packetbuf.h"
+#include "net/ipv6/uip-ds6.h"
+#include "net/mac/tsch/tsch.h"
+#include "net/mac/tsch/tsch-schedule.h"
+#include "net/rpl/rpl.h"
+#include "dev/serial-line.h"
+#include "lib/random.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if WITH_DEPLOYMENT
+
+#ifndef WITH_TSCH
+#define WITH_TSCH 1
+#endif
+
+/* Message types, the first byte of every datagram */
+#define LINK_MAP_PROBE    0
+#define LINK_MAP_REPORT   1
+#define LINK_MAP_SCHEDULE 2
+#define LINK_MAP_ADD      3
+#define LINK_MAP_REMOVE   4
+
+/* Report: type, number of entries, preferred parent (2 bytes), entries */
+#define REPORT_HEADER_LEN 4
+/* Report entry: neighbor id (2 bytes), PDR (%), RSSI */
+#define REPORT_ENTRY_LEN 4
+/* Schedule, add and remove: type, slotframe size (2 bytes), number of
+ * links, links. The size is used by schedules only, options and
+ * neighbor by schedules and adds only */
+#define SCHEDULE_HEADER_LEN 4
+/* Schedule link: timeslot (2 bytes), channel offset, options, neighbor id (2 bytes) */
+#define SCHEDULE_LINK_LEN 6
+
+/* EWMA weight of new samples, in 1/8th */
+#define EWMA_ALPHA 1
+/* PDR unit: 1/10000 */
+#define PDR_SCALE 10000
+#define NOT_REPORTED 0xff
+
+struct link_map_entry {
+  uint16_t id;
+  uint16_t last_seqno;
+  /* PDR in 1/10000th, RSSI in 1/16th of dBm */
+  uint16_t pdr;
+  int16_t rssi;
+  /* Time we last heard a probe, and probes counted as missed since */
+  unsigned long last_heard;
+  uint8_t missed;
+  /* Values last reported to the root, NOT_REPORTED if none */
+  uint8_t reported_pdr;
+  int8_t reported_rssi;
+};
+
+static struct link_map_entry entries[LINK_MAP_MAX_NEIGHBORS];
+static uint8_t entries_count;
+static struct simple_udp_connection link_map_connection;
+static uint16_t link_map_root_id;
+static uint16_t probe_seqno;
+static uint8_t report_count;
+/* Preferred parent in our last report */
+static uint16_t reported_parent;
+
+PROCESS(link_map_process, "Link map");
+
+/*---------------------------------------------------------------------------*/
+static void
+pdr_update(struct link_map_entry *e, int received)
+{
+  e->pdr = ((uint32_t)e->pdr * (8 - EWMA_ALPHA) + (received ? PDR_SCALE : 0) * EWMA_ALPHA) / 8;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+pdr_percent(const struct link_map_entry *e)
+{
+  return (e->pdr + PDR_SCALE / 200) / (PDR_SCALE / 100);
+}
+/*---------------------------------------------------------------------------*/
+static int8_t
+rssi_dbm(const struct link_map_entry *e)
+{
+  return e->rssi / 16;
+}
+/*---------------------------------------------------------------------------*/
+static void
+link_map_log(uint16_t node, uint16_t neighbor, uint8_t pdr, int8_t rssi)
+{
+  LOG("LinkMap: %u %u pdr %u rssi %d\n", node, neighbor, pdr, rssi);
+#ifdef LINK_MAP_CALLBACK_REPORT
+  LINK_MAP_CALLBACK_REPORT(node, neighbor, pdr, rssi);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+static void
+probe_input(uint16_t src, uint16_t seqno)
+{
+  struct link_map_entry *e;
+  int16_t rssi = (int16_t)packetbuf_attr(PACKETBUF_ATTR_RSSI);
+  int i;
+
+  for(i = 0; i < entries_count; i++) {
+    if(entries[i].id == src) {
+      break;
+    }
+  }
+  e = &entries[i];
+  if(i == entries_count) {
+    if(entries_count == LINK_MAP_MAX_NEIGHBORS) {
+      return;
+    }
+    entries_count++;
+    memset(e, 0, sizeof(*e));
+    e->id = src;
+    e->pdr = PDR_SCALE;
+    e->rssi = rssi * 16;
+    e->reported_pdr = NOT_REPORTED;
+  } else {
+    /* Probes lost in between, not counted yet as missed from the silence */
+    uint16_t gap = seqno - e->last_seqno - 1;
+    if(gap < 0x100) {
+      while(gap-- > e->missed) {
+        pdr_update(e, 0);
+      }
+    }
+    pdr_update(e, 1);
+    e->rssi = (e->rssi * (8 - EWMA_ALPHA) + rssi * 16 * EWMA_ALPHA) / 8;
+  }
+  e->last_seqno = seqno;
+  e->last_heard = clock_seconds();
+  e->missed = 0;
+}
+/*---------------------------------------------------------------------------*/
+#if WITH_TSCH
+/* Add or remove links of our slotframe, all or none of them.
+ * Returns 1 if success, 0 otherwise */
+static int
+schedule_update(uint8_t type, struct tsch_slotframe *sf, const uint8_t *links, uint8_t count)
+{
+  linkaddr_t addr;
+  int ok = 1;
+
+  if(sf == NULL || !tsch_schedule_begin()) {
+    return 0;
+  }
+  for(; count > 0; count--, links += SCHEDULE_LINK_LEN) {
+    uint16_t timeslot = (links[0] << 8) | links[1];
+    uint16_t neighbor = (links[4] << 8) | links[5];
+    if(type == LINK_MAP_REMOVE) {
+      struct tsch_link *l = tsch_schedule_get_link_from_timeslot_and_offset(sf, timeslot, links[2]);
+      ok &= l != NULL && tsch_schedule_remove_link(sf, l);
+    } else {
+      if(neighbor == 0) {
+        linkaddr_copy(&addr, &tsch_broadcast_address);
+      } else {
+        set_linkaddr_from_id(&addr, neighbor);
+      }
+      ok &= tsch_schedule_add_link(sf, links[3], LINK_TYPE_NORMAL, &addr,
+                                   timeslot, links[2]) != NULL;
+    }
+  }
+  if(ok && tsch_schedule_commit()) {
+    return 1;
+  }
+  tsch_schedule_abort();
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Install a schedule in our slotframe, replacing the previous one */
+static void
+schedule_replace(uint16_t sf_size, const uint8_t *links, uint8_t count)
+{
+  struct tsch_slotframe *sf = tsch_schedule_get_slotframe_from_handle(LINK_MAP_SLOTFRAME_HANDLE);
+
+  if(sf != NULL) {
+    tsch_schedule_remove_slotframe(sf);
+  }
+  if(sf_size == 0) {
+    LOG("LinkMap: schedule removed\n");
+    return;
+  }
+  if((sf = tsch_schedule_add_slotframe(LINK_MAP_SLOTFRAME_HANDLE, sf_size)) == NULL) {
+    LOG("LinkMap:! failed to install schedule\n");
+    return;
+  }
+  if(!schedule_update(LINK_MAP_ADD, sf, links, count)) {
+    tsch_schedule_remove_slotframe(sf);
+    LOG("LinkMap:! failed to install schedule\n");
+    return;
+  }
+  LOG("LinkMap: schedule installed, slotframe %u, %u links\n", sf_size, count);
+}
+/*---------------------------------------------------------------------------*/
+static void
+schedule_input(uint8_t type, uint16_t sf_size, const uint8_t *links, uint8_t count)
+{
+  if(type == LINK_MAP_SCHEDULE) {
+    schedule_replace(sf_size, links, count);
+  } else if(schedule_update(type,
+                            tsch_schedule_get_slotframe_from_handle(LINK_MAP_SLOTFRAME_HANDLE),
+                            links, count)) {
+    LOG("LinkMap: %s %u links\n", type == LINK_MAP_ADD ? "added" : "removed", count);
+  } else {
+    LOG("LinkMap:! failed to %s links\n", type == LINK_MAP_ADD ? "add" : "remove");
+  }
+}
+#endif /* WITH_TSCH */
+/*---------------------------------------------------------------------------*/
+static void
+receiver(struct simple_udp_connection *c,
+         const uip_ipaddr_t *sender_addr,
+         uint16_t sender_port,
+         const uip_ipaddr_t *receiver_addr,
+         uint16_t receiver_port,
+         const uint8_t *data,
+         uint16_t datalen)
+{
+  uint16_t src = node_id_from_ipaddr(sender_addr);
+
+  if(datalen < 1) {
+    return;
+  }
+  switch(data[0]) {
+    case LINK_MAP_PROBE:
+      if(datalen == 3) {
+        probe_input(src, (data[1] << 8) | data[2]);
+      }
+      break;
+    case LINK_MAP_REPORT:
+      if(node_id == link_map_root_id && datalen >= REPORT_HEADER_LEN
+         && datalen == REPORT_HEADER_LEN + data[1] * REPORT_ENTRY_LEN) {
+        uint16_t parent = (data[2] << 8) | data[3];
+        LOG("LinkMap: %u parent %u\n", src, parent);
+#ifdef LINK_MAP_CALLBACK_PARENT
+        LINK_MAP_CALLBACK_PARENT(src, parent);
+#endif
+        for(data += REPORT_HEADER_LEN; datalen > REPORT_HEADER_LEN;
+            datalen -= REPORT_ENTRY_LEN, data += REPORT_ENTRY_LEN) {
+          link_map_log(src, (data[0] << 8) | data[1], data[2], (int8_t)data[3]);
+        }
+      }
+      break;
+    case LINK_MAP_SCHEDULE:
+    case LINK_MAP_ADD:
+    case LINK_MAP_REMOVE:
+#if WITH_TSCH
+      if(src == link_map_root_id && datalen >= SCHEDULE_HEADER_LEN
+         && datalen == SCHEDULE_HEADER_LEN + data[3] * SCHEDULE_LINK_LEN) {
+        schedule_input(data[0], (data[1] << 8) | data[2], data + SCHEDULE_HEADER_LEN, data[3]);
+      }
+#endif /* WITH_TSCH */
+      break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_probe(void)
+{
+  uint8_t buf[3];
+  uip_ipaddr_t addr;
+
+  probe_seqno++;
+  buf[0] = LINK_MAP_PROBE;
+  buf[1] = probe_seqno >> 8;
+  buf[2] = probe_seqno & 0xff;
+  uip_create_linklocal_allnodes_mcast(&addr);
+  simple_udp_sendto(&link_map_connection, buf, sizeof(buf), &addr);
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the node id of our preferred parent, 0 if none */
+static uint16_t
+preferred_parent(void)
+{
+  rpl_dag_t *dag = rpl_get_any_dag();
+  if(dag == NULL || dag->preferred_parent == NULL) {
+    return 0;
+  }
+  return node_id_from_ipaddr(rpl_get_parent_ipaddr(dag->preferred_parent));
+}
+/*---------------------------------------------------------------------------*/
+/* Count the probes missed from silent neighbors, drop the neighbors that
+ * went below LINK_MAP_MIN_PDR, and report the links that changed, along
+ * with our preferred parent */
+static void
+send_report(void)
+{
+  static uint8_t buf[REPORT_HEADER_LEN + LINK_MAP_MAX_NEIGHBORS * REPORT_ENTRY_LEN];
+  uint8_t *p = buf + REPORT_HEADER_LEN;
+  unsigned long now = clock_seconds();
+  int refresh = ++report_count % LINK_MAP_REFRESH == 0;
+  uint16_t parent = preferred_parent();
+  int i;
+
+  for(i = 0; i < entries_count; i++) {
+    struct link_map_entry *e = &entries[i];
+    unsigned long elapsed = (now - e->last_heard) / (LINK_MAP_PROBE_INTERVAL / CLOCK_SECOND);
+    /* Probes are sent at most an interval apart: after two intervals of
+     * silence, at least one was missed */
+    unsigned long missed = elapsed >= 2 ? elapsed - 1 : 0;
+    uint8_t pdr;
+    int8_t rssi;
+
+    while(e->missed < missed && e->missed < 0xff) {
+      e->missed++;
+      pdr_update(e, 0);
+    }
+    pdr = pdr_percent(e);
+    rssi = rssi_dbm(e);
+    if(pdr < LINK_MAP_MIN_PDR) {
+      pdr = 0;
+    }
+    if(refresh || e->reported_pdr == NOT_REPORTED
+       || abs(pdr - e->reported_pdr) >= LINK_MAP_PDR_DELTA
+       || abs(rssi - e->reported_rssi) >= LINK_MAP_RSSI_DELTA
+       || (pdr == 0 && e->reported_pdr != 0)) {
+      if(node_id == link_map_root_id) {
+        link_map_log(node_id, e->id, pdr, rssi);
+      } else {
+        *p++ = e->id >> 8;
+        *p++ = e->id & 0xff;
+        *p++ = pdr;
+        *p++ = rssi;
+      }
+      e->reported_pdr = pdr;
+      e->reported_rssi = rssi;
+    }
+    if(pdr == 0) {
+      /* Replace with the last entry */
+      entries[i--] = entries[--entries_count];
+    }
+  }
+
+  if((p > buf + REPORT_HEADER_LEN || parent != reported_parent || refresh)
+     && node_id != link_map_root_id && uip_ds6_defrt_choose() != NULL) {
+    uip_ipaddr_t root_addr;
+    buf[0] = LINK_MAP_REPORT;
+    buf[1] = (p - buf - REPORT_HEADER_LEN) / REPORT_ENTRY_LEN;
+    buf[2] = parent >> 8;
+    buf[3] = parent & 0xff;
+    set_ipaddr_from_id(&root_addr, link_map_root_id);
+    simple_udp_sendto(&link_map_connection, buf, p - buf, &root_addr);
+    reported_parent = parent;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+send_links(uint8_t type, uint16_t node, uint16_t sf_size,
+           const struct link_map_link *links, uint8_t count)
+{
+  static uint8_t buf[SCHEDULE_HEADER_LEN + LINK_MAP_MAX_LINKS * SCHEDULE_LINK_LEN];
+  uint8_t *p = buf + SCHEDULE_HEADER_LEN;
+  uip_ipaddr_t addr;
+  int i;
+
+  if(count > LINK_MAP_MAX_LINKS) {
+    return 0;
+  }
+  buf[0] = type;
+  buf[1] = sf_size >> 8;
+  buf[2] = sf_size & 0xff;
+  buf[3] = count;
+  for(i = 0; i < count; i++) {
+    *p++ = links[i].timeslot >> 8;
+    *p++ = links[i].timeslot & 0xff;
+    *p++ = links[i].channel_offset;
+    *p++ = links[i].link_options;
+    *p++ = links[i].neighbor >> 8;
+    *p++ = links[i].neighbor & 0xff;
+  }
+  if(node == node_id) {
+#if WITH_TSCH
+    schedule_input(type, sf_size, buf + SCHEDULE_HEADER_LEN, count);
+#endif /* WITH_TSCH */
+    return 1;
+  }
+  set_ipaddr_from_id(&addr, node);
+  simple_udp_sendto(&link_map_connection, buf, p - buf, &addr);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+link_map_push_schedule(uint16_t node, uint16_t sf_size,
+                       const struct link_map_link *links, uint8_t count)
+{
+  return send_links(LINK_MAP_SCHEDULE, node, sf_size, links, count);
+}
+/*---------------------------------------------------------------------------*/
+int
+link_map_add_links(uint16_t node, const struct link_map_link *links, uint8_t count)
+{
+  return send_links(LINK_MAP_ADD, node, 0, links, count);
+}
+/*---------------------------------------------------------------------------*/
+int
+link_map_remove_links(uint16_t node, const struct link_map_link *links, uint8_t count)
+{
+  return send_links(LINK_MAP_REMOVE, node, 0, links, count);
+}
+/*---------------------------------------------------------------------------*/
+/* lm push <node> <size> [<ts>:<choff>:<options>:<neighbor> ...]
+ * lm add <node> [<ts>:<choff>:<options>:<neighbor> ...]
+ * lm del <node> [<ts>:<choff> ...] */
+static void
+command(char *line)
+{
+  struct link_map_link links[LINK_MAP_MAX_LINKS];
+  uint16_t node, sf_size = 0;
+  uint8_t count = 0;
+  uint8_t type;
+  char *p;
+
+  if(!strcmp(line, "lm show")) {
+    link_map_print();
+    return;
+  }
+  if(!strncmp(line, "lm push ", 8)) {
+    type = LINK_MAP_SCHEDULE;
+  } else if(!strncmp(line, "lm add ", 7)) {
+    type = LINK_MAP_ADD;
+  } else if(!strncmp(line, "lm del ", 7)) {
+    type = LINK_MAP_REMOVE;
+  } else {
+    return;
+  }
+  node = strtoul(line + 7, &p, 10);
+  if(type == LINK_MAP_SCHEDULE) {
+    sf_size = strtoul(p, &p, 10);
+  }
+  while(*p == ' ' && count < LINK_MAP_MAX_LINKS) {
+    struct link_map_link *l = &links[count++];
+    l->timeslot = strtoul(p, &p, 10);
+    l->channel_offset = *p == ':' ? strtoul(p + 1, &p, 10) : 0;
+    l->link_options = 0;
+    if(*p == ':') {
+      for(p++; *p == 't' || *p == 'r' || *p == 's'; p++) {
+        l->link_options |= *p == 't' ? LINK_OPTION_TX
+                         : (*p == 'r' ? LINK_OPTION_RX : LINK_OPTION_SHARED);
+      }
+    }
+    l->neighbor = *p == ':' ? strtoul(p + 1, &p, 10) : 0;
+  }
+  if(node == 0 || *p != '\0') {
+    LOG("LinkMap:! bad command\n");
+    return;
+  }
+  LOG("LinkMap: sending %u links to %u\n", count, node);
+  send_links(type, node, sf_size, links, count);
+}
+/*---------------------------------------------------------------------------*/
+void
+link_map_print(void)
+{
+  int i;
+  for(i = 0; i < entries_count; i++) {
+    LOG("LinkMap: nbr %u pdr %u rssi %d\n",
+        entries[i].id, pdr_percent(&entries[i]), rssi_dbm(&entries[i]));
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(link_map_process, ev, data)
+{
+  static struct etimer probe_timer;
+  static struct etimer report_timer;
+
+  PROCESS_BEGIN();
+
+  etimer_set(&probe_timer, LINK_MAP_PROBE_INTERVAL / 2
+             + random_rand() % (LINK_MAP_PROBE_INTERVAL / 2));
+  etimer_set(&report_timer, LINK_MAP_REPORT_INTERVAL);
+
+  while(1) {
+    PROCESS_WAIT_EVENT();
+    if(ev == PROCESS_EVENT_TIMER && data == &probe_timer) {
+      send_probe();
+      /* Up to a quarter early, to spread probes of neighbors */
+      etimer_set(&probe_timer, LINK_MAP_PROBE_INTERVAL
+                 - random_rand() % (LINK_MAP_PROBE_INTERVAL / 4));
+    } else if(ev == PROCESS_EVENT_TIMER && data == &report_timer) {
+      send_report();
+      etimer_reset(&report_timer);
+    } else if(ev == serial_line_event_message && data != NULL
+              && node_id == link_map_root_id) {
+      command((char *)data);
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+link_map_init(uint16_t root_id)
+{
+  link_map_root_id = root_id;
+  simple_udp_register(&link_map_connection, LINK_MAP_PORT,
+                      NULL, LINK_MAP_PORT, receiver);
+  process_start(&link_map_process, NULL);
+}
+
+#endif /* WITH_DEPLOYMENT */
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Link-quality map service. Every node broadcasts probes at a low
+ *         rate, in the broadcast cells of the schedule, and keeps the PDR
+ *         and RSSI of the probes it hears from every neighbor. Changes
+ *         are reported to the root, which logs the matrix as
+ *         "LinkMap: <node> <neighbor> pdr <%> rssi <dBm>" lines.
+ *
+ *         The root (from code, or a host tool through the serial line)
+ *         can push a schedule to any node, which installs it in a
+ *         slotframe of its own, replacing the last one pushed, then add
+ *         or remove links of it:
+ *         lm push <node> <slotframe size> [<ts>:<choff>:<t|r|s...>:<neighbor> ...]
+ *         lm add <node> [<ts>:<choff>:<t|r|s...>:<neighbor> ...]
+ *         lm del <node> [<ts>:<choff> ...]
+ *         Neighbor 0 is the broadcast address. Every command is applied
+ *         atomically: all of its links or none.
+ *
+ *         Started from deployment_init with WITH_LINK_MAP. Needs RPL.
+ */
+
+#ifndef LINK_MAP_H
+#define LINK_MAP_H
+
+#include "contiki-conf.h"
+
+/* UDP port of probes, reports and schedules */
+#ifdef LINK_MAP_CONF_PORT
+#define LINK_MAP_PORT LINK_MAP_CONF_PORT
+#else
+#define LINK_MAP_PORT 0xf0b2
+#endif
+
+#ifdef LINK_MAP_CONF_PROBE_INTERVAL
+#define LINK_MAP_PROBE_INTERVAL LINK_MAP_CONF_PROBE_INTERVAL
+#else
+#define LINK_MAP_PROBE_INTERVAL (60 * CLOCK_SECOND)
+#endif
+
+/* Changes are reported at most once per period */
+#ifdef LINK_MAP_CONF_REPORT_INTERVAL
+#define LINK_MAP_REPORT_INTERVAL LINK_MAP_CONF_REPORT_INTERVAL
+#else
+#define LINK_MAP_REPORT_INTERVAL (5 * LINK_MAP_PROBE_INTERVAL)
+#endif
+
+/* Every this many reports, all links are reported, changed or not, so
+ * that the root recovers from lost reports */
+#ifdef LINK_MAP_CONF_REFRESH
+#define LINK_MAP_REFRESH LINK_MAP_CONF_REFRESH
+#else
+#define LINK_MAP_REFRESH 12
+#endif
+
+#ifdef LINK_MAP_CONF_MAX_NEIGHBORS
+#define LINK_MAP_MAX_NEIGHBORS LINK_MAP_CONF_MAX_NEIGHBORS
+#else
+#define LINK_MAP_MAX_NEIGHBORS 16
+#endif
+
+/* A link is reported when its PDR (%) or RSSI (dBm) changed by this much */
+#ifdef LINK_MAP_CONF_PDR_DELTA
+#define LINK_MAP_PDR_DELTA LINK_MAP_CONF_PDR_DELTA
+#else
+#define LINK_MAP_PDR_DELTA 10
+#endif
+
+#ifdef LINK_MAP_CONF_RSSI_DELTA
+#define LINK_MAP_RSSI_DELTA LINK_MAP_CONF_RSSI_DELTA
+#else
+#define LINK_MAP_RSSI_DELTA 6
+#endif
+
+/* Neighbors below this PDR (%) are removed, and reported with PDR 0 */
+#ifdef LINK_MAP_CONF_MIN_PDR
+#define LINK_MAP_MIN_PDR LINK_MAP_CONF_MIN_PDR
+#else
+#define LINK_MAP_MIN_PDR 5
+#endif
+
+/* Handle of the slotframe of pushed schedules. The highest handles have
+ * the lowest precedence, below Orchestra's slotframes */
+#ifdef LINK_MAP_CONF_SLOTFRAME_HANDLE
+#define LINK_MAP_SLOTFRAME_HANDLE LINK_MAP_CONF_SLOTFRAME_HANDLE
+#else
+#define LINK_MAP_SLOTFRAME_HANDLE 7
+#endif
+
+/* Maximum number of links in a pushed schedule */
+#ifdef LINK_MAP_CONF_MAX_LINKS
+#define LINK_MAP_MAX_LINKS LINK_MAP_CONF_MAX_LINKS
+#else
+#define LINK_MAP_MAX_LINKS 8
+#endif
+
+/* A link of a pushed schedule */
+struct link_map_link {
+  uint16_t timeslot;
+  uint8_t channel_offset;
+  uint8_t link_options;
+  uint16_t neighbor;
+};
+
+/* Called at the root for every reported link, with pdr 0 for a link
+ * that disappeared. Can be used to recompute schedules */
+#ifdef LINK_MAP_CALLBACK_REPORT
+void LINK_MAP_CALLBACK_REPORT(uint16_t node, uint16_t neighbor, uint8_t pdr, int8_t rssi);
+#endif
+
+/* Called at the root for every report, with the node's preferred parent,
+ * 0 if none */
+#ifdef LINK_MAP_CALLBACK_PARENT
+void LINK_MAP_CALLBACK_PARENT(uint16_t node, uint16_t parent);
+#endif
+
+/* Starts the service. The root is the destination of the reports */
+void link_map_init(uint16_t root_id);
+/* From the root: sends a schedule to node. Returns 1 if sent, 0 otherwise */
+int link_map_push_schedule(uint16_t node, uint16_t sf_size,
+                           const struct link_map_link *links, uint8_t count);
+/* From the root: adds or removes links of the schedule of node, at most
+ * LINK_MAP_MAX_LINKS. Removal uses timeslot and channel offset only.
+ * Return 1 if sent, 0 otherwise */
+int link_map_add_links(uint16_t node, const struct link_map_link *links, uint8_t count);
+int link_map_remove_links(uint16_t node, const struct link_map_link *links, uint8_t count);
+/* Prints our neighbors, their PDR and RSSI */
+void link_map_print(void);
+
+#endif /* LINK_MAP_H */
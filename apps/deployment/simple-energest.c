@@ -31,6 +31,8 @@
  * \file
  *         A process that periodically prints out the time spent in
  *         radio tx, radio rx, total time and duty cycle.
+ *         With TSCH_CONF_WITH_ENERGEST, also prints the TSCH radio-on
+ *         time per link type and slotframe.
  *
  * \author Simon Duquennoy <simonduq@sics.se>
  */
@@ -38,12 +40,55 @@
 #include "contiki.h"
 #include "node-id.h"
 #include "simple-energest.h"
+#include "net/mac/tsch/tsch-private.h"
 #include <stdio.h>
+#include <string.h>
 
 static uint32_t last_tx, last_rx, last_time;
 static uint32_t delta_tx, delta_rx, delta_time;
 static uint32_t curr_tx, curr_rx, curr_time;
 
+#if TSCH_WITH_ENERGEST
+/* TSCH radio-on counters at the end of the last window */
+static struct tsch_energest_stats last_tsch;
+
+/*---------------------------------------------------------------------------*/
+static void
+tsch_energest_print(const char *name, unsigned id,
+                    const struct tsch_energest *curr, const struct tsch_energest *last)
+{
+  LOG("Duty Cycle TSCH: [%u] %s %u %8lu %8lu %8lu\n",
+      node_id, name, id,
+      (unsigned long)(curr->tx - last->tx),
+      (unsigned long)(curr->rx - last->rx),
+      (unsigned long)(curr->rx_idle - last->rx_idle));
+}
+/*---------------------------------------------------------------------------*/
+/* Print the TSCH radio-on time of the last window: tx, rx and idle rx
+ * per link type, shared links and slotframe, then the scan time */
+static void
+tsch_energest_step(int verbose)
+{
+  const struct tsch_energest_stats *curr = tsch_energest_get_stats();
+  int i;
+
+  if(verbose) {
+    for(i = 0; i < 3; i++) {
+      tsch_energest_print("type", i, &curr->per_link_type[i], &last_tsch.per_link_type[i]);
+    }
+    tsch_energest_print("shared", 0, &curr->shared, &last_tsch.shared);
+    for(i = 0; i < TSCH_ENERGEST_MAX_SLOTFRAMES; i++) {
+      tsch_energest_print("sf", curr->per_slotframe[i].handle,
+          &curr->per_slotframe[i].e, &last_tsch.per_slotframe[i].e);
+    }
+    tsch_energest_print("other", 0, &curr->other_slotframes, &last_tsch.other_slotframes);
+    LOG("Duty Cycle TSCH: [%u] scan %8lu\n",
+        node_id, (unsigned long)(curr->scan - last_tsch.scan));
+  }
+  memcpy(&last_tsch, curr, sizeof(last_tsch));
+}
+#endif /* TSCH_WITH_ENERGEST */
+
 /*---------------------------------------------------------------------------*/
 void
 simple_energest_init()
@@ -52,6 +97,9 @@ simple_energest_init()
   last_tx = energest_type_time(ENERGEST_TYPE_TRANSMIT);
   last_rx = energest_type_time(ENERGEST_TYPE_LISTEN);
   last_time = energest_type_time(ENERGEST_TYPE_CPU) + energest_type_time(ENERGEST_TYPE_LPM);
+#if TSCH_WITH_ENERGEST
+  memcpy(&last_tsch, tsch_energest_get_stats(), sizeof(last_tsch));
+#endif /* TSCH_WITH_ENERGEST */
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -73,7 +121,8 @@ simple_energest_step(int verbose)
   last_time = curr_time;
 
   if(verbose) {
-    uint32_t fraction = (1000ul * (delta_tx + delta_rx)) / delta_time;
+    /* No time without energest, as in the native simulation */
+    uint32_t fraction = delta_time ? (1000ul * (delta_tx + delta_rx)) / delta_time : 0;
     LOG("Duty Cycle: [%u %u] %8lu +%8lu /%8lu (%lu permil)\n",
                  node_id,
                  cnt++,
@@ -81,4 +130,7 @@ simple_energest_step(int verbose)
                  fraction
                  );
   }
+#if TSCH_WITH_ENERGEST
+  tsch_energest_step(verbose);
+#endif /* TSCH_WITH_ENERGEST */
 }
@@ -55,6 +55,53 @@
 
 /*----------------------------------------------------------------------------*/
 
+#define BLOCK_UNKNOWN 0xffffffff
+
+/* Blocks received of the body being assembled, for clients that send
+ * several blocks at once: bit n of block1_mask is block block1_low + n */
+static uip_ipaddr_t block1_addr;
+static uint16_t block1_port;
+static uint32_t block1_low;
+static uint32_t block1_mask;
+static uint32_t block1_last = BLOCK_UNKNOWN;
+static unsigned long block1_time;
+
+/* Returns 1 if all blocks are received */
+static int
+block1_track(coap_packet_t *packet)
+{
+  uint32_t num = packet->block1_num;
+
+  /* block 0 starts a new body, unless it is a retransmission */
+  if(num == 0 &&
+     !(uip_ipaddr_cmp(&block1_addr, &UIP_IP_BUF->srcipaddr)
+       && block1_port == UIP_UDP_BUF->srcport
+       && block1_low <= block1_last
+       && clock_seconds() - block1_time <
+       (COAP_RESPONSE_TIMEOUT << COAP_MAX_RETRANSMIT))) {
+    uip_ipaddr_copy(&block1_addr, &UIP_IP_BUF->srcipaddr);
+    block1_port = UIP_UDP_BUF->srcport;
+    block1_low = 0;
+    block1_mask = 0;
+    block1_last = BLOCK_UNKNOWN;
+  }
+  block1_time = clock_seconds();
+
+  if(num >= block1_low) {
+    block1_mask |= (uint32_t)1 << (num - block1_low);
+  }
+  if(!packet->block1_more) {
+    block1_last = num;
+  }
+  while(block1_mask & 1) {
+    block1_mask >>= 1;
+    block1_low++;
+  }
+
+  return block1_low > block1_last;
+}
+/*----------------------------------------------------------------------------*/
+
 /**
  * \brief Block 1 support within a coap-ressource
  *
@@ -62,7 +109,9 @@
  *        error handling and response configuration is active. On return
  *        value 0, the last block was recived, while on return value 1
  *        more blocks will follow. With target, len and maxlen this
- *        function will assemble the blocks.
+ *        function will assemble the blocks. Blocks after the first one
+ *        may arrive out of order, 0 is returned once all of them were
+ *        received.
  *
  *        You can find an example in:
  *        examples/er-rest-example/resources/res-b1-sep-b2.c
@@ -96,9 +145,19 @@ coap_block1_handler(void *request, void *response, uint8_t *target, size_t *len,
     return -1;
   }
 
+  if(IS_OPTION(packet, COAP_OPTION_BLOCK1) && packet->block1_num != 0
+     && packet->block1_num - block1_low >= 32
+     && packet->block1_num >= block1_low) {
+    erbium_status_code = REQUEST_ENTITY_INCOMPLETE_4_08;
+    coap_error_message = "BlockOutOfWindow";
+    return -1;
+  }
+
   if(target && len) {
     memcpy(target + packet->block1_offset, payload, pay_len);
-    *len = packet->block1_offset + pay_len;
+    if(packet->block1_num == 0 || packet->block1_offset + pay_len > *len) {
+      *len = packet->block1_offset + pay_len;
+    }
   }
 
   if(IS_OPTION(packet, COAP_OPTION_BLOCK1)) {
@@ -109,7 +168,7 @@ coap_block1_handler(void *request, void *response, uint8_t *target, size_t *len,
            packet->block1_offset);
 
     coap_set_header_block1(response, packet->block1_num, packet->block1_more, packet->block1_size);
-    if(packet->block1_more) {
+    if(!block1_track(packet)) {
       coap_set_status_code(response, CONTINUE_2_31);
       return 1;
     }
@@ -53,6 +53,30 @@
 #define COAP_MAX_OPEN_TRANSACTIONS     4
 #endif /* COAP_MAX_OPEN_TRANSACTIONS */
 
+/* Buckets of the MID lookup table of open transactions, a power of two. */
+#ifndef COAP_TRANSACTION_HASH_SIZE
+#define COAP_TRANSACTION_HASH_SIZE     8
+#endif /* COAP_TRANSACTION_HASH_SIZE */
+
+/* Retransmissions share one timer wheel of COAP_TRANSACTION_WHEEL_SLOTS slots,
+ * each COAP_TRANSACTION_WHEEL_TICK long, which sets their accuracy. */
+#ifndef COAP_TRANSACTION_WHEEL_TICK
+#define COAP_TRANSACTION_WHEEL_TICK    ((CLOCK_SECOND + 7) / 8)
+#endif /* COAP_TRANSACTION_WHEEL_TICK */
+
+#ifndef COAP_TRANSACTION_WHEEL_SLOTS
+#define COAP_TRANSACTION_WHEEL_SLOTS   32
+#endif /* COAP_TRANSACTION_WHEEL_SLOTS */
+
+/* Blocks requested at once by a Block2 transfer of COAP_BLOCKING_REQUEST(),
+ * after the first one. Each takes a transaction. With more than 1, lost blocks
+ * are requested again alone, and the chunk handler is called as blocks arrive,
+ * from the CoAP engine and possibly out of order: it must place each chunk
+ * with its Block2 number. 1 is the plain stop-and-wait transfer. */
+#ifndef COAP_BLOCK_WINDOW
+#define COAP_BLOCK_WINDOW              1
+#endif /* COAP_BLOCK_WINDOW */
+
 /* Maximum number of failed request attempts before action */
 #ifndef COAP_MAX_ATTEMPTS
 #define COAP_MAX_ATTEMPTS              4
@@ -68,6 +92,16 @@
 #define COAP_MAX_OBSERVERS    COAP_MAX_OPEN_TRANSACTIONS - 1
 #endif /* COAP_MAX_OBSERVERS */
 
+/* Notifications sent at once when a resource changes, the others are paced out
+ * every COAP_OBSERVE_PACING_INTERVAL. An observer is sent the latest state only. */
+#ifndef COAP_OBSERVE_BURST
+#define COAP_OBSERVE_BURST             COAP_MAX_OBSERVERS
+#endif /* COAP_OBSERVE_BURST */
+
+#ifndef COAP_OBSERVE_PACING_INTERVAL
+#define COAP_OBSERVE_PACING_INTERVAL   (CLOCK_SECOND / 8)
+#endif /* COAP_OBSERVE_PACING_INTERVAL */
+
 /* Interval in notifies in which NON notifies are changed to CON notifies to check client. */
 #define COAP_OBSERVE_REFRESH_INTERVAL  20
 
@@ -53,6 +53,9 @@
 #define PRINTLLADDR(addr)
 #endif
 
+/* Where uip_udp_packet_send() expects the datagram payload */
+#define COAP_UIP_OUTPUT ((uint8_t *)&uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN])
+
 PROCESS(coap_engine, "CoAP Engine");
 
 /*---------------------------------------------------------------------------*/
@@ -64,6 +67,23 @@ static service_callback_t service_cbk = NULL;
 /*- Internal API ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
 static int
+in_uip_buf(const void *ptr)
+{
+  return (const uint8_t *)ptr >= uip_buf &&
+         (const uint8_t *)ptr < uip_buf + UIP_BUFSIZE;
+}
+/*---------------------------------------------------------------------------*/
+/* Whether the response points into the request, which lies in uip_buf */
+static int
+refers_to_request(coap_packet_t *pkt)
+{
+  return in_uip_buf(pkt->payload) || in_uip_buf(pkt->location_path)
+         || in_uip_buf(pkt->location_query) || in_uip_buf(pkt->uri_path)
+         || in_uip_buf(pkt->uri_query) || in_uip_buf(pkt->uri_host)
+         || in_uip_buf(pkt->proxy_uri) || in_uip_buf(pkt->proxy_scheme);
+}
+/*---------------------------------------------------------------------------*/
+static int
 coap_receive(void)
 {
   erbium_status_code = NO_ERROR;
@@ -207,9 +227,16 @@ coap_receive(void)
                 /* serialize response */
             }
             if(erbium_status_code == NO_ERROR) {
+              /* a response that is never retransmitted is serialized
+                 straight into the outgoing uIP buffer */
+              uint8_t *buffer = transaction->packet;
+
+              if(response->type != COAP_TYPE_CON
+                 && !refers_to_request(response)) {
+                buffer = COAP_UIP_OUTPUT;
+              }
               if((transaction->packet_len = coap_serialize_message(response,
-                                                                   transaction->
-                                                                   packet)) ==
+                                                                   buffer)) ==
                  0) {
                 erbium_status_code = PACKET_SERIALIZATION_ERROR;
               }
@@ -258,7 +285,11 @@ coap_receive(void)
 
     /* if(parsed correctly) */
     if(erbium_status_code == NO_ERROR) {
-      if(transaction) {
+      if(transaction && response->buffer == COAP_UIP_OUTPUT) {
+        coap_send_message(&transaction->addr, transaction->port,
+                          response->buffer, transaction->packet_len);
+        coap_clear_transaction(transaction);
+      } else if(transaction) {
         coap_send_transaction(transaction);
       }
     } else if(erbium_status_code == MANUAL_RESPONSE) {
@@ -283,8 +314,8 @@ coap_receive(void)
       coap_set_payload(message, coap_error_message,
                        strlen(coap_error_message));
       coap_send_message(&UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport,
-                        uip_appdata, coap_serialize_message(message,
-                                                            uip_appdata));
+                        COAP_UIP_OUTPUT,
+                        coap_serialize_message(message, COAP_UIP_OUTPUT));
     }
   }
 
@@ -356,6 +387,93 @@ coap_blocking_request_callback(void *callback_data, void *response)
   process_poll(state->process);
 }
 /*---------------------------------------------------------------------------*/
+#if COAP_BLOCK_WINDOW > 1
+#if COAP_BLOCK_WINDOW > 32
+#error "COAP_BLOCK_WINDOW is limited to 32 blocks"
+#endif
+
+#define BLOCK_UNKNOWN 0xffffffff
+
+/* A block of a windowed transfer, used when state is not NULL */
+struct block_request {
+  struct request_state_t *state;
+  coap_transaction_t *transaction;
+  uint32_t num;
+  uint8_t attempts;
+  uint8_t retry;
+};
+static struct block_request block_window[COAP_BLOCK_WINDOW];
+
+static void
+coap_window_request_callback(void *callback_data, void *response)
+{
+  struct block_request *b = (struct block_request *)callback_data;
+  struct request_state_t *state = b->state;
+  coap_packet_t *const res = (coap_packet_t *)response;
+  uint32_t num = 0;
+  uint8_t more = 0;
+
+  b->transaction = NULL;
+  process_poll(state->process);
+
+  if(res == NULL || (res->code < BAD_REQUEST_4_00 &&
+                     (!coap_get_header_block2(res, &num, &more, NULL, NULL)
+                      || num != b->num))) {
+    PRINTF("Block #%lu lost\n", b->num);
+    b->retry = 1;
+    return;
+  }
+  b->state = NULL;
+
+  if(res->code >= BAD_REQUEST_4_00) {
+    /* past the end (BlockOutOfScope), unless the end is known */
+    if(state->block_last == BLOCK_UNKNOWN) {
+      state->block_last = b->num - 1;
+    } else if(b->num <= state->block_last) {
+      state->block_failed = 1;
+    }
+    return;
+  }
+
+  PRINTF("Received #%lu%s (%u bytes)\n", num, more ? "+" : "",
+         res->payload_len);
+
+  if(!more && num < state->block_last) {
+    state->block_last = num;
+  }
+  if(num >= state->block_low && num - state->block_low < 32
+     && !(state->block_mask & ((uint32_t)1 << (num - state->block_low)))) {
+    state->block_mask |= (uint32_t)1 << (num - state->block_low);
+    state->handler(res);
+    while(state->block_mask & 1) {
+      state->block_mask >>= 1;
+      state->block_low++;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+coap_window_request_send(struct block_request *b, uip_ipaddr_t *remote_ipaddr,
+                         uint16_t remote_port, coap_packet_t *request)
+{
+  request->mid = coap_get_mid();
+  if(!(b->transaction = coap_new_transaction(request->mid, remote_ipaddr,
+                                             remote_port))) {
+    return 0;
+  }
+  b->transaction->callback = coap_window_request_callback;
+  b->transaction->callback_data = b;
+
+  coap_set_header_block2(request, b->num, 0, b->state->block_size);
+  b->transaction->packet_len = coap_serialize_message(request,
+                                                      b->transaction->packet);
+  b->retry = 0;
+  PRINTF("Requested #%lu (MID %u)\n", b->num, request->mid);
+  coap_send_transaction(b->transaction);
+  return 1;
+}
+#endif /* COAP_BLOCK_WINDOW > 1 */
+/*---------------------------------------------------------------------------*/
 PT_THREAD(coap_blocking_request
             (struct request_state_t *state, process_event_t ev,
             uip_ipaddr_t *remote_ipaddr, uint16_t remote_port,
@@ -367,6 +485,11 @@ PT_THREAD(coap_blocking_request
   static uint8_t more;
   static uint32_t res_block;
   static uint8_t block_error;
+#if COAP_BLOCK_WINDOW > 1
+  static struct block_request *b;
+  static uint8_t busy;
+  static uint32_t size2;
+#endif /* COAP_BLOCK_WINDOW > 1 */
 
   state->block_num = 0;
   state->response = NULL;
@@ -402,7 +525,13 @@ PT_THREAD(coap_blocking_request
         PT_EXIT(&state->pt);
       }
 
-      coap_get_header_block2(state->response, &res_block, &more, NULL, NULL);
+      coap_get_header_block2(state->response, &res_block, &more,
+#if COAP_BLOCK_WINDOW > 1
+                             &state->block_size,
+#else
+                             NULL,
+#endif /* COAP_BLOCK_WINDOW > 1 */
+                             NULL);
 
       PRINTF("Received #%lu%s (%u bytes)\n", res_block, more ? "+" : "",
              state->response->payload_len);
@@ -418,8 +547,76 @@ PT_THREAD(coap_blocking_request
       PRINTF("Could not allocate transaction buffer");
       PT_EXIT(&state->pt);
     }
+#if COAP_BLOCK_WINDOW > 1
+    /* the first block gives the block size, then request several at once */
+    if(more && state->block_num == 1 && request->type == COAP_TYPE_CON) {
+      break;
+    }
+#endif /* COAP_BLOCK_WINDOW > 1 */
   } while(more && block_error < COAP_MAX_ATTEMPTS);
 
+#if COAP_BLOCK_WINDOW > 1
+  if(!more || block_error >= COAP_MAX_ATTEMPTS) {
+    PT_EXIT(&state->pt);
+  }
+
+  state->handler = request_callback;
+  state->block_low = 1;
+  state->block_mask = 0;
+  state->block_last = BLOCK_UNKNOWN;
+  state->block_failed = 0;
+  if(coap_get_header_size2(state->response, &size2) && size2 > 0) {
+    state->block_last = (size2 - 1) / state->block_size;
+  }
+
+  while(state->block_low <= state->block_last && !state->block_failed) {
+    busy = 0;
+    for(b = block_window; b < &block_window[COAP_BLOCK_WINDOW]; b++) {
+      if(b->state == state && b->num > state->block_last) {
+        /* beyond the end */
+        coap_clear_transaction(b->transaction);
+        b->transaction = NULL;
+        b->state = NULL;
+      }
+      if(b->state == NULL && state->block_num <= state->block_last
+         && state->block_num - state->block_low < 32) {
+        b->state = state;
+        b->num = state->block_num++;
+        b->attempts = 0;
+        b->retry = 1;
+      }
+      if(b->state == state && b->retry) {
+        if(b->attempts == COAP_MAX_ATTEMPTS) {
+          PRINTF("Block #%lu failed\n", b->num);
+          state->block_failed = 1;
+          break;
+        }
+        if(coap_window_request_send(b, remote_ipaddr, remote_port, request)) {
+          b->attempts++;
+        }
+      }
+      if(b->state == state && b->transaction != NULL) {
+        busy = 1;
+      }
+    }
+
+    if(!busy) {
+      PRINTF("Could not allocate transaction buffer");
+      state->block_failed = 1;
+    } else if(!state->block_failed) {
+      PT_YIELD_UNTIL(&state->pt, ev == PROCESS_EVENT_POLL);
+    }
+  }
+
+  for(b = block_window; b < &block_window[COAP_BLOCK_WINDOW]; b++) {
+    if(b->state == state) {
+      coap_clear_transaction(b->transaction);
+      b->transaction = NULL;
+      b->state = NULL;
+    }
+  }
+#endif /* COAP_BLOCK_WINDOW > 1 */
+
   PT_END(&state->pt);
 }
 /*---------------------------------------------------------------------------*/
@@ -55,16 +55,25 @@ void coap_init_engine(void);
 /*---------------------------------------------------------------------------*/
 /*- Client Part -------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
+typedef void (*blocking_response_handler)(void *response);
+
 struct request_state_t {
   struct pt pt;
   struct process *process;
   coap_transaction_t *transaction;
   coap_packet_t *response;
   uint32_t block_num;
+#if COAP_BLOCK_WINDOW > 1
+  /* windowed Block2 transfer, see COAP_BLOCK_WINDOW */
+  blocking_response_handler handler;
+  uint32_t block_low;   /* first block not received */
+  uint32_t block_mask;  /* blocks received after block_low */
+  uint32_t block_last;  /* last block, if known */
+  uint16_t block_size;
+  uint8_t block_failed;
+#endif /* COAP_BLOCK_WINDOW > 1 */
 };
 
-typedef void (*blocking_response_handler)(void *response);
-
 PT_THREAD(coap_blocking_request
             (struct request_state_t *state, process_event_t ev,
             uip_ipaddr_t *remote_ipaddr, uint16_t remote_port,
@@ -55,6 +55,26 @@
 /*---------------------------------------------------------------------------*/
 MEMB(observers_memb, coap_observer_t, COAP_MAX_OBSERVERS);
 LIST(observers_list);
+
+/* Notifications of observers with a resource to notify are sent by
+ * send_notifications, at most COAP_OBSERVE_BURST at a time, the rest after
+ * COAP_OBSERVE_PACING_INTERVAL. */
+static struct ctimer pacing_timer;
+
+/* The last representation built for notifications, valid until
+ * coap_notify_observers() is called again for its resource */
+static resource_t *cached_resource;
+static coap_packet_t cached_notification[1];
+static uint8_t cached_payload[REST_MAX_CHUNK_SIZE];
+
+#ifdef COAP_OBSERVE_CONF_IS_CONGESTED
+/* Notifications are held back while this returns non-zero, e.g.
+ * tsch_queue_is_congested */
+int COAP_OBSERVE_CONF_IS_CONGESTED(void);
+#define IS_CONGESTED() COAP_OBSERVE_CONF_IS_CONGESTED()
+#else
+#define IS_CONGESTED() 0
+#endif
 /*---------------------------------------------------------------------------*/
 /*- Internal API ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
@@ -74,6 +94,7 @@ coap_add_observer(uip_ipaddr_t *addr, uint16_t port, const uint8_t *token,
     o->token_len = token_len;
     memcpy(o->token, token, token_len);
     o->last_mid = 0;
+    o->notify = NULL;
 
     PRINTF("Adding observer (%u/%u) for /%s [0x%02X%02X]\n",
            list_length(observers_list) + 1, COAP_MAX_OBSERVERS,
@@ -175,55 +196,110 @@ coap_remove_observer_by_mid(uip_ipaddr_t *addr, uint16_t port, uint16_t mid)
 /*---------------------------------------------------------------------------*/
 /*- Notification ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
-void
-coap_notify_observers(resource_t *resource)
+static int
+send_notification(coap_observer_t *obs)
 {
-  /* build notification */
   coap_packet_t notification[1]; /* this way the packet can be treated as pointer as usual */
-  coap_init_message(notification, COAP_TYPE_NON, CONTENT_2_05, 0);
-  coap_observer_t *obs = NULL;
+  coap_transaction_t *transaction = NULL;
+  resource_t *resource = obs->notify;
 
-  PRINTF("Observe: Notification from %s\n", resource->url);
+  /*TODO implement special transaction for CON, sharing the same buffer to allow for more observers */
 
-  /* iterate over observers */
-  for(obs = (coap_observer_t *)list_head(observers_list); obs;
-      obs = obs->next) {
-    if(obs->url == resource->url) {     /* using RESOURCE url pointer as handle */
-      coap_transaction_t *transaction = NULL;
+  if(!(transaction = coap_new_transaction(coap_get_mid(), &obs->addr, obs->port))) {
+    return 0;
+  }
+  obs->notify = NULL;
 
-      /*TODO implement special transaction for CON, sharing the same buffer to allow for more observers */
+  /* build the representation once for all observers */
+  if(cached_resource != resource) {
+    coap_init_message(cached_notification, COAP_TYPE_NON, CONTENT_2_05, 0);
+    resource->get_handler(NULL, cached_notification, cached_payload,
+                          REST_MAX_CHUNK_SIZE, NULL);
+    cached_resource = resource;
+  }
+  memcpy(notification, cached_notification, sizeof(notification));
 
-      if((transaction = coap_new_transaction(coap_get_mid(), &obs->addr, obs->port))) {
-        if(obs->obs_counter % COAP_OBSERVE_REFRESH_INTERVAL == 0) {
-          PRINTF("           Force Confirmable for\n");
-          notification->type = COAP_TYPE_CON;
-        }
+  if(obs->obs_counter % COAP_OBSERVE_REFRESH_INTERVAL == 0) {
+    PRINTF("           Force Confirmable for\n");
+    notification->type = COAP_TYPE_CON;
+  }
 
-        PRINTF("           Observer ");
-        PRINT6ADDR(&obs->addr);
-        PRINTF(":%u\n", obs->port);
+  PRINTF("           Observer ");
+  PRINT6ADDR(&obs->addr);
+  PRINTF(":%u\n", obs->port);
 
-        /* update last MID for RST matching */
-        obs->last_mid = transaction->mid;
+  /* update last MID for RST matching */
+  obs->last_mid = transaction->mid;
 
-        /* prepare response */
-        notification->mid = transaction->mid;
+  /* prepare response */
+  notification->mid = transaction->mid;
 
-        resource->get_handler(NULL, notification,
-                              transaction->packet + COAP_MAX_HEADER_SIZE,
-                              REST_MAX_CHUNK_SIZE, NULL);
+  if(notification->code < BAD_REQUEST_4_00) {
+    coap_set_header_observe(notification, (obs->obs_counter)++);
+  }
+  coap_set_token(notification, obs->token, obs->token_len);
 
-        if(notification->code < BAD_REQUEST_4_00) {
-          coap_set_header_observe(notification, (obs->obs_counter)++);
-        }
-        coap_set_token(notification, obs->token, obs->token_len);
+  transaction->packet_len =
+    coap_serialize_message(notification, transaction->packet);
 
-        transaction->packet_len =
-          coap_serialize_message(notification, transaction->packet);
+  coap_send_transaction(transaction);
+
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_notifications(void *ptr)
+{
+  coap_observer_t *obs = NULL;
+  int burst;
 
-        coap_send_transaction(transaction);
+  for(burst = 0; burst < COAP_OBSERVE_BURST; burst++) {
+    for(obs = (coap_observer_t *)list_head(observers_list); obs;
+        obs = obs->next) {
+      if(obs->notify != NULL) {
+        break;
       }
     }
+    if(obs == NULL) {
+      return;
+    }
+
+    if(IS_CONGESTED() || !send_notification(obs)) {
+      PRINTF("Observe: Holding back notifications\n");
+      break;
+    }
+
+    /* round robin, so that no observer waits behind the others */
+    list_remove(observers_list, obs);
+    list_add(observers_list, obs);
+  }
+
+  ctimer_set(&pacing_timer, COAP_OBSERVE_PACING_INTERVAL,
+             send_notifications, NULL);
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_notify_observers(resource_t *resource)
+{
+  coap_observer_t *obs = NULL;
+
+  PRINTF("Observe: Notification from %s\n", resource->url);
+
+  if(cached_resource == resource) {
+    cached_resource = NULL;
+  }
+
+  /* iterate over observers, notifications not sent yet will carry the new
+   * state only */
+  for(obs = (coap_observer_t *)list_head(observers_list); obs;
+      obs = obs->next) {
+    if(obs->url == resource->url) {     /* using RESOURCE url pointer as handle */
+      obs->notify = resource;
+    }
+  }
+
+  if(ctimer_expired(&pacing_timer)) {
+    send_notifications(NULL);
   }
 }
 /*---------------------------------------------------------------------------*/
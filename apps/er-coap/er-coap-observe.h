@@ -62,6 +62,8 @@ typedef struct coap_observer {
   uint16_t last_mid;
 
   int32_t obs_counter;
+  /* the resource of a notification not sent yet, or NULL */
+  resource_t *notify;
 
   struct etimer retrans_timer;
   uint8_t retrans_counter;
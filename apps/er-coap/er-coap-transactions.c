@@ -54,11 +54,108 @@
 #endif
 
 /*---------------------------------------------------------------------------*/
+#if (COAP_TRANSACTION_HASH_SIZE & (COAP_TRANSACTION_HASH_SIZE - 1)) != 0
+#error "COAP_TRANSACTION_HASH_SIZE must be a power of two"
+#endif
+
+#define MID_HASH(mid)      ((mid) & (COAP_TRANSACTION_HASH_SIZE - 1))
+#define WHEEL_SLOT(tick)   ((tick) % COAP_TRANSACTION_WHEEL_SLOTS)
+#define TICK_LT(a, b)      ((int16_t)((a) - (b)) < 0)
+
 MEMB(transactions_memb, coap_transaction_t, COAP_MAX_OPEN_TRANSACTIONS);
-LIST(transactions_list);
+
+/* Open transactions, chained by MID */
+static coap_transaction_t *mid_table[COAP_TRANSACTION_HASH_SIZE];
+
+/*
+ * Confirmable transactions waiting for an ACK, chained in the slot of the
+ * wheel tick at which they are retransmitted. A single etimer is set to the
+ * next non-empty slot. Ticks are counted from wheel_time, the time of tick
+ * wheel_tick, which is moved along while the wheel is in use; wheel_next is
+ * the first tick that has not been processed.
+ */
+static coap_transaction_t *wheel[COAP_TRANSACTION_WHEEL_SLOTS];
+static uint16_t wheel_count;
+static uint16_t wheel_tick;
+static uint16_t wheel_next;
+static uint16_t wheel_armed;
+static clock_time_t wheel_time;
+static struct etimer wheel_timer;
 
 static struct process *transaction_handler_process = NULL;
 
+/*---------------------------------------------------------------------------*/
+static uint16_t
+current_tick(void)
+{
+  return wheel_tick +
+         (clock_time() - wheel_time) / COAP_TRANSACTION_WHEEL_TICK;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_arm(uint16_t tick)
+{
+  clock_time_t interval = 1;
+
+  if(TICK_LT(current_tick(), tick)) {
+    interval = wheel_time - clock_time() +
+      (clock_time_t)(uint16_t)(tick - wheel_tick) * COAP_TRANSACTION_WHEEL_TICK;
+  }
+
+  /*FIXME
+   * Hack: Setting timer for responsible process.
+   * Maybe there is a better way, but avoid posting everything to the process.
+   */
+  struct process *process_actual = PROCESS_CURRENT();
+
+  process_current = transaction_handler_process;
+  etimer_set(&wheel_timer, interval);
+  process_current = process_actual;
+
+  wheel_armed = tick;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_add(coap_transaction_t *t, clock_time_t interval)
+{
+  uint16_t slot;
+
+  if(wheel_count == 0) {
+    /* restart the tick count, clock_time() may have wrapped since */
+    wheel_time = clock_time();
+    wheel_tick = wheel_next;
+  }
+
+  t->retrans_tick = current_tick() +
+    (interval + COAP_TRANSACTION_WHEEL_TICK - 1) / COAP_TRANSACTION_WHEEL_TICK;
+  if(TICK_LT(t->retrans_tick, wheel_next)) {
+    t->retrans_tick = wheel_next;
+  }
+
+  slot = WHEEL_SLOT(t->retrans_tick);
+  t->wheel_next = wheel[slot];
+  wheel[slot] = t;
+
+  if(wheel_count++ == 0 || etimer_expired(&wheel_timer) ||
+     TICK_LT(t->retrans_tick, wheel_armed)) {
+    wheel_arm(t->retrans_tick);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_remove(coap_transaction_t *t)
+{
+  coap_transaction_t **p;
+
+  for(p = &wheel[WHEEL_SLOT(t->retrans_tick)]; *p; p = &(*p)->wheel_next) {
+    if(*p == t) {
+      *p = t->wheel_next;
+      t->wheel_next = NULL;
+      wheel_count--;
+      return;
+    }
+  }
+}
 /*---------------------------------------------------------------------------*/
 /*- Internal API ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
@@ -75,12 +172,14 @@ coap_new_transaction(uint16_t mid, uip_ipaddr_t *addr, uint16_t port)
   if(t) {
     t->mid = mid;
     t->retrans_counter = 0;
+    t->wheel_next = NULL;
 
     /* save client address */
     uip_ipaddr_copy(&t->addr, addr);
     t->port = port;
 
-    list_add(transactions_list, t); /* list itself makes sure same element is not added twice */
+    t->next = mid_table[MID_HASH(mid)];
+    mid_table[MID_HASH(mid)] = t;
   }
 
   return t;
@@ -100,28 +199,20 @@ coap_send_transaction(coap_transaction_t *t)
       PRINTF("Keeping transaction %u\n", t->mid);
 
       if(t->retrans_counter == 0) {
-        t->retrans_timer.timer.interval =
+        t->retrans_interval =
           COAP_RESPONSE_TIMEOUT_TICKS + (random_rand()
                                          %
                                          (clock_time_t)
                                          COAP_RESPONSE_TIMEOUT_BACKOFF_MASK);
         PRINTF("Initial interval %f\n",
-               (float)t->retrans_timer.timer.interval / CLOCK_SECOND);
+               (float)t->retrans_interval / CLOCK_SECOND);
       } else {
-        t->retrans_timer.timer.interval <<= 1;  /* double */
+        t->retrans_interval <<= 1;  /* double */
         PRINTF("Doubled (%u) interval %f\n", t->retrans_counter,
-               (float)t->retrans_timer.timer.interval / CLOCK_SECOND);
+               (float)t->retrans_interval / CLOCK_SECOND);
       }
 
-      /*FIXME
-       * Hack: Setting timer for responsible process.
-       * Maybe there is a better way, but avoid posting everything to the process.
-       */
-      struct process *process_actual = PROCESS_CURRENT();
-
-      process_current = transaction_handler_process;
-      etimer_restart(&t->retrans_timer);        /* interval updated above */
-      process_current = process_actual;
+      wheel_add(t, t->retrans_interval);
 
       t = NULL;
     } else {
@@ -147,11 +238,18 @@ coap_send_transaction(coap_transaction_t *t)
 void
 coap_clear_transaction(coap_transaction_t *t)
 {
+  coap_transaction_t **p;
+
   if(t) {
     PRINTF("Freeing transaction %u: %p\n", t->mid, t);
 
-    etimer_stop(&t->retrans_timer);
-    list_remove(transactions_list, t);
+    wheel_remove(t);
+    for(p = &mid_table[MID_HASH(t->mid)]; *p; p = &(*p)->next) {
+      if(*p == t) {
+        *p = t->next;
+        break;
+      }
+    }
     memb_free(&transactions_memb, t);
   }
 }
@@ -160,7 +258,7 @@ coap_get_transaction_by_mid(uint16_t mid)
 {
   coap_transaction_t *t = NULL;
 
-  for(t = (coap_transaction_t *)list_head(transactions_list); t; t = t->next) {
+  for(t = mid_table[MID_HASH(mid)]; t; t = t->next) {
     if(t->mid == mid) {
       PRINTF("Found transaction for MID %u: %p\n", t->mid, t);
       return t;
@@ -172,13 +270,47 @@ coap_get_transaction_by_mid(uint16_t mid)
 void
 coap_check_transactions()
 {
-  coap_transaction_t *t = NULL;
+  coap_transaction_t *t;
+  uint16_t now;
+  uint16_t first;
+  uint16_t tick;
+  int i;
+
+  if(wheel_count == 0) {
+    return;
+  }
+
+  now = current_tick();
+  first = wheel_next;
+  if(!TICK_LT(now, first)) {
+    /* keep the tick count small */
+    wheel_time += (clock_time_t)(uint16_t)(now - wheel_tick) *
+      COAP_TRANSACTION_WHEEL_TICK;
+    wheel_tick = now;
+    wheel_next = now + 1;
+
+    /* retransmit everything due in the slots up to now, at most one turn */
+    for(i = 0, tick = first;
+        !TICK_LT(now, tick) && i < COAP_TRANSACTION_WHEEL_SLOTS; i++, tick++) {
+      /* the slot changes while retransmitting, start over after each one */
+      do {
+        for(t = wheel[WHEEL_SLOT(tick)]; t; t = t->wheel_next) {
+          if(!TICK_LT(now, t->retrans_tick)) {
+            wheel_remove(t);
+            ++(t->retrans_counter);
+            PRINTF("Retransmitting %u (%u)\n", t->mid, t->retrans_counter);
+            coap_send_transaction(t);
+            break;
+          }
+        }
+      } while(t != NULL);
+    }
+  }
 
-  for(t = (coap_transaction_t *)list_head(transactions_list); t; t = t->next) {
-    if(etimer_expired(&t->retrans_timer)) {
-      ++(t->retrans_counter);
-      PRINTF("Retransmitting %u (%u)\n", t->mid, t->retrans_counter);
-      coap_send_transaction(t);
+  for(i = 0, tick = wheel_next; i < COAP_TRANSACTION_WHEEL_SLOTS; i++, tick++) {
+    if(wheel[WHEEL_SLOT(tick)] != NULL) {
+      wheel_arm(tick);
+      break;
     }
   }
 }
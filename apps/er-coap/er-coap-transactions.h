@@ -50,10 +50,12 @@
 
 /* container for transactions with message buffer and retransmission info */
 typedef struct coap_transaction {
-  struct coap_transaction *next;        /* for LIST */
+  struct coap_transaction *next;        /* for the MID hash chain */
+  struct coap_transaction *wheel_next;  /* for the retransmission wheel slot */
 
   uint16_t mid;
-  struct etimer retrans_timer;
+  uint16_t retrans_tick;
+  clock_time_t retrans_interval;
   uint8_t retrans_counter;
 
   uip_ipaddr_t addr;
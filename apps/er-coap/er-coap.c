@@ -43,6 +43,9 @@
 
 #include "er-coap.h"
 #include "er-coap-transactions.h"
+#if SICSLOWPAN_UDP_PROFILES
+#include "net/ipv6/sicslowpan.h"
+#endif /* SICSLOWPAN_UDP_PROFILES */
 
 #define DEBUG 0
 #if DEBUG
@@ -62,6 +65,14 @@
 static struct uip_udp_conn *udp_conn = NULL;
 static uint16_t current_mid = 0;
 
+#if SICSLOWPAN_UDP_PROFILES
+/* Elides the CoAP port in 6LoWPAN frames. The CoAP header itself (random
+ * message ID and token) does not compress further. */
+static const struct sicslowpan_udp_profile coap_profile = {
+  SICSLOWPAN_UDP_PROFILE_COAP, COAP_DEFAULT_PORT, NULL, NULL
+};
+#endif /* SICSLOWPAN_UDP_PROFILES */
+
 coap_status_t erbium_status_code = NO_ERROR;
 char *coap_error_message = "";
 /*---------------------------------------------------------------------------*/
@@ -279,6 +290,9 @@ coap_init_connection(uint16_t port)
   udp_conn = udp_new(NULL, 0, NULL);
   udp_bind(udp_conn, port);
   PRINTF("Listening on port %u\n", uip_ntohs(udp_conn->lport));
+#if SICSLOWPAN_UDP_PROFILES
+  sicslowpan_udp_profile_register(&coap_profile);
+#endif /* SICSLOWPAN_UDP_PROFILES */
 
   /* initialize transaction ID */
   current_mid = random_rand();
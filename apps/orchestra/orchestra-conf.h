@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/**
+ * \file
+ *         Orchestra configuration: the rules to run and their parameters
+ *
+ * \author Simon Duquennoy <simonduq@sics.se>
+ */
+
+#ifndef __ORCHESTRA_CONF_H__
+#define __ORCHESTRA_CONF_H__
+
+/* The rules run by default, in order. Each rule gets its own slotframe(s),
+ * with consecutive handles starting from 0, so that earlier rules take
+ * precedence when their links overlap. Can be changed at runtime, before
+ * orchestra_init, with orchestra_set_rules */
+#ifdef ORCHESTRA_CONF_RULES
+#define ORCHESTRA_RULES ORCHESTRA_CONF_RULES
+#else
+#define ORCHESTRA_RULES { &eb_per_time_source, &default_common, &unicast_per_neighbor_rb }
+#endif
+
+/* Maximum number of rules active at once */
+#ifdef ORCHESTRA_CONF_MAX_RULES
+#define ORCHESTRA_MAX_RULES ORCHESTRA_CONF_MAX_RULES
+#else
+#define ORCHESTRA_MAX_RULES 4
+#endif
+
+/* Keep statistics per slotframe: links installed, removed and expired by
+ * the rules, packets selected, and unicast that no rule selected, i.e.
+ * that fall back to the common shared slotframe. With
+ * TSCH_SCHEDULE_CONF_WITH_LINK_STATS, the report also has the Tx and Rx
+ * use of every slotframe and the unacked Tx on its shared links. The
+ * deployment logger prints the report every minute */
+#ifdef ORCHESTRA_CONF_WITH_STATS
+#define ORCHESTRA_WITH_STATS ORCHESTRA_CONF_WITH_STATS
+#else
+#define ORCHESTRA_WITH_STATS 0
+#endif
+
+/* Derive the slots of a node from a hash of its link-layer address, rather
+ * than from its index in the deployment's node table. Nodes that are not in
+ * the table get slots too, and no table lookup is done per packet */
+#ifdef ORCHESTRA_CONF_HASH_SLOTS
+#define ORCHESTRA_HASH_SLOTS ORCHESTRA_CONF_HASH_SLOTS
+#else
+#define ORCHESTRA_HASH_SLOTS 0
+#endif
+
+/* The hash of a link-layer address, in 0..0x7fff */
+#ifdef ORCHESTRA_CONF_LINKADDR_HASH
+#define ORCHESTRA_LINKADDR_HASH(addr) ORCHESTRA_CONF_LINKADDR_HASH(addr)
+#else
+#define ORCHESTRA_LINKADDR_HASH(addr) orchestra_linkaddr_hash(addr)
+#endif
+
+/* Slots of two nodes may collide, with hashes or when the slotframes are
+ * shorter than the node table. When set, a dedicated Tx link that turns
+ * out to also be the Rx link for a neighbor (or for the time source's EBs)
+ * is made shared, so that TSCH backs off on it */
+#ifdef ORCHESTRA_CONF_COLLISION_AWARE
+#define ORCHESTRA_COLLISION_AWARE ORCHESTRA_CONF_COLLISION_AWARE
+#else
+#define ORCHESTRA_COLLISION_AWARE ORCHESTRA_HASH_SLOTS
+#endif
+
+/* Spread the dedicated unicast cells over ORCHESTRA_CHANNEL_OFFSETS
+ * channel offsets from ORCHESTRA_CHANNEL_OFFSET_FIRST, rather than the
+ * fixed offset of their slotframe. The offset of a cell is a hash of its
+ * sender and receiver, or of the receiver alone for receiver-based cells,
+ * so that neighbors sharing a timeslot tend to use different channels.
+ * Keep the offsets below the hopping sequence length, and clear of the
+ * EB and common shared offsets (0 and 1) */
+#ifdef ORCHESTRA_CONF_CHANNEL_DIVERSITY
+#define ORCHESTRA_CHANNEL_DIVERSITY ORCHESTRA_CONF_CHANNEL_DIVERSITY
+#else
+#define ORCHESTRA_CHANNEL_DIVERSITY 0
+#endif
+
+#ifdef ORCHESTRA_CONF_CHANNEL_OFFSET_FIRST
+#define ORCHESTRA_CHANNEL_OFFSET_FIRST ORCHESTRA_CONF_CHANNEL_OFFSET_FIRST
+#else
+#define ORCHESTRA_CHANNEL_OFFSET_FIRST 2
+#endif
+
+#ifdef ORCHESTRA_CONF_CHANNEL_OFFSETS
+#define ORCHESTRA_CHANNEL_OFFSETS ORCHESTRA_CONF_CHANNEL_OFFSETS
+#else
+#define ORCHESTRA_CHANNEL_OFFSETS 4
+#endif
+
+/* Slotframe lengths must be pairwise co-prime, so that overlapping links
+ * rotate. orchestra_init warns otherwise. tools/orchestra-slotframes
+ * suggests lengths for a deployment and its traffic */
+
+/* EB slotframe: one Tx link for our EBs, one Rx link for the time source's */
+#ifdef ORCHESTRA_CONF_EBSF_PERIOD
+#define ORCHESTRA_EBSF_PERIOD ORCHESTRA_CONF_EBSF_PERIOD
+#else
+#define ORCHESTRA_EBSF_PERIOD 397
+#endif
+
+/* Common shared slotframe: broadcast, and unicast to neighbors without link.
+ * Set the type to LINK_TYPE_ADVERTISING to also send EBs in it, e.g. when
+ * running it alone as a minimal schedule */
+#ifdef ORCHESTRA_CONF_COMMON_SHARED_PERIOD
+#define ORCHESTRA_COMMON_SHARED_PERIOD ORCHESTRA_CONF_COMMON_SHARED_PERIOD
+#else
+#define ORCHESTRA_COMMON_SHARED_PERIOD 31
+#endif
+
+#ifdef ORCHESTRA_CONF_COMMON_SHARED_TYPE
+#define ORCHESTRA_COMMON_SHARED_TYPE ORCHESTRA_CONF_COMMON_SHARED_TYPE
+#else
+#define ORCHESTRA_COMMON_SHARED_TYPE LINK_TYPE_NORMAL
+#endif
+
+/* Receiver-based unicast: one Rx link per node, shared Tx link to the
+ * time source. Selects the ICMPv6 unicast (RPL DAOs) to the time source */
+#ifdef ORCHESTRA_CONF_RB_PERIOD
+#define ORCHESTRA_RB_PERIOD ORCHESTRA_CONF_RB_PERIOD
+#else
+#define ORCHESTRA_RB_PERIOD 7
+#endif
+
+#ifdef ORCHESTRA_CONF_RB_CHANNEL_OFFSET
+#define ORCHESTRA_RB_CHANNEL_OFFSET ORCHESTRA_CONF_RB_CHANNEL_OFFSET
+#else
+#define ORCHESTRA_RB_CHANNEL_OFFSET 2
+#endif
+
+/* Adapt the receiver-based cell density to the load: a node listens in
+ * 2^level cells per slotframe, level up to ORCHESTRA_RB_ADAPTIVE_MAX_LEVEL.
+ * Every ORCHESTRA_RB_ADAPTIVE_PERIOD, the level goes up when the unicast
+ * received fill ORCHESTRA_RB_ADAPTIVE_HIGH percent of the Rx cells, and
+ * down below ORCHESTRA_RB_ADAPTIVE_LOW percent. Children learn the level of
+ * their time source from its ACK hints, see TSCH_CONF_PACKET_WITH_ACK_HINTS */
+#ifdef ORCHESTRA_CONF_RB_ADAPTIVE
+#define ORCHESTRA_RB_ADAPTIVE ORCHESTRA_CONF_RB_ADAPTIVE
+#else
+#define ORCHESTRA_RB_ADAPTIVE 0
+#endif
+
+#ifdef ORCHESTRA_CONF_RB_ADAPTIVE_MAX_LEVEL
+#define ORCHESTRA_RB_ADAPTIVE_MAX_LEVEL ORCHESTRA_CONF_RB_ADAPTIVE_MAX_LEVEL
+#else
+#define ORCHESTRA_RB_ADAPTIVE_MAX_LEVEL 2
+#endif
+
+#ifdef ORCHESTRA_CONF_RB_ADAPTIVE_PERIOD
+#define ORCHESTRA_RB_ADAPTIVE_PERIOD ORCHESTRA_CONF_RB_ADAPTIVE_PERIOD
+#else
+#define ORCHESTRA_RB_ADAPTIVE_PERIOD (60 * CLOCK_SECOND)
+#endif
+
+#ifdef ORCHESTRA_CONF_RB_ADAPTIVE_HIGH
+#define ORCHESTRA_RB_ADAPTIVE_HIGH ORCHESTRA_CONF_RB_ADAPTIVE_HIGH
+#else
+#define ORCHESTRA_RB_ADAPTIVE_HIGH 50
+#endif
+
+#ifdef ORCHESTRA_CONF_RB_ADAPTIVE_LOW
+#define ORCHESTRA_RB_ADAPTIVE_LOW ORCHESTRA_CONF_RB_ADAPTIVE_LOW
+#else
+#define ORCHESTRA_RB_ADAPTIVE_LOW 15
+#endif
+
+/* Receiver-based unicast for RPL storing mode: also install a shared Tx
+ * link to every child that is the next hop of downward routes */
+#ifdef ORCHESTRA_CONF_RB_STORING
+#define ORCHESTRA_RB_STORING ORCHESTRA_CONF_RB_STORING
+#else
+#define ORCHESTRA_RB_STORING 0
+#endif
+
+/* Sender-based unicast: one Tx link per node, Rx links to the senders we
+ * heard from, removed after ORCHESTRA_SB_LINK_LIFETIME without traffic.
+ * Nodes with index ORCHESTRA_SB_PERIOD and above go to a second slotframe of
+ * ORCHESTRA_SB_PERIOD2 (0: none, all nodes share the first one).
+ * Selects the non-ICMPv6 unicast to neighbors we have a Tx link to */
+#ifdef ORCHESTRA_CONF_SB_PERIOD
+#define ORCHESTRA_SB_PERIOD ORCHESTRA_CONF_SB_PERIOD
+#else
+#define ORCHESTRA_SB_PERIOD 47
+#endif
+
+#ifdef ORCHESTRA_CONF_SB_PERIOD2
+#define ORCHESTRA_SB_PERIOD2 ORCHESTRA_CONF_SB_PERIOD2
+#else
+#define ORCHESTRA_SB_PERIOD2 0
+#endif
+
+/* With a single slotframe, Tx links are shared when it has fewer timeslots
+ * than there are nodes */
+#ifdef ORCHESTRA_CONF_SB_SHARED
+#define ORCHESTRA_SB_SHARED ORCHESTRA_CONF_SB_SHARED
+#elif ORCHESTRA_SB_PERIOD2
+#define ORCHESTRA_SB_SHARED 0
+#else
+#define ORCHESTRA_SB_SHARED (ORCHESTRA_SB_PERIOD < MAX_NODES)
+#endif
+
+#ifdef ORCHESTRA_CONF_SB_CHANNEL_OFFSET
+#define ORCHESTRA_SB_CHANNEL_OFFSET ORCHESTRA_CONF_SB_CHANNEL_OFFSET
+#else
+#define ORCHESTRA_SB_CHANNEL_OFFSET 2
+#endif
+
+#ifdef ORCHESTRA_CONF_SB_CHANNEL_OFFSET2
+#define ORCHESTRA_SB_CHANNEL_OFFSET2 ORCHESTRA_CONF_SB_CHANNEL_OFFSET2
+#else
+#define ORCHESTRA_SB_CHANNEL_OFFSET2 3
+#endif
+
+/* Negotiate sender-based slots with NACKs. A receiver NACKs the frames
+ * of a sender whose timeslot is already taken by another sender it hears
+ * from, and listens to that sender in an alternate slot, derived from
+ * both nodes' indexes. The NACKed sender moves its Tx link to this slot.
+ * Requires TSCH_CALLBACK_DO_NACK and TSCH_CALLBACK_NACK_RECEIVED */
+#ifdef ORCHESTRA_CONF_SB_NACK
+#define ORCHESTRA_SB_NACK ORCHESTRA_CONF_SB_NACK
+#else
+#define ORCHESTRA_SB_NACK 0
+#endif
+
+/* Delete dedicated sender-based links after 2 minutes without traffic */
+#ifdef ORCHESTRA_CONF_SB_LINK_LIFETIME
+#define ORCHESTRA_SB_LINK_LIFETIME ORCHESTRA_CONF_SB_LINK_LIFETIME
+#else
+#define ORCHESTRA_SB_LINK_LIFETIME (2 * 60 * CLOCK_SECOND)
+#endif
+
+/* Period of the sweep removing the expired sender-based links. Links live
+ * up to ORCHESTRA_SB_LINK_LIFETIME + ORCHESTRA_SB_LINK_SWEEP_PERIOD */
+#ifdef ORCHESTRA_CONF_SB_LINK_SWEEP_PERIOD
+#define ORCHESTRA_SB_LINK_SWEEP_PERIOD ORCHESTRA_CONF_SB_LINK_SWEEP_PERIOD
+#else
+#define ORCHESTRA_SB_LINK_SWEEP_PERIOD (10 * CLOCK_SECOND)
+#endif
+
+/* Probing: every node listens in a timeslot of its own, probers add a
+ * shared Tx link to it while a probe is queued. Selects the RPL probes,
+ * see RPL_CALLBACK_PROBE */
+#ifdef ORCHESTRA_CONF_PROBING_PERIOD
+#define ORCHESTRA_PROBING_PERIOD ORCHESTRA_CONF_PROBING_PERIOD
+#else
+#define ORCHESTRA_PROBING_PERIOD 61
+#endif
+
+#ifdef ORCHESTRA_CONF_PROBING_CHANNEL_OFFSET
+#define ORCHESTRA_PROBING_CHANNEL_OFFSET ORCHESTRA_CONF_PROBING_CHANNEL_OFFSET
+#else
+#define ORCHESTRA_PROBING_CHANNEL_OFFSET 5
+#endif
+
+/* Bulk transfers: a receiver listens in a timeslot of its own, the sender
+ * adds a dedicated Tx link to it, for the time of the transfer. A short
+ * slotframe, for throughput. Place the rule before the common shared
+ * slotframe so that its links win, e.g.
+ * { &eb_per_time_source, &bulk, &default_common, &unicast_per_neighbor_rb } */
+#ifdef ORCHESTRA_CONF_BULK_PERIOD
+#define ORCHESTRA_BULK_PERIOD ORCHESTRA_CONF_BULK_PERIOD
+#else
+#define ORCHESTRA_BULK_PERIOD 5
+#endif
+
+#ifdef ORCHESTRA_CONF_BULK_CHANNEL_OFFSET
+#define ORCHESTRA_BULK_CHANNEL_OFFSET ORCHESTRA_CONF_BULK_CHANNEL_OFFSET
+#else
+#define ORCHESTRA_BULK_CHANNEL_OFFSET 6
+#endif
+
+/* Neighbors we transfer to or from at once */
+#ifdef ORCHESTRA_CONF_BULK_MAX_PEERS
+#define ORCHESTRA_BULK_MAX_PEERS ORCHESTRA_CONF_BULK_MAX_PEERS
+#else
+#define ORCHESTRA_BULK_MAX_PEERS 4
+#endif
+
+/* Traffic tracks: every track has a slotframe of its own, where a node
+ * listens in a timeslot of its own and has a shared Tx link to its time
+ * source. Packets to the time source ride the track of their RPL instance,
+ * or the one set with orchestra_track_set_flow for those we originate.
+ * Entries are { RPL instance ID (-1 for none), slotframe length }, track n
+ * being entry n - 1: short slotframes for latency-critical traffic, long
+ * ones for telemetry. Needs SICSLOWPAN_CALLBACK_PACKET_TRACK, see orchestra.h */
+#ifdef ORCHESTRA_CONF_TRACKS
+#define ORCHESTRA_TRACKS ORCHESTRA_CONF_TRACKS
+#else
+#define ORCHESTRA_TRACKS { { -1, 7 }, { -1, 31 } }
+#endif
+
+/* Channel offset of the first track, the others follow */
+#ifdef ORCHESTRA_CONF_TRACK_CHANNEL_OFFSET
+#define ORCHESTRA_TRACK_CHANNEL_OFFSET ORCHESTRA_CONF_TRACK_CHANNEL_OFFSET
+#else
+#define ORCHESTRA_TRACK_CHANNEL_OFFSET 7
+#endif
+
+#endif /* __ORCHESTRA_CONF_H__ */
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/**
+ * \file
+ *         Orchestra rule: temporary cells for bulk transfers, e.g. firmware
+ *         dissemination. A node receiving a transfer listens in a timeslot
+ *         of its own, and the sender adds a dedicated Tx link to it, in a
+ *         short slotframe, for as long as the transfer lasts. Without
+ *         transfers, the slotframe is empty. Selects all unicast to the
+ *         neighbors we transfer to. Driven by orchestra_bulk_start and
+ *         orchestra_bulk_stop.
+ */
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "orchestra.h"
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+#define TIMESLOT(index) ((index) % ORCHESTRA_BULK_PERIOD)
+
+struct bulk_peer {
+  linkaddr_t addr;
+  uint16_t index;
+  /* We send to the peer, rather than receive from it */
+  uint8_t tx;
+};
+
+static uint16_t slotframe_handle;
+static struct tsch_slotframe *sf_bulk;
+static struct bulk_peer peers[ORCHESTRA_BULK_MAX_PEERS];
+static uint8_t peers_count;
+
+/*---------------------------------------------------------------------------*/
+static struct bulk_peer *
+get_peer(const linkaddr_t *addr)
+{
+  int i;
+  for(i = 0; i < peers_count; i++) {
+    if(linkaddr_cmp(&peers[i].addr, addr)) {
+      return &peers[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Options of the link we need at a timeslot, 0 for none. *tx_peer is set
+ * to the first peer we send to at that timeslot */
+static uint8_t
+cell_options(uint16_t timeslot, struct bulk_peer **tx_peer)
+{
+  uint8_t options = 0;
+  int i;
+  *tx_peer = NULL;
+  for(i = 0; i < peers_count; i++) {
+    if(!peers[i].tx) {
+      if(orchestra_own_index() != ORCHESTRA_INDEX_UNKNOWN
+          && TIMESLOT(orchestra_own_index()) == timeslot) {
+        options |= LINK_OPTION_RX;
+      }
+    } else if(TIMESLOT(peers[i].index) == timeslot && *tx_peer == NULL) {
+      options |= LINK_OPTION_TX;
+      *tx_peer = &peers[i];
+    }
+  }
+  return options;
+}
+/*---------------------------------------------------------------------------*/
+static void
+install_cell(uint16_t timeslot)
+{
+  struct bulk_peer *tx_peer;
+  uint8_t options = cell_options(timeslot, &tx_peer);
+  struct tsch_link *l = tsch_schedule_get_link_from_timeslot(sf_bulk, timeslot);
+  if(options != 0 && (l == NULL || l->link_options != options
+      || (tx_peer != NULL && !linkaddr_cmp(tsch_schedule_get_link_addr(l), &tx_peer->addr)))) {
+    /* The receiver's channel offset. Our Tx link wins over our Rx link */
+    uint16_t rx_index = tx_peer != NULL ? tx_peer->index : orchestra_own_index();
+    PRINTF("Orchestra: bulk link at %u, options %x\n", timeslot, options);
+    if(tsch_schedule_add_link(sf_bulk,
+        options,
+        LINK_TYPE_NORMAL,
+        tx_peer != NULL ? &tx_peer->addr : NULL,
+        timeslot,
+        orchestra_channel_offset(ORCHESTRA_BULK_CHANNEL_OFFSET,
+                                 ORCHESTRA_INDEX_UNKNOWN, rx_index)) != NULL) {
+      ORCHESTRA_STATS_INC(sf_bulk, links_added);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Our Rx link while receiving, and a Tx link to every peer we send to */
+static void
+update_links(void)
+{
+  struct bulk_peer *tx_peer;
+  struct tsch_link *l;
+  int batch;
+  int i;
+
+  if(sf_bulk == NULL) {
+    return;
+  }
+  /* Apply all updates at once */
+  batch = tsch_schedule_begin();
+  l = list_head(sf_bulk->links_list);
+  while(l != NULL) {
+    /* Fetch the next link first, as l may be taken out of the list */
+    struct tsch_link *next = list_item_next(l);
+    if(cell_options(l->timeslot, &tx_peer) == 0) {
+      if(tsch_schedule_remove_link(sf_bulk, l)) {
+        ORCHESTRA_STATS_INC(sf_bulk, links_removed);
+      }
+    }
+    l = next;
+  }
+  if(orchestra_own_index() != ORCHESTRA_INDEX_UNKNOWN) {
+    install_cell(TIMESLOT(orchestra_own_index()));
+  }
+  for(i = 0; i < peers_count; i++) {
+    if(peers[i].tx) {
+      install_cell(TIMESLOT(peers[i].index));
+    }
+  }
+  if(batch) {
+    tsch_schedule_commit();
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+orchestra_bulk_start(const linkaddr_t *addr, int tx)
+{
+  struct bulk_peer *p = get_peer(addr);
+  uint16_t index = orchestra_node_index(addr);
+
+  if(index == ORCHESTRA_INDEX_UNKNOWN) {
+    return 0;
+  }
+  if(p == NULL) {
+    if(peers_count == ORCHESTRA_BULK_MAX_PEERS) {
+      return 0;
+    }
+    p = &peers[peers_count++];
+    linkaddr_copy(&p->addr, addr);
+  } else if(p->tx == (tx != 0)) {
+    return 1;
+  }
+  p->index = index;
+  p->tx = tx != 0;
+  update_links();
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+orchestra_bulk_stop(const linkaddr_t *addr)
+{
+  struct bulk_peer *p = get_peer(addr);
+  if(p != NULL) {
+    /* Replace with the last peer */
+    *p = peers[--peers_count];
+    update_links();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+select_packet(uint16_t *slotframe)
+{
+  struct bulk_peer *p = get_peer(packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+  if(p != NULL && p->tx) {
+    *slotframe = slotframe_handle;
+    return 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+init(uint16_t sf_handle)
+{
+  slotframe_handle = sf_handle;
+  sf_bulk = orchestra_add_slotframe(slotframe_handle, ORCHESTRA_BULK_PERIOD);
+  update_links();
+}
+/*---------------------------------------------------------------------------*/
+struct orchestra_rule bulk = {
+  init,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  select_packet,
+  1,
+  "bulk",
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+};
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/**
+ * \file
+ *         Orchestra rule: a slotframe for EBs. Every node sends its EBs in a
+ *         timeslot of its own, and listens to the EBs of its time source
+ *         (and of its backup time source, if any).
+ *
+ * \author Simon Duquennoy <simonduq@sics.se>
+ */
+
+#include "contiki.h"
+#include "orchestra.h"
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+#define TIMESLOT(index) ((index) % ORCHESTRA_EBSF_PERIOD)
+
+static struct tsch_slotframe *sf_eb;
+static uint16_t time_source_index = ORCHESTRA_INDEX_UNKNOWN;
+static uint16_t backup_index = ORCHESTRA_INDEX_UNKNOWN;
+
+/*---------------------------------------------------------------------------*/
+/* Options of the link we need at a timeslot, 0 for none */
+static uint8_t
+cell_options(uint16_t timeslot)
+{
+  uint8_t options = 0;
+  if(TIMESLOT(orchestra_own_index()) == timeslot) {
+    options |= LINK_OPTION_TX;
+  }
+  if((time_source_index != ORCHESTRA_INDEX_UNKNOWN && TIMESLOT(time_source_index) == timeslot)
+      || (backup_index != ORCHESTRA_INDEX_UNKNOWN && TIMESLOT(backup_index) == timeslot)) {
+    options |= LINK_OPTION_RX;
+  }
+  if(ORCHESTRA_COLLISION_AWARE && options == (LINK_OPTION_TX | LINK_OPTION_RX)) {
+    /* Collides with our EB Tx link: Tx when we have an EB, Rx otherwise */
+    options |= LINK_OPTION_SHARED;
+  }
+  return options;
+}
+/*---------------------------------------------------------------------------*/
+static void
+install_cell(uint16_t timeslot)
+{
+  uint8_t options = cell_options(timeslot);
+  struct tsch_link *l = tsch_schedule_get_link_from_timeslot(sf_eb, timeslot);
+  if(l == NULL || l->link_options != options) {
+    PRINTF("Orchestra: EB link at %u, options %x\n", timeslot, options);
+    if(tsch_schedule_add_link(sf_eb,
+        options,
+        LINK_TYPE_ADVERTISING_ONLY,
+        (options & LINK_OPTION_TX) ? &tsch_broadcast_address : NULL,
+        timeslot, 0) != NULL) {
+      ORCHESTRA_STATS_INC(sf_eb, links_added);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Our EB Tx link, and Rx links for the EBs of the time source and backup */
+static void
+update_links(void)
+{
+  struct tsch_link *l;
+  int batch;
+
+  if(sf_eb == NULL) {
+    return;
+  }
+  /* Apply all updates at once */
+  batch = tsch_schedule_begin();
+  l = list_head(sf_eb->links_list);
+  while(l != NULL) {
+    /* Fetch the next link first, as l may be taken out of the list */
+    struct tsch_link *next = list_item_next(l);
+    if(cell_options(l->timeslot) == 0) {
+      if(tsch_schedule_remove_link(sf_eb, l)) {
+        ORCHESTRA_STATS_INC(sf_eb, links_removed);
+      }
+    }
+    l = next;
+  }
+  install_cell(TIMESLOT(orchestra_own_index()));
+  if(time_source_index != ORCHESTRA_INDEX_UNKNOWN) {
+    install_cell(TIMESLOT(time_source_index));
+  }
+  if(backup_index != ORCHESTRA_INDEX_UNKNOWN) {
+    install_cell(TIMESLOT(backup_index));
+  }
+  if(batch) {
+    tsch_schedule_commit();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+new_time_source(const struct tsch_neighbor *old, const struct tsch_neighbor *new)
+{
+  uint16_t new_index = orchestra_node_index(new != NULL ? &new->addr : NULL);
+  if(new_index != time_source_index) {
+    time_source_index = new_index;
+    update_links();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+new_backup_time_source(const struct tsch_neighbor *old, const struct tsch_neighbor *new)
+{
+  uint16_t new_index = orchestra_node_index(new != NULL ? &new->addr : NULL);
+  if(new_index != backup_index) {
+    backup_index = new_index;
+    update_links();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+init(uint16_t slotframe_handle)
+{
+  sf_eb = orchestra_add_slotframe(slotframe_handle, ORCHESTRA_EBSF_PERIOD);
+  /* EB link: every neighbor uses its own to avoid contention */
+  update_links();
+}
+/*---------------------------------------------------------------------------*/
+struct orchestra_rule eb_per_time_source = {
+  init,
+  new_time_source,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  1,
+  "EB per time source",
+  NULL,
+  NULL,
+  new_backup_time_source,
+};
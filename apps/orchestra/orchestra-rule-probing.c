@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/**
+ * \file
+ *         Orchestra rule: cells for RPL probes. Every node listens in a
+ *         timeslot of its own, and a node probing a neighbor adds a Tx link
+ *         to the neighbor's timeslot until the probe is sent. Probes do not
+ *         contend with data in the common shared slotframe. To be run as
+ *         the last rule, so that its links lose to all others on overlap.
+ *         Requires RPL_CALLBACK_PROBE.
+ */
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "orchestra.h"
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+#define TIMESLOT(index) ((index) % ORCHESTRA_PROBING_PERIOD)
+
+static uint16_t slotframe_handle;
+static struct tsch_slotframe *sf_probing;
+/* The neighbor we are probing */
+static uint16_t probe_index = ORCHESTRA_INDEX_UNKNOWN;
+static linkaddr_t probe_addr;
+
+/*---------------------------------------------------------------------------*/
+/* Options of the link we need at a timeslot, 0 for none */
+static uint8_t
+cell_options(uint16_t timeslot)
+{
+  uint8_t options = 0;
+  if(orchestra_own_index() != ORCHESTRA_INDEX_UNKNOWN
+      && TIMESLOT(orchestra_own_index()) == timeslot) {
+    options |= LINK_OPTION_RX;
+  }
+  if(probe_index != ORCHESTRA_INDEX_UNKNOWN && TIMESLOT(probe_index) == timeslot) {
+    /* Others may probe the same neighbor */
+    options |= LINK_OPTION_TX | LINK_OPTION_SHARED;
+  }
+  return options;
+}
+/*---------------------------------------------------------------------------*/
+static void
+install_cell(uint16_t timeslot)
+{
+  uint8_t options = cell_options(timeslot);
+  struct tsch_link *l = tsch_schedule_get_link_from_timeslot(sf_probing, timeslot);
+  if(l == NULL || l->link_options != options) {
+    /* The receiver's channel offset. Our Tx link wins over our Rx link */
+    uint16_t rx_index = (options & LINK_OPTION_TX) ? probe_index : orchestra_own_index();
+    PRINTF("Orchestra: probing link at %u, options %x\n", timeslot, options);
+    if(tsch_schedule_add_link(sf_probing,
+        options,
+        LINK_TYPE_NORMAL,
+        (options & LINK_OPTION_TX) ? &probe_addr : NULL,
+        timeslot,
+        orchestra_channel_offset(ORCHESTRA_PROBING_CHANNEL_OFFSET,
+                                 ORCHESTRA_INDEX_UNKNOWN, rx_index)) != NULL) {
+      ORCHESTRA_STATS_INC(sf_probing, links_added);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Our Rx link, and a Tx link to the neighbor we are probing */
+static void
+update_links(void)
+{
+  struct tsch_link *l;
+  int batch;
+
+  if(sf_probing == NULL) {
+    return;
+  }
+  /* Apply all updates at once */
+  batch = tsch_schedule_begin();
+  l = list_head(sf_probing->links_list);
+  while(l != NULL) {
+    /* Fetch the next link first, as l may be taken out of the list */
+    struct tsch_link *next = list_item_next(l);
+    if(cell_options(l->timeslot) == 0) {
+      if(tsch_schedule_remove_link(sf_probing, l)) {
+        ORCHESTRA_STATS_INC(sf_probing, links_removed);
+      }
+    }
+    l = next;
+  }
+  if(orchestra_own_index() != ORCHESTRA_INDEX_UNKNOWN) {
+    install_cell(TIMESLOT(orchestra_own_index()));
+  }
+  if(probe_index != ORCHESTRA_INDEX_UNKNOWN) {
+    install_cell(TIMESLOT(probe_index));
+  }
+  if(batch) {
+    tsch_schedule_commit();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+probe(const linkaddr_t *addr)
+{
+  uint16_t new_index = orchestra_node_index(addr);
+  if(new_index != probe_index || !linkaddr_cmp(addr, &probe_addr)) {
+    probe_index = new_index;
+    linkaddr_copy(&probe_addr, new_index != ORCHESTRA_INDEX_UNKNOWN ? addr : &linkaddr_null);
+    update_links();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+select_packet(uint16_t *slotframe)
+{
+  /* ICMPv6 unicast to the neighbor we are probing */
+  if(probe_index != ORCHESTRA_INDEX_UNKNOWN
+      && packetbuf_attr(PACKETBUF_ATTR_PROTO) == UIP_PROTO_ICMP6
+      && linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &probe_addr)) {
+    *slotframe = slotframe_handle;
+    return 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+packet_sent(int mac_status)
+{
+  /* The probe is out, whatever its outcome: remove the Tx link */
+  if(probe_index != ORCHESTRA_INDEX_UNKNOWN
+      && packetbuf_attr(PACKETBUF_ATTR_PROTO) == UIP_PROTO_ICMP6
+      && linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &probe_addr)) {
+    probe_index = ORCHESTRA_INDEX_UNKNOWN;
+    linkaddr_copy(&probe_addr, &linkaddr_null);
+    update_links();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+init(uint16_t sf_handle)
+{
+  slotframe_handle = sf_handle;
+  sf_probing = orchestra_add_slotframe(slotframe_handle, ORCHESTRA_PROBING_PERIOD);
+  update_links();
+}
+/*---------------------------------------------------------------------------*/
+struct orchestra_rule probing = {
+  init,
+  NULL,
+  NULL,
+  packet_sent,
+  NULL,
+  select_packet,
+  1,
+  "probing",
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  probe,
+};
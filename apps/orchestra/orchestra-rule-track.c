@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Orchestra rule: traffic tracks, e.g. latency-critical alarms apart
+ *         from telemetry. Every track has a slotframe of its own, where a
+ *         node listens in a timeslot of its own and has a shared Tx link
+ *         to its time source. Selects the packets to the time source that
+ *         have a track, see ORCHESTRA_TRACKS.
+ */
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "net/ip/uip.h"
+#include "net/ipv6/uip-ds6.h"
+#include "net/rpl/rpl.h"
+#include "orchestra.h"
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+#ifdef WITHOUT_ATTR_TRACK
+#error The track rule needs PACKETBUF_ATTR_TRACK
+#endif
+
+#define UIP_IP_BUF ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+struct orchestra_track {
+  /* RPL instance ID of the track, -1 for none */
+  int16_t instance_id;
+  uint16_t period;
+};
+
+static const struct orchestra_track tracks[] = ORCHESTRA_TRACKS;
+#define NUM_TRACKS (sizeof(tracks) / sizeof(tracks[0]))
+
+static uint16_t slotframe_handle;
+static struct tsch_slotframe *sf_tracks[NUM_TRACKS];
+static linkaddr_t time_source_addr;
+static uint16_t time_source_index = ORCHESTRA_INDEX_UNKNOWN;
+static uint8_t flow_track;
+
+/*---------------------------------------------------------------------------*/
+/* Receiver-based links of a track: our Rx link, and a shared Tx link to
+ * the time source. Our Tx link wins over our Rx link */
+static void
+update_track_links(int i)
+{
+  struct tsch_slotframe *sf = sf_tracks[i];
+  uint16_t own_index = orchestra_own_index();
+  uint16_t rx_timeslot = 0xffff;
+  uint16_t tx_timeslot = 0xffff;
+  uint8_t tx_options;
+  struct tsch_link *l;
+
+  if(sf == NULL) {
+    return;
+  }
+  if(own_index != ORCHESTRA_INDEX_UNKNOWN) {
+    rx_timeslot = own_index % tracks[i].period;
+  }
+  if(time_source_index != ORCHESTRA_INDEX_UNKNOWN) {
+    tx_timeslot = time_source_index % tracks[i].period;
+  }
+
+  l = list_head(sf->links_list);
+  while(l != NULL) {
+    /* Fetch the next link first, as l may be taken out of the list */
+    struct tsch_link *next = list_item_next(l);
+    if(l->timeslot != rx_timeslot && l->timeslot != tx_timeslot) {
+      if(tsch_schedule_remove_link(sf, l)) {
+        ORCHESTRA_STATS_INC(sf, links_removed);
+      }
+    }
+    l = next;
+  }
+
+  tx_options = LINK_OPTION_TX | LINK_OPTION_SHARED
+    | (tx_timeslot == rx_timeslot ? LINK_OPTION_RX : 0);
+  l = tsch_schedule_get_link_from_timeslot(sf, tx_timeslot);
+  if(tx_timeslot != 0xffff && (l == NULL || l->link_options != tx_options
+      || !linkaddr_cmp(tsch_schedule_get_link_addr(l), &time_source_addr))) {
+    if(tsch_schedule_add_link(sf, tx_options,
+        LINK_TYPE_NORMAL, &time_source_addr, tx_timeslot,
+        orchestra_channel_offset(ORCHESTRA_TRACK_CHANNEL_OFFSET + i,
+                                 own_index, time_source_index)) != NULL) {
+      ORCHESTRA_STATS_INC(sf, links_added);
+    }
+  }
+  if(rx_timeslot != 0xffff && rx_timeslot != tx_timeslot
+     && tsch_schedule_get_link_from_timeslot(sf, rx_timeslot) == NULL) {
+    if(tsch_schedule_add_link(sf,
+        LINK_OPTION_RX,
+        LINK_TYPE_NORMAL, &tsch_broadcast_address, rx_timeslot,
+        orchestra_channel_offset(ORCHESTRA_TRACK_CHANNEL_OFFSET + i,
+                                 ORCHESTRA_INDEX_UNKNOWN, own_index)) != NULL) {
+      ORCHESTRA_STATS_INC(sf, links_added);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_links(void)
+{
+  int batch;
+  int i;
+
+  /* Apply all updates at once */
+  batch = tsch_schedule_begin();
+  for(i = 0; i < NUM_TRACKS; i++) {
+    update_track_links(i);
+  }
+  if(batch) {
+    tsch_schedule_commit();
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+orchestra_track_set_flow(uint8_t track)
+{
+  if(track > NUM_TRACKS) {
+    return 0;
+  }
+  flow_track = track;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+orchestra_callback_packet_track(void)
+{
+  int instance_id;
+  int i;
+
+  if(flow_track != 0 && uip_ds6_is_my_addr(&UIP_IP_BUF->srcipaddr)) {
+    return flow_track;
+  }
+  instance_id = rpl_get_header_instance();
+  if(instance_id >= 0) {
+    for(i = 0; i < NUM_TRACKS; i++) {
+      if(tracks[i].instance_id == instance_id) {
+        return i + 1;
+      }
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+orchestra_track_packet_class(void)
+{
+  if(packetbuf_attr(PACKETBUF_ATTR_PROTO) == UIP_PROTO_ICMP6
+     || packetbuf_datalen() == 0) {
+    return 0;
+  }
+  if(packetbuf_attr(PACKETBUF_ATTR_TRACK) != 0) {
+    return packetbuf_attr(PACKETBUF_ATTR_TRACK);
+  }
+  /* The last class */
+  return 0xff;
+}
+/*---------------------------------------------------------------------------*/
+static int
+select_packet(uint16_t *slotframe)
+{
+  uint8_t t = packetbuf_attr(PACKETBUF_ATTR_TRACK);
+  if(t != 0 && t <= NUM_TRACKS && sf_tracks[t - 1] != NULL
+     && time_source_index != ORCHESTRA_INDEX_UNKNOWN
+     && linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &time_source_addr)) {
+    *slotframe = slotframe_handle + t - 1;
+    return 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+new_time_source(const struct tsch_neighbor *old, const struct tsch_neighbor *new)
+{
+  uint16_t new_index = orchestra_node_index(new != NULL ? &new->addr : NULL);
+
+  if(new_index == time_source_index) {
+    return;
+  }
+  PRINTF("Orchestra: track time source %u -> %u\n", time_source_index, new_index);
+  time_source_index = new_index;
+  linkaddr_copy(&time_source_addr, new_index != ORCHESTRA_INDEX_UNKNOWN ? &new->addr : &linkaddr_null);
+  update_links();
+}
+/*---------------------------------------------------------------------------*/
+static void
+init(uint16_t sf_handle)
+{
+  int i;
+
+  slotframe_handle = sf_handle;
+  for(i = 0; i < NUM_TRACKS; i++) {
+    sf_tracks[i] = orchestra_add_slotframe(slotframe_handle + i, tracks[i].period);
+  }
+  update_links();
+}
+/*---------------------------------------------------------------------------*/
+struct orchestra_rule track = {
+  init,
+  new_time_source,
+  NULL,
+  NULL,
+  NULL,
+  select_packet,
+  NUM_TRACKS,
+  "track",
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+};
@@ -0,0 +1,389 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/**
+ * \file
+ *         Orchestra rule: receiver-based unicast. Every node listens in a
+ *         timeslot of its own, and has a shared Tx link in the timeslot of
+ *         its time source.
+ *         With ORCHESTRA_RB_ADAPTIVE, a node listens in up to
+ *         2^ORCHESTRA_RB_ADAPTIVE_MAX_LEVEL cells per slotframe depending
+ *         on the unicast it receives, and tells its children in ACK hints.
+ *         With ORCHESTRA_RB_STORING, a node also has a shared Tx link in
+ *         the timeslot of every child with downward routes through it.
+ *         A node also has a shared Tx link to its backup time source, if any.
+ *
+ * \author Simon Duquennoy <simonduq@sics.se>
+ */
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "sys/ctimer.h"
+#include "orchestra.h"
+#if ORCHESTRA_RB_STORING
+#include "net/ipv6/uip-ds6-route.h"
+#include "net/ipv6/uip-ds6-nbr.h"
+#endif /* ORCHESTRA_RB_STORING */
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+#define TIMESLOT(index) ((index) % ORCHESTRA_RB_PERIOD)
+/* Timeslot of the j-th of the 2^level cells of a node */
+#define CELL(index, level, j) TIMESLOT((index) + (j) * (ORCHESTRA_RB_PERIOD >> (level)))
+
+#if ORCHESTRA_RB_ADAPTIVE
+#if !TSCH_PACKET_WITH_ACK_HINTS
+#error ORCHESTRA_RB_ADAPTIVE requires TSCH_CONF_PACKET_WITH_ACK_HINTS
+#endif
+#if (1 << ORCHESTRA_RB_ADAPTIVE_MAX_LEVEL) > ORCHESTRA_RB_PERIOD
+#error ORCHESTRA_RB_ADAPTIVE_MAX_LEVEL too large for ORCHESTRA_RB_PERIOD
+#endif
+/* Our density level goes in ACK hint flags */
+#define ACK_HINT_LEVEL_SHIFT TSCH_ACK_HINT_USER_SHIFT
+#define ACK_HINT_LEVEL_MASK 0x03
+/* Cell capacity of a single cell over an adaptation period */
+#define CYCLES_PER_PERIOD (TSCH_CLOCK_TO_SLOTS(ORCHESTRA_RB_ADAPTIVE_PERIOD) / ORCHESTRA_RB_PERIOD)
+
+static uint8_t rx_level; /* We listen in 2^rx_level cells */
+static uint8_t tx_level; /* The time source listens in 2^tx_level cells */
+static uint16_t rx_count; /* Unicast received in the current period */
+static struct ctimer adapt_timer;
+#else /* ORCHESTRA_RB_ADAPTIVE */
+#define rx_level 0
+#define tx_level 0
+#endif /* ORCHESTRA_RB_ADAPTIVE */
+
+static uint16_t slotframe_handle;
+static struct tsch_slotframe *sf_rb;
+static linkaddr_t time_source_addr;
+static uint16_t time_source_index = ORCHESTRA_INDEX_UNKNOWN;
+static linkaddr_t backup_addr;
+static uint16_t backup_index = ORCHESTRA_INDEX_UNKNOWN;
+
+#if ORCHESTRA_RB_STORING
+static struct uip_ds6_notification route_notification;
+static struct ctimer route_timer;
+static void update_links(void);
+
+/*---------------------------------------------------------------------------*/
+/* Link-layer address of the next hop of a route, NULL if unknown */
+static const linkaddr_t *
+route_child(uip_ds6_route_t *r)
+{
+  uip_ipaddr_t *nexthop = uip_ds6_route_nexthop(r);
+  return nexthop != NULL ? (const linkaddr_t *)uip_ds6_nbr_lladdr_from_ipaddr(nexthop) : NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* The first child with downward routes whose cell is at a timeslot, or NULL */
+static const linkaddr_t *
+child_at(uint16_t timeslot)
+{
+  uip_ds6_route_t *r;
+  for(r = uip_ds6_route_head(); r != NULL; r = uip_ds6_route_next(r)) {
+    uint16_t index = orchestra_node_index(route_child(r));
+    if(index != ORCHESTRA_INDEX_UNKNOWN && TIMESLOT(index) == timeslot) {
+      return route_child(r);
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+route_changed(void *ptr)
+{
+  update_links();
+}
+/*---------------------------------------------------------------------------*/
+static void
+route_callback(int event, uip_ipaddr_t *route, uip_ipaddr_t *nexthop, int num_routes)
+{
+  /* Routes are removed only after the notification: update afterwards,
+   * and only once for a burst of changes (e.g. a DAO) */
+  if(event == UIP_DS6_NOTIFICATION_ROUTE_ADD || event == UIP_DS6_NOTIFICATION_ROUTE_RM) {
+    if(ctimer_expired(&route_timer)) {
+      ctimer_set(&route_timer, CLOCK_SECOND / 8, route_changed, NULL);
+    }
+  }
+}
+#endif /* ORCHESTRA_RB_STORING */
+
+/*---------------------------------------------------------------------------*/
+/* Options of the link we need at a timeslot, 0 for none, and its address */
+static uint8_t
+cell_options(uint16_t timeslot, const linkaddr_t **addr)
+{
+  uint8_t options = 0;
+  int j;
+  *addr = &tsch_broadcast_address;
+  for(j = 0; j < (1 << rx_level); j++) {
+    if(CELL(orchestra_own_index(), rx_level, j) == timeslot) {
+      options |= LINK_OPTION_RX;
+    }
+  }
+  if(time_source_index != ORCHESTRA_INDEX_UNKNOWN) {
+    for(j = 0; j < (1 << tx_level); j++) {
+      if(CELL(time_source_index, tx_level, j) == timeslot) {
+        options |= LINK_OPTION_TX | LINK_OPTION_SHARED;
+        *addr = &time_source_addr;
+      }
+    }
+  }
+  if(!(options & LINK_OPTION_TX) && backup_index != ORCHESTRA_INDEX_UNKNOWN
+      && TIMESLOT(backup_index) == timeslot) {
+    /* The backup time source listens at least in its first cell */
+    options |= LINK_OPTION_TX | LINK_OPTION_SHARED;
+    *addr = &backup_addr;
+  }
+#if ORCHESTRA_RB_STORING
+  if(!(options & LINK_OPTION_TX)) {
+    /* Children listen at least in their first cell */
+    const linkaddr_t *child = child_at(timeslot);
+    if(child != NULL) {
+      options |= LINK_OPTION_TX | LINK_OPTION_SHARED;
+      *addr = child;
+    }
+  }
+#endif /* ORCHESTRA_RB_STORING */
+  return options;
+}
+/*---------------------------------------------------------------------------*/
+static void
+install_cell(uint16_t timeslot)
+{
+  const linkaddr_t *addr;
+  uint8_t options = cell_options(timeslot, &addr);
+  struct tsch_link *l = tsch_schedule_get_link_from_timeslot(sf_rb, timeslot);
+  /* The cell is on the receiver's channel offset. When we both Tx and Rx
+   * in it, the Tx to the other receiver wins */
+  uint16_t choffset = orchestra_channel_offset(ORCHESTRA_RB_CHANNEL_OFFSET, ORCHESTRA_INDEX_UNKNOWN,
+      (options & LINK_OPTION_TX) ? orchestra_node_index(addr) : orchestra_own_index());
+  if(l == NULL || l->link_options != options || l->channel_offset != choffset
+      || !linkaddr_cmp(tsch_schedule_get_link_addr(l), addr)) {
+    PRINTF("Orchestra: rb link at %u, options %x\n", timeslot, options);
+    if(l != NULL && l->channel_offset != choffset && tsch_schedule_remove_link(sf_rb, l)) {
+      /* Moves to another offset: not replaced by a link of the new one */
+      ORCHESTRA_STATS_INC(sf_rb, links_removed);
+    }
+    if(tsch_schedule_add_link(sf_rb,
+        options,
+        LINK_TYPE_NORMAL, addr,
+        timeslot, choffset) != NULL) {
+      ORCHESTRA_STATS_INC(sf_rb, links_added);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Bring the slotframe in line with our cells and the time source's */
+static void
+update_links(void)
+{
+  struct tsch_link *l;
+  int batch;
+  int j;
+
+  if(sf_rb == NULL) {
+    return;
+  }
+  /* Apply all updates at once */
+  batch = tsch_schedule_begin();
+  l = list_head(sf_rb->links_list);
+  while(l != NULL) {
+    /* Fetch the next link first, as l may be taken out of the list */
+    struct tsch_link *next = list_item_next(l);
+    const linkaddr_t *addr;
+    if(cell_options(l->timeslot, &addr) == 0) {
+      if(tsch_schedule_remove_link(sf_rb, l)) {
+        ORCHESTRA_STATS_INC(sf_rb, links_removed);
+      }
+    }
+    l = next;
+  }
+  for(j = 0; j < (1 << rx_level); j++) {
+    install_cell(CELL(orchestra_own_index(), rx_level, j));
+  }
+  if(time_source_index != ORCHESTRA_INDEX_UNKNOWN) {
+    for(j = 0; j < (1 << tx_level); j++) {
+      install_cell(CELL(time_source_index, tx_level, j));
+    }
+  }
+  if(backup_index != ORCHESTRA_INDEX_UNKNOWN) {
+    install_cell(TIMESLOT(backup_index));
+  }
+#if ORCHESTRA_RB_STORING
+  {
+    uip_ds6_route_t *r;
+    for(r = uip_ds6_route_head(); r != NULL; r = uip_ds6_route_next(r)) {
+      uint16_t index = orchestra_node_index(route_child(r));
+      if(index != ORCHESTRA_INDEX_UNKNOWN) {
+        install_cell(TIMESLOT(index));
+      }
+    }
+  }
+#endif /* ORCHESTRA_RB_STORING */
+  if(batch) {
+    tsch_schedule_commit();
+  }
+}
+/*---------------------------------------------------------------------------*/
+#if ORCHESTRA_RB_ADAPTIVE
+static void
+adapt(void *ptr)
+{
+  /* Load of our Rx cells over the last period, in percent */
+  uint32_t load = (uint32_t)rx_count * 100 / ((uint32_t)CYCLES_PER_PERIOD << rx_level);
+  uint8_t level = rx_level;
+  if(load >= ORCHESTRA_RB_ADAPTIVE_HIGH && rx_level < ORCHESTRA_RB_ADAPTIVE_MAX_LEVEL) {
+    level++;
+  } else if(load < ORCHESTRA_RB_ADAPTIVE_LOW && rx_level > 0) {
+    level--;
+  }
+  if(level != rx_level) {
+    PRINTF("Orchestra: rb load %lu%%, level %u -> %u\n", (unsigned long)load, rx_level, level);
+    rx_level = level;
+    update_links();
+  }
+  rx_count = 0;
+  ctimer_reset(&adapt_timer);
+}
+/*---------------------------------------------------------------------------*/
+static void
+packet_received(void)
+{
+  if(!linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &linkaddr_null)) {
+    rx_count++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+ack_hints(struct tsch_link *link, linkaddr_t *src)
+{
+  /* Called from interrupt: only reads rx_level */
+  return rx_level << ACK_HINT_LEVEL_SHIFT;
+}
+/*---------------------------------------------------------------------------*/
+static void
+ack_hints_received(const linkaddr_t *dest, const struct tsch_ack_hints *hints)
+{
+  uint8_t level = (hints->flags >> ACK_HINT_LEVEL_SHIFT) & ACK_HINT_LEVEL_MASK;
+  if(time_source_index != ORCHESTRA_INDEX_UNKNOWN && linkaddr_cmp(dest, &time_source_addr)
+      && level != tx_level && level <= ORCHESTRA_RB_ADAPTIVE_MAX_LEVEL) {
+    PRINTF("Orchestra: time source rb level %u -> %u\n", tx_level, level);
+    tx_level = level;
+    update_links();
+  }
+}
+#endif /* ORCHESTRA_RB_ADAPTIVE */
+/*---------------------------------------------------------------------------*/
+static int
+select_packet(uint16_t *slotframe)
+{
+  /* ICMPv6 (RPL DAOs) to the time source */
+  struct tsch_neighbor *n = tsch_queue_get_time_source();
+  if(n != NULL && packetbuf_attr(PACKETBUF_ATTR_PROTO) == UIP_PROTO_ICMP6
+      && linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &n->addr)) {
+    *slotframe = slotframe_handle;
+    return 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+new_time_source(const struct tsch_neighbor *old, const struct tsch_neighbor *new)
+{
+  uint16_t new_index = orchestra_node_index(new != NULL ? &new->addr : NULL);
+
+  if(new_index == time_source_index) {
+    return;
+  }
+  /* Shared-slot: move the unicast Tx links to the new time source. Until
+   * it tells otherwise, it listens in a single cell */
+  PRINTF("Orchestra: rb time source %u -> %u\n", time_source_index, new_index);
+  time_source_index = new_index;
+  linkaddr_copy(&time_source_addr, new_index != ORCHESTRA_INDEX_UNKNOWN ? &new->addr : &linkaddr_null);
+#if ORCHESTRA_RB_ADAPTIVE
+  tx_level = 0;
+#endif /* ORCHESTRA_RB_ADAPTIVE */
+  update_links();
+}
+/*---------------------------------------------------------------------------*/
+static void
+new_backup_time_source(const struct tsch_neighbor *old, const struct tsch_neighbor *new)
+{
+  uint16_t new_index = orchestra_node_index(new != NULL ? &new->addr : NULL);
+
+  if(new_index == backup_index) {
+    return;
+  }
+  /* Keep a shared Tx link to the backup, so that a switch to it costs no capacity */
+  PRINTF("Orchestra: rb backup time source %u -> %u\n", backup_index, new_index);
+  backup_index = new_index;
+  linkaddr_copy(&backup_addr, new_index != ORCHESTRA_INDEX_UNKNOWN ? &new->addr : &linkaddr_null);
+  update_links();
+}
+/*---------------------------------------------------------------------------*/
+static void
+init(uint16_t handle)
+{
+  slotframe_handle = handle;
+  sf_rb = orchestra_add_slotframe(slotframe_handle, ORCHESTRA_RB_PERIOD);
+  /* Rx link, dedicated to us. Tx links are added from new_time_source */
+  update_links();
+#if ORCHESTRA_RB_STORING
+  /* Tx links to the children follow the routing table */
+  uip_ds6_notification_add(&route_notification, route_callback);
+#endif /* ORCHESTRA_RB_STORING */
+#if ORCHESTRA_RB_ADAPTIVE
+  ctimer_set(&adapt_timer, ORCHESTRA_RB_ADAPTIVE_PERIOD, adapt, NULL);
+#endif /* ORCHESTRA_RB_ADAPTIVE */
+}
+/*---------------------------------------------------------------------------*/
+struct orchestra_rule unicast_per_neighbor_rb = {
+  init,
+  new_time_source,
+  NULL,
+  NULL,
+#if ORCHESTRA_RB_ADAPTIVE
+  packet_received,
+#else
+  NULL,
+#endif
+  select_packet,
+  1,
+  "unicast per neighbor, receiver-based",
+#if ORCHESTRA_RB_ADAPTIVE
+  ack_hints,
+  ack_hints_received,
+#else
+  NULL,
+  NULL,
+#endif
+  new_backup_time_source,
+};
@@ -0,0 +1,599 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/**
+ * \file
+ *         Orchestra rule: sender-based unicast. Every node transmits in a
+ *         timeslot of its own. Tx links are added upon successful unicast
+ *         Tx and Rx links upon unicast Rx, and expire without traffic.
+ *         With ORCHESTRA_SB_NACK, a sender whose timeslot is taken at the
+ *         receiver gets NACKed, and both move to an alternate timeslot.
+ *
+ * \author Simon Duquennoy <simonduq@sics.se>
+ */
+
+#include "contiki.h"
+#include "lib/memb.h"
+#include "sys/ctimer.h"
+#include "net/packetbuf.h"
+#include "orchestra.h"
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+/* ORCHESTRA_SB_LINK_LIFETIME unless set at runtime */
+static clock_time_t link_lifetime = ORCHESTRA_SB_LINK_LIFETIME;
+#define LINK_LIFETIME TSCH_CLOCK_TO_SLOTS(link_lifetime)
+/* Rx links remember their sender, to negotiate or to get its channel offset */
+#define WITH_RX_INDEX (ORCHESTRA_SB_NACK || ORCHESTRA_CHANNEL_DIVERSITY)
+
+#if ORCHESTRA_SB_NACK && !(defined(TSCH_CALLBACK_DO_NACK) && defined(TSCH_CALLBACK_NACK_RECEIVED))
+#error ORCHESTRA_SB_NACK requires TSCH_CALLBACK_DO_NACK and TSCH_CALLBACK_NACK_RECEIVED
+#endif
+
+static struct tsch_slotframe *sf_sb;
+#if ORCHESTRA_SB_PERIOD2
+static struct tsch_slotframe *sf_sb2;
+#endif
+
+struct link_timestamps {
+  uint32_t last_tx;
+  uint32_t last_rx;
+#if WITH_RX_INDEX
+  /* The sender we listen to in the Rx link */
+  uint16_t rx_index;
+#endif
+};
+MEMB_FREE_LIST(nbr_timestamps, struct link_timestamps, TSCH_MAX_LINKS);
+
+static struct ctimer sweep_timer;
+
+#if ORCHESTRA_SB_NACK
+/* The alternate slot of a sender towards a receiver, never its own slot */
+#define NUM_INDEXES (ORCHESTRA_SB_PERIOD + ORCHESTRA_SB_PERIOD2)
+#define ALT_INDEX(src, dst) ((src) % NUM_INDEXES + 1 + (dst) % (NUM_INDEXES - 1))
+#define IS_FRESH(t) (current_asn.ls4b - (t) <= LINK_LIFETIME)
+/* The receiver that NACKed us in our own slot, and the last Tx to it */
+static linkaddr_t alt_dest;
+static uint32_t alt_last_tx;
+#endif /* ORCHESTRA_SB_NACK */
+
+/*---------------------------------------------------------------------------*/
+/* Get the slotframe, timeslot and channel offset of a node's Tx link */
+static struct tsch_slotframe *
+get_node_link(uint16_t index, uint16_t *timeslot, uint16_t *choffset)
+{
+#if ORCHESTRA_SB_PERIOD2
+  /* The two slotframes make a single space of PERIOD + PERIOD2 indexes */
+  index %= ORCHESTRA_SB_PERIOD + ORCHESTRA_SB_PERIOD2;
+  if(index >= ORCHESTRA_SB_PERIOD) {
+    *timeslot = index - ORCHESTRA_SB_PERIOD;
+    *choffset = ORCHESTRA_SB_CHANNEL_OFFSET2;
+    return sf_sb2;
+  }
+#endif
+  *timeslot = index % ORCHESTRA_SB_PERIOD;
+  *choffset = ORCHESTRA_SB_CHANNEL_OFFSET;
+  return sf_sb;
+}
+/*---------------------------------------------------------------------------*/
+#if ORCHESTRA_SB_NACK
+/* The sender we listen to in the Rx link of an index, if we heard from it
+ * within the link lifetime. ORCHESTRA_INDEX_UNKNOWN otherwise */
+static uint16_t
+rx_owner(uint16_t index)
+{
+  uint16_t timeslot;
+  uint16_t choffset;
+  struct tsch_slotframe *sf = get_node_link(index, &timeslot, &choffset);
+  struct tsch_link *l = sf != NULL ? tsch_schedule_get_link_from_timeslot(sf, timeslot) : NULL;
+  struct link_timestamps *ts = l != NULL ? tsch_schedule_get_link_data(l) : NULL;
+  if(ts != NULL && (l->link_options & LINK_OPTION_RX) && IS_FRESH(ts->last_rx)) {
+    return ts->rx_index;
+  }
+  return ORCHESTRA_INDEX_UNKNOWN;
+}
+#endif /* ORCHESTRA_SB_NACK */
+/*---------------------------------------------------------------------------*/
+/* The index of the slot we transmit to a neighbor in */
+static uint16_t
+tx_index(const linkaddr_t *dest)
+{
+#if ORCHESTRA_SB_NACK
+  if(linkaddr_cmp(dest, &alt_dest) && IS_FRESH(alt_last_tx)) {
+    return ALT_INDEX(orchestra_own_index(), orchestra_node_index(dest));
+  }
+#endif /* ORCHESTRA_SB_NACK */
+  return orchestra_own_index();
+}
+/*---------------------------------------------------------------------------*/
+/* The index of the slot a neighbor transmits to us in */
+static uint16_t
+rx_index(uint16_t src_index)
+{
+#if ORCHESTRA_SB_NACK
+  uint16_t alt = ALT_INDEX(src_index, orchestra_own_index());
+  uint16_t owner;
+  if(rx_owner(alt) == src_index) {
+    /* Already moved */
+    return alt;
+  }
+  owner = rx_owner(src_index);
+  if(owner != ORCHESTRA_INDEX_UNKNOWN && owner != src_index) {
+    /* Its own slot is taken: we NACK it there, see do_nack */
+    return alt;
+  }
+#endif /* ORCHESTRA_SB_NACK */
+  return src_index;
+}
+/*---------------------------------------------------------------------------*/
+static void
+joining_network_sf(struct tsch_slotframe *sf)
+{
+  /* Cleanup sf: reset timestamps. Old links remain active for LINK_LIFETIME */
+  struct tsch_link *l = list_head(sf->links_list);
+  while(l != NULL) {
+    struct link_timestamps *ts = (struct link_timestamps *)tsch_schedule_get_link_data(l);
+    if(ts != NULL) {
+      ts->last_tx = ts->last_rx = current_asn.ls4b;
+    }
+    l = list_item_next(l);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+joining_network(void)
+{
+  if(sf_sb == NULL) {
+    return;
+  }
+  joining_network_sf(sf_sb);
+#if ORCHESTRA_SB_PERIOD2
+  joining_network_sf(sf_sb2);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+#if TSCH_SCHEDULE_WITH_STORE
+static void
+restore_timestamps_sf(struct tsch_slotframe *sf)
+{
+  /* Links restored from a schedule snapshot have no timestamps. Give them
+   * some, so they expire as usual. They are reset when joining a network. */
+  struct tsch_link *l = list_head(sf->links_list);
+  while(l != NULL) {
+    if(tsch_schedule_get_link_data(l) == NULL) {
+      struct link_timestamps *ts = memb_alloc(&nbr_timestamps);
+      if(ts != NULL) {
+        ts->last_tx = ts->last_rx = current_asn.ls4b;
+#if WITH_RX_INDEX
+        ts->rx_index = ORCHESTRA_INDEX_UNKNOWN;
+#endif
+        if(!tsch_schedule_set_link_data(l, ts)) {
+          memb_free(&nbr_timestamps, ts);
+        }
+      }
+    }
+    l = list_item_next(l);
+  }
+}
+#endif /* TSCH_SCHEDULE_WITH_STORE */
+/*---------------------------------------------------------------------------*/
+/* Drops the Tx option of a link we also Rx in, which goes back to the
+ * channel offset of its sender. Returns the updated link (NULL if failure) */
+static struct tsch_link *
+remove_tx_option(struct tsch_slotframe *sf, struct tsch_link *l, struct link_timestamps *ts)
+{
+  uint8_t link_options = l->link_options & ~(LINK_OPTION_TX | LINK_OPTION_SHARED);
+  uint16_t timeslot = l->timeslot;
+  uint16_t choffset = l->channel_offset;
+#if ORCHESTRA_CHANNEL_DIVERSITY
+  if(ts != NULL && ts->rx_index != ORCHESTRA_INDEX_UNKNOWN) {
+    choffset = orchestra_channel_offset(choffset, ts->rx_index, orchestra_own_index());
+  }
+  if(choffset != l->channel_offset && tsch_schedule_remove_link(sf, l)) {
+    ORCHESTRA_STATS_INC(sf, links_removed);
+  }
+#endif /* ORCHESTRA_CHANNEL_DIVERSITY */
+  return tsch_schedule_add_link(sf,
+      link_options,
+      LINK_TYPE_NORMAL, &linkaddr_null,
+      timeslot, choffset);
+}
+/*---------------------------------------------------------------------------*/
+static void
+delete_old_links_sf(struct tsch_slotframe *sf)
+{
+  struct tsch_link *l = list_head(sf->links_list);
+  /* Loop over all links and remove old ones. */
+  while(l != NULL) {
+    /* Fetch the next link first, as l may be taken out of the list */
+    struct tsch_link *next = list_item_next(l);
+    struct tsch_link *new_link = NULL;
+    struct link_timestamps *ts = (struct link_timestamps *)tsch_schedule_get_link_data(l);
+    if(ts != NULL) {
+      int tx_outdated = current_asn.ls4b - ts->last_tx > LINK_LIFETIME;
+      int rx_outdated = current_asn.ls4b - ts->last_rx > LINK_LIFETIME;
+      if(tx_outdated && rx_outdated) {
+        /* Link outdated both for tx and rx, delete */
+        PRINTF("Orchestra: removing link at %u\n", l->timeslot);
+        tsch_schedule_set_link_data(l, NULL);
+        if(tsch_schedule_remove_link(sf, l)) {
+          ORCHESTRA_STATS_INC(sf, links_removed);
+        }
+        ORCHESTRA_STATS_INC(sf, links_expired);
+        memb_free(&nbr_timestamps, ts);
+      } else if(!rx_outdated && tx_outdated && (l->link_options & LINK_OPTION_TX)) {
+        PRINTF("Orchestra: removing tx flag at %u\n", l->timeslot);
+        /* Link outdated for tx, update */
+        new_link = remove_tx_option(sf, l, ts);
+      } else if(!tx_outdated && rx_outdated && (l->link_options & LINK_OPTION_RX)) {
+        PRINTF("Orchestra: removing rx flag at %u\n", l->timeslot);
+        /* Link outdated for rx, update */
+        linkaddr_t link_addr;
+        linkaddr_copy(&link_addr, tsch_schedule_get_link_addr(l));
+        new_link = tsch_schedule_add_link(sf,
+            l->link_options & ~(LINK_OPTION_RX
+                | (ORCHESTRA_SB_SHARED ? 0 : LINK_OPTION_SHARED)),
+            LINK_TYPE_NORMAL, &link_addr,
+            l->timeslot, l->channel_offset);
+      }
+      if(new_link != NULL) {
+        ORCHESTRA_STATS_INC(sf, links_expired);
+        /* Carry the timestamps over to the updated link */
+        tsch_schedule_set_link_data(new_link, ts);
+      }
+    }
+    l = next;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+delete_old_links(void *ptr)
+{
+  /* Apply all updates at once */
+  int batch = tsch_schedule_begin();
+  delete_old_links_sf(sf_sb);
+#if ORCHESTRA_SB_PERIOD2
+  delete_old_links_sf(sf_sb2);
+#endif
+  if(batch) {
+    tsch_schedule_commit();
+  }
+  ctimer_reset(&sweep_timer);
+}
+/*---------------------------------------------------------------------------*/
+static int
+select_packet(uint16_t *slotframe)
+{
+  /* Non-ICMPv6 unicast to the neighbors we have a Tx link to */
+  const linkaddr_t *dest = packetbuf_addr(PACKETBUF_ADDR_RECEIVER);
+  uint16_t timeslot;
+  uint16_t choffset;
+  struct tsch_slotframe *sf;
+  struct tsch_link *l;
+
+  if(packetbuf_attr(PACKETBUF_ATTR_PROTO) == UIP_PROTO_ICMP6
+      || linkaddr_cmp(dest, &linkaddr_null)) {
+    return 0;
+  }
+  sf = get_node_link(tx_index(dest), &timeslot, &choffset);
+  l = sf != NULL ? tsch_schedule_get_link_from_timeslot(sf, timeslot) : NULL;
+  if(l != NULL && (l->link_options & LINK_OPTION_TX)
+      && linkaddr_cmp(tsch_schedule_get_link_addr(l), dest)) {
+    *slotframe = sf->handle;
+    return 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+packet_received(void)
+{
+  uint16_t src_index;
+  uint16_t timeslot;
+  uint16_t choffset;
+  struct tsch_slotframe *sf;
+
+  if(sf_sb == NULL || packetbuf_attr(PACKETBUF_ATTR_PROTO) == UIP_PROTO_ICMP6) {
+    /* Filter out ICMP */
+    return;
+  }
+
+  src_index = orchestra_node_index(packetbuf_addr(PACKETBUF_ADDR_SENDER));
+  if(src_index != ORCHESTRA_INDEX_UNKNOWN
+      && !linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &linkaddr_null)) {
+    /* Successful unicast Rx
+     * We schedule a Rx link to listen to the source's dedicated slot */
+    linkaddr_t link_addr;
+    struct link_timestamps *ts;
+    uint8_t link_options = LINK_OPTION_RX;
+    struct tsch_link *l;
+
+    sf = get_node_link(rx_index(src_index), &timeslot, &choffset);
+    choffset = orchestra_channel_offset(choffset, src_index, orchestra_own_index());
+    l = tsch_schedule_get_link_from_timeslot(sf, timeslot);
+    if(l == NULL) {
+      linkaddr_copy(&link_addr, &linkaddr_null);
+      ts = memb_alloc(&nbr_timestamps);
+    } else {
+      link_options |= l->link_options;
+      if(link_options & LINK_OPTION_TX) {
+        /* We Tx in this link too: the channel offset of our Tx wins */
+        choffset = l->channel_offset;
+      }
+      if(ORCHESTRA_COLLISION_AWARE && (link_options & LINK_OPTION_TX)) {
+        /* The sender uses our Tx timeslot: contend for it */
+        link_options |= LINK_OPTION_SHARED;
+      }
+      linkaddr_copy(&link_addr, tsch_schedule_get_link_addr(l));
+      ts = tsch_schedule_get_link_data(l);
+      if(link_options != l->link_options || choffset != l->channel_offset) {
+        /* Link options or channel offset have changed, update the link */
+        if(choffset != l->channel_offset && tsch_schedule_remove_link(sf, l)) {
+          ORCHESTRA_STATS_INC(sf, links_removed);
+        }
+        l = NULL;
+      }
+    }
+    /* Now add/update the link */
+    if(l == NULL) {
+      PRINTF("Orchestra: adding rx link at %u\n", timeslot);
+      l = tsch_schedule_add_link(sf,
+          link_options,
+          LINK_TYPE_NORMAL, &link_addr,
+          timeslot, choffset);
+      if(l != NULL) {
+        ORCHESTRA_STATS_INC(sf, links_added);
+      }
+    } else {
+      PRINTF("Orchestra: updating rx link at %u\n", timeslot);
+    }
+    /* Update Rx timestamp */
+    if(l != NULL && ts != NULL) {
+      ts->last_rx = current_asn.ls4b;
+#if WITH_RX_INDEX
+      ts->rx_index = src_index;
+#endif
+      tsch_schedule_set_link_data(l, ts);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_tx_link(const linkaddr_t *dest)
+{
+  /* We schedule a Tx link to this neighbor in our dedicated slot */
+  uint16_t timeslot;
+  uint16_t choffset;
+  struct tsch_slotframe *sf;
+  struct link_timestamps *ts;
+  uint8_t link_options = LINK_OPTION_TX | (ORCHESTRA_SB_SHARED ? LINK_OPTION_SHARED : 0);
+  struct tsch_link *l;
+
+  sf = get_node_link(tx_index(dest), &timeslot, &choffset);
+  if(sf == NULL) {
+    return;
+  }
+  choffset = orchestra_channel_offset(choffset, orchestra_own_index(), orchestra_node_index(dest));
+  l = tsch_schedule_get_link_from_timeslot(sf, timeslot);
+  if(l == NULL) {
+    ts = memb_alloc(&nbr_timestamps);
+#if WITH_RX_INDEX
+    if(ts != NULL) {
+      ts->rx_index = ORCHESTRA_INDEX_UNKNOWN;
+    }
+#endif
+  } else {
+    link_options |= l->link_options;
+    if(ORCHESTRA_COLLISION_AWARE && (link_options & LINK_OPTION_RX)) {
+      /* A neighbor uses our Tx timeslot: contend for it */
+      link_options |= LINK_OPTION_SHARED;
+    }
+    ts = tsch_schedule_get_link_data(l);
+    if(link_options != l->link_options || choffset != l->channel_offset
+        || !linkaddr_cmp(tsch_schedule_get_link_addr(l), dest)) {
+      /* Link options, channel offset or address have changed, update the link */
+      if(choffset != l->channel_offset && tsch_schedule_remove_link(sf, l)) {
+        ORCHESTRA_STATS_INC(sf, links_removed);
+      }
+      l = NULL;
+    }
+  }
+  /* Now add/update the link */
+  if(l == NULL) {
+    PRINTF("Orchestra: adding tx link at %u\n", timeslot);
+    l = tsch_schedule_add_link(sf,
+        link_options,
+        LINK_TYPE_NORMAL, dest,
+        timeslot, choffset);
+    if(l != NULL) {
+      ORCHESTRA_STATS_INC(sf, links_added);
+    }
+  } else {
+    PRINTF("Orchestra: update tx link at %u\n", timeslot);
+  }
+  /* Update Tx timestamp */
+  if(l != NULL && ts != NULL) {
+    ts->last_tx = current_asn.ls4b;
+    tsch_schedule_set_link_data(l, ts);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+packet_sent(int mac_status)
+{
+  const linkaddr_t *dest = packetbuf_addr(PACKETBUF_ADDR_RECEIVER);
+
+  if(packetbuf_attr(PACKETBUF_ATTR_PROTO) == UIP_PROTO_ICMP6) {
+    /* Filter out ICMP */
+    return;
+  }
+
+  if(orchestra_node_index(dest) != ORCHESTRA_INDEX_UNKNOWN
+      && mac_status == MAC_TX_OK) {
+    /* Successful unicast Tx */
+#if ORCHESTRA_SB_NACK
+    if(linkaddr_cmp(dest, &alt_dest)) {
+      alt_last_tx = current_asn.ls4b;
+    }
+#endif
+    update_tx_link(dest);
+  }
+}
+#if ORCHESTRA_SB_NACK
+/*---------------------------------------------------------------------------*/
+static int
+do_nack(struct tsch_link *link, const linkaddr_t *src, const linkaddr_t *dst)
+{
+  /* Called from interrupt: NACK a sender in its own slot when we listen
+   * to another sender there. From its alternate slot, it has nowhere to go */
+  uint16_t timeslot;
+  uint16_t choffset;
+  uint16_t src_index;
+  struct tsch_slotframe *sf;
+  struct link_timestamps *ts;
+
+  if(link == NULL || !(link->link_options & LINK_OPTION_RX)
+      || (ts = tsch_schedule_get_link_data(link)) == NULL
+      || ts->rx_index == ORCHESTRA_INDEX_UNKNOWN || !IS_FRESH(ts->last_rx)) {
+    return 0;
+  }
+  src_index = orchestra_node_index(src);
+  if(src_index == ORCHESTRA_INDEX_UNKNOWN || src_index == ts->rx_index) {
+    return 0;
+  }
+  sf = get_node_link(src_index, &timeslot, &choffset);
+  return sf != NULL && sf->handle == link->slotframe_handle && timeslot == link->timeslot;
+}
+/*---------------------------------------------------------------------------*/
+static void
+nack_received(const linkaddr_t *dest, struct tsch_link *link)
+{
+  uint16_t timeslot;
+  uint16_t choffset;
+  struct tsch_slotframe *sf = get_node_link(orchestra_own_index(), &timeslot, &choffset);
+  struct link_timestamps *ts;
+  int batch;
+
+  if(sf == NULL || link->slotframe_handle != sf->handle || link->timeslot != timeslot
+      || orchestra_node_index(dest) == ORCHESTRA_INDEX_UNKNOWN) {
+    /* Not our own slot: nothing left to negotiate */
+    return;
+  }
+  PRINTF("Orchestra: NACKed at %u, moving to the alternate slot\n", timeslot);
+  linkaddr_copy(&alt_dest, dest);
+  alt_last_tx = current_asn.ls4b;
+
+  /* Switch from our own slot to the alternate one at once */
+  batch = tsch_schedule_begin();
+  ts = tsch_schedule_get_link_data(link);
+  if(!(link->link_options & LINK_OPTION_TX)
+      || !linkaddr_cmp(tsch_schedule_get_link_addr(link), dest)) {
+    /* Our own slot is in use towards another neighbor: keep it */
+  } else if(link->link_options & LINK_OPTION_RX) {
+    struct tsch_link *new_link = remove_tx_option(sf, link, ts);
+    if(new_link != NULL) {
+      ORCHESTRA_STATS_INC(sf, links_added);
+      tsch_schedule_set_link_data(new_link, ts);
+    }
+  } else {
+    tsch_schedule_set_link_data(link, NULL);
+    if(tsch_schedule_remove_link(sf, link)) {
+      ORCHESTRA_STATS_INC(sf, links_removed);
+    }
+    if(ts != NULL) {
+      memb_free(&nbr_timestamps, ts);
+    }
+  }
+  update_tx_link(dest);
+  if(batch) {
+    tsch_schedule_commit();
+  }
+}
+#endif /* ORCHESTRA_SB_NACK */
+/*---------------------------------------------------------------------------*/
+static void
+init(uint16_t handle)
+{
+  memb_init(&nbr_timestamps);
+  sf_sb = orchestra_add_slotframe(handle, ORCHESTRA_SB_PERIOD);
+#if ORCHESTRA_SB_PERIOD2
+  sf_sb2 = orchestra_add_slotframe(handle + 1, ORCHESTRA_SB_PERIOD2);
+  if(sf_sb2 == NULL && sf_sb != NULL) {
+    tsch_schedule_remove_slotframe(sf_sb);
+    sf_sb = NULL;
+  }
+#endif
+  if(sf_sb == NULL) {
+    /* Out of slotframes, see TSCH_CONF_MAX_SLOTFRAMES: the rule stays off */
+    printf("Orchestra:! sender-based rule: no slotframe for handle %u\n", handle);
+    return;
+  }
+#if TSCH_SCHEDULE_WITH_STORE
+  restore_timestamps_sf(sf_sb);
+#if ORCHESTRA_SB_PERIOD2
+  restore_timestamps_sf(sf_sb2);
+#endif
+#endif /* TSCH_SCHEDULE_WITH_STORE */
+  /* Rx links (with lease time) will be added upon receiving unicast */
+  /* Tx links (with lease time) will be added upon transmitting unicast (if ack received) */
+  /* Expired links are removed by a periodic sweep */
+  ctimer_set(&sweep_timer, ORCHESTRA_SB_LINK_SWEEP_PERIOD, delete_old_links, NULL);
+}
+/*---------------------------------------------------------------------------*/
+void
+orchestra_sb_set_link_lifetime(clock_time_t lifetime)
+{
+  link_lifetime = lifetime;
+}
+/*---------------------------------------------------------------------------*/
+clock_time_t
+orchestra_sb_get_link_lifetime(void)
+{
+  return link_lifetime;
+}
+/*---------------------------------------------------------------------------*/
+struct orchestra_rule unicast_per_neighbor_sb = {
+  init,
+  NULL,
+  joining_network,
+  packet_sent,
+  packet_received,
+  select_packet,
+  ORCHESTRA_SB_PERIOD2 ? 2 : 1,
+  "unicast per neighbor, sender-based",
+#if ORCHESTRA_SB_NACK
+  NULL,
+  NULL,
+  NULL,
+  do_nack,
+  nack_received,
+#endif
+};
@@ -0,0 +1,449 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/**
+ * \file
+ *         Orchestra: the rule engine. Assigns slotframes to the rules and
+ *         dispatches the TSCH and net-layer events to them.
+ *
+ * \author Simon Duquennoy <simonduq@sics.se>
+ */
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "net/rime/rime.h"
+#include "net/mac/tsch/tsch.h"
+#include "net/mac/tsch/tsch-private.h"
+#include "net/mac/tsch/tsch-rpl.h"
+#include "orchestra.h"
+#include <stdio.h>
+#include <string.h>
+#if !ORCHESTRA_HASH_SLOTS
+#include "deployment.h"
+#endif
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+static struct orchestra_rule *default_rules[] = ORCHESTRA_RULES;
+#define NUM_DEFAULT_RULES (sizeof(default_rules) / sizeof(struct orchestra_rule *))
+
+static struct orchestra_rule *rules[ORCHESTRA_MAX_RULES];
+static uint8_t num_rules;
+static uint8_t initialized;
+static uint16_t own_index = ORCHESTRA_INDEX_UNKNOWN;
+
+#if ORCHESTRA_WITH_STATS
+/* A rule has at most two slotframes, with handles from 0 */
+#define NUM_STATS (2 * ORCHESTRA_MAX_RULES)
+static struct orchestra_stats stats[NUM_STATS];
+static uint16_t unicast_count;
+static uint16_t fallback_count;
+#endif /* ORCHESTRA_WITH_STATS */
+
+/* A net-layer sniffer for packets sent and received */
+static void orchestra_packet_received(void);
+static void orchestra_packet_sent(int mac_status);
+RIME_SNIFFER(orchestra_sniffer, orchestra_packet_received, orchestra_packet_sent);
+
+/*---------------------------------------------------------------------------*/
+static void
+orchestra_packet_received(void)
+{
+  int i;
+  for(i = 0; i < num_rules; i++) {
+    if(rules[i]->packet_received != NULL) {
+      rules[i]->packet_received();
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+orchestra_packet_sent(int mac_status)
+{
+  int i;
+  for(i = 0; i < num_rules; i++) {
+    if(rules[i]->packet_sent != NULL) {
+      rules[i]->packet_sent(mac_status);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+orchestra_callback_select_packet(void)
+{
+  /* The first rule to select the packet wins */
+  uint16_t slotframe;
+  int i;
+#if ORCHESTRA_WITH_STATS
+  int is_unicast = !linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &linkaddr_null);
+  if(is_unicast) {
+    unicast_count++;
+  }
+#endif /* ORCHESTRA_WITH_STATS */
+  for(i = 0; i < num_rules; i++) {
+    if(rules[i]->select_packet != NULL && rules[i]->select_packet(&slotframe)) {
+#if ORCHESTRA_WITH_STATS
+      if(slotframe < NUM_STATS) {
+        stats[slotframe].selected++;
+      }
+#endif /* ORCHESTRA_WITH_STATS */
+      return slotframe;
+    }
+  }
+#if ORCHESTRA_WITH_STATS
+  if(is_unicast) {
+    fallback_count++;
+  }
+#endif /* ORCHESTRA_WITH_STATS */
+  return TSCH_PACKET_ANY_SLOTFRAME;
+}
+/*---------------------------------------------------------------------------*/
+void
+orchestra_callback_new_time_source(struct tsch_neighbor *old, struct tsch_neighbor *new)
+{
+  int i;
+  /* Switch from the old to the new time source's links at once */
+  int batch = tsch_schedule_begin();
+  for(i = 0; i < num_rules; i++) {
+    if(rules[i]->new_time_source != NULL) {
+      rules[i]->new_time_source(old, new);
+    }
+  }
+  if(batch) {
+    tsch_schedule_commit();
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+orchestra_callback_new_backup_time_source(struct tsch_neighbor *old, struct tsch_neighbor *new)
+{
+  int i;
+  int batch = tsch_schedule_begin();
+  for(i = 0; i < num_rules; i++) {
+    if(rules[i]->new_backup_time_source != NULL) {
+      rules[i]->new_backup_time_source(old, new);
+    }
+  }
+  if(batch) {
+    tsch_schedule_commit();
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+orchestra_callback_joining_network(void)
+{
+  int i;
+  for(i = 0; i < num_rules; i++) {
+    if(rules[i]->joining_network != NULL) {
+      rules[i]->joining_network();
+    }
+  }
+  tsch_rpl_callback_joining_network();
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+orchestra_callback_ack_hints(struct tsch_link *link, linkaddr_t *src)
+{
+  uint8_t flags = 0;
+  int i;
+  for(i = 0; i < num_rules; i++) {
+    if(rules[i]->ack_hints != NULL) {
+      flags |= rules[i]->ack_hints(link, src);
+    }
+  }
+  return flags;
+}
+/*---------------------------------------------------------------------------*/
+void
+orchestra_callback_ack_hints_received(const linkaddr_t *dest, const struct tsch_ack_hints *hints)
+{
+  int i;
+  for(i = 0; i < num_rules; i++) {
+    if(rules[i]->ack_hints_received != NULL) {
+      rules[i]->ack_hints_received(dest, hints);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+orchestra_callback_do_nack(struct tsch_link *link, linkaddr_t *src, linkaddr_t *dst)
+{
+  int i;
+  for(i = 0; i < num_rules; i++) {
+    if(rules[i]->do_nack != NULL && rules[i]->do_nack(link, src, dst)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+orchestra_callback_nack_received(const linkaddr_t *dest, uint16_t link_handle)
+{
+  /* The link may have been removed since */
+  struct tsch_link *link = tsch_schedule_get_link_from_handle(link_handle);
+  int i;
+  if(link == NULL) {
+    return;
+  }
+  for(i = 0; i < num_rules; i++) {
+    if(rules[i]->nack_received != NULL) {
+      rules[i]->nack_received(dest, link);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+orchestra_callback_probe(const linkaddr_t *addr)
+{
+  int i;
+  for(i = 0; i < num_rules; i++) {
+    if(rules[i]->probe != NULL) {
+      rules[i]->probe(addr);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+struct tsch_slotframe *
+orchestra_add_slotframe(uint16_t handle, uint16_t size)
+{
+  /* The slotframe may have been restored already from a schedule snapshot */
+  struct tsch_slotframe *sf = tsch_schedule_get_slotframe_from_handle(handle);
+  if(sf != NULL && sf->size.val != size) {
+    tsch_schedule_remove_slotframe(sf);
+    sf = NULL;
+  }
+  return sf != NULL ? sf : tsch_schedule_add_slotframe(handle, size);
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+orchestra_linkaddr_hash(const linkaddr_t *addr)
+{
+  /* Rotate-xor over the address: the last bytes matter most, as they
+   * tell apart the nodes of a deployment */
+  uint16_t hash = 0;
+  int i;
+  for(i = 0; i < LINKADDR_SIZE; i++) {
+    hash = ((hash << 5) | (hash >> 11)) ^ addr->u8[i];
+  }
+  return hash & 0x7fff;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+orchestra_channel_offset(uint16_t offset, uint16_t tx_index, uint16_t rx_index)
+{
+#if ORCHESTRA_CHANNEL_DIVERSITY
+  /* Multiplicative mix, so that (a, b) and (b, a) get different offsets */
+  uint16_t hash = (uint16_t)(tx_index * 0x9e37u) ^ (uint16_t)(rx_index * 0x7f4bu);
+  return ORCHESTRA_CHANNEL_OFFSET_FIRST + (hash ^ (hash >> 8)) % ORCHESTRA_CHANNEL_OFFSETS;
+#else
+  return offset;
+#endif
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+orchestra_node_index(const linkaddr_t *addr)
+{
+  if(addr == NULL || linkaddr_cmp(addr, &linkaddr_null)) {
+    return ORCHESTRA_INDEX_UNKNOWN;
+  }
+#if ORCHESTRA_HASH_SLOTS
+  return ORCHESTRA_LINKADDR_HASH(addr);
+#else
+  return node_index_from_linkaddr(addr);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+orchestra_own_index(void)
+{
+  return own_index;
+}
+/*---------------------------------------------------------------------------*/
+#if ORCHESTRA_WITH_STATS
+struct orchestra_stats *
+orchestra_get_stats(const struct tsch_slotframe *sf)
+{
+  return (sf != NULL && sf->handle < NUM_STATS) ? &stats[sf->handle] : NULL;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+orchestra_get_fallback_stats(uint16_t *unicast)
+{
+  if(unicast != NULL) {
+    *unicast = unicast_count;
+  }
+  return fallback_count;
+}
+/*---------------------------------------------------------------------------*/
+void
+orchestra_reset_stats(void)
+{
+  memset(stats, 0, sizeof(stats));
+  unicast_count = 0;
+  fallback_count = 0;
+#if TSCH_SCHEDULE_WITH_LINK_STATS
+  tsch_schedule_reset_link_stats();
+#endif /* TSCH_SCHEDULE_WITH_LINK_STATS */
+}
+/*---------------------------------------------------------------------------*/
+#if TSCH_SCHEDULE_WITH_LINK_STATS
+/* Prints the Tx and Rx use of a slotframe, from the link counters */
+static void
+print_link_stats(struct tsch_slotframe *sf)
+{
+  unsigned tx = 0, tx_ok = 0, collisions = 0, rx_ok = 0, rx_slots = 0;
+  struct tsch_link *l;
+  for(l = list_head(sf->links_list); l != NULL; l = list_item_next(l)) {
+    const struct tsch_link_stats *s = tsch_schedule_get_link_stats(l);
+    tx += s->tx_attempts;
+    tx_ok += s->tx_ok;
+    if(l->link_options & LINK_OPTION_SHARED) {
+      collisions += s->tx_noack;
+    }
+    rx_ok += s->rx_ok;
+    rx_slots += s->rx_ok + s->rx_idle;
+  }
+  printf(", tx %u ok %u coll %u, rx %u/%u", tx, tx_ok, collisions, rx_ok, rx_slots);
+}
+#endif /* TSCH_SCHEDULE_WITH_LINK_STATS */
+/*---------------------------------------------------------------------------*/
+void
+orchestra_print_stats(void)
+{
+  uint16_t handle = 0;
+  int i, j;
+  for(i = 0; i < num_rules; i++) {
+    for(j = 0; j < rules[i]->num_slotframes; j++, handle++) {
+      struct tsch_slotframe *sf = tsch_schedule_get_slotframe_from_handle(handle);
+      struct orchestra_stats *s = orchestra_get_stats(sf);
+      if(s == NULL) {
+        continue;
+      }
+      printf("Orchestra: sf %u %s, links %u +%u -%u exp %u, sel %u",
+          handle, rules[i]->name, list_length(sf->links_list),
+          s->links_added, s->links_removed, s->links_expired, s->selected);
+#if TSCH_SCHEDULE_WITH_LINK_STATS
+      print_link_stats(sf);
+#endif /* TSCH_SCHEDULE_WITH_LINK_STATS */
+      printf("\n");
+    }
+  }
+  printf("Orchestra: fallback %u/%u\n", fallback_count, unicast_count);
+}
+#endif /* ORCHESTRA_WITH_STATS */
+/*---------------------------------------------------------------------------*/
+int
+orchestra_set_rules(struct orchestra_rule * const *new_rules, uint8_t new_num_rules)
+{
+  int i;
+  if(initialized || new_num_rules > ORCHESTRA_MAX_RULES) {
+    return 0;
+  }
+  for(i = 0; i < new_num_rules; i++) {
+    if(new_rules[i] == NULL || new_rules[i]->init == NULL) {
+      return 0;
+    }
+  }
+  for(i = 0; i < new_num_rules; i++) {
+    rules[i] = new_rules[i];
+  }
+  num_rules = new_num_rules;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+orchestra_get_rules(struct orchestra_rule * const **active_rules)
+{
+  if(active_rules != NULL) {
+    *active_rules = rules;
+  }
+  return num_rules;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+gcd(uint16_t a, uint16_t b)
+{
+  while(b != 0) {
+    uint16_t r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+/*---------------------------------------------------------------------------*/
+/* Slotframes whose lengths share a factor overlap at the same timeslots
+ * in every cycle: the links that lose there never get a turn. See
+ * tools/orchestra-slotframes to pick lengths */
+static void
+check_slotframe_lengths(void)
+{
+  struct tsch_slotframe *a;
+  struct tsch_slotframe *b;
+  for(a = tsch_schedule_slotframe_head(); a != NULL; a = tsch_schedule_slotframe_next(a)) {
+    for(b = tsch_schedule_slotframe_next(a); b != NULL; b = tsch_schedule_slotframe_next(b)) {
+      uint16_t factor = gcd(a->size.val, b->size.val);
+      if(factor > 1) {
+        printf("Orchestra:! slotframes %u and %u of lengths %u and %u share factor %u\n",
+            a->handle, b->handle, a->size.val, b->size.val, factor);
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+orchestra_init(void)
+{
+  uint16_t slotframe_handle = 0;
+  int i;
+
+  if(initialized) {
+    return;
+  }
+  if(num_rules == 0) {
+    orchestra_set_rules(default_rules, MIN(NUM_DEFAULT_RULES, ORCHESTRA_MAX_RULES));
+  }
+  initialized = 1;
+#if ORCHESTRA_HASH_SLOTS
+  own_index = ORCHESTRA_LINKADDR_HASH(&linkaddr_node_addr);
+#else
+  own_index = node_index;
+#endif
+
+  /* Slotframe handles follow the order of the rules */
+  for(i = 0; i < num_rules; i++) {
+    PRINTF("Orchestra: rule %s, slotframe %u\n", rules[i]->name, slotframe_handle);
+    rules[i]->init(slotframe_handle);
+    slotframe_handle += rules[i]->num_slotframes;
+  }
+  check_slotframe_lengths();
+  rime_sniffer_add(&orchestra_sniffer);
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/**
+ * \file
+ *         Orchestra: autonomous TSCH scheduling, as a set of rules.
+ *         Each rule installs and maintains the links of its own slotframe(s).
+ *
+ * \author Simon Duquennoy <simonduq@sics.se>
+ */
+
+#ifndef __ORCHESTRA_H__
+#define __ORCHESTRA_H__
+
+#include "net/mac/tsch/tsch.h"
+#include "net/mac/tsch/tsch-queue.h"
+#include "net/mac/tsch/tsch-schedule.h"
+#include "deployment-def.h"
+#include "orchestra-conf.h"
+
+/* An Orchestra rule. The rule owns num_slotframes slotframes, of handles
+ * slotframe_handle and above. All callbacks but init are optional.
+ * select_packet is called for every packet queued: it returns 1 and sets
+ * *slotframe if the packet in packetbuf must be sent in one of the rule's
+ * slotframes, 0 otherwise. Schedule updates from new_time_source are
+ * applied at once, see tsch_schedule_begin */
+struct orchestra_rule {
+  void (* init)(uint16_t slotframe_handle);
+  void (* new_time_source)(const struct tsch_neighbor *old, const struct tsch_neighbor *new);
+  void (* joining_network)(void);
+  void (* packet_sent)(int mac_status);
+  void (* packet_received)(void);
+  int (* select_packet)(uint16_t *slotframe);
+  uint8_t num_slotframes;
+  const char *name;
+  /* ACK hint flags (from TSCH_ACK_HINT_USER_SHIFT on) to send, from interrupt */
+  uint8_t (* ack_hints)(struct tsch_link *link, linkaddr_t *src);
+  void (* ack_hints_received)(const linkaddr_t *dest, const struct tsch_ack_hints *hints);
+  /* Keep cells to the backup time source, see TSCH_CONF_WITH_BACKUP_TIME_SOURCE */
+  void (* new_backup_time_source)(const struct tsch_neighbor *old, const struct tsch_neighbor *new);
+  /* Link negotiation: returns 1 to NACK a frame, from interrupt. And NACKs
+   * received for a packet, with the link they were received on */
+  int (* do_nack)(struct tsch_link *link, const linkaddr_t *src, const linkaddr_t *dst);
+  void (* nack_received)(const linkaddr_t *dest, struct tsch_link *link);
+  /* The next ICMPv6 unicast to addr is an RPL probe */
+  void (* probe)(const linkaddr_t *addr);
+};
+
+extern struct orchestra_rule eb_per_time_source;
+extern struct orchestra_rule default_common;
+extern struct orchestra_rule unicast_per_neighbor_rb;
+extern struct orchestra_rule unicast_per_neighbor_sb;
+extern struct orchestra_rule probing;
+extern struct orchestra_rule bulk;
+extern struct orchestra_rule track;
+
+/* Set the rules to run, in order. Must be called before orchestra_init.
+ * Returns 1 if successful, 0 otherwise */
+int orchestra_set_rules(struct orchestra_rule * const *rules, uint8_t num_rules);
+/* Get the active rules. Returns the number of rules */
+uint8_t orchestra_get_rules(struct orchestra_rule * const **rules);
+void orchestra_init(void);
+
+/* Slotframe helper for the rules: reuses a slotframe restored from a
+ * schedule snapshot, provided it has the right size */
+struct tsch_slotframe *orchestra_add_slotframe(uint16_t handle, uint16_t size);
+
+/* Index of a node, from which the rules derive its slots: its index in the
+ * node table, or the hash of its address with ORCHESTRA_HASH_SLOTS.
+ * ORCHESTRA_INDEX_UNKNOWN if addr is NULL, broadcast, or not in the table */
+#define ORCHESTRA_INDEX_UNKNOWN 0xffff
+uint16_t orchestra_node_index(const linkaddr_t *addr);
+/* Our own index */
+uint16_t orchestra_own_index(void);
+/* Channel offset of a dedicated cell from a node (ORCHESTRA_INDEX_UNKNOWN
+ * for any) to another: offset, or a hash of both indexes with
+ * ORCHESTRA_CHANNEL_DIVERSITY */
+uint16_t orchestra_channel_offset(uint16_t offset, uint16_t tx_index, uint16_t rx_index);
+/* Default address hash, see ORCHESTRA_LINKADDR_HASH */
+uint16_t orchestra_linkaddr_hash(const linkaddr_t *addr);
+
+/* Bulk rule: cells for a transfer to (tx) or from a neighbor, until
+ * orchestra_bulk_stop. Returns 1 if successful, 0 otherwise */
+int orchestra_bulk_start(const linkaddr_t *addr, int tx);
+void orchestra_bulk_stop(const linkaddr_t *addr);
+
+/* Track rule: the track of the packets we originate from now on, 0 for
+ * that of their RPL instance. Returns 1 if successful, 0 otherwise */
+int orchestra_track_set_flow(uint8_t track);
+/* Queue class of the packet in packetbuf, control traffic first, then
+ * track 1, 2, etc. To use, set TSCH_QUEUE_CONF_PACKET_CLASS to it */
+uint8_t orchestra_track_packet_class(void);
+
+/* Sender-based rule: lifetime of the links without traffic, from
+ * ORCHESTRA_SB_LINK_LIFETIME. Takes effect at the next sweep */
+void orchestra_sb_set_link_lifetime(clock_time_t lifetime);
+clock_time_t orchestra_sb_get_link_lifetime(void);
+
+#if ORCHESTRA_WITH_STATS
+/* Counters of a slotframe */
+struct orchestra_stats {
+  /* Links installed or updated */
+  uint16_t links_added;
+  /* Links removed */
+  uint16_t links_removed;
+  /* Links removed or downgraded for lack of traffic */
+  uint16_t links_expired;
+  /* Packets selected for the slotframe */
+  uint16_t selected;
+};
+/* Returns the counters of a slotframe (NULL if failure) */
+struct orchestra_stats *orchestra_get_stats(const struct tsch_slotframe *sf);
+/* Returns the number of unicast packets no rule selected, and the total */
+uint16_t orchestra_get_fallback_stats(uint16_t *unicast);
+void orchestra_reset_stats(void);
+/* Prints one line per slotframe, and one for the fallback to common */
+void orchestra_print_stats(void);
+/* Increments a counter of a rule's slotframe */
+#define ORCHESTRA_STATS_INC(sf, field) do { \
+    struct orchestra_stats *stats = orchestra_get_stats(sf); \
+    if(stats != NULL) { \
+      stats->field++; \
+    } \
+  } while(0)
+#else /* ORCHESTRA_WITH_STATS */
+#define ORCHESTRA_STATS_INC(sf, field)
+#endif /* ORCHESTRA_WITH_STATS */
+
+/* TSCH callbacks. To use, set in project-conf.h:
+ * #define TSCH_CALLBACK_NEW_TIME_SOURCE orchestra_callback_new_time_source
+ * #define TSCH_CALLBACK_JOINING_NETWORK orchestra_callback_joining_network
+ * #define TSCH_CALLBACK_SELECT_PACKET orchestra_callback_select_packet
+ * and with TSCH_CONF_PACKET_WITH_ACK_HINTS:
+ * #define TSCH_CALLBACK_ACK_HINTS orchestra_callback_ack_hints
+ * #define TSCH_CALLBACK_ACK_HINTS_RECEIVED orchestra_callback_ack_hints_received
+ * and with TSCH_CONF_WITH_BACKUP_TIME_SOURCE, to keep cells to the backup too:
+ * #define TSCH_CALLBACK_NEW_BACKUP_TIME_SOURCE orchestra_callback_new_backup_time_source
+ * and with ORCHESTRA_SB_NACK:
+ * #define TSCH_CALLBACK_DO_NACK orchestra_callback_do_nack
+ * #define TSCH_CALLBACK_NACK_RECEIVED orchestra_callback_nack_received
+ * and for the probing rule, the RPL callback:
+ * #define RPL_CALLBACK_PROBE orchestra_callback_probe
+ * and for the track rule, the 6LoWPAN callback:
+ * #define SICSLOWPAN_CALLBACK_PACKET_TRACK orchestra_callback_packet_track */
+void orchestra_callback_new_time_source(struct tsch_neighbor *old, struct tsch_neighbor *new);
+void orchestra_callback_joining_network(void);
+uint16_t orchestra_callback_select_packet(void);
+void orchestra_callback_new_backup_time_source(struct tsch_neighbor *old, struct tsch_neighbor *new);
+uint8_t orchestra_callback_ack_hints(struct tsch_link *link, linkaddr_t *src);
+void orchestra_callback_ack_hints_received(const linkaddr_t *dest, const struct tsch_ack_hints *hints);
+int orchestra_callback_do_nack(struct tsch_link *link, linkaddr_t *src, linkaddr_t *dst);
+void orchestra_callback_nack_received(const linkaddr_t *dest, uint16_t link_handle);
+void orchestra_callback_probe(const linkaddr_t *addr);
+uint8_t orchestra_callback_packet_track(void);
+
+#endif /* __ORCHESTRA_H__ */
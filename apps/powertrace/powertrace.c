@@ -42,6 +42,9 @@
 #include "sys/compower.h"
 #include "powertrace.h"
 #include "net/rime/rime.h"
+#ifdef TSCH_CONF_WITH_CPU_TIME
+#include "net/mac/tsch/tsch-private.h"
+#endif
 
 #include <stdio.h>
 #include <string.h>
@@ -133,6 +136,30 @@ powertrace_print(char *str)
          (int)((100L * listen) / time),
          (int)((10000L * listen) / time - (100L * listen / time) * 100));
 
+#if PROCESS_CONF_CPU_TIME
+  /* CPU time of every process, cumulative */
+  {
+    struct process *p;
+    for(p = PROCESS_LIST(); p != NULL; p = p->next) {
+      printf("%s %lu PC %d.%d %lu %lu %s\n",
+             str, clock_time(), linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], seqno,
+             p->cpu_time, PROCESS_NAME_STRING(p));
+    }
+  }
+#endif /* PROCESS_CONF_CPU_TIME */
+
+#if TSCH_WITH_CPU_TIME
+  /* CPU time of TSCH link operations, in rtimer interrupt */
+  {
+    static uint32_t last_tsch;
+    uint32_t all_tsch = tsch_get_cpu_time();
+    printf("%s %lu PT %d.%d %lu %lu %lu\n",
+           str, clock_time(), linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], seqno,
+           (unsigned long)all_tsch, (unsigned long)(all_tsch - last_tsch));
+    last_tsch = all_tsch;
+  }
+#endif /* TSCH_WITH_CPU_TIME */
+
   for(s = list_head(stats_list); s != NULL; s = list_item_next(s)) {
 
 #if ! NETSTACK_CONF_WITH_IPV6
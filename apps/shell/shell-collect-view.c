@@ -72,6 +72,8 @@ PROCESS_THREAD(collect_view_data_process, ev, data)
   collect_view_construct_message(&msg, &shell_collect_conn.parent,
                                  parent_etx, shell_collect_conn.rtmetric,
                                  num_neighbors, beacon_interval);
+  msg.sensors[COLLECT_VIEW_QUEUE_SENSOR] =
+    collect_queue_occupancy(&shell_collect_conn);
   shell_output(&collect_view_data_command, &msg, sizeof(msg), "", 0);
 
   PROCESS_END();
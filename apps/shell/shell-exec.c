@@ -77,6 +77,7 @@ PROCESS_THREAD(shell_exec_process, ev, data)
   } else {
     int ret;
     char *print, *symbol;
+    char loadtime[24];
 
     ret = elfloader_load(fd);
     cfs_close(fd);
@@ -85,6 +86,9 @@ PROCESS_THREAD(shell_exec_process, ev, data)
     switch(ret) {
     case ELFLOADER_OK:
       print = "OK";
+      sprintf(loadtime, ", %lu ms",
+	      (unsigned long)elfloader_load_time * 1000 / CLOCK_SECOND);
+      symbol = loadtime;
       break;
     case ELFLOADER_BAD_ELF_HEADER:
       print = "Bad ELF header";
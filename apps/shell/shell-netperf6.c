@@ -0,0 +1,541 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         UDP/IPv6 network performance measurements between two nodes:
+ *         stream, request/response and ping flood, with throughput,
+ *         round-trip-time distribution, loss, the duty cycle of both
+ *         nodes and, with RPL_CONF_HOP_TIMESTAMPS, per-hop latencies.
+ *
+ *         Both nodes run the netperf6 shell command set; the one where
+ *         the command is entered clears the statistics of the other, runs
+ *         the test and fetches them back over the same UDP port.
+ */
+
+#include "contiki.h"
+#include "shell.h"
+#include "shell-netperf6.h"
+#include "net/ip/uip.h"
+#include "net/ip/uiplib.h"
+#include "net/ip/simple-udp.h"
+#include "sys/energest.h"
+#if UIP_CONF_IPV6_RPL
+#include "net/rpl/rpl.h"
+#endif /* UIP_CONF_IPV6_RPL */
+
+#include <stdio.h>
+#include <string.h>
+
+/* UDP port of both the data and the control messages */
+#ifdef SHELL_NETPERF6_CONF_PORT
+#define SHELL_NETPERF6_PORT SHELL_NETPERF6_CONF_PORT
+#else
+#define SHELL_NETPERF6_PORT 5001
+#endif
+
+/* UDP payload of the data messages */
+#ifdef SHELL_NETPERF6_CONF_DATALEN
+#define SHELL_NETPERF6_DATALEN SHELL_NETPERF6_CONF_DATALEN
+#else
+#define SHELL_NETPERF6_DATALEN 64
+#endif
+
+/* Default interval between two packets of a stream or ping flood, in ms */
+#ifdef SHELL_NETPERF6_CONF_INTERVAL
+#define SHELL_NETPERF6_INTERVAL SHELL_NETPERF6_CONF_INTERVAL
+#else
+#define SHELL_NETPERF6_INTERVAL 250
+#endif
+
+/* How long we wait for a reply, and after the last packet for late replies */
+#ifdef SHELL_NETPERF6_CONF_TIMEOUT
+#define SHELL_NETPERF6_TIMEOUT SHELL_NETPERF6_CONF_TIMEOUT
+#else
+#define SHELL_NETPERF6_TIMEOUT (4 * CLOCK_SECOND)
+#endif
+
+#define MAX_RETRIES 8
+
+/* RTT histogram: bucket i counts the RTTs below RTT_BUCKET_MS << i ms,
+ * the last one all others */
+#define RTT_BUCKETS 8
+#define RTT_BUCKET_MS 32
+
+#define NETPERF6_HOPS (UIP_CONF_IPV6_RPL && RPL_HOP_TIMESTAMPS)
+
+#define CONTINUE_EVENT 128
+
+struct power {
+  uint32_t cpu, lpm, rx, tx;
+};
+
+struct stats {
+  uint16_t sent, received, timedout;
+  uint32_t bytes;
+  clock_time_t start, end;
+  struct power power0, power;
+  clock_time_t rtt_min, rtt_max;
+  uint32_t rtt_total;
+  uint16_t rtt_hist[RTT_BUCKETS];
+#if NETPERF6_HOPS
+  /* Latency of the i-th hop, in units of RPL_CALLBACK_HOP_TIMESTAMP */
+  uint16_t hop_count[RPL_HOP_TIMESTAMPS];
+  uint32_t hop_total[RPL_HOP_TIMESTAMPS];
+#endif /* NETPERF6_HOPS */
+};
+
+enum {
+  MSG_STREAM,
+  MSG_ECHO_REQUEST,
+  MSG_ECHO_REPLY,
+  MSG_CLEAR,
+  MSG_CLEAR_ACK,
+  MSG_STATS,
+  MSG_STATS_REPLY,
+};
+
+struct netperf6_msg {
+  uint8_t type;
+  uint8_t pad;
+  uint16_t seqno;
+  clock_time_t tx;
+};
+
+struct ctrl_reply {
+  struct netperf6_msg hdr;
+  struct stats stats;
+};
+
+enum {
+  TYPE_NONE,
+  TYPE_STREAM,
+  TYPE_REQUEST_RESPONSE,
+  TYPE_FLOOD,
+};
+
+static struct simple_udp_connection conn;
+static struct stats stats;
+static uint8_t current_type;
+/* Type of the last control reply, and stats of the remote node */
+static uint8_t ctrl_reply_type;
+static struct stats remote_stats;
+/* Seqno of the echo request we wait for, request/response only */
+static uint16_t pending_seqno;
+
+/*---------------------------------------------------------------------------*/
+PROCESS(shell_netperf6_process, "netperf6");
+SHELL_COMMAND(netperf6_command,
+	      "netperf6",
+	      "netperf6 [-s|r|f] <address> <num packets> [interval ms]: measure UDP/IPv6 performance",
+	      &shell_netperf6_process);
+/*---------------------------------------------------------------------------*/
+static void
+sample_power_profile(struct power *p)
+{
+  energest_flush();
+  p->cpu = energest_type_time(ENERGEST_TYPE_CPU);
+  p->lpm = energest_type_time(ENERGEST_TYPE_LPM);
+  p->rx = energest_type_time(ENERGEST_TYPE_LISTEN);
+  p->tx = energest_type_time(ENERGEST_TYPE_TRANSMIT);
+}
+/*---------------------------------------------------------------------------*/
+static void
+clear_stats(void)
+{
+  memset(&stats, 0, sizeof(stats));
+  stats.rtt_min = (clock_time_t)-1;
+  stats.start = clock_time();
+  sample_power_profile(&stats.power0);
+}
+/*---------------------------------------------------------------------------*/
+static void
+finalize_stats(void)
+{
+  stats.end = clock_time();
+  sample_power_profile(&stats.power);
+}
+/*---------------------------------------------------------------------------*/
+static void
+record_rtt(clock_time_t rtt)
+{
+  int i;
+
+  stats.rtt_total += rtt;
+  if(rtt < stats.rtt_min) {
+    stats.rtt_min = rtt;
+  }
+  if(rtt > stats.rtt_max) {
+    stats.rtt_max = rtt;
+  }
+  for(i = 0; i < RTT_BUCKETS - 1; i++) {
+    if((uint32_t)rtt * 1000 < (uint32_t)(RTT_BUCKET_MS << i) * CLOCK_SECOND) {
+      break;
+    }
+  }
+  stats.rtt_hist[i]++;
+}
+/*---------------------------------------------------------------------------*/
+/* Accounts for the latency of every hop of the packet in uip_buf */
+static void
+record_hops(void)
+{
+#if NETPERF6_HOPS
+  uint16_t timestamps[RPL_HOP_TIMESTAMPS + 1];
+  int count;
+  int i;
+
+  count = rpl_get_hop_timestamps(timestamps, RPL_HOP_TIMESTAMPS + 1);
+  for(i = 0; i + 1 < count; i++) {
+    stats.hop_count[i]++;
+    stats.hop_total[i] += (uint16_t)(timestamps[i + 1] - timestamps[i]);
+  }
+#endif /* NETPERF6_HOPS */
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_duty_cycle(const char *prefix, const struct stats *s)
+{
+  unsigned long total_time, rx, tx;
+
+  total_time = (s->power.cpu - s->power0.cpu) + (s->power.lpm - s->power0.lpm);
+  rx = s->power.rx - s->power0.rx;
+  tx = s->power.tx - s->power0.tx;
+  if(total_time == 0) {
+    total_time = 1;
+  }
+  printf("  %s radio duty cycle: rx %lu.%02lu%% tx %lu.%02lu%%\n", prefix,
+	 (100 * rx) / total_time, ((10000 * rx) / total_time) % 100,
+	 (100 * tx) / total_time, ((10000 * tx) / total_time) % 100);
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_hops(const char *path, const struct stats *s)
+{
+#if NETPERF6_HOPS
+  int i;
+
+  for(i = 0; i < RPL_HOP_TIMESTAMPS && s->hop_count[i] > 0; i++) {
+    printf("  %s hop %d: %u packets, average latency %lu\n", path, i + 1,
+	   s->hop_count[i], (unsigned long)(s->hop_total[i] / s->hop_count[i]));
+  }
+#endif /* NETPERF6_HOPS */
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_stats(const struct stats *local, const struct stats *remote)
+{
+  unsigned long duration, received, throughput;
+  int i;
+
+  duration = local->end - local->start;
+  if(duration == 0) {
+    duration = 1;
+  }
+  /* Packets that made it: to the remote node for a stream, back for the
+   * echo tests */
+  received = current_type == TYPE_STREAM ? remote->received : local->received;
+
+  printf("%u %u %lu %u %u %u %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu # for automatic processing\n",
+	 current_type, local->sent, received, remote->received, local->timedout,
+	 SHELL_NETPERF6_DATALEN, duration,
+	 (unsigned long)local->rtt_total, (unsigned long)local->rtt_max,
+	 (unsigned long)(local->power.cpu - local->power0.cpu),
+	 (unsigned long)(local->power.lpm - local->power0.lpm),
+	 (unsigned long)(local->power.rx - local->power0.rx),
+	 (unsigned long)(local->power.tx - local->power0.tx),
+	 (unsigned long)(remote->power.cpu - remote->power0.cpu),
+	 (unsigned long)(remote->power.rx - remote->power0.rx),
+	 (unsigned long)(remote->power.tx - remote->power0.tx));
+
+  throughput = (8UL * SHELL_NETPERF6_DATALEN * remote->received * CLOCK_SECOND) /
+    duration;
+  printf("netperf6 statistics:\n");
+  printf("  Transfer time:            %lu.%02lu seconds, %lu bits/second to remote\n",
+	 duration / CLOCK_SECOND, ((100 * duration) / CLOCK_SECOND) % 100,
+	 throughput);
+  printf("  Packets:                  sent %u, remote received %u, replies %u, timed out %u\n",
+	 local->sent, remote->received, local->received, local->timedout);
+  if(local->sent > 0) {
+    printf("  Loss:                     %lu.%02lu%%\n",
+	   (100UL * (local->sent - received)) / local->sent,
+	   ((10000UL * (local->sent - received)) / local->sent) % 100);
+  }
+  if(local->received > 0) {
+    printf("  Round-trip-time:          min %lu avg %lu max %lu ms\n",
+	   ((unsigned long)local->rtt_min * 1000) / CLOCK_SECOND,
+	   (unsigned long)(local->rtt_total * 1000 / local->received) / CLOCK_SECOND,
+	   ((unsigned long)local->rtt_max * 1000) / CLOCK_SECOND);
+    printf("  RTT histogram (ms):      ");
+    for(i = 0; i < RTT_BUCKETS - 1; i++) {
+      printf(" <%u:%u", RTT_BUCKET_MS << i, local->rtt_hist[i]);
+    }
+    printf(" >=%u:%u\n", RTT_BUCKET_MS << (RTT_BUCKETS - 2),
+	   local->rtt_hist[RTT_BUCKETS - 1]);
+  }
+  print_duty_cycle("Local ", local);
+  print_duty_cycle("Remote", remote);
+  print_hops("Forward", remote);
+  print_hops("Reverse", local);
+}
+/*---------------------------------------------------------------------------*/
+static void
+receiver(struct simple_udp_connection *c,
+         const uip_ipaddr_t *sender_addr,
+         uint16_t sender_port,
+         const uip_ipaddr_t *receiver_addr,
+         uint16_t receiver_port,
+         const uint8_t *data,
+         uint16_t datalen)
+{
+  static uint8_t buf[SHELL_NETPERF6_DATALEN > sizeof(struct ctrl_reply) ?
+                     SHELL_NETPERF6_DATALEN : sizeof(struct ctrl_reply)];
+  struct netperf6_msg msg;
+  uint16_t len;
+
+  if(datalen < sizeof(msg)) {
+    return;
+  }
+  memcpy(&msg, data, sizeof(msg));
+
+  switch(msg.type) {
+  case MSG_STREAM:
+  case MSG_ECHO_REQUEST:
+    stats.received++;
+    stats.bytes += datalen;
+    record_hops();
+    if(msg.type == MSG_ECHO_REQUEST) {
+      len = datalen < sizeof(buf) ? datalen : sizeof(buf);
+      memcpy(buf, data, len);
+      ((struct netperf6_msg *)buf)->type = MSG_ECHO_REPLY;
+      simple_udp_sendto(c, buf, len, sender_addr);
+      stats.sent++;
+    }
+    break;
+  case MSG_ECHO_REPLY:
+    if(current_type == TYPE_NONE) {
+      break;
+    }
+    stats.received++;
+    stats.bytes += datalen;
+    record_rtt(clock_time() - msg.tx);
+    record_hops();
+    if(current_type == TYPE_REQUEST_RESPONSE && msg.seqno == pending_seqno) {
+      process_post(&shell_netperf6_process, CONTINUE_EVENT, NULL);
+    }
+    break;
+  case MSG_CLEAR:
+    clear_stats();
+    msg.type = MSG_CLEAR_ACK;
+    simple_udp_sendto(c, &msg, sizeof(msg), sender_addr);
+    break;
+  case MSG_STATS:
+    finalize_stats();
+    msg.type = MSG_STATS_REPLY;
+    memcpy(buf, &msg, sizeof(msg));
+    memcpy(buf + sizeof(msg), &stats, sizeof(stats));
+    simple_udp_sendto(c, buf, sizeof(struct ctrl_reply), sender_addr);
+    break;
+  case MSG_CLEAR_ACK:
+  case MSG_STATS_REPLY:
+    if(msg.type == MSG_STATS_REPLY) {
+      if(datalen < sizeof(struct ctrl_reply)) {
+        break;
+      }
+      memcpy(&remote_stats, data + sizeof(msg), sizeof(remote_stats));
+    }
+    ctrl_reply_type = msg.type;
+    process_post(&shell_netperf6_process, CONTINUE_EVENT, NULL);
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_msg(const uip_ipaddr_t *to, uint8_t type, uint16_t seqno, uint16_t len)
+{
+  static uint8_t buf[SHELL_NETPERF6_DATALEN];
+  struct netperf6_msg msg;
+
+  msg.type = type;
+  msg.pad = 0;
+  msg.seqno = seqno;
+  msg.tx = clock_time();
+  memset(buf, 0, sizeof(buf));
+  memcpy(buf, &msg, sizeof(msg));
+  simple_udp_sendto(&conn, buf, len, to);
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_usage(void)
+{
+  shell_output_str(&netperf6_command,
+		   "netperf6 [-s|r|f] <address> <num packets> [interval ms]: measure UDP/IPv6 performance to address", "");
+  shell_output_str(&netperf6_command,
+		   "        -s stream: one-way packets every interval", "");
+  shell_output_str(&netperf6_command,
+		   "        -r request/response: next echo request after the reply (default)", "");
+  shell_output_str(&netperf6_command,
+		   "        -f ping flood: echo requests every interval", "");
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shell_netperf6_process, ev, data)
+{
+  static struct etimer e;
+  static uip_ipaddr_t remote;
+  static uint16_t i, num_packets;
+  static clock_time_t interval;
+  static uint8_t type, retries;
+  char addrstr[40];
+  const char *args, *next, *nextptr;
+
+  PROCESS_EXITHANDLER(current_type = TYPE_NONE;)
+  PROCESS_BEGIN();
+
+  current_type = TYPE_NONE;
+  type = TYPE_REQUEST_RESPONSE;
+  args = data;
+  while(args != NULL && *args == '-') {
+    ++args;
+    while(*args != ' ' && *args != 0) {
+      if(*args == 's') {
+        type = TYPE_STREAM;
+      } else if(*args == 'r') {
+        type = TYPE_REQUEST_RESPONSE;
+      } else if(*args == 'f') {
+        type = TYPE_FLOOD;
+      }
+      ++args;
+    }
+    while(*args == ' ') {
+      args++;
+    }
+  }
+
+  /* Parse the address */
+  next = args != NULL ? strchr(args, ' ') : NULL;
+  if(next == NULL || next - args >= sizeof(addrstr)) {
+    print_usage();
+    PROCESS_EXIT();
+  }
+  memcpy(addrstr, args, next - args);
+  addrstr[next - args] = 0;
+  if(uiplib_ipaddrconv(addrstr, &remote) == 0) {
+    shell_output_str(&netperf6_command, "netperf6: bad address: ", addrstr);
+    PROCESS_EXIT();
+  }
+
+  num_packets = shell_strtolong(next, &nextptr);
+  if(nextptr == next || num_packets == 0) {
+    print_usage();
+    PROCESS_EXIT();
+  }
+  next = nextptr;
+  interval = shell_strtolong(next, &nextptr);
+  if(nextptr == next) {
+    interval = SHELL_NETPERF6_INTERVAL;
+  }
+  interval = interval * CLOCK_SECOND / 1000;
+  if(interval == 0) {
+    interval = 1;
+  }
+
+  /* Clear the statistics of the remote node, then ours */
+  ctrl_reply_type = MSG_STATS;
+  for(retries = 0; retries < MAX_RETRIES && ctrl_reply_type != MSG_CLEAR_ACK;
+      retries++) {
+    send_msg(&remote, MSG_CLEAR, 0, sizeof(struct netperf6_msg));
+    etimer_set(&e, SHELL_NETPERF6_TIMEOUT);
+    PROCESS_WAIT_UNTIL(etimer_expired(&e) || ev == CONTINUE_EVENT);
+  }
+  if(ctrl_reply_type != MSG_CLEAR_ACK) {
+    shell_output_str(&netperf6_command, "netperf6: no response from ", addrstr);
+    PROCESS_EXIT();
+  }
+  clear_stats();
+  current_type = type;
+
+  for(i = 0; i < num_packets; i++) {
+    if(current_type == TYPE_STREAM) {
+      send_msg(&remote, MSG_STREAM, i, SHELL_NETPERF6_DATALEN);
+    } else {
+      pending_seqno = i;
+      send_msg(&remote, MSG_ECHO_REQUEST, i, SHELL_NETPERF6_DATALEN);
+    }
+    stats.sent++;
+    if(current_type == TYPE_REQUEST_RESPONSE) {
+      etimer_set(&e, SHELL_NETPERF6_TIMEOUT);
+      PROCESS_WAIT_UNTIL(etimer_expired(&e) || ev == CONTINUE_EVENT);
+      if(etimer_expired(&e)) {
+        stats.timedout++;
+      }
+    } else {
+      etimer_set(&e, interval);
+      PROCESS_WAIT_UNTIL(etimer_expired(&e));
+    }
+  }
+  if(current_type != TYPE_REQUEST_RESPONSE) {
+    /* Late replies, and packets still queued along the path */
+    etimer_set(&e, SHELL_NETPERF6_TIMEOUT);
+    PROCESS_WAIT_UNTIL(etimer_expired(&e));
+  }
+  finalize_stats();
+  if(current_type == TYPE_FLOOD) {
+    stats.timedout = stats.sent - stats.received;
+  }
+
+  /* Fetch the statistics of the remote node */
+  ctrl_reply_type = MSG_CLEAR_ACK;
+  for(retries = 0; retries < MAX_RETRIES && ctrl_reply_type != MSG_STATS_REPLY;
+      retries++) {
+    send_msg(&remote, MSG_STATS, 0, sizeof(struct netperf6_msg));
+    etimer_set(&e, SHELL_NETPERF6_TIMEOUT);
+    PROCESS_WAIT_UNTIL(etimer_expired(&e) ||
+                       (ev == CONTINUE_EVENT && ctrl_reply_type == MSG_STATS_REPLY));
+  }
+  if(ctrl_reply_type != MSG_STATS_REPLY) {
+    shell_output_str(&netperf6_command, "netperf6: no statistics from ", addrstr);
+    memset(&remote_stats, 0, sizeof(remote_stats));
+  }
+  print_stats(&stats, &remote_stats);
+  current_type = TYPE_NONE;
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+shell_netperf6_init(void)
+{
+  simple_udp_register(&conn, SHELL_NETPERF6_PORT, NULL,
+                      SHELL_NETPERF6_PORT, receiver);
+  shell_register_command(&netperf6_command);
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,434 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         TSCH shell commands: slot-timing profile, deadline misses,
+ *         log filter, schedule and queues, runtime parameters,
+ *         RPL parents
+ */
+
+#include "contiki.h"
+#include "shell.h"
+#include "net/mac/tsch/tsch-private.h"
+#include "net/mac/tsch/tsch-log.h"
+#include "net/mac/tsch/tsch-queue.h"
+#include "net/mac/tsch/tsch-schedule.h"
+#if WITH_ORCHESTRA
+#include "orchestra.h"
+#endif /* WITH_ORCHESTRA */
+#if UIP_CONF_IPV6_RPL
+#include "net/rpl/rpl.h"
+#include "net/rpl/rpl-private.h"
+#endif /* UIP_CONF_IPV6_RPL */
+
+#include <stdio.h>
+#include <string.h>
+
+/*---------------------------------------------------------------------------*/
+PROCESS(shell_tsch_profile_process, "tsch-profile");
+SHELL_COMMAND(tsch_profile_command,
+	      "tsch-profile",
+	      "tsch-profile [reset]: print TSCH slot timing profile, in rtimer ticks",
+	      &shell_tsch_profile_process);
+PROCESS(shell_tsch_misses_process, "tsch-misses");
+SHELL_COMMAND(tsch_misses_command,
+	      "tsch-misses",
+	      "tsch-misses [reset]: print TSCH deadline misses",
+	      &shell_tsch_misses_process);
+PROCESS(shell_tsch_log_process, "tsch-log");
+SHELL_COMMAND(tsch_log_command,
+	      "tsch-log",
+	      "tsch-log [reset|all|types <bitmap>|links <bitmap>|sf <handle>|nbr <id>|sample <n>]: "
+	      "print or set the TSCH log filter (sf and nbr: -1 for any)",
+	      &shell_tsch_log_process);
+PROCESS(shell_tsch_schedule_process, "tsch-schedule");
+SHELL_COMMAND(tsch_schedule_command,
+	      "tsch-schedule",
+	      "tsch-schedule [reset]: print the TSCH schedule and link counters",
+	      &shell_tsch_schedule_process);
+PROCESS(shell_tsch_queue_process, "tsch-queue");
+SHELL_COMMAND(tsch_queue_command,
+	      "tsch-queue",
+	      "tsch-queue [reset]: print the TSCH neighbor queues",
+	      &shell_tsch_queue_process);
+PROCESS(shell_tsch_param_process, "tsch-param");
+SHELL_COMMAND(tsch_param_command,
+	      "tsch-param",
+	      "tsch-param [eb <s>|ka <s>|lifetime <s>]: print or set the EB period "
+	      "(0: automatic), keepalive timeout and Orchestra link lifetime",
+	      &shell_tsch_param_process);
+#if UIP_CONF_IPV6_RPL
+PROCESS(shell_rpl_parents_process, "rpl-parents");
+SHELL_COMMAND(rpl_parents_command,
+	      "rpl-parents",
+	      "rpl-parents: print the RPL rank and parents",
+	      &shell_rpl_parents_process);
+#endif /* UIP_CONF_IPV6_RPL */
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shell_tsch_profile_process, ev, data)
+{
+#if TSCH_WITH_SLOT_PROFILER
+  struct tsch_slot_profile profile;
+  char buf[32 + 6 * TSCH_SLOT_PROFILER_BUCKETS];
+  int i, j, len;
+#endif /* TSCH_WITH_SLOT_PROFILER */
+
+  PROCESS_BEGIN();
+
+#if TSCH_WITH_SLOT_PROFILER
+  if(data != NULL && strncmp(data, "reset", 5) == 0) {
+    shell_output_str(&tsch_profile_command,
+		     tsch_slot_profiler_reset() ? "profile reset" : "TSCH busy", "");
+    PROCESS_EXIT();
+  }
+
+  snprintf(buf, sizeof(buf), "budget tx_offset %lu tx_ack_delay %lu slot %lu bucket %lu",
+	   (unsigned long)TsTxOffset, (unsigned long)TsTxAckDelay,
+	   (unsigned long)TsSlotDuration,
+	   (unsigned long)tsch_slot_profiler_bucket_width());
+  shell_output_str(&tsch_profile_command, buf, "");
+
+  for(i = 0; i < TSCH_SLOT_PHASE_COUNT; i++) {
+    if(!tsch_slot_profiler_get(i, &profile)) {
+      shell_output_str(&tsch_profile_command, "no complete window yet", "");
+      break;
+    }
+    len = snprintf(buf, sizeof(buf), "%s n %u min %lu max %lu mean %lu |",
+		   tsch_slot_phase_name(i), profile.count,
+		   (unsigned long)profile.min, (unsigned long)profile.max,
+		   profile.count ? (unsigned long)(profile.sum / profile.count) : 0UL);
+    for(j = 0; j < TSCH_SLOT_PROFILER_BUCKETS && len < sizeof(buf); j++) {
+      len += snprintf(buf + len, sizeof(buf) - len, " %u", profile.hist[j]);
+    }
+    shell_output_str(&tsch_profile_command, buf, "");
+  }
+#else /* TSCH_WITH_SLOT_PROFILER */
+  shell_output_str(&tsch_profile_command,
+		   "slot profiler disabled (TSCH_CONF_WITH_SLOT_PROFILER)", "");
+#endif /* TSCH_WITH_SLOT_PROFILER */
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shell_tsch_misses_process, ev, data)
+{
+#if TSCH_WITH_DL_MISS_STATS
+  const struct tsch_dl_miss_stats *stats;
+  struct tsch_dl_miss miss;
+  char buf[80];
+  int i, len;
+#endif /* TSCH_WITH_DL_MISS_STATS */
+
+  PROCESS_BEGIN();
+
+#if TSCH_WITH_DL_MISS_STATS
+  if(data != NULL && strncmp(data, "reset", 5) == 0) {
+    shell_output_str(&tsch_misses_command,
+		     tsch_dl_miss_reset() ? "misses reset" : "TSCH busy", "");
+    PROCESS_EXIT();
+  }
+
+  stats = tsch_dl_miss_get_stats();
+  snprintf(buf, sizeof(buf), "total %lu skipped %lu normal %u adv %u adv-only %u none %u",
+	   (unsigned long)stats->total, (unsigned long)stats->skipped,
+	   stats->per_link_type[0], stats->per_link_type[1],
+	   stats->per_link_type[2], stats->per_link_type[3]);
+  shell_output_str(&tsch_misses_command, buf, "");
+
+  len = snprintf(buf, sizeof(buf), "phase");
+  for(i = 0; i <= TSCH_SLOT_PHASE_COUNT && len < sizeof(buf); i++) {
+    len += snprintf(buf + len, sizeof(buf) - len, " %s %u",
+		    tsch_slot_phase_name(i),
+		    stats->per_phase[i]);
+  }
+  shell_output_str(&tsch_misses_command, buf, "");
+
+  len = snprintf(buf, sizeof(buf), "slotframe");
+  for(i = 0; i < TSCH_DL_MISS_MAX_SLOTFRAMES && stats->per_slotframe[i].count
+	&& len < sizeof(buf); i++) {
+    len += snprintf(buf + len, sizeof(buf) - len, " %u:%u",
+		    stats->per_slotframe[i].handle, stats->per_slotframe[i].count);
+  }
+  if(len < sizeof(buf)) {
+    snprintf(buf + len, sizeof(buf) - len, " other:%u", stats->other_slotframes);
+  }
+  shell_output_str(&tsch_misses_command, buf, "");
+
+  for(i = 0; tsch_dl_miss_get_last(i, &miss); i++) {
+    snprintf(buf, sizeof(buf), "asn %x.%lx sf %u ts %u type %u phase %u%s late %lu",
+	     miss.asn.ms1b, (unsigned long)miss.asn.ls4b,
+	     miss.slotframe_handle, miss.timeslot, miss.link_type, miss.phase,
+	     miss.skipped ? " skipped" : "", (unsigned long)miss.late);
+    shell_output_str(&tsch_misses_command, buf, "");
+  }
+#else /* TSCH_WITH_DL_MISS_STATS */
+  shell_output_str(&tsch_misses_command,
+		   "deadline-miss stats disabled (TSCH_CONF_WITH_DL_MISS_STATS)", "");
+#endif /* TSCH_WITH_DL_MISS_STATS */
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+#if WITH_TSCH_LOG
+/* Parse a signed integer argument, for the -1 wildcard */
+static long
+parse_arg(const char *str)
+{
+  while(*str == ' ') {
+    str++;
+  }
+  if(*str == '-') {
+    return -(long)shell_strtolong(str + 1, NULL);
+  }
+  return shell_strtolong(str, NULL);
+}
+#endif /* WITH_TSCH_LOG */
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shell_tsch_log_process, ev, data)
+{
+#if WITH_TSCH_LOG
+  struct tsch_log_filter filter;
+  struct tsch_log_stats stats;
+  const char *arg = data;
+  char buf[80];
+#endif /* WITH_TSCH_LOG */
+
+  PROCESS_BEGIN();
+
+#if WITH_TSCH_LOG
+  tsch_log_get_filter(&filter);
+
+  if(arg != NULL && strncmp(arg, "reset", 5) == 0) {
+    tsch_log_reset_stats();
+  } else if(arg != NULL && strncmp(arg, "all", 3) == 0) {
+    filter.types = TSCH_LOG_TYPES_ALL;
+    filter.link_types = TSCH_LOG_LINK_TYPES_ALL;
+    filter.slotframe = TSCH_LOG_FILTER_ANY;
+    filter.neighbor = TSCH_LOG_FILTER_ANY;
+    filter.sample = 1;
+  } else if(arg != NULL && strncmp(arg, "types", 5) == 0) {
+    filter.types = parse_arg(arg + 5);
+  } else if(arg != NULL && strncmp(arg, "links", 5) == 0) {
+    filter.link_types = parse_arg(arg + 5);
+  } else if(arg != NULL && strncmp(arg, "sf", 2) == 0) {
+    filter.slotframe = parse_arg(arg + 2);
+  } else if(arg != NULL && strncmp(arg, "nbr", 3) == 0) {
+    filter.neighbor = parse_arg(arg + 3);
+  } else if(arg != NULL && strncmp(arg, "sample", 6) == 0) {
+    filter.sample = parse_arg(arg + 6);
+  } else if(arg != NULL && *arg != '\0') {
+    shell_output_str(&tsch_log_command, "unknown option ", arg);
+    PROCESS_EXIT();
+  }
+  tsch_log_set_filter(&filter);
+
+  snprintf(buf, sizeof(buf), "filter types 0x%x links 0x%x sf %d nbr %d sample %u",
+	   filter.types, filter.link_types, filter.slotframe,
+	   filter.neighbor, filter.sample);
+  shell_output_str(&tsch_log_command, buf, "");
+  tsch_log_get_stats(&stats);
+  snprintf(buf, sizeof(buf), "added %lu dropped %lu filtered %lu",
+	   (unsigned long)stats.added, (unsigned long)stats.dropped,
+	   (unsigned long)stats.filtered);
+  shell_output_str(&tsch_log_command, buf, "");
+#else /* WITH_TSCH_LOG */
+  shell_output_str(&tsch_log_command, "TSCH log disabled (WITH_TSCH_LOG)", "");
+#endif /* WITH_TSCH_LOG */
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shell_tsch_schedule_process, ev, data)
+{
+  struct tsch_slotframe *sf;
+  struct tsch_link *l;
+  char buf[128];
+  int len;
+
+  PROCESS_BEGIN();
+
+  if(data != NULL && strncmp(data, "reset", 5) == 0) {
+#if TSCH_SCHEDULE_WITH_LINK_STATS
+    tsch_schedule_reset_link_stats();
+    shell_output_str(&tsch_schedule_command, "link counters reset", "");
+#else /* TSCH_SCHEDULE_WITH_LINK_STATS */
+    shell_output_str(&tsch_schedule_command,
+		     "link counters disabled (TSCH_SCHEDULE_CONF_WITH_LINK_STATS)", "");
+#endif /* TSCH_SCHEDULE_WITH_LINK_STATS */
+    PROCESS_EXIT();
+  }
+
+  for(sf = tsch_schedule_slotframe_head(); sf != NULL;
+      sf = tsch_schedule_slotframe_next(sf)) {
+    snprintf(buf, sizeof(buf), "slotframe %u size %u", sf->handle, sf->size.val);
+    shell_output_str(&tsch_schedule_command, buf, "");
+    for(l = list_head(sf->links_list); l != NULL; l = list_item_next(l)) {
+      len = snprintf(buf, sizeof(buf), "ts %u ch %u opt 0x%02x type %u nbr %u",
+		     l->timeslot, l->channel_offset, l->link_options, l->link_type,
+		     LOG_NODEID_FROM_LINKADDR(tsch_schedule_get_link_addr(l)));
+#if TSCH_SCHEDULE_WITH_LINK_STATS
+      if(len < sizeof(buf)) {
+	snprintf(buf + len, sizeof(buf) - len, ", tx %u ok %u noack %u nack %u busy %u, rx %u idle %u",
+		 l->stats.tx_attempts, l->stats.tx_ok, l->stats.tx_noack, l->stats.tx_nack,
+		 l->stats.cca_busy, l->stats.rx_ok, l->stats.rx_idle);
+      }
+#endif /* TSCH_SCHEDULE_WITH_LINK_STATS */
+      shell_output_str(&tsch_schedule_command, buf, "");
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shell_tsch_queue_process, ev, data)
+{
+  struct tsch_neighbor *n;
+#if TSCH_QUEUE_WITH_STATS
+  const struct tsch_queue_stats *s;
+#endif /* TSCH_QUEUE_WITH_STATS */
+  char buf[128];
+  int len;
+
+  PROCESS_BEGIN();
+
+  if(data != NULL && strncmp(data, "reset", 5) == 0) {
+#if TSCH_QUEUE_WITH_STATS
+    tsch_queue_reset_stats();
+    shell_output_str(&tsch_queue_command, "queue counters reset", "");
+#else /* TSCH_QUEUE_WITH_STATS */
+    shell_output_str(&tsch_queue_command,
+		     "queue counters disabled (TSCH_QUEUE_CONF_WITH_STATS)", "");
+#endif /* TSCH_QUEUE_WITH_STATS */
+    PROCESS_EXIT();
+  }
+
+  for(n = tsch_queue_first_nbr(); n != NULL; n = tsch_queue_next_nbr(n)) {
+    len = snprintf(buf, sizeof(buf), "nbr %u%s len %d",
+		   LOG_NODEID_FROM_LINKADDR(&n->addr),
+		   n->is_time_source ? " (time source)" : "",
+		   tsch_queue_packet_count(&n->addr));
+#if TSCH_QUEUE_WITH_STATS
+    s = tsch_queue_get_stats(&n->addr);
+    if(s != NULL && len < sizeof(buf)) {
+      snprintf(buf + len, sizeof(buf) - len,
+	       " max %u, in %u out %u drop full %u retries %u aqm %u, sojourn avg %lu max %u",
+	       s->max_len, s->enqueued, s->dequeued,
+	       s->drop_full, s->drop_retries, s->drop_aqm,
+	       s->dequeued ? (unsigned long)(s->sojourn_sum / s->dequeued) : 0UL,
+	       s->sojourn_max);
+    }
+#endif /* TSCH_QUEUE_WITH_STATS */
+    shell_output_str(&tsch_queue_command, buf, "");
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shell_tsch_param_process, ev, data)
+{
+  const char *arg = data;
+  char buf[80];
+
+  PROCESS_BEGIN();
+
+  if(arg != NULL && strncmp(arg, "eb", 2) == 0) {
+    tsch_set_fixed_eb_period(shell_strtolong(arg + 2, NULL) * CLOCK_SECOND);
+  } else if(arg != NULL && strncmp(arg, "ka", 2) == 0) {
+    tsch_set_keepalive_timeout(shell_strtolong(arg + 2, NULL) * CLOCK_SECOND);
+  } else if(arg != NULL && strncmp(arg, "lifetime", 8) == 0) {
+#if WITH_ORCHESTRA
+    orchestra_sb_set_link_lifetime(shell_strtolong(arg + 8, NULL) * CLOCK_SECOND);
+#else /* WITH_ORCHESTRA */
+    shell_output_str(&tsch_param_command, "Orchestra disabled (WITH_ORCHESTRA)", "");
+    PROCESS_EXIT();
+#endif /* WITH_ORCHESTRA */
+  } else if(arg != NULL && *arg != '\0') {
+    shell_output_str(&tsch_param_command, "unknown option ", arg);
+    PROCESS_EXIT();
+  }
+
+  snprintf(buf, sizeof(buf), "eb %lu ka %lu",
+	   (unsigned long)(tsch_get_eb_period() / CLOCK_SECOND),
+	   (unsigned long)(tsch_get_keepalive_timeout() / CLOCK_SECOND));
+  shell_output_str(&tsch_param_command, buf, "");
+#if WITH_ORCHESTRA
+  snprintf(buf, sizeof(buf), "lifetime %lu",
+	   (unsigned long)(orchestra_sb_get_link_lifetime() / CLOCK_SECOND));
+  shell_output_str(&tsch_param_command, buf, "");
+#endif /* WITH_ORCHESTRA */
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_CONF_IPV6_RPL
+PROCESS_THREAD(shell_rpl_parents_process, ev, data)
+{
+  rpl_dag_t *dag;
+  rpl_parent_t *p;
+  char buf[64];
+
+  PROCESS_BEGIN();
+
+  dag = rpl_get_any_dag();
+  if(dag == NULL) {
+    shell_output_str(&rpl_parents_command, "no DAG", "");
+    PROCESS_EXIT();
+  }
+  snprintf(buf, sizeof(buf), "rank %u", dag->rank);
+  shell_output_str(&rpl_parents_command, buf, "");
+  for(p = nbr_table_head(rpl_parents); p != NULL; p = nbr_table_next(rpl_parents, p)) {
+    snprintf(buf, sizeof(buf), "parent %u%s rank %u link metric %u",
+	     LOG_NODEID_FROM_LINKADDR(nbr_table_get_lladdr(rpl_parents, p)),
+	     p == dag->preferred_parent ? " (preferred)" : "",
+	     p->rank, p->link_metric);
+    shell_output_str(&rpl_parents_command, buf, "");
+  }
+
+  PROCESS_END();
+}
+#endif /* UIP_CONF_IPV6_RPL */
+/*---------------------------------------------------------------------------*/
+void
+shell_tsch_init(void)
+{
+  shell_register_command(&tsch_profile_command);
+  shell_register_command(&tsch_misses_command);
+  shell_register_command(&tsch_log_command);
+  shell_register_command(&tsch_schedule_command);
+  shell_register_command(&tsch_queue_command);
+  shell_register_command(&tsch_param_command);
+#if UIP_CONF_IPV6_RPL
+  shell_register_command(&rpl_parents_command);
+#endif /* UIP_CONF_IPV6_RPL */
+}
+/*---------------------------------------------------------------------------*/
@@ -384,6 +384,7 @@ struct shell_input {
 #include "shell-memdebug.h"
 #include "shell-netfile.h"
 #include "shell-netperf.h"
+#include "shell-netperf6.h"
 #include "shell-netstat.h"
 #include "shell-ping.h"
 #include "shell-power.h"
@@ -406,6 +407,7 @@ struct shell_input {
 #include "shell-tcpsend.h"
 #include "shell-text.h"
 #include "shell-time.h"
+#include "shell-tsch.h"
 #include "shell-udpsend.h"
 #include "shell-vars.h"
 #include "shell-wget.h"
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *	Append-only record logs on top of Coffee.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
+#include "cfs-coffee-arch.h"
+#include "cfs/cfs-coffee-ring.h"
+
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+/*
+ * Every chunk starts with its number plus one, never zero so that the
+ * header is always counted in the file size.
+ */
+typedef uint32_t chunk_header_t;
+
+#define CHUNK_OFFSET(ring, index) \
+  (sizeof(chunk_header_t) + \
+   (cfs_offset_t)((index) % (ring)->chunk_records) * (ring)->record_size)
+
+/*---------------------------------------------------------------------------*/
+static void
+chunk_name(struct cfs_coffee_ring *ring, uint32_t chunk, char *name)
+{
+  sprintf(name, "%s.%u", ring->name, (unsigned)(chunk % ring->chunks));
+}
+/*---------------------------------------------------------------------------*/
+static int
+open_chunk(struct cfs_coffee_ring *ring, uint32_t chunk, int flags)
+{
+  char name[COFFEE_NAME_LENGTH];
+
+  chunk_name(ring, chunk, name);
+  return cfs_open(name, flags);
+}
+/*---------------------------------------------------------------------------*/
+/* Opens the chunk of ring->next for appending, starting it if needed */
+static int
+append_chunk(struct cfs_coffee_ring *ring)
+{
+  char name[COFFEE_NAME_LENGTH];
+  uint32_t chunk;
+  chunk_header_t header;
+
+  chunk = ring->next / ring->chunk_records;
+  chunk_name(ring, chunk, name);
+
+  if(ring->next % ring->chunk_records != 0) {
+    /* Resume a chunk left after cfs_coffee_ring_open() */
+    ring->fd = cfs_open(name, CFS_WRITE | CFS_APPEND);
+    if(ring->fd < 0) {
+      return -1;
+    }
+    cfs_coffee_set_io_semantics(ring->fd, CFS_COFFEE_IO_FLASH_AWARE |
+                                CFS_COFFEE_IO_FIRM_SIZE);
+    cfs_seek(ring->fd, CHUNK_OFFSET(ring, ring->next), CFS_SEEK_SET);
+    return 0;
+  }
+
+  if(chunk >= ring->chunks) {
+    if(!(ring->flags & CFS_COFFEE_RING_WRAP)) {
+      return -1;
+    }
+    /* The slot holds the oldest chunk */
+    if(ring->first < (chunk - ring->chunks + 1) * ring->chunk_records) {
+      ring->first = (chunk - ring->chunks + 1) * ring->chunk_records;
+    }
+  }
+  cfs_remove(name);
+
+  if(cfs_coffee_reserve(name, sizeof(header) +
+                        (cfs_offset_t)ring->chunk_records * ring->record_size) < 0) {
+    PRINTF("ring: cannot reserve %s\n", name);
+    return -1;
+  }
+  ring->fd = cfs_open(name, CFS_WRITE);
+  if(ring->fd < 0) {
+    return -1;
+  }
+  cfs_coffee_set_io_semantics(ring->fd, CFS_COFFEE_IO_FLASH_AWARE |
+                              CFS_COFFEE_IO_FIRM_SIZE);
+  header = chunk + 1;
+  if(cfs_write(ring->fd, &header, sizeof(header)) != sizeof(header)) {
+    cfs_close(ring->fd);
+    ring->fd = -1;
+    return -1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+cfs_coffee_ring_open(struct cfs_coffee_ring *ring, const char *name,
+                     uint16_t record_size, uint16_t chunk_records,
+                     uint8_t chunks, uint8_t flags)
+{
+  chunk_header_t header;
+  uint32_t oldest, newest;
+  cfs_offset_t end;
+  int found;
+  int fd;
+  int i;
+
+  if(record_size == 0 || chunk_records == 0 || chunks == 0 ||
+     strlen(name) + 5 > COFFEE_NAME_LENGTH) {
+    return -1;
+  }
+
+  ring->name = name;
+  ring->record_size = record_size;
+  ring->chunk_records = chunk_records;
+  ring->chunks = chunks;
+  ring->flags = flags;
+  ring->fd = -1;
+  ring->first = ring->next = 0;
+
+  oldest = newest = 0;
+  found = 0;
+  for(i = 0; i < chunks; i++) {
+    fd = open_chunk(ring, i, CFS_READ);
+    if(fd < 0) {
+      continue;
+    }
+    if(cfs_read(fd, &header, sizeof(header)) == sizeof(header) &&
+       header > 0 && (header - 1) % chunks == i) {
+      header--;
+      if(!found || header < oldest) {
+        oldest = header;
+      }
+      if(!found || header > newest) {
+        newest = header;
+      }
+      found = 1;
+    }
+    cfs_close(fd);
+  }
+
+  if(!found) {
+    return 0;
+  }
+
+  fd = open_chunk(ring, newest, CFS_READ);
+  if(fd < 0) {
+    return -1;
+  }
+  end = cfs_seek(fd, 0, CFS_SEEK_END);
+  cfs_close(fd);
+  if(end < (cfs_offset_t)sizeof(header)) {
+    end = sizeof(header);
+  }
+
+  ring->first = oldest * chunk_records;
+  ring->next = newest * chunk_records +
+    (end - sizeof(header) + record_size - 1) / record_size;
+  if(ring->next > (newest + 1) * chunk_records) {
+    ring->next = (newest + 1) * chunk_records;
+  }
+  PRINTF("ring: %s records %lu to %lu\n", name,
+         (unsigned long)ring->first, (unsigned long)ring->next);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+cfs_coffee_ring_append(struct cfs_coffee_ring *ring, const void *record)
+{
+  if(ring->fd >= 0 && ring->next % ring->chunk_records == 0) {
+    cfs_coffee_ring_close(ring);
+  }
+  if(ring->fd < 0 && append_chunk(ring) < 0) {
+    return -1;
+  }
+
+  if(cfs_write(ring->fd, record, ring->record_size) != ring->record_size) {
+    /* Do not leave a hole: the chunk is resumed at the next append */
+    cfs_coffee_ring_close(ring);
+    return -1;
+  }
+  ring->next++;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+cfs_coffee_ring_read(struct cfs_coffee_ring *ring, uint32_t index,
+                     void *record)
+{
+  int fd;
+  int r;
+
+  if(index < ring->first || index >= ring->next) {
+    return -1;
+  }
+
+  fd = open_chunk(ring, index / ring->chunk_records, CFS_READ);
+  if(fd < 0) {
+    return -1;
+  }
+  /* Trailing zeroes of the last record are not part of the file size */
+  memset(record, 0, ring->record_size);
+  if(cfs_seek(fd, CHUNK_OFFSET(ring, index), CFS_SEEK_SET) < 0) {
+    r = -1;
+  } else {
+    r = cfs_read(fd, record, ring->record_size);
+  }
+  cfs_close(fd);
+
+  return r < 0 ? -1 : 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+cfs_coffee_ring_close(struct cfs_coffee_ring *ring)
+{
+  if(ring->fd >= 0) {
+    cfs_close(ring->fd);
+    ring->fd = -1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+cfs_coffee_ring_remove(struct cfs_coffee_ring *ring)
+{
+  char name[COFFEE_NAME_LENGTH];
+  int i;
+
+  cfs_coffee_ring_close(ring);
+  for(i = 0; i < ring->chunks; i++) {
+    chunk_name(ring, i, name);
+    cfs_remove(name);
+  }
+  ring->first = ring->next = 0;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \addtogroup cfs
+ * @{
+ */
+
+/**
+ * \file
+ *	Append-only record logs on top of Coffee, for sensor data logging.
+ *
+ *	A log stores fixed-size records, numbered from 0 in the order they
+ *	are appended. The records are kept in a set of chunk files,
+ *	"<name>.<slot>", of chunk_records records each. Every chunk is
+ *	reserved at its final size when it is started and written
+ *	sequentially with CFS_COFFEE_IO_FLASH_AWARE | CFS_COFFEE_IO_FIRM_SIZE,
+ *	so appends never go through a micro log and never extend (copy) the
+ *	file. The location of a record follows from its number, which makes
+ *	reading any record, and the tail in particular, a single seek.
+ *
+ *	When all chunks are full, a log opened with CFS_COFFEE_RING_WRAP
+ *	removes its oldest chunk to start a new one, discarding
+ *	chunk_records records at once; otherwise appending fails.
+ *
+ *	The log state is recovered by cfs_coffee_ring_open() from the chunk
+ *	headers. As for any Coffee file, trailing zero bytes are not counted
+ *	in the size of the last chunk: a last record made of zeroes only is
+ *	lost when the log is reopened.
+ *
+ *	Compile with PROJECT_SOURCEFILES += cfs-coffee-ring.c.
+ */
+
+#ifndef CFS_COFFEE_RING_H
+#define CFS_COFFEE_RING_H
+
+#include "contiki-conf.h"
+
+/** Overwrite the oldest records when the log is full. */
+#define CFS_COFFEE_RING_WRAP	0x1
+
+struct cfs_coffee_ring {
+  const char *name;
+  /** Number of the oldest record kept */
+  uint32_t first;
+  /** Number of the next record appended */
+  uint32_t next;
+  uint16_t record_size;
+  uint16_t chunk_records;
+  uint8_t chunks;
+  uint8_t flags;
+  /** Descriptor of the chunk being appended to, -1 if none */
+  int fd;
+};
+
+/**
+ * \brief Open a record log, creating it if it does not exist.
+ * \param ring The log state, kept by the caller.
+ * \param name The base name of the chunk files, at most
+ *             COFFEE_NAME_LENGTH - 5 characters.
+ * \param record_size The size of a record.
+ * \param chunk_records The number of records per chunk.
+ * \param chunks The number of chunks, at most 255.
+ * \param flags 0 or CFS_COFFEE_RING_WRAP.
+ * \return 0 on success, -1 on failure.
+ *
+ * The same sizes must be used every time a given log is opened.
+ */
+int cfs_coffee_ring_open(struct cfs_coffee_ring *ring, const char *name,
+                         uint16_t record_size, uint16_t chunk_records,
+                         uint8_t chunks, uint8_t flags);
+
+/**
+ * \brief Append a record.
+ * \return 0 on success, -1 on failure, e.g. if the log is full and does
+ *         not wrap.
+ */
+int cfs_coffee_ring_append(struct cfs_coffee_ring *ring, const void *record);
+
+/**
+ * \brief Read record number index, from ring->first to ring->next - 1.
+ * \return 0 on success, -1 on failure or if the record is not kept.
+ */
+int cfs_coffee_ring_read(struct cfs_coffee_ring *ring, uint32_t index,
+                         void *record);
+
+/** \brief The number of records kept. */
+#define cfs_coffee_ring_count(ring) ((ring)->next - (ring)->first)
+
+/** \brief Close the chunk being appended to. */
+void cfs_coffee_ring_close(struct cfs_coffee_ring *ring);
+
+/** \brief Remove all records of the log. */
+void cfs_coffee_ring_remove(struct cfs_coffee_ring *ring);
+
+#endif /* !CFS_COFFEE_RING_H */
+
+/** @} */
@@ -58,6 +58,9 @@
 #include "cfs/cfs.h"
 #include "cfs-coffee-arch.h"
 #include "cfs/cfs-coffee.h"
+#if COFFEE_BACKGROUND_GC
+#include "sys/process.h"
+#endif
 
 /* Micro logs enable modifications on storage types that do not support
    in-place updates. This applies primarily to flash memories. */
@@ -90,6 +93,52 @@
 #define COFFEE_EXTENDED_WEAR_LEVELLING	1
 #endif
 
+/*
+ * Keep an index of the active files in RAM: a hash of the name, the
+ * first page, and the end offset once known. Opening a file then reads
+ * a single header instead of scanning the file system, and does not
+ * search for the end of the file again after it was evicted from the
+ * file cache. Files beyond COFFEE_PAGE_INDEX_SIZE are found by
+ * scanning, as without the index.
+ */
+#ifndef COFFEE_PAGE_INDEX
+#ifdef COFFEE_CONF_PAGE_INDEX
+#define COFFEE_PAGE_INDEX	COFFEE_CONF_PAGE_INDEX
+#else
+#define COFFEE_PAGE_INDEX	0
+#endif
+#endif
+
+#ifndef COFFEE_PAGE_INDEX_SIZE
+#ifdef COFFEE_CONF_PAGE_INDEX_SIZE
+#define COFFEE_PAGE_INDEX_SIZE	COFFEE_CONF_PAGE_INDEX_SIZE
+#else
+#define COFFEE_PAGE_INDEX_SIZE	16
+#endif
+#endif
+
+/*
+ * Collect garbage in the background, one sector per step of a process
+ * that yields between steps, as soon as files are allocated in the last
+ * COFFEE_GC_WATERMARK sectors. The synchronous collection in reserve()
+ * then only runs when the background one could not keep up.
+ */
+#ifndef COFFEE_BACKGROUND_GC
+#ifdef COFFEE_CONF_BACKGROUND_GC
+#define COFFEE_BACKGROUND_GC	COFFEE_CONF_BACKGROUND_GC
+#else
+#define COFFEE_BACKGROUND_GC	0
+#endif
+#endif
+
+#ifndef COFFEE_GC_WATERMARK
+#ifdef COFFEE_CONF_GC_WATERMARK
+#define COFFEE_GC_WATERMARK	COFFEE_CONF_GC_WATERMARK
+#else
+#define COFFEE_GC_WATERMARK	2
+#endif
+#endif
+
 #if COFFEE_START & (COFFEE_SECTOR_SIZE - 1)
 #error COFFEE_START must point to the first byte in a sector.
 #endif
@@ -159,6 +208,9 @@ struct sector_status {
   coffee_page_t active;
   coffee_page_t obsolete;
   coffee_page_t free;
+  /* Obsolete pages at the start of the sector, of a file starting in
+     a previous sector. */
+  coffee_page_t head;
 };
 
 /* The structure of cached file objects. */
@@ -193,6 +245,21 @@ struct file_header {
   char name[COFFEE_NAME_LENGTH];
 };
 
+#if COFFEE_PAGE_INDEX
+/* An entry of the page index, free if page is INVALID_PAGE. */
+struct page_index_entry {
+  cfs_offset_t end;
+  coffee_page_t page;
+  uint16_t hash;
+};
+
+/* The index is built on first use, and rebuilt when files were missing
+   from it and a slot became free. */
+#define PAGE_INDEX_UNKNOWN	0
+#define PAGE_INDEX_COMPLETE	1
+#define PAGE_INDEX_OVERFLOW	2
+#endif /* COFFEE_PAGE_INDEX */
+
 /* This is needed because of a buggy compiler. */
 struct log_param {
   cfs_offset_t offset;
@@ -211,11 +278,19 @@ static struct protected_mem_t {
   struct file_desc coffee_fd_set[COFFEE_FD_SET_SIZE];
   coffee_page_t next_free;
   char gc_wait;
+#if COFFEE_PAGE_INDEX
+  struct page_index_entry page_index[COFFEE_PAGE_INDEX_SIZE];
+  uint8_t page_index_state;
+#endif /* COFFEE_PAGE_INDEX */
 } protected_mem;
 static struct file * const coffee_files = protected_mem.coffee_files;
 static struct file_desc * const coffee_fd_set = protected_mem.coffee_fd_set;
 static coffee_page_t * const next_free = &protected_mem.next_free;
 static char * const gc_wait = &protected_mem.gc_wait;
+#if COFFEE_PAGE_INDEX
+static struct page_index_entry * const page_index = protected_mem.page_index;
+static uint8_t * const page_index_state = &protected_mem.page_index_state;
+#endif /* COFFEE_PAGE_INDEX */
 
 /*---------------------------------------------------------------------------*/
 static void
@@ -283,10 +358,12 @@ get_sector_status(uint16_t sector, struct sector_status *stats)
   } else {
     if(skip_pages >= COFFEE_PAGES_PER_SECTOR) {
       stats->obsolete = COFFEE_PAGES_PER_SECTOR;
+      stats->head = COFFEE_PAGES_PER_SECTOR;
       skip_pages -= COFFEE_PAGES_PER_SECTOR;
       return skip_pages >= COFFEE_PAGES_PER_SECTOR ? 0 : skip_pages;
     }
     obsolete = skip_pages;
+    stats->head = skip_pages;
   }
 
   /* Determine the amount of pages of each type that have not been 
@@ -362,12 +439,68 @@ isolate_pages(coffee_page_t start, coffee_page_t skip_pages)
 
 }
 /*---------------------------------------------------------------------------*/
+/* Return values of collect_sector(). */
+#define SECTOR_KEPT		0
+#define SECTOR_ERASED		1
+#define SECTOR_ERASED_ISOLATED	2
+
+/*
+ * Erases a sector if it is erasable. previous_erased tells whether the
+ * previous sector was erased right before, along with the header of
+ * any file extending into this sector.
+ */
+static int
+collect_sector(uint16_t sector, int mode, int previous_erased)
+{
+  struct sector_status stats;
+  coffee_page_t first_page, isolation_count;
+
+  isolation_count = get_sector_status(sector, &stats);
+  PRINTF("Coffee: Sector %u has %u active, %u obsolete, and %u free pages.\n",
+      sector, (unsigned)stats.active,
+      (unsigned)stats.obsolete, (unsigned)stats.free);
+
+  if(stats.active > 0) {
+    return SECTOR_KEPT;
+  }
+
+  if(previous_erased) {
+    stats.head = 0;
+  } else if(stats.head >= COFFEE_PAGES_PER_SECTOR) {
+    /* The whole sector would have to be isolated again. */
+    return SECTOR_KEPT;
+  }
+
+  if((mode == GC_RELUCTANT && stats.free == 0) ||
+     (mode == GC_GREEDY && stats.obsolete > 0)) {
+    first_page = sector * COFFEE_PAGES_PER_SECTOR;
+    if(first_page < *next_free) {
+      *next_free = first_page;
+    }
+
+    if(isolation_count > 0) {
+      isolate_pages(first_page + COFFEE_PAGES_PER_SECTOR, isolation_count);
+    }
+
+    COFFEE_ERASE(sector);
+    PRINTF("Coffee: Erased sector %d!\n", sector);
+
+    if(stats.head > 0) {
+      /* The file extending into this sector still has its header in
+         the previous one, and covers these pages when skipping over it. */
+      isolate_pages(first_page, stats.head);
+    }
+
+    return isolation_count > 0 ? SECTOR_ERASED_ISOLATED : SECTOR_ERASED;
+  }
+  return SECTOR_KEPT;
+}
+/*---------------------------------------------------------------------------*/
 static void
 collect_garbage(int mode)
 {
   uint16_t sector;
-  struct sector_status stats;
-  coffee_page_t first_page, isolation_count;
+  int status;
 
   PRINTF("Coffee: Running the file system garbage collector in %s mode\n",
 	 mode == GC_RELUCTANT ? "reluctant" : "greedy");
@@ -375,36 +508,40 @@ collect_garbage(int mode)
    * The garbage collector erases as many sectors as possible. A sector is
    * erasable if there are only free or obsolete pages in it.
    */
+  status = SECTOR_KEPT;
   for(sector = 0; sector < COFFEE_SECTOR_COUNT; sector++) {
-    isolation_count = get_sector_status(sector, &stats);
-    PRINTF("Coffee: Sector %u has %u active, %u obsolete, and %u free pages.\n",
-        sector, (unsigned)stats.active,
-	(unsigned)stats.obsolete, (unsigned)stats.free);
-
-    if(stats.active > 0) {
-      continue;
+    status = collect_sector(sector, mode, status != SECTOR_KEPT);
+    if(mode == GC_RELUCTANT && status == SECTOR_ERASED_ISOLATED) {
+      break;
     }
+  }
+}
+#if COFFEE_BACKGROUND_GC
+/*---------------------------------------------------------------------------*/
+PROCESS(coffee_gc_process, "Coffee GC");
+PROCESS_THREAD(coffee_gc_process, ev, data)
+{
+  static uint16_t sector;
+  uint16_t i;
+  struct sector_status stats;
 
-    if((mode == GC_RELUCTANT && stats.free == 0) ||
-       (mode == GC_GREEDY && stats.obsolete > 0)) {
-      first_page = sector * COFFEE_PAGES_PER_SECTOR;
-      if(first_page < *next_free) {
-        *next_free = first_page;
-      }
-
-      if(isolation_count > 0) {
-        isolate_pages(first_page + COFFEE_PAGES_PER_SECTOR, isolation_count);
-      }
-
-      COFFEE_ERASE(sector);
-      PRINTF("Coffee: Erased sector %d!\n", sector);
+  PROCESS_BEGIN();
 
-      if(mode == GC_RELUCTANT && isolation_count > 0) {
-        break;
-      }
+  PRINTF("Coffee: Running the file system garbage collector in background\n");
+  for(sector = 0; sector < COFFEE_SECTOR_COUNT; sector++) {
+    /* get_sector_status() iterates from sector 0, and files may have
+       been reserved or removed since the previous step. */
+    for(i = 0; i < sector; i++) {
+      get_sector_status(i, &stats);
     }
+    collect_sector(sector, GC_GREEDY, 0);
+    /* Let other processes run between sectors. */
+    PROCESS_PAUSE();
   }
+
+  PROCESS_END();
 }
+#endif /* COFFEE_BACKGROUND_GC */
 /*---------------------------------------------------------------------------*/
 static coffee_page_t
 next_file(coffee_page_t page, struct file_header *hdr)
@@ -426,6 +563,100 @@ next_file(coffee_page_t page, struct file_header *hdr)
   }
   return page + hdr->max_pages;    
 }
+#if COFFEE_PAGE_INDEX
+/*---------------------------------------------------------------------------*/
+static uint16_t
+name_hash(const char *name)
+{
+  uint16_t hash;
+  int i;
+
+  hash = 5381;
+  /* Over the part of the name kept in file headers. */
+  for(i = 0; i < COFFEE_NAME_LENGTH - 1 && name[i] != '\0'; i++) {
+    hash = hash * 33 + (unsigned char)name[i];
+  }
+  return hash;
+}
+/*---------------------------------------------------------------------------*/
+static struct page_index_entry *
+index_find_page(coffee_page_t page)
+{
+  int i;
+
+  for(i = 0; i < COFFEE_PAGE_INDEX_SIZE; i++) {
+    if(page_index[i].page == page) {
+      return &page_index[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_add(const char *name, coffee_page_t page, cfs_offset_t end)
+{
+  struct page_index_entry *entry;
+
+  if(*page_index_state == PAGE_INDEX_UNKNOWN) {
+    /* Will be found when the index is built. */
+    return;
+  }
+
+  entry = index_find_page(INVALID_PAGE);
+  if(entry == NULL) {
+    *page_index_state = PAGE_INDEX_OVERFLOW;
+    return;
+  }
+  entry->page = page;
+  entry->end = end;
+  entry->hash = name_hash(name);
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_remove(coffee_page_t page)
+{
+  struct page_index_entry *entry;
+
+  entry = index_find_page(page);
+  if(entry != NULL) {
+    entry->page = INVALID_PAGE;
+    if(*page_index_state == PAGE_INDEX_OVERFLOW) {
+      /* There is room for one of the files left out. */
+      *page_index_state = PAGE_INDEX_UNKNOWN;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_build(void)
+{
+  struct file_header hdr;
+  coffee_page_t page;
+  int i;
+
+  for(i = 0; i < COFFEE_PAGE_INDEX_SIZE; i++) {
+    page_index[i].page = INVALID_PAGE;
+  }
+  *page_index_state = PAGE_INDEX_COMPLETE;
+
+  for(page = 0; page < COFFEE_PAGE_COUNT; page = next_file(page, &hdr)) {
+    read_header(&hdr, page);
+    if(HDR_ACTIVE(hdr) && !HDR_LOG(hdr)) {
+      index_add(hdr.name, page, UNKNOWN_OFFSET);
+    }
+  }
+
+  /* Cached files know their end already. */
+  for(i = 0; i < COFFEE_MAX_OPEN_FILES; i++) {
+    if(!FILE_FREE(&coffee_files[i])) {
+      struct page_index_entry *entry = index_find_page(coffee_files[i].page);
+      if(entry != NULL) {
+        entry->end = coffee_files[i].end;
+      }
+    }
+  }
+}
+#endif /* COFFEE_PAGE_INDEX */
 /*---------------------------------------------------------------------------*/
 static struct file *
 load_file(coffee_page_t start, struct file_header *hdr)
@@ -456,8 +687,25 @@ load_file(coffee_page_t start, struct file_header *hdr)
   }
 
   file = &coffee_files[i];
+#if COFFEE_PAGE_INDEX
+  if(!FILE_FREE(file)) {
+    /* Keep the end of the evicted file. */
+    struct page_index_entry *entry = index_find_page(file->page);
+    if(entry != NULL) {
+      entry->end = file->end;
+    }
+  }
+#endif /* COFFEE_PAGE_INDEX */
   file->page = start;
   file->end = UNKNOWN_OFFSET;
+#if COFFEE_PAGE_INDEX
+  {
+    struct page_index_entry *entry = index_find_page(start);
+    if(entry != NULL) {
+      file->end = entry->end;
+    }
+  }
+#endif /* COFFEE_PAGE_INDEX */
   file->max_pages = hdr->max_pages;
   file->flags = 0;
   if(HDR_MODIFIED(*hdr)) {
@@ -475,6 +723,36 @@ find_file(const char *name)
   int i;
   struct file_header hdr;
   coffee_page_t page;
+
+#if COFFEE_PAGE_INDEX
+  uint16_t hash;
+
+  if(*page_index_state == PAGE_INDEX_UNKNOWN) {
+    index_build();
+  }
+
+  hash = name_hash(name);
+  for(i = 0; i < COFFEE_PAGE_INDEX_SIZE; i++) {
+    if(page_index[i].page == INVALID_PAGE || page_index[i].hash != hash) {
+      continue;
+    }
+    page = page_index[i].page;
+    read_header(&hdr, page);
+    if(HDR_ACTIVE(hdr) && !HDR_LOG(hdr) && strcmp(name, hdr.name) == 0) {
+      int j;
+      for(j = 0; j < COFFEE_MAX_OPEN_FILES; j++) {
+        if(!FILE_FREE(&coffee_files[j]) && coffee_files[j].page == page) {
+          return &coffee_files[j];
+        }
+      }
+      return load_file(page, &hdr);
+    }
+  }
+
+  if(*page_index_state == PAGE_INDEX_COMPLETE) {
+    return NULL;
+  }
+#endif /* COFFEE_PAGE_INDEX */
   
   /* First check if the file metadata is cached. */
   for(i = 0; i < COFFEE_MAX_OPEN_FILES; i++) {
@@ -589,6 +867,9 @@ remove_by_page(coffee_page_t page, int remove_log, int close_fds,
 
   hdr.flags |= HDR_FLAG_OBSOLETE;
   write_header(&hdr, page);
+#if COFFEE_PAGE_INDEX
+  index_remove(page);
+#endif /* COFFEE_PAGE_INDEX */
 
   *gc_wait = 0;
 
@@ -658,6 +939,18 @@ reserve(const char *name, coffee_page_t pages,
 
   PRINTF("Coffee: Reserved %u pages starting from %u for file %s\n",
       pages, page, name);
+#if COFFEE_BACKGROUND_GC
+  if(page + pages > COFFEE_PAGE_COUNT -
+     COFFEE_GC_WATERMARK * COFFEE_PAGES_PER_SECTOR &&
+     !process_is_running(&coffee_gc_process)) {
+    process_start(&coffee_gc_process, NULL);
+  }
+#endif /* COFFEE_BACKGROUND_GC */
+#if COFFEE_PAGE_INDEX
+  if(!(flags & HDR_FLAG_LOG)) {
+    index_add(name, page, 0);
+  }
+#endif /* COFFEE_PAGE_INDEX */
 
   file = load_file(page, &hdr);
   if(file != NULL) {
@@ -1179,6 +1472,10 @@ cfs_write(int fd, const void *buf, unsigned size)
     PRINTF("Extended the file at page %u\n", (unsigned)file->page);
   }
 #if COFFEE_IO_SEMANTICS
+  } else if(size + fdp->offset + sizeof(struct file_header) >
+            (file->max_pages * COFFEE_PAGE_SIZE)) {
+    /* A firm size file must not overwrite the pages that follow it. */
+    return -1;
   }
 #endif
 
@@ -58,6 +58,7 @@
  *
  * A case when this is necessary is when the file has a firm size limit,
  * and a safeguard is needed to protect against writes beyond this limit.
+ * Such writes fail and return -1.
  *
  * \sa cfs_coffee_set_io_semantics()
  */
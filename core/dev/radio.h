@@ -58,6 +58,7 @@
 #define RADIO_H_
 
 #include <stddef.h>
+#include "sys/rtimer.h"
 
 /**
  * Each radio has a set of parameters that designate the current
@@ -159,6 +160,37 @@ enum {
    */
   RADIO_PARAM_64BIT_ADDR,
 
+  /*
+   * Start time of the next transmission, as an rtimer_clock_t. The
+   * next call to transmit() starts sending the frame at that time,
+   * without CCA. It applies to that transmission only.
+   *
+   * This parameter is set with radio.set_object().
+   */
+  RADIO_PARAM_TX_START_TIME,
+
+  /*
+   * Reception window, as a struct radio_rx_window. The radio is
+   * turned on to be listening from window.start. With a non-zero
+   * window.duration, the function returns once a frame is being
+   * received, or when the window ends without one, and then turns the
+   * radio off.
+   *
+   * This parameter is set with radio.set_object().
+   */
+  RADIO_PARAM_RX_WINDOW,
+
+  /*
+   * First bytes of the frame being received, before its end: the PHY
+   * length byte, then the first size - 1 bytes of the frame. Returns
+   * RADIO_RESULT_ERROR if they are not received yet, and
+   * RADIO_RESULT_NOT_SUPPORTED if the radio gives no access to a frame
+   * before it is received in full. read() still returns the whole frame.
+   *
+   * This parameter is read with radio.get_object().
+   */
+  RADIO_PARAM_RX_HEADER,
+
   /* Constants (read only) */
 
   /* The lowest radio channel. */
@@ -172,6 +204,12 @@ enum {
   RADIO_CONST_TXPOWER_MAX
 };
 
+/* Object of RADIO_PARAM_RX_WINDOW */
+struct radio_rx_window {
+  rtimer_clock_t start;
+  rtimer_clock_t duration;
+};
+
 /* Radio power modes */
 enum {
   RADIO_POWER_MODE_OFF,
@@ -203,6 +241,15 @@ enum {
  */
 #define RADIO_TX_MODE_SEND_ON_CCA      (1 << 0)
 
+/**
+ * With RADIO_TX_MODE_NO_WAIT, transmit() returns RADIO_TX_OK as soon as
+ * the transmission is started (or armed, with RADIO_PARAM_TX_START_TIME)
+ * and the radio completes it on its own, e.g. to leave the CPU free
+ * while an ACK is sent. The radio must not be used again until the end
+ * of the frame.
+ */
+#define RADIO_TX_MODE_NO_WAIT          (1 << 1)
+
 /* Radio return values when setting or getting radio parameters. */
 typedef enum {
   RADIO_RESULT_OK,
@@ -85,6 +85,23 @@ static uint16_t begin, end;
 static uint8_t rxbuf[RX_BUFSIZE];
 static uint16_t pkt_end;		/* SLIP_END tracker. */
 
+/* With a non-zero SLIP_CONF_RX_RING_SIZE, slip_input_byte() only stores
+ * the bytes in a ring, and they are decoded into rxbuf by slip_process.
+ * This keeps the UART interrupt short at high baud rates */
+#ifdef SLIP_CONF_RX_RING_SIZE
+#define RX_RING_SIZE SLIP_CONF_RX_RING_SIZE
+#else
+#define RX_RING_SIZE 0
+#endif
+
+#if RX_RING_SIZE
+static uint8_t rx_ring[RX_RING_SIZE];
+static volatile uint16_t rx_ring_put, rx_ring_get;
+/* Set by the interrupt on overflow: bytes are dropped until the ring is
+ * decoded, then the frame they were part of is discarded */
+static volatile uint8_t rx_ring_overflow;
+#endif /* RX_RING_SIZE */
+
 static void (* input_callback)(void) = NULL;
 /*---------------------------------------------------------------------------*/
 void
@@ -248,6 +265,34 @@ slip_poll_handler(uint8_t *outbuf, uint16_t blen)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+#if RX_RING_SIZE
+static int decode_byte(unsigned char c);
+
+/* Decode the bytes of the ring into rxbuf, until it holds two packets */
+static void
+rx_ring_decode(void)
+{
+  uint16_t get;
+
+  get = rx_ring_get;
+  while(get != rx_ring_put && state != STATE_TWOPACKETS) {
+    decode_byte(rx_ring[get]);
+    get = (get + 1) % RX_RING_SIZE;
+  }
+  rx_ring_get = get;
+
+  if(get == rx_ring_put && rx_ring_overflow && state != STATE_TWOPACKETS) {
+    state = STATE_RUBBISH;
+    SLIP_STATISTICS(slip_overflow++);
+    end = pkt_end;		/* remove rubbish */
+    rx_ring_overflow = 0;
+  } else if(get != rx_ring_put || rx_ring_overflow) {
+    /* Left for when a packet has been read */
+    process_poll(&slip_process);
+  }
+}
+#endif /* RX_RING_SIZE */
+/*---------------------------------------------------------------------------*/
 PROCESS_THREAD(slip_process, ev, data)
 {
   PROCESS_BEGIN();
@@ -259,6 +304,10 @@ PROCESS_THREAD(slip_process, ev, data)
     
     slip_active = 1;
 
+#if RX_RING_SIZE
+    rx_ring_decode();
+#endif /* RX_RING_SIZE */
+
     /* Move packet from rxbuf to buffer provided by uIP. */
     uip_len = slip_poll_handler(&uip_buf[UIP_LLH_LEN],
 				UIP_BUFSIZE - UIP_LLH_LEN);
@@ -313,8 +362,40 @@ PROCESS_THREAD(slip_process, ev, data)
   PROCESS_END();
 }
 /*---------------------------------------------------------------------------*/
+#if RX_RING_SIZE
+int
+slip_input_byte(unsigned char c)
+{
+  uint16_t next;
+
+  if(rx_ring_overflow) {
+    return 0;
+  }
+  next = (rx_ring_put + 1) % RX_RING_SIZE;
+  if(next == rx_ring_get) {
+    rx_ring_overflow = 1;
+    process_poll(&slip_process);
+    return 1;
+  }
+  rx_ring[rx_ring_put] = c;
+  rx_ring_put = next;
+
+  /* Wake up the process once per packet, or when the ring fills up.
+   * 'T' ends the CLIENT request, see slip_poll_handler() */
+  if(c == SLIP_END || c == 'T' ||
+     (next - rx_ring_get + RX_RING_SIZE) % RX_RING_SIZE >= RX_RING_SIZE / 2) {
+    process_poll(&slip_process);
+    return 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+decode_byte(unsigned char c)
+#else /* RX_RING_SIZE */
 int
 slip_input_byte(unsigned char c)
+#endif /* RX_RING_SIZE */
 {
   switch(state) {
   case STATE_RUBBISH:
@@ -48,7 +48,8 @@ uint8_t slip_send(void);
  *
  * This function is called by the RS232/SIO device driver to pass
  * incoming bytes to the SLIP driver. The function can be called from
- * an interrupt context.
+ * an interrupt context. With SLIP_CONF_RX_RING_SIZE, it only stores the
+ * byte, and the SLIP process decodes the bytes in batches.
  *
  * For systems using low-power CPU modes, the return value of the
  * function can be used to determine if the CPU should be woken up or
@@ -182,6 +182,19 @@ aes_128_padded_encrypt(uint8_t *plaintext_and_result, uint8_t plaintext_len)
 }
 /*---------------------------------------------------------------------------*/
 void
+aes_128_encrypt_blocks(uint8_t *plaintexts_and_results, uint8_t count)
+{
+  if(AES_128.encrypt_blocks) {
+    AES_128.encrypt_blocks(plaintexts_and_results, count);
+    return;
+  }
+  while(count--) {
+    AES_128.encrypt(plaintexts_and_results);
+    plaintexts_and_results += AES_128_BLOCK_SIZE;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
 aes_128_set_padded_key(uint8_t *key, uint8_t key_len)
 {
   uint8_t block[AES_128_BLOCK_SIZE];
@@ -193,6 +206,7 @@ aes_128_set_padded_key(uint8_t *key, uint8_t key_len)
 /*---------------------------------------------------------------------------*/
 const struct aes_128_driver aes_128_driver = {
   set_key,
-  encrypt
+  encrypt,
+  NULL
 };
 /*---------------------------------------------------------------------------*/
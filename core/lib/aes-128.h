@@ -65,6 +65,12 @@ struct aes_128_driver {
    * \brief Encrypts.
    */
   void (* encrypt)(uint8_t *plaintext_and_result);
+  
+  /**
+   * \brief Encrypts count consecutive blocks in a single request, NULL
+   *        if the driver has no batch mode.
+   */
+  void (* encrypt_blocks)(uint8_t *plaintexts_and_results, uint8_t count);
 };
 
 /**
@@ -72,6 +78,12 @@ struct aes_128_driver {
  */
 void aes_128_padded_encrypt(uint8_t *plaintext_and_result, uint8_t plaintext_len);
 
+/**
+ * \brief Encrypts count consecutive blocks, in one request if
+ *        AES_128 supports it
+ */
+void aes_128_encrypt_blocks(uint8_t *plaintexts_and_results, uint8_t count);
+
 /**
  * \brief Pads the key with zeroes before calling AES_128.set_key
  */
@@ -55,6 +55,27 @@
 #ifndef CRC16_H_
 #define CRC16_H_
 
+/* Implementations of the CRC, to trade speed for flash (CRC16_CONF_TABLE):
+ * shifts and XORs only, a 16-entry table (32 bytes) looked up twice per
+ * byte, or a 256-entry table (512 bytes) looked up once per byte */
+#define CRC16_TABLE_NONE   0
+#define CRC16_TABLE_NIBBLE 1
+#define CRC16_TABLE_BYTE   2
+
+#ifdef CRC16_CONF_TABLE
+#define CRC16_TABLE CRC16_CONF_TABLE
+#else
+#define CRC16_TABLE CRC16_TABLE_NONE
+#endif
+
+/* A platform with a CRC unit defines CRC16_ARCH_DATA and implements
+ * crc16_arch_data(), that crc16_data() then calls. It must give the
+ * same CRC as crc16_add() over every byte */
+#ifdef CRC16_ARCH_DATA
+unsigned short crc16_arch_data(const unsigned char *data, int datalen,
+                               unsigned short acc);
+#endif
+
 /**
  * \brief      Update an accumulated CRC16 checksum with one byte.
  * \param b    The byte to be added to the checksum
@@ -65,10 +86,11 @@
  *             with one byte. It can be used as a running checksum, or
  *             to checksum an entire data block.
  *
- *             \note The algorithm used in this implementation is
- *             tailored for a running checksum and does not perform as
- *             well as a table-driven algorithm when checksumming an
- *             entire data block.
+ *             \note Unless CRC16_CONF_TABLE selects a table, the
+ *             algorithm used in this implementation is tailored for a
+ *             running checksum and does not perform as well as a
+ *             table-driven algorithm when checksumming an entire data
+ *             block.
  *
  */
 unsigned short crc16_add(unsigned char b, unsigned short crc);
@@ -82,10 +104,11 @@ unsigned short crc16_add(unsigned char b, unsigned short crc);
  *
  *             This function calculates the CRC16 checksum of a data area.
  *
- *             \note The algorithm used in this implementation is
- *             tailored for a running checksum and does not perform as
- *             well as a table-driven algorithm when checksumming an
- *             entire data block.
+ *             \note Unless CRC16_CONF_TABLE selects a table, or the
+ *             platform has a CRC unit (CRC16_ARCH_DATA), the algorithm
+ *             used in this implementation is tailored for a running
+ *             checksum and does not perform as well as a table-driven
+ *             algorithm when checksumming an entire data block.
  */
 unsigned short crc16_data(const unsigned char *data, int datalen,
 			  unsigned short acc);
@@ -142,19 +142,30 @@ list_tail(list_t list)
 void
 list_add(list_t list, void *item)
 {
-  struct list *l;
+  struct list *l, *next, *tail;
 
-  /* Make sure not to add the same element twice */
-  list_remove(list, item);
+  /* Make sure not to add the same element twice: take it out while
+     looking for the tail, in a single pass */
+  tail = NULL;
+  for(l = *list; l != NULL; l = next) {
+    next = l->next;
+    if(l == item) {
+      if(tail == NULL) {
+        *list = next;
+      } else {
+        tail->next = next;
+      }
+    } else {
+      tail = l;
+    }
+  }
 
   ((struct list *)item)->next = NULL;
-  
-  l = list_tail(list);
 
-  if(l == NULL) {
+  if(tail == NULL) {
     *list = item;
   } else {
-    l->next = item;
+    tail->next = item;
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -327,4 +338,156 @@ list_item_next(void *item)
   return item == NULL? NULL: ((struct list *)item)->next;
 }
 /*---------------------------------------------------------------------------*/
+/* The tail pointer of a list declared with LIST_WITH_TAIL() */
+#define TAIL(list) ((list)[1])
+/*---------------------------------------------------------------------------*/
+/**
+ * Initialize a list declared with LIST_WITH_TAIL() or
+ * LIST_STRUCT_WITH_TAIL().
+ *
+ * \param list The list to be initialized.
+ */
+void
+tlist_init(list_t list)
+{
+  *list = NULL;
+  TAIL(list) = NULL;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Get the last element of a list with a tail pointer, in constant time.
+ *
+ * \param list The list
+ * \return A pointer to the last element, NULL if the list is empty.
+ */
+void *
+tlist_tail(list_t list)
+{
+  return TAIL(list);
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Add an item at the end of a list with a tail pointer.
+ *
+ * As list_add(), the item is first taken out of the list if it is on
+ * it, which walks the list once.
+ *
+ * \param list The list.
+ * \param item A pointer to the item to be added.
+ *
+ * \sa tlist_add_unchecked()
+ */
+void
+tlist_add(list_t list, void *item)
+{
+  tlist_remove(list, item);
+  tlist_add_unchecked(list, item);
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Add an item at the end of a list with a tail pointer, in constant
+ * time.
+ *
+ * \param list The list.
+ * \param item A pointer to the item to be added. It must not be on the
+ *             list already.
+ *
+ * \sa tlist_add()
+ */
+void
+tlist_add_unchecked(list_t list, void *item)
+{
+  ((struct list *)item)->next = NULL;
+
+  if(TAIL(list) == NULL) {
+    *list = item;
+  } else {
+    ((struct list *)TAIL(list))->next = item;
+  }
+  TAIL(list) = item;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Add an item to the start of a list with a tail pointer.
+ */
+void
+tlist_push(list_t list, void *item)
+{
+  tlist_remove(list, item);
+
+  ((struct list *)item)->next = *list;
+  *list = item;
+  if(TAIL(list) == NULL) {
+    TAIL(list) = item;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Remove the first object on a list with a tail pointer.
+ *
+ * \param list The list.
+ * \return Pointer to the removed element of list.
+ */
+void *
+tlist_pop(list_t list)
+{
+  void *l = list_pop(list);
+
+  if(*list == NULL) {
+    TAIL(list) = NULL;
+  }
+
+  return l;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Remove a specific element from a list with a tail pointer.
+ *
+ * \param list The list.
+ * \param item The item that is to be removed from the list.
+ */
+void
+tlist_remove(list_t list, void *item)
+{
+  struct list *l, *r;
+
+  r = NULL;
+  for(l = *list; l != NULL; l = l->next) {
+    if(l == item) {
+      if(r == NULL) {
+        *list = l->next;
+      } else {
+        r->next = l->next;
+      }
+      if(TAIL(list) == l) {
+        TAIL(list) = r;
+      }
+      l->next = NULL;
+      return;
+    }
+    r = l;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Insert an item after a specified item on a list with a tail pointer.
+ *
+ * \param list The list
+ * \param previtem The item after which the new item should be
+ *                 inserted, NULL to insert at the start of the list
+ * \param newitem  The new item that is to be inserted
+ */
+void
+tlist_insert(list_t list, void *previtem, void *newitem)
+{
+  if(previtem == NULL) {
+    tlist_push(list, newitem);
+  } else {
+    list_insert(list, previtem, newitem);
+    if(TAIL(list) == previtem) {
+      TAIL(list) = newitem;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
 /** @} */
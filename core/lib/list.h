@@ -60,6 +60,12 @@
  * list with list_remove(). The head and tail of a list can be
  * extracted using list_head() and list_tail(), respectively.
  *
+ * Lists declared with LIST_WITH_TAIL() or LIST_STRUCT_WITH_TAIL() also
+ * keep a pointer to their last element, for lists that are often
+ * appended to. They are read with the functions above, but must only be
+ * modified with the tlist_*() functions, which keep the tail pointer up
+ * to date. tlist_tail() and tlist_add_unchecked() take constant time.
+ *
  * @{
  */
 
@@ -126,6 +132,45 @@
        list_init((struct_ptr)->name);                                   \
     } while(0)
 
+/**
+ * Declare a linked list that keeps a pointer to its tail.
+ *
+ * As LIST(), but the list is two pointers: the first element and the
+ * last one. The list must only be modified with the tlist_*()
+ * functions.
+ *
+ * \param name The name of the list.
+ */
+#define LIST_WITH_TAIL(name) \
+         static void *LIST_CONCAT(name,_list)[2] = { NULL, NULL }; \
+         static list_t name = (list_t)LIST_CONCAT(name,_list)
+
+/**
+ * Declare a linked list that keeps a pointer to its tail inside a
+ * structure declaraction.
+ *
+ * As LIST_STRUCT(). The list is initialized with the
+ * LIST_STRUCT_WITH_TAIL_INIT() macro, and must only be modified with
+ * the tlist_*() functions.
+ *
+ * \param name The name of the list.
+ */
+#define LIST_STRUCT_WITH_TAIL(name) \
+         void *LIST_CONCAT(name,_list)[2]; \
+         list_t name
+
+/**
+ * Initialize a linked list declared with LIST_STRUCT_WITH_TAIL().
+ *
+ * \param struct_ptr A pointer to the struct
+ * \param name The name of the list.
+ */
+#define LIST_STRUCT_WITH_TAIL_INIT(struct_ptr, name)                    \
+    do {                                                                \
+       (struct_ptr)->name = (struct_ptr)->LIST_CONCAT(name,_list);      \
+       tlist_init((struct_ptr)->name);                                  \
+    } while(0)
+
 /**
  * The linked list type.
  *
@@ -151,6 +196,15 @@ void   list_insert(list_t list, void *previtem, void *newitem);
 
 void * list_item_next(void *item);
 
+void   tlist_init(list_t list);
+void * tlist_tail(list_t list);
+void   tlist_add(list_t list, void *item);
+void   tlist_add_unchecked(list_t list, void *item);
+void   tlist_push(list_t list, void *item);
+void * tlist_pop(list_t list);
+void   tlist_remove(list_t list, void *item);
+void   tlist_insert(list_t list, void *previtem, void *newitem);
+
 #endif /* LIST_H_ */
 
 /** @} */
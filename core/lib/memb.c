@@ -47,12 +47,90 @@
 #include "contiki.h"
 #include "lib/memb.h"
 
+#if MEMB_WITH_FREE_LIST
+/*---------------------------------------------------------------------------*/
+static void
+free_list_init(struct memb *m)
+{
+  struct memb_free_list *fl = m->free_list;
+  unsigned short i;
+
+  for(i = 0; i < m->num; ++i) {
+    fl->next[i] = i + 1;
+  }
+  fl->head = 0;
+  fl->used = 0;
+  fl->max_used = 0;
+  fl->failures = 0;
+  fl->ready = 1;
+}
+/*---------------------------------------------------------------------------*/
+static void *
+free_list_alloc(struct memb *m)
+{
+  struct memb_free_list *fl = m->free_list;
+  unsigned short i;
+
+  if(!fl->ready) {
+    /* The memory block is used without memb_init() */
+    free_list_init(m);
+  }
+
+  if(fl->head >= m->num) {
+    if(fl->failures < 0xffff) {
+      ++fl->failures;
+    }
+    return NULL;
+  }
+
+  i = fl->head;
+  fl->head = fl->next[i];
+  ++(m->count[i]);
+  if(++fl->used > fl->max_used) {
+    fl->max_used = fl->used;
+  }
+  return (void *)((char *)m->mem + (i * m->size));
+}
+/*---------------------------------------------------------------------------*/
+static char
+free_list_free(struct memb *m, void *ptr)
+{
+  struct memb_free_list *fl = m->free_list;
+  unsigned long offset;
+  unsigned short i;
+
+  if(!memb_inmemb(m, ptr)) {
+    return -1;
+  }
+  offset = (char *)ptr - (char *)m->mem;
+  i = offset / m->size;
+  if((unsigned long)i * m->size != offset) {
+    /* Not the start of a block */
+    return -1;
+  }
+
+  if(m->count[i] > 0) {
+    /* Make sure that we don't deallocate free memory. */
+    if(--(m->count[i]) == 0) {
+      fl->next[i] = fl->head;
+      fl->head = i;
+      --fl->used;
+    }
+  }
+  return m->count[i];
+}
+#endif /* MEMB_WITH_FREE_LIST */
 /*---------------------------------------------------------------------------*/
 void
 memb_init(struct memb *m)
 {
   memset(m->count, 0, m->num);
   memset(m->mem, 0, m->size * m->num);
+#if MEMB_WITH_FREE_LIST
+  if(m->free_list != NULL) {
+    free_list_init(m);
+  }
+#endif /* MEMB_WITH_FREE_LIST */
 }
 /*---------------------------------------------------------------------------*/
 void *
@@ -60,6 +138,12 @@ memb_alloc(struct memb *m)
 {
   int i;
 
+#if MEMB_WITH_FREE_LIST
+  if(m->free_list != NULL) {
+    return free_list_alloc(m);
+  }
+#endif /* MEMB_WITH_FREE_LIST */
+
   for(i = 0; i < m->num; ++i) {
     if(m->count[i] == 0) {
       /* If this block was unused, we increase the reference count to
@@ -81,6 +165,12 @@ memb_free(struct memb *m, void *ptr)
   int i;
   char *ptr2;
 
+#if MEMB_WITH_FREE_LIST
+  if(m->free_list != NULL) {
+    return free_list_free(m, ptr);
+  }
+#endif /* MEMB_WITH_FREE_LIST */
+
   /* Walk through the list of blocks and try to find the block to
      which the pointer "ptr" points to. */
   ptr2 = (char *)m->mem;
@@ -113,6 +203,12 @@ memb_numfree(struct memb *m)
   int i;
   int num_free = 0;
 
+#if MEMB_WITH_FREE_LIST
+  if(m->free_list != NULL) {
+    return m->free_list->ready ? m->num - m->free_list->used : m->num;
+  }
+#endif /* MEMB_WITH_FREE_LIST */
+
   for(i = 0; i < m->num; ++i) {
     if(m->count[i] == 0) {
       ++num_free;
@@ -121,4 +217,24 @@ memb_numfree(struct memb *m)
 
   return num_free;
 }
+#if MEMB_WITH_FREE_LIST
+/*---------------------------------------------------------------------------*/
+int
+memb_max_used(struct memb *m)
+{
+  if(m->free_list == NULL) {
+    return -1;
+  }
+  return m->free_list->max_used;
+}
+/*---------------------------------------------------------------------------*/
+int
+memb_alloc_failures(struct memb *m)
+{
+  if(m->free_list == NULL) {
+    return -1;
+  }
+  return m->free_list->failures;
+}
+#endif /* MEMB_WITH_FREE_LIST */
 /** @} */
@@ -48,6 +48,14 @@
  * memory by the memb_alloc() function, and are deallocated with the
  * memb_free() function.
  *
+ * memb_alloc() looks for a free block from the start of the memory, and
+ * memb_free() for the block from its pointer. With
+ * MEMB_CONF_WITH_FREE_LIST, the memory blocks declared with
+ * MEMB_FREE_LIST() instead keep their free blocks in a list, so that
+ * both take constant time, and count their allocations: see
+ * memb_max_used() and memb_alloc_failures(). This costs two bytes per
+ * block. Without MEMB_CONF_WITH_FREE_LIST, MEMB_FREE_LIST() is MEMB().
+ *
  * @{
  */
 
@@ -65,6 +73,12 @@
 
 #include "sys/cc.h"
 
+#ifdef MEMB_CONF_WITH_FREE_LIST
+#define MEMB_WITH_FREE_LIST MEMB_CONF_WITH_FREE_LIST
+#else
+#define MEMB_WITH_FREE_LIST 0
+#endif
+
 /**
  * Declare a memory block.
  *
@@ -93,11 +107,57 @@ MEMB(connections, struct connection, 16);
                                           CC_CONCAT(name,_memb_count), \
                                           (void *)CC_CONCAT(name,_memb_mem)}
 
+#if MEMB_WITH_FREE_LIST
+/**
+ * Declare a memory block whose free blocks are kept in a list.
+ *
+ * As MEMB(), with constant-time memb_alloc(), memb_free() and
+ * memb_numfree(). Needs MEMB_CONF_WITH_FREE_LIST, otherwise same as
+ * MEMB().
+ *
+ * \param name The name of the memory block.
+ *
+ * \param structure The name of the struct that the memory block holds
+ *
+ * \param num The total number of memory chunks in the block.
+ *
+ */
+#define MEMB_FREE_LIST(name, structure, num) \
+        static char CC_CONCAT(name,_memb_count)[num]; \
+        static structure CC_CONCAT(name,_memb_mem)[num]; \
+        static unsigned short CC_CONCAT(name,_memb_next)[num]; \
+        static struct memb_free_list CC_CONCAT(name,_memb_free_list) = \
+                                          {CC_CONCAT(name,_memb_next)}; \
+        static struct memb name = {sizeof(structure), num, \
+                                          CC_CONCAT(name,_memb_count), \
+                                          (void *)CC_CONCAT(name,_memb_mem), \
+                                          &CC_CONCAT(name,_memb_free_list)}
+
+/* The free list and counters of a MEMB_FREE_LIST() memory block */
+struct memb_free_list {
+  /* For each free block, the index of the next one */
+  unsigned short *next;
+  /* The first free block, num if none */
+  unsigned short head;
+  unsigned short used;
+  unsigned short max_used;
+  unsigned short failures;
+  /* Set by memb_init(), or by the first memb_alloc() */
+  unsigned char ready;
+};
+#else /* MEMB_WITH_FREE_LIST */
+#define MEMB_FREE_LIST(name, structure, num) MEMB(name, structure, num)
+#endif /* MEMB_WITH_FREE_LIST */
+
 struct memb {
   unsigned short size;
   unsigned short num;
   char *count;
   void *mem;
+#if MEMB_WITH_FREE_LIST
+  /* NULL if declared with MEMB() */
+  struct memb_free_list *free_list;
+#endif /* MEMB_WITH_FREE_LIST */
 };
 
 /**
@@ -132,6 +192,27 @@ int memb_inmemb(struct memb *m, void *ptr);
 
 int  memb_numfree(struct memb *m);
 
+#if MEMB_WITH_FREE_LIST
+/**
+ * Get the highest number of blocks allocated at once since memb_init().
+ *
+ * \param m A memory block previously declared with MEMB_FREE_LIST().
+ *
+ * \return The high watermark, or -1 if "m" has no free list.
+ */
+int  memb_max_used(struct memb *m);
+
+/**
+ * Get the number of memb_alloc() that failed since memb_init().
+ *
+ * \param m A memory block previously declared with MEMB_FREE_LIST().
+ *
+ * \return The count of failures (saturated), or -1 if "m" has no free
+ * list.
+ */
+int  memb_alloc_failures(struct memb *m);
+#endif /* MEMB_WITH_FREE_LIST */
+
 /** @} */
 /** @} */
 
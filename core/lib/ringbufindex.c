@@ -46,6 +46,21 @@ ringbufindex_init(struct ringbufindex *r, uint8_t size)
   r->mask = size - 1;
   r->put_ptr = 0;
   r->get_ptr = 0;
+#if RINGBUFINDEX_MULTI_PRODUCER
+  r->reserve_ptr = 0;
+  r->writers = 0;
+#endif /* RINGBUFINDEX_MULTI_PRODUCER */
+  r->high_watermark = 0;
+  r->overflows = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_high_watermark(struct ringbufindex *r, uint8_t put_ptr)
+{
+  uint8_t elements = (put_ptr - r->get_ptr) & r->mask;
+  if(elements > r->high_watermark) {
+    r->high_watermark = elements;
+  }
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -61,19 +76,22 @@ ringbufindex_put(struct ringbufindex *r)
      most platforms, but C does not guarantee this.
   */
   if(((r->put_ptr - r->get_ptr) & r->mask) == r->mask) {
+    r->overflows++;
     return 0;
   }
   r->put_ptr = (r->put_ptr + 1) & r->mask;
+  update_high_watermark(r, r->put_ptr);
   return 1;
 }
 /*---------------------------------------------------------------------------*/
 int16_t
-ringbufindex_peek_put(const struct ringbufindex *r)
+ringbufindex_peek_put(struct ringbufindex *r)
 {
-  /* Check if there are bytes in the buffer. If so, we return the
-     first one. If there are no bytes left, we return -1.
+  /* Check if there is space left in the buffer. If so, we return the
+     index of the next put. If the buffer is full, we return -1.
   */
   if(((r->put_ptr - r->get_ptr) & r->mask) == r->mask) {
+    r->overflows++;
     return -1;
   }
   return (r->put_ptr + 1) & r->mask;
@@ -117,6 +135,88 @@ ringbufindex_peek_get(const struct ringbufindex *r)
 }
 /*---------------------------------------------------------------------------*/
 int
+ringbufindex_peek_get_batch(const struct ringbufindex *r, int16_t *first)
+{
+  int elements = ringbufindex_elements(r);
+  if(elements > 0) {
+    *first = (r->get_ptr + 1) & r->mask;
+  }
+  return elements;
+}
+/*---------------------------------------------------------------------------*/
+int
+ringbufindex_get_batch(struct ringbufindex *r, int n)
+{
+  int elements = ringbufindex_elements(r);
+  if(n > elements) {
+    n = elements;
+  }
+  r->get_ptr = (r->get_ptr + n) & r->mask;
+  return n;
+}
+#if RINGBUFINDEX_MULTI_PRODUCER
+/*---------------------------------------------------------------------------*/
+int16_t
+ringbufindex_reserve(struct ringbufindex *r)
+{
+  uint8_t writers;
+  uint8_t reserve_ptr;
+
+  /* Count ourselves as a writer first, so that no commit publishes the
+     element before we are done with it */
+  do {
+    writers = r->writers;
+  } while(!RINGBUFINDEX_CAS(&r->writers, writers, writers + 1));
+
+  do {
+    reserve_ptr = r->reserve_ptr;
+    if(((reserve_ptr - r->get_ptr) & r->mask) == r->mask) {
+      r->overflows++;
+      ringbufindex_commit(r);
+      return -1;
+    }
+  } while(!RINGBUFINDEX_CAS(&r->reserve_ptr, reserve_ptr,
+                            (reserve_ptr + 1) & r->mask));
+  return (reserve_ptr + 1) & r->mask;
+}
+/*---------------------------------------------------------------------------*/
+void
+ringbufindex_commit(struct ringbufindex *r)
+{
+  uint8_t writers;
+  uint8_t put_ptr;
+  uint8_t reserve_ptr;
+
+  do {
+    writers = r->writers;
+  } while(!RINGBUFINDEX_CAS(&r->writers, writers, writers - 1));
+
+  if(writers == 1) {
+    /* We were the last writer: all reserved elements are filled in.
+       A producer preempting us from here publishes them itself, in which
+       case put_ptr changes and the swap fails */
+    put_ptr = r->put_ptr;
+    reserve_ptr = r->reserve_ptr;
+    if(RINGBUFINDEX_CAS(&r->put_ptr, put_ptr, reserve_ptr)) {
+      update_high_watermark(r, reserve_ptr);
+    }
+  }
+}
+#endif /* RINGBUFINDEX_MULTI_PRODUCER */
+/*---------------------------------------------------------------------------*/
+int
+ringbufindex_high_watermark(const struct ringbufindex *r)
+{
+  return r->high_watermark;
+}
+/*---------------------------------------------------------------------------*/
+int
+ringbufindex_overflows(const struct ringbufindex *r)
+{
+  return r->overflows;
+}
+/*---------------------------------------------------------------------------*/
+int
 ringbufindex_size(const struct ringbufindex *r)
 {
   return r->mask + 1;
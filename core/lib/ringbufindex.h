@@ -55,6 +55,23 @@
 
 #include "contiki-conf.h"
 
+/* Multi-producer mode: ringbufindex_reserve() and ringbufindex_commit()
+ * may be used by producers preempting each other, e.g. nested interrupts.
+ * The other functions keep their single-producer semantics */
+#ifdef RINGBUFINDEX_CONF_MULTI_PRODUCER
+#define RINGBUFINDEX_MULTI_PRODUCER RINGBUFINDEX_CONF_MULTI_PRODUCER
+#else
+#define RINGBUFINDEX_MULTI_PRODUCER 0
+#endif
+
+/* Atomic compare-and-swap of an uint8_t, returns non-zero on success.
+ * Platforms without the GCC builtin can provide their own */
+#ifdef RINGBUFINDEX_CONF_CAS
+#define RINGBUFINDEX_CAS(ptr, old, new) RINGBUFINDEX_CONF_CAS(ptr, old, new)
+#else
+#define RINGBUFINDEX_CAS(ptr, old, new) __sync_bool_compare_and_swap(ptr, old, new)
+#endif
+
 /**
  * \brief      Structure that holds the state of a ring buffer.
  *
@@ -69,6 +86,16 @@ struct ringbufindex {
   
   /* XXX these must be 8-bit quantities to avoid race conditions. */
   uint8_t put_ptr, get_ptr;
+#if RINGBUFINDEX_MULTI_PRODUCER
+  /* Last reserved index, and number of producers between reserve and
+   * commit. The last producer to commit makes all reserved elements
+   * visible */
+  volatile uint8_t reserve_ptr, writers;
+#endif /* RINGBUFINDEX_MULTI_PRODUCER */
+  /* Highest number of elements since init */
+  uint8_t high_watermark;
+  /* Number of times a producer found the buffer full */
+  uint16_t overflows;
 };
 
 /**
@@ -96,14 +123,14 @@ int     ringbufindex_put(struct ringbufindex *r);
 /**
  * \brief      Get the index of the next put
  * \param r    A pointer to a struct ringbufindex to hold the state of the ring buffer
- * \return     Non-zero if there data could be written, or zero if the buffer was full.
+ * \return     The index of the next put, or -1 if the buffer was full.
  *
- *             This function inserts a byte into the ring buffer. It
+ *             A full buffer counts as an overflow. It
  *             is safe to call this function from an interrupt
  *             handler.
  *
  */
-int16_t     ringbufindex_peek_put(const struct ringbufindex *r);
+int16_t     ringbufindex_peek_put(struct ringbufindex *r);
 
 /**
  * \brief      Remove and get an element from the ring buffer
@@ -128,6 +155,55 @@ int16_t     ringbufindex_get(struct ringbufindex *r);
  */
 int16_t     ringbufindex_peek_get(const struct ringbufindex *r);
 
+/**
+ * \brief      Get all elements available to the consumer
+ * \param r    A pointer to a struct ringbufindex to hold the state of the ring buffer
+ * \param first Set to the index of the first element
+ * \return     The number of elements. Element i is at (first + i) modulo the size
+ */
+int         ringbufindex_peek_get_batch(const struct ringbufindex *r, int16_t *first);
+
+/**
+ * \brief      Remove elements from the ring buffer
+ * \param r    A pointer to a struct ringbufindex to hold the state of the ring buffer
+ * \param n    The number of elements to remove
+ * \return     The number of elements removed, at most n
+ */
+int         ringbufindex_get_batch(struct ringbufindex *r, int n);
+
+#if RINGBUFINDEX_MULTI_PRODUCER
+/**
+ * \brief      Reserve the next element, in multi-producer mode
+ * \param r    A pointer to a struct ringbufindex to hold the state of the ring buffer
+ * \return     The index of the reserved element, or -1 if the buffer was full
+ *
+ *             The producer fills in the element and then calls
+ *             ringbufindex_commit(). Safe against other producers
+ *             preempting this one.
+ */
+int16_t     ringbufindex_reserve(struct ringbufindex *r);
+
+/**
+ * \brief      Commit a reservation, in multi-producer mode
+ * \param r    A pointer to a struct ringbufindex to hold the state of the ring buffer
+ */
+void        ringbufindex_commit(struct ringbufindex *r);
+#endif /* RINGBUFINDEX_MULTI_PRODUCER */
+
+/**
+ * \brief      Get the highest number of elements in the ring buffer
+ * \param r    A pointer to a struct ringbufindex to hold the state of the ring buffer
+ * \return     The highest number of elements since the buffer was initialized
+ */
+int         ringbufindex_high_watermark(const struct ringbufindex *r);
+
+/**
+ * \brief      Get the number of overflows
+ * \param r    A pointer to a struct ringbufindex to hold the state of the ring buffer
+ * \return     The number of times a producer found the buffer full
+ */
+int         ringbufindex_overflows(const struct ringbufindex *r);
+
 /**
  * \brief      Get the size of a ring buffer
  * \param r    A pointer to a struct ringbufindex to hold the state of the ring buffer
@@ -137,6 +137,25 @@ struct process * const * elfloader_autostart_processes;
 
 static struct relevant_section bss, data, rodata, text;
 
+clock_time_t elfloader_load_time;
+
+/* Read-ahead of the tables read in sequence: relocations and
+   symbols. elfloader_arch_relocate() writes to the sections
+   themselves, which are never read through it. */
+static struct {
+  int fd;
+  unsigned int offset;
+  int len;
+  char data[ELFLOADER_READ_BUFFER_SIZE];
+} readbuf;
+
+/* Addresses of the symbols referred to by relocations, by symbol
+   index. Index 0, the null symbol, is never cached. */
+static struct {
+  unsigned int index;
+  char *address;
+} symbol_cache[ELFLOADER_SYMBOL_CACHE_SIZE];
+
 static const unsigned char elf_magic_header[] =
   {0x7f, 0x45, 0x4c, 0x46,  /* 0x7f, 'E', 'L', 'F' */
    0x01,                    /* Only 32-bit objects. */
@@ -163,6 +182,42 @@ seek_read(int fd, unsigned int offset, char *buf, int len)
 #endif /* DEBUG */
 }
 /*---------------------------------------------------------------------------*/
+static void
+stream_read(int fd, unsigned int offset, char *buf, int len)
+{
+  if(len > (int)sizeof(readbuf.data)) {
+    seek_read(fd, offset, buf, len);
+    return;
+  }
+  if(fd != readbuf.fd || offset < readbuf.offset ||
+     offset + len > readbuf.offset + readbuf.len) {
+    cfs_seek(fd, offset, CFS_SEEK_SET);
+    readbuf.len = cfs_read(fd, readbuf.data, sizeof(readbuf.data));
+    readbuf.fd = fd;
+    readbuf.offset = offset;
+    if(readbuf.len < len) {
+      /* At the end of the file */
+      len = readbuf.len < 0 ? 0 : readbuf.len;
+    }
+  }
+  memcpy(buf, &readbuf.data[offset - readbuf.offset], len);
+}
+/*---------------------------------------------------------------------------*/
+static struct relevant_section *
+find_section(elf32_half shndx)
+{
+  if(shndx == bss.number) {
+    return &bss;
+  } else if(shndx == data.number) {
+    return &data;
+  } else if(shndx == rodata.number) {
+    return &rodata;
+  } else if(shndx == text.number) {
+    return &text;
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
 /*
 static void
 seek_write(int fd, unsigned int offset, char *buf, int len)
@@ -183,22 +238,13 @@ find_local_symbol(int fd, const char *symbol,
   struct relevant_section *sect;
   
   for(a = symtab; a < symtab + symtabsize; a += sizeof(s)) {
-    seek_read(fd, a, (char *)&s, sizeof(s));
+    stream_read(fd, a, (char *)&s, sizeof(s));
 
-    if(s.st_name != 0) {
+    /* Names are only read for the symbols of the loaded sections */
+    sect = find_section(s.st_shndx);
+    if(s.st_name != 0 && sect != NULL) {
       seek_read(fd, strtab + s.st_name, name, sizeof(name));
       if(strcmp(name, symbol) == 0) {
-	if(s.st_shndx == bss.number) {
-	  sect = &bss;
-	} else if(s.st_shndx == data.number) {
-	  sect = &data;
-  } else if(s.st_shndx == rodata.number) {
-    sect = &rodata;
-	} else if(s.st_shndx == text.number) {
-	  sect = &text;
-	} else {
-	  return NULL;
-	}
 	return &(sect->address[s.st_value]);
       }
     }
@@ -207,23 +253,58 @@ find_local_symbol(int fd, const char *symbol,
 }
 /*---------------------------------------------------------------------------*/
 static int
+find_symbol_address(int fd, unsigned int index,
+		    unsigned int strtab, unsigned int symtab,
+		    char **addr)
+{
+  struct elf32_sym s;
+  char name[30];
+  struct relevant_section *sect;
+
+  seek_read(fd, symtab + sizeof(struct elf32_sym) * index,
+	    (char *)&s, sizeof(s));
+  sect = find_section(s.st_shndx);
+  if(s.st_name != 0) {
+    seek_read(fd, strtab + s.st_name, name, sizeof(name));
+    PRINTF("name: %s\n", name);
+    *addr = (char *)symtab_lookup(name);
+    if(*addr != NULL) {
+      return ELFLOADER_OK;
+    }
+    PRINTF("name not found in global: %s\n", name);
+    if(sect == NULL) {
+      PRINTF("elfloader unknown name: '%30s'\n", name);
+      memcpy(elfloader_unknown, name, sizeof(elfloader_unknown));
+      elfloader_unknown[sizeof(elfloader_unknown) - 1] = 0;
+      return ELFLOADER_SYMBOL_NOT_FOUND;
+    }
+    /* A local symbol: the one we just read */
+    *addr = &sect->address[s.st_value];
+  } else {
+    if(sect == NULL) {
+      return ELFLOADER_SEGMENT_NOT_FOUND;
+    }
+    *addr = sect->address;
+  }
+  return ELFLOADER_OK;
+}
+/*---------------------------------------------------------------------------*/
+static int
 relocate_section(int fd,
 		 unsigned int section, unsigned short size,
 		 unsigned int sectionaddr,
 		 char *sectionbase,
-		 unsigned int strs,
 		 unsigned int strtab,
-		 unsigned int symtab, unsigned short symtabsize,
+		 unsigned int symtab,
 		 unsigned char using_relas)
 {
   /* sectionbase added; runtime start address of current section */
   struct elf32_rela rela; /* Now used both for rel and rela data! */
   int rel_size = 0;
-  struct elf32_sym s;
   unsigned int a;
-  char name[30];
+  unsigned int index;
   char *addr;
-  struct relevant_section *sect;
+  int ret;
 
   /* determine correct relocation entry sizes */
   if(using_relas) {
@@ -233,51 +314,18 @@ relocate_section(int fd,
   }
   
   for(a = section; a < section + size; a += rel_size) {
-    seek_read(fd, a, (char *)&rela, rel_size);
-    seek_read(fd,
-	      symtab + sizeof(struct elf32_sym) * ELF32_R_SYM(rela.r_info),
-	      (char *)&s, sizeof(s));
-    if(s.st_name != 0) {
-      seek_read(fd, strtab + s.st_name, name, sizeof(name));
-      PRINTF("name: %s\n", name);
-      addr = (char *)symtab_lookup(name);
-      /* ADDED */
-      if(addr == NULL) {
-	PRINTF("name not found in global: %s\n", name);
-	addr = find_local_symbol(fd, name, symtab, symtabsize, strtab);
-	PRINTF("found address %p\n", addr);
-      }
-      if(addr == NULL) {
-	if(s.st_shndx == bss.number) {
-	  sect = &bss;
-	} else if(s.st_shndx == data.number) {
-	  sect = &data;
-	} else if(s.st_shndx == rodata.number) {
-	  sect = &rodata;
-	} else if(s.st_shndx == text.number) {
-	  sect = &text;
-	} else {
-	  PRINTF("elfloader unknown name: '%30s'\n", name);
-	  memcpy(elfloader_unknown, name, sizeof(elfloader_unknown));
-	  elfloader_unknown[sizeof(elfloader_unknown) - 1] = 0;
-	  return ELFLOADER_SYMBOL_NOT_FOUND;
-	}
-	addr = sect->address;
-      }
+    stream_read(fd, a, (char *)&rela, rel_size);
+    index = ELF32_R_SYM(rela.r_info);
+    if(index != 0 &&
+       symbol_cache[index % ELFLOADER_SYMBOL_CACHE_SIZE].index == index) {
+      addr = symbol_cache[index % ELFLOADER_SYMBOL_CACHE_SIZE].address;
     } else {
-      if(s.st_shndx == bss.number) {
-	sect = &bss;
-      } else if(s.st_shndx == data.number) {
-	sect = &data;
-      } else if(s.st_shndx == rodata.number) {
-	sect = &rodata;
-      } else if(s.st_shndx == text.number) {
-	sect = &text;
-      } else {
-	return ELFLOADER_SEGMENT_NOT_FOUND;
+      ret = find_symbol_address(fd, index, strtab, symtab, &addr);
+      if(ret != ELFLOADER_OK) {
+	return ret;
       }
-      
-      addr = sect->address;
+      symbol_cache[index % ELFLOADER_SYMBOL_CACHE_SIZE].index = index;
+      symbol_cache[index % ELFLOADER_SYMBOL_CACHE_SIZE].address = addr;
     }
 
     if(!using_relas) {
@@ -300,7 +348,7 @@ find_program_processes(int fd,
   char name[30];
   
   for(a = symtab; a < symtab + size; a += sizeof(s)) {
-    seek_read(fd, a, (char *)&s, sizeof(s));
+    stream_read(fd, a, (char *)&s, sizeof(s));
 
     if(s.st_name != 0) {
       seek_read(fd, strtab + s.st_name, name, sizeof(name));
@@ -335,8 +383,8 @@ print_chars(unsigned char *ptr, int num)
 }
 #endif /* 0 */
 /*---------------------------------------------------------------------------*/
-int
-elfloader_load(int fd)
+static int
+load(int fd)
 {
   struct elf32_ehdr ehdr;
   struct elf32_shdr shdr;
@@ -361,6 +409,8 @@ elfloader_load(int fd)
   int ret;
 
   elfloader_unknown[0] = 0;
+  readbuf.fd = -1;
+  memset(symbol_cache, 0, sizeof(symbol_cache));
 
   /* The ELF header is located at the start of the buffer. */
   seek_read(fd, 0, (char *)&ehdr, sizeof(ehdr));
@@ -438,7 +488,8 @@ elfloader_load(int fd)
       PRINTF("symtab\n");
       symtaboff = shdr.sh_offset;
       symtabsize = shdr.sh_size;
-    } else if(shdr.sh_type == SHT_STRTAB/*strncmp(name, ".strtab", 7) == 0*/) {
+    } else if(shdr.sh_type == SHT_STRTAB && i != ehdr.e_shstrndx
+              /*strncmp(name, ".strtab", 7) == 0*/) {
       PRINTF("strtab\n");
       strtaboff = shdr.sh_offset;
       strtabsize = shdr.sh_size;
@@ -525,9 +576,8 @@ elfloader_load(int fd)
 			   textrelaoff, textrelasize,
 			   textoff,
 			   text.address,
-			   strs,
 			   strtaboff,
-			   symtaboff, symtabsize, using_relas);
+			   symtaboff, using_relas);
     if(ret != ELFLOADER_OK) {
       return ret;
     }
@@ -540,9 +590,8 @@ elfloader_load(int fd)
 			   rodatarelaoff, rodatarelasize,
 			   rodataoff,
 			   rodata.address,
-			   strs,
 			   strtaboff,
-			   symtaboff, symtabsize, using_relas);
+			   symtaboff, using_relas);
     if(ret != ELFLOADER_OK) {
       PRINTF("elfloader: data failed\n");
       return ret;
@@ -556,9 +605,8 @@ elfloader_load(int fd)
 			   datarelaoff, datarelasize,
 			   dataoff,
 			   data.address,
-			   strs,
 			   strtaboff,
-			   symtaboff, symtabsize, using_relas);
+			   symtaboff, using_relas);
     if(ret != ELFLOADER_OK) {
       PRINTF("elfloader: data failed\n");
       return ret;
@@ -588,3 +636,17 @@ elfloader_load(int fd)
   }
 }
 /*---------------------------------------------------------------------------*/
+int
+elfloader_load(int fd)
+{
+  clock_time_t start;
+  int ret;
+
+  start = clock_time();
+  ret = load(fd);
+  elfloader_load_time = clock_time() - start;
+  PRINTF("elfloader: load %d in %lu ticks\n",
+	 ret, (unsigned long)elfloader_load_time);
+  return ret;
+}
+/*---------------------------------------------------------------------------*/
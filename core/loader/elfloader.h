@@ -76,6 +76,7 @@
 #define ELFLOADER_H_
 
 #include "cfs/cfs.h"
+#include "sys/clock.h"
 
 /**
  * Return value from elfloader_load() indicating that loading worked.
@@ -159,6 +160,34 @@ extern struct process * const * elfloader_autostart_processes;
  */
 extern char elfloader_unknown[30];
 
+/**
+ * The time, in clock ticks, taken by the last elfloader_load().
+ */
+extern clock_time_t elfloader_load_time;
+
+/**
+ * The size of the read-ahead buffer of the relocation and symbol
+ * tables.
+ */
+#ifndef ELFLOADER_READ_BUFFER_SIZE
+#ifdef ELFLOADER_CONF_READ_BUFFER_SIZE
+#define ELFLOADER_READ_BUFFER_SIZE ELFLOADER_CONF_READ_BUFFER_SIZE
+#else
+#define ELFLOADER_READ_BUFFER_SIZE 64
+#endif
+#endif /* ELFLOADER_READ_BUFFER_SIZE */
+
+/**
+ * The number of symbol addresses kept during relocation.
+ */
+#ifndef ELFLOADER_SYMBOL_CACHE_SIZE
+#ifdef ELFLOADER_CONF_SYMBOL_CACHE_SIZE
+#define ELFLOADER_SYMBOL_CACHE_SIZE ELFLOADER_CONF_SYMBOL_CACHE_SIZE
+#else
+#define ELFLOADER_SYMBOL_CACHE_SIZE 16
+#endif
+#endif /* ELFLOADER_SYMBOL_CACHE_SIZE */
+
 #ifndef ELFLOADER_DATAMEMORY_SIZE
 #ifdef ELFLOADER_CONF_DATAMEMORY_SIZE
 #define ELFLOADER_DATAMEMORY_SIZE ELFLOADER_CONF_DATAMEMORY_SIZE
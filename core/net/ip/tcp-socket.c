@@ -53,11 +53,53 @@ call_event(struct tcp_socket *s, tcp_socket_event_t event)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if UIP_TCP_WINDOW_SEGMENTS > 1
+/*---------------------------------------------------------------------------*/
+/* With several segments in flight, the output buffer starts with the
+   uip_outstanding() bytes in flight: new data is sent after them, and a
+   retransmission sends the oldest ones again. */
+static void
+senddata_window(struct tcp_socket *s)
+{
+  int offset, len;
+
+  offset = uip_rexmit() ? 0 : uip_outstanding(uip_conn);
+  len = MIN(s->output_data_len - offset, uip_mss());
+  if(len > 0) {
+    uip_send(&s->output_data_ptr[offset], len);
+    if(!uip_rexmit() && offset + len < s->output_data_len) {
+      /* Get called again to fill the window */
+      tcpip_poll_tcp(uip_conn);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+acked_window(struct tcp_socket *s)
+{
+  int len;
+
+  len = MIN(uip_ackedlen(), s->output_data_len);
+  memmove(&s->output_data_ptr[0], &s->output_data_ptr[len],
+          s->output_data_len - len);
+  s->output_data_len -= len;
+
+  call_event(s, TCP_SOCKET_DATA_SENT);
+}
+#endif /* UIP_TCP_WINDOW_SEGMENTS > 1 */
+/*---------------------------------------------------------------------------*/
 static void
 senddata(struct tcp_socket *s)
 {
   int len;
 
+#if UIP_TCP_WINDOW_SEGMENTS > 1
+  if(s->segments > 0) {
+    senddata_window(s);
+    return;
+  }
+#endif /* UIP_TCP_WINDOW_SEGMENTS > 1 */
+
   if(s->output_data_len > 0) {
     len = MIN(s->output_data_len, uip_mss());
     s->output_data_send_nxt = len;
@@ -68,6 +110,13 @@ senddata(struct tcp_socket *s)
 static void
 acked(struct tcp_socket *s)
 {
+#if UIP_TCP_WINDOW_SEGMENTS > 1
+  if(s->segments > 0) {
+    acked_window(s);
+    return;
+  }
+#endif /* UIP_TCP_WINDOW_SEGMENTS > 1 */
+
   if(s->output_data_len > 0) {
     /* Copy the data in the outputbuf down and update outputbufptr and
        outputbuf_lastsent */
@@ -160,6 +209,9 @@ appcall(void *state)
     if(s == NULL) {
       uip_abort();
     } else {
+#if UIP_TCP_WINDOW_SEGMENTS > 1
+      uip_set_segments(uip_conn, s->segments);
+#endif /* UIP_TCP_WINDOW_SEGMENTS > 1 */
       if(uip_newdata()) {
         newdata(s);
       }
@@ -261,6 +313,7 @@ tcp_socket_register(struct tcp_socket *s, void *ptr,
 
   s->listen_port = 0;
   s->flags = TCP_SOCKET_FLAGS_NONE;
+  s->segments = 0;
   return 1;
 }
 /*---------------------------------------------------------------------------*/
@@ -314,6 +367,22 @@ tcp_socket_unlisten(struct tcp_socket *s)
 }
 /*---------------------------------------------------------------------------*/
 int
+tcp_socket_set_window(struct tcp_socket *s, int segments)
+{
+  if(s == NULL || segments < 0) {
+    return -1;
+  }
+
+#if UIP_TCP_WINDOW_SEGMENTS > 1
+  s->segments = MIN(segments, UIP_TCP_WINDOW_SEGMENTS);
+  if(s->segments == 1) {
+    s->segments = 0;
+  }
+#endif /* UIP_TCP_WINDOW_SEGMENTS > 1 */
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
 tcp_socket_send(struct tcp_socket *s,
          const uint8_t *data, int datalen)
 {
@@ -97,6 +97,7 @@ struct tcp_socket {
   uint16_t output_data_send_nxt;
 
   uint8_t flags;
+  uint8_t segments;
   uint16_t listen_port;
   struct uip_conn *c;
 };
@@ -206,6 +207,28 @@ int tcp_socket_listen(struct tcp_socket *s,
  */
 int tcp_socket_unlisten(struct tcp_socket *s);
 
+/**
+ * \brief      Let a TCP socket have several segments in flight
+ * \param s    A pointer to a TCP socket that must have been previously registered with tcp_socket_register()
+ * \param segments The number of segments, at most UIP_CONF_TCP_WINDOW_SEGMENTS
+ * \retval -1  If an error occurs
+ * \retval 1   If the operation succeeds.
+ *
+ *             By default, a TCP socket waits for every segment to be
+ *             acknowledged before it sends the next one, i.e. it
+ *             sends one MSS per round-trip time. This function lets
+ *             the socket send up to segments segments of its output
+ *             buffer before waiting, which is needed over multi-hop
+ *             paths with long round-trip times. The output buffer
+ *             should then hold at least that many segments.
+ *
+ *             The setting takes effect when the socket gets
+ *             connected. With UIP_CONF_TCP_WINDOW_SEGMENTS unset, the
+ *             socket stays stop-and-wait.
+ *
+ */
+int tcp_socket_set_window(struct tcp_socket *s, int segments);
+
 /**
  * \brief      Send data on a connected TCP socket
  * \param s    A pointer to a TCP socket that must have been previously registered with tcp_socket_register()
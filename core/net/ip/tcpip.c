@@ -541,6 +541,9 @@ tcpip_ipv6_output(void)
 {
   uip_ds6_nbr_t *nbr = NULL;
   uip_ipaddr_t *nexthop;
+#if UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING
+  uip_ipaddr_t srh_nexthop;
+#endif /* UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING */
 
   if(uip_len == 0) {
     return;
@@ -567,6 +570,12 @@ tcpip_ipv6_output(void)
        nexthop address. */
     if(uip_ds6_is_addr_onlink(&UIP_IP_BUF->destipaddr)){
       nexthop = &UIP_IP_BUF->destipaddr;
+#if UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING
+    } else if(rpl_srh_get_next_hop(&srh_nexthop)) {
+      /* Source-routed packet, the next hop is the current destination */
+      nexthop = &srh_nexthop;
+      LOGU("Tcpip: fw to %d (source route) (%u bytes)", LOG_NODEID_FROM_IPADDR(nexthop), uip_len);
+#endif /* UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING */
     } else {
       uip_ds6_route_t *route;
       /* Check if we have a route to the destination address. */
@@ -580,6 +589,9 @@ tcpip_ipv6_output(void)
       if(route == NULL) {
         PRINTF("tcpip_ipv6_output: no route found, using default route\n");
         nexthop = uip_ds6_defrt_choose();
+#if UIP_CONF_IPV6_RPL
+        nexthop = rpl_get_upward_nexthop(nexthop);
+#endif /* UIP_CONF_IPV6_RPL */
         if(nexthop == NULL) {
 #ifdef UIP_FALLBACK_INTERFACE
 	  PRINTF("FALLBACK: removing ext hdrs & setting proto %d %d\n", 
@@ -655,6 +667,18 @@ tcpip_ipv6_output(void)
       return;
     }
 #endif /* UIP_CONF_IPV6_RPL */
+#if UIP_DS6_LL_FROM_IID
+    {
+      /* Link-local next hops are resolved from their IID, no neighbor
+         cache entry and no NS needed */
+      uip_lladdr_t lladdr;
+      if(uip_ds6_lladdr_from_iid(&lladdr, nexthop)) {
+        tcpip_output(&lladdr);
+        uip_len = 0;
+        return;
+      }
+    }
+#endif /* UIP_DS6_LL_FROM_IID */
     nbr = uip_ds6_nbr_lookup(nexthop);
     if(nbr == NULL) {
 #if UIP_ND6_SEND_NA
@@ -664,10 +688,8 @@ tcpip_ipv6_output(void)
       } else {
 #if UIP_CONF_IPV6_QUEUE_PKT
         /* Copy outgoing pkt in the queuing buffer for later transmit. */
-        if(uip_packetqueue_alloc(&nbr->packethandle, UIP_DS6_NBR_PACKET_LIFETIME) != NULL) {
-          memcpy(uip_packetqueue_buf(&nbr->packethandle), UIP_IP_BUF, uip_len);
-          uip_packetqueue_set_buflen(&nbr->packethandle, uip_len);
-        }
+        uip_packetqueue_push(&nbr->packethandle, UIP_DS6_NBR_PACKET_LIFETIME,
+                             UIP_IP_BUF, uip_len);
 #endif
       /* RFC4861, 7.2.2:
        * "If the source address of the packet prompting the solicitation is the
@@ -692,10 +714,8 @@ tcpip_ipv6_output(void)
 #if UIP_CONF_IPV6_QUEUE_PKT
         /* Copy outgoing pkt in the queuing buffer for later transmit and set
            the destination nbr to nbr. */
-        if(uip_packetqueue_alloc(&nbr->packethandle, UIP_DS6_NBR_PACKET_LIFETIME) != NULL) {
-          memcpy(uip_packetqueue_buf(&nbr->packethandle), UIP_IP_BUF, uip_len);
-          uip_packetqueue_set_buflen(&nbr->packethandle, uip_len);
-        }
+        uip_packetqueue_push(&nbr->packethandle, UIP_DS6_NBR_PACKET_LIFETIME,
+                             UIP_IP_BUF, uip_len);
 #endif /*UIP_CONF_IPV6_QUEUE_PKT*/
         uip_len = 0;
         return;
@@ -719,10 +739,10 @@ tcpip_ipv6_output(void)
        * NA after sendiong a NS, you receive a NS with SLLAO: the entry moves
        * to STALE, and you must both send a NA and the queued packet.
        */
-      if(uip_packetqueue_buflen(&nbr->packethandle) != 0) {
+      while(uip_packetqueue_buflen(&nbr->packethandle) != 0) {
         uip_len = uip_packetqueue_buflen(&nbr->packethandle);
         memcpy(UIP_IP_BUF, uip_packetqueue_buf(&nbr->packethandle), uip_len);
-        uip_packetqueue_free(&nbr->packethandle);
+        uip_packetqueue_pop(&nbr->packethandle);
         tcpip_output(uip_ds6_nbr_get_ll(nbr));
       }
 #endif /*UIP_CONF_IPV6_QUEUE_PKT*/
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 
 #include "net/ip/uip.h"
 
@@ -6,8 +7,18 @@
 
 #include "net/ip/uip-packetqueue.h"
 
-#define MAX_NUM_QUEUED_PACKETS 2
-MEMB(packets_memb, struct uip_packetqueue_packet, MAX_NUM_QUEUED_PACKETS);
+MEMB(packets_memb, struct uip_packetqueue_packet, UIP_PACKETQUEUE_NUM);
+
+/* The memory a packet takes */
+#if UIP_PACKETQUEUE_WITH_PACKETMEM
+#define PACKET_SIZE(p) packetmem_size((p)->mem)
+#else /* UIP_PACKETQUEUE_WITH_PACKETMEM */
+#define PACKET_SIZE(p) (UIP_BUFSIZE - UIP_LLH_LEN)
+#endif /* UIP_PACKETQUEUE_WITH_PACKETMEM */
+
+#if UIP_PACKETQUEUE_MAX_BYTES
+static uint16_t queued_bytes;
+#endif /* UIP_PACKETQUEUE_MAX_BYTES */
 
 #define DEBUG 0
 #if DEBUG
@@ -17,15 +28,36 @@ MEMB(packets_memb, struct uip_packetqueue_packet, MAX_NUM_QUEUED_PACKETS);
 #define PRINTF(...)
 #endif
 
+/*---------------------------------------------------------------------------*/
+/* Unlink a packet from its queue and free it */
+static void
+packet_free(struct uip_packetqueue_packet *p)
+{
+  struct uip_packetqueue_packet **pp;
+
+  for(pp = &p->handle->packet; *pp != NULL; pp = &(*pp)->next) {
+    if(*pp == p) {
+      *pp = p->next;
+      break;
+    }
+  }
+  ctimer_stop(&p->lifetimer);
+#if UIP_PACKETQUEUE_MAX_BYTES
+  queued_bytes -= PACKET_SIZE(p);
+#endif /* UIP_PACKETQUEUE_MAX_BYTES */
+#if UIP_PACKETQUEUE_WITH_PACKETMEM
+  packetmem_free(p->mem);
+#endif /* UIP_PACKETQUEUE_WITH_PACKETMEM */
+  memb_free(&packets_memb, p);
+}
 /*---------------------------------------------------------------------------*/
 static void
 packet_timedout(void *ptr)
 {
-  struct uip_packetqueue_handle *h = ptr;
+  struct uip_packetqueue_packet *p = ptr;
 
-  PRINTF("uip_packetqueue_free timed out %p\n", h);
-  memb_free(&packets_memb, h->packet);
-  h->packet = NULL;
+  PRINTF("uip_packetqueue_free timed out %p\n", p->handle);
+  packet_free(p);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -33,41 +65,117 @@ uip_packetqueue_new(struct uip_packetqueue_handle *handle)
 {
   PRINTF("uip_packetqueue_new %p\n", handle);
   handle->packet = NULL;
+#if UIP_PACKETQUEUE_WITH_PACKETMEM
+  packetmem_init();
+#endif /* UIP_PACKETQUEUE_WITH_PACKETMEM */
 }
 /*---------------------------------------------------------------------------*/
 struct uip_packetqueue_packet *
 uip_packetqueue_alloc(struct uip_packetqueue_handle *handle, clock_time_t lifetime)
 {
+  return uip_packetqueue_alloc_len(handle, lifetime, UIP_BUFSIZE - UIP_LLH_LEN);
+}
+/*---------------------------------------------------------------------------*/
+struct uip_packetqueue_packet *
+uip_packetqueue_alloc_len(struct uip_packetqueue_handle *handle,
+                          clock_time_t lifetime, uint16_t len)
+{
+  struct uip_packetqueue_packet **pp;
+  struct uip_packetqueue_packet *p;
+  int count;
+
   PRINTF("uip_packetqueue_alloc %p\n", handle);
-  if(handle->packet != NULL) {
-    PRINTF("alloced\n");
+  if(len > UIP_BUFSIZE - UIP_LLH_LEN) {
     return NULL;
   }
-  handle->packet = memb_alloc(&packets_memb);
-  if(handle->packet != NULL) {
-    ctimer_set(&handle->packet->lifetimer, lifetime,
-               packet_timedout, handle);
-  } else {
+  count = 0;
+  for(pp = &handle->packet; *pp != NULL; pp = &(*pp)->next) {
+    count++;
+  }
+  if(count >= UIP_PACKETQUEUE_MAX_PER_HANDLE) {
+    PRINTF("uip_packetqueue_alloc full\n");
+    return NULL;
+  }
+
+  p = memb_alloc(&packets_memb);
+#if UIP_PACKETQUEUE_WITH_PACKETMEM
+  if(p != NULL) {
+    p->mem = packetmem_alloc(len);
+    if(p->mem == NULL) {
+      memb_free(&packets_memb, p);
+      p = NULL;
+    }
+  }
+#endif /* UIP_PACKETQUEUE_WITH_PACKETMEM */
+#if UIP_PACKETQUEUE_MAX_BYTES
+  if(p != NULL && queued_bytes + PACKET_SIZE(p) > UIP_PACKETQUEUE_MAX_BYTES) {
+#if UIP_PACKETQUEUE_WITH_PACKETMEM
+    packetmem_free(p->mem);
+#endif /* UIP_PACKETQUEUE_WITH_PACKETMEM */
+    memb_free(&packets_memb, p);
+    p = NULL;
+  }
+#endif /* UIP_PACKETQUEUE_MAX_BYTES */
+  if(p == NULL) {
     PRINTF("uip_packetqueue_alloc failed\n");
+    return NULL;
+  }
+
+#if UIP_PACKETQUEUE_MAX_BYTES
+  queued_bytes += PACKET_SIZE(p);
+#endif /* UIP_PACKETQUEUE_MAX_BYTES */
+  p->next = NULL;
+  p->handle = handle;
+  p->queue_buf_len = 0;
+  ctimer_set(&p->lifetimer, lifetime, packet_timedout, p);
+  *pp = p;
+  return p;
+}
+/*---------------------------------------------------------------------------*/
+int
+uip_packetqueue_push(struct uip_packetqueue_handle *handle,
+                     clock_time_t lifetime, const void *data, uint16_t len)
+{
+  struct uip_packetqueue_packet *p;
+
+  p = uip_packetqueue_alloc_len(handle, lifetime, len);
+  if(p == NULL) {
+    return 0;
+  }
+#if UIP_PACKETQUEUE_WITH_PACKETMEM
+  memcpy(packetmem_ptr(p->mem), data, len);
+#else /* UIP_PACKETQUEUE_WITH_PACKETMEM */
+  memcpy(p->queue_buf, data, len);
+#endif /* UIP_PACKETQUEUE_WITH_PACKETMEM */
+  p->queue_buf_len = len;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_packetqueue_pop(struct uip_packetqueue_handle *handle)
+{
+  if(handle->packet != NULL) {
+    packet_free(handle->packet);
   }
-  return handle->packet;
 }
 /*---------------------------------------------------------------------------*/
 void
 uip_packetqueue_free(struct uip_packetqueue_handle *handle)
 {
   PRINTF("uip_packetqueue_free %p\n", handle);
-  if(handle->packet != NULL) {
-    ctimer_stop(&handle->packet->lifetimer);
-    memb_free(&packets_memb, handle->packet);
-    handle->packet = NULL;
+  while(handle->packet != NULL) {
+    packet_free(handle->packet);
   }
 }
 /*---------------------------------------------------------------------------*/
 uint8_t *
 uip_packetqueue_buf(struct uip_packetqueue_handle *h)
 {
+#if UIP_PACKETQUEUE_WITH_PACKETMEM
+  return h->packet != NULL? packetmem_ptr(h->packet->mem): NULL;
+#else /* UIP_PACKETQUEUE_WITH_PACKETMEM */
   return h->packet != NULL? h->packet->queue_buf: NULL;
+#endif /* UIP_PACKETQUEUE_WITH_PACKETMEM */
 }
 /*---------------------------------------------------------------------------*/
 uint16_t
@@ -80,6 +188,11 @@ void
 uip_packetqueue_set_buflen(struct uip_packetqueue_handle *h, uint16_t len)
 {
   if(h->packet != NULL) {
+#if UIP_PACKETQUEUE_WITH_PACKETMEM
+    if(len > packetmem_size(h->packet->mem)) {
+      len = packetmem_size(h->packet->mem);
+    }
+#endif /* UIP_PACKETQUEUE_WITH_PACKETMEM */
     h->packet->queue_buf_len = len;
   }
 }
@@ -3,16 +3,57 @@
 
 #include "sys/ctimer.h"
 
+/* With UIP_PACKETQUEUE_CONF_WITH_PACKETMEM, the queued packets are
+   allocated at their length out of the packetmem pool, rather than in
+   full uip_buf-sized slots */
+#ifdef UIP_PACKETQUEUE_CONF_WITH_PACKETMEM
+#define UIP_PACKETQUEUE_WITH_PACKETMEM UIP_PACKETQUEUE_CONF_WITH_PACKETMEM
+#else
+#define UIP_PACKETQUEUE_WITH_PACKETMEM 0
+#endif
+
+#if UIP_PACKETQUEUE_WITH_PACKETMEM
+#include "net/packetmem.h"
+#endif /* UIP_PACKETQUEUE_WITH_PACKETMEM */
+
+/* Total number of queued packets, shared by all handles */
+#ifdef UIP_PACKETQUEUE_CONF_NUM
+#define UIP_PACKETQUEUE_NUM UIP_PACKETQUEUE_CONF_NUM
+#else
+#define UIP_PACKETQUEUE_NUM 2
+#endif
+
+/* Max number of packets queued to a handle (i.e., a neighbor awaiting
+   address resolution). When full, new packets are dropped */
+#ifdef UIP_PACKETQUEUE_CONF_MAX_PER_HANDLE
+#define UIP_PACKETQUEUE_MAX_PER_HANDLE UIP_PACKETQUEUE_CONF_MAX_PER_HANDLE
+#else
+#define UIP_PACKETQUEUE_MAX_PER_HANDLE 1
+#endif
+
+/* Max number of bytes queued, all handles together. 0: no limit other
+   than UIP_PACKETQUEUE_NUM */
+#ifdef UIP_PACKETQUEUE_CONF_MAX_BYTES
+#define UIP_PACKETQUEUE_MAX_BYTES UIP_PACKETQUEUE_CONF_MAX_BYTES
+#else
+#define UIP_PACKETQUEUE_MAX_BYTES 0
+#endif
+
 struct uip_packetqueue_handle;
 
 struct uip_packetqueue_packet {
-  struct uip_ds6_queued_packet *next;
+  struct uip_packetqueue_packet *next;
+#if UIP_PACKETQUEUE_WITH_PACKETMEM
+  struct packetmem *mem;
+#else /* UIP_PACKETQUEUE_WITH_PACKETMEM */
   uint8_t queue_buf[UIP_BUFSIZE - UIP_LLH_LEN];
+#endif /* UIP_PACKETQUEUE_WITH_PACKETMEM */
   uint16_t queue_buf_len;
   struct ctimer lifetimer;
   struct uip_packetqueue_handle *handle;
 };
 
+/* A FIFO of packets, oldest first */
 struct uip_packetqueue_handle {
   struct uip_packetqueue_packet *packet;
 };
@@ -23,10 +64,24 @@ void uip_packetqueue_new(struct uip_packetqueue_handle *handle);
 struct uip_packetqueue_packet *
 uip_packetqueue_alloc(struct uip_packetqueue_handle *handle, clock_time_t lifetime);
 
+/* Allocate a packet of up to len bytes at the end of the queue */
+struct uip_packetqueue_packet *
+uip_packetqueue_alloc_len(struct uip_packetqueue_handle *handle,
+                          clock_time_t lifetime, uint16_t len);
+
+/* Queue a copy of len bytes of data. Returns 1 if queued, 0 otherwise */
+int uip_packetqueue_push(struct uip_packetqueue_handle *handle,
+                         clock_time_t lifetime,
+                         const void *data, uint16_t len);
+
+/* Free the oldest packet of the queue */
+void uip_packetqueue_pop(struct uip_packetqueue_handle *handle);
 
+/* Free all packets of the queue */
 void
 uip_packetqueue_free(struct uip_packetqueue_handle *handle);
 
+/* Buffer and length of the oldest packet of the queue */
 uint8_t *uip_packetqueue_buf(struct uip_packetqueue_handle *h);
 uint16_t uip_packetqueue_buflen(struct uip_packetqueue_handle *h);
 void uip_packetqueue_set_buflen(struct uip_packetqueue_handle *h, uint16_t len);
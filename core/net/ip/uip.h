@@ -837,6 +837,32 @@ CCIF void uip_send(const void *data, int len);
  */
 #define uip_mss()             (uip_conn->mss)
 
+#if UIP_TCP_WINDOW_SEGMENTS > 1
+/**
+ * Let a connection have several segments in flight.
+ *
+ * Up to n segments (at most UIP_TCP_WINDOW_SEGMENTS, and within the
+ * window of the receiver) can then be sent before being acknowledged;
+ * 0 goes back to stop-and-wait. This changes what the application
+ * sees: uip_outstanding() is the number of bytes in flight, the data
+ * given to uip_send() goes after them, uip_acked() is also set when
+ * only part of them is acknowledged, see uip_ackedlen(), and a
+ * retransmission must send the oldest bytes in flight again.
+ *
+ * \hideinitializer
+ */
+#define uip_set_segments(conn, n) ((conn)->segments = (n))
+
+/**
+ * The number of bytes acknowledged, from the oldest in flight, when
+ * uip_acked() is set on a connection with uip_set_segments().
+ *
+ * \hideinitializer
+ */
+#define uip_ackedlen()        (uip_acklen)
+CCIF extern uint16_t uip_acklen;
+#endif /* UIP_TCP_WINDOW_SEGMENTS > 1 */
+
 /**
  * Set up a new UDP connection.
  *
@@ -1358,6 +1384,11 @@ struct uip_conn {
   uint8_t timer;         /**< The retransmission timer. */
   uint8_t nrtx;          /**< The number of retransmissions for the last
 			 segment sent. */
+#if UIP_TCP_WINDOW_SEGMENTS > 1
+  uint8_t segments;      /**< The number of segments allowed in flight,
+                         0 for stop-and-wait. */
+  uint16_t snd_wnd;      /**< The window advertised by the remote host. */
+#endif /* UIP_TCP_WINDOW_SEGMENTS > 1 */
 
   /** The application state. */
   uip_tcp_appstate_t appstate;
@@ -1607,6 +1638,7 @@ void uip_process(uint8_t flag);
 #define UIP_TS_MASK     15
 
 #define UIP_STOPPED      16
+#define UIP_ACKPENDING   32
 
 /* The TCP and IP headers. */
 struct uip_tcpip_hdr {
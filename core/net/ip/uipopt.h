@@ -500,6 +500,43 @@ void uip_log(char *msg);
 #define UIP_RECEIVE_WINDOW (UIP_CONF_RECEIVE_WINDOW)
 #endif
 
+/**
+ * The maximum number of segments a TCP connection can have in flight.
+ *
+ * Only the connections that ask for it with uip_set_segments() send
+ * more than one segment before being acknowledged, all others keep
+ * the stop-and-wait behavior of uIP. Set to 1 to compile the sliding
+ * window out. IPv6 only.
+ *
+ * \hideinitializer
+ */
+#ifndef UIP_CONF_TCP_WINDOW_SEGMENTS
+#define UIP_TCP_WINDOW_SEGMENTS 1
+#else
+#define UIP_TCP_WINDOW_SEGMENTS (UIP_CONF_TCP_WINDOW_SEGMENTS)
+#endif
+
+#if UIP_TCP_WINDOW_SEGMENTS > 1 && !NETSTACK_CONF_WITH_IPV6
+#error UIP_CONF_TCP_WINDOW_SEGMENTS is only supported by the IPv6 stack
+#endif
+
+/**
+ * Delayed ACKs.
+ *
+ * If set, received data that the application sends no reply to is
+ * acknowledged with the next segment received, or by the periodic TCP
+ * timer at the latest. This halves the number of ACKs of a bulk
+ * transfer, but the peer must be allowed to send two segments, i.e.
+ * UIP_CONF_RECEIVE_WINDOW be at least twice the MSS.
+ *
+ * \hideinitializer
+ */
+#ifndef UIP_CONF_TCP_DELAYED_ACK
+#define UIP_TCP_DELAYED_ACK 0
+#else
+#define UIP_TCP_DELAYED_ACK (UIP_CONF_TCP_DELAYED_ACK)
+#endif
+
 /**
  * How long a connection should stay in the TIME_WAIT state.
  *
@@ -570,6 +607,68 @@ void uip_log(char *msg);
 #define SICSLOWPAN_REASS_MAXAGE 20
 #endif
 
+/**
+ * Number of datagrams reassembled concurrently at the 6lowpan layer, each
+ * with a buffer of UIP_BUFSIZE bytes
+ */
+#ifdef SICSLOWPAN_CONF_REASS_CONTEXTS
+#define SICSLOWPAN_REASS_CONTEXTS (SICSLOWPAN_CONF_REASS_CONTEXTS)
+#else
+#define SICSLOWPAN_REASS_CONTEXTS 1
+#endif
+
+/**
+ * Fragment forwarding: fragments of a datagram routed through us are
+ * forwarded as they arrive instead of being reassembled first. At most
+ * SICSLOWPAN_FRAG_FORWARD_ENTRIES datagrams are forwarded concurrently,
+ * the others are reassembled. Requires SICSLOWPAN_CONF_FRAG.
+ */
+#ifdef SICSLOWPAN_CONF_FRAG_FORWARDING
+#define SICSLOWPAN_FRAG_FORWARDING (SICSLOWPAN_CONF_FRAG_FORWARDING)
+#else
+#define SICSLOWPAN_FRAG_FORWARDING 0
+#endif
+
+#if SICSLOWPAN_FRAG_FORWARDING && !SICSLOWPAN_CONF_FRAG
+#error SICSLOWPAN_CONF_FRAG_FORWARDING requires SICSLOWPAN_CONF_FRAG
+#endif
+
+#ifdef SICSLOWPAN_CONF_FRAG_FORWARD_ENTRIES
+#define SICSLOWPAN_FRAG_FORWARD_ENTRIES (SICSLOWPAN_CONF_FRAG_FORWARD_ENTRIES)
+#else
+#define SICSLOWPAN_FRAG_FORWARD_ENTRIES 4
+#endif
+
+/**
+ * UDP compression profiles (IPHC only): how many profiles can be
+ * registered with sicslowpan_udp_profile_register(), 0 to disable.
+ * A profile elides a well-known UDP port, and may compress the payload
+ * of datagrams of up to SICSLOWPAN_UDP_PROFILE_MAX_PAYLOAD bytes.
+ */
+#ifdef SICSLOWPAN_CONF_UDP_PROFILES
+#define SICSLOWPAN_UDP_PROFILES (SICSLOWPAN_CONF_UDP_PROFILES)
+#else
+#define SICSLOWPAN_UDP_PROFILES 0
+#endif
+
+#ifdef SICSLOWPAN_CONF_UDP_PROFILE_MAX_PAYLOAD
+#define SICSLOWPAN_UDP_PROFILE_MAX_PAYLOAD (SICSLOWPAN_CONF_UDP_PROFILE_MAX_PAYLOAD)
+#else
+#define SICSLOWPAN_UDP_PROFILE_MAX_PAYLOAD 32
+#endif
+
+/**
+ * Unfragmented outgoing packets get their 6lowpan header in the packetbuf
+ * header area and reference their payload in uip_buf, which the MAC
+ * layer copies once when queueing the packet. Only for MAC layers that
+ * queue packets (TSCH, CSMA), and without link-layer security.
+ */
+#ifdef SICSLOWPAN_CONF_OUTPUT_REFERENCE
+#define SICSLOWPAN_OUTPUT_REFERENCE (SICSLOWPAN_CONF_OUTPUT_REFERENCE)
+#else
+#define SICSLOWPAN_OUTPUT_REFERENCE 0
+#endif
+
 /**
  * Do we compress the IP header or not (default: no)
  */
@@ -38,6 +38,7 @@
 #include "lib/random.h"
 
 #include <string.h>
+#include <stddef.h>
 
 #ifdef IP64_ADDRMAP_CONF_ENTRIES
 #define NUM_ENTRIES IP64_ADDRMAP_CONF_ENTRIES
@@ -45,9 +46,46 @@
 #define NUM_ENTRIES 32
 #endif /* IP64_ADDRMAP_CONF_ENTRIES */
 
+/* Buckets of the two lookup tables: by connection and by mapped port */
+#ifdef IP64_ADDRMAP_CONF_HASH_SIZE
+#define HASH_SIZE IP64_ADDRMAP_CONF_HASH_SIZE
+#else /* IP64_ADDRMAP_CONF_HASH_SIZE */
+#define HASH_SIZE 16
+#endif /* IP64_ADDRMAP_CONF_HASH_SIZE */
+
+/* Expiry timer wheel: WHEEL_SLOTS slots of WHEEL_TICK each. Mappings
+   further away than a full turn are looked at once per turn. */
+#ifdef IP64_ADDRMAP_CONF_WHEEL_SLOTS
+#define WHEEL_SLOTS IP64_ADDRMAP_CONF_WHEEL_SLOTS
+#else /* IP64_ADDRMAP_CONF_WHEEL_SLOTS */
+#define WHEEL_SLOTS 32
+#endif /* IP64_ADDRMAP_CONF_WHEEL_SLOTS */
+
+#ifdef IP64_ADDRMAP_CONF_WHEEL_TICK
+#define WHEEL_TICK IP64_ADDRMAP_CONF_WHEEL_TICK
+#else /* IP64_ADDRMAP_CONF_WHEEL_TICK */
+#define WHEEL_TICK (CLOCK_SECOND * 2)
+#endif /* IP64_ADDRMAP_CONF_WHEEL_TICK */
+
 MEMB(entrymemb, struct ip64_addrmap_entry, NUM_ENTRIES);
 LIST(entrylist);
 
+static struct ip64_addrmap_entry *conn_hash[HASH_SIZE];
+static struct ip64_addrmap_entry *port_hash[HASH_SIZE];
+
+#define CONN_HASH(ip6addr, ip6port, ip4addr, ip4port)                   \
+  (((ip6addr)->u8[14] ^ (ip6addr)->u8[15] ^ (ip4addr)->u8[3] ^          \
+    (ip6port) ^ ((ip6port) >> 8) ^ (ip4port) ^ ((ip4port) >> 8)) % HASH_SIZE)
+#define PORT_HASH(port) (((port) ^ ((port) >> 8)) % HASH_SIZE)
+
+/* Mappings are in the slot of the wheel in which they expire. The
+   lifetime of a mapping is updated on every packet, without moving it:
+   when its slot comes, a mapping that is still alive goes to the slot of
+   its new expiry time. */
+static struct ip64_addrmap_entry *wheel[WHEEL_SLOTS];
+static uint8_t wheel_pos;
+static clock_time_t wheel_time;
+
 #define FIRST_MAPPED_PORT 10000
 #define LAST_MAPPED_PORT  20000
 static uint16_t mapped_port = FIRST_MAPPED_PORT;
@@ -66,26 +104,93 @@ ip64_addrmap_init(void)
 {
   memb_init(&entrymemb);
   list_init(entrylist);
+  memset(conn_hash, 0, sizeof(conn_hash));
+  memset(port_hash, 0, sizeof(port_hash));
+  memset(wheel, 0, sizeof(wheel));
+  wheel_pos = 0;
+  wheel_time = clock_time();
   mapped_port = FIRST_MAPPED_PORT;
 }
 /*---------------------------------------------------------------------------*/
 static void
+wheel_add(struct ip64_addrmap_entry *m)
+{
+  clock_time_t d;
+  clock_time_t ticks;
+
+  /* The time of expiry from the start of the current slot */
+  d = 0;
+  if(!timer_expired(&m->timer)) {
+    d = timer_remaining(&m->timer) + (clock_time() - wheel_time);
+  }
+  ticks = d / WHEEL_TICK;
+  if(ticks >= WHEEL_SLOTS) {
+    ticks = WHEEL_SLOTS - 1;
+  }
+  m->wheel_slot = (wheel_pos + ticks) % WHEEL_SLOTS;
+  m->wheel_next = wheel[m->wheel_slot];
+  wheel[m->wheel_slot] = m;
+}
+/*---------------------------------------------------------------------------*/
+static void
+chain_remove(struct ip64_addrmap_entry **p, struct ip64_addrmap_entry *m,
+       int offset)
+{
+  /* Follow the next pointer at offset in the entries of chain p */
+  while(*p != NULL && *p != m) {
+    p = (struct ip64_addrmap_entry **)((char *)*p + offset);
+  }
+  if(*p != NULL) {
+    *p = *(struct ip64_addrmap_entry **)((char *)m + offset);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_entry(struct ip64_addrmap_entry *m, int in_wheel)
+{
+  list_remove(entrylist, m);
+  chain_remove(&conn_hash[CONN_HASH(&m->ip6addr, m->ip6port,
+                              &m->ip4addr, m->ip4port)], m,
+         offsetof(struct ip64_addrmap_entry, conn_next));
+  chain_remove(&port_hash[PORT_HASH(m->mapped_port)], m,
+         offsetof(struct ip64_addrmap_entry, port_next));
+  if(in_wheel) {
+    chain_remove(&wheel[m->wheel_slot], m,
+           offsetof(struct ip64_addrmap_entry, wheel_next));
+  }
+  memb_free(&entrymemb, m);
+}
+/*---------------------------------------------------------------------------*/
+static void
 check_age(void)
 {
-  struct ip64_addrmap_entry *m;
+  struct ip64_addrmap_entry *m, *next;
+  clock_time_t now;
+  int steps;
 
-  /* Walk through the list of address mappings, throw away the ones
-     that are too old. */
-  m = list_head(entrylist);
-  while(m != NULL) {
-    if(timer_expired(&m->timer)) {
-      list_remove(entrylist, m);
-      memb_free(&entrymemb, m);
-      m = list_head(entrylist);
-    } else {
-      m = list_item_next(m);
+  /* Throw away the mappings of the slots that have passed; the others
+     in these slots go to the slot of their current expiry time. */
+  now = clock_time();
+  for(steps = 0;
+      steps < WHEEL_SLOTS && (clock_time_t)(now - wheel_time) >= WHEEL_TICK;
+      steps++) {
+    m = wheel[wheel_pos];
+    wheel[wheel_pos] = NULL;
+    wheel_pos = (wheel_pos + 1) % WHEEL_SLOTS;
+    wheel_time += WHEEL_TICK;
+    for(; m != NULL; m = next) {
+      next = m->wheel_next;
+      if(timer_expired(&m->timer)) {
+        remove_entry(m, 0);
+      } else {
+        wheel_add(m);
+      }
     }
   }
+  if((clock_time_t)(now - wheel_time) >= WHEEL_TICK) {
+    /* All slots were seen: skip the rest */
+    wheel_time = now - (clock_time_t)(now - wheel_time) % WHEEL_TICK;
+  }
 }
 /*---------------------------------------------------------------------------*/
 static int
@@ -94,9 +199,6 @@ recycle(void)
   /* Find the oldest recyclable mapping and remove it. */
   struct ip64_addrmap_entry *m, *oldest;
 
-  /* Walk through the list of address mappings, throw away the ones
-     that are too old. */
-
   oldest = NULL;
   for(m = list_head(entrylist);
       m != NULL;
@@ -116,8 +218,7 @@ recycle(void)
   /* If we found an oldest recyclable entry, remove it and return
      non-zero. */
   if(oldest != NULL) {
-    list_remove(entrylist, oldest);
-    memb_free(&entrymemb, oldest);
+    remove_entry(oldest, 1);
     return 1;
   }
 
@@ -136,18 +237,19 @@ ip64_addrmap_lookup(const uip_ip6addr_t *ip6addr,
   printf("lookup ip4port %d ip6port %d\n", uip_htons(ip4port),
 	 uip_htons(ip6port));
   check_age();
-  for(m = list_head(entrylist); m != NULL; m = list_item_next(m)) {
-    printf("protocol %d %d, ip4port %d %d, ip6port %d %d, ip4 %d ip6 %d\n",
-	   m->protocol, protocol,
-	   m->ip4port, ip4port,
-	   m->ip6port, ip6port,
-	   uip_ip4addr_cmp(&m->ip4addr, ip4addr),
-	   uip_ip6addr_cmp(&m->ip6addr, ip6addr));
+  for(m = conn_hash[CONN_HASH(ip6addr, ip6port, ip4addr, ip4port)];
+      m != NULL;
+      m = m->conn_next) {
     if(m->protocol == protocol &&
        m->ip4port == ip4port &&
        m->ip6port == ip6port &&
        uip_ip4addr_cmp(&m->ip4addr, ip4addr) &&
        uip_ip6addr_cmp(&m->ip6addr, ip6addr)) {
+      if(timer_expired(&m->timer)) {
+        /* Expired, but its slot has not come yet */
+        remove_entry(m, 1);
+        return NULL;
+      }
       return m;
     }
   }
@@ -160,18 +262,35 @@ ip64_addrmap_lookup_port(uint16_t mapped_port, uint8_t protocol)
   struct ip64_addrmap_entry *m;
 
   check_age();
-  for(m = list_head(entrylist); m != NULL; m = list_item_next(m)) {
+  for(m = port_hash[PORT_HASH(mapped_port)]; m != NULL; m = m->port_next) {
     printf("mapped port %d %d, protocol %d %d\n",
 	   m->mapped_port, mapped_port,
 	   m->protocol, protocol);
     if(m->mapped_port == mapped_port &&
        m->protocol == protocol) {
+      if(timer_expired(&m->timer)) {
+        remove_entry(m, 1);
+        return NULL;
+      }
       return m;
     }
   }
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+static int
+mapped_port_in_use(uint16_t port)
+{
+  struct ip64_addrmap_entry *m;
+
+  for(m = port_hash[PORT_HASH(port)]; m != NULL; m = m->port_next) {
+    if(m->mapped_port == port) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
 static void
 increase_mapped_port(void)
 {
@@ -187,6 +306,7 @@ ip64_addrmap_create(const uip_ip6addr_t *ip6addr,
 		    uint8_t protocol)
 {
   struct ip64_addrmap_entry *m;
+  struct ip64_addrmap_entry **bucket;
 
   check_age();
   m = memb_alloc(&entrymemb);
@@ -209,22 +329,21 @@ ip64_addrmap_create(const uip_ip6addr_t *ip6addr,
     /* Pick a new, unused local port. First make sure that the
        mapped_port number does not belong to any active connection. If
        so, we keep increasing the mapped_port until we're free. */
-    {
-      struct ip64_addrmap_entry *n;
-      n = list_head(entrylist);
-      while(n != NULL) {
-	if(n->mapped_port == mapped_port) {
-	  increase_mapped_port();
-	  n = list_head(entrylist);
-	} else {
-	  n = list_item_next(m);
-	}
-      }
+    while(mapped_port_in_use(mapped_port)) {
+      increase_mapped_port();
     }
     m->mapped_port = mapped_port;
     increase_mapped_port();
 
     list_add(entrylist, m);
+    bucket = &conn_hash[CONN_HASH(ip6addr, ip6port, ip4addr, ip4port)];
+    m->conn_next = *bucket;
+    *bucket = m;
+    bucket = &port_hash[PORT_HASH(m->mapped_port)];
+    m->port_next = *bucket;
+    *bucket = m;
+    /* Goes to the next slot, by when it has its lifetime */
+    wheel_add(m);
     return m;
   }
   return NULL;
@@ -37,6 +37,11 @@
 
 struct ip64_addrmap_entry {
   struct ip64_addrmap_entry *next;
+  /* Chains of the connection and mapped port hash tables, and of the
+     expiry wheel slot */
+  struct ip64_addrmap_entry *conn_next;
+  struct ip64_addrmap_entry *port_next;
+  struct ip64_addrmap_entry *wheel_next;
   struct timer timer;
   uip_ip6addr_t ip6addr;
   uip_ip4addr_t ip4addr;
@@ -45,6 +50,7 @@ struct ip64_addrmap_entry {
   uint16_t ip4port;
   uint8_t protocol;
   uint8_t flags;
+  uint8_t wheel_slot;
 };
 
 #define FLAGS_NONE       0
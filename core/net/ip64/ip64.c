@@ -295,6 +295,44 @@ chksum(uint16_t sum, const uint8_t *data, uint16_t len)
   return sum;
 }
 /*---------------------------------------------------------------------------*/
+/* Subtracts the 16-bit words of data (len is even) from sum, by adding
+   their ones' complement. */
+static uint16_t
+chksum_sub(uint16_t sum, const uint8_t *data, uint16_t len)
+{
+  uint16_t t;
+
+  for(; len >= 2; data += 2, len -= 2) {
+    t = ~((data[0] << 8) + data[1]);
+    sum += t;
+    if(sum < t) {
+      sum++;		/* carry */
+    }
+  }
+  return sum;
+}
+/*---------------------------------------------------------------------------*/
+/* Updates a TCP or UDP checksum, as found in a packet, for new
+   pseudoheader addresses and new ports (RFC 1624), instead of summing
+   the whole payload again. The other pseudoheader fields, length and
+   protocol, are the same in IPv4 and IPv6. */
+static uint16_t
+transport_checksum_update(uint16_t chksum_field,
+                          const uint8_t *oldaddrs, uint16_t oldaddrslen,
+                          const uint8_t *oldports,
+                          const uint8_t *newaddrs, uint16_t newaddrslen,
+                          const uint8_t *newports)
+{
+  uint16_t sum;
+
+  sum = ~uip_ntohs(chksum_field);
+  sum = chksum_sub(sum, oldaddrs, oldaddrslen);
+  sum = chksum_sub(sum, oldports, 4);
+  sum = chksum(sum, newaddrs, newaddrslen);
+  sum = chksum(sum, newports, 4);
+  return uip_htons((uint16_t)~sum);
+}
+/*---------------------------------------------------------------------------*/
 static uint16_t
 ipv4_checksum(struct ipv4_hdr *hdr)
 {
@@ -421,26 +459,26 @@ ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
     PRINTF("ip64_6to4: TCP header\n");
     v4hdr->proto = IP_PROTO_TCP;
 
-    /* Compute and check the TCP checksum - since we're going to
-       recompute it ourselves, we must ensure that it was correct in
-       the first place. */
+#if DEBUG
+    /* The checksum is updated for the new addresses and ports only,
+       so a bad checksum stays bad. */
     if(ipv6_transport_checksum(ipv6packet, ipv6len,
                                IP_PROTO_TCP) != 0xffff) {
-      PRINTF("Bad TCP checksum, dropping packet\n");
+      PRINTF("Bad TCP checksum\n");
     }
+#endif /* DEBUG */
 
     break;
 
   case IP_PROTO_UDP:
     PRINTF("ip64_6to4: UDP header\n");
     v4hdr->proto = IP_PROTO_UDP;
-    /* Compute and check the UDP checksum - since we're going to
-       recompute it ourselves, we must ensure that it was correct in
-       the first place. */
+#if DEBUG
     if(ipv6_transport_checksum(ipv6packet, ipv6len,
                                IP_PROTO_UDP) != 0xffff) {
-      PRINTF("Bad UDP checksum, dropping packet\n");
+      PRINTF("Bad UDP checksum\n");
     }
+#endif /* DEBUG */
     break;
 
   case IP_PROTO_ICMPV6:
@@ -597,14 +635,24 @@ ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
      field. */
   switch(v4hdr->proto) {
   case IP_PROTO_TCP:
-    tcphdr->tcpchksum = 0;
-    tcphdr->tcpchksum = ~(ipv4_transport_checksum(resultpacket, ipv4len,
-						  IP_PROTO_TCP));
+    tcphdr->tcpchksum =
+      transport_checksum_update(tcphdr->tcpchksum,
+                                (uint8_t *)&v6hdr->srcipaddr,
+                                2 * sizeof(uip_ip6addr_t),
+                                &ipv6packet[IPV6_HDRLEN],
+                                (uint8_t *)&v4hdr->srcipaddr,
+                                2 * sizeof(uip_ip4addr_t),
+                                (uint8_t *)tcphdr);
     break;
   case IP_PROTO_UDP:
-    udphdr->udpchksum = 0;
-    udphdr->udpchksum = ~(ipv4_transport_checksum(resultpacket, ipv4len,
-						  IP_PROTO_UDP));
+    udphdr->udpchksum =
+      transport_checksum_update(udphdr->udpchksum,
+                                (uint8_t *)&v6hdr->srcipaddr,
+                                2 * sizeof(uip_ip6addr_t),
+                                &ipv6packet[IPV6_HDRLEN],
+                                (uint8_t *)&v4hdr->srcipaddr,
+                                2 * sizeof(uip_ip4addr_t),
+                                (uint8_t *)udphdr);
     if(udphdr->udpchksum == 0) {
       udphdr->udpchksum = 0xffff;
     }
@@ -817,16 +865,31 @@ ip64_4to6(const uint8_t *ipv4packet, const uint16_t ipv4packet_len,
      field. */
   switch(v6hdr->nxthdr) {
   case IP_PROTO_TCP:
-    tcphdr->tcpchksum = 0;
-    tcphdr->tcpchksum = ~(ipv6_transport_checksum(resultpacket,
-						  ipv6len,
-						  IP_PROTO_TCP));
+    tcphdr->tcpchksum =
+      transport_checksum_update(tcphdr->tcpchksum,
+                                (uint8_t *)&v4hdr->srcipaddr,
+                                2 * sizeof(uip_ip4addr_t),
+                                &ipv4packet[IPV4_HDRLEN],
+                                (uint8_t *)&v6hdr->srcipaddr,
+                                2 * sizeof(uip_ip6addr_t),
+                                (uint8_t *)tcphdr);
     break;
   case IP_PROTO_UDP:
-    udphdr->udpchksum = 0;
-    udphdr->udpchksum = ~(ipv6_transport_checksum(resultpacket,
-						  ipv6len,
-						  IP_PROTO_UDP));
+    if(udphdr->udpchksum != 0) {
+      udphdr->udpchksum =
+        transport_checksum_update(udphdr->udpchksum,
+                                  (uint8_t *)&v4hdr->srcipaddr,
+                                  2 * sizeof(uip_ip4addr_t),
+                                  &ipv4packet[IPV4_HDRLEN],
+                                  (uint8_t *)&v6hdr->srcipaddr,
+                                  2 * sizeof(uip_ip6addr_t),
+                                  (uint8_t *)udphdr);
+    } else {
+      /* No IPv4 checksum to update, but one is mandatory in IPv6 */
+      udphdr->udpchksum = ~(ipv6_transport_checksum(resultpacket,
+                                                    ipv6len,
+                                                    IP_PROTO_UDP));
+    }
     if(udphdr->udpchksum == 0) {
       udphdr->udpchksum = 0xffff;
     }
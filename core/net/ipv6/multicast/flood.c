@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/**
+ * \file
+ *         Controlled flooding multicast engine, see flood.h
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "net/ipv6/multicast/uip-mcast6.h"
+#include "net/ipv6/multicast/uip-mcast6-stats.h"
+#include "net/rpl/rpl.h"
+#include "net/ipv6/multicast/flood.h"
+#include "lib/random.h"
+#include <string.h>
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+/*---------------------------------------------------------------------------*/
+/* uIPv6 Pointers */
+/*---------------------------------------------------------------------------*/
+#define UIP_IP_BUF        ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+/* The sequence number is the low 16 bits of the flow label */
+#define FLOOD_SEQNO()     UIP_HTONS(UIP_IP_BUF->flow)
+/* Sequence numbers older than the last one we keep track of */
+#define FLOOD_WINDOW      32
+/*---------------------------------------------------------------------------*/
+/* Internal Data */
+/*---------------------------------------------------------------------------*/
+/* Per-seed window: last sequence number and a bitmap of the previous ones,
+ * bit n set if last - n was seen */
+static struct seed {
+  uip_ipaddr_t addr;
+  uint16_t last;
+  uint32_t seen;
+} seeds[FLOOD_SEEDS];
+static uint8_t next_seed;
+
+static uint16_t seqno;
+static struct ctimer mcast_periodic;
+static uint16_t mcast_len;
+static uip_buf_t mcast_buf;
+/*---------------------------------------------------------------------------*/
+/* Record sequence number seq from seed src. Returns 1 if it
+ * is new, 0 if it is a duplicate */
+static int
+seen_update(const uip_ipaddr_t *src, uint16_t seq)
+{
+  struct seed *s;
+  int16_t diff;
+
+  for(s = seeds; s < &seeds[FLOOD_SEEDS]; s++) {
+    if(s->seen != 0 && uip_ipaddr_cmp(&s->addr, src)) {
+      break;
+    }
+  }
+  if(s == &seeds[FLOOD_SEEDS]) {
+    /* New seed: replace the oldest one */
+    s = &seeds[next_seed];
+    next_seed = (next_seed + 1) % FLOOD_SEEDS;
+    uip_ipaddr_copy(&s->addr, src);
+    s->last = seq;
+    s->seen = 1;
+    return 1;
+  }
+
+  diff = (int16_t)(seq - s->last);
+  if(diff > 0) {
+    s->seen = diff < FLOOD_WINDOW ? (s->seen << diff) | 1 : 1;
+    s->last = seq;
+    return 1;
+  }
+  if(-diff >= FLOOD_WINDOW) {
+    /* Far behind the window: the seed rebooted, start over */
+    s->last = seq;
+    s->seen = 1;
+    return 1;
+  }
+  if(s->seen & ((uint32_t)1 << -diff)) {
+    return 0;
+  }
+  s->seen |= (uint32_t)1 << -diff;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Relay only datagrams flowing down the DODAG, and only if we have
+ * children to relay them to */
+static int
+should_relay(void)
+{
+  rpl_dag_t *d;
+  rpl_rank_t sender_rank;
+
+  d = rpl_get_any_dag();
+  if(d == NULL || UIP_IP_BUF->ttl <= 1) {
+    return 0;
+  }
+  if(!FLOOD_RELAY_LEAVES && uip_ds6_route_head() == NULL) {
+    return 0;
+  }
+  sender_rank = rpl_get_parent_rank((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
+  return sender_rank != 0 && sender_rank < d->rank;
+}
+/*---------------------------------------------------------------------------*/
+static void
+mcast_fwd(void *p)
+{
+  if(UIP_MCAST6_FWD_BACKLOG() >= UIP_MCAST6_MAX_BACKLOG) {
+    /* The MAC is busy with earlier broadcasts: try again later */
+    ctimer_set(&mcast_periodic, 1 + FLOOD_MAX_FWD_DELAY / 4, mcast_fwd, NULL);
+    return;
+  }
+  memcpy(uip_buf, &mcast_buf, mcast_len);
+  uip_len = mcast_len;
+  UIP_IP_BUF->ttl--;
+  tcpip_output(NULL);
+  uip_len = 0;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+in()
+{
+  UIP_MCAST6_STATS_ADD(mcast_in_all);
+
+  if(!seen_update(&UIP_IP_BUF->srcipaddr, FLOOD_SEQNO())) {
+    PRINTF("FLOOD: duplicate %u\n", FLOOD_SEQNO());
+    UIP_MCAST6_STATS_ADD(mcast_dropped);
+    return UIP_MCAST6_DROP;
+  }
+  UIP_MCAST6_STATS_ADD(mcast_in_unique);
+
+  if(should_relay()) {
+    UIP_MCAST6_STATS_ADD(mcast_fwd);
+    if(ctimer_expired(&mcast_periodic)) {
+      memcpy(&mcast_buf, uip_buf, uip_len);
+      mcast_len = uip_len;
+      ctimer_set(&mcast_periodic, random_rand() % (FLOOD_MAX_FWD_DELAY + 1),
+                 mcast_fwd, NULL);
+    } else {
+      /* The buffer is taken, relay this one right away */
+      UIP_IP_BUF->ttl--;
+      tcpip_output(NULL);
+      UIP_IP_BUF->ttl++;        /* Restore before potential upstack delivery */
+    }
+    PRINTF("FLOOD: %u bytes: fwd %u\n", uip_len, FLOOD_SEQNO());
+  }
+
+  if(!uip_ds6_is_my_maddr(&UIP_IP_BUF->destipaddr)) {
+    return UIP_MCAST6_DROP;
+  } else {
+    UIP_MCAST6_STATS_ADD(mcast_in_ours);
+    return UIP_MCAST6_ACCEPT;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+init()
+{
+  UIP_MCAST6_STATS_INIT(NULL);
+
+  /* Start at a random number, so that a rebooted seed is not taken for
+   * a duplicate */
+  seqno = random_rand();
+}
+/*---------------------------------------------------------------------------*/
+static void
+out()
+{
+  if(uip_len == 0) {
+    return;
+  }
+  seqno++;
+  UIP_IP_BUF->flow = UIP_HTONS(seqno);
+  /* So that we do not relay our own datagrams */
+  seen_update(&UIP_IP_BUF->srcipaddr, seqno);
+  UIP_MCAST6_STATS_ADD(mcast_out);
+}
+/*---------------------------------------------------------------------------*/
+const struct uip_mcast6_driver flood_driver = {
+  "FLOOD",
+  init,
+  out,
+  in,
+};
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/**
+ * \file
+ *         Header file for the controlled flooding multicast engine
+ *
+ *         The seed numbers its datagrams in the IPv6 flow label. Every node
+ *         keeps a window of the sequence numbers seen from each seed and
+ *         relays a datagram once, if it came from a neighbor of lower rank
+ *         and we have children in the DODAG. Datagrams flow down the DODAG
+ *         only: a seed reaches its sub-DODAG, so seeds are normally the root.
+ */
+
+#ifndef FLOOD_H_
+#define FLOOD_H_
+
+#include "contiki-conf.h"
+
+#include <stdint.h>
+/*---------------------------------------------------------------------------*/
+/* Configuration */
+/*---------------------------------------------------------------------------*/
+/* Number of seeds we keep a window for */
+#ifdef FLOOD_CONF_SEEDS
+#define FLOOD_SEEDS FLOOD_CONF_SEEDS
+#else
+#define FLOOD_SEEDS 4
+#endif
+
+/* Maximum random delay before relaying, to spread out siblings' relays */
+#ifdef FLOOD_CONF_MAX_FWD_DELAY
+#define FLOOD_MAX_FWD_DELAY FLOOD_CONF_MAX_FWD_DELAY
+#else
+#define FLOOD_MAX_FWD_DELAY (CLOCK_SECOND / 8)
+#endif
+
+/* Relay even when we have no downward routes. Needed in MOPs without
+ * children information in the routing table (non-storing or no downward
+ * routes), where every node relays */
+#ifdef FLOOD_CONF_RELAY_LEAVES
+#define FLOOD_RELAY_LEAVES FLOOD_CONF_RELAY_LEAVES
+#else
+#define FLOOD_RELAY_LEAVES (!RPL_WITH_STORING)
+#endif
+
+#endif /* FLOOD_H_ */
@@ -624,7 +624,9 @@ handle_timer(void *ptr)
         /* Handle multicast transmissions */
         if(locmpptr->active < TRICKLE_ACTIVE(param) &&
            ((SUPPRESSION_ENABLED(param) && MCAST_PACKET_MUST_SEND(locmpptr)) ||
-           SUPPRESSION_DISABLED(param))) {
+           SUPPRESSION_DISABLED(param)) &&
+           /* Rate-limit to the MAC: keep it for the next pass */
+           UIP_MCAST6_FWD_BACKLOG() < UIP_MCAST6_MAX_BACKLOG) {
           PRINTF("ROLL TM: M=%u Periodic - Sending packet from Seed ", m);
           PRINT_SEED(&locmpptr->sw->seed_id);
           PRINTF(" seq %u\n", locmpptr->seq_val);
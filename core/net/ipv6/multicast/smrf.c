@@ -55,8 +55,13 @@
 /*---------------------------------------------------------------------------*/
 /* Macros */
 /*---------------------------------------------------------------------------*/
+#ifdef UIP_MCAST6_CALLBACK_FWD_DELAY
+/* Next broadcast opportunity of the MAC */
+#define SMRF_FWD_DELAY()  mac_fwd_delay()
+#else
 /* CCI */
 #define SMRF_FWD_DELAY()  NETSTACK_RDC.channel_check_interval()
+#endif
 /* Number of slots in the next 500ms */
 #define SMRF_INTERVAL_COUNT  ((CLOCK_SECOND >> 2) / fwd_delay)
 /*---------------------------------------------------------------------------*/
@@ -72,9 +77,24 @@ static uint8_t fwd_spread;
 /*---------------------------------------------------------------------------*/
 #define UIP_IP_BUF        ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
 /*---------------------------------------------------------------------------*/
+#ifdef UIP_MCAST6_CALLBACK_FWD_DELAY
+static uint8_t
+mac_fwd_delay(void)
+{
+  clock_time_t delay = UIP_MCAST6_CALLBACK_FWD_DELAY();
+  return delay > 0xff ? 0xff : delay;
+}
+#endif /* UIP_MCAST6_CALLBACK_FWD_DELAY */
+/*---------------------------------------------------------------------------*/
 static void
 mcast_fwd(void *p)
 {
+  if(UIP_MCAST6_FWD_BACKLOG() >= UIP_MCAST6_MAX_BACKLOG) {
+    /* The MAC is busy with earlier broadcasts: try again when it is done */
+    fwd_delay = SMRF_FWD_DELAY();
+    ctimer_set(&mcast_periodic, fwd_delay > 0 ? fwd_delay : 1, mcast_fwd, NULL);
+    return;
+  }
   memcpy(uip_buf, &mcast_buf, mcast_len);
   uip_len = mcast_len;
   UIP_IP_BUF->ttl--;
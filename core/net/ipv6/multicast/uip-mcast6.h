@@ -79,6 +79,35 @@
 #define UIP_MCAST6_ENGINE UIP_MCAST6_ENGINE_NONE
 #endif
 /*---------------------------------------------------------------------------*/
+/*
+ * Optional MAC feedback for the engines' forwarding.
+ * UIP_MCAST6_CALLBACK_FWD_BACKLOG can name a function returning the number
+ * of broadcast frames waiting in the MAC queue, UIP_MCAST6_CALLBACK_FWD_DELAY
+ * one returning the time until a new broadcast frame would be sent. With
+ * TSCH, set them to tsch_queue_broadcast_backlog and
+ * tsch_queue_broadcast_delay.
+ */
+#ifdef UIP_MCAST6_CALLBACK_FWD_BACKLOG
+int UIP_MCAST6_CALLBACK_FWD_BACKLOG(void);
+#define UIP_MCAST6_FWD_BACKLOG() UIP_MCAST6_CALLBACK_FWD_BACKLOG()
+#else
+#define UIP_MCAST6_FWD_BACKLOG() 0
+#endif
+
+#ifdef UIP_MCAST6_CALLBACK_FWD_DELAY
+clock_time_t UIP_MCAST6_CALLBACK_FWD_DELAY(void);
+#endif
+
+/*
+ * Forwarding waits rather than queuing a multicast frame behind that many
+ * broadcast frames. Retransmissions are skipped: a copy is still queued
+ */
+#ifdef UIP_MCAST6_CONF_MAX_BACKLOG
+#define UIP_MCAST6_MAX_BACKLOG UIP_MCAST6_CONF_MAX_BACKLOG
+#else
+#define UIP_MCAST6_MAX_BACKLOG 2
+#endif
+/*---------------------------------------------------------------------------*/
 /*
  * Multicast API. Similar to NETSTACK, each engine must define a driver and
  * populate the fields with suitable function pointers
@@ -143,6 +172,10 @@ struct uip_mcast6_driver {
 #define RPL_CONF_MULTICAST     1
 
 #define UIP_MCAST6             smrf_driver
+#elif UIP_MCAST6_ENGINE == UIP_MCAST6_ENGINE_FLOOD
+#define RPL_CONF_MULTICAST     0        /* Floods, no group management */
+
+#define UIP_MCAST6             flood_driver
 #else
 #error "Multicast Enabled with an Unknown Engine."
 #error "Check the value of UIP_MCAST6_CONF_ENGINE in conf files."
@@ -157,6 +190,11 @@ extern const struct uip_mcast6_driver UIP_MCAST6;
 #error "The selected Multicast mode requires UIP_CONF_IPV6_RPL != 0"
 #error "Check the value of UIP_CONF_IPV6_RPL in conf files."
 #endif
+
+#if UIP_MCAST6_ENGINE == UIP_MCAST6_ENGINE_FLOOD && (!UIP_CONF_IPV6_RPL)
+#error "The FLOOD multicast engine relays along the RPL DODAG"
+#error "Check the value of UIP_CONF_IPV6_RPL in conf files."
+#endif
 /*---------------------------------------------------------------------------*/
 
 #endif /* UIP_MCAST6_H_ */
@@ -68,6 +68,11 @@
 #include "net/rime/rime.h"
 #include "net/ipv6/sicslowpan.h"
 #include "net/netstack.h"
+#include "lib/list.h"
+#include "lib/memb.h"
+#if SICSLOWPAN_FRAG_FORWARDING && UIP_CONF_IPV6_RPL
+#include "net/rpl/rpl-private.h"
+#endif
 
 #include <stdio.h>
 
@@ -104,6 +109,12 @@ void uip_log(char *msg);
 #define SICSLOWPAN_MAX_MAC_TRANSMISSIONS 4
 #endif
 
+/* Callback returning the traffic track (PACKETBUF_ATTR_TRACK) of the
+ * packet in uip_buf, for the MAC to schedule tracks apart */
+#ifdef SICSLOWPAN_CALLBACK_PACKET_TRACK
+uint8_t SICSLOWPAN_CALLBACK_PACKET_TRACK(void);
+#endif
+
 #ifndef SICSLOWPAN_COMPRESSION
 #ifdef SICSLOWPAN_CONF_COMPRESSION
 #define SICSLOWPAN_COMPRESSION SICSLOWPAN_CONF_COMPRESSION
@@ -221,43 +232,82 @@ static int last_tx_status;
  *  @{
  */
 
-static uint16_t sicslowpan_len;
-
 /**
- * The buffer used for the 6lowpan reassembly.
- * This buffer contains only the IPv6 packet (no MAC header, 6lowpan, etc).
- * It has a fix size as we do not use dynamic memory allocation.
+ * A datagram being reassembled, identified by the sender, tag and size
+ * of its fragments. SICSLOWPAN_REASS_CONTEXTS of them can be in progress
+ * at the same time.
  */
-static uip_buf_t sicslowpan_aligned_buf;
-#define sicslowpan_buf (sicslowpan_aligned_buf.u8)
+struct sicslowpan_reass {
+  struct sicslowpan_reass *next;
+  /** The source address of the fragments being merged */
+  linkaddr_t sender;
+  /** The tag in the fragments being merged */
+  uint16_t tag;
+  /** The total length of the IPv6 packet in the buffer */
+  uint16_t len;
+  /**
+   * length of the ip packet already received.
+   * It includes IP and transport headers.
+   */
+  uint16_t processed;
+  /** Reassembly %process %timer. */
+  struct timer timer;
+  /**
+   * The buffer used for the 6lowpan reassembly.
+   * This buffer contains only the IPv6 packet (no MAC header, 6lowpan, etc).
+   */
+  uip_buf_t buf;
+};
 
-/** The total length of the IPv6 packet in the sicslowpan_buf. */
+MEMB(reass_memb, struct sicslowpan_reass, SICSLOWPAN_REASS_CONTEXTS);
+LIST(reass_list);
+
+/** The reassembly the incoming fragment belongs to, NULL if not a fragment */
+static struct sicslowpan_reass *reass;
 
 /**
- * length of the ip packet already sent / received.
- * It includes IP and transport headers.
+ * The buffer the incoming packet is uncompressed in: the reassembly buffer
+ * for a fragment, uip_buf otherwise.
  */
-static uint16_t processed_ip_in_len;
+static uint8_t *sicslowpan_buf;
 
 /** Datagram tag to be put in the fragments I send. */
 static uint16_t my_tag;
 
-/** When reassembling, the tag in the fragments being merged. */
-static uint16_t reass_tag;
+#if SICSLOWPAN_FRAG_FORWARDING
+/**
+ * A datagram whose fragments we forward as they arrive: the fragments
+ * from sender with tag go to next_hop with out_tag. A null next_hop
+ * means the datagram is dropped.
+ */
+struct sicslowpan_fwd {
+  struct sicslowpan_fwd *next;
+  linkaddr_t sender;
+  uint16_t tag;
+  uint16_t len;
+  linkaddr_t next_hop;
+  uint16_t out_tag;
+  struct timer timer;
+};
 
-/** When reassembling, the source address of the fragments being merged */
-linkaddr_t frag_sender;
+MEMB(fwd_memb, struct sicslowpan_fwd, SICSLOWPAN_FRAG_FORWARD_ENTRIES);
+LIST(fwd_list);
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
 
-/** Reassembly %process %timer. */
-static struct timer reass_timer;
+struct sicslowpan_reass_stats sicslowpan_reass_stats;
 
 /** @} */
 #else /* SICSLOWPAN_CONF_FRAG */
 /** The buffer used for the 6lowpan processing is uip_buf.
     We do not use any additional buffer.*/
 #define sicslowpan_buf uip_buf
-#define sicslowpan_len uip_len
 #endif /* SICSLOWPAN_CONF_FRAG */
+/** The length of a non-fragmented packet, uncompressed in uip_buf */
+#define sicslowpan_len uip_len
+
+#if SICSLOWPAN_OUTPUT_REFERENCE
+struct sicslowpan_output_stats sicslowpan_output_stats;
+#endif /* SICSLOWPAN_OUTPUT_REFERENCE */
 
 static int last_rssi;
 
@@ -325,9 +375,23 @@ addr_contexts[SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS];
 /** pointer to an address context. */
 static struct sicslowpan_addr_context *context;
 
+#if SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0
+/** The context last found by prefix: consecutive packets, and the source
+ * and destination of a packet, mostly share it */
+static struct sicslowpan_addr_context *last_context;
+#endif /* SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0 */
+
 /** pointer to the byte where to write next inline field. */
 static uint8_t *hc06_ptr;
 
+#if SICSLOWPAN_UDP_PROFILES
+/** The registered UDP compression profiles */
+static const struct sicslowpan_udp_profile *udp_profiles[SICSLOWPAN_UDP_PROFILES];
+/** Set while the payload of the datagram is not all in uip_buf (fragment
+ * forwarding) and must not be compressed */
+static uint8_t udp_profile_no_payload;
+#endif /* SICSLOWPAN_UDP_PROFILES */
+
 /* Uncompression of linklocal */
 /*   0 -> 16 bytes from packet  */
 /*   1 -> 2 bytes from prefix - bunch of zeroes and 8 from packet */
@@ -368,9 +432,14 @@ addr_context_lookup_by_prefix(uip_ipaddr_t *ipaddr)
 /* Remove code to avoid warnings and save flash if no context is used */
 #if SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0
   int i;
+  if(last_context != NULL &&
+     uip_ipaddr_prefixcmp(&last_context->prefix, ipaddr, 64)) {
+    return last_context;
+  }
   for(i = 0; i < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS; i++) {
-    if((addr_contexts[i].used == 1) &&
+    if((addr_contexts[i].used == SICSLOWPAN_CONTEXT_COMPRESS) &&
        uip_ipaddr_prefixcmp(&addr_contexts[i].prefix, ipaddr, 64)) {
+      last_context = &addr_contexts[i];
       return &addr_contexts[i];
     }
   }
@@ -386,7 +455,7 @@ addr_context_lookup_by_number(uint8_t number)
 #if SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0
   int i;
   for(i = 0; i < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS; i++) {
-    if((addr_contexts[i].used == 1) &&
+    if((addr_contexts[i].used != SICSLOWPAN_CONTEXT_UNUSED) &&
        addr_contexts[i].number == number) {
       return &addr_contexts[i];
     }
@@ -454,7 +523,143 @@ uncompress_addr(uip_ipaddr_t *ipaddr, uint8_t const prefix[],
   PRINT6ADDR(ipaddr);
   PRINTF("\n");
 }
+/*--------------------------------------------------------------------*/
+#if SICSLOWPAN_UDP_PROFILES
+static const struct sicslowpan_udp_profile *
+udp_profile_lookup(uint8_t number)
+{
+  int i;
+  for(i = 0; i < SICSLOWPAN_UDP_PROFILES; i++) {
+    if(udp_profiles[i] != NULL && udp_profiles[i]->number == number) {
+      return udp_profiles[i];
+    }
+  }
+  return NULL;
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Compress the UDP header of uip_buf, and its payload if the
+ * profile can, with the first matching profile
+ * \return 1 if a profile was used, 0 to fall back to LOWPAN_UDP
+ */
+static int
+compress_udp_profile(void)
+{
+  const struct sicslowpan_udp_profile *p;
+  uint16_t srcport = UIP_HTONS(UIP_UDP_BUF->srcport);
+  uint16_t destport = UIP_HTONS(UIP_UDP_BUF->destport);
+  uint8_t *payload = (uint8_t *)UIP_UDP_BUF + UIP_UDPH_LEN;
+  uint16_t payload_len = uip_len - UIP_IPUDPH_LEN;
+  uint8_t *ptr;
+  uint8_t nhc;
+  int i, len;
+
+  for(i = 0; i < SICSLOWPAN_UDP_PROFILES; i++) {
+    p = udp_profiles[i];
+    if(p == NULL) {
+      continue;
+    }
+    nhc = SICSLOWPAN_NHC_UDP_PROFILE_ID;
+    if(p->port != 0 && srcport == p->port) {
+      nhc |= SICSLOWPAN_NHC_UDP_PROFILE_S;
+    }
+    if(p->port != 0 && destport == p->port) {
+      nhc |= SICSLOWPAN_NHC_UDP_PROFILE_D;
+    }
+    if(p->port != 0 && (nhc & (SICSLOWPAN_NHC_UDP_PROFILE_S | SICSLOWPAN_NHC_UDP_PROFILE_D)) == 0) {
+      continue;
+    }
+
+    ptr = hc06_ptr + 2;
+    if(!(nhc & SICSLOWPAN_NHC_UDP_PROFILE_S)) {
+      memcpy(ptr, &UIP_UDP_BUF->srcport, 2);
+      ptr += 2;
+    }
+    if(!(nhc & SICSLOWPAN_NHC_UDP_PROFILE_D)) {
+      memcpy(ptr, &UIP_UDP_BUF->destport, 2);
+      ptr += 2;
+    }
+    memcpy(ptr, &UIP_UDP_BUF->udpchksum, 2);
+    ptr += 2;
+
+    /* The payload goes in the compressed header, only if the whole
+     * datagram fits in a frame */
+    len = -1;
+    if(p->compress != NULL && !udp_profile_no_payload &&
+       payload_len <= SICSLOWPAN_UDP_PROFILE_MAX_PAYLOAD) {
+      len = p->compress(ptr, payload, payload_len);
+    }
+    if(len >= 0) {
+      nhc |= SICSLOWPAN_NHC_UDP_PROFILE_P;
+      ptr += len;
+    } else if(p->port == 0) {
+      continue;
+    }
+
+    PRINTF("IPHC: UDP profile %u, nhc %x\n", p->number, nhc);
+    hc06_ptr[0] = nhc;
+    hc06_ptr[1] = p->number;
+    hc06_ptr = ptr;
+    uncomp_hdr_len += UIP_UDPH_LEN;
+    if(nhc & SICSLOWPAN_NHC_UDP_PROFILE_P) {
+      uncomp_hdr_len += payload_len;
+    }
+    return 1;
+  }
+  return 0;
+}
+/*--------------------------------------------------------------------*/
+/** \brief Uncompress a UDP header, and its payload if compressed, that
+ * was compressed with a profile */
+static void
+uncompress_udp_profile(void)
+{
+  const struct sicslowpan_udp_profile *p;
+  uint8_t nhc = hc06_ptr[0];
+  int len;
+
+  p = udp_profile_lookup(hc06_ptr[1]);
+  if(p == NULL) {
+    PRINTF("sicslowpan uncompress_hdr: error unknown UDP profile %u\n", hc06_ptr[1]);
+    return;
+  }
+  hc06_ptr += 2;
 
+  SICSLOWPAN_IP_BUF->proto = UIP_PROTO_UDP;
+  if(nhc & SICSLOWPAN_NHC_UDP_PROFILE_S) {
+    SICSLOWPAN_UDP_BUF->srcport = UIP_HTONS(p->port);
+  } else {
+    memcpy(&SICSLOWPAN_UDP_BUF->srcport, hc06_ptr, 2);
+    hc06_ptr += 2;
+  }
+  if(nhc & SICSLOWPAN_NHC_UDP_PROFILE_D) {
+    SICSLOWPAN_UDP_BUF->destport = UIP_HTONS(p->port);
+  } else {
+    memcpy(&SICSLOWPAN_UDP_BUF->destport, hc06_ptr, 2);
+    hc06_ptr += 2;
+  }
+  memcpy(&SICSLOWPAN_UDP_BUF->udpchksum, hc06_ptr, 2);
+  hc06_ptr += 2;
+  uncomp_hdr_len += UIP_UDPH_LEN;
+
+  if(nhc & SICSLOWPAN_NHC_UDP_PROFILE_P) {
+    /* The rest of the frame is the compressed payload */
+    len = packetbuf_datalen() - (hc06_ptr - packetbuf_ptr);
+    if(p->uncompress == NULL || len < 0) {
+      PRINTF("sicslowpan uncompress_hdr: error bad UDP profile payload\n");
+      return;
+    }
+    len = p->uncompress((uint8_t *)SICSLOWPAN_UDP_BUF + UIP_UDPH_LEN,
+                        hc06_ptr, len, SICSLOWPAN_UDP_PROFILE_MAX_PAYLOAD);
+    if(len < 0) {
+      PRINTF("sicslowpan uncompress_hdr: error bad UDP profile payload\n");
+      return;
+    }
+    hc06_ptr = packetbuf_ptr + packetbuf_datalen();
+    uncomp_hdr_len += len;
+  }
+}
+#endif /* SICSLOWPAN_UDP_PROFILES */
 /*--------------------------------------------------------------------*/
 /**
  * \brief Compress IP/UDP header
@@ -704,8 +909,12 @@ compress_hdr_hc06(linkaddr_t *link_destaddr)
   uncomp_hdr_len = UIP_IPH_LEN;
 
 #if UIP_CONF_UDP || UIP_CONF_ROUTER
-  /* UDP header compression */
-  if(UIP_IP_BUF->proto == UIP_PROTO_UDP) {
+  /* UDP header compression, with a profile if one matches */
+  if(UIP_IP_BUF->proto == UIP_PROTO_UDP
+#if SICSLOWPAN_UDP_PROFILES
+     && !compress_udp_profile()
+#endif /* SICSLOWPAN_UDP_PROFILES */
+     ) {
     PRINTF("IPHC: Uncompressed UDP ports on send side: %x, %x\n",
 	   UIP_HTONS(UIP_UDP_BUF->srcport), UIP_HTONS(UIP_UDP_BUF->destport));
     /* Mask out the last 4 bits can be used as a mask */
@@ -993,6 +1202,11 @@ uncompress_hdr_hc06(uint16_t ip_len)
       }
       uncomp_hdr_len += UIP_UDPH_LEN;
     }
+#if SICSLOWPAN_UDP_PROFILES
+    else if((*hc06_ptr & SICSLOWPAN_NHC_UDP_PROFILE_MASK) == SICSLOWPAN_NHC_UDP_PROFILE_ID) {
+      uncompress_udp_profile();
+    }
+#endif /* SICSLOWPAN_UDP_PROFILES */
 #ifdef SICSLOWPAN_NH_COMPRESSOR
     else {
       hc06_ptr += SICSLOWPAN_NH_COMPRESSOR.uncompress(hc06_ptr, sicslowpan_buf, &uncomp_hdr_len);
@@ -1363,6 +1577,49 @@ send_packet(linkaddr_t *dest)
   watchdog_periodic();
 }
 /*--------------------------------------------------------------------*/
+/** \brief Compress the headers of the IP packet in uip_buf to packetbuf */
+static void
+compress_hdr(linkaddr_t *dest)
+{
+  if(uip_len >= COMPRESSION_THRESHOLD) {
+    /* Try to compress the headers */
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC1
+    compress_hdr_hc1(dest);
+#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC1 */
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_IPV6
+    compress_hdr_ipv6(dest);
+#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_IPV6 */
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06
+    compress_hdr_hc06(dest);
+#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 */
+  } else {
+    compress_hdr_ipv6(dest);
+  }
+}
+/*--------------------------------------------------------------------*/
+/** \brief The room left for 6lowpan headers and payload in a frame to dest */
+static int
+get_max_payload(linkaddr_t *dest)
+{
+  int framer_hdrlen;
+
+  /* Calculate NETSTACK_FRAMER's header length, that will be added in the NETSTACK_RDC.
+   * We calculate it here only to make a better decision of whether the outgoing packet
+   * needs to be fragmented or not. */
+#define USE_FRAMER_HDRLEN 1
+#if USE_FRAMER_HDRLEN
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, dest);
+  framer_hdrlen = NETSTACK_FRAMER.length();
+  if(framer_hdrlen < 0) {
+    /* Framing failed, we assume the maximum header length */
+    framer_hdrlen = 21;
+  }
+#else /* USE_FRAMER_HDRLEN */
+  framer_hdrlen = 21;
+#endif /* USE_FRAMER_HDRLEN */
+  return MAC_MAX_PAYLOAD - framer_hdrlen - NETSTACK_LLSEC.get_overhead();
+}
+/*--------------------------------------------------------------------*/
 /** \brief Take an IP packet and format it to be sent on an 802.15.4
  *  network using 6lowpan.
  *  \param localdest The MAC address of the destination
@@ -1375,7 +1632,6 @@ send_packet(linkaddr_t *dest)
 static uint8_t
 output(const uip_lladdr_t *localdest)
 {
-  int framer_hdrlen;
   int max_payload;
 
   /* The MAC address of the destination of the packet */
@@ -1403,6 +1659,10 @@ output(const uip_lladdr_t *localdest)
     set_packet_attrs();
   }
 
+#if defined(SICSLOWPAN_CALLBACK_PACKET_TRACK) && !defined(WITHOUT_ATTR_TRACK)
+  packetbuf_set_attr(PACKETBUF_ATTR_TRACK, SICSLOWPAN_CALLBACK_PACKET_TRACK());
+#endif
+
 #define TCP_FIN 0x01
 #define TCP_ACK 0x10
 #define TCP_CTL 0x3f
@@ -1434,37 +1694,10 @@ output(const uip_lladdr_t *localdest)
   
   PRINTFO("sicslowpan output: sending packet len %d\n", uip_len);
 
-  if(uip_len >= COMPRESSION_THRESHOLD) {
-    /* Try to compress the headers */
-#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC1
-    compress_hdr_hc1(&dest);
-#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC1 */
-#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_IPV6
-    compress_hdr_ipv6(&dest);
-#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_IPV6 */
-#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06
-    compress_hdr_hc06(&dest);
-#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 */
-  } else {
-    compress_hdr_ipv6(&dest);
-  }
+  compress_hdr(&dest);
   PRINTFO("sicslowpan output: header of len %d\n", packetbuf_hdr_len);
 
-  /* Calculate NETSTACK_FRAMER's header length, that will be added in the NETSTACK_RDC.
-   * We calculate it here only to make a better decision of whether the outgoing packet
-   * needs to be fragmented or not. */
-#define USE_FRAMER_HDRLEN 1
-#if USE_FRAMER_HDRLEN
-  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &dest);
-  framer_hdrlen = NETSTACK_FRAMER.length();
-  if(framer_hdrlen < 0) {
-    /* Framing failed, we assume the maximum header length */
-    framer_hdrlen = 21;
-  }
-#else /* USE_FRAMER_HDRLEN */
-  framer_hdrlen = 21;
-#endif /* USE_FRAMER_HDRLEN */
-  max_payload = MAC_MAX_PAYLOAD - framer_hdrlen - NETSTACK_LLSEC.get_overhead();
+  max_payload = get_max_payload(&dest);
 
   if((int)uip_len - (int)uncomp_hdr_len > max_payload - (int)packetbuf_hdr_len) {
 #if SICSLOWPAN_CONF_FRAG
@@ -1586,14 +1819,301 @@ output(const uip_lladdr_t *localdest)
      * The packet does not need to be fragmented
      * copy "payload" and send
      */
+#if SICSLOWPAN_OUTPUT_REFERENCE
+    /* Move the header to the header area and reference the payload in
+       uip_buf, the MAC layer copies both into its queue */
+    if(packetbuf_hdralloc(packetbuf_hdr_len)) {
+      memcpy(packetbuf_hdrptr(), packetbuf_ptr, packetbuf_hdr_len);
+      packetbuf_reference_volatile((uint8_t *)UIP_IP_BUF + uncomp_hdr_len,
+                                   uip_len - uncomp_hdr_len);
+      sicslowpan_output_stats.referenced++;
+    } else {
+      memcpy(packetbuf_ptr + packetbuf_hdr_len, (uint8_t *)UIP_IP_BUF + uncomp_hdr_len,
+             uip_len - uncomp_hdr_len);
+      packetbuf_set_datalen(uip_len - uncomp_hdr_len + packetbuf_hdr_len);
+      sicslowpan_output_stats.copied++;
+    }
+#else /* SICSLOWPAN_OUTPUT_REFERENCE */
     memcpy(packetbuf_ptr + packetbuf_hdr_len, (uint8_t *)UIP_IP_BUF + uncomp_hdr_len,
            uip_len - uncomp_hdr_len);
     packetbuf_set_datalen(uip_len - uncomp_hdr_len + packetbuf_hdr_len);
+#endif /* SICSLOWPAN_OUTPUT_REFERENCE */
     send_packet(&dest);
   }
   return 1;
 }
 
+#if SICSLOWPAN_CONF_FRAG
+/*--------------------------------------------------------------------*/
+/** \brief Cancel the reassemblies that timed out */
+static void
+reass_purge(void)
+{
+  struct sicslowpan_reass *r, *next;
+
+  for(r = list_head(reass_list); r != NULL; r = next) {
+    next = list_item_next(r);
+    if(timer_expired(&r->timer)) {
+      PRINTFI("sicslowpan input: reassembly timed out (tag %d)\n", r->tag);
+      sicslowpan_reass_stats.timeouts++;
+      list_remove(reass_list, r);
+      memb_free(&reass_memb, r);
+    }
+  }
+}
+/*--------------------------------------------------------------------*/
+/** \brief Find the reassembly a fragment belongs to */
+static struct sicslowpan_reass *
+reass_lookup(const linkaddr_t *sender, uint16_t tag, uint16_t len)
+{
+  struct sicslowpan_reass *r;
+
+  for(r = list_head(reass_list); r != NULL; r = list_item_next(r)) {
+    if(r->tag == tag && r->len == len && linkaddr_cmp(&r->sender, sender)) {
+      return r;
+    }
+  }
+  return NULL;
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Start a reassembly. When all contexts are in use, the oldest
+ * reassembly is discarded: this lessens the negative impacts of too high
+ * SICSLOWPAN_REASS_MAXAGE.
+ */
+static struct sicslowpan_reass *
+reass_start(const linkaddr_t *sender, uint16_t tag, uint16_t len)
+{
+  struct sicslowpan_reass *r;
+
+  r = memb_alloc(&reass_memb);
+  if(r == NULL) {
+    /* New reassemblies are pushed at the head, the oldest is the tail */
+    r = list_chop(reass_list);
+    PRINTFI("sicslowpan input: discarding reassembly (tag %d)\n", r->tag);
+    sicslowpan_reass_stats.evicted++;
+  }
+  linkaddr_copy(&r->sender, sender);
+  r->tag = tag;
+  r->len = len;
+  r->processed = 0;
+  timer_set(&r->timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND);
+  list_push(reass_list, r);
+  PRINTFI("sicslowpan input: INIT FRAGMENTATION (len %d, tag %d)\n",
+         len, tag);
+  return r;
+}
+#if SICSLOWPAN_FRAG_FORWARDING
+/*--------------------------------------------------------------------*/
+/** \brief Cancel the fragment forwardings that timed out */
+static void
+fwd_purge(void)
+{
+  struct sicslowpan_fwd *f, *next;
+
+  for(f = list_head(fwd_list); f != NULL; f = next) {
+    next = list_item_next(f);
+    if(timer_expired(&f->timer)) {
+      sicslowpan_reass_stats.timeouts++;
+      list_remove(fwd_list, f);
+      memb_free(&fwd_memb, f);
+    }
+  }
+}
+/*--------------------------------------------------------------------*/
+/** \brief Find the fragment forwarding a fragment belongs to */
+static struct sicslowpan_fwd *
+fwd_lookup(const linkaddr_t *sender, uint16_t tag, uint16_t len)
+{
+  struct sicslowpan_fwd *f;
+
+  for(f = list_head(fwd_list); f != NULL; f = list_item_next(f)) {
+    if(f->tag == tag && f->len == len && linkaddr_cmp(&f->sender, sender)) {
+      return f;
+    }
+  }
+  return NULL;
+}
+/*--------------------------------------------------------------------*/
+static void
+fwd_send(linkaddr_t *dest)
+{
+#ifndef WITHOUT_MAC_TX_ATTR
+  packetbuf_set_attr(PACKETBUF_ATTR_MAX_MAC_TRANSMISSIONS,
+                     SICSLOWPAN_MAX_MAC_TRANSMISSIONS);
+#endif /* WITHOUT_MAC_TX_ATTR */
+  send_packet(dest);
+  sicslowpan_reass_stats.forwarded++;
+}
+/*--------------------------------------------------------------------*/
+/** \brief Forward the FRAGN in packetbuf */
+static void
+fwd_fragn(struct sicslowpan_fwd *f, uint8_t frag_offset)
+{
+  int len = packetbuf_datalen();
+
+  if(linkaddr_cmp(&f->next_hop, &linkaddr_null)) {
+    sicslowpan_reass_stats.dropped++;
+  } else {
+    /* Same fragment in a fresh packetbuf, with the tag of the next hop.
+     * uip_buf is not in use while we process an input fragment. */
+    memcpy(uip_buf, packetbuf_dataptr(), len);
+    packetbuf_clear();
+    packetbuf_ptr = packetbuf_dataptr();
+    memcpy(packetbuf_ptr, uip_buf, len);
+    packetbuf_set_datalen(len);
+    SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_TAG, f->out_tag);
+    PRINTFI("sicslowpan input: forwarding fragment (offset %d, tag %d)\n",
+            frag_offset, f->out_tag);
+    fwd_send(&f->next_hop);
+  }
+
+  if(((uint16_t)frag_offset << 3) + len - SICSLOWPAN_FRAGN_HDR_LEN >= f->len) {
+    list_remove(fwd_list, f);
+    memb_free(&fwd_memb, f);
+  }
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Forward the first fragment of a datagram routed through us, whose
+ * header is uncompressed in uip_buf with the fragment's payload after it.
+ * The following fragments are forwarded by fwd_fragn.
+ * \return 0 if the datagram must be reassembled and handed to the IP stack
+ */
+static int
+fwd_frag1(uint16_t frag_size, uint16_t frag_tag)
+{
+  struct sicslowpan_fwd *f;
+  uip_ipaddr_t *nexthop;
+  const uip_lladdr_t *lladdr;
+  int in_len, end, max_payload;
+
+  /* Uncompressed length covered by this fragment */
+  in_len = uncomp_hdr_len + packetbuf_payload_len;
+
+  if(uip_is_addr_mcast(&UIP_IP_BUF->destipaddr) ||
+     uip_is_addr_linklocal(&UIP_IP_BUF->destipaddr) ||
+     uip_ds6_is_my_addr(&UIP_IP_BUF->destipaddr) ||
+     UIP_IP_BUF->ttl <= 1) {
+    return 0;
+  }
+#if UIP_CONF_IPV6_RPL
+  /* The RPL hop-by-hop option must be in this fragment, to be
+   * updated in place. Inserting it or a source routing header would
+   * change the datagram size. */
+  if(RPL_WITH_NON_STORING || UIP_IP_BUF->proto != UIP_PROTO_HBHO ||
+     in_len < UIP_IPH_LEN + RPL_HOP_BY_HOP_LEN) {
+    return 0;
+  }
+#endif /* UIP_CONF_IPV6_RPL */
+
+  /* Next hop determination, see tcpip_ipv6_output. If there is none, the
+   * IP stack handles the datagram. */
+  if(uip_ds6_is_addr_onlink(&UIP_IP_BUF->destipaddr)) {
+    nexthop = &UIP_IP_BUF->destipaddr;
+  } else {
+    uip_ds6_route_t *route = NULL;
+#if UIP_CONF_ROUTER
+    route = uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr);
+#endif /* UIP_CONF_ROUTER */
+    if(route != NULL) {
+      nexthop = uip_ds6_route_nexthop(route);
+    } else {
+      nexthop = uip_ds6_defrt_choose();
+#if UIP_CONF_IPV6_RPL
+      nexthop = rpl_get_upward_nexthop(nexthop);
+#endif /* UIP_CONF_IPV6_RPL */
+    }
+  }
+  lladdr = nexthop != NULL ? uip_ds6_nbr_lladdr_from_ipaddr(nexthop) : NULL;
+  if(lladdr == NULL ||
+     linkaddr_cmp((const linkaddr_t *)lladdr, packetbuf_addr(PACKETBUF_ADDR_SENDER))) {
+    return 0;
+  }
+
+  f = memb_alloc(&fwd_memb);
+  if(f == NULL) {
+    return 0;
+  }
+  linkaddr_copy(&f->sender, packetbuf_addr(PACKETBUF_ADDR_SENDER));
+  f->tag = frag_tag;
+  f->len = frag_size;
+  linkaddr_copy(&f->next_hop, (const linkaddr_t *)lladdr);
+  f->out_tag = my_tag++;
+  timer_set(&f->timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND);
+  list_push(fwd_list, f);
+
+  UIP_IP_BUF->ttl--;
+#if UIP_CONF_IPV6_RPL
+  uip_ext_len = 0;
+  if(rpl_update_header_empty()) {
+    /* Forwarding error: drop the whole datagram */
+    linkaddr_copy(&f->next_hop, &linkaddr_null);
+    sicslowpan_reass_stats.dropped++;
+    return 1;
+  }
+#endif /* UIP_CONF_IPV6_RPL */
+
+  /* Compress the header again for the next hop */
+  uip_len = frag_size;
+  uncomp_hdr_len = 0;
+  packetbuf_hdr_len = 0;
+  packetbuf_clear();
+  packetbuf_ptr = packetbuf_dataptr();
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 && SICSLOWPAN_UDP_PROFILES
+  udp_profile_no_payload = 1;
+  compress_hdr(&f->next_hop);
+  udp_profile_no_payload = 0;
+#else
+  compress_hdr(&f->next_hop);
+#endif
+  max_payload = get_max_payload(&f->next_hop);
+
+  memmove(packetbuf_ptr + SICSLOWPAN_FRAG1_HDR_LEN, packetbuf_ptr, packetbuf_hdr_len);
+  SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_DISPATCH_SIZE,
+        ((SICSLOWPAN_DISPATCH_FRAG1 << 8) | frag_size));
+  SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_TAG, f->out_tag);
+  packetbuf_hdr_len += SICSLOWPAN_FRAG1_HDR_LEN;
+
+  /* The compressed header may have grown (e.g. inline hop limit). The
+   * bytes that no longer fit go in an extra FRAGN. */
+  end = (uncomp_hdr_len + max_payload - packetbuf_hdr_len) & ~7;
+  if(end > in_len) {
+    end = in_len;
+  }
+  if(end <= (int)uncomp_hdr_len) {
+    linkaddr_copy(&f->next_hop, &linkaddr_null);
+    sicslowpan_reass_stats.dropped++;
+    return 1;
+  }
+  memcpy(packetbuf_ptr + packetbuf_hdr_len,
+         (uint8_t *)UIP_IP_BUF + uncomp_hdr_len, end - uncomp_hdr_len);
+  packetbuf_set_datalen(packetbuf_hdr_len + end - uncomp_hdr_len);
+  PRINTFI("sicslowpan input: forwarding first fragment (len %d, tag %d)\n",
+          frag_size, f->out_tag);
+  fwd_send(&f->next_hop);
+
+  if(end < in_len) {
+    packetbuf_clear();
+    packetbuf_ptr = packetbuf_dataptr();
+    SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_DISPATCH_SIZE,
+          ((SICSLOWPAN_DISPATCH_FRAGN << 8) | frag_size));
+    SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_TAG, f->out_tag);
+    PACKETBUF_FRAG_PTR[PACKETBUF_FRAG_OFFSET] = end >> 3;
+    memcpy(packetbuf_ptr + SICSLOWPAN_FRAGN_HDR_LEN,
+           (uint8_t *)UIP_IP_BUF + end, in_len - end);
+    packetbuf_set_datalen(SICSLOWPAN_FRAGN_HDR_LEN + in_len - end);
+    fwd_send(&f->next_hop);
+  }
+
+  if(in_len >= frag_size) {
+    list_remove(fwd_list, f);
+    memb_free(&fwd_memb, f);
+  }
+  return 1;
+}
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
+#endif /* SICSLOWPAN_CONF_FRAG */
 /*--------------------------------------------------------------------*/
 /** \brief Process a received 6lowpan packet.
  *  \param r The MAC layer
@@ -1619,6 +2139,10 @@ input(void)
   /* tag of the fragment */
   uint16_t frag_tag = 0;
   uint8_t first_fragment = 0, last_fragment = 0;
+#if SICSLOWPAN_FRAG_FORWARDING
+  uint8_t fwd_candidate = 0;
+  struct sicslowpan_fwd *fwd;
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
 #endif /*SICSLOWPAN_CONF_FRAG*/
 
   /* init */
@@ -1640,11 +2164,12 @@ input(void)
      want to query us for it later. */
   last_rssi = (signed short)packetbuf_attr(PACKETBUF_ATTR_RSSI);
 #if SICSLOWPAN_CONF_FRAG
-  /* if reassembly timed out, cancel it */
-  if(timer_expired(&reass_timer)) {
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
-  }
+  reass_purge();
+#if SICSLOWPAN_FRAG_FORWARDING
+  fwd_purge();
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
+  reass = NULL;
+  sicslowpan_buf = uip_buf;
   /*
    * Since we don't support the mesh and broadcast header, the first header
    * we look for is the fragmentation header
@@ -1660,7 +2185,6 @@ input(void)
       PRINTFI("size %d, tag %d, offset %d)\n",
              frag_size, frag_tag, frag_offset);
       packetbuf_hdr_len += SICSLOWPAN_FRAG1_HDR_LEN;
-      /*      printf("frag1 %d %d\n", reass_tag, frag_tag);*/
       first_fragment = 1;
       is_fragment = 1;
       break;
@@ -1676,76 +2200,60 @@ input(void)
       PRINTFI("size %d, tag %d, offset %d)\n",
              frag_size, frag_tag, frag_offset);
       packetbuf_hdr_len += SICSLOWPAN_FRAGN_HDR_LEN;
-
-      /* If this is the last fragment, we may shave off any extrenous
-         bytes at the end. We must be liberal in what we accept. */
-      PRINTFI("last_fragment?: processed_ip_in_len %d packetbuf_payload_len %d frag_size %d\n",
-              processed_ip_in_len, packetbuf_datalen() - packetbuf_hdr_len, frag_size);
-
-      if(processed_ip_in_len + packetbuf_datalen() - packetbuf_hdr_len >= frag_size) {
-        last_fragment = 1;
-      }
       is_fragment = 1;
       break;
     default:
       break;
   }
 
-  /* We are currently reassembling a packet, but have just received the first
-   * fragment of another packet. We can either ignore it and hope to receive
-   * the rest of the under-reassembly packet fragments, or we can discard the
-   * previous packet altogether, and start reassembling the new packet.
-   *
-   * We discard the previous packet, and start reassembling the new packet.
-   * This lessens the negative impacts of too high SICSLOWPAN_REASS_MAXAGE.
+  /*
+   * Non-fragmented packets are uncompressed directly in uip_buf and do not
+   * interfere with the reassemblies in progress. A fragment is merged into
+   * the reassembly of its datagram, started by its first fragment.
    */
-#define PRIORITIZE_NEW_PACKETS 1
-#if PRIORITIZE_NEW_PACKETS
-
-  if(!is_fragment) {
-    /* Prioritize non-fragment packets too. */
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
-  } else if(processed_ip_in_len > 0 && first_fragment
-      && !linkaddr_cmp(&frag_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER))) {
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
-  }
-#endif /* PRIORITIZE_NEW_PACKETS */
-
-  if(processed_ip_in_len > 0) {
-    /* reassembly is ongoing */
-    /*    printf("frag %d %d\n", reass_tag, frag_tag);*/
-    if((frag_size > 0 &&
-        (frag_size != sicslowpan_len ||
-         reass_tag  != frag_tag ||
-         !linkaddr_cmp(&frag_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER))))  ||
-       frag_size == 0) {
-      /*
-       * the packet is a fragment that does not belong to the packet
-       * being reassembled or the packet is not a fragment.
-       */
-      PRINTFI("sicslowpan input: Dropping 6lowpan packet that is not a fragment of the packet currently being reassembled\n");
+  if(is_fragment) {
+#if SICSLOWPAN_FRAG_FORWARDING
+    fwd = fwd_lookup(packetbuf_addr(PACKETBUF_ADDR_SENDER), frag_tag, frag_size);
+    if(fwd != NULL) {
+      if(!first_fragment) {
+        fwd_fragn(fwd, frag_offset);
+      }
+      /* else a duplicate of the first fragment, already forwarded */
       return;
     }
-  } else {
-    /*
-     * reassembly is off
-     * start it if we received a fragment
-     */
-    if((frag_size > 0) && (frag_size <= UIP_BUFSIZE)) {
-      /* We are currently not reassembling a packet, but have received a packet fragment
-       * that is not the first one. */
-      if(is_fragment && !first_fragment) {
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
+    reass = reass_lookup(packetbuf_addr(PACKETBUF_ADDR_SENDER), frag_tag, frag_size);
+    if(reass == NULL) {
+      if(!first_fragment || frag_size == 0 || frag_size > UIP_BUFSIZE) {
+        /*
+         * the packet is a fragment of a packet we are not reassembling,
+         * or too large to be reassembled.
+         */
+        PRINTFI("sicslowpan input: Dropping 6lowpan fragment that is not part of a packet being reassembled\n");
+        sicslowpan_reass_stats.dropped++;
         return;
       }
+#if SICSLOWPAN_FRAG_FORWARDING
+      /* Uncompress the header in uip_buf, to decide whether to forward
+       * the datagram right away or to reassemble it */
+      fwd_candidate = 1;
+#else /* SICSLOWPAN_FRAG_FORWARDING */
+      reass = reass_start(packetbuf_addr(PACKETBUF_ADDR_SENDER), frag_tag, frag_size);
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
+    }
+  }
+  if(reass != NULL) {
+    sicslowpan_buf = reass->buf.u8;
+
+    if(!first_fragment) {
+      /* If this is the last fragment, we may shave off any extrenous
+         bytes at the end. We must be liberal in what we accept. */
+      PRINTFI("last_fragment?: processed %d packetbuf_payload_len %d frag_size %d\n",
+              reass->processed, packetbuf_datalen() - packetbuf_hdr_len, frag_size);
 
-      sicslowpan_len = frag_size;
-      reass_tag = frag_tag;
-      timer_set(&reass_timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND);
-      PRINTFI("sicslowpan input: INIT FRAGMENTATION (len %d, tag %d)\n",
-             sicslowpan_len, reass_tag);
-      linkaddr_copy(&frag_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER));
+      if(reass->processed + packetbuf_datalen() - packetbuf_hdr_len >= frag_size) {
+        last_fragment = 1;
+      }
     }
   }
 
@@ -1808,33 +2316,44 @@ input(void)
   {
     int req_size = UIP_LLH_LEN + uncomp_hdr_len + (uint16_t)(frag_offset << 3)
         + packetbuf_payload_len;
-    if(req_size > sizeof(sicslowpan_buf)) {
+    if(req_size > UIP_BUFSIZE) {
       PRINTF(
           "SICSLOWPAN: packet dropped, minimum required SICSLOWPAN_IP_BUF size: %d+%d+%d+%d=%d (current size: %d)\n",
           UIP_LLH_LEN, uncomp_hdr_len, (uint16_t)(frag_offset << 3),
-          packetbuf_payload_len, req_size, sizeof(sicslowpan_buf));
+          packetbuf_payload_len, req_size, UIP_BUFSIZE);
       return;
     }
   }
 
   memcpy((uint8_t *)SICSLOWPAN_IP_BUF + uncomp_hdr_len + (uint16_t)(frag_offset << 3), packetbuf_ptr + packetbuf_hdr_len, packetbuf_payload_len);
   
-  /* update processed_ip_in_len if fragment, sicslowpan_len otherwise */
+#if SICSLOWPAN_CONF_FRAG && SICSLOWPAN_FRAG_FORWARDING
+  if(fwd_candidate) {
+    if(fwd_frag1(frag_size, frag_tag)) {
+      return;
+    }
+    reass = reass_start(packetbuf_addr(PACKETBUF_ADDR_SENDER), frag_tag, frag_size);
+    memcpy(reass->buf.u8, uip_buf, UIP_LLH_LEN + uncomp_hdr_len + packetbuf_payload_len);
+    sicslowpan_buf = reass->buf.u8;
+  }
+#endif /* SICSLOWPAN_CONF_FRAG && SICSLOWPAN_FRAG_FORWARDING */
+
+  /* update the reassembly if fragment, sicslowpan_len otherwise */
 
 #if SICSLOWPAN_CONF_FRAG
-  if(frag_size > 0) {
+  if(reass != NULL) {
     /* Add the size of the header only for the first fragment. */
     if(first_fragment != 0) {
-      processed_ip_in_len += uncomp_hdr_len;
+      reass->processed += uncomp_hdr_len;
     }
     /* For the last fragment, we are OK if there is extrenous bytes at
        the end of the packet. */
     if(last_fragment != 0) {
-      processed_ip_in_len = frag_size;
+      reass->processed = frag_size;
     } else {
-      processed_ip_in_len += packetbuf_payload_len;
+      reass->processed += packetbuf_payload_len;
     }
-    PRINTF("processed_ip_in_len %d, packetbuf_payload_len %d\n", processed_ip_in_len, packetbuf_payload_len);
+    PRINTF("processed %d, packetbuf_payload_len %d\n", reass->processed, packetbuf_payload_len);
 
   } else {
 #endif /* SICSLOWPAN_CONF_FRAG */
@@ -1846,15 +2365,17 @@ input(void)
    * If we have a full IP packet in sicslowpan_buf, deliver it to
    * the IP stack
    */
-  PRINTF("sicslowpan_init processed_ip_in_len %d, sicslowpan_len %d\n",
-         processed_ip_in_len, sicslowpan_len);
-  if(processed_ip_in_len == 0 || (processed_ip_in_len == sicslowpan_len)) {
-    PRINTFI("sicslowpan input: IP packet ready (length %d)\n",
-           sicslowpan_len);
-    memcpy((uint8_t *)UIP_IP_BUF, (uint8_t *)SICSLOWPAN_IP_BUF, sicslowpan_len);
-    uip_len = sicslowpan_len;
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
+  if(reass == NULL || reass->processed == reass->len) {
+    if(reass != NULL) {
+      PRINTFI("sicslowpan input: IP packet ready (length %d)\n",
+             reass->len);
+      memcpy((uint8_t *)UIP_IP_BUF, (uint8_t *)SICSLOWPAN_IP_BUF, reass->len);
+      uip_len = reass->len;
+      list_remove(reass_list, reass);
+      memb_free(&reass_memb, reass);
+      reass = NULL;
+      sicslowpan_buf = uip_buf;
+    }
 #endif /* SICSLOWPAN_CONF_FRAG */
 
 #if DEBUG
@@ -1896,6 +2417,15 @@ sicslowpan_init(void)
    */
   tcpip_set_outputfunc(output);
 
+#if SICSLOWPAN_CONF_FRAG
+  memb_init(&reass_memb);
+  list_init(reass_list);
+#if SICSLOWPAN_FRAG_FORWARDING
+  memb_init(&fwd_memb);
+  list_init(fwd_list);
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
+#endif /* SICSLOWPAN_CONF_FRAG */
+
 #if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06
 /* Preinitialize any address contexts for better header compression
  * (Saves up to 13 bytes per 6lowpan packet)
@@ -1942,6 +2472,99 @@ sicslowpan_init(void)
 #endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 */
 }
 /*--------------------------------------------------------------------*/
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 && SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0
+int
+sicslowpan_context_set(uint8_t number, const uip_ipaddr_t *prefix, uint8_t compress)
+{
+  struct sicslowpan_addr_context *c;
+  int i;
+
+  c = addr_context_lookup_by_number(number);
+  for(i = 0; c == NULL && i < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS; i++) {
+    if(addr_contexts[i].used == SICSLOWPAN_CONTEXT_UNUSED) {
+      c = &addr_contexts[i];
+    }
+  }
+  if(c == NULL) {
+    PRINTF("sicslowpan: no free context for context %u\n", number);
+    return 0;
+  }
+  c->number = number & 0x0f;
+  memcpy(c->prefix, prefix, sizeof(c->prefix));
+  c->used = compress ? SICSLOWPAN_CONTEXT_COMPRESS : SICSLOWPAN_CONTEXT_UNCOMPRESS_ONLY;
+  last_context = NULL;
+  return 1;
+}
+/*--------------------------------------------------------------------*/
+void
+sicslowpan_context_remove(uint8_t number)
+{
+  struct sicslowpan_addr_context *c = addr_context_lookup_by_number(number);
+  if(c != NULL) {
+    c->used = SICSLOWPAN_CONTEXT_UNUSED;
+    last_context = NULL;
+  }
+}
+/*--------------------------------------------------------------------*/
+int
+sicslowpan_context_get(uint8_t index, uint8_t *number,
+                       uip_ipaddr_t *prefix, uint8_t *compress)
+{
+  int i;
+
+  for(i = 0; i < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS; i++) {
+    if(addr_contexts[i].used != SICSLOWPAN_CONTEXT_UNUSED && index-- == 0) {
+      *number = addr_contexts[i].number;
+      memset(prefix, 0, sizeof(*prefix));
+      memcpy(prefix, addr_contexts[i].prefix, sizeof(addr_contexts[i].prefix));
+      *compress = addr_contexts[i].used == SICSLOWPAN_CONTEXT_COMPRESS;
+      return 1;
+    }
+  }
+  return 0;
+}
+#else /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 && SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0 */
+int
+sicslowpan_context_set(uint8_t number, const uip_ipaddr_t *prefix, uint8_t compress)
+{
+  return 0;
+}
+void
+sicslowpan_context_remove(uint8_t number)
+{
+}
+int
+sicslowpan_context_get(uint8_t index, uint8_t *number,
+                       uip_ipaddr_t *prefix, uint8_t *compress)
+{
+  return 0;
+}
+#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 && SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0 */
+/*--------------------------------------------------------------------*/
+int
+sicslowpan_udp_profile_register(const struct sicslowpan_udp_profile *profile)
+{
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 && SICSLOWPAN_UDP_PROFILES
+  int i, free_slot = -1;
+
+  for(i = 0; i < SICSLOWPAN_UDP_PROFILES; i++) {
+    if(udp_profiles[i] != NULL && udp_profiles[i]->number == profile->number) {
+      udp_profiles[i] = profile;
+      return 1;
+    }
+    if(udp_profiles[i] == NULL && free_slot < 0) {
+      free_slot = i;
+    }
+  }
+  if(free_slot >= 0) {
+    udp_profiles[free_slot] = profile;
+    return 1;
+  }
+  PRINTF("sicslowpan: no room for UDP profile %u\n", profile->number);
+#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 && SICSLOWPAN_UDP_PROFILES */
+  return 0;
+}
+/*--------------------------------------------------------------------*/
 int
 sicslowpan_get_last_rssi(void)
 {
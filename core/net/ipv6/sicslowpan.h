@@ -164,6 +164,23 @@
 #define SICSLOWPAN_NHC_UDP_CS_P_11  0xF3 /* source & dest = 0xF0B + 4bit inline */
 /** @} */
 
+/**
+ * \name UDP compression profiles (local NHC, not in RFC 6282)
+ * The NHC byte is followed by the profile number, the ports that are not
+ * the profile port, the checksum, and the payload, compressed if P is set.
+ * @{
+ */
+#define SICSLOWPAN_NHC_UDP_PROFILE_MASK             0xF8
+#define SICSLOWPAN_NHC_UDP_PROFILE_ID               0xD8
+#define SICSLOWPAN_NHC_UDP_PROFILE_S                0x04 /* source is the profile port */
+#define SICSLOWPAN_NHC_UDP_PROFILE_D                0x02 /* dest is the profile port */
+#define SICSLOWPAN_NHC_UDP_PROFILE_P                0x01 /* payload compressed */
+
+/* Profile numbers, the same on all nodes */
+#define SICSLOWPAN_UDP_PROFILE_COAP                 1
+#define SICSLOWPAN_UDP_PROFILE_APPDATA              2
+/** @} */
+
 
 /**
  * \name The 6lowpan "headers" length
@@ -220,11 +237,17 @@
  * each context can have upto 8 bytes
  */
 struct sicslowpan_addr_context {
-  uint8_t used; /* possibly use as prefix-length */
+  uint8_t used; /* SICSLOWPAN_CONTEXT_* */
   uint8_t number;
   uint8_t prefix[8];
 };
 
+/** Values of the used field of an address context */
+#define SICSLOWPAN_CONTEXT_UNUSED          0
+#define SICSLOWPAN_CONTEXT_COMPRESS        1
+/** Context learned with the C flag unset: only used to uncompress */
+#define SICSLOWPAN_CONTEXT_UNCOMPRESS_ONLY 2
+
 /**
  * \name Address compressibility test functions
  * @{
@@ -321,6 +344,75 @@ struct sicslowpan_nh_compressor {
 
 int sicslowpan_get_last_rssi(void);
 
+/**
+ * A UDP compression profile. Both ends must register the same profiles.
+ */
+struct sicslowpan_udp_profile {
+  /** Profile number, carried in the compressed header */
+  uint8_t number;
+  /** The port elided by the profile (host byte order), 0 for none */
+  uint16_t port;
+  /** Compress a payload, NULL if the profile only elides the port.
+      \return the compressed length, at most len, or -1 if not applicable */
+  int (* compress)(uint8_t *compressed, const uint8_t *payload, uint16_t len);
+  /** Uncompress a payload of at most max bytes.
+      \return the uncompressed length, or -1 on error */
+  int (* uncompress)(uint8_t *payload, const uint8_t *compressed, uint16_t len,
+                     uint16_t max);
+};
+
+/**
+ * \brief Register a UDP compression profile, replacing any profile with
+ * the same number
+ * \return 1 on success, 0 if there is no room or profiles are disabled
+ */
+int sicslowpan_udp_profile_register(const struct sicslowpan_udp_profile *profile);
+
+/**
+ * \brief Install or update the IPHC context number (0-15) for a 64-bit
+ * prefix, e.g. learned from a context option.
+ * \param compress 0 if the context may only be used to uncompress
+ * \return 1 on success, 0 if all contexts are in use or IPHC is off
+ */
+int sicslowpan_context_set(uint8_t number, const uip_ipaddr_t *prefix,
+                           uint8_t compress);
+/** \brief Remove the IPHC context number */
+void sicslowpan_context_remove(uint8_t number);
+/**
+ * \brief The index-th IPHC context in use, to advertise the contexts
+ * \return 0 if there are less than index + 1 contexts
+ */
+int sicslowpan_context_get(uint8_t index, uint8_t *number,
+                           uip_ipaddr_t *prefix, uint8_t *compress);
+
+#if SICSLOWPAN_CONF_FRAG
+/** Reassembly counters */
+struct sicslowpan_reass_stats {
+  /** Reassemblies that timed out */
+  uint16_t timeouts;
+  /** Reassemblies discarded to make room for a new one */
+  uint16_t evicted;
+  /** Fragments dropped, not part of a datagram being reassembled */
+  uint16_t dropped;
+#if SICSLOWPAN_FRAG_FORWARDING
+  /** Fragments forwarded without reassembly */
+  uint16_t forwarded;
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
+};
+extern struct sicslowpan_reass_stats sicslowpan_reass_stats;
+#endif /* SICSLOWPAN_CONF_FRAG */
+
+#if SICSLOWPAN_OUTPUT_REFERENCE
+/** Payloads of unfragmented outgoing packets */
+struct sicslowpan_output_stats {
+  /** Referenced in uip_buf, copied only by the MAC queue */
+  uint16_t referenced;
+  /** Copied into packetbuf, no room left in the header area */
+  uint16_t copied;
+};
+extern struct sicslowpan_output_stats sicslowpan_output_stats;
+#endif /* SICSLOWPAN_OUTPUT_REFERENCE */
+
 extern const struct network_driver sicslowpan_driver;
 
 #endif /* SICSLOWPAN_H_ */
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/**
+ * \file
+ *         Aggregation of small forwarded UDP datagrams, see uip-aggr.h.
+ */
+
+#include "contiki.h"
+#include "net/ip/uip.h"
+#include "net/ip/simple-udp.h"
+#include "net/ipv6/uip-aggr.h"
+#include <string.h>
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+#if UIP_AGGR
+
+#define UIP_IP_BUF   ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+/* Aggregate header: source and destination ports */
+#define AGGR_HDR_LEN 4
+/* Per-datagram header: length and source IID */
+#define AGGR_REC_HDR_LEN 9
+
+static struct simple_udp_connection aggr_connection;
+static uip_aggr_callback aggr_callback;
+static int initialized;
+
+/* The aggregate being filled. Upward traffic goes to a single sink, so
+ * one is enough: a datagram for another destination is sent unchanged */
+static struct {
+  uip_ipaddr_t dest;
+  uint8_t buf[UIP_AGGR_BUF_SIZE];
+  uint16_t len;
+  struct ctimer timer;
+} pending;
+
+/*---------------------------------------------------------------------------*/
+static void
+flush(void *ptr)
+{
+  if(pending.len > AGGR_HDR_LEN) {
+    PRINTF("uip-aggr: sending %u bytes to ", pending.len);
+    PRINT6ADDR(&pending.dest);
+    PRINTF("\n");
+    simple_udp_sendto(&aggr_connection, pending.buf, pending.len, &pending.dest);
+  }
+  pending.len = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+aggr_input(struct simple_udp_connection *c,
+           const uip_ipaddr_t *sender_addr,
+           uint16_t sender_port,
+           const uip_ipaddr_t *receiver_addr,
+           uint16_t receiver_port,
+           const uint8_t *data,
+           uint16_t datalen)
+{
+  uip_ipaddr_t src;
+  uint16_t srcport;
+  uint16_t destport;
+  uint16_t i;
+
+  if(aggr_callback == NULL || datalen < AGGR_HDR_LEN) {
+    return;
+  }
+  srcport = (data[0] << 8) | data[1];
+  destport = (data[2] << 8) | data[3];
+  /* The sources share the prefix of the destination */
+  uip_ipaddr_copy(&src, receiver_addr);
+  i = AGGR_HDR_LEN;
+  while(i + AGGR_REC_HDR_LEN <= datalen
+        && i + AGGR_REC_HDR_LEN + data[i] <= datalen) {
+    memcpy(&src.u8[8], &data[i + 1], 8);
+    aggr_callback(&src, srcport, destport,
+                  &data[i + AGGR_REC_HDR_LEN], data[i]);
+    i += AGGR_REC_HDR_LEN + data[i];
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+uip_aggr_forward(void)
+{
+  struct uip_udp_hdr *udp;
+  uint16_t offset;
+  uint16_t datalen;
+  uint8_t proto;
+
+  if(!initialized) {
+    return 0;
+  }
+
+  /* Only UDP, possibly after a hop-by-hop header (RPL) */
+  offset = UIP_LLIPH_LEN;
+  proto = UIP_IP_BUF->proto;
+  if(proto == UIP_PROTO_HBHO) {
+    proto = uip_buf[offset];
+    offset += (uip_buf[offset + 1] << 3) + 8;
+  }
+  if(proto != UIP_PROTO_UDP || offset + UIP_UDPH_LEN > uip_len + UIP_LLH_LEN) {
+    return 0;
+  }
+  udp = (struct uip_udp_hdr *)&uip_buf[offset];
+  datalen = uip_len + UIP_LLH_LEN - offset - UIP_UDPH_LEN;
+  if(datalen > UIP_AGGR_MAX_PAYLOAD
+     || udp->destport == UIP_HTONS(UIP_AGGR_PORT)
+     || memcmp(&UIP_IP_BUF->srcipaddr, &UIP_IP_BUF->destipaddr, 8) != 0) {
+    return 0;
+  }
+
+  if(pending.len > 0
+     && (!uip_ipaddr_cmp(&pending.dest, &UIP_IP_BUF->destipaddr)
+         || memcmp(pending.buf, &udp->srcport, 2) != 0
+         || memcmp(pending.buf + 2, &udp->destport, 2) != 0
+         || pending.len + AGGR_REC_HDR_LEN + datalen > UIP_AGGR_BUF_SIZE)) {
+    /* This one does not fit, send it as it is and the aggregate right after */
+    ctimer_set(&pending.timer, 0, flush, NULL);
+    return 0;
+  }
+
+  if(pending.len == 0) {
+    uip_ipaddr_copy(&pending.dest, &UIP_IP_BUF->destipaddr);
+    memcpy(pending.buf, &udp->srcport, 2);
+    memcpy(pending.buf + 2, &udp->destport, 2);
+    pending.len = AGGR_HDR_LEN;
+    ctimer_set(&pending.timer, UIP_AGGR_MAX_DELAY, flush, NULL);
+  }
+  pending.buf[pending.len] = datalen;
+  memcpy(&pending.buf[pending.len + 1], &UIP_IP_BUF->srcipaddr.u8[8], 8);
+  memcpy(&pending.buf[pending.len + AGGR_REC_HDR_LEN],
+         (uint8_t *)udp + UIP_UDPH_LEN, datalen);
+  pending.len += AGGR_REC_HDR_LEN + datalen;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_aggr_init(uip_aggr_callback callback)
+{
+  aggr_callback = callback;
+  if(!initialized) {
+    simple_udp_register(&aggr_connection, UIP_AGGR_PORT,
+                        NULL, UIP_AGGR_PORT, aggr_input);
+    initialized = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+#endif /* UIP_AGGR */
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/**
+ * \file
+ *         Aggregation of small forwarded UDP datagrams.
+ *
+ *         A forwarder holds small UDP datagrams towards the same
+ *         destination and ports for at most UIP_AGGR_MAX_DELAY, then sends
+ *         them as a single datagram to UIP_AGGR_PORT. The destination splits
+ *         it and hands every original datagram to its callback.
+ *
+ *         Aggregate payload: source port, destination port, then for each
+ *         datagram its length (1 byte), the IID of its source (8 bytes,
+ *         the prefix is the destination's) and its payload.
+ */
+
+#ifndef UIP_AGGR_H
+#define UIP_AGGR_H
+
+#include "contiki.h"
+#include "net/ip/uip.h"
+
+/* Enable aggregation at forwarders and splitting at destinations */
+#ifdef UIP_CONF_AGGR
+#define UIP_AGGR UIP_CONF_AGGR
+#else
+#define UIP_AGGR 0
+#endif
+
+/* UDP port of the aggregates, 0xf0b0-0xf0bf are compressed to 4 bits */
+#ifdef UIP_CONF_AGGR_PORT
+#define UIP_AGGR_PORT UIP_CONF_AGGR_PORT
+#else
+#define UIP_AGGR_PORT 0xf0b1
+#endif
+
+/* Datagrams with a larger UDP payload are forwarded as they are */
+#ifdef UIP_CONF_AGGR_MAX_PAYLOAD
+#define UIP_AGGR_MAX_PAYLOAD UIP_CONF_AGGR_MAX_PAYLOAD
+#else
+#define UIP_AGGR_MAX_PAYLOAD 32
+#endif
+
+/* Maximum time a datagram is held at a forwarder */
+#ifdef UIP_CONF_AGGR_MAX_DELAY
+#define UIP_AGGR_MAX_DELAY UIP_CONF_AGGR_MAX_DELAY
+#else
+#define UIP_AGGR_MAX_DELAY (CLOCK_SECOND / 2)
+#endif
+
+/* Maximum payload of an aggregate */
+#ifdef UIP_CONF_AGGR_BUF_SIZE
+#define UIP_AGGR_BUF_SIZE UIP_CONF_AGGR_BUF_SIZE
+#else
+#define UIP_AGGR_BUF_SIZE 80
+#endif
+
+/* Called at the destination for every datagram of an aggregate */
+typedef void (* uip_aggr_callback)(const uip_ipaddr_t *sender_addr,
+                                   uint16_t sender_port,
+                                   uint16_t receiver_port,
+                                   const uint8_t *data,
+                                   uint16_t datalen);
+
+/* Start aggregating forwarded datagrams. callback receives the datagrams
+ * of the aggregates destined to this node, NULL at nodes that are not
+ * a destination */
+void uip_aggr_init(uip_aggr_callback callback);
+/* Called from the forwarding path with a datagram in uip_buf. Returns 1
+ * if the datagram was held for aggregation and must not be forwarded */
+int uip_aggr_forward(void);
+
+#endif /* UIP_AGGR_H */
@@ -46,7 +46,9 @@
    so that it will be maintained along with the rest of the neighbor
    tables in the system. */
 NBR_TABLE(struct uip_ds6_route_neighbor_routes, nbr_routes);
+#if !UIP_DS6_ROUTE_COMPACT
 MEMB(neighborroutememb, struct uip_ds6_route_neighbor_route, UIP_DS6_ROUTE_NB);
+#endif /* !UIP_DS6_ROUTE_COMPACT */
 
 /* Each route is repressented by a uip_ds6_route_t structure and
    memory for each route is allocated from the routememb memory
@@ -54,6 +56,15 @@ MEMB(neighborroutememb, struct uip_ds6_route_neighbor_route, UIP_DS6_ROUTE_NB);
 LIST(routelist);
 MEMB(routememb, uip_ds6_route_t, UIP_DS6_ROUTE_NB);
 
+#if UIP_DS6_ROUTE_HASH_SIZE
+/* Host routes are also on a hash bucket, indexed by the last bytes of
+   their address. Other routes are only on the routelist, which is
+   searched only if there are any. */
+static uip_ds6_route_t *route_hash[UIP_DS6_ROUTE_HASH_SIZE];
+static int num_prefix_routes;
+#define ROUTE_HASH(addr) (((addr)->u8[14] ^ (addr)->u8[15]) % UIP_DS6_ROUTE_HASH_SIZE)
+#endif /* UIP_DS6_ROUTE_HASH_SIZE */
+
 #endif /* UIP_DS6_ROUTE_NB > 0 */
 
 /* Default routes are held on the defaultrouterlist and their
@@ -76,6 +87,9 @@ static int num_routes = 0;
 #include "net/ip/uip-debug.h"
 
 static void rm_routelist_callback(nbr_table_item_t *ptr);
+#if UIP_DS6_ROUTE_NB > 0 && UIP_DS6_ROUTE_KEEP_NEXTHOPS
+static int nexthop_veto_callback(nbr_table_item_t *ptr);
+#endif /* UIP_DS6_ROUTE_NB > 0 && UIP_DS6_ROUTE_KEEP_NEXTHOPS */
 /*---------------------------------------------------------------------------*/
 #if DEBUG != DEBUG_NONE
 static void
@@ -148,8 +162,15 @@ uip_ds6_route_init(void)
 #if UIP_DS6_ROUTE_NB > 0
   memb_init(&routememb);
   list_init(routelist);
+#if UIP_DS6_ROUTE_HASH_SIZE
+  memset(route_hash, 0, sizeof(route_hash));
+  num_prefix_routes = 0;
+#endif /* UIP_DS6_ROUTE_HASH_SIZE */
   nbr_table_register(nbr_routes,
                      (nbr_table_callback *)rm_routelist_callback);
+#if UIP_DS6_ROUTE_KEEP_NEXTHOPS
+  nbr_table_set_veto(nbr_routes, nexthop_veto_callback);
+#endif /* UIP_DS6_ROUTE_KEEP_NEXTHOPS */
 #endif /* UIP_DS6_ROUTE_NB > 0 */
 
   memb_init(&defaultroutermemb);
@@ -204,18 +225,44 @@ uip_ds6_route_num_routes(void)
   return num_routes;
 }
 /*---------------------------------------------------------------------------*/
-uip_ds6_route_t *
-uip_ds6_route_lookup(uip_ipaddr_t *addr)
+#if UIP_DS6_ROUTE_HASH_SIZE
+static void
+route_hash_add(uip_ds6_route_t *r)
+{
+  if(r->length == 128) {
+    uip_ds6_route_t **bucket = &route_hash[ROUTE_HASH(&r->ipaddr)];
+    r->hash_next = *bucket;
+    *bucket = r;
+  } else {
+    num_prefix_routes++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+route_hash_rm(uip_ds6_route_t *r)
+{
+  if(r->length == 128) {
+    uip_ds6_route_t **p = &route_hash[ROUTE_HASH(&r->ipaddr)];
+    while(*p != NULL && *p != r) {
+      p = &(*p)->hash_next;
+    }
+    if(*p != NULL) {
+      *p = r->hash_next;
+    }
+  } else {
+    num_prefix_routes--;
+  }
+}
+#endif /* UIP_DS6_ROUTE_HASH_SIZE */
+/*---------------------------------------------------------------------------*/
+/* Longest prefix match over the whole route list */
+static uip_ds6_route_t *
+route_prefix_lookup(uip_ipaddr_t *addr)
 {
   uip_ds6_route_t *r;
   uip_ds6_route_t *found_route;
   uint8_t longestmatch;
 
-  PRINTF("uip-ds6-route: Looking up route for ");
-  PRINT6ADDR(addr);
-  PRINTF("\n");
-
-
   found_route = NULL;
   longestmatch = 0;
   for(r = uip_ds6_route_head();
@@ -231,6 +278,29 @@ uip_ds6_route_lookup(uip_ipaddr_t *addr)
       }
     }
   }
+  return found_route;
+}
+/*---------------------------------------------------------------------------*/
+uip_ds6_route_t *
+uip_ds6_route_lookup(uip_ipaddr_t *addr)
+{
+  uip_ds6_route_t *found_route;
+
+  PRINTF("uip-ds6-route: Looking up route for ");
+  PRINT6ADDR(addr);
+  PRINTF("\n");
+
+#if UIP_DS6_ROUTE_HASH_SIZE
+  /* A host route is the longest match there can be */
+  for(found_route = route_hash[ROUTE_HASH(addr)];
+      found_route != NULL && !uip_ipaddr_cmp(addr, &found_route->ipaddr);
+      found_route = found_route->hash_next);
+  if(found_route == NULL && num_prefix_routes > 0) {
+    found_route = route_prefix_lookup(addr);
+  }
+#else /* UIP_DS6_ROUTE_HASH_SIZE */
+  found_route = route_prefix_lookup(addr);
+#endif /* UIP_DS6_ROUTE_HASH_SIZE */
 
   if(found_route != NULL) {
     PRINTF("uip-ds6-route: Found route: ");
@@ -260,7 +330,9 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
 		  uip_ipaddr_t *nexthop)
 {
   uip_ds6_route_t *r;
+#if !UIP_DS6_ROUTE_COMPACT
   struct uip_ds6_route_neighbor_route *nbrr;
+#endif /* !UIP_DS6_ROUTE_COMPACT */
 
 #if DEBUG != DEBUG_NONE
   assert_nbr_routes_list_sane();
@@ -329,7 +401,11 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
         PRINTF("uip_ds6_route_add: could not allocate neighbor table entry\n");
         return NULL;
       }
+#if UIP_DS6_ROUTE_COMPACT
+      routes->num_routes = 0;
+#else /* UIP_DS6_ROUTE_COMPACT */
       LIST_STRUCT_INIT(routes, route_list);
+#endif /* UIP_DS6_ROUTE_COMPACT */
     }
 
     /* Allocate a routing entry and populate it. */
@@ -346,6 +422,9 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
        and that there is a packet coming soon. */
     list_push(routelist, r);
 
+#if UIP_DS6_ROUTE_COMPACT
+    routes->num_routes++;
+#else /* UIP_DS6_ROUTE_COMPACT */
     nbrr = memb_alloc(&neighborroutememb);
     if(nbrr == NULL) {
       /* This should not happen, as we explicitly deallocated one
@@ -358,6 +437,7 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
     nbrr->route = r;
     /* Add the route to this neighbor */
     list_add(routes->route_list, nbrr);
+#endif /* UIP_DS6_ROUTE_COMPACT */
     r->neighbor_routes = routes;
     num_routes++;
 
@@ -366,6 +446,9 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
 
   uip_ipaddr_copy(&(r->ipaddr), ipaddr);
   r->length = length;
+#if UIP_DS6_ROUTE_HASH_SIZE
+  route_hash_add(r);
+#endif /* UIP_DS6_ROUTE_HASH_SIZE */
 
 #ifdef UIP_DS6_ROUTE_STATE_TYPE
   memset(&r->state, 0, sizeof(UIP_DS6_ROUTE_STATE_TYPE));
@@ -392,7 +475,9 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
 void
 uip_ds6_route_rm(uip_ds6_route_t *route)
 {
+#if !UIP_DS6_ROUTE_COMPACT
   struct uip_ds6_route_neighbor_route *neighbor_route;
+#endif /* !UIP_DS6_ROUTE_COMPACT */
 #if DEBUG != DEBUG_NONE
   assert_nbr_routes_list_sane();
 #endif /* DEBUG != DEBUG_NONE */
@@ -404,7 +489,19 @@ uip_ds6_route_rm(uip_ds6_route_t *route)
 
     /* Remove the route from the route list */
     list_remove(routelist, route);
+#if UIP_DS6_ROUTE_HASH_SIZE
+    route_hash_rm(route);
+#endif /* UIP_DS6_ROUTE_HASH_SIZE */
 
+#if UIP_DS6_ROUTE_COMPACT
+    if(--route->neighbor_routes->num_routes == 0) {
+      /* If this was the only route using this neighbor, remove the
+         neibhor from the table */
+      PRINTF("uip_ds6_route_rm: removing neighbor too\n");
+      nbr_table_remove(nbr_routes, route->neighbor_routes);
+    }
+    memb_free(&routememb, route);
+#else /* UIP_DS6_ROUTE_COMPACT */
     /* Find the corresponding neighbor_route and remove it. */
     for(neighbor_route = list_head(route->neighbor_routes->route_list);
         neighbor_route != NULL && neighbor_route->route != route;
@@ -424,6 +521,7 @@ uip_ds6_route_rm(uip_ds6_route_t *route)
     }
     memb_free(&routememb, route);
     memb_free(&neighborroutememb, neighbor_route);
+#endif /* UIP_DS6_ROUTE_COMPACT */
 
     num_routes--;
 
@@ -467,6 +565,18 @@ rm_routelist(struct uip_ds6_route_neighbor_routes *routes)
   assert_nbr_routes_list_sane();
 #endif /* DEBUG != DEBUG_NONE */
   PRINTF("uip_ds6_route_rm_routelist\n");
+#if UIP_DS6_ROUTE_COMPACT
+  if(routes != NULL) {
+    uip_ds6_route_t *r, *next;
+    for(r = uip_ds6_route_head(); r != NULL; r = next) {
+      next = uip_ds6_route_next(r);
+      if(r->neighbor_routes == routes) {
+        uip_ds6_route_rm(r);
+      }
+    }
+    nbr_table_remove(nbr_routes, routes);
+  }
+#else /* UIP_DS6_ROUTE_COMPACT */
   if(routes != NULL && routes->route_list != NULL) {
     struct uip_ds6_route_neighbor_route *r;
     r = list_head(routes->route_list);
@@ -476,6 +586,7 @@ rm_routelist(struct uip_ds6_route_neighbor_routes *routes)
     }
     nbr_table_remove(nbr_routes, routes);
   }
+#endif /* UIP_DS6_ROUTE_COMPACT */
 #if DEBUG != DEBUG_NONE
   assert_nbr_routes_list_sane();
 #endif /* DEBUG != DEBUG_NONE */
@@ -486,6 +597,19 @@ rm_routelist_callback(nbr_table_item_t *ptr)
 {
   rm_routelist((struct uip_ds6_route_neighbor_routes *)ptr);
 }
+#if UIP_DS6_ROUTE_KEEP_NEXTHOPS
+/*---------------------------------------------------------------------------*/
+static int
+nexthop_veto_callback(nbr_table_item_t *ptr)
+{
+  struct uip_ds6_route_neighbor_routes *routes = ptr;
+#if UIP_DS6_ROUTE_COMPACT
+  return routes->num_routes > 0;
+#else /* UIP_DS6_ROUTE_COMPACT */
+  return list_head(routes->route_list) != NULL;
+#endif /* UIP_DS6_ROUTE_COMPACT */
+}
+#endif /* UIP_DS6_ROUTE_KEEP_NEXTHOPS */
 /*---------------------------------------------------------------------------*/
 void
 uip_ds6_route_rm_by_nexthop(uip_ipaddr_t *nexthop)
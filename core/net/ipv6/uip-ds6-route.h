@@ -81,6 +81,31 @@ void uip_ds6_notification_rm(struct uip_ds6_notification *n);
 #define UIP_DS6_ROUTE_NB UIP_CONF_MAX_ROUTES
 #endif /* UIP_CONF_MAX_ROUTES */
 
+/* Host routes (/128) are looked up in a hash table with that many
+   buckets, 0 to search all routes linearly */
+#ifdef UIP_CONF_DS6_ROUTE_HASH_SIZE
+#define UIP_DS6_ROUTE_HASH_SIZE UIP_CONF_DS6_ROUTE_HASH_SIZE
+#else
+#define UIP_DS6_ROUTE_HASH_SIZE 0
+#endif
+
+/* Compact routes: a neighbor only counts the routes through it instead
+   of listing them, which saves a list entry per route. Removing all
+   routes through a neighbor then searches the whole route list. */
+#ifdef UIP_CONF_DS6_ROUTE_COMPACT
+#define UIP_DS6_ROUTE_COMPACT UIP_CONF_DS6_ROUTE_COMPACT
+#else
+#define UIP_DS6_ROUTE_COMPACT 0
+#endif
+
+/* Keep the neighbors that routes go through when the neighbor table is
+   full, rather than evicting them and dropping their routes. */
+#ifdef UIP_CONF_DS6_ROUTE_KEEP_NEXTHOPS
+#define UIP_DS6_ROUTE_KEEP_NEXTHOPS UIP_CONF_DS6_ROUTE_KEEP_NEXTHOPS
+#else
+#define UIP_DS6_ROUTE_KEEP_NEXTHOPS 0
+#endif
+
 /** \brief define some additional RPL related route state and
  *  neighbor callback for RPL - if not a DS6_ROUTE_STATE is already set */
 #ifndef UIP_DS6_ROUTE_STATE_TYPE
@@ -97,7 +122,11 @@ typedef struct rpl_route_entry {
 /** \brief The neighbor routes hold a list of routing table entries
     that are attached to a specific neihbor. */
 struct uip_ds6_route_neighbor_routes {
+#if UIP_DS6_ROUTE_COMPACT
+  uint16_t num_routes;
+#else /* UIP_DS6_ROUTE_COMPACT */
   LIST_STRUCT(route_list);
+#endif /* UIP_DS6_ROUTE_COMPACT */
 };
 
 /** \brief An entry in the routing table */
@@ -109,6 +138,10 @@ typedef struct uip_ds6_route {
      belong to the neighbor table entry that this routing table entry
      uses. */
   struct uip_ds6_route_neighbor_routes *neighbor_routes;
+#if UIP_DS6_ROUTE_HASH_SIZE
+  /* Next host route in the same hash bucket */
+  struct uip_ds6_route *hash_next;
+#endif
   uip_ipaddr_t ipaddr;
 #ifdef UIP_DS6_ROUTE_STATE_TYPE
   UIP_DS6_ROUTE_STATE_TYPE state;
@@ -119,6 +119,14 @@
 #define UIP_DS6_LL_NUD UIP_CONF_DS6_LL_NUD
 #endif
 
+/* Should we derive the link-layer address of link-local neighbors from
+ * their IID instead of using the neighbor cache and ND? */
+#ifndef UIP_CONF_DS6_LL_FROM_IID
+#define UIP_DS6_LL_FROM_IID 0
+#else
+#define UIP_DS6_LL_FROM_IID UIP_CONF_DS6_LL_FROM_IID
+#endif
+
 /** \brief Possible states for the an address  (RFC 4862) */
 #define ADDR_TENTATIVE 0
 #define ADDR_PREFERRED 1
@@ -305,6 +313,10 @@ uip_ds6_aaddr_t *uip_ds6_aaddr_lookup(uip_ipaddr_t *ipaddr);
 /** \brief set the last 64 bits of an IP address based on the MAC address */
 void uip_ds6_set_addr_iid(uip_ipaddr_t *ipaddr, uip_lladdr_t *lladdr);
 
+/** \brief Get the MAC address of a link-local address built by
+ * uip_ds6_set_addr_iid, return 0 if the address is not one */
+int uip_ds6_lladdr_from_iid(uip_lladdr_t *lladdr, const uip_ipaddr_t *ipaddr);
+
 /** \brief Get the number of matching bits of two addresses */
 uint8_t get_match_length(uip_ipaddr_t *src, uip_ipaddr_t *dst);
 
@@ -313,6 +313,10 @@ uip_icmp6_send(const uip_ipaddr_t *dest, int type, int code, int payload_len)
   UIP_ICMP_BUF->icmpchksum = ~uip_icmp6chksum();
 
   uip_len = UIP_IPH_LEN + UIP_ICMPH_LEN + payload_len;
+#if UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING
+  /* Messages from the root to nodes down the DAG are source-routed */
+  rpl_insert_srh_header();
+#endif /* UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING */
   tcpip_ipv6_output();
 }
 /*---------------------------------------------------------------------------*/
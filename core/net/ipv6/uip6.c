@@ -77,6 +77,7 @@
 #include "net/ipv6/uip-nd6.h"
 #include "net/ipv6/uip-ds6.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
+#include "net/ipv6/uip-aggr.h"
 
 #include <string.h>
 
@@ -244,6 +245,13 @@ static uint8_t iss[4];
 uint8_t uip_acc32[4];
 static uint8_t opt;
 static uint16_t tmp16;
+
+#if UIP_TCP_WINDOW_SEGMENTS > 1
+/* The number of bytes acknowledged by the incoming segment */
+uint16_t uip_acklen;
+/* The offset of the data sent out from the oldest byte in flight */
+static uint16_t sndoff;
+#endif /* UIP_TCP_WINDOW_SEGMENTS > 1 */
 #endif /* UIP_TCP */
 /** @} */
 
@@ -298,8 +306,108 @@ uip_add32(uint8_t *op32, uint16_t op16)
 
 #endif /* UIP_ARCH_ADD32 && UIP_TCP */
 
+#if UIP_TCP
+#if UIP_TCP_WINDOW_SEGMENTS > 1
+/*---------------------------------------------------------------------------*/
+static uint32_t
+seqno32(const uint8_t *seqno)
+{
+  return ((uint32_t)seqno[0] << 24) | ((uint32_t)seqno[1] << 16) |
+    ((uint32_t)seqno[2] << 8) | seqno[3];
+}
+/*---------------------------------------------------------------------------*/
+/* The number of bytes a windowed connection can have in flight: its
+ * number of segments, within the window of the remote host. A window
+ * smaller than the MSS still lets one segment through, as a probe. */
+static uint16_t
+tcp_window(struct uip_conn *conn)
+{
+  uint16_t wnd;
+
+  wnd = (conn->segments > UIP_TCP_WINDOW_SEGMENTS ?
+         UIP_TCP_WINDOW_SEGMENTS : conn->segments) * conn->mss;
+  if(conn->snd_wnd > conn->mss && conn->snd_wnd < wnd) {
+    wnd = conn->snd_wnd;
+  }
+  return wnd;
+}
+#define TCP_CAN_SEND(conn) ((conn)->segments > 0 ? \
+                            (conn)->len < tcp_window(conn) : \
+                            !uip_outstanding(conn))
+#else /* UIP_TCP_WINDOW_SEGMENTS > 1 */
+#define TCP_CAN_SEND(conn) (!uip_outstanding(conn))
+#endif /* UIP_TCP_WINDOW_SEGMENTS > 1 */
+/*---------------------------------------------------------------------------*/
+/* RTT estimation, taken directly from VJs original code in his paper */
+static void
+tcp_update_rto(struct uip_conn *conn)
+{
+  signed char m;
+
+  m = conn->rto - conn->timer;
+  m = m - (conn->sa >> 3);
+  conn->sa += m;
+  if(m < 0) {
+    m = -m;
+  }
+  m = m - (conn->sv >> 2);
+  conn->sv += m;
+  conn->rto = (conn->sa >> 3) + conn->sv;
+}
+#endif /* UIP_TCP */
+
 #if ! UIP_ARCH_CHKSUM
 /*---------------------------------------------------------------------------*/
+#ifdef UIP_ARCH_CHKSUM_ADD
+/* The CPU provides the one's complement sum of the data, added to sum,
+ * both in host byte order (e.g. cpu/msp430/uip-ipchksum.c) */
+uint16_t uip_arch_chksum_add(uint16_t sum, const uint8_t *data, uint16_t len);
+#define chksum(sum, data, len) uip_arch_chksum_add(sum, data, len)
+#else /* UIP_ARCH_CHKSUM_ADD */
+/* Accumulate the 16-bit words in 32 bits and fold the carries once at
+ * the end, rather than after every word. Faster on 32-bit CPUs, that
+ * also do not need data to be aligned here. Up to 0xffff bytes, this
+ * cannot overflow */
+#ifdef UIP_CONF_CHKSUM_ACC32
+#define UIP_CHKSUM_ACC32 UIP_CONF_CHKSUM_ACC32
+#else
+#define UIP_CHKSUM_ACC32 0
+#endif
+#if UIP_CHKSUM_ACC32
+static uint16_t
+chksum(uint16_t sum, const uint8_t *data, uint16_t len)
+{
+  uint32_t acc;
+  const uint8_t *dataptr;
+  const uint8_t *last_byte;
+
+  acc = sum;
+  dataptr = data;
+  last_byte = data + len - 1;
+
+  while(dataptr + 6 < last_byte) {   /* At least eight more bytes */
+    acc += ((uint16_t)dataptr[0] << 8) + dataptr[1];
+    acc += ((uint16_t)dataptr[2] << 8) + dataptr[3];
+    acc += ((uint16_t)dataptr[4] << 8) + dataptr[5];
+    acc += ((uint16_t)dataptr[6] << 8) + dataptr[7];
+    dataptr += 8;
+  }
+  while(dataptr < last_byte) {   /* At least two more bytes */
+    acc += ((uint16_t)dataptr[0] << 8) + dataptr[1];
+    dataptr += 2;
+  }
+  if(dataptr == last_byte) {
+    acc += (uint16_t)dataptr[0] << 8;
+  }
+
+  /* Fold the carries, twice as the first fold can carry again */
+  acc = (acc & 0xffff) + (acc >> 16);
+  acc = (acc & 0xffff) + (acc >> 16);
+
+  /* Return sum in host byte order. */
+  return (uint16_t)acc;
+}
+#else /* UIP_CHKSUM_ACC32 */
 static uint16_t
 chksum(uint16_t sum, const uint8_t *data, uint16_t len)
 {
@@ -330,6 +438,8 @@ chksum(uint16_t sum, const uint8_t *data, uint16_t len)
   /* Return sum in host byte order. */
   return sum;
 }
+#endif /* UIP_CHKSUM_ACC32 */
+#endif /* UIP_ARCH_CHKSUM_ADD */
 /*---------------------------------------------------------------------------*/
 uint16_t
 uip_chksum(uint16_t *data, uint16_t len)
@@ -497,6 +607,10 @@ uip_connect(uip_ipaddr_t *ripaddr, uint16_t rport)
   
   conn->len = 1;   /* TCP length of the SYN is one. */
   conn->nrtx = 0;
+#if UIP_TCP_WINDOW_SEGMENTS > 1
+  conn->segments = 0;
+  conn->snd_wnd = 0;
+#endif /* UIP_TCP_WINDOW_SEGMENTS > 1 */
   conn->timer = 1; /* Send the SYN next time around. */
   conn->rto = UIP_RTO;
   conn->sa = 0;
@@ -934,7 +1048,7 @@ uip_process(uint8_t flag)
   if(flag == UIP_POLL_REQUEST) {
 #if UIP_TCP
     if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
-       !uip_outstanding(uip_connr)) {
+       TCP_CAN_SEND(uip_connr)) {
       uip_flags = UIP_POLL;
       UIP_APPCALL();
       goto appsend;
@@ -976,6 +1090,12 @@ uip_process(uint8_t flag)
         uip_connr->tcpstateflags = UIP_CLOSED;
       }
     } else if(uip_connr->tcpstateflags != UIP_CLOSED) {
+#if UIP_TCP_DELAYED_ACK
+      if(uip_connr->tcpstateflags & UIP_ACKPENDING) {
+        /* The periodic timer bounds the delay of an ACK */
+        goto tcp_send_ack;
+      }
+#endif /* UIP_TCP_DELAYED_ACK */
       /*
        * If the connection has outstanding data, we increase the
        * connection's timer and see if it has reached the RTO value
@@ -1038,6 +1158,18 @@ uip_process(uint8_t flag)
                */
               uip_flags = UIP_REXMIT;
               UIP_APPCALL();
+#if UIP_TCP_WINDOW_SEGMENTS > 1
+              if(uip_connr->segments > 0) {
+                /* Only the oldest segment in flight is retransmitted */
+                if(uip_slen > uip_connr->mss) {
+                  uip_slen = uip_connr->mss;
+                }
+                if(uip_slen > uip_connr->len) {
+                  uip_slen = uip_connr->len;
+                }
+                sndoff = 0;
+              }
+#endif /* UIP_TCP_WINDOW_SEGMENTS > 1 */
               goto apprexmit;
                      
             case UIP_FIN_WAIT_1:
@@ -1047,7 +1179,9 @@ uip_process(uint8_t flag)
               goto tcp_send_finack;
           }
         }
-      } else if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
+      }
+      if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
+         TCP_CAN_SEND(uip_connr)) {
         /*
          * If there was no need for a retransmission, we poll the
          * application for new data.
@@ -1205,6 +1339,14 @@ uip_process(uint8_t flag)
         goto send;
       }
 
+#if UIP_AGGR
+      if(uip_aggr_forward()) {
+        /* Held, it will be forwarded as part of an aggregate */
+        UIP_STAT(++uip_stat.ip.forwarded);
+        goto drop;
+      }
+#endif /* UIP_AGGR */
+
 #if UIP_CONF_IPV6_RPL
       if(rpl_update_header_empty()) {
         /* Packet can not be forwarded */
@@ -1345,6 +1487,20 @@ uip_process(uint8_t flag)
          */
 
         PRINTF("Processing Routing header\n");
+#if UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING
+        if(rpl_process_srh_header()) {
+          /* Forward to the next hop of the source route */
+          if(UIP_IP_BUF->ttl <= 1) {
+            uip_icmp6_error_output(ICMP6_TIME_EXCEEDED,
+                                   ICMP6_TIME_EXCEED_TRANSIT, 0);
+            UIP_STAT(++uip_stat.ip.drop);
+            goto send;
+          }
+          UIP_IP_BUF->ttl = UIP_IP_BUF->ttl - 1;
+          UIP_STAT(++uip_stat.ip.forwarded);
+          goto send;
+        }
+#endif /* UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING */
         if(UIP_ROUTING_BUF->seg_left > 0) {
           uip_icmp6_error_output(ICMP6_PARAM_PROB, ICMP6_PARAMPROB_HEADER, UIP_IPH_LEN + uip_ext_len + 2);
           UIP_STAT(++uip_stat.ip.drop);
@@ -1725,6 +1881,10 @@ uip_process(uint8_t flag)
   uip_connr->snd_nxt[2] = iss[2];
   uip_connr->snd_nxt[3] = iss[3];
   uip_connr->len = 1;
+#if UIP_TCP_WINDOW_SEGMENTS > 1
+  uip_connr->segments = 0;
+  uip_connr->snd_wnd = 0;
+#endif /* UIP_TCP_WINDOW_SEGMENTS > 1 */
 
   /* rcv_nxt should be the seqno from the incoming packet + 1. */
   uip_connr->rcv_nxt[3] = UIP_TCP_BUF->seqno[3];
@@ -1842,6 +2002,30 @@ uip_process(uint8_t flag)
      data. If so, we update the sequence number, reset the length of
      the outstanding data, calculate RTT estimations, and reset the
      retransmission timer. */
+#if UIP_TCP_WINDOW_SEGMENTS > 1
+  if((UIP_TCP_BUF->flags & TCP_ACK) && uip_connr->segments > 0 &&
+     uip_outstanding(uip_connr)) {
+    /* A windowed connection takes cumulative ACKs of part of the data
+       in flight. The RTT is only sampled when a single segment was in
+       flight, as the timer restarts with every ACK. */
+    uint32_t acked;
+
+    acked = seqno32(UIP_TCP_BUF->ackno) - seqno32(uip_connr->snd_nxt);
+    if(acked > 0 && acked <= uip_connr->len) {
+      uip_add32(uip_connr->snd_nxt, acked);
+      memcpy(uip_connr->snd_nxt, uip_acc32, 4);
+      if(uip_connr->nrtx == 0 && acked == uip_connr->len &&
+         uip_connr->len <= uip_connr->mss) {
+        tcp_update_rto(uip_connr);
+      }
+      uip_acklen = acked;
+      uip_flags = UIP_ACKDATA;
+      uip_connr->timer = uip_connr->rto;
+      uip_connr->nrtx = 0;
+      uip_connr->len -= acked;
+    }
+  } else
+#endif /* UIP_TCP_WINDOW_SEGMENTS > 1 */
   if((UIP_TCP_BUF->flags & TCP_ACK) && uip_outstanding(uip_connr)) {
     uip_add32(uip_connr->snd_nxt, uip_connr->len);
 
@@ -1857,18 +2041,7 @@ uip_process(uint8_t flag)
    
       /* Do RTT estimation, unless we have done retransmissions. */
       if(uip_connr->nrtx == 0) {
-        signed char m;
-        m = uip_connr->rto - uip_connr->timer;
-        /* This is taken directly from VJs original code in his paper */
-        m = m - (uip_connr->sa >> 3);
-        uip_connr->sa += m;
-        if(m < 0) {
-          m = -m;
-        }
-        m = m - (uip_connr->sv >> 2);
-        uip_connr->sv += m;
-        uip_connr->rto = (uip_connr->sa >> 3) + uip_connr->sv;
-
+        tcp_update_rto(uip_connr);
       }
       /* Set the acknowledged flag. */
       uip_flags = UIP_ACKDATA;
@@ -2045,6 +2218,9 @@ uip_process(uint8_t flag)
          "persistent timer" and uses the retransmission mechanim.
       */
       tmp16 = ((uint16_t)UIP_TCP_BUF->wnd[0] << 8) + (uint16_t)UIP_TCP_BUF->wnd[1];
+#if UIP_TCP_WINDOW_SEGMENTS > 1
+      uip_connr->snd_wnd = tmp16;
+#endif /* UIP_TCP_WINDOW_SEGMENTS > 1 */
       if(tmp16 > uip_connr->initialmss ||
          tmp16 == 0) {
         tmp16 = uip_connr->initialmss;
@@ -2090,6 +2266,25 @@ uip_process(uint8_t flag)
         }
 
         /* If uip_slen > 0, the application has data to be sent. */
+#if UIP_TCP_WINDOW_SEGMENTS > 1
+        if(uip_slen > 0 && uip_connr->segments > 0) {
+          /* A windowed connection sends new data after the data in
+             flight, as long as the window is not full. */
+          tmp16 = tcp_window(uip_connr);
+          if(uip_connr->len >= tmp16) {
+            uip_slen = 0;
+          } else {
+            if(uip_slen > uip_connr->mss) {
+              uip_slen = uip_connr->mss;
+            }
+            if(uip_slen > tmp16 - uip_connr->len) {
+              uip_slen = tmp16 - uip_connr->len;
+            }
+            sndoff = uip_connr->len;
+            uip_connr->len += uip_slen;
+          }
+        } else
+#endif /* UIP_TCP_WINDOW_SEGMENTS > 1 */
         if(uip_slen > 0) {
 
           /* If the connection has acknowledged data, the contents of
@@ -2121,6 +2316,10 @@ uip_process(uint8_t flag)
             uip_slen = uip_connr->len;
           }
         }
+#if UIP_TCP_WINDOW_SEGMENTS > 1
+        /* Older data in flight keeps its retransmission count */
+        if(uip_connr->segments == 0 || uip_connr->len <= uip_slen)
+#endif /* UIP_TCP_WINDOW_SEGMENTS > 1 */
         uip_connr->nrtx = 0;
       apprexmit:
         uip_appdata = uip_sappdata;
@@ -2130,6 +2329,12 @@ uip_process(uint8_t flag)
         if(uip_slen > 0 && uip_connr->len > 0) {
           /* Add the length of the IP and TCP headers. */
           uip_len = uip_connr->len + UIP_TCPIP_HLEN;
+#if UIP_TCP_WINDOW_SEGMENTS > 1
+          if(uip_connr->segments > 0) {
+            /* A single segment of the data in flight */
+            uip_len = uip_slen + UIP_TCPIP_HLEN;
+          }
+#endif /* UIP_TCP_WINDOW_SEGMENTS > 1 */
           /* We always set the ACK flag in response packets. */
           UIP_TCP_BUF->flags = TCP_ACK | TCP_PSH;
           /* Send the packet. */
@@ -2138,6 +2343,13 @@ uip_process(uint8_t flag)
         /* If there is no data to send, just send out a pure ACK if
            there is newdata. */
         if(uip_flags & UIP_NEWDATA) {
+#if UIP_TCP_DELAYED_ACK
+          if(!(uip_connr->tcpstateflags & UIP_ACKPENDING)) {
+            /* Acknowledged with the next segment, or by the timer */
+            uip_connr->tcpstateflags |= UIP_ACKPENDING;
+            goto drop;
+          }
+#endif /* UIP_TCP_DELAYED_ACK */
           uip_len = UIP_TCPIP_HLEN;
           UIP_TCP_BUF->flags = TCP_ACK;
           goto tcp_send_noopts;
@@ -2238,6 +2450,18 @@ uip_process(uint8_t flag)
   UIP_TCP_BUF->seqno[1] = uip_connr->snd_nxt[1];
   UIP_TCP_BUF->seqno[2] = uip_connr->snd_nxt[2];
   UIP_TCP_BUF->seqno[3] = uip_connr->snd_nxt[3];
+#if UIP_TCP_WINDOW_SEGMENTS > 1
+  if(sndoff > 0) {
+    /* New data after the data in flight */
+    uip_add32(uip_connr->snd_nxt, sndoff);
+    memcpy(UIP_TCP_BUF->seqno, uip_acc32, 4);
+    sndoff = 0;
+  }
+#endif /* UIP_TCP_WINDOW_SEGMENTS > 1 */
+#if UIP_TCP_DELAYED_ACK
+  /* Every segment we send acknowledges all received data */
+  uip_connr->tcpstateflags &= ~UIP_ACKPENDING;
+#endif /* UIP_TCP_DELAYED_ACK */
 
   UIP_IP_BUF->proto = UIP_PROTO_TCP;
 
@@ -49,11 +49,26 @@
 /* This node's current frame counter value */
 static uint32_t counter;
 
+#ifdef ANTI_REPLAY_CONF_COUNTER_BASE
+/* Network-wide clock, e.g. the TSCH ASN, that the frame counter never
+ * falls behind. Counters then keep increasing across reboots, and the
+ * neighbors do not reject the frames of a rebooted node as replayed */
+uint32_t ANTI_REPLAY_CONF_COUNTER_BASE(void);
+#endif /* ANTI_REPLAY_CONF_COUNTER_BASE */
+
 /*---------------------------------------------------------------------------*/
 void
 anti_replay_set_counter(void)
 {
   frame802154_frame_counter_t reordered_counter;
+#ifdef ANTI_REPLAY_CONF_COUNTER_BASE
+  uint32_t base;
+  
+  base = ANTI_REPLAY_CONF_COUNTER_BASE();
+  if(base > counter) {
+    counter = base - 1;
+  }
+#endif /* ANTI_REPLAY_CONF_COUNTER_BASE */
   
   reordered_counter.u32 = LLSEC802154_HTONL(++counter);
   
@@ -165,19 +165,35 @@ mic(const uint8_t *extended_source_address,
 static void
 ctr(const uint8_t *extended_source_address)
 {
+  uint8_t keystream[CCM_STAR_CTR_BATCH * AES_128_BLOCK_SIZE];
   uint8_t m_len;
   uint8_t *m;
   uint8_t pos;
   uint8_t counter;
+  uint8_t blocks;
+  uint8_t i;
   
   m_len = packetbuf_datalen();
   m = (uint8_t *) packetbuf_dataptr();
   
+  /* The keystream blocks do not depend on each other: compute them in
+     batches to save per-block driver overhead */
   pos = 0;
   counter = 1;
   while(pos < m_len) {
-    ctr_step(extended_source_address, pos, m, m_len, counter++);
-    pos += AES_128_BLOCK_SIZE;
+    blocks = 0;
+    while((blocks < CCM_STAR_CTR_BATCH)
+        && (pos + blocks * AES_128_BLOCK_SIZE < m_len)) {
+      set_nonce(keystream + blocks * AES_128_BLOCK_SIZE,
+          CCM_STAR_ENCRYPTION_FLAGS, extended_source_address, counter++);
+      blocks++;
+    }
+    aes_128_encrypt_blocks(keystream, blocks);
+    
+    for(i = 0; (i < blocks * AES_128_BLOCK_SIZE) && (pos + i < m_len); i++) {
+      m[pos + i] ^= keystream[i];
+    }
+    pos += blocks * AES_128_BLOCK_SIZE;
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -52,6 +52,13 @@
 #define CCM_STAR_AUTH_FLAGS(Adata, M) ((Adata ? (1 << 6) : 0) | (((M - 2) >> 1) << 3) | 1)
 #define CCM_STAR_ENCRYPTION_FLAGS     1
 
+/* Number of CTR keystream blocks submitted to the AES driver at once */
+#ifdef CCM_STAR_CONF_CTR_BATCH
+#define CCM_STAR_CTR_BATCH CCM_STAR_CONF_CTR_BATCH
+#else /* CCM_STAR_CONF_CTR_BATCH */
+#define CCM_STAR_CTR_BATCH 8
+#endif /* CCM_STAR_CONF_CTR_BATCH */
+
 #ifdef CCM_STAR_CONF
 #define CCM_STAR CCM_STAR_CONF
 #else /* CCM_STAR_CONF */
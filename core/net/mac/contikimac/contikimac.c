@@ -201,6 +201,15 @@ static int we_are_receiving_burst = 0;
 //#define MAX_PHASE_STROBE_TIME              RTIMER_ARCH_SECOND / 60
 #define MAX_PHASE_STROBE_TIME              GUARD_TIME_MULTIPLICATOR * (RTIMER_ARCH_SECOND / 60)
 
+/* PHASE_STROBE_TIME is the time that we transmit repeated packets of len
+   bytes to a neighbor whose phase is known within uncertainty, with
+   PHASE_DRIFT_CORRECT: as long after the expected phase as the guard time
+   before it, plus a channel check and a packet, by which the acked packet
+   can be late on the phase. */
+#define PHASE_STROBE_TIME(uncertainty, len) \
+  (2 * (GUARD_TIME + (uncertainty)) + CHECK_TIME + INTER_PACKET_INTERVAL + \
+   (rtimer_clock_t)((uint32_t)(len) * RTIMER_ARCH_SECOND / 31250))
+
 #define ACK_LEN 3
 
 #include <stdio.h>
@@ -213,6 +222,8 @@ static volatile uint8_t contikimac_keep_radio_on = 0;
 static volatile unsigned char we_are_sending = 0;
 static volatile unsigned char radio_is_on = 0;
 
+struct contikimac_phase_stats contikimac_phase_stats;
+
 #define DEBUG 0
 #if DEBUG
 #include <stdio.h>
@@ -507,6 +518,7 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
   uint8_t is_broadcast = 0;
   uint8_t is_reliable = 0;
   uint8_t is_known_receiver = 0;
+  rtimer_clock_t phase_strobe_time = MAX_PHASE_STROBE_TIME;
   uint8_t collisions;
   int transmit_len;
   int ret;
@@ -583,6 +595,13 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
     }
     if(ret != PHASE_UNKNOWN) {
       is_known_receiver = 1;
+#if PHASE_DRIFT_CORRECT
+      phase_strobe_time = PHASE_STROBE_TIME(
+          phase_uncertainty(packetbuf_addr(PACKETBUF_ADDR_RECEIVER)), transmit_len);
+      if(phase_strobe_time > MAX_PHASE_STROBE_TIME) {
+        phase_strobe_time = MAX_PHASE_STROBE_TIME;
+      }
+#endif /* PHASE_DRIFT_CORRECT */
     }
 #endif /* WITH_PHASE_OPTIMIZATION */ 
   }
@@ -673,7 +692,7 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
     watchdog_periodic();
 
     if(!is_broadcast && (is_receiver_awake || is_known_receiver) &&
-       !RTIMER_CLOCK_LT(RTIMER_NOW(), t0 + MAX_PHASE_STROBE_TIME)) {
+       !RTIMER_CLOCK_LT(RTIMER_NOW(), t0 + phase_strobe_time)) {
       PRINTF("miss to %d\n", packetbuf_addr(PACKETBUF_ADDR_RECEIVER)->u8[0]);
       break;
     }
@@ -734,6 +753,19 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
 
   uint16_t strobe_duration = RTIMER_NOW() - t0;
 
+  if(!is_broadcast && !is_receiver_awake) {
+    if(is_known_receiver) {
+      contikimac_phase_stats.known++;
+      contikimac_phase_stats.known_strobe_time += strobe_duration;
+      if(got_strobe_ack) {
+        contikimac_phase_stats.hits++;
+      }
+    } else {
+      contikimac_phase_stats.unknown++;
+      contikimac_phase_stats.unknown_strobe_time += strobe_duration;
+    }
+  }
+
   PRINTF("contikimac: send (strobes=%u, len=%u, %s, %s), done\n", strobes,
          packetbuf_totlen(),
          got_strobe_ack ? "ack" : "no ack",
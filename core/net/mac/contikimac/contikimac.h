@@ -46,4 +46,16 @@
 
 extern const struct rdc_driver contikimac_driver;
 
+/* Unicasts to neighbors whose phase is known or not, to compare phase-lock
+ * settings: how often the phase is hit (the packet acked within the phase
+ * strobe), and the strobe time spent, in rtimer ticks */
+struct contikimac_phase_stats {
+  uint32_t known;
+  uint32_t hits;
+  uint32_t known_strobe_time;
+  uint32_t unknown;
+  uint32_t unknown_strobe_time;
+};
+extern struct contikimac_phase_stats contikimac_phase_stats;
+
 #endif /* CONTIKIMAC_H */
@@ -51,6 +51,10 @@
 #include "lib/list.h"
 #include "lib/memb.h"
 
+#if CSMA_WITH_STATS
+#include "net/nbr-table.h"
+#endif /* CSMA_WITH_STATS */
+
 #include <string.h>
 
 #include <stdio.h>
@@ -124,6 +128,81 @@ LIST(neighbor_list);
 static void packet_sent(void *ptr, int status, int num_transmissions);
 static void transmit_packet_list(void *ptr);
 
+#if CSMA_WITH_STATS
+/* Kept in a neighbor table, as neighbor queues are freed when empty */
+NBR_TABLE(struct csma_neighbor_stats, csma_stats);
+static struct csma_neighbor_stats broadcast_stats;
+
+/*---------------------------------------------------------------------------*/
+static struct csma_neighbor_stats *
+stats_from_addr(const linkaddr_t *addr, int create)
+{
+  struct csma_neighbor_stats *s;
+  if(linkaddr_cmp(addr, &linkaddr_null)) {
+    return &broadcast_stats;
+  }
+  s = nbr_table_get_from_lladdr(csma_stats, addr);
+  if(s == NULL && create) {
+    s = nbr_table_add_lladdr(csma_stats, addr);
+    if(s != NULL) {
+      memset(s, 0, sizeof(*s));
+      s->window_start = clock_time();
+    }
+  }
+  return s;
+}
+/*---------------------------------------------------------------------------*/
+/* Adds bytes to the current window, closing it first if it is over.
+ * After a silence of two windows or more, the rate restarts from the
+ * last window alone */
+static void
+update_rate(struct csma_neighbor_stats *s, uint16_t bytes)
+{
+  clock_time_t now = clock_time();
+  clock_time_t elapsed = now - s->window_start;
+  if(elapsed >= CSMA_RATE_WINDOW) {
+    uint32_t window_rate = (uint32_t)s->window_bytes * CLOCK_SECOND / elapsed;
+    if(elapsed < 2 * CSMA_RATE_WINDOW) {
+      window_rate = (s->rate + window_rate) / 2;
+    }
+    s->rate = window_rate;
+    s->window_bytes = 0;
+    s->window_start = now;
+  }
+  s->window_bytes += bytes;
+}
+/*---------------------------------------------------------------------------*/
+const struct csma_neighbor_stats *
+csma_get_neighbor_stats(const linkaddr_t *addr)
+{
+  struct csma_neighbor_stats *s = stats_from_addr(addr, 0);
+  if(s != NULL) {
+    update_rate(s, 0);
+  }
+  return s;
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_stats(uint16_t id, struct csma_neighbor_stats *s)
+{
+  update_rate(s, 0);
+  printf("CSMA: nbr %u packets %u drops %u tx %u collisions %u bursts %u bytes %lu rate %u\n",
+         id, s->packets, s->drops, s->transmissions, s->collisions,
+         s->bursts, (unsigned long)s->bytes, s->rate);
+}
+/*---------------------------------------------------------------------------*/
+void
+csma_print_stats(void)
+{
+  struct csma_neighbor_stats *s;
+  print_stats(0, &broadcast_stats);
+  for(s = nbr_table_head(csma_stats); s != NULL;
+      s = nbr_table_next(csma_stats, s)) {
+    print_stats(LOG_NODEID_FROM_LINKADDR(nbr_table_get_lladdr(csma_stats, s)), s);
+  }
+}
+#endif /* CSMA_WITH_STATS */
+
 /*---------------------------------------------------------------------------*/
 static struct neighbor_queue *
 neighbor_queue_from_addr(const linkaddr_t *addr)
@@ -162,6 +241,12 @@ transmit_packet_list(void *ptr)
   if(n) {
     struct rdc_buf_list *q = list_head(n->queued_packet_list);
     if(q != NULL) {
+#if CSMA_WITH_STATS
+      struct csma_neighbor_stats *s = stats_from_addr(&n->addr, 1);
+      if(s != NULL) {
+        s->bursts++;
+      }
+#endif /* CSMA_WITH_STATS */
       PRINTF("csma: preparing number %d %p, queue len %d\n", n->transmissions, q,
           list_length(n->queued_packet_list));
       /* Send packets in the neighbor's list */
@@ -171,7 +256,7 @@ transmit_packet_list(void *ptr)
 }
 /*---------------------------------------------------------------------------*/
 static void
-free_packet(struct neighbor_queue *n, struct rdc_buf_list *p)
+free_packet(struct neighbor_queue *n, struct rdc_buf_list *p, int status)
 {
   if(p != NULL) {
     /* Remove packet from list and deallocate */
@@ -187,8 +272,10 @@ free_packet(struct neighbor_queue *n, struct rdc_buf_list *p)
       n->transmissions = 0;
       n->collisions = 0;
       n->deferrals = 0;
-      /* Set a timer for next transmissions */
-      ctimer_set(&n->transmit_timer, default_timebase(),
+      /* Set a timer for next transmissions. After a success the channel
+         is ours: carry on with the rest of the queue */
+      ctimer_set(&n->transmit_timer,
+                 (CSMA_BURST && status == MAC_TX_OK) ? 0 : default_timebase(),
                  transmit_packet_list, n);
     } else {
       /* This was the last packet in the queue, we free the neighbor */
@@ -211,11 +298,32 @@ packet_sent(void *ptr, int status, int num_transmissions)
   int num_tx;
   int backoff_exponent;
   int backoff_transmissions;
+#if CSMA_WITH_STATS
+  struct csma_neighbor_stats *s;
+#endif /* CSMA_WITH_STATS */
 
   n = ptr;
   if(n == NULL) {
     return;
   }
+#if CSMA_WITH_STATS
+  s = stats_from_addr(&n->addr, 1);
+  if(s != NULL) {
+    switch(status) {
+    case MAC_TX_OK:
+      s->packets++;
+      s->bytes += packetbuf_datalen();
+      update_rate(s, packetbuf_datalen());
+      /* Fall through */
+    case MAC_TX_NOACK:
+      s->transmissions += num_transmissions;
+      break;
+    case MAC_TX_COLLISION:
+      s->collisions += num_transmissions;
+      break;
+    }
+  }
+#endif /* CSMA_WITH_STATS */
   switch(status) {
   case MAC_TX_OK:
   case MAC_TX_NOACK:
@@ -293,7 +401,12 @@ packet_sent(void *ptr, int status, int num_transmissions)
         } else {
           PRINTF("csma: drop with status %d after %d transmissions, %d collisions\n",
                  status, n->transmissions, n->collisions);
-          free_packet(n, q);
+#if CSMA_WITH_STATS
+          if(s != NULL) {
+            s->drops++;
+          }
+#endif /* CSMA_WITH_STATS */
+          free_packet(n, q, status);
           mac_call_sent_callback(sent, cptr, status, num_tx);
         }
       } else {
@@ -301,8 +414,13 @@ packet_sent(void *ptr, int status, int num_transmissions)
           PRINTF("csma: rexmit ok %d\n", n->transmissions);
         } else {
           PRINTF("csma: rexmit failed %d: %d\n", n->transmissions, status);
+#if CSMA_WITH_STATS
+          if(s != NULL) {
+            s->drops++;
+          }
+#endif /* CSMA_WITH_STATS */
         }
-        free_packet(n, q);
+        free_packet(n, q, status);
         mac_call_sent_callback(sent, cptr, status, num_tx);
       }
     } else {
@@ -455,6 +573,9 @@ init(void)
   memb_init(&packet_memb);
   memb_init(&metadata_memb);
   memb_init(&neighbor_memb);
+#if CSMA_WITH_STATS
+  nbr_table_register(csma_stats, NULL);
+#endif /* CSMA_WITH_STATS */
 }
 /*---------------------------------------------------------------------------*/
 const struct mac_driver csma_driver = {
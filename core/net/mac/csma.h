@@ -42,7 +42,52 @@
 #define CSMA_H_
 
 #include "net/mac/mac.h"
+#include "net/linkaddr.h"
 #include "dev/radio.h"
+#include "sys/clock.h"
+
+/* After a successful transmission, the next packet queued for the same
+ * neighbor is sent right away instead of after a channel check interval,
+ * so that the RDC sends the whole queue in a burst (send_list) */
+#ifdef CSMA_CONF_BURST
+#define CSMA_BURST CSMA_CONF_BURST
+#else
+#define CSMA_BURST 1
+#endif
+
+/* Per-neighbor transmission statistics and throughput */
+#ifdef CSMA_CONF_WITH_STATS
+#define CSMA_WITH_STATS CSMA_CONF_WITH_STATS
+#else
+#define CSMA_WITH_STATS 0
+#endif
+
+/* Throughput is metered over windows of this length */
+#ifdef CSMA_CONF_RATE_WINDOW
+#define CSMA_RATE_WINDOW CSMA_CONF_RATE_WINDOW
+#else
+#define CSMA_RATE_WINDOW (10 * CLOCK_SECOND)
+#endif
+
+#if CSMA_WITH_STATS
+struct csma_neighbor_stats {
+  uint16_t packets; /* Packets sent successfully */
+  uint16_t drops; /* Packets dropped */
+  uint16_t transmissions; /* Transmissions, including retransmissions */
+  uint16_t collisions; /* Transmissions deferred on a busy channel */
+  uint16_t bursts; /* Calls to the RDC's send_list */
+  uint32_t bytes; /* Payload bytes sent successfully */
+  uint16_t rate; /* Throughput (bytes/s), averaged over the last windows */
+  uint16_t window_bytes; /* Bytes sent in the current window */
+  clock_time_t window_start;
+};
+
+/* Returns the statistics of a neighbor, linkaddr_null for broadcast,
+ * NULL if we never sent to it */
+const struct csma_neighbor_stats *csma_get_neighbor_stats(const linkaddr_t *addr);
+/* Prints the statistics of all neighbors */
+void csma_print_stats(void);
+#endif /* CSMA_WITH_STATS */
 
 extern const struct mac_driver csma_driver;
 
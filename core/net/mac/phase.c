@@ -46,16 +46,15 @@
 #include "net/queuebuf.h"
 #include "net/nbr-table.h"
 
-#if PHASE_CONF_DRIFT_CORRECT
-#define PHASE_DRIFT_CORRECT PHASE_CONF_DRIFT_CORRECT
-#else
-#define PHASE_DRIFT_CORRECT 0
-#endif
-
 struct phase {
   rtimer_clock_t time;
 #if PHASE_DRIFT_CORRECT
-  rtimer_clock_t drift;
+  /* When time was last measured, in seconds */
+  unsigned long updated;
+  /* Drift of the neighbor's phase, and how much the measurements
+   * deviate from it, in ticks per PHASE_DRIFT_PERIOD */
+  int32_t drift;
+  int32_t error;
 #endif
   uint8_t noacks;
   struct timer noacks_timer;
@@ -79,6 +78,13 @@ struct phase_queueitem {
 MEMB(queued_packets_memb, struct phase_queueitem, PHASE_QUEUESIZE);
 NBR_TABLE(struct phase, nbr_phase);
 
+#if PHASE_DRIFT_CORRECT
+/* Beyond any cycle, half the range of rtimer_clock_t */
+#define PHASE_UNCERTAINTY_MAX 0x7fff
+/* The cycle of the MAC layer, from phase_wait */
+static rtimer_clock_t mac_cycle_time;
+#endif
+
 #define DEBUG 0
 #if DEBUG
 #include <stdio.h>
@@ -89,6 +95,75 @@ NBR_TABLE(struct phase, nbr_phase);
 #define PRINTDEBUG(...)
 #endif
 /*---------------------------------------------------------------------------*/
+#if PHASE_DRIFT_CORRECT
+/* The phase of e predicted for now, from its time and drift */
+static rtimer_clock_t
+predicted_time(const struct phase *e, unsigned long now)
+{
+  return e->time + (int32_t)(e->drift * (int32_t)(now - e->updated)
+                             / PHASE_DRIFT_PERIOD);
+}
+/*---------------------------------------------------------------------------*/
+static rtimer_clock_t
+uncertainty(const struct phase *e, unsigned long now)
+{
+  /* The current second is not over */
+  unsigned long age = now - e->updated + 1;
+  int32_t u;
+
+  if(age > PHASE_DRIFT_PERIOD * 64) {
+    return PHASE_UNCERTAINTY_MAX;
+  }
+  u = e->error * (int32_t)age / PHASE_DRIFT_PERIOD;
+  return u < PHASE_UNCERTAINTY_MAX ? u : PHASE_UNCERTAINTY_MAX;
+}
+/*---------------------------------------------------------------------------*/
+static void
+reset_drift(struct phase *e)
+{
+  e->updated = clock_seconds();
+  e->drift = 0;
+  e->error = PHASE_DRIFT_MAX;
+}
+/*---------------------------------------------------------------------------*/
+/* Learns the drift of e from a new measurement of its phase */
+static void
+update_drift(struct phase *e, rtimer_clock_t time)
+{
+  unsigned long now = clock_seconds();
+  int32_t age = now - e->updated;
+  int32_t shift, rate;
+
+  if(age == 0 || mac_cycle_time == 0) {
+    /* Too recent to tell a drift from jitter */
+    return;
+  }
+  /* How far the phase moved from the prediction, within a cycle */
+  shift = (rtimer_clock_t)(time - predicted_time(e, now)) % mac_cycle_time;
+  if(shift >= mac_cycle_time / 2) {
+    shift -= mac_cycle_time;
+  }
+  if(shift > mac_cycle_time / 4 || shift < -(int32_t)mac_cycle_time / 4) {
+    /* Not a drift: the neighbor rebooted */
+    reset_drift(e);
+    return;
+  }
+  rate = shift * PHASE_DRIFT_PERIOD / age;
+  /* Moving averages, with the drift bounded by the crystals' tolerance */
+  e->drift += rate / 8;
+  if(e->drift > PHASE_DRIFT_MAX) {
+    e->drift = PHASE_DRIFT_MAX;
+  } else if(e->drift < -PHASE_DRIFT_MAX) {
+    e->drift = -PHASE_DRIFT_MAX;
+  }
+  e->error = (3 * e->error + (rate >= 0 ? rate : -rate)) / 4;
+  if(e->error == 0) {
+    e->error = 1;
+  }
+  e->updated = now;
+}
+#endif /* PHASE_DRIFT_CORRECT */
+/*---------------------------------------------------------------------------*/
 void
 phase_update(const linkaddr_t *neighbor, rtimer_clock_t time,
              int mac_status)
@@ -100,7 +175,7 @@ phase_update(const linkaddr_t *neighbor, rtimer_clock_t time,
   if(e != NULL) {
     if(mac_status == MAC_TX_OK) {
 #if PHASE_DRIFT_CORRECT
-      e->drift = time-e->time;
+      update_drift(e, time);
 #endif
       e->time = time;
     }
@@ -128,9 +203,9 @@ phase_update(const linkaddr_t *neighbor, rtimer_clock_t time,
       if(e) {
         e->time = time;
 #if PHASE_DRIFT_CORRECT
-      e->drift = 0;
+        reset_drift(e);
 #endif
-      e->noacks = 0;
+        e->noacks = 0;
       }
     }
   }
@@ -189,11 +264,13 @@ phase_wait(const linkaddr_t *neighbor, rtimer_clock_t cycle_time,
 
 #if PHASE_DRIFT_CORRECT
     {
-      int32_t s;
-      if(e->drift > cycle_time) {
-        s = e->drift % cycle_time / (e->drift / cycle_time);  /* drift per cycle */
-        s = s * (now - sync) / cycle_time;                    /* estimated drift to now */
-        sync += s;                                            /* add it in */
+      unsigned long seconds = clock_seconds();
+      mac_cycle_time = cycle_time;
+      sync = predicted_time(e, seconds);
+      guard_time += uncertainty(e, seconds);
+      if(guard_time >= cycle_time / 2) {
+        /* Lost track of the phase, until the next update */
+        return PHASE_UNKNOWN;
       }
     }
 #endif
@@ -240,6 +317,18 @@ phase_wait(const linkaddr_t *neighbor, rtimer_clock_t cycle_time,
   return PHASE_UNKNOWN;
 }
 /*---------------------------------------------------------------------------*/
+rtimer_clock_t
+phase_uncertainty(const linkaddr_t *neighbor)
+{
+#if PHASE_DRIFT_CORRECT
+  struct phase *e = nbr_table_get_from_lladdr(nbr_phase, neighbor);
+  if(e != NULL) {
+    return uncertainty(e, clock_seconds());
+  }
+#endif
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
 void
 phase_init(void)
 {
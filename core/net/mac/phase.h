@@ -47,6 +47,32 @@
 #include "lib/memb.h"
 #include "net/netstack.h"
 
+/* Learn the clock drift of every neighbor, to predict its phase, and how
+ * uncertain the prediction gets with time since the last update. The guard
+ * time before the predicted phase grows with this uncertainty, instead of
+ * covering the worst case. Neighbors are looked up in a neighbor table,
+ * hashed with NBR_TABLE_CONF_HASH */
+#ifdef PHASE_CONF_DRIFT_CORRECT
+#define PHASE_DRIFT_CORRECT PHASE_CONF_DRIFT_CORRECT
+#else
+#define PHASE_DRIFT_CORRECT 0
+#endif
+
+/* Drifts are in rtimer ticks per PHASE_DRIFT_PERIOD seconds */
+#ifdef PHASE_CONF_DRIFT_PERIOD
+#define PHASE_DRIFT_PERIOD PHASE_CONF_DRIFT_PERIOD
+#else
+#define PHASE_DRIFT_PERIOD 64
+#endif
+
+/* The largest drift, assumed until measured: 40 ppm, two crystals of
+ * 20 ppm */
+#ifdef PHASE_CONF_DRIFT_MAX
+#define PHASE_DRIFT_MAX PHASE_CONF_DRIFT_MAX
+#else
+#define PHASE_DRIFT_MAX ((int32_t)((uint32_t)RTIMER_ARCH_SECOND * PHASE_DRIFT_PERIOD / 25000))
+#endif
+
 typedef enum {
   PHASE_UNKNOWN,
   PHASE_SEND_NOW,
@@ -62,5 +88,8 @@ phase_status_t phase_wait(const linkaddr_t *neighbor,
 void phase_update(const linkaddr_t *neighbor,
                   rtimer_clock_t time, int mac_status);
 void phase_remove(const linkaddr_t *neighbor);
+/* How far the phase of neighbor may be from its prediction, in rtimer
+ * ticks. 0 without PHASE_DRIFT_CORRECT or phase */
+rtimer_clock_t phase_uncertainty(const linkaddr_t *neighbor);
 
 #endif /* PHASE_H */
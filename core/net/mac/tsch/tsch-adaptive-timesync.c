@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         TSCH adaptive time synchronization: learns the clock skew with
+ *         the network from successive drift corrections, and compensates
+ *         for it at every wake up.
+ *
+ */
+
+#include "contiki.h"
+#include "net/mac/tsch/tsch-private.h"
+#include "net/mac/tsch/tsch-adaptive-timesync.h"
+
+#if TSCH_ADAPTIVE_TIMESYNC
+
+/* Skew is stored in ticks per 2^DRIFT_SHIFT ticks */
+#define DRIFT_SHIFT 24
+/* Weight of the last estimate in the running average: 1/2^AVG_SHIFT */
+#define AVG_SHIFT 2
+
+/* Learned skew */
+static int32_t drift_rate;
+/* Number of estimates that went into drift_rate */
+static uint8_t drift_samples;
+/* Time source we learn from */
+static const struct tsch_neighbor *time_source;
+/* Since the last estimate: timeslots elapsed, corrections from the time
+ * source, and compensations we applied ourselves */
+static uint32_t pending_asn;
+static int32_t pending_correction;
+static int32_t compensated_ticks;
+/* Fractional part of the compensation, carried over to the next wake up */
+static int32_t compensation_remainder;
+
+/*---------------------------------------------------------------------------*/
+/* Learn from a drift correction of drift_correction ticks, applied to
+ * synchronize with time source n, time_delta_asn timeslots after the
+ * previous synchronization */
+void
+tsch_timesync_update(const struct tsch_neighbor *n, uint32_t time_delta_asn, int32_t drift_correction)
+{
+  int32_t estimate;
+
+  if(n != time_source) {
+    /* Corrections from the previous time source do not add up with
+     * corrections from this one, start a new interval */
+    time_source = n;
+    tsch_timesync_reset();
+    return;
+  }
+
+  pending_asn += time_delta_asn;
+  pending_correction += drift_correction;
+  if(pending_asn < TSCH_CLOCK_TO_SLOTS(TSCH_ADAPTIVE_TIMESYNC_MIN_INTERVAL)) {
+    /* Too short an interval, a single tick would be a large skew */
+    return;
+  }
+
+  /* Total deviation over the interval: what we corrected after the fact,
+   * plus what we had already compensated for */
+  estimate = (int32_t)((((int64_t)pending_correction + compensated_ticks) << DRIFT_SHIFT)
+      / ((int64_t)pending_asn * TsSlotDuration));
+  if(drift_samples == 0) {
+    drift_rate = estimate;
+  } else {
+    drift_rate += (estimate - drift_rate) >> AVG_SHIFT;
+  }
+  if(drift_samples < 0xff) {
+    drift_samples++;
+  }
+
+  pending_asn = 0;
+  pending_correction = 0;
+  compensated_ticks = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the number of ticks to add to a wake up delta_ticks from now */
+int32_t
+tsch_timesync_adaptive_compensate(rtimer_clock_t delta_ticks)
+{
+  int64_t amount;
+  int32_t result;
+
+  if(drift_samples == 0) {
+    return 0;
+  }
+
+  amount = (int64_t)delta_ticks * drift_rate + compensation_remainder;
+  result = (int32_t)(amount / (1L << DRIFT_SHIFT));
+  compensation_remainder = (int32_t)(amount - (int64_t)result * (1L << DRIFT_SHIFT));
+  compensated_ticks += result;
+  return result;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the learned skew, in ppm */
+long
+tsch_timesync_get_drift_ppm(void)
+{
+  return (long)(((int64_t)drift_rate * 1000000) >> DRIFT_SHIFT);
+}
+/*---------------------------------------------------------------------------*/
+/* Start learning over, e.g. when leaving the network. The skew learned
+ * so far is kept, as it is a property of our clock */
+void
+tsch_timesync_reset(void)
+{
+  pending_asn = 0;
+  pending_correction = 0;
+  compensated_ticks = 0;
+}
+/*---------------------------------------------------------------------------*/
+
+#endif /* TSCH_ADAPTIVE_TIMESYNC */
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         TSCH adaptive time synchronization: learns the clock skew with
+ *         the network from successive drift corrections, and compensates
+ *         for it at every wake up.
+ *
+ */
+
+#ifndef __TSCH_ADAPTIVE_TIMESYNC_H__
+#define __TSCH_ADAPTIVE_TIMESYNC_H__
+
+#include "contiki.h"
+#include "net/mac/tsch/tsch-private.h"
+
+#if TSCH_ADAPTIVE_TIMESYNC
+
+struct tsch_neighbor;
+
+/* Learn from a drift correction of drift_correction ticks, applied to
+ * synchronize with time source n, time_delta_asn timeslots after the
+ * previous synchronization */
+void tsch_timesync_update(const struct tsch_neighbor *n, uint32_t time_delta_asn, int32_t drift_correction);
+/* Returns the number of ticks to add to a wake up delta_ticks from now */
+int32_t tsch_timesync_adaptive_compensate(rtimer_clock_t delta_ticks);
+/* Returns the learned skew, in ppm */
+long tsch_timesync_get_drift_ppm(void);
+/* Start learning over, e.g. when leaving the network. The skew learned
+ * so far is kept, as it is a property of our clock */
+void tsch_timesync_reset(void);
+
+#endif /* TSCH_ADAPTIVE_TIMESYNC */
+
+#endif /* __TSCH_ADAPTIVE_TIMESYNC_H__ */
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         TSCH link estimator: per-neighbor link quality from unicast Tx
+ *         outcomes, per-channel ACKs, RSSI and EB reception, exposed as an
+ *         ETX for the routing layer.
+ *
+ */
+
+#include "contiki.h"
+#include "net/nbr-table.h"
+#include "net/mac/mac.h"
+#include "net/mac/tsch/tsch-private.h"
+#include "net/mac/tsch/tsch-link-estimator.h"
+
+#if TSCH_WITH_LINK_ESTIMATOR
+
+/* Weights (in percent) of the previous ETX in the running average, for
+ * the first few packets and afterwards */
+#define ETX_EARLY_THRESHOLD 4
+#define ETX_EARLY_ALPHA 50
+#define ETX_ALPHA 80
+/* ETX of a packet that was never acked */
+#define NOACK_ETX (8 * TSCH_LINK_ETX_DIVISOR)
+/* Bound on the ETX estimated from Rx only */
+#define MAX_RX_ETX (3 * TSCH_LINK_ETX_DIVISOR)
+/* RSSI range mapped linearly to a PRR of 0..1, as in rpl_init_link_metric */
+#define MIN_RSSI -90
+#define MAX_RSSI -60
+/* EB inter-arrivals longer than this restart the measurement (slots) */
+#define MAX_EB_INTERVAL 0xffff
+/* Lowest EB reception ratio we account for, in percent */
+#define MIN_EB_RATIO 33
+
+NBR_TABLE(struct tsch_link_estimate, link_estimates);
+
+/*---------------------------------------------------------------------------*/
+static struct tsch_link_estimate *
+get_or_add(const linkaddr_t *addr)
+{
+  struct tsch_link_estimate *le = nbr_table_get_from_lladdr(link_estimates, addr);
+  if(le == NULL) {
+    le = nbr_table_add_lladdr(link_estimates, addr);
+  }
+  return le;
+}
+/*---------------------------------------------------------------------------*/
+/* ETX estimated from Rx only: the RSSI gives a PRR, scaled down by the
+ * share of EBs received */
+static uint16_t
+rx_etx(const struct tsch_link_estimate *le)
+{
+  int16_t rssi = le->rssi;
+  uint32_t etx;
+
+  if(rssi > MAX_RSSI) {
+    rssi = MAX_RSSI;
+  } else if(rssi < MIN_RSSI + 1) {
+    rssi = MIN_RSSI + 1;
+  }
+  etx = (uint32_t)(MAX_RSSI - MIN_RSSI) * TSCH_LINK_ETX_DIVISOR / (rssi - MIN_RSSI);
+
+  /* Compare the average EB inter-arrival to the shortest one, which
+   * approximates the sender's EB period */
+  if(le->eb_count >= 3 && le->eb_interval > 0) {
+    uint16_t ratio = (uint32_t)le->eb_interval_min * 100 / le->eb_interval;
+    if(ratio < MIN_EB_RATIO) {
+      ratio = MIN_EB_RATIO;
+    }
+    etx = etx * 100 / ratio;
+  }
+
+  return etx > MAX_RX_ETX ? MAX_RX_ETX : etx;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_link_estimator_packet_sent(const linkaddr_t *addr, int status, int transmissions,
+                                uint16_t noack_channels, uint8_t ack_channel)
+{
+  struct tsch_link_estimate *le;
+  uint16_t packet_etx;
+  int alpha;
+
+  /* Collisions and errors say nothing about the link */
+  if(status != MAC_TX_OK && status != MAC_TX_NOACK) {
+    return;
+  }
+  if((le = get_or_add(addr)) == NULL) {
+    return;
+  }
+
+  le->noack_channels |= noack_channels;
+  if(ack_channel >= 11 && ack_channel <= 26) {
+    le->noack_channels &= ~(1 << (ack_channel - 11));
+  }
+
+  packet_etx = status == MAC_TX_OK ? transmissions * TSCH_LINK_ETX_DIVISOR : NOACK_ETX;
+  if(le->tx_count == 0) {
+    /* Start from what we know from Rx, or from the packet itself */
+    le->etx = le->rx_count > 0 ? rx_etx(le) : packet_etx;
+  }
+  alpha = le->tx_count < ETX_EARLY_THRESHOLD ? ETX_EARLY_ALPHA : ETX_ALPHA;
+  le->etx = ((uint32_t)le->etx * alpha + (uint32_t)packet_etx * (100 - alpha)) / 100;
+  if(le->tx_count < 255) {
+    le->tx_count++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_link_estimator_packet_received(const linkaddr_t *addr, int16_t rssi)
+{
+  struct tsch_link_estimate *le;
+
+  if((le = get_or_add(addr)) == NULL) {
+    return;
+  }
+  if(le->rx_count == 0) {
+    le->rssi = rssi;
+  } else {
+    /* Average with a weight of 1/4 for the new sample */
+    le->rssi = (3 * (int16_t)le->rssi + rssi) / 4;
+  }
+  if(le->rx_count < 255) {
+    le->rx_count++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_link_estimator_eb_received(const linkaddr_t *addr, const struct asn_t *asn)
+{
+  struct tsch_link_estimate *le;
+  uint32_t interval;
+
+  if((le = get_or_add(addr)) == NULL) {
+    return;
+  }
+  if(le->eb_count > 0) {
+    interval = ASN_DIFF(*asn, le->last_eb_asn);
+    if(interval == 0 || interval > MAX_EB_INTERVAL) {
+      /* Duplicate, or too long ago to compare: start over */
+      le->eb_count = 0;
+    } else if(le->eb_count == 1) {
+      le->eb_interval = interval;
+      le->eb_interval_min = interval;
+    } else {
+      le->eb_interval = (3 * (uint32_t)le->eb_interval + interval) / 4;
+      if(interval < le->eb_interval_min) {
+        le->eb_interval_min = interval;
+      }
+    }
+  }
+  le->last_eb_asn = *asn;
+  if(le->eb_count < 255) {
+    le->eb_count++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+const struct tsch_link_estimate *
+tsch_link_estimator_get(const linkaddr_t *addr)
+{
+  return nbr_table_get_from_lladdr(link_estimates, addr);
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+tsch_link_estimator_get_etx(const linkaddr_t *addr)
+{
+  const struct tsch_link_estimate *le = tsch_link_estimator_get(addr);
+  if(le == NULL) {
+    return 0;
+  }
+  if(le->tx_count > 0) {
+    return le->etx;
+  }
+  return le->rx_count > 0 ? rx_etx(le) : 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_link_estimator_evict_score(const linkaddr_t *addr)
+{
+  uint16_t etx = tsch_link_estimator_get_etx(addr);
+  if(etx == 0) {
+    return 0;
+  }
+  /* At least 1 for any known neighbor */
+  return etx < 0x7fff ? 0x7fff - etx : 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_link_estimator_init(void)
+{
+  nbr_table_register(link_estimates, NULL);
+}
+/*---------------------------------------------------------------------------*/
+
+#endif /* TSCH_WITH_LINK_ESTIMATOR */
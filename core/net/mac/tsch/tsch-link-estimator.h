@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         TSCH link estimator: per-neighbor link quality from unicast Tx
+ *         outcomes, per-channel ACKs, RSSI and EB reception, exposed as an
+ *         ETX for the routing layer.
+ *
+ */
+
+#ifndef __TSCH_LINK_ESTIMATOR_H__
+#define __TSCH_LINK_ESTIMATOR_H__
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+#include "net/mac/tsch/tsch-private.h"
+
+#if TSCH_WITH_LINK_ESTIMATOR
+
+/* ETX fixed-point divisor: an ETX of 1 is TSCH_LINK_ETX_DIVISOR */
+#define TSCH_LINK_ETX_DIVISOR 128
+
+/* Link estimate of a neighbor */
+struct tsch_link_estimate {
+  /* Running average of the ETX of unicast packets, valid if tx_count > 0 */
+  uint16_t etx;
+  /* Running average of EB inter-arrival, and shortest seen, in slots */
+  uint16_t eb_interval;
+  uint16_t eb_interval_min;
+  /* Channels (bit channel - 11) where the last unicast attempt was not acked */
+  uint16_t noack_channels;
+  struct asn_t last_eb_asn;
+  /* Running average of the RSSI, valid if rx_count > 0 */
+  int8_t rssi;
+  /* Unicast packets sent with a known outcome, frames and EBs received.
+   * All saturate at 255 */
+  uint8_t tx_count;
+  uint8_t rx_count;
+  uint8_t eb_count;
+};
+
+/* Initialize the link estimator */
+void tsch_link_estimator_init(void);
+/* Update from the outcome of a unicast packet sent in transmissions
+ * attempts. noack_channels: channels of the unacked attempts, ack_channel:
+ * channel of the acked attempt or 0 */
+void tsch_link_estimator_packet_sent(const linkaddr_t *addr, int status, int transmissions,
+                                     uint16_t noack_channels, uint8_t ack_channel);
+/* Update from a frame received from addr */
+void tsch_link_estimator_packet_received(const linkaddr_t *addr, int16_t rssi);
+/* Update from an EB received from addr at a given ASN */
+void tsch_link_estimator_eb_received(const linkaddr_t *addr, const struct asn_t *asn);
+/* Returns the link estimate of a neighbor, NULL if not known */
+const struct tsch_link_estimate *tsch_link_estimator_get(const linkaddr_t *addr);
+/* Returns the fused ETX to a neighbor (TSCH_LINK_ETX_DIVISOR scale):
+ * from unicast Tx if any, otherwise estimated from RSSI and EB reception.
+ * Returns 0 if nothing is known about the neighbor */
+uint16_t tsch_link_estimator_get_etx(const linkaddr_t *addr);
+/* Neighbor table eviction score (NBR_TABLE_CALLBACK_EVICT_SCORE): the
+ * better the link, the higher. Unknown neighbors score 0 */
+int tsch_link_estimator_evict_score(const linkaddr_t *addr);
+
+#endif /* TSCH_WITH_LINK_ESTIMATOR */
+
+#endif /* __TSCH_LINK_ESTIMATOR_H__ */
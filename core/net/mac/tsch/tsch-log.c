@@ -42,6 +42,7 @@
 
 #include "contiki.h"
 #include <stdio.h>
+#include <string.h>
 #include "net/mac/tsch/tsch.h"
 #include "net/mac/tsch/tsch-queue.h"
 #include "net/mac/tsch/tsch-private.h"
@@ -49,6 +50,7 @@
 #include "net/mac/tsch/tsch-packet.h"
 #include "net/mac/tsch/tsch-schedule.h"
 #include "lib/ringbufindex.h"
+#include "net/ip/uip.h"
 
 #if WITH_TSCH_LOG
 
@@ -63,21 +65,174 @@ PROCESS_NAME(tsch_pending_events_process);
 #endif
 static struct ringbufindex log_ringbuf;
 static struct tsch_log_t log_array[TSCH_MAX_LOGS];
-static int log_dropped = 0;
+static struct tsch_log_stats log_stats;
+static uint32_t last_log_dropped;
+/* The runtime filter, keeps all logs by default */
+static struct tsch_log_filter log_filter = {
+  TSCH_LOG_TYPES_ALL, TSCH_LOG_LINK_TYPES_ALL,
+  TSCH_LOG_FILTER_ANY, TSCH_LOG_FILTER_ANY, 1
+};
+/* Number of matching logs seen since the last sampled one */
+static uint16_t sample_count;
+
+#if TSCH_LOG_BINARY
+
+/* Largest binary record, before SLIP escaping */
+#define BINARY_RECORD_MAX_LEN 48
+
+/* Write a binary record to the console, SLIP-framed. The leading END
+ * separates the record from any text output that preceded it */
+static void
+binary_write(const uint8_t *buf, int len)
+{
+  putchar(TSCH_LOG_SLIP_END);
+  while(len-- > 0) {
+    if(*buf == TSCH_LOG_SLIP_END) {
+      putchar(TSCH_LOG_SLIP_ESC);
+      putchar(TSCH_LOG_SLIP_ESC_END);
+    } else if(*buf == TSCH_LOG_SLIP_ESC) {
+      putchar(TSCH_LOG_SLIP_ESC);
+      putchar(TSCH_LOG_SLIP_ESC_ESC);
+    } else {
+      putchar(*buf);
+    }
+    buf++;
+  }
+  putchar(TSCH_LOG_SLIP_END);
+}
+
+/* Little-endian field writers, return the new write pointer */
+static uint8_t *
+put_u8(uint8_t *p, uint8_t v)
+{
+  *p++ = v;
+  return p;
+}
+
+static uint8_t *
+put_u16(uint8_t *p, uint16_t v)
+{
+  *p++ = v & 0xff;
+  *p++ = v >> 8;
+  return p;
+}
+
+static uint8_t *
+put_u32(uint8_t *p, uint32_t v)
+{
+  p = put_u16(p, v & 0xffff);
+  return put_u16(p, v >> 16);
+}
+
+/* Append the seqno, hop count and end-to-end addresses of an appdata, if any */
+static uint8_t *
+put_appdata(uint8_t *p, uint8_t *flags, struct app_data *appdata)
+{
+  if(appdata->magic == UIP_HTONL(LOG_MAGIC)) {
+    *flags |= TSCH_LOG_FLAG_APPDATA;
+    p = put_u32(p, UIP_HTONL(appdata->seqno));
+    p = put_u8(p, appdata->hop);
+    p = put_u16(p, UIP_HTONS(appdata->src));
+    p = put_u16(p, UIP_HTONS(appdata->dest));
+  }
+  return p;
+}
+
+/* Encode and output a log as a binary record. Layout (little endian):
+ * magic, type, asn (5), slotframe handle, slotframe size (2), timeslot (2),
+ * channel offset (2), channel, followed by type-specific fields */
+static void
+binary_log(struct tsch_log_t *log)
+{
+  uint8_t buf[BINARY_RECORD_MAX_LEN];
+  uint8_t *p = buf;
+  uint8_t *flags;
+  int len;
+  struct tsch_slotframe *sf = tsch_schedule_get_slotframe_from_handle(log->link->slotframe_handle);
+
+  p = put_u8(p, TSCH_LOG_BINARY_MAGIC);
+  p = put_u8(p, log->type);
+  p = put_u8(p, log->asn.ms1b);
+  p = put_u32(p, log->asn.ls4b);
+  p = put_u8(p, log->link->slotframe_handle);
+  p = put_u16(p, sf ? sf->size.val : 0);
+  p = put_u16(p, log->link->timeslot);
+  p = put_u16(p, log->link->channel_offset);
+  p = put_u8(p, tsch_calculate_channel(&log->asn, log->link->channel_offset));
+
+  switch(log->type) {
+    case tsch_log_tx:
+      flags = p;
+      p = put_u8(p, (log->tx.is_data ? TSCH_LOG_FLAG_IS_DATA : 0)
+                 | (log->tx.drift_used ? TSCH_LOG_FLAG_DRIFT_USED : 0)
+                 | (log->tx.dest != 0 ? TSCH_LOG_FLAG_IS_UNICAST : 0));
+      p = put_u8(p, log->tx.datalen);
+      p = put_u16(p, log->tx.dest);
+      p = put_u8(p, log->tx.mac_tx_status);
+      p = put_u8(p, log->tx.num_tx);
+      p = put_u16(p, log->tx.drift);
+      p = put_appdata(p, flags, &log->tx.appdata);
+      break;
+    case tsch_log_rx:
+      flags = p;
+      p = put_u8(p, (log->rx.is_data ? TSCH_LOG_FLAG_IS_DATA : 0)
+                 | (log->rx.drift_used ? TSCH_LOG_FLAG_DRIFT_USED : 0)
+                 | (log->rx.is_unicast ? TSCH_LOG_FLAG_IS_UNICAST : 0));
+      p = put_u8(p, log->rx.datalen);
+      p = put_u16(p, log->rx.src);
+      p = put_u16(p, log->rx.drift);
+      p = put_u16(p, log->rx.estimated_drift);
+      p = put_appdata(p, flags, &log->rx.appdata);
+      break;
+    case tsch_log_message:
+      /* Formatting is done here, out of the link operation. The text
+       * is not nul-terminated, its length is given by the frame */
+      len = snprintf((char *)p, buf + sizeof(buf) - p, log->message.fmt,
+                     log->message.args[0], log->message.args[1],
+                     log->message.args[2], log->message.args[3]);
+      if(len > buf + sizeof(buf) - p - 1) {
+        len = buf + sizeof(buf) - p - 1;
+      }
+      p += len > 0 ? len : 0;
+      break;
+  }
+
+  binary_write(buf, p - buf);
+}
+
+/* Output the total number of dropped logs as a binary record */
+static void
+binary_log_dropped(uint16_t dropped)
+{
+  uint8_t buf[4];
+  uint8_t *p = buf;
+  p = put_u8(p, TSCH_LOG_BINARY_MAGIC);
+  p = put_u8(p, TSCH_LOG_BINARY_DROPPED);
+  p = put_u16(p, dropped);
+  binary_write(buf, p - buf);
+}
+
+#endif /* TSCH_LOG_BINARY */
 
 /* Process pending log messages */
 void
 tsch_log_process_pending()
 {
-  static int last_log_dropped = 0;
   int16_t log_index;
   /* Loop on accessing (without removing) a pending input packet */
   /* LOG("TSCH: logs in queue %u, total dropped %u\n", ringbufindex_elements(&log_ringbuf), log_dropped); */
-  if(log_dropped != last_log_dropped) {
-    LOG("TSCH:! logs dropped %u\n", log_dropped);
-    last_log_dropped = log_dropped;
+  if(log_stats.dropped != last_log_dropped) {
+    last_log_dropped = log_stats.dropped;
+#if TSCH_LOG_BINARY
+    binary_log_dropped(last_log_dropped);
+#else
+    LOG("TSCH:! logs dropped %lu\n", (unsigned long)last_log_dropped);
+#endif
   }
   while((log_index = ringbufindex_peek_get(&log_ringbuf)) != -1) {
+#if TSCH_LOG_BINARY
+    binary_log(&log_array[log_index]);
+#else /* TSCH_LOG_BINARY */
     struct tsch_log_t *log = &log_array[log_index];
     struct tsch_slotframe *sf = tsch_schedule_get_slotframe_from_handle(log->link->slotframe_handle);
     LOG("TSCH: {asn-%x.%lx link-%u-%u-%u-%u ch-%u} ",
@@ -94,7 +249,7 @@ tsch_log_process_pending()
         if(log->tx.drift_used) {
           LOG(", dr %d", log->tx.drift);
         }
-        LOGA(&log->tx.appdata, "");
+        LOGA_END(&log->tx.appdata);
         break;
       case tsch_log_rx:
         LOG("%s-%u %u rx %d",
@@ -104,31 +259,58 @@ tsch_log_process_pending()
         if(log->rx.drift_used) {
           LOG(", dr %d", log->rx.drift);
         }
-        LOGA(&log->rx.appdata,
+        LOGA_TEXT(&log->rx.appdata,
             ", edr %d", (int)log->rx.estimated_drift);
         break;
       case tsch_log_message:
-        LOG("%s\n", log->message);
+        LOG(log->message.fmt,
+            log->message.args[0], log->message.args[1],
+            log->message.args[2], log->message.args[3]);
+        LOG("\n");
         break;
     }
+#endif /* TSCH_LOG_BINARY */
     /* Remove input from ringbuf */
     ringbufindex_get(&log_ringbuf);
   }
 }
 
-/* Prepare addition of a new log.
+/* Link of the logs added outside of links, printed as all zero */
+static struct tsch_link no_link;
+
+/* Prepare addition of a new log of a given type.
  * Returns pointer to log structure if success, NULL otherwise */
 struct tsch_log_t *
-tsch_log_prepare_add()
+tsch_log_prepare_add(int type)
 {
-  int log_index = ringbufindex_peek_put(&log_ringbuf);
+  int log_index;
+
+  /* Filters that do not need the log content */
+  if(!(log_filter.types & (1 << type))
+     || (current_link != NULL
+         && (!(log_filter.link_types & (1 << current_link->link_type))
+             || (log_filter.slotframe != TSCH_LOG_FILTER_ANY
+                 && log_filter.slotframe != current_link->slotframe_handle)))) {
+    log_stats.filtered++;
+    return NULL;
+  }
+  if(log_filter.sample > 1) {
+    if(++sample_count < log_filter.sample) {
+      log_stats.filtered++;
+      return NULL;
+    }
+    sample_count = 0;
+  }
+
+  log_index = ringbufindex_peek_put(&log_ringbuf);
   if(log_index != -1) {
     struct tsch_log_t *log = &log_array[log_index];
+    log->type = type;
     log->asn = current_asn;
-    log->link = current_link;
+    log->link = current_link != NULL ? current_link : &no_link;
     return log;
   } else {
-    log_dropped++;
+    log_stats.dropped++;
     return NULL;
   }
 }
@@ -137,10 +319,54 @@ tsch_log_prepare_add()
 void
 tsch_log_commit()
 {
+  int log_index = ringbufindex_peek_put(&log_ringbuf);
+  struct tsch_log_t *log = &log_array[log_index];
+
+  /* The neighbor filter, now that the log is filled in */
+  if(log_filter.neighbor != TSCH_LOG_FILTER_ANY
+     && ((log->type == tsch_log_tx && log->tx.dest != log_filter.neighbor)
+         || (log->type == tsch_log_rx && log->rx.src != log_filter.neighbor))) {
+    log_stats.filtered++;
+    return;
+  }
+
+  log_stats.added++;
   ringbufindex_put(&log_ringbuf);
   process_poll(&tsch_pending_events_process);
 }
 
+/* Set the runtime log filter. Takes effect from the next log. The filter
+ * is read from interrupt, a log racing with the update may see an
+ * inconsistent filter, which is harmless */
+void
+tsch_log_set_filter(const struct tsch_log_filter *filter)
+{
+  log_filter = *filter;
+  sample_count = 0;
+}
+
+/* Get the current runtime log filter */
+void
+tsch_log_get_filter(struct tsch_log_filter *filter)
+{
+  *filter = log_filter;
+}
+
+/* Get the log counters */
+void
+tsch_log_get_stats(struct tsch_log_stats *stats)
+{
+  *stats = log_stats;
+}
+
+/* Reset the log counters */
+void
+tsch_log_reset_stats()
+{
+  memset(&log_stats, 0, sizeof(log_stats));
+  last_log_dropped = 0;
+}
+
 /* Initialize log module */
 void
 tsch_log_init()
@@ -43,9 +43,35 @@
 #include "contiki.h"
 #include "sys/rtimer.h"
 #include "net/mac/tsch/tsch-private.h"
+#include "net/mac/tsch/tsch-schedule.h"
 
 #if WITH_TSCH_LOG
 
+/* Emit logs as compact SLIP-framed binary records instead of text.
+ * Decode on the host with tools/tsch-log-decode */
+#ifdef TSCH_LOG_CONF_BINARY
+#define TSCH_LOG_BINARY TSCH_LOG_CONF_BINARY
+#else
+#define TSCH_LOG_BINARY 0
+#endif
+
+/* Number of integer arguments stored with a message log */
+#define TSCH_LOG_MESSAGE_ARGS 4
+
+/* Binary record framing (SLIP) and header */
+#define TSCH_LOG_SLIP_END 0xc0
+#define TSCH_LOG_SLIP_ESC 0xdb
+#define TSCH_LOG_SLIP_ESC_END 0xdc
+#define TSCH_LOG_SLIP_ESC_ESC 0xdd
+#define TSCH_LOG_BINARY_MAGIC 0xa5
+/* Record type for the dropped logs counter, follows the log types */
+#define TSCH_LOG_BINARY_DROPPED 3
+/* Flags in tx and rx records */
+#define TSCH_LOG_FLAG_IS_DATA 0x01
+#define TSCH_LOG_FLAG_DRIFT_USED 0x02
+#define TSCH_LOG_FLAG_IS_UNICAST 0x04
+#define TSCH_LOG_FLAG_APPDATA 0x08
+
 /* Structure for a log. Union of different types of logs */
 struct tsch_log_t {
   enum { tsch_log_tx,
@@ -55,7 +81,11 @@ struct tsch_log_t {
   struct asn_t asn;
   struct tsch_link *link;
   union {
-    char message[26];
+    struct {
+      /* Format string, only expanded from process context */
+      const char *fmt;
+      int args[TSCH_LOG_MESSAGE_ARGS];
+    } message;
     struct {
       struct app_data appdata;
       int mac_tx_status;
@@ -79,29 +109,76 @@ struct tsch_log_t {
   };
 };
 
-/* Prepare addition of a new log.
+/* Wildcard for the slotframe and neighbor filters */
+#define TSCH_LOG_FILTER_ANY -1
+/* Bitmap of all log types, for the type filter */
+#define TSCH_LOG_TYPES_ALL ((1 << tsch_log_tx) | (1 << tsch_log_rx) | (1 << tsch_log_message))
+/* Bitmap of all link types, for the link type filter */
+#define TSCH_LOG_LINK_TYPES_ALL ((1 << LINK_TYPE_NORMAL) | (1 << LINK_TYPE_ADVERTISING) \
+                                 | (1 << LINK_TYPE_ADVERTISING_ONLY))
+
+/* Runtime log filter. Logs are kept only if they match all criteria.
+ * Type, link type, slotframe and sampling are checked before the log is
+ * filled in, the neighbor (node id) once it is. Message logs match any
+ * neighbor */
+struct tsch_log_filter {
+  uint8_t types; /* Bitmap of (1 << log type) */
+  uint8_t link_types; /* Bitmap of (1 << link type) */
+  int16_t slotframe; /* Slotframe handle, or TSCH_LOG_FILTER_ANY */
+  int neighbor; /* Neighbor node id, or TSCH_LOG_FILTER_ANY */
+  uint16_t sample; /* Keep one in every 'sample' matching logs, 0 or 1 for all */
+};
+
+/* Log counters, since boot or last reset */
+struct tsch_log_stats {
+  uint32_t added; /* Logs queued for printout */
+  uint32_t dropped; /* Logs lost because the ringbuf was full */
+  uint32_t filtered; /* Logs discarded by the filter or by sampling */
+};
+
+/* Prepare addition of a new log of a given type.
  * Returns pointer to log structure if success, NULL otherwise */
-struct tsch_log_t *tsch_log_prepare_add();
+struct tsch_log_t *tsch_log_prepare_add(int type);
 /* Actually add the previously prepared log */
 void tsch_log_commit();
+/* Set the runtime log filter. Takes effect from the next log */
+void tsch_log_set_filter(const struct tsch_log_filter *filter);
+/* Get the current runtime log filter */
+void tsch_log_get_filter(struct tsch_log_filter *filter);
+/* Get the log counters */
+void tsch_log_get_stats(struct tsch_log_stats *stats);
+/* Reset the log counters */
+void tsch_log_reset_stats();
 /* Initialize log module */
 void tsch_log_init();
 /* Process pending log messages */
 void tsch_log_process_pending();
 
 #define TSCH_LOG_ADD(log_type, init_code) do { \
-    struct tsch_log_t *log = tsch_log_prepare_add(); \
+    struct tsch_log_t *log = tsch_log_prepare_add(log_type); \
     if(log != NULL) { \
-      log->type = (log_type); \
       init_code \
       tsch_log_commit(); \
     } \
   } while(0);
 
+/* Log a formatted message. Only the format string and arguments are stored,
+ * the message is formatted when the log is processed. Up to
+ * TSCH_LOG_MESSAGE_ARGS int arguments, pass 0 for the unused ones */
+#define TSCH_LOG_MESSAGE(f, a0, a1, a2, a3) \
+  TSCH_LOG_ADD(tsch_log_message, \
+      log->message.fmt = (f); \
+      log->message.args[0] = (int)(a0); \
+      log->message.args[1] = (int)(a1); \
+      log->message.args[2] = (int)(a2); \
+      log->message.args[3] = (int)(a3); \
+  )
+
 #else /* WITH_TSCH_LOG */
 
 #define tsch_log_init()
 #define tsch_log_process_pending()
 #define TSCH_LOG_ADD(log_type, init_code)
+#define TSCH_LOG_MESSAGE(f, a0, a1, a2, a3)
 
 #endif /* WITH_TSCH_LOG */
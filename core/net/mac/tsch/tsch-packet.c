@@ -57,6 +57,20 @@
  * FCF + seqno + pan ID + source MAC + MLME outer ID */
 #define EB_IE_SYNC_OFFSET (2+1+2+8+2)
 
+#if TSCH_PACKET_EB_WITH_TEMPLATE
+/* EB template, with seqno, ASN and join priority set to 0. Length 0: to be built */
+static uint8_t eb_template[TSCH_PACKET_EB_TEMPLATE_LEN];
+static uint8_t eb_template_len;
+#endif /* TSCH_PACKET_EB_WITH_TEMPLATE */
+
+#ifdef TSCH_CALLBACK_EB_RPL_INFO
+int TSCH_CALLBACK_EB_RPL_INFO(struct tsch_eb_rpl_info *info);
+#if TSCH_PACKET_EB_WITH_TEMPLATE
+/* The RPL state in eb_template */
+static struct tsch_eb_rpl_info eb_template_rpl_info;
+#endif /* TSCH_PACKET_EB_WITH_TEMPLATE */
+#endif /* TSCH_CALLBACK_EB_RPL_INFO */
+
 /* Parse 802.15.4e time correction IE */
 static int
 parse_ie_time_correction(uint8_t *buf, int buf_size,
@@ -87,7 +101,7 @@ parse_ie_time_correction(uint8_t *buf, int buf_size,
       if(drift != NULL) {
         *drift = US_TO_RTIMERTICKS(drift_us);
       }
-      return 1;
+      return TSCH_SYNC_IE_LEN;
     }
   }
   return 0;
@@ -174,14 +188,52 @@ append_ie_time_correction(uint8_t* const buf, int buf_size,
     return TSCH_SYNC_IE_LEN;
   }
 }
-/* Parse enhanced ACK packet, extract drift and nack */
+#if TSCH_PACKET_WITH_ACK_HINTS
+/* Header IE with our ACK hints. The element ID is not assigned in IEEE 802.15.4e */
+#define ACK_HINTS_IE_ID 0x40
+
+/* Parse our ACK hints IE */
+static int
+parse_ie_ack_hints(uint8_t *buf, int buf_size, struct tsch_ack_hints *hints)
+{
+  if(buf_size < TSCH_ACK_HINTS_IE_LEN
+      || buf[0] != TSCH_ACK_HINTS_IE_LEN - 2 || buf[1] != ACK_HINTS_IE_ID) {
+    return 0;
+  }
+  if(hints != NULL) {
+    hints->rx_free = buf[2];
+    hints->queue_len = buf[3];
+    hints->flags = buf[4];
+  }
+  return TSCH_ACK_HINTS_IE_LEN;
+}
+
+/* Update packet with our ACK hints IE */
+static int
+append_ie_ack_hints(uint8_t* const buf, int buf_size, const struct tsch_ack_hints *hints)
+{
+  if(buf_size < TSCH_ACK_HINTS_IE_LEN) {
+    return 0;
+  }
+  buf[0] = TSCH_ACK_HINTS_IE_LEN - 2;
+  buf[1] = ACK_HINTS_IE_ID;
+  buf[2] = hints->rx_free;
+  buf[3] = hints->queue_len;
+  buf[4] = hints->flags;
+  return TSCH_ACK_HINTS_IE_LEN;
+}
+#endif /* TSCH_PACKET_WITH_ACK_HINTS */
+
+/* Parse enhanced ACK packet, extract drift and nack, and hints (if non-NULL) */
 int tsch_packet_parse_sync_ack(int32_t *drift, int *nack,
-    uint8_t *ackbuf, int ackbuf_len, uint8_t seqno, int extract_sync_ie)
+    uint8_t *ackbuf, int ackbuf_len, uint8_t seqno, int extract_sync_ie,
+    struct tsch_ack_hints *hints)
 {
   if(ackbuf_len >= TSCH_BASE_ACK_LEN && 2 == ackbuf[0] && seqno == ackbuf[2]) {
     int ret;
     int is_ack = 1;
     int has_sync_ie = 0;
+    int has_hints = 0;
     int curr_len = TSCH_BASE_ACK_LEN;
 #if TSCH_PACKET_DEST_ADDR_IN_ACK
     /* Check FCF byte 1: b10-b11:dest-addr-mode=3 */
@@ -207,23 +259,34 @@ int tsch_packet_parse_sync_ack(int32_t *drift, int *nack,
     /* Check FCF byte 1: FCF byte 1: b9:IE-list-present=1 */
     /* Check FCF byte 1: b12-b13:frame version=2 */
     if((ackbuf[1] & (0x02 | 0x20)) == (0x02 | 0x20)) {
-      if(extract_sync_ie) {
-        ret = parse_ie_time_correction(&ackbuf[curr_len], ackbuf_len-curr_len, drift, nack);
-        if(ret) {
+      if(extract_sync_ie || hints != NULL) {
+        ret = parse_ie_time_correction(&ackbuf[curr_len], ackbuf_len-curr_len,
+            extract_sync_ie ? drift : NULL, extract_sync_ie ? nack : NULL);
+        if(ret && extract_sync_ie) {
           has_sync_ie = 1;
         }
         curr_len += ret;
       }
+#if TSCH_PACKET_WITH_ACK_HINTS
+      if(hints != NULL) {
+        ret = parse_ie_ack_hints(&ackbuf[curr_len], ackbuf_len-curr_len, hints);
+        if(ret) {
+          has_hints = 1;
+        }
+        curr_len += ret;
+      }
+#endif /* TSCH_PACKET_WITH_ACK_HINTS */
     }
 #endif
-    return TSCH_ACK_OK*is_ack + TSCH_ACK_HAS_SYNC_IE*has_sync_ie;
+    return TSCH_ACK_OK*is_ack + TSCH_ACK_HAS_SYNC_IE*has_sync_ie + TSCH_ACK_HAS_HINTS*has_hints;
   }
   return 0;
 }
 /* Construct enhanced ACK packet and return ACK length */
 int
 tsch_packet_make_sync_ack(int32_t drift, int nack,
-    uint8_t *ackbuf, int ackbuf_len, linkaddr_t *dest_addr, uint8_t seqno)
+    uint8_t *ackbuf, int ackbuf_len, linkaddr_t *dest_addr, uint8_t seqno,
+    const struct tsch_ack_hints *hints)
 {
   if(ackbuf_len < TSCH_ACK_LEN) {
     return 0;
@@ -245,6 +308,11 @@ tsch_packet_make_sync_ack(int32_t drift, int nack,
     ackbuf[1] |= 0x20; /* FCF byte 1: b12-b13:frame version=2 */
     /* Append IE timesync */
     curr_len += append_ie_time_correction(&ackbuf[curr_len], ackbuf_len-curr_len, drift, nack);
+#if TSCH_PACKET_WITH_ACK_HINTS
+    if(hints != NULL) {
+      curr_len += append_ie_ack_hints(&ackbuf[curr_len], ackbuf_len-curr_len, hints);
+    }
+#endif /* TSCH_PACKET_WITH_ACK_HINTS */
 #endif
     return curr_len;
   }
@@ -259,7 +327,8 @@ tsch_packet_parse_frame_type_from_fcf_lsb(uint8_t fcf_lsb)
   uint8_t is_data = (fcf_lsb & 7) == FRAME802154_DATAFRAME ? IS_DATA : 0;
   uint8_t is_ack = (fcf_lsb & 7) == FRAME802154_ACKFRAME ? IS_ACK : 0;
   uint8_t is_eb = (fcf_lsb & 7) == FRAME802154_BEACONFRAME ? IS_EB : 0;
-  return do_ack | is_data | is_ack | is_eb;
+  uint8_t frame_pending = ((fcf_lsb >> 4) & 1) == 1 ? FRAME_PENDING : 0;
+  return do_ack | is_data | is_ack | is_eb | frame_pending;
 }
 /* Extract 802.15.4 frame type from a struct packet_input */
 uint8_t
@@ -278,6 +347,19 @@ tsch_packet_parse_frame_type(uint8_t *buf, uint8_t len, uint8_t *seqno)
 
   return tsch_packet_parse_frame_type_from_fcf_lsb(fcf_lsb);
 }
+/* Set or clear the frame pending bit of a frame */
+void
+tsch_packet_set_frame_pending(uint8_t *buf, uint8_t len, int pending)
+{
+  if(len < 3) {
+    return;
+  }
+  if(pending) {
+    buf[0] |= 1 << 4;
+  } else {
+    buf[0] &= ~(1 << 4);
+  }
+}
 
 static int
 is_broadcast_addr(uint8_t mode, uint8_t *addr)
@@ -291,42 +373,113 @@ is_broadcast_addr(uint8_t mode, uint8_t *addr)
   return 1;
 }
 
+/* Rewrite the destination address of an unsecured unicast frame, whose
+ * addresses have the size of a linkaddr_t. Returns 1 on success, 0 otherwise */
+int
+tsch_packet_set_dest_address(uint8_t *buf, uint8_t len, const linkaddr_t *dest_address)
+{
+  frame802154_t frame;
+  int i;
+
+  if(!frame802154_parse(buf, len, &frame)
+     || frame.fcf.security_enabled
+     || frame.fcf.dest_addr_mode != (LINKADDR_SIZE == 2
+         ? FRAME802154_SHORTADDRMODE : FRAME802154_LONGADDRMODE)
+     || is_broadcast_addr(frame.fcf.dest_addr_mode, frame.dest_addr)) {
+    return 0;
+  }
+  /* After FCF, sequence number and destination PAN ID, in reverse byte order */
+  for(i = 0; i < LINKADDR_SIZE; i++) {
+    buf[3 + 2 + i] = dest_address->u8[LINKADDR_SIZE - 1 - i];
+  }
+  return 1;
+}
+/* Get the destination address of a frame from its first bytes only, e.g.
+ * while it is being received. dest_address is set to linkaddr_null for
+ * broadcast. Returns 1 on success, 0 if the frame has no destination
+ * address of the size of a linkaddr_t */
+int
+tsch_packet_peek_dest_address(const uint8_t *buf, uint8_t len, linkaddr_t *dest_address)
+{
+  uint8_t dest_addr_mode;
+  int i;
+
+  if(len < 3) {
+    return 0;
+  }
+  dest_addr_mode = (buf[1] >> 2) & 3;
+  if(dest_addr_mode == FRAME802154_SHORTADDRMODE && len >= 3 + 2 + 2
+     && buf[5] == 0xff && buf[6] == 0xff) {
+    linkaddr_copy(dest_address, &linkaddr_null);
+    return 1;
+  }
+  if(dest_addr_mode != (LINKADDR_SIZE == 2
+       ? FRAME802154_SHORTADDRMODE : FRAME802154_LONGADDRMODE)
+     || len < TSCH_PACKET_PEEK_LEN) {
+    return 0;
+  }
+  /* After FCF, sequence number and destination PAN ID, in reverse byte order */
+  for(i = 0; i < LINKADDR_SIZE; i++) {
+    dest_address->u8[i] = buf[3 + 2 + LINKADDR_SIZE - 1 - i];
+  }
+  if(is_broadcast_addr(dest_addr_mode, dest_address->u8)) {
+    linkaddr_copy(dest_address, &linkaddr_null);
+  }
+  return 1;
+}
 /* Extract addresses from raw packet */
 int
 tsch_packet_extract_addresses(uint8_t *buf, uint8_t len, linkaddr_t *source_address, linkaddr_t *dest_address)
 {
-  frame802154_t frame;
-  uint8_t parsed = frame802154_parse(buf, len, &frame);
+  struct tsch_packet_header hdr;
+  int parsed = tsch_packet_parse_header(buf, len, &hdr);
   if(parsed) {
+    if(source_address != NULL) {
+      linkaddr_copy(source_address, &hdr.source_address);
+    }
     if(dest_address != NULL) {
-      linkaddr_copy(dest_address, &linkaddr_null);
+      linkaddr_copy(dest_address, &hdr.dest_address);
     }
+  }
+  return parsed;
+}
+/* Parse the 802.15.4 header of a raw packet in a single pass.
+ * Returns the header length, 0 on failure */
+int
+tsch_packet_parse_header(uint8_t *buf, uint8_t len, struct tsch_packet_header *hdr)
+{
+  frame802154_t frame;
+  uint8_t parsed = frame802154_parse(buf, len, &frame);
+
+  hdr->hdr_len = 0;
+  hdr->flags = tsch_packet_parse_frame_type(buf, len, &hdr->seqno);
+  if(parsed) {
+    linkaddr_copy(&hdr->dest_address, &linkaddr_null);
     if(frame.fcf.dest_addr_mode) {
       if(frame.dest_pid != IEEE802154_PANID
           && frame.dest_pid != FRAME802154_BROADCASTPANDID) {
         /* Packet to another PAN */
-        PRINTF("tsch_packet_extract_addresses: for another pan %u\n", frame.dest_pid);
+        PRINTF("tsch_packet_parse_header: for another pan %u\n", frame.dest_pid);
         return 0;
       }
       if(!is_broadcast_addr(frame.fcf.dest_addr_mode, frame.dest_addr)) {
-        if(dest_address != NULL) {
-          linkaddr_copy(dest_address, (linkaddr_t *)frame.dest_addr);
-        }
+        linkaddr_copy(&hdr->dest_address, (linkaddr_t *)frame.dest_addr);
       }
     } else { /* broadcast (EB) packet with no addresses */
       if(frame.fcf.src_addr_mode && frame.src_pid != IEEE802154_PANID) {
         /* Reject if from another PAN */
-        PRINTF("tsch_packet_extract_addresses: from another pan %u\n", frame.src_pid);
+        PRINTF("tsch_packet_parse_header: from another pan %u\n", frame.src_pid);
         return 0;
       }
     }
-    if(source_address != NULL) {
-      linkaddr_copy(source_address, (linkaddr_t *)frame.src_addr);
-    }
+    linkaddr_copy(&hdr->source_address, (linkaddr_t *)frame.src_addr);
+    hdr->frame_type = frame.fcf.frame_type;
+    hdr->security_enabled = frame.fcf.security_enabled;
+    hdr->hdr_len = parsed;
   } else {
-    PRINTF("tsch_packet_extract_addresses: failed to parse\n");
+    PRINTF("tsch_packet_parse_header: failed to parse\n");
   }
-  return parsed;
+  return hdr->hdr_len;
 }
 
 /* Parse 802.15.4e Sync Information Element */
@@ -358,23 +511,53 @@ parse_ie_sync(uint8_t* const buf, int buf_size,
   }
 }
 
-/* Parse with 802.15.4e timeslot template */
+/* Timeslot template IE, full form: ID and 12 durations of 2 bytes each */
+#define TIMESLOT_TEMPLATE_FULL_LEN 25
+
+/* Read/write a 16-bit template field (us) to/from rtimer ticks */
+#define TEMPLATE_GET(buf, i) ((rtimer_clock_t)US_TO_RTIMERTICKS((uint16_t)((buf)[i] | ((buf)[(i) + 1] << 8))))
+#define TEMPLATE_PUT(buf, i, t) do { \
+    uint16_t us = (uint16_t)RTIMERTICKS_TO_US(t); \
+    (buf)[i] = us & 0xff; \
+    (buf)[(i) + 1] = us >> 8; \
+  } while(0)
+
+/* Parse with 802.15.4e timeslot template. The short form (ID only)
+ * stands for our default template */
 static int
 parse_ie_timeslot_template(uint8_t* const buf, int buf_size,
-    uint8_t *hop_sequence_id)
+    uint8_t *hop_sequence_id, struct tsch_timeslot_timing *timing)
 {
+  int len;
   if(buf_size < 3) {
     return 0;
   } else {
     /* Long IE: 2 bytes header, c.f. fig 48s in IEEE 802.15.4e
-     * b0-10: length=1, b11-14: sub-ID=9, b15: type=1 */
-    if(buf[0] != 1 || (buf[1] != ((9 << 3) | (1 << 7)))) {
+     * b0-10: length=1 or 25, b11-14: sub-ID=9, b15: type=1 */
+    len = buf[0] | ((buf[1] & 0x07) << 8);
+    if((len != 1 && len != TIMESLOT_TEMPLATE_FULL_LEN)
+        || (buf[1] & 0xf8) != ((9 << 3) | (1 << 7))
+        || buf_size < 2 + len) {
       return 0;
     }
     if(hop_sequence_id) {
       *hop_sequence_id = buf[2];
     }
-    return 3;
+    if(timing) {
+      if(len == 1) {
+        *timing = tsch_default_timing;
+      } else {
+        /* Fields: CCAOffset, CCA, TxOffset, RxOffset, RxAckDelay, TxAckDelay,
+         * RxWait, AckWait, RxTx, MaxAck, MaxTx, TimeslotLength.
+         * We derive the Rx-side ones from our own guard times */
+        timing->cca_offset = TEMPLATE_GET(buf, 3);
+        timing->cca = TEMPLATE_GET(buf, 5);
+        timing->tx_offset = TEMPLATE_GET(buf, 7);
+        timing->tx_ack_delay = TEMPLATE_GET(buf, 13);
+        timing->slot_duration = TEMPLATE_GET(buf, 25);
+      }
+    }
+    return 2 + len;
   }
 }
 
@@ -398,6 +581,165 @@ parse_ie_hop_sequence_template(uint8_t* const buf, int buf_size,
   }
 }
 
+/* Parse 802.15.4e slotframe and link IE. Stores up to TSCH_PACKET_EB_MAX_CELLS
+ * cells in schedule (if non-NULL) */
+static int
+parse_ie_slotframe_and_link(uint8_t* const buf, int buf_size,
+    struct tsch_eb_schedule *schedule)
+{
+  int len;
+  int curr_len;
+  uint8_t num_slotframes;
+  if(buf_size < 3) {
+    return 0;
+  }
+  /* Short IE: 2 bytes header, c.f. fig 48r in IEEE 802.15.4e
+   * b0-7: length, b8-14: sub-ID=0x1b, b15: type=0 */
+  len = buf[0];
+  if(buf[1] != 0x1b || len < 1 || buf_size < 2 + len) {
+    return 0;
+  }
+  if(schedule != NULL) {
+    schedule->num_cells = 0;
+  }
+  /* Number of slotframes, then for each: handle, size, number of links,
+   * and for each link: timeslot, channel offset, link options */
+  num_slotframes = buf[2];
+  curr_len = 3;
+  while(num_slotframes-- > 0) {
+    uint8_t handle;
+    uint16_t size;
+    uint8_t num_links;
+    if(curr_len + 4 > 2 + len) {
+      return 0;
+    }
+    handle = buf[curr_len];
+    size = buf[curr_len + 1] | (buf[curr_len + 2] << 8);
+    num_links = buf[curr_len + 3];
+    curr_len += 4;
+    if(curr_len + 5 * num_links > 2 + len) {
+      return 0;
+    }
+    while(num_links-- > 0) {
+      if(schedule != NULL && schedule->num_cells < TSCH_PACKET_EB_MAX_CELLS) {
+        struct tsch_eb_cell *c = &schedule->cells[schedule->num_cells++];
+        c->slotframe_handle = handle;
+        c->slotframe_size = size;
+        c->timeslot = buf[curr_len] | (buf[curr_len + 1] << 8);
+        c->channel_offset = buf[curr_len + 2] | (buf[curr_len + 3] << 8);
+        c->link_options = buf[curr_len + 4];
+      }
+      curr_len += 5;
+    }
+  }
+  return 2 + len;
+}
+
+/* Our minimal schedule IE (not in the standard), short IE: number of cells
+ * of the minimal schedule, then number of cells of the scheduled change
+ * (0 if none) and its activation ASN (5 bytes) */
+#define MINIMAL_IE_ID 0x41
+#define MINIMAL_IE_LEN 9
+
+/* Parse our minimal schedule IE */
+static int
+parse_ie_minimal(uint8_t* const buf, int buf_size,
+    struct tsch_eb_minimal_schedule *minimal)
+{
+  if(buf_size < MINIMAL_IE_LEN
+      || buf[0] != MINIMAL_IE_LEN - 2 || buf[1] != MINIMAL_IE_ID || buf[2] == 0) {
+    return 0;
+  }
+  if(minimal != NULL) {
+    minimal->num_cells = buf[2];
+    minimal->next.num_cells = buf[3];
+    minimal->next.asn.ls4b = (uint32_t)buf[4] | ((uint32_t)buf[5] << 8)
+        | ((uint32_t)buf[6] << 16) | ((uint32_t)buf[7] << 24);
+    minimal->next.asn.ms1b = buf[8];
+  }
+  return MINIMAL_IE_LEN;
+}
+
+/* Our RPL IE (not in the standard), short IE: RPL instance ID, DODAG
+ * version and rank (2 bytes) of the sender */
+#define RPL_IE_ID 0x42
+#define RPL_IE_LEN 6
+
+/* Parse our RPL IE */
+static int
+parse_ie_rpl(uint8_t* const buf, int buf_size,
+    struct tsch_eb_rpl_info *rpl_info)
+{
+  if(buf_size < RPL_IE_LEN
+      || buf[0] != RPL_IE_LEN - 2 || buf[1] != RPL_IE_ID) {
+    return 0;
+  }
+  if(rpl_info != NULL) {
+    rpl_info->instance_id = buf[2];
+    rpl_info->version = buf[3];
+    rpl_info->rank = (uint16_t)buf[4] | ((uint16_t)buf[5] << 8);
+  }
+  return RPL_IE_LEN;
+}
+
+/* Channel hopping IE, c.f. fig 48v in IEEE 802.15.4e, with hopping sequence ID 1:
+ * ID, channel page, number of channels, PHY configuration, hopping sequence
+ * length and list (2 bytes per channel) and current hop. No extended bitmap.
+ * With ID 2 (not in the standard), it announces a scheduled change in a
+ * compact form: ID, activation ASN (5 bytes), length and list (1 byte per channel) */
+#define CHANNEL_HOPPING_BASE_LEN 12
+#define CHANNEL_HOPPING_CHANGE_BASE_LEN 7
+#define CHANNEL_HOPPING_ID_CURRENT 1
+#define CHANNEL_HOPPING_ID_NEXT 2
+
+/* Parse 802.15.4e channel hopping IE */
+static int
+parse_ie_channel_hopping(uint8_t* const buf, int buf_size,
+    struct tsch_eb_hopping_sequence *hopping)
+{
+  int len;
+  uint16_t seq_len;
+  int i;
+  if(buf_size < 3) {
+    return 0;
+  }
+  /* Long IE: 2 bytes header, c.f. fig 48s in IEEE 802.15.4e
+   * b0-10: length, b11-14: sub-ID=9, b15: type=1 */
+  len = buf[0] | ((buf[1] & 0x07) << 8);
+  if((buf[1] & 0xf8) != ((9 << 3) | (1 << 7)) || buf_size < 2 + len) {
+    return 0;
+  }
+  if(buf[2] == CHANNEL_HOPPING_ID_CURRENT && len >= CHANNEL_HOPPING_BASE_LEN) {
+    seq_len = buf[10] | (buf[11] << 8);
+    if(seq_len == 0 || seq_len > TSCH_HOPPING_SEQUENCE_MAX_LEN
+        || len != CHANNEL_HOPPING_BASE_LEN + 2 * seq_len) {
+      return 0;
+    }
+    if(hopping != NULL) {
+      hopping->len = seq_len;
+      for(i = 0; i < seq_len; i++) {
+        hopping->channels[i] = buf[12 + 2 * i];
+      }
+    }
+  } else if(buf[2] == CHANNEL_HOPPING_ID_NEXT && len >= CHANNEL_HOPPING_CHANGE_BASE_LEN) {
+    seq_len = buf[8];
+    if(seq_len == 0 || seq_len > TSCH_HOPPING_SEQUENCE_MAX_LEN
+        || len != CHANNEL_HOPPING_CHANGE_BASE_LEN + seq_len) {
+      return 0;
+    }
+    if(hopping != NULL) {
+      hopping->next.asn.ls4b = (uint32_t)buf[3] | ((uint32_t)buf[4] << 8)
+          | ((uint32_t)buf[5] << 16) | ((uint32_t)buf[6] << 24);
+      hopping->next.asn.ms1b = buf[7];
+      hopping->next.len = seq_len;
+      memcpy(hopping->next.channels, &buf[9], seq_len);
+    }
+  } else {
+    return 0;
+  }
+  return 2 + len;
+}
+
 /* Parse 802.15.4e MLME outer IE */
 static int
 parse_ie_mlme_outer(uint8_t* const buf, int buf_size,
@@ -438,7 +780,7 @@ append_ie_sync(uint8_t* const buf, int buf_size,
       buf[5] = asn->ls4b >> 24;
       buf[6] = asn->ms1b;
     } else {
-      memset(buf, 0, 5);
+      memset(&buf[2], 0, 5);
     }
     buf[7] = join_priority;
 
@@ -446,20 +788,37 @@ append_ie_sync(uint8_t* const buf, int buf_size,
   }
 }
 
-/* Update packet with 802.15.4e timeslot template */
+/* Update packet with 802.15.4e timeslot template. The full template
+ * is included only if we do not use the default one */
 static int
 append_ie_timeslot_template(uint8_t* const buf, int buf_size,
     uint8_t hop_sequence_id)
 {
-  if(buf_size < 3) {
+  int len = memcmp(&tsch_timing, &tsch_default_timing, sizeof(tsch_timing)) == 0
+      ? 1 : TIMESLOT_TEMPLATE_FULL_LEN;
+  if(buf_size < 2 + len) {
     return 0;
   } else {
     /* Long IE: 2 bytes header, c.f. fig 48s in IEEE 802.15.4e
-     * b0-10: length=1, b11-14: sub-ID=9, b15: type=1 */
-    buf[0] = 1;
+     * b0-10: length=1 or 25, b11-14: sub-ID=9, b15: type=1 */
+    buf[0] = len;
     buf[1] = (9 << 3) | (1 << 7);
     buf[2] = hop_sequence_id;
-    return 3;
+    if(len != 1) {
+      TEMPLATE_PUT(buf, 3, TsCCAOffset);
+      TEMPLATE_PUT(buf, 5, TsCCA);
+      TEMPLATE_PUT(buf, 7, TsTxOffset);
+      TEMPLATE_PUT(buf, 9, TsTxOffset - TsLongGT);
+      TEMPLATE_PUT(buf, 11, TsTxAckDelay - TsShortGT);
+      TEMPLATE_PUT(buf, 13, TsTxAckDelay);
+      TEMPLATE_PUT(buf, 15, 2 * TsLongGT);
+      TEMPLATE_PUT(buf, 17, 2 * TsShortGT);
+      TEMPLATE_PUT(buf, 19, US_TO_RTIMERTICKS(192));
+      TEMPLATE_PUT(buf, 21, TSCH_ACK_MAX_DURATION);
+      TEMPLATE_PUT(buf, 23, TSCH_DATA_MAX_DURATION);
+      TEMPLATE_PUT(buf, 25, TsSlotDuration);
+    }
+    return 2 + len;
   }
 }
 
@@ -480,6 +839,163 @@ append_ie_hop_sequence_template(uint8_t* const buf, int buf_size,
   }
 }
 
+/* Update packet with 802.15.4e channel hopping IE, holding our hopping sequence */
+static int
+append_ie_channel_hopping(uint8_t* const buf, int buf_size)
+{
+  const uint8_t *sequence = hopping_sequence_list;
+  uint16_t seq_len = hopping_sequence_length.val;
+  int len = CHANNEL_HOPPING_BASE_LEN + 2 * seq_len;
+  uint32_t phy_config = 0;
+  int i;
+  if(buf_size < 2 + len) {
+    return 0;
+  }
+  for(i = 0; i < seq_len; i++) {
+    phy_config |= (uint32_t)1 << sequence[i];
+  }
+  /* Long IE: 2 bytes header, c.f. fig 48s in IEEE 802.15.4e
+   * b0-10: length, b11-14: sub-ID=9, b15: type=1 */
+  buf[0] = len;
+  buf[1] = (9 << 3) | (1 << 7);
+  buf[2] = CHANNEL_HOPPING_ID_CURRENT; /* Hopping sequence ID */
+  buf[3] = 0; /* Channel page */
+  buf[4] = 16; /* Number of channels */
+  buf[5] = 0;
+  buf[6] = phy_config;
+  buf[7] = phy_config >> 8;
+  buf[8] = phy_config >> 16;
+  buf[9] = phy_config >> 24;
+  buf[10] = seq_len & 0xff;
+  buf[11] = seq_len >> 8;
+  for(i = 0; i < seq_len; i++) {
+    buf[12 + 2 * i] = sequence[i];
+    buf[12 + 2 * i + 1] = 0;
+  }
+  /* Current hop: unused, we hop from the ASN */
+  buf[12 + 2 * seq_len] = 0;
+  buf[12 + 2 * seq_len + 1] = 0;
+  return 2 + len;
+}
+
+/* Update packet with our channel hopping IE announcing a scheduled change */
+static int
+append_ie_channel_hopping_change(uint8_t* const buf, int buf_size,
+    const struct tsch_hopping_sequence_change *change)
+{
+  int len = CHANNEL_HOPPING_CHANGE_BASE_LEN + change->len;
+  if(buf_size < 2 + len) {
+    return 0;
+  }
+  /* Long IE: 2 bytes header, c.f. fig 48s in IEEE 802.15.4e
+   * b0-10: length, b11-14: sub-ID=9, b15: type=1 */
+  buf[0] = len;
+  buf[1] = (9 << 3) | (1 << 7);
+  buf[2] = CHANNEL_HOPPING_ID_NEXT;
+  buf[3] = change->asn.ls4b;
+  buf[4] = change->asn.ls4b >> 8;
+  buf[5] = change->asn.ls4b >> 16;
+  buf[6] = change->asn.ls4b >> 24;
+  buf[7] = change->asn.ms1b;
+  buf[8] = change->len;
+  memcpy(&buf[9], change->channels, change->len);
+  return 2 + len;
+}
+
+#if TSCH_PACKET_EB_WITH_SLOTFRAME_AND_LINK
+/* Update packet with 802.15.4e slotframe and link IE, announcing our
+ * links to the broadcast address that are shared. Links that do not fit
+ * are left out. Returns 0 (no IE) if there is no such link */
+static int
+append_ie_slotframe_and_link(uint8_t* const buf, int buf_size)
+{
+  struct tsch_slotframe *sf;
+  int curr_len = 3;
+  uint8_t num_slotframes = 0;
+  if(buf_size < curr_len) {
+    return 0;
+  }
+  for(sf = tsch_schedule_slotframe_head(); sf != NULL; sf = tsch_schedule_slotframe_next(sf)) {
+    struct tsch_link *l;
+    int sf_offset = curr_len;
+    uint8_t num_links = 0;
+    if(sf->handle > 0xff || curr_len + 4 + 5 > buf_size || curr_len + 4 + 5 > 2 + 0xff) {
+      continue;
+    }
+    curr_len += 4;
+    for(l = list_head(sf->links_list); l != NULL; l = list_item_next(l)) {
+      if((l->link_options & LINK_OPTION_SHARED)
+          && linkaddr_cmp(tsch_schedule_get_link_addr(l), &tsch_broadcast_address)
+          && curr_len + 5 <= buf_size && curr_len + 5 <= 2 + 0xff) {
+        buf[curr_len++] = l->timeslot & 0xff;
+        buf[curr_len++] = l->timeslot >> 8;
+        buf[curr_len++] = l->channel_offset & 0xff;
+        buf[curr_len++] = l->channel_offset >> 8;
+        buf[curr_len++] = l->link_options;
+        num_links++;
+      }
+    }
+    if(num_links == 0) {
+      /* Nothing to announce in this slotframe */
+      curr_len = sf_offset;
+    } else {
+      buf[sf_offset] = sf->handle;
+      buf[sf_offset + 1] = sf->size.val & 0xff;
+      buf[sf_offset + 2] = sf->size.val >> 8;
+      buf[sf_offset + 3] = num_links;
+      num_slotframes++;
+    }
+  }
+  if(num_slotframes == 0) {
+    return 0;
+  }
+  /* Short IE: 2 bytes header, c.f. fig 48r in IEEE 802.15.4e
+   * b0-7: length, b8-14: sub-ID=0x1b, b15: type=0 */
+  buf[0] = curr_len - 2;
+  buf[1] = 0x1b;
+  buf[2] = num_slotframes;
+  return curr_len;
+}
+#endif /* TSCH_PACKET_EB_WITH_SLOTFRAME_AND_LINK */
+
+/* Update packet with our minimal schedule IE */
+static int
+append_ie_minimal(uint8_t* const buf, int buf_size)
+{
+  if(buf_size < MINIMAL_IE_LEN) {
+    return 0;
+  }
+  buf[0] = MINIMAL_IE_LEN - 2;
+  buf[1] = MINIMAL_IE_ID;
+  buf[2] = tsch_schedule_minimal_cells();
+  buf[3] = tsch_next_minimal_change.num_cells;
+  buf[4] = tsch_next_minimal_change.asn.ls4b;
+  buf[5] = tsch_next_minimal_change.asn.ls4b >> 8;
+  buf[6] = tsch_next_minimal_change.asn.ls4b >> 16;
+  buf[7] = tsch_next_minimal_change.asn.ls4b >> 24;
+  buf[8] = tsch_next_minimal_change.asn.ms1b;
+  return MINIMAL_IE_LEN;
+}
+
+#ifdef TSCH_CALLBACK_EB_RPL_INFO
+/* Update packet with our RPL IE */
+static int
+append_ie_rpl(uint8_t* const buf, int buf_size,
+    const struct tsch_eb_rpl_info *rpl_info)
+{
+  if(buf_size < RPL_IE_LEN) {
+    return 0;
+  }
+  buf[0] = RPL_IE_LEN - 2;
+  buf[1] = RPL_IE_ID;
+  buf[2] = rpl_info->instance_id;
+  buf[3] = rpl_info->version;
+  buf[4] = rpl_info->rank;
+  buf[5] = rpl_info->rank >> 8;
+  return RPL_IE_LEN;
+}
+#endif /* TSCH_CALLBACK_EB_RPL_INFO */
+
 /* Update packet with 802.15.4e MLME outer IE */
 static int
 append_ie_mlme_outer(uint8_t* const buf, int buf_size,
@@ -496,12 +1012,16 @@ append_ie_mlme_outer(uint8_t* const buf, int buf_size,
   }
 }
 
-/* Create an EB packet */
-int
-tsch_packet_make_eb(uint8_t* const buf, uint8_t buf_size, uint8_t seqno)
+/* Serialize an EB */
+static int
+eb_build(uint8_t* const buf, uint8_t buf_size, uint8_t seqno)
 {
   uint8_t curr_len = 0;
   uint8_t ie_mlme_offset;
+  int ret;
+#ifdef TSCH_CALLBACK_EB_RPL_INFO
+  struct tsch_eb_rpl_info rpl_info;
+#endif /* TSCH_CALLBACK_EB_RPL_INFO */
 
   /* FCF: 2 bytes */
   /* b0-2: frame type=0, b3: security=0, b4: pending=0, b5: AR, b6: PAN ID compression, b7: reserved */
@@ -534,8 +1054,50 @@ tsch_packet_make_eb(uint8_t* const buf, uint8_t buf_size, uint8_t seqno)
   curr_len += append_ie_timeslot_template(&buf[curr_len], buf_size-curr_len, 1);
   /* Hop sequence template IE */
   curr_len += append_ie_hop_sequence_template(&buf[curr_len], buf_size-curr_len, 1);
+  /* Channel hopping IE, if not using the default sequence.
+   * Without it, joining nodes would use the wrong sequence */
+  if(!tsch_hopping_sequence_is_default()) {
+    ret = append_ie_channel_hopping(&buf[curr_len], buf_size-curr_len);
+    if(ret == 0) {
+      return 0;
+    }
+    curr_len += ret;
+  }
+  /* Channel hopping IE of the scheduled change, if any */
+  if(tsch_next_hopping_sequence.len != 0) {
+    ret = append_ie_channel_hopping_change(&buf[curr_len], buf_size-curr_len,
+        &tsch_next_hopping_sequence);
+    if(ret == 0) {
+      return 0;
+    }
+    curr_len += ret;
+  }
 
-  /* TODO append TSCH slotframe & link IE */
+#if TSCH_PACKET_EB_WITH_SLOTFRAME_AND_LINK
+  /* Slotframe and link IE */
+  curr_len += append_ie_slotframe_and_link(&buf[curr_len], buf_size-curr_len);
+#endif /* TSCH_PACKET_EB_WITH_SLOTFRAME_AND_LINK */
+  /* Minimal schedule IE, if not using the default one or if a change is
+   * scheduled. Without it, joining nodes would use the wrong cells */
+  if(tsch_schedule_minimal_cells() != 0
+      && (tsch_schedule_minimal_cells() != TSCH_SCHEDULE_MINIMAL_CELLS
+          || tsch_next_minimal_change.num_cells != 0)) {
+    ret = append_ie_minimal(&buf[curr_len], buf_size-curr_len);
+    if(ret == 0) {
+      return 0;
+    }
+    curr_len += ret;
+  }
+#ifdef TSCH_CALLBACK_EB_RPL_INFO
+  /* RPL IE, once we are part of a DODAG */
+  if(TSCH_CALLBACK_EB_RPL_INFO(&rpl_info)) {
+    ret = append_ie_rpl(&buf[curr_len], buf_size-curr_len, &rpl_info);
+    if(ret == 0) {
+      return 0;
+    }
+    curr_len += ret;
+  }
+#endif /* TSCH_CALLBACK_EB_RPL_INFO */
 
   /* MLME IE */
   curr_len += append_ie_mlme_outer(&buf[ie_mlme_offset], 2, curr_len-ie_mlme_offset-2);
@@ -543,23 +1105,78 @@ tsch_packet_make_eb(uint8_t* const buf, uint8_t buf_size, uint8_t seqno)
   return curr_len;
 }
 
-/* Update ASN in EB packet */
+/* Create an EB packet */
+int
+tsch_packet_make_eb(uint8_t* const buf, uint8_t buf_size, uint8_t seqno)
+{
+#if TSCH_PACKET_EB_WITH_TEMPLATE
+#ifdef TSCH_CALLBACK_EB_RPL_INFO
+  /* Our rank changes without notice: rebuild the template when it does */
+  struct tsch_eb_rpl_info rpl_info;
+  if(!TSCH_CALLBACK_EB_RPL_INFO(&rpl_info)) {
+    rpl_info.rank = 0;
+  }
+  if(eb_template_len != 0) {
+    if(rpl_info.rank != eb_template_rpl_info.rank
+        || (rpl_info.rank != 0
+            && (rpl_info.instance_id != eb_template_rpl_info.instance_id
+                || rpl_info.version != eb_template_rpl_info.version))) {
+      eb_template_len = 0;
+    }
+  }
+#endif /* TSCH_CALLBACK_EB_RPL_INFO */
+  if(eb_template_len == 0) {
+    eb_template_len = eb_build(eb_template, sizeof(eb_template), 0);
+#ifdef TSCH_CALLBACK_EB_RPL_INFO
+    eb_template_rpl_info = rpl_info;
+#endif /* TSCH_CALLBACK_EB_RPL_INFO */
+  }
+  if(eb_template_len != 0 && eb_template_len <= buf_size) {
+    memcpy(buf, eb_template, eb_template_len);
+    /* Seqno: third byte */
+    buf[2] = seqno;
+    return eb_template_len;
+  }
+#endif /* TSCH_PACKET_EB_WITH_TEMPLATE */
+  return eb_build(buf, buf_size, seqno);
+}
+
+/* Is to be called whenever the content of EBs changes */
+void
+tsch_packet_eb_template_invalidate(void)
+{
+#if TSCH_PACKET_EB_WITH_TEMPLATE
+  eb_template_len = 0;
+#endif /* TSCH_PACKET_EB_WITH_TEMPLATE */
+}
+
+/* Update ASN in EB packet. Called from the Tx link: only patches the ASN and
+ * join priority fields of the sync IE, which is at a fixed offset */
 int
 tsch_packet_update_eb(uint8_t *buf, uint8_t buf_size)
 {
   if(/* is beacon? */
      (FRAME802154_BEACONFRAME == (buf[0] & 7))
      /* IE FCF as expected? */
-     && ((buf[1] & 0xe2) == 0xe2)) {
-    /* Update ASN and join priority */
-    return append_ie_sync(
-        &buf[EB_IE_SYNC_OFFSET], buf_size-EB_IE_SYNC_OFFSET, &current_asn, tsch_join_priority);
+     && ((buf[1] & 0xe2) == 0xe2)
+     && buf_size >= EB_IE_SYNC_OFFSET + 8) {
+    uint8_t *sync_ie = &buf[EB_IE_SYNC_OFFSET];
+    sync_ie[2] = current_asn.ls4b;
+    sync_ie[3] = current_asn.ls4b >> 8;
+    sync_ie[4] = current_asn.ls4b >> 16;
+    sync_ie[5] = current_asn.ls4b >> 24;
+    sync_ie[6] = current_asn.ms1b;
+    sync_ie[7] = tsch_join_priority;
+    return 8;
   }
   return 0;
 }
 
 uint8_t
-tsch_parse_eb(uint8_t *buf, uint8_t buf_size, linkaddr_t *source_address, struct asn_t *asn, uint8_t *join_priority)
+tsch_parse_eb(uint8_t *buf, uint8_t buf_size, linkaddr_t *source_address, struct asn_t *asn, uint8_t *join_priority,
+    struct tsch_timeslot_timing *timing, struct tsch_eb_schedule *schedule,
+    struct tsch_eb_hopping_sequence *hopping, struct tsch_eb_minimal_schedule *minimal,
+    struct tsch_eb_rpl_info *rpl_info)
 {
   uint8_t curr_len = 0;
   uint8_t sub_ies_length = 0;
@@ -616,7 +1233,7 @@ tsch_parse_eb(uint8_t *buf, uint8_t buf_size, linkaddr_t *source_address, struct
   curr_len += ret;
 
   /* Timeslot template IE */
-  ret = parse_ie_timeslot_template(&buf[curr_len], buf_size-curr_len, &slot_template_id);
+  ret = parse_ie_timeslot_template(&buf[curr_len], buf_size-curr_len, &slot_template_id, timing);
   if(ret == 0 || slot_template_id != 1) {
     return 0;
   }
@@ -629,6 +1246,56 @@ tsch_parse_eb(uint8_t *buf, uint8_t buf_size, linkaddr_t *source_address, struct
   }
   curr_len += ret;
 
+  /* Optional IEs: channel hopping IE, slotframe and link IE,
+   * minimal schedule IE, then RPL IE */
+  if(schedule != NULL) {
+    schedule->num_cells = 0;
+  }
+  if(hopping != NULL) {
+    hopping->len = 0;
+    hopping->next.len = 0;
+  }
+  if(minimal != NULL) {
+    minimal->num_cells = 0;
+    minimal->next.num_cells = 0;
+  }
+  if(rpl_info != NULL) {
+    rpl_info->rank = 0;
+  }
+  /* Up to two channel hopping IEs: the sequence in use, and the next one */
+  if(sub_ies_length > curr_len-ie_mlme_offset-2) {
+    ret = parse_ie_channel_hopping(&buf[curr_len], buf_size-curr_len, hopping);
+    curr_len += ret;
+    if(ret != 0 && sub_ies_length > curr_len-ie_mlme_offset-2) {
+      curr_len += parse_ie_channel_hopping(&buf[curr_len], buf_size-curr_len, hopping);
+    }
+  }
+  if(sub_ies_length > curr_len-ie_mlme_offset-2
+      && curr_len + 2 <= buf_size && buf[curr_len + 1] != MINIMAL_IE_ID
+      && buf[curr_len + 1] != RPL_IE_ID) {
+    ret = parse_ie_slotframe_and_link(&buf[curr_len], buf_size-curr_len, schedule);
+    if(ret == 0) {
+      return 0;
+    }
+    curr_len += ret;
+  }
+  if(sub_ies_length > curr_len-ie_mlme_offset-2) {
+    if(curr_len + 2 <= buf_size && buf[curr_len + 1] == MINIMAL_IE_ID) {
+      ret = parse_ie_minimal(&buf[curr_len], buf_size-curr_len, minimal);
+      if(ret == 0) {
+        return 0;
+      }
+      curr_len += ret;
+    }
+  }
+  if(sub_ies_length > curr_len-ie_mlme_offset-2) {
+    ret = parse_ie_rpl(&buf[curr_len], buf_size-curr_len, rpl_info);
+    if(ret == 0) {
+      return 0;
+    }
+    curr_len += ret;
+  }
+
   /* Finally, check sub_ies_length */
   if(sub_ies_length != curr_len-ie_mlme_offset-2) {
     return 0;
@@ -44,32 +44,131 @@
 #include "contiki.h"
 #include "net/mac/tsch/tsch-private.h"
 
+/* Build EBs from a template holding all IEs, serialized only when they
+ * change (see tsch_packet_eb_template_invalidate). Only the seqno is
+ * written when an EB is created, and the ASN and join priority when it is sent */
+#ifdef TSCH_PACKET_CONF_EB_WITH_TEMPLATE
+#define TSCH_PACKET_EB_WITH_TEMPLATE TSCH_PACKET_CONF_EB_WITH_TEMPLATE
+#else
+#define TSCH_PACKET_EB_WITH_TEMPLATE 1
+#endif
+
+/* Max length of the EB template. EBs that do not fit are built from scratch */
+#ifdef TSCH_PACKET_CONF_EB_TEMPLATE_LEN
+#define TSCH_PACKET_EB_TEMPLATE_LEN TSCH_PACKET_CONF_EB_TEMPLATE_LEN
+#else
+#define TSCH_PACKET_EB_TEMPLATE_LEN TSCH_MAX_PACKET_LEN
+#endif
+
+/* Advertise our broadcast shared cells in the EB slotframe and link IE,
+ * and install the ones of the EB we associate from. EBs with the IE are
+ * accepted either way */
+#ifdef TSCH_PACKET_CONF_EB_WITH_SLOTFRAME_AND_LINK
+#define TSCH_PACKET_EB_WITH_SLOTFRAME_AND_LINK TSCH_PACKET_CONF_EB_WITH_SLOTFRAME_AND_LINK
+#else
+#define TSCH_PACKET_EB_WITH_SLOTFRAME_AND_LINK 0
+#endif
+
+/* Max number of cells read from the slotframe and link IE of an EB */
+#ifdef TSCH_PACKET_CONF_EB_MAX_CELLS
+#define TSCH_PACKET_EB_MAX_CELLS TSCH_PACKET_CONF_EB_MAX_CELLS
+#else
+#define TSCH_PACKET_EB_MAX_CELLS 4
+#endif
+
+/* A cell announced in the slotframe and link IE of an EB */
+struct tsch_eb_cell {
+  uint16_t slotframe_size;
+  uint16_t timeslot;
+  uint16_t channel_offset;
+  uint8_t slotframe_handle;
+  uint8_t link_options;
+};
+
+/* The cells announced in an EB */
+struct tsch_eb_schedule {
+  uint8_t num_cells;
+  struct tsch_eb_cell cells[TSCH_PACKET_EB_MAX_CELLS];
+};
+
+/* The channel hopping sequence announced in an EB */
+struct tsch_eb_hopping_sequence {
+  uint8_t len; /* 0 if the EB does not announce one, i.e. uses the default */
+  uint8_t channels[TSCH_HOPPING_SEQUENCE_MAX_LEN];
+  struct tsch_hopping_sequence_change next; /* The announced change, if any */
+};
+
+/* The minimal schedule announced in an EB */
+struct tsch_eb_minimal_schedule {
+  uint8_t num_cells; /* 0 if the EB does not announce one, i.e. uses the default */
+  struct tsch_minimal_change next; /* The announced change, if any */
+};
+
+/* The RPL state announced in an EB, so that neighbors can check their
+ * consistency with us without a DIO. Announced when
+ * TSCH_CALLBACK_EB_RPL_INFO is defined, and passed to
+ * TSCH_CALLBACK_EB_RPL_INFO_RECEIVED on reception */
+struct tsch_eb_rpl_info {
+  uint16_t rank; /* 0 if the EB does not announce one */
+  uint8_t instance_id;
+  uint8_t version;
+};
+
 /* Return values for tsch_packet_parse_frame_type */
 #define DO_ACK 2
 #define IS_DATA 4
 #define IS_ACK 8
 #define IS_EB 16
+#define FRAME_PENDING 32
+
+/* The 802.15.4 header of a received frame, as parsed once in the Rx
+ * timeslot and reused downstream instead of parsing the frame again */
+struct tsch_packet_header {
+  linkaddr_t source_address;
+  linkaddr_t dest_address; /* linkaddr_null for broadcast */
+  uint8_t hdr_len; /* 0 if the frame failed to parse or is for another PAN */
+  uint8_t frame_type; /* Raw 802.15.4 frame type */
+  uint8_t flags; /* DO_ACK | IS_DATA | IS_ACK | IS_EB | FRAME_PENDING */
+  uint8_t seqno;
+  uint8_t security_enabled;
+};
 
 /* Return values for tsch_packet_parse_sync_ack */
 #define TSCH_ACK_OK 2
 #define TSCH_ACK_HAS_SYNC_IE 4
+#define TSCH_ACK_HAS_HINTS 8
 
-/* Construct enhanced ACK packet and return ACK length */
+/* Construct enhanced ACK packet and return ACK length.
+ * hints are included if non-NULL and TSCH_PACKET_WITH_ACK_HINTS */
 int tsch_packet_make_sync_ack(int32_t drift, int nack,
-    uint8_t *ackbuf, int ackbuf_len, linkaddr_t *dest_addr, uint8_t seqno);
+    uint8_t *ackbuf, int ackbuf_len, linkaddr_t *dest_addr, uint8_t seqno,
+    const struct tsch_ack_hints *hints);
 
-/* Parse enhanced ACK packet, extract drift and nack */
+/* Parse enhanced ACK packet, extract drift and nack, and hints (if non-NULL) */
 int tsch_packet_parse_sync_ack(int32_t *drift, int *nack,
-    uint8_t *ackbuf, int ackbuf_len, uint8_t seqno, int extract_sync_ie);
+    uint8_t *ackbuf, int ackbuf_len, uint8_t seqno, int extract_sync_ie,
+    struct tsch_ack_hints *hints);
 
 /* Create an EB packet */
 int tsch_packet_make_eb(uint8_t* const buf, uint8_t buf_size, uint8_t seqno);
 
+/* Is to be called whenever the content of EBs changes (e.g. timeslot template) */
+void tsch_packet_eb_template_invalidate(void);
+
+/* Parse the 802.15.4 header of a raw packet in a single pass.
+ * Returns the header length, 0 on failure */
+int tsch_packet_parse_header(uint8_t *buf, uint8_t len, struct tsch_packet_header *hdr);
+
 /* Extract addresses from raw packet */
 int tsch_packet_extract_addresses(uint8_t *buf, uint8_t len, linkaddr_t *source_address, linkaddr_t *dest_address);
 
-/* Parse EB and extract ASN and join priority */
-uint8_t tsch_parse_eb(uint8_t *buf, uint8_t buf_len, linkaddr_t *source_address, struct asn_t *asn, uint8_t *join_priority);
+/* Parse EB and extract ASN, join priority, timeslot template (if timing is non-NULL),
+ * announced cells (if schedule is non-NULL), hopping sequence (if hopping is non-NULL),
+ * minimal schedule (if minimal is non-NULL) and RPL state (if rpl_info is non-NULL) */
+uint8_t tsch_parse_eb(uint8_t *buf, uint8_t buf_len, linkaddr_t *source_address, struct asn_t *asn, uint8_t *join_priority,
+    struct tsch_timeslot_timing *timing, struct tsch_eb_schedule *schedule,
+    struct tsch_eb_hopping_sequence *hopping, struct tsch_eb_minimal_schedule *minimal,
+    struct tsch_eb_rpl_info *rpl_info);
 
 /* Update ASN in EB packet */
 int tsch_packet_update_eb(uint8_t *buf, uint8_t buf_len);
@@ -80,4 +179,21 @@ uint8_t tsch_packet_parse_frame_type_from_fcf_lsb(uint8_t fcf_lsb);
 /* Extract 802.15.4 frame type from a struct packet_input */
 uint8_t tsch_packet_parse_frame_type(uint8_t *buf, uint8_t len, uint8_t *seqno);
 
+/* Set or clear the frame pending bit of a frame */
+void tsch_packet_set_frame_pending(uint8_t *buf, uint8_t len, int pending);
+
+/* Rewrite the destination address of an unsecured unicast frame, whose
+ * addresses have the size of a linkaddr_t. Returns 1 on success, 0 otherwise */
+int tsch_packet_set_dest_address(uint8_t *buf, uint8_t len, const linkaddr_t *dest_address);
+
+/* Number of first bytes of a frame needed to get its destination address:
+ * FCF, sequence number, destination PAN ID and address */
+#define TSCH_PACKET_PEEK_LEN (3 + 2 + LINKADDR_SIZE)
+
+/* Get the destination address of a frame from its first bytes only, e.g.
+ * while it is being received. dest_address is set to linkaddr_null for
+ * broadcast. Returns 1 on success, 0 if the frame has no destination
+ * address of the size of a linkaddr_t */
+int tsch_packet_peek_dest_address(const uint8_t *buf, uint8_t len, linkaddr_t *dest_address);
+
 #endif /* __tsch_packet_H__ */
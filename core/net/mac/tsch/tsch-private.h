@@ -45,7 +45,9 @@
 #include "contiki.h"
 #include "net/linkaddr.h"
 
-/* Max time before sending a unicast keep-alive message to the time source */
+/* Max time before sending a unicast keep-alive message to the time source.
+ * Any frame exchanged with the time source that synchronizes us (EB, data,
+ * or ACK with a Sync IE) postpones the keepalive */
 #ifdef TSCH_CONF_KEEPALIVE_TIMEOUT
 #define TSCH_KEEPALIVE_TIMEOUT TSCH_CONF_KEEPALIVE_TIMEOUT
 #else
@@ -73,6 +75,31 @@
 #define TSCH_MAX_EB_PERIOD (60 * CLOCK_SECOND)
 #endif
 
+/* Adaptive EB period: instead of following the RPL DIO interval, send
+ * just enough EBs, together with the EBs we hear from neighbors, for a
+ * joiner to hear one within TSCH_ADAPTIVE_EB_JOIN_LATENCY. Trickle resets
+ * (joiners, inconsistencies) switch to TSCH_MIN_EB_PERIOD for a window.
+ * The period is kept within [TSCH_MIN_EB_PERIOD, TSCH_MAX_EB_PERIOD] */
+#ifdef TSCH_CONF_ADAPTIVE_EB_PERIOD
+#define TSCH_ADAPTIVE_EB_PERIOD TSCH_CONF_ADAPTIVE_EB_PERIOD
+#else
+#define TSCH_ADAPTIVE_EB_PERIOD 0
+#endif
+
+/* Adaptive EB period: target join latency */
+#ifdef TSCH_CONF_ADAPTIVE_EB_JOIN_LATENCY
+#define TSCH_ADAPTIVE_EB_JOIN_LATENCY TSCH_CONF_ADAPTIVE_EB_JOIN_LATENCY
+#else
+#define TSCH_ADAPTIVE_EB_JOIN_LATENCY (30 * CLOCK_SECOND)
+#endif
+
+/* Adaptive EB period: window over which received EBs are counted */
+#ifdef TSCH_CONF_ADAPTIVE_EB_WINDOW
+#define TSCH_ADAPTIVE_EB_WINDOW TSCH_CONF_ADAPTIVE_EB_WINDOW
+#else
+#define TSCH_ADAPTIVE_EB_WINDOW (60 * CLOCK_SECOND)
+#endif
+
 /* Max acceptable join priority */
 #ifdef TSCH_CONF_MAX_JOIN_PRIORITY
 #define TSCH_MAX_JOIN_PRIORITY TSCH_CONF_MAX_JOIN_PRIORITY
@@ -87,6 +114,138 @@
 #define TSCH_GUARD_TIME 1000
 #endif
 
+/* Adaptive time synchronization: learn the clock skew with the time source
+ * and compensate for it at every wake up. Residual drift is then much
+ * smaller, which allows for longer TSCH_CONF_KEEPALIVE_TIMEOUT and
+ * TSCH_CONF_DESYNC_THRESHOLD */
+#ifdef TSCH_CONF_ADAPTIVE_TIMESYNC
+#define TSCH_ADAPTIVE_TIMESYNC TSCH_CONF_ADAPTIVE_TIMESYNC
+#else
+#define TSCH_ADAPTIVE_TIMESYNC 0
+#endif
+
+/* Per-neighbor link estimation from unicast Tx outcomes, per-channel ACKs,
+ * RSSI and EB reception, see tsch-link-estimator.h */
+#ifdef TSCH_CONF_WITH_LINK_ESTIMATOR
+#define TSCH_WITH_LINK_ESTIMATOR TSCH_CONF_WITH_LINK_ESTIMATOR
+#else
+#define TSCH_WITH_LINK_ESTIMATOR 0
+#endif
+
+/* 6P-style negotiation of dedicated cells with the neighbors, on demand,
+ * see tsch-sixp.h */
+#ifdef TSCH_CONF_WITH_SIXP
+#define TSCH_WITH_SIXP TSCH_CONF_WITH_SIXP
+#else
+#define TSCH_WITH_SIXP 0
+#endif
+
+/* Keep a backup time source next to the primary one (e.g. a second RPL
+ * parent), see tsch_queue_update_backup_time_source. Frames from the backup
+ * are used for synchronization once the primary has been silent for
+ * TSCH_BACKUP_TIME_SOURCE_SYNC_AFTER, so that losing the primary does not
+ * cost synchronization until the time source is switched */
+#ifdef TSCH_CONF_WITH_BACKUP_TIME_SOURCE
+#define TSCH_WITH_BACKUP_TIME_SOURCE TSCH_CONF_WITH_BACKUP_TIME_SOURCE
+#else
+#define TSCH_WITH_BACKUP_TIME_SOURCE 0
+#endif
+
+#ifdef TSCH_CONF_BACKUP_TIME_SOURCE_SYNC_AFTER
+#define TSCH_BACKUP_TIME_SOURCE_SYNC_AFTER TSCH_CONF_BACKUP_TIME_SOURCE_SYNC_AFTER
+#else
+#define TSCH_BACKUP_TIME_SOURCE_SYNC_AFTER TSCH_KEEPALIVE_TIMEOUT
+#endif
+
+/* Adaptive time synchronization: min interval to estimate the skew over */
+#ifdef TSCH_CONF_ADAPTIVE_TIMESYNC_MIN_INTERVAL
+#define TSCH_ADAPTIVE_TIMESYNC_MIN_INTERVAL TSCH_CONF_ADAPTIVE_TIMESYNC_MIN_INTERVAL
+#else
+#define TSCH_ADAPTIVE_TIMESYNC_MIN_INTERVAL (4 * CLOCK_SECOND)
+#endif
+
+/* Adaptive guard time: learn the drift with the current time source and
+ * shrink the Rx guard time (never above TsLongGT) when it is small and
+ * our last synchronization is recent */
+#ifdef TSCH_CONF_ADAPTIVE_GUARD_TIME
+#define TSCH_ADAPTIVE_GUARD_TIME TSCH_CONF_ADAPTIVE_GUARD_TIME
+#else
+#define TSCH_ADAPTIVE_GUARD_TIME 0
+#endif
+
+/* Adaptive guard time: fixed margin added to the expected drift, in us.
+ * Also covers the drift of neighbors other than our time source */
+#ifdef TSCH_CONF_ADAPTIVE_GUARD_MARGIN
+#define TSCH_ADAPTIVE_GUARD_MARGIN TSCH_CONF_ADAPTIVE_GUARD_MARGIN
+#else
+#define TSCH_ADAPTIVE_GUARD_MARGIN 200
+#endif
+
+/* Adaptive guard time: drift measurements needed before shrinking the guard time */
+#ifdef TSCH_CONF_ADAPTIVE_GUARD_MIN_SAMPLES
+#define TSCH_ADAPTIVE_GUARD_MIN_SAMPLES TSCH_CONF_ADAPTIVE_GUARD_MIN_SAMPLES
+#else
+#define TSCH_ADAPTIVE_GUARD_MIN_SAMPLES 4
+#endif
+
+/* Adaptive keepalive period: from the drift learned for the guard time,
+ * send keepalives only as often as needed for the drift to stay within
+ * TsLongGT, between TSCH_KEEPALIVE_TIMEOUT and TSCH_KEEPALIVE_MAX_TIMEOUT.
+ * Needs TSCH_CONF_ADAPTIVE_GUARD_TIME */
+#ifdef TSCH_CONF_ADAPTIVE_KEEPALIVE
+#define TSCH_ADAPTIVE_KEEPALIVE TSCH_CONF_ADAPTIVE_KEEPALIVE
+#else
+#define TSCH_ADAPTIVE_KEEPALIVE 0
+#endif
+
+#if TSCH_ADAPTIVE_KEEPALIVE && !TSCH_ADAPTIVE_GUARD_TIME
+#error TSCH_CONF_ADAPTIVE_KEEPALIVE requires TSCH_CONF_ADAPTIVE_GUARD_TIME
+#endif
+
+#ifdef TSCH_CONF_KEEPALIVE_MAX_TIMEOUT
+#define TSCH_KEEPALIVE_MAX_TIMEOUT TSCH_CONF_KEEPALIVE_MAX_TIMEOUT
+#else
+#define TSCH_KEEPALIVE_MAX_TIMEOUT (TSCH_DESYNC_THRESHOLD / 2)
+#endif
+
+/* Per-neighbor Tx power control: unicast frames are sent with less power
+ * than configured (e.g. RF_POWER) as long as the ACKs of the neighbor are
+ * received above TSCH_TX_POWER_TARGET_RSSI. Broadcast frames, EBs and
+ * ACKs are always sent with the configured power */
+#ifdef TSCH_CONF_WITH_TX_POWER_CONTROL
+#define TSCH_WITH_TX_POWER_CONTROL TSCH_CONF_WITH_TX_POWER_CONTROL
+#else
+#define TSCH_WITH_TX_POWER_CONTROL 0
+#endif
+
+/* Tx power control: ACK RSSI to stay above, in dBm. The power is lowered
+ * by TSCH_TX_POWER_STEP when the ACK RSSI is more than
+ * TSCH_TX_POWER_HYSTERESIS above the target, raised when below */
+#ifdef TSCH_CONF_TX_POWER_TARGET_RSSI
+#define TSCH_TX_POWER_TARGET_RSSI TSCH_CONF_TX_POWER_TARGET_RSSI
+#else
+#define TSCH_TX_POWER_TARGET_RSSI (-80)
+#endif
+
+#ifdef TSCH_CONF_TX_POWER_HYSTERESIS
+#define TSCH_TX_POWER_HYSTERESIS TSCH_CONF_TX_POWER_HYSTERESIS
+#else
+#define TSCH_TX_POWER_HYSTERESIS 6
+#endif
+
+#ifdef TSCH_CONF_TX_POWER_STEP
+#define TSCH_TX_POWER_STEP TSCH_CONF_TX_POWER_STEP
+#else
+#define TSCH_TX_POWER_STEP 2
+#endif
+
+/* Tx power control: back to full power after this many consecutive NOACKs */
+#ifdef TSCH_CONF_TX_POWER_NOACK_STREAK
+#define TSCH_TX_POWER_NOACK_STREAK TSCH_CONF_TX_POWER_NOACK_STREAK
+#else
+#define TSCH_TX_POWER_NOACK_STREAK 2
+#endif
+
 /* Max number of links */
 #ifdef TSCH_CONF_MAX_LINKS
 #define TSCH_MAX_LINKS TSCH_CONF_MAX_LINKS
@@ -94,9 +253,162 @@
 #define TSCH_MAX_LINKS 32
 #endif
 
+/* Association scan: time spent on each channel of the hopping sequence */
+#ifdef TSCH_CONF_ASSOCIATION_CHANNEL_DWELL
+#define TSCH_ASSOCIATION_CHANNEL_DWELL TSCH_CONF_ASSOCIATION_CHANNEL_DWELL
+#else
+#define TSCH_ASSOCIATION_CHANNEL_DWELL CLOCK_SECOND
+#endif
+
+/* Association scan: percentage of each channel dwell the radio listens for.
+ * The radio is off for the rest of the dwell */
+#ifdef TSCH_CONF_ASSOCIATION_DUTY_CYCLE
+#define TSCH_ASSOCIATION_DUTY_CYCLE TSCH_CONF_ASSOCIATION_DUTY_CYCLE
+#else
+#define TSCH_ASSOCIATION_DUTY_CYCLE 100
+#endif
+
+/* Association scan: polling interval of the radio while listening */
+#ifdef TSCH_CONF_ASSOCIATION_POLL_INTERVAL
+#define TSCH_ASSOCIATION_POLL_INTERVAL TSCH_CONF_ASSOCIATION_POLL_INTERVAL
+#else
+#define TSCH_ASSOCIATION_POLL_INTERVAL (CLOCK_SECOND / 100)
+#endif
+
+/* Association window: collect EBs for this long before joining the best
+ * source (lowest join priority, then highest RSSI). 0 to join on the first
+ * acceptable EB */
+#ifdef TSCH_CONF_ASSOCIATION_WINDOW
+#define TSCH_ASSOCIATION_WINDOW TSCH_CONF_ASSOCIATION_WINDOW
+#else
+#define TSCH_ASSOCIATION_WINDOW 0
+#endif
+
+/* Association window: max number of EB sources remembered */
+#ifdef TSCH_CONF_ASSOCIATION_MAX_CANDIDATES
+#define TSCH_ASSOCIATION_MAX_CANDIDATES TSCH_CONF_ASSOCIATION_MAX_CANDIDATES
+#else
+#define TSCH_ASSOCIATION_MAX_CANDIDATES 4
+#endif
+
+/* Burst mode: max number of frames sent back-to-back to a neighbor in
+ * consecutive timeslots, announced with the frame pending bit.
+ * 0 disables burst mode */
+#ifdef TSCH_CONF_BURST_MAX_LEN
+#define TSCH_BURST_MAX_LEN TSCH_CONF_BURST_MAX_LEN
+#else
+#define TSCH_BURST_MAX_LEN 0
+#endif
+
+/* Start Tx and Rx at absolute times through RADIO_PARAM_TX_START_TIME and
+ * RADIO_PARAM_RX_WINDOW when the radio supports them (JN5168 in hardware,
+ * cc2420 and cc2538 from their own start latency). Other radios fall back
+ * to a busy-wait until the start time. TSCH_HW_TIMED_RADIO_MARGIN is how long (us) before
+ * the start time the link operation wakes up to arm the radio */
+#ifdef TSCH_CONF_HW_TIMED_RADIO
+#define TSCH_HW_TIMED_RADIO TSCH_CONF_HW_TIMED_RADIO
+#else
+#define TSCH_HW_TIMED_RADIO 0
+#endif
+
+#ifdef TSCH_CONF_HW_TIMED_RADIO_MARGIN
+#define TSCH_HW_TIMED_RADIO_MARGIN TSCH_CONF_HW_TIMED_RADIO_MARGIN
+#else
+#define TSCH_HW_TIMED_RADIO_MARGIN 100
+#endif
+
+/* Slot-timing profiler: keep per-phase min/max/mean and a histogram of the
+ * durations measured during link operation, over a rolling window */
+#ifdef TSCH_CONF_WITH_SLOT_PROFILER
+#define TSCH_WITH_SLOT_PROFILER TSCH_CONF_WITH_SLOT_PROFILER
+#else
+#define TSCH_WITH_SLOT_PROFILER 0
+#endif
+
+/* Number of link operations in a profiling window */
+#ifdef TSCH_CONF_SLOT_PROFILER_WINDOW
+#define TSCH_SLOT_PROFILER_WINDOW TSCH_CONF_SLOT_PROFILER_WINDOW
+#else
+#define TSCH_SLOT_PROFILER_WINDOW 256
+#endif
+
+/* Number of histogram buckets, the last one collects all overflows */
+#ifdef TSCH_CONF_SLOT_PROFILER_BUCKETS
+#define TSCH_SLOT_PROFILER_BUCKETS TSCH_CONF_SLOT_PROFILER_BUCKETS
+#else
+#define TSCH_SLOT_PROFILER_BUCKETS 16
+#endif
+
+/* Width of a histogram bucket, in us (converted to rtimer ticks per platform) */
+#ifdef TSCH_CONF_SLOT_PROFILER_BUCKET_US
+#define TSCH_SLOT_PROFILER_BUCKET_US TSCH_CONF_SLOT_PROFILER_BUCKET_US
+#else
+#define TSCH_SLOT_PROFILER_BUCKET_US 500
+#endif
+
+/* Deadline-miss accounting: count the deadlines missed when scheduling
+ * link operation, per link type, slotframe and overrunning phase */
+#ifdef TSCH_CONF_WITH_DL_MISS_STATS
+#define TSCH_WITH_DL_MISS_STATS TSCH_CONF_WITH_DL_MISS_STATS
+#else
+#define TSCH_WITH_DL_MISS_STATS 0
+#endif
+
+/* Number of most recent deadline misses kept with their ASN */
+#ifdef TSCH_CONF_DL_MISS_LOG_LEN
+#define TSCH_DL_MISS_LOG_LEN TSCH_CONF_DL_MISS_LOG_LEN
+#else
+#define TSCH_DL_MISS_LOG_LEN 8
+#endif
+
+/* Number of slotframes with their own deadline-miss counter */
+#ifdef TSCH_CONF_DL_MISS_MAX_SLOTFRAMES
+#define TSCH_DL_MISS_MAX_SLOTFRAMES TSCH_CONF_DL_MISS_MAX_SLOTFRAMES
+#else
+#define TSCH_DL_MISS_MAX_SLOTFRAMES 4
+#endif
+
+/* Radio-on time accounting per link type and slotframe, telling
+ * transmission, reception and idle listening apart */
+#ifdef TSCH_CONF_WITH_ENERGEST
+#define TSCH_WITH_ENERGEST TSCH_CONF_WITH_ENERGEST
+#else
+#define TSCH_WITH_ENERGEST 0
+#endif
+
+/* Number of slotframes with their own radio-on counters */
+#ifdef TSCH_CONF_ENERGEST_MAX_SLOTFRAMES
+#define TSCH_ENERGEST_MAX_SLOTFRAMES TSCH_CONF_ENERGEST_MAX_SLOTFRAMES
+#else
+#define TSCH_ENERGEST_MAX_SLOTFRAMES 4
+#endif
+
+/* Early rejection of frames for other nodes: once the destination
+ * address of a frame is received, turn the radio off if it is a unicast
+ * to another node rather than listen to the rest of it. Needs a radio
+ * that supports RADIO_PARAM_RX_HEADER, is a no-op otherwise */
+#ifdef TSCH_CONF_RX_EARLY_REJECT
+#define TSCH_RX_EARLY_REJECT TSCH_CONF_RX_EARLY_REJECT
+#else
+#define TSCH_RX_EARLY_REJECT 0
+#endif
+
+/* CPU time accounting of the link operation, in rtimer interrupt */
+#ifdef TSCH_CONF_WITH_CPU_TIME
+#define TSCH_WITH_CPU_TIME TSCH_CONF_WITH_CPU_TIME
+#else
+#define TSCH_WITH_CPU_TIME 0
+#endif
+
 /* TSCH MAC parameters */
 #define MAC_MIN_BE 0
+/* Highest number of retransmissions of a packet. Can be lowered per packet,
+ * see TSCH_QUEUE_RETRIES_ETX_FACTOR and TSCH_QUEUE_WITH_PACKET_MAX_TRANSMISSIONS */
+#ifdef TSCH_CONF_MAC_MAX_FRAME_RETRIES
+#define MAC_MAX_FRAME_RETRIES TSCH_CONF_MAC_MAX_FRAME_RETRIES
+#else
 #define MAC_MAX_FRAME_RETRIES 8
+#endif
 #define MAC_MAX_BE 4
 
 /* TSCH packet len */
@@ -111,9 +423,30 @@
 #else
 #define TSCH_PACKET_DEST_ADDR_IN_ACK 0
 #endif
+/* Piggyback hints from the receiver in enhanced ACKs: its free Rx
+ * capacity, its queue towards the sender, and flags (e.g. it is about to
+ * drop the link). See TSCH_CALLBACK_ACK_HINTS and TSCH_CALLBACK_ACK_HINTS_RECEIVED */
+#ifdef TSCH_CONF_PACKET_WITH_ACK_HINTS
+#define TSCH_PACKET_WITH_ACK_HINTS TSCH_CONF_PACKET_WITH_ACK_HINTS
+#else
+#define TSCH_PACKET_WITH_ACK_HINTS 0
+#endif
+#define TSCH_ACK_HINTS_IE_LEN 5
 #define TSCH_ACK_LEN (TSCH_BASE_ACK_LEN \
                       + TSCH_PACKET_WITH_SYNC_IE*TSCH_SYNC_IE_LEN \
-                      + TSCH_PACKET_DEST_ADDR_IN_ACK*TSCH_EACK_DEST_LEN)
+                      + TSCH_PACKET_DEST_ADDR_IN_ACK*TSCH_EACK_DEST_LEN \
+                      + TSCH_PACKET_WITH_ACK_HINTS*TSCH_ACK_HINTS_IE_LEN)
+
+/* Hints carried in enhanced ACKs */
+struct tsch_ack_hints {
+  uint8_t rx_free; /* Free slots in the receiver's incoming packet ringbuf */
+  uint8_t queue_len; /* Packets the receiver has queued for the sender */
+  uint8_t flags; /* TSCH_ACK_HINT_* */
+};
+/* The receiver is about to remove the link the frame was received on */
+#define TSCH_ACK_HINT_LINK_EXPIRING 1
+/* Flags from this bit on are left to the TSCH_CALLBACK_ACK_HINTS user */
+#define TSCH_ACK_HINT_USER_SHIFT 4
 
 /* Calculate packet tx/rc duration based on sent packet len assuming 802.15.4 250kbps data rate
  * PHY packet length: payload_len + CHECKSUM_LEN(2) + PHY_LEN_FIELD(1) */
@@ -124,15 +457,145 @@
 #define TSCH_DATA_MAX_DURATION ((unsigned)(TSCH_PACKET_DURATION(TSCH_MAX_PACKET_LEN) + US_TO_RTIMERTICKS(350)))
 #define TSCH_ACK_MAX_DURATION  ((unsigned)(TSCH_PACKET_DURATION(TSCH_ACK_LEN) + US_TO_RTIMERTICKS(350)))
 
+/* Default timeslot template, in us. The coordinator can set another one
+ * at runtime with tsch_set_timeslot_timing(), joining nodes adopt the
+ * template announced in the EB they join from */
+#ifdef TSCH_CONF_DEFAULT_TS_CCA_OFFSET
+#define TSCH_DEFAULT_TS_CCA_OFFSET TSCH_CONF_DEFAULT_TS_CCA_OFFSET
+#else
+#define TSCH_DEFAULT_TS_CCA_OFFSET 1800
+#endif
+
+#ifdef TSCH_CONF_DEFAULT_TS_CCA
+#define TSCH_DEFAULT_TS_CCA TSCH_CONF_DEFAULT_TS_CCA
+#else
+#define TSCH_DEFAULT_TS_CCA 128
+#endif
+
+#ifdef TSCH_CONF_DEFAULT_TS_TX_OFFSET
+#define TSCH_DEFAULT_TS_TX_OFFSET TSCH_CONF_DEFAULT_TS_TX_OFFSET
+#else
+#define TSCH_DEFAULT_TS_TX_OFFSET 4000
+#endif
+
+#ifdef TSCH_CONF_DEFAULT_TS_TX_ACK_DELAY
+#define TSCH_DEFAULT_TS_TX_ACK_DELAY TSCH_CONF_DEFAULT_TS_TX_ACK_DELAY
+#else
+#define TSCH_DEFAULT_TS_TX_ACK_DELAY 4000
+#endif
+
+#ifdef TSCH_CONF_DEFAULT_TS_TIMESLOT_LENGTH
+#define TSCH_DEFAULT_TS_TIMESLOT_LENGTH TSCH_CONF_DEFAULT_TS_TIMESLOT_LENGTH
+#else
+#define TSCH_DEFAULT_TS_TIMESLOT_LENGTH 15000
+#endif
+
+/* Timeslot template, all durations in rtimer ticks */
+struct tsch_timeslot_timing {
+  rtimer_clock_t cca_offset;
+  rtimer_clock_t cca;
+  rtimer_clock_t tx_offset;
+  rtimer_clock_t tx_ack_delay;
+  rtimer_clock_t slot_duration;
+};
+/* The compile-time default template, and the template in use */
+extern const struct tsch_timeslot_timing tsch_default_timing;
+extern struct tsch_timeslot_timing tsch_timing;
+
 /* Timeslot timing */
-#define TsCCAOffset         ((unsigned)US_TO_RTIMERTICKS(1800))
-#define TsCCA               ((unsigned)US_TO_RTIMERTICKS(128))
+#define TsCCAOffset         (tsch_timing.cca_offset)
+#define TsCCA               (tsch_timing.cca)
 
-#define TsTxOffset          ((unsigned)US_TO_RTIMERTICKS(4000))
-#define TsTxAckDelay        ((unsigned)US_TO_RTIMERTICKS(4000))
+#define TsTxOffset          (tsch_timing.tx_offset)
+#define TsTxAckDelay        (tsch_timing.tx_ack_delay)
 #define TsLongGT            ((unsigned)US_TO_RTIMERTICKS(TSCH_GUARD_TIME))
 #define TsShortGT           ((unsigned)US_TO_RTIMERTICKS(400))
-#define TsSlotDuration      ((unsigned)US_TO_RTIMERTICKS(15000))
+#define TsSlotDuration      (tsch_timing.slot_duration)
+
+/* Channel hopping sequences. 16_16 is the standard 6TiSCH one; INDRIYA is
+ * ordered by measured goodness from a specific testbed experiment in Indriya */
+#define TSCH_HOPPING_SEQUENCE_16_16 (uint8_t[]){ 16, 17, 23, 18, 26, 15, 25, 22, 19, 11, 12, 13, 24, 14, 20, 21 }
+#define TSCH_HOPPING_SEQUENCE_4_16 (uint8_t[]){ 20, 26, 25, 26, 15, 15, 25, 20, 26, 15, 26, 25, 20, 15, 20, 25 }
+#define TSCH_HOPPING_SEQUENCE_4_4 (uint8_t[]){ 15, 25, 26, 20 }
+#define TSCH_HOPPING_SEQUENCE_2_2 (uint8_t[]){ 20, 25 }
+#define TSCH_HOPPING_SEQUENCE_1_1 (uint8_t[]){ 20 }
+#define TSCH_HOPPING_SEQUENCE_INDRIYA (uint8_t[]){ 26, 15, 25, 20, 16, 19, 14, 24, 18, 17, 17, 11, 21, 23, 12, 22, 13 }
+
+/* Default hopping sequence. The coordinator can set another one at runtime
+ * with tsch_set_hopping_sequence(), joining nodes adopt the sequence
+ * announced in the EB they join from */
+#ifdef TSCH_CONF_DEFAULT_HOPPING_SEQUENCE
+#define TSCH_DEFAULT_HOPPING_SEQUENCE TSCH_CONF_DEFAULT_HOPPING_SEQUENCE
+#else
+#define TSCH_DEFAULT_HOPPING_SEQUENCE TSCH_HOPPING_SEQUENCE_INDRIYA
+#endif
+
+/* Max length of a hopping sequence */
+#ifdef TSCH_CONF_HOPPING_SEQUENCE_MAX_LEN
+#define TSCH_HOPPING_SEQUENCE_MAX_LEN TSCH_CONF_HOPPING_SEQUENCE_MAX_LEN
+#else
+#define TSCH_HOPPING_SEQUENCE_MAX_LEN 16
+#endif
+
+/* Adaptive channel blacklisting: the coordinator periodically removes from
+ * the default hopping sequence the channels on which its unicast
+ * transmissions fail, and schedules the new sequence network-wide through EBs */
+#ifdef TSCH_CONF_CHANNEL_BLACKLIST
+#define TSCH_CHANNEL_BLACKLIST TSCH_CONF_CHANNEL_BLACKLIST
+#else
+#define TSCH_CHANNEL_BLACKLIST 0
+#endif
+
+/* Collect per-channel Tx/Rx statistics */
+#ifdef TSCH_CONF_WITH_CHANNEL_STATS
+#define TSCH_WITH_CHANNEL_STATS TSCH_CONF_WITH_CHANNEL_STATS
+#else
+#define TSCH_WITH_CHANNEL_STATS TSCH_CHANNEL_BLACKLIST
+#endif
+
+/* Period at which the blacklist is evaluated, and the statistics reset */
+#ifdef TSCH_CONF_CHANNEL_BLACKLIST_PERIOD
+#define TSCH_CHANNEL_BLACKLIST_PERIOD TSCH_CONF_CHANNEL_BLACKLIST_PERIOD
+#else
+#define TSCH_CHANNEL_BLACKLIST_PERIOD (5 * 60 * CLOCK_SECOND)
+#endif
+
+/* Min number of unicast transmissions on a channel to judge it */
+#ifdef TSCH_CONF_CHANNEL_BLACKLIST_MIN_TX
+#define TSCH_CHANNEL_BLACKLIST_MIN_TX TSCH_CONF_CHANNEL_BLACKLIST_MIN_TX
+#else
+#define TSCH_CHANNEL_BLACKLIST_MIN_TX 20
+#endif
+
+/* Channels with a lower ACK ratio (%) are blacklisted */
+#ifdef TSCH_CONF_CHANNEL_BLACKLIST_PDR_THRESHOLD
+#define TSCH_CHANNEL_BLACKLIST_PDR_THRESHOLD TSCH_CONF_CHANNEL_BLACKLIST_PDR_THRESHOLD
+#else
+#define TSCH_CHANNEL_BLACKLIST_PDR_THRESHOLD 50
+#endif
+
+/* Never hop over fewer channels than this */
+#ifdef TSCH_CONF_CHANNEL_BLACKLIST_MIN_CHANNELS
+#define TSCH_CHANNEL_BLACKLIST_MIN_CHANNELS TSCH_CONF_CHANNEL_BLACKLIST_MIN_CHANNELS
+#else
+#define TSCH_CHANNEL_BLACKLIST_MIN_CHANNELS 4
+#endif
+
+/* Number of periods after which blacklisted channels, that we no longer
+ * get samples from, are tried again */
+#ifdef TSCH_CONF_CHANNEL_BLACKLIST_LIFETIME
+#define TSCH_CHANNEL_BLACKLIST_LIFETIME TSCH_CONF_CHANNEL_BLACKLIST_LIFETIME
+#else
+#define TSCH_CHANNEL_BLACKLIST_LIFETIME 12
+#endif
+
+/* Delay (in seconds) between scheduling a new sequence and using it,
+ * for the EBs announcing it to reach all nodes */
+#ifdef TSCH_CONF_CHANNEL_BLACKLIST_ACTIVATION_DELAY
+#define TSCH_CHANNEL_BLACKLIST_ACTIVATION_DELAY TSCH_CONF_CHANNEL_BLACKLIST_ACTIVATION_DELAY
+#else
+#define TSCH_CHANNEL_BLACKLIST_ACTIVATION_DELAY (4 * TSCH_MAX_EB_PERIOD / CLOCK_SECOND)
+#endif
 
 /* The ASN is an absolute slot number over 5 bytes. */
 struct asn_t {
@@ -183,6 +646,25 @@ struct asn_divisor_t {
   +(uint16_t)((asn).ms1b * (div).asn_ms1b_remainder % (div).val)) \
   % (div).val
 
+/* ASN modulo a divisor, for an ASN that moves forward by a few slots at a
+ * time (the link operation). The remainder of the last ASN is moved along
+ * by subtractions, as the MSP430 has no hardware divider. ASN_MOD is done
+ * again only after a reset, or a jump backward or of more than 0xffff slots */
+struct asn_cursor_t {
+  struct asn_t asn; /* The last ASN */
+  uint16_t mod; /* asn % divisor */
+  uint8_t valid;
+};
+
+/* Invalidate a cursor, e.g. when its divisor changes */
+#define ASN_CURSOR_RESET(c) ((c).valid = 0)
+
+/* Returns asn % div, and moves the cursor to asn */
+uint16_t tsch_asn_cursor_mod(struct asn_cursor_t *c, const struct asn_t *asn,
+                             const struct asn_divisor_t *div);
+/* Returns x % val, by subtractions if x is less than 16 times val */
+uint16_t tsch_mod16(uint32_t x, uint16_t val);
+
 /* 802.15.4 broadcast MAC address */
 extern const linkaddr_t tsch_broadcast_address;
 /* The address we use to identify EB queue */
@@ -202,14 +684,237 @@ int tsch_is_locked();
 int tsch_get_lock();
 /* Release TSCH lock */
 void tsch_release_lock();
+struct tsch_packet;
+/* Pass a packet removed from its queue with the lock held to the pending
+ * events process, for the packet_sent callback. Returns 0 if no space */
+int tsch_dequeued_packet_add(struct tsch_packet *p);
+
+/* The hopping sequence in use */
+extern uint8_t hopping_sequence_list[TSCH_HOPPING_SEQUENCE_MAX_LEN];
+extern struct asn_divisor_t hopping_sequence_length;
 
 /* Returns a 802.15.4 channel from an ASN and channel offset */
 uint8_t tsch_calculate_channel(struct asn_t *asn, uint8_t channel_offset);
+/* Set the channel hopping sequence. Only possible while not associated,
+ * i.e. on the coordinator before it starts, or when joining.
+ * NULL restores the default sequence. Returns 1 if the sequence was valid and applied */
+int tsch_set_hopping_sequence(const uint8_t *sequence, uint8_t len);
+/* Is the hopping sequence in use the default one? */
+int tsch_hopping_sequence_is_default(void);
+
+/* A hopping sequence change, scheduled at an ASN */
+struct tsch_hopping_sequence_change {
+  uint8_t len; /* 0 if no change is scheduled */
+  uint8_t channels[TSCH_HOPPING_SEQUENCE_MAX_LEN];
+  struct asn_t asn;
+};
+/* The scheduled change, announced in our EBs until it happens */
+extern struct tsch_hopping_sequence_change tsch_next_hopping_sequence;
+/* Switch to a new hopping sequence at a given ASN. All nodes must switch
+ * at the same ASN: the change is announced in EBs until then.
+ * Returns 1 if the sequence was valid and the change scheduled */
+int tsch_schedule_hopping_sequence(const uint8_t *sequence, uint8_t len, const struct asn_t *asn);
+
+/* A change of the number of cells of the minimal schedule, at an ASN */
+struct tsch_minimal_change {
+  uint8_t num_cells; /* 0 if no change is scheduled */
+  struct asn_t asn;
+};
+/* The scheduled change, announced in our EBs until it happens */
+extern struct tsch_minimal_change tsch_next_minimal_change;
+/* Rebuild the minimal schedule with num_cells cells at a given ASN, see
+ * tsch_schedule_create_minimal_cells. The change is announced in EBs
+ * until then, and followed by the nodes that hear it from their time
+ * source. Returns 1 if the change was scheduled */
+int tsch_schedule_minimal_change(uint8_t num_cells, const struct asn_t *asn);
+
+/* Per-channel link quality */
+struct tsch_channel_stats {
+  uint16_t tx; /* Unicast transmissions */
+  uint16_t tx_ok; /* Unicast transmissions that were acked */
+  uint16_t rx; /* Frames received */
+};
+/* Get the statistics of a channel (11 to 26), NULL if invalid or not collected */
+const struct tsch_channel_stats *tsch_get_channel_stats(uint8_t channel);
+/* Reset all per-channel statistics */
+void tsch_reset_channel_stats(void);
 /* The the period at which EBs are sent */
 void tsch_set_eb_period(uint32_t period);
+/* Set a fixed EB period (at least one second), e.g. from the shell,
+ * overriding the one set by RPL or adapted. 0 to go back to the latter */
+void tsch_set_fixed_eb_period(clock_time_t period);
+/* The period at which EBs are currently sent */
+clock_time_t tsch_get_eb_period(void);
+/* Set the keepalive timeout, TSCH_KEEPALIVE_TIMEOUT at startup. With
+ * TSCH_ADAPTIVE_KEEPALIVE, it is the shortest keepalive period */
+void tsch_set_keepalive_timeout(clock_time_t timeout);
+clock_time_t tsch_get_keepalive_timeout(void);
+#if TSCH_ADAPTIVE_EB_PERIOD
+/* Adaptive EB period: report that joiners may be around, e.g. upon a
+ * Trickle reset. EBs are sent at TSCH_MIN_EB_PERIOD for a window */
+void tsch_adaptive_eb_joiner_hint(void);
+#endif /* TSCH_ADAPTIVE_EB_PERIOD */
+/* Set the timeslot template. Only possible while not associated, i.e.
+ * on the coordinator before it starts, or when joining.
+ * Returns 1 if the template was valid and applied */
+int tsch_set_timeslot_timing(const struct tsch_timeslot_timing *timing);
 /* Brief dump of the TSCH state */
 void tsch_dump_status();
 
+/* Incoming packet ringbuf counters */
+struct tsch_rx_ring_stats {
+  /* Packets added to the ringbuf */
+  uint32_t received;
+  /* Rx links skipped because the ringbuf was full */
+  uint16_t full;
+  /* Highest number of packets waiting in the ringbuf */
+  uint8_t max_used;
+};
+/* Get the incoming packet ringbuf counters */
+const struct tsch_rx_ring_stats *tsch_get_rx_ring_stats(void);
+
+/* Cost of the last association */
+struct tsch_association_stats {
+  /* Time from the start of the scan to association */
+  clock_time_t join_time;
+  /* Time the radio was on during the scan */
+  clock_time_t radio_on_time;
+  /* Number of channel dwells */
+  uint16_t channels_scanned;
+  /* Number of frames received during the scan, EB or not */
+  uint16_t frames_received;
+  /* Number of EBs parsed, whether we joined from them or not */
+  uint16_t ebs_parsed;
+};
+/* Get the cost of the last association (or of the scan in progress) */
+const struct tsch_association_stats *tsch_get_association_stats(void);
+
+/* Phases of a link operation, as timed by the slot profiler */
+enum tsch_slot_phase {
+  TSCH_SLOT_PHASE_PREPARE,
+  TSCH_SLOT_PHASE_TX,
+  TSCH_SLOT_PHASE_TX_ACK,
+  TSCH_SLOT_PHASE_POST_TX,
+  TSCH_SLOT_PHASE_RX,
+  TSCH_SLOT_PHASE_RX_ACK,
+  TSCH_SLOT_PHASE_COUNT
+};
+/* Short name of a phase, for printing */
+const char *tsch_slot_phase_name(enum tsch_slot_phase phase);
+
+#if TSCH_WITH_SLOT_PROFILER
+
+/* Timing profile of a phase over a window, all durations in rtimer ticks */
+struct tsch_slot_profile {
+  uint16_t count;
+  rtimer_clock_t min;
+  rtimer_clock_t max;
+  uint32_t sum;
+  uint16_t hist[TSCH_SLOT_PROFILER_BUCKETS];
+};
+
+/* Get the profile of a phase over the last complete window.
+ * Returns 0 if no window has completed yet */
+int tsch_slot_profiler_get(enum tsch_slot_phase phase, struct tsch_slot_profile *profile);
+/* Restart profiling from an empty window */
+int tsch_slot_profiler_reset(void);
+/* Width of a histogram bucket, in rtimer ticks */
+rtimer_clock_t tsch_slot_profiler_bucket_width(void);
+#endif /* TSCH_WITH_SLOT_PROFILER */
+
+#if TSCH_WITH_DL_MISS_STATS
+/* A missed deadline. phase is the phase of link operation that overran,
+ * TSCH_SLOT_PHASE_COUNT if none was running (e.g. when the schedule
+ * lookup itself was late) */
+struct tsch_dl_miss {
+  struct asn_t asn;
+  uint16_t slotframe_handle;
+  uint16_t timeslot;
+  uint8_t link_type;
+  uint8_t phase;
+  /* Was the whole link skipped, or only a wait within the link? */
+  uint8_t skipped;
+  /* How late we were, in rtimer ticks */
+  rtimer_clock_t late;
+};
+
+/* Deadline-miss counters */
+struct tsch_dl_miss_stats {
+  uint32_t total;
+  /* Links skipped altogether */
+  uint32_t skipped;
+  /* Per enum link_type, the last entry is for slots without link */
+  uint16_t per_link_type[4];
+  /* Per overrunning phase, the last entry is for no phase */
+  uint16_t per_phase[TSCH_SLOT_PHASE_COUNT + 1];
+  /* Per slotframe, first come first served */
+  struct {
+    uint16_t handle;
+    uint16_t count;
+  } per_slotframe[TSCH_DL_MISS_MAX_SLOTFRAMES];
+  /* Misses in slotframes that did not get a counter */
+  uint16_t other_slotframes;
+};
+
+/* Get the deadline-miss counters */
+const struct tsch_dl_miss_stats *tsch_dl_miss_get_stats(void);
+/* Get the i-th most recent deadline miss (0 being the last one).
+ * Returns 0 if there is no such miss */
+int tsch_dl_miss_get_last(uint8_t i, struct tsch_dl_miss *miss);
+/* Reset all deadline-miss counters and the log of last misses */
+int tsch_dl_miss_reset(void);
+#endif /* TSCH_WITH_DL_MISS_STATS */
+
+#if TSCH_WITH_ENERGEST
+/* Radio-on time of a set of links, in rtimer ticks */
+struct tsch_energest {
+  /* Transmitting frames and ACKs */
+  uint32_t tx;
+  /* Listening while a frame or an ACK was received */
+  uint32_t rx;
+  /* Listening for nothing: idle Rx links and missing ACKs */
+  uint32_t rx_idle;
+};
+
+/* Radio-on counters, cumulative since boot */
+struct tsch_energest_stats {
+  /* Per enum link_type */
+  struct tsch_energest per_link_type[3];
+  /* Shared links, whatever their type: contention */
+  struct tsch_energest shared;
+  /* Per slotframe, first come first served */
+  struct {
+    uint16_t handle;
+    struct tsch_energest e;
+  } per_slotframe[TSCH_ENERGEST_MAX_SLOTFRAMES];
+  /* Slotframes that did not get counters */
+  struct tsch_energest other_slotframes;
+  /* Listening while scanning for EBs, before association */
+  uint32_t scan;
+};
+
+/* Get the radio-on counters */
+const struct tsch_energest_stats *tsch_energest_get_stats(void);
+#endif /* TSCH_WITH_ENERGEST */
+
+#if TSCH_RX_EARLY_REJECT
+/* Frames for other nodes dropped after their header, cumulative since boot */
+struct tsch_rx_early_reject_stats {
+  /* Number of frames dropped */
+  uint32_t count;
+  /* Radio-on time saved, in rtimer ticks */
+  uint32_t saved;
+};
+
+/* Get the early rejection counters */
+const struct tsch_rx_early_reject_stats *tsch_rx_early_reject_get_stats(void);
+#endif /* TSCH_RX_EARLY_REJECT */
+
+#if TSCH_WITH_CPU_TIME
+/* Get the time spent in tsch_link_operation since boot, in rtimer ticks */
+uint32_t tsch_get_cpu_time(void);
+#endif /* TSCH_WITH_CPU_TIME */
+
 #ifndef MIN
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #endif /* MIN */
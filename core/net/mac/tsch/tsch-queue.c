@@ -50,6 +50,8 @@
 #include "net/mac/tsch/tsch-private.h"
 #include "net/mac/tsch/tsch-queue.h"
 #include "net/mac/tsch/tsch-schedule.h"
+#include "net/mac/tsch/tsch-packet.h"
+#include "net/ipv6/sicslowpan.h"
 #include "net/rpl/rpl.h"
 #include "net/rpl/rpl-private.h"
 #include <string.h>
@@ -58,18 +60,45 @@
 void TSCH_CALLBACK_NEW_TIME_SOURCE(struct tsch_neighbor *old, struct tsch_neighbor *new);
 #endif
 
+#ifdef TSCH_CALLBACK_SELECT_PACKET
+uint16_t TSCH_CALLBACK_SELECT_PACKET(void);
+#endif
+
+#ifdef TSCH_CALLBACK_NEW_BACKUP_TIME_SOURCE
+void TSCH_CALLBACK_NEW_BACKUP_TIME_SOURCE(struct tsch_neighbor *old, struct tsch_neighbor *new);
+#endif
+
 #define DEBUG DEBUG_NONE
 #include "net/ip/uip-debug.h"
 
 /* We have as many packets are there are queuebuf in the system */
-MEMB(packet_memb, struct tsch_packet, QUEUEBUF_NUM);
-MEMB(neighbor_memb, struct tsch_neighbor, TSCH_QUEUE_MAX_NEIGHBOR_QUEUES);
+MEMB_FREE_LIST(packet_memb, struct tsch_packet, QUEUEBUF_NUM);
+MEMB_FREE_LIST(neighbor_memb, struct tsch_neighbor, TSCH_QUEUE_MAX_NEIGHBOR_QUEUES);
 LIST(neighbor_list);
+/* Hash table for neighbor lookup, chained through hash_next */
+static struct tsch_neighbor *neighbor_hash[TSCH_QUEUE_NBR_HASH_SIZE];
+#define NBR_HASH(addr) (((addr)->u8[LINKADDR_SIZE - 1] + (addr)->u8[LINKADDR_SIZE - 2]) \
+                        & (TSCH_QUEUE_NBR_HASH_SIZE - 1))
+
+/* Number of Tx, Shared slots to the broadcast address. Neighbors with no
+ * tx link count their backoff in these slots, others in their own slots */
+static uint32_t broadcast_shared_slot_count;
+#define SHARED_SLOT_COUNT(n) ((n)->tx_links_count == 0 ? broadcast_shared_slot_count \
+                                                        : (n)->shared_slot_count)
 
 /* Broadcast and EB virtual neighbors */
 struct tsch_neighbor *n_broadcast;
 struct tsch_neighbor *n_eb;
 
+#if TSCH_QUEUE_WITH_LOAD_EVENTS
+process_event_t tsch_queue_event_load;
+static uint8_t congested;
+static void update_load(void);
+#define UPDATE_LOAD() update_load()
+#else /* TSCH_QUEUE_WITH_LOAD_EVENTS */
+#define UPDATE_LOAD()
+#endif /* TSCH_QUEUE_WITH_LOAD_EVENTS */
+
 /**
  *  A pseudo-random generator with better properties than msp430-libc's default
  **/
@@ -101,13 +130,14 @@ tsch_queue_add_nbr(const linkaddr_t *addr)
       if(n != NULL) {
         /* Initialize neighbor entry */
         memset(n, 0, sizeof(struct tsch_neighbor));
-        ringbufindex_init(&n->tx_ringbuf, TSCH_QUEUE_NUM_PER_NEIGHBOR);
         linkaddr_copy(&n->addr, addr);
         n->is_broadcast = linkaddr_cmp(addr, &tsch_eb_address)
                     || linkaddr_cmp(addr, &tsch_broadcast_address);
         tsch_queue_backoff_reset(n);
-        /* Add neighbor to the list */
+        /* Add neighbor to the list and hash table */
         list_add(neighbor_list, n);
+        n->hash_next = neighbor_hash[NBR_HASH(addr)];
+        neighbor_hash[NBR_HASH(addr)] = n;
       }
       tsch_release_lock();
     }
@@ -128,12 +158,12 @@ struct tsch_neighbor *
 tsch_queue_get_nbr(const linkaddr_t *addr)
 {
   if(!tsch_is_locked()) {
-    struct tsch_neighbor *n = list_head(neighbor_list);
+    struct tsch_neighbor *n = neighbor_hash[NBR_HASH(addr)];
     while(n != NULL) {
       if(linkaddr_cmp(&n->addr, addr)) {
         return n;
       }
-      n = list_item_next(n);
+      n = n->hash_next;
     }
   }
   return NULL;
@@ -164,6 +194,9 @@ tsch_queue_update_time_source(const linkaddr_t *new_addr)
       struct tsch_neighbor *new_time_src = new_addr ? tsch_queue_add_nbr(new_addr) : NULL;
 
       if(new_time_src != old_time_src) {
+#if TSCH_WITH_BACKUP_TIME_SOURCE && defined(TSCH_CALLBACK_NEW_BACKUP_TIME_SOURCE)
+        int backup_took_over = 0;
+#endif /* TSCH_WITH_BACKUP_TIME_SOURCE && defined(TSCH_CALLBACK_NEW_BACKUP_TIME_SOURCE) */
         LOG("TSCH: update time source: %u -> %u\n",
             LOG_NODEID_FROM_LINKADDR(old_time_src ? &old_time_src->addr : NULL),
             LOG_NODEID_FROM_LINKADDR(new_time_src ? &new_time_src->addr : NULL));
@@ -171,6 +204,15 @@ tsch_queue_update_time_source(const linkaddr_t *new_addr)
         /* Update time source */
         if(new_time_src != NULL) {
           new_time_src->is_time_source = 1;
+#if TSCH_WITH_BACKUP_TIME_SOURCE
+          if(new_time_src->is_backup_time_source) {
+            /* The backup takes over: no backup until a new one is set */
+            new_time_src->is_backup_time_source = 0;
+#ifdef TSCH_CALLBACK_NEW_BACKUP_TIME_SOURCE
+            backup_took_over = 1;
+#endif
+          }
+#endif /* TSCH_WITH_BACKUP_TIME_SOURCE */
         }
 
         if(old_time_src != NULL) {
@@ -180,6 +222,13 @@ tsch_queue_update_time_source(const linkaddr_t *new_addr)
 #ifdef TSCH_CALLBACK_NEW_TIME_SOURCE
         TSCH_CALLBACK_NEW_TIME_SOURCE(old_time_src, new_time_src);
 #endif
+#if TSCH_WITH_BACKUP_TIME_SOURCE && defined(TSCH_CALLBACK_NEW_BACKUP_TIME_SOURCE)
+        /* After the time source callback, so that the links of the former
+         * backup are there all along */
+        if(backup_took_over) {
+          TSCH_CALLBACK_NEW_BACKUP_TIME_SOURCE(new_time_src, NULL);
+        }
+#endif /* TSCH_WITH_BACKUP_TIME_SOURCE && defined(TSCH_CALLBACK_NEW_BACKUP_TIME_SOURCE) */
 
         return 1;
       }
@@ -187,6 +236,52 @@ tsch_queue_update_time_source(const linkaddr_t *new_addr)
   }
   return 0;
 }
+#if TSCH_WITH_BACKUP_TIME_SOURCE
+/* Get the backup time source */
+struct tsch_neighbor *
+tsch_queue_get_backup_time_source(void)
+{
+  if(!tsch_is_locked()) {
+    struct tsch_neighbor *curr_nbr = list_head(neighbor_list);
+    while(curr_nbr != NULL) {
+      if(curr_nbr->is_backup_time_source) {
+        return curr_nbr;
+      }
+      curr_nbr = list_item_next(curr_nbr);
+    }
+  }
+  return NULL;
+}
+/* Update the backup time source */
+int
+tsch_queue_update_backup_time_source(const linkaddr_t *new_addr)
+{
+  if(!tsch_is_locked() && !tsch_is_coordinator) {
+    struct tsch_neighbor *old_backup = tsch_queue_get_backup_time_source();
+    struct tsch_neighbor *new_backup = new_addr ? tsch_queue_add_nbr(new_addr) : NULL;
+
+    if(new_backup != NULL && new_backup->is_time_source) {
+      new_backup = NULL;
+    }
+    if(new_backup != old_backup) {
+      LOG("TSCH: update backup time source: %u -> %u\n",
+          LOG_NODEID_FROM_LINKADDR(old_backup ? &old_backup->addr : NULL),
+          LOG_NODEID_FROM_LINKADDR(new_backup ? &new_backup->addr : NULL));
+      if(new_backup != NULL) {
+        new_backup->is_backup_time_source = 1;
+      }
+      if(old_backup != NULL) {
+        old_backup->is_backup_time_source = 0;
+      }
+#ifdef TSCH_CALLBACK_NEW_BACKUP_TIME_SOURCE
+      TSCH_CALLBACK_NEW_BACKUP_TIME_SOURCE(old_backup, new_backup);
+#endif
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif /* TSCH_WITH_BACKUP_TIME_SOURCE */
 /* Flush a neighbor queue */
 static void
 tsch_queue_flush_nbr_queue(struct tsch_neighbor *n)
@@ -209,9 +304,16 @@ tsch_queue_remove_nbr(struct tsch_neighbor *n)
 {
   if(n != NULL) {
     if(tsch_get_lock()) {
+      struct tsch_neighbor **prev = &neighbor_hash[NBR_HASH(&n->addr)];
 
-      /* Remove neighbor from list */
+      /* Remove neighbor from list and hash table */
       list_remove(neighbor_list, n);
+      while(*prev != NULL && *prev != n) {
+        prev = &(*prev)->hash_next;
+      }
+      if(*prev != NULL) {
+        *prev = n->hash_next;
+      }
 
       tsch_release_lock();
 
@@ -227,39 +329,262 @@ tsch_queue_remove_nbr(struct tsch_neighbor *n)
     }
   }
 }
-/* Add packet to neighbor queue. Use same lockfree implementation as ringbuf.c (put is atomic) */
+/* Number of packets in a FIFO */
+#define FIFO_LEN(q) ((uint8_t)((q)->put_count - (q)->get_count))
+/* Append a packet to a FIFO. Called from process context only,
+ * may be interrupted by a get at any point */
+static void
+fifo_put(struct tsch_queue_fifo *q, struct tsch_packet *p)
+{
+  p->next = NULL;
+  if(FIFO_LEN(q) == 0) {
+    /* Empty queue: get does not touch head */
+    q->head = p;
+  } else {
+    q->tail->next = p;
+    if(FIFO_LEN(q) == 0) {
+      /* The queue was drained before we linked p to the tail */
+      q->head = p;
+    }
+  }
+  q->tail = p;
+  /* Commit */
+  q->put_count++;
+}
+/* Remove the head packet of a FIFO (remove committed through an atomic operation) */
+static struct tsch_packet *
+fifo_get(struct tsch_queue_fifo *q)
+{
+  struct tsch_packet *p = q->head;
+  q->head = p->next;
+  q->get_count++;
+  return p;
+}
+/* Number of packets in a neighbor queue, all classes */
+static uint8_t
+queue_len(const struct tsch_neighbor *n)
+{
+#if TSCH_QUEUE_NUM_CLASSES > 1
+  uint8_t i, len = 0;
+  for(i = 0; i < TSCH_QUEUE_NUM_CLASSES; i++) {
+    len += FIFO_LEN(&n->tx_queue[i]);
+  }
+  return len;
+#else /* TSCH_QUEUE_NUM_CLASSES > 1 */
+  return FIFO_LEN(&n->tx_queue[0]);
+#endif /* TSCH_QUEUE_NUM_CLASSES > 1 */
+}
+/* Highest-priority non-empty FIFO of a neighbor, NULL if none */
+static struct tsch_queue_fifo *
+queue_first_fifo(const struct tsch_neighbor *n)
+{
+  uint8_t i;
+  for(i = 0; i < TSCH_QUEUE_NUM_CLASSES; i++) {
+    if(FIFO_LEN(&n->tx_queue[i]) != 0) {
+      return (struct tsch_queue_fifo *)&n->tx_queue[i];
+    }
+  }
+  return NULL;
+}
+#if TSCH_QUEUE_NUM_CLASSES > 1
+#ifdef TSCH_QUEUE_CONF_PACKET_CLASS
+uint8_t TSCH_QUEUE_CONF_PACKET_CLASS(void);
+#define PACKET_CLASS() MIN(TSCH_QUEUE_CONF_PACKET_CLASS(), TSCH_QUEUE_NUM_CLASSES - 1)
+#else /* TSCH_QUEUE_CONF_PACKET_CLASS */
+/* Control traffic (RPL, ICMPv6 and keepalives) first, then the rest */
+#define PACKET_CLASS() ((packetbuf_attr(PACKETBUF_ATTR_PROTO) == UIP_PROTO_ICMP6 \
+                         || packetbuf_datalen() == 0) ? 0 : TSCH_QUEUE_NUM_CLASSES - 1)
+#endif /* TSCH_QUEUE_CONF_PACKET_CLASS */
+#else /* TSCH_QUEUE_NUM_CLASSES > 1 */
+#define PACKET_CLASS() 0
+#endif /* TSCH_QUEUE_NUM_CLASSES > 1 */
+#ifdef TSCH_QUEUE_CONF_PACKET_MAX_AGE
+uint16_t TSCH_QUEUE_CONF_PACKET_MAX_AGE(void);
+#define PACKET_MAX_AGE() TSCH_QUEUE_CONF_PACKET_MAX_AGE()
+#else /* TSCH_QUEUE_CONF_PACKET_MAX_AGE */
+#define PACKET_MAX_AGE() TSCH_QUEUE_AQM_MAX_AGE
+#endif /* TSCH_QUEUE_CONF_PACKET_MAX_AGE */
+/* Transmission budget of the packet in packetbuf */
+static uint8_t
+packet_max_transmissions(const linkaddr_t *addr)
+{
+  uint16_t max_tx = 0;
+#if TSCH_QUEUE_WITH_PACKET_MAX_TRANSMISSIONS && !defined(WITHOUT_MAC_TX_ATTR)
+  max_tx = packetbuf_attr(PACKETBUF_ATTR_MAX_MAC_TRANSMISSIONS);
+#endif /* TSCH_QUEUE_WITH_PACKET_MAX_TRANSMISSIONS && !defined(WITHOUT_MAC_TX_ATTR) */
+#if TSCH_QUEUE_RETRIES_ETX_FACTOR
+  if(max_tx == 0) {
+    /* Budget from the link ETX, if the neighbor is a RPL parent */
+    uint16_t link_metric = rpl_get_parent_link_metric((const uip_lladdr_t *)addr);
+    if(link_metric != 0) {
+      max_tx = ((uint32_t)TSCH_QUEUE_RETRIES_ETX_FACTOR * link_metric
+                + RPL_DAG_MC_ETX_DIVISOR - 1) / RPL_DAG_MC_ETX_DIVISOR;
+    }
+  }
+#endif /* TSCH_QUEUE_RETRIES_ETX_FACTOR */
+  if(max_tx == 0 || max_tx > MAC_MAX_FRAME_RETRIES + 1) {
+    max_tx = MAC_MAX_FRAME_RETRIES + 1;
+  }
+  return max_tx;
+}
+#if TSCH_QUEUE_WITH_AQM
+static struct tsch_packet *queue_remove(struct tsch_neighbor *n, struct tsch_queue_fifo *q);
+/* Is time a (4 lower bytes of an ASN) reached? */
+#define TIME_REACHED(time) ((int32_t)(current_asn.ls4b - (time)) >= 0)
+#if TSCH_QUEUE_AQM_CODEL
+/* Integer square root, for the CoDel control law */
+static uint8_t
+aqm_sqrt(uint8_t x)
+{
+  uint8_t r = 1;
+  while((r + 1) * (r + 1) <= x) {
+    r++;
+  }
+  return r;
+}
+#endif /* TSCH_QUEUE_AQM_CODEL */
+/* Is the head packet of a FIFO to be dropped? Can be called without the
+ * lock: the packet may be dequeued meanwhile but is only freed from process context */
+static int
+aqm_head_is_stale(const struct tsch_neighbor *n, const struct tsch_queue_fifo *q)
+{
+  if(FIFO_LEN(q) != 0) {
+    struct tsch_packet *p = q->head;
+    uint32_t age = current_asn.ls4b - p->enqueue_asn.ls4b;
+    if(p->max_age != 0 && age > p->max_age) {
+      return 1;
+    }
+#if TSCH_QUEUE_AQM_CODEL
+    if(n->codel.dropping && age >= TSCH_QUEUE_AQM_CODEL_TARGET
+        && TIME_REACHED(n->codel.drop_next)) {
+      return 1;
+    }
+#endif /* TSCH_QUEUE_AQM_CODEL */
+  }
+  return 0;
+}
+/* Drop the head packet of a FIFO. The lock must be held.
+ * Returns 0 if the packet could not be passed to the pending events process */
+static int
+aqm_drop_head(struct tsch_neighbor *n, struct tsch_queue_fifo *q)
+{
+  struct tsch_packet *p = q->head;
+  if(FIFO_LEN(q) != 0 && tsch_dequeued_packet_add(p)) {
+    queue_remove(n, q);
+    p->ret = MAC_TX_ERR;
+#if TSCH_QUEUE_AQM_CODEL
+    if(n->codel.dropping) {
+      /* Next drop sooner as long as the delay stays above target */
+      if(n->codel.count < 0xff) {
+        n->codel.count++;
+      }
+      n->codel.drop_next = current_asn.ls4b
+        + TSCH_QUEUE_AQM_CODEL_INTERVAL / aqm_sqrt(n->codel.count);
+    }
+#endif /* TSCH_QUEUE_AQM_CODEL */
+#if TSCH_QUEUE_WITH_STATS
+    n->stats.drop_aqm++;
+#endif /* TSCH_QUEUE_WITH_STATS */
+    PRINTF("TSCH-queue: aqm drop, nbr %u class %u\n",
+        LOG_NODEID_FROM_LINKADDR(&n->addr), p->tc);
+    return 1;
+  }
+  return 0;
+}
+/* Run active queue management before queueing a packet of class tc to n */
+static void
+aqm_on_enqueue(struct tsch_neighbor *n, uint8_t tc)
+{
+  uint8_t i;
+  int stale = 0;
+  int head_drop = (TSCH_QUEUE_AQM_HEAD_DROP & (1 << tc))
+    && queue_len(n) >= TSCH_QUEUE_NUM_PER_NEIGHBOR;
+  for(i = 0; i < TSCH_QUEUE_NUM_CLASSES; i++) {
+    stale |= aqm_head_is_stale(n, &n->tx_queue[i]);
+  }
+  /* Only take the lock when there is something to drop */
+  if((stale || head_drop) && tsch_get_lock()) {
+    for(i = 0; i < TSCH_QUEUE_NUM_CLASSES; i++) {
+      while(aqm_head_is_stale(n, &n->tx_queue[i])
+          && aqm_drop_head(n, &n->tx_queue[i]));
+    }
+    if(head_drop && queue_len(n) >= TSCH_QUEUE_NUM_PER_NEIGHBOR) {
+      aqm_drop_head(n, &n->tx_queue[tc]);
+    }
+    tsch_release_lock();
+  }
+}
+#endif /* TSCH_QUEUE_WITH_AQM */
+/* Add packet to neighbor queue. Lock-free, the put is committed atomically */
 int
 tsch_queue_add_packet(const linkaddr_t *addr, mac_callback_t sent, void *ptr)
 {
   struct tsch_neighbor *n = NULL;
-  int16_t put_index = -1;
   struct tsch_packet *p = NULL;
   if(!tsch_is_locked()) {
+    uint8_t tc = PACKET_CLASS();
     n = tsch_queue_add_nbr(addr);
+#if TSCH_QUEUE_WITH_AQM
     if(n != NULL) {
-      put_index = ringbufindex_peek_put(&n->tx_ringbuf);
-      if(put_index != -1) {
-        p = memb_alloc(&packet_memb);
-        if(p != NULL) {
-          /* Enqueue packet */
-          p->qb = queuebuf_new_from_packetbuf();
-          if(p->qb != NULL) {
-            p->sent = sent;
-            p->ptr = ptr;
-            p->ret = MAC_TX_DEFERRED;
-            p->transmissions = 0;
-            /* Add to ringbuf (actual add committed through atomic operation) */
-            n->tx_array[put_index] = p;
-            ringbufindex_put(&n->tx_ringbuf);
-            return 1;
-          } else {
-            memb_free(&packet_memb, p);
-          }
+      aqm_on_enqueue(n, tc);
+    }
+#endif /* TSCH_QUEUE_WITH_AQM */
+    if(n != NULL && queue_len(n) < TSCH_QUEUE_NUM_PER_NEIGHBOR) {
+      p = memb_alloc(&packet_memb);
+      if(p != NULL) {
+        /* Enqueue packet */
+        p->qb = queuebuf_new_from_packetbuf();
+        if(p->qb != NULL) {
+          p->sent = sent;
+          p->ptr = ptr;
+          p->ret = MAC_TX_DEFERRED;
+          p->transmissions = 0;
+#if TSCH_PACKET_WITH_ACK_HINTS
+          p->has_ack_hints = 0;
+#endif /* TSCH_PACKET_WITH_ACK_HINTS */
+#if TSCH_WITH_LINK_ESTIMATOR
+          p->noack_channels = 0;
+          p->ack_channel = 0;
+#endif /* TSCH_WITH_LINK_ESTIMATOR */
+#if TSCH_PACKET_WITH_NACK_LINK
+          p->nack_link = TSCH_PACKET_NO_NACK;
+#endif /* TSCH_PACKET_WITH_NACK_LINK */
+#if TSCH_QUEUE_ANYCAST_NOACK
+          p->anycast = 0;
+#endif /* TSCH_QUEUE_ANYCAST_NOACK */
+#if TSCH_QUEUE_CACHED_PAYLOAD
+          p->payload = queuebuf_dataptr(p->qb);
+          p->payload_len = queuebuf_datalen(p->qb);
+#endif /* TSCH_QUEUE_CACHED_PAYLOAD */
+          p->max_transmissions = packet_max_transmissions(addr);
+          p->tc = tc;
+          p->enqueue_asn = current_asn;
+#if TSCH_QUEUE_WITH_AQM
+          p->max_age = PACKET_MAX_AGE();
+#endif /* TSCH_QUEUE_WITH_AQM */
+#if TSCH_PACKET_WITH_SLOTFRAME
+          p->slotframe = TSCH_CALLBACK_SELECT_PACKET();
+#endif /* TSCH_PACKET_WITH_SLOTFRAME */
+          fifo_put(&n->tx_queue[p->tc], p);
+#if TSCH_QUEUE_WITH_STATS
+          n->stats.enqueued++;
+          n->stats.len_sum += queue_len(n);
+          n->stats.max_len = MAX(n->stats.max_len, queue_len(n));
+#endif /* TSCH_QUEUE_WITH_STATS */
+          UPDATE_LOAD();
+          return 1;
+        } else {
+          memb_free(&packet_memb, p);
         }
       }
     }
+#if TSCH_QUEUE_WITH_STATS
+    if(n != NULL) {
+      n->stats.drop_full++;
+    }
+#endif /* TSCH_QUEUE_WITH_STATS */
   }
-  PRINTF("TSCH-queue:! add packet failed: %u %p %d %p %p", tsch_is_locked(), n, put_index, p, p ? p->qb : NULL);
+  PRINTF("TSCH-queue:! add packet failed: %u %p %u %p %p", tsch_is_locked(), n, n ? queue_len(n) : 0, p, p ? p->qb : NULL);
   return 0;
 }
 /* Returns the number of packets currently in the queue */
@@ -270,23 +595,99 @@ tsch_queue_packet_count(const linkaddr_t *addr)
   if(!tsch_is_locked()) {
     n = tsch_queue_add_nbr(addr);
     if(n != NULL) {
-      return ringbufindex_elements(&n->tx_ringbuf);
+      return queue_len(n);
     }
   }
   return -1;
 }
+/* Number of frames in the broadcast queue, for the multicast engines.
+ * To use, set #define UIP_MCAST6_CALLBACK_FWD_BACKLOG tsch_queue_broadcast_backlog */
+int
+tsch_queue_broadcast_backlog(void)
+{
+  int count = tsch_queue_packet_count(&tsch_broadcast_address);
+  return count > 0 ? count : 0;
+}
+/* Time until a new broadcast frame would be sent, given the frames already
+ * queued and the broadcast Tx links of the schedule. 0 if there is none.
+ * To use, set #define UIP_MCAST6_CALLBACK_FWD_DELAY tsch_queue_broadcast_delay */
+clock_time_t
+tsch_queue_broadcast_delay(void)
+{
+  /* Broadcast opportunities per 1024 timeslots */
+  uint32_t rate = 0;
+  uint32_t slots;
+  struct tsch_slotframe *sf;
+  struct tsch_link *l;
+
+  for(sf = tsch_schedule_slotframe_head(); sf != NULL;
+      sf = tsch_schedule_slotframe_next(sf)) {
+    for(l = list_head(sf->links_list); l != NULL; l = list_item_next(l)) {
+      if((l->link_options & LINK_OPTION_TX)
+         && linkaddr_cmp(tsch_schedule_get_link_addr(l), &tsch_broadcast_address)) {
+        rate += 1024UL / sf->size.val;
+      }
+    }
+  }
+  if(rate == 0) {
+    return 0;
+  }
+  slots = 1024UL * (tsch_queue_broadcast_backlog() + 1) / rate;
+  return (clock_time_t)(slots * TsSlotDuration * CLOCK_SECOND / RTIMER_SECOND);
+}
+/* Remove the head packet of a neighbor FIFO */
+static struct tsch_packet *
+queue_remove(struct tsch_neighbor *n, struct tsch_queue_fifo *q)
+{
+  struct tsch_packet *p = fifo_get(q);
+#if TSCH_QUEUE_AQM_CODEL
+  /* Track how long the queueing delay has been above target. The drops
+   * themselves are done from process context, in aqm_on_enqueue */
+  if(current_asn.ls4b - p->enqueue_asn.ls4b < TSCH_QUEUE_AQM_CODEL_TARGET
+      || queue_len(n) == 0) {
+    n->codel.first_above_time = 0;
+    n->codel.dropping = 0;
+  } else if(n->codel.first_above_time == 0) {
+    n->codel.first_above_time = (current_asn.ls4b + TSCH_QUEUE_AQM_CODEL_INTERVAL) | 1;
+  } else if(!n->codel.dropping && TIME_REACHED(n->codel.first_above_time)) {
+    n->codel.dropping = 1;
+    n->codel.count = 0;
+    n->codel.drop_next = current_asn.ls4b;
+  }
+#endif /* TSCH_QUEUE_AQM_CODEL */
+#if TSCH_QUEUE_WITH_STATS
+  uint32_t sojourn = ASN_DIFF(current_asn, p->enqueue_asn);
+  n->stats.dequeued++;
+  n->stats.sojourn_sum += sojourn;
+  n->stats.sojourn_max = MAX(n->stats.sojourn_max, MIN(sojourn, 0xffff));
+#endif /* TSCH_QUEUE_WITH_STATS */
+  return p;
+}
 /* Remove first packet from a neighbor queue */
 struct tsch_packet *
 tsch_queue_remove_packet_from_queue(struct tsch_neighbor *n)
 {
   if(!tsch_is_locked()) {
     if(n != NULL) {
-      /* Get and remove packet from ringbuf (remove committed through an atomic operation */
-      int16_t get_index = ringbufindex_get(&n->tx_ringbuf);
-      if(get_index != -1) {
-        return n->tx_array[get_index];
-      } else {
-        return NULL;
+      struct tsch_queue_fifo *q = queue_first_fifo(n);
+      if(q != NULL) {
+        return queue_remove(n, q);
+      }
+    }
+  }
+  return NULL;
+}
+/* Remove a packet returned by tsch_queue_get_packet_for_nbr from a neighbor
+ * queue. A higher-class packet may have been queued since, so we remove from
+ * the packet's own class */
+struct tsch_packet *
+tsch_queue_remove_packet(struct tsch_neighbor *n, struct tsch_packet *p)
+{
+  if(!tsch_is_locked()) {
+    if(n != NULL && p != NULL) {
+      struct tsch_queue_fifo *q = &n->tx_queue[p->tc];
+      if(FIFO_LEN(q) != 0 && q->head == p) {
+        return queue_remove(n, q);
       }
     }
   }
@@ -299,7 +700,244 @@ tsch_queue_free_packet(struct tsch_packet *p)
   if(p != NULL) {
     queuebuf_free(p->qb);
     memb_free(&packet_memb, p);
+    UPDATE_LOAD();
+  }
+}
+#if TSCH_QUEUE_WITH_REROUTE || TSCH_QUEUE_ANYCAST_NOACK
+/* Is a frame queued to addr forwarded through it, i.e. may it go through
+ * another next hop? Only unfragmented IPHC frames qualify, whose IPv6
+ * destination is neither link-local, nor derived from the MAC header,
+ * nor addr's own interface identifier */
+static int
+packet_is_reroutable(const uint8_t *buf, uint8_t len, const linkaddr_t *addr)
+{
+  struct tsch_packet_header hdr;
+  const uint8_t *iphc;
+  const uint8_t *dest;
+  uint8_t inline_len;
+
+  if(tsch_packet_parse_header((uint8_t *)buf, len, &hdr) == 0
+     || hdr.security_enabled
+     || len < hdr.hdr_len + 2) {
+    return 0;
+  }
+  iphc = buf + hdr.hdr_len;
+  if((iphc[0] & 0xe0) != SICSLOWPAN_DISPATCH_IPHC
+     || (iphc[1] & SICSLOWPAN_IPHC_M)) {
+    return 0;
+  }
+  /* Skip the inline fields that come before the destination */
+  inline_len = 2 + ((iphc[1] & SICSLOWPAN_IPHC_CID) ? 1 : 0);
+  switch(iphc[0] & (SICSLOWPAN_IPHC_FL_C | SICSLOWPAN_IPHC_TC_C)) {
+  case 0: inline_len += 4; break;
+  case SICSLOWPAN_IPHC_TC_C: inline_len += 3; break;
+  case SICSLOWPAN_IPHC_FL_C: inline_len += 1; break;
+  }
+  if(!(iphc[0] & SICSLOWPAN_IPHC_NH_C)) {
+    inline_len += 1;
+  }
+  if((iphc[0] & 0x03) == SICSLOWPAN_IPHC_TTL_I) {
+    inline_len += 1;
+  }
+  switch(iphc[1] & SICSLOWPAN_IPHC_SAM_11) {
+  case SICSLOWPAN_IPHC_SAM_00:
+    inline_len += (iphc[1] & SICSLOWPAN_IPHC_SAC) ? 0 : 16;
+    break;
+  case SICSLOWPAN_IPHC_SAM_01: inline_len += 8; break;
+  case SICSLOWPAN_IPHC_SAM_10: inline_len += 2; break;
+  }
+  dest = iphc + inline_len;
+
+  if(!(iphc[1] & SICSLOWPAN_IPHC_DAC)) {
+    /* Stateless: only a full inline address can be global */
+    if((iphc[1] & SICSLOWPAN_IPHC_DAM_11) != SICSLOWPAN_IPHC_DAM_00
+       || len < hdr.hdr_len + inline_len + 16
+       || (dest[0] == 0xfe && (dest[1] & 0xc0) == 0x80)) {
+      return 0;
+    }
+    dest += 8;
+  } else {
+    switch(iphc[1] & SICSLOWPAN_IPHC_DAM_11) {
+    case SICSLOWPAN_IPHC_DAM_01:
+      if(len < hdr.hdr_len + inline_len + 8) {
+        return 0;
+      }
+      break;
+    case SICSLOWPAN_IPHC_DAM_10:
+      /* 16-bit short address, not derived from a LINKADDR_SIZE 8 address */
+      return LINKADDR_SIZE != 2;
+    default:
+      /* Derived from the MAC header, or reserved */
+      return 0;
+    }
+  }
+  /* dest points to the interface identifier of the destination */
+#if LINKADDR_SIZE == 8
+  return (dest[0] ^ 0x02) != addr->u8[0] || memcmp(dest + 1, addr->u8 + 1, 7) != 0;
+#else /* LINKADDR_SIZE == 8 */
+  return 1;
+#endif /* LINKADDR_SIZE == 8 */
+}
+/* Send a packet to another next hop: rewrite its destination and reset the
+ * state of the attempts to the former one. Returns 1 on success, 0 otherwise */
+static int
+retarget_packet(struct tsch_packet *p, const linkaddr_t *new_addr)
+{
+  if(!tsch_packet_set_dest_address(tsch_queue_packet_payload(p),
+                                   tsch_queue_packet_len(p), new_addr)) {
+    return 0;
+  }
+  /* Reported to the new next hop by the packet_sent callback */
+  linkaddr_copy(queuebuf_addr(p->qb, PACKETBUF_ADDR_RECEIVER), new_addr);
+#if TSCH_PACKET_WITH_ACK_HINTS
+  p->has_ack_hints = 0;
+#endif /* TSCH_PACKET_WITH_ACK_HINTS */
+#if TSCH_WITH_LINK_ESTIMATOR
+  p->noack_channels = 0;
+  p->ack_channel = 0;
+#endif /* TSCH_WITH_LINK_ESTIMATOR */
+#if TSCH_PACKET_WITH_NACK_LINK
+  p->nack_link = TSCH_PACKET_NO_NACK;
+#endif /* TSCH_PACKET_WITH_NACK_LINK */
+  return 1;
+}
+#endif /* TSCH_QUEUE_WITH_REROUTE || TSCH_QUEUE_ANYCAST_NOACK */
+#if TSCH_QUEUE_WITH_REROUTE
+/* Move the packets queued to old_addr that are forwarded through it to the
+ * queue of new_addr, with their destination rewritten. The others, and
+ * those beyond the quota of new_addr, are left in place */
+int
+tsch_queue_reroute(const linkaddr_t *old_addr, const linkaddr_t *new_addr)
+{
+  struct tsch_neighbor *old_nbr;
+  struct tsch_neighbor *new_nbr;
+  int count = 0;
+  uint8_t i, j, len;
+
+  if(tsch_is_locked() || old_addr == NULL || new_addr == NULL
+     || linkaddr_cmp(old_addr, new_addr)) {
+    return 0;
+  }
+  old_nbr = tsch_queue_get_nbr(old_addr);
+  if(old_nbr == NULL || old_nbr->is_broadcast || tsch_queue_is_empty(old_nbr)) {
+    return 0;
+  }
+  new_nbr = tsch_queue_add_nbr(new_addr);
+  if(new_nbr == NULL || new_nbr->is_broadcast || !tsch_get_lock()) {
+    return 0;
+  }
+
+  /* With the lock, no packet is being sent: go once through every FIFO,
+   * putting each packet either to the new queue or back to the old one */
+  for(i = 0; i < TSCH_QUEUE_NUM_CLASSES; i++) {
+    struct tsch_queue_fifo *q = &old_nbr->tx_queue[i];
+    len = FIFO_LEN(q);
+    for(j = 0; j < len; j++) {
+      struct tsch_packet *p = fifo_get(q);
+      if(queue_len(new_nbr) < TSCH_QUEUE_NUM_PER_NEIGHBOR
+         && packet_is_reroutable(tsch_queue_packet_payload(p),
+                                 tsch_queue_packet_len(p), old_addr)
+         && retarget_packet(p, new_addr)) {
+        /* Full budget towards the new next hop */
+        p->transmissions = 0;
+        fifo_put(&new_nbr->tx_queue[i], p);
+        count++;
+      } else {
+        fifo_put(q, p);
+      }
+    }
+  }
+#if TSCH_QUEUE_WITH_STATS
+  old_nbr->stats.rerouted += count;
+#endif /* TSCH_QUEUE_WITH_STATS */
+  tsch_release_lock();
+
+  if(count > 0) {
+    LOG("TSCH-queue: rerouted %u packets %u -> %u\n", count,
+        LOG_NODEID_FROM_LINKADDR(old_addr), LOG_NODEID_FROM_LINKADDR(new_addr));
+  }
+  return count;
+}
+#endif /* TSCH_QUEUE_WITH_REROUTE */
+#if TSCH_QUEUE_ANYCAST_NOACK
+/* The alternate neighbor of a time source or backup time source, i.e. the
+ * other one, if we have a Tx link to it. NULL otherwise. Also called from
+ * interrupt, to tell whether a failed packet may leave its queue */
+struct tsch_neighbor *
+tsch_queue_get_anycast_nbr(const struct tsch_neighbor *n)
+{
+  struct tsch_neighbor *curr_nbr;
+
+  if(tsch_is_locked() || n == NULL
+     || !(n->is_time_source || n->is_backup_time_source)) {
+    return NULL;
+  }
+  for(curr_nbr = list_head(neighbor_list); curr_nbr != NULL;
+      curr_nbr = list_item_next(curr_nbr)) {
+    if(curr_nbr != n && curr_nbr->tx_links_count > 0
+       && (n->is_time_source ? curr_nbr->is_backup_time_source
+                             : curr_nbr->is_time_source)) {
+      return curr_nbr;
+    }
+  }
+  return NULL;
+}
+/* Queue again, from process context, a packet dequeued for anycast: to the
+ * alternate neighbor of its receiver, with its destination rewritten, or
+ * back to its receiver. Returns 1 if queued, 0 if it must be reported failed */
+int
+tsch_queue_anycast(struct tsch_packet *p)
+{
+  const linkaddr_t *addr;
+  struct tsch_neighbor *n;
+  struct tsch_neighbor *alt;
+
+  if(tsch_is_locked() || p == NULL) {
+    return 0;
   }
+  addr = queuebuf_addr(p->qb, PACKETBUF_ADDR_RECEIVER);
+  n = tsch_queue_get_nbr(addr);
+  if(n == NULL) {
+    return 0;
+  }
+  alt = tsch_queue_get_anycast_nbr(n);
+  if(alt != NULL && queue_len(alt) < TSCH_QUEUE_NUM_PER_NEIGHBOR
+     && packet_is_reroutable(tsch_queue_packet_payload(p),
+                             tsch_queue_packet_len(p), addr)
+     && retarget_packet(p, &alt->addr)) {
+#if TSCH_PACKET_WITH_SLOTFRAME
+    /* The slotframe was picked for the former next hop */
+    p->slotframe = TSCH_PACKET_ANY_SLOTFRAME;
+#endif /* TSCH_PACKET_WITH_SLOTFRAME */
+#if TSCH_QUEUE_WITH_STATS
+    n->stats.rerouted++;
+#endif /* TSCH_QUEUE_WITH_STATS */
+    PRINTF("TSCH-queue: anycast %u -> %u after %u tx\n",
+           LOG_NODEID_FROM_LINKADDR(addr), LOG_NODEID_FROM_LINKADDR(&alt->addr),
+           p->transmissions);
+    n = alt;
+  } else if(queue_len(n) >= TSCH_QUEUE_NUM_PER_NEIGHBOR) {
+    return 0;
+  }
+  /* Behind the packets queued since it left */
+  fifo_put(&n->tx_queue[p->tc], p);
+#if TSCH_QUEUE_WITH_STATS
+  n->stats.enqueued++;
+#endif /* TSCH_QUEUE_WITH_STATS */
+  return 1;
+}
+#endif /* TSCH_QUEUE_ANYCAST_NOACK */
+/* Returns the first neighbor, for iteration in process context */
+struct tsch_neighbor *
+tsch_queue_first_nbr(void)
+{
+  return list_head(neighbor_list);
+}
+/* Returns the neighbor after n (NULL if none) */
+struct tsch_neighbor *
+tsch_queue_next_nbr(const struct tsch_neighbor *n)
+{
+  return n != NULL ? list_item_next((void *)n) : NULL;
 }
 /* Flush all neighbor queues */
 void
@@ -325,8 +963,11 @@ tsch_queue_free_unused_neighbors()
     while(n != NULL) {
       struct tsch_neighbor *next_n = list_item_next(n);
       /* Queue is empty, no tx link to this neighbor: deallocate.
-       * Always keep time source and virtual broadcast neighbors. */
+       * Always keep time sources and virtual broadcast neighbors. */
       if(!n->is_broadcast && !n->is_time_source && !n->tx_links_count
+#if TSCH_WITH_BACKUP_TIME_SOURCE
+          && !n->is_backup_time_source
+#endif /* TSCH_WITH_BACKUP_TIME_SOURCE */
           && tsch_queue_is_empty(n)) {
         tsch_queue_remove_nbr(n);
       }
@@ -338,7 +979,14 @@ tsch_queue_free_unused_neighbors()
 int
 tsch_queue_is_empty(const struct tsch_neighbor *n)
 {
-  return !tsch_is_locked() && n != NULL && ringbufindex_empty(&n->tx_ringbuf);
+  return !tsch_is_locked() && n != NULL && queue_len(n) == 0;
+}
+/* Number of packets queued for a neighbor, 0 if NULL. Never adds a
+ * neighbor nor takes the lock, safe from the link operation */
+int
+tsch_queue_nbr_packet_count(const struct tsch_neighbor *n)
+{
+  return !tsch_is_locked() && n != NULL ? queue_len(n) : 0;
 }
 /* Returns the first packet from a neighbor queue */
 struct tsch_packet *
@@ -346,11 +994,11 @@ tsch_queue_get_packet_for_nbr(const struct tsch_neighbor *n, int is_shared_link)
 {
   if(!tsch_is_locked()) {
     if(n != NULL) {
-      int16_t get_index = ringbufindex_peek_get(&n->tx_ringbuf);
-      if(get_index != -1 &&
+      struct tsch_queue_fifo *q = queue_first_fifo(n);
+      if(q != NULL &&
           !(is_shared_link && !tsch_queue_backoff_expired(n))) {    /* If this is a shared link,
                                                                     make sure the backoff has expired */
-        return n->tx_array[get_index];
+        return q->head;
       }
     }
   }
@@ -371,22 +1019,45 @@ struct tsch_packet *
 tsch_queue_get_unicast_packet_for_any(struct tsch_neighbor **n, int is_shared_link)
 {
   if(!tsch_is_locked()) {
-    /* TODO: round-robin among neighbors */
     struct tsch_neighbor *curr_nbr = list_head(neighbor_list);
     struct tsch_packet *p = NULL;
+#if TSCH_QUEUE_FAIR_UNICAST_FOR_ANY
+    struct tsch_neighbor *best_nbr = NULL;
+    struct tsch_packet *best_p = NULL;
+    uint8_t best_len = 0;
+    uint32_t best_age = 0;
+#endif /* TSCH_QUEUE_FAIR_UNICAST_FOR_ANY */
     while(curr_nbr != NULL) {
       if(!curr_nbr->is_broadcast && curr_nbr->tx_links_count == 0) {
         /* Only look up for non-broadcast neighbors we do not have a tx link to */
         p = tsch_queue_get_packet_for_nbr(curr_nbr, is_shared_link);
         if(p != NULL) {
+#if TSCH_QUEUE_FAIR_UNICAST_FOR_ANY
+          /* Longest queue first, then oldest head packet */
+          uint8_t len = queue_len(curr_nbr);
+          uint32_t age = current_asn.ls4b - p->enqueue_asn.ls4b;
+          if(best_p == NULL || len > best_len || (len == best_len && age > best_age)) {
+            best_nbr = curr_nbr;
+            best_p = p;
+            best_len = len;
+            best_age = age;
+          }
+#else /* TSCH_QUEUE_FAIR_UNICAST_FOR_ANY */
           if(n != NULL) {
             *n = curr_nbr;
           }
           return p;
+#endif /* TSCH_QUEUE_FAIR_UNICAST_FOR_ANY */
         }
       }
       curr_nbr = list_item_next(curr_nbr);
     }
+#if TSCH_QUEUE_FAIR_UNICAST_FOR_ANY
+    if(best_p != NULL && n != NULL) {
+      *n = best_nbr;
+    }
+    return best_p;
+#endif /* TSCH_QUEUE_FAIR_UNICAST_FOR_ANY */
   }
   return NULL;
 }
@@ -394,7 +1065,8 @@ tsch_queue_get_unicast_packet_for_any(struct tsch_neighbor **n, int is_shared_li
 int
 tsch_queue_backoff_expired(const struct tsch_neighbor *n)
 {
-  return n->backoff_window == 0;
+  /* Backoff windows are decremented lazily, by counting shared slots */
+  return (uint32_t)(SHARED_SLOT_COUNT(n) - n->backoff_start) >= n->backoff_window;
 }
 /* Reset neighbor backoff */
 void
@@ -414,33 +1086,72 @@ tsch_queue_backoff_inc(struct tsch_neighbor *n)
   /* Add one to the window as we will decrement it at the end of the current slot
    * through tsch_queue_update_all_backoff_windows */
   n->backoff_window++;
+  n->backoff_start = SHARED_SLOT_COUNT(n);
 }
-/* Decrement backoff window for all queues directed at dest_addr */
+/* Count a Tx, Shared slot to dest_addr, i.e. decrement the backoff window
+ * of all queues directed at it. O(1): tsch_queue_backoff_expired compares
+ * the slot count with the one at which the window was picked */
 void
 tsch_queue_update_all_backoff_windows(const linkaddr_t *dest_addr)
 {
   if(!tsch_is_locked()) {
-    int is_broadcast = linkaddr_cmp(dest_addr, &tsch_broadcast_address);
-    struct tsch_neighbor *n = list_head(neighbor_list);
-    while(n != NULL) {
-      if(n->backoff_window != 0 /* Is the queue in backoff state? */
-          && (  (n->tx_links_count == 0  && is_broadcast)
-             || (n->tx_links_count  > 0 && linkaddr_cmp(dest_addr, &n->addr)))) {
-        n->backoff_window--;
+    if(linkaddr_cmp(dest_addr, &tsch_broadcast_address)) {
+      broadcast_shared_slot_count++;
+    } else {
+      struct tsch_neighbor *n = tsch_queue_get_nbr(dest_addr);
+      if(n != NULL) {
+        n->shared_slot_count++;
       }
-      n = list_item_next(n);
     }
   }
 }
+/* Returns the queue load in percent */
+uint8_t
+tsch_queue_get_load(void)
+{
+  uint8_t load = (QUEUEBUF_NUM - memb_numfree(&packet_memb)) * 100 / QUEUEBUF_NUM;
+  struct tsch_neighbor *n;
+  for(n = list_head(neighbor_list); n != NULL; n = list_item_next(n)) {
+    if(!n->is_broadcast) {
+      load = MAX(load, queue_len(n) * 100 / TSCH_QUEUE_NUM_PER_NEIGHBOR);
+    }
+  }
+  return load;
+}
+#if TSCH_QUEUE_WITH_LOAD_EVENTS
+/* Called from process context whenever a packet is queued or freed.
+ * Posts tsch_queue_event_load on congestion state changes, with hysteresis */
+static void
+update_load(void)
+{
+  uint8_t load = tsch_queue_get_load();
+  if(congested ? load <= TSCH_QUEUE_LOAD_LOW : load >= TSCH_QUEUE_LOAD_HIGH) {
+    congested = !congested;
+    PRINTF("TSCH-queue: load %u%%, congested %u\n", load, congested);
+    process_post(PROCESS_BROADCAST, tsch_queue_event_load, NULL);
+  }
+}
+/* Is TSCH congested? */
+int
+tsch_queue_is_congested(void)
+{
+  return congested;
+}
+#endif /* TSCH_QUEUE_WITH_LOAD_EVENTS */
 /* Initialize TSCH queue module */
 void
 tsch_queue_init(void)
 {
   list_init(neighbor_list);
+  memset(neighbor_hash, 0, sizeof(neighbor_hash));
   tsch_random_init(*((uint32_t *)&linkaddr_node_addr) +
       *((uint32_t *)&linkaddr_node_addr + 1));
   memb_init(&neighbor_memb);
   memb_init(&packet_memb);
+#if TSCH_QUEUE_WITH_LOAD_EVENTS
+  tsch_queue_event_load = process_alloc_event();
+  congested = 0;
+#endif /* TSCH_QUEUE_WITH_LOAD_EVENTS */
   /* Add virtual EB and the broadcast neighbors */
   n_eb = tsch_queue_add_nbr(&tsch_eb_address);
   n_broadcast = tsch_queue_add_nbr(&tsch_broadcast_address);
@@ -565,3 +1276,40 @@ tsch_queue_dump_nbrs()
     printf("TSCH Queue dump-nbrs: LOCKED\n");
   }
 }
+#if TSCH_QUEUE_WITH_STATS
+/* Returns the queue statistics of a neighbor (NULL if failure) */
+const struct tsch_queue_stats *
+tsch_queue_get_stats(const linkaddr_t *addr)
+{
+  struct tsch_neighbor *n = tsch_queue_get_nbr(addr);
+  return n != NULL ? &n->stats : NULL;
+}
+/* Resets the queue statistics of all neighbors */
+void
+tsch_queue_reset_stats(void)
+{
+  if(!tsch_is_locked()) {
+    struct tsch_neighbor *n;
+    for(n = list_head(neighbor_list); n != NULL; n = list_item_next(n)) {
+      memset(&n->stats, 0, sizeof(n->stats));
+    }
+  }
+}
+/* Prints the queue statistics of all neighbors */
+void
+tsch_queue_print_stats(void)
+{
+  if(!tsch_is_locked()) {
+    struct tsch_neighbor *n;
+    for(n = list_head(neighbor_list); n != NULL; n = list_item_next(n)) {
+      struct tsch_queue_stats *s = &n->stats;
+      printf("TSCH-queue: nbr %u len %u max %u avg %lu, in %u out %u drop-full %u drop-retries %u drop-aqm %u, sojourn avg %lu max %u, rerouted %u\n",
+          LOG_NODEID_FROM_LINKADDR(&n->addr), queue_len(n), s->max_len,
+          s->enqueued ? (unsigned long)(s->len_sum / s->enqueued) : 0ul,
+          s->enqueued, s->dequeued, s->drop_full, s->drop_retries, s->drop_aqm,
+          s->dequeued ? (unsigned long)(s->sojourn_sum / s->dequeued) : 0ul, s->sojourn_max,
+          s->rerouted);
+    }
+  }
+}
+#endif /* TSCH_QUEUE_WITH_STATS */
@@ -45,18 +45,21 @@
 #define __TSCH_QUEUE_H__
 
 #include "contiki.h"
-#include "lib/ringbufindex.h"
 #include "net/linkaddr.h"
+#include "net/queuebuf.h"
+#include "net/mac/mac.h"
+#include "net/mac/tsch/tsch-private.h"
 
-/* The maximum number of packets in the system: must be power of two to enable atomic ringbuf operations */
+/* Per-neighbor quota: the maximum number of packets queued for a neighbor.
+ * Packets are taken from a pool of QUEUEBUF_NUM shared by all neighbors */
 #ifdef TSCH_CONF_QUEUE_NUM_PER_NEIGHBOR
 #define TSCH_QUEUE_NUM_PER_NEIGHBOR TSCH_CONF_QUEUE_NUM_PER_NEIGHBOR
 #else
 #define TSCH_QUEUE_NUM_PER_NEIGHBOR 8
 #endif
 
-#if (TSCH_QUEUE_NUM_PER_NEIGHBOR & (TSCH_QUEUE_NUM_PER_NEIGHBOR-1)) != 0
-#error TSCH_QUEUE_NUM_PER_NEIGHBOR must be power of two
+#if TSCH_QUEUE_NUM_PER_NEIGHBOR > 255
+#error TSCH_QUEUE_NUM_PER_NEIGHBOR must be at most 255
 #endif
 
 #ifdef TSCH_CONF_QUEUE_MAX_NEIGHBOR_QUEUES
@@ -65,38 +68,352 @@
 #define TSCH_QUEUE_MAX_NEIGHBOR_QUEUES 8
 #endif
 
+/* Number of buckets of the neighbor lookup hash table: must be power of two */
+#ifdef TSCH_CONF_QUEUE_NBR_HASH_SIZE
+#define TSCH_QUEUE_NBR_HASH_SIZE TSCH_CONF_QUEUE_NBR_HASH_SIZE
+#else
+#define TSCH_QUEUE_NBR_HASH_SIZE 8
+#endif
+
+#if (TSCH_QUEUE_NBR_HASH_SIZE & (TSCH_QUEUE_NBR_HASH_SIZE-1)) != 0
+#error TSCH_QUEUE_NBR_HASH_SIZE must be power of two
+#endif
+
+/* Number of traffic classes per neighbor queue (1 to 4). Class 0 is served
+ * first. By default, RPL/ICMPv6 and keepalives go to class 0 and everything
+ * else to the last class. TSCH_QUEUE_CONF_PACKET_CLASS can name a function
+ * returning the class of the packet in packetbuf instead */
+#ifdef TSCH_QUEUE_CONF_NUM_CLASSES
+#define TSCH_QUEUE_NUM_CLASSES TSCH_QUEUE_CONF_NUM_CLASSES
+#else
+#define TSCH_QUEUE_NUM_CLASSES 1
+#endif
+
+#if TSCH_QUEUE_NUM_CLASSES < 1 || TSCH_QUEUE_NUM_CLASSES > 4
+#error TSCH_QUEUE_NUM_CLASSES must be between 1 and 4
+#endif
+
+/* Active queue management, all disabled by default. Ages are in slots.
+ * Drops happen when a packet is queued, and are reported through the
+ * packet_sent callback (MAC_TX_ERR) like retransmission drops.
+ * - Max age: drop packets older than TSCH_QUEUE_CONF_AQM_MAX_AGE.
+ * TSCH_QUEUE_CONF_PACKET_MAX_AGE can name a function returning the
+ * max age of the packet in packetbuf instead (0: no limit).
+ * - Head drop: TSCH_QUEUE_CONF_AQM_HEAD_DROP is a bitmask of traffic
+ * classes for which a full queue drops its oldest packet of that class
+ * rather than rejecting the new one (for time-sensitive traffic).
+ * - CoDel-like: once the queueing delay of dequeued packets has stayed
+ * above TSCH_QUEUE_AQM_CODEL_TARGET for TSCH_QUEUE_AQM_CODEL_INTERVAL,
+ * drop head packets (at a rate growing with the square root of the
+ * number of drops) until the delay falls below target again */
+#ifdef TSCH_QUEUE_CONF_AQM_MAX_AGE
+#define TSCH_QUEUE_AQM_MAX_AGE TSCH_QUEUE_CONF_AQM_MAX_AGE
+#else
+#define TSCH_QUEUE_AQM_MAX_AGE 0
+#endif
+
+#ifdef TSCH_QUEUE_CONF_AQM_HEAD_DROP
+#define TSCH_QUEUE_AQM_HEAD_DROP TSCH_QUEUE_CONF_AQM_HEAD_DROP
+#else
+#define TSCH_QUEUE_AQM_HEAD_DROP 0
+#endif
+
+#ifdef TSCH_QUEUE_CONF_AQM_CODEL
+#define TSCH_QUEUE_AQM_CODEL TSCH_QUEUE_CONF_AQM_CODEL
+#else
+#define TSCH_QUEUE_AQM_CODEL 0
+#endif
+
+#ifdef TSCH_QUEUE_CONF_AQM_CODEL_TARGET
+#define TSCH_QUEUE_AQM_CODEL_TARGET TSCH_QUEUE_CONF_AQM_CODEL_TARGET
+#else
+#define TSCH_QUEUE_AQM_CODEL_TARGET 100
+#endif
+
+#ifdef TSCH_QUEUE_CONF_AQM_CODEL_INTERVAL
+#define TSCH_QUEUE_AQM_CODEL_INTERVAL TSCH_QUEUE_CONF_AQM_CODEL_INTERVAL
+#else
+#define TSCH_QUEUE_AQM_CODEL_INTERVAL 500
+#endif
+
+#if TSCH_QUEUE_AQM_MAX_AGE || TSCH_QUEUE_AQM_HEAD_DROP || TSCH_QUEUE_AQM_CODEL \
+    || defined(TSCH_QUEUE_CONF_PACKET_MAX_AGE)
+#define TSCH_QUEUE_WITH_AQM 1
+#else
+#define TSCH_QUEUE_WITH_AQM 0
+#endif
+
+/* Retransmission budget of the packets to a RPL parent: this factor times
+ * the link ETX, at least 1 and at most MAC_MAX_FRAME_RETRIES + 1
+ * transmissions (0: always MAC_MAX_FRAME_RETRIES + 1) */
+#ifdef TSCH_QUEUE_CONF_RETRIES_ETX_FACTOR
+#define TSCH_QUEUE_RETRIES_ETX_FACTOR TSCH_QUEUE_CONF_RETRIES_ETX_FACTOR
+#else
+#define TSCH_QUEUE_RETRIES_ETX_FACTOR 0
+#endif
+
+/* Take the budget of a packet from PACKETBUF_ATTR_MAX_MAC_TRANSMISSIONS
+ * when set. Off by default, as sicslowpan sets it on every packet to
+ * SICSLOWPAN_MAX_MAC_TRANSMISSIONS. Ignored with WITHOUT_MAC_TX_ATTR */
+#ifdef TSCH_QUEUE_CONF_WITH_PACKET_MAX_TRANSMISSIONS
+#define TSCH_QUEUE_WITH_PACKET_MAX_TRANSMISSIONS TSCH_QUEUE_CONF_WITH_PACKET_MAX_TRANSMISSIONS
+#else
+#define TSCH_QUEUE_WITH_PACKET_MAX_TRANSMISSIONS 0
+#endif
+
+/* After this many consecutive unacknowledged transmissions to a neighbor,
+ * packets to that neighbor are dropped after their first failed
+ * transmission, until one is acknowledged (0: disabled) */
+#ifdef TSCH_QUEUE_CONF_NOACK_ABORT_STREAK
+#define TSCH_QUEUE_NOACK_ABORT_STREAK TSCH_QUEUE_CONF_NOACK_ABORT_STREAK
+#else
+#define TSCH_QUEUE_NOACK_ABORT_STREAK 0
+#endif
+
+/* On a shared broadcast link with no broadcast to send, pick among the
+ * neighbors without tx link the one with the longest queue, and then the
+ * oldest head packet, rather than the first one found in the neighbor list */
+#ifdef TSCH_QUEUE_CONF_FAIR_UNICAST_FOR_ANY
+#define TSCH_QUEUE_FAIR_UNICAST_FOR_ANY TSCH_QUEUE_CONF_FAIR_UNICAST_FOR_ANY
+#else
+#define TSCH_QUEUE_FAIR_UNICAST_FOR_ANY 1
+#endif
+
+/* On a RPL parent switch, move the packets queued to the former parent
+ * to the new one (see tsch_queue_reroute) rather than leaving them to
+ * a neighbor that may be gone. Does not apply to secured frames */
+#ifdef TSCH_QUEUE_CONF_WITH_REROUTE
+#define TSCH_QUEUE_WITH_REROUTE TSCH_QUEUE_CONF_WITH_REROUTE
+#else
+#define TSCH_QUEUE_WITH_REROUTE 0
+#endif
+
+#if TSCH_QUEUE_WITH_REROUTE && WITH_SWAP
+#error TSCH_QUEUE_WITH_REROUTE requires the frames in RAM (no WITH_SWAP)
+#endif
+
+/* Anycast on repeated NOACK: a unicast forwarded through the time source
+ * (the RPL preferred parent) that failed this many times moves to the
+ * queue of the backup time source (the next-best parent) if we have a Tx
+ * link to it, and back after as many failures there. The packet keeps its
+ * transmission count, max_transmissions still bounds it. Same restrictions
+ * as TSCH_QUEUE_WITH_REROUTE. 0 to disable */
+#ifdef TSCH_QUEUE_CONF_ANYCAST_NOACK
+#define TSCH_QUEUE_ANYCAST_NOACK TSCH_QUEUE_CONF_ANYCAST_NOACK
+#else
+#define TSCH_QUEUE_ANYCAST_NOACK 0
+#endif
+
+#if TSCH_QUEUE_ANYCAST_NOACK && WITH_SWAP
+#error TSCH_QUEUE_ANYCAST_NOACK requires the frames in RAM (no WITH_SWAP)
+#endif
+
+#if TSCH_QUEUE_ANYCAST_NOACK && !TSCH_WITH_BACKUP_TIME_SOURCE
+#error TSCH_QUEUE_ANYCAST_NOACK requires TSCH_CONF_WITH_BACKUP_TIME_SOURCE
+#endif
+
+/* Back-pressure: post tsch_queue_event_load to all processes when the
+ * queue load (see tsch_queue_get_load) reaches TSCH_QUEUE_LOAD_HIGH percent,
+ * and again when it falls back to TSCH_QUEUE_LOAD_LOW percent, so that
+ * applications and forwarding can throttle before packets get dropped */
+#ifdef TSCH_QUEUE_CONF_WITH_LOAD_EVENTS
+#define TSCH_QUEUE_WITH_LOAD_EVENTS TSCH_QUEUE_CONF_WITH_LOAD_EVENTS
+#else
+#define TSCH_QUEUE_WITH_LOAD_EVENTS 0
+#endif
+
+#ifdef TSCH_QUEUE_CONF_LOAD_HIGH
+#define TSCH_QUEUE_LOAD_HIGH TSCH_QUEUE_CONF_LOAD_HIGH
+#else
+#define TSCH_QUEUE_LOAD_HIGH 75
+#endif
+
+#ifdef TSCH_QUEUE_CONF_LOAD_LOW
+#define TSCH_QUEUE_LOAD_LOW TSCH_QUEUE_CONF_LOAD_LOW
+#else
+#define TSCH_QUEUE_LOAD_LOW 25
+#endif
+
+#if TSCH_QUEUE_LOAD_LOW >= TSCH_QUEUE_LOAD_HIGH
+#error TSCH_QUEUE_LOAD_LOW must be lower than TSCH_QUEUE_LOAD_HIGH
+#endif
+
+/* TSCH_CALLBACK_SELECT_PACKET can name a function returning the handle of
+ * the slotframe the packet in packetbuf must be sent in, or
+ * TSCH_PACKET_ANY_SLOTFRAME. A packet restricted to a slotframe is sent only
+ * in links of that slotframe, or in shared links to the broadcast address
+ * (for neighbors without dedicated link) */
+#define TSCH_PACKET_ANY_SLOTFRAME 0xffff
+#ifdef TSCH_CALLBACK_SELECT_PACKET
+#define TSCH_PACKET_WITH_SLOTFRAME 1
+#else
+#define TSCH_PACKET_WITH_SLOTFRAME 0
+#endif
+
+/* TSCH_CALLBACK_NACK_RECEIVED can name a function called from process
+ * context for every packet NACKed by its receiver, with the handle of the
+ * link of the last NACK. The NACKed frame is still received: the NACK only
+ * tells the sender to use another link, see TSCH_CALLBACK_DO_NACK */
+#define TSCH_PACKET_NO_NACK 0xffff
+#ifdef TSCH_CALLBACK_NACK_RECEIVED
+#define TSCH_PACKET_WITH_NACK_LINK 1
+#else
+#define TSCH_PACKET_WITH_NACK_LINK 0
+#endif
+
+/* Cache the frame of queued packets at enqueue time, see
+ * tsch_queue_packet_payload. Not with swap, nor with packetmem whose
+ * compaction moves the frames */
+#define TSCH_QUEUE_CACHED_PAYLOAD (!WITH_SWAP && !QUEUEBUF_WITH_PACKETMEM)
+
+/* Keep per-neighbor queue occupancy, drop and sojourn-time statistics */
+#ifdef TSCH_QUEUE_CONF_WITH_STATS
+#define TSCH_QUEUE_WITH_STATS TSCH_QUEUE_CONF_WITH_STATS
+#else
+#define TSCH_QUEUE_WITH_STATS 0
+#endif
+
 /* TSCH packet information */
 struct tsch_packet {
+  struct tsch_packet *next; /* next packet in the neighbor queue */
   struct queuebuf *qb;  /* pointer to the queuebuf to be sent */
   mac_callback_t sent; /* callback for this packet */
   void *ptr; /* MAC callback parameter */
   uint8_t transmissions; /* #transmissions performed for this packet */
+  uint8_t max_transmissions; /* drop the packet after this many transmissions */
   uint8_t ret; /* status -- MAC return code */
+  uint8_t tc; /* traffic class */
+  struct asn_t enqueue_asn; /* ASN at which the packet was queued */
+#if TSCH_QUEUE_CACHED_PAYLOAD
+  uint8_t *payload; /* the frame, framed at enqueue time and in RAM */
+  uint8_t payload_len; /* frame length */
+#endif /* TSCH_QUEUE_CACHED_PAYLOAD */
+#if TSCH_QUEUE_WITH_AQM
+  uint16_t max_age; /* drop the packet when older than this (slots), 0: never */
+#endif /* TSCH_QUEUE_WITH_AQM */
+#if TSCH_PACKET_WITH_ACK_HINTS
+  struct tsch_ack_hints ack_hints; /* hints from the last ACK */
+  uint8_t has_ack_hints;
+#endif /* TSCH_PACKET_WITH_ACK_HINTS */
+#if TSCH_WITH_LINK_ESTIMATOR
+  uint16_t noack_channels; /* channels (bit channel - 11) of the unacked attempts */
+  uint8_t ack_channel; /* channel of the acked attempt, 0 if none */
+#endif /* TSCH_WITH_LINK_ESTIMATOR */
+#if TSCH_PACKET_WITH_SLOTFRAME
+  uint16_t slotframe; /* handle of the slotframe to send in, or TSCH_PACKET_ANY_SLOTFRAME */
+#endif /* TSCH_PACKET_WITH_SLOTFRAME */
+#if TSCH_PACKET_WITH_NACK_LINK
+  uint16_t nack_link; /* handle of the link of the last NACK, or TSCH_PACKET_NO_NACK */
+#endif /* TSCH_PACKET_WITH_NACK_LINK */
+#if TSCH_QUEUE_ANYCAST_NOACK
+  uint8_t anycast; /* dequeued to go to the alternate neighbor, see tsch_queue_anycast */
+#endif /* TSCH_QUEUE_ANYCAST_NOACK */
+};
+
+/* FIFO of packets from the shared pool, linked through their next field.
+ * Lock-free like ringbuf.c: tail and put_count are written by put only
+ * (and head on put to an empty queue), head and get_count by get only */
+struct tsch_queue_fifo {
+  struct tsch_packet *volatile head;
+  struct tsch_packet *tail;
+  volatile uint8_t put_count;
+  volatile uint8_t get_count;
+};
+
+#if TSCH_QUEUE_WITH_STATS
+/* Queue statistics of a neighbor */
+struct tsch_queue_stats {
+  /* Packets queued */
+  uint16_t enqueued;
+  /* Packets removed from the queue, sent or dropped */
+  uint16_t dequeued;
+  /* Packets rejected because the queue (or the packet pool) was full */
+  uint16_t drop_full;
+  /* Packets dropped after their last allowed retransmission */
+  uint16_t drop_retries;
+  /* Packets dropped by active queue management */
+  uint16_t drop_aqm;
+  /* Packets moved to the queue of another next hop */
+  uint16_t rerouted;
+  /* Highest queue length */
+  uint8_t max_len;
+  /* Sum of the queue lengths seen by queued packets (average: / enqueued) */
+  uint32_t len_sum;
+  /* Time spent in the queue, in slots (average: sojourn_sum / dequeued) */
+  uint32_t sojourn_sum;
+  uint16_t sojourn_max;
+};
+#endif /* TSCH_QUEUE_WITH_STATS */
+
+#if TSCH_QUEUE_AQM_CODEL
+/* CoDel state of a neighbor queue. Times are the 4 lower bytes of the ASN */
+struct tsch_queue_codel {
+  uint32_t first_above_time; /* when the delay will have been above target for an interval (0: below) */
+  uint32_t drop_next; /* time of the next drop in dropping state */
+  uint8_t count; /* drops since entering dropping state */
+  uint8_t dropping; /* are we in dropping state? */
 };
+#endif /* TSCH_QUEUE_AQM_CODEL */
+
+/* Frame and frame length of a queued packet, for the Tx link. Without
+ * queuebuf swap, these are cached at enqueue time so that the link
+ * operation only has to copy the frame to the radio. With swap, the
+ * queuebuf may have to be loaded from CFS within the slot. With packetmem,
+ * the frame moves on compaction, which holds the TSCH lock: the pointer
+ * is only valid until the end of the link operation */
+#if TSCH_QUEUE_CACHED_PAYLOAD
+#define tsch_queue_packet_payload(p) ((p)->payload)
+#define tsch_queue_packet_len(p) ((p)->payload_len)
+#else /* TSCH_QUEUE_CACHED_PAYLOAD */
+#define tsch_queue_packet_payload(p) ((uint8_t *)queuebuf_dataptr((p)->qb))
+#define tsch_queue_packet_len(p) ((uint8_t)queuebuf_datalen((p)->qb))
+#endif /* TSCH_QUEUE_CACHED_PAYLOAD */
 
 /* TSCH neighbor information */
 struct tsch_neighbor {
   /* Neighbors are stored as a list: "next" must be the first field */
   struct tsch_neighbor *next;
+  struct tsch_neighbor *hash_next; /* Next neighbor in the same hash bucket */
   linkaddr_t addr; /* MAC address of the neighbor */
   uint8_t is_broadcast; /* is this neighbor a virtual neighbor used for broadcast (of data packets or EBs) */
   uint8_t is_time_source; /* is this neighbor a time source? */
+#if TSCH_WITH_BACKUP_TIME_SOURCE
+  uint8_t is_backup_time_source; /* is this neighbor the backup time source? */
+#endif /* TSCH_WITH_BACKUP_TIME_SOURCE */
   uint8_t backoff_exponent; /* CSMA backoff exponent */
-  uint8_t backoff_window; /* CSMA backoff window (number of slots to skip) */
+  uint8_t backoff_window; /* CSMA backoff window (number of slots to skip, from backoff_start) */
+  uint32_t backoff_start; /* Shared slot count when the backoff window was picked */
+  uint32_t shared_slot_count; /* Number of Tx, Shared slots to this neighbor */
   uint8_t last_backoff_window; /* Last CSMA backoff window */
   uint8_t tx_links_count; /* How many links do we have to this neighbor? */
   uint8_t dedicated_tx_links_count; /* How many dedicated links do we have to this neighbor? */
-  /* Array for the ringbuf. Contains pointers to packets.
-   * Its size must be a power of two to allow for atomic put */
-  struct tsch_packet *tx_array[TSCH_QUEUE_NUM_PER_NEIGHBOR];
-  /* Circular buffer of pointers to packet. */
-  struct ringbufindex tx_ringbuf;
+  uint8_t noack_streak; /* Consecutive unacknowledged transmissions */
+#if TSCH_WITH_TX_POWER_CONTROL
+  uint8_t tx_power_reduction; /* dB below the configured Tx power */
+#endif /* TSCH_WITH_TX_POWER_CONTROL */
+#if TSCH_PACKET_WITH_ACK_HINTS
+  struct tsch_ack_hints ack_hints; /* Hints from the last ACK received from the neighbor */
+#endif /* TSCH_PACKET_WITH_ACK_HINTS */
+  /* One FIFO per traffic class */
+  struct tsch_queue_fifo tx_queue[TSCH_QUEUE_NUM_CLASSES];
+#if TSCH_QUEUE_WITH_STATS
+  struct tsch_queue_stats stats;
+#endif /* TSCH_QUEUE_WITH_STATS */
+#if TSCH_QUEUE_AQM_CODEL
+  struct tsch_queue_codel codel;
+#endif /* TSCH_QUEUE_AQM_CODEL */
 };
 
 /* Broadcast and EB virtual neighbors */
 extern struct tsch_neighbor *n_broadcast;
 extern struct tsch_neighbor *n_eb;
 
+#if TSCH_QUEUE_WITH_LOAD_EVENTS
+/* Posted to all processes when the queues become congested or
+ * uncongested. Data: NULL, see tsch_queue_is_congested */
+extern process_event_t tsch_queue_event_load;
+#endif /* TSCH_QUEUE_WITH_LOAD_EVENTS */
+
 /* Add a TSCH neighbor */
 struct tsch_neighbor *tsch_queue_add_nbr(const linkaddr_t *addr);
 /* Get a TSCH neighbor */
@@ -105,27 +422,62 @@ struct tsch_neighbor *tsch_queue_get_nbr(const linkaddr_t *addr);
 struct tsch_neighbor *tsch_queue_get_time_source();
 /* Update TSCH time source */
 int tsch_queue_update_time_source(const linkaddr_t *new_addr);
-/* Add packet to neighbor queue. Use same lockfree implementation as ringbuf.c (put is atomic) */
+#if TSCH_WITH_BACKUP_TIME_SOURCE
+/* Get the backup time source, NULL if none */
+struct tsch_neighbor *tsch_queue_get_backup_time_source(void);
+/* Update the backup time source (NULL: none). The time source itself
+ * cannot be its own backup. Returns 1 if it changed */
+int tsch_queue_update_backup_time_source(const linkaddr_t *new_addr);
+#endif /* TSCH_WITH_BACKUP_TIME_SOURCE */
+/* Add packet to neighbor queue, within the neighbor quota. Lock-free (put is atomic) */
 int tsch_queue_add_packet(const linkaddr_t *addr, mac_callback_t sent, void *ptr);
 /* Returns the number of packets currently in the queue */
 int tsch_queue_packet_count(const linkaddr_t *addr);
+/* Number of frames in the broadcast queue, for the multicast engines */
+int tsch_queue_broadcast_backlog(void);
+/* Time until a new broadcast frame would be sent, for the multicast engines */
+clock_time_t tsch_queue_broadcast_delay(void);
 /* Remove first packet from a neighbor queue. The packet is stored in a seprate
  * dequeued packet list, for later processing. Return the packet. */
 struct tsch_packet *tsch_queue_remove_packet_from_queue(struct tsch_neighbor *n);
+/* Remove a packet returned by tsch_queue_get_packet_for_nbr from a neighbor
+ * queue. Return the packet, or NULL if it is not at the head of its class */
+struct tsch_packet *tsch_queue_remove_packet(struct tsch_neighbor *n, struct tsch_packet *p);
 /* Free a packet */
 void tsch_queue_free_packet(struct tsch_packet *p);
+#if TSCH_QUEUE_WITH_REROUTE
+/* Move the packets queued to old_addr that are forwarded through it, not
+ * sent to it, to the queue of new_addr with their destination rewritten,
+ * within the quota of new_addr. Returns the number of packets moved */
+int tsch_queue_reroute(const linkaddr_t *old_addr, const linkaddr_t *new_addr);
+#endif /* TSCH_QUEUE_WITH_REROUTE */
+#if TSCH_QUEUE_ANYCAST_NOACK
+/* The alternate neighbor of a time source or backup time source, i.e. the
+ * other one, if we have a Tx link to it. NULL otherwise */
+struct tsch_neighbor *tsch_queue_get_anycast_nbr(const struct tsch_neighbor *n);
+/* Queue again, from process context, a packet dequeued for anycast: to the
+ * alternate neighbor of its receiver, with its destination rewritten, or
+ * back to its receiver. Returns 1 if queued, 0 if it must be reported failed */
+int tsch_queue_anycast(struct tsch_packet *p);
+#endif /* TSCH_QUEUE_ANYCAST_NOACK */
+/* Returns the first neighbor, for iteration in process context */
+struct tsch_neighbor *tsch_queue_first_nbr(void);
+/* Returns the neighbor after n (NULL if none) */
+struct tsch_neighbor *tsch_queue_next_nbr(const struct tsch_neighbor *n);
 /* Flush all neighbor queues */
 void tsch_queue_flush_all();
 /* Deallocate neighbors with empty queue */
 void tsch_queue_free_unused_neighbors();
 /* Is the neighbor queue empty? */
 int tsch_queue_is_empty(const struct tsch_neighbor *n);
+/* Number of packets queued for a neighbor, 0 if NULL. Safe from the link operation */
+int tsch_queue_nbr_packet_count(const struct tsch_neighbor *n);
 /* Returns the first packet from a neighbor queue */
 struct tsch_packet *tsch_queue_get_packet_for_nbr(const struct tsch_neighbor *n, int is_shared_link);
 /* Returns the head packet from a neighbor queue (from neighbor address) */
 struct tsch_packet *tsch_queue_get_packet_for_dest_addr(const linkaddr_t *addr, int is_shared_link);
-/* Returns the head packet of any neighbor queue with zero backoff counter.
- * Writes pointer to the neighbor in *n */
+/* Returns the head packet of any neighbor queue with zero backoff counter
+ * (see TSCH_QUEUE_FAIR_UNICAST_FOR_ANY). Writes pointer to the neighbor in *n */
 struct tsch_packet *tsch_queue_get_unicast_packet_for_any(struct tsch_neighbor **n, int is_shared_link);
 /* May the neighbor transmit over a share link? */
 int tsch_queue_backoff_expired(const struct tsch_neighbor *n);
@@ -133,8 +485,17 @@ int tsch_queue_backoff_expired(const struct tsch_neighbor *n);
 void tsch_queue_backoff_reset(struct tsch_neighbor *n);
 /* Increment backoff exponent, pick a new window */
 void tsch_queue_backoff_inc(struct tsch_neighbor *n);
-/* Decrement backoff window for all queues directed at dest_addr */
+/* Count a Tx, Shared slot to dest_addr, i.e. decrement the backoff window
+ * of all queues directed at it */
 void tsch_queue_update_all_backoff_windows(const linkaddr_t *dest_addr);
+/* Returns the queue load in percent (process context): the highest of the packet pool usage
+ * and of the fill level of the fullest unicast neighbor queue */
+uint8_t tsch_queue_get_load(void);
+#if TSCH_QUEUE_WITH_LOAD_EVENTS
+/* Has the load reached TSCH_QUEUE_LOAD_HIGH, and not yet fallen back to
+ * TSCH_QUEUE_LOAD_LOW? */
+int tsch_queue_is_congested(void);
+#endif /* TSCH_QUEUE_WITH_LOAD_EVENTS */
 /* Initialize TSCH queue module */
 void tsch_queue_init(void);
 /* Testing the module */
@@ -144,5 +505,13 @@ int tsch_queue_test(int num_nbr);
 int tsch_queue_aggressive_test(int num);
 /* Print nbr table entries (for debugging) */
 void tsch_queue_dump_nbrs();
+#if TSCH_QUEUE_WITH_STATS
+/* Returns the queue statistics of a neighbor (NULL if failure) */
+const struct tsch_queue_stats *tsch_queue_get_stats(const linkaddr_t *addr);
+/* Resets the queue statistics of all neighbors */
+void tsch_queue_reset_stats(void);
+/* Prints the queue statistics of all neighbors */
+void tsch_queue_print_stats(void);
+#endif /* TSCH_QUEUE_WITH_STATS */
 
 #endif /* __TSCH_QUEUE_H__ */
@@ -40,15 +40,20 @@
 #include "net/mac/tsch/tsch.h"
 #include "net/mac/tsch/tsch-private.h"
 #include "net/mac/tsch/tsch-schedule.h"
+#include "net/mac/tsch/tsch-link-estimator.h"
 #include "tsch-rpl.h"
 
 #define DEBUG DEBUG_NONE
 #include "net/ip/uip-debug.h"
 
-/* To use, set #define TSCH_CALLBACK_JOINING_NETWORK tsch_rpl_callback_joining_network */
+/* With RPL_WITH_STORE, verify a restored DAG now that we can reach its parent.
+ * To use, set #define TSCH_CALLBACK_JOINING_NETWORK tsch_rpl_callback_joining_network */
 void
 tsch_rpl_callback_joining_network()
 {
+#if RPL_WITH_STORE
+  rpl_store_verify();
+#endif /* RPL_WITH_STORE */
 }
 
 /* Upon leaving a TSCH network, perform a local repair
@@ -71,15 +76,83 @@ tsch_rpl_callback_new_time_source(struct tsch_neighbor *old, struct tsch_neighbo
   /* We currently do not need to do anything here */
 }
 
+#if TSCH_WITH_BACKUP_TIME_SOURCE
+/* Set the TSCH backup time source to the best RPL parent after the
+ * preferred one, among those of lower rank than ours */
+void
+tsch_rpl_update_backup_time_source(void)
+{
+  rpl_dag_t *dag = rpl_get_any_dag();
+  rpl_parent_t *best = NULL;
+  rpl_parent_t *p;
+
+  if(associated != 1 || dag == NULL || dag->preferred_parent == NULL) {
+    tsch_queue_update_backup_time_source(NULL);
+    return;
+  }
+  for(p = nbr_table_head(rpl_parents); p != NULL; p = nbr_table_next(rpl_parents, p)) {
+    if(p != dag->preferred_parent && p->dag == dag
+        && p->rank != INFINITE_RANK && p->rank < dag->rank) {
+      best = best == NULL ? p : dag->instance->of->best_parent(best, p);
+    }
+  }
+  tsch_queue_update_backup_time_source(best == NULL ? NULL :
+      (const linkaddr_t *)uip_ds6_nbr_lladdr_from_ipaddr(rpl_get_parent_ipaddr(best)));
+}
+#endif /* TSCH_WITH_BACKUP_TIME_SOURCE */
+
 /* Set TSCH EB period based on current RPL DIO period.
  * To use, set #define RPL_CALLBACK_PARENT_SWITCH tsch_rpl_callback_new_dio_interval */
 void
 tsch_rpl_callback_new_dio_interval(uint8_t dio_interval)
 {
+#if TSCH_WITH_BACKUP_TIME_SOURCE
+  /* Parent ranks change over time: refresh the backup every interval */
+  tsch_rpl_update_backup_time_source();
+#endif /* TSCH_WITH_BACKUP_TIME_SOURCE */
+#if TSCH_ADAPTIVE_EB_PERIOD
+  /* The EB period adapts by itself, we only report Trickle resets,
+   * typically caused by joiners (DIS) or inconsistencies */
+  if(dio_interval <= RPL_DIO_INTERVAL_MIN) {
+    tsch_adaptive_eb_joiner_hint();
+  }
+#else /* TSCH_ADAPTIVE_EB_PERIOD */
   tsch_set_eb_period(((1UL << dio_interval) * CLOCK_SECOND) / 1000UL);
+#endif /* TSCH_ADAPTIVE_EB_PERIOD */
+}
+
+#if TSCH_WITH_LINK_ESTIMATOR
+/* Link metric from the TSCH link estimator, for ETX-based objective
+ * functions. Returns link_metric unchanged if the neighbor is unknown.
+ * To use, set #define RPL_CALLBACK_LINK_METRIC tsch_rpl_callback_link_metric */
+uint16_t
+tsch_rpl_callback_link_metric(const linkaddr_t *addr, uint16_t link_metric)
+{
+  uint16_t etx = tsch_link_estimator_get_etx(addr);
+  if(etx == 0) {
+    return link_metric;
+  }
+  return (uint32_t)etx * RPL_DAG_MC_ETX_DIVISOR / TSCH_LINK_ETX_DIVISOR;
 }
+#endif /* TSCH_WITH_LINK_ESTIMATOR */
+
+/* Per-hop timestamp for RPL_HOP_TIMESTAMPS: the 16 LSBs of the current ASN.
+ * To use, set #define RPL_CALLBACK_HOP_TIMESTAMP tsch_rpl_callback_hop_timestamp */
+uint16_t
+tsch_rpl_callback_hop_timestamp(void)
+{
+  return (uint16_t)current_asn.ls4b;
+}
+
+#if TSCH_QUEUE_WITH_REROUTE
+/* The last parent left without a new one, whose packets go to the next parent */
+static linkaddr_t departed_parent;
+static uint8_t has_departed_parent;
+#endif /* TSCH_QUEUE_WITH_REROUTE */
 
 /* Set TSCH time source based on current RPL preferred parent.
+ * With TSCH_QUEUE_WITH_REROUTE, also move the packets queued to the
+ * former parent to the new one.
  * To use, set #define RPL_CALLBACK_PARENT_SWITCH tsch_rpl_callback_parent_switch */
 void
 tsch_rpl_callback_parent_switch(rpl_parent_t *old, rpl_parent_t *new)
@@ -94,5 +167,74 @@ tsch_rpl_callback_parent_switch(rpl_parent_t *old, rpl_parent_t *new)
                 rpl_get_parent_ipaddr(preferred_parent)));
       }
     }
+#if TSCH_WITH_BACKUP_TIME_SOURCE
+    tsch_rpl_update_backup_time_source();
+#endif /* TSCH_WITH_BACKUP_TIME_SOURCE */
+#if TSCH_QUEUE_WITH_REROUTE
+    {
+      /* The parents are still in the neighbor table, only unlocked */
+      const linkaddr_t *old_addr = old != NULL ? nbr_table_get_lladdr(rpl_parents, old) : NULL;
+      const linkaddr_t *new_addr = new != NULL ? nbr_table_get_lladdr(rpl_parents, new) : NULL;
+      if(old_addr == NULL && has_departed_parent) {
+        old_addr = &departed_parent;
+      }
+      if(new_addr == NULL) {
+        if(old_addr != NULL && old_addr != &departed_parent) {
+          linkaddr_copy(&departed_parent, old_addr);
+          has_departed_parent = 1;
+        }
+      } else {
+        if(old_addr != NULL) {
+          tsch_queue_reroute(old_addr, new_addr);
+        }
+        has_departed_parent = 0;
+      }
+    }
+#endif /* TSCH_QUEUE_WITH_REROUTE */
+  }
+}
+
+/* Our RPL state, to be announced in EBs. Returns 0 if not part of a DODAG.
+ * To use, set #define TSCH_CALLBACK_EB_RPL_INFO tsch_rpl_callback_eb_rpl_info */
+int
+tsch_rpl_callback_eb_rpl_info(struct tsch_eb_rpl_info *info)
+{
+  rpl_dag_t *dag = rpl_get_any_dag();
+  if(dag == NULL || dag->rank == INFINITE_RANK) {
+    return 0;
+  }
+  info->instance_id = dag->instance->instance_id;
+  info->version = dag->version;
+  info->rank = dag->rank;
+  return 1;
+}
+
+/* Count an EB of a parent announcing the rank and version we know as a
+ * consistent DIO, for Trickle to suppress ours. Inconsistencies are left
+ * to the DIOs, which carry the full DODAG state.
+ * To use, set #define TSCH_CALLBACK_EB_RPL_INFO_RECEIVED tsch_rpl_callback_eb_rpl_info_received */
+void
+tsch_rpl_callback_eb_rpl_info_received(const linkaddr_t *addr,
+                                       const struct tsch_eb_rpl_info *info)
+{
+  rpl_instance_t *instance = rpl_get_instance(info->instance_id);
+  rpl_dag_t *dag;
+  rpl_parent_t *p;
+
+  if(instance == NULL || instance->current_dag == NULL) {
+    return;
+  }
+  dag = instance->current_dag;
+  if(!dag->joined || info->version != dag->version
+      || info->rank == INFINITE_RANK) {
+    return;
+  }
+  if(dag->rank == ROOT_RANK(instance)) {
+    instance->dio_counter++;
+    return;
+  }
+  p = nbr_table_get_from_lladdr(rpl_parents, (linkaddr_t *)addr);
+  if(p != NULL && p->dag == dag && p->rank == info->rank) {
+    instance->dio_counter++;
   }
 }
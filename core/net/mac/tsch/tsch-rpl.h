@@ -36,6 +36,7 @@
 
 #include "net/rpl/rpl.h"
 #include "net/mac/tsch/tsch-queue.h"
+#include "net/mac/tsch/tsch-packet.h"
 
 /* To use, set #define TSCH_CALLBACK_JOINING_NETWORK tsch_rpl_callback_joining_network */
 void tsch_rpl_callback_joining_network();
@@ -49,6 +50,24 @@ void tsch_rpl_callback_new_time_source(struct tsch_neighbor *old, struct tsch_ne
 /* Set TSCH EB period based on current RPL DIO period.
  * To use, set #define RPL_CALLBACK_PARENT_SWITCH tsch_rpl_callback_new_dio_interval */
 void tsch_rpl_callback_new_dio_interval(uint8_t dio_interval);
+/* Link metric from the TSCH link estimator, for ETX-based objective
+ * functions. Returns link_metric unchanged if the neighbor is unknown.
+ * To use, set #define RPL_CALLBACK_LINK_METRIC tsch_rpl_callback_link_metric */
+uint16_t tsch_rpl_callback_link_metric(const linkaddr_t *addr, uint16_t link_metric);
+/* Per-hop timestamp for RPL_HOP_TIMESTAMPS: the 16 LSBs of the current ASN.
+ * To use, set #define RPL_CALLBACK_HOP_TIMESTAMP tsch_rpl_callback_hop_timestamp */
+uint16_t tsch_rpl_callback_hop_timestamp(void);
+/* Set the TSCH backup time source to the second best RPL parent. Called
+ * from the parent switch and DIO interval callbacks (TSCH_WITH_BACKUP_TIME_SOURCE) */
+void tsch_rpl_update_backup_time_source(void);
 /* Set TSCH time source based on current RPL preferred parent.
  * To use, set #define RPL_CALLBACK_PARENT_SWITCH tsch_rpl_callback_parent_switch */
 void tsch_rpl_callback_parent_switch(rpl_parent_t *old, rpl_parent_t *new);
+/* Our RPL state, to be announced in EBs. Returns 0 if not part of a DODAG.
+ * To use, set #define TSCH_CALLBACK_EB_RPL_INFO tsch_rpl_callback_eb_rpl_info */
+int tsch_rpl_callback_eb_rpl_info(struct tsch_eb_rpl_info *info);
+/* Count an EB of a parent announcing the rank and version we know as a
+ * consistent DIO, for Trickle to suppress ours.
+ * To use, set #define TSCH_CALLBACK_EB_RPL_INFO_RECEIVED tsch_rpl_callback_eb_rpl_info_received */
+void tsch_rpl_callback_eb_rpl_info_received(const linkaddr_t *addr,
+                                            const struct tsch_eb_rpl_info *info);
@@ -52,6 +52,10 @@
 #include "net/mac/frame802154.h"
 #include "sys/process.h"
 #include "sys/rtimer.h"
+#if TSCH_SCHEDULE_WITH_STORE
+#include "sys/ctimer.h"
+#include "cfs/cfs.h"
+#endif /* TSCH_SCHEDULE_WITH_STORE */
 #include <string.h>
 
 #define DEBUG DEBUG_NONE
@@ -66,6 +70,25 @@
 #define TSCH_SCHEDULE_PRIORITIZE_TX 1
 #endif
 
+#if TSCH_SCHEDULE_WITH_ARBITRATION
+#ifdef TSCH_CALLBACK_LINK_PRIORITY
+int TSCH_CALLBACK_LINK_PRIORITY(const struct tsch_slotframe *slotframe, const struct tsch_link *l);
+#define LINK_PRIORITY(sf, l) TSCH_CALLBACK_LINK_PRIORITY(sf, l)
+#else
+#define LINK_PRIORITY(sf, l) tsch_schedule_default_link_priority(sf, l)
+#endif
+#elif TSCH_SCHEDULE_MULTI_LINKS_PER_TIMESLOT
+#define LINK_PRIORITY(sf, l) link_class(l)
+#endif /* TSCH_SCHEDULE_WITH_ARBITRATION */
+
+/* Do we need to choose among links scheduled in the same slot? */
+#define TSCH_SCHEDULE_TIE_BREAK (TSCH_SCHEDULE_WITH_ARBITRATION || TSCH_SCHEDULE_MULTI_LINKS_PER_TIMESLOT)
+#if TSCH_SCHEDULE_TIE_BREAK
+static int link_is_better(const struct tsch_slotframe *sf, const struct tsch_link *l,
+                          const struct tsch_slotframe *best_sf, const struct tsch_link *best,
+                          int *best_priority);
+#endif /* TSCH_SCHEDULE_TIE_BREAK */
+
 /* 6TiSCH Minimal schedule-related defines */
 #ifdef TSCH_SCHEDULE_CONF_DEFAULT_LENGTH
 #define TSCH_SCHEDULE_DEFAULT_LENGTH TSCH_SCHEDULE_CONF_DEFAULT_LENGTH
@@ -73,6 +96,9 @@
 #define TSCH_SCHEDULE_DEFAULT_LENGTH 17 /* 17x15ms => 255ms */
 #endif
 
+/* Number of cells of the minimal schedule we built, 0 if none */
+static uint8_t minimal_cells;
+
 /* Max number of TSCH slotframes */
 #ifdef TSCH_CONF_MAX_SLOTFRAMES
 #define TSCH_MAX_SLOTFRAMES TSCH_CONF_MAX_SLOTFRAMES
@@ -81,12 +107,366 @@
 #endif
 
 /* Pre-allocated space for links */
-MEMB(link_memb, struct tsch_link, TSCH_MAX_LINKS);
+MEMB_FREE_LIST(link_memb, struct tsch_link, TSCH_MAX_LINKS);
 /* Pre-allocated space for slotframes */
 MEMB(slotframe_memb, struct tsch_slotframe, TSCH_MAX_SLOTFRAMES);
 /* List of slotframes (each slotframe holds its own list of links) */
 LIST(slotframe_list);
 
+#if TSCH_SCHEDULE_COMPACT_LINKS
+/* Index of a link without address */
+#define LINK_ADDR_NONE 0xff
+/* Distinct link addresses, with the number of links using them */
+struct link_addr_entry {
+  linkaddr_t addr;
+  uint8_t refcount;
+};
+static struct link_addr_entry link_addrs[TSCH_SCHEDULE_MAX_LINK_ADDRS];
+/* Upper-layer data of links */
+struct link_data_entry {
+  const struct tsch_link *link;
+  void *data;
+};
+static struct link_data_entry link_data[TSCH_SCHEDULE_LINK_DATA_SIZE];
+#endif /* TSCH_SCHEDULE_COMPACT_LINKS */
+
+/* Max number of links added within a batch */
+#ifdef TSCH_SCHEDULE_CONF_MAX_BATCH_SIZE
+#define TSCH_SCHEDULE_MAX_BATCH_SIZE TSCH_SCHEDULE_CONF_MAX_BATCH_SIZE
+#else
+#define TSCH_SCHEDULE_MAX_BATCH_SIZE 16
+#endif
+
+/* Is there a batch of link updates in progress? */
+static uint8_t batch_active;
+/* Did any update of the current batch fail? */
+static uint8_t batch_failed;
+/* Links added within the current batch */
+static struct tsch_link *batch_added[TSCH_SCHEDULE_MAX_BATCH_SIZE];
+static uint8_t batch_added_count;
+/* Links removed within the current batch */
+LIST_WITH_TAIL(batch_removed_list);
+
+#if TSCH_SCHEDULE_WITH_STORE
+/* Snapshot format: a header, then for each slotframe a slotframe record
+ * followed by its link records */
+#define STORE_MAGIC 0x5453
+#define STORE_VERSION 1
+struct store_header {
+  uint16_t magic;
+  uint8_t version;
+  uint8_t slotframe_count;
+};
+struct store_slotframe {
+  uint16_t handle;
+  uint16_t size;
+  uint16_t link_count;
+};
+struct store_link {
+  linkaddr_t addr;
+  uint16_t timeslot;
+  uint16_t channel_offset;
+  uint8_t link_options;
+  uint8_t link_type;
+};
+/* Has the schedule changed since the last snapshot? */
+static uint8_t store_dirty;
+/* Are we initialized? Snapshots of an uninitialized schedule are not saved */
+static uint8_t store_ready;
+static struct ctimer store_timer;
+#define STORE_MARK_DIRTY() (store_dirty = 1)
+#else /* TSCH_SCHEDULE_WITH_STORE */
+#define STORE_MARK_DIRTY()
+#endif /* TSCH_SCHEDULE_WITH_STORE */
+
+/* To be called whenever slotframes or links are added or removed */
+#if TSCH_PACKET_EB_WITH_SLOTFRAME_AND_LINK
+/* Our EBs advertise part of the schedule */
+#define SCHEDULE_CHANGED() do { \
+    STORE_MARK_DIRTY(); \
+    tsch_packet_eb_template_invalidate(); \
+  } while(0)
+#else /* TSCH_PACKET_EB_WITH_SLOTFRAME_AND_LINK */
+#define SCHEDULE_CHANGED() STORE_MARK_DIRTY()
+#endif /* TSCH_PACKET_EB_WITH_SLOTFRAME_AND_LINK */
+
+/* Is the schedule locked for process-context access? Within
+ * a batch, we are the ones holding the lock. */
+#define SCHEDULE_IS_LOCKED() (tsch_is_locked() && !batch_active)
+
+#if TSCH_SCHEDULE_LOCK_FREE
+/* Link changes are published atomically, no need to lock */
+#define SCHEDULE_GET_LOCK() 1
+#define SCHEDULE_RELEASE_LOCK()
+/* Links removed from the schedule, to be freed once the link operation
+ * can no longer be using them */
+LIST_WITH_TAIL(retired_links_list);
+/* Value of tsch_schedule_epoch at the time of the latest link removal */
+static uint16_t retired_epoch;
+volatile uint16_t tsch_schedule_epoch;
+#else /* TSCH_SCHEDULE_LOCK_FREE */
+/* Within a batch, the lock is held from begin to commit */
+#define SCHEDULE_GET_LOCK() (batch_active || tsch_get_lock())
+#define SCHEDULE_RELEASE_LOCK() do { \
+    if(!batch_active) { \
+      tsch_release_lock(); \
+    } \
+  } while(0)
+#endif /* TSCH_SCHEDULE_LOCK_FREE */
+
+#if TSCH_SCHEDULE_WITH_INDEX
+/* The index currently used by the link operation */
+#define ACTIVE_INDEX(sf) (&(sf)->index[(sf)->index_bank])
+/* The index including updates not published yet */
+#if TSCH_SCHEDULE_LOCK_FREE
+#define LATEST_INDEX(sf) ((sf)->index_dirty ? &(sf)->index[!(sf)->index_bank] : ACTIVE_INDEX(sf))
+#else /* TSCH_SCHEDULE_LOCK_FREE */
+#define LATEST_INDEX(sf) ACTIVE_INDEX(sf)
+#endif /* TSCH_SCHEDULE_LOCK_FREE */
+
+/* Returns the position of the first link in the index with a timeslot
+ * greater or equal to timeslot (binary search) */
+static uint16_t
+index_lower_bound(const struct tsch_slotframe_index *idx, uint16_t timeslot)
+{
+  uint16_t low = 0;
+  uint16_t high = idx->len;
+  while(low < high) {
+    uint16_t mid = (low + high) / 2;
+    if(idx->links[mid]->timeslot < timeslot) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+/* Returns the index to be updated. Without TSCH_SCHEDULE_LOCK_FREE, this
+ * is the active index, updated in place under the TSCH lock. Otherwise,
+ * this is a shadow copy of the active index. */
+static struct tsch_slotframe_index *
+index_update_begin(struct tsch_slotframe *sf)
+{
+#if TSCH_SCHEDULE_LOCK_FREE
+  struct tsch_slotframe_index *shadow = &sf->index[!sf->index_bank];
+  if(!sf->index_dirty) {
+    /* First update since the last publication, start from the active index */
+    struct tsch_slotframe_index *active = ACTIVE_INDEX(sf);
+    shadow->len = active->len;
+    memcpy(shadow->links, active->links, active->len * sizeof(struct tsch_link *));
+    sf->index_dirty = 1;
+  }
+  return shadow;
+#else /* TSCH_SCHEDULE_LOCK_FREE */
+  return ACTIVE_INDEX(sf);
+#endif /* TSCH_SCHEDULE_LOCK_FREE */
+}
+/* Publishes an index previously returned by index_update_begin.
+ * Within a batch, publication is deferred to tsch_schedule_commit. */
+static void
+index_update_commit(struct tsch_slotframe *sf)
+{
+#if TSCH_SCHEDULE_LOCK_FREE
+  if(!batch_active && sf->index_dirty) {
+    sf->index_dirty = 0;
+    sf->index_bank = !sf->index_bank;
+  }
+#endif /* TSCH_SCHEDULE_LOCK_FREE */
+}
+/* Inserts a link in a slotframe index. Return 1 if success, 0 if failure */
+static int
+index_insert(struct tsch_slotframe_index *idx, struct tsch_link *l)
+{
+  uint16_t pos;
+  if(idx->len >= TSCH_SCHEDULE_MAX_LINKS_PER_SLOTFRAME) {
+    return 0;
+  }
+  /* Insert after the links of the same timeslot, if any */
+  pos = index_lower_bound(idx, l->timeslot + 1);
+  memmove(&idx->links[pos + 1], &idx->links[pos],
+          (idx->len - pos) * sizeof(struct tsch_link *));
+  idx->links[pos] = l;
+  idx->len++;
+  return 1;
+}
+/* Removes a link from a slotframe index */
+static void
+index_remove(struct tsch_slotframe_index *idx, struct tsch_link *l)
+{
+  uint16_t pos = index_lower_bound(idx, l->timeslot);
+  while(pos < idx->len && idx->links[pos]->timeslot == l->timeslot) {
+    if(idx->links[pos] == l) {
+      idx->len--;
+      memmove(&idx->links[pos], &idx->links[pos + 1],
+              (idx->len - pos) * sizeof(struct tsch_link *));
+      return;
+    }
+    pos++;
+  }
+}
+/* Returns the first link of the slotframe strictly after timeslot
+ * (wrapping around at the end of the slotframe), and writes in
+ * *time_to_timeslot the number of slots until then. The cursor is moved
+ * forward from its previous position, which takes constant time as
+ * long as time moves forward; a binary search is used otherwise. */
+static struct tsch_link *
+index_get_next_link(struct tsch_slotframe *sf, uint16_t timeslot, uint16_t *time_to_timeslot)
+{
+  struct tsch_link *l;
+  const struct tsch_slotframe_index *idx = ACTIVE_INDEX(sf);
+  uint16_t c = sf->index_cursor;
+  if(idx->len == 0) {
+    return NULL;
+  }
+  if(c > idx->len || (c > 0 && idx->links[c - 1]->timeslot > timeslot)) {
+    /* The cursor is past timeslot (e.g. we wrapped around, or the index
+     * has changed) */
+    c = index_lower_bound(idx, timeslot + 1);
+  } else {
+    /* Skip links at or before timeslot */
+    while(c < idx->len && idx->links[c]->timeslot <= timeslot) {
+      c++;
+    }
+  }
+  sf->index_cursor = c;
+  if(c == idx->len) {
+    /* No more link in this slotframe cycle, wrap around */
+    c = 0;
+    l = idx->links[0];
+    *time_to_timeslot = sf->size.val + l->timeslot - timeslot;
+  } else {
+    l = idx->links[c];
+    *time_to_timeslot = l->timeslot - timeslot;
+  }
+#if TSCH_SCHEDULE_MULTI_LINKS_PER_TIMESLOT
+  {
+    /* Choose among all links of that timeslot */
+    int best_priority = -1;
+    uint16_t next_timeslot = l->timeslot;
+    while(++c < idx->len && idx->links[c]->timeslot == next_timeslot) {
+      if(link_is_better(sf, idx->links[c], sf, l, &best_priority)) {
+        l = idx->links[c];
+      }
+    }
+  }
+#endif /* TSCH_SCHEDULE_MULTI_LINKS_PER_TIMESLOT */
+  return l;
+}
+#endif /* TSCH_SCHEDULE_WITH_INDEX */
+
+#if TSCH_SCHEDULE_COMPACT_LINKS
+/* Returns the index of an address in the link address table, adding it
+ * if needed (LINK_ADDR_NONE if the table is full) */
+static uint8_t
+link_addr_acquire(const linkaddr_t *addr)
+{
+  uint8_t i;
+  uint8_t free_index = LINK_ADDR_NONE;
+  for(i = 0; i < TSCH_SCHEDULE_MAX_LINK_ADDRS; i++) {
+    if(link_addrs[i].refcount == 0) {
+      if(free_index == LINK_ADDR_NONE) {
+        free_index = i;
+      }
+    } else if(linkaddr_cmp(&link_addrs[i].addr, addr)) {
+      link_addrs[i].refcount++;
+      return i;
+    }
+  }
+  if(free_index != LINK_ADDR_NONE) {
+    /* No link is using this entry, it is safe to overwrite it */
+    linkaddr_copy(&link_addrs[free_index].addr, addr);
+    link_addrs[free_index].refcount = 1;
+  }
+  return free_index;
+}
+/* Returns the MAC address of neighbor of a link */
+const linkaddr_t *
+tsch_schedule_get_link_addr(const struct tsch_link *l)
+{
+  return &link_addrs[l->addr_index].addr;
+}
+/* Returns the upper-layer data of a link */
+void *
+tsch_schedule_get_link_data(const struct tsch_link *l)
+{
+  int i;
+  for(i = 0; i < TSCH_SCHEDULE_LINK_DATA_SIZE; i++) {
+    if(link_data[i].link == l) {
+      return link_data[i].data;
+    }
+  }
+  return NULL;
+}
+/* Sets the upper-layer data of a link. Return 1 if success, 0 if failure */
+int
+tsch_schedule_set_link_data(struct tsch_link *l, void *data)
+{
+  int i;
+  struct link_data_entry *free_entry = NULL;
+  for(i = 0; i < TSCH_SCHEDULE_LINK_DATA_SIZE; i++) {
+    if(link_data[i].link == l) {
+      if(data == NULL) {
+        link_data[i].link = NULL;
+      }
+      link_data[i].data = data;
+      return 1;
+    }
+    if(link_data[i].link == NULL && free_entry == NULL) {
+      free_entry = &link_data[i];
+    }
+  }
+  if(data == NULL) {
+    return 1;
+  }
+  if(free_entry != NULL) {
+    free_entry->link = l;
+    free_entry->data = data;
+    return 1;
+  }
+  return 0;
+}
+#else /* TSCH_SCHEDULE_COMPACT_LINKS */
+/* Returns the upper-layer data of a link */
+void *
+tsch_schedule_get_link_data(const struct tsch_link *l)
+{
+  return l->data;
+}
+/* Sets the upper-layer data of a link. Return 1 if success, 0 if failure */
+int
+tsch_schedule_set_link_data(struct tsch_link *l, void *data)
+{
+  l->data = data;
+  return 1;
+}
+#endif /* TSCH_SCHEDULE_COMPACT_LINKS */
+/* Frees a link, once it is no longer in the schedule */
+static void
+link_memb_free(struct tsch_link *l)
+{
+#if TSCH_SCHEDULE_COMPACT_LINKS
+  tsch_schedule_set_link_data(l, NULL);
+  link_addrs[l->addr_index].refcount--;
+#endif /* TSCH_SCHEDULE_COMPACT_LINKS */
+  memb_free(&link_memb, l);
+}
+
+#if TSCH_SCHEDULE_LOCK_FREE
+/* Frees the retired links, provided the link operation has passed a slot
+ * boundary since they were removed (or if force is set, which requires
+ * the TSCH lock). */
+static void
+reclaim_retired_links(int force)
+{
+  if(force || tsch_schedule_epoch != retired_epoch) {
+    struct tsch_link *l;
+    while((l = tlist_pop(retired_links_list)) != NULL) {
+      link_memb_free(l);
+    }
+  }
+}
+#endif /* TSCH_SCHEDULE_LOCK_FREE */
+
 /* Adds and returns a slotframe (NULL if failure) */
 struct tsch_slotframe *
 tsch_schedule_add_slotframe(uint16_t handle, uint16_t size)
@@ -101,9 +481,22 @@ tsch_schedule_add_slotframe(uint16_t handle, uint16_t size)
         /* Initialize the slotframe */
         sf->handle = handle;
         ASN_DIVISOR_INIT(sf->size, size);
-        LIST_STRUCT_INIT(sf, links_list);
+        ASN_CURSOR_RESET(sf->cursor);
+        LIST_STRUCT_WITH_TAIL_INIT(sf, links_list);
+#if TSCH_SCHEDULE_WITH_ARBITRATION
+        sf->priority = 0;
+#endif /* TSCH_SCHEDULE_WITH_ARBITRATION */
+#if TSCH_SCHEDULE_WITH_INDEX
+        sf->index_bank = 0;
+#if TSCH_SCHEDULE_LOCK_FREE
+        sf->index_dirty = 0;
+#endif /* TSCH_SCHEDULE_LOCK_FREE */
+        sf->index_cursor = 0;
+        ACTIVE_INDEX(sf)->len = 0;
+#endif /* TSCH_SCHEDULE_WITH_INDEX */
         /* Add the slotframe to the global list */
         list_add(slotframe_list, sf);
+        SCHEDULE_CHANGED();
       }
       tsch_release_lock();
       return sf;
@@ -124,9 +517,18 @@ tsch_schedule_remove_slotframe(struct tsch_slotframe *slotframe)
 
     /* Now that the slotframe has no links, remove it. */
     if(tsch_get_lock()) {
+#if TSCH_SCHEDULE_LOCK_FREE
+      /* No link operation is running: we can abort the next one
+       * if it uses one of our links, and free the links right away */
+      if(current_link != NULL && current_link->slotframe_handle == slotframe->handle) {
+        current_link = NULL;
+      }
+      reclaim_retired_links(1);
+#endif /* TSCH_SCHEDULE_LOCK_FREE */
       memb_free(&slotframe_memb, slotframe);
       list_remove(slotframe_list, slotframe);
       tsch_release_lock();
+      SCHEDULE_CHANGED();
       return 1;
     }
   }
@@ -136,7 +538,7 @@ tsch_schedule_remove_slotframe(struct tsch_slotframe *slotframe)
 struct tsch_slotframe *
 tsch_schedule_get_slotframe_from_handle(uint16_t handle)
 {
-  if(!tsch_is_locked()) {
+  if(!SCHEDULE_IS_LOCKED()) {
     struct tsch_slotframe *sf = list_head(slotframe_list);
     while(sf != NULL) {
       if(sf->handle == handle) {
@@ -147,11 +549,23 @@ tsch_schedule_get_slotframe_from_handle(uint16_t handle)
   }
   return NULL;
 }
+/* Returns the first slotframe (NULL if none or locked) */
+struct tsch_slotframe *
+tsch_schedule_slotframe_head(void)
+{
+  return SCHEDULE_IS_LOCKED() ? NULL : list_head(slotframe_list);
+}
+/* Returns the slotframe after sf (NULL if none) */
+struct tsch_slotframe *
+tsch_schedule_slotframe_next(struct tsch_slotframe *sf)
+{
+  return sf != NULL ? list_item_next(sf) : NULL;
+}
 /* Looks for a link from a handle */
 struct tsch_link *
 tsch_schedule_get_link_from_handle(uint16_t handle)
 {
-  if(!tsch_is_locked()) {
+  if(!SCHEDULE_IS_LOCKED()) {
     struct tsch_slotframe *sf = list_head(slotframe_list);
     while(sf != NULL) {
       struct tsch_link *l = list_head(sf->links_list);
@@ -167,6 +581,52 @@ tsch_schedule_get_link_from_handle(uint16_t handle)
   }
   return NULL;
 }
+/* Updates the tx link counters of a neighbor, when adding (delta 1)
+ * or removing (delta -1) a link to it */
+static void
+update_nbr_link_count(const linkaddr_t *addr, uint8_t link_options, int delta)
+{
+  if(link_options & LINK_OPTION_TX) {
+    struct tsch_neighbor *n = tsch_queue_add_nbr(addr);
+    /* We have a tx link to this neighbor, update counters */
+    if(n != NULL) {
+      n->tx_links_count += delta;
+      if(!(link_options & LINK_OPTION_SHARED)) {
+        n->dedicated_tx_links_count += delta;
+      }
+    }
+  }
+}
+/* Takes a link out of its slotframe (the link is not freed) */
+static void
+unlink_link(struct tsch_slotframe *slotframe, struct tsch_link *l)
+{
+#if !TSCH_SCHEDULE_LOCK_FREE
+  /* The link to be removed is the scheduled as next, set it to NULL
+   * to abort the next link operation */
+  if(l == current_link) {
+    current_link = NULL;
+  }
+#endif /* !TSCH_SCHEDULE_LOCK_FREE */
+#if TSCH_SCHEDULE_WITH_INDEX
+  index_remove(index_update_begin(slotframe), l);
+  index_update_commit(slotframe);
+#endif /* TSCH_SCHEDULE_WITH_INDEX */
+  tlist_remove(slotframe->links_list, l);
+}
+/* Frees a link previously taken out of its slotframe */
+static void
+free_link(struct tsch_link *l)
+{
+#if TSCH_SCHEDULE_LOCK_FREE
+  /* The link operation may be using the link until the next slot boundary.
+   * Read the epoch only after publishing the new index. */
+  tlist_add_unchecked(retired_links_list, l);
+  retired_epoch = tsch_schedule_epoch;
+#else /* TSCH_SCHEDULE_LOCK_FREE */
+  link_memb_free(l);
+#endif /* TSCH_SCHEDULE_LOCK_FREE */
+}
 /* Adds a link to a slotframe, return a pointer to it (NULL if failure) */
 struct tsch_link *
 tsch_schedule_add_link(struct tsch_slotframe *slotframe,
@@ -175,11 +635,23 @@ tsch_schedule_add_link(struct tsch_slotframe *slotframe,
 {
   struct tsch_link *l = NULL;
   if(slotframe != NULL) {
+#if TSCH_SCHEDULE_MULTI_LINKS_PER_TIMESLOT
+    /* Start with removing the link currently installed at this timeslot and
+     * channel offset (needed to keep neighbor state in sync with link options etc.) */
+    tsch_schedule_remove_link(slotframe,
+        tsch_schedule_get_link_from_timeslot_and_offset(slotframe, timeslot, channel_offset));
+#else /* TSCH_SCHEDULE_MULTI_LINKS_PER_TIMESLOT */
     /* We currently support only one link per timeslot in a given slotframe. */
     /* Start with removing the link currently installed at this timeslot (needed
      * to keep neighbor state in sync with link options etc.) */
     tsch_schedule_remove_link_from_timeslot(slotframe, timeslot);
-    if(!tsch_get_lock()) {
+#endif /* TSCH_SCHEDULE_MULTI_LINKS_PER_TIMESLOT */
+#if TSCH_SCHEDULE_LOCK_FREE
+    reclaim_retired_links(0);
+#endif /* TSCH_SCHEDULE_LOCK_FREE */
+    if(batch_active && batch_added_count >= TSCH_SCHEDULE_MAX_BATCH_SIZE) {
+      PRINTF("TSCH-schedule:! add_link batch full\n");
+    } else if(!SCHEDULE_GET_LOCK()) {
       PRINTF("TSCH-schedule:! add_link memb_alloc couldn't take lock\n");
     } else {
       l = memb_alloc(&link_memb);
@@ -187,9 +659,6 @@ tsch_schedule_add_link(struct tsch_slotframe *slotframe,
         PRINTF("TSCH-schedule:! add_link memb_alloc failed\n");
       } else {
         static int current_link_handle = 0;
-        struct tsch_neighbor *n;
-        /* Add the link to the slotframe */
-        list_add(slotframe->links_list, l);
         /* Initialize link */
         l->handle = current_link_handle++;
         l->link_options = link_options;
@@ -197,30 +666,63 @@ tsch_schedule_add_link(struct tsch_slotframe *slotframe,
         l->slotframe_handle = slotframe->handle;
         l->timeslot = timeslot;
         l->channel_offset = channel_offset;
+#if !TSCH_SCHEDULE_COMPACT_LINKS
         l->data = NULL;
+#endif /* !TSCH_SCHEDULE_COMPACT_LINKS */
+#if TSCH_SCHEDULE_WITH_LINK_STATS
+        memset(&l->stats, 0, sizeof(l->stats));
+#endif /* TSCH_SCHEDULE_WITH_LINK_STATS */
+#if TSCH_ADAPTIVE_RX_SKIP
+        memset(&l->rx_skip, 0, sizeof(l->rx_skip));
+#endif /* TSCH_ADAPTIVE_RX_SKIP */
         if(address == NULL) {
           address = &linkaddr_null;
         }
+#if TSCH_SCHEDULE_COMPACT_LINKS
+        l->addr_index = channel_offset <= 0xff ? link_addr_acquire(address) : LINK_ADDR_NONE;
+        if(l->addr_index == LINK_ADDR_NONE) {
+          PRINTF("TSCH-schedule:! add_link address table full\n");
+          memb_free(&link_memb, l);
+          l = NULL;
+        }
+#else /* TSCH_SCHEDULE_COMPACT_LINKS */
         linkaddr_copy(&l->addr, address);
+#endif /* TSCH_SCHEDULE_COMPACT_LINKS */
+
+#if TSCH_SCHEDULE_WITH_INDEX
+        if(l != NULL && !index_insert(index_update_begin(slotframe), l)) {
+          PRINTF("TSCH-schedule:! add_link index full\n");
+          link_memb_free(l);
+          l = NULL;
+        } else if(l != NULL) {
+          index_update_commit(slotframe);
+        }
+#endif /* TSCH_SCHEDULE_WITH_INDEX */
+      }
+      if(l != NULL) {
+        /* Add the link to the slotframe, it is a new one */
+        tlist_add_unchecked(slotframe->links_list, l);
+        SCHEDULE_CHANGED();
 
         PRINTF("TSCH-schedule: add_link %u %u %u %u %u\n",
             slotframe->handle, link_options, timeslot, channel_offset, LOG_NODEID_FROM_LINKADDR(address));
+      }
 
-        /* Release the lock before we update the neighbor (will take the lock) */
-        tsch_release_lock();
-
-        if(l->link_options & LINK_OPTION_TX) {
-          n = tsch_queue_add_nbr(&l->addr);
-          /* We have a tx link to this neighbor, update counters */
-          if(n != NULL) {
-            n->tx_links_count++;
-            if(!(l->link_options & LINK_OPTION_SHARED)) {
-              n->dedicated_tx_links_count++;
-            }
-          }
+      /* Release the lock before we update the neighbor (will take the lock) */
+      SCHEDULE_RELEASE_LOCK();
+
+      if(l != NULL) {
+        if(batch_active) {
+          /* Neighbor counters are updated at commit time */
+          batch_added[batch_added_count++] = l;
+        } else {
+          update_nbr_link_count(tsch_schedule_get_link_addr(l), l->link_options, 1);
         }
       }
     }
+    if(l == NULL && batch_active) {
+      batch_failed = 1;
+    }
   }
   return l;
 }
@@ -229,40 +731,47 @@ int
 tsch_schedule_remove_link(struct tsch_slotframe *slotframe, struct tsch_link *l)
 {
   if(slotframe != NULL && l != NULL && l->slotframe_handle == slotframe->handle) {
-    if(tsch_get_lock()) {
+    if(SCHEDULE_GET_LOCK()) {
       uint8_t link_options;
       linkaddr_t addr;
 
       /* Save link option and addr in local variables as we need them
        * after freeing the link */
       link_options = l->link_options;
-      linkaddr_copy(&addr, &l->addr);
-
-      /* The link to be removed is the scheduled as next, set it to NULL
-       * to abort the next link operation */
-      if(l == current_link) {
-        current_link = NULL;
-      }
+      linkaddr_copy(&addr, tsch_schedule_get_link_addr(l));
 
       PRINTF("TSCH-schedule: remove_link %u %u %u %u %u\n",
                   slotframe->handle, l->link_options, l->timeslot, l->channel_offset,
-                  LOG_NODEID_FROM_LINKADDR(&l->addr));
+                  LOG_NODEID_FROM_LINKADDR(tsch_schedule_get_link_addr(l)));
 
-      list_remove(slotframe->links_list, l);
-      memb_free(&link_memb, l);
+      unlink_link(slotframe, l);
+      SCHEDULE_CHANGED();
 
-      /* Release the lock before we update the neighbor (will take the lock) */
-      tsch_release_lock();
-
-      /* This was a tx link to this neighbor, update counters */
-      if(link_options & LINK_OPTION_TX) {
-        struct tsch_neighbor *n = tsch_queue_add_nbr(&addr);
-        if(n != NULL) {
-          n->tx_links_count--;
-          if(!(link_options & LINK_OPTION_SHARED)) {
-            n->dedicated_tx_links_count--;
+      if(batch_active) {
+        int i;
+        for(i = 0; i < batch_added_count; i++) {
+          if(batch_added[i] == l) {
+            break;
           }
         }
+        if(i < batch_added_count) {
+          /* The link was added within this batch and never used, free it now */
+          batch_added[i] = batch_added[--batch_added_count];
+          link_memb_free(l);
+        } else {
+          /* Keep the link until commit, to be able to roll back */
+          tlist_add_unchecked(batch_removed_list, l);
+        }
+      } else {
+        free_link(l);
+      }
+
+      /* Release the lock before we update the neighbor (will take the lock) */
+      SCHEDULE_RELEASE_LOCK();
+
+      if(!batch_active) {
+        /* This was a tx link to this neighbor, update counters */
+        update_nbr_link_count(&addr, link_options, -1);
       }
 
       return 1;
@@ -272,19 +781,129 @@ tsch_schedule_remove_link(struct tsch_slotframe *slotframe, struct tsch_link *l)
   }
   return 0;
 }
+/* Starts a batch of link updates. Return 1 if success, 0 if failure */
+int
+tsch_schedule_begin(void)
+{
+  if(batch_active) {
+    return 0;
+  }
+#if !TSCH_SCHEDULE_LOCK_FREE
+  /* Hold the lock for the whole batch */
+  if(!tsch_get_lock()) {
+    return 0;
+  }
+#endif /* !TSCH_SCHEDULE_LOCK_FREE */
+  batch_active = 1;
+  batch_failed = 0;
+  batch_added_count = 0;
+  tlist_init(batch_removed_list);
+  return 1;
+}
+/* Rolls back all link updates of the current batch */
+void
+tsch_schedule_abort(void)
+{
+  if(batch_active) {
+    struct tsch_link *l;
+    struct tsch_slotframe *sf;
+    /* Undo additions */
+    while(batch_added_count > 0) {
+      l = batch_added[--batch_added_count];
+      sf = tsch_schedule_get_slotframe_from_handle(l->slotframe_handle);
+      unlink_link(sf, l);
+      link_memb_free(l);
+    }
+    /* Undo removals. Re-inserting cannot fail as the links were there before. */
+    while((l = tlist_pop(batch_removed_list)) != NULL) {
+      sf = tsch_schedule_get_slotframe_from_handle(l->slotframe_handle);
+#if TSCH_SCHEDULE_WITH_INDEX
+      index_insert(index_update_begin(sf), l);
+#endif /* TSCH_SCHEDULE_WITH_INDEX */
+      tlist_add_unchecked(sf->links_list, l);
+    }
+#if TSCH_SCHEDULE_LOCK_FREE
+    /* Drop all shadow indices, the active ones were never changed */
+    for(sf = list_head(slotframe_list); sf != NULL; sf = list_item_next(sf)) {
+      sf->index_dirty = 0;
+    }
+#else /* TSCH_SCHEDULE_LOCK_FREE */
+    tsch_release_lock();
+#endif /* TSCH_SCHEDULE_LOCK_FREE */
+    batch_active = 0;
+  }
+}
+/* Applies all link updates of the current batch, or none of them if any
+ * update has failed. Return 1 if success, 0 if failure */
+int
+tsch_schedule_commit(void)
+{
+  struct tsch_link *l;
+  int i;
+  if(!batch_active) {
+    return 0;
+  }
+  if(batch_failed) {
+    tsch_schedule_abort();
+    return 0;
+  }
+  batch_active = 0;
+#if TSCH_SCHEDULE_LOCK_FREE
+  {
+    /* Publish all updated indices */
+    struct tsch_slotframe *sf;
+    for(sf = list_head(slotframe_list); sf != NULL; sf = list_item_next(sf)) {
+      index_update_commit(sf);
+    }
+  }
+#else /* TSCH_SCHEDULE_LOCK_FREE */
+  tsch_release_lock();
+#endif /* TSCH_SCHEDULE_LOCK_FREE */
+  /* Now that the lock is released, update neighbor counters */
+  while((l = tlist_pop(batch_removed_list)) != NULL) {
+    update_nbr_link_count(tsch_schedule_get_link_addr(l), l->link_options, -1);
+    free_link(l);
+  }
+  for(i = 0; i < batch_added_count; i++) {
+    l = batch_added[i];
+    update_nbr_link_count(tsch_schedule_get_link_addr(l), l->link_options, 1);
+  }
+  batch_added_count = 0;
+  return 1;
+}
 /* Removes a link from slotframe and timeslot. Return a 1 if success, 0 if failure */
 int
 tsch_schedule_remove_link_from_timeslot(struct tsch_slotframe *slotframe, uint16_t timeslot)
 {
+#if TSCH_SCHEDULE_MULTI_LINKS_PER_TIMESLOT
+  int ret = 0;
+  if(slotframe != NULL) {
+    struct tsch_link *l;
+    while((l = tsch_schedule_get_link_from_timeslot(slotframe, timeslot)) != NULL
+        && tsch_schedule_remove_link(slotframe, l)) {
+      ret = 1;
+    }
+  }
+  return ret;
+#else /* TSCH_SCHEDULE_MULTI_LINKS_PER_TIMESLOT */
   return slotframe != NULL &&
       tsch_schedule_remove_link(slotframe, tsch_schedule_get_link_from_timeslot(slotframe, timeslot));
+#endif /* TSCH_SCHEDULE_MULTI_LINKS_PER_TIMESLOT */
 }
 /* Looks within a slotframe for a link with a given timeslot */
 struct tsch_link *
 tsch_schedule_get_link_from_timeslot(struct tsch_slotframe *slotframe, uint16_t timeslot)
 {
-  if(!tsch_is_locked()) {
+  if(!SCHEDULE_IS_LOCKED()) {
     if(slotframe != NULL) {
+#if TSCH_SCHEDULE_WITH_INDEX
+      const struct tsch_slotframe_index *idx = LATEST_INDEX(slotframe);
+      uint16_t pos = index_lower_bound(idx, timeslot);
+      if(pos < idx->len && idx->links[pos]->timeslot == timeslot) {
+        return idx->links[pos];
+      }
+      return NULL;
+#else /* TSCH_SCHEDULE_WITH_INDEX */
       struct tsch_link *l = list_head(slotframe->links_list);
       /* Loop over all items. Assume there is max one link per timeslot */
       while(l != NULL) {
@@ -294,28 +913,141 @@ tsch_schedule_get_link_from_timeslot(struct tsch_slotframe *slotframe, uint16_t
         l = list_item_next(l);
       }
       return l;
+#endif /* TSCH_SCHEDULE_WITH_INDEX */
     }
   }
   return NULL;
 }
+/* Looks within a slotframe for a link with a given timeslot and channel offset */
+struct tsch_link *
+tsch_schedule_get_link_from_timeslot_and_offset(struct tsch_slotframe *slotframe,
+                                                uint16_t timeslot, uint16_t channel_offset)
+{
+  if(!SCHEDULE_IS_LOCKED()) {
+    if(slotframe != NULL) {
+#if TSCH_SCHEDULE_WITH_INDEX
+      const struct tsch_slotframe_index *idx = LATEST_INDEX(slotframe);
+      uint16_t pos = index_lower_bound(idx, timeslot);
+      while(pos < idx->len && idx->links[pos]->timeslot == timeslot) {
+        if(idx->links[pos]->channel_offset == channel_offset) {
+          return idx->links[pos];
+        }
+        pos++;
+      }
+#else /* TSCH_SCHEDULE_WITH_INDEX */
+      struct tsch_link *l = list_head(slotframe->links_list);
+      while(l != NULL) {
+        if(l->timeslot == timeslot && l->channel_offset == channel_offset) {
+          return l;
+        }
+        l = list_item_next(l);
+      }
+#endif /* TSCH_SCHEDULE_WITH_INDEX */
+    }
+  }
+  return NULL;
+}
+#if TSCH_SCHEDULE_TIE_BREAK
+/* Returns 2 for a Tx link with a packet ready, 1 for a link
+ * with Rx option, 0 otherwise */
+static int
+link_class(const struct tsch_link *l)
+{
+  if(l->link_options & LINK_OPTION_TX) {
+    /* Same packet selection as the link operation */
+    int is_shared_link = l->link_options & LINK_OPTION_SHARED;
+    struct tsch_neighbor *n = NULL;
+    if(l->link_type == LINK_TYPE_ADVERTISING || l->link_type == LINK_TYPE_ADVERTISING_ONLY) {
+      n = n_eb;
+    }
+    if(n != NULL && tsch_queue_get_packet_for_nbr(n, 0) != NULL) {
+      return 2;
+    } else if(l->link_type != LINK_TYPE_ADVERTISING_ONLY) {
+      n = tsch_queue_get_nbr(tsch_schedule_get_link_addr(l));
+      if(tsch_queue_get_packet_for_nbr(n, is_shared_link) != NULL
+          || (n == n_broadcast && tsch_queue_get_unicast_packet_for_any(&n, is_shared_link) != NULL)) {
+        return 2;
+      }
+    }
+  }
+  return (l->link_options & LINK_OPTION_RX) ? 1 : 0;
+}
+/* Returns 1 if link l of slotframe sf must be selected over the current
+ * best link. best_priority caches the priority of the current best, -1
+ * if not computed yet. */
+static int
+link_is_better(const struct tsch_slotframe *sf, const struct tsch_link *l,
+               const struct tsch_slotframe *best_sf, const struct tsch_link *best,
+               int *best_priority)
+{
+  int priority = LINK_PRIORITY(sf, l);
+  if(*best_priority < 0) {
+    *best_priority = LINK_PRIORITY(best_sf, best);
+  }
+  if(priority > *best_priority
+      || (priority == *best_priority && sf->handle < best_sf->handle)) {
+    *best_priority = priority;
+    return 1;
+  }
+  return 0;
+}
+#endif /* TSCH_SCHEDULE_TIE_BREAK */
+#if TSCH_SCHEDULE_WITH_ARBITRATION
+/* Sets the priority of a slotframe's links in case of overlap.
+ * Return 1 if success, 0 if failure */
+int
+tsch_schedule_set_slotframe_priority(struct tsch_slotframe *slotframe, uint8_t priority)
+{
+  if(slotframe != NULL) {
+    slotframe->priority = priority;
+    return 1;
+  }
+  return 0;
+}
+/* Returns the priority of a link of a given slotframe, the higher the better */
+int
+tsch_schedule_default_link_priority(const struct tsch_slotframe *slotframe, const struct tsch_link *l)
+{
+  return (link_class(l) << 8) | slotframe->priority;
+}
+#endif /* TSCH_SCHEDULE_WITH_ARBITRATION */
 /* Returns the link to be used at a given ASN */
 struct tsch_link *
 tsch_schedule_get_link_from_asn(struct asn_t *asn)
 {
   struct tsch_link *curr_best = NULL;
-  struct tsch_slotframe *sf = list_head(slotframe_list);
+#if TSCH_SCHEDULE_WITH_ARBITRATION
+  struct tsch_slotframe *curr_best_sf = NULL;
+  int curr_best_priority = -1;
+#endif /* TSCH_SCHEDULE_WITH_ARBITRATION */
+  struct tsch_slotframe *sf = tsch_is_locked() ? NULL : list_head(slotframe_list);
   /* For each slotframe, looks for a link matching the asn.
    * Tx links have priority, then lower handle have priority. */
   while(sf != NULL) {
     /* Get timeslot from ASN, given the slotframe length */
     uint16_t timeslot = ASN_MOD(*asn, sf->size);
+#if TSCH_SCHEDULE_WITH_INDEX
+    /* Look only at published links, as we may be called from interrupt */
+    const struct tsch_slotframe_index *idx = ACTIVE_INDEX(sf);
+    uint16_t pos = index_lower_bound(idx, timeslot);
+    struct tsch_link *l = (pos < idx->len && idx->links[pos]->timeslot == timeslot) ? idx->links[pos] : NULL;
+#else /* TSCH_SCHEDULE_WITH_INDEX */
     struct tsch_link *l = tsch_schedule_get_link_from_timeslot(sf, timeslot);
+#endif /* TSCH_SCHEDULE_WITH_INDEX */
     /* We have a match */
-    if(l != NULL) {
+    while(l != NULL) {
       if(curr_best == NULL) {
         curr_best = l;
+#if TSCH_SCHEDULE_WITH_ARBITRATION
+        curr_best_sf = sf;
+#endif /* TSCH_SCHEDULE_WITH_ARBITRATION */
       } else {
-#if TSCH_SCHEDULE_PRIORITIZE_TX
+#if TSCH_SCHEDULE_WITH_ARBITRATION
+        if(link_is_better(sf, l, curr_best_sf, curr_best, &curr_best_priority)) {
+          curr_best = l;
+          curr_best_sf = sf;
+        }
+#elif TSCH_SCHEDULE_PRIORITIZE_TX
         /* We already have a current best,
          * we must check Tx flag and handle to find the highest priority link */
         if((curr_best->link_options & LINK_OPTION_TX) == (l->link_options & LINK_OPTION_TX)) {
@@ -334,8 +1066,20 @@ tsch_schedule_get_link_from_asn(struct asn_t *asn)
           /* We have a lower handle */
           curr_best = l;
         }
-#endif /* TSCH_SCHEDULE_PRIORITIZE_TX */
+#endif /* TSCH_SCHEDULE_WITH_ARBITRATION */
       }
+#if TSCH_SCHEDULE_MULTI_LINKS_PER_TIMESLOT
+      /* Look for other links in the same timeslot */
+#if TSCH_SCHEDULE_WITH_INDEX
+      l = (++pos < idx->len && idx->links[pos]->timeslot == timeslot) ? idx->links[pos] : NULL;
+#else /* TSCH_SCHEDULE_WITH_INDEX */
+      do {
+        l = list_item_next(l);
+      } while(l != NULL && l->timeslot != timeslot);
+#endif /* TSCH_SCHEDULE_WITH_INDEX */
+#else /* TSCH_SCHEDULE_MULTI_LINKS_PER_TIMESLOT */
+      l = NULL;
+#endif /* TSCH_SCHEDULE_MULTI_LINKS_PER_TIMESLOT */
     }
     sf = list_item_next(sf);
   }
@@ -347,12 +1091,36 @@ tsch_schedule_get_next_active_link(struct asn_t *asn, uint16_t *time_offset)
 {
   uint16_t curr_earliest = 0;
   struct tsch_link *curr_earliest_link = NULL;
+#if TSCH_SCHEDULE_TIE_BREAK
+  struct tsch_slotframe *curr_earliest_sf = NULL;
+  int curr_earliest_priority = -1;
+#endif /* TSCH_SCHEDULE_TIE_BREAK */
   if(!tsch_is_locked()) {
     struct tsch_slotframe *sf = list_head(slotframe_list);
     /* For each slotframe, look for the earliest occurring link */
     while(sf != NULL) {
-      /* Get timeslot from ASN, given the slotframe length */
-      uint16_t timeslot = ASN_MOD(*asn, sf->size);
+      /* Get timeslot from ASN, given the slotframe length. The cursors
+       * follow current_asn, which only the link operation moves forward */
+      uint16_t timeslot = asn == &current_asn ?
+        tsch_asn_cursor_mod(&sf->cursor, asn, &sf->size) : ASN_MOD(*asn, sf->size);
+#if TSCH_SCHEDULE_WITH_INDEX
+      uint16_t time_to_timeslot;
+      struct tsch_link *l = index_get_next_link(sf, timeslot, &time_to_timeslot);
+      if(l != NULL && (curr_earliest == 0 || time_to_timeslot < curr_earliest)) {
+        curr_earliest = time_to_timeslot;
+        curr_earliest_link = l;
+#if TSCH_SCHEDULE_TIE_BREAK
+        curr_earliest_sf = sf;
+        curr_earliest_priority = -1;
+      } else if(TSCH_SCHEDULE_WITH_ARBITRATION
+          && l != NULL && time_to_timeslot == curr_earliest
+          && link_is_better(sf, l, curr_earliest_sf, curr_earliest_link, &curr_earliest_priority)) {
+        /* Overlap with a link of another slotframe */
+        curr_earliest_link = l;
+        curr_earliest_sf = sf;
+#endif /* TSCH_SCHEDULE_TIE_BREAK */
+      }
+#else /* TSCH_SCHEDULE_WITH_INDEX */
       struct tsch_link *l = list_head(sf->links_list);
       while(l != NULL) {
         uint16_t time_to_timeslot =
@@ -362,9 +1130,20 @@ tsch_schedule_get_next_active_link(struct asn_t *asn, uint16_t *time_offset)
         if(curr_earliest == 0 || time_to_timeslot < curr_earliest) {
           curr_earliest = time_to_timeslot;
           curr_earliest_link = l;
+#if TSCH_SCHEDULE_TIE_BREAK
+          curr_earliest_sf = sf;
+          curr_earliest_priority = -1;
+        } else if(time_to_timeslot == curr_earliest
+            && (TSCH_SCHEDULE_WITH_ARBITRATION || sf == curr_earliest_sf)
+            && link_is_better(sf, l, curr_earliest_sf, curr_earliest_link, &curr_earliest_priority)) {
+          /* Overlap with another link */
+          curr_earliest_link = l;
+          curr_earliest_sf = sf;
+#endif /* TSCH_SCHEDULE_TIE_BREAK */
         }
         l = list_item_next(l);
       }
+#endif /* TSCH_SCHEDULE_WITH_INDEX */
       sf = list_item_next(sf);
     }
     if(time_offset != NULL) {
@@ -376,7 +1155,7 @@ tsch_schedule_get_next_active_link(struct asn_t *asn, uint16_t *time_offset)
 void
 tsch_schedule_print()
 {
-  if(!tsch_is_locked()) {
+  if(!SCHEDULE_IS_LOCKED()) {
     struct tsch_slotframe *sf = list_head(slotframe_list);
 
     printf("Schedule: slotframe list\n");
@@ -389,7 +1168,12 @@ tsch_schedule_print()
 
       while(l != NULL) {
         printf("[Link] Options %02x, type %u, timeslot %u, channel offset %u, address %u\n",
-               l->link_options, l->link_type, l->timeslot, l->channel_offset, l->addr.u8[7]);
+               l->link_options, l->link_type, l->timeslot, l->channel_offset, tsch_schedule_get_link_addr(l)->u8[7]);
+#if TSCH_SCHEDULE_WITH_LINK_STATS
+        printf("[Stats] tx %u ok %u noack %u nack %u cca-busy %u, rx ok %u idle %u\n",
+               l->stats.tx_attempts, l->stats.tx_ok, l->stats.tx_noack, l->stats.tx_nack,
+               l->stats.cca_busy, l->stats.rx_ok, l->stats.rx_idle);
+#endif /* TSCH_SCHEDULE_WITH_LINK_STATS */
         l = list_item_next(l);
       }
 
@@ -399,6 +1183,51 @@ tsch_schedule_print()
     printf("Schedule: end of slotframe list\n");
   }
 }
+#if TSCH_SCHEDULE_WITH_LINK_STATS
+/* Returns the usage counters of a link (NULL if failure) */
+const struct tsch_link_stats *
+tsch_schedule_get_link_stats(const struct tsch_link *l)
+{
+  return l != NULL ? &l->stats : NULL;
+}
+/* Sums up the usage counters of all links of a slotframe into stats.
+ * Return the number of links, or -1 if failure */
+int
+tsch_schedule_get_slotframe_stats(struct tsch_slotframe *slotframe, struct tsch_link_stats *stats)
+{
+  int count = 0;
+  struct tsch_link *l;
+  if(slotframe == NULL || stats == NULL || SCHEDULE_IS_LOCKED()) {
+    return -1;
+  }
+  memset(stats, 0, sizeof(*stats));
+  for(l = list_head(slotframe->links_list); l != NULL; l = list_item_next(l)) {
+    stats->tx_attempts += l->stats.tx_attempts;
+    stats->tx_ok += l->stats.tx_ok;
+    stats->tx_noack += l->stats.tx_noack;
+    stats->tx_nack += l->stats.tx_nack;
+    stats->cca_busy += l->stats.cca_busy;
+    stats->rx_idle += l->stats.rx_idle;
+    stats->rx_ok += l->stats.rx_ok;
+    count++;
+  }
+  return count;
+}
+/* Resets the usage counters of all links */
+void
+tsch_schedule_reset_link_stats(void)
+{
+  if(!SCHEDULE_IS_LOCKED()) {
+    struct tsch_slotframe *sf;
+    for(sf = list_head(slotframe_list); sf != NULL; sf = list_item_next(sf)) {
+      struct tsch_link *l;
+      for(l = list_head(sf->links_list); l != NULL; l = list_item_next(l)) {
+        memset(&l->stats, 0, sizeof(l->stats));
+      }
+    }
+  }
+}
+#endif /* TSCH_SCHEDULE_WITH_LINK_STATS */
 void
 tsch_schedule_test()
 {
@@ -444,6 +1273,129 @@ tsch_schedule_test()
     }
   }
 }
+#if TSCH_SCHEDULE_WITH_STORE
+/* Saves a snapshot of the schedule to CFS. Return 1 if success, 0 if failure */
+int
+tsch_schedule_save(void)
+{
+  int fd;
+  int ok = 1;
+  struct store_header header;
+  struct tsch_slotframe *sf;
+
+  if(!store_ready || SCHEDULE_IS_LOCKED() || batch_active) {
+    return 0;
+  }
+
+  cfs_remove(TSCH_SCHEDULE_STORE_FILE);
+  fd = cfs_open(TSCH_SCHEDULE_STORE_FILE, CFS_WRITE);
+  if(fd < 0) {
+    return 0;
+  }
+
+  /* Write an invalid header first, so that an interrupted
+   * save does not leave a valid-looking snapshot */
+  header.magic = 0;
+  header.version = STORE_VERSION;
+  header.slotframe_count = list_length(slotframe_list);
+  ok = cfs_write(fd, &header, sizeof(header)) == sizeof(header);
+
+  for(sf = list_head(slotframe_list); ok && sf != NULL; sf = list_item_next(sf)) {
+    struct store_slotframe sf_record;
+    struct tsch_link *l;
+    sf_record.handle = sf->handle;
+    sf_record.size = sf->size.val;
+    sf_record.link_count = list_length(sf->links_list);
+    ok = cfs_write(fd, &sf_record, sizeof(sf_record)) == sizeof(sf_record);
+    for(l = list_head(sf->links_list); ok && l != NULL; l = list_item_next(l)) {
+      struct store_link link_record;
+      linkaddr_copy(&link_record.addr, tsch_schedule_get_link_addr(l));
+      link_record.timeslot = l->timeslot;
+      link_record.channel_offset = l->channel_offset;
+      link_record.link_options = l->link_options;
+      link_record.link_type = l->link_type;
+      ok = cfs_write(fd, &link_record, sizeof(link_record)) == sizeof(link_record);
+    }
+  }
+
+  if(ok) {
+    /* Everything is written, validate the snapshot */
+    header.magic = STORE_MAGIC;
+    ok = cfs_seek(fd, 0, CFS_SEEK_SET) == 0
+      && cfs_write(fd, &header, sizeof(header)) == sizeof(header);
+  }
+  cfs_close(fd);
+
+  if(ok) {
+    store_dirty = 0;
+  }
+  PRINTF("TSCH-schedule: save %s\n", ok ? "done" : "failed");
+  return ok;
+}
+/* Restores the schedule from the CFS snapshot, reusing existing slotframes
+ * of the same handle and size. Return the number of links restored */
+int
+tsch_schedule_restore(void)
+{
+  int fd;
+  int count = 0;
+  uint8_t i;
+  struct store_header header;
+
+  fd = cfs_open(TSCH_SCHEDULE_STORE_FILE, CFS_READ);
+  if(fd < 0) {
+    return 0;
+  }
+
+  if(cfs_read(fd, &header, sizeof(header)) != sizeof(header)
+      || header.magic != STORE_MAGIC || header.version != STORE_VERSION) {
+    cfs_close(fd);
+    return 0;
+  }
+
+  for(i = 0; i < header.slotframe_count; i++) {
+    struct store_slotframe sf_record;
+    struct tsch_slotframe *sf;
+    uint16_t j;
+    if(cfs_read(fd, &sf_record, sizeof(sf_record)) != sizeof(sf_record)) {
+      break;
+    }
+    sf = tsch_schedule_get_slotframe_from_handle(sf_record.handle);
+    if(sf == NULL) {
+      sf = tsch_schedule_add_slotframe(sf_record.handle, sf_record.size);
+    } else if(sf->size.val != sf_record.size) {
+      /* The slotframe has been redefined, skip its links */
+      sf = NULL;
+    }
+    for(j = 0; j < sf_record.link_count; j++) {
+      struct store_link link_record;
+      if(cfs_read(fd, &link_record, sizeof(link_record)) != sizeof(link_record)) {
+        break;
+      }
+      if(sf != NULL && tsch_schedule_add_link(sf,
+                                              link_record.link_options, link_record.link_type, &link_record.addr,
+                                              link_record.timeslot, link_record.channel_offset) != NULL) {
+        count++;
+      }
+    }
+  }
+  cfs_close(fd);
+
+  /* The schedule matches the snapshot */
+  store_dirty = 0;
+  PRINTF("TSCH-schedule: restored %u links\n", count);
+  return count;
+}
+/* Saves the snapshot periodically, if the schedule has changed */
+static void
+store_timer_callback(void *ptr)
+{
+  if(store_dirty) {
+    tsch_schedule_save();
+  }
+  ctimer_reset(&store_timer);
+}
+#endif /* TSCH_SCHEDULE_WITH_STORE */
 /* Initialization. Return 1 is success, 0 if failure. */
 int
 tsch_schedule_init()
@@ -451,30 +1403,89 @@ tsch_schedule_init()
   if(tsch_get_lock()) {
     memb_init(&link_memb);
     memb_init(&slotframe_memb);
+#if TSCH_SCHEDULE_COMPACT_LINKS
+    memset(link_addrs, 0, sizeof(link_addrs));
+    memset(link_data, 0, sizeof(link_data));
+#endif /* TSCH_SCHEDULE_COMPACT_LINKS */
     list_init(slotframe_list);
+#if TSCH_SCHEDULE_LOCK_FREE
+    tlist_init(retired_links_list);
+#endif /* TSCH_SCHEDULE_LOCK_FREE */
     tsch_release_lock();
+#if TSCH_SCHEDULE_WITH_STORE
+    /* Warm reboot: start from the latest snapshot */
+    tsch_schedule_restore();
+    store_ready = 1;
+    ctimer_set(&store_timer, TSCH_SCHEDULE_STORE_PERIOD, store_timer_callback, NULL);
+#endif /* TSCH_SCHEDULE_WITH_STORE */
     return 1;
   } else {
     return 0;
   }
 }
 
-/* Create a 6TiSCH minimal schedule */
+/* Create or rebuild the minimal schedule with num_cells Tx|Rx|Shared cells
+ * using the broadcast address, spread evenly over the slotframe, each at a
+ * channel offset of its own */
+int
+tsch_schedule_create_minimal_cells(uint8_t num_cells)
+{
+  struct tsch_slotframe *sf_min;
+  struct tsch_link *l;
+  int batch;
+  int ok = 1;
+  int i;
+
+  /* We pick a slotframe length of TSCH_SCHEDULE_DEFAULT_LENGTH, or keep
+   * the one of the slotframe we rebuild */
+  sf_min = tsch_schedule_get_slotframe_from_handle(0);
+  if(sf_min == NULL) {
+    sf_min = tsch_schedule_add_slotframe(0, TSCH_SCHEDULE_DEFAULT_LENGTH);
+  }
+  if(sf_min == NULL || num_cells == 0 || num_cells > sf_min->size.val) {
+    return 0;
+  }
+
+  /* Replace all links at once */
+  batch = tsch_schedule_begin();
+  l = list_head(sf_min->links_list);
+  while(l != NULL) {
+    /* Fetch the next link first, as l may be taken out of the list */
+    struct tsch_link *next = list_item_next(l);
+    tsch_schedule_remove_link(sf_min, l);
+    l = next;
+  }
+  /* The first cell is at timeslot 0, channel offset 0. We set its link
+   * type to advertising, which is not compliant with 6TiSCH minimal schedule
+   * but is required according to 802.15.4e if also used for EB transmission */
+  for(i = 0; i < num_cells && ok; i++) {
+    ok = tsch_schedule_add_link(sf_min,
+        LINK_OPTION_RX | LINK_OPTION_TX | LINK_OPTION_SHARED,
+        i == 0 ? LINK_TYPE_ADVERTISING : LINK_TYPE_NORMAL, &tsch_broadcast_address,
+        (uint32_t)i * sf_min->size.val / num_cells, i) != NULL;
+  }
+  if(batch) {
+    ok = tsch_schedule_commit();
+  }
+  if(ok) {
+    minimal_cells = num_cells;
+    /* Our EBs announce the number of cells */
+    tsch_packet_eb_template_invalidate();
+  }
+  return ok;
+}
+
+uint8_t
+tsch_schedule_minimal_cells(void)
+{
+  return minimal_cells;
+}
+
+/* Create a 6TiSCH minimal schedule, of TSCH_SCHEDULE_MINIMAL_CELLS cells */
 void
 tsch_schedule_create_minimal()
 {
-  static struct tsch_slotframe *sf_min;
-  /* Build 6TiSCH minimal schedule.
-   * We pick a slotframe length of TSCH_SCHEDULE_DEFAULT_LENGTH */
-  sf_min = tsch_schedule_add_slotframe(0, TSCH_SCHEDULE_DEFAULT_LENGTH);
-  /* Add a single Tx|Rx|Shared slot using broadcast address (i.e. usable for unicast and broadcast).
-   * We set the link type to advertising, which is not compliant with 6TiSCH minimal schedule
-   * but is required according to 802.15.4e if also used for EB transmission.
-   * Timeslot: 0, channel offset: 0. */
-  tsch_schedule_add_link(sf_min,
-      LINK_OPTION_RX | LINK_OPTION_TX | LINK_OPTION_SHARED,
-      LINK_TYPE_ADVERTISING, &tsch_broadcast_address,
-      0, 0);
+  tsch_schedule_create_minimal_cells(TSCH_SCHEDULE_MINIMAL_CELLS);
 
   /* Example of a dedicated Tx unicast link. Timeslot: 1, channel offset: 0. */
   /* static linkaddr_t dest_addr = { { 0x00, 0x12, 0x74, 01, 00, 01, 01, 01 } }; */
@@ -57,13 +57,213 @@
  * LINK_TYPE_ADVERTISING_ONLY is an extra one: for EB-only links. */
 enum link_type { LINK_TYPE_NORMAL, LINK_TYPE_ADVERTISING, LINK_TYPE_ADVERTISING_ONLY };
 
+/* Keep, for every slotframe, an array of links sorted by timeslot.
+ * Enables O(log n) timeslot lookup from the rtimer interrupt, at the cost
+ * of one pointer per indexed link. Also enables a per-slotframe cursor
+ * to the next active link, making tsch_schedule_get_next_active_link
+ * amortized O(1) per slotframe. */
+#ifdef TSCH_SCHEDULE_CONF_WITH_INDEX
+#define TSCH_SCHEDULE_WITH_INDEX TSCH_SCHEDULE_CONF_WITH_INDEX
+#else
+#define TSCH_SCHEDULE_WITH_INDEX 0
+#endif
+
+/* Max number of links in the index of a given slotframe */
+#ifdef TSCH_SCHEDULE_CONF_MAX_LINKS_PER_SLOTFRAME
+#define TSCH_SCHEDULE_MAX_LINKS_PER_SLOTFRAME TSCH_SCHEDULE_CONF_MAX_LINKS_PER_SLOTFRAME
+#else
+#define TSCH_SCHEDULE_MAX_LINKS_PER_SLOTFRAME TSCH_MAX_LINKS
+#endif
+
+/* Lock-free link addition and removal. Every slotframe index is double-buffered:
+ * updates are applied to a shadow copy that is then published by flipping
+ * the active bank. The link operation only reads the active bank, at slot
+ * boundaries, so it is never skipped and the caller never busy-waits.
+ * Removed links are freed only once the link operation has passed a slot
+ * boundary. Adding or removing slotframes still takes the TSCH lock. */
+#ifdef TSCH_SCHEDULE_CONF_LOCK_FREE
+#define TSCH_SCHEDULE_LOCK_FREE TSCH_SCHEDULE_CONF_LOCK_FREE
+#else
+#define TSCH_SCHEDULE_LOCK_FREE 0
+#endif
+
+#if TSCH_SCHEDULE_LOCK_FREE && !TSCH_SCHEDULE_WITH_INDEX
+#error TSCH_SCHEDULE_CONF_LOCK_FREE requires TSCH_SCHEDULE_CONF_WITH_INDEX
+#endif
+
+#if TSCH_SCHEDULE_LOCK_FREE
+#define TSCH_SCHEDULE_INDEX_BANKS 2
+#else
+#define TSCH_SCHEDULE_INDEX_BANKS 1
+#endif
+
+/* Number of shared cells of the minimal schedule, spread over the
+ * slotframe and over channel offsets. More cells trade duty cycle for
+ * capacity. EBs announce any other number, for joining nodes to adopt */
+#ifdef TSCH_SCHEDULE_CONF_MINIMAL_CELLS
+#define TSCH_SCHEDULE_MINIMAL_CELLS TSCH_SCHEDULE_CONF_MINIMAL_CELLS
+#else
+#define TSCH_SCHEDULE_MINIMAL_CELLS 1
+#endif
+
+/* Keep usage counters for every link, updated by the link operation */
+#ifdef TSCH_SCHEDULE_CONF_WITH_LINK_STATS
+#define TSCH_SCHEDULE_WITH_LINK_STATS TSCH_SCHEDULE_CONF_WITH_LINK_STATS
+#else
+#define TSCH_SCHEDULE_WITH_LINK_STATS 0
+#endif
+
+#if TSCH_SCHEDULE_WITH_LINK_STATS
+/* Usage counters of a link, reset when the link is added */
+struct tsch_link_stats {
+  /* Number of transmissions attempted */
+  uint16_t tx_attempts;
+  /* Number of transmissions acked, or sent if broadcast */
+  uint16_t tx_ok;
+  /* Number of unicast transmissions without ack */
+  uint16_t tx_noack;
+  /* Number of acks with the NACK flag set */
+  uint16_t tx_nack;
+  /* Number of transmissions deferred because of a busy channel */
+  uint16_t cca_busy;
+  /* Number of Rx slots where nothing was received */
+  uint16_t rx_idle;
+  /* Number of frames received for us */
+  uint16_t rx_ok;
+};
+#endif /* TSCH_SCHEDULE_WITH_LINK_STATS */
+
+/* Adaptive idle listening suppression. Dedicated Rx links (Rx only,
+ * normal type) that keep being idle are sampled only every 2^exp cycles,
+ * exp growing up to TSCH_RX_SKIP_MAX_EXP. Any reception resets exp to 0.
+ * No signaling is needed: the sender retransmits on its dedicated link at
+ * every cycle, so a packet reaches a sampled cycle within 2^exp attempts. */
+#ifdef TSCH_CONF_ADAPTIVE_RX_SKIP
+#define TSCH_ADAPTIVE_RX_SKIP TSCH_CONF_ADAPTIVE_RX_SKIP
+#else
+#define TSCH_ADAPTIVE_RX_SKIP 0
+#endif
+
+/* Max log2 of the Rx sampling period */
+#ifdef TSCH_CONF_RX_SKIP_MAX_EXP
+#define TSCH_RX_SKIP_MAX_EXP TSCH_CONF_RX_SKIP_MAX_EXP
+#else
+#define TSCH_RX_SKIP_MAX_EXP 2
+#endif
+
+/* Number of consecutive idle samples before doubling the Rx sampling period */
+#ifdef TSCH_CONF_RX_SKIP_IDLE_THRESHOLD
+#define TSCH_RX_SKIP_IDLE_THRESHOLD TSCH_CONF_RX_SKIP_IDLE_THRESHOLD
+#else
+#define TSCH_RX_SKIP_IDLE_THRESHOLD 8
+#endif
+
+#if TSCH_ADAPTIVE_RX_SKIP && (1 << TSCH_RX_SKIP_MAX_EXP) > MAC_MAX_FRAME_RETRIES + 1
+#error TSCH_CONF_RX_SKIP_MAX_EXP too large: senders would run out of retransmissions
+#endif
+
+/* Queue-aware arbitration between links of different slotframes scheduled
+ * in the same slot. The link with highest priority is selected, then the
+ * one with lowest slotframe handle. The default priority favors a Tx link
+ * with a packet ready, then a link with Rx option, then an idle Tx link,
+ * and within each class the slotframe priority set with
+ * tsch_schedule_set_slotframe_priority. Can be overridden by defining
+ * TSCH_CALLBACK_LINK_PRIORITY to a function with the same prototype as
+ * tsch_schedule_default_link_priority. Called from interrupt. */
+#ifdef TSCH_SCHEDULE_CONF_WITH_ARBITRATION
+#define TSCH_SCHEDULE_WITH_ARBITRATION TSCH_SCHEDULE_CONF_WITH_ARBITRATION
+#else
+#define TSCH_SCHEDULE_WITH_ARBITRATION 0
+#endif
+
+/* Allow several links in the same timeslot of a slotframe, at different
+ * channel offsets. tsch_schedule_add_link then replaces only the link with
+ * the same timeslot and channel offset. When a timeslot has several links,
+ * the link operation favors a Tx link with a packet ready, then a link
+ * with Rx option (or uses TSCH_SCHEDULE_WITH_ARBITRATION priorities). */
+#ifdef TSCH_SCHEDULE_CONF_MULTI_LINKS_PER_TIMESLOT
+#define TSCH_SCHEDULE_MULTI_LINKS_PER_TIMESLOT TSCH_SCHEDULE_CONF_MULTI_LINKS_PER_TIMESLOT
+#else
+#define TSCH_SCHEDULE_MULTI_LINKS_PER_TIMESLOT 0
+#endif
+
+/* Compact link representation, to fit larger schedules in RAM. The link
+ * address is stored as an 8-bit index in a table of distinct link addresses,
+ * the channel offset and link type on 8 bits, and upper-layer data in a
+ * separate table with room for TSCH_SCHEDULE_LINK_DATA_SIZE links.
+ * Use tsch_schedule_get_link_addr, tsch_schedule_get_link_data and
+ * tsch_schedule_set_link_data rather than accessing the link fields. */
+#ifdef TSCH_SCHEDULE_CONF_COMPACT_LINKS
+#define TSCH_SCHEDULE_COMPACT_LINKS TSCH_SCHEDULE_CONF_COMPACT_LINKS
+#else
+#define TSCH_SCHEDULE_COMPACT_LINKS 0
+#endif
+
+/* Max number of distinct link addresses (compact representation only) */
+#ifdef TSCH_SCHEDULE_CONF_MAX_LINK_ADDRS
+#define TSCH_SCHEDULE_MAX_LINK_ADDRS TSCH_SCHEDULE_CONF_MAX_LINK_ADDRS
+#elif TSCH_MAX_LINKS < 255
+#define TSCH_SCHEDULE_MAX_LINK_ADDRS TSCH_MAX_LINKS
+#else
+#define TSCH_SCHEDULE_MAX_LINK_ADDRS 254
+#endif
+
+/* Max number of links with upper-layer data (compact representation only) */
+#ifdef TSCH_SCHEDULE_CONF_LINK_DATA_SIZE
+#define TSCH_SCHEDULE_LINK_DATA_SIZE TSCH_SCHEDULE_CONF_LINK_DATA_SIZE
+#else
+#define TSCH_SCHEDULE_LINK_DATA_SIZE TSCH_MAX_LINKS
+#endif
+
+#if TSCH_SCHEDULE_COMPACT_LINKS && TSCH_SCHEDULE_MAX_LINK_ADDRS > 254
+#error TSCH_SCHEDULE_CONF_MAX_LINK_ADDRS must fit in 8 bits
+#endif
+
+/* Keep a snapshot of the schedule in CFS (e.g. cfs-coffee), saved
+ * periodically when the schedule has changed and when leaving the network,
+ * and restored by tsch_schedule_init after a reboot. Upper-layer link
+ * data is not saved. */
+#ifdef TSCH_SCHEDULE_CONF_WITH_STORE
+#define TSCH_SCHEDULE_WITH_STORE TSCH_SCHEDULE_CONF_WITH_STORE
+#else
+#define TSCH_SCHEDULE_WITH_STORE 0
+#endif
+
+/* CFS file holding the schedule snapshot */
+#ifdef TSCH_SCHEDULE_CONF_STORE_FILE
+#define TSCH_SCHEDULE_STORE_FILE TSCH_SCHEDULE_CONF_STORE_FILE
+#else
+#define TSCH_SCHEDULE_STORE_FILE "tsch-schedule"
+#endif
+
+/* Period at which the snapshot is saved, if the schedule has changed */
+#ifdef TSCH_SCHEDULE_CONF_STORE_PERIOD
+#define TSCH_SCHEDULE_STORE_PERIOD TSCH_SCHEDULE_CONF_STORE_PERIOD
+#else
+#define TSCH_SCHEDULE_STORE_PERIOD (5 * 60 * CLOCK_SECOND)
+#endif
+
+#if TSCH_ADAPTIVE_RX_SKIP
+/* Rx sampling state of a link */
+struct tsch_link_rx_skip {
+  /* log2 of the current sampling period, in slotframe cycles */
+  uint8_t exp;
+  /* Consecutive idle samples at the current period */
+  uint8_t idle_count;
+  /* Cycles elapsed, modulo 256 */
+  uint8_t cycle;
+};
+#endif /* TSCH_ADAPTIVE_RX_SKIP */
+
 struct tsch_link {
   /* Links are stored as a list: "next" must be the first field */
   struct tsch_link *next;
   /* Unique identifier */
   uint16_t handle;
+#if !TSCH_SCHEDULE_COMPACT_LINKS
   /* MAC address of neighbor */
   linkaddr_t addr;
+#endif /* !TSCH_SCHEDULE_COMPACT_LINKS */
   /* Slotframe identifier */
   uint16_t slotframe_handle;
   /* Identifier of Slotframe to which this link belongs
@@ -71,18 +271,47 @@ struct tsch_link {
   /* uint8_t handle; */
   /* Timeslot for this link */
   uint16_t timeslot;
+#if TSCH_SCHEDULE_COMPACT_LINKS
+  /* Channel offset for this link */
+  uint8_t channel_offset;
+#else /* TSCH_SCHEDULE_COMPACT_LINKS */
   /* Channel offset for this link */
   uint16_t channel_offset;
+#endif /* TSCH_SCHEDULE_COMPACT_LINKS */
   /* A bit string that defines
    * b0 = Transmit, b1 = Receive, b2 = Shared, b3 = Timekeeping, b4 = reserved */
   uint8_t link_options;
+#if TSCH_SCHEDULE_COMPACT_LINKS
+  /* Type of link (enum link_type) */
+  uint8_t link_type;
+  /* Index of the MAC address of neighbor in the link address table */
+  uint8_t addr_index;
+#else /* TSCH_SCHEDULE_COMPACT_LINKS */
   /* Type of link. NORMAL = 0. ADVERTISING = 1, and indicates
      the link may be used to send an Enhanced beacon. */
   enum link_type link_type;
   /* Any other data for upper layers */
   void *data;
+#endif /* TSCH_SCHEDULE_COMPACT_LINKS */
+#if TSCH_SCHEDULE_WITH_LINK_STATS
+  /* Usage counters, updated from interrupt */
+  struct tsch_link_stats stats;
+#endif /* TSCH_SCHEDULE_WITH_LINK_STATS */
+#if TSCH_ADAPTIVE_RX_SKIP
+  /* Rx sampling state, updated from interrupt */
+  struct tsch_link_rx_skip rx_skip;
+#endif /* TSCH_ADAPTIVE_RX_SKIP */
 };
 
+#if TSCH_SCHEDULE_WITH_INDEX
+/* Links of a slotframe, sorted by increasing timeslot */
+struct tsch_slotframe_index {
+  /* Number of links in the index */
+  uint16_t len;
+  struct tsch_link *links[TSCH_SCHEDULE_MAX_LINKS_PER_SLOTFRAME];
+};
+#endif /* TSCH_SCHEDULE_WITH_INDEX */
+
 struct tsch_slotframe {
   /* Slotframes are stored as a list: "next" must be the first field */
   struct tsch_slotframe *next;
@@ -91,10 +320,36 @@ struct tsch_slotframe {
   /* Number of timeslots in the slotframe.
    * Stored as struct asn_divisor_t because we often need ASN%size */
   struct asn_divisor_t size;
-  /* List of links belonging to this slotframe */
-  LIST_STRUCT(links_list);
+  /* Timeslot of the ASN of the last call to tsch_schedule_get_next_active_link
+   * from the link operation, moved forward without division */
+  struct asn_cursor_t cursor;
+  /* List of links belonging to this slotframe, appended to in O(1) */
+  LIST_STRUCT_WITH_TAIL(links_list);
+#if TSCH_SCHEDULE_WITH_ARBITRATION
+  /* Priority of the slotframe's links in case of overlap, 0 by default */
+  uint8_t priority;
+#endif /* TSCH_SCHEDULE_WITH_ARBITRATION */
+#if TSCH_SCHEDULE_WITH_INDEX
+  /* The index bank in use by the link operation.
+   * XXX: must be an 8-bit quantity to be published atomically. */
+  volatile uint8_t index_bank;
+#if TSCH_SCHEDULE_LOCK_FREE
+  /* Does the shadow bank hold updates not published yet? */
+  uint8_t index_dirty;
+#endif /* TSCH_SCHEDULE_LOCK_FREE */
+  /* Position in the index of the next active link, as of the last
+   * call to tsch_schedule_get_next_active_link. Only a hint. */
+  uint16_t index_cursor;
+  struct tsch_slotframe_index index[TSCH_SCHEDULE_INDEX_BANKS];
+#endif /* TSCH_SCHEDULE_WITH_INDEX */
 };
 
+#if TSCH_SCHEDULE_LOCK_FREE
+/* Incremented by the link operation at every slot boundary, i.e. every
+ * time it is done with the previous link and has looked up the next one */
+extern volatile uint16_t tsch_schedule_epoch;
+#endif /* TSCH_SCHEDULE_LOCK_FREE */
+
 /* Initialization. Return 1 is success, 0 if failure. */
 int tsch_schedule_init();
 /* Adds and returns a slotframe (NULL if failure) */
@@ -103,23 +358,83 @@ struct tsch_slotframe *tsch_schedule_add_slotframe(uint16_t handle, uint16_t siz
 int tsch_schedule_remove_slotframe(struct tsch_slotframe *slotframe);
 /* Looks for a slotframe from a handle */
 struct tsch_slotframe *tsch_schedule_get_slotframe_from_handle(uint16_t handle);
+/* Returns the first slotframe (NULL if none or locked) */
+struct tsch_slotframe *tsch_schedule_slotframe_head(void);
+/* Returns the slotframe after sf (NULL if none) */
+struct tsch_slotframe *tsch_schedule_slotframe_next(struct tsch_slotframe *sf);
 /* Looks for a link from a handle */
 struct tsch_link *tsch_schedule_get_link_from_handle(uint16_t handle);
 /* Adds a link to a slotframe, return a pointer to it (NULL if failure) */
 struct tsch_link *tsch_schedule_add_link(struct tsch_slotframe *slotframe,
                                          uint8_t link_options, enum link_type link_type, const linkaddr_t *address,
                                          uint16_t timeslot, uint16_t channel_offset);
+/* Returns the MAC address of neighbor of a link */
+#if TSCH_SCHEDULE_COMPACT_LINKS
+const linkaddr_t *tsch_schedule_get_link_addr(const struct tsch_link *l);
+#else /* TSCH_SCHEDULE_COMPACT_LINKS */
+#define tsch_schedule_get_link_addr(l) ((const linkaddr_t *)&(l)->addr)
+#endif /* TSCH_SCHEDULE_COMPACT_LINKS */
+/* Returns the upper-layer data of a link */
+void *tsch_schedule_get_link_data(const struct tsch_link *l);
+/* Sets the upper-layer data of a link. Return 1 if success, 0 if failure */
+int tsch_schedule_set_link_data(struct tsch_link *l, void *data);
 /* Removes a link. Return 1 if success, 0 if failure */
 int tsch_schedule_remove_link(struct tsch_slotframe *slotframe, struct tsch_link *l);
-/* Removes a link from slotframe and timeslot. Return a 1 if success, 0 if failure */
+/* Removes a link from slotframe and timeslot. Return a 1 if success, 0 if failure.
+ * With TSCH_SCHEDULE_MULTI_LINKS_PER_TIMESLOT, removes all links of the timeslot. */
 int tsch_schedule_remove_link_from_timeslot(struct tsch_slotframe *slotframe, uint16_t timeslot);
-/* Looks within a slotframe for a link with a given timeslot */
+/* Looks within a slotframe for a link with a given timeslot.
+ * With TSCH_SCHEDULE_MULTI_LINKS_PER_TIMESLOT, returns the first one added. */
 struct tsch_link *tsch_schedule_get_link_from_timeslot(struct tsch_slotframe *slotframe, uint16_t timeslot);
+/* Looks within a slotframe for a link with a given timeslot and channel offset */
+struct tsch_link *tsch_schedule_get_link_from_timeslot_and_offset(struct tsch_slotframe *slotframe,
+                                                                  uint16_t timeslot, uint16_t channel_offset);
+/* Starts a batch of link updates: subsequent calls to tsch_schedule_add_link
+ * and tsch_schedule_remove_link are applied all at once, in a single
+ * critical section, by tsch_schedule_commit. Slotframes cannot be added
+ * or removed within a batch. Return 1 if success, 0 if failure */
+int tsch_schedule_begin(void);
+/* Ends a batch of link updates. If any update of the batch has failed,
+ * the whole batch is rolled back. Return 1 if success, 0 if failure */
+int tsch_schedule_commit(void);
+/* Ends a batch of link updates, rolling back all of them */
+void tsch_schedule_abort(void);
 /* Returns the link to be used at a given ASN */
 struct tsch_link *tsch_schedule_get_link_from_asn(struct asn_t *asn);
 /* Returns the next active link after a given ASN */
 struct tsch_link *tsch_schedule_get_next_active_link(struct asn_t *asn, uint16_t *time_offset);
 /* Create a 6TiSCH minimal schedule */
 void tsch_schedule_create_minimal();
+/* Create or rebuild the minimal schedule with num_cells shared cells per
+ * slotframe. To change it network-wide at runtime, see
+ * tsch_schedule_minimal_change. Return 1 if success, 0 if failure */
+int tsch_schedule_create_minimal_cells(uint8_t num_cells);
+/* Returns the number of cells of our minimal schedule, 0 if none */
+uint8_t tsch_schedule_minimal_cells(void);
+#if TSCH_SCHEDULE_WITH_ARBITRATION
+/* Sets the priority of a slotframe's links in case of overlap.
+ * Return 1 if success, 0 if failure */
+int tsch_schedule_set_slotframe_priority(struct tsch_slotframe *slotframe, uint8_t priority);
+/* Returns the priority of a link of a given slotframe, the higher the better */
+int tsch_schedule_default_link_priority(const struct tsch_slotframe *slotframe, const struct tsch_link *l);
+#endif /* TSCH_SCHEDULE_WITH_ARBITRATION */
+#if TSCH_SCHEDULE_WITH_STORE
+/* Saves a snapshot of the schedule to CFS. Return 1 if success, 0 if failure */
+int tsch_schedule_save(void);
+/* Restores the schedule from the CFS snapshot, reusing existing slotframes
+ * of the same handle and size. Return the number of links restored */
+int tsch_schedule_restore(void);
+#endif /* TSCH_SCHEDULE_WITH_STORE */
+/* Prints out the current schedule (all slotframes and links) */
+void tsch_schedule_print();
+#if TSCH_SCHEDULE_WITH_LINK_STATS
+/* Returns the usage counters of a link (NULL if failure) */
+const struct tsch_link_stats *tsch_schedule_get_link_stats(const struct tsch_link *l);
+/* Sums up the usage counters of all links of a slotframe into stats.
+ * Return the number of links, or -1 if failure */
+int tsch_schedule_get_slotframe_stats(struct tsch_slotframe *slotframe, struct tsch_link_stats *stats);
+/* Resets the usage counters of all links */
+void tsch_schedule_reset_link_stats(void);
+#endif /* TSCH_SCHEDULE_WITH_LINK_STATS */
 
 #endif /* __TSCH_SCHEDULE_H__ */
@@ -0,0 +1,861 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         6P-style cell negotiation and its bandwidth-estimation
+ *         scheduling function, see tsch-sixp.h.
+ *
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "net/packetbuf.h"
+#include "net/mac/mac.h"
+#include "net/mac/frame802154.h"
+#include "net/llsec/llsec802154.h"
+#include "net/mac/tsch/tsch.h"
+#include "net/mac/tsch/tsch-private.h"
+#include "net/mac/tsch/tsch-queue.h"
+#include "net/mac/tsch/tsch-schedule.h"
+#include "net/mac/tsch/tsch-log.h"
+#include "net/mac/tsch/tsch-sixp.h"
+#include <stdio.h>
+#include <string.h>
+
+#if TSCH_WITH_SIXP
+
+#if LLSEC802154_SECURITY_LEVEL
+#error TSCH_CONF_WITH_SIXP does not support link-layer security
+#endif
+
+/* A message is a data frame whose payload is:
+ *   dispatch (1), version | type << 4 (1), code (1), SFID (1), seqnum (1)
+ * followed, for ADD, DELETE and RELOCATE requests, by:
+ *   cell options of the requester (1), number of cells (1), [relocation
+ *   list (RELOCATE only)], candidate list
+ * and, for responses, by the cell list. A cell is its timeslot and
+ * channel offset, 2 bytes each, little endian. */
+/* Payload dispatch: a 6LoWPAN NALP (not a LoWPAN frame) value, never
+ * taken for IPv6 */
+#define SIXP_DISPATCH 0x3c
+#define SIXP_VERSION 0
+#define SIXP_HEADER_LEN 5
+#define SIXP_CELL_LEN 4
+/* The SFID of our scheduling function */
+#define SIXP_SFID 0xf0
+
+/* Message types */
+#define SIXP_TYPE_REQUEST 0
+#define SIXP_TYPE_RESPONSE 1
+
+/* Commands */
+#define SIXP_CMD_ADD 1
+#define SIXP_CMD_DELETE 2
+#define SIXP_CMD_RELOCATE 3
+#define SIXP_CMD_CLEAR 7
+
+/* Return codes */
+#define SIXP_RC_SUCCESS 0
+#define SIXP_RC_ERR 2
+#define SIXP_RC_ERR_VERSION 4
+#define SIXP_RC_ERR_SFID 5
+#define SIXP_RC_ERR_CELLLIST 7
+#define SIXP_RC_ERR_BUSY 8
+
+/* Longest cell list we send or keep: two candidates per cell */
+#define SIXP_MAX_CELLLIST (2 * TSCH_SIXP_MAX_CELLS)
+#define SIXP_MAX_LEN (SIXP_HEADER_LEN + 2 \
+                      + (TSCH_SIXP_MAX_CELLS + SIXP_MAX_CELLLIST) * SIXP_CELL_LEN)
+
+struct sixp_cell {
+  uint16_t timeslot;
+  uint16_t channel_offset;
+};
+
+enum sixp_state {
+  SIXP_IDLE,
+  /* Requester: waiting for the response */
+  SIXP_WAIT_RESPONSE,
+  /* Responder: the response is applied once acked */
+  SIXP_SEND_RESPONSE,
+};
+
+/* 6P state of a neighbor */
+struct sixp_nbr {
+  linkaddr_t addr;
+  uint8_t in_use;
+  uint8_t state;
+  /* Sequence number of our last request */
+  uint8_t seqnum;
+  /* Command of the ongoing transaction, and our options for its cells */
+  uint8_t command;
+  uint8_t cell_options;
+  /* Cells of the ongoing transaction: the candidates we proposed, or the
+   * cells we accepted, deleted or moved to as responder */
+  uint8_t num_cells;
+  struct sixp_cell cells[SIXP_MAX_CELLLIST];
+  /* RELOCATE: the cells being moved. As responder, relocated[i] moves
+   * to cells[i] */
+  uint8_t num_relocated;
+  struct sixp_cell relocated[TSCH_SIXP_MAX_CELLS];
+  /* Scheduling function: packets queued to the neighbor at the last run */
+  uint16_t last_enqueued;
+  /* Transaction timeout */
+  struct ctimer timer;
+};
+
+static struct sixp_nbr sixp_nbrs[TSCH_SIXP_MAX_NEIGHBORS];
+static struct tsch_slotframe *sf_sixp;
+/* Scheduling function timer, and slotframe cycles per period */
+static struct ctimer sf_timer;
+static uint16_t sf_cycles;
+
+/*---------------------------------------------------------------------------*/
+/* Returns the 6P state of a neighbor, allocated if create is set (NULL if
+ * not found or no room) */
+static struct sixp_nbr *
+get_nbr(const linkaddr_t *addr, int create)
+{
+  struct sixp_nbr *free_nbr = NULL;
+  int i;
+
+  for(i = 0; i < TSCH_SIXP_MAX_NEIGHBORS; i++) {
+    if(sixp_nbrs[i].in_use) {
+      if(linkaddr_cmp(&sixp_nbrs[i].addr, addr)) {
+        return &sixp_nbrs[i];
+      }
+    } else if(free_nbr == NULL) {
+      free_nbr = &sixp_nbrs[i];
+    }
+  }
+  if(create && free_nbr != NULL) {
+    memset(free_nbr, 0, sizeof(struct sixp_nbr));
+    linkaddr_copy(&free_nbr->addr, addr);
+    free_nbr->in_use = 1;
+    return free_nbr;
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* The options of a cell as seen from the other end */
+static uint8_t
+peer_options(uint8_t options)
+{
+  uint8_t ret = options & LINK_OPTION_SHARED;
+  if(options & LINK_OPTION_TX) {
+    ret |= LINK_OPTION_RX;
+  }
+  if(options & LINK_OPTION_RX) {
+    ret |= LINK_OPTION_TX;
+  }
+  return ret;
+}
+/*---------------------------------------------------------------------------*/
+static int
+cell_in_list(const struct sixp_cell *cells, uint8_t num, uint16_t timeslot)
+{
+  uint8_t i;
+  for(i = 0; i < num; i++) {
+    if(cells[i].timeslot == timeslot) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Is a timeslot free in our slotframe, and in none of the ongoing
+ * transactions? */
+static int
+timeslot_is_free(uint16_t timeslot)
+{
+  int i;
+
+  if(tsch_schedule_get_link_from_timeslot(sf_sixp, timeslot) != NULL) {
+    return 0;
+  }
+  for(i = 0; i < TSCH_SIXP_MAX_NEIGHBORS; i++) {
+    if(sixp_nbrs[i].in_use && sixp_nbrs[i].state != SIXP_IDLE
+       && cell_in_list(sixp_nbrs[i].cells, sixp_nbrs[i].num_cells, timeslot)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Picks up to num candidate cells at random free timeslots.
+ * Returns the number picked */
+static uint8_t
+pick_candidates(struct sixp_cell *cells, uint8_t num)
+{
+  uint8_t count = 0;
+  uint8_t tries;
+
+  for(tries = 0; count < num && tries < 4 * num; tries++) {
+    uint16_t timeslot = random_rand() % TSCH_SIXP_SLOTFRAME_SIZE;
+    if(timeslot_is_free(timeslot) && !cell_in_list(cells, count, timeslot)) {
+      cells[count].timeslot = timeslot;
+      cells[count].channel_offset = hopping_sequence_length.val > 0
+        ? random_rand() % hopping_sequence_length.val : 0;
+      count++;
+    }
+  }
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+/* Our link with a neighbor at a cell, with the given options */
+static struct tsch_link *
+get_link(const linkaddr_t *addr, const struct sixp_cell *cell, uint8_t link_options)
+{
+  struct tsch_link *l = tsch_schedule_get_link_from_timeslot_and_offset(sf_sixp,
+                          cell->timeslot, cell->channel_offset);
+  if(l != NULL && l->link_options == link_options
+     && linkaddr_cmp(tsch_schedule_get_link_addr(l), addr)) {
+    return l;
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Removes all our cells with a neighbor, or with all if addr is NULL */
+static void
+remove_cells(const linkaddr_t *addr)
+{
+  struct tsch_link *l = list_head(sf_sixp->links_list);
+  while(l != NULL) {
+    struct tsch_link *next = list_item_next(l);
+    if(addr == NULL || linkaddr_cmp(tsch_schedule_get_link_addr(l), addr)) {
+      tsch_schedule_remove_link(sf_sixp, l);
+    }
+    l = next;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Applies a successful transaction to our schedule, all at once.
+ * cells: those of the response */
+static void
+apply_transaction(struct sixp_nbr *nbr, const struct sixp_cell *cells, uint8_t num)
+{
+  static const char *names[] = { "", "add", "delete", "relocate" };
+  struct tsch_link *l;
+  int batch;
+  uint8_t i;
+
+  batch = tsch_schedule_begin();
+  for(i = 0; i < num; i++) {
+    switch(nbr->command) {
+      case SIXP_CMD_ADD:
+        tsch_schedule_add_link(sf_sixp, nbr->cell_options, LINK_TYPE_NORMAL, &nbr->addr,
+                               cells[i].timeslot, cells[i].channel_offset);
+        break;
+      case SIXP_CMD_DELETE:
+        if((l = get_link(&nbr->addr, &cells[i], nbr->cell_options)) != NULL) {
+          tsch_schedule_remove_link(sf_sixp, l);
+        }
+        break;
+      case SIXP_CMD_RELOCATE:
+        if(i < nbr->num_relocated
+           && (l = get_link(&nbr->addr, &nbr->relocated[i], nbr->cell_options)) != NULL) {
+          tsch_schedule_remove_link(sf_sixp, l);
+          tsch_schedule_add_link(sf_sixp, nbr->cell_options, LINK_TYPE_NORMAL, &nbr->addr,
+                                 cells[i].timeslot, cells[i].channel_offset);
+        }
+        break;
+    }
+  }
+  if(batch && !tsch_schedule_commit()) {
+    LOG("TSCH-sixp:! failed to %s %u cells with %u\n", names[nbr->command], num,
+        LOG_NODEID_FROM_LINKADDR(&nbr->addr));
+    return;
+  }
+  if(num > 0) {
+    LOG("TSCH-sixp: %s %u cells with %u, now %u\n", names[nbr->command], num,
+        LOG_NODEID_FROM_LINKADDR(&nbr->addr), tsch_sixp_cell_count(&nbr->addr, 0));
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+transaction_timeout(void *ptr)
+{
+  struct sixp_nbr *nbr = ptr;
+  LOG("TSCH-sixp:! transaction %u with %u timed out\n", nbr->seqnum,
+      LOG_NODEID_FROM_LINKADDR(&nbr->addr));
+  nbr->state = SIXP_IDLE;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+write_header(uint8_t *buf, uint8_t type, uint8_t code, uint8_t seqnum)
+{
+  buf[0] = SIXP_DISPATCH;
+  buf[1] = SIXP_VERSION | (type << 4);
+  buf[2] = code;
+  buf[3] = SIXP_SFID;
+  buf[4] = seqnum;
+  return buf + SIXP_HEADER_LEN;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+write_cells(uint8_t *buf, const struct sixp_cell *cells, uint8_t num)
+{
+  uint8_t i;
+  for(i = 0; i < num; i++) {
+    buf[0] = cells[i].timeslot & 0xff;
+    buf[1] = cells[i].timeslot >> 8;
+    buf[2] = cells[i].channel_offset & 0xff;
+    buf[3] = cells[i].channel_offset >> 8;
+    buf += SIXP_CELL_LEN;
+  }
+  return buf;
+}
+/*---------------------------------------------------------------------------*/
+/* Reads up to max cells, returns the number read */
+static uint8_t
+read_cells(const uint8_t *buf, uint8_t len, struct sixp_cell *cells, uint8_t max)
+{
+  uint8_t num = 0;
+  while(len >= SIXP_CELL_LEN && num < max) {
+    cells[num].timeslot = buf[0] | (buf[1] << 8);
+    cells[num].channel_offset = buf[2] | (buf[3] << 8);
+    buf += SIXP_CELL_LEN;
+    len -= SIXP_CELL_LEN;
+    num++;
+  }
+  return num;
+}
+/*---------------------------------------------------------------------------*/
+/* Sends a 6P message. The outcome goes to sent, possibly before returning */
+static void
+send_message(const linkaddr_t *addr, const uint8_t *buf, uint8_t len,
+             mac_callback_t sent, void *ptr)
+{
+  packetbuf_clear();
+  memcpy(packetbuf_dataptr(), buf, len);
+  packetbuf_set_datalen(len);
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, addr);
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &linkaddr_node_addr);
+#ifndef WITHOUT_ATTR_FRAME_TYPE
+  packetbuf_set_attr(PACKETBUF_ATTR_FRAME_TYPE, FRAME802154_DATAFRAME);
+#endif /* WITHOUT_ATTR_FRAME_TYPE */
+  tschmac_driver.send(sent, ptr);
+}
+/*---------------------------------------------------------------------------*/
+static void
+request_sent(void *ptr, int status, int transmissions)
+{
+  struct sixp_nbr *nbr = ptr;
+  if(nbr->state == SIXP_WAIT_RESPONSE && status != MAC_TX_OK) {
+    ctimer_stop(&nbr->timer);
+    nbr->state = SIXP_IDLE;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Sends a request with the cells of nbr. Returns 1 if sent */
+static int
+send_request(struct sixp_nbr *nbr, uint8_t command, uint8_t options, uint8_t num_cells)
+{
+  uint8_t buf[SIXP_MAX_LEN];
+  uint8_t *p;
+
+  nbr->seqnum++;
+  nbr->command = command;
+  nbr->cell_options = options;
+  p = write_header(buf, SIXP_TYPE_REQUEST, command, nbr->seqnum);
+  if(command != SIXP_CMD_CLEAR) {
+    *p++ = options;
+    *p++ = num_cells;
+    if(command == SIXP_CMD_RELOCATE) {
+      p = write_cells(p, nbr->relocated, nbr->num_relocated);
+    }
+    p = write_cells(p, nbr->cells, nbr->num_cells);
+  }
+
+  nbr->state = SIXP_WAIT_RESPONSE;
+  ctimer_set(&nbr->timer, TSCH_SIXP_TIMEOUT, transaction_timeout, nbr);
+  send_message(&nbr->addr, buf, p - buf, request_sent, nbr);
+  return nbr->state == SIXP_WAIT_RESPONSE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+response_sent(void *ptr, int status, int transmissions)
+{
+  struct sixp_nbr *nbr = ptr;
+  if(nbr->state == SIXP_SEND_RESPONSE) {
+    nbr->state = SIXP_IDLE;
+    /* Otherwise the requester times out, without changes on either side */
+    if(status == MAC_TX_OK) {
+      apply_transaction(nbr, nbr->cells, nbr->num_cells);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Sends a response with a cell list. With nbr, the transaction is applied
+ * once the response is acked */
+static void
+send_response(const linkaddr_t *addr, struct sixp_nbr *nbr, uint8_t rc, uint8_t seqnum,
+              const struct sixp_cell *cells, uint8_t num)
+{
+  uint8_t buf[SIXP_MAX_LEN];
+  uint8_t *p;
+
+  p = write_header(buf, SIXP_TYPE_RESPONSE, rc, seqnum);
+  p = write_cells(p, cells, num);
+  if(nbr != NULL) {
+    nbr->state = SIXP_SEND_RESPONSE;
+    send_message(addr, buf, p - buf, response_sent, nbr);
+  } else {
+    send_message(addr, buf, p - buf, NULL, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+request_input(const linkaddr_t *from, uint8_t command, uint8_t sfid, uint8_t seqnum,
+              const uint8_t *body, uint8_t len)
+{
+  struct sixp_nbr *nbr = get_nbr(from, 1);
+  struct sixp_cell list[SIXP_MAX_CELLLIST];
+  struct sixp_cell relocated[TSCH_SIXP_MAX_CELLS];
+  uint8_t num_list;
+  uint8_t num_relocated = 0;
+  uint8_t num_cells;
+  uint8_t options;
+  int room;
+  uint8_t i;
+
+  if(nbr == NULL) {
+    send_response(from, NULL, SIXP_RC_ERR_BUSY, seqnum, NULL, 0);
+    return;
+  }
+  if(sfid != SIXP_SFID) {
+    send_response(from, NULL, SIXP_RC_ERR_SFID, seqnum, NULL, 0);
+    return;
+  }
+
+  if(command == SIXP_CMD_CLEAR) {
+    /* Always honoured, ends any ongoing transaction with the neighbor */
+    ctimer_stop(&nbr->timer);
+    nbr->state = SIXP_IDLE;
+    remove_cells(from);
+    LOG("TSCH-sixp: clear with %u\n", LOG_NODEID_FROM_LINKADDR(from));
+    send_response(from, NULL, SIXP_RC_SUCCESS, seqnum, NULL, 0);
+    return;
+  }
+  if(nbr->state != SIXP_IDLE) {
+    send_response(from, NULL, SIXP_RC_ERR_BUSY, seqnum, NULL, 0);
+    return;
+  }
+  if(len < 2 || (command != SIXP_CMD_ADD && command != SIXP_CMD_DELETE
+                 && command != SIXP_CMD_RELOCATE)) {
+    send_response(from, NULL, SIXP_RC_ERR, seqnum, NULL, 0);
+    return;
+  }
+
+  options = peer_options(body[0]);
+  num_cells = body[1];
+  body += 2;
+  len -= 2;
+  if(command == SIXP_CMD_RELOCATE) {
+    if(len < num_cells * SIXP_CELL_LEN) {
+      send_response(from, NULL, SIXP_RC_ERR, seqnum, NULL, 0);
+      return;
+    }
+    num_relocated = read_cells(body, num_cells * SIXP_CELL_LEN, relocated, TSCH_SIXP_MAX_CELLS);
+    body += num_cells * SIXP_CELL_LEN;
+    len -= num_cells * SIXP_CELL_LEN;
+  }
+  num_list = read_cells(body, len, list, SIXP_MAX_CELLLIST);
+
+  nbr->command = command;
+  nbr->cell_options = options;
+  nbr->num_cells = 0;
+  nbr->num_relocated = 0;
+  switch(command) {
+    case SIXP_CMD_ADD:
+      /* The first candidates free in our schedule, within our quota */
+      room = TSCH_SIXP_MAX_CELLS - tsch_sixp_cell_count(from, 0);
+      for(i = 0; i < num_list && nbr->num_cells < num_cells && nbr->num_cells < room; i++) {
+        if(timeslot_is_free(list[i].timeslot)
+           && !cell_in_list(nbr->cells, nbr->num_cells, list[i].timeslot)) {
+          nbr->cells[nbr->num_cells++] = list[i];
+        }
+      }
+      break;
+    case SIXP_CMD_DELETE:
+      for(i = 0; i < num_list && nbr->num_cells < num_cells; i++) {
+        if(get_link(from, &list[i], options) != NULL) {
+          nbr->cells[nbr->num_cells++] = list[i];
+        }
+      }
+      if(nbr->num_cells == 0 && num_cells > 0) {
+        send_response(from, NULL, SIXP_RC_ERR_CELLLIST, seqnum, NULL, 0);
+        return;
+      }
+      break;
+    case SIXP_CMD_RELOCATE:
+      for(i = 0; i < num_relocated; i++) {
+        if(get_link(from, &relocated[i], options) == NULL) {
+          send_response(from, NULL, SIXP_RC_ERR_CELLLIST, seqnum, NULL, 0);
+          return;
+        }
+      }
+      /* Move as many cells as we have free candidates for, in order */
+      for(i = 0; i < num_list && nbr->num_cells < num_relocated; i++) {
+        if(timeslot_is_free(list[i].timeslot)
+           && !cell_in_list(nbr->cells, nbr->num_cells, list[i].timeslot)) {
+          nbr->relocated[nbr->num_cells] = relocated[nbr->num_cells];
+          nbr->cells[nbr->num_cells++] = list[i];
+        }
+      }
+      nbr->num_relocated = nbr->num_cells;
+      break;
+  }
+  send_response(from, nbr, SIXP_RC_SUCCESS, seqnum, nbr->cells, nbr->num_cells);
+}
+/*---------------------------------------------------------------------------*/
+static void
+response_input(const linkaddr_t *from, uint8_t rc, uint8_t seqnum,
+               const uint8_t *body, uint8_t len)
+{
+  struct sixp_nbr *nbr = get_nbr(from, 0);
+  struct sixp_cell list[SIXP_MAX_CELLLIST];
+  struct sixp_cell cells[SIXP_MAX_CELLLIST];
+  uint8_t num_list;
+  uint8_t num = 0;
+  uint8_t i;
+
+  if(nbr == NULL || nbr->state != SIXP_WAIT_RESPONSE || seqnum != nbr->seqnum) {
+    return;
+  }
+  ctimer_stop(&nbr->timer);
+  nbr->state = SIXP_IDLE;
+
+  if(rc == SIXP_RC_SUCCESS) {
+    if(nbr->command == SIXP_CMD_CLEAR) {
+      return;
+    }
+    num_list = read_cells(body, len, list, SIXP_MAX_CELLLIST);
+    for(i = 0; i < num_list; i++) {
+      if(nbr->command == SIXP_CMD_DELETE) {
+        cells[num++] = list[i];
+      } else if(cell_in_list(nbr->cells, nbr->num_cells, list[i].timeslot)
+                && tsch_schedule_get_link_from_timeslot(sf_sixp, list[i].timeslot) == NULL) {
+        /* Only our own candidates, still free. Relocated cells stay paired
+         * with their new cell: stop at the first that is not */
+        cells[num++] = list[i];
+      } else if(nbr->command == SIXP_CMD_RELOCATE) {
+        break;
+      }
+    }
+    apply_transaction(nbr, cells, num);
+  } else if(rc != SIXP_RC_ERR_BUSY && nbr->command != SIXP_CMD_CLEAR) {
+    /* Our schedules disagree: start over with the neighbor */
+    LOG("TSCH-sixp:! transaction %u with %u failed: %u\n", seqnum,
+        LOG_NODEID_FROM_LINKADDR(from), rc);
+    tsch_sixp_clear(from);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_sixp_input(void)
+{
+  const uint8_t *buf = packetbuf_dataptr();
+  uint8_t len = packetbuf_datalen();
+  uint8_t msg[SIXP_MAX_LEN];
+  linkaddr_t from;
+
+  if(len < SIXP_HEADER_LEN || buf[0] != SIXP_DISPATCH) {
+    return 0;
+  }
+  /* 6P is between neighbors only */
+  if(sf_sixp == NULL
+     || !linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &linkaddr_node_addr)) {
+    return 1;
+  }
+
+  /* packetbuf is reused for the response */
+  linkaddr_copy(&from, packetbuf_addr(PACKETBUF_ADDR_SENDER));
+  if(len > SIXP_MAX_LEN) {
+    len = SIXP_MAX_LEN;
+  }
+  memcpy(msg, buf, len);
+
+  switch(msg[1] >> 4) {
+    case SIXP_TYPE_REQUEST:
+      if((msg[1] & 0x0f) != SIXP_VERSION) {
+        send_response(&from, NULL, SIXP_RC_ERR_VERSION, msg[4], NULL, 0);
+      } else {
+        request_input(&from, msg[2], msg[3], msg[4],
+                      msg + SIXP_HEADER_LEN, len - SIXP_HEADER_LEN);
+      }
+      break;
+    case SIXP_TYPE_RESPONSE:
+      if((msg[1] & 0x0f) == SIXP_VERSION && msg[3] == SIXP_SFID) {
+        response_input(&from, msg[2], msg[4], msg + SIXP_HEADER_LEN, len - SIXP_HEADER_LEN);
+      }
+      break;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* The state of a neighbor we can start a transaction with, NULL if none */
+static struct sixp_nbr *
+get_idle_nbr(const linkaddr_t *addr)
+{
+  struct sixp_nbr *nbr;
+  if(sf_sixp == NULL || addr == NULL || linkaddr_cmp(addr, &linkaddr_null)) {
+    return NULL;
+  }
+  nbr = get_nbr(addr, 1);
+  return nbr != NULL && nbr->state == SIXP_IDLE ? nbr : NULL;
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_sixp_add_cells(const linkaddr_t *addr, uint8_t num_cells)
+{
+  struct sixp_nbr *nbr = get_idle_nbr(addr);
+  int room;
+
+  if(nbr == NULL) {
+    return 0;
+  }
+  room = TSCH_SIXP_MAX_CELLS - tsch_sixp_cell_count(addr, 0);
+  if(num_cells > room) {
+    num_cells = room > 0 ? room : 0;
+  }
+  if(num_cells == 0) {
+    return 0;
+  }
+  nbr->num_relocated = 0;
+  nbr->num_cells = pick_candidates(nbr->cells, 2 * num_cells);
+  if(nbr->num_cells == 0) {
+    return 0;
+  }
+  return send_request(nbr, SIXP_CMD_ADD, LINK_OPTION_TX, num_cells);
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_sixp_delete_cells(const linkaddr_t *addr, uint8_t num_cells)
+{
+  struct sixp_nbr *nbr = get_idle_nbr(addr);
+  struct tsch_link *l;
+
+  if(nbr == NULL) {
+    return 0;
+  }
+  nbr->num_relocated = 0;
+  nbr->num_cells = 0;
+  for(l = list_head(sf_sixp->links_list); l != NULL && nbr->num_cells < num_cells;
+      l = list_item_next(l)) {
+    if(l->link_options == LINK_OPTION_TX && linkaddr_cmp(tsch_schedule_get_link_addr(l), addr)) {
+      nbr->cells[nbr->num_cells].timeslot = l->timeslot;
+      nbr->cells[nbr->num_cells].channel_offset = l->channel_offset;
+      nbr->num_cells++;
+    }
+  }
+  if(nbr->num_cells == 0) {
+    return 0;
+  }
+  return send_request(nbr, SIXP_CMD_DELETE, LINK_OPTION_TX, nbr->num_cells);
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_sixp_relocate_cell(const struct tsch_link *l)
+{
+  struct sixp_nbr *nbr;
+
+  if(l == NULL || l->slotframe_handle != TSCH_SIXP_SLOTFRAME_HANDLE
+     || (nbr = get_idle_nbr(tsch_schedule_get_link_addr(l))) == NULL) {
+    return 0;
+  }
+  nbr->relocated[0].timeslot = l->timeslot;
+  nbr->relocated[0].channel_offset = l->channel_offset;
+  nbr->num_relocated = 1;
+  nbr->num_cells = pick_candidates(nbr->cells, 2);
+  if(nbr->num_cells == 0) {
+    return 0;
+  }
+  return send_request(nbr, SIXP_CMD_RELOCATE, l->link_options, 1);
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_sixp_clear(const linkaddr_t *addr)
+{
+  struct sixp_nbr *nbr;
+
+  if(sf_sixp == NULL) {
+    return 0;
+  }
+  remove_cells(addr);
+  if((nbr = get_nbr(addr, 1)) == NULL) {
+    return 0;
+  }
+  ctimer_stop(&nbr->timer);
+  nbr->num_cells = 0;
+  nbr->num_relocated = 0;
+  return send_request(nbr, SIXP_CMD_CLEAR, 0, 0);
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_sixp_cell_count(const linkaddr_t *addr, uint8_t link_options)
+{
+  struct tsch_link *l;
+  int count = 0;
+
+  if(sf_sixp == NULL) {
+    return 0;
+  }
+  for(l = list_head(sf_sixp->links_list); l != NULL; l = list_item_next(l)) {
+    if((link_options == 0 || l->link_options == link_options)
+       && linkaddr_cmp(tsch_schedule_get_link_addr(l), addr)) {
+      count++;
+    }
+  }
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+/* Scheduling function: relocate the Tx cell to a neighbor with the lowest
+ * share of acked transmissions, if too low */
+static void
+sf_relocate(const linkaddr_t *addr)
+{
+#if TSCH_SCHEDULE_WITH_LINK_STATS
+  struct tsch_link *l;
+  struct tsch_link *worst = NULL;
+  uint16_t worst_pdr = TSCH_SIXP_SF_RELOCATE_PDR;
+
+  for(l = list_head(sf_sixp->links_list); l != NULL; l = list_item_next(l)) {
+    const struct tsch_link_stats *stats = tsch_schedule_get_link_stats(l);
+    if(l->link_options == LINK_OPTION_TX && linkaddr_cmp(tsch_schedule_get_link_addr(l), addr)
+       && stats != NULL && stats->tx_attempts >= TSCH_SIXP_SF_RELOCATE_MIN_TX) {
+      uint16_t pdr = (uint32_t)stats->tx_ok * 100 / stats->tx_attempts;
+      if(pdr < worst_pdr) {
+        worst = l;
+        worst_pdr = pdr;
+      }
+    }
+  }
+  if(worst != NULL) {
+    tsch_sixp_relocate_cell(worst);
+  }
+#endif /* TSCH_SCHEDULE_WITH_LINK_STATS */
+}
+/*---------------------------------------------------------------------------*/
+/* Scheduling function: match the Tx cells to a neighbor to the packets
+ * queued to it over the last period */
+static void
+sf_update(struct tsch_neighbor *n)
+{
+  struct sixp_nbr *nbr = get_nbr(&n->addr, 0);
+  uint16_t enqueued = n->stats.enqueued;
+  uint16_t load;
+  int cells;
+  int add_target;
+  int keep_target;
+
+  if(nbr == NULL) {
+    /* Start measuring once the neighbor has traffic */
+    if(enqueued > 0 && (nbr = get_nbr(&n->addr, 1)) != NULL) {
+      nbr->last_enqueued = enqueued;
+    }
+    return;
+  }
+  /* A decrease means the statistics were reset */
+  load = enqueued >= nbr->last_enqueued ? enqueued - nbr->last_enqueued : enqueued;
+  nbr->last_enqueued = enqueued;
+  if(nbr->state != SIXP_IDLE) {
+    return;
+  }
+
+  cells = tsch_sixp_cell_count(&n->addr, LINK_OPTION_TX);
+  /* Add for the load plus overprovisioning, delete once the load alone
+   * fits in fewer cells: the difference is our hysteresis */
+  add_target = (uint32_t)load * (100 + TSCH_SIXP_SF_OVERPROVISION) / (100 * (uint32_t)sf_cycles);
+  keep_target = (load + sf_cycles - 1) / sf_cycles;
+  if(add_target > cells) {
+    tsch_sixp_add_cells(&n->addr, add_target - cells);
+  } else if(keep_target < cells) {
+    tsch_sixp_delete_cells(&n->addr, cells - keep_target);
+  } else if(cells > 0) {
+    sf_relocate(&n->addr);
+  } else if(load == 0 && tsch_sixp_cell_count(&n->addr, 0) == 0) {
+    /* Nothing to negotiate with this neighbor anymore */
+    nbr->in_use = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+sf_run(void *ptr)
+{
+  struct tsch_neighbor *n;
+
+  ctimer_set(&sf_timer, TSCH_SIXP_SF_PERIOD, sf_run, NULL);
+  if(!associated || sf_sixp == NULL) {
+    return;
+  }
+  for(n = tsch_queue_first_nbr(); n != NULL; n = tsch_queue_next_nbr(n)) {
+    if(!n->is_broadcast) {
+      sf_update(n);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_sixp_reset(void)
+{
+  int i;
+  for(i = 0; i < TSCH_SIXP_MAX_NEIGHBORS; i++) {
+    if(sixp_nbrs[i].in_use) {
+      ctimer_stop(&sixp_nbrs[i].timer);
+      sixp_nbrs[i].in_use = 0;
+    }
+  }
+  if(sf_sixp != NULL) {
+    remove_cells(NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_sixp_init(void)
+{
+  sf_sixp = tsch_schedule_add_slotframe(TSCH_SIXP_SLOTFRAME_HANDLE, TSCH_SIXP_SLOTFRAME_SIZE);
+  if(sf_sixp == NULL) {
+    /* Out of slotframes, see TSCH_CONF_MAX_SLOTFRAMES: 6P stays off */
+    LOG("TSCH-sixp:! no slotframe for handle %u\n", TSCH_SIXP_SLOTFRAME_HANDLE);
+    return;
+  }
+  sf_cycles = TSCH_CLOCK_TO_SLOTS(TSCH_SIXP_SF_PERIOD) / TSCH_SIXP_SLOTFRAME_SIZE;
+  if(sf_cycles == 0) {
+    sf_cycles = 1;
+  }
+  ctimer_set(&sf_timer, TSCH_SIXP_SF_PERIOD, sf_run, NULL);
+}
+/*---------------------------------------------------------------------------*/
+
+#endif /* TSCH_WITH_SIXP */
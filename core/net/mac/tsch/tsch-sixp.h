@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         6P-style cell negotiation: neighbors add, delete and relocate
+ *         dedicated cells of a slotframe of their own through two-step
+ *         transactions, driven by a scheduling function that estimates
+ *         the bandwidth needed to each neighbor from its queue statistics.
+ *
+ *         The slotframe (TSCH_SIXP_SLOTFRAME_HANDLE) lives next to the
+ *         ones of Orchestra, whose cells carry the 6P messages. 6P
+ *         messages are unsecured data frames whose payload starts with a
+ *         6LoWPAN NALP dispatch, as the framer does not support IEs.
+ *
+ */
+
+#ifndef __TSCH_SIXP_H__
+#define __TSCH_SIXP_H__
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+#include "net/mac/tsch/tsch-private.h"
+#include "net/mac/tsch/tsch-queue.h"
+#include "net/mac/tsch/tsch-schedule.h"
+
+#if TSCH_WITH_SIXP
+
+#if !TSCH_QUEUE_WITH_STATS
+#error TSCH_CONF_WITH_SIXP requires TSCH_QUEUE_CONF_WITH_STATS
+#endif
+
+/* Handle of the slotframe of the negotiated cells, distinct from those
+ * of Orchestra */
+#ifdef TSCH_SIXP_CONF_SLOTFRAME_HANDLE
+#define TSCH_SIXP_SLOTFRAME_HANDLE TSCH_SIXP_CONF_SLOTFRAME_HANDLE
+#else
+#define TSCH_SIXP_SLOTFRAME_HANDLE 8
+#endif
+
+/* Length of the slotframe of the negotiated cells. A cell carries one
+ * packet per slotframe */
+#ifdef TSCH_SIXP_CONF_SLOTFRAME_SIZE
+#define TSCH_SIXP_SLOTFRAME_SIZE TSCH_SIXP_CONF_SLOTFRAME_SIZE
+#else
+#define TSCH_SIXP_SLOTFRAME_SIZE 101
+#endif
+
+/* Max number of cells negotiated with a neighbor, both directions */
+#ifdef TSCH_SIXP_CONF_MAX_CELLS
+#define TSCH_SIXP_MAX_CELLS TSCH_SIXP_CONF_MAX_CELLS
+#else
+#define TSCH_SIXP_MAX_CELLS 4
+#endif
+
+/* Number of neighbors we keep a 6P state for */
+#ifdef TSCH_SIXP_CONF_MAX_NEIGHBORS
+#define TSCH_SIXP_MAX_NEIGHBORS TSCH_SIXP_CONF_MAX_NEIGHBORS
+#else
+#define TSCH_SIXP_MAX_NEIGHBORS 4
+#endif
+
+/* A transaction is given up after this long without response */
+#ifdef TSCH_SIXP_CONF_TIMEOUT
+#define TSCH_SIXP_TIMEOUT TSCH_SIXP_CONF_TIMEOUT
+#else
+#define TSCH_SIXP_TIMEOUT (10 * CLOCK_SECOND)
+#endif
+
+/* Scheduling function: period of the bandwidth estimation */
+#ifdef TSCH_SIXP_CONF_SF_PERIOD
+#define TSCH_SIXP_SF_PERIOD TSCH_SIXP_CONF_SF_PERIOD
+#else
+#define TSCH_SIXP_SF_PERIOD (30 * CLOCK_SECOND)
+#endif
+
+/* Scheduling function: cells are added for the estimated load plus this
+ * percentage, and deleted once the load alone fits in fewer cells */
+#ifdef TSCH_SIXP_CONF_SF_OVERPROVISION
+#define TSCH_SIXP_SF_OVERPROVISION TSCH_SIXP_CONF_SF_OVERPROVISION
+#else
+#define TSCH_SIXP_SF_OVERPROVISION 50
+#endif
+
+/* Scheduling function: relocate a Tx cell whose share of acked
+ * transmissions is below this percentage, after at least
+ * TSCH_SIXP_SF_RELOCATE_MIN_TX attempts. Needs
+ * TSCH_SCHEDULE_CONF_WITH_LINK_STATS */
+#ifdef TSCH_SIXP_CONF_SF_RELOCATE_PDR
+#define TSCH_SIXP_SF_RELOCATE_PDR TSCH_SIXP_CONF_SF_RELOCATE_PDR
+#else
+#define TSCH_SIXP_SF_RELOCATE_PDR 50
+#endif
+
+#ifdef TSCH_SIXP_CONF_SF_RELOCATE_MIN_TX
+#define TSCH_SIXP_SF_RELOCATE_MIN_TX TSCH_SIXP_CONF_SF_RELOCATE_MIN_TX
+#else
+#define TSCH_SIXP_SF_RELOCATE_MIN_TX 16
+#endif
+
+/* Initialize 6P: add its slotframe and start the scheduling function */
+void tsch_sixp_init(void);
+/* Remove all negotiated cells and abort all transactions */
+void tsch_sixp_reset(void);
+/* Process the data frame in packetbuf, already parsed and unsecured.
+ * Returns 1 if it was a 6P message, 0 if it is for the upper layers */
+int tsch_sixp_input(void);
+/* Start a transaction to add num_cells Tx cells to a neighbor.
+ * Returns 1 if started, 0 if failure (e.g. a transaction is ongoing) */
+int tsch_sixp_add_cells(const linkaddr_t *addr, uint8_t num_cells);
+/* Start a transaction to delete num_cells Tx cells to a neighbor.
+ * Returns 1 if started, 0 if failure */
+int tsch_sixp_delete_cells(const linkaddr_t *addr, uint8_t num_cells);
+/* Start a transaction to move a negotiated Tx link to another cell.
+ * Returns 1 if started, 0 if failure */
+int tsch_sixp_relocate_cell(const struct tsch_link *l);
+/* Remove all cells negotiated with a neighbor, and tell it to do the same.
+ * Returns 1 if the neighbor was told, 0 if failure */
+int tsch_sixp_clear(const linkaddr_t *addr);
+/* Returns the number of negotiated cells with a neighbor with the given
+ * link options (0: any) */
+int tsch_sixp_cell_count(const linkaddr_t *addr, uint8_t link_options);
+
+#endif /* TSCH_WITH_SIXP */
+
+#endif /* __TSCH_SIXP_H__ */
@@ -51,7 +51,11 @@
 #include "net/mac/tsch/tsch-log.h"
 #include "net/mac/tsch/tsch-packet.h"
 #include "net/mac/tsch/tsch-schedule.h"
+#include "net/mac/tsch/tsch-adaptive-timesync.h"
+#include "net/mac/tsch/tsch-link-estimator.h"
+#include "net/mac/tsch/tsch-sixp.h"
 #include "net/mac/frame802154.h"
+#include "net/llsec/llsec802154.h"
 #include "lib/random.h"
 #include "lib/ringbufindex.h"
 #include "sys/process.h"
@@ -64,6 +68,8 @@
 /* TODO: move platform-specific code away from core */
 #if CONTIKI_TARGET_JN5168
 #include "dev/micromac-radio.h"
+#elif CONTIKI_TARGET_NATIVE
+#include "dev/sim-radio.h"
 #else
 #include "dev/cc2420/cc2420.h"
 #endif
@@ -77,9 +83,31 @@
 #define DEBUG_INJECT_DRIFT 0
 
 #ifdef TSCH_CALLBACK_DO_NACK
+/* Called from the Rx link before ACKing a frame. Returns 1 to NACK it */
 int TSCH_CALLBACK_DO_NACK(struct tsch_link *link, linkaddr_t *src, linkaddr_t *dst);
 #endif
 
+#ifdef TSCH_CALLBACK_NACK_RECEIVED
+/* Called from process context, for every packet NACKed */
+void TSCH_CALLBACK_NACK_RECEIVED(const linkaddr_t *dest, uint16_t link_handle);
+#endif
+
+#ifdef TSCH_CALLBACK_ACK_HINTS
+/* Called from the Rx link before ACKing a frame. Returns TSCH_ACK_HINT_* flags */
+uint8_t TSCH_CALLBACK_ACK_HINTS(struct tsch_link *link, linkaddr_t *src);
+#endif
+
+#ifdef TSCH_CALLBACK_ACK_HINTS_RECEIVED
+/* Called from process context, for every packet acked with hints */
+void TSCH_CALLBACK_ACK_HINTS_RECEIVED(const linkaddr_t *dest, const struct tsch_ack_hints *hints);
+#endif
+
+#ifdef TSCH_CALLBACK_EB_RPL_INFO_RECEIVED
+/* Called from process context, for every EB of our network that
+ * announces the RPL state of its sender */
+void TSCH_CALLBACK_EB_RPL_INFO_RECEIVED(const linkaddr_t *src, const struct tsch_eb_rpl_info *rpl_info);
+#endif
+
 #ifdef TSCH_CALLBACK_JOINING_NETWORK
 void TSCH_CALLBACK_JOINING_NETWORK();
 #endif
@@ -104,6 +132,7 @@ void TSCH_CALLBACK_LEAVING_NETWORK();
 #define DEBUG DEBUG_NONE
 #include "net/ip/uip-debug.h"
 
+/* Max number of channels used from TSCH_DEFAULT_HOPPING_SEQUENCE */
 #ifdef TSCH_CONF_N_CHANNELS
 #define TSCH_N_CHANNELS TSCH_CONF_N_CHANNELS
 #else
@@ -131,16 +160,21 @@ void TSCH_CALLBACK_LEAVING_NETWORK();
 #endif /* TSCH_802154_AUTOACK */
 
 #if TSCH_802154_DUPLICATE_DETECTION
-struct seqno {
-  linkaddr_t sender;
-  uint8_t seqno;
+/* Number of last sequence numbers kept per sender. Retransmissions are
+ * of the head of a queue, a frame of another traffic class at most
+ * can come in between */
+#ifdef TSCH_CONF_SEQNO_HISTORY
+#define TSCH_SEQNO_HISTORY TSCH_CONF_SEQNO_HISTORY
+#else /* TSCH_CONF_SEQNO_HISTORY */
+#define TSCH_SEQNO_HISTORY 2
+#endif /* TSCH_CONF_SEQNO_HISTORY */
+
+/* Last sequence numbers received from a neighbor, most recent first */
+struct seqno_history {
+  uint8_t seqnos[TSCH_SEQNO_HISTORY];
+  uint8_t count;
 };
-
-#ifdef NETSTACK_CONF_MAC_SEQNO_HISTORY
-#define MAX_SEQNOS NETSTACK_CONF_MAC_SEQNO_HISTORY
-#else /* NETSTACK_CONF_MAC_SEQNO_HISTORY */
-#define MAX_SEQNOS 8
-#endif /* NETSTACK_CONF_MAC_SEQNO_HISTORY */
+NBR_TABLE(struct seqno_history, received_seqnos);
 
 #if TSCH_EB_AUTOSELECT
 int best_neighbor_eb_count;
@@ -150,15 +184,40 @@ struct eb_stat {
 };
 NBR_TABLE(struct eb_stat, eb_stats);
 #endif
-
-static struct seqno received_seqnos[MAX_SEQNOS];
 #endif /* TSCH_802154_DUPLICATE_DETECTION */
 
-// TODO use the standard hopping sequence
-/* Channel hopping: a list of channels (ordered by measured goodness from a specific testbed experiment in Indriya) */
-uint8_t hopping_sequence_list[] = { 26, 15, 25, 20, 16, 19, 14, 24, 18, 17, 17, 11, 21, 23, 12, 22, 13 };
-//uint8_t hopping_sequence_list[] = { 23, 12, 22, 13 };
+/* Channel hopping: the sequence in use, set from TSCH_DEFAULT_HOPPING_SEQUENCE
+ * or tsch_set_hopping_sequence() */
+uint8_t hopping_sequence_list[TSCH_HOPPING_SEQUENCE_MAX_LEN];
 struct asn_divisor_t hopping_sequence_length;
+#define DEFAULT_HOPPING_SEQUENCE_LEN \
+  MIN(MIN(sizeof(TSCH_DEFAULT_HOPPING_SEQUENCE), TSCH_N_CHANNELS), TSCH_HOPPING_SEQUENCE_MAX_LEN)
+/* At file scope, so that the compound literal has static storage */
+static const uint8_t *const default_hopping_sequence = TSCH_DEFAULT_HOPPING_SEQUENCE;
+/* Index in the hopping sequence of the last Rx/Tx link, updated
+ * incrementally by the link operation */
+static struct asn_cursor_t hopping_cursor;
+/* The scheduled hopping sequence change */
+struct tsch_hopping_sequence_change tsch_next_hopping_sequence;
+/* Set from the link operation when it applied the scheduled change */
+static volatile uint8_t hopping_sequence_changed;
+/* The scheduled minimal schedule change */
+struct tsch_minimal_change tsch_next_minimal_change;
+/* Set from the link operation to the number of cells of the minimal
+ * schedule change that is due, for the pending events process to apply it */
+static volatile uint8_t minimal_change_due;
+
+#if TSCH_WITH_CHANNEL_STATS
+static struct tsch_channel_stats channel_stats[16];
+/* Increments a counter of the current channel */
+#define CHANNEL_STATS_INC(field) do { \
+    if(current_channel >= 11 && current_channel <= 26) { \
+      channel_stats[current_channel - 11].field++; \
+    } \
+  } while(0)
+#else /* TSCH_WITH_CHANNEL_STATS */
+#define CHANNEL_STATS_INC(field)
+#endif /* TSCH_WITH_CHANNEL_STATS */
 
 /* 802.15.4 broadcast MAC address  */
 const linkaddr_t tsch_broadcast_address = { { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff } };
@@ -171,6 +230,15 @@ int tsch_is_coordinator = 0;
 
 /* The current radio channel */
 static uint8_t current_channel = -1;
+/* Timeslot template */
+#define TIMESLOT_TIMING_DEFAULT { \
+    US_TO_RTIMERTICKS(TSCH_DEFAULT_TS_CCA_OFFSET), \
+    US_TO_RTIMERTICKS(TSCH_DEFAULT_TS_CCA), \
+    US_TO_RTIMERTICKS(TSCH_DEFAULT_TS_TX_OFFSET), \
+    US_TO_RTIMERTICKS(TSCH_DEFAULT_TS_TX_ACK_DELAY), \
+    US_TO_RTIMERTICKS(TSCH_DEFAULT_TS_TIMESLOT_LENGTH) }
+const struct tsch_timeslot_timing tsch_default_timing = TIMESLOT_TIMING_DEFAULT;
+struct tsch_timeslot_timing tsch_timing = TIMESLOT_TIMING_DEFAULT;
 /* The current Absolute Slot Number (ASN) */
 struct asn_t current_asn;
 /* Last time we received Sync-IE (ACK or data packet from a time source) */
@@ -188,6 +256,21 @@ uint8_t tsch_join_priority;
 static uint8_t tsch_packet_seqno = 0;
 /* Current period for EB output */
 static clock_time_t tsch_current_eb_period;
+/* EB period set at runtime, overriding the current one when not 0 */
+static clock_time_t tsch_fixed_eb_period;
+#define EB_PERIOD() (tsch_fixed_eb_period != 0 ? tsch_fixed_eb_period : tsch_current_eb_period)
+/* Keepalive timeout, TSCH_KEEPALIVE_TIMEOUT unless set at runtime */
+static clock_time_t tsch_keepalive_timeout = TSCH_KEEPALIVE_TIMEOUT;
+#if TSCH_ADAPTIVE_EB_PERIOD
+/* EBs heard in the current window, and running average over past windows */
+static uint16_t adaptive_eb_heard;
+static uint16_t adaptive_eb_heard_avg;
+static clock_time_t adaptive_eb_window_start;
+/* Windows left at TSCH_MIN_EB_PERIOD */
+static uint8_t adaptive_eb_boost;
+/* Set to have the EB process reschedule the next EB within the new period */
+static uint8_t adaptive_eb_restart;
+#endif /* TSCH_ADAPTIVE_EB_PERIOD */
 
 /* timer for sending keepalive messages */
 static struct ctimer keepalive_timer;
@@ -212,10 +295,29 @@ static struct tsch_packet *dequeued_array[DEQUEUED_ARRAY_SIZE];
 #endif
 #if (TSCH_MAX_INCOMING_PACKETS & (TSCH_MAX_INCOMING_PACKETS-1)) != 0
 #error TSCH_MAX_INCOMING_PACKETS must be power of two
+#endif
+
+/* Hand incoming packets to the upper layers without copying them to the
+ * packetbuf: the packetbuf references the ringbuf entry, which is released
+ * only once the upper layers are done with it */
+#ifdef TSCH_CONF_RX_ZERO_COPY
+#define TSCH_RX_ZERO_COPY TSCH_CONF_RX_ZERO_COPY
+#else
+#define TSCH_RX_ZERO_COPY 0
+#endif
+
+/* Reuse the 802.15.4 header parsed in the Rx timeslot when passing data
+ * frames to the upper layers, rather than running the framer again.
+ * Secured frames always go through the framer. */
+#ifdef TSCH_CONF_RX_REUSE_HEADER
+#define TSCH_RX_REUSE_HEADER TSCH_CONF_RX_REUSE_HEADER
+#else
+#define TSCH_RX_REUSE_HEADER 1
 #endif
 
  struct input_packet {
    uint8_t payload[TSCH_MAX_PACKET_LEN];
+   struct tsch_packet_header hdr;
    struct asn_t rx_asn;
    int len;
    uint16_t rssi;
@@ -224,6 +326,7 @@ static struct tsch_packet *dequeued_array[DEQUEUED_ARRAY_SIZE];
 static struct input_packet input_eb;
 struct ringbufindex input_ringbuf;
 struct input_packet input_array[TSCH_MAX_INCOMING_PACKETS];
+static struct tsch_rx_ring_stats rx_ring_stats;
 
 /* Last estimated drift in RTIMER ticks
  * (Sky: 1 tick ~= 30.52 uSec) */
@@ -242,6 +345,18 @@ static rtimer_clock_t tsch_time_until_next_active_link = 0;
 struct tsch_link *current_link;
 static struct tsch_packet *current_packet;
 static struct tsch_neighbor *current_neighbor;
+#if TSCH_BURST_MAX_LEN > 0
+/* Roles in a burst */
+enum { BURST_NONE, BURST_TX, BURST_RX };
+/* Role to keep in the next timeslot, as decided during link operation */
+static uint8_t burst_link_scheduled;
+/* Role in the burst for the current link operation */
+static uint8_t burst_role;
+/* Number of timeslots the current burst was extended by */
+static uint8_t burst_count;
+/* Does the frame being transmitted have its frame pending bit set? */
+static uint8_t burst_pending;
+#endif /* TSCH_BURST_MAX_LEN > 0 */
 
 /* Protothread for link operation, called from rtimer interrupt
  * and scheduled from tsch_schedule_link_operation */
@@ -263,9 +378,189 @@ static void tsch_reset(void);
 static void tsch_tx_process_pending();
 static void tsch_rx_process_pending();
 static void tsch_schedule_keepalive();
+static void keepalive_send();
+
+/* Cost of the last association */
+static struct tsch_association_stats association_stats;
+/* Association scan: radio-on time in each channel dwell */
+#define ASSOCIATION_LISTEN_DURATION ((clock_time_t)((TSCH_ASSOCIATION_CHANNEL_DWELL * 1UL * TSCH_ASSOCIATION_DUTY_CYCLE) / 100))
 
 /* Debug timing */
 static rtimer_clock_t t0prepare = 0, t0tx = 0, t0txack = 0, t0post_tx = 0, t0rx = 0, t0rxack = 0;
+static const char *slot_phase_names[TSCH_SLOT_PHASE_COUNT] = {
+  "prepare", "tx", "tx_ack", "post_tx", "rx", "rx_ack"
+};
+
+#if TSCH_WITH_DL_MISS_STATS
+static struct tsch_dl_miss_stats dl_miss_stats;
+/* Ring of the last deadline misses: next entry to write, number of entries */
+static struct tsch_dl_miss dl_miss_log[TSCH_DL_MISS_LOG_LEN];
+static uint8_t dl_miss_log_head, dl_miss_log_count;
+/* Phase of link operation in progress, or last run */
+static uint8_t dl_miss_phase = TSCH_SLOT_PHASE_COUNT;
+/* Set while scheduling the next link rather than a wait within a link */
+static uint8_t dl_miss_next_link;
+#define DL_MISS_PHASE(phase) (dl_miss_phase = (phase))
+#else
+#define DL_MISS_PHASE(phase)
+#endif /* TSCH_WITH_DL_MISS_STATS */
+
+#if TSCH_RX_EARLY_REJECT
+static struct tsch_rx_early_reject_stats rx_early_reject_stats;
+#endif /* TSCH_RX_EARLY_REJECT */
+
+#if TSCH_WITH_ENERGEST
+static struct tsch_energest_stats energest_stats;
+/* Radio-on time of the link operation in progress */
+static struct tsch_energest energest_link;
+/* Start, then duration, of the last listen period */
+static rtimer_clock_t energest_listen;
+#define TSCH_ENERGEST_TX(duration) (energest_link.tx += (duration))
+#define TSCH_ENERGEST_LISTEN_START(t) (energest_listen = (t))
+#define TSCH_ENERGEST_LISTEN_END() (energest_listen = RTIMER_NOW() - energest_listen)
+/* Account for the last listen period, once we know whether we got a frame */
+#define TSCH_ENERGEST_LISTEN_ADD(idle) do { \
+    if(idle) { \
+      energest_link.rx_idle += energest_listen; \
+    } else { \
+      energest_link.rx += energest_listen; \
+    } \
+  } while(0)
+/* Scan time is measured in clock ticks */
+#define TSCH_ENERGEST_SCAN(duration) \
+  (energest_stats.scan += (uint32_t)(duration) * RTIMER_SECOND / CLOCK_SECOND)
+#else
+#define TSCH_ENERGEST_TX(duration)
+#define TSCH_ENERGEST_LISTEN_START(t)
+#define TSCH_ENERGEST_LISTEN_END()
+#define TSCH_ENERGEST_LISTEN_ADD(idle)
+#define TSCH_ENERGEST_SCAN(duration)
+#endif /* TSCH_WITH_ENERGEST */
+
+#if TSCH_WITH_CPU_TIME
+/* Time spent in tsch_link_operation, in rtimer ticks */
+static uint32_t link_operation_cpu_time;
+/* Run the link operation until it yields, and account for its time */
+static void
+tsch_link_operation_timed(struct rtimer *t, void *ptr)
+{
+  rtimer_clock_t start = RTIMER_NOW();
+  tsch_link_operation(t, ptr);
+  link_operation_cpu_time += (rtimer_clock_t)(RTIMER_NOW() - start);
+}
+#define TSCH_LINK_OPERATION tsch_link_operation_timed
+#else
+#define TSCH_LINK_OPERATION tsch_link_operation
+#endif /* TSCH_WITH_CPU_TIME */
+
+#if TSCH_WITH_SLOT_PROFILER
+/* Bitmaps of the phases started and completed in the current link operation */
+static uint8_t t0_started, t0_measured;
+/* Profile of the window in progress and of the last complete one */
+static struct tsch_slot_profile slot_profile[TSCH_SLOT_PHASE_COUNT];
+static struct tsch_slot_profile slot_profile_last[TSCH_SLOT_PHASE_COUNT];
+static uint16_t slot_profile_ops;
+static uint8_t slot_profile_last_valid;
+#define SLOT_PROFILE_BUCKET_WIDTH ((rtimer_clock_t)US_TO_RTIMERTICKS(TSCH_SLOT_PROFILER_BUCKET_US))
+/* Start and end of a timed phase: at the end, var holds its duration.
+ * Only phases that were started in this link operation are recorded */
+#define SLOT_PROFILE_START(var, phase) do { \
+    (var) = RTIMER_NOW(); \
+    t0_started |= 1 << (phase); \
+    DL_MISS_PHASE(phase); \
+  } while(0)
+#define SLOT_PROFILE_END(var, phase) do { \
+    (var) = RTIMER_NOW() - (var); \
+    t0_measured |= t0_started & (1 << (phase)); \
+  } while(0)
+#else
+#define SLOT_PROFILE_START(var, phase) do { (var) = RTIMER_NOW(); DL_MISS_PHASE(phase); } while(0)
+#define SLOT_PROFILE_END(var, phase) do { (var) = RTIMER_NOW() - (var); } while(0)
+#endif /* TSCH_WITH_SLOT_PROFILER */
+
+#if TSCH_WITH_SLOT_PROFILER
+/* Add a phase duration to the window in progress */
+static void
+slot_profile_add(struct tsch_slot_profile *p, rtimer_clock_t duration)
+{
+  rtimer_clock_t bucket = duration / SLOT_PROFILE_BUCKET_WIDTH;
+  if(p->count == 0 || duration < p->min) {
+    p->min = duration;
+  }
+  if(p->count == 0 || duration > p->max) {
+    p->max = duration;
+  }
+  p->count++;
+  p->sum += duration;
+  p->hist[MIN(bucket, TSCH_SLOT_PROFILER_BUCKETS - 1)]++;
+}
+/* Called from interrupt once a link operation is over: record the phases it
+ * completed, and roll the window when full */
+static void
+slot_profile_end_of_link(void)
+{
+  if(t0_measured != 0) {
+    rtimer_clock_t durations[TSCH_SLOT_PHASE_COUNT];
+    int i;
+    durations[TSCH_SLOT_PHASE_PREPARE] = t0prepare;
+    durations[TSCH_SLOT_PHASE_TX] = t0tx;
+    durations[TSCH_SLOT_PHASE_TX_ACK] = t0txack;
+    durations[TSCH_SLOT_PHASE_POST_TX] = t0post_tx;
+    durations[TSCH_SLOT_PHASE_RX] = t0rx;
+    durations[TSCH_SLOT_PHASE_RX_ACK] = t0rxack;
+    for(i = 0; i < TSCH_SLOT_PHASE_COUNT; i++) {
+      if(t0_measured & (1 << i)) {
+        slot_profile_add(&slot_profile[i], durations[i]);
+      }
+    }
+    if(++slot_profile_ops >= TSCH_SLOT_PROFILER_WINDOW) {
+      memcpy(slot_profile_last, slot_profile, sizeof(slot_profile));
+      memset(slot_profile, 0, sizeof(slot_profile));
+      slot_profile_ops = 0;
+      slot_profile_last_valid = 1;
+    }
+  }
+  t0_started = 0;
+  t0_measured = 0;
+}
+#endif /* TSCH_WITH_SLOT_PROFILER */
+
+#if TSCH_WITH_ENERGEST
+static void
+energest_add(struct tsch_energest *to, const struct tsch_energest *e)
+{
+  to->tx += e->tx;
+  to->rx += e->rx;
+  to->rx_idle += e->rx_idle;
+}
+/* Called from interrupt once a link operation is over: add its radio-on
+ * time to the counters of its link type and slotframe */
+static void
+energest_end_of_link(void)
+{
+  if(current_link != NULL
+      && (energest_link.tx != 0 || energest_link.rx != 0 || energest_link.rx_idle != 0)) {
+    int i;
+    energest_add(&energest_stats.per_link_type[current_link->link_type], &energest_link);
+    if(current_link->link_options & LINK_OPTION_SHARED) {
+      energest_add(&energest_stats.shared, &energest_link);
+    }
+    for(i = 0; i < TSCH_ENERGEST_MAX_SLOTFRAMES; i++) {
+      struct tsch_energest *e = &energest_stats.per_slotframe[i].e;
+      if((e->tx == 0 && e->rx == 0 && e->rx_idle == 0)
+          || energest_stats.per_slotframe[i].handle == current_link->slotframe_handle) {
+        energest_stats.per_slotframe[i].handle = current_link->slotframe_handle;
+        energest_add(e, &energest_link);
+        break;
+      }
+    }
+    if(i == TSCH_ENERGEST_MAX_SLOTFRAMES) {
+      energest_add(&energest_stats.other_slotframes, &energest_link);
+    }
+  }
+  memset(&energest_link, 0, sizeof(energest_link));
+}
+#endif /* TSCH_WITH_ENERGEST */
 
 /* A global lock for manipulating data structures safely from outside of interrupt */
 static volatile int tsch_locked = 0;
@@ -288,7 +583,12 @@ int tsch_get_lock() {
     if(tsch_in_link_operation) {
       busy_wait = 1;
       busy_wait_time = RTIMER_NOW();
-      while(tsch_in_link_operation);
+      while(tsch_in_link_operation) {
+#if NATIVE_CONF_SIM
+        /* In simulation, the link operation only runs as time advances */
+        RTIMER_NOW();
+#endif /* NATIVE_CONF_SIM */
+      }
       busy_wait_time = RTIMER_NOW() - busy_wait_time;
     }
     if(!tsch_locked) {
@@ -297,18 +597,13 @@ int tsch_get_lock() {
       tsch_lock_requested = 0;
       if(busy_wait) {
         /* Issue a log whenever we had to busy wait until getting the lock */
-        TSCH_LOG_ADD(tsch_log_message,
-            snprintf(log->message, sizeof(log->message),
-                "!get lock delay %u", busy_wait_time);
-        );
+        TSCH_LOG_MESSAGE("!get lock delay %u",
+            busy_wait_time, 0, 0, 0);
       }
       return 1;
     }
   }
-  TSCH_LOG_ADD(tsch_log_message,
-      snprintf(log->message, sizeof(log->message),
-                      "!failed to lock");
-          );
+  TSCH_LOG_MESSAGE("!failed to lock", 0, 0, 0, 0);
   return 0;
 }
 
@@ -317,6 +612,22 @@ void tsch_release_lock() {
   tsch_locked = 0;
 }
 
+/* Pass a packet removed from its queue with the lock held to the pending
+ * events process. The link operation, the only other producer of
+ * dequeued_ringbuf, is not running */
+int
+tsch_dequeued_packet_add(struct tsch_packet *p)
+{
+  int16_t dequeued_index = ringbufindex_peek_put(&dequeued_ringbuf);
+  if(tsch_is_locked() && dequeued_index != -1) {
+    dequeued_array[dequeued_index] = p;
+    ringbufindex_put(&dequeued_ringbuf);
+    process_poll(&tsch_pending_events_process);
+    return 1;
+  }
+  return 0;
+}
+
 /*---------------------------------------------------------------------------*/
 static void
 on(void)
@@ -359,6 +670,108 @@ check_timer_miss(rtimer_clock_t ref_time, rtimer_clock_t offset, rtimer_clock_t
     return now_has_overflowed;
   }
 }
+#if TSCH_WITH_DL_MISS_STATS
+/* Account for a missed deadline of the current link, called from interrupt */
+static void
+dl_miss_record(rtimer_clock_t late)
+{
+  struct tsch_dl_miss *m = &dl_miss_log[dl_miss_log_head];
+
+  dl_miss_stats.total++;
+  if(dl_miss_next_link) {
+    dl_miss_stats.skipped++;
+  }
+  dl_miss_stats.per_phase[dl_miss_phase]++;
+  if(current_link != NULL) {
+    int i;
+    dl_miss_stats.per_link_type[current_link->link_type]++;
+    for(i = 0; i < TSCH_DL_MISS_MAX_SLOTFRAMES; i++) {
+      if(dl_miss_stats.per_slotframe[i].count == 0
+          || dl_miss_stats.per_slotframe[i].handle == current_link->slotframe_handle) {
+        dl_miss_stats.per_slotframe[i].handle = current_link->slotframe_handle;
+        dl_miss_stats.per_slotframe[i].count++;
+        break;
+      }
+    }
+    if(i == TSCH_DL_MISS_MAX_SLOTFRAMES) {
+      dl_miss_stats.other_slotframes++;
+    }
+  } else {
+    dl_miss_stats.per_link_type[3]++;
+  }
+
+  /* Log the miss in the ring */
+  m->asn = current_asn;
+  m->slotframe_handle = current_link != NULL ? current_link->slotframe_handle : 0xffff;
+  m->timeslot = current_link != NULL ? current_link->timeslot : 0xffff;
+  m->link_type = current_link != NULL ? current_link->link_type : 0xff;
+  m->phase = dl_miss_phase;
+  m->skipped = dl_miss_next_link;
+  m->late = late;
+  dl_miss_log_head = (dl_miss_log_head + 1) % TSCH_DL_MISS_LOG_LEN;
+  if(dl_miss_log_count < TSCH_DL_MISS_LOG_LEN) {
+    dl_miss_log_count++;
+  }
+}
+#endif /* TSCH_WITH_DL_MISS_STATS */
+#if TSCH_ADAPTIVE_GUARD_TIME
+/* Drift estimator for the current time source */
+static struct {
+  const struct tsch_neighbor *time_source;
+  /* Estimate of |drift| in rtimer ticks per 1024 timeslots.
+   * Follows increases immediately and decreases slowly */
+  uint32_t drift_rate;
+  uint8_t samples;
+} guard_estimator;
+/* Rx guard time of the current link operation */
+static rtimer_clock_t rx_guard_time;
+#define RX_GUARD_TIME rx_guard_time
+
+/* Account for a drift measured with the time source n. Must be called before
+ * updating last_sync_asn */
+static void
+guard_time_update(const struct tsch_neighbor *n, int32_t drift)
+{
+  uint32_t slots = ASN_DIFF(current_asn, last_sync_asn);
+  uint32_t rate;
+
+  if(n != guard_estimator.time_source) {
+    /* New time source, start over */
+    guard_estimator.time_source = n;
+    guard_estimator.samples = 0;
+  }
+  if(slots == 0) {
+    return;
+  }
+  rate = ((uint32_t)(drift < 0 ? -drift : drift) << 10) / slots;
+  if(guard_estimator.samples == 0 || rate > guard_estimator.drift_rate) {
+    guard_estimator.drift_rate = rate;
+  } else {
+    guard_estimator.drift_rate -= (guard_estimator.drift_rate - rate) >> 3;
+  }
+  if(guard_estimator.samples < 0xff) {
+    guard_estimator.samples++;
+  }
+}
+/* Returns the Rx guard time for the current timeslot */
+static rtimer_clock_t
+guard_time_get(void)
+{
+  uint32_t guard;
+
+  if(tsch_is_coordinator
+      || guard_estimator.samples < TSCH_ADAPTIVE_GUARD_MIN_SAMPLES
+      || guard_estimator.time_source != tsch_queue_get_time_source()) {
+    return TsLongGT;
+  }
+  /* Twice the drift expected since the last sync, plus a fixed margin */
+  guard = US_TO_RTIMERTICKS(TSCH_ADAPTIVE_GUARD_MARGIN)
+      + ((2 * guard_estimator.drift_rate * ASN_DIFF(current_asn, last_sync_asn)) >> 10);
+  return MIN(guard, TsLongGT);
+}
+#else /* TSCH_ADAPTIVE_GUARD_TIME */
+#define RX_GUARD_TIME TsLongGT
+#endif /* TSCH_ADAPTIVE_GUARD_TIME */
 /* Wait for a condition with timeout t0+offset. */
 #define BUSYWAIT_UNTIL_ABS(cond, t0, offset) \
   do { \
@@ -381,19 +794,20 @@ tsch_schedule_link_operation(struct rtimer *tm, rtimer_clock_t ref_time, rtimer_
   int missed = check_timer_miss(ref_time, offset, now);
 
   if(missed) {
-    TSCH_LOG_ADD(tsch_log_message,
-                snprintf(log->message, sizeof(log->message),
-                    "!dl-miss-%d %d %d",
-                        conditional,
-                        (int)(now - ref_time), (int)offset);
-    );
+    TSCH_LOG_MESSAGE("!dl-miss-%d %d %d",
+        conditional, (int)(now - ref_time), (int)offset, 0);
+#if TSCH_WITH_DL_MISS_STATS
+    dl_miss_record((rtimer_clock_t)(now - ref_time) > offset ? (now - ref_time) - offset : 0);
+#endif /* TSCH_WITH_DL_MISS_STATS */
 
     if(conditional) {
       return 0;
     }
   }
   ref_time += offset;
-  r = rtimer_set(tm, ref_time, 1, (void (*)(struct rtimer *, void *))tsch_link_operation, NULL /*(void*)&status*/);
+  /* Tasks of other rtimer users never make us late */
+  RTIMER_SET_PRIORITY(tm, RTIMER_PRIORITY_HIGH);
+  r = rtimer_set(tm, ref_time, 1, (void (*)(struct rtimer *, void *))TSCH_LINK_OPERATION, NULL /*(void*)&status*/);
   if(r != RTIMER_OK) {
     return 0;
   }
@@ -407,6 +821,59 @@ tsch_schedule_link_operation(struct rtimer *tm, rtimer_clock_t ref_time, rtimer_
     } \
   } while(0);
 
+#if TSCH_HW_TIMED_RADIO
+/* Wake up a little ahead of the start time and let the radio start on time */
+#define TX_WAKEUP_LEAD (delayTx + US_TO_RTIMERTICKS(TSCH_HW_TIMED_RADIO_MARGIN))
+#define RX_WAKEUP_LEAD (delayRx + US_TO_RTIMERTICKS(TSCH_HW_TIMED_RADIO_MARGIN))
+/* Transmit the frame in the radio buffer, starting at time t */
+static int
+radio_transmit_at(unsigned short len, rtimer_clock_t t)
+{
+  if(NETSTACK_RADIO.set_object(RADIO_PARAM_TX_START_TIME, &t, sizeof(t))
+     != RADIO_RESULT_OK) {
+    while(RTIMER_CLOCK_LT(RTIMER_NOW(), t - delayTx)) ;
+  }
+  return NETSTACK_RADIO.transmit(len);
+}
+/* Start listening at time t */
+static void
+radio_on_at(rtimer_clock_t t)
+{
+  struct radio_rx_window window;
+
+  window.start = t;
+  window.duration = 0;
+  if(NETSTACK_RADIO.set_object(RADIO_PARAM_RX_WINDOW, &window, sizeof(window))
+     != RADIO_RESULT_OK) {
+    while(RTIMER_CLOCK_LT(RTIMER_NOW(), t - delayRx)) ;
+    on();
+  }
+}
+/* Transmit an ACK at time t, in no-wait mode if the radio has it.
+ * Returns 1 if the radio completes the ACK on its own */
+static int
+radio_transmit_ack_at(unsigned short len, rtimer_clock_t t)
+{
+  radio_value_t mode;
+
+  if(NETSTACK_RADIO.get_value(RADIO_PARAM_TX_MODE, &mode) == RADIO_RESULT_OK
+     && NETSTACK_RADIO.set_value(RADIO_PARAM_TX_MODE, mode | RADIO_TX_MODE_NO_WAIT)
+        == RADIO_RESULT_OK) {
+    radio_transmit_at(len, t);
+    NETSTACK_RADIO.set_value(RADIO_PARAM_TX_MODE, mode);
+    return 1;
+  }
+  radio_transmit_at(len, t);
+  return 0;
+}
+#else /* TSCH_HW_TIMED_RADIO */
+#define TX_WAKEUP_LEAD delayTx
+#define RX_WAKEUP_LEAD delayRx
+#define radio_transmit_at(len, t) NETSTACK_RADIO.transmit(len)
+#define radio_on_at(t) on()
+#define radio_transmit_ack_at(len, t) (NETSTACK_RADIO.transmit(len), 0)
+#endif /* TSCH_HW_TIMED_RADIO */
+
 /*
  * Channel hopping
  */
@@ -419,12 +886,67 @@ tsch_calculate_channel(struct asn_t *asn, uint8_t channel_offset)
   uint16_t index_of_offset = (index_of_0 + channel_offset) % hopping_sequence_length.val;
   return hopping_sequence_list[index_of_offset];
 }
+/* Returns x % val, by subtractions if x is less than 16 times val */
+uint16_t
+tsch_mod16(uint32_t x, uint16_t val)
+{
+  if(x < ((uint32_t)val << 4)) {
+    while(x >= val) {
+      x -= val;
+    }
+    return x;
+  }
+  return x % val;
+}
+/* Returns asn % div, and moves the cursor to asn */
+uint16_t
+tsch_asn_cursor_mod(struct asn_cursor_t *c, const struct asn_t *asn,
+                    const struct asn_divisor_t *div)
+{
+  uint32_t diff = ASN_DIFF(*asn, c->asn);
+  if(c->valid && asn->ms1b == c->asn.ms1b
+      && asn->ls4b >= c->asn.ls4b && diff <= 0xffff) {
+    c->mod = tsch_mod16(c->mod + diff, div->val);
+  } else {
+    c->mod = ASN_MOD(*asn, *div);
+    c->valid = 1;
+  }
+  c->asn = *asn;
+  return c->mod;
+}
+/* Index of an ASN in the hopping sequence. The ASN only moves forward by a
+ * few slots between links, so we move the index of the last one forward
+ * and do the full 40-bit modulo only after a jump (association, ASN correction) */
+static uint16_t
+hopping_sequence_index(struct asn_t *asn)
+{
+  if(tsch_next_hopping_sequence.len != 0
+      && (int32_t)ASN_DIFF(*asn, tsch_next_hopping_sequence.asn) >= 0) {
+    /* Time for the scheduled change */
+    memcpy(hopping_sequence_list, tsch_next_hopping_sequence.channels, tsch_next_hopping_sequence.len);
+    ASN_DIVISOR_INIT(hopping_sequence_length, tsch_next_hopping_sequence.len);
+    tsch_next_hopping_sequence.len = 0;
+    ASN_CURSOR_RESET(hopping_cursor);
+    /* Let the pending events process update the EB */
+    hopping_sequence_changed = 1;
+    process_poll(&tsch_pending_events_process);
+  }
+  if(tsch_next_minimal_change.num_cells != 0
+      && (int32_t)ASN_DIFF(*asn, tsch_next_minimal_change.asn) >= 0) {
+    /* Time to rebuild the minimal schedule, from process context */
+    minimal_change_due = tsch_next_minimal_change.num_cells;
+    tsch_next_minimal_change.num_cells = 0;
+    process_poll(&tsch_pending_events_process);
+  }
+  return tsch_asn_cursor_mod(&hopping_cursor, asn, &hopping_sequence_length);
+}
 /* Select the current channel from ASN and channel offset, hop to it */
 static void
 hop_channel(struct asn_t *asn, uint8_t offset)
 {
   current_channel = -1;
-  uint8_t channel = tsch_calculate_channel(asn, offset);
+  uint8_t channel = hopping_sequence_list[tsch_mod16(hopping_sequence_index(asn) + offset,
+                                                     hopping_sequence_length.val)];
   if(current_channel != channel) {
     NETSTACK_RADIO_set_channel(channel);
     current_channel = channel;
@@ -467,7 +989,16 @@ send_packet(mac_callback_t sent, void *ptr)
 
   packet_count_before = tsch_queue_packet_count(addr);
 
+#if LLSEC802154_SECURITY_LEVEL
+  /* Frames sent through NETSTACK_LLSEC are secured now, in process
+   * context, so that the slot only has to copy them to the radio.
+   * The frame counter, not the ASN, is the nonce: the ASN of the
+   * transmission is not known yet, and retransmissions reuse the frame */
+  if((packetbuf_attr(PACKETBUF_ATTR_SECURITY_LEVEL)
+      ? NETSTACK_FRAMER.create_and_secure() : NETSTACK_FRAMER.create()) < 0) {
+#else /* LLSEC802154_SECURITY_LEVEL */
   if(NETSTACK_FRAMER.create() < 0) {
+#endif /* LLSEC802154_SECURITY_LEVEL */
     //LOGP("TSCH:! can't send packet due to framer error");
     ret = MAC_TX_ERR;
   } else {
@@ -487,6 +1018,34 @@ send_packet(mac_callback_t sent, void *ptr)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if TSCH_RX_REUSE_HEADER && !RADIO_PARSE_MAC_HW
+/* Header of the frame being passed up, as parsed in the Rx timeslot.
+ * NULL when packetbuf must go through the framer. */
+static const struct tsch_packet_header *input_header;
+
+/* Set packetbuf attributes from an already-parsed header, the way
+ * the 802.15.4 framer would, and strip the header */
+static int
+input_header_apply(const struct tsch_packet_header *hdr)
+{
+  if(!packetbuf_hdrreduce(hdr->hdr_len)) {
+    return FRAMER_FAILED;
+  }
+#ifndef WITHOUT_ATTR_FRAME_TYPE
+  packetbuf_set_attr(PACKETBUF_ATTR_FRAME_TYPE, hdr->frame_type);
+#endif /* WITHOUT_ATTR_FRAME_TYPE */
+  if(!linkaddr_cmp(&hdr->dest_address, &linkaddr_null)) {
+    packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &hdr->dest_address);
+  }
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &hdr->source_address);
+#ifndef WITHOUT_CONTIKIMAC
+  packetbuf_set_attr(PACKETBUF_ATTR_PENDING, (hdr->flags & FRAME_PENDING) != 0);
+#endif /* WITHOUT_CONTIKIMAC */
+  packetbuf_set_attr(PACKETBUF_ATTR_PACKET_ID, hdr->seqno);
+  return hdr->hdr_len;
+}
+#endif /* TSCH_RX_REUSE_HEADER && !RADIO_PARSE_MAC_HW */
+/*---------------------------------------------------------------------------*/
 static void
 packet_input(void)
 {
@@ -496,7 +1055,13 @@ packet_input(void)
 
   int frame_parsed = 1;
 
-#if !RADIO_PARSE_MAC_HW
+#if TSCH_RX_REUSE_HEADER && !RADIO_PARSE_MAC_HW
+  if(input_header != NULL && !input_header->security_enabled) {
+    frame_parsed = input_header_apply(input_header);
+  } else {
+    frame_parsed = NETSTACK_FRAMER.parse();
+  }
+#elif !RADIO_PARSE_MAC_HW
     frame_parsed = NETSTACK_FRAMER.parse();
 #endif
 
@@ -514,27 +1079,36 @@ packet_input(void)
 
 #if TSCH_802154_DUPLICATE_DETECTION
     /* Check for duplicate packet by comparing the sequence number
-       of the incoming packet with the last few ones we saw. */
+       of the incoming packet with the last few ones of its sender. */
+    const linkaddr_t *sender = packetbuf_addr(PACKETBUF_ADDR_SENDER);
+    uint8_t seqno = packetbuf_attr(PACKETBUF_ATTR_PACKET_ID);
+    struct seqno_history *h = nbr_table_get_from_lladdr(received_seqnos, sender);
     int i;
-    for(i = 0; i < MAX_SEQNOS; ++i) {
-      if(packetbuf_attr(PACKETBUF_ATTR_PACKET_ID) == received_seqnos[i].seqno &&
-         linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_SENDER),
-                      &received_seqnos[i].sender)) {
-        /* Drop the packet. */
-        LOGP("TSCH:! drop dup ll from %u seqno %u",
-               LOG_NODEID_FROM_LINKADDR(packetbuf_addr(PACKETBUF_ADDR_SENDER)),
-               packetbuf_attr(PACKETBUF_ATTR_PACKET_ID));
-        duplicate = 1;
-      }
+    if(h == NULL && !linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &linkaddr_null)) {
+      /* Only unicast frames are retransmitted: no entry for broadcasts,
+       * which could evict neighbors of the upper layers. If the table is
+       * full, we do without duplicate detection */
+      h = nbr_table_add_lladdr(received_seqnos, sender);
     }
-    if(!duplicate) {
-      for(i = MAX_SEQNOS - 1; i > 0; --i) {
-        memcpy(&received_seqnos[i], &received_seqnos[i - 1],
-               sizeof(struct seqno));
+    if(h != NULL) {
+      for(i = 0; i < h->count; ++i) {
+        if(h->seqnos[i] == seqno) {
+          /* Drop the packet. */
+          LOGP("TSCH:! drop dup ll from %u seqno %u",
+                 LOG_NODEID_FROM_LINKADDR(sender), seqno);
+          duplicate = 1;
+          break;
+        }
+      }
+      if(!duplicate) {
+        if(h->count < TSCH_SEQNO_HISTORY) {
+          h->count++;
+        }
+        for(i = h->count - 1; i > 0; --i) {
+          h->seqnos[i] = h->seqnos[i - 1];
+        }
+        h->seqnos[0] = seqno;
       }
-      received_seqnos[0].seqno = packetbuf_attr(PACKETBUF_ATTR_PACKET_ID);
-      linkaddr_copy(&received_seqnos[0].sender,
-                    packetbuf_addr(PACKETBUF_ADDR_SENDER));
     }
 #endif /* TSCH_802154_DUPLICATE_DETECTION */
 
@@ -546,11 +1120,58 @@ packet_input(void)
         LOGP("TSCH: received from %u with seqno %u",
                        LOG_NODEID_FROM_LINKADDR(packetbuf_addr(PACKETBUF_ADDR_SENDER)),
                        packetbuf_attr(PACKETBUF_ATTR_PACKET_ID));
-        NETSTACK_NETWORK.input();
+#if TSCH_WITH_SIXP
+        /* 6P messages stop here */
+        if(tsch_sixp_input()) {
+          return;
+        }
+#endif /* TSCH_WITH_SIXP */
+        /* Verified and decrypted here, in process context, after the slot */
+        NETSTACK_LLSEC.input();
       }
     }
   }
 }
+/* Keepalive period: the keepalive timeout, or with TSCH_ADAPTIVE_KEEPALIVE
+ * the time for the expected drift to use up the Rx guard time, as
+ * computed by guard_time_get() */
+static clock_time_t
+keepalive_period(void)
+{
+#if TSCH_ADAPTIVE_KEEPALIVE
+  if(guard_estimator.samples >= TSCH_ADAPTIVE_GUARD_MIN_SAMPLES
+      && guard_estimator.time_source == tsch_queue_get_time_source()) {
+    uint32_t margin = US_TO_RTIMERTICKS(TSCH_ADAPTIVE_GUARD_MARGIN);
+    uint64_t slots;
+    uint64_t period;
+    if(guard_estimator.drift_rate == 0 || TsLongGT <= margin) {
+      return guard_estimator.drift_rate == 0 ? TSCH_KEEPALIVE_MAX_TIMEOUT : tsch_keepalive_timeout;
+    }
+    slots = ((uint64_t)(TsLongGT - margin) << 10) / (2 * guard_estimator.drift_rate);
+    period = slots * TsSlotDuration * CLOCK_SECOND / RTIMER_SECOND;
+    return MIN(MAX(period, tsch_keepalive_timeout), TSCH_KEEPALIVE_MAX_TIMEOUT);
+  }
+#endif /* TSCH_ADAPTIVE_KEEPALIVE */
+  return tsch_keepalive_timeout;
+}
+/* Time since our last synchronization */
+static clock_time_t
+time_since_last_sync(void)
+{
+  return (uint64_t)ASN_DIFF(current_asn, last_sync_asn) * TsSlotDuration
+    * CLOCK_SECOND / RTIMER_SECOND;
+}
+/* Set ctimer to send a keepalive message after a random delay in
+ * [period*0.9, period[, minus the time already elapsed since elapsed */
+static void
+keepalive_timer_set(clock_time_t elapsed)
+{
+  clock_time_t period = keepalive_period();
+  clock_time_t delay = (period - period/10)
+                          + random_rand() % (period/10);
+  ctimer_set(&keepalive_timer, delay > elapsed ? delay - elapsed : 1,
+             keepalive_send, NULL);
+}
 /* Tx callback for keepalive messages */
 static void
 keepalive_packet_sent(void *ptr, int status, int transmissions)
@@ -558,14 +1179,23 @@ keepalive_packet_sent(void *ptr, int status, int transmissions)
   uip_ds6_link_neighbor_callback(status, transmissions);
 //  LOG("TSCH: KA sent to %u, st %d %d\n",
 //      LOG_NODEID_FROM_LINKADDR(packetbuf_addr(PACKETBUF_ADDR_RECEIVER)), status, transmissions);
-  tsch_schedule_keepalive();
+  if(!tsch_is_coordinator && associated) {
+    /* A full period after a failure, rather than right away */
+    keepalive_timer_set(status == MAC_TX_OK ? time_since_last_sync() : 0);
+  }
 }
-/* Prepare and send a keepalive message */
+/* Prepare and send a keepalive message, unless we synchronized with the
+ * time source meanwhile */
 static void
 keepalive_send()
 {
   if(associated) {
     struct tsch_neighbor *n = tsch_queue_get_time_source();
+    clock_time_t period = keepalive_period();
+    if(time_since_last_sync() < period - period/10) {
+      tsch_schedule_keepalive();
+      return;
+    }
     /* Simply send an empty packet */
     /* TODO filter keep alive messages based on packet type
      * (MAC_COMMAND) not data length*/
@@ -576,18 +1206,27 @@ keepalive_send()
 //        LOG_NODEID_FROM_LINKADDR(&n->addr));
   }
 }
-/* Set ctimer to send a keepalive message after expiration of TSCH_KEEPALIVE_TIMEOUT */
+/* Set ctimer to send a keepalive message a keepalive period after our last
+ * synchronization. Process context only: the link operation only updates
+ * last_sync_asn, which keepalive_send() checks before sending */
 static void
 tsch_schedule_keepalive()
 {
-  /* Pick a delay in the range [TSCH_KEEPALIVE_TIMEOUT*0.9, TSCH_KEEPALIVE_TIMEOUT[ */
   if(!tsch_is_coordinator && associated) {
-    unsigned long delay = (TSCH_KEEPALIVE_TIMEOUT - TSCH_KEEPALIVE_TIMEOUT/10)
-                            + random_rand() % (TSCH_KEEPALIVE_TIMEOUT/10);
-    ctimer_set(&keepalive_timer, delay, keepalive_send, NULL);
+    keepalive_timer_set(time_since_last_sync());
   }
 }
 
+/* Is this a neighbor we synchronize to? The backup time source only
+ * once the time source has been silent for a while */
+#if TSCH_WITH_BACKUP_TIME_SOURCE
+#define IS_SYNC_NEIGHBOR(n) ((n) != NULL && ((n)->is_time_source \
+    || ((n)->is_backup_time_source && ASN_DIFF(current_asn, last_sync_asn) \
+        > TSCH_CLOCK_TO_SLOTS(TSCH_BACKUP_TIME_SOURCE_SYNC_AFTER))))
+#else /* TSCH_WITH_BACKUP_TIME_SOURCE */
+#define IS_SYNC_NEIGHBOR(n) ((n) != NULL && (n)->is_time_source)
+#endif /* TSCH_WITH_BACKUP_TIME_SOURCE */
+
 /* Get EB, broadcast or unicast packet to be sent, and target neighbor. */
 static struct tsch_packet *
 get_packet_and_neighbor_for_link(struct tsch_link *link, struct tsch_neighbor **target_neighbor)
@@ -608,8 +1247,20 @@ get_packet_and_neighbor_for_link(struct tsch_link *link, struct tsch_neighbor **
       /* NORMAL link or no EB to send, pick a data packet */
       if(p == NULL) {
         /* Get neighbor queue associated to the link and get packet from it */
-        n = tsch_queue_get_nbr(&link->addr);
+        n = tsch_queue_get_nbr(tsch_schedule_get_link_addr(link));
         p = tsch_queue_get_packet_for_nbr(n, is_shared_link);
+#if TSCH_PACKET_WITH_SLOTFRAME
+        /* The packet is restricted to another slotframe. Negotiated 6P
+         * cells serve all packets to their neighbor */
+        if(p != NULL && n != n_broadcast && p->slotframe != TSCH_PACKET_ANY_SLOTFRAME
+            && p->slotframe != link->slotframe_handle
+#if TSCH_WITH_SIXP
+            && link->slotframe_handle != TSCH_SIXP_SLOTFRAME_HANDLE
+#endif /* TSCH_WITH_SIXP */
+            ) {
+          p = NULL;
+        }
+#endif /* TSCH_PACKET_WITH_SLOTFRAME */
         /* if it is a broadcast slot and there were no broadcast packets, pick any unicast packet */
         if(p == NULL && n == n_broadcast) {
           p = tsch_queue_get_unicast_packet_for_any(&n, is_shared_link);
@@ -625,6 +1276,112 @@ get_packet_and_neighbor_for_link(struct tsch_link *link, struct tsch_neighbor **
   return p;
 }
 
+#if TSCH_SCHEDULE_WITH_LINK_STATS
+/* Increments a usage counter of the current link */
+#define LINK_STATS_INC(field) do { \
+    if(current_link != NULL) { \
+      current_link->stats.field++; \
+    } \
+  } while(0)
+#else /* TSCH_SCHEDULE_WITH_LINK_STATS */
+#define LINK_STATS_INC(field)
+#endif /* TSCH_SCHEDULE_WITH_LINK_STATS */
+
+#if TSCH_ADAPTIVE_RX_SKIP
+/* Is the Rx sampling period of this link adapted? */
+#define RX_SKIP_ELIGIBLE(l) ((l)->link_options == LINK_OPTION_RX && (l)->link_type == LINK_TYPE_NORMAL)
+/* Returns 1 if we must not listen this cycle of the link */
+static int
+rx_skip_link(struct tsch_link *l)
+{
+  if(!RX_SKIP_ELIGIBLE(l)) {
+    return 0;
+  }
+#if TSCH_BURST_MAX_LEN > 0
+  /* Always listen when a burst was announced */
+  if(burst_role == BURST_RX) {
+    return 0;
+  }
+#endif /* TSCH_BURST_MAX_LEN > 0 */
+  return (l->rx_skip.cycle++ & ((1 << l->rx_skip.exp) - 1)) != 0;
+}
+/* Adapts the Rx sampling period of the current link after listening */
+static void
+rx_skip_update(int received)
+{
+  if(current_link == NULL || !RX_SKIP_ELIGIBLE(current_link)) {
+    return;
+  }
+  if(received) {
+    /* Back to listening at every cycle */
+    current_link->rx_skip.exp = 0;
+    current_link->rx_skip.idle_count = 0;
+  } else if(current_link->rx_skip.exp < TSCH_RX_SKIP_MAX_EXP
+      && ++current_link->rx_skip.idle_count >= TSCH_RX_SKIP_IDLE_THRESHOLD) {
+    /* Idle for long enough, halve the sampling rate */
+    current_link->rx_skip.exp++;
+    current_link->rx_skip.idle_count = 0;
+  }
+}
+#define RX_SKIP_UPDATE(received) rx_skip_update(received)
+#else /* TSCH_ADAPTIVE_RX_SKIP */
+#define RX_SKIP_UPDATE(received)
+#endif /* TSCH_ADAPTIVE_RX_SKIP */
+
+#if TSCH_WITH_TX_POWER_CONTROL
+/* Configured and lowest Tx power, and the one currently set, in dBm */
+static radio_value_t tx_power_max;
+static radio_value_t tx_power_min;
+static radio_value_t tx_power_current;
+/* Does the radio let us set its Tx power? -1: not known yet */
+static int8_t tx_power_supported = -1;
+
+/* Reads the configured Tx power. Done at the first frame after each
+ * association, as the platform may set the power after TSCH starts */
+static void
+tx_power_init(void)
+{
+  tx_power_supported =
+      NETSTACK_RADIO.get_value(RADIO_PARAM_TXPOWER, &tx_power_max) == RADIO_RESULT_OK
+      && NETSTACK_RADIO.get_value(RADIO_CONST_TXPOWER_MIN, &tx_power_min) == RADIO_RESULT_OK
+      && tx_power_min < tx_power_max;
+  tx_power_current = tx_power_max;
+}
+/* Sets the Tx power for the next frame, to the configured power if n is
+ * NULL or a virtual neighbor */
+static void
+tx_power_set(const struct tsch_neighbor *n)
+{
+  radio_value_t power;
+  if(tx_power_supported < 0) {
+    tx_power_init();
+  }
+  if(!tx_power_supported) {
+    return;
+  }
+  power = tx_power_max;
+  if(n != NULL && !n->is_broadcast) {
+    power = MAX(tx_power_max - n->tx_power_reduction, tx_power_min);
+  }
+  if(power != tx_power_current
+      && NETSTACK_RADIO.set_value(RADIO_PARAM_TXPOWER, power) == RADIO_RESULT_OK) {
+    tx_power_current = power;
+  }
+}
+/* Adapts the Tx power to a neighbor from the RSSI of its ACK */
+static void
+tx_power_ack_received(struct tsch_neighbor *n, int16_t ack_rssi)
+{
+  if(ack_rssi > TSCH_TX_POWER_TARGET_RSSI + TSCH_TX_POWER_HYSTERESIS) {
+    if(tx_power_max - n->tx_power_reduction - TSCH_TX_POWER_STEP >= tx_power_min) {
+      n->tx_power_reduction += TSCH_TX_POWER_STEP;
+    }
+  } else if(ack_rssi < TSCH_TX_POWER_TARGET_RSSI) {
+    n->tx_power_reduction = n->tx_power_reduction > TSCH_TX_POWER_STEP
+        ? n->tx_power_reduction - TSCH_TX_POWER_STEP : 0;
+  }
+}
+#endif /* TSCH_WITH_TX_POWER_CONTROL */
 
 /* Post TX: Update neighbor state after a transmission */
 static int
@@ -635,11 +1392,26 @@ update_neighbor_state(struct tsch_neighbor *n, struct tsch_packet *p,
   int is_shared_link = link->link_options & LINK_OPTION_SHARED;
   int is_unicast = !n->is_broadcast;
 
-  t0post_tx = RTIMER_NOW();
+  SLOT_PROFILE_START(t0post_tx, TSCH_SLOT_PHASE_POST_TX);
+
+  if(is_unicast) {
+    /* Track consecutive unacknowledged transmissions */
+    if(mac_tx_status == MAC_TX_OK) {
+      n->noack_streak = 0;
+    } else if(mac_tx_status == MAC_TX_NOACK && n->noack_streak < 0xff) {
+      n->noack_streak++;
+    }
+#if TSCH_WITH_TX_POWER_CONTROL
+    /* Safe fallback: the link may be too weak for the reduced power */
+    if(n->noack_streak >= TSCH_TX_POWER_NOACK_STREAK) {
+      n->tx_power_reduction = 0;
+    }
+#endif /* TSCH_WITH_TX_POWER_CONTROL */
+  }
 
   if(mac_tx_status == MAC_TX_OK) {
     /* Successful transmission */
-    tsch_queue_remove_packet_from_queue(n);
+    tsch_queue_remove_packet(n, p);
     in_queue = 0;
 
     /* Update CSMA state in the unicast case */
@@ -652,10 +1424,29 @@ update_neighbor_state(struct tsch_neighbor *n, struct tsch_packet *p,
     }
   } else {
     /* Failed transmission */
-    if(p->transmissions >= MAC_MAX_FRAME_RETRIES + 1) {
+#if TSCH_QUEUE_ANYCAST_NOACK
+    if(is_unicast && mac_tx_status == MAC_TX_NOACK
+        && p->transmissions < p->max_transmissions
+        && p->transmissions % TSCH_QUEUE_ANYCAST_NOACK == 0
+        && tsch_queue_get_anycast_nbr(n) != NULL
+        && tsch_queue_remove_packet(n, p) != NULL) {
+      /* Queued to the alternate neighbor by tsch_tx_process_pending */
+      p->anycast = 1;
+      in_queue = 0;
+    }
+#endif /* TSCH_QUEUE_ANYCAST_NOACK */
+    if(in_queue && (p->transmissions >= p->max_transmissions
+#if TSCH_QUEUE_NOACK_ABORT_STREAK
+        /* The neighbor looks unreachable: do not insist */
+        || n->noack_streak >= TSCH_QUEUE_NOACK_ABORT_STREAK
+#endif /* TSCH_QUEUE_NOACK_ABORT_STREAK */
+        )) {
       /* Drop packet */
-      tsch_queue_remove_packet_from_queue(n);
+      tsch_queue_remove_packet(n, p);
       in_queue = 0;
+#if TSCH_QUEUE_WITH_STATS
+      n->stats.drop_retries++;
+#endif /* TSCH_QUEUE_WITH_STATS */
     }
     /* Update CSMA state in the unicast case */
     if(is_unicast) {
@@ -668,7 +1459,7 @@ update_neighbor_state(struct tsch_neighbor *n, struct tsch_packet *p,
     }
   }
 
-  t0post_tx = RTIMER_NOW() - t0post_tx;
+  SLOT_PROFILE_END(t0post_tx, TSCH_SLOT_PHASE_POST_TX);
 
   return in_queue;
 }
@@ -701,7 +1492,10 @@ PT_THREAD(tsch_tx_link(struct pt *pt, struct rtimer *t))
   if(dequeued_index != -1) {
 
     /* TODO There are small timing variations visible in cooja, which needs tuning */
-    t0prepare = RTIMER_NOW();
+    SLOT_PROFILE_START(t0prepare, TSCH_SLOT_PHASE_PREPARE);
+#if TSCH_BURST_MAX_LEN > 0
+    burst_pending = 0;
+#endif /* TSCH_BURST_MAX_LEN > 0 */
 
     if(current_packet == NULL || current_packet->qb == NULL) {
       mac_tx_status = MAC_TX_ERR_FATAL;
@@ -721,8 +1515,8 @@ PT_THREAD(tsch_tx_link(struct pt *pt, struct rtimer *t))
 #endif
 
       /* get payload */
-      payload = queuebuf_dataptr(current_packet->qb);
-      payload_len = queuebuf_datalen(current_packet->qb);
+      payload = tsch_queue_packet_payload(current_packet);
+      payload_len = tsch_queue_packet_len(current_packet);
       /* is this a broadcast packet? (wait for ack?) */
       is_broadcast = current_neighbor->is_broadcast;
       /* read seqno from payload */
@@ -731,11 +1525,22 @@ PT_THREAD(tsch_tx_link(struct pt *pt, struct rtimer *t))
       if(current_neighbor == n_eb) {
         packet_ready = tsch_packet_update_eb(payload, payload_len);
       }
+#if TSCH_BURST_MAX_LEN > 0
+      if(!is_broadcast) {
+        /* Announce more frames to come if we have some and the burst can be extended */
+        burst_pending = burst_count + 1 < TSCH_BURST_MAX_LEN
+            && tsch_queue_packet_count(&current_neighbor->addr) > 1;
+        tsch_packet_set_frame_pending(payload, payload_len, burst_pending);
+      }
+#endif /* TSCH_BURST_MAX_LEN > 0 */
+#if TSCH_WITH_TX_POWER_CONTROL
+      tx_power_set(current_neighbor);
+#endif /* TSCH_WITH_TX_POWER_CONTROL */
       /* prepare packet to send: copy to radio buffer */
       if(packet_ready && NETSTACK_RADIO.prepare(payload, payload_len) == 0) { /* 0 means success */
         static rtimer_clock_t tx_duration;
 
-        t0prepare = RTIMER_NOW() - t0prepare;
+        SLOT_PROFILE_END(t0prepare, TSCH_SLOT_PHASE_PREPARE);
 
 #if CCA_ENABLED
         cca_status = 1;
@@ -753,10 +1558,10 @@ PT_THREAD(tsch_tx_link(struct pt *pt, struct rtimer *t))
 #endif /* CCA_ENABLED */
         {
           /* delay before TX */
-          TSCH_SCHEDULE_AND_YIELD(pt, t, current_link_start, TsTxOffset - delayTx);
-          t0tx = RTIMER_NOW();
+          TSCH_SCHEDULE_AND_YIELD(pt, t, current_link_start, TsTxOffset - TX_WAKEUP_LEAD);
+          SLOT_PROFILE_START(t0tx, TSCH_SLOT_PHASE_TX);
           /* send packet already in radio tx buffer */
-          mac_tx_status = NETSTACK_RADIO.transmit(payload_len);
+          mac_tx_status = radio_transmit_at(payload_len, current_link_start + TsTxOffset);
           /* Save tx timestamp */
 #if TSCH_USE_SFD_FOR_SYNC
           tx_start_time = current_link_start + TsTxOffset;
@@ -771,9 +1576,10 @@ PT_THREAD(tsch_tx_link(struct pt *pt, struct rtimer *t))
           tx_duration = MIN(tx_duration, TSCH_DATA_MAX_DURATION);
           /* turn tadio off -- will turn on again to wait for ACK if needed */
           off();
-          t0tx = RTIMER_NOW() - t0tx;
+          TSCH_ENERGEST_TX(tx_duration);
+          SLOT_PROFILE_END(t0tx, TSCH_SLOT_PHASE_TX);
 
-          t0txack = RTIMER_NOW();
+          SLOT_PROFILE_START(t0txack, TSCH_SLOT_PHASE_TX_ACK);
           if(mac_tx_status == RADIO_TX_OK) {
             if(!is_broadcast) {
               uint8_t ackbuf[TSCH_ACK_LEN];
@@ -788,8 +1594,9 @@ PT_THREAD(tsch_tx_link(struct pt *pt, struct rtimer *t))
               NETSTACK_RADIO_address_decode(0);
               /* Unicast: wait for ack after tx: sleep until ack time */
               TSCH_SCHEDULE_AND_YIELD(pt, t, tx_start_time,
-                  tx_duration + TsTxAckDelay - TsShortGT - delayRx);
-              on();
+                  tx_duration + TsTxAckDelay - TsShortGT - RX_WAKEUP_LEAD);
+              radio_on_at(tx_start_time + tx_duration + TsTxAckDelay - TsShortGT);
+              TSCH_ENERGEST_LISTEN_START(tx_start_time + tx_duration + TsTxAckDelay - TsShortGT);
               /* Wait for ACK to come */
               BUSYWAIT_UNTIL_ABS(NETSTACK_RADIO.receiving_packet(),
                   tx_start_time, tx_duration + TsTxAckDelay + TsShortGT);
@@ -805,16 +1612,27 @@ PT_THREAD(tsch_tx_link(struct pt *pt, struct rtimer *t))
               BUSYWAIT_UNTIL_ABS(!NETSTACK_RADIO.receiving_packet(),
                   ack_start_time, TSCH_ACK_MAX_DURATION);
               off();
+              TSCH_ENERGEST_LISTEN_END();
               /* Enabling address decoding again so the radio filters data packets */
               NETSTACK_RADIO_address_decode(1);
 
               /* Read ack frame */
               ack_len = NETSTACK_RADIO.read((void *)ackbuf, TSCH_ACK_LEN);
+              TSCH_ENERGEST_LISTEN_ADD(ack_len <= 0);
 
-              is_time_source = current_neighbor != NULL && current_neighbor->is_time_source;
+              is_time_source = IS_SYNC_NEIGHBOR(current_neighbor);
               received_drift = 0;
+#if TSCH_PACKET_WITH_ACK_HINTS
               ret = tsch_packet_parse_sync_ack(&received_drift, &is_nack,
-                  ackbuf, ack_len, seqno, is_time_source);
+                  ackbuf, ack_len, seqno, is_time_source, &current_packet->ack_hints);
+              current_packet->has_ack_hints = (ret & TSCH_ACK_HAS_HINTS) != 0;
+              if(current_packet->has_ack_hints && current_neighbor != NULL) {
+                current_neighbor->ack_hints = current_packet->ack_hints;
+              }
+#else /* TSCH_PACKET_WITH_ACK_HINTS */
+              ret = tsch_packet_parse_sync_ack(&received_drift, &is_nack,
+                  ackbuf, ack_len, seqno, is_time_source, NULL);
+#endif /* TSCH_PACKET_WITH_ACK_HINTS */
 
               if(ret & TSCH_ACK_OK) {
                 if(is_time_source && (ret & TSCH_ACK_HAS_SYNC_IE)) {
@@ -827,19 +1645,39 @@ PT_THREAD(tsch_tx_link(struct pt *pt, struct rtimer *t))
                     drift_correction = received_drift;
                   }
                   if(drift_correction != received_drift) {
-                    TSCH_LOG_ADD(tsch_log_message,
-                        snprintf(log->message, sizeof(log->message),
-                            "!truncated dr %d %d", (int)received_drift, (int)drift_correction);
-                    );
+                    TSCH_LOG_MESSAGE("!truncated dr %d %d",
+                        (int)received_drift, (int)drift_correction, 0, 0);
                   }
 #else /* TRUNCATE_SYNC_IE */
                   drift_correction = received_drift;
 #endif /* TRUNCATE_SYNC_IE */
                   drift_neighbor = current_neighbor;
-                  /* Keep track of sync time */
+#if TSCH_ADAPTIVE_TIMESYNC
+                  tsch_timesync_update(current_neighbor, ASN_DIFF(current_asn, last_sync_asn), drift_correction);
+#endif /* TSCH_ADAPTIVE_TIMESYNC */
+#if TSCH_ADAPTIVE_GUARD_TIME
+                  guard_time_update(current_neighbor, received_drift);
+#endif /* TSCH_ADAPTIVE_GUARD_TIME */
+                  /* Keep track of sync time, postpones the keepalive */
                   last_sync_asn = current_asn;
-                  tsch_schedule_keepalive();
                 }
+                if(is_nack) {
+                  LINK_STATS_INC(tx_nack);
+#if TSCH_PACKET_WITH_NACK_LINK
+                  if(current_link != NULL) {
+                    current_packet->nack_link = current_link->handle;
+                  }
+#endif /* TSCH_PACKET_WITH_NACK_LINK */
+#if TSCH_BURST_MAX_LEN > 0
+                  burst_pending = 0;
+#endif /* TSCH_BURST_MAX_LEN > 0 */
+                }
+#if TSCH_WITH_TX_POWER_CONTROL
+                if(current_neighbor != NULL) {
+                  extern signed char radio_last_rssi;
+                  tx_power_ack_received(current_neighbor, radio_last_rssi + RSSI_CORRECTION_CONSTANT);
+                }
+#endif /* TSCH_WITH_TX_POWER_CONTROL */
                 mac_tx_status = MAC_TX_OK;
               } else {
                 mac_tx_status = MAC_TX_NOACK;
@@ -850,13 +1688,43 @@ PT_THREAD(tsch_tx_link(struct pt *pt, struct rtimer *t))
           } else {
             mac_tx_status = MAC_TX_ERR;
           }
+          if(!is_broadcast && mac_tx_status != MAC_TX_ERR) {
+            CHANNEL_STATS_INC(tx);
+            if(mac_tx_status == MAC_TX_OK) {
+              CHANNEL_STATS_INC(tx_ok);
+            }
+#if TSCH_WITH_LINK_ESTIMATOR
+            if(current_channel >= 11 && current_channel <= 26) {
+              if(mac_tx_status == MAC_TX_OK) {
+                current_packet->ack_channel = current_channel;
+              } else {
+                current_packet->noack_channels |= 1 << (current_channel - 11);
+              }
+            }
+#endif /* TSCH_WITH_LINK_ESTIMATOR */
+          }
         }
       }
     }
-    t0txack = RTIMER_NOW() - t0txack;
+    SLOT_PROFILE_END(t0txack, TSCH_SLOT_PHASE_TX_ACK);
 
     current_packet->transmissions++;
     current_packet->ret = mac_tx_status;
+#if TSCH_BURST_MAX_LEN > 0
+    if(mac_tx_status == MAC_TX_OK && burst_pending) {
+      /* The frame announcing more was acked: continue in the next timeslot */
+      burst_link_scheduled = BURST_TX;
+    }
+#endif /* TSCH_BURST_MAX_LEN > 0 */
+
+    LINK_STATS_INC(tx_attempts);
+    if(mac_tx_status == MAC_TX_OK) {
+      LINK_STATS_INC(tx_ok);
+    } else if(mac_tx_status == MAC_TX_NOACK) {
+      LINK_STATS_INC(tx_noack);
+    } else if(mac_tx_status == MAC_TX_COLLISION) {
+      LINK_STATS_INC(cca_busy);
+    }
 
     /* Post TX: Update neighbor state */
     in_queue = update_neighbor_state(current_neighbor, current_packet, current_link, mac_tx_status);
@@ -873,28 +1741,63 @@ PT_THREAD(tsch_tx_link(struct pt *pt, struct rtimer *t))
     TSCH_LOG_ADD(tsch_log_tx,
         log->tx.mac_tx_status = mac_tx_status;
     log->tx.num_tx = current_packet->transmissions;
-    log->tx.datalen = queuebuf_datalen(current_packet->qb);
+    log->tx.datalen = tsch_queue_packet_len(current_packet);
     log->tx.drift = drift_correction;
     log->tx.drift_used = drift_neighbor != NULL;
     log->tx.is_data =
-        (tsch_packet_parse_frame_type_from_fcf_lsb(((uint8_t*)queuebuf_dataptr(current_packet->qb))[0])
+        (tsch_packet_parse_frame_type_from_fcf_lsb(tsch_queue_packet_payload(current_packet)[0])
             & IS_DATA) != 0;
     log->tx.dest = LOG_NODEID_FROM_LINKADDR(queuebuf_addr(current_packet->qb, PACKETBUF_ADDR_RECEIVER));
-    appdata_copy(&log->tx.appdata, LOG_APPDATAPTR_FROM_BUFFER(queuebuf_dataptr(current_packet->qb), queuebuf_datalen(current_packet->qb)));
+    appdata_copy(&log->tx.appdata, LOG_APPDATAPTR_FROM_BUFFER(tsch_queue_packet_payload(current_packet), tsch_queue_packet_len(current_packet)));
     );
   }
 
   PT_END(pt);
 }
 
+#if TSCH_RX_EARLY_REJECT
+/* Called from interrupt while a frame is being received, started at
+ * rx_start. Waits for its destination address and returns 1 if it is a
+ * unicast to another node, i.e. there is no point in receiving the rest */
+static int
+rx_early_reject(rtimer_clock_t rx_start)
+{
+  uint8_t header[1 + TSCH_PACKET_PEEK_LEN];
+  linkaddr_t dest;
+  rtimer_clock_t rx_end;
+  rtimer_clock_t now;
+
+  BUSYWAIT_UNTIL_ABS(!NETSTACK_RADIO.receiving_packet(),
+      rx_start, TSCH_PACKET_DURATION(TSCH_PACKET_PEEK_LEN));
+  if(!NETSTACK_RADIO.receiving_packet()
+     || NETSTACK_RADIO.get_object(RADIO_PARAM_RX_HEADER, header, sizeof(header)) != RADIO_RESULT_OK
+     || header[0] < 2
+     || !tsch_packet_peek_dest_address(header + 1, TSCH_PACKET_PEEK_LEN, &dest)
+     || linkaddr_cmp(&dest, &linkaddr_node_addr)
+     || linkaddr_cmp(&dest, &linkaddr_null)) {
+    return 0;
+  }
+
+  /* The length byte includes the FCS, TSCH_PACKET_DURATION does not */
+  rx_end = rx_start + TSCH_PACKET_DURATION(header[0] - 2);
+  now = RTIMER_NOW();
+  rx_early_reject_stats.count++;
+  if(RTIMER_CLOCK_LT(now, rx_end)) {
+    rx_early_reject_stats.saved += (rtimer_clock_t)(rx_end - now);
+  }
+  return 1;
+}
+#endif /* TSCH_RX_EARLY_REJECT */
+
 static
 PT_THREAD(tsch_rx_link(struct pt *pt, struct rtimer *t))
 {
   /**
    * RX link:
    * 1. Check if it is used for TIME_KEEPING
-   * 2. Sleep and wake up just before expected RX time (with a guard time: TsLongGT)
-   * 3. Check for radio activity for the guard time: TsLongGT
+   * 2. Sleep and wake up just before expected RX time (with a guard time: TsLongGT,
+   *    or less with TSCH_ADAPTIVE_GUARD_TIME)
+   * 3. Check for radio activity for the guard time
    * 4. Prepare and send ACK if needed
    * 5. Drift calculated in the ACK callback registered with the radio driver. Use it if receiving from a time source neighbor.
    **/
@@ -924,33 +1827,50 @@ PT_THREAD(tsch_rx_link(struct pt *pt, struct rtimer *t))
     /* Default start time: expected Rx time */
     rx_start_time = expected_rx_time;
 
-    t0rx = RTIMER_NOW();
+    SLOT_PROFILE_START(t0rx, TSCH_SLOT_PHASE_RX);
 
     current_input = &input_array[input_index];
 
+#if TSCH_ADAPTIVE_GUARD_TIME
+    rx_guard_time = guard_time_get();
+#endif /* TSCH_ADAPTIVE_GUARD_TIME */
+
     /* Wait before starting to listen */
-    TSCH_SCHEDULE_AND_YIELD(pt, t, current_link_start, TsTxOffset - TsLongGT - delayRx);
+    TSCH_SCHEDULE_AND_YIELD(pt, t, current_link_start, TsTxOffset - RX_GUARD_TIME - RX_WAKEUP_LEAD);
 
     /* Start radio for at least guard time */
-    on();
+    radio_on_at(current_link_start + TsTxOffset - RX_GUARD_TIME);
+    TSCH_ENERGEST_LISTEN_START(current_link_start + TsTxOffset - RX_GUARD_TIME);
     if(!NETSTACK_RADIO.receiving_packet()) {
       /* Check if receiving within guard time */
       BUSYWAIT_UNTIL_ABS(NETSTACK_RADIO.receiving_packet(),
-          current_link_start, TsTxOffset + TsLongGT);
+          current_link_start, TsTxOffset + RX_GUARD_TIME);
       /* Save packet timestamp,
        * XXX it seems that RTIMER gives better sync than SFD timer both on NXP and SKY */
       rx_start_time = RTIMER_NOW();
     }
     if(!NETSTACK_RADIO.receiving_packet() && !NETSTACK_RADIO.pending_packet()) {
       off();
-      t0rx = RTIMER_NOW() - t0rx;
+      TSCH_ENERGEST_LISTEN_END();
+      TSCH_ENERGEST_LISTEN_ADD(1);
+      SLOT_PROFILE_END(t0rx, TSCH_SLOT_PHASE_RX);
       /* no packets on air */
+      LINK_STATS_INC(rx_idle);
+      RX_SKIP_UPDATE(0);
+#if TSCH_RX_EARLY_REJECT
+    } else if(NETSTACK_RADIO.receiving_packet() && rx_early_reject(rx_start_time)) {
+      /* Unicast to another node: drop it, this flushes the radio */
+      off();
+      TSCH_ENERGEST_LISTEN_END();
+      TSCH_ENERGEST_LISTEN_ADD(0);
+      SLOT_PROFILE_END(t0rx, TSCH_SLOT_PHASE_RX);
+#endif /* TSCH_RX_EARLY_REJECT */
     } else {
       uint8_t seqno;
 
       /* Wait until packet is received, turn radio off */
       BUSYWAIT_UNTIL_ABS(!NETSTACK_RADIO.receiving_packet(),
-          current_link_start, TsTxOffset + TsLongGT + TSCH_DATA_MAX_DURATION);
+          current_link_start, TsTxOffset + RX_GUARD_TIME + TSCH_DATA_MAX_DURATION);
       /* XXX it seems that RTIMER gives better sync than SFD timer both on NXP and SKY */
 #if TSCH_USE_SFD_FOR_SYNC
       /* Save packet timestamp */
@@ -958,6 +1878,8 @@ PT_THREAD(tsch_rx_link(struct pt *pt, struct rtimer *t))
 #endif /* TSCH_USE_SFD_FOR_SYNC */
 
       off();
+      TSCH_ENERGEST_LISTEN_END();
+      TSCH_ENERGEST_LISTEN_ADD(0);
 
       if(NETSTACK_RADIO.pending_packet()) {
         static int ack_needed;
@@ -969,19 +1891,28 @@ PT_THREAD(tsch_rx_link(struct pt *pt, struct rtimer *t))
         current_input->len = NETSTACK_RADIO.read((void *)current_input->payload, TSCH_MAX_PACKET_LEN);
         current_input->rx_asn = current_asn;
         current_input->rssi = radio_last_rssi + RSSI_CORRECTION_CONSTANT;
-        ack_needed = tsch_packet_parse_frame_type((uint8_t *)current_input->payload, current_input->len, &seqno) & DO_ACK;
-        frame_valid = tsch_packet_extract_addresses((uint8_t*)current_input->payload,
-            current_input->len, &source_address, &destination_address);
+        /* Parse the header once; the result is kept with the input packet */
+        frame_valid = tsch_packet_parse_header((uint8_t *)current_input->payload,
+            current_input->len, &current_input->hdr) != 0;
+        ack_needed = current_input->hdr.flags & DO_ACK;
+        seqno = current_input->hdr.seqno;
+        if(frame_valid) {
+          linkaddr_copy(&source_address, &current_input->hdr.source_address);
+          linkaddr_copy(&destination_address, &current_input->hdr.dest_address);
+        }
         rx_end_time = rx_start_time + TSCH_PACKET_DURATION(current_input->len);
 
-        t0rx = RTIMER_NOW() - t0rx;
-        t0rxack = RTIMER_NOW();
+        SLOT_PROFILE_END(t0rx, TSCH_SLOT_PHASE_RX);
+        SLOT_PROFILE_START(t0rxack, TSCH_SLOT_PHASE_RX_ACK);
 
         if(frame_valid) {
           if(linkaddr_cmp(&destination_address, &linkaddr_node_addr)
               || linkaddr_cmp(&destination_address, &linkaddr_null)) {
             int do_nack = 0;
             estimated_drift = ((int32_t)expected_rx_time - (int32_t)rx_start_time);
+            LINK_STATS_INC(rx_ok);
+            CHANNEL_STATS_INC(rx);
+            RX_SKIP_UPDATE(1);
 
 #ifdef TSCH_CALLBACK_DO_NACK
             if(ack_needed) {
@@ -993,28 +1924,62 @@ PT_THREAD(tsch_rx_link(struct pt *pt, struct rtimer *t))
             if(ack_needed) {
               static uint8_t ack_buf[TSCH_ACK_LEN];
               static int ack_len;
+#if TSCH_PACKET_WITH_ACK_HINTS
+              struct tsch_ack_hints hints;
+              hints.rx_free = TSCH_MAX_INCOMING_PACKETS - ringbufindex_elements(&input_ringbuf);
+              hints.queue_len = tsch_queue_nbr_packet_count(tsch_queue_get_nbr(&source_address));
+#ifdef TSCH_CALLBACK_ACK_HINTS
+              hints.flags = TSCH_CALLBACK_ACK_HINTS(current_link, &source_address);
+#else
+              hints.flags = 0;
+#endif
+#define ACK_HINTS &hints
+#else /* TSCH_PACKET_WITH_ACK_HINTS */
+#define ACK_HINTS NULL
+#endif /* TSCH_PACKET_WITH_ACK_HINTS */
 
               /* Build ACK frame */
               ack_len = tsch_packet_make_sync_ack(
                   estimated_drift, do_nack,
-                  ack_buf, sizeof(ack_buf), &source_address, seqno);
+                  ack_buf, sizeof(ack_buf), &source_address, seqno, ACK_HINTS);
+#if TSCH_WITH_TX_POWER_CONTROL
+              tx_power_set(NULL);
+#endif /* TSCH_WITH_TX_POWER_CONTROL */
               /* Copy to radio buffer */
               NETSTACK_RADIO.prepare((const void *)ack_buf, ack_len);
 
               /* Wait for time to ACK and transmit ACK */
-              TSCH_SCHEDULE_AND_YIELD(pt, t, rx_end_time, TsTxAckDelay - delayTx);
-              NETSTACK_RADIO.transmit(ack_len);
+              TSCH_SCHEDULE_AND_YIELD(pt, t, rx_end_time, TsTxAckDelay - TX_WAKEUP_LEAD);
+              if(radio_transmit_ack_at(ack_len, rx_end_time + TsTxAckDelay)) {
+                /* Leave the CPU free until the end of the ACK */
+                TSCH_SCHEDULE_AND_YIELD(pt, t, rx_end_time,
+                    TsTxAckDelay + TSCH_PACKET_DURATION(ack_len));
+              }
+              TSCH_ENERGEST_TX(TSCH_PACKET_DURATION(ack_len));
+
+#if TSCH_BURST_MAX_LEN > 0
+              if(!do_nack && burst_count + 1 < TSCH_BURST_MAX_LEN
+                  && (current_input->hdr.flags & FRAME_PENDING)) {
+                /* The sender has more frames for us: listen in the next timeslot */
+                burst_link_scheduled = BURST_RX;
+              }
+#endif /* TSCH_BURST_MAX_LEN > 0 */
             }
 
             /* If the sender is a time source, proceed to clock drift compensation */
             n = tsch_queue_get_nbr(&source_address);
-            if(n != NULL && n->is_time_source) {
+            if(IS_SYNC_NEIGHBOR(n)) {
+#if TSCH_ADAPTIVE_TIMESYNC
+              tsch_timesync_update(n, ASN_DIFF(current_asn, last_sync_asn), -estimated_drift);
+#endif /* TSCH_ADAPTIVE_TIMESYNC */
+#if TSCH_ADAPTIVE_GUARD_TIME
+              guard_time_update(n, estimated_drift);
+#endif /* TSCH_ADAPTIVE_GUARD_TIME */
               /* Keep track of last sync time */
               last_sync_asn = current_asn;
               /* Save estimated drift */
               drift_correction = -estimated_drift;
               drift_neighbor = n;
-              tsch_schedule_keepalive();
             }
 
 #if WITH_APP_PROBING
@@ -1023,6 +1988,7 @@ PT_THREAD(tsch_rx_link(struct pt *pt, struct rtimer *t))
             /* Add current input to ringbuf and set ctimer for later processing */
             ringbufindex_put(&input_ringbuf);
             process_poll(&tsch_pending_events_process);
+            rx_ring_stats.received++;
 #endif /* WITH_APP_PROBING */
 
             /* Log every reception */
@@ -1032,30 +1998,22 @@ PT_THREAD(tsch_rx_link(struct pt *pt, struct rtimer *t))
               log->rx.datalen = current_input->len;
               log->rx.drift = drift_correction;
               log->rx.drift_used = drift_neighbor != NULL;
-              log->rx.is_data =
-                  (tsch_packet_parse_frame_type(current_input->payload, current_input->len, NULL)
-                  & IS_DATA) != 0;
+              log->rx.is_data = (current_input->hdr.flags & IS_DATA) != 0;
               log->rx.estimated_drift = estimated_drift;
               appdata_copy(&log->rx.appdata, LOG_APPDATAPTR_FROM_BUFFER(current_input->payload, current_input->len));
             );
           } else {
-            TSCH_LOG_ADD(tsch_log_message,
-                  snprintf(log->message, sizeof(log->message),
-                      "!not for us %x:%x:%x:%x",
-                      destination_address.u8[4], destination_address.u8[5],
-                      destination_address.u8[6], destination_address.u8[7]);
-            );
+            TSCH_LOG_MESSAGE("!not for us %x:%x:%x:%x",
+                destination_address.u8[4], destination_address.u8[5], destination_address.u8[6], destination_address.u8[7]);
           }
         }
       }
     }
 
-    t0rxack = RTIMER_NOW() - t0rxack;
+    SLOT_PROFILE_END(t0rxack, TSCH_SLOT_PHASE_RX_ACK);
     if(input_queue_drop != 0) {
-      TSCH_LOG_ADD(tsch_log_message,
-          snprintf(log->message, sizeof(log->message),
-              "!queue full skipped %u", input_queue_drop);
-      );
+      TSCH_LOG_MESSAGE("!queue full skipped %u",
+          input_queue_drop, 0, 0, 0);
       input_queue_drop = 0;
     }
   }
@@ -1073,20 +2031,26 @@ PT_THREAD(tsch_link_operation(struct rtimer *t, void *ptr))
   /* Loop over all active links */
   while(associated) {
 
+#if TSCH_WITH_DL_MISS_STATS
+    dl_miss_phase = TSCH_SLOT_PHASE_COUNT;
+#endif /* TSCH_WITH_DL_MISS_STATS */
     if(current_link == NULL || tsch_lock_requested) { /* Skip link operation if there is no link
                                                           or if there is a pending request for getting the lock */
       /* Issue a log whenever skipping a link */
-      TSCH_LOG_ADD(tsch_log_message,
-                      snprintf(log->message, sizeof(log->message),
-                          "!skipped link %u %u %u",
-                            tsch_locked,
-                            tsch_lock_requested,
-                            current_link == NULL);
-      );
+      TSCH_LOG_MESSAGE("!skipped link %u %u %u",
+          tsch_locked, tsch_lock_requested, current_link == NULL, 0);
 
     } else {
       tsch_in_link_operation = 1;
       /* Get a packet ready to be sent */
+#if TSCH_BURST_MAX_LEN > 0
+      if(burst_role == BURST_TX) {
+        /* Continue the burst with the same neighbor */
+        current_packet = tsch_queue_get_packet_for_nbr(current_neighbor, 0);
+      } else if(burst_role == BURST_RX) {
+        current_packet = NULL;
+      } else
+#endif /* TSCH_BURST_MAX_LEN > 0 */
       current_packet = get_packet_and_neighbor_for_link(current_link, &current_neighbor);
       /* Hop channel */
       hop_channel(&current_asn, current_link->channel_offset);
@@ -1103,7 +2067,12 @@ PT_THREAD(tsch_link_operation(struct rtimer *t, void *ptr))
          **/
         static struct pt link_tx_pt;
         PT_SPAWN(&link_operation_pt, &link_tx_pt, tsch_tx_link(&link_tx_pt, t));
-      } else if((current_link->link_options & LINK_OPTION_RX)) {
+      } else if((current_link->link_options & LINK_OPTION_RX)
+#if TSCH_ADAPTIVE_RX_SKIP
+          /* Do not listen if the link is idle and this cycle is not sampled */
+          && !rx_skip_link(current_link)
+#endif /* TSCH_ADAPTIVE_RX_SKIP */
+          ) {
         /* Listen */
         static struct pt link_rx_pt;
         PT_SPAWN(&link_operation_pt, &link_rx_pt, tsch_rx_link(&link_rx_pt, t));
@@ -1111,14 +2080,14 @@ PT_THREAD(tsch_link_operation(struct rtimer *t, void *ptr))
     }
 
     /* End of slot operation, schedule next slot or resynchronize */
+#if TSCH_WITH_ENERGEST
+    energest_end_of_link();
+#endif /* TSCH_WITH_ENERGEST */
 
     /* Do we need to resynchronize? i.e., wait for EB again */
     if(!tsch_is_coordinator && (ASN_DIFF(current_asn, last_sync_asn) > TSCH_CLOCK_TO_SLOTS(TSCH_DESYNC_THRESHOLD))) {
-      TSCH_LOG_ADD(tsch_log_message,
-            snprintf(log->message, sizeof(log->message),
-                "! leaving the network, last sync %u\n",
-                          (unsigned)ASN_DIFF(current_asn, last_sync_asn));
-      );
+      TSCH_LOG_MESSAGE("! leaving the network, last sync %u",
+          (unsigned)ASN_DIFF(current_asn, last_sync_asn), 0, 0, 0);
       associated = 0;
       process_post(&tsch_process, PROCESS_EVENT_POLL, NULL);
     } else {
@@ -1126,38 +2095,76 @@ PT_THREAD(tsch_link_operation(struct rtimer *t, void *ptr))
       /* int32_t drift_correction_backup = drift_correction; */
       uint16_t timeslot_diff = 0;
       rtimer_clock_t prev_link_start;
+#if TSCH_WITH_DL_MISS_STATS
+      dl_miss_next_link = 1;
+#endif /* TSCH_WITH_DL_MISS_STATS */
       /* Schedule next wakeup skipping slots if missed deadline */
       do {
         if(current_link != NULL
+#if TSCH_BURST_MAX_LEN > 0
+            /* Burst timeslots are not part of the shared schedule */
+            && burst_role == BURST_NONE
+#endif /* TSCH_BURST_MAX_LEN > 0 */
             && current_link->link_options & LINK_OPTION_TX
             && current_link->link_options & LINK_OPTION_SHARED) {
           /* Decrement the backoff window for all neighbors able to transmit over
            * this Tx, Shared link. */
-          tsch_queue_update_all_backoff_windows(&current_link->addr);
+          tsch_queue_update_all_backoff_windows(tsch_schedule_get_link_addr(current_link));
         }
 
-        /* Get next active link */
-        current_link = tsch_schedule_get_next_active_link(&current_asn, &timeslot_diff);
-        if(current_link == NULL) {
-          /* There is no next link. Fall back to default
-           * behavior: wake up at the next timeslot. */
+#if TSCH_BURST_MAX_LEN > 0
+        burst_role = burst_link_scheduled;
+        burst_link_scheduled = BURST_NONE;
+        burst_count = burst_role != BURST_NONE ? burst_count + 1 : 0;
+        if(burst_role != BURST_NONE) {
+          /* Continue the burst on the current link, in the next timeslot.
+           * If we miss it, the burst is over. */
           timeslot_diff = 1;
+        } else
+#endif /* TSCH_BURST_MAX_LEN > 0 */
+        {
+          /* Get next active link */
+          current_link = tsch_schedule_get_next_active_link(&current_asn, &timeslot_diff);
+          if(current_link == NULL) {
+            /* There is no next link. Fall back to default
+             * behavior: wake up at the next timeslot. */
+            timeslot_diff = 1;
+          }
         }
         /* Update ASN */
         ASN_INC(current_asn, timeslot_diff);
         /* Time to next wake up */
         tsch_time_until_next_active_link = timeslot_diff * TsSlotDuration + drift_correction;
+#if TSCH_ADAPTIVE_TIMESYNC
+        /* Compensate for the learned clock skew */
+        tsch_time_until_next_active_link += tsch_timesync_adaptive_compensate(timeslot_diff * TsSlotDuration);
+#endif /* TSCH_ADAPTIVE_TIMESYNC */
         drift_correction = 0;
         drift_neighbor = NULL;
         /* Update current link start */
         prev_link_start = current_link_start;
         current_link_start += tsch_time_until_next_active_link;
       } while(!tsch_schedule_link_operation(t, prev_link_start, tsch_time_until_next_active_link, 1));
+#if TSCH_WITH_DL_MISS_STATS
+      dl_miss_next_link = 0;
+#endif /* TSCH_WITH_DL_MISS_STATS */
+#if TSCH_SCHEDULE_LOCK_FREE
+      /* We are done with the previous link. Links removed from the schedule before
+       * the above lookup can now be freed. */
+#if TSCH_BURST_MAX_LEN > 0
+      /* Unless we stay on it for a burst */
+      if(burst_role == BURST_NONE)
+#endif /* TSCH_BURST_MAX_LEN > 0 */
+      tsch_schedule_epoch++;
+#endif /* TSCH_SCHEDULE_LOCK_FREE */
 
       /* Drift correction monitoring */
       //PRINTF("TSCH: end of cell, drift correction: %d ticks, next wake up: %u slots\n", (int16_t)drift_correction_backup, timeslot_diff);
       /* Timing profiling of various parts of TSCH link operation */
       // PRINTF("TSCH: timing: TX_prepare %u, TX %u, TX_ack %u, post_TX %u, RX %u, RX_ack %u\n", t0prepare, t0tx, t0txack, t0post_tx, t0rx, t0rxack);
+#if TSCH_WITH_SLOT_PROFILER
+      slot_profile_end_of_link();
+#endif /* TSCH_WITH_SLOT_PROFILER */
       /* Reset time-profiling variables for next wake up */
       t0prepare=0; t0tx=0; t0txack=0; t0post_tx=0; t0rx=0; t0rxack=0;
       #if DEBUG_INJECT_DRIFT
@@ -1174,6 +2181,117 @@ PT_THREAD(tsch_link_operation(struct rtimer *t, void *ptr))
   PT_END(&link_operation_pt);
 }
 
+#if TSCH_ASSOCIATION_WINDOW
+/* EB sources heard during the association window */
+static struct association_candidate {
+  linkaddr_t addr;
+  uint16_t rank; /* RPL rank from the EB, 0 if none */
+  uint8_t join_priority;
+  int8_t rssi;
+} association_candidates[TSCH_ASSOCIATION_MAX_CANDIDATES];
+static uint8_t association_candidates_count;
+
+/* Is a a better time source than b? */
+static int
+association_candidate_is_better(const struct association_candidate *a,
+                                const struct association_candidate *b)
+{
+  if(a->join_priority != b->join_priority) {
+    return a->join_priority < b->join_priority;
+  }
+  /* The RPL rank is finer than the join priority derived from it */
+  if(a->rank != 0 && b->rank != 0 && a->rank != b->rank) {
+    return a->rank < b->rank;
+  }
+  return a->rssi > b->rssi;
+}
+/* Records an acceptable EB received elapsed after the start of the scan.
+ * Returns 1 if we should join from it */
+static int
+association_candidate_accept(const linkaddr_t *addr, uint8_t join_priority,
+                             uint16_t rank, int8_t rssi, clock_time_t elapsed)
+{
+  struct association_candidate c;
+  struct association_candidate *best;
+  int i;
+
+  linkaddr_copy(&c.addr, addr);
+  c.rank = rank;
+  c.join_priority = join_priority;
+  c.rssi = rssi;
+
+  /* Update the candidate table, replacing the worst entry if full */
+  for(i = 0; i < association_candidates_count; i++) {
+    if(linkaddr_cmp(&association_candidates[i].addr, addr)) {
+      break;
+    }
+  }
+  if(i == association_candidates_count) {
+    if(association_candidates_count < TSCH_ASSOCIATION_MAX_CANDIDATES) {
+      association_candidates_count++;
+    } else {
+      int j;
+      for(i = 0, j = 1; j < association_candidates_count; j++) {
+        if(association_candidate_is_better(&association_candidates[i], &association_candidates[j])) {
+          i = j;
+        }
+      }
+      if(!association_candidate_is_better(&c, &association_candidates[i])) {
+        i = -1;
+      }
+    }
+  }
+  if(i >= 0) {
+    association_candidates[i] = c;
+  }
+
+  if(join_priority == 0) {
+    /* EB from the coordinator, we can't get any better */
+    return 1;
+  }
+  if(elapsed < TSCH_ASSOCIATION_WINDOW) {
+    /* Keep listening */
+    return 0;
+  }
+  if(elapsed >= 2 * TSCH_ASSOCIATION_WINDOW) {
+    /* We were not able to hear the best source again, take any */
+    return 1;
+  }
+  /* Window over: synchronize to the best candidate at its next EB */
+  best = &association_candidates[0];
+  for(i = 1; i < association_candidates_count; i++) {
+    if(association_candidate_is_better(&association_candidates[i], best)) {
+      best = &association_candidates[i];
+    }
+  }
+  return linkaddr_cmp(&best->addr, addr);
+}
+#endif /* TSCH_ASSOCIATION_WINDOW */
+
+#if TSCH_PACKET_EB_WITH_SLOTFRAME_AND_LINK
+/* Install the cells announced in the EB we associate from, so that we can
+ * use the broadcast and shared cells of the network right away. Cells
+ * conflicting with our own schedule are skipped */
+static void
+install_eb_schedule(const struct tsch_eb_schedule *schedule)
+{
+  int i;
+  for(i = 0; i < schedule->num_cells; i++) {
+    const struct tsch_eb_cell *c = &schedule->cells[i];
+    struct tsch_slotframe *sf = tsch_schedule_get_slotframe_from_handle(c->slotframe_handle);
+    if(sf == NULL) {
+      sf = tsch_schedule_add_slotframe(c->slotframe_handle, c->slotframe_size);
+    }
+    if(sf != NULL && sf->size.val == c->slotframe_size
+        && c->timeslot < c->slotframe_size
+        && tsch_schedule_get_link_from_timeslot(sf, c->timeslot) == NULL) {
+      tsch_schedule_add_link(sf, c->link_options, LINK_TYPE_NORMAL,
+          &tsch_broadcast_address, c->timeslot, c->channel_offset);
+    }
+  }
+}
+#endif /* TSCH_PACKET_EB_WITH_SLOTFRAME_AND_LINK */
+
 /* Associate:
  * If we are a master, start right away.
  * Otherwise, wait for EBs to associate with a master
@@ -1184,6 +2302,9 @@ PT_THREAD(tsch_associate(struct pt *pt))
   PT_BEGIN(pt);
 
   ASN_INIT(current_asn, 0, 0);
+#if TSCH_WITH_TX_POWER_CONTROL
+  tx_power_supported = -1;
+#endif /* TSCH_WITH_TX_POWER_CONTROL */
 
   if(tsch_is_coordinator) {
     /* We are coordinator, start operating now */
@@ -1201,18 +2322,53 @@ PT_THREAD(tsch_associate(struct pt *pt))
   } else {
     static struct etimer associate_timer;
     static uint32_t base_channel;
+    /* Start of the scan, of the current channel dwell and of the current listen period */
+    static clock_time_t scan_start, dwell_start, listen_start;
+    static uint8_t listening;
     base_channel = random_rand();
-    etimer_set(&associate_timer, CLOCK_SECOND / 100);
+    scan_start = clock_time();
+    dwell_start = scan_start;
+    listening = 0;
+    memset(&association_stats, 0, sizeof(association_stats));
+    association_stats.channels_scanned = 1;
+#if TSCH_ASSOCIATION_WINDOW
+    association_candidates_count = 0;
+#endif /* TSCH_ASSOCIATION_WINDOW */
 
     while(!associated) {
       /* We are not coordinator, try to associate */
       rtimer_clock_t t0;
       int is_packet_pending = 0;
+      clock_time_t now = clock_time();
 
-      /* Hop to any channel offset */
-      hop_channel(&current_asn, base_channel + clock_seconds());
+      if(now - dwell_start >= TSCH_ASSOCIATION_CHANNEL_DWELL) {
+        /* Move on to the next channel offset */
+        base_channel++;
+        dwell_start = now;
+        association_stats.channels_scanned++;
+      }
+
+      if(now - dwell_start >= ASSOCIATION_LISTEN_DURATION) {
+        /* Duty-cycled scan: keep the radio off until the next dwell */
+        if(listening) {
+          off();
+          association_stats.radio_on_time += now - listen_start;
+          TSCH_ENERGEST_SCAN(now - listen_start);
+          listening = 0;
+        }
+        etimer_set(&associate_timer, dwell_start + TSCH_ASSOCIATION_CHANNEL_DWELL - now);
+        PT_WAIT_UNTIL(pt, etimer_expired(&associate_timer));
+        continue;
+      }
+
+      /* Hop to the channel offset of this dwell */
+      hop_channel(&current_asn, base_channel);
 
       /* Turn radio on and wait for EB */
+      if(!listening) {
+        listen_start = now;
+        listening = 1;
+      }
       NETSTACK_RADIO_radio_raw_rx_on();
 
       /* Busy wait for a packet for 1 second */
@@ -1227,6 +2383,16 @@ PT_THREAD(tsch_associate(struct pt *pt))
 
       if(is_packet_pending) {
         linkaddr_t source_address;
+        struct tsch_timeslot_timing eb_timing;
+        struct tsch_eb_hopping_sequence eb_hopping;
+        struct tsch_eb_minimal_schedule eb_minimal;
+        struct tsch_eb_rpl_info eb_rpl;
+#if TSCH_PACKET_EB_WITH_SLOTFRAME_AND_LINK
+        struct tsch_eb_schedule eb_schedule;
+#define EB_SCHEDULE &eb_schedule
+#else /* TSCH_PACKET_EB_WITH_SLOTFRAME_AND_LINK */
+#define EB_SCHEDULE NULL
+#endif /* TSCH_PACKET_EB_WITH_SLOTFRAME_AND_LINK */
         int eb_parsed = 0;
 
         /* Save packet timestamp */
@@ -1238,11 +2404,15 @@ PT_THREAD(tsch_associate(struct pt *pt))
 
         /* Read packet */
         input_eb.len = NETSTACK_RADIO.read(input_eb.payload, TSCH_MAX_PACKET_LEN);
+        association_stats.frames_received++;
 
         if(input_eb.len != 0) {
           /* Parse EB and extract ASN and join priority */
           eb_parsed = tsch_parse_eb(input_eb.payload, input_eb.len,
-              &source_address, &current_asn, &tsch_join_priority);
+              &source_address, &current_asn, &tsch_join_priority, &eb_timing, EB_SCHEDULE, &eb_hopping, &eb_minimal, &eb_rpl);
+          if(eb_parsed != 0) {
+            association_stats.ebs_parsed++;
+          }
         }
 
 #if TSCH_CHECK_TIME_AT_ASSOCIATION > 0
@@ -1259,6 +2429,34 @@ PT_THREAD(tsch_associate(struct pt *pt))
         }
 #endif
 
+#if TSCH_ASSOCIATION_WINDOW
+        if(eb_parsed != 0 && tsch_join_priority < TSCH_MAX_JOIN_PRIORITY) {
+          extern signed char radio_last_rssi;
+          if(!association_candidate_accept(&source_address, tsch_join_priority, eb_rpl.rank,
+                radio_last_rssi + RSSI_CORRECTION_CONSTANT, clock_time() - scan_start)) {
+            /* Not joining from this EB, keep scanning */
+            eb_parsed = 0;
+          }
+        }
+#endif /* TSCH_ASSOCIATION_WINDOW */
+
+        if(eb_parsed != 0 && tsch_join_priority < TSCH_MAX_JOIN_PRIORITY
+            && !tsch_set_timeslot_timing(&eb_timing)) {
+          /* The announced timeslot template does not work with our radio */
+          eb_parsed = 0;
+        }
+
+        if(eb_parsed != 0 && tsch_join_priority < TSCH_MAX_JOIN_PRIORITY
+            && !tsch_set_hopping_sequence(eb_hopping.len > 0 ? eb_hopping.channels : NULL,
+                                          eb_hopping.len)) {
+          /* The announced hopping sequence is not valid */
+          eb_parsed = 0;
+        }
+        if(eb_parsed != 0 && eb_hopping.next.len != 0) {
+          /* A change is scheduled, follow it. Not associated yet: no lock needed */
+          tsch_next_hopping_sequence = eb_hopping.next;
+        }
+
         if(eb_parsed != 0 && tsch_join_priority < TSCH_MAX_JOIN_PRIORITY) {
           struct tsch_neighbor *n;
 
@@ -1266,8 +2464,31 @@ PT_THREAD(tsch_associate(struct pt *pt))
           n = tsch_queue_add_nbr(&source_address);
 
           if(n != NULL) {
+#if TSCH_ASSOCIATION_WINDOW
+            int i;
+            /* Add the other candidates as well, for the upper layer to pick
+             * a different parent if it wants to */
+            for(i = 0; i < association_candidates_count; i++) {
+              tsch_queue_add_nbr(&association_candidates[i].addr);
+            }
+#endif /* TSCH_ASSOCIATION_WINDOW */
             tsch_queue_update_time_source(&source_address);
 
+#if TSCH_PACKET_EB_WITH_SLOTFRAME_AND_LINK
+            install_eb_schedule(&eb_schedule);
+#endif /* TSCH_PACKET_EB_WITH_SLOTFRAME_AND_LINK */
+
+            /* If we run a minimal schedule, use the cells of the network */
+            if(tsch_schedule_minimal_cells() != 0) {
+              uint8_t num_cells = eb_minimal.num_cells != 0 ? eb_minimal.num_cells : TSCH_SCHEDULE_MINIMAL_CELLS;
+              if(num_cells != tsch_schedule_minimal_cells()) {
+                tsch_schedule_create_minimal_cells(num_cells);
+              }
+              if(eb_minimal.next.num_cells != 0) {
+                tsch_schedule_minimal_change(eb_minimal.next.num_cells, &eb_minimal.next.asn);
+              }
+            }
+
             /* Use this ASN as "last synchronization ASN" */
             last_sync_asn = current_asn;
             tsch_schedule_keepalive();
@@ -1298,8 +2519,11 @@ PT_THREAD(tsch_associate(struct pt *pt))
       if(associated) {
         /* End of association turn the radio off */
         off();
+        association_stats.radio_on_time += clock_time() - listen_start;
+        TSCH_ENERGEST_SCAN(clock_time() - listen_start);
+        association_stats.join_time = clock_time() - scan_start;
       } else {
-        etimer_reset(&associate_timer);
+        etimer_set(&associate_timer, TSCH_ASSOCIATION_POLL_INTERVAL);
         PT_WAIT_UNTIL(pt, etimer_expired(&associate_timer));
       }
     }
@@ -1329,6 +2553,13 @@ PROCESS_THREAD(tsch_process, ev, data)
 
     association_time = clock_seconds();
     tsch_current_eb_period = TSCH_MIN_EB_PERIOD;
+#if TSCH_ADAPTIVE_EB_PERIOD
+    /* Start at the minimum period for a window, as we just joined */
+    adaptive_eb_heard = 0;
+    adaptive_eb_heard_avg = 0;
+    adaptive_eb_window_start = clock_time();
+    adaptive_eb_boost = 1;
+#endif /* TSCH_ADAPTIVE_EB_PERIOD */
 
     /* TODO: make queues and data structures
      * from received EB */
@@ -1336,6 +2567,10 @@ PROCESS_THREAD(tsch_process, ev, data)
     PRINTF("TSCH: scheduling initial link operation: asn-%x.%lx, start: %u, now: %u\n", current_asn.ms1b, current_asn.ls4b, current_link_start, RTIMER_NOW());
 
     /* Schedule next slot */
+#if TSCH_WITH_DL_MISS_STATS
+    dl_miss_next_link = 1;
+    dl_miss_phase = TSCH_SLOT_PHASE_COUNT;
+#endif /* TSCH_WITH_DL_MISS_STATS */
     do {
       uint16_t timeslot_diff;
       /* Get next active link */
@@ -1344,10 +2579,16 @@ PROCESS_THREAD(tsch_process, ev, data)
       ASN_INC(current_asn, timeslot_diff);
       /* Time to next wake up */
       tsch_time_until_next_active_link = timeslot_diff * TsSlotDuration;
+#if TSCH_ADAPTIVE_TIMESYNC
+      tsch_time_until_next_active_link += tsch_timesync_adaptive_compensate(timeslot_diff * TsSlotDuration);
+#endif /* TSCH_ADAPTIVE_TIMESYNC */
       /* Update current link start */
       prev_link_start = current_link_start;
       current_link_start += tsch_time_until_next_active_link;
     } while(!tsch_schedule_link_operation(&link_operation_timer, prev_link_start, tsch_time_until_next_active_link, 1));
+#if TSCH_WITH_DL_MISS_STATS
+    dl_miss_next_link = 0;
+#endif /* TSCH_WITH_DL_MISS_STATS */
 
     PROCESS_YIELD_UNTIL(!associated);
 
@@ -1370,6 +2611,21 @@ PROCESS_THREAD(tsch_pending_events_process, ev, data)
     tsch_rx_process_pending();
     tsch_tx_process_pending();
     tsch_log_process_pending();
+    if(hopping_sequence_changed) {
+      hopping_sequence_changed = 0;
+      tsch_packet_eb_template_invalidate();
+      LOG("TSCH: switched to a hopping sequence of %u channels\n", hopping_sequence_length.val);
+    }
+    if(minimal_change_due) {
+      uint8_t num_cells = minimal_change_due;
+      minimal_change_due = 0;
+      if(tsch_schedule_create_minimal_cells(num_cells)) {
+        LOG("TSCH: switched to a minimal schedule of %u cells\n", num_cells);
+      } else {
+        /* Not announced anymore */
+        tsch_packet_eb_template_invalidate();
+      }
+    }
   }
   PROCESS_END();
 }
@@ -1382,8 +2638,36 @@ tsch_tx_process_pending()
   /* Loop on accessing (without removing) a pending input packet */
   while((dequeued_index = ringbufindex_peek_get(&dequeued_ringbuf)) != -1) {
     struct tsch_packet *p = dequeued_array[dequeued_index];
+#if TSCH_QUEUE_ANYCAST_NOACK
+    if(p->anycast) {
+      p->anycast = 0;
+      if(tsch_queue_anycast(p)) {
+        /* Not done yet, the callback comes later */
+        ringbufindex_get(&dequeued_ringbuf);
+        continue;
+      }
+    }
+#endif /* TSCH_QUEUE_ANYCAST_NOACK */
     /* Put packet into packetbuf for packet_sent callback */
     queuebuf_to_packetbuf(p->qb);
+#if TSCH_PACKET_WITH_ACK_HINTS && defined(TSCH_CALLBACK_ACK_HINTS_RECEIVED)
+    if(p->has_ack_hints) {
+      TSCH_CALLBACK_ACK_HINTS_RECEIVED(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &p->ack_hints);
+    }
+#endif /* TSCH_PACKET_WITH_ACK_HINTS && defined(TSCH_CALLBACK_ACK_HINTS_RECEIVED) */
+#if TSCH_PACKET_WITH_NACK_LINK
+    if(p->nack_link != TSCH_PACKET_NO_NACK) {
+      TSCH_CALLBACK_NACK_RECEIVED(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), p->nack_link);
+    }
+#endif /* TSCH_PACKET_WITH_NACK_LINK */
+#if TSCH_WITH_LINK_ESTIMATOR
+    if(!linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &linkaddr_null)
+       && !linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &tsch_broadcast_address)) {
+      /* Update the estimate first, so that upper layers see it from the callback */
+      tsch_link_estimator_packet_sent(packetbuf_addr(PACKETBUF_ADDR_RECEIVER),
+                                      p->ret, p->transmissions, p->noack_channels, p->ack_channel);
+    }
+#endif /* TSCH_WITH_LINK_ESTIMATOR */
     /* Call packet_sent callback */
     mac_call_sent_callback(p->sent, p->ptr, p->ret, p->transmissions);
     /* Free packet queuebuf */
@@ -1403,7 +2687,14 @@ tsch_rx_process_pending()
   /* Loop on accessing (without removing) a pending input packet */
   while((input_index = ringbufindex_peek_get(&input_ringbuf)) != -1) {
     struct input_packet *current_input = &input_array[input_index];
-    int is_data = (tsch_packet_parse_frame_type(current_input->payload, current_input->len, NULL) & IS_DATA) != 0;
+    int is_data = (current_input->hdr.flags & IS_DATA) != 0;
+#if TSCH_RX_REUSE_HEADER && !RADIO_PARSE_MAC_HW
+    struct tsch_packet_header hdr;
+#endif
+#if TSCH_WITH_LINK_ESTIMATOR
+    tsch_link_estimator_packet_received(&current_input->hdr.source_address,
+                                        (int16_t)current_input->rssi);
+#endif /* TSCH_WITH_LINK_ESTIMATOR */
     if(is_data) {
       /* Skip EBs and other control messages */
       /* Copy to packetbuf for processing by upper layers */
@@ -1413,18 +2704,39 @@ tsch_rx_process_pending()
        * (and skip SW parser) */
 #if RADIO_PARSE_MAC_HW
       micromac_copy_mac_frame_to_packetbuf(current_input->payload);
+#elif TSCH_RX_ZERO_COPY
+      packetbuf_reference(current_input->payload, current_input->len);
 #else
       packetbuf_copyfrom(current_input->payload, current_input->len);
 #endif
       packetbuf_set_attr(PACKETBUF_ATTR_RSSI, current_input->rssi);
+#if TSCH_RX_REUSE_HEADER && !RADIO_PARSE_MAC_HW
+      /* Keep the header: the ringbuf entry may be reused once removed */
+      hdr = current_input->hdr;
+#endif
     }
 
+#if TSCH_RX_ZERO_COPY && !RADIO_PARSE_MAC_HW
+    /* Referenced data packets are removed only once processed, see below */
+    if(!is_data)
+#endif
     /* Remove input from ringbuf */
     ringbufindex_get(&input_ringbuf);
 
     if(is_data) {
       /* Pass to upper layers */
+#if TSCH_RX_REUSE_HEADER && !RADIO_PARSE_MAC_HW
+      input_header = &hdr;
+      packet_input();
+      input_header = NULL;
+#else
       packet_input();
+#endif
+#if TSCH_RX_ZERO_COPY && !RADIO_PARSE_MAC_HW
+      /* Make sure nothing references the ringbuf entry anymore and release it */
+      packetbuf_clear();
+      ringbufindex_get(&input_ringbuf);
+#endif
     } else {
       /* LOG("TSCH: EB received\n"); */
       linkaddr_t source_address;
@@ -1433,8 +2745,22 @@ tsch_rx_process_pending()
       /* Verify incoming EB (does its ASN match our Rx time?),
        * and update our join priority. */
 
+      struct tsch_eb_hopping_sequence eb_hopping;
+      struct tsch_eb_minimal_schedule eb_minimal;
+      struct tsch_eb_rpl_info eb_rpl;
       if(tsch_parse_eb(current_input->payload, current_input->len,
-                    &source_address, &eb_asn, &eb_join_priority)) {
+                    &source_address, &eb_asn, &eb_join_priority, NULL, NULL, &eb_hopping, &eb_minimal, &eb_rpl)) {
+#if TSCH_WITH_LINK_ESTIMATOR
+        tsch_link_estimator_eb_received(&source_address, &current_input->rx_asn);
+#endif /* TSCH_WITH_LINK_ESTIMATOR */
+#ifdef TSCH_CALLBACK_EB_RPL_INFO_RECEIVED
+        if(eb_rpl.rank != 0) {
+          TSCH_CALLBACK_EB_RPL_INFO_RECEIVED(&source_address, &eb_rpl);
+        }
+#endif /* TSCH_CALLBACK_EB_RPL_INFO_RECEIVED */
+#if TSCH_ADAPTIVE_EB_PERIOD
+        adaptive_eb_heard++;
+#endif /* TSCH_ADAPTIVE_EB_PERIOD */
 
 #if TSCH_EB_AUTOSELECT
         if(!tsch_is_coordinator) {
@@ -1493,6 +2819,23 @@ tsch_rx_process_pending()
             LOG("TSCH: corrected ASN by %ld\n", asn_diff);
           }
 
+          /* Follow the hopping sequence change announced by our time source */
+          if(eb_hopping.next.len != 0
+              && (eb_hopping.next.len != tsch_next_hopping_sequence.len
+                  || ASN_DIFF(eb_hopping.next.asn, tsch_next_hopping_sequence.asn) != 0
+                  || memcmp(eb_hopping.next.channels, tsch_next_hopping_sequence.channels,
+                            eb_hopping.next.len) != 0)) {
+            tsch_schedule_hopping_sequence(eb_hopping.next.channels, eb_hopping.next.len,
+                &eb_hopping.next.asn);
+          }
+          /* Same for the minimal schedule, unless the EB is older than the change */
+          if(eb_minimal.next.num_cells != 0
+              && (int32_t)ASN_DIFF(eb_minimal.next.asn, current_asn) > 0
+              && (eb_minimal.next.num_cells != tsch_next_minimal_change.num_cells
+                  || ASN_DIFF(eb_minimal.next.asn, tsch_next_minimal_change.asn) != 0)) {
+            tsch_schedule_minimal_change(eb_minimal.next.num_cells, &eb_minimal.next.asn);
+          }
+
           /* Update join priority */
           if(eb_join_priority < TSCH_MAX_JOIN_PRIORITY) {
             if(tsch_join_priority != eb_join_priority + 1) {
@@ -1513,6 +2856,204 @@ tsch_rx_process_pending()
   }
 }
 
+/* Is a timeslot template consistent with our radio and frame durations? */
+static int
+timeslot_timing_is_valid(const struct tsch_timeslot_timing *timing)
+{
+  return timing->cca_offset + timing->cca + delayTx <= timing->tx_offset
+      /* Room to wake up before the Rx guard times */
+      && timing->tx_offset > TsLongGT + delayRx + RTIMER_MIN_DELAY
+      && timing->tx_ack_delay > TsShortGT + delayRx + RTIMER_MIN_DELAY
+      /* The longest frame and its ACK fit in the timeslot */
+      && (uint32_t)timing->tx_offset + TSCH_DATA_MAX_DURATION + timing->tx_ack_delay
+          + TsShortGT + TSCH_ACK_MAX_DURATION < timing->slot_duration;
+}
+
+int
+tsch_set_timeslot_timing(const struct tsch_timeslot_timing *timing)
+{
+  if(associated || !timeslot_timing_is_valid(timing)) {
+    return 0;
+  }
+  tsch_timing = *timing;
+  tsch_packet_eb_template_invalidate();
+  return 1;
+}
+
+static int
+hopping_sequence_is_valid(const uint8_t *sequence, uint8_t len)
+{
+  int i;
+  if(len == 0 || len > TSCH_HOPPING_SEQUENCE_MAX_LEN) {
+    return 0;
+  }
+  for(i = 0; i < len; i++) {
+    if(sequence[i] < 11 || sequence[i] > 26) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+int
+tsch_set_hopping_sequence(const uint8_t *sequence, uint8_t len)
+{
+  if(associated) {
+    return 0;
+  }
+  if(sequence == NULL) {
+    sequence = default_hopping_sequence;
+    len = DEFAULT_HOPPING_SEQUENCE_LEN;
+  }
+  if(!hopping_sequence_is_valid(sequence, len)) {
+    return 0;
+  }
+  memcpy(hopping_sequence_list, sequence, len);
+  ASN_DIVISOR_INIT(hopping_sequence_length, len);
+  ASN_CURSOR_RESET(hopping_cursor);
+  tsch_next_hopping_sequence.len = 0;
+  tsch_packet_eb_template_invalidate();
+  return 1;
+}
+
+int
+tsch_schedule_hopping_sequence(const uint8_t *sequence, uint8_t len, const struct asn_t *asn)
+{
+  if(!hopping_sequence_is_valid(sequence, len)) {
+    return 0;
+  }
+  /* The link operation reads the change */
+  if(!tsch_get_lock()) {
+    return 0;
+  }
+  memcpy(tsch_next_hopping_sequence.channels, sequence, len);
+  tsch_next_hopping_sequence.asn = *asn;
+  tsch_next_hopping_sequence.len = len;
+  tsch_release_lock();
+  tsch_packet_eb_template_invalidate();
+  return 1;
+}
+
+int
+tsch_schedule_minimal_change(uint8_t num_cells, const struct asn_t *asn)
+{
+  if(num_cells == 0 || tsch_schedule_minimal_cells() == 0) {
+    return 0;
+  }
+  /* The link operation reads the change */
+  if(!tsch_get_lock()) {
+    return 0;
+  }
+  tsch_next_minimal_change.asn = *asn;
+  tsch_next_minimal_change.num_cells = num_cells;
+  tsch_release_lock();
+  tsch_packet_eb_template_invalidate();
+  return 1;
+}
+
+const struct tsch_channel_stats *
+tsch_get_channel_stats(uint8_t channel)
+{
+#if TSCH_WITH_CHANNEL_STATS
+  if(channel >= 11 && channel <= 26) {
+    return &channel_stats[channel - 11];
+  }
+#endif /* TSCH_WITH_CHANNEL_STATS */
+  return NULL;
+}
+
+void
+tsch_reset_channel_stats(void)
+{
+#if TSCH_WITH_CHANNEL_STATS
+  memset(channel_stats, 0, sizeof(channel_stats));
+#endif /* TSCH_WITH_CHANNEL_STATS */
+}
+
+#if TSCH_CHANNEL_BLACKLIST
+/* Coordinator only: remove from the default sequence the channels our unicast
+ * transmissions fail on, and schedule the switch to the new sequence.
+ * Called every TSCH_CHANNEL_BLACKLIST_PERIOD */
+static void
+channel_blacklist_update(void)
+{
+  /* Number of periods since we last changed the sequence */
+  static uint8_t periods;
+  uint8_t sequence[TSCH_HOPPING_SEQUENCE_MAX_LEN];
+  uint8_t len = 0;
+  uint8_t distinct = 0;
+  uint32_t in_use = 0;
+  uint32_t blacklist = 0;
+  uint32_t seen = 0;
+  struct asn_t activation_asn;
+  int i;
+
+  if(tsch_next_hopping_sequence.len != 0) {
+    /* The previous change did not happen yet */
+    return;
+  }
+  for(i = 0; i < hopping_sequence_length.val; i++) {
+    in_use |= (uint32_t)1 << hopping_sequence_list[i];
+  }
+  for(i = 11; i <= 26; i++) {
+    const struct tsch_channel_stats *s = &channel_stats[i - 11];
+    if(!(in_use & ((uint32_t)1 << i))) {
+      /* Blacklisted, keep it so until it is time to try it again */
+      if(periods < TSCH_CHANNEL_BLACKLIST_LIFETIME) {
+        blacklist |= (uint32_t)1 << i;
+      }
+    } else if(s->tx >= TSCH_CHANNEL_BLACKLIST_MIN_TX
+        && (uint32_t)s->tx_ok * 100 < (uint32_t)s->tx * TSCH_CHANNEL_BLACKLIST_PDR_THRESHOLD) {
+      blacklist |= (uint32_t)1 << i;
+    }
+  }
+  tsch_reset_channel_stats();
+  if(periods < 0xff) {
+    periods++;
+  }
+
+  /* The new sequence: the default one, without the blacklisted channels */
+  for(i = 0; i < DEFAULT_HOPPING_SEQUENCE_LEN; i++) {
+    uint32_t bit = (uint32_t)1 << default_hopping_sequence[i];
+    if(!(blacklist & bit)) {
+      sequence[len++] = default_hopping_sequence[i];
+      if(!(seen & bit)) {
+        seen |= bit;
+        distinct++;
+      }
+    }
+  }
+  if(distinct < TSCH_CHANNEL_BLACKLIST_MIN_CHANNELS
+      || (len == hopping_sequence_length.val
+          && memcmp(sequence, hopping_sequence_list, len) == 0)) {
+    /* Too few channels left, or no change */
+    return;
+  }
+  activation_asn = current_asn;
+  ASN_INC(activation_asn, TSCH_CHANNEL_BLACKLIST_ACTIVATION_DELAY
+      * (RTIMER_SECOND / TsSlotDuration));
+  if(tsch_schedule_hopping_sequence(sequence, len, &activation_asn)) {
+    periods = 0;
+    LOG("TSCH: blacklisting, %u channels from asn-%x.%lx\n",
+        distinct, activation_asn.ms1b, activation_asn.ls4b);
+  }
+}
+#endif /* TSCH_CHANNEL_BLACKLIST */
+
+uint32_t
+tsch_get_asn_ls4b(void)
+{
+  return associated ? current_asn.ls4b : 0;
+}
+
+int
+tsch_hopping_sequence_is_default(void)
+{
+  return hopping_sequence_length.val == DEFAULT_HOPPING_SEQUENCE_LEN
+      && memcmp(hopping_sequence_list, default_hopping_sequence,
+                DEFAULT_HOPPING_SEQUENCE_LEN) == 0;
+}
+
 void
 tsch_set_eb_period(uint32_t period)
 {
@@ -1528,10 +3069,126 @@ tsch_set_eb_period(uint32_t period)
   }
 }
 
+/* Set a fixed EB period, overriding the one set by RPL or adapted.
+ * 0 to go back to the latter */
+void
+tsch_set_fixed_eb_period(clock_time_t period)
+{
+  tsch_fixed_eb_period = period != 0 ? MAX(period, CLOCK_SECOND) : 0;
+}
+
+/* The period at which EBs are currently sent */
+clock_time_t
+tsch_get_eb_period(void)
+{
+  return EB_PERIOD();
+}
+
+/* Set the keepalive timeout, at least one second. The next keepalive is
+ * rescheduled accordingly */
+void
+tsch_set_keepalive_timeout(clock_time_t timeout)
+{
+  tsch_keepalive_timeout = MAX(timeout, CLOCK_SECOND);
+  if(associated && !tsch_is_coordinator) {
+    tsch_schedule_keepalive();
+  }
+}
+
+/* The keepalive timeout */
+clock_time_t
+tsch_get_keepalive_timeout(void)
+{
+  return tsch_keepalive_timeout;
+}
+
+#if TSCH_ADAPTIVE_EB_PERIOD
+/* Shortest EB period that uses at most half of our EB Tx cells: twice the
+ * cycle of advertising Tx links. 0 if there are none */
+static clock_time_t
+adaptive_eb_min_period(void)
+{
+  struct tsch_slotframe *sf;
+  struct tsch_link *l;
+  clock_time_t min_period = 0;
+  uint32_t slot_ms = TsSlotDuration / (RTIMER_SECOND / 1000);
+
+  for(sf = tsch_schedule_slotframe_head(); sf != NULL; sf = tsch_schedule_slotframe_next(sf)) {
+    int count = 0;
+    for(l = list_head(sf->links_list); l != NULL; l = list_item_next(l)) {
+      if(l->link_type != LINK_TYPE_NORMAL && (l->link_options & LINK_OPTION_TX)) {
+        count++;
+      }
+    }
+    if(count > 0) {
+      clock_time_t period = 2 * (uint32_t)sf->size.val * slot_ms * CLOCK_SECOND / 1000 / count;
+      if(min_period == 0 || period < min_period) {
+        min_period = period;
+      }
+    }
+  }
+  return min_period;
+}
+
+/* Adaptive EB period: at the end of every window, pick the period that,
+ * added to the EBs we hear, gives a joiner (listening on one channel of
+ * the hopping sequence) an EB within TSCH_ADAPTIVE_EB_JOIN_LATENCY */
+static void
+adaptive_eb_period_update(void)
+{
+  uint32_t target;
+  uint32_t period;
+
+  if(clock_time() - adaptive_eb_window_start < TSCH_ADAPTIVE_EB_WINDOW) {
+    return;
+  }
+  adaptive_eb_window_start = clock_time();
+  adaptive_eb_heard_avg = (adaptive_eb_heard_avg + adaptive_eb_heard) / 2;
+  adaptive_eb_heard = 0;
+
+  /* EBs needed in a window from all neighbors together */
+  target = (uint32_t)TSCH_ADAPTIVE_EB_WINDOW * hopping_sequence_length.val / TSCH_ADAPTIVE_EB_JOIN_LATENCY;
+  if(adaptive_eb_boost > 0) {
+    adaptive_eb_boost--;
+    period = TSCH_MIN_EB_PERIOD;
+  } else if(adaptive_eb_heard_avg >= target) {
+    period = TSCH_MAX_EB_PERIOD;
+  } else {
+    period = TSCH_ADAPTIVE_EB_WINDOW / (target - adaptive_eb_heard_avg);
+  }
+  period = MAX(period, adaptive_eb_min_period());
+  period = MAX(period, TSCH_MIN_EB_PERIOD);
+  period = MIN(period, TSCH_MAX_EB_PERIOD);
+  if(period != tsch_current_eb_period) {
+    PRINTF("TSCH: EB period %lu, heard %u, target %lu\n",
+           (unsigned long)period, adaptive_eb_heard_avg, (unsigned long)target);
+  }
+  tsch_current_eb_period = period;
+}
+
+/* Adaptive EB period: report that joiners may be around, e.g. upon a
+ * Trickle reset. EBs are sent at TSCH_MIN_EB_PERIOD for a window */
+void
+tsch_adaptive_eb_joiner_hint(void)
+{
+  adaptive_eb_boost = 1;
+  adaptive_eb_window_start = clock_time();
+  if(tsch_current_eb_period > TSCH_MIN_EB_PERIOD) {
+    tsch_current_eb_period = TSCH_MIN_EB_PERIOD;
+    adaptive_eb_restart = 1;
+    process_poll(&tsch_send_eb_process);
+  }
+}
+#endif /* TSCH_ADAPTIVE_EB_PERIOD */
+
 /* A periodic process to send TSCH Enhanced Beacons (EB) */
 PROCESS_THREAD(tsch_send_eb_process, ev, data)
 {
   static struct etimer eb_timer;
+#if TSCH_CHANNEL_BLACKLIST
+  /* Last evaluation of the channel blacklist */
+  static clock_time_t blacklist_time;
+#endif /* TSCH_CHANNEL_BLACKLIST */
 
   PROCESS_BEGIN();
 
@@ -1544,7 +3201,7 @@ PROCESS_THREAD(tsch_send_eb_process, ev, data)
 
   /* Set an initial delay except for coordinator, which should send an EB asap */
   if(!tsch_is_coordinator) {
-    etimer_set(&eb_timer, random_rand() % tsch_current_eb_period);
+    etimer_set(&eb_timer, random_rand() % EB_PERIOD());
     PROCESS_WAIT_UNTIL(etimer_expired(&eb_timer));
   }
 
@@ -1574,15 +3231,58 @@ PROCESS_THREAD(tsch_send_eb_process, ev, data)
         }
       }
     }
+#if TSCH_CHANNEL_BLACKLIST
+    if(associated && tsch_is_coordinator
+        && clock_time() - blacklist_time >= TSCH_CHANNEL_BLACKLIST_PERIOD) {
+      blacklist_time = clock_time();
+      channel_blacklist_update();
+    }
+#endif /* TSCH_CHANNEL_BLACKLIST */
+#if TSCH_ADAPTIVE_EB_PERIOD
+    adaptive_eb_period_update();
+#endif /* TSCH_ADAPTIVE_EB_PERIOD */
     /* Next EB transmission with a random delay
-     * within [tsch_current_eb_period*0.9, tsch_current_eb_period[ */
-    delay = (tsch_current_eb_period - tsch_current_eb_period/10)
-        + random_rand() % (tsch_current_eb_period/10);
+     * within [EB_PERIOD()*0.9, EB_PERIOD()[ */
+    delay = (EB_PERIOD() - EB_PERIOD()/10)
+        + random_rand() % (EB_PERIOD()/10);
     etimer_set(&eb_timer, delay);
+#if TSCH_ADAPTIVE_EB_PERIOD
+    PROCESS_WAIT_UNTIL(etimer_expired(&eb_timer) || adaptive_eb_restart);
+    if(adaptive_eb_restart) {
+      /* The period was shortened: send the next EB within the new period */
+      adaptive_eb_restart = 0;
+      etimer_set(&eb_timer, random_rand() % EB_PERIOD());
+      PROCESS_WAIT_UNTIL(etimer_expired(&eb_timer));
+    }
+#else /* TSCH_ADAPTIVE_EB_PERIOD */
     PROCESS_WAIT_UNTIL(etimer_expired(&eb_timer));
+#endif /* TSCH_ADAPTIVE_EB_PERIOD */
   }
   PROCESS_END();
 }
+/* Short name of a phase of link operation, for printing */
+const char *
+tsch_slot_phase_name(enum tsch_slot_phase phase)
+{
+  return phase < TSCH_SLOT_PHASE_COUNT ? slot_phase_names[phase] : "none";
+}
+/*---------------------------------------------------------------------------*/
+/* Get the incoming packet ringbuf counters */
+const struct tsch_rx_ring_stats *
+tsch_get_rx_ring_stats(void)
+{
+  rx_ring_stats.full = ringbufindex_overflows(&input_ringbuf);
+  rx_ring_stats.max_used = ringbufindex_high_watermark(&input_ringbuf);
+  return &rx_ring_stats;
+}
+/*---------------------------------------------------------------------------*/
+/* Get the cost of the last association (or of the scan in progress) */
+const struct tsch_association_stats *
+tsch_get_association_stats(void)
+{
+  return &association_stats;
+}
+/*---------------------------------------------------------------------------*/
 /* Brief dump of the TSCH state */
 void
 tsch_dump_status()
@@ -1593,8 +3293,192 @@ tsch_dump_status()
       current_link != NULL ? current_link->slotframe_handle : 0xffff,
           current_link != NULL ? current_link->channel_offset : 0xffff
   );
+  tsch_get_rx_ring_stats();
+  printf("TSCH-rx-ring %lu %u %u/%u\n",
+      (unsigned long)rx_ring_stats.received, rx_ring_stats.full,
+      rx_ring_stats.max_used, TSCH_MAX_INCOMING_PACKETS);
+  printf("TSCH-dequeued-ring %u %u/%u\n",
+      ringbufindex_overflows(&dequeued_ringbuf),
+      ringbufindex_high_watermark(&dequeued_ringbuf), DEQUEUED_ARRAY_SIZE);
+  printf("TSCH-association %lu %lu %u %u %u\n",
+      (unsigned long)association_stats.join_time, (unsigned long)association_stats.radio_on_time,
+      association_stats.channels_scanned, association_stats.frames_received,
+      association_stats.ebs_parsed);
+#if TSCH_ADAPTIVE_TIMESYNC
+  printf("TSCH-timesync drift %ld ppm\n", tsch_timesync_get_drift_ppm());
+#endif /* TSCH_ADAPTIVE_TIMESYNC */
+#if TSCH_WITH_SLOT_PROFILER
+  if(slot_profile_last_valid) {
+    int i, j;
+    /* Budgets the phases have to fit in, and the histogram resolution */
+    printf("TSCH-profile budget %lu %lu %lu %lu\n",
+        (unsigned long)TsTxOffset, (unsigned long)TsTxAckDelay,
+        (unsigned long)TsSlotDuration, (unsigned long)SLOT_PROFILE_BUCKET_WIDTH);
+    for(i = 0; i < TSCH_SLOT_PHASE_COUNT; i++) {
+      struct tsch_slot_profile *p = &slot_profile_last[i];
+      printf("TSCH-profile %s %u %lu %lu %lu |",
+          slot_phase_names[i], p->count,
+          (unsigned long)p->min, (unsigned long)p->max,
+          p->count ? (unsigned long)(p->sum / p->count) : 0UL);
+      for(j = 0; j < TSCH_SLOT_PROFILER_BUCKETS; j++) {
+        printf(" %u", p->hist[j]);
+      }
+      printf("\n");
+    }
+  }
+#endif /* TSCH_WITH_SLOT_PROFILER */
+#if TSCH_WITH_DL_MISS_STATS
+  {
+    int i;
+    struct tsch_dl_miss m;
+    printf("TSCH-dl-miss %lu %lu | %u %u %u %u |",
+        (unsigned long)dl_miss_stats.total, (unsigned long)dl_miss_stats.skipped,
+        dl_miss_stats.per_link_type[0], dl_miss_stats.per_link_type[1],
+        dl_miss_stats.per_link_type[2], dl_miss_stats.per_link_type[3]);
+    for(i = 0; i <= TSCH_SLOT_PHASE_COUNT; i++) {
+      printf(" %u", dl_miss_stats.per_phase[i]);
+    }
+    printf(" |");
+    for(i = 0; i < TSCH_DL_MISS_MAX_SLOTFRAMES && dl_miss_stats.per_slotframe[i].count; i++) {
+      printf(" %u:%u", dl_miss_stats.per_slotframe[i].handle, dl_miss_stats.per_slotframe[i].count);
+    }
+    printf(" other:%u\n", dl_miss_stats.other_slotframes);
+    for(i = 0; tsch_dl_miss_get_last(i, &m); i++) {
+      printf("TSCH-dl-miss-log %x.%lx sf %u ts %u type %u phase %u skip %u late %lu\n",
+          m.asn.ms1b, (unsigned long)m.asn.ls4b, m.slotframe_handle, m.timeslot,
+          m.link_type, m.phase, m.skipped, (unsigned long)m.late);
+    }
+  }
+#endif /* TSCH_WITH_DL_MISS_STATS */
+#if TSCH_WITH_ENERGEST
+  {
+    int i;
+    const struct tsch_energest *e;
+    for(i = 0; i < 3; i++) {
+      e = &energest_stats.per_link_type[i];
+      printf("TSCH-energest type %u %lu %lu %lu\n", i,
+          (unsigned long)e->tx, (unsigned long)e->rx, (unsigned long)e->rx_idle);
+    }
+    e = &energest_stats.shared;
+    printf("TSCH-energest shared %lu %lu %lu\n",
+        (unsigned long)e->tx, (unsigned long)e->rx, (unsigned long)e->rx_idle);
+    for(i = 0; i < TSCH_ENERGEST_MAX_SLOTFRAMES; i++) {
+      e = &energest_stats.per_slotframe[i].e;
+      if(e->tx != 0 || e->rx != 0 || e->rx_idle != 0) {
+        printf("TSCH-energest sf %u %lu %lu %lu\n", energest_stats.per_slotframe[i].handle,
+            (unsigned long)e->tx, (unsigned long)e->rx, (unsigned long)e->rx_idle);
+      }
+    }
+    e = &energest_stats.other_slotframes;
+    printf("TSCH-energest other %lu %lu %lu\n",
+        (unsigned long)e->tx, (unsigned long)e->rx, (unsigned long)e->rx_idle);
+    printf("TSCH-energest scan %lu\n", (unsigned long)energest_stats.scan);
+  }
+#endif /* TSCH_WITH_ENERGEST */
+#if TSCH_WITH_CPU_TIME
+  printf("TSCH-cpu %lu\n", (unsigned long)link_operation_cpu_time);
+#endif /* TSCH_WITH_CPU_TIME */
   tsch_log_process_pending();
 }
+#if TSCH_WITH_CPU_TIME
+/*---------------------------------------------------------------------------*/
+/* Get the time spent in tsch_link_operation since boot */
+uint32_t
+tsch_get_cpu_time(void)
+{
+  return link_operation_cpu_time;
+}
+#endif /* TSCH_WITH_CPU_TIME */
+#if TSCH_WITH_ENERGEST
+/*---------------------------------------------------------------------------*/
+/* Get the radio-on counters */
+const struct tsch_energest_stats *
+tsch_energest_get_stats(void)
+{
+  return &energest_stats;
+}
+#endif /* TSCH_WITH_ENERGEST */
+#if TSCH_RX_EARLY_REJECT
+/*---------------------------------------------------------------------------*/
+/* Get the early rejection counters */
+const struct tsch_rx_early_reject_stats *
+tsch_rx_early_reject_get_stats(void)
+{
+  return &rx_early_reject_stats;
+}
+#endif /* TSCH_RX_EARLY_REJECT */
+#if TSCH_WITH_DL_MISS_STATS
+/*---------------------------------------------------------------------------*/
+/* Get the deadline-miss counters */
+const struct tsch_dl_miss_stats *
+tsch_dl_miss_get_stats(void)
+{
+  return &dl_miss_stats;
+}
+/*---------------------------------------------------------------------------*/
+/* Get the i-th most recent deadline miss (0 being the last one).
+ * Returns 0 if there is no such miss */
+int
+tsch_dl_miss_get_last(uint8_t i, struct tsch_dl_miss *miss)
+{
+  if(i >= dl_miss_log_count || miss == NULL) {
+    return 0;
+  }
+  memcpy(miss, &dl_miss_log[(dl_miss_log_head + TSCH_DL_MISS_LOG_LEN - 1 - i) % TSCH_DL_MISS_LOG_LEN],
+      sizeof(struct tsch_dl_miss));
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Reset all deadline-miss counters and the log of last misses */
+int
+tsch_dl_miss_reset(void)
+{
+  if(!tsch_get_lock()) {
+    return 0;
+  }
+  memset(&dl_miss_stats, 0, sizeof(dl_miss_stats));
+  dl_miss_log_head = 0;
+  dl_miss_log_count = 0;
+  tsch_release_lock();
+  return 1;
+}
+#endif /* TSCH_WITH_DL_MISS_STATS */
+#if TSCH_WITH_SLOT_PROFILER
+/*---------------------------------------------------------------------------*/
+/* Get the profile of a phase over the last complete window.
+ * Returns 0 if no window has completed yet */
+int
+tsch_slot_profiler_get(enum tsch_slot_phase phase, struct tsch_slot_profile *profile)
+{
+  if(phase >= TSCH_SLOT_PHASE_COUNT || profile == NULL || !slot_profile_last_valid) {
+    return 0;
+  }
+  memcpy(profile, &slot_profile_last[phase], sizeof(struct tsch_slot_profile));
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Restart profiling from an empty window */
+int
+tsch_slot_profiler_reset(void)
+{
+  if(!tsch_get_lock()) {
+    return 0;
+  }
+  memset(slot_profile, 0, sizeof(slot_profile));
+  memset(slot_profile_last, 0, sizeof(slot_profile_last));
+  slot_profile_ops = 0;
+  slot_profile_last_valid = 0;
+  tsch_release_lock();
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Width of a histogram bucket, in rtimer ticks */
+rtimer_clock_t
+tsch_slot_profiler_bucket_width(void)
+{
+  return SLOT_PROFILE_BUCKET_WIDTH;
+}
+#endif /* TSCH_WITH_SLOT_PROFILER */
 /*---------------------------------------------------------------------------*/
 static void
 tsch_reset(void)
@@ -1609,9 +3493,31 @@ tsch_reset(void)
   /* Initialize global variables */
   tsch_join_priority = 0xff;
   ASN_INIT(current_asn, 0, 0);
+  tsch_next_hopping_sequence.len = 0;
+  tsch_next_minimal_change.num_cells = 0;
   current_link = NULL;
   current_packet = NULL;
   current_neighbor = NULL;
+#if TSCH_ADAPTIVE_TIMESYNC
+  tsch_timesync_reset();
+#endif /* TSCH_ADAPTIVE_TIMESYNC */
+#if TSCH_BURST_MAX_LEN > 0
+  burst_link_scheduled = BURST_NONE;
+  burst_role = BURST_NONE;
+  burst_count = 0;
+#endif /* TSCH_BURST_MAX_LEN > 0 */
+#if TSCH_SCHEDULE_LOCK_FREE
+  /* No link operation is running anymore */
+  tsch_schedule_epoch++;
+#endif /* TSCH_SCHEDULE_LOCK_FREE */
+#if TSCH_WITH_SIXP
+  /* Negotiated cells do not outlive the network */
+  tsch_sixp_reset();
+#endif /* TSCH_WITH_SIXP */
+#if TSCH_SCHEDULE_WITH_STORE
+  /* Keep the schedule we had for when we join again, possibly after a reboot */
+  tsch_schedule_save();
+#endif /* TSCH_SCHEDULE_WITH_STORE */
 #ifdef TSCH_CALLBACK_LEAVING_NETWORK
   TSCH_CALLBACK_LEAVING_NETWORK();
 #endif
@@ -1621,6 +3527,10 @@ tsch_reset(void)
 #endif
   /* Reset time-profiling variables for next wake up */
   t0prepare=0; t0tx=0; t0txack=0; t0post_tx=0; t0rx=0; t0rxack=0;
+#if TSCH_WITH_SLOT_PROFILER
+  t0_started = 0;
+  t0_measured = 0;
+#endif /* TSCH_WITH_SLOT_PROFILER */
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -1638,12 +3548,24 @@ tsch_init(void)
   tsch_reset();
   tsch_queue_init();
   tsch_schedule_init();
+#if TSCH_802154_DUPLICATE_DETECTION
+  nbr_table_register(received_seqnos, NULL);
+#endif /* TSCH_802154_DUPLICATE_DETECTION */
   tsch_log_init();
+#if TSCH_WITH_LINK_ESTIMATOR
+  tsch_link_estimator_init();
+#endif /* TSCH_WITH_LINK_ESTIMATOR */
+#if TSCH_WITH_SIXP
+  tsch_sixp_init();
+#endif /* TSCH_WITH_SIXP */
   ringbufindex_init(&input_ringbuf, TSCH_MAX_INCOMING_PACKETS);
   ringbufindex_init(&dequeued_ringbuf, DEQUEUED_ARRAY_SIZE);
-  ASN_DIVISOR_INIT(hopping_sequence_length, TSCH_N_CHANNELS);
+  tsch_set_hopping_sequence(NULL, 0);
   /* Process tx/rx callback and log messages whenever polled */
   process_start(&tsch_pending_events_process, NULL);
+  /* Serve the MAC before the upper layers, with PROCESS_CONF_PRIORITY_LEVELS */
+  process_set_priority(&tsch_pending_events_process, PROCESS_CONF_PRIORITY_LEVELS - 1);
+  process_set_priority(&tsch_process, PROCESS_CONF_PRIORITY_LEVELS - 1);
 }
 /*---------------------------------------------------------------------------*/
 static int
@@ -46,7 +46,12 @@
 
 /* A global variable telling whether we are coordinator of the TSCH network */
 extern int tsch_is_coordinator;
-/* The TSCH radio driver */
-extern const struct rdc_driver tschrdc_driver;
+/* The TSCH MAC driver */
+extern const struct mac_driver tschmac_driver;
+
+/* The 4 LSBs of the current ASN, 0 before association.
+ * To use as llsec frame counter base, set
+ * #define ANTI_REPLAY_CONF_COUNTER_BASE tsch_get_asn_ls4b */
+uint32_t tsch_get_asn_ls4b(void);
 
 #endif /* __TSCH_H__ */
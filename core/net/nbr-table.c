@@ -57,11 +57,37 @@ static uint8_t locked_map[NBR_TABLE_MAX_NEIGHBORS];
 static struct nbr_table *all_tables[MAX_NUM_TABLES];
 /* The current number of tables */
 static unsigned num_tables;
+#if NBR_TABLE_EVICT_POLICY == NBR_TABLE_EVICT_LRU
+/* For each neighbor, the number of neighbors added since it was last
+ * looked up, saturating at 255 */
+static uint8_t age_map[NBR_TABLE_MAX_NEIGHBORS];
+/* Set while choosing a neighbor to evict, so that the lookups made by the
+ * score callback do not count as uses */
+static uint8_t evicting;
+#endif /* NBR_TABLE_EVICT_POLICY */
 
 /* The neighbor address table */
 MEMB(neighbor_addr_mem, nbr_table_key_t, NBR_TABLE_MAX_NEIGHBORS);
 LIST(nbr_table_keys);
 
+#if NBR_TABLE_HASH
+#if NBR_TABLE_HASH_SIZE <= NBR_TABLE_MAX_NEIGHBORS || NBR_TABLE_MAX_NEIGHBORS > 254
+#error "NBR_TABLE_HASH_SIZE must be larger than NBR_TABLE_MAX_NEIGHBORS"
+#endif
+/* Open addressing with linear probing over the keys in nbr_table_keys.
+ * A slot holds the neighbor index + 1, 0 if empty */
+static uint8_t hash_slots[NBR_TABLE_HASH_SIZE];
+#endif /* NBR_TABLE_HASH */
+
+#if NBR_TABLE_WITH_LOOKUP_CACHE
+#if NBR_TABLE_MAX_NEIGHBORS > 254
+#error "NBR_TABLE_WITH_LOOKUP_CACHE requires NBR_TABLE_MAX_NEIGHBORS <= 254"
+#endif
+/* Index + 1 of the neighbor last looked up or added, 0 if none.
+ * A single byte, so that lookups from interrupts see a consistent value */
+static uint8_t last_lookup;
+#endif /* NBR_TABLE_WITH_LOOKUP_CACHE */
+
 /*---------------------------------------------------------------------------*/
 /* Get a key from a neighbor index */
 static nbr_table_key_t *
@@ -104,17 +130,75 @@ key_from_item(nbr_table_t *table, const nbr_table_item_t *item)
 {
   return key_from_index(index_from_item(table, item));
 }
+#if NBR_TABLE_HASH
 /*---------------------------------------------------------------------------*/
-/* Get the index of a neighbor from its link-layer address */
+/* Hash slot where the search for a link-layer address starts */
 static int
-index_from_lladdr(const linkaddr_t *lladdr)
+hash_start(const linkaddr_t *lladdr)
+{
+  int i;
+  unsigned h = 0;
+  for(i = 0; i < LINKADDR_SIZE; i++) {
+    h = h * 31 + lladdr->u8[i];
+  }
+  return h % NBR_TABLE_HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+hash_add(nbr_table_key_t *key)
+{
+  int i = hash_start(&key->lladdr);
+  while(hash_slots[i] != 0) {
+    i = (i + 1) % NBR_TABLE_HASH_SIZE;
+  }
+  hash_slots[i] = index_from_key(key) + 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+hash_remove(nbr_table_key_t *key)
+{
+  int i;
+  int j;
+  int k;
+  int index = index_from_key(key) + 1;
+
+  for(i = hash_start(&key->lladdr); hash_slots[i] != index;
+      i = (i + 1) % NBR_TABLE_HASH_SIZE) {
+    if(hash_slots[i] == 0) {
+      return;
+    }
+  }
+  /* Move back the following entries that would not be found past the hole */
+  for(j = (i + 1) % NBR_TABLE_HASH_SIZE; hash_slots[j] != 0;
+      j = (j + 1) % NBR_TABLE_HASH_SIZE) {
+    k = hash_start(&key_from_index(hash_slots[j] - 1)->lladdr);
+    if(i <= j ? (k <= i || k > j) : (k <= i && k > j)) {
+      hash_slots[i] = hash_slots[j];
+      i = j;
+    }
+  }
+  hash_slots[i] = 0;
+}
+#endif /* NBR_TABLE_HASH */
+/*---------------------------------------------------------------------------*/
+/* Search the index of a neighbor from its link-layer address */
+static int
+search_lladdr(const linkaddr_t *lladdr)
 {
   nbr_table_key_t *key;
-  /* Allow lladdr-free insertion, useful e.g. for IPv6 ND.
-   * Only one such entry is possible at a time, indexed by linkaddr_null. */
-  if(lladdr == NULL) {
-    lladdr = &linkaddr_null;
+#if NBR_TABLE_HASH
+  {
+    int i;
+    for(i = hash_start(lladdr); hash_slots[i] != 0;
+        i = (i + 1) % NBR_TABLE_HASH_SIZE) {
+      key = key_from_index(hash_slots[i] - 1);
+      if(linkaddr_cmp(lladdr, &key->lladdr)) {
+        return hash_slots[i] - 1;
+      }
+    }
+    return -1;
   }
+#endif /* NBR_TABLE_HASH */
   key = list_head(nbr_table_keys);
   while(key != NULL) {
     if(lladdr && linkaddr_cmp(lladdr, &key->lladdr)) {
@@ -125,6 +209,33 @@ index_from_lladdr(const linkaddr_t *lladdr)
   return -1;
 }
 /*---------------------------------------------------------------------------*/
+/* Get the index of a neighbor from its link-layer address */
+static int
+index_from_lladdr(const linkaddr_t *lladdr)
+{
+  /* Allow lladdr-free insertion, useful e.g. for IPv6 ND.
+   * Only one such entry is possible at a time, indexed by linkaddr_null. */
+  if(lladdr == NULL) {
+    lladdr = &linkaddr_null;
+  }
+#if NBR_TABLE_WITH_LOOKUP_CACHE
+  {
+    uint8_t last = last_lookup;
+    int index;
+    if(last != 0 && linkaddr_cmp(lladdr, &key_from_index(last - 1)->lladdr)) {
+      return last - 1;
+    }
+    index = search_lladdr(lladdr);
+    if(index != -1) {
+      last_lookup = index + 1;
+    }
+    return index;
+  }
+#else /* NBR_TABLE_WITH_LOOKUP_CACHE */
+  return search_lladdr(lladdr);
+#endif /* NBR_TABLE_WITH_LOOKUP_CACHE */
+}
+/*---------------------------------------------------------------------------*/
 /* Get bit from "used" or "locked" bitmap */
 static int
 nbr_get_bit(uint8_t *bitmap, nbr_table_t *table, nbr_table_item_t *item)
@@ -156,6 +267,49 @@ nbr_set_bit(uint8_t *bitmap, nbr_table_t *table, nbr_table_item_t *item, int val
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+/* Returns 1 if a table using the neighbor vetoes its eviction */
+static int
+is_vetoed(int item_index)
+{
+  int i;
+  for(i = 0; i < MAX_NUM_TABLES; i++) {
+    if(all_tables[i] != NULL && all_tables[i]->veto != NULL
+       && (used_map[item_index] & (1 << i))
+       && all_tables[i]->veto(item_from_index(all_tables[i], item_index))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns 1 if the neighbor at item_index is a better eviction candidate
+ * than the one at best_index, used by as many tables */
+static int
+evict_before(int item_index, int best_index)
+{
+#ifdef NBR_TABLE_CALLBACK_EVICT_SCORE
+  int score;
+  int best_score;
+#if NBR_TABLE_EVICT_POLICY == NBR_TABLE_EVICT_LRU
+  evicting = 1;
+#endif /* NBR_TABLE_EVICT_POLICY */
+  score = NBR_TABLE_CALLBACK_EVICT_SCORE(&key_from_index(item_index)->lladdr);
+  best_score = NBR_TABLE_CALLBACK_EVICT_SCORE(&key_from_index(best_index)->lladdr);
+#if NBR_TABLE_EVICT_POLICY == NBR_TABLE_EVICT_LRU
+  evicting = 0;
+#endif /* NBR_TABLE_EVICT_POLICY */
+  if(score != best_score) {
+    return score < best_score;
+  }
+#endif /* NBR_TABLE_CALLBACK_EVICT_SCORE */
+#if NBR_TABLE_EVICT_POLICY == NBR_TABLE_EVICT_LRU
+  return age_map[item_index] > age_map[best_index];
+#else /* NBR_TABLE_EVICT_POLICY */
+  /* Keep the oldest, found first */
+  return 0;
+#endif /* NBR_TABLE_EVICT_POLICY */
+}
+/*---------------------------------------------------------------------------*/
 static nbr_table_key_t *
 nbr_table_allocate(void)
 {
@@ -177,8 +331,8 @@ nbr_table_allocate(void)
     while(key != NULL) {
       int item_index = index_from_key(key);
       int locked = locked_map[item_index];
-      /* Never delete a locked item */
-      if(!locked) {
+      /* Never delete a locked or vetoed item */
+      if(!locked && !is_vetoed(item_index)) {
         int used = used_map[item_index];
         int used_count = 0;
         /* Count how many tables are using this item */
@@ -189,12 +343,16 @@ nbr_table_allocate(void)
           used >>= 1;
         }
         /* Find least used item */
-        if(least_used_key == NULL || used_count < least_used_count) {
+        if(least_used_key == NULL || used_count < least_used_count
+           || (used_count == least_used_count
+               && evict_before(item_index, index_from_key(least_used_key)))) {
           least_used_key = key;
           least_used_count = used_count;
+#if NBR_TABLE_EVICT_POLICY == NBR_TABLE_EVICT_OLDEST && !defined(NBR_TABLE_CALLBACK_EVICT_SCORE)
           if(used_count == 0) { /* We won't find any least used item */
             break;
           }
+#endif
         }
       }
       key = list_item_next(key);
@@ -216,8 +374,17 @@ nbr_table_allocate(void)
       }
       /* Empty used map */
       used_map[index_from_key(least_used_key)] = 0;
+#if NBR_TABLE_WITH_LOOKUP_CACHE
+      /* The key is about to get another address */
+      if(last_lookup == index_from_key(least_used_key) + 1) {
+        last_lookup = 0;
+      }
+#endif /* NBR_TABLE_WITH_LOOKUP_CACHE */
       /* Remove neighbor from list */
       list_remove(nbr_table_keys, least_used_key);
+#if NBR_TABLE_HASH
+      hash_remove(least_used_key);
+#endif /* NBR_TABLE_HASH */
       /* Return associated key */
       return least_used_key;
     }
@@ -240,6 +407,12 @@ nbr_table_register(nbr_table_t *table, nbr_table_callback *callback)
   }
 }
 /*---------------------------------------------------------------------------*/
+void
+nbr_table_set_veto(nbr_table_t *table, nbr_table_veto_callback *veto)
+{
+  table->veto = veto;
+}
+/*---------------------------------------------------------------------------*/
 /* Returns the first item of the current table */
 nbr_table_item_t *
 nbr_table_head(nbr_table_t *table)
@@ -298,7 +471,26 @@ nbr_table_add_lladdr(nbr_table_t *table, const linkaddr_t *lladdr)
 
     /* Set link-layer address */
     linkaddr_copy(&key->lladdr, lladdr);
+#if NBR_TABLE_WITH_LOOKUP_CACHE
+    last_lookup = index + 1;
+#endif /* NBR_TABLE_WITH_LOOKUP_CACHE */
+#if NBR_TABLE_HASH
+    hash_add(key);
+#endif /* NBR_TABLE_HASH */
+#if NBR_TABLE_EVICT_POLICY == NBR_TABLE_EVICT_LRU
+    {
+      int i;
+      for(i = 0; i < NBR_TABLE_MAX_NEIGHBORS; i++) {
+        if(age_map[i] < 255) {
+          age_map[i]++;
+        }
+      }
+    }
+#endif /* NBR_TABLE_EVICT_POLICY */
   }
+#if NBR_TABLE_EVICT_POLICY == NBR_TABLE_EVICT_LRU
+  age_map[index] = 0;
+#endif /* NBR_TABLE_EVICT_POLICY */
 
   /* Get item in the current table */
   item = item_from_index(table, index);
@@ -314,8 +506,17 @@ nbr_table_add_lladdr(nbr_table_t *table, const linkaddr_t *lladdr)
 void *
 nbr_table_get_from_lladdr(nbr_table_t *table, const linkaddr_t *lladdr)
 {
-  void *item = item_from_index(table, index_from_lladdr(lladdr));
-  return nbr_get_bit(used_map, table, item) ? item : NULL;
+  int index = index_from_lladdr(lladdr);
+  void *item = item_from_index(table, index);
+  if(!nbr_get_bit(used_map, table, item)) {
+    return NULL;
+  }
+#if NBR_TABLE_EVICT_POLICY == NBR_TABLE_EVICT_LRU
+  if(!evicting) {
+    age_map[index] = 0;
+  }
+#endif /* NBR_TABLE_EVICT_POLICY */
+  return item;
 }
 /*---------------------------------------------------------------------------*/
 /* Removes a neighbor from the current table (unset "used" bit) */
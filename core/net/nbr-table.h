@@ -46,11 +46,57 @@
 #define NBR_TABLE_MAX_NEIGHBORS 8
 #endif /* NBR_TABLE_CONF_MAX_NEIGHBORS */
 
+/* Index the neighbors with a hash of their link-layer address, so that
+ * lookups do not scan all neighbors */
+#ifdef NBR_TABLE_CONF_HASH
+#define NBR_TABLE_HASH NBR_TABLE_CONF_HASH
+#else /* NBR_TABLE_CONF_HASH */
+#define NBR_TABLE_HASH 0
+#endif /* NBR_TABLE_CONF_HASH */
+
+/* Number of hash slots, larger than NBR_TABLE_MAX_NEIGHBORS */
+#ifdef NBR_TABLE_CONF_HASH_SIZE
+#define NBR_TABLE_HASH_SIZE NBR_TABLE_CONF_HASH_SIZE
+#else /* NBR_TABLE_CONF_HASH_SIZE */
+#define NBR_TABLE_HASH_SIZE (2 * NBR_TABLE_MAX_NEIGHBORS)
+#endif /* NBR_TABLE_CONF_HASH_SIZE */
+
+/* Remember the neighbor last looked up. All layers that process a packet
+ * (MAC, llsec, ds6-nbr, RPL) look up its sender or receiver in turn, only
+ * the first lookup searches the table */
+#ifdef NBR_TABLE_CONF_WITH_LOOKUP_CACHE
+#define NBR_TABLE_WITH_LOOKUP_CACHE NBR_TABLE_CONF_WITH_LOOKUP_CACHE
+#else /* NBR_TABLE_CONF_WITH_LOOKUP_CACHE */
+#define NBR_TABLE_WITH_LOOKUP_CACHE 0
+#endif /* NBR_TABLE_CONF_WITH_LOOKUP_CACHE */
+
+/* Eviction policy when the table is full. Among the neighbors that are
+ * neither locked nor vetoed by a table, the one used by the fewest tables
+ * is evicted. Ties go to the oldest inserted (NBR_TABLE_EVICT_OLDEST) or
+ * to the least recently looked up (NBR_TABLE_EVICT_LRU) */
+#define NBR_TABLE_EVICT_OLDEST 0
+#define NBR_TABLE_EVICT_LRU    1
+
+#ifdef NBR_TABLE_CONF_EVICT_POLICY
+#define NBR_TABLE_EVICT_POLICY NBR_TABLE_CONF_EVICT_POLICY
+#else /* NBR_TABLE_CONF_EVICT_POLICY */
+#define NBR_TABLE_EVICT_POLICY NBR_TABLE_EVICT_OLDEST
+#endif /* NBR_TABLE_CONF_EVICT_POLICY */
+
+/* NBR_TABLE_CALLBACK_EVICT_SCORE can name a function returning how much a
+ * neighbor is worth keeping, e.g. from its link quality. Among neighbors
+ * used by as many tables, the lowest score is evicted first */
+#ifdef NBR_TABLE_CALLBACK_EVICT_SCORE
+int NBR_TABLE_CALLBACK_EVICT_SCORE(const linkaddr_t *lladdr);
+#endif /* NBR_TABLE_CALLBACK_EVICT_SCORE */
+
 /* An item in a neighbor table */
 typedef void nbr_table_item_t;
 
 /* Callback function, called when removing an item from a table */
 typedef void(nbr_table_callback)(nbr_table_item_t *item);
+/* Callback function, returns non-zero to prevent the eviction of an item */
+typedef int(nbr_table_veto_callback)(nbr_table_item_t *item);
 
 /* A neighbor table */
 typedef struct nbr_table {
@@ -58,6 +104,7 @@ typedef struct nbr_table {
   int item_size;
   nbr_table_callback *callback;
   nbr_table_item_t *data;
+  nbr_table_veto_callback *veto;
 } nbr_table_t;
 
 /** \brief A static neighbor table. To be initialized through nbr_table_register(name) */
@@ -78,6 +125,8 @@ typedef struct nbr_table {
 /** \name Neighbor tables: register and loop through table elements */
 /** @{ */
 int nbr_table_register(nbr_table_t *table, nbr_table_callback *callback);
+/* Let a table veto the eviction of the neighbors it uses */
+void nbr_table_set_veto(nbr_table_t *table, nbr_table_veto_callback *veto);
 nbr_table_item_t *nbr_table_head(nbr_table_t *table);
 nbr_table_item_t *nbr_table_next(nbr_table_t *table, nbr_table_item_t *item);
 /** @} */
@@ -63,6 +63,7 @@ static uint32_t packetbuf_aligned[(PACKETBUF_SIZE + PACKETBUF_HDR_SIZE + 3) / 4]
 static uint8_t *packetbuf = (uint8_t *)packetbuf_aligned;
 
 static uint8_t *packetbufptr;
+static uint8_t reference_volatile;
 
 #define DEBUG 0
 #if DEBUG
@@ -80,6 +81,7 @@ packetbuf_clear(void)
   hdrptr = PACKETBUF_HDR_SIZE;
 
   packetbufptr = &packetbuf[PACKETBUF_HDR_SIZE];
+  reference_volatile = 0;
   packetbuf_attr_clear();
 }
 /*---------------------------------------------------------------------------*/
@@ -107,8 +109,12 @@ packetbuf_compact(void)
   int i, len;
 
   if(packetbuf_is_reference()) {
-    memcpy(&packetbuf[PACKETBUF_HDR_SIZE], packetbuf_reference_ptr(),
+    memcpy(&packetbuf[PACKETBUF_HDR_SIZE], packetbufptr + bufptr,
 	   packetbuf_datalen());
+    /* The data now lives in the packetbuf itself */
+    packetbufptr = &packetbuf[PACKETBUF_HDR_SIZE];
+    reference_volatile = 0;
+    bufptr = 0;
   } else if(bufptr > 0) {
     len = packetbuf_datalen() + PACKETBUF_HDR_SIZE;
     for(i = PACKETBUF_HDR_SIZE; i < len; i++) {
@@ -206,7 +212,7 @@ packetbuf_set_datalen(uint16_t len)
 void *
 packetbuf_dataptr(void)
 {
-  return (void *)(&packetbuf[bufptr + PACKETBUF_HDR_SIZE]);
+  return (void *)(packetbufptr + bufptr);
 }
 /*---------------------------------------------------------------------------*/
 void *
@@ -223,12 +229,27 @@ packetbuf_reference(void *ptr, uint16_t len)
   buflen = len;
 }
 /*---------------------------------------------------------------------------*/
+void
+packetbuf_reference_volatile(void *ptr, uint16_t len)
+{
+  packetbufptr = ptr;
+  bufptr = 0;
+  buflen = len;
+  reference_volatile = 1;
+}
+/*---------------------------------------------------------------------------*/
 int
 packetbuf_is_reference(void)
 {
   return packetbufptr != &packetbuf[PACKETBUF_HDR_SIZE];
 }
 /*---------------------------------------------------------------------------*/
+int
+packetbuf_is_volatile_reference(void)
+{
+  return packetbuf_is_reference() && reference_volatile;
+}
+/*---------------------------------------------------------------------------*/
 void *
 packetbuf_reference_ptr(void)
 {
@@ -290,6 +311,68 @@ packetbuf_attr_copyfrom(struct packetbuf_attr *attrs,
   memcpy(packetbuf_addrs, addrs, sizeof(packetbuf_addrs));
 }
 /*---------------------------------------------------------------------------*/
+int
+packetbuf_attr_copyto_sparse(uint8_t *present, packetbuf_attr_t *vals,
+                             int max, struct packetbuf_addr *addrs)
+{
+  int i;
+  int n = 0;
+  for(i = 0; i < PACKETBUF_NUM_ATTRS; ++i) {
+    if(packetbuf_attrs[i].val != 0) {
+      n++;
+    }
+  }
+  if(n > max) {
+    /* Leave the destination as it is */
+    return -1;
+  }
+  n = 0;
+  memset(present, 0, PACKETBUF_ATTR_PRESENT_SIZE);
+  for(i = 0; i < PACKETBUF_NUM_ATTRS; ++i) {
+    if(packetbuf_attrs[i].val != 0) {
+      present[i / 8] |= 1 << (i % 8);
+      vals[n++] = packetbuf_attrs[i].val;
+    }
+  }
+  memcpy(addrs, packetbuf_addrs, sizeof(packetbuf_addrs));
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+void
+packetbuf_attr_copyfrom_sparse(const uint8_t *present,
+                               const packetbuf_attr_t *vals,
+                               const struct packetbuf_addr *addrs)
+{
+  int i;
+  int n = 0;
+  for(i = 0; i < PACKETBUF_NUM_ATTRS; ++i) {
+    if(present[i / 8] & (1 << (i % 8))) {
+      packetbuf_attrs[i].val = vals[n++];
+    } else {
+      packetbuf_attrs[i].val = 0;
+    }
+  }
+  memcpy(packetbuf_addrs, addrs, sizeof(packetbuf_addrs));
+}
+/*---------------------------------------------------------------------------*/
+packetbuf_attr_t
+packetbuf_attr_sparse(const uint8_t *present, const packetbuf_attr_t *vals,
+                      uint8_t type)
+{
+  int i;
+  int n = 0;
+  if(!(present[type / 8] & (1 << (type % 8)))) {
+    return 0;
+  }
+  /* The value's index is the number of attributes present before it */
+  for(i = 0; i < type; ++i) {
+    if(present[i / 8] & (1 << (i % 8))) {
+      n++;
+    }
+  }
+  return vals[n];
+}
+/*---------------------------------------------------------------------------*/
 #if !PACKETBUF_CONF_ATTRS_INLINE
 int
 packetbuf_set_attr(uint8_t type, const packetbuf_attr_t val)
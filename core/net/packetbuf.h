@@ -206,6 +206,26 @@ void packetbuf_reference(void *ptr, uint16_t len);
  */
 int packetbuf_is_reference(void);
 
+/**
+ * \brief      Point the packetbuf data to external data that may not
+ *             outlive the current call
+ * \param ptr  A pointer to the external data
+ * \param len  The length of the external data
+ *
+ *             Unlike packetbuf_reference(), the header and attributes
+ *             are kept. queuebuf_new_from_packetbuf() copies the data
+ *             instead of keeping the reference. The header and data
+ *             are not contiguous, so this is only for MAC layers that
+ *             queue packets before sending them.
+ */
+void packetbuf_reference_volatile(void *ptr, uint16_t len);
+
+/**
+ * \brief      Check if the packetbuf data was referenced with
+ *             packetbuf_reference_volatile()
+ */
+int packetbuf_is_volatile_reference(void);
+
 /**
  * \brief      Get a pointer to external data referenced by the packetbuf
  * \retval     A pointer to the external data
@@ -361,6 +381,10 @@ enum {
 #endif /* WITHOUT_MAC_TX_ATTR */
   PACKETBUF_ATTR_MAC_SEQNO,
   PACKETBUF_ATTR_MAC_ACK,
+#ifndef WITHOUT_ATTR_TRACK
+  /* Traffic track of the packet, 0 for none, see SICSLOWPAN_CALLBACK_PACKET_TRACK */
+  PACKETBUF_ATTR_TRACK,
+#endif /* WITHOUT_ATTR_TRACK */
 #ifndef WITHOUT_CONTIKIMAC
   PACKETBUF_ATTR_IS_CREATED_AND_SECURED,
 #endif /* WITHOUT_CONTIKIMAC */
@@ -499,6 +523,32 @@ void              packetbuf_attr_copyto(struct packetbuf_attr *attrs,
 void              packetbuf_attr_copyfrom(struct packetbuf_attr *attrs,
 					struct packetbuf_addr *addrs);
 
+/* Sparse attributes: a bitmap of the attributes that are set (non-zero),
+   and their values in order. Used to store the attributes of queued
+   packets, which set only a few of them */
+#define PACKETBUF_ATTR_PRESENT_SIZE ((PACKETBUF_NUM_ATTRS + 7) / 8)
+
+/**
+ * \brief      Copy the attributes to a sparse representation
+ * \param present Bitmap of PACKETBUF_ATTR_PRESENT_SIZE bytes
+ * \param vals Values of the attributes present
+ * \param max  Size of vals
+ * \param addrs The addresses, copied as with packetbuf_attr_copyto()
+ * \retval     The number of attributes present, -1 if more than max,
+ *             in which case nothing is copied
+ */
+int               packetbuf_attr_copyto_sparse(uint8_t *present,
+                                               packetbuf_attr_t *vals,
+                                               int max,
+                                               struct packetbuf_addr *addrs);
+void              packetbuf_attr_copyfrom_sparse(const uint8_t *present,
+                                                 const packetbuf_attr_t *vals,
+                                                 const struct packetbuf_addr *addrs);
+/* Value of attribute type in a sparse representation */
+packetbuf_attr_t  packetbuf_attr_sparse(const uint8_t *present,
+                                        const packetbuf_attr_t *vals,
+                                        uint8_t type);
+
 #define PACKETBUF_ATTRIBUTES(...) { __VA_ARGS__ PACKETBUF_ATTR_LAST }
 #define PACKETBUF_ATTR_LAST { PACKETBUF_ATTR_NONE, 0 }
 
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Variable-size packet payloads on top of mmem, with deferred
+ *         compaction
+ */
+
+#include "contiki.h"
+#include "lib/memb.h"
+#include "net/packetmem.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+/* Taken around a compaction, to keep payloads from being read while they
+ * move. Returns 0 if the lock is not available */
+#ifdef PACKETMEM_CONF_LOCK
+int PACKETMEM_CONF_LOCK(void);
+void PACKETMEM_CONF_UNLOCK(void);
+#define PACKETMEM_LOCK() PACKETMEM_CONF_LOCK()
+#define PACKETMEM_UNLOCK() PACKETMEM_CONF_UNLOCK()
+#else
+#define PACKETMEM_LOCK() 1
+#define PACKETMEM_UNLOCK()
+#endif
+
+MEMB(packetmem_memb, struct packetmem, PACKETMEM_NUM);
+
+/* The freed payloads, still in the mmem heap */
+static struct packetmem *freed_list;
+/* Set while an event for the packetmem process is in the queue */
+static uint8_t compaction_posted;
+
+PROCESS(packetmem_process, "packetmem");
+/*---------------------------------------------------------------------------*/
+int
+packetmem_compact(void)
+{
+  struct packetmem *m;
+
+  if(freed_list == NULL) {
+    return 1;
+  }
+  if(!PACKETMEM_LOCK()) {
+    return 0;
+  }
+  while(freed_list != NULL) {
+    m = freed_list;
+    freed_list = m->next_freed;
+    mmem_free(&m->mmem);
+    memb_free(&packetmem_memb, m);
+  }
+  PACKETMEM_UNLOCK();
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+struct packetmem *
+packetmem_alloc(uint16_t size)
+{
+  struct packetmem *m;
+
+  m = memb_alloc(&packetmem_memb);
+  if(m == NULL && packetmem_compact()) {
+    m = memb_alloc(&packetmem_memb);
+  }
+  if(m == NULL) {
+    PRINTF("packetmem: no free handle\n");
+    return NULL;
+  }
+  if(!mmem_alloc(&m->mmem, size)) {
+    /* Freed payloads are only reclaimed by a compaction */
+    if(freed_list == NULL || !packetmem_compact()
+       || !mmem_alloc(&m->mmem, size)) {
+      PRINTF("packetmem: could not allocate %u bytes\n", size);
+      memb_free(&packetmem_memb, m);
+      return NULL;
+    }
+  }
+  m->next_freed = NULL;
+  return m;
+}
+/*---------------------------------------------------------------------------*/
+void
+packetmem_free(struct packetmem *m)
+{
+  if(m == NULL) {
+    return;
+  }
+  m->next_freed = freed_list;
+  freed_list = m;
+  /* Compact once the events already queued are processed. Unlike a poll,
+   * that does not preempt them */
+  if(!compaction_posted &&
+     process_post(&packetmem_process, PROCESS_EVENT_CONTINUE, NULL) ==
+     PROCESS_ERR_OK) {
+    compaction_posted = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(packetmem_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_CONTINUE);
+    compaction_posted = 0;
+    /* If the lock is busy, the next free or allocation retries */
+    packetmem_compact();
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+packetmem_init(void)
+{
+  static uint8_t inited = 0;
+
+  if(!inited) {
+    mmem_init();
+    memb_init(&packetmem_memb);
+    freed_list = NULL;
+    compaction_posted = 0;
+    process_start(&packetmem_process, NULL);
+    inited = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Variable-size packet payloads on top of the managed memory
+ *         allocator (mmem), for the queues that would otherwise hold
+ *         every packet in a worst-case fixed-size slot.
+ *
+ *         mmem compacts its memory whenever a block is freed, which
+ *         moves the other blocks. Here, frees are deferred: a freed
+ *         payload stays in place until the next compaction, which runs
+ *         from the packetmem process once the pending events are
+ *         processed, or when an allocation needs the space, and only
+ *         after taking PACKETMEM_CONF_LOCK. With TSCH,
+ *         setting it to tsch_get_lock (and PACKETMEM_CONF_UNLOCK to
+ *         tsch_release_lock) ensures no payload moves during a slot
+ *         operation. A pointer from packetmem_ptr() is therefore valid
+ *         until the next packetmem_alloc() or the next time the
+ *         packetmem process runs.
+ *
+ *         The payloads share the mmem heap, of MMEM_CONF_SIZE bytes.
+ */
+
+#ifndef PACKETMEM_H_
+#define PACKETMEM_H_
+
+#include "contiki.h"
+#include "lib/mmem.h"
+
+/* The number of payloads that can be allocated (including the freed
+ * ones not yet compacted) */
+#ifdef PACKETMEM_CONF_NUM
+#define PACKETMEM_NUM PACKETMEM_CONF_NUM
+#else
+#define PACKETMEM_NUM 16
+#endif
+
+struct packetmem {
+  struct mmem mmem;
+  /* Next freed payload waiting for compaction */
+  struct packetmem *next_freed;
+};
+
+/* Initialize the payload pool, and mmem. Can be called several times */
+void packetmem_init(void);
+/* Allocate a payload of size bytes. Returns NULL if failure */
+struct packetmem *packetmem_alloc(uint16_t size);
+/* Free a payload. Its memory is reclaimed at the next compaction */
+void packetmem_free(struct packetmem *m);
+/* Compact now the freed payloads. Returns 1 if done, 0 if the lock could
+ * not be taken */
+int packetmem_compact(void);
+
+#define packetmem_ptr(m) ((void *)(m)->mmem.ptr)
+#define packetmem_size(m) ((uint16_t)(m)->mmem.size)
+
+#endif /* PACKETMEM_H_ */
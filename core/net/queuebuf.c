@@ -47,6 +47,10 @@
 #include "cfs/cfs.h"
 #endif
 
+#if QUEUEBUF_WITH_PACKETMEM
+#include "net/packetmem.h"
+#endif /* QUEUEBUF_WITH_PACKETMEM */
+
 #include <string.h> /* for memcpy() */
 
 #ifdef QUEUEBUF_CONF_REF_NUM
@@ -77,12 +81,30 @@ struct queuebuf {
 
 /* The actual queuebuf data */
 struct queuebuf_data {
+#if QUEUEBUF_SIZE_CLASSES
+  uint8_t *data;
+#elif QUEUEBUF_WITH_PACKETMEM
+  struct packetmem *mem;
+#else /* QUEUEBUF_SIZE_CLASSES */
   uint8_t data[PACKETBUF_SIZE];
+#endif /* QUEUEBUF_SIZE_CLASSES */
   uint16_t len;
+#if QUEUEBUF_SPARSE_ATTRS
+  uint8_t attrs_present[PACKETBUF_ATTR_PRESENT_SIZE];
+  packetbuf_attr_t attrs[QUEUEBUF_ATTRS_MAX];
+#else /* QUEUEBUF_SPARSE_ATTRS */
   struct packetbuf_attr attrs[PACKETBUF_NUM_ATTRS];
+#endif /* QUEUEBUF_SPARSE_ATTRS */
   struct packetbuf_addr addrs[PACKETBUF_NUM_ADDRS];
 };
 
+/* The packet data of a struct queuebuf_data */
+#if QUEUEBUF_WITH_PACKETMEM
+#define QUEUEBUF_DATA(d) ((uint8_t *)packetmem_ptr((d)->mem))
+#else /* QUEUEBUF_WITH_PACKETMEM */
+#define QUEUEBUF_DATA(d) ((d)->data)
+#endif /* QUEUEBUF_WITH_PACKETMEM */
+
 struct queuebuf_ref {
   uint16_t len;
   uint8_t *ref;
@@ -90,10 +112,26 @@ struct queuebuf_ref {
   uint8_t hdrlen;
 };
 
-MEMB(bufmem, struct queuebuf, QUEUEBUF_NUM);
-MEMB(refbufmem, struct queuebuf_ref, QUEUEBUF_REF_NUM);
+MEMB_FREE_LIST(bufmem, struct queuebuf, QUEUEBUF_NUM);
+MEMB_FREE_LIST(refbufmem, struct queuebuf_ref, QUEUEBUF_REF_NUM);
 MEMB(buframmem, struct queuebuf_data, QUEUEBUFRAM_NUM);
 
+#if QUEUEBUF_SIZE_CLASSES
+/* The packet data slots, one pool per size */
+struct queuebuf_small {
+  uint8_t data[QUEUEBUF_SMALL_SIZE];
+};
+struct queuebuf_medium {
+  uint8_t data[QUEUEBUF_MEDIUM_SIZE];
+};
+struct queuebuf_large {
+  uint8_t data[PACKETBUF_SIZE];
+};
+MEMB_FREE_LIST(smallmem, struct queuebuf_small, QUEUEBUF_SMALL_NUM);
+MEMB_FREE_LIST(mediummem, struct queuebuf_medium, QUEUEBUF_MEDIUM_NUM);
+MEMB_FREE_LIST(largemem, struct queuebuf_large, QUEUEBUF_LARGE_NUM);
+#endif /* QUEUEBUF_SIZE_CLASSES */
+
 #if WITH_SWAP
 
 /* Swapping allows to store up to QUEUEBUF_NUM - QUEUEBUFRAM_NUM
@@ -289,6 +327,72 @@ queuebuf_load_to_ram(struct queuebuf *b)
 }
 #endif /* WITH_SWAP */
 /*---------------------------------------------------------------------------*/
+/* Copy the packetbuf attributes to d. Returns 0 if they do not fit */
+static int
+attrs_copyto(struct queuebuf_data *d)
+{
+#if QUEUEBUF_SPARSE_ATTRS
+  if(packetbuf_attr_copyto_sparse(d->attrs_present, d->attrs,
+                                  QUEUEBUF_ATTRS_MAX, d->addrs) < 0) {
+    PRINTF("queuebuf: more than %u attributes\n", QUEUEBUF_ATTRS_MAX);
+    return 0;
+  }
+#else /* QUEUEBUF_SPARSE_ATTRS */
+  packetbuf_attr_copyto(d->attrs, d->addrs);
+#endif /* QUEUEBUF_SPARSE_ATTRS */
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+attrs_copyfrom(struct queuebuf_data *d)
+{
+#if QUEUEBUF_SPARSE_ATTRS
+  packetbuf_attr_copyfrom_sparse(d->attrs_present, d->attrs, d->addrs);
+#else /* QUEUEBUF_SPARSE_ATTRS */
+  packetbuf_attr_copyfrom(d->attrs, d->addrs);
+#endif /* QUEUEBUF_SPARSE_ATTRS */
+}
+#if QUEUEBUF_SIZE_CLASSES
+/*---------------------------------------------------------------------------*/
+/* Allocate the smallest free slot that fits len bytes */
+static uint8_t *
+data_alloc(uint16_t len)
+{
+  uint8_t *ptr = NULL;
+  if(len <= QUEUEBUF_SMALL_SIZE) {
+    ptr = memb_alloc(&smallmem);
+  }
+  if(ptr == NULL && len <= QUEUEBUF_MEDIUM_SIZE) {
+    ptr = memb_alloc(&mediummem);
+  }
+  if(ptr == NULL) {
+    ptr = memb_alloc(&largemem);
+  }
+  return ptr;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+data_size(uint8_t *ptr)
+{
+  if(memb_inmemb(&smallmem, ptr)) {
+    return QUEUEBUF_SMALL_SIZE;
+  } else if(memb_inmemb(&mediummem, ptr)) {
+    return QUEUEBUF_MEDIUM_SIZE;
+  } else {
+    return PACKETBUF_SIZE;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+data_free(uint8_t *ptr)
+{
+  if(memb_free(&smallmem, ptr) == -1
+     && memb_free(&mediummem, ptr) == -1) {
+    memb_free(&largemem, ptr);
+  }
+}
+#endif /* QUEUEBUF_SIZE_CLASSES */
+/*---------------------------------------------------------------------------*/
 void
 queuebuf_init(void)
 {
@@ -300,6 +404,14 @@ queuebuf_init(void)
   }
 #endif
   memb_init(&buframmem);
+#if QUEUEBUF_SIZE_CLASSES
+  memb_init(&smallmem);
+  memb_init(&mediummem);
+  memb_init(&largemem);
+#endif /* QUEUEBUF_SIZE_CLASSES */
+#if QUEUEBUF_WITH_PACKETMEM
+  packetmem_init();
+#endif /* QUEUEBUF_WITH_PACKETMEM */
   memb_init(&bufmem);
   memb_init(&refbufmem);
 #if QUEUEBUF_STATS
@@ -310,7 +422,7 @@ queuebuf_init(void)
 int
 queuebuf_numfree(void)
 {
-  if(packetbuf_is_reference()) {
+  if(packetbuf_is_reference() && !packetbuf_is_volatile_reference()) {
     return memb_numfree(&refbufmem);
   } else {
     return memb_numfree(&bufmem);
@@ -328,7 +440,8 @@ queuebuf_new_from_packetbuf(void)
   struct queuebuf *buf;
   struct queuebuf_ref *rbuf;
 
-  if(packetbuf_is_reference()) {
+  /* Volatile references are copied as the packetbuf data would be */
+  if(packetbuf_is_reference() && !packetbuf_is_volatile_reference()) {
     rbuf = memb_alloc(&refbufmem);
     if(rbuf != NULL) {
 #if QUEUEBUF_STATS
@@ -370,10 +483,51 @@ queuebuf_new_from_packetbuf(void)
         return NULL;
       }
       buframptr = buf->ram_ptr;
+#if QUEUEBUF_SIZE_CLASSES
+      buframptr->data = data_alloc(packetbuf_totlen());
+      if(buframptr->data == NULL) {
+        PRINTF("queuebuf_new_from_packetbuf: could not allocate %u bytes\n",
+               packetbuf_totlen());
+        memb_free(&buframmem, buf->ram_ptr);
+        memb_free(&bufmem, buf);
+        return NULL;
+      }
+#endif /* QUEUEBUF_SIZE_CLASSES */
+#if QUEUEBUF_WITH_PACKETMEM
+      buframptr->mem = packetmem_alloc(packetbuf_totlen());
+      if(buframptr->mem == NULL) {
+        PRINTF("queuebuf_new_from_packetbuf: could not allocate %u bytes\n",
+               packetbuf_totlen());
+        memb_free(&buframmem, buf->ram_ptr);
+        memb_free(&bufmem, buf);
+        return NULL;
+      }
+#endif /* QUEUEBUF_WITH_PACKETMEM */
 #endif
 
-      buframptr->len = packetbuf_copyto(buframptr->data);
-      packetbuf_attr_copyto(buframptr->attrs, buframptr->addrs);
+      buframptr->len = packetbuf_copyto(QUEUEBUF_DATA(buframptr));
+      if(!attrs_copyto(buframptr)) {
+#if WITH_SWAP
+        if(buf->location == IN_RAM) {
+          memb_free(&buframmem, buf->ram_ptr);
+        } else {
+          tmpdata_qbuf = NULL;
+        }
+#else
+#if QUEUEBUF_SIZE_CLASSES
+        data_free(buframptr->data);
+#endif /* QUEUEBUF_SIZE_CLASSES */
+#if QUEUEBUF_WITH_PACKETMEM
+        packetmem_free(buframptr->mem);
+#endif /* QUEUEBUF_WITH_PACKETMEM */
+        memb_free(&buframmem, buf->ram_ptr);
+#endif
+#if QUEUEBUF_DEBUG
+        list_remove(queuebuf_list, buf);
+#endif /* QUEUEBUF_DEBUG */
+        memb_free(&bufmem, buf);
+        return NULL;
+      }
 
 #if WITH_SWAP
       if(buf->location == IN_CFS) {
@@ -407,7 +561,7 @@ void
 queuebuf_update_attr_from_packetbuf(struct queuebuf *buf)
 {
   struct queuebuf_data *buframptr = queuebuf_load_to_ram(buf);
-  packetbuf_attr_copyto(buframptr->attrs, buframptr->addrs);
+  attrs_copyto(buframptr);
 #if WITH_SWAP
   if(buf->location == IN_CFS) {
     queuebuf_flush_tmpdata();
@@ -419,8 +573,34 @@ void
 queuebuf_update_from_packetbuf(struct queuebuf *buf)
 {
   struct queuebuf_data *buframptr = queuebuf_load_to_ram(buf);
-  packetbuf_attr_copyto(buframptr->attrs, buframptr->addrs);
-  buframptr->len = packetbuf_copyto(buframptr->data);
+  attrs_copyto(buframptr);
+#if QUEUEBUF_SIZE_CLASSES
+  if(packetbuf_totlen() > data_size(buframptr->data)) {
+    /* The packet grew out of its slot, move it to a larger one */
+    uint8_t *ptr = data_alloc(packetbuf_totlen());
+    if(ptr == NULL) {
+      PRINTF("queuebuf_update_from_packetbuf: could not allocate %u bytes\n",
+             packetbuf_totlen());
+      return;
+    }
+    data_free(buframptr->data);
+    buframptr->data = ptr;
+  }
+#endif /* QUEUEBUF_SIZE_CLASSES */
+#if QUEUEBUF_WITH_PACKETMEM
+  if(packetbuf_totlen() > packetmem_size(buframptr->mem)) {
+    /* The packet grew out of its payload, allocate a larger one */
+    struct packetmem *mem = packetmem_alloc(packetbuf_totlen());
+    if(mem == NULL) {
+      PRINTF("queuebuf_update_from_packetbuf: could not allocate %u bytes\n",
+             packetbuf_totlen());
+      return;
+    }
+    packetmem_free(buframptr->mem);
+    buframptr->mem = mem;
+  }
+#endif /* QUEUEBUF_WITH_PACKETMEM */
+  buframptr->len = packetbuf_copyto(QUEUEBUF_DATA(buframptr));
 #if WITH_SWAP
   if(buf->location == IN_CFS) {
     queuebuf_flush_tmpdata();
@@ -439,6 +619,12 @@ queuebuf_free(struct queuebuf *buf)
       queuebuf_remove_from_file(buf->swap_id);
     }
 #else
+#if QUEUEBUF_SIZE_CLASSES
+    data_free(buf->ram_ptr->data);
+#endif /* QUEUEBUF_SIZE_CLASSES */
+#if QUEUEBUF_WITH_PACKETMEM
+    packetmem_free(buf->ram_ptr->mem);
+#endif /* QUEUEBUF_WITH_PACKETMEM */
     memb_free(&buframmem, buf->ram_ptr);
 #endif
     memb_free(&bufmem, buf);
@@ -463,8 +649,8 @@ queuebuf_to_packetbuf(struct queuebuf *b)
   struct queuebuf_ref *r;
   if(memb_inmemb(&bufmem, b)) {
     struct queuebuf_data *buframptr = queuebuf_load_to_ram(b);
-    packetbuf_copyfrom(buframptr->data, buframptr->len);
-    packetbuf_attr_copyfrom(buframptr->attrs, buframptr->addrs);
+    packetbuf_copyfrom(QUEUEBUF_DATA(buframptr), buframptr->len);
+    attrs_copyfrom(buframptr);
   } else if(memb_inmemb(&refbufmem, b)) {
     r = (struct queuebuf_ref *)b;
     packetbuf_clear();
@@ -481,7 +667,7 @@ queuebuf_dataptr(struct queuebuf *b)
 
   if(memb_inmemb(&bufmem, b)) {
     struct queuebuf_data *buframptr = queuebuf_load_to_ram(b);
-    return buframptr->data;
+    return QUEUEBUF_DATA(buframptr);
   } else if(memb_inmemb(&refbufmem, b)) {
     r = (struct queuebuf_ref *)b;
     return r->ref;
@@ -507,7 +693,11 @@ packetbuf_attr_t
 queuebuf_attr(struct queuebuf *b, uint8_t type)
 {
   struct queuebuf_data *buframptr = queuebuf_load_to_ram(b);
+#if QUEUEBUF_SPARSE_ATTRS
+  return packetbuf_attr_sparse(buframptr->attrs_present, buframptr->attrs, type);
+#else /* QUEUEBUF_SPARSE_ATTRS */
   return buframptr->attrs[type].val;
+#endif /* QUEUEBUF_SPARSE_ATTRS */
 }
 /*---------------------------------------------------------------------------*/
 void
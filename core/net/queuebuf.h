@@ -79,6 +79,87 @@
   #define WITH_SWAP 0
 #endif /* QUEUEBUFRAM_CONF_NUM */
 
+/* With QUEUEBUF_CONF_SIZE_CLASSES, the packet data is stored in the
+   smallest free slot out of pools of QUEUEBUF_SMALL_SIZE,
+   QUEUEBUF_MEDIUM_SIZE and PACKETBUF_SIZE bytes, rather than in a full
+   PACKETBUF_SIZE slot. The attributes remain in QUEUEBUFRAM_NUM blocks,
+   shared by all sizes. Not compatible with swapping. */
+#ifdef QUEUEBUF_CONF_SIZE_CLASSES
+#define QUEUEBUF_SIZE_CLASSES QUEUEBUF_CONF_SIZE_CLASSES
+#else
+#define QUEUEBUF_SIZE_CLASSES 0
+#endif
+
+#if QUEUEBUF_SIZE_CLASSES
+
+#if WITH_SWAP
+#error "QUEUEBUF_CONF_SIZE_CLASSES cannot be used with swapping"
+#endif
+
+#ifdef QUEUEBUF_CONF_SMALL_SIZE
+#define QUEUEBUF_SMALL_SIZE QUEUEBUF_CONF_SMALL_SIZE
+#else
+#define QUEUEBUF_SMALL_SIZE 32
+#endif
+
+#ifdef QUEUEBUF_CONF_MEDIUM_SIZE
+#define QUEUEBUF_MEDIUM_SIZE QUEUEBUF_CONF_MEDIUM_SIZE
+#else
+#define QUEUEBUF_MEDIUM_SIZE 64
+#endif
+
+/* Number of slots of each size. A packet takes a larger slot when all
+   slots of its size are in use */
+#ifdef QUEUEBUF_CONF_SMALL_NUM
+#define QUEUEBUF_SMALL_NUM QUEUEBUF_CONF_SMALL_NUM
+#else
+#define QUEUEBUF_SMALL_NUM QUEUEBUFRAM_NUM
+#endif
+
+#ifdef QUEUEBUF_CONF_MEDIUM_NUM
+#define QUEUEBUF_MEDIUM_NUM QUEUEBUF_CONF_MEDIUM_NUM
+#else
+#define QUEUEBUF_MEDIUM_NUM (QUEUEBUFRAM_NUM / 2)
+#endif
+
+#ifdef QUEUEBUF_CONF_LARGE_NUM
+#define QUEUEBUF_LARGE_NUM QUEUEBUF_CONF_LARGE_NUM
+#else
+#define QUEUEBUF_LARGE_NUM ((QUEUEBUFRAM_NUM + 3) / 4)
+#endif
+
+#endif /* QUEUEBUF_SIZE_CLASSES */
+
+/* With QUEUEBUF_CONF_WITH_PACKETMEM, the packet data is allocated at its
+   exact length out of the packetmem pool, on top of mmem, rather than in
+   a full PACKETBUF_SIZE slot. Its size is set with MMEM_CONF_SIZE. Not
+   compatible with swapping nor size classes. */
+#ifdef QUEUEBUF_CONF_WITH_PACKETMEM
+#define QUEUEBUF_WITH_PACKETMEM QUEUEBUF_CONF_WITH_PACKETMEM
+#else
+#define QUEUEBUF_WITH_PACKETMEM 0
+#endif
+
+#if QUEUEBUF_WITH_PACKETMEM && (WITH_SWAP || QUEUEBUF_SIZE_CLASSES)
+#error "QUEUEBUF_CONF_WITH_PACKETMEM cannot be used with swapping nor QUEUEBUF_CONF_SIZE_CLASSES"
+#endif
+
+/* With QUEUEBUF_CONF_SPARSE_ATTRS, queuebufs store only the attributes
+   that are set, up to QUEUEBUF_ATTRS_MAX of them, rather than all
+   PACKETBUF_NUM_ATTRS. A packet with more attributes set cannot be
+   queued. */
+#ifdef QUEUEBUF_CONF_SPARSE_ATTRS
+#define QUEUEBUF_SPARSE_ATTRS QUEUEBUF_CONF_SPARSE_ATTRS
+#else
+#define QUEUEBUF_SPARSE_ATTRS 0
+#endif
+
+#ifdef QUEUEBUF_CONF_ATTRS_MAX
+#define QUEUEBUF_ATTRS_MAX QUEUEBUF_CONF_ATTRS_MAX
+#else
+#define QUEUEBUF_ATTRS_MAX 10
+#endif
+
 #ifdef QUEUEBUF_CONF_DEBUG
 #define QUEUEBUF_DEBUG QUEUEBUF_CONF_DEBUG
 #else /* QUEUEBUF_CONF_DEBUG */
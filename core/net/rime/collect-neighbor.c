@@ -218,6 +218,9 @@ collect_neighbor_list_add(struct collect_neighbor_list *neighbors_list,
     n->rtmetric = nrtmetric;
     collect_link_estimate_new(&n->le);
     n->le_age = 0;
+#if COLLECT_BACKPRESSURE
+    n->queue = 0;
+#endif /* COLLECT_BACKPRESSURE */
     return 1;
   }
   return 0;
@@ -269,14 +272,17 @@ collect_neighbor_list_best(struct collect_neighbor_list *neighbors_list)
   /*  PRINTF("%d: ", node_id);*/
   PRINTF("collect_neighbor_best: ");
 
-  /* Find the neighbor with the lowest rtmetric + linkt estimate. */
+  /* Find the neighbor with the lowest rtmetric + linkt estimate
+     (+ queue penalty). */
   for(n = list_head(neighbors_list->list); n != NULL; n = list_item_next(n)) {
     PRINTF("%d.%d %d+%d=%d, ",
            n->addr.u8[0], n->addr.u8[1],
            n->rtmetric, collect_neighbor_link_estimate(n),
            collect_neighbor_rtmetric(n));
-    if(collect_neighbor_rtmetric_link_estimate(n) < rtmetric) {
-      rtmetric = collect_neighbor_rtmetric_link_estimate(n);
+    if(collect_neighbor_rtmetric_link_estimate(n) +
+       collect_neighbor_queue_penalty(n) < rtmetric) {
+      rtmetric = collect_neighbor_rtmetric_link_estimate(n) +
+        collect_neighbor_queue_penalty(n);
       best = n;
     }
   }
@@ -435,4 +441,28 @@ collect_neighbor_is_congested(struct collect_neighbor *n)
   }
 }
 /*---------------------------------------------------------------------------*/
+void
+collect_neighbor_set_queue(struct collect_neighbor *n, uint8_t queue)
+{
+#if COLLECT_BACKPRESSURE
+  if(n == NULL) {
+    return;
+  }
+  n->queue = queue > 100 ? 100 : queue;
+#endif /* COLLECT_BACKPRESSURE */
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+collect_neighbor_queue_penalty(struct collect_neighbor *n)
+{
+#if COLLECT_BACKPRESSURE
+  if(n == NULL) {
+    return 0;
+  }
+  return (uint32_t)COLLECT_BACKPRESSURE_WEIGHT * n->queue / 100;
+#else /* COLLECT_BACKPRESSURE */
+  return 0;
+#endif /* COLLECT_BACKPRESSURE */
+}
+/*---------------------------------------------------------------------------*/
 /** @} */
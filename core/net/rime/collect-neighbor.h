@@ -57,6 +57,22 @@
 #include "net/rime/collect-link-estimate.h"
 #include "lib/list.h"
 
+/* With backpressure, nodes advertise the occupancy of their forwarding
+   queue, and parents are chosen by routing metric plus a penalty
+   proportional to it, COLLECT_BACKPRESSURE_WEIGHT for a full queue.
+   The advertised routing metric does not include the penalty. */
+#ifdef COLLECT_CONF_BACKPRESSURE
+#define COLLECT_BACKPRESSURE COLLECT_CONF_BACKPRESSURE
+#else /* COLLECT_CONF_BACKPRESSURE */
+#define COLLECT_BACKPRESSURE 0
+#endif /* COLLECT_CONF_BACKPRESSURE */
+
+#ifdef COLLECT_CONF_BACKPRESSURE_WEIGHT
+#define COLLECT_BACKPRESSURE_WEIGHT COLLECT_CONF_BACKPRESSURE_WEIGHT
+#else /* COLLECT_CONF_BACKPRESSURE_WEIGHT */
+#define COLLECT_BACKPRESSURE_WEIGHT (2 * COLLECT_LINK_ESTIMATE_UNIT)
+#endif /* COLLECT_CONF_BACKPRESSURE_WEIGHT */
+
 struct collect_neighbor_list {
   LIST_STRUCT(list);
   struct ctimer periodic;
@@ -70,6 +86,9 @@ struct collect_neighbor {
   uint16_t le_age;
   struct collect_link_estimate le;
   struct timer congested_timer;
+#if COLLECT_BACKPRESSURE
+  uint8_t queue; /* Occupancy of its forwarding queue, in percent */
+#endif /* COLLECT_BACKPRESSURE */
 };
 
 void collect_neighbor_init(void);
@@ -96,6 +115,8 @@ void collect_neighbor_rx(struct collect_neighbor *n);
 void collect_neighbor_tx_fail(struct collect_neighbor *n, uint16_t num_tx);
 void collect_neighbor_set_congested(struct collect_neighbor *n);
 int collect_neighbor_is_congested(struct collect_neighbor *n);
+void collect_neighbor_set_queue(struct collect_neighbor *n, uint8_t queue);
+uint16_t collect_neighbor_queue_penalty(struct collect_neighbor *n);
 
 uint16_t collect_neighbor_link_estimate(struct collect_neighbor *n);
 uint16_t collect_neighbor_rtmetric_link_estimate(struct collect_neighbor *n);
@@ -99,9 +99,10 @@ struct data_msg_hdr {
    (ACK_FLAGS_RTMETRIC_NEEDS_UPDATE). The flags can contain any
    combination of the flags. The ACK header also contains the routing
    metric of the node that sends tha ACK. This is used to keep an
-   up-to-date routing state in the network. */
+   up-to-date routing state in the network. With backpressure, it
+   also contains the occupancy of its forwarding queue, in percent. */
 struct ack_msg {
-  uint8_t flags, dummy;
+  uint8_t flags, queue;
   uint16_t rtmetric;
 };
 
@@ -330,8 +331,10 @@ update_parent(struct collect_conn *tc)
         PRINTF("#A e=%d\n", collect_neighbor_link_estimate(best));
       }
       if(collect_neighbor_rtmetric_link_estimate(best) +
+         collect_neighbor_queue_penalty(best) +
          SIGNIFICANT_RTMETRIC_PARENT_CHANGE <
-         collect_neighbor_rtmetric_link_estimate(current)) {
+         collect_neighbor_rtmetric_link_estimate(current) +
+         collect_neighbor_queue_penalty(current)) {
 
         /* We switch parent. */
         PRINTF("update_parent: new parent %d.%d (%d) old parent %d.%d (%d)\n",
@@ -753,6 +756,18 @@ retransmit_current_packet(struct collect_conn *c)
     }
   }
 
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_queue_announcement(struct collect_conn *tc)
+{
+#if COLLECT_BACKPRESSURE && COLLECT_ANNOUNCEMENTS
+  /* Sent along with the rtmetric in the next announcement */
+  if(tc->is_router) {
+    announcement_set_value(&tc->queue_announcement,
+                           collect_queue_occupancy(tc));
+  }
+#endif /* COLLECT_BACKPRESSURE && COLLECT_ANNOUNCEMENTS */
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -760,6 +775,7 @@ send_next_packet(struct collect_conn *tc)
 {
   /* Remove the first packet on the queue, the packet that was just sent. */
   packetqueue_dequeue(&tc->send_queue);
+  update_queue_announcement(tc);
   tc->seqno = (tc->seqno + 1) % (1 << COLLECT_PACKET_ID_BITS);
 
   /* Cancel retransmission timer. */
@@ -815,6 +831,7 @@ handle_ack(struct collect_conn *tc)
     if(n != NULL) {
       collect_neighbor_tx(n, tc->transmissions);
       collect_neighbor_update_rtmetric(n, msg.rtmetric);
+      collect_neighbor_set_queue(n, msg.queue);
       update_rtmetric(tc);
     }
 
@@ -885,6 +902,10 @@ send_ack(struct collect_conn *tc, const linkaddr_t *to, int flags)
   memset(ack, 0, sizeof(struct ack_msg));
   ack->rtmetric = tc->rtmetric;
   ack->flags = flags;
+#if COLLECT_BACKPRESSURE
+  ack->queue = collect_queue_occupancy(tc);
+  update_queue_announcement(tc);
+#endif /* COLLECT_BACKPRESSURE */
 
   packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, to);
   packetbuf_set_attr(PACKETBUF_ATTR_PACKET_TYPE, PACKETBUF_ATTR_PACKET_TYPE_ACK);
@@ -1281,6 +1302,23 @@ received_announcement(struct announcement *a, const linkaddr_t *from,
   }
 #endif /* COLLECT_CONF_WITH_LISTEN */
 }
+#if COLLECT_BACKPRESSURE
+/*---------------------------------------------------------------------------*/
+static void
+received_queue_announcement(struct announcement *a, const linkaddr_t *from,
+                            uint16_t id, uint16_t value)
+{
+  struct collect_conn *tc = (struct collect_conn *)
+    ((char *)a - offsetof(struct collect_conn, queue_announcement));
+  struct collect_neighbor *n;
+
+  n = collect_neighbor_list_find(&tc->neighbor_list, from);
+  if(n != NULL) {
+    collect_neighbor_set_queue(n, value);
+    update_rtmetric(tc);
+  }
+}
+#endif /* COLLECT_BACKPRESSURE */
 #endif /* !COLLECT_ANNOUNCEMENTS */
 /*---------------------------------------------------------------------------*/
 static const struct unicast_callbacks unicast_callbacks = {node_packet_received,
@@ -1322,6 +1360,12 @@ collect_open(struct collect_conn *tc, uint16_t channels,
 #else /* !COLLECT_ANNOUNCEMENTS */
   announcement_register(&tc->announcement, channels,
 			received_announcement);
+#if COLLECT_BACKPRESSURE
+  /* The unicast channel is not used by announcements */
+  announcement_register(&tc->queue_announcement, channels + 1,
+                        received_queue_announcement);
+  update_queue_announcement(tc);
+#endif /* COLLECT_BACKPRESSURE */
 #if ! COLLECT_CONF_WITH_LISTEN
   if(tc->is_router) {
     announcement_set_value(&tc->announcement, RTMETRIC_MAX);
@@ -1375,6 +1419,9 @@ collect_close(struct collect_conn *tc)
 {
 #if COLLECT_ANNOUNCEMENTS
   announcement_remove(&tc->announcement);
+#if COLLECT_BACKPRESSURE
+  announcement_remove(&tc->queue_announcement);
+#endif /* COLLECT_BACKPRESSURE */
 #else
   neighbor_discovery_close(&tc->neighbor_discovery_conn);
 #endif /* COLLECT_ANNOUNCEMENTS */
@@ -1467,6 +1514,7 @@ collect_send(struct collect_conn *tc, int rexmits)
                                      FORWARD_PACKET_LIFETIME_BASE *
                                      packetbuf_attr(PACKETBUF_ATTR_MAX_REXMIT),
                                      tc)) {
+      update_queue_announcement(tc);
       send_queued_packet(tc);
       ret = 1;
     } else {
@@ -1528,6 +1576,12 @@ collect_parent(struct collect_conn *tc)
   return &tc->current_parent;
 }
 /*---------------------------------------------------------------------------*/
+int
+collect_queue_occupancy(struct collect_conn *tc)
+{
+  return packetqueue_len(&tc->send_queue) * 100 / (MAX_SENDING_QUEUE);
+}
+/*---------------------------------------------------------------------------*/
 void
 collect_purge(struct collect_conn *tc)
 {
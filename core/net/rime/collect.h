@@ -121,6 +121,9 @@ struct collect_conn {
 #else /* ! COLLECT_ANNOUNCEMENTS */
   struct announcement announcement;
   struct ctimer transmit_after_scan_timer;
+#if COLLECT_BACKPRESSURE
+  struct announcement queue_announcement;
+#endif /* COLLECT_BACKPRESSURE */
 #endif /* COLLECT_ANNOUNCEMENTS */
   const struct collect_callbacks *cb;
   struct ctimer retransmission_timer;
@@ -159,6 +162,8 @@ void collect_set_sink(struct collect_conn *c, int should_be_sink);
 
 int collect_depth(struct collect_conn *c);
 const linkaddr_t *collect_parent(struct collect_conn *c);
+/* Occupancy of the forwarding queue, in percent */
+int collect_queue_occupancy(struct collect_conn *c);
 
 void collect_set_keepalive(struct collect_conn *c, clock_time_t period);
 
@@ -40,6 +40,19 @@
 
 #include "contiki-conf.h"
 
+/* DAG Mode of Operation */
+#define RPL_MOP_NO_DOWNWARD_ROUTES      0
+#define RPL_MOP_NON_STORING             1
+#define RPL_MOP_STORING_NO_MULTICAST    2
+#define RPL_MOP_STORING_MULTICAST       3
+
+/* In storing mode, every node keeps routes to its subtree. In non-storing
+ * mode, only the root keeps the DAG topology (see rpl-ns.c) and sends
+ * downward traffic along source routes (RFC 6554) */
+#define RPL_WITH_STORING (RPL_CONF_MOP == RPL_MOP_STORING_NO_MULTICAST \
+                          || RPL_CONF_MOP == RPL_MOP_STORING_MULTICAST)
+#define RPL_WITH_NON_STORING (RPL_CONF_MOP == RPL_MOP_NON_STORING)
+
 /* Set to 1 to enable RPL statistics */
 #ifndef RPL_CONF_STATS
 #define RPL_CONF_STATS 0
@@ -158,6 +171,32 @@
 #define RPL_DIO_REDUNDANCY          10
 #endif
 
+/*
+ * Density-adaptive DIO redundancy. With more than RPL_DIO_DENSITY_THRESHOLD
+ * RPL neighbors, the redundancy constant is scaled down in proportion to
+ * the neighbor count, but not below RPL_DIO_REDUNDANCY_MIN, so that the
+ * number of DIOs per interval in a neighborhood stays flat as the region
+ * gets denser. Per-interval DIO counters are kept and printed by the
+ * deployment logger.
+ */
+#ifdef RPL_CONF_DIO_ADAPTIVE_REDUNDANCY
+#define RPL_DIO_ADAPTIVE_REDUNDANCY RPL_CONF_DIO_ADAPTIVE_REDUNDANCY
+#else
+#define RPL_DIO_ADAPTIVE_REDUNDANCY 0
+#endif
+
+#ifdef RPL_CONF_DIO_DENSITY_THRESHOLD
+#define RPL_DIO_DENSITY_THRESHOLD   RPL_CONF_DIO_DENSITY_THRESHOLD
+#else
+#define RPL_DIO_DENSITY_THRESHOLD   8
+#endif
+
+#ifdef RPL_CONF_DIO_REDUNDANCY_MIN
+#define RPL_DIO_REDUNDANCY_MIN      RPL_CONF_DIO_REDUNDANCY_MIN
+#else
+#define RPL_DIO_REDUNDANCY_MIN      2
+#endif
+
 /*
  * Initial metric attributed to a link when the ETX is unknown
  */
@@ -186,6 +225,282 @@
 #define RPL_DEFAULT_LIFETIME            RPL_CONF_DEFAULT_LIFETIME
 #endif
 
+/*
+ * Process parent updates (link metric changes, lost neighbors, loops) as
+ * they happen, at most RPL_RANK_UPDATES_PER_EVENT per event, instead of a
+ * sweep of the whole parent table every second. A non-preferred parent
+ * that does not beat the preferred one is checked alone, without parent
+ * selection.
+ */
+#ifdef RPL_CONF_INCREMENTAL_RANKS
+#define RPL_INCREMENTAL_RANKS       RPL_CONF_INCREMENTAL_RANKS
+#else
+#define RPL_INCREMENTAL_RANKS       0
+#endif
+
+#ifdef RPL_CONF_RANK_UPDATES_PER_EVENT
+#define RPL_RANK_UPDATES_PER_EVENT  RPL_CONF_RANK_UPDATES_PER_EVENT
+#else
+#define RPL_RANK_UPDATES_PER_EVENT  2
+#endif
+
+/*
+ * DIO fast path. A CRC of each neighbor's last accepted DIO is kept; a DIO
+ * identical to it, on the same DAG version and with the neighbor's rank
+ * still current, only refreshes the neighbor and counts towards Trickle
+ * redundancy. Option parsing, parent re-evaluation and RPL_DEBUG_DIO_INPUT
+ * are skipped.
+ */
+#ifdef RPL_CONF_DIO_FAST_PATH
+#define RPL_DIO_FAST_PATH           RPL_CONF_DIO_FAST_PATH
+#else
+#define RPL_DIO_FAST_PATH           0
+#endif
+
+/*
+ * 6LoWPAN context distribution. DIOs carry the IPHC contexts of the
+ * sender in context options (RPL_OPTION_CONTEXT, the 6LoWPAN-ND context
+ * option of RFC 6775 in an RPL option). The root advertises the contexts
+ * set with sicslowpan_context_set(); the other nodes install the contexts
+ * from the DIOs of their DAG and advertise them in turn.
+ */
+#ifdef RPL_CONF_DIO_CONTEXTS
+#define RPL_DIO_CONTEXTS            RPL_CONF_DIO_CONTEXTS
+#else
+#define RPL_DIO_CONTEXTS            0
+#endif
+
+/*
+ * Loop statistics: counters of the rank and forwarding errors seen in the
+ * RPL hop-by-hop option and of the repairs they trigger, along with the
+ * last RPL_LOOP_HISTORY_LEN events, each with the time since our last
+ * parent switch. Printed by the deployment logger.
+ */
+#ifdef RPL_CONF_LOOP_STATS
+#define RPL_LOOP_STATS              RPL_CONF_LOOP_STATS
+#else
+#define RPL_LOOP_STATS              0
+#endif
+
+#ifdef RPL_CONF_LOOP_HISTORY_LEN
+#define RPL_LOOP_HISTORY_LEN        RPL_CONF_LOOP_HISTORY_LEN
+#else
+#define RPL_LOOP_HISTORY_LEN        8
+#endif
+
+/*
+ * Fast local repair. Up to RPL_BACKUP_PARENTS parents closer to the root
+ * than us are kept ranked by the objective function. On a local repair,
+ * the best one still valid becomes the preferred parent right away, and
+ * parents and Trickle are only reset if there is none. A backup is valid
+ * if heard from (DIO or acked unicast) within RPL_BACKUP_PARENT_FRESHNESS
+ * seconds, and if it neither poisoned its rank nor advertised one above
+ * ours at the time the list was built, as it may then be in our subtree.
+ * The freshness defaults to three maximum DIO intervals.
+ */
+#ifdef RPL_CONF_FAST_REPAIR
+#define RPL_FAST_REPAIR             RPL_CONF_FAST_REPAIR
+#else
+#define RPL_FAST_REPAIR             0
+#endif
+
+#ifdef RPL_CONF_BACKUP_PARENTS
+#define RPL_BACKUP_PARENTS          RPL_CONF_BACKUP_PARENTS
+#else
+#define RPL_BACKUP_PARENTS          3
+#endif
+
+#ifdef RPL_CONF_BACKUP_PARENT_FRESHNESS
+#define RPL_BACKUP_PARENT_FRESHNESS RPL_CONF_BACKUP_PARENT_FRESHNESS
+#else
+#define RPL_BACKUP_PARENT_FRESHNESS ((3UL << (RPL_DIO_INTERVAL_MIN + RPL_DIO_INTERVAL_DOUBLINGS)) / 1000)
+#endif
+
+/*
+ * Multipath forwarding of upward traffic. Instead of always using the
+ * preferred parent, traffic sent through the RPL default route is spread
+ * over all parents of the current DAG that have a lower rank and a path
+ * cost within RPL_MULTIPATH_RANK_STRETCH of ours, weighted by the inverse
+ * of their link ETX. The parent is drawn for every packet
+ * (RPL_MULTIPATH_PER_PACKET) or from a hash of the source and destination
+ * addresses, keeping a flow on one parent (RPL_MULTIPATH_PER_FLOW).
+ */
+#define RPL_MULTIPATH_NONE          0
+#define RPL_MULTIPATH_PER_PACKET    1
+#define RPL_MULTIPATH_PER_FLOW      2
+
+#ifdef RPL_CONF_MULTIPATH
+#define RPL_MULTIPATH               RPL_CONF_MULTIPATH
+#else
+#define RPL_MULTIPATH               RPL_MULTIPATH_NONE
+#endif
+
+#ifdef RPL_CONF_MULTIPATH_RANK_STRETCH
+#define RPL_MULTIPATH_RANK_STRETCH  RPL_CONF_MULTIPATH_RANK_STRETCH
+#else
+#define RPL_MULTIPATH_RANK_STRETCH  RPL_MIN_HOPRANKINC
+#endif
+
+/*
+ * Probing budget (RPL_CONF_PROBING): at most RPL_PROBING_BUDGET probes per
+ * RPL_PROBING_BUDGET_PERIOD, 0 for no limit. The network-wide probing
+ * overhead is then bounded by the number of nodes times the budget.
+ */
+#ifdef RPL_CONF_PROBING_BUDGET
+#define RPL_PROBING_BUDGET          RPL_CONF_PROBING_BUDGET
+#else
+#define RPL_PROBING_BUDGET          0
+#endif
+
+#ifdef RPL_CONF_PROBING_BUDGET_PERIOD
+#define RPL_PROBING_BUDGET_PERIOD   RPL_CONF_PROBING_BUDGET_PERIOD
+#else
+#define RPL_PROBING_BUDGET_PERIOD   (60 * CLOCK_SECOND)
+#endif
+
+/*
+ * Probe coalescing: a probe waits up to RPL_PROBING_COALESCE_WINDOW for
+ * upward data, which is then sent to the probed parent instead of the
+ * preferred one. The DIO probe is sent only if no data came. Only applies
+ * to parents closer to the root than us.
+ */
+#ifdef RPL_CONF_PROBING_COALESCE
+#define RPL_PROBING_COALESCE        RPL_CONF_PROBING_COALESCE
+#else
+#define RPL_PROBING_COALESCE        0
+#endif
+
+#ifdef RPL_CONF_PROBING_COALESCE_WINDOW
+#define RPL_PROBING_COALESCE_WINDOW RPL_CONF_PROBING_COALESCE_WINDOW
+#else
+#define RPL_PROBING_COALESCE_WINDOW (10 * CLOCK_SECOND)
+#endif
+
+/*
+ * Cache the path cost through each parent, for the objective functions
+ * with a costly calculate_rank (rpl_of_etx_exp, rpl_of_pdr). The cache is
+ * recomputed when the rank or link metric of the parent changes.
+ */
+#ifdef RPL_OF_CONF_CACHE_PATH_COST
+#define RPL_OF_CACHE_PATH_COST      RPL_OF_CONF_CACHE_PATH_COST
+#else
+#define RPL_OF_CACHE_PATH_COST      0
+#endif
+
+/*
+ * Lookup tables, with linear interpolation, instead of the multiply/divide
+ * loops of the non-linear link cost transforms of the objective functions.
+ * Costs some RAM per objective function, filled at first use.
+ */
+#ifdef RPL_OF_CONF_LOOKUP_TABLES
+#define RPL_OF_LOOKUP_TABLES        RPL_OF_CONF_LOOKUP_TABLES
+#else
+#define RPL_OF_LOOKUP_TABLES        0
+#endif
+
+/*
+ * Maximum number of targets per DAO. Received DAOs may carry several
+ * targets, each followed or not by its transit information. Three /128
+ * targets keep the DAO within a single 802.15.4 frame.
+ */
+#ifdef RPL_CONF_DAO_MAX_TARGETS
+#define RPL_DAO_MAX_TARGETS         RPL_CONF_DAO_MAX_TARGETS
+#else
+#define RPL_DAO_MAX_TARGETS         3
+#endif
+
+/*
+ * DAO aggregation for storing mode. Our own target and those forwarded
+ * from our subtree are queued and sent to the preferred parent together,
+ * up to RPL_DAO_MAX_TARGETS per DAO, after a delay jittered over
+ * [RPL_DAO_AGGREGATION_DELAY / 2, 3 * RPL_DAO_AGGREGATION_DELAY / 2), and
+ * no sooner than RPL_DAO_MIN_INTERVAL after the last DAO. A full DAO is
+ * sent right away. With RPL_CONF_DAO_ACK, DAO-ACKs to up to
+ * RPL_DAO_ACK_BATCH children are sent together with the DAO, the latest
+ * DAO of a child acknowledging the previous ones.
+ */
+#ifdef RPL_CONF_DAO_AGGREGATION
+#define RPL_DAO_AGGREGATION         RPL_CONF_DAO_AGGREGATION
+#else
+#define RPL_DAO_AGGREGATION         0
+#endif
+
+#ifdef RPL_CONF_DAO_AGGREGATION_DELAY
+#define RPL_DAO_AGGREGATION_DELAY   RPL_CONF_DAO_AGGREGATION_DELAY
+#else
+#define RPL_DAO_AGGREGATION_DELAY   (2 * CLOCK_SECOND)
+#endif
+
+#ifdef RPL_CONF_DAO_MIN_INTERVAL
+#define RPL_DAO_MIN_INTERVAL        RPL_CONF_DAO_MIN_INTERVAL
+#else
+#define RPL_DAO_MIN_INTERVAL        (4 * CLOCK_SECOND)
+#endif
+
+#ifdef RPL_CONF_DAO_ACK_BATCH
+#define RPL_DAO_ACK_BATCH           RPL_CONF_DAO_ACK_BATCH
+#else
+#define RPL_DAO_ACK_BATCH           4
+#endif
+
+/*
+ * Number of per-hop timestamps carried in the RPL hop-by-hop option, 0 to
+ * disable. The source and every forwarder append a 16-bit timestamp, see
+ * rpl_get_hop_timestamps. All nodes of a network must use the same value.
+ */
+#ifdef RPL_CONF_HOP_TIMESTAMPS
+#define RPL_HOP_TIMESTAMPS          RPL_CONF_HOP_TIMESTAMPS
+#else
+#define RPL_HOP_TIMESTAMPS          0
+#endif
+
+/*
+ * Warm restart. Our instance, DAG version and configuration, rank,
+ * preferred parent and its link metric are saved to CFS (RPL_STORE_FILE)
+ * every RPL_STORE_PERIOD if they changed. On boot, the DAG is joined again
+ * through the stored parent, provisionally: up to RPL_STORE_VERIFY_ATTEMPTS
+ * unicast DIS are sent to it, RPL_STORE_VERIFY_INTERVAL apart, and the
+ * instance is left for a normal join if it answers none with a DIO of the
+ * DAG. With RPL_STORE_WAIT_LINK, the verification only starts when the
+ * link layer calls rpl_store_verify(), e.g. tsch-rpl upon joining a TSCH
+ * network. The root does not save its state.
+ */
+#ifdef RPL_CONF_WITH_STORE
+#define RPL_WITH_STORE              RPL_CONF_WITH_STORE
+#else
+#define RPL_WITH_STORE              0
+#endif
+
+#ifdef RPL_STORE_CONF_FILE
+#define RPL_STORE_FILE              RPL_STORE_CONF_FILE
+#else
+#define RPL_STORE_FILE              "rpl-state"
+#endif
+
+#ifdef RPL_STORE_CONF_PERIOD
+#define RPL_STORE_PERIOD            RPL_STORE_CONF_PERIOD
+#else
+#define RPL_STORE_PERIOD            (5 * 60 * CLOCK_SECOND)
+#endif
+
+#ifdef RPL_STORE_CONF_VERIFY_ATTEMPTS
+#define RPL_STORE_VERIFY_ATTEMPTS   RPL_STORE_CONF_VERIFY_ATTEMPTS
+#else
+#define RPL_STORE_VERIFY_ATTEMPTS   3
+#endif
+
+#ifdef RPL_STORE_CONF_VERIFY_INTERVAL
+#define RPL_STORE_VERIFY_INTERVAL   RPL_STORE_CONF_VERIFY_INTERVAL
+#else
+#define RPL_STORE_VERIFY_INTERVAL   (10 * CLOCK_SECOND)
+#endif
+
+#ifdef RPL_STORE_CONF_WAIT_LINK
+#define RPL_STORE_WAIT_LINK         RPL_STORE_CONF_WAIT_LINK
+#else
+#define RPL_STORE_WAIT_LINK         0
+#endif
+
 /*
  * DAG preference field
  */
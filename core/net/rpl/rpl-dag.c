@@ -47,11 +47,13 @@
 #include "net/rpl/rpl-private.h"
 #include "net/ip/uip.h"
 #include "net/ipv6/uip-nd6.h"
+#include "net/ipv6/sicslowpan.h"
 #include "net/nbr-table.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
 #include "lib/list.h"
 #include "lib/memb.h"
 #include "sys/ctimer.h"
+#include "lib/random.h"
 
 #include <limits.h>
 #include <string.h>
@@ -75,10 +77,49 @@ static rpl_of_t * const objective_functions[] = {&RPL_OF};
 #ifdef RPL_CALLBACK_PARENT_SWITCH
 void RPL_CALLBACK_PARENT_SWITCH(rpl_parent_t *old, rpl_parent_t *new);
 #endif
+#ifdef RPL_CALLBACK_LINK_METRIC
+uint16_t RPL_CALLBACK_LINK_METRIC(const linkaddr_t *addr, uint16_t link_metric);
+#endif
+#ifdef RPL_CALLBACK_PROBE
+void RPL_CALLBACK_PROBE(const linkaddr_t *addr);
+#endif
+
+#define WITH_PROBING_COALESCE (RPL_CONF_PROBING && RPL_PROBING_COALESCE)
+/* Do we send upward traffic to other parents than the preferred one? */
+#define WITH_UPWARD_PARENTS (RPL_MULTIPATH != RPL_MULTIPATH_NONE || WITH_PROBING_COALESCE)
 
 /*---------------------------------------------------------------------------*/
 /* Per-parent RPL information */
 NBR_TABLE_GLOBAL(rpl_parent_t, rpl_parents);
+#if RPL_INCREMENTAL_RANKS
+/* FIFO of the parents flagged RPL_PARENT_FLAG_UPDATED. A parent is queued
+ * at most once, so that it never overflows */
+static rpl_parent_t *updated_parents[NBR_TABLE_MAX_NEIGHBORS];
+static uint8_t updated_head;
+static uint8_t updated_count;
+static struct ctimer rank_update_timer;
+static void handle_rank_updates(void *ptr);
+#endif /* RPL_INCREMENTAL_RANKS */
+#if RPL_CONF_PROBING
+struct rpl_probing_stats rpl_probing_stats;
+#if RPL_PROBING_BUDGET
+static clock_time_t budget_start;
+static uint16_t budget_used;
+#endif /* RPL_PROBING_BUDGET */
+#if WITH_PROBING_COALESCE
+/* The parent to probe, waiting for upward data */
+static rpl_parent_t *probe_pending;
+static struct ctimer probe_pending_timer;
+#endif /* WITH_PROBING_COALESCE */
+#endif /* RPL_CONF_PROBING */
+#if RPL_FAST_REPAIR
+/* Backup parents of the current DAG, best first, and our rank when the
+ * list was built */
+static rpl_parent_t *backup_parents[RPL_BACKUP_PARENTS];
+static uint8_t backup_count;
+static rpl_rank_t backup_max_rank;
+static void update_backup_parents(rpl_dag_t *dag);
+#endif /* RPL_FAST_REPAIR */
 /*---------------------------------------------------------------------------*/
 /* Allocate instance table. */
 rpl_instance_t instance_table[RPL_MAX_INSTANCES];
@@ -156,7 +197,8 @@ rpl_set_preferred_parent(rpl_dag_t *dag, rpl_parent_t *p)
      * neighbor table. */
 #if RPL_CONF_PROBING_LOCK_ALL
     /* Unlock only if the neighbor is not probed */
-    if(dag->preferred_parent->tx_count < RPL_CONF_PROBING_TX_THRESHOLD) {
+    if(dag->preferred_parent != NULL
+       && dag->preferred_parent->tx_count < RPL_CONF_PROBING_TX_THRESHOLD) {
       nbr_table_unlock(rpl_parents, dag->preferred_parent);
     }
 #else /* RPL_CONF_PROBING_LOCK_ALL */
@@ -589,11 +631,114 @@ rpl_free_dag(rpl_dag_t *dag)
 }
 /*---------------------------------------------------------------------------*/
 #if RPL_CONF_RSSI_BASED_ETX
+/* A platform calibration of the initial ETX, as points of increasing RSSI
+ * interpolated linearly, e.g.:
+ * #define RPL_CONF_RSSI_ETX_TABLE { { -85, 3 * RPL_DAG_MC_ETX_DIVISOR }, \
+ *                                   { -70, RPL_DAG_MC_ETX_DIVISOR } }
+ * Without it, learning starts from the linear PRR model below */
+#ifdef RPL_CONF_RSSI_ETX_TABLE
+#define RSSI_ETX_TABLE RPL_CONF_RSSI_ETX_TABLE
+#elif RPL_RSSI_ETX_LEARNING
+#define RSSI_ETX_TABLE { { -80, 3 * RPL_DAG_MC_ETX_DIVISOR }, \
+                         { -75, 2 * RPL_DAG_MC_ETX_DIVISOR }, \
+                         { -70, 3 * RPL_DAG_MC_ETX_DIVISOR / 2 }, \
+                         { -65, 6 * RPL_DAG_MC_ETX_DIVISOR / 5 }, \
+                         { -60, RPL_DAG_MC_ETX_DIVISOR } }
+#endif
+
+#ifdef RSSI_ETX_TABLE
+struct rssi_etx {
+  int16_t rssi;
+  uint16_t etx;
+};
+#if RPL_RSSI_ETX_LEARNING
+static struct rssi_etx rssi_etx_table[] = RSSI_ETX_TABLE;
+#else
+static const struct rssi_etx rssi_etx_table[] = RSSI_ETX_TABLE;
+#endif
+#define RSSI_ETX_POINTS ((int)(sizeof(rssi_etx_table) / sizeof(rssi_etx_table[0])))
+/* Weight of a learned ETX, as a divisor */
+#define RSSI_ETX_LEARNING_DIV 8
+
+/*---------------------------------------------------------------------------*/
+/* Index of the point at or below rssi, within the table range */
+static int
+rssi_etx_index(int16_t rssi)
+{
+  int i;
+  for(i = 0; i < RSSI_ETX_POINTS - 2; i++) {
+    if(rssi < rssi_etx_table[i + 1].rssi) {
+      break;
+    }
+  }
+  return i;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+rssi_etx_lookup(int16_t rssi)
+{
+  const struct rssi_etx *a, *b;
+  int i;
+
+  if(RSSI_ETX_POINTS == 1 || rssi <= rssi_etx_table[0].rssi) {
+    return rssi_etx_table[0].etx;
+  }
+  if(rssi >= rssi_etx_table[RSSI_ETX_POINTS - 1].rssi) {
+    return rssi_etx_table[RSSI_ETX_POINTS - 1].etx;
+  }
+  i = rssi_etx_index(rssi);
+  a = &rssi_etx_table[i];
+  b = &rssi_etx_table[i + 1];
+  return a->etx + ((int32_t)b->etx - a->etx) * (rssi - a->rssi) / (b->rssi - a->rssi);
+}
+/*---------------------------------------------------------------------------*/
+#if RPL_RSSI_ETX_LEARNING
+/* Moves the two points around rssi towards etx, each in proportion to
+ * its closeness to rssi */
+void
+rpl_rssi_etx_learn(int16_t rssi, uint16_t etx)
+{
+  struct rssi_etx *a, *b;
+  int32_t span;
+  int32_t wb;
+  int i;
+
+  if(RSSI_ETX_POINTS == 1 || rssi <= rssi_etx_table[0].rssi) {
+    a = &rssi_etx_table[0];
+    a->etx += ((int32_t)etx - a->etx) / RSSI_ETX_LEARNING_DIV;
+  } else if(rssi >= rssi_etx_table[RSSI_ETX_POINTS - 1].rssi) {
+    a = &rssi_etx_table[RSSI_ETX_POINTS - 1];
+    a->etx += ((int32_t)etx - a->etx) / RSSI_ETX_LEARNING_DIV;
+  } else {
+    i = rssi_etx_index(rssi);
+    a = &rssi_etx_table[i];
+    b = &rssi_etx_table[i + 1];
+    span = (int32_t)(b->rssi - a->rssi) * RSSI_ETX_LEARNING_DIV;
+    wb = rssi - a->rssi;
+    a->etx += ((int32_t)etx - a->etx) * (b->rssi - a->rssi - wb) / span;
+    b->etx += ((int32_t)etx - b->etx) * wb / span;
+  }
+
+  PRINTF("RPL: learned ETX %u at RSSI %d\n", etx, rssi);
+}
+#endif /* RPL_RSSI_ETX_LEARNING */
+#endif /* RSSI_ETX_TABLE */
+/*---------------------------------------------------------------------------*/
 uint16_t
 rpl_init_link_metric(rpl_parent_t *p, rpl_dio_t *dio) {
   if(dio == NULL) {
     return RPL_INIT_LINK_METRIC * RPL_DAG_MC_ETX_DIVISOR;
   } else {
+#ifdef RSSI_ETX_TABLE
+#define MAX_INIT_ETX (3*RPL_DAG_MC_ETX_DIVISOR) /* Bound the resulting ETX to 3 */
+    uint16_t etx = rssi_etx_lookup(dio->rssi);
+    if(etx > MAX_INIT_ETX) {
+      etx = MAX_INIT_ETX;
+    } else if(etx < RPL_DAG_MC_ETX_DIVISOR) {
+      etx = RPL_DAG_MC_ETX_DIVISOR;
+    }
+    return etx;
+#else /* RSSI_ETX_TABLE */
     /* Our rough, pessimistic estimate of PRR from RSSI, based on measurements
      * in the Indriya testbed, is a linear function where:
      *      RSSI >= -60 results in PRR of 1
@@ -621,6 +766,7 @@ rpl_init_link_metric(rpl_parent_t *p, rpl_dio_t *dio) {
       //  LOG_NODEID_FROM_LINKADDR(nbr_table_get_lladdr(rpl_parents, p)),
         //dio->rssi, etx);
     return etx;
+#endif /* RSSI_ETX_TABLE */
   }
 }
 #endif /* RPL_CONF_RSSI_BASED_ETX */
@@ -650,12 +796,18 @@ rpl_add_parent(rpl_dag_t *dag, rpl_dio_t *dio, uip_ipaddr_t *addr)
       p->rank = dio->rank;
       p->dtsn = dio->dtsn;
       p->tx_count = 0;
+      p->flags &= ~RPL_PARENT_FLAG_DIO_FINGERPRINT;
+      rpl_of_invalidate_path_cost(p);
 #if RPL_CONF_RSSI_BASED_ETX
       p->link_metric = rpl_init_link_metric(p, dio);
 #else
       p->link_metric = RPL_INIT_LINK_METRIC * RPL_DAG_MC_ETX_DIVISOR;
+#endif
+#ifdef RPL_CALLBACK_LINK_METRIC
+      p->link_metric = RPL_CALLBACK_LINK_METRIC((const linkaddr_t *)lladdr, p->link_metric);
 #endif
       p->rssi = dio->rssi;
+      RPL_PARENT_HEARD(p);
 #if RPL_DAG_MC != RPL_DAG_MC_NONE
       memcpy(&p->mc, &dio->mc, sizeof(p->mc));
 #endif /* RPL_DAG_MC != RPL_DAG_MC_NONE */
@@ -780,9 +932,13 @@ rpl_select_dag(rpl_instance_t *instance, rpl_parent_t *p)
     PRINTF("RPL: Changed preferred parent, rank changed from %u to %u\n",
   	(unsigned)old_rank, best_dag->rank);
     RPL_STAT(rpl_stats.parent_switch++);
+#if RPL_LOOP_STATS
+    rpl_loop_stats.last_switch = clock_seconds();
+#endif /* RPL_LOOP_STATS */
     if(RPL_CONF_MOP != RPL_MOP_NO_DOWNWARD_ROUTES) {
-      if(last_parent != NULL) {
-        /* Send a No-Path DAO to the removed preferred parent. */
+      if(RPL_WITH_STORING && last_parent != NULL) {
+        /* Send a No-Path DAO to the removed preferred parent. In
+         * non-storing mode, the new DAO updates the root. */
         dao_output(last_parent, RPL_ZERO_LIFETIME);
       }
       /* The DAO parent set changed - schedule a DAO transmission. */
@@ -800,6 +956,9 @@ rpl_select_dag(rpl_instance_t *instance, rpl_parent_t *p)
                 best_dag->preferred_parent != NULL ? best_dag->preferred_parent->link_metric : INFINITE_RANK
                 );
   }
+#if RPL_FAST_REPAIR
+  update_backup_parents(best_dag);
+#endif /* RPL_FAST_REPAIR */
   return best_dag;
 }
 /*---------------------------------------------------------------------------*/
@@ -830,6 +989,44 @@ best_parent(rpl_dag_t *dag)
 }
 /*---------------------------------------------------------------------------*/
 #if RPL_CONF_PROBING
+/* Sends a DIO probe to p if the budget allows it */
+static void
+send_probe(rpl_parent_t *p)
+{
+#if RPL_PROBING_BUDGET
+  if(clock_time() - budget_start >= RPL_PROBING_BUDGET_PERIOD) {
+    budget_start = clock_time();
+    budget_used = 0;
+  }
+  if(budget_used >= RPL_PROBING_BUDGET) {
+    rpl_probing_stats.over_budget++;
+    return;
+  }
+  budget_used++;
+#endif /* RPL_PROBING_BUDGET */
+  LOG("RPL: probing %u (%u tx)\n",
+      LOG_NODEID_FROM_IPADDR(rpl_get_parent_ipaddr(p)), p->tx_count);
+#ifdef RPL_CALLBACK_PROBE
+  /* Lets the MAC layer know the next DIO to p is a probe */
+  RPL_CALLBACK_PROBE(nbr_table_get_lladdr(rpl_parents, p));
+#endif
+  rpl_probing_stats.sent++;
+  dio_output(p->dag->instance, rpl_get_parent_ipaddr(p));
+}
+/*---------------------------------------------------------------------------*/
+#if WITH_PROBING_COALESCE
+static void
+handle_probe_pending_timer(void *ptr)
+{
+  /* No upward data came: send the probe */
+  rpl_parent_t *p = probe_pending;
+  probe_pending = NULL;
+  if(p != NULL && p->dag != NULL) {
+    send_probe(p);
+  }
+}
+#endif /* WITH_PROBING_COALESCE */
+/*---------------------------------------------------------------------------*/
 static void
 handle_probing_timer(void *ptr)
 {
@@ -839,7 +1036,7 @@ handle_probing_timer(void *ptr)
   rpl_parent_t *p, *second_best, *probing_target;
   rpl_rank_t second_best_rank;
 
-  if(best->tx_count < RPL_CONF_PROBING_TX_THRESHOLD) {
+  if(best != NULL && best->tx_count < RPL_CONF_PROBING_TX_THRESHOLD) {
     probing_target = best;
   } else {
     /* Look for the second best parent. Must be done without the
@@ -868,9 +1065,16 @@ handle_probing_timer(void *ptr)
   }
 
   if(probing_target != NULL && probing_target->tx_count < RPL_CONF_PROBING_TX_THRESHOLD) {
-    LOG("RPL: probing %u (%u tx)\n",
-        LOG_NODEID_FROM_IPADDR(rpl_get_parent_ipaddr(probing_target)), probing_target->tx_count);
-    dio_output(dag->instance, rpl_get_parent_ipaddr(probing_target));
+#if WITH_PROBING_COALESCE
+    if(rpl_is_upward_parent(probing_target)) {
+      /* Give upward data a chance to do the probing */
+      probe_pending = probing_target;
+      ctimer_set(&probe_pending_timer, RPL_PROBING_COALESCE_WINDOW,
+                 handle_probe_pending_timer, NULL);
+      return;
+    }
+#endif /* WITH_PROBING_COALESCE */
+    send_probe(probing_target);
   }
 }
 #endif /* RPL_CONF_PROBING */
@@ -914,6 +1118,37 @@ rpl_remove_parent(rpl_parent_t *parent)
   PRINTF("\n");
 
   rpl_nullify_parent(parent);
+#if WITH_PROBING_COALESCE
+  if(parent == probe_pending) {
+    probe_pending = NULL;
+    ctimer_stop(&probe_pending_timer);
+  }
+#endif /* WITH_PROBING_COALESCE */
+#if RPL_INCREMENTAL_RANKS
+  if(parent->flags & RPL_PARENT_FLAG_UPDATED) {
+    /* Take it out of the update FIFO */
+    uint8_t i, j;
+    for(i = 0, j = 0; i < updated_count; i++) {
+      rpl_parent_t *p = updated_parents[(updated_head + i) % NBR_TABLE_MAX_NEIGHBORS];
+      if(p != parent) {
+        updated_parents[(updated_head + j++) % NBR_TABLE_MAX_NEIGHBORS] = p;
+      }
+    }
+    updated_count = j;
+    parent->flags &= ~RPL_PARENT_FLAG_UPDATED;
+  }
+#endif /* RPL_INCREMENTAL_RANKS */
+#if RPL_FAST_REPAIR
+  {
+    uint8_t i, j;
+    for(i = 0, j = 0; i < backup_count; i++) {
+      if(backup_parents[i] != parent) {
+        backup_parents[j++] = backup_parents[i];
+      }
+    }
+    backup_count = j;
+  }
+#endif /* RPL_FAST_REPAIR */
 
   nbr_table_remove(rpl_parents, parent);
 }
@@ -1011,6 +1246,26 @@ rpl_find_of(rpl_ocp_t ocp)
 
   return NULL;
 }
+#if RPL_DIO_CONTEXTS
+/*---------------------------------------------------------------------------*/
+/* Installs the 6LoWPAN contexts advertised in a DIO of our DAG */
+static void
+update_contexts(rpl_dio_t *dio)
+{
+  uint8_t i;
+  uint8_t number;
+
+  for(i = 0; i < dio->num_contexts; i++) {
+    number = dio->contexts[i].flags & RPL_CONTEXT_CID_MASK;
+    if(dio->contexts[i].lifetime == 0) {
+      sicslowpan_context_remove(number);
+    } else if(!sicslowpan_context_set(number, &dio->contexts[i].prefix,
+                                      dio->contexts[i].flags & RPL_CONTEXT_FLAG_C)) {
+      PRINTF("RPL: No room for 6LoWPAN context %u\n", number);
+    }
+  }
+}
+#endif /* RPL_DIO_CONTEXTS */
 /*---------------------------------------------------------------------------*/
 void
 rpl_join_instance(uip_ipaddr_t *from, rpl_dio_t *dio)
@@ -1098,6 +1353,10 @@ rpl_join_instance(uip_ipaddr_t *from, rpl_dio_t *dio)
 
   ANNOTATE("#A join=%u\n", dag->dag_id.u8[sizeof(dag->dag_id) - 1]);
 
+#if RPL_DIO_CONTEXTS
+  update_contexts(dio);
+#endif /* RPL_DIO_CONTEXTS */
+
   rpl_reset_dio_timer(instance, 4);
   rpl_set_default_route(instance, from);
 
@@ -1216,6 +1475,86 @@ global_repair(uip_ipaddr_t *from, rpl_dag_t *dag, rpl_dio_t *dio)
   RPL_STAT(rpl_stats.global_repairs++);
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_FAST_REPAIR
+/* Can p take over as preferred parent after a local repair? */
+static int
+is_valid_backup(rpl_dag_t *dag, rpl_parent_t *p)
+{
+  return p->dag == dag && p != dag->preferred_parent
+      && p->rank != INFINITE_RANK && p->rank < backup_max_rank
+      && (uint16_t)((uint16_t)clock_seconds() - p->last_heard) < RPL_BACKUP_PARENT_FRESHNESS;
+}
+/*---------------------------------------------------------------------------*/
+/* Rank the parents closer to the root than us, best first */
+static void
+update_backup_parents(rpl_dag_t *dag)
+{
+  rpl_of_t *of = dag->instance->of;
+  rpl_parent_t *p;
+  uint8_t i;
+
+  if(dag->preferred_parent == NULL || dag->rank == INFINITE_RANK) {
+    /* Keep the list of our last valid rank for the repair */
+    return;
+  }
+  backup_count = 0;
+  backup_max_rank = dag->rank;
+  for(p = nbr_table_head(rpl_parents); p != NULL; p = nbr_table_next(rpl_parents, p)) {
+    if(!is_valid_backup(dag, p)) {
+      continue;
+    }
+    /* Insertion, dropping the worst one when full */
+    i = backup_count < RPL_BACKUP_PARENTS ? backup_count++ : RPL_BACKUP_PARENTS;
+    while(i > 0 && of->best_parent(backup_parents[i - 1], p) == p) {
+      if(i < RPL_BACKUP_PARENTS) {
+        backup_parents[i] = backup_parents[i - 1];
+      }
+      i--;
+    }
+    if(i < RPL_BACKUP_PARENTS) {
+      backup_parents[i] = p;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Make the best valid backup our preferred parent. Returns 1 on success */
+static int
+promote_backup_parent(rpl_instance_t *instance)
+{
+  rpl_dag_t *dag = instance->current_dag;
+  rpl_parent_t *old = dag->preferred_parent;
+  rpl_parent_t *p;
+  uint8_t i;
+
+  if(dag->rank == ROOT_RANK(instance)) {
+    return 0;
+  }
+  for(i = 0; i < backup_count; i++) {
+    p = backup_parents[i];
+    if(is_valid_backup(dag, p)) {
+      backup_count = 0;
+      rpl_set_preferred_parent(dag, p);
+      dag->rank = instance->of->calculate_rank(p, 0);
+      /* Our rank before the repair is forgotten */
+      dag->min_rank = dag->rank;
+      rpl_set_default_route(instance, rpl_get_parent_ipaddr(p));
+      if(RPL_CONF_MOP != RPL_MOP_NO_DOWNWARD_ROUTES) {
+        if(RPL_WITH_STORING && old != NULL) {
+          dao_output(old, RPL_ZERO_LIFETIME);
+        }
+        RPL_LOLLIPOP_INCREMENT(instance->dtsn_out);
+        rpl_schedule_dao(instance);
+      }
+      LOG("RPL: local repair, backup %u promoted, rank %u\n",
+          LOG_NODEID_FROM_IPADDR(rpl_get_parent_ipaddr(p)), dag->rank);
+      update_backup_parents(dag);
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif /* RPL_FAST_REPAIR */
+/*---------------------------------------------------------------------------*/
 void
 rpl_local_repair(rpl_instance_t *instance)
 {
@@ -1225,6 +1564,12 @@ rpl_local_repair(rpl_instance_t *instance)
     PRINTF("RPL: local repair requested for instance NULL\n");
     return;
   }
+#if RPL_FAST_REPAIR
+  if(promote_backup_parent(instance)) {
+    RPL_STAT(rpl_stats.local_repairs++);
+    return;
+  }
+#endif /* RPL_FAST_REPAIR */
   LOG("RPL: local repair\n");
   for(i = 0; i < RPL_MAX_DAG_PER_INSTANCE; i++) {
     if(instance->dag_table[i].used) {
@@ -1239,6 +1584,186 @@ rpl_local_repair(rpl_instance_t *instance)
   RPL_STAT(rpl_stats.local_repairs++);
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_INCREMENTAL_RANKS
+/* Returns 1 if an update of p cannot change the parent selection: p is a
+ * valid parent of the current DAG that still loses to the preferred one */
+static int
+parent_update_is_local(rpl_parent_t *p)
+{
+#if WITH_OF_HOP_ETX
+  /* Selection is not pairwise */
+  return 0;
+#else /* WITH_OF_HOP_ETX */
+  rpl_dag_t *dag = p->dag;
+  rpl_instance_t *instance = dag->instance;
+  rpl_parent_t *preferred = dag->preferred_parent;
+  return dag == instance->current_dag && preferred != NULL && p != preferred
+      && p->rank != INFINITE_RANK && acceptable_rank(dag, p->rank)
+      && instance->of->best_parent(preferred, p) == preferred;
+#endif /* WITH_OF_HOP_ETX */
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_rank_updates(void *ptr)
+{
+  int i;
+  for(i = 0; i < RPL_RANK_UPDATES_PER_EVENT && updated_count > 0; i++) {
+    rpl_parent_t *p = updated_parents[updated_head];
+    updated_head = (updated_head + 1) % NBR_TABLE_MAX_NEIGHBORS;
+    updated_count--;
+    p->flags &= ~RPL_PARENT_FLAG_UPDATED;
+    if(p->dag != NULL && p->dag->instance != NULL && !parent_update_is_local(p)) {
+      PRINTF("RPL: rpl_process_parent_event rank update\n");
+      if(!rpl_process_parent_event(p->dag->instance, p)) {
+        PRINTF("RPL: A parent was dropped\n");
+      }
+    }
+  }
+  if(updated_count > 0) {
+    /* Leave room for other events before the next ones */
+    ctimer_set(&rank_update_timer, 0, handle_rank_updates, NULL);
+  }
+}
+#endif /* RPL_INCREMENTAL_RANKS */
+/*---------------------------------------------------------------------------*/
+void
+rpl_parent_updated(rpl_parent_t *p)
+{
+#if RPL_INCREMENTAL_RANKS
+  if(!(p->flags & RPL_PARENT_FLAG_UPDATED)) {
+    updated_parents[(updated_head + updated_count) % NBR_TABLE_MAX_NEIGHBORS] = p;
+    if(updated_count++ == 0) {
+      ctimer_set(&rank_update_timer, 0, handle_rank_updates, NULL);
+    }
+  }
+#endif /* RPL_INCREMENTAL_RANKS */
+  p->flags |= RPL_PARENT_FLAG_UPDATED;
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_is_upward_parent(rpl_parent_t *p)
+{
+  rpl_dag_t *dag = p->dag;
+
+  if(dag == NULL || p != dag->preferred_parent) {
+#if WITH_UPWARD_PARENTS
+    /* Any parent strictly closer to the root, so that the packet is
+     * not taken for a loop */
+    if(dag == NULL || dag != dag->instance->current_dag) {
+      return 0;
+    }
+    return p->rank != INFINITE_RANK
+        && DAG_RANK(p->rank, dag->instance) < DAG_RANK(dag->rank, dag->instance);
+#else /* WITH_UPWARD_PARENTS */
+    return 0;
+#endif /* WITH_UPWARD_PARENTS */
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+#if RPL_MULTIPATH != RPL_MULTIPATH_NONE
+/* An upward parent whose path is not much worse than ours */
+static int
+is_multipath_parent(rpl_parent_t *p)
+{
+  return rpl_is_upward_parent(p)
+      && p->dag->instance->of->calculate_rank(p, 0) <= p->dag->rank + RPL_MULTIPATH_RANK_STRETCH;
+}
+/*---------------------------------------------------------------------------*/
+/* Weight of a parent: the inverse of its link ETX, 16 for a perfect link */
+static unsigned
+upward_weight(rpl_parent_t *p)
+{
+  uint16_t etx = p->link_metric;
+  if(etx < RPL_DAG_MC_ETX_DIVISOR) {
+    etx = RPL_DAG_MC_ETX_DIVISOR;
+  }
+  return (16 * RPL_DAG_MC_ETX_DIVISOR + etx / 2) / etx;
+}
+/*---------------------------------------------------------------------------*/
+#if RPL_MULTIPATH == RPL_MULTIPATH_PER_FLOW
+#define UIP_IP_BUF ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+/* Hash of the source and destination of the packet in uip_buf */
+static uint16_t
+flow_hash(void)
+{
+  uint16_t h = 0;
+  int i;
+  for(i = 0; i < 16; i++) {
+    h = h * 31 + UIP_IP_BUF->srcipaddr.u8[i];
+    h = h * 31 + UIP_IP_BUF->destipaddr.u8[i];
+  }
+  return h ^ (h >> 8);
+}
+#endif /* RPL_MULTIPATH == RPL_MULTIPATH_PER_FLOW */
+#endif /* RPL_MULTIPATH != RPL_MULTIPATH_NONE */
+/*---------------------------------------------------------------------------*/
+uip_ipaddr_t *
+rpl_get_upward_nexthop(uip_ipaddr_t *defrt)
+{
+#if WITH_UPWARD_PARENTS
+  rpl_dag_t *dag;
+  uip_ipaddr_t *addr;
+#if RPL_MULTIPATH != RPL_MULTIPATH_NONE
+  rpl_parent_t *p;
+  unsigned total = 0;
+  unsigned pick;
+#endif /* RPL_MULTIPATH != RPL_MULTIPATH_NONE */
+
+  if(defrt == NULL || default_instance == NULL || !default_instance->used
+     || (dag = default_instance->current_dag) == NULL
+     || dag->preferred_parent == NULL) {
+    return defrt;
+  }
+  /* Only rewrite the default route set by RPL */
+  addr = rpl_get_parent_ipaddr(dag->preferred_parent);
+  if(addr == NULL || !uip_ipaddr_cmp(addr, defrt)) {
+    return defrt;
+  }
+
+#if WITH_PROBING_COALESCE
+  if(probe_pending != NULL && rpl_is_upward_parent(probe_pending)
+     && (addr = rpl_get_parent_ipaddr(probe_pending)) != NULL) {
+    /* The data packet probes the parent */
+    LOG("RPL: probing %u with data (%u tx)\n",
+        LOG_NODEID_FROM_IPADDR(addr), probe_pending->tx_count);
+    probe_pending = NULL;
+    ctimer_stop(&probe_pending_timer);
+    rpl_probing_stats.coalesced++;
+    return addr;
+  }
+#endif /* WITH_PROBING_COALESCE */
+
+#if RPL_MULTIPATH != RPL_MULTIPATH_NONE
+  for(p = nbr_table_head(rpl_parents); p != NULL; p = nbr_table_next(rpl_parents, p)) {
+    if(is_multipath_parent(p) && rpl_get_parent_ipaddr(p) != NULL) {
+      total += upward_weight(p);
+    }
+  }
+  if(total == 0) {
+    return defrt;
+  }
+
+#if RPL_MULTIPATH == RPL_MULTIPATH_PER_FLOW
+  pick = flow_hash() % total;
+#else /* RPL_MULTIPATH == RPL_MULTIPATH_PER_FLOW */
+  pick = random_rand() % total;
+#endif /* RPL_MULTIPATH == RPL_MULTIPATH_PER_FLOW */
+
+  for(p = nbr_table_head(rpl_parents); p != NULL; p = nbr_table_next(rpl_parents, p)) {
+    if(is_multipath_parent(p) && (addr = rpl_get_parent_ipaddr(p)) != NULL) {
+      unsigned weight = upward_weight(p);
+      if(pick < weight) {
+        return addr;
+      }
+      pick -= weight;
+    }
+  }
+#endif /* RPL_MULTIPATH != RPL_MULTIPATH_NONE */
+#endif /* WITH_UPWARD_PARENTS */
+  return defrt;
+}
+/*---------------------------------------------------------------------------*/
 void
 rpl_recalculate_ranks(void)
 {
@@ -1249,6 +1774,10 @@ rpl_recalculate_ranks(void)
    * than RPL protocol messages. This periodical recalculation is called
    * from a timer in order to keep the stack depth reasonably low.
    */
+#if RPL_INCREMENTAL_RANKS
+  /* Updates are processed as they come, see rpl_parent_updated */
+  return;
+#endif /* RPL_INCREMENTAL_RANKS */
   p = nbr_table_head(rpl_parents);
   while(p != NULL) {
     if(p->dag != NULL && p->dag->instance && (p->flags & RPL_PARENT_FLAG_UPDATED)) {
@@ -1332,6 +1861,12 @@ rpl_process_dio(uip_ipaddr_t *from, rpl_dio_t *dio)
   dag = get_dag(dio->instance_id, &dio->dag_id);
   instance = rpl_get_instance(dio->instance_id);
 
+#if RPL_WITH_STORE
+  if(dag != NULL && !lollipop_greater_than(dag->version, dio->version)) {
+    rpl_store_dio_input(from, dio);
+  }
+#endif /* RPL_WITH_STORE */
+
   if(dag != NULL && instance != NULL) {
     if(lollipop_greater_than(dio->version, dag->version)) {
       if(dag->rank == ROOT_RANK(instance)) {
@@ -1390,6 +1925,13 @@ rpl_process_dio(uip_ipaddr_t *from, rpl_dio_t *dio)
     rpl_reset_dio_timer(instance, 8);
   }
 
+#if RPL_DIO_CONTEXTS
+  /* The root owns the contexts, the others learn them from their DAG */
+  if(dag == instance->current_dag && dag->rank != ROOT_RANK(instance)) {
+    update_contexts(dio);
+  }
+#endif /* RPL_DIO_CONTEXTS */
+
   /* Prefix Information Option treated to add new prefix */
   if(dio->prefix_info.length != 0) {
     if(dio->prefix_info.flags & UIP_ND6_RA_FLAG_AUTONOMOUS) {
@@ -1450,6 +1992,7 @@ rpl_process_dio(uip_ipaddr_t *from, rpl_dio_t *dio)
 
   /* Update link quality info */
   p->rssi = dio->rssi;
+  RPL_PARENT_HEARD(p);
 
   PRINTF("RPL: preferred DAG ");
   PRINT6ADDR(&instance->current_dag->dag_id);
@@ -1479,9 +2022,53 @@ rpl_process_dio(uip_ipaddr_t *from, rpl_dio_t *dio)
     uip_ds6_defrt_add(from, RPL_LIFETIME(instance, RPL_DEFAULT_LIFETIME));
   }
   p->dtsn = dio->dtsn;
+#if RPL_DIO_FAST_PATH
+  p->dio_fingerprint = dio->fingerprint;
+  p->flags |= RPL_PARENT_FLAG_DIO_FINGERPRINT;
+#endif /* RPL_DIO_FAST_PATH */
 
   return 0;
 }
+#if RPL_DIO_FAST_PATH
+/*---------------------------------------------------------------------------*/
+/* Handles a DIO identical to the last one accepted from its sender, of
+ * which only the base object is parsed. Returns 0 if the DIO needs full
+ * processing. */
+int
+rpl_process_dio_unchanged(uip_ipaddr_t *from, rpl_dio_t *dio)
+{
+  rpl_parent_t *p;
+  rpl_dag_t *dag;
+
+  p = find_parent_any_dag_any_instance(from);
+  if(p == NULL || !(p->flags & RPL_PARENT_FLAG_DIO_FINGERPRINT) ||
+     p->dio_fingerprint != dio->fingerprint) {
+    return 0;
+  }
+
+  /* Our own view changed since (new version, parent nullified, root):
+   * the same DIO may now call for a different action */
+  dag = p->dag;
+  if(dag == NULL || !dag->used || dag->instance == NULL ||
+     dag->instance->instance_id != dio->instance_id ||
+     dag->version != dio->version ||
+     p->rank != dio->rank || dio->rank == INFINITE_RANK ||
+     dag->rank == ROOT_RANK(dag->instance)) {
+    return 0;
+  }
+
+  if(dag->joined) {
+    dag->instance->dio_counter++;
+    if(p == dag->preferred_parent) {
+      uip_ds6_defrt_add(from, RPL_LIFETIME(dag->instance, RPL_DEFAULT_LIFETIME));
+    }
+  }
+  p->rssi = dio->rssi;
+  RPL_PARENT_HEARD(p);
+
+  return 1;
+}
+#endif /* RPL_DIO_FAST_PATH */
 /*---------------------------------------------------------------------------*/
 int
 rpl_dag_parents_num(void)
@@ -48,6 +48,7 @@
 #include "net/ip/tcpip.h"
 #include "net/ipv6/uip-ds6.h"
 #include "net/rpl/rpl-private.h"
+#include "net/rpl/rpl-ns.h"
 #include "net/packetbuf.h"
 
 #define DEBUG DEBUG_NONE
@@ -64,6 +65,50 @@
 #define UIP_EXT_HDR_OPT_BUF       ((struct uip_ext_hdr_opt *)&uip_buf[uip_l2_l3_hdr_len + uip_ext_opt_offset])
 #define UIP_EXT_HDR_OPT_PADN_BUF  ((struct uip_ext_hdr_opt_padn *)&uip_buf[uip_l2_l3_hdr_len + uip_ext_opt_offset])
 #define UIP_EXT_HDR_OPT_RPL_BUF   ((struct uip_ext_hdr_opt_rpl *)&uip_buf[uip_l2_l3_hdr_len + uip_ext_opt_offset])
+#define UIP_RH_BUF                ((struct uip_routing_hdr *)&uip_buf[uip_l2_l3_hdr_len])
+#define UIP_RPL_SRH_BUF           ((uint8_t *)&uip_buf[uip_l2_l3_hdr_len + 4])
+#define UIP_FIRST_RH_BUF          ((struct uip_routing_hdr *)&uip_buf[UIP_LLIPH_LEN])
+#define UIP_HOP_TS_BUF            ((uint8_t *)&uip_buf[uip_l2_l3_hdr_len + RPL_HOP_BY_HOP_LEN - RPL_HOP_TS_LEN])
+
+#if RPL_HOP_TIMESTAMPS
+#ifdef RPL_CALLBACK_HOP_TIMESTAMP
+uint16_t RPL_CALLBACK_HOP_TIMESTAMP(void);
+#define RPL_HOP_TIMESTAMP() RPL_CALLBACK_HOP_TIMESTAMP()
+#else
+#define RPL_HOP_TIMESTAMP() ((uint16_t)clock_time())
+#endif
+#endif /* RPL_HOP_TIMESTAMPS */
+/*---------------------------------------------------------------------------*/
+#if RPL_LOOP_STATS
+struct rpl_loop_stats rpl_loop_stats;
+
+static void
+loop_event(uint8_t type, rpl_rank_t sender_rank, rpl_rank_t rank, int dropped)
+{
+  struct rpl_loop_event *e;
+  unsigned long since_switch = clock_seconds() - rpl_loop_stats.last_switch;
+
+  rpl_loop_stats.count[type]++;
+  if(dropped) {
+    rpl_loop_stats.dropped++;
+  }
+  if(rpl_loop_stats.history_count == RPL_LOOP_HISTORY_LEN) {
+    /* Drop the oldest event */
+    memmove(&rpl_loop_stats.history[0], &rpl_loop_stats.history[1],
+            (RPL_LOOP_HISTORY_LEN - 1) * sizeof(struct rpl_loop_event));
+    rpl_loop_stats.history_count--;
+  }
+  e = &rpl_loop_stats.history[rpl_loop_stats.history_count++];
+  linkaddr_copy(&e->sender, packetbuf_addr(PACKETBUF_ADDR_SENDER));
+  e->sender_rank = sender_rank;
+  e->rank = rank;
+  e->since_switch = since_switch > 0xffff ? 0xffff : since_switch;
+  e->type = type;
+}
+#define LOOP_EVENT(type, sender_rank, rank, dropped) loop_event(type, sender_rank, rank, dropped)
+#else /* RPL_LOOP_STATS */
+#define LOOP_EVENT(type, sender_rank, rank, dropped)
+#endif /* RPL_LOOP_STATS */
 /*---------------------------------------------------------------------------*/
 int
 rpl_verify_header(int uip_ext_opt_offset)
@@ -74,7 +119,7 @@ rpl_verify_header(int uip_ext_opt_offset)
   uint8_t sender_closer;
   uip_ds6_route_t *route;
 
-  if(UIP_HBHO_BUF->len != RPL_HOP_BY_HOP_LEN - 8) {
+  if(UIP_HBHO_BUF->len != RPL_HOP_BY_HOP_EXT_LEN) {
     PRINTF("RPL: Hop-by-hop extension header has wrong size\n");
     return 1;
   }
@@ -96,7 +141,7 @@ rpl_verify_header(int uip_ext_opt_offset)
     return 1;
   }
 
-  if(RPL_CONF_MOP != RPL_MOP_NO_DOWNWARD_ROUTES && UIP_EXT_HDR_OPT_RPL_BUF->flags & RPL_HDR_OPT_FWD_ERR) {
+  if(RPL_WITH_STORING && UIP_EXT_HDR_OPT_RPL_BUF->flags & RPL_HDR_OPT_FWD_ERR) {
     PRINTF("RPL: Forward error!\n");
     /* We should try to repair it by removing the neighbor that caused
        the packet to be forwareded in the first place. We drop any
@@ -107,6 +152,8 @@ rpl_verify_header(int uip_ext_opt_offset)
       uip_ds6_route_rm(route);
     }
     RPL_STAT(rpl_stats.forward_errors++);
+    LOOP_EVENT(RPL_LOOP_FWD_ERROR_RECEIVED, UIP_HTONS(UIP_EXT_HDR_OPT_RPL_BUF->senderrank),
+               instance->current_dag->rank, 1);
     /* Trigger DAO retransmission */
     rpl_reset_dio_timer(instance, 17);
     /* drop the packet as it is not routable */
@@ -148,11 +195,13 @@ rpl_verify_header(int uip_ext_opt_offset)
 
     if(UIP_EXT_HDR_OPT_RPL_BUF->flags & RPL_HDR_OPT_RANK_ERR) {
       PRINTF("RPL: Rank error signalled in RPL option!\n");
+      LOOP_EVENT(RPL_LOOP_RANK_ERROR_REPAIR, sender_rank, instance->current_dag->rank, 0);
       rpl_reset_dio_timer(instance, 9);
       /* Forward the packet anyway. */
       return 0;
     }
     PRINTF("RPL: Single error tolerated\n");
+    LOOP_EVENT(RPL_LOOP_RANK_ERROR, sender_rank, instance->current_dag->rank, 0);
     UIP_EXT_HDR_OPT_RPL_BUF->flags |= RPL_HDR_OPT_RANK_ERR;
     return 0;
   }
@@ -171,20 +220,45 @@ set_rpl_opt(unsigned uip_ext_opt_offset)
   memset(UIP_HBHO_BUF, 0, RPL_HOP_BY_HOP_LEN);
   UIP_HBHO_BUF->next = UIP_IP_BUF->proto;
   UIP_IP_BUF->proto = UIP_PROTO_HBHO;
-  UIP_HBHO_BUF->len = RPL_HOP_BY_HOP_LEN - 8;
+  UIP_HBHO_BUF->len = RPL_HOP_BY_HOP_EXT_LEN;
   UIP_EXT_HDR_OPT_RPL_BUF->opt_type = UIP_EXT_HDR_OPT_RPL;
   UIP_EXT_HDR_OPT_RPL_BUF->opt_len = RPL_HDR_OPT_LEN;
   UIP_EXT_HDR_OPT_RPL_BUF->flags = 0;
   UIP_EXT_HDR_OPT_RPL_BUF->instance = 0;
   UIP_EXT_HDR_OPT_RPL_BUF->senderrank = 0;
+#if RPL_HOP_TIMESTAMPS
+  UIP_HOP_TS_BUF[0] = RPL_HOP_TS_OPT_TYPE;
+  UIP_HOP_TS_BUF[1] = RPL_HOP_TS_LEN - 2;
+#endif /* RPL_HOP_TIMESTAMPS */
   uip_len += RPL_HOP_BY_HOP_LEN;
   temp_len = UIP_IP_BUF->len[1];
-  UIP_IP_BUF->len[1] += UIP_HBHO_BUF->len + 8;
+  UIP_IP_BUF->len[1] += RPL_HOP_BY_HOP_LEN;
   if(UIP_IP_BUF->len[1] < temp_len) {
     UIP_IP_BUF->len[0]++;
   }
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_HOP_TIMESTAMPS
+static void
+add_hop_timestamp(void)
+{
+  uint8_t *opt = UIP_HOP_TS_BUF;
+  uint16_t timestamp;
+
+  if(opt[0] != RPL_HOP_TS_OPT_TYPE || opt[2] >= RPL_HOP_TIMESTAMPS) {
+    /* No slot left, the timestamps of the first hops are kept */
+    return;
+  }
+  timestamp = RPL_HOP_TIMESTAMP();
+  opt[3 + 2 * opt[2]] = timestamp >> 8;
+  opt[4 + 2 * opt[2]] = timestamp & 0xff;
+  opt[2]++;
+}
+#define ADD_HOP_TIMESTAMP() add_hop_timestamp()
+#else /* RPL_HOP_TIMESTAMPS */
+#define ADD_HOP_TIMESTAMP()
+#endif /* RPL_HOP_TIMESTAMPS */
+/*---------------------------------------------------------------------------*/
 int
 rpl_update_header_empty(void)
 {
@@ -193,6 +267,15 @@ rpl_update_header_empty(void)
   int last_uip_ext_len;
   rpl_parent_t *parent;
 
+#if RPL_WITH_NON_STORING
+  if(default_instance != NULL && default_instance->current_dag->rank == ROOT_RANK(default_instance)
+     && rpl_ns_is_node_reachable(default_instance->current_dag, &UIP_IP_BUF->destipaddr)) {
+    /* Going down from the root: the source route replaces the RPL option */
+    rpl_remove_header();
+    return !rpl_insert_srh_header();
+  }
+#endif /* RPL_WITH_NON_STORING */
+
   last_uip_ext_len = uip_ext_len;
   uip_ext_len = 0;
   uip_ext_opt_offset = 2;
@@ -201,7 +284,7 @@ rpl_update_header_empty(void)
 
   switch(UIP_IP_BUF->proto) {
   case UIP_PROTO_HBHO:
-    if(UIP_HBHO_BUF->len != RPL_HOP_BY_HOP_LEN - 8) {
+    if(UIP_HBHO_BUF->len != RPL_HOP_BY_HOP_EXT_LEN) {
       PRINTF("RPL: Hop-by-hop extension header has wrong size\n");
       uip_ext_len = last_uip_ext_len;
       return 0;
@@ -230,6 +313,7 @@ rpl_update_header_empty(void)
       return 0;
     }
     set_rpl_opt(uip_ext_opt_offset);
+    ADD_HOP_TIMESTAMP();
     uip_ext_len = last_uip_ext_len + RPL_HOP_BY_HOP_LEN;
     return 0;
   }
@@ -243,10 +327,12 @@ rpl_update_header_empty(void)
        which states that if a packet is going down it should in
        general not go back up again. If this happens, a
        RPL_HDR_OPT_FWD_ERR should be flagged. */
-    if(RPL_CONF_MOP != RPL_MOP_NO_DOWNWARD_ROUTES && (UIP_EXT_HDR_OPT_RPL_BUF->flags & RPL_HDR_OPT_DOWN)) {
+    if(RPL_WITH_STORING && (UIP_EXT_HDR_OPT_RPL_BUF->flags & RPL_HDR_OPT_DOWN)) {
       if(uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr) == NULL) {
         UIP_EXT_HDR_OPT_RPL_BUF->flags |= RPL_HDR_OPT_FWD_ERR;
         PRINTF("RPL forwarding error\n");
+        LOOP_EVENT(RPL_LOOP_FWD_ERROR_SENT, UIP_HTONS(UIP_EXT_HDR_OPT_RPL_BUF->senderrank),
+                   instance->current_dag->rank, 1);
         /* We should send back the packet to the originating parent,
            but it is not feasible yet, so we send a No-Path DAO instead */
         PRINTF("RPL generate No-Path DAO\n");
@@ -273,6 +359,7 @@ rpl_update_header_empty(void)
       }
     }
 
+    ADD_HOP_TIMESTAMP();
     uip_ext_len = last_uip_ext_len;
     return 0;
   default:
@@ -294,7 +381,7 @@ rpl_update_header_final(uip_ipaddr_t *addr)
   uip_ext_opt_offset = 2;
 
   if(UIP_IP_BUF->proto == UIP_PROTO_HBHO) {
-    if(UIP_HBHO_BUF->len != RPL_HOP_BY_HOP_LEN - 8) {
+    if(UIP_HBHO_BUF->len != RPL_HOP_BY_HOP_EXT_LEN) {
       PRINTF("RPL: Non RPL Hop-by-hop options support not implemented\n");
       uip_ext_len = last_uip_ext_len;
       return 0;
@@ -308,7 +395,7 @@ rpl_update_header_final(uip_ipaddr_t *addr)
           return 1;
         }
         parent = rpl_find_parent(default_instance->current_dag, addr);
-        if(parent == NULL || parent != parent->dag->preferred_parent) {
+        if(parent == NULL || !rpl_is_upward_parent(parent)) {
           UIP_EXT_HDR_OPT_RPL_BUF->flags = RPL_HDR_OPT_DOWN;
         }
         UIP_EXT_HDR_OPT_RPL_BUF->instance = default_instance->instance_id;
@@ -332,8 +419,8 @@ rpl_remove_header(void)
     PRINTF("RPL: Removing the RPL header option\n");
     UIP_IP_BUF->proto = UIP_HBHO_BUF->next;
     temp_len = UIP_IP_BUF->len[1];
-    uip_len -= UIP_HBHO_BUF->len + 8;
-    UIP_IP_BUF->len[1] -= UIP_HBHO_BUF->len + 8;
+    uip_len -= (UIP_HBHO_BUF->len << 3) + 8;
+    UIP_IP_BUF->len[1] -= (UIP_HBHO_BUF->len << 3) + 8;
     if(UIP_IP_BUF->len[1] > temp_len) {
       UIP_IP_BUF->len[0]--;
     }
@@ -379,10 +466,208 @@ rpl_invert_header(void)
   }
 }
 /*---------------------------------------------------------------------------*/
+/* Copies the hop timestamps of the packet in uip_buf, the source's first,
+ * followed by the local timestamp. Differences between consecutive entries
+ * are the per-hop queueing plus MAC delays. Returns the number of entries. */
+int
+rpl_get_hop_timestamps(uint16_t *timestamps, int max)
+{
+#if RPL_HOP_TIMESTAMPS
+  uint8_t *opt = &uip_buf[UIP_LLIPH_LEN + RPL_HOP_BY_HOP_LEN - RPL_HOP_TS_LEN];
+  int i;
+
+  if(UIP_IP_BUF->proto != UIP_PROTO_HBHO
+     || ((struct uip_hbho_hdr *)&uip_buf[UIP_LLIPH_LEN])->len != RPL_HOP_BY_HOP_EXT_LEN
+     || opt[0] != RPL_HOP_TS_OPT_TYPE || opt[2] >= max) {
+    return 0;
+  }
+  for(i = 0; i < opt[2]; i++) {
+    timestamps[i] = (opt[3 + 2 * i] << 8) | opt[4 + 2 * i];
+  }
+  timestamps[i++] = RPL_HOP_TIMESTAMP();
+  return i;
+#else /* RPL_HOP_TIMESTAMPS */
+  return 0;
+#endif /* RPL_HOP_TIMESTAMPS */
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the RPL instance ID of the hop-by-hop option of the packet in
+ * uip_buf, -1 if it has none */
+int
+rpl_get_header_instance(void)
+{
+  struct uip_ext_hdr_opt_rpl *opt =
+    (struct uip_ext_hdr_opt_rpl *)&uip_buf[UIP_LLIPH_LEN + 2];
+
+  if(UIP_IP_BUF->proto != UIP_PROTO_HBHO
+     || ((struct uip_hbho_hdr *)&uip_buf[UIP_LLIPH_LEN])->len != RPL_HOP_BY_HOP_EXT_LEN
+     || opt->opt_type != UIP_EXT_HDR_OPT_RPL) {
+    return -1;
+  }
+  return opt->instance;
+}
+/*---------------------------------------------------------------------------*/
+#if RPL_WITH_NON_STORING
+/* Inserts, at the root, a source routing header towards the destination
+ * if it is a node of our DAG. Returns 0 if the packet has to be dropped */
+int
+rpl_insert_srh_header(void)
+{
+  rpl_dag_t *dag;
+  rpl_ns_node_t *dest_node;
+  rpl_ns_node_t *root_node;
+  rpl_ns_node_t *node;
+  uint8_t *addr;
+  int last_uip_ext_len;
+  int path_len;
+  int ext_len;
+  int i;
+  uint16_t len;
+
+  if(default_instance == NULL || uip_is_addr_mcast(&UIP_IP_BUF->destipaddr)) {
+    return 1;
+  }
+  dag = default_instance->current_dag;
+  if(dag == NULL || dag->rank != ROOT_RANK(default_instance)
+     || !rpl_ns_is_node_reachable(dag, &UIP_IP_BUF->destipaddr)) {
+    return 1;
+  }
+  dest_node = rpl_ns_get_node(dag, &UIP_IP_BUF->destipaddr);
+  root_node = rpl_ns_get_node(dag, &dag->dag_id);
+
+  /* Number of hops below the root */
+  path_len = 0;
+  for(node = dest_node; node != root_node; node = node->parent) {
+    path_len++;
+  }
+  if(path_len <= 1) {
+    /* One of our children, no need for a source route */
+    return 1;
+  }
+
+  ext_len = RPL_SRH_LEN(path_len - 1);
+  if(uip_len + ext_len > UIP_BUFSIZE) {
+    PRINTF("RPL: Packet too long: impossible to add source routing header\n");
+    return 0;
+  }
+
+  last_uip_ext_len = uip_ext_len;
+  uip_ext_len = 0;
+  memmove((uint8_t *)UIP_EXT_BUF + ext_len, UIP_EXT_BUF, uip_len - UIP_IPH_LEN);
+  memset(UIP_EXT_BUF, 0, ext_len);
+  UIP_RH_BUF->next = UIP_IP_BUF->proto;
+  UIP_IP_BUF->proto = UIP_PROTO_ROUTING;
+  UIP_RH_BUF->len = (ext_len - 8) / 8;
+  UIP_RH_BUF->routing_type = RPL_RH_TYPE_SRH;
+  UIP_RH_BUF->seg_left = path_len - 1;
+  /* CmprI and CmprE, no padding */
+  UIP_RPL_SRH_BUF[0] = (RPL_SRH_CMPR << 4) | RPL_SRH_CMPR;
+
+  /* The hops after the first one, the destination last */
+  addr = (uint8_t *)UIP_RH_BUF + 8;
+  node = dest_node;
+  for(i = path_len - 2; i >= 0; i--) {
+    memcpy(addr + i * (16 - RPL_SRH_CMPR), node->link_identifier, 16 - RPL_SRH_CMPR);
+    node = node->parent;
+  }
+  /* The first hop is the destination for now */
+  rpl_ns_get_node_global_addr(&UIP_IP_BUF->destipaddr, node);
+
+  uip_len += ext_len;
+  len = (UIP_IP_BUF->len[0] << 8) + UIP_IP_BUF->len[1] + ext_len;
+  UIP_IP_BUF->len[0] = len >> 8;
+  UIP_IP_BUF->len[1] = len & 0xff;
+  uip_ext_len = last_uip_ext_len + ext_len;
+
+  PRINTF("RPL: Source route of %u hops\n", path_len);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Processes the source routing header at uip_ext_len, on the way through
+ * uip6.c. Returns 1 if the packet is to be forwarded to the next hop */
+int
+rpl_process_srh_header(void)
+{
+  uip_ipaddr_t next_hop;
+  uint8_t cmpri;
+  uint8_t cmpre;
+  uint8_t pad;
+  uint8_t *addr;
+  int n;
+  int i;
+
+  if(UIP_RH_BUF->routing_type != RPL_RH_TYPE_SRH || UIP_RH_BUF->seg_left == 0) {
+    return 0;
+  }
+
+  cmpri = UIP_RPL_SRH_BUF[0] >> 4;
+  cmpre = UIP_RPL_SRH_BUF[0] & 0x0f;
+  pad = UIP_RPL_SRH_BUF[1] >> 4;
+  if(cmpri != RPL_SRH_CMPR || cmpre != RPL_SRH_CMPR) {
+    /* We only build headers compressed to the DAG prefix */
+    PRINTF("RPL: Unsupported source routing header compression\n");
+    return 0;
+  }
+
+  n = ((UIP_RH_BUF->len * 8) - pad - (16 - cmpre)) / (16 - cmpri) + 1;
+  if(UIP_RH_BUF->seg_left > n) {
+    PRINTF("RPL: Bad source routing header\n");
+    return 0;
+  }
+  i = n - UIP_RH_BUF->seg_left;
+  addr = (uint8_t *)UIP_RH_BUF + 8 + i * (16 - cmpri);
+
+  uip_ipaddr_copy(&next_hop, &UIP_IP_BUF->destipaddr);
+  memcpy(((uint8_t *)&next_hop) + cmpri, addr, 16 - cmpri);
+  if(uip_ds6_is_my_addr(&next_hop)) {
+    PRINTF("RPL: Loop in source routing header\n");
+    return 0;
+  }
+
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &next_hop);
+  UIP_RH_BUF->seg_left--;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Next hop of a source-routed packet, or of a packet from the root to one
+ * of its children. Returns 1 if ipaddr was set */
+int
+rpl_srh_get_next_hop(uip_ipaddr_t *ipaddr)
+{
+  rpl_dag_t *dag;
+  rpl_ns_node_t *dest_node;
+
+  if(UIP_IP_BUF->proto != UIP_PROTO_ROUTING
+     || UIP_FIRST_RH_BUF->routing_type != RPL_RH_TYPE_SRH) {
+    if(default_instance == NULL || (dag = default_instance->current_dag) == NULL
+       || dag->rank != ROOT_RANK(default_instance)) {
+      return 0;
+    }
+    dest_node = rpl_ns_get_node(dag, &UIP_IP_BUF->destipaddr);
+    if(dest_node == NULL || dest_node->parent == NULL
+       || dest_node->parent != rpl_ns_get_node(dag, &dag->dag_id)) {
+      return 0;
+    }
+  }
+
+  /* The current destination is a neighbor */
+  uip_create_linklocal_prefix(ipaddr);
+  memcpy(((uint8_t *)ipaddr) + 8, ((uint8_t *)&UIP_IP_BUF->destipaddr) + 8, 8);
+  return 1;
+}
+#endif /* RPL_WITH_NON_STORING */
+/*---------------------------------------------------------------------------*/
 void
 rpl_insert_header(void)
 {
   if(default_instance != NULL && !uip_is_addr_mcast(&UIP_IP_BUF->destipaddr)) {
+#if RPL_WITH_NON_STORING
+    if(default_instance->current_dag->rank == ROOT_RANK(default_instance)) {
+      /* Downward traffic from the root is source-routed */
+      rpl_insert_srh_header();
+      return;
+    }
+#endif /* RPL_WITH_NON_STORING */
     rpl_update_header_empty();
   }
 }
@@ -50,9 +50,13 @@
 #include "net/ipv6/uip-ds6.h"
 #include "net/ipv6/uip-nd6.h"
 #include "net/ipv6/uip-icmp6.h"
+#include "net/ipv6/sicslowpan.h"
 #include "net/rpl/rpl-private.h"
+#include "net/rpl/rpl-ns.h"
 #include "net/packetbuf.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
+#include "lib/random.h"
+#include "lib/crc16.h"
 
 #include <limits.h>
 #include <string.h>
@@ -61,6 +65,9 @@
 
 #include "net/ip/uip-debug.h"
 
+/* DAOs are only aggregated when every node maintains downward routes */
+#define WITH_DAO_AGGREGATION (RPL_DAO_AGGREGATION && RPL_WITH_STORING)
+
 /*---------------------------------------------------------------------------*/
 #define RPL_DIO_GROUNDED                 0x80
 #define RPL_DIO_MOP_SHIFT                3
@@ -303,6 +310,16 @@ dio_input(void)
   PRINT6ADDR(&dio.dag_id);
   PRINTF(", %u)\n", dio.preference);
 
+#if RPL_DIO_FAST_PATH
+  /* The fingerprint covers the base object and all options */
+  dio.fingerprint = crc16_data(buffer, buffer_length, 0);
+  if(rpl_process_dio_unchanged(&from, &dio)) {
+    PRINTF("RPL: Unchanged DIO, fast path\n");
+    uip_len = 0;
+    return;
+  }
+#endif /* RPL_DIO_FAST_PATH */
+
   /* Check if there are any DIO suboptions. */
   for(; i < buffer_length; i += len) {
     subopt_type = buffer[i];
@@ -416,6 +433,23 @@ dio_input(void)
       PRINTF("RPL: Copying prefix information\n");
       memcpy(&dio.prefix_info.prefix, &buffer[i + 16], 16);
       break;
+#if RPL_DIO_CONTEXTS
+    case RPL_OPTION_CONTEXT:
+      if(len != 16) {
+        PRINTF("RPL: Invalid context option, len != 16\n");
+        RPL_STAT(rpl_stats.malformed_msgs++);
+        return;
+      }
+      /* Context length, C and CID, 2 reserved bytes, lifetime and prefix.
+       * Contexts are 64 bits long in sicslowpan. */
+      if(buffer[i + 2] == 64 && dio.num_contexts < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS) {
+        dio.contexts[dio.num_contexts].flags = buffer[i + 3];
+        dio.contexts[dio.num_contexts].lifetime = get16(buffer, i + 6);
+        memcpy(&dio.contexts[dio.num_contexts].prefix, &buffer[i + 8], 8);
+        dio.num_contexts++;
+      }
+      break;
+#endif /* RPL_DIO_CONTEXTS */
     default:
       PRINTF("RPL: Unsupported suboption type in DIO: %u\n",
 	(unsigned)subopt_type);
@@ -556,6 +590,26 @@ dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
            dag->prefix_info.length);
   }
 
+#if RPL_DIO_CONTEXTS
+  {
+    uip_ipaddr_t prefix;
+    uint8_t n, number, compress;
+
+    for(n = 0; sicslowpan_context_get(n, &number, &prefix, &compress); n++) {
+      buffer[pos++] = RPL_OPTION_CONTEXT;
+      buffer[pos++] = 14;
+      buffer[pos++] = 64;
+      buffer[pos++] = (compress ? RPL_CONTEXT_FLAG_C : 0) | number;
+      buffer[pos++] = 0; /* reserved */
+      buffer[pos++] = 0;
+      set16(buffer, pos, RPL_CONTEXT_LIFETIME);
+      pos += 2;
+      memcpy(&buffer[pos], &prefix, 8);
+      pos += 8;
+    }
+  }
+#endif /* RPL_DIO_CONTEXTS */
+
   LOG("RPL: DIO output to %d, rank %u\n", LOG_NODEID_FROM_IPADDR(uc_addr), (unsigned)instance->current_dag->rank);
 
 #if RPL_LEAF_ONLY
@@ -586,6 +640,118 @@ dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
 #endif /* RPL_LEAF_ONLY */
 }
 /*---------------------------------------------------------------------------*/
+/* A DAO target and its lifetime */
+struct dao_target {
+  uip_ipaddr_t prefix;
+  uint8_t prefixlen;
+  uint8_t lifetime;
+  uint8_t forward;
+#if RPL_WITH_NON_STORING
+  uip_ipaddr_t parent;
+#endif /* RPL_WITH_NON_STORING */
+};
+#if WITH_DAO_AGGREGATION
+static void dao_aggregate(rpl_instance_t *instance, uip_ipaddr_t *prefix,
+                          uint8_t prefixlen, uint8_t lifetime);
+static void dao_ack_batch(uip_ipaddr_t *dest, uint8_t sequence);
+#endif /* WITH_DAO_AGGREGATION */
+/*---------------------------------------------------------------------------*/
+/* Updates the routes from a DAO target. Returns 1 if the target is to be
+ * forwarded to our parent and acknowledged, 0 otherwise */
+static int
+dao_process_target(rpl_instance_t *instance, uip_ipaddr_t *dao_sender_addr,
+                   rpl_parent_t *parent, const struct dao_target *target,
+                   int learned_from)
+{
+  rpl_dag_t *dag = instance->current_dag;
+  uip_ipaddr_t prefix;
+  uip_ds6_route_t *rep;
+  uip_ds6_nbr_t *nbr;
+  uint8_t prefixlen = target->prefixlen;
+  uint8_t lifetime = target->lifetime;
+
+  uip_ipaddr_copy(&prefix, &target->prefix);
+
+  PRINTF("RPL: DAO lifetime: %u, prefix length: %u prefix: ",
+          (unsigned)lifetime, (unsigned)prefixlen);
+  PRINT6ADDR(&prefix);
+  PRINTF("\n");
+
+#if RPL_CONF_MULTICAST
+  if(uip_is_addr_mcast_global(&prefix)) {
+    mcast_group = uip_mcast6_route_add(&prefix);
+    if(mcast_group) {
+      mcast_group->dag = dag;
+      mcast_group->lifetime = RPL_LIFETIME(instance, lifetime);
+    }
+    return learned_from == RPL_ROUTE_FROM_UNICAST_DAO;
+  }
+#endif
+
+  rep = uip_ds6_route_lookup(&prefix);
+
+  if(lifetime == RPL_ZERO_LIFETIME) {
+    PRINTF("RPL: No-Path DAO received\n");
+    LOG("RPL: DAO input from %d, target %d\n",
+        LOG_NODEID_FROM_IPADDR(dao_sender_addr), LOG_NODEID_FROM_IPADDR(&prefix));
+    /* No-Path DAO received; invoke the route purging routine. */
+    if(rep != NULL &&
+       rep->state.nopath_received == 0 &&
+       rep->length == prefixlen &&
+       uip_ds6_route_nexthop(rep) != NULL &&
+       uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), dao_sender_addr)) {
+      PRINTF("RPL: Setting expiration timer for prefix ");
+      PRINT6ADDR(&prefix);
+      PRINTF("\n");
+      rep->state.nopath_received = 1;
+      rep->state.lifetime = DAO_EXPIRATION_TIMEOUT;
+
+      /* We forward the incoming no-path DAO to our parent */
+      return 1;
+    }
+    return 0;
+  }
+
+  PRINTF("RPL: adding DAO route\n");
+
+  if((nbr = uip_ds6_nbr_lookup(dao_sender_addr)) == NULL) {
+    if((nbr = uip_ds6_nbr_add(dao_sender_addr,
+                              (uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER),
+                              0, NBR_REACHABLE)) != NULL) {
+      /* set reachable timer */
+      stimer_set(&nbr->reachable, UIP_ND6_REACHABLE_TIME / 1000);
+      PRINTF("RPL: Neighbor added to neighbor cache ");
+      PRINT6ADDR(dao_sender_addr);
+      PRINTF(", ");
+      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
+      PRINTF("\n");
+    } else {
+      PRINTF("RPL: Out of Memory, dropping DAO from ");
+      PRINT6ADDR(dao_sender_addr);
+      PRINTF(", ");
+      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
+      PRINTF("\n");
+      return 0;
+    }
+  } else {
+    PRINTF("RPL: Neighbor already in neighbor cache\n");
+  }
+
+  rpl_lock_parent(parent);
+
+  rep = rpl_add_route(dag, &prefix, prefixlen, dao_sender_addr);
+  if(rep == NULL) {
+    RPL_STAT(rpl_stats.mem_overflows++);
+    PRINTF("RPL: Could not add a route after receiving a DAO\n");
+    return 0;
+  }
+
+  rep->state.lifetime = RPL_LIFETIME(instance, lifetime);
+  rep->state.learned_from = learned_from;
+
+  return learned_from == RPL_ROUTE_FROM_UNICAST_DAO;
+}
+/*---------------------------------------------------------------------------*/
 static void
 dao_input(void)
 {
@@ -603,15 +769,16 @@ dao_input(void)
   uint8_t pathcontrol;
   uint8_t pathsequence;
   */
-  uip_ipaddr_t prefix;
-  uip_ds6_route_t *rep;
+  struct dao_target targets[RPL_DAO_MAX_TARGETS];
+  int num_targets;
+  int first_target;
+  int fwd;
   uint8_t buffer_length;
   int pos;
   int len;
   int i;
   int learned_from;
   rpl_parent_t *parent;
-  uip_ds6_nbr_t *nbr;
 
   prefixlen = 0;
   parent = NULL;
@@ -668,7 +835,7 @@ dao_input(void)
       PRINTF("RPL: Loop detected when receiving a unicast DAO from a node with a lower rank! (%u < %u)\n",
           DAG_RANK(parent->rank, instance), DAG_RANK(dag->rank, instance));
       parent->rank = INFINITE_RANK;
-      parent->flags |= RPL_PARENT_FLAG_UPDATED;
+      rpl_parent_updated(parent);
       return;
     }
 
@@ -676,12 +843,15 @@ dao_input(void)
     if(parent != NULL && parent == dag->preferred_parent) {
       PRINTF("RPL: Loop detected when receiving a unicast DAO from our parent\n");
       parent->rank = INFINITE_RANK;
-      parent->flags |= RPL_PARENT_FLAG_UPDATED;
+      rpl_parent_updated(parent);
       return;
     }
   }
 
-  /* Check if there are any RPL options present. */
+  /* Check if there are any RPL options present. A Transit option applies
+   * to the Targets before it */
+  num_targets = 0;
+  first_target = 0;
   for(i = pos; i < buffer_length; i += len) {
     subopt_type = buffer[i];
     if(subopt_type == RPL_OPTION_PAD1) {
@@ -694,127 +864,86 @@ dao_input(void)
     switch(subopt_type) {
     case RPL_OPTION_TARGET:
       /* Handle the target option. */
-      prefixlen = buffer[i + 3];
-      memset(&prefix, 0, sizeof(prefix));
-      memcpy(&prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
+      if(num_targets < RPL_DAO_MAX_TARGETS) {
+        prefixlen = buffer[i + 3];
+        memset(&targets[num_targets], 0, sizeof(targets[num_targets]));
+        memcpy(&targets[num_targets].prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
+        targets[num_targets].prefixlen = prefixlen;
+        targets[num_targets].forward = 0;
+        num_targets++;
+      }
       break;
     case RPL_OPTION_TRANSIT:
       /* The path sequence and control are ignored. */
       /*      pathcontrol = buffer[i + 3];
               pathsequence = buffer[i + 4];*/
       lifetime = buffer[i + 5];
-      /* The parent address is also ignored. */
+      for(; first_target < num_targets; first_target++) {
+        targets[first_target].lifetime = lifetime;
+#if RPL_WITH_NON_STORING
+        /* The parent address tells the root where the targets are */
+        if(buffer[i + 1] >= 4 + sizeof(uip_ipaddr_t)) {
+          memcpy(&targets[first_target].parent, buffer + i + 6, sizeof(uip_ipaddr_t));
+        }
+#endif /* RPL_WITH_NON_STORING */
+      }
       break;
     }
   }
-
-  PRINTF("RPL: DAO lifetime: %u, prefix length: %u prefix: ",
-          (unsigned)lifetime, (unsigned)prefixlen);
-  PRINT6ADDR(&prefix);
-  PRINTF("\n");
-
-#if RPL_CONF_MULTICAST
-  if(uip_is_addr_mcast_global(&prefix)) {
-    mcast_group = uip_mcast6_route_add(&prefix);
-    if(mcast_group) {
-      mcast_group->dag = dag;
-      mcast_group->lifetime = RPL_LIFETIME(instance, lifetime);
-    }
-    goto fwd_dao;
+  /* Targets with no Transit after them take the last lifetime seen */
+  for(; first_target < num_targets; first_target++) {
+    targets[first_target].lifetime = lifetime;
   }
-#endif
-
-  rep = uip_ds6_route_lookup(&prefix);
-
-  if(lifetime == RPL_ZERO_LIFETIME) {
-    PRINTF("RPL: No-Path DAO received\n");
-    /* No-Path DAO received; invoke the route purging routine. */
-    if(rep != NULL &&
-       rep->state.nopath_received == 0 &&
-       rep->length == prefixlen &&
-       uip_ds6_route_nexthop(rep) != NULL &&
-       uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), &dao_sender_addr)) {
-      PRINTF("RPL: Setting expiration timer for prefix ");
-      PRINT6ADDR(&prefix);
-      PRINTF("\n");
-      rep->state.nopath_received = 1;
-      rep->state.lifetime = DAO_EXPIRATION_TIMEOUT;
 
-      /* We forward the incoming no-path DAO to our parent, if we have
-         one. */
-      if(dag->preferred_parent != NULL &&
-         rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
-        PRINTF("RPL: Forwarding no-path DAO to parent ");
-        PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
-        PRINTF("\n");
-        uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
-                       ICMP6_RPL, RPL_CODE_DAO, buffer_length);
-      }
-      if(flags & RPL_DAO_K_FLAG) {
-        dao_ack_output(instance, &dao_sender_addr, sequence);
-      }
+#if RPL_WITH_NON_STORING
+  /* Only the root keeps downward state; DAOs are addressed to it */
+  if(dag->rank == ROOT_RANK(instance)) {
+    for(i = 0; i < num_targets; i++) {
+      LOG("RPL: DAO input from %d, target %d\n",
+          LOG_NODEID_FROM_IPADDR(&dao_sender_addr), LOG_NODEID_FROM_IPADDR(&targets[i].prefix));
+      rpl_ns_update_node(dag, &targets[i].prefix, &targets[i].parent,
+                         RPL_LIFETIME(instance, targets[i].lifetime));
     }
-
-    LOG("RPL: DAO input from %d, target %d\n",
-        LOG_NODEID_FROM_IPADDR(&dao_sender_addr), LOG_NODEID_FROM_IPADDR(&prefix));
-
-    return;
-  }
-
-  PRINTF("RPL: adding DAO route\n");
-
-  if((nbr = uip_ds6_nbr_lookup(&dao_sender_addr)) == NULL) {
-    if((nbr = uip_ds6_nbr_add(&dao_sender_addr,
-                              (uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER),
-                              0, NBR_REACHABLE)) != NULL) {
-      /* set reachable timer */
-      stimer_set(&nbr->reachable, UIP_ND6_REACHABLE_TIME / 1000);
-      PRINTF("RPL: Neighbor added to neighbor cache ");
-      PRINT6ADDR(&dao_sender_addr);
-      PRINTF(", ");
-      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
-      PRINTF("\n");
-    } else {
-      PRINTF("RPL: Out of Memory, dropping DAO from ");
-      PRINT6ADDR(&dao_sender_addr);
-      PRINTF(", ");
-      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
-      PRINTF("\n");
-      return;
+    if(flags & RPL_DAO_K_FLAG) {
+      dao_ack_output(instance, &dao_sender_addr, sequence);
     }
-  } else {
-    PRINTF("RPL: Neighbor already in neighbor cache\n");
   }
-
-  rpl_lock_parent(parent);
-
-  rep = rpl_add_route(dag, &prefix, prefixlen, &dao_sender_addr);
-  if(rep == NULL) {
-    RPL_STAT(rpl_stats.mem_overflows++);
-    PRINTF("RPL: Could not add a route after receiving a DAO\n");
-    return;
+  uip_len = 0;
+  return;
+#endif /* RPL_WITH_NON_STORING */
+
+  fwd = 0;
+  for(i = 0; i < num_targets; i++) {
+    if(dao_process_target(instance, &dao_sender_addr, parent, &targets[i], learned_from)) {
+      targets[i].forward = 1;
+      fwd = 1;
+    }
   }
 
-  rep->state.lifetime = RPL_LIFETIME(instance, lifetime);
-  rep->state.learned_from = learned_from;
-
-#if RPL_CONF_MULTICAST
-fwd_dao:
-#endif
-
-  int dao_fw = 0;
-  if(learned_from == RPL_ROUTE_FROM_UNICAST_DAO) {
+  if(fwd) {
+#if WITH_DAO_AGGREGATION
+    /* Forward the targets along with others of our subtree */
+    for(i = 0; i < num_targets; i++) {
+      if(targets[i].forward) {
+        dao_aggregate(instance, &targets[i].prefix, targets[i].prefixlen, targets[i].lifetime);
+      }
+    }
+#else /* WITH_DAO_AGGREGATION */
     if(dag->preferred_parent != NULL &&
        rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
-      dao_fw = 1;
       PRINTF("RPL: Forwarding DAO to parent ");
       PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
       PRINTF("\n");
       uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
                      ICMP6_RPL, RPL_CODE_DAO, buffer_length);
     }
+#endif /* WITH_DAO_AGGREGATION */
     if(flags & RPL_DAO_K_FLAG) {
+#if WITH_DAO_AGGREGATION
+      dao_ack_batch(&dao_sender_addr, sequence);
+#else /* WITH_DAO_AGGREGATION */
       dao_ack_output(instance, &dao_sender_addr, sequence);
+#endif /* WITH_DAO_AGGREGATION */
     }
   }
   uip_len = 0;
@@ -836,6 +965,220 @@ dao_output(rpl_parent_t *parent, uint8_t lifetime)
   dao_output_target(parent, &prefix, lifetime);
 }
 /*---------------------------------------------------------------------------*/
+/* Writes the DAO base object to buffer, returns its length */
+static int
+dao_header(rpl_instance_t *instance, unsigned char *buffer)
+{
+  int pos;
+
+  RPL_LOLLIPOP_INCREMENT(dao_sequence);
+  pos = 0;
+
+  buffer[pos++] = instance->instance_id;
+  buffer[pos] = 0;
+#if RPL_DAO_SPECIFY_DAG
+  buffer[pos] |= RPL_DAO_D_FLAG;
+#endif /* RPL_DAO_SPECIFY_DAG */
+#if RPL_CONF_DAO_ACK
+  buffer[pos] |= RPL_DAO_K_FLAG;
+#endif /* RPL_CONF_DAO_ACK */
+  ++pos;
+  buffer[pos++] = 0; /* reserved */
+  buffer[pos++] = dao_sequence;
+#if RPL_DAO_SPECIFY_DAG
+  memcpy(buffer + pos, &instance->current_dag->dag_id, sizeof(instance->current_dag->dag_id));
+  pos+=sizeof(instance->current_dag->dag_id);
+#endif /* RPL_DAO_SPECIFY_DAG */
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+/* Appends a target sub-option at pos, returns the new length */
+static int
+dao_target_option(unsigned char *buffer, int pos, uip_ipaddr_t *prefix, uint8_t prefixlen)
+{
+  buffer[pos++] = RPL_OPTION_TARGET;
+  buffer[pos++] = 2 + ((prefixlen + 7) / CHAR_BIT);
+  buffer[pos++] = 0; /* reserved */
+  buffer[pos++] = prefixlen;
+  memcpy(buffer + pos, prefix, (prefixlen + 7) / CHAR_BIT);
+  pos += ((prefixlen + 7) / CHAR_BIT);
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+/* Appends a transit information sub-option at pos, with the parent address
+ * unless NULL. Returns the new length */
+static int
+dao_transit_option(unsigned char *buffer, int pos, uint8_t lifetime,
+                   const uip_ipaddr_t *parent_addr)
+{
+  buffer[pos++] = RPL_OPTION_TRANSIT;
+  buffer[pos++] = parent_addr != NULL ? 4 + sizeof(*parent_addr) : 4;
+  buffer[pos++] = 0; /* flags - ignored */
+  buffer[pos++] = 0; /* path control - ignored */
+  buffer[pos++] = 0; /* path seq - ignored */
+  buffer[pos++] = lifetime;
+  if(parent_addr != NULL) {
+    memcpy(buffer + pos, parent_addr, sizeof(*parent_addr));
+    pos += sizeof(*parent_addr);
+  }
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+#if WITH_DAO_AGGREGATION
+/* Targets waiting to go to our preferred parent in a single DAO */
+static struct dao_target agg_targets[RPL_DAO_MAX_TARGETS];
+static uint8_t agg_num_targets;
+static rpl_instance_t *agg_instance;
+static struct ctimer agg_timer;
+static clock_time_t agg_last_sent;
+#if RPL_CONF_DAO_ACK
+/* DAO-ACKs waiting to be sent, one per child */
+struct dao_ack {
+  uip_ipaddr_t dest;
+  uint8_t sequence;
+};
+static struct dao_ack agg_acks[RPL_DAO_ACK_BATCH];
+static uint8_t agg_num_acks;
+#endif /* RPL_CONF_DAO_ACK */
+/*---------------------------------------------------------------------------*/
+#if RPL_CONF_DAO_ACK
+static void
+dao_ack_flush(void)
+{
+  uint8_t i;
+  for(i = 0; i < agg_num_acks; i++) {
+    if(agg_instance != NULL) {
+      dao_ack_output(agg_instance, &agg_acks[i].dest, agg_acks[i].sequence);
+    }
+  }
+  agg_num_acks = 0;
+}
+#endif /* RPL_CONF_DAO_ACK */
+/*---------------------------------------------------------------------------*/
+/* Sends the queued targets in one DAO, grouped by lifetime */
+static void
+dao_flush(void)
+{
+  rpl_parent_t *parent;
+  unsigned char *buffer;
+  uint8_t sent[RPL_DAO_MAX_TARGETS];
+  uint8_t i, j;
+  int pos;
+
+  ctimer_stop(&agg_timer);
+  if(agg_num_targets == 0 || agg_instance == NULL || agg_instance->current_dag == NULL
+     || (parent = agg_instance->current_dag->preferred_parent) == NULL
+     || rpl_get_parent_ipaddr(parent) == NULL) {
+    /* Our own DAO timer and those of our children will advertise
+     * the targets again */
+    agg_num_targets = 0;
+    return;
+  }
+
+  buffer = UIP_ICMP_PAYLOAD;
+  pos = dao_header(agg_instance, buffer);
+  memset(sent, 0, sizeof(sent));
+  for(i = 0; i < agg_num_targets; i++) {
+    if(!sent[i]) {
+      for(j = i; j < agg_num_targets; j++) {
+        if(!sent[j] && agg_targets[j].lifetime == agg_targets[i].lifetime) {
+          pos = dao_target_option(buffer, pos, &agg_targets[j].prefix, agg_targets[j].prefixlen);
+          sent[j] = 1;
+        }
+      }
+      pos = dao_transit_option(buffer, pos, agg_targets[i].lifetime, NULL);
+    }
+  }
+
+  LOG("RPL: DAO ouptut to %d, %u targets\n",
+      LOG_NODEID_FROM_IPADDR(rpl_get_parent_ipaddr(parent)), agg_num_targets);
+
+  agg_num_targets = 0;
+  agg_last_sent = clock_time();
+  uip_icmp6_send(rpl_get_parent_ipaddr(parent), ICMP6_RPL, RPL_CODE_DAO, pos);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_agg_timer(void *ptr)
+{
+#if RPL_CONF_DAO_ACK
+  dao_ack_flush();
+#endif /* RPL_CONF_DAO_ACK */
+  dao_flush();
+}
+/*---------------------------------------------------------------------------*/
+/* Sends the queued DAO and DAO-ACKs after a jittered delay, and no
+ * sooner than RPL_DAO_MIN_INTERVAL after the last DAO */
+static void
+schedule_agg_timer(void)
+{
+  clock_time_t delay;
+  clock_time_t since_last;
+
+  if(!ctimer_expired(&agg_timer)) {
+    return;
+  }
+  delay = RPL_DAO_AGGREGATION_DELAY / 2 + random_rand() % RPL_DAO_AGGREGATION_DELAY;
+  since_last = clock_time() - agg_last_sent;
+  if(since_last < RPL_DAO_MIN_INTERVAL && delay < RPL_DAO_MIN_INTERVAL - since_last) {
+    delay = RPL_DAO_MIN_INTERVAL - since_last;
+  }
+  ctimer_set(&agg_timer, delay, handle_agg_timer, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+dao_aggregate(rpl_instance_t *instance, uip_ipaddr_t *prefix,
+              uint8_t prefixlen, uint8_t lifetime)
+{
+  uint8_t i;
+
+  if(agg_num_targets > 0 && instance != agg_instance) {
+    dao_flush();
+  }
+  agg_instance = instance;
+  /* A new advertisement of a queued target replaces it */
+  for(i = 0; i < agg_num_targets; i++) {
+    if(agg_targets[i].prefixlen == prefixlen
+       && uip_ipaddr_cmp(&agg_targets[i].prefix, prefix)) {
+      agg_targets[i].lifetime = lifetime;
+      return;
+    }
+  }
+  if(agg_num_targets == RPL_DAO_MAX_TARGETS) {
+    /* Full DAO, send it now */
+    dao_flush();
+  }
+  uip_ipaddr_copy(&agg_targets[agg_num_targets].prefix, prefix);
+  agg_targets[agg_num_targets].prefixlen = prefixlen;
+  agg_targets[agg_num_targets].lifetime = lifetime;
+  agg_num_targets++;
+  schedule_agg_timer();
+}
+/*---------------------------------------------------------------------------*/
+static void
+dao_ack_batch(uip_ipaddr_t *dest, uint8_t sequence)
+{
+#if RPL_CONF_DAO_ACK
+  uint8_t i;
+
+  /* The latest DAO of a child acknowledges the previous ones */
+  for(i = 0; i < agg_num_acks; i++) {
+    if(uip_ipaddr_cmp(&agg_acks[i].dest, dest)) {
+      agg_acks[i].sequence = sequence;
+      return;
+    }
+  }
+  if(agg_num_acks == RPL_DAO_ACK_BATCH) {
+    dao_ack_flush();
+  }
+  uip_ipaddr_copy(&agg_acks[agg_num_acks].dest, dest);
+  agg_acks[agg_num_acks].sequence = sequence;
+  agg_num_acks++;
+  schedule_agg_timer();
+#endif /* RPL_CONF_DAO_ACK */
+}
+#endif /* WITH_DAO_AGGREGATION */
+/*---------------------------------------------------------------------------*/
 void
 dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
 {
@@ -844,6 +1187,9 @@ dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
   unsigned char *buffer;
   uint8_t prefixlen;
   int pos;
+#if RPL_WITH_NON_STORING
+  uip_ipaddr_t parent_addr;
+#endif /* RPL_WITH_NON_STORING */
 
   /* Destination Advertisement Object */
 
@@ -877,43 +1223,41 @@ dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
   RPL_DEBUG_DAO_OUTPUT(parent);
 #endif
 
+  prefixlen = sizeof(*prefix) * CHAR_BIT;
+#if WITH_DAO_AGGREGATION
+  if(parent == dag->preferred_parent && dag == instance->current_dag) {
+    /* Goes along with the targets of our subtree */
+    dao_aggregate(instance, prefix, prefixlen, lifetime);
+    return;
+  }
+#endif /* WITH_DAO_AGGREGATION */
+
   buffer = UIP_ICMP_PAYLOAD;
+  pos = dao_header(instance, buffer);
 
-  RPL_LOLLIPOP_INCREMENT(dao_sequence);
-  pos = 0;
+  /* create target subopt */
+  pos = dao_target_option(buffer, pos, prefix, prefixlen);
 
-  buffer[pos++] = instance->instance_id;
-  buffer[pos] = 0;
-#if RPL_DAO_SPECIFY_DAG
-  buffer[pos] |= RPL_DAO_D_FLAG;
-#endif /* RPL_DAO_SPECIFY_DAG */
-#if RPL_CONF_DAO_ACK
-  buffer[pos] |= RPL_DAO_K_FLAG;
-#endif /* RPL_CONF_DAO_ACK */
-  ++pos;
-  buffer[pos++] = 0; /* reserved */
-  buffer[pos++] = dao_sequence;
-#if RPL_DAO_SPECIFY_DAG
-  memcpy(buffer + pos, &dag->dag_id, sizeof(dag->dag_id));
-  pos+=sizeof(dag->dag_id);
-#endif /* RPL_DAO_SPECIFY_DAG */
+#if RPL_WITH_NON_STORING
+  /* Create a transit information sub-option with the global address of
+   * our parent, and send the DAO to the root */
+  if(rpl_get_parent_ipaddr(parent) == NULL) {
+    return;
+  }
+  memcpy(&parent_addr, &dag->dag_id, 8);
+  memcpy(((uint8_t *)&parent_addr) + 8, ((uint8_t *)rpl_get_parent_ipaddr(parent)) + 8, 8);
+  pos = dao_transit_option(buffer, pos, lifetime, &parent_addr);
 
-  /* create target subopt */
-  prefixlen = sizeof(*prefix) * CHAR_BIT;
-  buffer[pos++] = RPL_OPTION_TARGET;
-  buffer[pos++] = 2 + ((prefixlen + 7) / CHAR_BIT);
-  buffer[pos++] = 0; /* reserved */
-  buffer[pos++] = prefixlen;
-  memcpy(buffer + pos, prefix, (prefixlen + 7) / CHAR_BIT);
-  pos += ((prefixlen + 7) / CHAR_BIT);
+  LOG("RPL: DAO ouptut to %d, target %d, parent %d\n",
+      LOG_NODEID_FROM_IPADDR(&dag->dag_id), LOG_NODEID_FROM_IPADDR(prefix),
+      LOG_NODEID_FROM_IPADDR(&parent_addr));
+
+  uip_icmp6_send(&dag->dag_id, ICMP6_RPL, RPL_CODE_DAO, pos);
+  return;
+#endif /* RPL_WITH_NON_STORING */
 
   /* Create a transit information sub-option. */
-  buffer[pos++] = RPL_OPTION_TRANSIT;
-  buffer[pos++] = 4;
-  buffer[pos++] = 0; /* flags - ignored */
-  buffer[pos++] = 0; /* path control - ignored */
-  buffer[pos++] = 0; /* path seq - ignored */
-  buffer[pos++] = lifetime;
+  pos = dao_transit_option(buffer, pos, lifetime, NULL);
 
   PRINTF("RPL: Sending DAO with prefix ");
   PRINT6ADDR(prefix);
@@ -0,0 +1,228 @@
+/**
+ * \addtogroup uip6
+ * @{
+ */
+/*
+ * Copyright (c) 2010, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         RPL non-storing mode: the DAG topology as learned by the root
+ *         from the DAOs. Each node registers its preferred parent, the
+ *         root walks up the parents of a destination to build its source
+ *         route. Other nodes hold no downward state.
+ */
+
+#include "net/rpl/rpl-private.h"
+#include "net/rpl/rpl-ns.h"
+#include "lib/list.h"
+#include "lib/memb.h"
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+#include <string.h>
+
+#if RPL_WITH_NON_STORING
+
+LIST(nodelist);
+MEMB(nodememb, rpl_ns_node_t, RPL_NS_LINK_NUM);
+
+static int num_nodes;
+/*---------------------------------------------------------------------------*/
+/* Do addr and the DAG ID share the DAG prefix? */
+static int
+is_in_dag_prefix(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
+{
+  return memcmp(addr, &dag->dag_id, 8) == 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_ns_num_nodes(void)
+{
+  return num_nodes;
+}
+/*---------------------------------------------------------------------------*/
+rpl_ns_node_t *
+rpl_ns_get_node(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
+{
+  rpl_ns_node_t *l;
+
+  if(dag == NULL || addr == NULL || !is_in_dag_prefix(dag, addr)) {
+    return NULL;
+  }
+  for(l = list_head(nodelist); l != NULL; l = list_item_next(l)) {
+    if(l->dag == dag && memcmp(l->link_identifier, ((const uint8_t *)addr) + 8, 8) == 0) {
+      return l;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_ns_is_node_reachable(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
+{
+  int max_depth = RPL_NS_LINK_NUM;
+  rpl_ns_node_t *node = rpl_ns_get_node(dag, addr);
+  rpl_ns_node_t *root_node = rpl_ns_get_node(dag, &dag->dag_id);
+
+  /* Walk up the parents; a loop ends when max_depth does */
+  while(node != NULL && node != root_node && max_depth > 0) {
+    node = node->parent;
+    max_depth--;
+  }
+  return node != NULL && node == root_node;
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_get_node_global_addr(uip_ipaddr_t *addr, const rpl_ns_node_t *node)
+{
+  if(addr != NULL && node != NULL && node->dag != NULL) {
+    memcpy(addr, &node->dag->dag_id, 8);
+    memcpy(((uint8_t *)addr) + 8, node->link_identifier, 8);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static rpl_ns_node_t *
+add_node(rpl_dag_t *dag, const uip_ipaddr_t *addr, uint32_t lifetime)
+{
+  rpl_ns_node_t *node = memb_alloc(&nodememb);
+
+  if(node == NULL) {
+    PRINTF("RPL: NS table full\n");
+    return NULL;
+  }
+  node->dag = dag;
+  node->parent = NULL;
+  node->lifetime = lifetime;
+  memcpy(node->link_identifier, ((const uint8_t *)addr) + 8, 8);
+  list_add(nodelist, node);
+  num_nodes++;
+  return node;
+}
+/*---------------------------------------------------------------------------*/
+rpl_ns_node_t *
+rpl_ns_update_node(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                   const uip_ipaddr_t *parent, uint32_t lifetime)
+{
+  rpl_ns_node_t *child_node;
+  rpl_ns_node_t *parent_node;
+
+  if(dag == NULL || child == NULL || !is_in_dag_prefix(dag, child)) {
+    return NULL;
+  }
+
+  child_node = rpl_ns_get_node(dag, child);
+  if(lifetime == 0) {
+    /* No-Path DAO, removed at the next periodic call */
+    if(child_node != NULL) {
+      child_node->lifetime = 0;
+    }
+    return child_node;
+  }
+
+  if(parent == NULL || !is_in_dag_prefix(dag, parent)) {
+    return NULL;
+  }
+  parent_node = rpl_ns_get_node(dag, parent);
+  if(parent_node == NULL) {
+    /* Parents we have not heard from yet live as long as their children,
+     * the root forever */
+    parent_node = add_node(dag, parent,
+                           uip_ipaddr_cmp(parent, &dag->dag_id) ?
+                           RPL_NS_INFINITE_LIFETIME : lifetime);
+    if(parent_node == NULL) {
+      return NULL;
+    }
+  } else if(parent_node->lifetime < lifetime) {
+    parent_node->lifetime = lifetime;
+  }
+
+  if(child_node == NULL) {
+    child_node = add_node(dag, child, lifetime);
+    if(child_node == NULL) {
+      return NULL;
+    }
+  } else {
+    child_node->lifetime = lifetime;
+  }
+  child_node->parent = parent_node;
+
+  PRINTF("RPL: NS node ");
+  PRINT6ADDR(child);
+  PRINTF(" parent ");
+  PRINT6ADDR(parent);
+  PRINTF(", %u nodes\n", num_nodes);
+
+  return child_node;
+}
+/*---------------------------------------------------------------------------*/
+/* Called every second from the RPL periodic timer */
+void
+rpl_ns_periodic(void)
+{
+  rpl_ns_node_t *l;
+  rpl_ns_node_t *next;
+  rpl_ns_node_t *l2;
+
+  for(l = list_head(nodelist); l != NULL; l = next) {
+    next = list_item_next(l);
+    if(l->lifetime == RPL_NS_INFINITE_LIFETIME) {
+      continue;
+    }
+    if(l->lifetime > 0) {
+      l->lifetime--;
+    }
+    if(l->lifetime == 0) {
+      /* Its children are unreachable until they register a new parent */
+      for(l2 = list_head(nodelist); l2 != NULL; l2 = list_item_next(l2)) {
+        if(l2->parent == l) {
+          l2->parent = NULL;
+        }
+      }
+      list_remove(nodelist, l);
+      memb_free(&nodememb, l);
+      num_nodes--;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_init(void)
+{
+  list_init(nodelist);
+  memb_init(&nodememb);
+  num_nodes = 0;
+}
+#endif /* RPL_WITH_NON_STORING */
+
+/** @}*/
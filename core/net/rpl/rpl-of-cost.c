@@ -0,0 +1,96 @@
+/**
+ * \addtogroup uip6
+ * @{
+ */
+/*
+ * Copyright (c) 2010, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Helpers for the objective functions: a per-parent cache of the
+ *         path cost, and lookup tables for non-linear link cost transforms.
+ */
+
+#include "net/rpl/rpl-private.h"
+
+/*---------------------------------------------------------------------------*/
+#if RPL_OF_CACHE_PATH_COST
+rpl_rank_t
+rpl_of_path_cost(rpl_parent_t *p, rpl_rank_t (*compute)(rpl_parent_t *))
+{
+  /* The cache is valid as long as the inputs of the cost are unchanged */
+  if(p->cost_rank != p->rank || p->cost_link_metric != p->link_metric) {
+    p->path_cost = compute(p);
+    p->cost_rank = p->rank;
+    p->cost_link_metric = p->link_metric;
+  }
+  return p->path_cost;
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_of_invalidate_path_cost(rpl_parent_t *p)
+{
+  p->cost_rank = ~p->rank;
+}
+#endif /* RPL_OF_CACHE_PATH_COST */
+/*---------------------------------------------------------------------------*/
+#if RPL_OF_LOOKUP_TABLES
+static void
+table_init(struct rpl_of_table *t)
+{
+  int i;
+  for(i = 0; i <= t->size; i++) {
+    t->values[i] = t->f((uint32_t)i << t->shift);
+  }
+  t->ready = 1;
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+rpl_of_table_lookup(struct rpl_of_table *t, uint32_t x)
+{
+  uint32_t i = x >> t->shift;
+  uint32_t frac;
+  int32_t delta;
+
+  if(i >= t->size) {
+    /* Out of the table */
+    return t->f(x);
+  }
+  if(!t->ready) {
+    table_init(t);
+  }
+  /* Linear interpolation between the two closest entries */
+  frac = x & ((1ul << t->shift) - 1);
+  delta = (int32_t)(t->values[i + 1] - t->values[i]);
+  return t->values[i] + (uint32_t)((delta * (int32_t)frac) >> t->shift);
+}
+#endif /* RPL_OF_LOOKUP_TABLES */
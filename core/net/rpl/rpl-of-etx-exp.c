@@ -132,21 +132,41 @@ neighbor_link_callback(rpl_parent_t *p, int status, int numtx)
   }
 }
 
+/* Link cost: the link ETX to the power of RPL_OF_ETX_EXP_N */
+static uint32_t
+link_cost(uint32_t etx)
+{
+  int i;
+  uint32_t cost = etx;
+
+  for(i=0; i<RPL_OF_ETX_EXP_N-1; i++) {
+    cost *= etx;
+    cost /= RPL_DAG_MC_ETX_DIVISOR;
+  }
+  return cost;
+}
+
+#if RPL_OF_LOOKUP_TABLES
+/* Up to ETX NOACK_ETX_PENALTY, every 1/4 ETX */
+RPL_OF_TABLE(link_cost_table, link_cost, 4 * NOACK_ETX_PENALTY, 6);
+#define LINK_COST(etx) rpl_of_table_lookup(&link_cost_table, etx)
+#else
+#define LINK_COST(etx) link_cost(etx)
+#endif
+
+static rpl_rank_t
+path_cost(rpl_parent_t *p)
+{
+  return p->rank + LINK_COST(p->link_metric);
+}
+
 static rpl_rank_t
 calculate_rank(rpl_parent_t *p, rpl_rank_t base_rank)
 {
   if(p == NULL) {
     return INFINITE_RANK;
   } else {
-    int i;
-    uint32_t link_metric = p->link_metric;
-
-    for(i=0; i<RPL_OF_ETX_EXP_N-1; i++) {
-      link_metric *= p->link_metric;
-      link_metric /= RPL_DAG_MC_ETX_DIVISOR;
-    }
-
-    return p->rank + link_metric;
+    return RPL_OF_PATH_COST(p, path_cost);
   }
 }
 
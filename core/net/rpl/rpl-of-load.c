@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+/**
+ * \file
+ *         An objective function that, on top of the ETX, avoids loaded
+ *         parents. Every node advertises in the Node Energy object of
+ *         its DIO metric container how busy it is, from 0 to 255: the
+ *         highest of its queue load (RPL_CALLBACK_NODE_LOAD, e.g.
+ *         tsch_queue_get_load) and of its radio duty cycle (energest).
+ *         The rank is the one of MRHOF without metric container, and
+ *         best_parent() adds to it RPL_OF_LOAD_WEIGHT in proportion to
+ *         the advertised load, so that children drain away from hot
+ *         spots. Needs RPL_CONF_DAG_MC RPL_DAG_MC_ENERGY.
+ */
+
+#include "net/rpl/rpl-private.h"
+#include "net/nbr-table.h"
+#include "sys/energest.h"
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+/* Without the Node Energy object, rpl_of_load is not available */
+#if RPL_DAG_MC == RPL_DAG_MC_ENERGY
+
+static void reset(rpl_dag_t *);
+static void neighbor_link_callback(rpl_parent_t *, int, int);
+static rpl_parent_t *best_parent(rpl_parent_t *, rpl_parent_t *);
+static rpl_dag_t *best_dag(rpl_dag_t *, rpl_dag_t *);
+static rpl_rank_t calculate_rank(rpl_parent_t *, rpl_rank_t);
+static void update_metric_container(rpl_instance_t *);
+
+rpl_of_t rpl_of_load = {
+  reset,
+  neighbor_link_callback,
+  best_parent,
+  best_dag,
+  calculate_rank,
+  update_metric_container,
+  1
+};
+
+/* Extra cost of a parent advertising a load of 255, in rank units */
+#ifdef RPL_OF_LOAD_CONF_WEIGHT
+#define RPL_OF_LOAD_WEIGHT RPL_OF_LOAD_CONF_WEIGHT
+#else
+#define RPL_OF_LOAD_WEIGHT (2 * RPL_DAG_MC_ETX_DIVISOR)
+#endif
+
+/* Account for the radio duty cycle in the advertised load */
+#ifdef RPL_OF_LOAD_CONF_WITH_DUTY_CYCLE
+#define RPL_OF_LOAD_WITH_DUTY_CYCLE RPL_OF_LOAD_CONF_WITH_DUTY_CYCLE
+#else
+#define RPL_OF_LOAD_WITH_DUTY_CYCLE ENERGEST_CONF_ON
+#endif
+
+/* Duty cycle, in percent, advertised as a load of 255 */
+#ifdef RPL_OF_LOAD_CONF_MAX_DUTY_CYCLE
+#define RPL_OF_LOAD_MAX_DUTY_CYCLE RPL_OF_LOAD_CONF_MAX_DUTY_CYCLE
+#else
+#define RPL_OF_LOAD_MAX_DUTY_CYCLE 10
+#endif
+
+#ifdef RPL_CALLBACK_NODE_LOAD
+/* Returns the load of the node, in percent */
+uint8_t RPL_CALLBACK_NODE_LOAD(void);
+#endif
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+/* Constants for the ETX moving average */
+#define ETX_SCALE   100
+#define ETX_ALPHA   90
+/* Parent with less than ETX_EARLY_THRESHOLD Tx history use a more
+ * aggressive alpha of ETX_EARLY_ALPHA */
+#define ETX_EARLY_THRESHOLD   2
+#define ETX_EARLY_ALPHA      70
+/* Non-acked transmissions translate to an ETX of NOACK_ETX_PENALTY */
+#define NOACK_ETX_PENALTY     16
+
+/* Weight (in percent) of the previous load in the advertised average,
+ * which keeps children from moving back and forth */
+#define LOAD_ALPHA 75
+
+/*
+ * The cost must differ more than 1/PARENT_SWITCH_THRESHOLD_DIV in order
+ * to switch preferred parent.
+ */
+#define PARENT_SWITCH_THRESHOLD_DIV	2
+
+typedef uint32_t rpl_path_metric_t;
+
+/* Our load, as advertised */
+static uint8_t node_load;
+
+static void
+reset(rpl_dag_t *sag)
+{
+  PRINTF("RPL: Reset OF load\n");
+}
+
+static void
+neighbor_link_callback(rpl_parent_t *p, int status, int numtx)
+{
+  uint16_t recorded_etx = p->link_metric;
+  uint16_t packet_etx = numtx * RPL_DAG_MC_ETX_DIVISOR;
+  uint16_t new_etx;
+
+  /* Do not penalize the ETX when collisions or transmission errors occur. */
+  if(status == MAC_TX_OK || status == MAC_TX_NOACK) {
+    int etx_alpha = ETX_ALPHA;
+
+    if(p->tx_count < ETX_EARLY_THRESHOLD) {
+      etx_alpha = MIN(etx_alpha, ETX_EARLY_ALPHA);
+    }
+
+    if(status == MAC_TX_NOACK) {
+      packet_etx = NOACK_ETX_PENALTY * RPL_DAG_MC_ETX_DIVISOR;
+    }
+
+    new_etx = ((uint32_t)recorded_etx * etx_alpha +
+               (uint32_t)packet_etx * (ETX_SCALE - etx_alpha)) / ETX_SCALE;
+
+    PRINTF("RPL: ETX changed from %u to %u (packet ETX = %u)\n",
+        (unsigned)(recorded_etx / RPL_DAG_MC_ETX_DIVISOR),
+        (unsigned)(new_etx  / RPL_DAG_MC_ETX_DIVISOR),
+        (unsigned)(packet_etx / RPL_DAG_MC_ETX_DIVISOR));
+    p->link_metric = new_etx;
+  }
+}
+
+static rpl_rank_t
+path_cost(rpl_parent_t *p)
+{
+  uint32_t rank = (uint32_t)p->rank + p->link_metric;
+  return rank > INFINITE_RANK ? INFINITE_RANK : rank;
+}
+
+static rpl_rank_t
+calculate_rank(rpl_parent_t *p, rpl_rank_t base_rank)
+{
+  if(p == NULL) {
+    return INFINITE_RANK;
+  } else {
+    return RPL_OF_PATH_COST(p, path_cost);
+  }
+}
+
+/* The rank through p, plus the weighted load p advertises */
+static rpl_path_metric_t
+parent_cost(rpl_parent_t *p)
+{
+  return calculate_rank(p, 0) +
+    (uint32_t)p->mc.obj.energy.energy_est * RPL_OF_LOAD_WEIGHT / 255;
+}
+
+static rpl_dag_t *
+best_dag(rpl_dag_t *d1, rpl_dag_t *d2)
+{
+  if(d1->grounded != d2->grounded) {
+    return d1->grounded ? d1 : d2;
+  }
+
+  if(d1->preference != d2->preference) {
+    return d1->preference > d2->preference ? d1 : d2;
+  }
+
+  return d1->rank < d2->rank ? d1 : d2;
+}
+
+static rpl_parent_t *
+best_parent(rpl_parent_t *p1, rpl_parent_t *p2)
+{
+  rpl_dag_t *dag;
+  rpl_path_metric_t min_diff;
+  rpl_path_metric_t p1_metric;
+  rpl_path_metric_t p2_metric;
+
+  dag = p1->dag; /* Both parents are in the same DAG. */
+
+  min_diff = RPL_DAG_MC_ETX_DIVISOR /
+             PARENT_SWITCH_THRESHOLD_DIV;
+
+  p1_metric = parent_cost(p1);
+  p2_metric = parent_cost(p2);
+
+  /* Maintain stability of the preferred parent in case of similar costs. */
+  if(p1 == dag->preferred_parent || p2 == dag->preferred_parent) {
+    if(p1_metric < p2_metric + min_diff &&
+       p1_metric + min_diff > p2_metric) {
+      PRINTF("RPL: OF load hysteresis: %lu %lu\n",
+             (unsigned long)p1_metric, (unsigned long)p2_metric);
+      return dag->preferred_parent;
+    }
+  }
+
+  return p1_metric < p2_metric ? p1 : p2;
+}
+
+/* Our current load, from 0 to 255 */
+static uint8_t
+current_load(void)
+{
+  uint16_t load = 0;
+#if RPL_OF_LOAD_WITH_DUTY_CYCLE
+  static unsigned long last_radio, last_total;
+  unsigned long radio, total;
+  uint32_t full_scale;
+
+  radio = energest_type_time(ENERGEST_TYPE_LISTEN) +
+    energest_type_time(ENERGEST_TYPE_TRANSMIT);
+  total = energest_type_time(ENERGEST_TYPE_CPU) +
+    energest_type_time(ENERGEST_TYPE_LPM);
+  /* Radio on time since the last DIO, 255 at RPL_OF_LOAD_MAX_DUTY_CYCLE */
+  full_scale = (uint32_t)(total - last_total) * RPL_OF_LOAD_MAX_DUTY_CYCLE / (100 * 255);
+  if(full_scale > 0) {
+    load = MIN((radio - last_radio) / full_scale, 255);
+  }
+  last_radio = radio;
+  last_total = total;
+#endif /* RPL_OF_LOAD_WITH_DUTY_CYCLE */
+#ifdef RPL_CALLBACK_NODE_LOAD
+  {
+    uint16_t queue_load = (uint16_t)MIN(RPL_CALLBACK_NODE_LOAD(), 100) * 255 / 100;
+    if(queue_load > load) {
+      load = queue_load;
+    }
+  }
+#endif /* RPL_CALLBACK_NODE_LOAD */
+  return load;
+}
+
+static void
+update_metric_container(rpl_instance_t *instance)
+{
+  rpl_dag_t *dag;
+  uint8_t type;
+
+  instance->mc.type = RPL_DAG_MC;
+  instance->mc.flags = RPL_DAG_MC_FLAG_P;
+  instance->mc.aggr = RPL_DAG_MC_AGGR_MAXIMUM;
+  instance->mc.prec = 0;
+
+  dag = instance->current_dag;
+
+  if (!dag->joined) {
+    PRINTF("RPL: Cannot update the metric container when not joined\n");
+    return;
+  }
+
+  if(dag->rank == ROOT_RANK(instance)) {
+    type = RPL_DAG_MC_ENERGY_TYPE_MAINS;
+  } else {
+    type = RPL_DAG_MC_ENERGY_TYPE_BATTERY;
+  }
+
+  node_load = ((uint16_t)node_load * LOAD_ALPHA +
+               (uint16_t)current_load() * (100 - LOAD_ALPHA)) / 100;
+
+  instance->mc.length = sizeof(instance->mc.obj.energy);
+  instance->mc.obj.energy.flags = type << RPL_DAG_MC_ENERGY_TYPE;
+  instance->mc.obj.energy.energy_est = node_load;
+
+  PRINTF("RPL: My load is %u\n", node_load);
+}
+
+#endif /* RPL_DAG_MC == RPL_DAG_MC_ENERGY */
@@ -119,31 +119,52 @@ neighbor_link_callback(rpl_parent_t *p, int status, int numtx)
   }
 }
 
+/* Loss rate of a link of PRR prr, over PRR_EXPONENT transmissions */
+static uint32_t
+link_loss(uint32_t prr)
+{
+  uint32_t link_loss_rate = PDR_BASE;
+  int i;
+
+  for(i=0; i<PRR_EXPONENT; i++) {
+    link_loss_rate *= PDR_BASE - prr;
+    link_loss_rate /= PDR_BASE;
+  }
+  return link_loss_rate;
+}
+
+#if RPL_OF_LOOKUP_TABLES
+/* Every 1/64th of PRR */
+RPL_OF_TABLE(link_loss_table, link_loss, 64, 10);
+#define LINK_LOSS(prr) rpl_of_table_lookup(&link_loss_table, prr)
+#else
+#define LINK_LOSS(prr) link_loss(prr)
+#endif
+
+static rpl_rank_t
+path_cost(rpl_parent_t *p)
+{
+  uint32_t parent_pdr = (uint32_t)PDR_BASE-p->rank;
+  uint32_t link_loss_rate = LINK_LOSS(p->link_metric);
+
+  uint32_t link_prr = PDR_ONE - link_loss_rate;
+  uint32_t path_pdr = ((PDR_BASE/2)+parent_pdr*link_prr) / PDR_BASE;
+  uint32_t path_loss_rate = PDR_ONE - path_pdr;
+
+  if(path_loss_rate > p->rank + RPL_MIN_HOPRANKINC) {
+    return path_loss_rate;
+  } else {
+    return p->rank + RPL_MIN_HOPRANKINC;
+  }
+}
+
 static rpl_rank_t
 calculate_rank(rpl_parent_t *p, rpl_rank_t base_rank)
 {
   if(p == NULL) {
     return INFINITE_RANK;
   } else {
-    uint32_t link_loss_rate = PDR_BASE - p->link_metric;
-    uint32_t parent_pdr = (uint32_t)PDR_BASE-p->rank;
-    int i;
-
-    link_loss_rate = PDR_BASE;
-    for(i=0; i<PRR_EXPONENT; i++) {
-      link_loss_rate *= PDR_BASE - p->link_metric;
-      link_loss_rate /= PDR_BASE;
-    }
-
-    uint32_t link_prr = PDR_ONE - link_loss_rate;
-    uint32_t path_pdr = ((PDR_BASE/2)+parent_pdr*link_prr) / PDR_BASE;
-    uint32_t path_loss_rate = PDR_ONE - path_pdr;
-
-    if(path_loss_rate > p->rank + RPL_MIN_HOPRANKINC) {
-      return path_loss_rate;
-    } else {
-      return p->rank + RPL_MIN_HOPRANKINC;
-    }
+    return RPL_OF_PATH_COST(p, path_cost);
   }
 }
 
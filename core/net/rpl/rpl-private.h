@@ -87,19 +87,44 @@
 #define RPL_OPTION_SOLICITED_INFO        7
 #define RPL_OPTION_PREFIX_INFO           8
 #define RPL_OPTION_TARGET_DESC           9
+/* Not assigned by IANA, see RPL_CONF_DIO_CONTEXTS */
+#define RPL_OPTION_CONTEXT               0x22
+
+/* Context option flags and lifetime (in minutes) */
+#define RPL_CONTEXT_FLAG_C               0x10
+#define RPL_CONTEXT_CID_MASK             0x0f
+#define RPL_CONTEXT_LIFETIME             0xffff
 
 #define RPL_DAO_K_FLAG                   0x80 /* DAO ACK requested */
 #define RPL_DAO_D_FLAG                   0x40 /* DODAG ID present */
 /*---------------------------------------------------------------------------*/
 /* RPL IPv6 extension header option. */
 #define RPL_HDR_OPT_LEN			4
-#define RPL_HOP_BY_HOP_LEN		(RPL_HDR_OPT_LEN + 2 + 2)
+#if RPL_HOP_TIMESTAMPS
+/* Experimental option type (RFC 4727): skipped if unknown, changes en route.
+ * Holds a count and up to RPL_HOP_TIMESTAMPS 16-bit timestamps, and is
+ * sized to keep the extension header 8-byte aligned. */
+#define RPL_HOP_TS_OPT_TYPE		0x3e
+#define RPL_HOP_TS_LEN			((2 + 1 + 2 * RPL_HOP_TIMESTAMPS + 7) & ~7)
+#else /* RPL_HOP_TIMESTAMPS */
+#define RPL_HOP_TS_LEN			0
+#endif /* RPL_HOP_TIMESTAMPS */
+#define RPL_HOP_BY_HOP_LEN		(RPL_HDR_OPT_LEN + 2 + 2 + RPL_HOP_TS_LEN)
+/* Hdr Ext Len field: in 8-octet units, not including the first 8 octets */
+#define RPL_HOP_BY_HOP_EXT_LEN		((RPL_HOP_BY_HOP_LEN - 8) / 8)
 #define RPL_HDR_OPT_DOWN		0x80
 #define RPL_HDR_OPT_DOWN_SHIFT  	7
 #define RPL_HDR_OPT_RANK_ERR		0x40
 #define RPL_HDR_OPT_RANK_ERR_SHIFT   	6
 #define RPL_HDR_OPT_FWD_ERR		0x20
 #define RPL_HDR_OPT_FWD_ERR_SHIFT   	5
+
+/* RPL source routing header (RFC 6554), for non-storing mode. The
+ * addresses share their first RPL_SRH_CMPR bytes, the DAG prefix, with
+ * the IPv6 destination */
+#define RPL_RH_TYPE_SRH                  3
+#define RPL_SRH_CMPR                     8
+#define RPL_SRH_LEN(n)                   (8 + (n) * (16 - RPL_SRH_CMPR))
 /*---------------------------------------------------------------------------*/
 /* Default values for RPL constants and variables. */
 
@@ -151,12 +176,7 @@
 #define RPL_ROUTE_FROM_MULTICAST_DAO    2
 #define RPL_ROUTE_FROM_DIO              3
 
-/* DAG Mode of Operation */
-#define RPL_MOP_NO_DOWNWARD_ROUTES      0
-#define RPL_MOP_NON_STORING             1
-#define RPL_MOP_STORING_NO_MULTICAST    2
-#define RPL_MOP_STORING_MULTICAST       3
-
+/* DAG Mode of Operation, see rpl-conf.h */
 #ifdef  RPL_CONF_MOP
 #define RPL_MOP_DEFAULT                 RPL_CONF_MOP
 #else /* RPL_CONF_MOP */
@@ -239,6 +259,18 @@ struct rpl_dio {
   rpl_prefix_t destination_prefix;
   rpl_prefix_t prefix_info;
   struct rpl_metric_container mc;
+#if RPL_DIO_FAST_PATH
+  uint16_t fingerprint;
+#endif /* RPL_DIO_FAST_PATH */
+#if RPL_DIO_CONTEXTS
+  struct {
+    uip_ipaddr_t prefix;
+    uint16_t lifetime;
+    /* C flag and context number */
+    uint8_t flags;
+  } contexts[SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS];
+  uint8_t num_contexts;
+#endif /* RPL_DIO_CONTEXTS */
 };
 typedef struct rpl_dio rpl_dio_t;
 
@@ -251,11 +283,75 @@ struct rpl_stats {
   uint16_t malformed_msgs;
   uint16_t resets;
   uint16_t parent_switch;
+  uint16_t forward_errors;
 };
 typedef struct rpl_stats rpl_stats_t;
 
 extern rpl_stats_t rpl_stats;
 #endif
+
+#if RPL_CONF_PROBING
+/* Probing overhead, kept apart from data */
+struct rpl_probing_stats {
+  /* DIO probes sent */
+  uint16_t sent;
+  /* Probes served by data packets */
+  uint16_t coalesced;
+  /* Probes skipped for lack of budget */
+  uint16_t over_budget;
+};
+extern struct rpl_probing_stats rpl_probing_stats;
+#endif /* RPL_CONF_PROBING */
+
+#if RPL_DIO_ADAPTIVE_REDUNDANCY
+/* DIO Trickle counters, see rpl-timers.c */
+struct rpl_trickle_stats {
+  /* Totals since boot */
+  uint16_t intervals;
+  uint16_t sent;
+  uint16_t suppressed;
+  /* Last completed interval: consistent DIOs heard, redundancy used
+   * and whether we transmitted */
+  uint8_t last_heard;
+  uint8_t last_k;
+  uint8_t last_sent;
+};
+extern struct rpl_trickle_stats rpl_trickle_stats;
+#endif /* RPL_DIO_ADAPTIVE_REDUNDANCY */
+
+#if RPL_LOOP_STATS
+/* Loop events, see rpl_verify_header and rpl_update_header_empty */
+enum rpl_loop_event_type {
+  /* Rank error detected, packet flagged and forwarded */
+  RPL_LOOP_RANK_ERROR,
+  /* Second rank error on a flagged packet, DIO timer reset, forwarded */
+  RPL_LOOP_RANK_ERROR_REPAIR,
+  /* Packet received with the forwarding error flag: route removed, DIO
+   * timer reset, packet dropped */
+  RPL_LOOP_FWD_ERROR_RECEIVED,
+  /* Downward packet with no route: flagged, No-Path DAO sent, dropped */
+  RPL_LOOP_FWD_ERROR_SENT,
+  RPL_LOOP_EVENT_TYPES
+};
+struct rpl_loop_event {
+  linkaddr_t sender;
+  rpl_rank_t sender_rank;
+  rpl_rank_t rank;
+  /* Seconds since our last parent switch, saturated */
+  uint16_t since_switch;
+  uint8_t type;
+};
+struct rpl_loop_stats {
+  uint16_t count[RPL_LOOP_EVENT_TYPES];
+  /* Packets dropped upon these events */
+  uint16_t dropped;
+  /* The last events, oldest first, up to RPL_LOOP_HISTORY_LEN */
+  struct rpl_loop_event history[RPL_LOOP_HISTORY_LEN];
+  uint8_t history_count;
+  unsigned long last_switch;
+};
+extern struct rpl_loop_stats rpl_loop_stats;
+#endif /* RPL_LOOP_STATS */
 /*---------------------------------------------------------------------------*/
 /* RPL macros. */
 
@@ -291,7 +387,16 @@ void rpl_icmp6_register_handlers(void);
 void rpl_join_dag(uip_ipaddr_t *from, rpl_dio_t *dio);
 void rpl_join_instance(uip_ipaddr_t *from, rpl_dio_t *dio);
 void rpl_local_repair(rpl_instance_t *instance);
+#if RPL_FAST_REPAIR
+/* Refresh the freshness timestamp of a parent */
+#define RPL_PARENT_HEARD(p) ((p)->last_heard = (uint16_t)clock_seconds())
+#else
+#define RPL_PARENT_HEARD(p)
+#endif /* RPL_FAST_REPAIR */
 int rpl_process_dio(uip_ipaddr_t *, rpl_dio_t *);
+#if RPL_DIO_FAST_PATH
+int rpl_process_dio_unchanged(uip_ipaddr_t *, rpl_dio_t *);
+#endif /* RPL_DIO_FAST_PATH */
 int rpl_process_parent_event(rpl_instance_t *, rpl_parent_t *);
 
 /* DAG object management. */
@@ -310,6 +415,34 @@ void rpl_move_parent(rpl_dag_t *dag_src, rpl_dag_t *dag_dst, rpl_parent_t *paren
 rpl_parent_t *rpl_select_parent(rpl_dag_t *dag);
 rpl_dag_t *rpl_select_dag(rpl_instance_t *instance,rpl_parent_t *parent);
 void rpl_recalculate_ranks(void);
+/* Flags a parent for rank recalculation, see RPL_CONF_INCREMENTAL_RANKS */
+void rpl_parent_updated(rpl_parent_t *p);
+/* Returns 1 if p can take upward traffic, see RPL_CONF_MULTIPATH */
+int rpl_is_upward_parent(rpl_parent_t *p);
+
+/* Learn the initial ETX of an RSSI from the ETX a parent converged to,
+ * see RPL_CONF_RSSI_ETX_LEARNING */
+#ifdef RPL_CONF_RSSI_ETX_LEARNING
+#define RPL_RSSI_ETX_LEARNING RPL_CONF_RSSI_ETX_LEARNING
+#else
+#define RPL_RSSI_ETX_LEARNING 0
+#endif
+/* Number of transmissions to a parent after which its ETX is learned */
+#ifdef RPL_CONF_RSSI_ETX_LEARNING_TX
+#define RPL_RSSI_ETX_LEARNING_TX RPL_CONF_RSSI_ETX_LEARNING_TX
+#else
+#define RPL_RSSI_ETX_LEARNING_TX 16
+#endif
+#if RPL_CONF_RSSI_BASED_ETX && RPL_RSSI_ETX_LEARNING
+void rpl_rssi_etx_learn(int16_t rssi, uint16_t etx);
+#endif
+
+#if RPL_WITH_STORE
+/* Restores the stored DAG, if any, and starts the periodic save */
+void rpl_store_init(void);
+/* A DIO of a DAG we are part of, not of an older version */
+void rpl_store_dio_input(uip_ipaddr_t *from, rpl_dio_t *dio);
+#endif /* RPL_WITH_STORE */
 
 /* RPL routing table functions. */
 void rpl_remove_routes(rpl_dag_t *dag);
@@ -324,6 +457,34 @@ void rpl_lock_parent(rpl_parent_t *p);
 /* Objective function. */
 rpl_of_t *rpl_find_of(rpl_ocp_t);
 
+#if RPL_OF_CACHE_PATH_COST
+/* Returns the path cost through p, from the cache or from compute */
+rpl_rank_t rpl_of_path_cost(rpl_parent_t *p, rpl_rank_t (*compute)(rpl_parent_t *));
+/* Forces the next rpl_of_path_cost to compute */
+void rpl_of_invalidate_path_cost(rpl_parent_t *p);
+#define RPL_OF_PATH_COST(p, compute) rpl_of_path_cost(p, compute)
+#else /* RPL_OF_CACHE_PATH_COST */
+#define rpl_of_invalidate_path_cost(p)
+#define RPL_OF_PATH_COST(p, compute) compute(p)
+#endif /* RPL_OF_CACHE_PATH_COST */
+
+#if RPL_OF_LOOKUP_TABLES
+/* Table of f over [0, size << shift], one entry every 1 << shift */
+struct rpl_of_table {
+  uint32_t (* f)(uint32_t x);
+  uint32_t *values;
+  uint8_t size;
+  uint8_t shift;
+  uint8_t ready;
+};
+#define RPL_OF_TABLE(name, f, size, shift) \
+  static uint32_t name##_values[(size) + 1]; \
+  static struct rpl_of_table name = { f, name##_values, size, shift, 0 }
+/* Returns f(x), interpolated from the table. Falls back to f
+ * out of the table */
+uint32_t rpl_of_table_lookup(struct rpl_of_table *t, uint32_t x);
+#endif /* RPL_OF_LOOKUP_TABLES */
+
 /* Timer functions. */
 #if RPL_CONF_MOP != RPL_MOP_NO_DOWNWARD_ROUTES
 void rpl_schedule_dao(rpl_instance_t *);
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+/**
+ * \file
+ *         Warm restart of RPL: our DAG, rank and preferred parent are
+ *         saved to CFS, and joined again after a reboot through the
+ *         stored parent, without waiting for DIOs. The restored DAG is
+ *         provisional until the parent answers a unicast DIS, and left
+ *         for a normal join otherwise. See RPL_CONF_WITH_STORE.
+ */
+
+#include "net/rpl/rpl-private.h"
+#include "net/ipv6/uip-ds6-nbr.h"
+#include "net/nbr-table.h"
+#include "sys/ctimer.h"
+#include "cfs/cfs.h"
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+#include <string.h>
+
+#if RPL_WITH_STORE
+
+#define STORE_MAGIC 0x5250
+#define STORE_VERSION 1
+
+/* Our DAG and preferred parent, as saved in CFS */
+struct store_record {
+  uint16_t magic;
+  uint8_t version;
+  uint8_t instance_id;
+  uint8_t dag_version;
+  uint8_t grounded;
+  uint8_t preference;
+  uint8_t parent_dtsn;
+  rpl_ocp_t ocp;
+  rpl_rank_t rank;
+  rpl_rank_t parent_rank;
+  uint16_t parent_link_metric;
+  int16_t parent_rssi;
+  uip_ipaddr_t dag_id;
+  rpl_prefix_t prefix_info;
+  uip_ipaddr_t parent_ipaddr;
+  uip_lladdr_t parent_lladdr;
+};
+
+/* The last record saved or restored */
+static struct store_record saved;
+static struct ctimer store_timer;
+/* The restored instance, until its parent answers */
+static rpl_instance_t *provisional;
+static uint8_t verify_attempts;
+static struct ctimer verify_timer;
+
+/*---------------------------------------------------------------------------*/
+/* Fills a record with our current state. Returns 0 if there is nothing
+ * worth saving: no DAG, no preferred parent, or we are the root */
+static int
+fill_record(struct store_record *r)
+{
+  rpl_dag_t *dag = rpl_get_any_dag();
+  rpl_parent_t *p;
+  uip_ipaddr_t *ipaddr;
+  const linkaddr_t *lladdr;
+
+  if(dag == NULL || dag->rank == INFINITE_RANK
+     || dag->rank == ROOT_RANK(dag->instance)
+     || dag->preferred_parent == NULL) {
+    return 0;
+  }
+  p = dag->preferred_parent;
+  ipaddr = rpl_get_parent_ipaddr(p);
+  lladdr = nbr_table_get_lladdr(rpl_parents, p);
+  if(ipaddr == NULL || lladdr == NULL) {
+    return 0;
+  }
+
+  /* Cleared for the padding, as records are compared */
+  memset(r, 0, sizeof(*r));
+  r->magic = STORE_MAGIC;
+  r->version = STORE_VERSION;
+  r->instance_id = dag->instance->instance_id;
+  r->dag_version = dag->version;
+  r->grounded = dag->grounded;
+  r->preference = dag->preference;
+  r->parent_dtsn = p->dtsn;
+  r->ocp = dag->instance->of->ocp;
+  r->rank = dag->rank;
+  r->parent_rank = p->rank;
+  r->parent_link_metric = p->link_metric;
+  r->parent_rssi = p->rssi;
+  uip_ipaddr_copy(&r->dag_id, &dag->dag_id);
+  memcpy(&r->prefix_info, &dag->prefix_info, sizeof(r->prefix_info));
+  uip_ipaddr_copy(&r->parent_ipaddr, ipaddr);
+  memcpy(&r->parent_lladdr, lladdr, sizeof(r->parent_lladdr));
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_store_save(void)
+{
+  struct store_record r;
+  int fd;
+  int ok;
+
+  /* A provisional state is still the one we restored */
+  if(provisional != NULL || !fill_record(&r)) {
+    return 0;
+  }
+  if(memcmp(&r, &saved, sizeof(r)) == 0) {
+    return 1;
+  }
+
+  cfs_remove(RPL_STORE_FILE);
+  fd = cfs_open(RPL_STORE_FILE, CFS_WRITE);
+  if(fd < 0) {
+    return 0;
+  }
+  ok = cfs_write(fd, &r, sizeof(r)) == sizeof(r);
+  cfs_close(fd);
+
+  if(ok) {
+    memcpy(&saved, &r, sizeof(saved));
+  }
+  PRINTF("RPL-store: save %s, rank %u\n", ok ? "done" : "failed", r.rank);
+  return ok;
+}
+/*---------------------------------------------------------------------------*/
+static void
+store_timer_callback(void *ptr)
+{
+  rpl_store_save();
+  ctimer_reset(&store_timer);
+}
+/*---------------------------------------------------------------------------*/
+/* Joins the stored DAG through the stored parent, as upon its DIO.
+ * Returns 1 if success, 0 if failure */
+static int
+restore(void)
+{
+  struct store_record r;
+  rpl_dio_t dio;
+  uip_ds6_nbr_t *nbr;
+  rpl_instance_t *instance;
+  rpl_dag_t *dag;
+  rpl_parent_t *p;
+  int fd;
+  int ok;
+
+  fd = cfs_open(RPL_STORE_FILE, CFS_READ);
+  if(fd < 0) {
+    return 0;
+  }
+  ok = cfs_read(fd, &r, sizeof(r)) == sizeof(r);
+  cfs_close(fd);
+  if(!ok || r.magic != STORE_MAGIC || r.version != STORE_VERSION
+     || rpl_find_of(r.ocp) == NULL) {
+    return 0;
+  }
+
+  /* RPL parents must be in the neighbor cache, dio_input adds them */
+  if((nbr = uip_ds6_nbr_lookup(&r.parent_ipaddr)) == NULL) {
+    if((nbr = uip_ds6_nbr_add(&r.parent_ipaddr, &r.parent_lladdr,
+                              0, NBR_REACHABLE)) == NULL) {
+      return 0;
+    }
+    stimer_set(&nbr->reachable, UIP_ND6_REACHABLE_TIME / 1000);
+  }
+
+  memset(&dio, 0, sizeof(dio));
+  uip_ipaddr_copy(&dio.dag_id, &r.dag_id);
+  dio.ocp = r.ocp;
+  dio.rank = r.parent_rank;
+  dio.grounded = r.grounded;
+  dio.preference = r.preference;
+  dio.version = r.dag_version;
+  dio.instance_id = r.instance_id;
+  dio.dtsn = r.parent_dtsn;
+  dio.rssi = r.parent_rssi;
+  memcpy(&dio.prefix_info, &r.prefix_info, sizeof(dio.prefix_info));
+  rpl_process_dio(&r.parent_ipaddr, &dio);
+
+  instance = rpl_get_instance(r.instance_id);
+  if(instance == NULL) {
+    return 0;
+  }
+  dag = instance->current_dag;
+  p = rpl_find_parent(dag, &r.parent_ipaddr);
+  if(p == NULL || p != dag->preferred_parent) {
+    rpl_free_instance(instance);
+    return 0;
+  }
+
+  /* Resume from the link metric we had, rather than the initial one */
+  p->link_metric = r.parent_link_metric;
+  rpl_of_invalidate_path_cost(p);
+  dag->rank = instance->of->calculate_rank(p, 0);
+  dag->min_rank = dag->rank;
+
+  memcpy(&saved, &r, sizeof(saved));
+  provisional = instance;
+  PRINTF("RPL-store: restored instance %u, version %u, rank %u (was %u), parent ",
+         r.instance_id, r.dag_version, dag->rank, r.rank);
+  PRINT6ADDR(&r.parent_ipaddr);
+  PRINTF("\n");
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+verify_timer_callback(void *ptr)
+{
+  rpl_dag_t *dag;
+  uip_ipaddr_t *ipaddr;
+
+  if(provisional == NULL) {
+    return;
+  }
+
+  /* We may have moved on by ourselves, e.g. to another parent */
+  dag = provisional->used ? provisional->current_dag : NULL;
+  ipaddr = dag != NULL && dag->preferred_parent != NULL ?
+    rpl_get_parent_ipaddr(dag->preferred_parent) : NULL;
+  if(ipaddr == NULL || !uip_ipaddr_cmp(ipaddr, &saved.parent_ipaddr)) {
+    provisional = NULL;
+    return;
+  }
+
+  if(verify_attempts >= RPL_STORE_VERIFY_ATTEMPTS) {
+    PRINTF("RPL-store: no answer from the stored parent, leaving instance %u\n",
+           provisional->instance_id);
+    rpl_free_instance(provisional);
+    provisional = NULL;
+    return;
+  }
+
+  verify_attempts++;
+  dis_output(&saved.parent_ipaddr);
+  ctimer_set(&verify_timer, RPL_STORE_VERIFY_INTERVAL, verify_timer_callback, NULL);
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_store_verify(void)
+{
+  if(provisional != NULL) {
+    verify_attempts = 0;
+    verify_timer_callback(NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_store_dio_input(uip_ipaddr_t *from, rpl_dio_t *dio)
+{
+  if(provisional != NULL && dio->instance_id == provisional->instance_id
+     && dio->rank != INFINITE_RANK && uip_ipaddr_cmp(from, &saved.parent_ipaddr)) {
+    PRINTF("RPL-store: restored state verified\n");
+    ctimer_stop(&verify_timer);
+    provisional = NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_store_init(void)
+{
+  provisional = NULL;
+  if(restore() && !RPL_STORE_WAIT_LINK) {
+    rpl_store_verify();
+  }
+  ctimer_set(&store_timer, RPL_STORE_PERIOD, store_timer_callback, NULL);
+}
+
+#endif /* RPL_WITH_STORE */
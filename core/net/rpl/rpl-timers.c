@@ -43,6 +43,7 @@
 
 #include "contiki-conf.h"
 #include "net/rpl/rpl-private.h"
+#include "net/rpl/rpl-ns.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
 #include "lib/random.h"
 #include "sys/ctimer.h"
@@ -71,11 +72,33 @@ static uint8_t dio_send_ok;
 void RPL_CALLBACK_NEW_DIO_INTERVAL(uint8_t dio_interval);
 #endif
 
+#if RPL_DIO_ADAPTIVE_REDUNDANCY
+struct rpl_trickle_stats rpl_trickle_stats;
+#endif /* RPL_DIO_ADAPTIVE_REDUNDANCY */
+
+/*---------------------------------------------------------------------------*/
+/* Returns the redundancy constant k for the current neighbor density */
+static uint8_t
+dio_redundancy(void)
+{
+#if RPL_DIO_ADAPTIVE_REDUNDANCY
+  int num = rpl_dag_parents_num();
+  if(num > RPL_DIO_DENSITY_THRESHOLD) {
+    int k = (RPL_DIO_REDUNDANCY * RPL_DIO_DENSITY_THRESHOLD) / num;
+    return k > RPL_DIO_REDUNDANCY_MIN ? k : RPL_DIO_REDUNDANCY_MIN;
+  }
+#endif /* RPL_DIO_ADAPTIVE_REDUNDANCY */
+  return RPL_DIO_REDUNDANCY;
+}
+
 /*---------------------------------------------------------------------------*/
 static void
 handle_periodic_timer(void *ptr)
 {
   rpl_purge_routes();
+#if RPL_WITH_NON_STORING
+  rpl_ns_periodic();
+#endif /* RPL_WITH_NON_STORING */
   rpl_recalculate_ranks();
 
   /* handle DIS */
@@ -102,7 +125,9 @@ new_dio_interval(rpl_instance_t *instance)
   ticks = (time * CLOCK_SECOND) / 1000;
   instance->dio_next_delay = ticks;
 
-  /* random number between I/2 and I */
+  /* random number between I/2 and I. The first half of the interval is
+   * listen-only: we only count the consistent DIOs heard, so that nodes
+   * with a short interval do not transmit before hearing the others. */
   ticks = ticks / 2 + (ticks / 2 * (uint32_t)random_rand()) / RANDOM_RAND_MAX;
 
   /*
@@ -131,6 +156,11 @@ new_dio_interval(rpl_instance_t *instance)
 	   instance->current_dag->rank == ROOT_RANK(instance) ? "BLUE" : "ORANGE");
 #endif /* RPL_CONF_STATS */
 
+#if RPL_DIO_ADAPTIVE_REDUNDANCY
+  rpl_trickle_stats.intervals++;
+  rpl_trickle_stats.last_heard = instance->dio_counter;
+#endif /* RPL_DIO_ADAPTIVE_REDUNDANCY */
+
   /* reset the redundancy counter */
   instance->dio_counter = 0;
 
@@ -158,16 +188,28 @@ handle_dio_timer(void *ptr)
   }
 
   if(instance->dio_send) {
+    uint8_t k = dio_redundancy();
     /* send DIO if counter is less than desired redundancy */
-    if(instance->dio_counter < RPL_DIO_REDUNDANCY) {
+    if(instance->dio_counter < k) {
 #if RPL_CONF_STATS
       instance->dio_totsend++;
 #endif /* RPL_CONF_STATS */
+#if RPL_DIO_ADAPTIVE_REDUNDANCY
+      rpl_trickle_stats.sent++;
+      rpl_trickle_stats.last_sent = 1;
+#endif /* RPL_DIO_ADAPTIVE_REDUNDANCY */
       dio_output(instance, NULL);
     } else {
+#if RPL_DIO_ADAPTIVE_REDUNDANCY
+      rpl_trickle_stats.suppressed++;
+      rpl_trickle_stats.last_sent = 0;
+#endif /* RPL_DIO_ADAPTIVE_REDUNDANCY */
       PRINTF("RPL: Supressing DIO transmission (%d >= %d)\n",
-             instance->dio_counter, RPL_DIO_REDUNDANCY);
+             instance->dio_counter, k);
     }
+#if RPL_DIO_ADAPTIVE_REDUNDANCY
+    rpl_trickle_stats.last_k = k;
+#endif /* RPL_DIO_ADAPTIVE_REDUNDANCY */
     instance->dio_send = 0;
     PRINTF("RPL: Scheduling DIO timer %lu ticks in future (sent)\n",
            instance->dio_next_delay);
@@ -47,6 +47,7 @@
 #include "net/ipv6/uip-ds6.h"
 #include "net/ipv6/uip-icmp6.h"
 #include "net/rpl/rpl-private.h"
+#include "net/rpl/rpl-ns.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
 
 #define DEBUG DEBUG_NONE
@@ -60,6 +61,10 @@ rpl_stats_t rpl_stats;
 #endif
 
 static enum rpl_mode mode = RPL_MODE_MESH;
+
+#ifdef RPL_CALLBACK_LINK_METRIC
+uint16_t RPL_CALLBACK_LINK_METRIC(const linkaddr_t *addr, uint16_t link_metric);
+#endif
 /*---------------------------------------------------------------------------*/
 enum rpl_mode
 rpl_get_mode(void)
@@ -260,16 +265,29 @@ rpl_link_neighbor_callback(const linkaddr_t *addr, int status, int numtx)
       if(parent != NULL) {
         /* Trigger DAG rank recalculation. */
         PRINTF("RPL: rpl_link_neighbor_callback triggering update\n");
-        parent->flags |= RPL_PARENT_FLAG_UPDATED;
         if(instance->of->neighbor_link_callback != NULL) {
           instance->of->neighbor_link_callback(parent, status, numtx);
+#ifdef RPL_CALLBACK_LINK_METRIC
+          /* Let the link layer override the metric with its own estimate */
+          parent->link_metric = RPL_CALLBACK_LINK_METRIC(addr, parent->link_metric);
+#endif
+#if RPL_CONF_RSSI_BASED_ETX && RPL_RSSI_ETX_LEARNING
+          if(parent->tx_count < RPL_RSSI_ETX_LEARNING_TX &&
+             parent->tx_count + numtx >= RPL_RSSI_ETX_LEARNING_TX) {
+            rpl_rssi_etx_learn(parent->rssi, parent->link_metric);
+          }
+#endif
           parent->tx_count += numtx;
+          if(status == MAC_TX_OK) {
+            RPL_PARENT_HEARD(parent);
+          }
 #if RPL_CONF_PROBING_LOCK_ALL
           if(parent->tx_count >= RPL_CONF_PROBING_TX_THRESHOLD) {
             nbr_table_lock(rpl_parents, parent);
           }
 #endif /* RPL_CONF_PROBING_LOCK_ALL */
         }
+        rpl_parent_updated(parent);
       }
     }
   }
@@ -292,7 +310,7 @@ rpl_ipv6_neighbor_callback(uip_ds6_nbr_t *nbr)
         p->rank = INFINITE_RANK;
         /* Trigger DAG rank recalculation. */
         PRINTF("RPL: rpl_ipv6_neighbor_callback infinite rank\n");
-        p->flags |= RPL_PARENT_FLAG_UPDATED;
+        rpl_parent_updated(p);
       }
     }
   }
@@ -306,6 +324,9 @@ rpl_init(void)
   default_instance = NULL;
 
   rpl_dag_init();
+#if RPL_WITH_NON_STORING
+  rpl_ns_init();
+#endif /* RPL_WITH_NON_STORING */
   rpl_reset_periodic_timer();
   rpl_icmp6_register_handlers();
 
@@ -318,6 +339,9 @@ rpl_init(void)
 #endif
 
   RPL_OF.reset(NULL);
+#if RPL_WITH_STORE
+  rpl_store_init();
+#endif /* RPL_WITH_STORE */
 }
 /*---------------------------------------------------------------------------*/
 
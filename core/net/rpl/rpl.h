@@ -107,6 +107,7 @@ struct rpl_dag;
 /*---------------------------------------------------------------------------*/
 #define RPL_PARENT_FLAG_UPDATED           0x1
 #define RPL_PARENT_FLAG_LINK_METRIC_VALID 0x2
+#define RPL_PARENT_FLAG_DIO_FINGERPRINT   0x4
 
 struct rpl_parent {
   struct rpl_parent *next;
@@ -120,6 +121,21 @@ struct rpl_parent {
   uint16_t tx_count;
   uint8_t dtsn;
   uint8_t flags;
+#if RPL_FAST_REPAIR
+  /* Last time we heard from this parent, in seconds */
+  uint16_t last_heard;
+#endif /* RPL_FAST_REPAIR */
+#if RPL_OF_CACHE_PATH_COST
+  /* Path cost through this parent, and the rank and link metric it was
+   * computed from */
+  rpl_rank_t path_cost;
+  rpl_rank_t cost_rank;
+  uint16_t cost_link_metric;
+#endif /* RPL_OF_CACHE_PATH_COST */
+#if RPL_DIO_FAST_PATH
+  /* CRC of the last DIO accepted from this parent */
+  uint16_t dio_fingerprint;
+#endif /* RPL_DIO_FAST_PATH */
 };
 typedef struct rpl_parent rpl_parent_t;
 /*---------------------------------------------------------------------------*/
@@ -254,10 +270,26 @@ int rpl_verify_header(int);
 void rpl_insert_header(void);
 void rpl_remove_header(void);
 uint8_t rpl_invert_header(void);
+int rpl_get_hop_timestamps(uint16_t *timestamps, int max);
+int rpl_get_header_instance(void);
 uip_ipaddr_t *rpl_get_parent_ipaddr(rpl_parent_t *nbr);
 rpl_parent_t *rpl_get_parent(uip_lladdr_t *addr);
 rpl_rank_t rpl_get_parent_rank(uip_lladdr_t *addr);
 uint16_t rpl_get_parent_link_metric(const uip_lladdr_t *addr);
+uip_ipaddr_t *rpl_get_upward_nexthop(uip_ipaddr_t *defrt);
+#if RPL_WITH_NON_STORING
+int rpl_insert_srh_header(void);
+int rpl_process_srh_header(void);
+int rpl_srh_get_next_hop(uip_ipaddr_t *ipaddr);
+#endif /* RPL_WITH_NON_STORING */
+#if RPL_WITH_STORE
+/* Saves our DAG, rank and preferred parent to CFS, if they changed.
+ * Returns 1 if saved or unchanged, 0 if failure or nothing to save */
+int rpl_store_save(void);
+/* (Re)starts the verification of a restored DAG with the stored parent,
+ * e.g. once the link layer can reach it. See RPL_CONF_WITH_STORE */
+void rpl_store_verify(void);
+#endif /* RPL_WITH_STORE */
 void rpl_dag_init(void);
 
 
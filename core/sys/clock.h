@@ -132,6 +132,14 @@ void clock_wait(clock_time_t t);
  */
 void clock_delay_usec(uint16_t dt);
 
+/**
+ * Skip the clock interrupts until the next etimer expiration, on
+ * platforms with CLOCK_CONF_TICKLESS. Called with interrupts disabled,
+ * before going to sleep.
+ *
+ */
+void clock_tickless_idle(void);
+
 /**
  * Deprecated platform-specific routines.
  *
@@ -46,7 +46,8 @@
 #include "contiki.h"
 #include "lib/list.h"
 
-LIST(ctimer_list);
+/* Appended to on every ctimer_set */
+LIST_WITH_TAIL(ctimer_list);
 
 static char initialized;
 
@@ -74,7 +75,7 @@ PROCESS_THREAD(ctimer_process, ev, data)
     PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_TIMER);
     for(c = list_head(ctimer_list); c != NULL; c = c->next) {
       if(&c->etimer == data) {
-	list_remove(ctimer_list, c);
+	tlist_remove(ctimer_list, c);
 	PROCESS_CONTEXT_BEGIN(c->p);
 	if(c->f != NULL) {
 	  c->f(c->ptr);
@@ -91,7 +92,7 @@ void
 ctimer_init(void)
 {
   initialized = 0;
-  list_init(ctimer_list);
+  tlist_init(ctimer_list);
   process_start(&ctimer_process, NULL);
 }
 /*---------------------------------------------------------------------------*/
@@ -111,7 +112,7 @@ ctimer_set(struct ctimer *c, clock_time_t t,
     c->etimer.timer.interval = t;
   }
 
-  list_add(ctimer_list, c);
+  tlist_add(ctimer_list, c);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -123,7 +124,7 @@ ctimer_reset(struct ctimer *c)
     PROCESS_CONTEXT_END(&ctimer_process);
   }
 
-  list_add(ctimer_list, c);
+  tlist_add(ctimer_list, c);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -135,7 +136,7 @@ ctimer_restart(struct ctimer *c)
     PROCESS_CONTEXT_END(&ctimer_process);
   }
 
-  list_add(ctimer_list, c);
+  tlist_add(ctimer_list, c);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -147,7 +148,7 @@ ctimer_stop(struct ctimer *c)
     c->etimer.next = NULL;
     c->etimer.p = PROCESS_NONE;
   }
-  list_remove(ctimer_list, c);
+  tlist_remove(ctimer_list, c);
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -49,31 +49,83 @@
 #include "sys/etimer.h"
 #include "sys/process.h"
 
+/* Pending timers, sorted by expiration time: the next to expire is
+   first, and timers expiring at the same time are in insertion order. */
 static struct etimer *timerlist;
+/* Last timer of the list, for constant-time insertion at the end, the
+   common case of timers set to the longest interval in use. */
+static struct etimer *timerlist_tail;
 static clock_time_t next_expiration;
 
 PROCESS(etimer_process, "Event timer");
+
+#define EXPIRATION(t) ((t)->timer.start + (t)->timer.interval)
+/*---------------------------------------------------------------------------*/
+/* Time left before a timer expires, 0 if it has. Relative to now, to
+   order timers across clock wraps. */
+static clock_time_t
+time_left(struct etimer *t, clock_time_t now)
+{
+  if((clock_time_t)(now - t->timer.start) >= t->timer.interval) {
+    return 0;
+  }
+  return EXPIRATION(t) - now;
+}
 /*---------------------------------------------------------------------------*/
 static void
 update_time(void)
 {
-  clock_time_t tdist;
-  clock_time_t now;
-  struct etimer *t;
+  next_expiration = timerlist != NULL ? EXPIRATION(timerlist) : 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Remove a timer from the list, returns 1 if it was there. */
+static int
+remove_timer(struct etimer *et)
+{
+  struct etimer *t, *u = NULL;
 
-  if (timerlist == NULL) {
-    next_expiration = 0;
+  for(t = timerlist; t != NULL && t != et; t = t->next) {
+    u = t;
+  }
+  if(t == NULL) {
+    return 0;
+  }
+  if(u != NULL) {
+    u->next = et->next;
   } else {
-    now = clock_time();
-    t = timerlist;
-    /* Must calculate distance to next time into account due to wraps */
-    tdist = t->timer.start + t->timer.interval - now;
-    for(t = t->next; t != NULL; t = t->next) {
-      if(t->timer.start + t->timer.interval - now < tdist) {
-	tdist = t->timer.start + t->timer.interval - now;
-      }
+    timerlist = et->next;
+  }
+  if(timerlist_tail == et) {
+    timerlist_tail = u;
+  }
+  et->next = NULL;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Insert a timer at its place in the list. */
+static void
+insert_timer(struct etimer *et)
+{
+  clock_time_t now = clock_time();
+  clock_time_t left = time_left(et, now);
+  struct etimer *t, *u = NULL;
+
+  if(timerlist_tail != NULL && left >= time_left(timerlist_tail, now)) {
+    u = timerlist_tail;
+  } else {
+    for(t = timerlist; t != NULL && left >= time_left(t, now); t = t->next) {
+      u = t;
     }
-    next_expiration = now + tdist;
+  }
+  if(u != NULL) {
+    et->next = u->next;
+    u->next = et;
+  } else {
+    et->next = timerlist;
+    timerlist = et;
+  }
+  if(et->next == NULL) {
+    timerlist_tail = et;
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -84,6 +136,7 @@ PROCESS_THREAD(etimer_process, ev, data)
   PROCESS_BEGIN();
 
   timerlist = NULL;
+  timerlist_tail = NULL;
   
   while(1) {
     PROCESS_YIELD();
@@ -91,49 +144,44 @@ PROCESS_THREAD(etimer_process, ev, data)
     if(ev == PROCESS_EVENT_EXITED) {
       struct process *p = data;
 
-      while(timerlist != NULL && timerlist->p == p) {
-	timerlist = timerlist->next;
-      }
-
-      if(timerlist != NULL) {
-	t = timerlist;
-	while(t->next != NULL) {
-	  if(t->next->p == p) {
-	    t->next = t->next->next;
-	  } else
-	    t = t->next;
+      u = NULL;
+      for(t = timerlist; t != NULL; t = t->next) {
+	if(t->p == p) {
+	  if(u != NULL) {
+	    u->next = t->next;
+	  } else {
+	    timerlist = t->next;
+	  }
+	} else {
+	  u = t;
 	}
       }
+      timerlist_tail = u;
+      update_time();
       continue;
     } else if(ev != PROCESS_EVENT_POLL) {
       continue;
     }
 
-  again:
-    
-    u = NULL;
-    
-    for(t = timerlist; t != NULL; t = t->next) {
-      if(timer_expired(&t->timer)) {
-	if(process_post(t->p, PROCESS_EVENT_TIMER, t) == PROCESS_ERR_OK) {
-	  
-	  /* Reset the process ID of the event timer, to signal that the
-	     etimer has expired. This is later checked in the
-	     etimer_expired() function. */
-	  t->p = PROCESS_NONE;
-	  if(u != NULL) {
-	    u->next = t->next;
-	  } else {
-	    timerlist = t->next;
-	  }
-	  t->next = NULL;
-	  update_time();
-	  goto again;
-	} else {
-	  etimer_request_poll();
+    /* The list is sorted: only the timers at its head can have expired */
+    while(timerlist != NULL && timer_expired(&timerlist->timer)) {
+      t = timerlist;
+      if(process_post(t->p, PROCESS_EVENT_TIMER, t) == PROCESS_ERR_OK) {
+
+	/* Reset the process ID of the event timer, to signal that the
+	   etimer has expired. This is later checked in the
+	   etimer_expired() function. */
+	t->p = PROCESS_NONE;
+	timerlist = t->next;
+	if(timerlist == NULL) {
+	  timerlist_tail = NULL;
 	}
+	t->next = NULL;
+	update_time();
+      } else {
+	etimer_request_poll();
+	break;
       }
-      u = t;
     }
     
   }
@@ -150,25 +198,15 @@ etimer_request_poll(void)
 static void
 add_timer(struct etimer *timer)
 {
-  struct etimer *t;
-
   etimer_request_poll();
 
   if(timer->p != PROCESS_NONE) {
-    for(t = timerlist; t != NULL; t = t->next) {
-      if(t == timer) {
-	/* Timer already on list, bail out. */
-        timer->p = PROCESS_CURRENT();
-	update_time();
-	return;
-      }
-    }
+    /* Timer maybe already on list, with another expiration time. */
+    remove_timer(timer);
   }
 
-  /* Timer not on list. */
   timer->p = PROCESS_CURRENT();
-  timer->next = timerlist;
-  timerlist = timer;
+  insert_timer(timer);
 
   update_time();
 }
@@ -198,6 +236,9 @@ void
 etimer_adjust(struct etimer *et, int timediff)
 {
   et->timer.start += timediff;
+  if(et->p != PROCESS_NONE && remove_timer(et)) {
+    insert_timer(et);
+  }
   update_time();
 }
 /*---------------------------------------------------------------------------*/
@@ -234,25 +275,8 @@ etimer_next_expiration_time(void)
 void
 etimer_stop(struct etimer *et)
 {
-  struct etimer *t;
-
-  /* First check if et is the first event timer on the list. */
-  if(et == timerlist) {
-    timerlist = timerlist->next;
+  if(remove_timer(et)) {
     update_time();
-  } else {
-    /* Else walk through the list and try to find the item before the
-       et timer. */
-    for(t = timerlist; t != NULL && t->next != et; t = t->next);
-
-    if(t != NULL) {
-      /* We've found the item before the event timer that we are about
-	 to remove. We point the items next pointer to the event after
-	 the removed item. */
-      t->next = et->next;
-
-      update_time();
-    }
   }
 
   /* Remove the next pointer from the item to be removed. */
@@ -47,6 +47,10 @@
 
 #include "sys/process.h"
 #include "sys/arg.h"
+#if PROCESS_CONF_CPU_TIME
+#include "sys/clock.h"
+#include "sys/rtimer.h"
+#endif /* PROCESS_CONF_CPU_TIME */
 
 /*
  * Pointer to the currently running process structure.
@@ -68,10 +72,26 @@ struct event_data {
 static process_num_events_t nevents, fevent;
 static struct event_data events[PROCESS_CONF_NUMEVENTS];
 
+#if PROCESS_CONF_PRIORITY_LEVELS > 1
+/* Queues of the levels above 0, and their total number of events */
+static process_num_events_t prio_nevents[PROCESS_CONF_PRIORITY_LEVELS - 1];
+static process_num_events_t prio_fevent[PROCESS_CONF_PRIORITY_LEVELS - 1];
+static struct event_data prio_events[PROCESS_CONF_PRIORITY_LEVELS - 1][PROCESS_CONF_NUMEVENTS_PRIORITY];
+static process_num_events_t prio_total;
+#define PRIO_TOTAL prio_total
+#else
+#define PRIO_TOTAL 0
+#endif /* PROCESS_CONF_PRIORITY_LEVELS > 1 */
+
 #if PROCESS_CONF_STATS
 process_num_events_t process_maxevents;
 #endif
 
+#if PROCESS_CONF_CPU_TIME
+/* Total time charged to processes, to tell the time of nested calls */
+static unsigned long process_cpu_charged;
+#endif /* PROCESS_CONF_CPU_TIME */
+
 static volatile unsigned char poll_requested;
 
 #define PROCESS_STATE_NONE        0
@@ -175,6 +195,10 @@ static void
 call_process(struct process *p, process_event_t ev, process_data_t data)
 {
   int ret;
+#if PROCESS_CONF_CPU_TIME
+  rtimer_clock_t start;
+  unsigned long charged, elapsed;
+#endif /* PROCESS_CONF_CPU_TIME */
 
 #if DEBUG
   if(p->state == PROCESS_STATE_CALLED) {
@@ -187,7 +211,17 @@ call_process(struct process *p, process_event_t ev, process_data_t data)
     PRINTF("process: calling process '%s' with event %d\n", PROCESS_NAME_STRING(p), ev);
     process_current = p;
     p->state = PROCESS_STATE_CALLED;
+#if PROCESS_CONF_CPU_TIME
+    charged = process_cpu_charged;
+    start = RTIMER_NOW();
+#endif /* PROCESS_CONF_CPU_TIME */
     ret = p->thread(&p->pt, ev, data);
+#if PROCESS_CONF_CPU_TIME
+    /* Do not charge p for the processes it called synchronously */
+    elapsed = (rtimer_clock_t)(RTIMER_NOW() - start) - (process_cpu_charged - charged);
+    p->cpu_time += elapsed;
+    process_cpu_charged += elapsed;
+#endif /* PROCESS_CONF_CPU_TIME */
     if(ret == PT_EXITED ||
        ret == PT_ENDED ||
        ev == PROCESS_EVENT_EXIT) {
@@ -198,6 +232,41 @@ call_process(struct process *p, process_event_t ev, process_data_t data)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if PROCESS_CONF_PRIORITY_LEVELS > 1
+void
+process_set_priority(struct process *p, unsigned char priority)
+{
+  p->priority = priority < PROCESS_CONF_PRIORITY_LEVELS ?
+    priority : PROCESS_CONF_PRIORITY_LEVELS - 1;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Deliver the next event of the highest non-empty level above 0.
+ * Returns 0 if there is none.
+ */
+static int
+do_prio_event(void)
+{
+  struct event_data e;
+  int i;
+
+  for(i = PROCESS_CONF_PRIORITY_LEVELS - 2; i >= 0; i--) {
+    if(prio_nevents[i] > 0) {
+      e = prio_events[i][prio_fevent[i]];
+      prio_fevent[i] = (prio_fevent[i] + 1) % PROCESS_CONF_NUMEVENTS_PRIORITY;
+      --prio_nevents[i];
+      --prio_total;
+      if(e.ev == PROCESS_EVENT_INIT) {
+	e.p->state = PROCESS_STATE_RUNNING;
+      }
+      call_process(e.p, e.ev, e.data);
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif /* PROCESS_CONF_PRIORITY_LEVELS > 1 */
+/*---------------------------------------------------------------------------*/
 void
 process_exit(struct process *p)
 {
@@ -258,6 +327,12 @@ do_event(void)
    * call the poll handlers inbetween.
    */
 
+#if PROCESS_CONF_PRIORITY_LEVELS > 1
+  if(prio_total > 0 && do_prio_event()) {
+    return;
+  }
+#endif /* PROCESS_CONF_PRIORITY_LEVELS > 1 */
+
   if(nevents > 0) {
     
     /* There are events that we should deliver. */
@@ -309,13 +384,13 @@ process_run(void)
   /* Process one event from the queue */
   do_event();
 
-  return nevents + poll_requested;
+  return nevents + PRIO_TOTAL + poll_requested;
 }
 /*---------------------------------------------------------------------------*/
 int
 process_nevents(void)
 {
-  return nevents + poll_requested;
+  return nevents + PRIO_TOTAL + poll_requested;
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -332,6 +407,22 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
 	   p == PROCESS_BROADCAST? "<broadcast>": PROCESS_NAME_STRING(p), nevents);
   }
   
+#if PROCESS_CONF_PRIORITY_LEVELS > 1
+  if(p != PROCESS_BROADCAST && p->priority > 0) {
+    unsigned char i = p->priority - 1;
+    if(prio_nevents[i] == PROCESS_CONF_NUMEVENTS_PRIORITY) {
+      return PROCESS_ERR_FULL;
+    }
+    snum = (process_num_events_t)(prio_fevent[i] + prio_nevents[i]) % PROCESS_CONF_NUMEVENTS_PRIORITY;
+    prio_events[i][snum].ev = ev;
+    prio_events[i][snum].data = data;
+    prio_events[i][snum].p = p;
+    ++prio_nevents[i];
+    ++prio_total;
+    return PROCESS_ERR_OK;
+  }
+#endif /* PROCESS_CONF_PRIORITY_LEVELS > 1 */
+
   if(nevents == PROCESS_CONF_NUMEVENTS) {
 #if DEBUG
     if(p == PROCESS_BROADCAST) {
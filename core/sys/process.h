@@ -88,6 +88,18 @@ typedef unsigned char process_num_events_t;
 #define PROCESS_CONF_NUMEVENTS 32
 #endif /* PROCESS_CONF_NUMEVENTS */
 
+/* Number of process priority levels. Events to processes of a higher
+ * level are delivered first, each level having its own queue, between
+ * poll handlers as usual. Broadcast events are of the lowest level, 0. */
+#ifndef PROCESS_CONF_PRIORITY_LEVELS
+#define PROCESS_CONF_PRIORITY_LEVELS 1
+#endif /* PROCESS_CONF_PRIORITY_LEVELS */
+
+/* Size of the event queue of every level above 0 */
+#ifndef PROCESS_CONF_NUMEVENTS_PRIORITY
+#define PROCESS_CONF_NUMEVENTS_PRIORITY 8
+#endif /* PROCESS_CONF_NUMEVENTS_PRIORITY */
+
 #define PROCESS_EVENT_NONE            0x80
 #define PROCESS_EVENT_INIT            0x81
 #define PROCESS_EVENT_POLL            0x82
@@ -323,6 +335,16 @@ struct process {
   PT_THREAD((* thread)(struct pt *, process_event_t, process_data_t));
   struct pt pt;
   unsigned char state, needspoll;
+#if PROCESS_CONF_PRIORITY_LEVELS > 1
+  /* Priority level, 0 (the default) to PROCESS_CONF_PRIORITY_LEVELS - 1 */
+  unsigned char priority;
+#endif /* PROCESS_CONF_PRIORITY_LEVELS > 1 */
+#if PROCESS_CONF_CPU_TIME
+  /* Time spent in the process' thread, in rtimer ticks, with
+     PROCESS_CONF_CPU_TIME. Includes the interrupts that occurred
+     meanwhile, but not the processes it posted synchronous events to. */
+  unsigned long cpu_time;
+#endif /* PROCESS_CONF_CPU_TIME */
 };
 
 /**
@@ -341,6 +363,21 @@ struct process {
  */
 CCIF void process_start(struct process *p, process_data_t data);
 
+/**
+ * Set the priority level of a process.
+ *
+ * \param p A pointer to a process structure.
+ *
+ * \param priority The level, from 0 to PROCESS_CONF_PRIORITY_LEVELS - 1.
+ * Higher levels are served first. Events already queued keep their level.
+ *
+ */
+#if PROCESS_CONF_PRIORITY_LEVELS > 1
+void process_set_priority(struct process *p, unsigned char priority);
+#else
+#define process_set_priority(p, priority)
+#endif /* PROCESS_CONF_PRIORITY_LEVELS > 1 */
+
 /**
  * Post an asynchronous event.
  *
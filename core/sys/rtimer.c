@@ -54,7 +54,17 @@
 #define PRINTF(...)
 #endif
 
+#if RTIMER_MULTIPLEX
+/* Pending tasks, sorted by time, then by decreasing priority */
+static struct rtimer *queue;
+/* Set while the queue is modified or tasks run. An interrupt that finds
+ * it set leaves the tasks to rtimer_run_next in progress */
+static volatile uint8_t locked;
+static volatile uint8_t run_requested;
+static struct rtimer_multiplex_stats stats;
+#else /* RTIMER_MULTIPLEX */
 static struct rtimer *next_rtimer;
+#endif /* RTIMER_MULTIPLEX */
 
 /*---------------------------------------------------------------------------*/
 void
@@ -62,6 +72,152 @@ rtimer_init(void)
 {
   rtimer_arch_init();
 }
+#if RTIMER_MULTIPLEX
+/*---------------------------------------------------------------------------*/
+/* Removes a task from the queue. Returns 1 if it was there, 0 otherwise */
+static int
+queue_remove(struct rtimer *rtimer)
+{
+  struct rtimer **p;
+  for(p = &queue; *p != NULL; p = &(*p)->next) {
+    if(*p == rtimer) {
+      *p = rtimer->next;
+      rtimer->next = NULL;
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+queue_insert(struct rtimer *rtimer)
+{
+  struct rtimer **p;
+  for(p = &queue; *p != NULL; p = &(*p)->next) {
+    if(RTIMER_CLOCK_LT(rtimer->time, (*p)->time)
+        || (rtimer->time == (*p)->time && rtimer->priority > (*p)->priority)) {
+      break;
+    }
+  }
+  rtimer->next = *p;
+  *p = rtimer;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the first task that, run from the latest of now and its time,
+ * leaves RTIMER_MULTIPLEX_GUARD before any task of higher priority */
+static struct rtimer *
+first_runnable(rtimer_clock_t now)
+{
+  struct rtimer *t;
+  struct rtimer *q;
+  rtimer_clock_t start;
+
+  for(t = queue; t != NULL; t = t->next) {
+    start = RTIMER_CLOCK_LT(now, t->time) ? t->time : now;
+    for(q = t->next; q != NULL; q = q->next) {
+      if(!RTIMER_CLOCK_LT(q->time, start + RTIMER_MULTIPLEX_GUARD)) {
+        /* This one and all next ones are far enough */
+        q = NULL;
+        break;
+      }
+      if(q->priority > t->priority) {
+        break;
+      }
+    }
+    if(q == NULL) {
+      return t;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+int
+rtimer_set(struct rtimer *rtimer, rtimer_clock_t time,
+	   rtimer_clock_t duration,
+	   rtimer_callback_t func, void *ptr)
+{
+  /* Called from a task, rtimer_run_next holds the queue */
+  uint8_t nested = locked;
+
+  PRINTF("rtimer_set time %d\n", time);
+
+  locked = 1;
+  queue_remove(rtimer);
+  rtimer->func = func;
+  rtimer->ptr = ptr;
+  rtimer->time = time;
+  queue_insert(rtimer);
+  if(!nested) {
+    locked = 0;
+    rtimer_run_next();
+  }
+  return RTIMER_OK;
+}
+/*---------------------------------------------------------------------------*/
+int
+rtimer_cancel(struct rtimer *rtimer)
+{
+  uint8_t nested = locked;
+  int r;
+
+  locked = 1;
+  r = queue_remove(rtimer);
+  if(!nested) {
+    locked = 0;
+    rtimer_run_next();
+  }
+  return r;
+}
+/*---------------------------------------------------------------------------*/
+void
+rtimer_run_next(void)
+{
+  struct rtimer *t;
+  rtimer_clock_t now;
+  rtimer_clock_t start;
+  rtimer_clock_t duration;
+
+  if(locked) {
+    /* Interrupted rtimer_set, which runs the tasks once done */
+    run_requested = 1;
+    return;
+  }
+  do {
+    locked = 1;
+    run_requested = 0;
+    while((t = first_runnable(now = RTIMER_NOW())) != NULL) {
+      if(RTIMER_CLOCK_LT(now + RTIMER_MULTIPLEX_SPIN, t->time)) {
+        rtimer_arch_schedule(t->time);
+        break;
+      }
+      if(t != queue && !RTIMER_CLOCK_LT(now, queue->time)) {
+        stats.deferred++;
+      }
+      while(RTIMER_CLOCK_LT(RTIMER_NOW(), t->time));
+      queue_remove(t);
+      start = RTIMER_NOW();
+      t->func(t, t->ptr);
+      if(t->priority < RTIMER_PRIORITY_HIGH) {
+        duration = RTIMER_NOW() - start;
+        if(duration > stats.max_low_duration) {
+          stats.max_low_duration = duration;
+        }
+        if(duration > RTIMER_MULTIPLEX_GUARD) {
+          stats.overruns++;
+        }
+      }
+    }
+    locked = 0;
+    /* An interrupt may have come after the last task */
+  } while(run_requested);
+}
+/*---------------------------------------------------------------------------*/
+const struct rtimer_multiplex_stats *
+rtimer_multiplex_stats(void)
+{
+  return &stats;
+}
+#else /* RTIMER_MULTIPLEX */
 /*---------------------------------------------------------------------------*/
 int
 rtimer_set(struct rtimer *rtimer, rtimer_clock_t time,
@@ -103,6 +259,7 @@ rtimer_run_next(void)
   }
   return;
 }
+#endif /* RTIMER_MULTIPLEX */
 /*---------------------------------------------------------------------------*/
 
 /** @}*/
@@ -62,6 +62,34 @@ typedef unsigned short rtimer_clock_t;
 
 #include "rtimer-arch.h"
 
+/* With the multiplexer, any number of tasks can be pending at a time,
+ * in a queue sorted by time. A task runs only if no task of higher
+ * priority is due within RTIMER_MULTIPLEX_GUARD, which must thus be the
+ * longest run time of a task of lower priority (TSCH has the highest) */
+#ifdef RTIMER_CONF_MULTIPLEX
+#define RTIMER_MULTIPLEX RTIMER_CONF_MULTIPLEX
+#else
+#define RTIMER_MULTIPLEX 0
+#endif
+
+#ifdef RTIMER_CONF_MULTIPLEX_GUARD
+#define RTIMER_MULTIPLEX_GUARD RTIMER_CONF_MULTIPLEX_GUARD
+#else
+#define RTIMER_MULTIPLEX_GUARD (RTIMER_ARCH_SECOND / 1000)
+#endif
+
+/* A task due within this many ticks is busy-waited for rather than
+ * scheduled, as the hardware may miss a compare value that close */
+#ifdef RTIMER_CONF_MULTIPLEX_SPIN
+#define RTIMER_MULTIPLEX_SPIN RTIMER_CONF_MULTIPLEX_SPIN
+#else
+#define RTIMER_MULTIPLEX_SPIN 2
+#endif
+
+/* Task priorities. Tasks are zero-initialized to the lowest */
+#define RTIMER_PRIORITY_LOW 0
+#define RTIMER_PRIORITY_HIGH 1
+
 /**
  * \brief      Initialize the real-time scheduler.
  *
@@ -85,7 +113,23 @@ struct rtimer {
   rtimer_clock_t time;
   rtimer_callback_t func;
   void *ptr;
+#if RTIMER_MULTIPLEX
+  struct rtimer *next;
+  uint8_t priority;
+#endif /* RTIMER_MULTIPLEX */
+};
+
+#if RTIMER_MULTIPLEX
+/* Statistics of the multiplexer */
+struct rtimer_multiplex_stats {
+  /* Runs of a task put off for a task of higher priority */
+  uint32_t deferred;
+  /* Runs of a task of low priority longer than RTIMER_MULTIPLEX_GUARD */
+  uint32_t overruns;
+  /* Longest run of a task of low priority */
+  rtimer_clock_t max_low_duration;
 };
+#endif /* RTIMER_MULTIPLEX */
 
 enum {
   RTIMER_OK,
@@ -107,10 +151,29 @@ enum {
  *             This function schedules a real-time task at a specified
  *             time in the future.
  *
+ *             With the multiplexer, a pending task is rescheduled, and
+ *             a task due by now runs before this function returns. It
+ *             must be called from a process or from a task, not from
+ *             other interrupts.
+ *
  */
 int rtimer_set(struct rtimer *task, rtimer_clock_t time,
 	       rtimer_clock_t duration, rtimer_callback_t func, void *ptr);
 
+#if RTIMER_MULTIPLEX
+/**
+ * \brief      Remove a pending real-time task
+ * \param task The task
+ * \return     Non-zero (true) if the task was pending, zero otherwise
+ */
+int rtimer_cancel(struct rtimer *task);
+
+/**
+ * \brief      Get the statistics of the multiplexer
+ */
+const struct rtimer_multiplex_stats *rtimer_multiplex_stats(void);
+#endif /* RTIMER_MULTIPLEX */
+
 /**
  * \brief      Execute the next real-time task and schedule the next task, if any
  *
@@ -145,6 +208,22 @@ void rtimer_run_next(void);
  */
 #define RTIMER_TIME(task) ((task)->time)
 
+/**
+ * \brief      Set the priority of a task
+ * \param task The task
+ * \param p    The priority, e.g. RTIMER_PRIORITY_HIGH
+ *
+ *             Set before rtimer_set(). Without the multiplexer, a
+ *             single task is pending at a time and this does nothing.
+ *
+ * \hideinitializer
+ */
+#if RTIMER_MULTIPLEX
+#define RTIMER_SET_PRIORITY(task, p) ((task)->priority = (p))
+#else
+#define RTIMER_SET_PRIORITY(task, p)
+#endif
+
 void rtimer_arch_init(void);
 void rtimer_arch_schedule(rtimer_clock_t t);
 /*rtimer_clock_t rtimer_arch_now(void);*/
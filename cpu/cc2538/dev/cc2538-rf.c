@@ -91,6 +91,13 @@
 
 /* 192 usec off -> on interval (RX Callib -> SFD Wait). We wait a bit more */
 #define ONOFF_TIME                    RTIMER_ARCH_SECOND / 3125
+
+/* ISTXON to start of frame: 192 usec turnaround, preamble and SFD */
+#ifdef CC2538_RF_CONF_DELAY_BEFORE_TX
+#define DELAY_BEFORE_TX CC2538_RF_CONF_DELAY_BEFORE_TX
+#else
+#define DELAY_BEFORE_TX ((rtimer_clock_t)(352UL * RTIMER_ARCH_SECOND / 1000000UL))
+#endif
 /*---------------------------------------------------------------------------*/
 /* Sniffer configuration */
 #ifndef CC2538_RF_CONF_SNIFFER_USB
@@ -123,6 +130,12 @@ static const uint8_t magic[] = { 0x53, 0x6E, 0x69, 0x66 };      /** Snif */
 /*---------------------------------------------------------------------------*/
 static uint8_t rf_flags;
 
+/* Set through RADIO_PARAM_TX_START_TIME, for the next transmission */
+static uint8_t timed_tx;
+static rtimer_clock_t timed_tx_start;
+/* RADIO_PARAM_TX_MODE */
+static uint8_t tx_mode = RADIO_TX_MODE_SEND_ON_CCA;
+
 static int on(void);
 static int off(void);
 /*---------------------------------------------------------------------------*/
@@ -558,7 +571,12 @@ transmit(unsigned short transmit_len)
     while(RTIMER_CLOCK_LT(RTIMER_NOW(), t0 + ONOFF_TIME));
   }
 
-  if(channel_clear() == CC2538_RF_CCA_BUSY) {
+  if(timed_tx) {
+    /* At the start time, without CCA */
+    timed_tx = 0;
+    while(RTIMER_CLOCK_LT(RTIMER_NOW(), timed_tx_start - DELAY_BEFORE_TX));
+  } else if((tx_mode & RADIO_TX_MODE_SEND_ON_CCA)
+            && channel_clear() == CC2538_RF_CCA_BUSY) {
     RIMESTATS_ADD(contentiondrop);
     return RADIO_TX_COLLISION;
   }
@@ -589,8 +607,11 @@ transmit(unsigned short transmit_len)
     CC2538_RF_CSP_ISFLUSHTX();
     ret = RADIO_TX_ERR;
   } else {
-    /* Wait for the transmission to finish */
-    while(REG(RFCORE_XREG_FSMSTAT1) & RFCORE_XREG_FSMSTAT1_TX_ACTIVE);
+    /* Wait for the transmission to finish, unless in no-wait mode. off()
+     * waits for it in any case */
+    if(!(tx_mode & RADIO_TX_MODE_NO_WAIT)) {
+      while(REG(RFCORE_XREG_FSMSTAT1) & RFCORE_XREG_FSMSTAT1_TX_ACTIVE);
+    }
     ret = RADIO_TX_OK;
   }
   ENERGEST_OFF(ENERGEST_TYPE_TRANSMIT);
@@ -785,6 +806,9 @@ get_value(radio_param_t param, radio_value_t *value)
       *value |= RADIO_RX_MODE_AUTOACK;
     }
     return RADIO_RESULT_OK;
+  case RADIO_PARAM_TX_MODE:
+    *value = tx_mode;
+    return RADIO_RESULT_OK;
   case RADIO_PARAM_TXPOWER:
     *value = get_tx_power();
     return RADIO_RESULT_OK;
@@ -849,6 +873,12 @@ set_value(radio_param_t param, radio_value_t value)
     set_frame_filtering((value & RADIO_RX_MODE_ADDRESS_FILTER) != 0);
     set_auto_ack((value & RADIO_RX_MODE_AUTOACK) != 0);
 
+    return RADIO_RESULT_OK;
+  case RADIO_PARAM_TX_MODE:
+    if(value & ~(RADIO_TX_MODE_SEND_ON_CCA | RADIO_TX_MODE_NO_WAIT)) {
+      return RADIO_RESULT_INVALID_VALUE;
+    }
+    tx_mode = value;
     return RADIO_RESULT_OK;
   case RADIO_PARAM_TXPOWER:
     if(value < OUTPUT_POWER_MIN || value > OUTPUT_POWER_MAX) {
@@ -889,8 +919,35 @@ get_object(radio_param_t param, void *dest, size_t size)
 static radio_result_t
 set_object(radio_param_t param, const void *src, size_t size)
 {
+  const struct radio_rx_window *window;
   int i;
 
+  if(param == RADIO_PARAM_TX_START_TIME) {
+    if(size != sizeof(rtimer_clock_t) || !src) {
+      return RADIO_RESULT_INVALID_VALUE;
+    }
+    timed_tx_start = *(const rtimer_clock_t *)src;
+    timed_tx = 1;
+    return RADIO_RESULT_OK;
+  }
+
+  if(param == RADIO_PARAM_RX_WINDOW) {
+    if(size != sizeof(struct radio_rx_window) || !src) {
+      return RADIO_RESULT_INVALID_VALUE;
+    }
+    window = src;
+    while(RTIMER_CLOCK_LT(RTIMER_NOW(), window->start - ONOFF_TIME));
+    on();
+    if(window->duration > 0) {
+      while(!(REG(RFCORE_XREG_FSMSTAT1) & RFCORE_XREG_FSMSTAT1_SFD)
+            && RTIMER_CLOCK_LT(RTIMER_NOW(), window->start + window->duration));
+      if(!receiving_packet() && !pending_packet()) {
+        off();
+      }
+    }
+    return RADIO_RESULT_OK;
+  }
+
   if(param == RADIO_PARAM_64BIT_ADDR) {
     if(size != 8 || !src) {
       return RADIO_RESULT_INVALID_VALUE;
@@ -146,6 +146,15 @@
 #define BAUD2BRD(baud)        DIV_ROUND(UART_CLOCK_RATE << (UART_CTL_HSE_VALUE + 2), (baud))
 #define BAUD2IBRD(baud)       (BAUD2BRD(baud) >> 6)
 #define BAUD2FBRD(baud)       (BAUD2BRD(baud) & 0x3f)
+
+/* RX FIFO level of the RX interrupt. The FIFO is read out in full at every
+ * interrupt, and the RX timeout interrupt catches the bytes left below the
+ * level, so a higher level means fewer interrupts at high baud rates. */
+#ifdef UART_CONF_RX_FIFO_LEVEL
+#define UART_RX_FIFO_LEVEL    UART_CONF_RX_FIFO_LEVEL
+#else
+#define UART_RX_FIFO_LEVEL    UART_IFLS_RXIFLSEL_1_8
+#endif
 /*---------------------------------------------------------------------------*/
 typedef struct {
   int8_t port;
@@ -296,7 +305,7 @@ uart_init(uint8_t uart)
   REG(regs->base | UART_IM) |= UART_IM_OEIM | UART_IM_BEIM | UART_IM_FEIM;
 
   REG(regs->base | UART_IFLS) =
-    UART_IFLS_RXIFLSEL_1_8 | UART_IFLS_TXIFLSEL_1_2;
+    UART_RX_FIFO_LEVEL | UART_IFLS_TXIFLSEL_1_2;
 
   /* Make sure the UART is disabled before trying to configure it */
   REG(regs->base | UART_CTL) = UART_CTL_VALUE;
@@ -51,6 +51,9 @@ ISR(TIMERB1, cc2420_timerb1_interrupt)
   } else {
     cc2420_sfd_counter = 0;
     cc2420_sfd_end_time = TBCCR1;
+#if CC2420_RX_RING
+    cc2420_sfd_frame_end(cc2420_sfd_start_time, cc2420_sfd_end_time);
+#endif /* CC2420_RX_RING */
   }
   ENERGEST_OFF(ENERGEST_TYPE_IRQ);
 }
@@ -43,11 +43,31 @@
 
 #define CLOCK_LT(a, b) ((int16_t)((a)-(b)) < 0)
 
+/* Tickless mode: while the CPU sleeps, the clock interrupt is skipped up
+   to the next etimer expiration, or CLOCK_TICKLESS_MAX_TICKS. The ticks
+   are counted when it fires, and clock_time() adds those not counted yet. */
+#ifdef CLOCK_CONF_TICKLESS
+#define CLOCK_TICKLESS CLOCK_CONF_TICKLESS
+#else
+#define CLOCK_TICKLESS 0
+#endif
+
+/* Must stay below half the timer range, for CLOCK_LT */
+#ifdef CLOCK_CONF_TICKLESS_MAX_TICKS
+#define CLOCK_TICKLESS_MAX_TICKS CLOCK_CONF_TICKLESS_MAX_TICKS
+#else
+#define CLOCK_TICKLESS_MAX_TICKS (CLOCK_SECOND / 2)
+#endif
+
 static volatile unsigned long seconds;
 
 static volatile clock_time_t count = 0;
 /* last_tar is used for calculating clock_fine */
 static volatile uint16_t last_tar = 0;
+#if CLOCK_TICKLESS
+/* Timer value of the next tick to count */
+static volatile uint16_t next_tick = INTERVAL;
+#endif /* CLOCK_TICKLESS */
 /*---------------------------------------------------------------------------*/
 static inline uint16_t
 read_tar(void)
@@ -74,10 +94,18 @@ ISR(TIMERA1, timera1)
     while(TACTL & MC1 && TACCR1 - read_tar() == 1);
 
     last_tar = read_tar();
+#if CLOCK_TICKLESS
+    /* Count all ticks since the last interrupt */
+    while(!CLOCK_LT(last_tar, next_tick)) {
+      next_tick += INTERVAL;
+      TACCR1 = next_tick;
+      ++count;
+#else /* CLOCK_TICKLESS */
     /* Make sure interrupt time is future */
     while(!CLOCK_LT(last_tar, TACCR1)) {
       TACCR1 += INTERVAL;
       ++count;
+#endif /* CLOCK_TICKLESS */
 
       /* Make sure the CLOCK_CONF_SECOND is a power of two, to ensure
 	 that the modulo operation below becomes a logical and and not
@@ -99,6 +127,12 @@ ISR(TIMERA1, timera1)
       etimer_request_poll();
       LPM4_EXIT;
     }
+#if CLOCK_TICKLESS
+    else if(process_nevents() == 0) {
+      /* Back to sleep: skip ticks again */
+      clock_tickless_idle();
+    }
+#endif /* CLOCK_TICKLESS */
 
   }
   /*  if(process_nevents() >= 0) {
@@ -113,19 +147,52 @@ ISR(TIMERA1, timera1)
 clock_time_t
 clock_time(void)
 {
+#if CLOCK_TICKLESS
+  clock_time_t t;
+  int s = splhigh();
+  /* Add the ticks elapsed since the interrupt was last skipped */
+  t = count + (uint16_t)(read_tar() - (next_tick - INTERVAL)) / INTERVAL;
+  splx(s);
+  return t;
+#else /* CLOCK_TICKLESS */
   clock_time_t t1, t2;
   do {
     t1 = count;
     t2 = count;
   } while(t1 != t2);
   return t1;
+#endif /* CLOCK_TICKLESS */
+}
+/*---------------------------------------------------------------------------*/
+#if CLOCK_TICKLESS
+/* Called with interrupts disabled, before sleeping: set the next clock
+   interrupt to the tick where the next etimer expires */
+void
+clock_tickless_idle(void)
+{
+  clock_time_t ticks = CLOCK_TICKLESS_MAX_TICKS;
+
+  if(etimer_pending()) {
+    clock_time_t left = etimer_next_expiration_time() - count;
+    if((clock_time_t)(left - 1) > MAX_TICKS) {
+      /* Expired already */
+      ticks = 1;
+    } else if(left < ticks) {
+      ticks = left;
+    }
+  }
+  TACCR1 = next_tick + (ticks - 1) * INTERVAL;
 }
+#endif /* CLOCK_TICKLESS */
 /*---------------------------------------------------------------------------*/
 void
 clock_set(clock_time_t clock, clock_time_t fclock)
 {
   TAR = fclock;
   TACCR1 = fclock + INTERVAL;
+#if CLOCK_TICKLESS
+  next_tick = TACCR1;
+#endif /* CLOCK_TICKLESS */
   count = clock;
 }
 /*---------------------------------------------------------------------------*/
@@ -142,7 +209,13 @@ clock_fine(void)
   /* Assign last_tar to local varible that can not be changed by interrupt */
   t = last_tar;
   /* perform calc based on t, TAR will not be changed during interrupt */
+#if CLOCK_TICKLESS
+  /* The interrupt may have been skipped: count from the last tick */
+  (void)t;
+  return (unsigned short) (TAR - (next_tick - INTERVAL)) % INTERVAL;
+#else /* CLOCK_TICKLESS */
   return (unsigned short) (TAR - t);
+#endif /* CLOCK_TICKLESS */
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -173,6 +246,9 @@ clock_init(void)
 
   /* Interrupt after X ms. */
   TACCR1 = INTERVAL;
+#if CLOCK_TICKLESS
+  next_tick = INTERVAL;
+#endif /* CLOCK_TICKLESS */
 
   /* Start Timer_A in continuous mode. */
   TACTL |= MC1;
@@ -36,6 +36,7 @@
  */
 
 #include "net/ip/uip.h"
+#include <stdint.h>
 
 #define asmv(arg) __asm__ __volatile__(arg)
 /*---------------------------------------------------------------------------*/
@@ -74,3 +75,81 @@ uip_ipchksum(void)
 #endif
 #endif
 /*---------------------------------------------------------------------------*/
+#ifdef UIP_ARCH_CHKSUM_ADD
+/* One's complement sum of data added to sum, both in host byte order, for
+ * the uip6 checksums. Words are read little-endian, which sums the
+ * byte-swapped data: sum is swapped on the way in and out. The carry is
+ * propagated with addc along four words at a time */
+uint16_t
+uip_arch_chksum_add(uint16_t sum, const uint8_t *data, uint16_t len)
+{
+  register uint16_t acc;
+  const uint16_t *p;
+  uint16_t words;
+  uint16_t t;
+
+  if((uintptr_t)data & 1) {
+    /* Word accesses must be aligned: bytewise sum */
+    while(len > 1) {
+      t = (data[0] << 8) + data[1];
+      sum += t;
+      if(sum < t) {
+        sum++;
+      }
+      data += 2;
+      len -= 2;
+    }
+    if(len == 1) {
+      t = data[0] << 8;
+      sum += t;
+      if(sum < t) {
+        sum++;
+      }
+    }
+    return sum;
+  }
+
+  acc = (sum << 8) | (sum >> 8);
+  p = (const uint16_t *)data;
+  words = len >> 1;
+
+#ifdef __IAR_SYSTEMS_ICC__
+  while(words > 0) {
+    acc += *p;
+    if(acc < *p) {
+      acc++;
+    }
+    p++;
+    words--;
+  }
+#else
+  while(words >= 4) {
+    asmv("add  @%[p]+, %[acc]\n\t"
+         "addc @%[p]+, %[acc]\n\t"
+         "addc @%[p]+, %[acc]\n\t"
+         "addc @%[p]+, %[acc]\n\t"
+         "addc #0, %[acc]"
+         : [acc] "+r" (acc), [p] "+r" (p) : : "memory");
+    words -= 4;
+  }
+  while(words > 0) {
+    asmv("add  @%[p]+, %[acc]\n\t"
+         "addc #0, %[acc]"
+         : [acc] "+r" (acc), [p] "+r" (p) : : "memory");
+    words--;
+  }
+#endif
+
+  if(len & 1) {
+    /* The last byte is the high byte of a zero-padded word */
+    t = *(const uint8_t *)p;
+    acc += t;
+    if(acc < t) {
+      acc++;
+    }
+  }
+
+  return (acc << 8) | (acc >> 8);
+}
+#endif /* UIP_ARCH_CHKSUM_ADD */
+/*---------------------------------------------------------------------------*/
@@ -45,6 +45,9 @@
 
 #include "sys/rtimer.h"
 #include "sys/clock.h"
+#if NATIVE_CONF_SIM
+#include "sim.h"
+#endif /* NATIVE_CONF_SIM */
 
 #define DEBUG 0
 #if DEBUG
@@ -54,6 +57,20 @@
 #define PRINTF(...)
 #endif
 
+/*---------------------------------------------------------------------------*/
+#if NATIVE_CONF_SIM
+/* The rtimer is run by the simulation, in virtual time */
+void
+rtimer_arch_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+rtimer_arch_schedule(rtimer_clock_t t)
+{
+  sim_rtimer_schedule(t);
+}
+#else /* NATIVE_CONF_SIM */
 /*---------------------------------------------------------------------------*/
 static void
 interrupt(int sig)
@@ -89,4 +106,5 @@ rtimer_arch_schedule(rtimer_clock_t t)
   setitimer(ITIMER_REAL, &val, NULL);
 #endif /* !_WIN32 */
 }
+#endif /* NATIVE_CONF_SIM */
 /*---------------------------------------------------------------------------*/
@@ -42,8 +42,18 @@
 
 #include "contiki-conf.h"
 
+#if NATIVE_CONF_SIM
+/* Virtual time of the native simulation, at the rate of sky/z1 */
+#include "sim-msg.h"
+
+#define RTIMER_ARCH_SECOND SIM_SECOND
+
+rtimer_clock_t sim_rtimer_now(void);
+#define rtimer_arch_now() sim_rtimer_now()
+#else /* NATIVE_CONF_SIM */
 #define RTIMER_ARCH_SECOND CLOCK_CONF_SECOND
 
 #define rtimer_arch_now() clock_time()
+#endif /* NATIVE_CONF_SIM */
 
 #endif /* RTIMER_ARCH_H_ */
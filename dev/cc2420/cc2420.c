@@ -49,6 +49,7 @@
 #include "net/packetbuf.h"
 #include "net/rime/rimestats.h"
 #include "net/netstack.h"
+#include "lib/ringbufindex.h"
 
 /* CC2420 MAX PACKET DURATION in RTIMER ticks */
 #define CC2420_MAX_PACKET_DURATION 148
@@ -76,6 +77,21 @@
 #define CC2420_CONF_ADR_DECODE 1
 #endif /* CC2420_CONF_ADR_DECODE */
 
+/* Time from STXON to the start of the frame: 12 symbols of turnaround,
+ * the preamble and the SFD. Used by RADIO_PARAM_TX_START_TIME */
+#ifdef CC2420_CONF_DELAY_BEFORE_TX
+#define CC2420_DELAY_BEFORE_TX CC2420_CONF_DELAY_BEFORE_TX
+#else
+#define CC2420_DELAY_BEFORE_TX ((rtimer_clock_t)(352UL * RTIMER_SECOND / 1000000UL))
+#endif
+
+/* Time from SRXON to listening: 12 symbols. Used by RADIO_PARAM_RX_WINDOW */
+#ifdef CC2420_CONF_DELAY_BEFORE_RX
+#define CC2420_DELAY_BEFORE_RX CC2420_CONF_DELAY_BEFORE_RX
+#else
+#define CC2420_DELAY_BEFORE_RX ((rtimer_clock_t)(192UL * RTIMER_SECOND / 1000000UL))
+#endif
+
 #define CHECKSUM_LEN        2
 #define FOOTER_LEN          2
 #define FOOTER1_CRC_OK      0x80
@@ -155,6 +171,41 @@ volatile uint16_t cc2420_sfd_start_time;
 volatile uint16_t cc2420_sfd_end_time;
 
 static volatile uint16_t last_packet_timestamp;
+
+#if CC2420_RX_RING
+/* Frames drained from the RX FIFO, with their footer */
+struct rx_frame {
+  uint8_t len;
+  int8_t rssi;
+  uint8_t correlation;
+  uint16_t sfd;
+  uint8_t data[CC2420_MAX_PACKET_LEN - FOOTER_LEN];
+};
+static struct rx_frame rx_frames[CC2420_RX_RING];
+static struct ringbufindex rx_ring;
+
+/* The last SFD pulses, in timer B ticks. Every frame drained finds its
+ * own from its length, skipping the pulses of frames rejected by
+ * address decoding and of our own transmissions */
+#define SFD_QUEUE_LEN 8
+struct sfd_pulse {
+  uint16_t start;
+  uint16_t duration;
+};
+static struct sfd_pulse sfd_queue[SFD_QUEUE_LEN];
+static volatile uint8_t sfd_put, sfd_get;
+/* End of the SFD pulse of the last frame we sent */
+static uint16_t tx_sfd_end;
+static uint16_t last_frame_sfd;
+#else /* CC2420_RX_RING */
+/* Max number of bytes of RADIO_PARAM_RX_HEADER, length byte included */
+#define RX_HEADER_MAX_LEN 24
+/* Bytes of the frame being received already popped from the RXFIFO by
+ * RADIO_PARAM_RX_HEADER, the length byte first. cc2420_read() starts
+ * with them, flushrx() discards them */
+static uint8_t rx_header[RX_HEADER_MAX_LEN];
+static uint8_t rx_header_len;
+#endif /* CC2420_RX_RING */
 /*---------------------------------------------------------------------------*/
 PROCESS(cc2420_process, "CC2420 driver");
 /*---------------------------------------------------------------------------*/
@@ -185,6 +236,7 @@ int cc2420_on(void);
 int cc2420_off(void);
 
 static int cc2420_read(void *buf, unsigned short bufsize);
+static void getrxdata(uint8_t *buffer, int count);
 
 static int cc2420_prepare(const void *data, unsigned short len);
 static int cc2420_transmit(unsigned short len);
@@ -200,6 +252,10 @@ uint8_t cc2420_last_correlation;
 static uint8_t receive_on;
 static int channel;
 
+/* Set through RADIO_PARAM_TX_START_TIME, for the next transmission */
+static uint8_t timed_tx;
+static rtimer_clock_t timed_tx_start;
+
 /* A flag to enable or disable FIFOP interrupt */
 static uint8_t volatile interrupt_enabled = 1;
 static uint8_t volatile address_decoding_enabled = CC2420_CONF_ADR_DECODE;
@@ -293,12 +349,59 @@ set_value(radio_param_t param, radio_value_t value)
 static radio_result_t
 get_object(radio_param_t param, void *dest, size_t size)
 {
+#if !CC2420_RX_RING
+  if(param == RADIO_PARAM_RX_HEADER) {
+    if(size == 0 || size > RX_HEADER_MAX_LEN || !dest) {
+      return RADIO_RESULT_INVALID_VALUE;
+    }
+    /* Pop what is in the RXFIFO, up to the footer of the frame */
+    while(rx_header_len < size && CC2420_FIFO_IS_1) {
+      if(rx_header_len > 0 && (rx_header[0] > CC2420_MAX_PACKET_LEN
+                               || rx_header_len >= rx_header[0] + 1 - FOOTER_LEN)) {
+        break;
+      }
+      getrxdata(&rx_header[rx_header_len], 1);
+      rx_header_len++;
+    }
+    if(rx_header_len < size) {
+      return RADIO_RESULT_ERROR;
+    }
+    memcpy(dest, rx_header, size);
+    return RADIO_RESULT_OK;
+  }
+#endif /* !CC2420_RX_RING */
   return RADIO_RESULT_NOT_SUPPORTED;
 }
 
 static radio_result_t
 set_object(radio_param_t param, const void *src, size_t size)
 {
+  const struct radio_rx_window *window;
+
+  if(param == RADIO_PARAM_TX_START_TIME) {
+    if(size != sizeof(rtimer_clock_t) || !src) {
+      return RADIO_RESULT_INVALID_VALUE;
+    }
+    timed_tx_start = *(const rtimer_clock_t *)src;
+    timed_tx = 1;
+    return RADIO_RESULT_OK;
+  }
+  if(param == RADIO_PARAM_RX_WINDOW) {
+    if(size != sizeof(struct radio_rx_window) || !src) {
+      return RADIO_RESULT_INVALID_VALUE;
+    }
+    window = src;
+    while(RTIMER_CLOCK_LT(RTIMER_NOW(), window->start - CC2420_DELAY_BEFORE_RX));
+    cc2420_on();
+    if(window->duration > 0) {
+      while(!CC2420_SFD_IS_1
+            && RTIMER_CLOCK_LT(RTIMER_NOW(), window->start + window->duration));
+      if(!CC2420_SFD_IS_1 && !CC2420_FIFOP_IS_1) {
+        cc2420_off();
+      }
+    }
+    return RADIO_RESULT_OK;
+  }
   return RADIO_RESULT_NOT_SUPPORTED;
 }
 
@@ -469,6 +572,9 @@ flushrx(void)
   getrxdata(&dummy, 1);
   strobe(CC2420_SFLUSHRX);
   strobe(CC2420_SFLUSHRX);
+#if !CC2420_RX_RING
+  rx_header_len = 0;
+#endif /* !CC2420_RX_RING */
   if(dummy) {
     /* avoid unused variable compiler warning */
   }
@@ -578,9 +684,33 @@ encrypt(uint8_t *plaintext_and_result)
   RELEASE_LOCK();
 }
 /*---------------------------------------------------------------------------*/
+/* The stand-alone buffer holds a single block, but the radio lock is taken
+ * once for the whole batch and the next block is loaded right away */
+static void
+encrypt_blocks(uint8_t *plaintexts_and_results, uint8_t count)
+{
+  GET_LOCK();
+  
+  while(count--) {
+    write_ram(plaintexts_and_results,
+        CC2420RAM_SABUF,
+        16,
+        WRITE_RAM_IN_ORDER);
+    
+    strobe(CC2420_SAES);
+    while(get_status() & BV(CC2420_ENC_BUSY));
+    
+    read_ram(plaintexts_and_results, CC2420RAM_SABUF, 16);
+    plaintexts_and_results += 16;
+  }
+  
+  RELEASE_LOCK();
+}
+/*---------------------------------------------------------------------------*/
 const struct aes_128_driver cc2420_aes_128_driver = {
   set_key,
-  encrypt
+  encrypt,
+  encrypt_blocks
 };
 /*---------------------------------------------------------------------------*/
 static void
@@ -680,6 +810,10 @@ cc2420_init(void)
   cc2420_set_interrupt_enable(1);
   cc2420_sfd_sync(1, 1);
 
+#if CC2420_RX_RING
+  ringbufindex_init(&rx_ring, CC2420_RX_RING);
+#endif /* CC2420_RX_RING */
+
   if(interrupt_enabled) {
     CC2420_CLEAR_FIFOP_INT();
   }
@@ -716,13 +850,19 @@ cc2420_transmit(unsigned short payload_len)
 #define LOOP_20_SYMBOLS CC2420_CONF_SYMBOL_LOOP_COUNT
 #endif
 
+  if(timed_tx) {
+    timed_tx = 0;
+    while(RTIMER_CLOCK_LT(RTIMER_NOW(), timed_tx_start - CC2420_DELAY_BEFORE_TX));
+    strobe(CC2420_STXON);
+  } else {
 #if WITH_SEND_CCA
-  strobe(CC2420_SRXON);
-  wait_for_status(BV(CC2420_RSSI_VALID));
-  strobe(CC2420_STXONCCA);
+    strobe(CC2420_SRXON);
+    wait_for_status(BV(CC2420_RSSI_VALID));
+    strobe(CC2420_STXONCCA);
 #else /* WITH_SEND_CCA */
-  strobe(CC2420_STXON);
+    strobe(CC2420_STXON);
 #endif /* WITH_SEND_CCA */
+  }
   for(i = LOOP_20_SYMBOLS; i > 0; i--) {
     if(CC2420_SFD_IS_1) {
       {
@@ -749,6 +889,9 @@ cc2420_transmit(unsigned short payload_len)
       /* We wait until transmission has ended so that we get an
 	 accurate measurement of the transmission time.*/
       wait_for_transmission();
+#if CC2420_RX_RING
+      tx_sfd_end = TBCCR1;
+#endif /* CC2420_RX_RING */
 
 #ifdef ENERGEST_CONF_LEVELDEVICE_LEVELS
       ENERGEST_OFF_LEVEL(ENERGEST_TYPE_TRANSMIT,cc2420_get_txpower());
@@ -916,13 +1059,133 @@ cc2420_set_pan_addr(unsigned pan,
   RELEASE_LOCK();
 }
 /*---------------------------------------------------------------------------*/
+#if CC2420_RX_RING
+void
+cc2420_sfd_frame_end(uint16_t start, uint16_t end)
+{
+  if((uint8_t)(sfd_put - sfd_get) == SFD_QUEUE_LEN) {
+    /* Drop the oldest pulse */
+    sfd_get++;
+  }
+  sfd_queue[sfd_put % SFD_QUEUE_LEN].start = start;
+  sfd_queue[sfd_put % SFD_QUEUE_LEN].duration = end - start;
+  sfd_put++;
+}
+/*---------------------------------------------------------------------------*/
+/* The SFD start of a frame of len bytes (PHY payload), from the queue */
+static uint16_t
+frame_sfd(uint8_t len)
+{
+  /* The SFD pulse lasts for the length byte and the frame, 32 us per
+   * byte, in 32768 Hz ticks */
+  uint16_t expected = (len + 1) + (len + 1) / 21;
+  uint16_t sfd = cc2420_sfd_start_time;
+  struct sfd_pulse *p;
+  uint8_t i;
+  int s;
+
+  s = splhigh();
+  for(i = sfd_get; i != sfd_put; i++) {
+    p = &sfd_queue[i % SFD_QUEUE_LEN];
+    if(p->duration + 2 >= expected && p->duration <= expected + 2
+       && (uint16_t)(p->start + p->duration) != tx_sfd_end) {
+      sfd = p->start;
+      sfd_get = i + 1;
+      break;
+    }
+  }
+  splx(s);
+  return sfd;
+}
+/*---------------------------------------------------------------------------*/
+/* Reads a frame from the RX FIFO, in a single SPI transaction. Returns 1
+ * if it was stored, 0 if dropped, -1 if the FIFO must be flushed */
+static int
+getrxframe(struct rx_frame *f)
+{
+  uint8_t len;
+  uint8_t footer[FOOTER_LEN];
+  uint8_t i;
+
+  CC2420_SPI_ENABLE();
+  SPI_WRITE(CC2420_RXFIFO | 0x40);
+  (void) SPI_RXBUF;
+  SPI_READ(len);
+  if(len > CC2420_MAX_PACKET_LEN || len <= FOOTER_LEN) {
+    CC2420_SPI_DISABLE();
+    if(len > CC2420_MAX_PACKET_LEN) {
+      /* Oops, we must be out of sync. */
+      RIMESTATS_ADD(badsynch);
+    } else {
+      RIMESTATS_ADD(tooshort);
+    }
+    return -1;
+  }
+  for(i = 0; i < len - FOOTER_LEN; i++) {
+    SPI_READ(f->data[i]);
+  }
+  SPI_READ(footer[0]);
+  SPI_READ(footer[1]);
+  clock_delay(1);
+  CC2420_SPI_DISABLE();
+
+  if(!(footer[1] & FOOTER1_CRC_OK)) {
+    RIMESTATS_ADD(badcrc);
+    return 0;
+  }
+  f->len = len - FOOTER_LEN;
+  f->rssi = footer[0];
+  f->correlation = footer[1] & FOOTER1_CORRELATION;
+  f->sfd = frame_sfd(len);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Moves the complete frames of the RX FIFO to the ring. The SPI must
+ * be free */
+static void
+drain_rxfifo(void)
+{
+  int16_t i;
+  int r;
+
+  while(CC2420_FIFOP_IS_1) {
+    if(!CC2420_FIFO_IS_1) {
+      /* Clean up in case of FIFO overflow!  This happens for every
+       * full length frame and is signaled by FIFOP = 1 and FIFO =
+       * 0. */
+      flushrx();
+      return;
+    }
+    i = ringbufindex_peek_put(&rx_ring);
+    if(i == -1) {
+      /* Ring full: leave the frames in the FIFO */
+      return;
+    }
+    r = getrxframe(&rx_frames[i]);
+    if(r < 0) {
+      flushrx();
+      return;
+    }
+    if(r > 0) {
+      ringbufindex_put(&rx_ring);
+    }
+  }
+}
+#endif /* CC2420_RX_RING */
+/*---------------------------------------------------------------------------*/
 /*
- * Interrupt leaves frame intact in FIFO.
+ * Interrupt leaves frame intact in FIFO, unless with the RX ring.
  */
 int
 cc2420_interrupt(void)
 {
   CC2420_CLEAR_FIFOP_INT();
+#if CC2420_RX_RING
+  /* Otherwise the frames are drained by the next cc2420_read() */
+  if(!locked) {
+    drain_rxfifo();
+  }
+#endif /* CC2420_RX_RING */
   process_poll(&cc2420_process);
 
   last_packet_timestamp = cc2420_sfd_start_time;
@@ -942,7 +1205,7 @@ PROCESS_THREAD(cc2420_process, ev, data)
     PRINTF("cc2420_process: calling receiver callback\n");
 
     packetbuf_clear();
-#ifndef WITHOUT_ATTR_TIMESTAMP
+#if !defined(WITHOUT_ATTR_TIMESTAMP) && !CC2420_RX_RING
     packetbuf_set_attr(PACKETBUF_ATTR_TIMESTAMP, last_packet_timestamp);
 #endif /* WITHOUT_ATTR_TIMESTAMP */
     len = cc2420_read(packetbuf_dataptr(), PACKETBUF_SIZE);
@@ -955,11 +1218,67 @@ PROCESS_THREAD(cc2420_process, ev, data)
   PROCESS_END();
 }
 /*---------------------------------------------------------------------------*/
+#if CC2420_RX_RING
+static int
+cc2420_read(void *buf, unsigned short bufsize)
+{
+  struct rx_frame *f;
+  int16_t i;
+  int len;
+
+  GET_LOCK();
+  drain_rxfifo();
+  RELEASE_LOCK();
+
+  i = ringbufindex_peek_get(&rx_ring);
+  if(i == -1) {
+    return 0;
+  }
+  f = &rx_frames[i];
+  len = f->len;
+  if(len > bufsize) {
+    RIMESTATS_ADD(toolong);
+    len = 0;
+  } else {
+    memcpy(buf, f->data, len);
+    radio_last_rssi = cc2420_last_rssi = f->rssi;
+    radio_last_correlation = cc2420_last_correlation = f->correlation;
+    last_frame_sfd = f->sfd;
+
+    if(interrupt_enabled) {
+      /* If interrupt are disabled, this function is possibly called from interrupt
+       * by the MAC or RDC layer. Don't write to packetbuf in interrupt. */
+      packetbuf_set_attr(PACKETBUF_ATTR_RSSI, cc2420_last_rssi-45);
+#ifndef WITHOUT_ATTR_LINK_QUALITY
+      packetbuf_set_attr(PACKETBUF_ATTR_LINK_QUALITY, cc2420_last_correlation);
+#endif /* WITHOUT_ATTR_LINK_QUALITY */
+#ifndef WITHOUT_ATTR_TIMESTAMP
+      packetbuf_set_attr(PACKETBUF_ATTR_TIMESTAMP, last_frame_sfd);
+#endif /* WITHOUT_ATTR_TIMESTAMP */
+    }
+    RIMESTATS_ADD(llrx);
+  }
+  ringbufindex_get(&rx_ring);
+
+  if(interrupt_enabled && pending_packet()) {
+    /* Another packet has been received and needs attention. */
+    process_poll(&cc2420_process);
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+cc2420_read_frame_sfd(void)
+{
+  return last_frame_sfd;
+}
+#else /* CC2420_RX_RING */
 static int
 cc2420_read(void *buf, unsigned short bufsize)
 {
   uint8_t footer[FOOTER_LEN];
   uint8_t len;
+  uint8_t offset;
 
   if(!CC2420_FIFOP_IS_1) {
     return 0;
@@ -967,7 +1286,14 @@ cc2420_read(void *buf, unsigned short bufsize)
   
   GET_LOCK();
 
-  getrxdata(&len, 1);
+  /* Start with the bytes popped through RADIO_PARAM_RX_HEADER, if any */
+  if(rx_header_len > 0) {
+    len = rx_header[0];
+  } else {
+    getrxdata(&len, 1);
+  }
+  offset = rx_header_len > 0 ? rx_header_len - 1 : 0;
+  rx_header_len = 0;
 
   if(len > CC2420_MAX_PACKET_LEN) {
     /* Oops, we must be out of sync. */
@@ -977,7 +1303,8 @@ cc2420_read(void *buf, unsigned short bufsize)
   } else if(len - FOOTER_LEN > bufsize) {
     RIMESTATS_ADD(toolong);
   } else {
-    getrxdata((uint8_t *) buf, len - FOOTER_LEN);
+    memcpy(buf, &rx_header[1], offset);
+    getrxdata((uint8_t *) buf + offset, len - FOOTER_LEN - offset);
     getrxdata(footer, FOOTER_LEN);
     
     if(footer[1] & FOOTER1_CRC_OK) {
@@ -1021,6 +1348,7 @@ cc2420_read(void *buf, unsigned short bufsize)
   RELEASE_LOCK();
   return 0;
 }
+#endif /* CC2420_RX_RING */
 /*---------------------------------------------------------------------------*/
 void
 cc2420_set_txpower(uint8_t power)
@@ -1117,6 +1445,11 @@ cc2420_receiving_packet(void)
 static int
 pending_packet(void)
 {
+#if CC2420_RX_RING
+  if(!ringbufindex_empty(&rx_ring)) {
+    return 1;
+  }
+#endif /* CC2420_RX_RING */
   return CC2420_FIFOP_IS_1;
 }
 /*---------------------------------------------------------------------------*/
@@ -1215,8 +1548,10 @@ cc2420_set_interrupt_enable(uint8_t e)
 		/* Disable FIFOP interrupt */
 		CC2420_CLEAR_FIFOP_INT();
 		CC2420_DISABLE_FIFOP_INT();
+#if !CC2420_RX_RING
 		/* Disable SFD timer capture interrupt */
 		TBCCTL1 &= ~CCIE;
+#endif /* !CC2420_RX_RING */
 	}
 	RELEASE_LOCK();
 }
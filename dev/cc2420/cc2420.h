@@ -113,6 +113,25 @@ void cc2420_set_interrupt_enable(uint8_t e);
 /* Get radio interrupt enable status */
 uint8_t cc2420_get_interrupt_enable(void);
 
+/* Number of frames (a power of two) of the RX ring, 0 to disable it.
+ * With the ring, frames are drained from the RX FIFO by the FIFOP
+ * interrupt as soon as they are complete, in a single SPI transaction
+ * each, and keep their own SFD timestamp, RSSI and LQI until read.
+ * cc2420_read() returns them in order. The SFD capture interrupt is
+ * then left enabled by cc2420_set_interrupt_enable(0). */
+#ifdef CC2420_CONF_RX_RING
+#define CC2420_RX_RING CC2420_CONF_RX_RING
+#else
+#define CC2420_RX_RING 0
+#endif
+
+#if CC2420_RX_RING
+/* Called by the SFD capture interrupt at the end of every frame */
+void cc2420_sfd_frame_end(uint16_t start, uint16_t end);
+/* The SFD start timestamp of the last frame returned by cc2420_read() */
+uint16_t cc2420_read_frame_sfd(void);
+#endif /* CC2420_RX_RING */
+
 /************************************************************************/
 /* Generic names for special functions */
 /************************************************************************/
@@ -121,6 +140,9 @@ uint8_t cc2420_get_interrupt_enable(void);
 #define NETSTACK_RADIO_set_interrupt_enable(E)  cc2420_set_interrupt_enable((E))
 #define NETSTACK_RADIO_sfd_sync(S,E)            cc2420_sfd_sync((S),(E))
 #define NETSTACK_RADIO_read_sfd_timer()         cc2420_read_sfd_timer()
+#if CC2420_RX_RING
+#define NETSTACK_RADIO_read_frame_sfd()         cc2420_read_frame_sfd()
+#endif /* CC2420_RX_RING */
 #define NETSTACK_RADIO_set_channel(C)           cc2420_set_channel((C))
 #define NETSTACK_RADIO_get_channel()            cc2420_get_channel()
 #define NETSTACK_RADIO_radio_raw_rx_on()        cc2420_on();
@@ -3,3 +3,6 @@
 
 #undef NETSTACK_CONF_RDC
 #define NETSTACK_CONF_RDC       nullrdc_driver
+
+/* For the "bench" command */
+#define DB_FEATURE_BULK_INSERT  1
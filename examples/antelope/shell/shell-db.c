@@ -35,15 +35,75 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "contiki.h"
 #include "dev/serial-line.h"
+#include "lib/random.h"
 
 #include "antelope.h"
 
 PROCESS(db_shell, "DB shell");
 AUTOSTART_PROCESSES(&db_shell);
 
+#if DB_FEATURE_BULK_INSERT
+/* "bench <tuples>": measures the insertion rate into a new relation,
+   one tuple at a time and with bulk insertions. */
+static unsigned long
+insert_rate(relation_t *rel, unsigned tuples, int bulk)
+{
+  attribute_value_t values[2];
+  clock_time_t start;
+  unsigned i;
+  db_result_t result;
+
+  values[0].domain = values[1].domain = DOMAIN_INT;
+  start = clock_time();
+  for(i = 0; i < tuples; i++) {
+    VALUE_INT(&values[0]) = i;
+    VALUE_INT(&values[1]) = random_rand();
+    result = bulk ? relation_bulk_insert(rel, values) : relation_insert(rel, values);
+    if(DB_ERROR(result)) {
+      printf("Insertion failed: %s\n", db_get_result_message(result));
+      return 0;
+    }
+  }
+  if(bulk && DB_ERROR(relation_bulk_flush(rel))) {
+    printf("Bulk flush failed\n");
+    return 0;
+  }
+
+  return (unsigned long)tuples * CLOCK_SECOND / (clock_time() - start + 1);
+}
+
+static void
+benchmark(unsigned tuples)
+{
+  relation_t *rel;
+  unsigned long single;
+  unsigned long bulk;
+
+  db_query(NULL, "REMOVE RELATION bench;");
+  db_query(NULL, "CREATE RELATION bench;");
+  db_query(NULL, "CREATE ATTRIBUTE id DOMAIN INT IN bench;");
+  db_query(NULL, "CREATE ATTRIBUTE value DOMAIN INT IN bench;");
+
+  rel = relation_load("bench");
+  if(rel == NULL) {
+    printf("Failed to create the benchmark relation\n");
+    return;
+  }
+  single = insert_rate(rel, tuples, 0);
+  bulk = insert_rate(rel, tuples, 1);
+  relation_release(rel);
+
+  printf("[%u tuples: %lu tuples/s single, %lu tuples/s bulk]\n",
+         tuples, single, bulk);
+  db_query(NULL, "REMOVE RELATION bench;");
+}
+#endif /* DB_FEATURE_BULK_INSERT */
+
 PROCESS_THREAD(db_shell, ev, data)
 {
   static db_handle_t handle;
@@ -58,6 +118,14 @@ PROCESS_THREAD(db_shell, ev, data)
   for(;;) {
     PROCESS_WAIT_EVENT_UNTIL(ev == serial_line_event_message && data != NULL);
 
+#if DB_FEATURE_BULK_INSERT
+    if(strncmp(data, "bench ", 6) == 0) {
+      benchmark(atoi((char *)data + 6));
+      printf("OK\n");
+      continue;
+    }
+#endif /* DB_FEATURE_BULK_INSERT */
+
     result = db_query(&handle, data);
     if(DB_ERROR(result)) {
       printf("Query \"%s\" failed: %s\n",
@@ -72,8 +72,11 @@ border_router_cmd_handler(const uint8_t *data, int len)
       return 1;
     } else if(data[1] == 'M' && command_context == CMD_CONTEXT_RADIO) {
       /* We need to know that this is from the slip-radio here. */
-      PRINTF("Setting MAC address\n");
-      border_router_set_mac(&data[2]);
+      if(slip_radio_input == 0) {
+        /* The other radios take the address of the first one */
+        PRINTF("Setting MAC address\n");
+        border_router_set_mac(&data[2]);
+      }
       return 1;
     } else if(data[1] == 'C' && command_context == CMD_CONTEXT_RADIO) {
       /* We need to know that this is from the slip-radio here. */
@@ -40,6 +40,8 @@
 #include "net/packetbuf.h"
 #include "net/queuebuf.h"
 #include "net/netstack.h"
+#include "net/nbr-table.h"
+#include "net/mac/mac-sequence.h"
 #include "packetutils.h"
 #include "border-router.h"
 #include <string.h>
@@ -62,23 +64,88 @@ struct tx_callback {
   void *ptr;
   struct packetbuf_attr attrs[PACKETBUF_NUM_ATTRS];
   struct packetbuf_addr addrs[PACKETBUF_NUM_ADDRS];
+  /* Radios the packet was sent to and that did not report yet */
+  uint8_t pending;
+  uint8_t status;
+  uint8_t tx;
 };
 
 static struct tx_callback callbacks[MAX_CALLBACKS];
+
+/* With several radios: the radios that heard a neighbor, and the radio
+   unicasts to it go out on */
+struct radio_nbr {
+  uint8_t heard;
+  uint8_t radio;
+};
+NBR_TABLE(struct radio_nbr, radio_nbrs);
+
+/* Packets sent to every radio and not reported yet */
+static uint8_t in_flight[SLIP_DEV_RADIOS];
 /*---------------------------------------------------------------------------*/
 void packet_sent(uint8_t sessionid, uint8_t status, uint8_t tx)
 {
   if(sessionid < MAX_CALLBACKS) {
     struct tx_callback *callback;
+    struct radio_nbr *n;
+    int radio = slip_radio_input;
+
+    if(in_flight[radio] > 0) {
+      in_flight[radio]--;
+    }
     callback = &callbacks[sessionid];
+    if(callback->pending == 0) {
+      PRINTF("br-rdc: late report for session id %d\n", sessionid);
+      return;
+    }
+    if(status == MAC_TX_NOACK && slip_radios() > 1) {
+      /* Let the other radios that heard the neighbor take over */
+      n = nbr_table_get_from_lladdr(radio_nbrs,
+                                    &callback->addrs[PACKETBUF_ADDR_RECEIVER - PACKETBUF_ADDR_FIRST].addr);
+      if(n != NULL) {
+        n->heard &= ~(1 << radio);
+      }
+    }
+    /* A broadcast is reported as sent if one of the radios sent it */
+    if(callback->status != MAC_TX_OK) {
+      callback->status = status;
+      callback->tx = tx;
+    }
+    if(--callback->pending > 0) {
+      return;
+    }
     packetbuf_clear();
     packetbuf_attr_copyfrom(callback->attrs, callback->addrs);
-    mac_call_sent_callback(callback->cback, callback->ptr, status, tx);
+    mac_call_sent_callback(callback->cback, callback->ptr,
+                           callback->status, callback->tx);
   } else {
     PRINTF("*** ERROR: too high session id %d\n", sessionid);
   }
 }
 /*---------------------------------------------------------------------------*/
+/* Of the radios that heard dest, the one with the fewest packets in flight */
+static int
+select_radio(const linkaddr_t *dest)
+{
+  struct radio_nbr *n;
+  int best;
+  int i;
+
+  n = nbr_table_get_from_lladdr(radio_nbrs, dest);
+  if(n == NULL) {
+    return 0;
+  }
+  best = n->radio;
+  for(i = 0; i < slip_radios(); i++) {
+    if((n->heard & (1 << i)) &&
+       (!(n->heard & (1 << best)) || in_flight[i] < in_flight[best])) {
+      best = i;
+    }
+  }
+  n->radio = best;
+  return best;
+}
+/*---------------------------------------------------------------------------*/
 static int
 setup_callback(mac_callback_t sent, void *ptr)
 {
@@ -87,6 +154,9 @@ setup_callback(mac_callback_t sent, void *ptr)
   callback = &callbacks[callback_pos];
   callback->cback = sent;
   callback->ptr = ptr;
+  callback->pending = 0;
+  callback->status = MAC_TX_ERR;
+  callback->tx = 0;
   packetbuf_attr_copyto(callback->attrs, callback->addrs);
 
   callback_pos++;
@@ -104,6 +174,7 @@ send_packet(mac_callback_t sent, void *ptr)
   /* 3 bytes per packet attribute is required for serialization */
   uint8_t buf[PACKETBUF_NUM_ATTRS * 3 + PACKETBUF_SIZE + 3];
   uint8_t sid;
+  int radio;
 
   packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &linkaddr_node_addr);
 
@@ -134,7 +205,20 @@ send_packet(mac_callback_t sent, void *ptr)
       /* Copy packet data */
       memcpy(&buf[3 + size], packetbuf_hdrptr(), packetbuf_totlen());
 
-      write_to_slip(buf, packetbuf_totlen() + size + 3);
+      if(slip_radios() > 1 &&
+         linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &linkaddr_null)) {
+        /* Broadcasts go out on all radios */
+        for(radio = 0; radio < slip_radios(); radio++) {
+          callbacks[sid].pending++;
+          in_flight[radio]++;
+          write_to_slip_radio(radio, buf, packetbuf_totlen() + size + 3);
+        }
+      } else if(slip_radios() > 0) {
+        radio = select_radio(packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+        callbacks[sid].pending = 1;
+        in_flight[radio]++;
+        write_to_slip_radio(radio, buf, packetbuf_totlen() + size + 3);
+      }
     }
   }
 }
@@ -151,11 +235,36 @@ send_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *buf_list)
 static void
 packet_input(void)
 {
+  struct radio_nbr *n;
+  const linkaddr_t *sender;
+
   if(NETSTACK_FRAMER.parse() < 0) {
     PRINTF("br-rdc: failed to parse %u\n", packetbuf_datalen());
-  } else {
-    NETSTACK_MAC.input();
+    return;
+  }
+
+  if(slip_radios() > 1) {
+    sender = packetbuf_addr(PACKETBUF_ADDR_SENDER);
+    n = nbr_table_get_from_lladdr(radio_nbrs, sender);
+    if(n == NULL) {
+      n = nbr_table_add_lladdr(radio_nbrs, sender);
+      if(n != NULL) {
+        n->heard = 0;
+        n->radio = slip_radio_input;
+      }
+    }
+    if(n != NULL) {
+      n->heard |= 1 << slip_radio_input;
+    }
+
+    /* Radios within range of each other deliver the same frames */
+    if(mac_sequence_is_duplicate()) {
+      PRINTF("br-rdc: duplicate from radio %d\n", slip_radio_input);
+      return;
+    }
+    mac_sequence_register_seqno();
   }
+  NETSTACK_MAC.input();
 }
 /*---------------------------------------------------------------------------*/
 static int
@@ -180,6 +289,7 @@ static void
 init(void)
 {
   callback_pos = 0;
+  nbr_table_register(radio_nbrs, NULL);
 }
 /*---------------------------------------------------------------------------*/
 const struct rdc_driver border_router_rdc_driver = {
@@ -242,6 +242,17 @@ request_mac(void)
 void
 border_router_set_mac(const uint8_t *data)
 {
+  uint8_t buf[2 + sizeof(uip_lladdr.addr)];
+  int i;
+
+  /* All radios answer to the same address, as a single root */
+  buf[0] = '!';
+  buf[1] = 'M';
+  memcpy(&buf[2], data, sizeof(uip_lladdr.addr));
+  for(i = 1; i < slip_radios(); i++) {
+    write_to_slip_radio(i, buf, sizeof(buf));
+  }
+
   memcpy(uip_lladdr.addr, data, sizeof(uip_lladdr.addr));
   linkaddr_set_node_addr((linkaddr_t *)uip_lladdr.addr);
 
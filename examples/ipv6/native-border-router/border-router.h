@@ -41,9 +41,24 @@
 #include "net/ip/uip.h"
 #include <stdio.h>
 
+/* Maximum number of slip-radios, at most 8. All radios act as one root: the first
+ * one gives its MAC address to the others, broadcasts go out on every
+ * radio and unicasts on one of the radios that heard the neighbor, the
+ * least busy one */
+#ifdef SLIP_DEV_CONF_RADIOS
+#define SLIP_DEV_RADIOS SLIP_DEV_CONF_RADIOS
+#else
+#define SLIP_DEV_RADIOS 4
+#endif
+
+/* The radio the frame or command being processed comes from */
+extern int slip_radio_input;
+
 int border_router_cmd_handler(const uint8_t *data, int len);
 int slip_config_handle_arguments(int argc, char **argv);
 void write_to_slip(const uint8_t *buf, int len);
+void write_to_slip_radio(int radio, const uint8_t *buf, int len);
+int slip_radios(void);
 
 void border_router_set_prefix_64(const uip_ipaddr_t *prefix_64);
 void border_router_set_mac(const uint8_t *data);
@@ -52,7 +67,7 @@ void border_router_print_stat(void);
 
 void tun_init(void);
 
-int slip_init(void);
+void slip_init(void);
 int slip_set_fd(int maxfd, fd_set *rset, fd_set *wset);
 void slip_handle_fd(fd_set *rset, fd_set *wset);
 
@@ -46,14 +46,19 @@
 #include <sys/ioctl.h>
 #include <err.h>
 #include "contiki.h"
+#include "border-router.h"
 
 int slip_config_verbose = 0;
 const char *slip_config_ipaddr;
 int slip_config_flowcontrol = 0;
 int slip_config_timestamp = 0;
-const char *slip_config_siodev = NULL;
+/* One serial device, or one port with -a, per radio */
+const char *slip_config_siodevs[SLIP_DEV_RADIOS];
 const char *slip_config_host = NULL;
-const char *slip_config_port = NULL;
+const char *slip_config_ports[SLIP_DEV_RADIOS];
+/* Channel of every radio, -1 to keep the radio's own */
+int slip_config_channels[SLIP_DEV_RADIOS];
+int slip_config_radios = 1;
 char slip_config_tundev[32] = { "" };
 uint16_t slip_config_basedelay = 0;
 
@@ -69,11 +74,16 @@ slip_config_handle_arguments(int argc, char **argv)
   const char *prog;
   char c;
   int baudrate = 115200;
+  int siodevs = 0, ports = 0, channels = 0;
+  int i;
 
   slip_config_verbose = 0;
+  for(i = 0; i < SLIP_DEV_RADIOS; i++) {
+    slip_config_channels[i] = -1;
+  }
 
   prog = argv[0];
-  while((c = getopt(argc, argv, "B:H:D:Lhs:t:v::d::a:p:T")) != -1) {
+  while((c = getopt(argc, argv, "B:H:D:Lhs:t:v::d::a:p:c:T")) != -1) {
     switch(c) {
     case 'B':
       baudrate = atoi(optarg);
@@ -88,10 +98,13 @@ slip_config_handle_arguments(int argc, char **argv)
       break;
 
     case 's':
+      if(siodevs == SLIP_DEV_RADIOS) {
+        errx(1, "at most %d radios", SLIP_DEV_RADIOS);
+      }
       if(strncmp("/dev/", optarg, 5) == 0) {
-	slip_config_siodev = optarg + 5;
+	slip_config_siodevs[siodevs++] = optarg + 5;
       } else {
-	slip_config_siodev = optarg;
+	slip_config_siodevs[siodevs++] = optarg;
       }
       break;
 
@@ -108,7 +121,17 @@ slip_config_handle_arguments(int argc, char **argv)
       break;
 
     case 'p':
-      slip_config_port = optarg;
+      if(ports == SLIP_DEV_RADIOS) {
+        errx(1, "at most %d radios", SLIP_DEV_RADIOS);
+      }
+      slip_config_ports[ports++] = optarg;
+      break;
+
+    case 'c':
+      if(channels == SLIP_DEV_RADIOS) {
+        errx(1, "at most %d radios", SLIP_DEV_RADIOS);
+      }
+      slip_config_channels[channels++] = atoi(optarg);
       break;
 
     case 'd':
@@ -137,6 +160,8 @@ fprintf(stderr," -L             Log output format (adds time stamps)\n");
 fprintf(stderr," -s siodev      Serial device (default /dev/ttyUSB0)\n");
 fprintf(stderr," -a host        Connect via TCP to server at <host>\n");
 fprintf(stderr," -p port        Connect via TCP to server at <host>:<port>\n");
+fprintf(stderr,"                -s and -p can be repeated for up to %d radios\n", SLIP_DEV_RADIOS);
+fprintf(stderr," -c channel     Channel of the radio, once per radio in the same order\n");
 fprintf(stderr," -t tundev      Name of interface (default tun0)\n");
 fprintf(stderr," -v[level]      Verbosity level\n");
 fprintf(stderr,"    -v0         No messages\n");
@@ -161,6 +186,12 @@ exit(1);
   }
   slip_config_ipaddr = argv[1];
 
+  if(slip_config_host != NULL) {
+    slip_config_radios = ports > 1 ? ports : 1;
+  } else {
+    slip_config_radios = siodevs > 1 ? siodevs : 1;
+  }
+
   switch(baudrate) {
   case -2:
     break;			/* Use default. */
@@ -54,13 +54,16 @@
 #include "net/netstack.h"
 #include "net/packetbuf.h"
 #include "cmd.h"
+#include "border-router.h"
 #include "border-router-cmds.h"
 
 extern int slip_config_verbose;
 extern int slip_config_flowcontrol;
-extern const char *slip_config_siodev;
+extern const char *slip_config_siodevs[SLIP_DEV_RADIOS];
 extern const char *slip_config_host;
-extern const char *slip_config_port;
+extern const char *slip_config_ports[SLIP_DEV_RADIOS];
+extern int slip_config_channels[SLIP_DEV_RADIOS];
+extern int slip_config_radios;
 extern uint16_t slip_config_basedelay;
 extern speed_t slip_config_b_rate;
 
@@ -72,14 +75,26 @@ extern speed_t slip_config_b_rate;
 
 int devopen(const char *dev, int flags);
 
-static FILE *inslip;
+/* A slip-radio, with its input and output buffers */
+struct slip_radio {
+  int fd;
+  FILE *inslip;
+  unsigned char inbuf[2048];
+  int inbufptr;
+  unsigned char buf[2048];
+  int end, begin, packet_end, packet_count;
+  /* delay between slip packets */
+  struct timer send_delay_timer;
+};
+static struct slip_radio radios[SLIP_DEV_RADIOS];
+static int radio_count;
+/* The radio the frame or command being processed comes from */
+int slip_radio_input;
 
 /* for statistics */
 long slip_sent = 0;
 long slip_received = 0;
 
-int slipfd = 0;
-
 //#define PROGRESS(s) fprintf(stderr, s)
 #define PROGRESS(s) do { } while(0)
 
@@ -173,14 +188,17 @@ slip_packet_input(unsigned char *data, int len)
  * Read from serial, when we have a packet call slip_packet_input. No output
  * buffering, input buffered by stdio.
  */
-void
-serial_input(FILE *inslip)
+static void
+serial_input(struct slip_radio *r)
 {
-  static unsigned char inbuf[2048];
-  static int inbufptr = 0;
+  FILE *inslip = r->inslip;
+  unsigned char *inbuf = r->inbuf;
+  int inbufptr = r->inbufptr;
   int ret,i;
   unsigned char c;
 
+  slip_radio_input = r - radios;
+
 #ifdef linux
   ret = fread(&c, 1, 1, inslip);
   if(ret == -1 || ret == 0) err(1, "serial_input: read");
@@ -188,7 +206,7 @@ serial_input(FILE *inslip)
 #endif
 
  read_more:
-  if(inbufptr >= sizeof(inbuf)) {
+  if(inbufptr >= sizeof(r->inbuf)) {
      fprintf(stderr, "*** dropping large %d byte packet\n", inbufptr);
      inbufptr = 0;
   }
@@ -201,6 +219,7 @@ serial_input(FILE *inslip)
   }
   if(ret == 0) {
     clearerr(inslip);
+    r->inbufptr = inbufptr;
     return;
   }
   slip_received++;
@@ -247,6 +266,7 @@ serial_input(FILE *inslip)
       clearerr(inslip);
       /* Put ESC back and give up! */
       ungetc(SLIP_ESC, inslip);
+      r->inbufptr = inbufptr;
       return;
     }
 
@@ -280,72 +300,68 @@ serial_input(FILE *inslip)
   goto read_more;
 }
 
-unsigned char slip_buf[2048];
-int slip_end, slip_begin, slip_packet_end, slip_packet_count;
-static struct timer send_delay_timer;
 /* delay between slip packets */
 static clock_time_t send_delay = SEND_DELAY;
 /*---------------------------------------------------------------------------*/
 static void
-slip_send(int fd, unsigned char c)
+slip_send(struct slip_radio *r, unsigned char c)
 {
-  if(slip_end >= sizeof(slip_buf)) {
+  if(r->end >= sizeof(r->buf)) {
     err(1, "slip_send overflow");
   }
-  slip_buf[slip_end] = c;
-  slip_end++;
+  r->buf[r->end] = c;
+  r->end++;
   slip_sent++;
   if(c == SLIP_END) {
     /* Full packet received. */
-    slip_packet_count++;
-    if(slip_packet_end == 0) {
-      slip_packet_end = slip_end;
+    r->packet_count++;
+    if(r->packet_end == 0) {
+      r->packet_end = r->end;
     }
   }
 }
 /*---------------------------------------------------------------------------*/
-int
-slip_empty()
+static int
+slip_empty(struct slip_radio *r)
 {
-  return slip_packet_end == 0;
+  return r->packet_end == 0;
 }
 /*---------------------------------------------------------------------------*/
-void
-slip_flushbuf(int fd)
+static void
+slip_flushbuf(struct slip_radio *r)
 {
   int n;
 
-  if(slip_empty()) {
+  if(slip_empty(r)) {
     return;
   }
 
-  n = write(fd, slip_buf + slip_begin, slip_packet_end - slip_begin);
+  n = write(r->fd, r->buf + r->begin, r->packet_end - r->begin);
 
   if(n == -1 && errno != EAGAIN) {
     err(1, "slip_flushbuf write failed");
   } else if(n == -1) {
     PROGRESS("Q");		/* Outqueue is full! */
   } else {
-    slip_begin += n;
-    if(slip_begin == slip_packet_end) {
-      slip_packet_count--;
-      if(slip_end > slip_packet_end) {
-        memcpy(slip_buf, slip_buf + slip_packet_end,
-               slip_end - slip_packet_end);
+    r->begin += n;
+    if(r->begin == r->packet_end) {
+      r->packet_count--;
+      if(r->end > r->packet_end) {
+        memmove(r->buf, r->buf + r->packet_end, r->end - r->packet_end);
       }
-      slip_end -= slip_packet_end;
-      slip_begin = slip_packet_end = 0;
-      if(slip_end > 0) {
+      r->end -= r->packet_end;
+      r->begin = r->packet_end = 0;
+      if(r->end > 0) {
         /* Find end of next slip packet */
-        for(n = 1; n < slip_end; n++) {
-          if(slip_buf[n] == SLIP_END) {
-            slip_packet_end = n + 1;
+        for(n = 1; n < r->end; n++) {
+          if(r->buf[n] == SLIP_END) {
+            r->packet_end = n + 1;
             break;
           }
         }
         /* a delay between slip packets to avoid losing data */
         if(send_delay > 0) {
-          timer_set(&send_delay_timer, send_delay);
+          timer_set(&r->send_delay_timer, send_delay);
         }
       }
     }
@@ -353,7 +369,7 @@ slip_flushbuf(int fd)
 }
 /*---------------------------------------------------------------------------*/
 static void
-write_to_serial(int outfd, const uint8_t *inbuf, int len)
+write_to_serial(struct slip_radio *r, const uint8_t *inbuf, int len)
 {
   const uint8_t *p = inbuf;
   int i;
@@ -383,36 +399,48 @@ write_to_serial(int outfd, const uint8_t *inbuf, int len)
   /* It would be ``nice'' to send a SLIP_END here but it's not
    * really necessary.
    */
-  /* slip_send(outfd, SLIP_END); */
+  /* slip_send(r, SLIP_END); */
 
   for(i = 0; i < len; i++) {
     switch(p[i]) {
     case SLIP_END:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_END);
+      slip_send(r, SLIP_ESC);
+      slip_send(r, SLIP_ESC_END);
       break;
     case SLIP_ESC:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_ESC);
+      slip_send(r, SLIP_ESC);
+      slip_send(r, SLIP_ESC_ESC);
       break;
     default:
-      slip_send(outfd, p[i]);
+      slip_send(r, p[i]);
       break;
     }
   }
-  slip_send(outfd, SLIP_END);
+  slip_send(r, SLIP_END);
   PROGRESS("t");
 }
 /*---------------------------------------------------------------------------*/
-/* writes an 802.15.4 packet to slip-radio */
+/* writes an 802.15.4 packet to the first slip-radio */
 void
 write_to_slip(const uint8_t *buf, int len)
 {
-  if(slipfd > 0) {
-    write_to_serial(slipfd, buf, len);
+  write_to_slip_radio(0, buf, len);
+}
+/*---------------------------------------------------------------------------*/
+void
+write_to_slip_radio(int radio, const uint8_t *buf, int len)
+{
+  if(radio < radio_count && radios[radio].fd > 0) {
+    write_to_serial(&radios[radio], buf, len);
   }
 }
 /*---------------------------------------------------------------------------*/
+int
+slip_radios(void)
+{
+  return radio_count;
+}
+/*---------------------------------------------------------------------------*/
 static void
 stty_telos(int fd)
 {
@@ -462,51 +490,62 @@ stty_telos(int fd)
 static int
 set_fd(fd_set *rset, fd_set *wset)
 {
-  /* Anything to flush? */
-  if(!slip_empty() && (send_delay == 0 || timer_expired(&send_delay_timer))) {
-    FD_SET(slipfd, wset);
-  }
+  int i;
+
+  for(i = 0; i < radio_count; i++) {
+    /* Anything to flush? */
+    if(!slip_empty(&radios[i]) &&
+       (send_delay == 0 || timer_expired(&radios[i].send_delay_timer))) {
+      FD_SET(radios[i].fd, wset);
+    }
 
-  FD_SET(slipfd, rset);	/* Read from slip ASAP! */
+    FD_SET(radios[i].fd, rset);	/* Read from slip ASAP! */
+  }
   return 1;
 }
 /*---------------------------------------------------------------------------*/
 static void
 handle_fd(fd_set *rset, fd_set *wset)
 {
-  if(FD_ISSET(slipfd, rset)) {
-    serial_input(inslip);
-  }
+  int i;
 
-  if(FD_ISSET(slipfd, wset)) {
-    slip_flushbuf(slipfd);
+  for(i = 0; i < radio_count; i++) {
+    if(FD_ISSET(radios[i].fd, rset)) {
+      serial_input(&radios[i]);
+    }
+
+    if(FD_ISSET(radios[i].fd, wset)) {
+      slip_flushbuf(&radios[i]);
+    }
   }
 }
 /*---------------------------------------------------------------------------*/
 static const struct select_callback slip_callback = { set_fd, handle_fd };
 /*---------------------------------------------------------------------------*/
-void
-slip_init(void)
+static int
+open_radio(int radio)
 {
-  setvbuf(stdout, NULL, _IOLBF, 0); /* Line buffered output. */
+  const char *siodev = slip_config_siodevs[radio];
+  const char *port = slip_config_ports[radio];
+  int fd;
 
   if(slip_config_host != NULL) {
-    if(slip_config_port == NULL) {
-      slip_config_port = "60001";
+    if(port == NULL) {
+      port = "60001";
     }
-    slipfd = connect_to_server(slip_config_host, slip_config_port);
-    if(slipfd == -1) {
-      err(1, "can't connect to ``%s:%s''", slip_config_host, slip_config_port);
+    fd = connect_to_server(slip_config_host, port);
+    if(fd == -1) {
+      err(1, "can't connect to ``%s:%s''", slip_config_host, port);
     }
+    fprintf(stderr, "********SLIP opened to ``%s:%s''\n", slip_config_host,
+	    port);
+    return fd;
+  }
 
-  } else if(slip_config_siodev != NULL) {
-    if(strcmp(slip_config_siodev, "null") == 0) {
-      /* Disable slip */
-      return;
-    }
-    slipfd = devopen(slip_config_siodev, O_RDWR | O_NONBLOCK);
-    if(slipfd == -1) {
-      err(1, "can't open siodev ``/dev/%s''", slip_config_siodev);
+  if(siodev != NULL) {
+    fd = devopen(siodev, O_RDWR | O_NONBLOCK);
+    if(fd == -1) {
+      err(1, "can't open siodev ``/dev/%s''", siodev);
     }
 
   } else {
@@ -514,33 +553,63 @@ slip_init(void)
       "ttyUSB0", "cuaU0", "ucom0" /* linux, fbsd6, fbsd5 */
     };
     int i;
+    fd = -1;
     for(i = 0; i < 3; i++) {
-      slip_config_siodev = siodevs[i];
-      slipfd = devopen(slip_config_siodev, O_RDWR | O_NONBLOCK);
-      if(slipfd != -1) {
+      siodev = siodevs[i];
+      fd = devopen(siodev, O_RDWR | O_NONBLOCK);
+      if(fd != -1) {
 	break;
       }
     }
-    if(slipfd == -1) {
+    if(fd == -1) {
       err(1, "can't open siodev");
     }
   }
 
-  select_set_callback(slipfd, &slip_callback);
+  fprintf(stderr, "********SLIP started on ``/dev/%s''\n", siodev);
+  stty_telos(fd);
+  return fd;
+}
+/*---------------------------------------------------------------------------*/
+void
+slip_init(void)
+{
+  struct slip_radio *r;
+  uint8_t cmd[3];
+  int maxfd;
+
+  setvbuf(stdout, NULL, _IOLBF, 0); /* Line buffered output. */
 
-  if(slip_config_host != NULL) {
-    fprintf(stderr, "********SLIP opened to ``%s:%s''\n", slip_config_host,
-	    slip_config_port);
-  } else {
-    fprintf(stderr, "********SLIP started on ``/dev/%s''\n", slip_config_siodev);
-    stty_telos(slipfd);
+  if(slip_config_host == NULL && slip_config_siodevs[0] != NULL &&
+     strcmp(slip_config_siodevs[0], "null") == 0) {
+    /* Disable slip */
+    return;
   }
 
-  timer_set(&send_delay_timer, 0);
-  slip_send(slipfd, SLIP_END);
-  inslip = fdopen(slipfd, "r");
-  if(inslip == NULL) {
-    err(1, "main: fdopen");
+  maxfd = 0;
+  for(radio_count = 0; radio_count < slip_config_radios; radio_count++) {
+    r = &radios[radio_count];
+    r->fd = open_radio(radio_count);
+    if(r->fd > maxfd) {
+      maxfd = r->fd;
+    }
+
+    timer_set(&r->send_delay_timer, 0);
+    slip_send(r, SLIP_END);
+    r->inslip = fdopen(r->fd, "r");
+    if(r->inslip == NULL) {
+      err(1, "main: fdopen");
+    }
+
+    if(slip_config_channels[radio_count] >= 0) {
+      cmd[0] = '!';
+      cmd[1] = 'C';
+      cmd[2] = slip_config_channels[radio_count];
+      write_to_serial(r, cmd, 3);
+    }
   }
+
+  /* The callback serves all radios */
+  select_set_callback(maxfd, &slip_callback);
 }
 /*---------------------------------------------------------------------------*/
@@ -132,6 +132,15 @@ slip_radio_cmd_handler(const uint8_t *data, int len)
 	packet_pos = 0;
       }
 
+      return 1;
+    } else if(data[1] == 'M' && len >= 2 + sizeof(uip_lladdr.addr)) {
+      /* Take the address of the border router, when it has several radios */
+      memcpy(uip_lladdr.addr, &data[2], sizeof(uip_lladdr.addr));
+      linkaddr_set_node_addr((linkaddr_t *)uip_lladdr.addr);
+      /* For radios that filter addresses; not supported by all */
+      NETSTACK_RADIO.set_object(RADIO_PARAM_64BIT_ADDR, &data[2],
+                                sizeof(uip_lladdr.addr));
+      PRINTF("slip-radio: address set\n");
       return 1;
     }
   } else if(uip_buf[0] == '?') {
@@ -34,6 +34,8 @@
  *         (which also must be root or have even node-id). Upon receiving a ping,
  *         nodes answer with a poing.
  *         Can be deployed in the Indriya or Twist testbeds.
+ *         This is a one-shot experiment; for a link map maintained in the
+ *         background of RPL applications, see WITH_LINK_MAP (link-map.h).
  *
  * \author Simon Duquennoy <simonduq@sics.se>
  */
@@ -101,6 +101,9 @@ app_send_to(uint16_t id, int ping, uint32_t seqno)
   data.dest = id;
   data.hop = 0;
   data.ping = ping;
+#if WITH_LOG_LATENCY
+  data.origin_asn = UIP_HTONL(appdata_timestamp());
+#endif /* WITH_LOG_LATENCY */
 
   if(ping) {
     LOGA(&data, "App: sending ping");
@@ -47,7 +47,12 @@
 #include "simple-udp.h"
 #include <stdio.h>
 
+/* The send interval can be set in seconds, e.g. for parameter sweeps */
+#ifdef APP_CONF_SEND_INTERVAL_SECONDS
+#define SEND_INTERVAL   (APP_CONF_SEND_INTERVAL_SECONDS * CLOCK_SECOND)
+#else
 #define SEND_INTERVAL   (60 * CLOCK_SECOND)
+#endif
 #define UDP_PORT 1234
 
 static struct simple_udp_connection unicast_connection;
@@ -111,6 +116,9 @@ app_send_to(uint16_t id, int ping, uint32_t seqno)
   data.dest = id;
   data.hop = 0;
   data.ping = ping;
+#if WITH_LOG_LATENCY
+  data.origin_asn = UIP_HTONL(appdata_timestamp());
+#endif /* WITH_LOG_LATENCY */
 
   if(ping) {
     LOGA(&data, "App: sending ping");
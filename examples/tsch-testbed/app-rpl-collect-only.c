@@ -45,10 +45,16 @@
 #include "net/mac/tsch/tsch-rpl.h"
 #include "deployment.h"
 #include "simple-udp.h"
-#include "tools/orchestra.h"
+#include "net/ipv6/uip-aggr.h"
+#include "orchestra.h"
 #include <stdio.h>
 
+/* The send interval can be set in seconds, e.g. for parameter sweeps */
+#ifdef APP_CONF_SEND_INTERVAL_SECONDS
+#define SEND_INTERVAL   (APP_CONF_SEND_INTERVAL_SECONDS * CLOCK_SECOND)
+#else
 #define SEND_INTERVAL   (60*CLOCK_SECOND)
+#endif
 #define UDP_PORT 1234
 
 static struct simple_udp_connection unicast_connection;
@@ -67,7 +73,34 @@ receiver(struct simple_udp_connection *c,
          uint16_t datalen)
 {
   LOGA((void*)data, "App: received");
+#if RPL_HOP_TIMESTAMPS
+  {
+    uint16_t timestamps[RPL_HOP_TIMESTAMPS + 1];
+    int i;
+    int count = rpl_get_hop_timestamps(timestamps, RPL_HOP_TIMESTAMPS + 1);
+    if(count > 0) {
+      LOG("App: hop timestamps");
+      for(i = 0; i < count; i++) {
+        LOG(" %u", timestamps[i]);
+      }
+      LOG("\n");
+    }
+  }
+#endif /* RPL_HOP_TIMESTAMPS */
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_AGGR
+static void
+aggr_receiver(const uip_ipaddr_t *sender_addr,
+              uint16_t sender_port,
+              uint16_t receiver_port,
+              const uint8_t *data,
+              uint16_t datalen)
+{
+  receiver(&unicast_connection, sender_addr, sender_port,
+           NULL, receiver_port, data, datalen);
 }
+#endif /* UIP_AGGR */
 /*---------------------------------------------------------------------------*/
 int
 can_send_to(uip_ipaddr_t *ipaddr) {
@@ -88,6 +121,9 @@ app_send_to(uint16_t id, uint32_t seqno, unsigned int to_send_cnt)
   data.src = UIP_HTONS(node_id);
   data.dest = UIP_HTONS(id);
   data.hop = 0;
+#if WITH_LOG_LATENCY
+  data.origin_asn = UIP_HTONL(appdata_timestamp());
+#endif /* WITH_LOG_LATENCY */
 
   set_ipaddr_from_id(&dest_ipaddr, id);
 
@@ -120,6 +156,9 @@ PROCESS_THREAD(unicast_sender_process, ev, data)
   }
   simple_udp_register(&unicast_connection, UDP_PORT,
                       NULL, UDP_PORT, receiver);
+#if UIP_AGGR
+  uip_aggr_init(node_id == ROOT_ID ? aggr_receiver : NULL);
+#endif /* UIP_AGGR */
 
 #if WITH_TSCH
 #if WITH_ORCHESTRA
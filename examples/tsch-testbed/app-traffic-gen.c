@@ -0,0 +1,600 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Traffic generator for benchmarking, using RPL.
+ *
+ *         Sends UDP datagrams with a periodic, Poisson, bursty or
+ *         event-triggered pattern, to the root or to a set of nodes.
+ *         Defaults are set with the TG_CONF_* below, and can be changed at
+ *         runtime with commands on the serial line:
+ *
+ *         tg start|stop             start or stop sending
+ *         tg pattern periodic|poisson|bursty|event
+ *         tg interval <ms>          mean interval between packets (bursts)
+ *         tg burst <n> <gap ms>     packets per burst and gap between them
+ *         tg payload <bytes>        UDP payload, appdata included
+ *         tg dest [id ...]          destination set, the root if empty
+ *         tg ramp <s> <%> [min ms]  scale the interval by % every s seconds
+ *         tg event                  send a burst, with the event pattern
+ *         tg conf|stats             print the configuration or a summary
+ *
+ *         Every TG_SUMMARY_PERIOD, prints summary lines starting with "TG:":
+ *         transmissions, receptions with loss (from sequence number gaps),
+ *         throughput and PDR (permil), latency (with WITH_LOG_LATENCY, in
+ *         slots) and duty cycle (permil), all over the last period.
+ */
+
+#include "contiki-conf.h"
+#include "net/netstack.h"
+#include "net/rpl/rpl-private.h"
+#include "net/mac/tsch/tsch-schedule.h"
+#include "net/ip/uip-debug.h"
+#include "lib/random.h"
+#include "dev/serial-line.h"
+#include "sys/energest.h"
+#include "deployment.h"
+#include "simple-udp.h"
+#include "orchestra.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UDP_PORT 1234
+
+/* Traffic patterns */
+#define TG_PERIODIC 0
+#define TG_POISSON  1
+#define TG_BURSTY   2
+#define TG_EVENT    3
+
+#ifdef TG_CONF_PATTERN
+#define TG_PATTERN TG_CONF_PATTERN
+#else
+#define TG_PATTERN TG_PERIODIC
+#endif
+
+/* Mean interval between packets, or bursts, in ms */
+#ifdef TG_CONF_INTERVAL_MS
+#define TG_INTERVAL_MS TG_CONF_INTERVAL_MS
+#else
+#define TG_INTERVAL_MS 60000
+#endif
+
+/* Packets per burst and gap between them, in ms */
+#ifdef TG_CONF_BURST_LEN
+#define TG_BURST_LEN TG_CONF_BURST_LEN
+#else
+#define TG_BURST_LEN 4
+#endif
+
+#ifdef TG_CONF_BURST_GAP_MS
+#define TG_BURST_GAP_MS TG_CONF_BURST_GAP_MS
+#else
+#define TG_BURST_GAP_MS 100
+#endif
+
+/* UDP payload, at least an appdata */
+#ifdef TG_CONF_PAYLOAD
+#define TG_PAYLOAD TG_CONF_PAYLOAD
+#else
+#define TG_PAYLOAD sizeof(struct app_data)
+#endif
+
+#ifdef TG_CONF_MAX_PAYLOAD
+#define TG_MAX_PAYLOAD TG_CONF_MAX_PAYLOAD
+#else
+#define TG_MAX_PAYLOAD 80
+#endif
+
+/* Size of the destination set */
+#ifdef TG_CONF_MAX_DESTS
+#define TG_MAX_DESTS TG_CONF_MAX_DESTS
+#else
+#define TG_MAX_DESTS 8
+#endif
+
+/* Number of sources whose sequence numbers we track to count losses */
+#ifdef TG_CONF_MAX_SOURCES
+#define TG_MAX_SOURCES TG_CONF_MAX_SOURCES
+#else
+#define TG_MAX_SOURCES 16
+#endif
+
+/* Start sending at boot, except at the root */
+#ifdef TG_CONF_AUTOSTART
+#define TG_AUTOSTART TG_CONF_AUTOSTART
+#else
+#define TG_AUTOSTART 1
+#endif
+
+#ifdef TG_CONF_SUMMARY_PERIOD
+#define TG_SUMMARY_PERIOD TG_CONF_SUMMARY_PERIOD
+#else
+#define TG_SUMMARY_PERIOD (60 * CLOCK_SECOND)
+#endif
+
+#define MS_TO_CLOCK(ms) ((clock_time_t)(((uint32_t)(ms) * CLOCK_SECOND) / 1000))
+
+static const char *pattern_names[] = { "periodic", "poisson", "bursty", "event" };
+
+static struct {
+  uint8_t running;
+  uint8_t pattern;
+  uint32_t interval_ms;
+  uint8_t burst_len;
+  uint16_t burst_gap_ms;
+  uint8_t payload;
+  uint16_t dests[TG_MAX_DESTS];
+  uint8_t dests_count;
+  /* Every ramp_period seconds, the interval is scaled by ramp_percent,
+   * without going below ramp_min_ms */
+  uint16_t ramp_period;
+  uint16_t ramp_percent;
+  uint32_t ramp_min_ms;
+} conf = {
+  0, TG_PATTERN, TG_INTERVAL_MS, TG_BURST_LEN, TG_BURST_GAP_MS, TG_PAYLOAD,
+  { 0 }, 0, 0, 100, 0
+};
+
+/* Counters of the current summary period */
+static struct {
+  uint32_t sent;
+  uint32_t failed;
+  uint32_t sent_bytes;
+  uint32_t received;
+  uint32_t received_bytes;
+  uint32_t lost;
+  uint32_t lat_sum;
+  uint32_t lat_min;
+  uint32_t lat_max;
+} stats;
+
+/* Next expected counter (seqno LSBs) per source */
+static struct {
+  uint16_t id;
+  uint16_t next;
+} sources[TG_MAX_SOURCES];
+static uint8_t sources_count;
+
+static struct simple_udp_connection unicast_connection;
+static uint16_t cnt;
+/* Packets left in the current burst */
+static uint8_t burst_left;
+static struct etimer send_timer;
+static struct etimer ramp_timer;
+static struct etimer summary_timer;
+static uint32_t last_radio, last_time;
+
+/*---------------------------------------------------------------------------*/
+PROCESS(traffic_gen_process, "Traffic generator");
+AUTOSTART_PROCESSES(&traffic_gen_process);
+/*---------------------------------------------------------------------------*/
+/* Count the packets lost from a source, from the gaps in its counter */
+static void
+update_losses(uint16_t src, uint16_t counter)
+{
+  int i;
+  for(i = 0; i < sources_count; i++) {
+    if(sources[i].id == src) {
+      break;
+    }
+  }
+  if(i == sources_count) {
+    if(sources_count == TG_MAX_SOURCES) {
+      return;
+    }
+    sources_count++;
+    sources[i].id = src;
+    sources[i].next = counter;
+  }
+  if((int16_t)(counter - sources[i].next) >= 0) {
+    stats.lost += (uint16_t)(counter - sources[i].next);
+    sources[i].next = counter + 1;
+  } else if((uint16_t)(sources[i].next - counter) > 0x100) {
+    /* Far in the past: the source rebooted */
+    sources[i].next = counter + 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+receiver(struct simple_udp_connection *c,
+         const uip_ipaddr_t *sender_addr,
+         uint16_t sender_port,
+         const uip_ipaddr_t *receiver_addr,
+         uint16_t receiver_port,
+         const uint8_t *data,
+         uint16_t datalen)
+{
+  struct app_data *dataptr = appdataptr_from_buffer(data, datalen);
+  struct app_data appdata;
+
+  LOGA(dataptr, "App: received");
+  stats.received++;
+  stats.received_bytes += datalen;
+  if(dataptr == NULL) {
+    return;
+  }
+  appdata_copy(&appdata, dataptr);
+  update_losses(UIP_HTONS(appdata.src), UIP_HTONL(appdata.seqno) & 0xffff);
+#if WITH_LOG_LATENCY
+  {
+    uint32_t lat = appdata_timestamp() - UIP_HTONL(appdata.origin_asn);
+    if(stats.lat_sum == 0 || lat < stats.lat_min) {
+      stats.lat_min = lat;
+    }
+    if(lat > stats.lat_max) {
+      stats.lat_max = lat;
+    }
+    stats.lat_sum += lat;
+  }
+#endif /* WITH_LOG_LATENCY */
+}
+/*---------------------------------------------------------------------------*/
+static int
+can_send_to(uip_ipaddr_t *ipaddr)
+{
+  return uip_ds6_is_addr_onlink(ipaddr)
+      || uip_ds6_route_lookup(ipaddr)
+      || uip_ds6_defrt_choose();
+}
+/*---------------------------------------------------------------------------*/
+static void
+app_send_to(uint16_t id)
+{
+  static uint8_t buf[TG_MAX_PAYLOAD];
+  struct app_data data;
+  uip_ipaddr_t dest_ipaddr;
+  uint8_t len = MAX(conf.payload, sizeof(struct app_data));
+
+  data.magic = UIP_HTONL(LOG_MAGIC);
+  data.seqno = UIP_HTONL(((uint32_t)node_id << 16) + cnt);
+  data.src = UIP_HTONS(node_id);
+  data.dest = UIP_HTONS(id);
+  data.hop = 0;
+  data.ping = 0;
+  data.dummy_for_padding = 0;
+#if WITH_LOG_LATENCY
+  data.origin_asn = UIP_HTONL(appdata_timestamp());
+#endif /* WITH_LOG_LATENCY */
+  cnt++;
+
+  /* The appdata goes at the end, where the logs look for it */
+  memset(buf, 0xa5, len - sizeof(struct app_data));
+  appdata_copy(buf + len - sizeof(struct app_data), &data);
+
+  set_ipaddr_from_id(&dest_ipaddr, id);
+  if(default_instance != NULL && can_send_to(&dest_ipaddr)) {
+    LOGA(&data, "App: sending");
+    simple_udp_sendto(&unicast_connection, buf, len, &dest_ipaddr);
+    stats.sent++;
+    stats.sent_bytes += len;
+  } else {
+    LOGA(&data, "App: could not send");
+    stats.failed++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Send a packet to a random destination of the set */
+static void
+send_one(void)
+{
+  if(conf.dests_count == 0) {
+    app_send_to(ROOT_ID);
+  } else {
+    app_send_to(conf.dests[(random_rand() >> 4) % conf.dests_count]);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Exponentially distributed delay of the given mean: -ln(U) * mean, with
+ * log2 approximated linearly between powers of two */
+static clock_time_t
+poisson_delay(clock_time_t mean)
+{
+  uint16_t r = random_rand() | 1;
+  uint16_t msb = 15;
+  uint32_t log2_q8;
+  uint32_t exp_q8;
+
+  while(!(r & 0x8000)) {
+    r <<= 1;
+    msb--;
+  }
+  /* log2 of the 16-bit random number, in 1/256th */
+  log2_q8 = ((uint32_t)msb << 8) + ((r & 0x7fff) >> 7);
+  /* -ln(r / 65536), ln(2) being 177/256 */
+  exp_q8 = (((16UL << 8) - log2_q8) * 177) >> 8;
+  return (clock_time_t)(((uint32_t)mean * exp_q8) >> 8);
+}
+/*---------------------------------------------------------------------------*/
+/* Set the timer for the next packet of the pattern */
+static void
+schedule_next(void)
+{
+  clock_time_t interval = MS_TO_CLOCK(conf.interval_ms);
+
+  if(burst_left > 0) {
+    etimer_set(&send_timer, MAX(1, MS_TO_CLOCK(conf.burst_gap_ms)));
+    return;
+  }
+  switch(conf.pattern) {
+    case TG_PERIODIC:
+      etimer_set(&send_timer, MAX(1, interval));
+      break;
+    case TG_POISSON:
+      etimer_set(&send_timer, MAX(1, poisson_delay(interval)));
+      break;
+    case TG_BURSTY:
+      /* Bursts start at random times, interval apart on average */
+      etimer_set(&send_timer, 1 + random_rand() % (2 * interval + 1));
+      break;
+    case TG_EVENT:
+      etimer_stop(&send_timer);
+      break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_timer_expired(void)
+{
+  if(!conf.running) {
+    return;
+  }
+  if(burst_left == 0 && (conf.pattern == TG_BURSTY || conf.pattern == TG_EVENT)) {
+    burst_left = conf.burst_len;
+  }
+  send_one();
+  if(burst_left > 0) {
+    burst_left--;
+  }
+  schedule_next();
+}
+/*---------------------------------------------------------------------------*/
+static void
+start(void)
+{
+  conf.running = 1;
+  burst_left = 0;
+  if(conf.pattern != TG_EVENT) {
+    /* Random start, to desynchronize nodes */
+    etimer_set(&send_timer, 1 + random_rand() % (MS_TO_CLOCK(conf.interval_ms) + 1));
+  }
+  if(conf.ramp_period > 0) {
+    etimer_set(&ramp_timer, conf.ramp_period * CLOCK_SECOND);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+ramp(void)
+{
+  uint32_t interval = (conf.interval_ms * conf.ramp_percent) / 100;
+  if(conf.ramp_percent < 100 && interval < conf.ramp_min_ms) {
+    interval = conf.ramp_min_ms;
+  }
+  if(interval > 0 && interval != conf.interval_ms) {
+    conf.interval_ms = interval;
+    LOG("TG: interval %lu ms\n", (unsigned long)conf.interval_ms);
+  }
+  etimer_reset(&ramp_timer);
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_conf(void)
+{
+  int i;
+  LOG("TG: conf %s %s interval %lu burst %u/%u payload %u ramp %u/%u/%lu dest",
+      conf.running ? "running" : "stopped", pattern_names[conf.pattern],
+      (unsigned long)conf.interval_ms, conf.burst_len, conf.burst_gap_ms,
+      MAX(conf.payload, sizeof(struct app_data)),
+      conf.ramp_period, conf.ramp_percent, (unsigned long)conf.ramp_min_ms);
+  if(conf.dests_count == 0) {
+    LOG(" %u", ROOT_ID);
+  }
+  for(i = 0; i < conf.dests_count; i++) {
+    LOG(" %u", conf.dests[i]);
+  }
+  LOG("\n");
+}
+/*---------------------------------------------------------------------------*/
+/* Print the summary of the period and start a new one */
+static void
+print_summary(void)
+{
+  uint32_t radio, time;
+  uint32_t total = stats.received + stats.lost;
+  unsigned long secs = TG_SUMMARY_PERIOD / CLOCK_SECOND;
+
+  energest_flush();
+  radio = energest_type_time(ENERGEST_TYPE_TRANSMIT) + energest_type_time(ENERGEST_TYPE_LISTEN);
+  time = energest_type_time(ENERGEST_TYPE_CPU) + energest_type_time(ENERGEST_TYPE_LPM);
+
+  LOG("TG: tx %lu fail %lu bytes %lu\n",
+      (unsigned long)stats.sent, (unsigned long)stats.failed,
+      (unsigned long)stats.sent_bytes);
+  LOG("TG: rx %lu lost %lu pdr %lu bytes %lu thr %lu B/s\n",
+      (unsigned long)stats.received, (unsigned long)stats.lost,
+      total ? (1000UL * stats.received) / total : 0UL,
+      (unsigned long)stats.received_bytes,
+      secs ? (unsigned long)stats.received_bytes / secs : 0UL);
+#if WITH_LOG_LATENCY
+  LOG("TG: lat min %lu avg %lu max %lu slots\n",
+      (unsigned long)stats.lat_min,
+      stats.received ? (unsigned long)(stats.lat_sum / stats.received) : 0UL,
+      (unsigned long)stats.lat_max);
+#endif /* WITH_LOG_LATENCY */
+  LOG("TG: dc %lu permil\n",
+      time != last_time ? (1000UL * (radio - last_radio)) / (time - last_time) : 0UL);
+
+  last_radio = radio;
+  last_time = time;
+  memset(&stats, 0, sizeof(stats));
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the next space-separated token of *str, NULL if none */
+static char *
+next_token(char **str)
+{
+  char *token;
+  while(**str == ' ') {
+    (*str)++;
+  }
+  if(**str == '\0') {
+    return NULL;
+  }
+  token = *str;
+  while(**str != ' ' && **str != '\0') {
+    (*str)++;
+  }
+  if(**str == ' ') {
+    *(*str)++ = '\0';
+  }
+  return token;
+}
+/*---------------------------------------------------------------------------*/
+static void
+command(char *line)
+{
+  char *cmd;
+  char *arg;
+  int i;
+
+  if(strncmp(line, "tg ", 3) != 0) {
+    return;
+  }
+  line += 3;
+  cmd = next_token(&line);
+  if(cmd == NULL) {
+    return;
+  }
+  arg = next_token(&line);
+
+  if(!strcmp(cmd, "start")) {
+    start();
+  } else if(!strcmp(cmd, "stop")) {
+    conf.running = 0;
+    etimer_stop(&send_timer);
+    etimer_stop(&ramp_timer);
+  } else if(!strcmp(cmd, "pattern") && arg != NULL) {
+    for(i = 0; i <= TG_EVENT; i++) {
+      if(!strcmp(arg, pattern_names[i])) {
+        conf.pattern = i;
+      }
+    }
+    if(conf.running) {
+      start();
+    }
+  } else if(!strcmp(cmd, "interval") && arg != NULL) {
+    conf.interval_ms = MAX(1, atol(arg));
+  } else if(!strcmp(cmd, "burst") && arg != NULL) {
+    conf.burst_len = MAX(1, atoi(arg));
+    if((arg = next_token(&line)) != NULL) {
+      conf.burst_gap_ms = atoi(arg);
+    }
+  } else if(!strcmp(cmd, "payload") && arg != NULL) {
+    conf.payload = MIN(atoi(arg), TG_MAX_PAYLOAD);
+  } else if(!strcmp(cmd, "dest")) {
+    for(conf.dests_count = 0; arg != NULL && conf.dests_count < TG_MAX_DESTS;
+        arg = next_token(&line)) {
+      conf.dests[conf.dests_count++] = atoi(arg);
+    }
+  } else if(!strcmp(cmd, "ramp") && arg != NULL) {
+    conf.ramp_period = atoi(arg);
+    if((arg = next_token(&line)) != NULL) {
+      conf.ramp_percent = atoi(arg);
+    }
+    conf.ramp_min_ms = (arg = next_token(&line)) != NULL ? atol(arg) : 0;
+    if(conf.ramp_period > 0 && conf.running) {
+      etimer_set(&ramp_timer, conf.ramp_period * CLOCK_SECOND);
+    } else {
+      etimer_stop(&ramp_timer);
+    }
+  } else if(!strcmp(cmd, "event")) {
+    if(conf.running && conf.pattern == TG_EVENT && burst_left == 0) {
+      send_timer_expired();
+    }
+  } else if(!strcmp(cmd, "stats")) {
+    print_summary();
+    etimer_restart(&summary_timer);
+    return;
+  } else if(strcmp(cmd, "conf")) {
+    LOG("TG: unknown command %s\n", cmd);
+    return;
+  }
+  print_conf();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(traffic_gen_process, ev, data)
+{
+  uip_ipaddr_t global_ipaddr;
+
+  PROCESS_BEGIN();
+
+  if(!deployment_init(&global_ipaddr, NULL, ROOT_ID)) {
+    PROCESS_EXIT();
+  }
+  simple_udp_register(&unicast_connection, UDP_PORT,
+                      NULL, UDP_PORT, receiver);
+
+#if WITH_TSCH
+#if WITH_ORCHESTRA
+  orchestra_init();
+#else
+  tsch_schedule_create_minimal();
+#endif
+#endif
+
+  energest_flush();
+  last_radio = energest_type_time(ENERGEST_TYPE_TRANSMIT) + energest_type_time(ENERGEST_TYPE_LISTEN);
+  last_time = energest_type_time(ENERGEST_TYPE_CPU) + energest_type_time(ENERGEST_TYPE_LPM);
+  etimer_set(&summary_timer, TG_SUMMARY_PERIOD);
+  if(TG_AUTOSTART && node_id != ROOT_ID) {
+    start();
+  }
+  print_conf();
+
+  while(1) {
+    PROCESS_WAIT_EVENT();
+    if(ev == serial_line_event_message && data != NULL) {
+      command((char *)data);
+    } else if(ev == PROCESS_EVENT_TIMER) {
+      if(data == &send_timer) {
+        send_timer_expired();
+      } else if(data == &ramp_timer) {
+        ramp();
+      } else if(data == &summary_timer) {
+        print_summary();
+        etimer_reset(&summary_timer);
+      }
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,515 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Microbenchmarks of the TSCH schedule and queue functions that run
+ *         from the link operation, in rtimer ticks, for a range of link and
+ *         neighbor counts, and of the uIP checksum and CRC16 for a range of
+ *         lengths, checked against reference values. With
+ *         RTIMER_CONF_MULTIPLEX, the jitter (average and max lateness) of
+ *         an rtimer task scheduled as the TSCH link operation, with and
+ *         without tasks of low priority. Prints one line per
+ *         function and count:
+ *         Bench: <platform> <function> <count> <ticks per 100 calls> <us per call>
+ *         To be run on a node that is not associated, e.g. with:
+ *         make TARGET=sky app-tsch-bench.upload
+ */
+
+#include "contiki-conf.h"
+#include "net/packetbuf.h"
+#include "net/queuebuf.h"
+#include "net/ip/uip.h"
+#include "lib/crc16.h"
+#include "lib/random.h"
+#include "net/mac/tsch/tsch.h"
+#include "net/mac/tsch/tsch-private.h"
+#include "net/mac/tsch/tsch-queue.h"
+#include "net/mac/tsch/tsch-schedule.h"
+#include <stdio.h>
+
+struct unit_test;
+static void bench_print_report(const struct unit_test *utp);
+#define UNIT_TEST_PRINT_FUNCTION bench_print_report
+#include "unit-test.h"
+
+#ifndef CONTIKI_TARGET_NAME
+#define CONTIKI_TARGET_NAME "unknown"
+#endif
+
+/* Calls timed per function and count */
+#define BENCH_ITERATIONS 64
+/* Handle and length of the slotframe of the schedule benchmarks */
+#define BENCH_SLOTFRAME_HANDLE 100
+#define BENCH_SLOTFRAME_SIZE 101
+/* Link and neighbor counts */
+static const uint8_t link_counts[] = { 1, 4, 8, 16, 32 };
+static const uint8_t nbr_counts[] = { 1, 2, 4, 8 };
+/* Checksum and CRC lengths, in bytes */
+static const uint8_t data_lens[] = { 16, 64, 127 };
+/* The EB and broadcast queues are neighbors too */
+#define BENCH_MAX_NBRS (TSCH_QUEUE_MAX_NEIGHBOR_QUEUES - 2)
+#if RTIMER_MULTIPLEX
+/* Tasks of low priority of the jitter benchmark, and their run time */
+#define BENCH_LOAD_TASKS 3
+#define BENCH_LOAD_DURATION (RTIMER_MULTIPLEX_GUARD * 3 / 4)
+#endif /* RTIMER_MULTIPLEX */
+
+static struct tsch_slotframe *sf_bench;
+#if RTIMER_MULTIPLEX
+static struct rtimer jitter_task;
+static struct rtimer load_tasks[BENCH_LOAD_TASKS];
+static int jitter_load;
+static volatile int jitter_count;
+static unsigned long jitter_sum;
+static rtimer_clock_t jitter_max;
+static unsigned long load_count;
+#endif /* RTIMER_MULTIPLEX */
+
+UNIT_TEST_REGISTER(get_link_from_asn, "tsch_schedule_get_link_from_asn");
+UNIT_TEST_REGISTER(get_next_active_link, "tsch_schedule_get_next_active_link");
+UNIT_TEST_REGISTER(add_packet, "tsch_queue_add_packet");
+UNIT_TEST_REGISTER(get_packet_for_nbr, "tsch_queue_get_packet_for_nbr");
+UNIT_TEST_REGISTER(update_all_backoff_windows, "tsch_queue_update_all_backoff_windows");
+UNIT_TEST_REGISTER(chksum, "uip_chksum");
+UNIT_TEST_REGISTER(crc16, "crc16_data");
+#if RTIMER_MULTIPLEX
+UNIT_TEST_REGISTER(rtimer_jitter, "rtimer jitter");
+#endif /* RTIMER_MULTIPLEX */
+
+/*---------------------------------------------------------------------------*/
+static void
+bench_print_report(const struct unit_test *utp)
+{
+  printf("Bench: %s %s, exit line %u\n", utp->descr,
+         utp->result == unit_test_failure ? "failed" : "done", utp->exit_line);
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_row(const char *function, int count, unsigned long ticks)
+{
+  printf("Bench: %s %s %d %lu %lu\n", CONTIKI_TARGET_NAME, function, count,
+         ticks * 100 / BENCH_ITERATIONS,
+         ticks * 1000000 / RTIMER_SECOND / BENCH_ITERATIONS);
+}
+/*---------------------------------------------------------------------------*/
+/* A slotframe with num_links Tx links spread over its timeslots.
+ * Returns 1 if successful, 0 otherwise */
+static int
+setup_links(int num_links)
+{
+  int i;
+  if(sf_bench != NULL) {
+    tsch_schedule_remove_slotframe(sf_bench);
+  }
+  sf_bench = tsch_schedule_add_slotframe(BENCH_SLOTFRAME_HANDLE, BENCH_SLOTFRAME_SIZE);
+  if(sf_bench == NULL) {
+    return 0;
+  }
+  for(i = 0; i < num_links; i++) {
+    if(tsch_schedule_add_link(sf_bench, LINK_OPTION_TX | LINK_OPTION_SHARED,
+        LINK_TYPE_NORMAL, &tsch_broadcast_address,
+        i * BENCH_SLOTFRAME_SIZE / num_links, 0) == NULL) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+cleanup_links(void)
+{
+  if(sf_bench != NULL) {
+    tsch_schedule_remove_slotframe(sf_bench);
+    sf_bench = NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+nbr_addr(int i, linkaddr_t *addr)
+{
+  linkaddr_copy(addr, &linkaddr_null);
+  addr->u8[0] = 0x02;
+  addr->u8[LINKADDR_SIZE - 1] = i + 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Queues one packet to neighbor i. Returns 1 if successful, 0 otherwise */
+static int
+queue_packet(int i)
+{
+  linkaddr_t addr;
+  nbr_addr(i, &addr);
+  packetbuf_clear();
+  packetbuf_set_datalen(20);
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &addr);
+  return tsch_queue_add_packet(&addr, NULL, NULL);
+}
+/*---------------------------------------------------------------------------*/
+/* One packet queued to each of num_nbrs neighbors.
+ * Returns 1 if successful, 0 otherwise */
+static int
+setup_queues(int num_nbrs)
+{
+  int i;
+  for(i = 0; i < num_nbrs; i++) {
+    if(!queue_packet(i)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+cleanup_queues(void)
+{
+  tsch_queue_flush_all();
+  tsch_queue_free_unused_neighbors();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST(get_link_from_asn)
+{
+  struct asn_t asn;
+  rtimer_clock_t start;
+  int c, i;
+
+  UNIT_TEST_BEGIN();
+
+  for(c = 0; c < sizeof(link_counts) && link_counts[c] <= TSCH_MAX_LINKS; c++) {
+    UNIT_TEST_ASSERT(setup_links(link_counts[c]));
+    ASN_INIT(asn, 0, 0);
+    start = RTIMER_NOW();
+    for(i = 0; i < BENCH_ITERATIONS; i++) {
+      tsch_schedule_get_link_from_asn(&asn);
+      ASN_INC(asn, 7);
+    }
+    print_row("get_link_from_asn", link_counts[c], RTIMER_NOW() - start);
+    /* Timeslot 0 always has a link */
+    ASN_INIT(asn, 0, 0);
+    UNIT_TEST_ASSERT(tsch_schedule_get_link_from_asn(&asn) != NULL);
+  }
+  cleanup_links();
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST(get_next_active_link)
+{
+  struct asn_t asn;
+  uint16_t time_offset;
+  rtimer_clock_t start;
+  int c, i;
+
+  UNIT_TEST_BEGIN();
+
+  for(c = 0; c < sizeof(link_counts) && link_counts[c] <= TSCH_MAX_LINKS; c++) {
+    UNIT_TEST_ASSERT(setup_links(link_counts[c]));
+    ASN_INIT(asn, 0, 0);
+    start = RTIMER_NOW();
+    for(i = 0; i < BENCH_ITERATIONS; i++) {
+      tsch_schedule_get_next_active_link(&asn, &time_offset);
+      /* Move to the next link, as the link operation does */
+      ASN_INC(asn, time_offset);
+    }
+    print_row("get_next_active_link", link_counts[c], RTIMER_NOW() - start);
+    UNIT_TEST_ASSERT(tsch_schedule_get_next_active_link(&asn, &time_offset) != NULL);
+  }
+  cleanup_links();
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST(add_packet)
+{
+  rtimer_clock_t ticks;
+  rtimer_clock_t start;
+  int batch;
+  int c, i, n;
+
+  UNIT_TEST_BEGIN();
+
+  for(c = 0; c < sizeof(nbr_counts) && nbr_counts[c] <= BENCH_MAX_NBRS; c++) {
+    /* Time batches that fit in the packet pool and in the neighbor
+     * quotas, flush in between */
+    batch = MIN(QUEUEBUF_NUM, nbr_counts[c] * TSCH_QUEUE_NUM_PER_NEIGHBOR);
+    ticks = 0;
+    for(i = 0; i < BENCH_ITERATIONS; i += n) {
+      start = RTIMER_NOW();
+      for(n = 0; n < batch && i + n < BENCH_ITERATIONS; n++) {
+        UNIT_TEST_ASSERT(queue_packet(n % nbr_counts[c]));
+      }
+      ticks += RTIMER_NOW() - start;
+      cleanup_queues();
+    }
+    print_row("add_packet", nbr_counts[c], ticks);
+  }
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST(get_packet_for_nbr)
+{
+  struct tsch_neighbor *nbrs[BENCH_MAX_NBRS];
+  linkaddr_t addr;
+  rtimer_clock_t start;
+  int c, i;
+
+  UNIT_TEST_BEGIN();
+
+  for(c = 0; c < sizeof(nbr_counts) && nbr_counts[c] <= BENCH_MAX_NBRS; c++) {
+    UNIT_TEST_ASSERT(setup_queues(nbr_counts[c]));
+    for(i = 0; i < nbr_counts[c]; i++) {
+      nbr_addr(i, &addr);
+      nbrs[i] = tsch_queue_get_nbr(&addr);
+      UNIT_TEST_ASSERT(nbrs[i] != NULL);
+    }
+    start = RTIMER_NOW();
+    for(i = 0; i < BENCH_ITERATIONS; i++) {
+      tsch_queue_get_packet_for_nbr(nbrs[i % nbr_counts[c]], 1);
+    }
+    print_row("get_packet_for_nbr", nbr_counts[c], RTIMER_NOW() - start);
+    UNIT_TEST_ASSERT(tsch_queue_get_packet_for_nbr(nbrs[0], 0) != NULL);
+    cleanup_queues();
+  }
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST(update_all_backoff_windows)
+{
+  rtimer_clock_t start;
+  int c, i;
+
+  UNIT_TEST_BEGIN();
+
+  for(c = 0; c < sizeof(nbr_counts) && nbr_counts[c] <= BENCH_MAX_NBRS; c++) {
+    UNIT_TEST_ASSERT(setup_queues(nbr_counts[c]));
+    /* A shared broadcast slot counts for all queues */
+    start = RTIMER_NOW();
+    for(i = 0; i < BENCH_ITERATIONS; i++) {
+      tsch_queue_update_all_backoff_windows(&tsch_broadcast_address);
+    }
+    print_row("update_all_backoff_windows", nbr_counts[c], RTIMER_NOW() - start);
+    cleanup_queues();
+  }
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+/* Reference checksum, in network byte order as uip_chksum */
+static uint16_t
+chksum_ref(const uint8_t *data, uint16_t len)
+{
+  uint32_t sum = 0;
+  uint16_t i;
+  for(i = 0; i < len; i++) {
+    sum += (i & 1) ? data[i] : (uint16_t)data[i] << 8;
+  }
+  while(sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  return uip_htons(sum);
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST(chksum)
+{
+  /* Room for all lengths at an odd offset, word-aligned */
+  static uint16_t buf[(128 + 2) / 2];
+  uint8_t *data = (uint8_t *)buf;
+  rtimer_clock_t start;
+  int c, i;
+
+  UNIT_TEST_BEGIN();
+
+  for(i = 0; i < sizeof(buf); i++) {
+    data[i] = (i * 37) ^ (i >> 2) ^ (i % 5 == 0 ? 0xff : 0);
+  }
+  /* Every length, aligned or not */
+  for(i = 0; i <= 128; i++) {
+    UNIT_TEST_ASSERT(uip_chksum(buf, i) == chksum_ref(data, i));
+    UNIT_TEST_ASSERT(uip_chksum((uint16_t *)(data + 1), i) ==
+                     chksum_ref(data + 1, i));
+  }
+
+  for(c = 0; c < sizeof(data_lens); c++) {
+    start = RTIMER_NOW();
+    for(i = 0; i < BENCH_ITERATIONS; i++) {
+      uip_chksum(buf, data_lens[c]);
+    }
+    print_row("uip_chksum", data_lens[c], RTIMER_NOW() - start);
+  }
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST(crc16)
+{
+  static uint8_t buf[128];
+  unsigned short acc;
+  rtimer_clock_t start;
+  int c, i;
+
+  UNIT_TEST_BEGIN();
+
+  /* CRC-16/KERMIT check value */
+  UNIT_TEST_ASSERT(crc16_data((const unsigned char *)"123456789", 9, 0) == 0x2189);
+  /* A running CRC gives the same as one over the block */
+  for(i = 0; i < sizeof(buf); i++) {
+    buf[i] = (i * 37) ^ (i >> 2);
+  }
+  acc = 0;
+  for(i = 0; i < sizeof(buf); i++) {
+    acc = crc16_add(buf[i], acc);
+  }
+  UNIT_TEST_ASSERT(crc16_data(buf, sizeof(buf), 0) == acc);
+
+  for(c = 0; c < sizeof(data_lens); c++) {
+    start = RTIMER_NOW();
+    for(i = 0; i < BENCH_ITERATIONS; i++) {
+      crc16_data(buf, data_lens[c], 0);
+    }
+    print_row("crc16_data", data_lens[c], RTIMER_NOW() - start);
+  }
+
+  UNIT_TEST_END();
+}
+#if RTIMER_MULTIPLEX
+/*---------------------------------------------------------------------------*/
+/* The TSCH-like task: lateness of every run */
+static void
+jitter_callback(struct rtimer *t, void *ptr)
+{
+  rtimer_clock_t late = RTIMER_NOW() - RTIMER_TIME(t);
+
+  jitter_sum += late;
+  if(late > jitter_max) {
+    jitter_max = late;
+  }
+  if(++jitter_count < BENCH_ITERATIONS) {
+    /* As the link operation, from the start of the previous timeslot */
+    rtimer_set(t, RTIMER_TIME(t) + tsch_default_timing.slot_duration, 1,
+               jitter_callback, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* A task of low priority, e.g. sensor sampling, at random times */
+static void
+load_callback(struct rtimer *t, void *ptr)
+{
+  rtimer_clock_t start = RTIMER_NOW();
+
+  load_count++;
+  while(RTIMER_CLOCK_LT(RTIMER_NOW(), start + BENCH_LOAD_DURATION)) ;
+  if(jitter_count < BENCH_ITERATIONS) {
+    rtimer_set(t, start + RTIMER_MULTIPLEX_GUARD
+               + random_rand() % tsch_default_timing.slot_duration, 1,
+               load_callback, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Starts BENCH_ITERATIONS timeslots of the TSCH-like task, with num_load
+ * tasks of low priority */
+static void
+jitter_start(int num_load)
+{
+  rtimer_clock_t now = RTIMER_NOW();
+  int i;
+
+  for(i = 0; i < BENCH_LOAD_TASKS; i++) {
+    rtimer_cancel(&load_tasks[i]);
+  }
+  jitter_load = num_load;
+  jitter_count = 0;
+  jitter_sum = 0;
+  jitter_max = 0;
+  load_count = 0;
+  for(i = 0; i < num_load; i++) {
+    RTIMER_SET_PRIORITY(&load_tasks[i], RTIMER_PRIORITY_LOW);
+    rtimer_set(&load_tasks[i], now + RTIMER_MULTIPLEX_GUARD
+               + random_rand() % tsch_default_timing.slot_duration, 1,
+               load_callback, NULL);
+  }
+  RTIMER_SET_PRIORITY(&jitter_task, RTIMER_PRIORITY_HIGH);
+  rtimer_set(&jitter_task, now + tsch_default_timing.slot_duration, 1,
+             jitter_callback, NULL);
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST(rtimer_jitter)
+{
+  UNIT_TEST_BEGIN();
+
+  print_row("rtimer_jitter_avg", jitter_load, jitter_sum);
+  print_row("rtimer_jitter_max", jitter_load,
+            (unsigned long)jitter_max * BENCH_ITERATIONS);
+  UNIT_TEST_ASSERT(jitter_load == 0 || load_count > 0);
+  /* Tasks of low priority shorter than the guard never delay it past it */
+  UNIT_TEST_ASSERT(jitter_max <= RTIMER_MULTIPLEX_GUARD);
+  UNIT_TEST_ASSERT(rtimer_multiplex_stats()->overruns == 0);
+
+  UNIT_TEST_END();
+}
+#endif /* RTIMER_MULTIPLEX */
+/*---------------------------------------------------------------------------*/
+PROCESS(tsch_bench_process, "TSCH benchmark");
+AUTOSTART_PROCESSES(&tsch_bench_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tsch_bench_process, ev, data)
+{
+  static struct etimer et;
+
+  PROCESS_BEGIN();
+
+  /* Let the system start */
+  etimer_set(&et, CLOCK_SECOND);
+  PROCESS_WAIT_UNTIL(etimer_expired(&et));
+
+  printf("Bench: platform function count ticks/100calls us/call, %u ticks per second\n",
+         (unsigned)RTIMER_SECOND);
+  UNIT_TEST_RUN(get_link_from_asn);
+  UNIT_TEST_RUN(get_next_active_link);
+  UNIT_TEST_RUN(add_packet);
+  UNIT_TEST_RUN(get_packet_for_nbr);
+  UNIT_TEST_RUN(update_all_backoff_windows);
+  UNIT_TEST_RUN(chksum);
+  UNIT_TEST_RUN(crc16);
+#if RTIMER_MULTIPLEX
+  /* Without, then with tasks of low priority. The rtimer runs from
+   * interrupt, we just wait */
+  for(jitter_load = 0; jitter_load <= BENCH_LOAD_TASKS; jitter_load += BENCH_LOAD_TASKS) {
+    jitter_start(jitter_load);
+    while(jitter_count < BENCH_ITERATIONS) {
+      etimer_set(&et, CLOCK_SECOND / 8);
+      PROCESS_WAIT_UNTIL(etimer_expired(&et));
+    }
+    UNIT_TEST_RUN(rtimer_jitter);
+  }
+#endif /* RTIMER_MULTIPLEX */
+  printf("Bench: end\n");
+
+  PROCESS_END();
+}
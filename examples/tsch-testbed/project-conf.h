@@ -47,12 +47,43 @@
 #define ORCHESTRA_MINIMAL_SCHEDULE 0
 #define ORCHESTRA_RECEIVER_BASED   1
 #define ORCHESTRA_SENDER_BASED     2
+#define ORCHESTRA_MIXED            3 /* Receiver-based for DAOs, sender-based for data */
+#ifdef ORCHESTRA_CONF_CONFIG
+/* Set from the command line, e.g. by regression-tests/20-orchestra */
+#define ORCHESTRA_CONFIG ORCHESTRA_CONF_CONFIG
+#else
 #define ORCHESTRA_CONFIG ORCHESTRA_SENDER_BASED
 //#define ORCHESTRA_CONFIG ORCHESTRA_RECEIVER_BASED
 //#define ORCHESTRA_CONFIG ORCHESTRA_MINIMAL_SCHEDULE
+//#define ORCHESTRA_CONFIG ORCHESTRA_MIXED
+#endif
+
+#if WITH_ORCHESTRA
+#define TSCH_CALLBACK_NEW_TIME_SOURCE orchestra_callback_new_time_source
+#define TSCH_CALLBACK_JOINING_NETWORK orchestra_callback_joining_network
+#define TSCH_CALLBACK_SELECT_PACKET orchestra_callback_select_packet
+#if TSCH_CONF_WITH_BACKUP_TIME_SOURCE
+#define TSCH_CALLBACK_NEW_BACKUP_TIME_SOURCE orchestra_callback_new_backup_time_source
+#endif
+#if TSCH_CONF_PACKET_WITH_ACK_HINTS
+#define TSCH_CALLBACK_ACK_HINTS orchestra_callback_ack_hints
+#define TSCH_CALLBACK_ACK_HINTS_RECEIVED orchestra_callback_ack_hints_received
+#endif
+/* Negotiate sender-based slots with NACKs */
+//#define ORCHESTRA_CONF_SB_NACK 1
+#if ORCHESTRA_CONF_SB_NACK
+#define TSCH_CALLBACK_DO_NACK orchestra_callback_do_nack
+#define TSCH_CALLBACK_NACK_RECEIVED orchestra_callback_nack_received
+#endif
+/* RPL probes in cells of their own, when &probing is the last rule */
+#define RPL_CALLBACK_PROBE orchestra_callback_probe
+#endif
 
 #if ORCHESTRA_CONFIG == ORCHESTRA_MINIMAL_SCHEDULE
 
+#define ORCHESTRA_CONF_RULES { &default_common }
+#define ORCHESTRA_CONF_COMMON_SHARED_PERIOD TSCH_SCHEDULE_CONF_DEFAULT_LENGTH
+#define ORCHESTRA_CONF_COMMON_SHARED_TYPE LINK_TYPE_ADVERTISING
 #define TSCH_CONF_PACKET_DEST_ADDR_IN_ACK 1
 #define TSCH_CONF_MIN_EB_PERIOD (4 * CLOCK_SECOND)
 #define TSCH_CONF_MAX_EB_PERIOD (16 * CLOCK_SECOND)
@@ -60,9 +91,14 @@
 
 #elif ORCHESTRA_CONFIG == ORCHESTRA_RECEIVER_BASED
 
+#ifdef ORCHESTRA_CONF_UNICAST_PERIOD
+#define ORCHESTRA_UNICAST_PERIOD ORCHESTRA_CONF_UNICAST_PERIOD
+#else
 #define ORCHESTRA_UNICAST_PERIOD 7
+#endif
+#define ORCHESTRA_CONF_RULES { &eb_per_time_source, &default_common, &unicast_per_neighbor_rb }
+#define ORCHESTRA_CONF_RB_PERIOD ORCHESTRA_UNICAST_PERIOD
 #define TSCH_CONF_PACKET_DEST_ADDR_IN_ACK 1
-#define TSCH_CALLBACK_NEW_TIME_SOURCE orchestra_callback_new_time_source
 #define TSCH_CONF_MIN_EB_PERIOD (2 * CLOCK_SECOND)
 #define TSCH_CONF_MAX_EB_PERIOD (2 * CLOCK_SECOND)
 
@@ -72,12 +108,41 @@
 
 #elif ORCHESTRA_CONFIG == ORCHESTRA_SENDER_BASED
 
+#ifdef ORCHESTRA_CONF_UNICAST_PERIOD
+#define ORCHESTRA_UNICAST_PERIOD ORCHESTRA_CONF_UNICAST_PERIOD
+#else
 #define ORCHESTRA_UNICAST_PERIOD 47
+#endif
+#ifdef ORCHESTRA_CONF_UNICAST_PERIOD2
+#define ORCHESTRA_UNICAST_PERIOD2 ORCHESTRA_CONF_UNICAST_PERIOD2
+#else
 #define ORCHESTRA_UNICAST_PERIOD2 53
+#endif
+#define ORCHESTRA_CONF_RULES { &eb_per_time_source, &default_common, &unicast_per_neighbor_sb }
+#define ORCHESTRA_CONF_SB_PERIOD ORCHESTRA_UNICAST_PERIOD
+#define ORCHESTRA_CONF_SB_PERIOD2 ORCHESTRA_UNICAST_PERIOD2
 #define TSCH_CONF_PACKET_DEST_ADDR_IN_ACK (ORCHESTRA_UNICAST_PERIOD < MAX_NODES)
-#define TSCH_CALLBACK_NEW_TIME_SOURCE orchestra_callback_new_time_source
-#define TSCH_CALLBACK_JOINING_NETWORK orchestra_callback_joining_network
-//#define TSCH_CALLBACK_DO_NACK orchestra_callback_do_nack
+#define TSCH_CONF_MIN_EB_PERIOD (2 * CLOCK_SECOND)
+#define TSCH_CONF_MAX_EB_PERIOD (2 * CLOCK_SECOND)
+
+#define NODE_INDEX_SUFFLE 1
+#define NODE_INDEX_SUFFLE_MULTIPLICATOR 10
+#define NODE_INDEX_SUFFLE_MODULUS MAX_NODES
+
+#elif ORCHESTRA_CONFIG == ORCHESTRA_MIXED
+
+/* Both unicast rules in their own slotframes and channel offsets.
+ * The receiver-based rule comes first and takes the DAOs */
+#define ORCHESTRA_CONF_RULES { &eb_per_time_source, &default_common, \
+                               &unicast_per_neighbor_rb, &unicast_per_neighbor_sb }
+/* EB, common, RB and the two SB slotframes */
+#define TSCH_CONF_MAX_SLOTFRAMES 5
+#define ORCHESTRA_CONF_RB_PERIOD 7
+#define ORCHESTRA_CONF_SB_PERIOD 47
+#define ORCHESTRA_CONF_SB_PERIOD2 53
+#define ORCHESTRA_CONF_SB_CHANNEL_OFFSET 3
+#define ORCHESTRA_CONF_SB_CHANNEL_OFFSET2 4
+#define TSCH_CONF_PACKET_DEST_ADDR_IN_ACK 1
 #define TSCH_CONF_MIN_EB_PERIOD (2 * CLOCK_SECOND)
 #define TSCH_CONF_MAX_EB_PERIOD (2 * CLOCK_SECOND)
 
@@ -95,34 +160,84 @@
 #define TSCH_CALLBACK_LEAVING_NETWORK tsch_rpl_callback_leaving_network
 #endif
 #define RPL_CALLBACK_PARENT_SWITCH tsch_rpl_callback_parent_switch
+/* Packets queued to a former parent go to the new one */
+#define TSCH_QUEUE_CONF_WITH_REROUTE 1
+/* After 3 NOACKs, try the next-best parent (needs the backup time source) */
+/* #define TSCH_QUEUE_CONF_ANYCAST_NOACK 3 */
+/* Dedicated cells on demand for heavy flows, negotiated with 6P next to
+ * the Orchestra slotframes */
+/* #define TSCH_CONF_WITH_SIXP 1 */
+/* #define TSCH_QUEUE_CONF_WITH_STATS 1 */
+#if TSCH_CONF_WITH_SIXP
+/* One more slotframe than Orchestra for the 6P cells */
+#undef TSCH_CONF_MAX_SLOTFRAMES
+#if ORCHESTRA_CONFIG == ORCHESTRA_MIXED
+#define TSCH_CONF_MAX_SLOTFRAMES 6
+#else
+#define TSCH_CONF_MAX_SLOTFRAMES 5
+#endif
+#endif /* TSCH_CONF_WITH_SIXP */
 #define RPL_CALLBACK_NEW_DIO_INTERVAL tsch_rpl_callback_new_dio_interval
+/* Announce our rank in EBs, which then count as consistent DIOs */
+/* #define TSCH_CALLBACK_EB_RPL_INFO tsch_rpl_callback_eb_rpl_info */
+/* #define TSCH_CALLBACK_EB_RPL_INFO_RECEIVED tsch_rpl_callback_eb_rpl_info_received */
+/* Per-hop latency, in slots: set RPL_CONF_HOP_TIMESTAMPS to the max hop count */
+#define RPL_CALLBACK_HOP_TIMESTAMP tsch_rpl_callback_hop_timestamp
+/* Multicast engines forward at the pace of the broadcast cells */
+#define UIP_MCAST6_CALLBACK_FWD_BACKLOG tsch_queue_broadcast_backlog
+#define UIP_MCAST6_CALLBACK_FWD_DELAY tsch_queue_broadcast_delay
 #endif
 
 #define TSCH_CONF_GUARD_TIME 600
+/* Send unicast frames with less than RF_POWER when the ACK RSSI allows */
+/* #define TSCH_CONF_WITH_TX_POWER_CONTROL 1 */
 
 /* #define WITH_OF_HOP_ETX 1 */
 /* #define WITH_OF_PDR 1 */
+/* #define WITH_OF_LOAD 1 */
 #define WITH_OF_ETX_EXP 1
 
 #define TSCH_SCHEDULE_CONF_PRIORITIZE_TX 0
 #define TSCH_CONF_USE_SFD_FOR_SYNC !IN_COOJA
 
 #define TSCH_CONF_CHECK_TIME_AT_ASSOCIATION 20
+/* Log the radio-on time per Orchestra slotframe with the duty cycle */
+//#define TSCH_CONF_WITH_ENERGEST 1
+/* CPU time per process and in TSCH link operations, printed by powertrace */
+//#define PROCESS_CONF_CPU_TIME 1
+//#define TSCH_CONF_WITH_CPU_TIME 1
+/* Turn the radio off after the header of unicasts to other nodes (cc2420) */
+//#define TSCH_CONF_RX_EARLY_REJECT 1
+/* Deliver events to the TSCH processes before all others */
+//#define PROCESS_CONF_PRIORITY_LEVELS 2
 #define RPL_CONF_PROBING 1
 #define RPL_CONF_PROBING_TX_THRESHOLD 4 /* Stop probing after 4 tx to a neighbor */
 #define RPL_CONF_PROBING_LOCK_ALL 1
 #define RPL_CONF_RSSI_BASED_ETX 1
+/* Refine the RSSI to initial ETX mapping from the ETX of probed parents */
+//#define RPL_CONF_RSSI_ETX_LEARNING 1
+/* Rejoin the stored DAG through the stored parent after a reboot (needs
+ * a CFS), verified once TSCH has joined */
+//#define RPL_CONF_WITH_STORE 1
+//#define RPL_STORE_CONF_WAIT_LINK 1
 
 #define ANNOTATE_DEFAULT_ROUTE IN_COOJA
 
 #undef QUEUEBUF_CONF_NUM
 #define QUEUEBUF_CONF_NUM 16
+/* Store small frames (EBs, keepalives, RPL control) in small slots */
+//#define QUEUEBUF_CONF_SIZE_CLASSES 1
+/* Or store frame payloads at their length in a compacted mmem pool,
+   locked against the TSCH slot operation */
+//#define QUEUEBUF_CONF_WITH_PACKETMEM 1
+//#define PACKETMEM_CONF_LOCK tsch_get_lock
+//#define PACKETMEM_CONF_UNLOCK tsch_release_lock
 
 #undef TSCH_CONF_QUEUE_NUM_PER_NEIGHBOR
 #define TSCH_CONF_QUEUE_NUM_PER_NEIGHBOR 16
 
 #undef TSCH_CONF_QUEUE_MAX_NEIGHBOR_QUEUES
-#define TSCH_CONF_QUEUE_MAX_NEIGHBOR_QUEUES 6
+#define TSCH_CONF_QUEUE_MAX_NEIGHBOR_QUEUES 12
 
 #if !CONTIKI_TARGET_JN5168
 #undef ENABLE_COOJA_DEBUG
@@ -166,12 +281,23 @@
 
 #endif /* !CONTIKI_TARGET_JN5168 */
 
+#if CONTIKI_TARGET_NATIVE
+/* Native simulation, built with NATIVE_SIM=1 and run by tools/tsch-sim */
+#undef NETSTACK_CONF_RADIO
+#define NETSTACK_CONF_RADIO   sim_radio_driver
+#endif /* CONTIKI_TARGET_NATIVE */
+
 #include "cooja-debug.h"
 
 /* No Downwards routes */
 #undef RPL_CONF_MOP
 #define RPL_CONF_MOP RPL_MOP_NO_DOWNWARD_ROUTES
 //#define RPL_CONF_MOP RPL_MOP_STORING_NO_MULTICAST
+/* Non-storing mode: only the root keeps downward state, for up to
+ * RPL_NS_CONF_LINK_NUM nodes */
+//#define RPL_CONF_MOP RPL_MOP_NON_STORING
+/* In storing mode, give downward traffic receiver-based cells too */
+//#define ORCHESTRA_CONF_RB_STORING 1
 
 #undef UIP_CONF_IP_FORWARD
 #define UIP_CONF_IP_FORWARD 0
@@ -213,6 +339,23 @@
 #define RPL_CONF_MAX_NBRHOPINC 4
 #define RPL_OF_HOP_ETX_CONF_THRESHOLD (RPL_DAG_MC_ETX_DIVISOR / 2)
 
+#elif WITH_OF_LOAD
+
+#undef RPL_CONF_OF
+#define RPL_CONF_OF rpl_of_load
+#undef RPL_CONF_DAG_MC
+#define RPL_CONF_DAG_MC RPL_DAG_MC_ENERGY
+/* Advertise the TSCH queue load */
+#define RPL_CALLBACK_NODE_LOAD tsch_queue_get_load
+#undef RPL_CONF_INIT_LINK_METRIC
+#define RPL_CONF_INIT_LINK_METRIC 2 /* default 5 */
+#undef RPL_CONF_MIN_HOPRANKINC
+#define RPL_CONF_MIN_HOPRANKINC 256
+#undef RPL_CONF_MAX_HOPRANKINC
+#define RPL_CONF_MAX_HOPRANKINC 0 /* default (7 * RPL_MIN_HOPRANKINC) */
+/* Do not accept RPL neighbors with rank greater than ours + 1.5 */
+#define RPL_CONF_MAX_NBRHOPINC (RPL_MIN_HOPRANKINC + RPL_MIN_HOPRANKINC/2)
+
 #elif WITH_OF_ETX_EXP
 
 #undef RPL_CONF_OF
@@ -245,6 +388,19 @@
 /* The neighbor table size */
 #undef NBR_TABLE_CONF_MAX_NEIGHBORS
 #define NBR_TABLE_CONF_MAX_NEIGHBORS 22
+/* Hashed neighbor lookup, avoids scanning the 22 neighbors per packet */
+//#define NBR_TABLE_CONF_HASH 1
+/* Look up the sender of a packet once for all layers */
+//#define NBR_TABLE_CONF_WITH_LOOKUP_CACHE 1
+/* When full, evict the least recently used neighbor with the worst link,
+ * never one we route through */
+//#define NBR_TABLE_CONF_EVICT_POLICY NBR_TABLE_EVICT_LRU
+//#define NBR_TABLE_CALLBACK_EVICT_SCORE tsch_link_estimator_evict_score
+/* Constant-time alloc and free for the TSCH, Orchestra and queuebuf pools */
+//#define MEMB_CONF_WITH_FREE_LIST 1
+/* Queue of rtimer tasks, for sensor sampling next to TSCH */
+//#define RTIMER_CONF_MULTIPLEX 1
+//#define UIP_CONF_DS6_ROUTE_KEEP_NEXTHOPS 1
 
 /* The routing table size */
 #undef UIP_CONF_MAX_ROUTES
@@ -349,10 +505,39 @@
 #undef NETSTACK_CONF_FRAMER
 #define NETSTACK_CONF_FRAMER  framer_802154
 
+/* Link-layer security: TSCH secures frames when queuing them and verifies
+ * them after the slot, and sky uses the cc2420 AES. Needs
+ * MODULES += core/net/llsec/noncoresec in the Makefile */
+//#undef NETSTACK_CONF_LLSEC
+//#define NETSTACK_CONF_LLSEC noncoresec_driver
+//#define LLSEC802154_CONF_SECURITY_LEVEL FRAME802154_SECURITY_LEVEL_MIC_32
+//#define ANTI_REPLAY_CONF_COUNTER_BASE tsch_get_asn_ls4b
+
 #define WITH_DEPLOYMENT 1
 #define WITH_TSCH_LOG 1
 #define WITH_LOG 1
 #define WITH_LOG_HOP_COUNT 1
+/* Stamp data packets with their origin ASN, log the latency at every hop */
+//#define WITH_LOG_LATENCY 1
+/* Queue packet logs as binary records, decode with tools/deployment-log-decode */
+//#define DEPLOYMENT_LOG_CONF_BINARY 1
+/* Keep a map of neighbor PDR and RSSI, reported to the root, see link-map.h */
+//#define WITH_LINK_MAP 1
+/* Report duty cycle, TSCH drops and misses, parent and ETX to the root, see health-report.h */
+//#define WITH_HEALTH_REPORT 1
+/* Compute schedules at the root and push them through the link map, see central-schedule.h */
+//#define WITH_CENTRAL_SCHEDULE 1
+#if WITH_CENTRAL_SCHEDULE
+#define LINK_MAP_CALLBACK_PARENT central_schedule_set_parent
+#endif
+/* Disseminate files down the DODAG, in Orchestra bulk cells, see dissemination.h */
+//#define WITH_DISSEMINATION 1
+#if WITH_DISSEMINATION && WITH_ORCHESTRA
+#define DISSEMINATION_CALLBACK_BULK_START orchestra_bulk_start
+#define DISSEMINATION_CALLBACK_BULK_STOP orchestra_bulk_stop
+#endif
+/* Disseminated files are delta images, see delta-patch.h */
+//#define DISSEMINATION_CALLBACK_COMPLETE delta_patch_complete
 #if WITH_LOG
 #include "deployment-log.h"
 #endif
@@ -439,6 +439,7 @@ typedef uint32_t rtimer_clock_t;
 #define UIP_CONF_UDP                         1
 #define UIP_CONF_UDP_CHECKSUMS               1
 #define UIP_CONF_ICMP6                       1
+#define UIP_CONF_CHKSUM_ACC32                1
 
 /* ND and Routing */
 #ifndef UIP_CONF_ROUTER
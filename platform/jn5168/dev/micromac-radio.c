@@ -235,6 +235,20 @@ micromac_radio_read_sfd_timer(void)
   return last_packet_timestamp;
 }
 /*---------------------------------------------------------------------------*/
+/* Convert an absolute rtimer time to the radio timebase.
+ * Times already in the past map to "now". */
+static uint32_t
+micromac_radio_time_from_rtimer(rtimer_clock_t t)
+{
+  rtimer_clock_t now = RTIMER_NOW();
+  uint32_t radio_now = u32MMAC_GetTime();
+
+  if(RTIMER_CLOCK_LT(t, now)) {
+    return radio_now;
+  }
+  return radio_now + RTIMER_TO_RADIO((rtimer_clock_t)(t - now));
+}
+/*---------------------------------------------------------------------------*/
 int
 micromac_radio_init(void)
 {
@@ -357,6 +371,27 @@ micromac_radio_raw_rx_on(void)
   return 1;
 }
 /*---------------------------------------------------------------------------*/
+/* Arm the receiver to start listening at rtimer time t.
+ * The MAC hardware handles the start, so there is no interrupt
+ * latency to compensate for. */
+int
+micromac_radio_rx_on_at(rtimer_clock_t t)
+{
+  GET_LOCK();
+  rx_in_progress = 1;
+  if(rx_frame_buffer != NULL) {
+    vMMAC_SetRxStartTime(micromac_radio_time_from_rtimer(t));
+    vMMAC_StartPhyReceive(rx_frame_buffer,
+      (uint16_t) (E_MMAC_RX_DELAY_START
+                 | MICROMAC_CONF_RX_FCS_ERROR) /* means: reject FCS errors */
+      );
+  } else {
+    missed_radio_on_request = 1;
+  }
+  RELEASE_LOCK();
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
 static void
 off(void)
 {
@@ -368,10 +403,12 @@ off(void)
   /* TODO PROTOCOL shutdown... to shutdown the circuit instead. */
 }
 /*---------------------------------------------------------------------------*/
+/* RADIO_TX_MODE_NO_WAIT */
+static uint8_t tx_no_wait;
+
 static int
-micromac_radio_transmit(unsigned short payload_len)
+micromac_radio_start_transmit(uint16_t start_option, rtimer_clock_t max_duration)
 {
-  PRINTF("micromac_radio_transmit\n");
   if(tx_in_progress) {
     PRINTF("micromac_radio_transmit: RADIO_TX_COLLISION\n");
     return RADIO_TX_COLLISION;
@@ -380,10 +417,16 @@ micromac_radio_transmit(unsigned short payload_len)
   tx_in_progress = 1;
   /* TODO no auto ack in Pyh mode, remove it here and constuct ack in interrupt */
   vMMAC_StartPhyTransmit(&tx_frame_buffer,
-      E_MMAC_TX_START_NOW | MMAC_TX_AUTO_ACK_CONF | E_MMAC_TX_NO_CCA);
+      start_option | MMAC_TX_AUTO_ACK_CONF | E_MMAC_TX_NO_CCA);
+  if(tx_no_wait) {
+    /* The MAC hardware completes the transmission on its own */
+    tx_in_progress = 0;
+    RELEASE_LOCK();
+    return RADIO_TX_OK;
+  }
   /* TODO should this be removed? */
   BUSYWAIT_UNTIL(u32MMAC_PollInterruptSource(E_MMAC_INT_TX_COMPLETE),
-      MAX_PACKET_DURATION);
+      max_duration);
   tx_in_progress = 0;
   int ret = RADIO_TX_ERR;
   uint32_t tx_error = u32MMAC_GetTxErrors();
@@ -404,6 +447,34 @@ micromac_radio_transmit(unsigned short payload_len)
   return ret;
 }
 /*---------------------------------------------------------------------------*/
+/* Set through RADIO_PARAM_TX_START_TIME, for the next transmission */
+static uint8_t timed_tx;
+static rtimer_clock_t timed_tx_start;
+
+static int
+micromac_radio_transmit(unsigned short payload_len)
+{
+  if(timed_tx) {
+    timed_tx = 0;
+    return micromac_radio_transmit_at(payload_len, timed_tx_start);
+  }
+  PRINTF("micromac_radio_transmit\n");
+  return micromac_radio_start_transmit(E_MMAC_TX_START_NOW, MAX_PACKET_DURATION);
+}
+/*---------------------------------------------------------------------------*/
+/* Transmit the frame already in the radio buffer, starting at rtimer time t.
+ * The start is triggered by the MAC hardware rather than by software */
+int
+micromac_radio_transmit_at(unsigned short payload_len, rtimer_clock_t t)
+{
+  rtimer_clock_t now = RTIMER_NOW();
+  rtimer_clock_t wait = RTIMER_CLOCK_LT(now, t) ? t - now : 0;
+
+  PRINTF("micromac_radio_transmit_at\n");
+  vMMAC_SetTxStartTime(micromac_radio_time_from_rtimer(t));
+  return micromac_radio_start_transmit(E_MMAC_TX_DELAY_START, wait + MAX_PACKET_DURATION);
+}
+/*---------------------------------------------------------------------------*/
 static int
 micromac_radio_prepare(const void *payload, unsigned short payload_len)
 {
@@ -912,6 +983,10 @@ get_value(radio_param_t param, radio_value_t *value)
     /* Return the RSSI value in dBm */
     *value = radio_last_rssi;
     return RADIO_RESULT_OK;
+  case RADIO_PARAM_TX_MODE:
+    /* Frames are always sent without CCA */
+    *value = tx_no_wait ? RADIO_TX_MODE_NO_WAIT : 0;
+    return RADIO_RESULT_OK;
   case RADIO_CONST_CHANNEL_MIN:
     *value = 11;
     return RADIO_RESULT_OK;
@@ -963,6 +1038,12 @@ set_value(radio_param_t param, radio_value_t value)
     }
     micromac_radio_set_txpower(output_power[i - 1].config);
     return RADIO_RESULT_OK;
+  case RADIO_PARAM_TX_MODE:
+    if(value & ~RADIO_TX_MODE_NO_WAIT) {
+      return RADIO_RESULT_INVALID_VALUE;
+    }
+    tx_no_wait = (value & RADIO_TX_MODE_NO_WAIT) != 0;
+    return RADIO_RESULT_OK;
   default:
     return RADIO_RESULT_NOT_SUPPORTED;
   }
@@ -977,6 +1058,32 @@ get_object(radio_param_t param, void *dest, size_t size)
 static radio_result_t
 set_object(radio_param_t param, const void *src, size_t size)
 {
+  const struct radio_rx_window *window;
+
+  if(param == RADIO_PARAM_TX_START_TIME) {
+    if(size != sizeof(rtimer_clock_t) || !src) {
+      return RADIO_RESULT_INVALID_VALUE;
+    }
+    timed_tx_start = *(const rtimer_clock_t *)src;
+    timed_tx = 1;
+    return RADIO_RESULT_OK;
+  }
+  if(param == RADIO_PARAM_RX_WINDOW) {
+    if(size != sizeof(struct radio_rx_window) || !src) {
+      return RADIO_RESULT_INVALID_VALUE;
+    }
+    window = src;
+    /* The MAC hardware starts the receiver */
+    micromac_radio_rx_on_at(window->start);
+    if(window->duration > 0) {
+      while(!micromac_radio_receiving_packet()
+            && RTIMER_CLOCK_LT(RTIMER_NOW(), window->start + window->duration));
+      if(!micromac_radio_receiving_packet() && !micromac_radio_pending_packet()) {
+        micromac_radio_off();
+      }
+    }
+    return RADIO_RESULT_OK;
+  }
   return RADIO_RESULT_NOT_SUPPORTED;
 }
 /*---------------------------------------------------------------------------*/
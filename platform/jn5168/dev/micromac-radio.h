@@ -111,6 +111,11 @@ void micromac_radio_set_interrupt_enable(uint8_t e);
 
 int micromac_radio_raw_rx_on(void);
 
+/* Timed operations: the MAC hardware starts the transmission
+ * (resp. reception) at the given absolute rtimer time */
+int micromac_radio_transmit_at(unsigned short payload_len, rtimer_clock_t t);
+int micromac_radio_rx_on_at(rtimer_clock_t t);
+
 /* Enable or disable radio always on */
 void micromac_radio_set_always_on(uint8_t e);
 
@@ -99,6 +99,7 @@ typedef unsigned long rtimer_clock_t;
 
 #define UIP_ARCH_ADD32           1
 #define UIP_ARCH_CHKSUM          0
+#define UIP_CONF_CHKSUM_ACC32    1
 
 #define UIP_CONF_BYTE_ORDER      UIP_LITTLE_ENDIAN
 #define EEPROM_CONF_SIZE	8000
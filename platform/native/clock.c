@@ -40,8 +40,25 @@
 #include "sys/clock.h"
 #include <time.h>
 #include <sys/time.h>
+#if NATIVE_CONF_SIM
+#include "sim.h"
+#endif /* NATIVE_CONF_SIM */
 
 /*---------------------------------------------------------------------------*/
+#if NATIVE_CONF_SIM
+/* Virtual time of the simulation */
+clock_time_t
+clock_time(void)
+{
+  return sim_time() * CLOCK_SECOND / SIM_SECOND;
+}
+/*---------------------------------------------------------------------------*/
+unsigned long
+clock_seconds(void)
+{
+  return sim_time() / SIM_SECOND;
+}
+#else /* NATIVE_CONF_SIM */
 clock_time_t
 clock_time(void)
 {
@@ -61,6 +78,7 @@ clock_seconds(void)
 
   return tv.tv_sec;
 }
+#endif /* NATIVE_CONF_SIM */
 /*---------------------------------------------------------------------------*/
 void
 clock_delay(unsigned int d)
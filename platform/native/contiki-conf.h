@@ -238,7 +238,12 @@ typedef unsigned short uip_stats_t;
 
 typedef unsigned long clock_time_t;
 
+#if NATIVE_CONF_SIM
+/* As sky, whose timing simulated nodes follow */
+#define CLOCK_CONF_SECOND 128
+#else /* NATIVE_CONF_SIM */
 #define CLOCK_CONF_SECOND 1000
+#endif /* NATIVE_CONF_SIM */
 
 #define LOG_CONF_ENABLED 1
 
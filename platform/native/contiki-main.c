@@ -72,6 +72,11 @@
 
 #include "net/rime/rime.h"
 
+#if NATIVE_CONF_SIM
+#include "sim.h"
+#include "lib/random.h"
+#endif /* NATIVE_CONF_SIM */
+
 #ifdef SELECT_CONF_MAX
 #define SELECT_MAX SELECT_CONF_MAX
 #else
@@ -173,6 +178,10 @@ char **contiki_argv;
 int
 main(int argc, char **argv)
 {
+#if NATIVE_CONF_SIM
+  /* Output is read by tsch-sim, until we next wait */
+  setvbuf(stdout, (char *)NULL, _IONBF, 0);
+#endif /* NATIVE_CONF_SIM */
 #if NETSTACK_CONF_WITH_IPV6
 #if UIP_CONF_IPV6_RPL
   printf(CONTIKI_VERSION_STRING " started with IPV6, RPL\n");
@@ -187,6 +196,21 @@ main(int argc, char **argv)
   contiki_argc = argc;
   contiki_argv = argv;
 
+#if NATIVE_CONF_SIM
+  node_id = sim_init();
+  /* The address Cooja gives to mote node_id, with the high byte of ids
+   * above 255 in byte 6, as in apps/deployment */
+  serial_id[0] = 0x00;
+  serial_id[1] = 0x12;
+  serial_id[2] = 0x74;
+  serial_id[3] = node_id & 0xff;
+  serial_id[4] = 0x00;
+  serial_id[5] = node_id & 0xff;
+  serial_id[6] = (node_id & 0xff) ^ (node_id >> 8);
+  serial_id[7] = node_id & 0xff;
+  random_init(node_id);
+#endif /* NATIVE_CONF_SIM */
+
   /* native under windows is hardcoded to use the first one or two args */
   /* for wpcap configuration so this needs to be "removed" from         */
   /* contiki_args (used by the native-border-router) */
@@ -244,6 +268,14 @@ main(int argc, char **argv)
 
   autostart_start(autostart_processes);
 
+#if NATIVE_CONF_SIM
+  /* Run until no process is runnable, then let the virtual time advance */
+  while(1) {
+    while(process_run() > 0);
+    sim_idle();
+  }
+#endif /* NATIVE_CONF_SIM */
+
   /* Make standard output unbuffered. */
   setvbuf(stdout, (char *)NULL, _IONBF, 0);
 
@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Simulated radio of the native simulation
+ */
+
+#include "contiki.h"
+#include "sim.h"
+#include "dev/sim-radio.h"
+
+#include <string.h>
+
+/* Frames delivered by tsch-sim that did not start yet */
+#ifdef SIM_RADIO_CONF_QUEUE_SIZE
+#define SIM_RADIO_QUEUE_SIZE SIM_RADIO_CONF_QUEUE_SIZE
+#else
+#define SIM_RADIO_QUEUE_SIZE 8
+#endif
+
+/* Values read by TSCH */
+signed char radio_last_rssi;
+uint8_t radio_last_correlation;
+
+static uint8_t radio_on;
+static uint8_t transmitting;
+static uint8_t channel = 26;
+static uint8_t tx_buf[SIM_MAX_FRAME];
+static unsigned short tx_len;
+/* The last frame received, valid from its SFD until read */
+static struct sim_msg rx;
+static uint8_t rx_valid;
+/* Sorted by start time */
+static struct sim_msg queue[SIM_RADIO_QUEUE_SIZE];
+static uint8_t queue_len;
+
+/*---------------------------------------------------------------------------*/
+/* Time on air, from the SFD: length byte and frame, 32 us per byte */
+static uint32_t
+frame_duration(unsigned short len)
+{
+  return ((uint64_t)(len + 1) * 32 * SIM_SECOND + 999999) / 1000000;
+}
+/*---------------------------------------------------------------------------*/
+void
+sim_radio_input(const struct sim_msg *m)
+{
+  int i;
+
+  if(queue_len == SIM_RADIO_QUEUE_SIZE) {
+    return;
+  }
+  for(i = queue_len; i > 0 && queue[i - 1].time > m->time; i--) {
+    queue[i] = queue[i - 1];
+  }
+  memcpy(&queue[i], m, sizeof(*m));
+  queue_len++;
+}
+/*---------------------------------------------------------------------------*/
+/* Receives the frames started by now. The radio state did not change
+ * since the last update, so it is the state at their start */
+void
+sim_radio_update(void)
+{
+  struct sim_msg *m;
+  uint64_t now = sim_time();
+  int i;
+
+  for(i = 0; i < queue_len && queue[i].time <= now; i++) {
+    m = &queue[i];
+    if(radio_on && !transmitting && m->channel == channel
+       && !(rx_valid && rx.time + rx.duration > m->time)) {
+      memcpy(&rx, m, sizeof(rx));
+      rx_valid = 1;
+    }
+  }
+  if(i > 0) {
+    queue_len -= i;
+    memmove(queue, queue + i, queue_len * sizeof(queue[0]));
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+init(void)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+prepare(const void *payload, unsigned short payload_len)
+{
+  if(payload_len > SIM_MAX_FRAME) {
+    return 1;
+  }
+  memcpy(tx_buf, payload, payload_len);
+  tx_len = payload_len;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Blocks until the end of the frame, as the cc2420 driver does */
+static int
+transmit(unsigned short transmit_len)
+{
+  struct sim_msg m;
+
+  m.type = SIM_MSG_TX;
+  m.time = sim_time() + SIM_TX_DELAY;
+  m.duration = frame_duration(tx_len);
+  m.channel = channel;
+  m.len = tx_len;
+  memcpy(m.data, tx_buf, tx_len);
+  /* No reception while transmitting */
+  rx_valid = 0;
+  transmitting = 1;
+  sim_send(&m);
+  sim_wait(m.time + m.duration);
+  transmitting = 0;
+  return RADIO_TX_OK;
+}
+/*---------------------------------------------------------------------------*/
+static int
+send(const void *payload, unsigned short payload_len)
+{
+  if(prepare(payload, payload_len) != 0) {
+    return RADIO_TX_ERR;
+  }
+  return transmit(payload_len);
+}
+/*---------------------------------------------------------------------------*/
+static int
+receiving_packet(void)
+{
+  return rx_valid && sim_time() < rx.time + rx.duration;
+}
+/*---------------------------------------------------------------------------*/
+static int
+pending_packet(void)
+{
+  return rx_valid && sim_time() >= rx.time + rx.duration;
+}
+/*---------------------------------------------------------------------------*/
+static int
+radio_read(void *buf, unsigned short buf_len)
+{
+  int len;
+
+  if(!pending_packet()) {
+    return 0;
+  }
+  rx_valid = 0;
+  if(rx.len > buf_len) {
+    return 0;
+  }
+  len = rx.len;
+  memcpy(buf, rx.data, len);
+  /* TSCH adds RSSI_CORRECTION_CONSTANT of cc2420 */
+  radio_last_rssi = rx.rssi + 45;
+  radio_last_correlation = 108;
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+static int
+channel_clear(void)
+{
+  return !receiving_packet();
+}
+/*---------------------------------------------------------------------------*/
+static int
+on(void)
+{
+  radio_on = 1;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+off(void)
+{
+  if(radio_on) {
+    radio_on = 0;
+    /* A frame still on air is lost, a received one is kept */
+    if(receiving_packet()) {
+      rx_valid = 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+sim_radio_set_channel(int c)
+{
+  if(c != channel) {
+    channel = c;
+    rx_valid = 0;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+sim_radio_get_channel(void)
+{
+  return channel;
+}
+/*---------------------------------------------------------------------------*/
+rtimer_clock_t
+sim_radio_read_sfd_timer(void)
+{
+  return (rtimer_clock_t)rx.time;
+}
+/*---------------------------------------------------------------------------*/
+static radio_result_t
+get_value(radio_param_t param, radio_value_t *value)
+{
+  switch(param) {
+  case RADIO_PARAM_POWER_MODE:
+    *value = radio_on ? RADIO_POWER_MODE_ON : RADIO_POWER_MODE_OFF;
+    return RADIO_RESULT_OK;
+  case RADIO_PARAM_CHANNEL:
+    *value = channel;
+    return RADIO_RESULT_OK;
+  default:
+    return RADIO_RESULT_NOT_SUPPORTED;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static radio_result_t
+set_value(radio_param_t param, radio_value_t value)
+{
+  switch(param) {
+  case RADIO_PARAM_POWER_MODE:
+    if(value == RADIO_POWER_MODE_ON) {
+      on();
+    } else {
+      off();
+    }
+    return RADIO_RESULT_OK;
+  case RADIO_PARAM_CHANNEL:
+    if(value < 11 || value > 26) {
+      return RADIO_RESULT_INVALID_VALUE;
+    }
+    sim_radio_set_channel(value);
+    return RADIO_RESULT_OK;
+  default:
+    return RADIO_RESULT_NOT_SUPPORTED;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static radio_result_t
+get_object(radio_param_t param, void *dest, size_t size)
+{
+  return RADIO_RESULT_NOT_SUPPORTED;
+}
+/*---------------------------------------------------------------------------*/
+static radio_result_t
+set_object(radio_param_t param, const void *src, size_t size)
+{
+  return RADIO_RESULT_NOT_SUPPORTED;
+}
+/*---------------------------------------------------------------------------*/
+const struct radio_driver sim_radio_driver =
+  {
+    init,
+    prepare,
+    transmit,
+    send,
+    radio_read,
+    channel_clear,
+    receiving_packet,
+    pending_packet,
+    on,
+    off,
+    get_value,
+    set_value,
+    get_object,
+    set_object
+  };
+/*---------------------------------------------------------------------------*/
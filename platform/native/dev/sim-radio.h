@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Simulated radio of the native simulation (NATIVE_SIM=1). Frames
+ *         go through tools/tsch-sim, which delivers them to the neighbors
+ *         as its topology file says, ahead of time. The radio receives
+ *         them when they start, if it listens on their channel and is not
+ *         busy with another frame. The radio is polled, as TSCH does:
+ *         frames do not wake processes up.
+ */
+
+#ifndef SIM_RADIO_H
+#define SIM_RADIO_H
+
+#include "contiki.h"
+#include "dev/radio.h"
+
+extern const struct radio_driver sim_radio_driver;
+
+int sim_radio_set_channel(int channel);
+int sim_radio_get_channel(void);
+/* The SFD time of the last frame received */
+rtimer_clock_t sim_radio_read_sfd_timer(void);
+
+/************************************************************************/
+/* Generic names for special functions */
+/************************************************************************/
+
+#define NETSTACK_RADIO_address_decode(E)
+#define NETSTACK_RADIO_set_interrupt_enable(E)
+#define NETSTACK_RADIO_sfd_sync(S,E)
+#define NETSTACK_RADIO_read_sfd_timer()         sim_radio_read_sfd_timer()
+#define NETSTACK_RADIO_set_channel(C)           sim_radio_set_channel((C))
+#define NETSTACK_RADIO_get_channel()            sim_radio_get_channel()
+#define NETSTACK_RADIO_radio_raw_rx_on()        sim_radio_driver.on();
+
+#endif /* SIM_RADIO_H */
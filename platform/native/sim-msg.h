@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Messages between the nodes of a native simulation (NATIVE_SIM=1)
+ *         and tools/tsch-sim, which runs them. Every node is a process of
+ *         its own, connected to tsch-sim through a SOCK_SEQPACKET socket,
+ *         one message per packet. Stand-alone, so that tsch-sim can
+ *         include it.
+ *
+ *         Time is virtual, in ticks of SIM_SECOND, shared by all nodes.
+ *         A node runs until it has nothing to do before a given time, then
+ *         sends SIM_MSG_WAIT and blocks until tsch-sim answers with
+ *         SIM_MSG_GO. tsch-sim advances the time to the earliest wakeup of
+ *         all nodes.
+ *
+ *         A frame starts SIM_TX_DELAY after the node decides to send it,
+ *         which gives the nodes a lookahead: frames starting before
+ *         SIM_TX_DELAY from the earliest wakeup are all known. tsch-sim
+ *         delivers them to the neighbors, which then run up to that
+ *         horizon on their own, and decide whether they received the
+ *         frames as their time reaches them.
+ */
+
+#ifndef SIM_MSG_H
+#define SIM_MSG_H
+
+#include <stdint.h>
+
+/* Virtual ticks per second: the rtimer of sky/z1, whose timing TSCH uses */
+#define SIM_SECOND 32768
+
+/* From the transmit call to the SFD, as delayTx of TSCH with cc2420 */
+#define SIM_TX_DELAY 15
+
+/* Environment variables set by tsch-sim for every node */
+#define SIM_ENV_FD "SIM_FD"
+#define SIM_ENV_NODE_ID "SIM_NODE_ID"
+
+#define SIM_MAX_FRAME 127
+
+/* Node to tsch-sim: wake me up at time */
+#define SIM_MSG_WAIT  1
+/* tsch-sim to node: it is now time, run until horizon */
+#define SIM_MSG_GO    2
+/* Node to tsch-sim: a frame starts at time, on channel */
+#define SIM_MSG_TX    3
+/* tsch-sim to node: a frame from a neighbor starts at time, on channel */
+#define SIM_MSG_RX    4
+
+struct sim_msg {
+  /* WAIT, GO: wakeup time. TX, RX: start of the frame (SFD) */
+  uint64_t time;
+  /* GO: the node can run until then without waiting */
+  uint64_t horizon;
+  /* TX, RX: time on air */
+  uint32_t duration;
+  uint8_t type;
+  uint8_t channel;
+  /* RX: in dBm */
+  int8_t rssi;
+  uint8_t len;
+  uint8_t data[SIM_MAX_FRAME];
+};
+
+#endif /* SIM_MSG_H */
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Native simulation: virtual time and connection to tools/tsch-sim
+ */
+
+#include "contiki.h"
+#include "sys/etimer.h"
+#include "sys/rtimer.h"
+#include "sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+
+/* Socket to tsch-sim */
+static int sim_fd = -1;
+/* The virtual time, and until when we may advance it without tsch-sim */
+static uint64_t now;
+static uint64_t horizon;
+/* The next rtimer, in virtual time */
+static uint64_t rtimer_time;
+static uint8_t rtimer_pending;
+/* Set while the rtimer runs, which nothing preempts */
+static uint8_t in_rtimer;
+
+/*---------------------------------------------------------------------------*/
+uint16_t
+sim_init(void)
+{
+  const char *fd = getenv(SIM_ENV_FD);
+  const char *id = getenv(SIM_ENV_NODE_ID);
+
+  if(fd == NULL || id == NULL) {
+    fprintf(stderr, "sim: to be started by tools/tsch-sim\n");
+    exit(1);
+  }
+  sim_fd = atoi(fd);
+  return atoi(id);
+}
+/*---------------------------------------------------------------------------*/
+uint64_t
+sim_time(void)
+{
+  return now;
+}
+/*---------------------------------------------------------------------------*/
+void
+sim_send(struct sim_msg *m)
+{
+  if(send(sim_fd, m, sizeof(*m), 0) != sizeof(*m)) {
+    /* tsch-sim is gone: the simulation is over */
+    exit(0);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_rtimer(void)
+{
+  while(rtimer_pending && !in_rtimer && rtimer_time <= now) {
+    rtimer_pending = 0;
+    in_rtimer = 1;
+    rtimer_run_next();
+    in_rtimer = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Blocks until tsch-sim lets us run at time t, receiving frames meanwhile.
+ * Before the horizon, no frame we do not know of yet can start */
+static void
+wait_until(uint64_t t)
+{
+  struct sim_msg m;
+
+  if(t < horizon) {
+    now = t;
+    sim_radio_update();
+    return;
+  }
+  m.type = SIM_MSG_WAIT;
+  m.time = t;
+  sim_send(&m);
+  do {
+    if(recv(sim_fd, &m, sizeof(m), 0) != sizeof(m)) {
+      exit(0);
+    }
+    if(m.type == SIM_MSG_RX) {
+      sim_radio_input(&m);
+    }
+  } while(m.type != SIM_MSG_GO);
+  now = m.time;
+  horizon = m.horizon;
+  sim_radio_update();
+}
+/*---------------------------------------------------------------------------*/
+void
+sim_wait(uint64_t t)
+{
+  uint64_t next;
+
+  do {
+    run_rtimer();
+    next = t;
+    if(rtimer_pending && !in_rtimer && rtimer_time < next) {
+      next = rtimer_time;
+    }
+    if(next > now) {
+      wait_until(next);
+    }
+  } while(now < t);
+  run_rtimer();
+}
+/*---------------------------------------------------------------------------*/
+void
+sim_idle(void)
+{
+  uint64_t t = UINT64_MAX;
+
+  if(etimer_pending()) {
+    /* The first tick at which clock_time() reaches the expiration time */
+    t = ((uint64_t)etimer_next_expiration_time() * SIM_SECOND + CLOCK_SECOND - 1)
+        / CLOCK_SECOND;
+  }
+  sim_wait(t > now ? t : now);
+  etimer_request_poll();
+}
+/*---------------------------------------------------------------------------*/
+void
+sim_rtimer_schedule(rtimer_clock_t t)
+{
+  rtimer_clock_t delta = t - (rtimer_clock_t)now;
+
+  /* Run as soon as possible if in the past, as RTIMER_CLOCK_LT sees it */
+  if(RTIMER_CLOCK_LT(t, (rtimer_clock_t)now)) {
+    delta = 0;
+  }
+  rtimer_time = now + delta;
+  rtimer_pending = 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Reading the time takes a tick, so that busy-waits end */
+rtimer_clock_t
+sim_rtimer_now(void)
+{
+  sim_wait(now + 1);
+  return (rtimer_clock_t)now;
+}
+/*---------------------------------------------------------------------------*/
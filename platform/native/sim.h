@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Native simulation (NATIVE_SIM=1): the node runs in virtual time,
+ *         driven by tools/tsch-sim, with the simulated radio of
+ *         dev/sim-radio.c. The clock and rtimer follow the virtual time.
+ *         Processes take no time; every read of the rtimer takes a tick,
+ *         which ends busy-waits. The rtimer preempts processes as an
+ *         interrupt would, whenever the time advances.
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include "contiki-conf.h"
+#include "sys/rtimer.h"
+#include "sim-msg.h"
+
+/* Connects to tsch-sim. Returns our node id */
+uint16_t sim_init(void);
+/* The virtual time, in SIM_SECOND ticks */
+uint64_t sim_time(void);
+/* Blocks until the virtual time reaches t, running the rtimer when due */
+void sim_wait(uint64_t t);
+/* From the main loop, when no process is runnable: waits for the next
+ * etimer or rtimer */
+void sim_idle(void);
+/* Sends a message to tsch-sim */
+void sim_send(struct sim_msg *m);
+
+/* Called by rtimer-arch.c */
+void sim_rtimer_schedule(rtimer_clock_t t);
+rtimer_clock_t sim_rtimer_now(void);
+
+/* Implemented by the radio driver: for every frame received from tsch-sim,
+ * before it starts, and whenever the time advances */
+void sim_radio_input(const struct sim_msg *m);
+void sim_radio_update(void);
+
+#endif /* SIM_H */
@@ -450,6 +450,10 @@ main(int argc, char **argv)
       }
 #endif
 
+#if CLOCK_CONF_TICKLESS
+      clock_tickless_idle();
+#endif /* CLOCK_CONF_TICKLESS */
+
       /* Re-enable interrupts and go to sleep atomically. */
       ENERGEST_OFF(ENERGEST_TYPE_CPU);
       ENERGEST_ON(ENERGEST_TYPE_LPM);
@@ -83,6 +83,7 @@ import org.jfree.chart.axis.NumberAxis;
 import org.jfree.chart.axis.ValueAxis;
 import org.contikios.contiki.collect.gui.AggregatedTimeChartPanel;
 import org.contikios.contiki.collect.gui.BarChartPanel;
+import org.contikios.contiki.collect.gui.FleetPanel;
 import org.contikios.contiki.collect.gui.MapPanel;
 import org.contikios.contiki.collect.gui.NodeControl;
 import org.contikios.contiki.collect.gui.NodeInfoPanel;
@@ -121,6 +122,8 @@ public class CollectServer implements SerialConnectionListener {
   private Hashtable<String,Node> nodeTable = new Hashtable<String,Node>();
   private Node[] nodeCache;
 
+  private final NetworkStats networkStats = new NetworkStats();
+
   private JFrame window;
   private JTabbedPane mainPanel;
   private HashMap<String,JTabbedPane> categoryTable = new HashMap<String,JTabbedPane>();
@@ -598,6 +601,7 @@ public class CollectServer implements SerialConnectionListener {
           }
         },
         new NodeInfoPanel(this, MAIN),
+        new FleetPanel(this, MAIN, "RPL/TSCH Fleet"),
         serialConsole
     };
     for (int i = 0, n = visualizers.length; i < n; i++) {
@@ -982,6 +986,10 @@ public class CollectServer implements SerialConnectionListener {
     return getNode(nodeID, true);
   }
 
+  public NetworkStats getNetworkStats() {
+    return networkStats;
+  }
+
   private Node getNode(final String nodeID, boolean notify) {
     Node node = nodeTable.get(nodeID);
     if (node == null) {
@@ -1139,6 +1147,8 @@ public class CollectServer implements SerialConnectionListener {
       handleSensorData(sensorData);
       return;
     }
+    // RPL/TSCH statistics of the deployment application, also shown in the console
+    networkStats.parseLine(line, systemTime);
     System.out.println("SERIAL: " + line);
     serialConsole.addSerialData(line);
   }
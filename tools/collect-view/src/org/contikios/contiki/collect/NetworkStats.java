@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ *
+ * -----------------------------------------------------------------
+ *
+ * NetworkStats
+ */
+
+package org.contikios.contiki.collect;
+import java.util.Arrays;
+import java.util.Comparator;
+import java.util.HashMap;
+import java.util.regex.Matcher;
+import java.util.regex.Pattern;
+
+/**
+ * Per-node RPL and TSCH statistics from the periodic text logs of the
+ * deployment application (apps/deployment/deployment-log.c), for
+ * networks of any size. Uses the following lines:
+ *   Duty Cycle: [id cnt] tx +rx /time: duty cycle
+ *   Duty Cycle TSCH: [id] sf handle tx rx idle: per-slotframe radio time
+ *   RPL: rank r dioint i, p/n nbr and RPL: nbr ...: rank, parent and ETX
+ *   RPL: parent switch: parent switches
+ *   TSCH-queue: nbr ...: queue length and drops
+ *   TSCH: {asn-.. link-sf-..} .. tx|rx: per-slotframe tx and rx slots
+ * Only the two first include the node id. For the others, the id is
+ * taken from the "ID:" prefix of the line, as in Cooja and testbed logs,
+ * or else is the id of the last Duty Cycle line, as printed first by
+ * every node on its own serial line.
+ */
+public class NetworkStats {
+
+  private static final Pattern DUTY_CYCLE =
+    Pattern.compile("Duty Cycle: \\[(\\d+) \\d+\\]\\s+(\\d+) \\+\\s*(\\d+) /\\s*(\\d+)");
+  private static final Pattern DUTY_CYCLE_TSCH =
+    Pattern.compile("Duty Cycle TSCH: \\[(\\d+)\\] sf (\\d+)\\s+(\\d+)\\s+(\\d+)\\s+(\\d+)");
+  private static final Pattern RPL_RANK =
+    Pattern.compile("RPL: rank (\\d+) dioint (\\d+), \\d+/(\\d+) nbr");
+  private static final Pattern RPL_NBR =
+    Pattern.compile("RPL: nbr\\s+(\\d+)\\s+\\d+,\\s+(\\d+) =>\\s+\\d+ \\*");
+  private static final Pattern RPL_SWITCH =
+    Pattern.compile("RPL: parent switch (\\d+) -> (\\d+)");
+  private static final Pattern QUEUE =
+    Pattern.compile("TSCH-queue: nbr \\d+ len (\\d+) max (\\d+) .* drop-full (\\d+) drop-retries (\\d+) drop-aqm (\\d+), sojourn avg \\d+ max (\\d+)");
+  private static final Pattern TSCH_LINK =
+    Pattern.compile("TSCH: \\{asn-\\S+ link-(\\d+)-\\S+ ch-\\d+\\} [bu]c-\\d+ \\d+ (tx|rx) ");
+  private static final Pattern ID =
+    Pattern.compile("ID:(\\d+)");
+
+  private final HashMap<Integer,NodeStats> nodeTable = new HashMap<Integer,NodeStats>();
+  private NodeStats[] nodeCache;
+  private int lastID = -1;
+  private int version;
+
+  /**
+   * Parse a log line.
+   * @return true if the line had statistics
+   */
+  public synchronized boolean parseLine(String line, long systemTime) {
+    NodeStats node;
+    Matcher m;
+
+    if (line.indexOf("Duty Cycle") >= 0) {
+      if ((m = DUTY_CYCLE.matcher(line)).find()) {
+        node = getNode(Integer.parseInt(m.group(1)));
+        node.radioTx = Long.parseLong(m.group(2));
+        node.radioRx = Long.parseLong(m.group(3));
+        node.radioTime = Long.parseLong(m.group(4));
+        node.dutyCycleReports++;
+        /* The queue statistics of this period follow */
+        node.isNewQueueReport = true;
+      } else if ((m = DUTY_CYCLE_TSCH.matcher(line)).find()) {
+        node = getNode(Integer.parseInt(m.group(1)));
+        long[] sf = node.getSlotframe(Integer.parseInt(m.group(2)));
+        sf[NodeStats.SF_RADIO_TX] = Long.parseLong(m.group(3));
+        sf[NodeStats.SF_RADIO_RX] = Long.parseLong(m.group(4));
+        sf[NodeStats.SF_RADIO_IDLE] = Long.parseLong(m.group(5));
+      } else {
+        return false;
+      }
+      lastID = node.getID();
+    } else if (line.indexOf("RPL: ") >= 0) {
+      if ((m = RPL_RANK.matcher(line)).find()) {
+        node = getLineNode(line);
+        if (node == null) {
+          return false;
+        }
+        node.rank = Integer.parseInt(m.group(1));
+        node.dioInterval = Integer.parseInt(m.group(2));
+        node.rplNeighbors = Integer.parseInt(m.group(3));
+        /* Set again by the neighbor list, if there is a parent */
+        node.parent = -1;
+        node.parentLinkMetric = -1;
+      } else if ((m = RPL_NBR.matcher(line)).find()) {
+        node = getLineNode(line);
+        if (node == null) {
+          return false;
+        }
+        node.parent = Integer.parseInt(m.group(1));
+        node.parentLinkMetric = Integer.parseInt(m.group(2));
+      } else if ((m = RPL_SWITCH.matcher(line)).find()) {
+        node = getLineNode(line);
+        if (node == null) {
+          return false;
+        }
+        node.parentSwitches++;
+        node.parent = Integer.parseInt(m.group(2));
+      } else {
+        return false;
+      }
+    } else if (line.indexOf("TSCH-queue: nbr") >= 0) {
+      if (!(m = QUEUE.matcher(line)).find()
+          || (node = getLineNode(line)) == null) {
+        return false;
+      }
+      if (node.isNewQueueReport || node.queueLength < 0) {
+        node.isNewQueueReport = false;
+        node.queueLength = node.queueMax = node.queueDrops = 0;
+        node.sojournMax = 0;
+      }
+      node.queueLength += Integer.parseInt(m.group(1));
+      node.queueMax = Math.max(node.queueMax, Integer.parseInt(m.group(2)));
+      node.queueDrops += Integer.parseInt(m.group(3))
+          + Integer.parseInt(m.group(4)) + Integer.parseInt(m.group(5));
+      node.sojournMax = Math.max(node.sojournMax, Long.parseLong(m.group(6)));
+    } else if (line.indexOf("TSCH: {asn-") >= 0) {
+      if (!(m = TSCH_LINK.matcher(line)).find()
+          || (node = getLineNode(line)) == null) {
+        return false;
+      }
+      long[] sf = node.getSlotframe(Integer.parseInt(m.group(1)));
+      if ("tx".equals(m.group(2))) {
+        sf[NodeStats.SF_SLOTS_TX]++;
+      } else {
+        sf[NodeStats.SF_SLOTS_RX]++;
+      }
+    } else {
+      return false;
+    }
+    node.lastUpdate = systemTime;
+    version++;
+    return true;
+  }
+
+  private NodeStats getLineNode(String line) {
+    Matcher m = ID.matcher(line);
+    if (m.find()) {
+      return getNode(Integer.parseInt(m.group(1)));
+    }
+    return lastID >= 0 ? getNode(lastID) : null;
+  }
+
+  private NodeStats getNode(int id) {
+    NodeStats node = nodeTable.get(id);
+    if (node == null) {
+      node = new NodeStats(id);
+      nodeTable.put(id, node);
+      nodeCache = null;
+    }
+    return node;
+  }
+
+  /** Incremented every time statistics are received */
+  public synchronized int getVersion() {
+    return version;
+  }
+
+  public synchronized int getNodeCount() {
+    return nodeTable.size();
+  }
+
+  /** A copy of the statistics of all nodes, sorted by id */
+  public synchronized NodeStats[] getNodes() {
+    if (nodeCache == null) {
+      NodeStats[] tmp = nodeTable.values().toArray(new NodeStats[nodeTable.size()]);
+      Arrays.sort(tmp, new Comparator<NodeStats>() {
+        public int compare(NodeStats a, NodeStats b) {
+          return a.getID() - b.getID();
+        }
+      });
+      nodeCache = tmp;
+    }
+    NodeStats[] copy = new NodeStats[nodeCache.length];
+    for (int i = 0; i < copy.length; i++) {
+      copy[i] = nodeCache[i].clone();
+    }
+    return copy;
+  }
+
+  public synchronized void clear() {
+    nodeTable.clear();
+    nodeCache = null;
+    lastID = -1;
+    version++;
+  }
+
+}
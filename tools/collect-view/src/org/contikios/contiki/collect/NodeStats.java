@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ *
+ * -----------------------------------------------------------------
+ *
+ * NodeStats
+ */
+
+package org.contikios.contiki.collect;
+import java.util.Map;
+import java.util.TreeMap;
+
+/**
+ * The last RPL and TSCH statistics reported by a node of a deployment
+ * (apps/deployment), see NetworkStats. Values not reported yet are -1.
+ */
+public class NodeStats implements Cloneable {
+
+  /** Radio tx, rx and idle rx time, and tx and rx slots, of a slotframe */
+  public static final int SF_RADIO_TX = 0;
+  public static final int SF_RADIO_RX = 1;
+  public static final int SF_RADIO_IDLE = 2;
+  public static final int SF_SLOTS_TX = 3;
+  public static final int SF_SLOTS_RX = 4;
+  public static final int SF_COUNT = 5;
+
+  private final int id;
+  long lastUpdate;
+
+  /* Duty cycle of the last window, radio time in energest ticks */
+  long radioTx = -1;
+  long radioRx = -1;
+  long radioTime = -1;
+  int dutyCycleReports;
+
+  int rank = -1;
+  int dioInterval = -1;
+  int rplNeighbors = -1;
+  int parent = -1;
+  /* Link metric to the preferred parent, ETX * 256 with MRHOF */
+  int parentLinkMetric = -1;
+  int parentSwitches;
+
+  /* Queue statistics of the last report, summed over the neighbors */
+  int queueLength = -1;
+  int queueMax = -1;
+  int queueDrops = -1;
+  long sojournMax = -1;
+  boolean isNewQueueReport;
+
+  TreeMap<Integer,long[]> slotframes = new TreeMap<Integer,long[]>();
+
+  public NodeStats(int id) {
+    this.id = id;
+  }
+
+  public int getID() {
+    return id;
+  }
+
+  /** Time of the last statistics received, in system time */
+  public long getLastUpdate() {
+    return lastUpdate;
+  }
+
+  /** Radio duty cycle of the last window, in percent, or -1 */
+  public double getDutyCycle() {
+    if (radioTime <= 0) {
+      return -1;
+    }
+    return 100.0 * (radioTx + radioRx) / radioTime;
+  }
+
+  public long getRadioTime() {
+    return radioTime;
+  }
+
+  public int getDutyCycleReports() {
+    return dutyCycleReports;
+  }
+
+  public int getRank() {
+    return rank;
+  }
+
+  public int getDIOInterval() {
+    return dioInterval;
+  }
+
+  public int getRPLNeighbors() {
+    return rplNeighbors;
+  }
+
+  /** The node id of the preferred parent, or -1 */
+  public int getParent() {
+    return parent;
+  }
+
+  /** ETX to the preferred parent, or -1 */
+  public double getParentETX() {
+    if (parentLinkMetric < 0) {
+      return -1;
+    }
+    return parentLinkMetric / 256.0;
+  }
+
+  public int getParentSwitches() {
+    return parentSwitches;
+  }
+
+  public int getQueueLength() {
+    return queueLength;
+  }
+
+  public int getQueueMax() {
+    return queueMax;
+  }
+
+  public int getQueueDrops() {
+    return queueDrops;
+  }
+
+  public long getSojournMax() {
+    return sojournMax;
+  }
+
+  /** The slotframe handles with statistics, and their SF_ values */
+  public Map<Integer,long[]> getSlotframes() {
+    return slotframes;
+  }
+
+  long[] getSlotframe(int handle) {
+    long[] sf = slotframes.get(handle);
+    if (sf == null) {
+      sf = new long[SF_COUNT];
+      slotframes.put(handle, sf);
+    }
+    return sf;
+  }
+
+  @Override
+  public NodeStats clone() {
+    try {
+      NodeStats copy = (NodeStats) super.clone();
+      copy.slotframes = new TreeMap<Integer,long[]>();
+      for (Map.Entry<Integer,long[]> e : slotframes.entrySet()) {
+        copy.slotframes.put(e.getKey(), e.getValue().clone());
+      }
+      return copy;
+    } catch (CloneNotSupportedException e) {
+      throw new InternalError(e.toString());
+    }
+  }
+
+  public String toString() {
+    return Integer.toString(id);
+  }
+
+}
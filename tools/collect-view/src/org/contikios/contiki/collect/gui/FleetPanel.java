@@ -0,0 +1,465 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ *
+ * -----------------------------------------------------------------
+ *
+ * FleetPanel
+ */
+
+package org.contikios.contiki.collect.gui;
+import java.awt.BorderLayout;
+import java.awt.Component;
+import java.awt.Dimension;
+import java.awt.FlowLayout;
+import java.awt.GridLayout;
+import java.awt.event.ActionEvent;
+import java.awt.event.ActionListener;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.Map;
+import java.util.TreeMap;
+import javax.swing.JComboBox;
+import javax.swing.JLabel;
+import javax.swing.JPanel;
+import javax.swing.JScrollPane;
+import javax.swing.JSplitPane;
+import javax.swing.JTabbedPane;
+import javax.swing.JTable;
+import javax.swing.Timer;
+import javax.swing.table.AbstractTableModel;
+import org.jfree.chart.ChartFactory;
+import org.jfree.chart.ChartPanel;
+import org.jfree.chart.JFreeChart;
+import org.jfree.chart.plot.PlotOrientation;
+import org.jfree.data.category.DefaultCategoryDataset;
+import org.contikios.contiki.collect.CollectServer;
+import org.contikios.contiki.collect.NetworkStats;
+import org.contikios.contiki.collect.Node;
+import org.contikios.contiki.collect.NodeStats;
+import org.contikios.contiki.collect.SensorData;
+import org.contikios.contiki.collect.Visualizer;
+
+/**
+ * Fleet-level view of the RPL and TSCH statistics of NetworkStats: the
+ * distribution of every metric over all nodes, a histogram, the totals
+ * per slotframe and a sortable table with one row per node. Nothing is
+ * drawn per node, and the view is refreshed periodically rather than for
+ * every line received, so that it scales to hundreds of nodes.
+ */
+public class FleetPanel extends JPanel implements Visualizer {
+
+  private static final long serialVersionUID = -3516221455732183062L;
+
+  /* Refresh period of the view */
+  private static final int UPDATE_INTERVAL = 2000;
+  /* Nodes not heard for this long are reported as silent (three log periods) */
+  private static final long SILENT_TIME = 3 * 60 * 1000;
+  private static final int HISTOGRAM_BINS = 20;
+
+  private static final int DUTY_CYCLE = 0;
+  private static final int RANK = 1;
+  private static final int ETX = 2;
+  private static final int NEIGHBORS = 3;
+  private static final int SWITCHES = 4;
+  private static final int QUEUE = 5;
+  private static final int DROPS = 6;
+  private static final int SOJOURN = 7;
+  private static final int AGE = 8;
+  private static final String[] METRICS = {
+    "Duty cycle (%)", "Rank", "ETX to parent", "RPL neighbors",
+    "Parent switches", "Queue length", "Queue drops", "Max sojourn",
+    "Last heard (s)"
+  };
+
+  private final NetworkStats networkStats;
+  private final String category;
+  private final String title;
+
+  private final JLabel statusLabel;
+  private final JComboBox histogramMetric;
+  private final DefaultCategoryDataset histogram;
+  private final SummaryModel summaryModel;
+  private final SlotframeModel slotframeModel;
+  private final NodeStatsModel nodeModel;
+  private final Timer timer;
+
+  private NodeStats[] nodes = new NodeStats[0];
+  private long now;
+  private int lastVersion = -1;
+
+  public FleetPanel(CollectServer server, String category, String title) {
+    super(new BorderLayout());
+    this.networkStats = server.getNetworkStats();
+    this.category = category;
+    this.title = title;
+
+    JPanel top = new JPanel(new FlowLayout(FlowLayout.LEFT));
+    statusLabel = new JLabel("No RPL/TSCH statistics received");
+    top.add(statusLabel);
+    top.add(new JLabel("   Histogram:"));
+    histogramMetric = new JComboBox(METRICS);
+    histogramMetric.addActionListener(new ActionListener() {
+      public void actionPerformed(ActionEvent e) {
+        updateHistogram();
+      }
+    });
+    top.add(histogramMetric);
+    add(top, BorderLayout.NORTH);
+
+    summaryModel = new SummaryModel();
+    JTable summaryTable = new JTable(summaryModel);
+    JScrollPane summaryPane = new JScrollPane(summaryTable);
+    summaryPane.setPreferredSize(new Dimension(450, 200));
+
+    histogram = new DefaultCategoryDataset();
+    JFreeChart chart = ChartFactory.createBarChart(null, null, "Nodes",
+        histogram, PlotOrientation.VERTICAL, false, true, false);
+    ChartPanel chartPanel = new ChartPanel(chart, false);
+    chartPanel.setPreferredSize(new Dimension(450, 200));
+
+    JPanel summaryPanel = new JPanel(new GridLayout(1, 2));
+    summaryPanel.add(summaryPane);
+    summaryPanel.add(chartPanel);
+
+    nodeModel = new NodeStatsModel();
+    JTable nodeTable = new JTable(nodeModel);
+    nodeTable.setAutoCreateRowSorter(true);
+    slotframeModel = new SlotframeModel();
+    JTable slotframeTable = new JTable(slotframeModel);
+
+    JTabbedPane tables = new JTabbedPane();
+    tables.add("Nodes", new JScrollPane(nodeTable));
+    tables.add("Slotframes", new JScrollPane(slotframeTable));
+
+    JSplitPane splitPane = new JSplitPane(JSplitPane.VERTICAL_SPLIT,
+        summaryPanel, tables);
+    splitPane.setResizeWeight(0.4);
+    add(splitPane, BorderLayout.CENTER);
+
+    timer = new Timer(UPDATE_INTERVAL, new ActionListener() {
+      public void actionPerformed(ActionEvent e) {
+        if (isShowing()) {
+          updateStats(false);
+        }
+      }
+    });
+    timer.start();
+  }
+
+  @Override
+  public String getCategory() {
+    return category;
+  }
+
+  @Override
+  public String getTitle() {
+    return title;
+  }
+
+  @Override
+  public Component getPanel() {
+    return this;
+  }
+
+  @Override
+  public void nodesSelected(Node[] node) {
+  }
+
+  @Override
+  public void nodeAdded(Node node) {
+  }
+
+  @Override
+  public void nodeDataReceived(SensorData sensorData) {
+  }
+
+  @Override
+  public void clearNodeData() {
+    networkStats.clear();
+    updateStats(true);
+  }
+
+  private void updateStats(boolean force) {
+    int version = networkStats.getVersion();
+    long time = System.currentTimeMillis();
+    /* The ages change even without new statistics */
+    if (!force && version == lastVersion && time - now < 10 * UPDATE_INTERVAL) {
+      return;
+    }
+    lastVersion = version;
+    now = time;
+    nodes = networkStats.getNodes();
+
+    int silent = 0, orphans = 0;
+    for (NodeStats n : nodes) {
+      if (now - n.getLastUpdate() > SILENT_TIME) {
+        silent++;
+      }
+      if (n.getRank() >= 0 && n.getParent() < 0) {
+        orphans++;
+      }
+    }
+    if (nodes.length > 0) {
+      statusLabel.setText(nodes.length + " nodes, " + silent + " silent for "
+          + (SILENT_TIME / 60000) + " min, " + orphans + " without parent");
+    } else {
+      statusLabel.setText("No RPL/TSCH statistics received");
+    }
+    summaryModel.update();
+    slotframeModel.update();
+    nodeModel.fireTableDataChanged();
+    updateHistogram();
+  }
+
+  /* The values of a metric for all nodes that reported it */
+  private double[] getValues(int metric) {
+    double[] values = new double[nodes.length];
+    int count = 0;
+    for (NodeStats n : nodes) {
+      double v = getValue(n, metric);
+      if (v >= 0) {
+        values[count++] = v;
+      }
+    }
+    values = Arrays.copyOf(values, count);
+    Arrays.sort(values);
+    return values;
+  }
+
+  private double getValue(NodeStats n, int metric) {
+    switch (metric) {
+    case DUTY_CYCLE: return n.getDutyCycle();
+    case RANK: return n.getRank();
+    case ETX: return n.getParentETX();
+    case NEIGHBORS: return n.getRPLNeighbors();
+    case SWITCHES: return n.getRank() >= 0 ? n.getParentSwitches() : -1;
+    case QUEUE: return n.getQueueLength();
+    case DROPS: return n.getQueueDrops();
+    case SOJOURN: return n.getSojournMax();
+    case AGE: return (now - n.getLastUpdate()) / 1000;
+    }
+    return -1;
+  }
+
+  private static double percentile(double[] sorted, double p) {
+    if (sorted.length == 0) {
+      return -1;
+    }
+    int i = (int) Math.ceil(p * sorted.length) - 1;
+    return sorted[Math.max(0, Math.min(sorted.length - 1, i))];
+  }
+
+  private static String format(double v) {
+    if (v < 0) {
+      return "-";
+    }
+    if (v == Math.rint(v) && v < 1e9) {
+      return Long.toString((long) v);
+    }
+    return String.format("%.2f", v);
+  }
+
+  private void updateHistogram() {
+    int metric = histogramMetric.getSelectedIndex();
+    double[] values = getValues(metric);
+    histogram.clear();
+    if (values.length == 0) {
+      return;
+    }
+    double min = values[0];
+    double max = values[values.length - 1];
+    int[] bins = new int[HISTOGRAM_BINS];
+    double width = (max - min) / HISTOGRAM_BINS;
+    for (double v : values) {
+      int bin = width > 0 ? (int) ((v - min) / width) : 0;
+      bins[Math.min(bin, HISTOGRAM_BINS - 1)]++;
+    }
+    int nbins = width > 0 ? HISTOGRAM_BINS : 1;
+    for (int i = 0; i < nbins; i++) {
+      histogram.addValue(bins[i], METRICS[metric],
+          format(min + i * width));
+    }
+  }
+
+  private class SummaryModel extends AbstractTableModel {
+
+    private static final long serialVersionUID = 3577160058542553527L;
+
+    private final String[] columns = {
+      "Metric", "Nodes", "Min", "Mean", "Median", "90th", "Max"
+    };
+    private final Object[][] rows = new Object[METRICS.length][];
+
+    void update() {
+      for (int i = 0; i < METRICS.length; i++) {
+        double[] values = getValues(i);
+        double sum = 0;
+        for (double v : values) {
+          sum += v;
+        }
+        rows[i] = new Object[] {
+          METRICS[i], values.length,
+          format(percentile(values, 0)),
+          format(values.length > 0 ? sum / values.length : -1),
+          format(percentile(values, 0.5)),
+          format(percentile(values, 0.9)),
+          format(percentile(values, 1))
+        };
+      }
+      fireTableDataChanged();
+    }
+
+    public int getColumnCount() {
+      return columns.length;
+    }
+
+    public String getColumnName(int column) {
+      return columns[column];
+    }
+
+    public int getRowCount() {
+      return rows[0] == null ? 0 : rows.length;
+    }
+
+    public Object getValueAt(int row, int column) {
+      return rows[row][column];
+    }
+  }
+
+  private class SlotframeModel extends AbstractTableModel {
+
+    private static final long serialVersionUID = -3141886744684564999L;
+
+    private final String[] columns = {
+      "Slotframe", "Nodes", "Radio tx", "Radio rx", "Idle rx", "Radio share (%)",
+      "Tx slots", "Rx slots"
+    };
+    private final ArrayList<Object[]> rows = new ArrayList<Object[]>();
+
+    void update() {
+      TreeMap<Integer,long[]> total = new TreeMap<Integer,long[]>();
+      TreeMap<Integer,Integer> count = new TreeMap<Integer,Integer>();
+      long radio = 0;
+      for (NodeStats n : nodes) {
+        for (Map.Entry<Integer,long[]> e : n.getSlotframes().entrySet()) {
+          long[] t = total.get(e.getKey());
+          if (t == null) {
+            t = new long[NodeStats.SF_COUNT];
+            total.put(e.getKey(), t);
+            count.put(e.getKey(), 0);
+          }
+          long[] sf = e.getValue();
+          for (int i = 0; i < NodeStats.SF_COUNT; i++) {
+            t[i] += sf[i];
+          }
+          count.put(e.getKey(), count.get(e.getKey()) + 1);
+          radio += sf[NodeStats.SF_RADIO_TX] + sf[NodeStats.SF_RADIO_RX]
+              + sf[NodeStats.SF_RADIO_IDLE];
+        }
+      }
+      rows.clear();
+      for (Map.Entry<Integer,long[]> e : total.entrySet()) {
+        long[] t = e.getValue();
+        long on = t[NodeStats.SF_RADIO_TX] + t[NodeStats.SF_RADIO_RX]
+            + t[NodeStats.SF_RADIO_IDLE];
+        rows.add(new Object[] {
+          e.getKey(), count.get(e.getKey()),
+          t[NodeStats.SF_RADIO_TX], t[NodeStats.SF_RADIO_RX],
+          t[NodeStats.SF_RADIO_IDLE],
+          format(radio > 0 ? 100.0 * on / radio : -1),
+          t[NodeStats.SF_SLOTS_TX], t[NodeStats.SF_SLOTS_RX]
+        });
+      }
+      fireTableDataChanged();
+    }
+
+    public int getColumnCount() {
+      return columns.length;
+    }
+
+    public String getColumnName(int column) {
+      return columns[column];
+    }
+
+    public int getRowCount() {
+      return rows.size();
+    }
+
+    public Object getValueAt(int row, int column) {
+      return rows.get(row)[column];
+    }
+  }
+
+  private class NodeStatsModel extends AbstractTableModel {
+
+    private static final long serialVersionUID = 1900543259216561127L;
+
+    private final String[] columns = {
+      "Node", "Last heard (s)", "Duty cycle (%)", "Rank", "Parent",
+      "ETX", "Neighbors", "Switches", "Queue", "Queue max", "Drops"
+    };
+
+    public int getColumnCount() {
+      return columns.length;
+    }
+
+    public String getColumnName(int column) {
+      return columns[column];
+    }
+
+    public Class<?> getColumnClass(int column) {
+      return column == 2 || column == 5 ? Double.class : Long.class;
+    }
+
+    public int getRowCount() {
+      return nodes.length;
+    }
+
+    public Object getValueAt(int row, int column) {
+      NodeStats n = nodes[row];
+      switch (column) {
+      case 0: return (long) n.getID();
+      case 1: return (now - n.getLastUpdate()) / 1000;
+      case 2: return Math.rint(n.getDutyCycle() * 100) / 100;
+      case 3: return (long) n.getRank();
+      case 4: return (long) n.getParent();
+      case 5: return Math.rint(n.getParentETX() * 100) / 100;
+      case 6: return (long) n.getRPLNeighbors();
+      case 7: return (long) n.getParentSwitches();
+      case 8: return (long) n.getQueueLength();
+      case 9: return (long) n.getQueueMax();
+      case 10: return (long) n.getQueueDrops();
+      }
+      return null;
+    }
+  }
+
+}
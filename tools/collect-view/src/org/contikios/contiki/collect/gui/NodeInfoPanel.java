@@ -134,6 +134,11 @@ public class NodeInfoPanel extends JPanel implements Visualizer, Configurable {
             return node.getSensorDataAggregator().getAverageBestNeighborETX();
           }
         },
+        new TableData("Queue", "Average Forwarding Queue Occupancy (%)", Double.class) {
+          public Object getValue(Node node) {
+            return node.getSensorDataAggregator().getAverageValue(SensorData.QUEUE);
+          }
+        },
         new TableData("Churn", "Next Hop Change Count", Number.class) {
           public Object getValue(Node node) {
             return node.getSensorDataAggregator().getNextHopChangeCount();
@@ -0,0 +1,549 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+import java.awt.BorderLayout;
+import java.awt.Color;
+import java.awt.Dimension;
+import java.awt.Graphics;
+import java.awt.Toolkit;
+import java.awt.datatransfer.Clipboard;
+import java.awt.datatransfer.StringSelection;
+import java.awt.event.ActionEvent;
+import java.awt.event.ActionListener;
+import java.awt.event.MouseEvent;
+import java.util.ArrayList;
+import java.util.Collection;
+import java.util.LinkedHashMap;
+import java.util.Map;
+import java.util.TreeMap;
+import java.util.regex.Matcher;
+import java.util.regex.Pattern;
+
+import javax.swing.AbstractAction;
+import javax.swing.Action;
+import javax.swing.Box;
+import javax.swing.JButton;
+import javax.swing.JComboBox;
+import javax.swing.JPanel;
+import javax.swing.JScrollPane;
+import javax.swing.Timer;
+
+import org.apache.log4j.Logger;
+import org.jdom.Element;
+
+import org.contikios.cooja.ClassDescription;
+import org.contikios.cooja.Cooja;
+import org.contikios.cooja.Mote;
+import org.contikios.cooja.PluginType;
+import org.contikios.cooja.SimEventCentral.LogOutputEvent;
+import org.contikios.cooja.SimEventCentral.LogOutputListener;
+import org.contikios.cooja.Simulation;
+import org.contikios.cooja.VisPlugin;
+
+/**
+ * Shows the TSCH schedule of every mote, and how it is used.
+ *
+ * The motes are followed through their log output, with no change to
+ * the firmware:
+ * - the text TSCH logs of core/net/mac/tsch/tsch-log.c, for every
+ *   transmission and reception, with its ASN, link and channel;
+ * - tsch_schedule_print(), which gives the whole schedule, and the
+ *   add_link/remove_link messages of tsch-schedule.c with DEBUG, which
+ *   keep it up to date. A link that shows up in a TSCH log is taken as
+ *   scheduled too.
+ *
+ * For every cell (slotframe, timeslot, channel offset) it counts the
+ * transmissions, their outcome, the receptions, and the conflicts: the
+ * times when another mote transmitted in the same ASN on the same
+ * channel, e.g. because of overlapping Orchestra slotframes. The
+ * utilization of a cell is the share of its slotframe cycles, since the
+ * first log of the mote, in which it was used. Like PowerTracker, the
+ * statistics can be read from a test script with statistics().
+ */
+@ClassDescription("TSCH schedule viewer")
+@PluginType(PluginType.SIM_PLUGIN)
+public class TSCHScheduleViewer extends VisPlugin {
+  private static Logger logger = Logger.getLogger(TSCHScheduleViewer.class);
+
+  private static final int UPDATE_INTERVAL = 500; /* ms */
+
+  /* Conflicts are looked for among the transmissions of the last
+   * CONFLICT_WINDOW slots, as the motes log with some delay */
+  private static final long CONFLICT_WINDOW = 1000;
+
+  /* Transmission status, see core/net/mac/mac.h */
+  private static final int MAC_TX_OK = 0;
+  private static final int MAC_TX_COLLISION = 1;
+  private static final int MAC_TX_NOACK = 2;
+
+  /* Link options, see core/net/mac/tsch/tsch-schedule.h */
+  private static final int LINK_OPTION_TX = 1;
+  private static final int LINK_OPTION_RX = 2;
+  private static final int LINK_OPTION_SHARED = 4;
+
+  private static final int CELL_SIZE = 10;
+  private static final int ROW_CELLS = 64;
+
+  private static final Pattern TSCH_LOG = Pattern.compile(
+      "TSCH: \\{asn-([0-9a-f]+)\\.([0-9a-f]+) link-(\\d+)-(\\d+)-(\\d+)-(\\d+) ch-(\\d+)\\} " +
+      "(bc|uc)-\\d+ \\d+ (tx|rx) (\\d+)(?:, st (\\d+)-(\\d+))?");
+  private static final Pattern SCHEDULE_START = Pattern.compile("Schedule: slotframe list");
+  private static final Pattern SCHEDULE_SLOTFRAME = Pattern.compile(
+      "\\[Slotframe\\] Handle (\\d+), size (\\d+)");
+  private static final Pattern SCHEDULE_LINK = Pattern.compile(
+      "\\[Link\\] Options ([0-9a-f]+), type \\d+, timeslot (\\d+), channel offset (\\d+), address (\\d+)");
+  private static final Pattern ADD_LINK = Pattern.compile(
+      "TSCH-schedule: add_link (\\d+) (\\d+) (\\d+) (\\d+) (\\d+)");
+  private static final Pattern REMOVE_LINK = Pattern.compile(
+      "TSCH-schedule: remove_link (\\d+) (\\d+) (\\d+) (\\d+) (\\d+)");
+
+  private Simulation simulation;
+  private LogOutputListener logOutputListener;
+
+  /* All state below is shared with the simulation thread */
+  private Map<Mote, NodeSchedule> nodes = new LinkedHashMap<Mote, NodeSchedule>();
+  /* Recent transmissions, by ASN and channel */
+  private TreeMap<Long, Cell> recentTx = new TreeMap<Long, Cell>();
+  private long maxAsn = 0;
+
+  private JComboBox moteBox;
+  private SchedulePanel schedulePanel;
+
+  public TSCHScheduleViewer(final Simulation simulation, final Cooja gui) {
+    super("TSCH schedule", gui, false);
+    this.simulation = simulation;
+
+    simulation.getEventCentral().addLogOutputListener(logOutputListener = new LogOutputListener() {
+      public void moteWasAdded(Mote mote) {
+        synchronized (TSCHScheduleViewer.this) {
+          nodes.put(mote, new NodeSchedule(mote));
+        }
+        updateMoteBox();
+      }
+      public void moteWasRemoved(Mote mote) {
+        synchronized (TSCHScheduleViewer.this) {
+          nodes.remove(mote);
+        }
+        updateMoteBox();
+      }
+      public void newLogOutput(LogOutputEvent ev) {
+        parse(ev.getMote(), ev.getMessage());
+      }
+      public void removedLogOutput(LogOutputEvent ev) {
+      }
+    });
+    synchronized (this) {
+      for (Mote m: simulation.getMotes()) {
+        nodes.put(m, new NodeSchedule(m));
+      }
+    }
+
+    if (!Cooja.isVisualized()) {
+      return;
+    }
+
+    moteBox = new JComboBox();
+    moteBox.addActionListener(new ActionListener() {
+      public void actionPerformed(ActionEvent e) {
+        schedulePanel.revalidate();
+        schedulePanel.repaint();
+      }
+    });
+    schedulePanel = new SchedulePanel();
+    updateMoteBox();
+
+    Box control = Box.createHorizontalBox();
+    control.add(moteBox);
+    control.add(Box.createHorizontalGlue());
+    control.add(new JButton(printAction));
+    control.add(new JButton(resetAction));
+
+    this.getContentPane().add(BorderLayout.NORTH, control);
+    this.getContentPane().add(BorderLayout.CENTER, new JScrollPane(schedulePanel));
+    setSize(ROW_CELLS * CELL_SIZE + 60, 400);
+
+    repaintTimer.start();
+  }
+
+  /* A cell of the schedule of a mote, and what was seen in it */
+  private static class Cell {
+    final NodeSchedule node;
+    final int handle;
+    final int timeslot;
+    final int channelOffset;
+    /* Link options and neighbor, or -1 if not scheduled */
+    int options = -1;
+    int neighbor = 0;
+    long tx = 0;
+    long txOk = 0;
+    long txCollision = 0;
+    long txNoAck = 0;
+    long rx = 0;
+    long conflicts = 0;
+
+    Cell(NodeSchedule node, int handle, int timeslot, int channelOffset) {
+      this.node = node;
+      this.handle = handle;
+      this.timeslot = timeslot;
+      this.channelOffset = channelOffset;
+    }
+
+    long used() {
+      return tx + rx;
+    }
+
+    String optionString() {
+      if (options < 0) {
+        return "-";
+      }
+      return ((options & LINK_OPTION_TX) != 0 ? "t" : "") +
+          ((options & LINK_OPTION_RX) != 0 ? "r" : "") +
+          ((options & LINK_OPTION_SHARED) != 0 ? "s" : "");
+    }
+  }
+
+  private static class NodeSchedule {
+    final Mote mote;
+    /* Slotframe sizes, by handle */
+    TreeMap<Integer, Integer> slotframes = new TreeMap<Integer, Integer>();
+    TreeMap<Long, Cell> cells = new TreeMap<Long, Cell>();
+    long firstAsn = -1;
+    long lastAsn = -1;
+    /* Slotframe of the links of tsch_schedule_print() */
+    int printHandle = -1;
+
+    NodeSchedule(Mote mote) {
+      this.mote = mote;
+    }
+
+    Cell getCell(int handle, int timeslot, int channelOffset) {
+      long key = ((long)handle << 32) | ((long)timeslot << 16) | channelOffset;
+      Cell c = cells.get(key);
+      if (c == null) {
+        c = new Cell(this, handle, timeslot, channelOffset);
+        cells.put(key, c);
+      }
+      return c;
+    }
+
+    /* Number of cycles of slotframe handle since the first log */
+    long cycles(int handle) {
+      Integer size = slotframes.get(handle);
+      if (size == null || size == 0 || firstAsn < 0) {
+        return 0;
+      }
+      return (lastAsn - firstAsn) / size + 1;
+    }
+
+    double utilization(Cell c) {
+      long cycles = cycles(c.handle);
+      return cycles == 0 ? 0 : Math.min(1.0, 1.0 * c.used() / cycles);
+    }
+  }
+
+  private synchronized void parse(Mote mote, String msg) {
+    NodeSchedule node = nodes.get(mote);
+    Matcher m;
+    if (node == null) {
+      return;
+    }
+
+    if ((m = TSCH_LOG.matcher(msg)).find()) {
+      long asn = (Long.parseLong(m.group(1), 16) << 32) | Long.parseLong(m.group(2), 16);
+      int handle = Integer.parseInt(m.group(3));
+      int size = Integer.parseInt(m.group(4));
+      int channel = Integer.parseInt(m.group(7));
+      if (size == 0) {
+        /* Not in a link */
+        return;
+      }
+      node.slotframes.put(handle, size);
+      Cell c = node.getCell(handle, Integer.parseInt(m.group(5)), Integer.parseInt(m.group(6)));
+      if (c.options < 0) {
+        c.options = m.group(9).equals("tx") ? LINK_OPTION_TX : LINK_OPTION_RX;
+      }
+      if (node.firstAsn < 0 || asn < node.firstAsn) {
+        node.firstAsn = asn;
+      }
+      if (asn > node.lastAsn) {
+        node.lastAsn = asn;
+      }
+
+      if (m.group(9).equals("rx")) {
+        c.rx++;
+        return;
+      }
+      c.tx++;
+      if (m.group(11) != null) {
+        int status = Integer.parseInt(m.group(11));
+        if (status == MAC_TX_OK) {
+          c.txOk++;
+        } else if (status == MAC_TX_COLLISION) {
+          c.txCollision++;
+        } else if (status == MAC_TX_NOACK) {
+          c.txNoAck++;
+        }
+      }
+      findConflict(node, c, asn, channel);
+    } else if (SCHEDULE_START.matcher(msg).find()) {
+      /* A full schedule follows */
+      node.slotframes.clear();
+      for (Cell c: node.cells.values()) {
+        c.options = -1;
+      }
+      node.printHandle = -1;
+    } else if ((m = SCHEDULE_SLOTFRAME.matcher(msg)).find()) {
+      node.printHandle = Integer.parseInt(m.group(1));
+      node.slotframes.put(node.printHandle, Integer.parseInt(m.group(2)));
+    } else if ((m = SCHEDULE_LINK.matcher(msg)).find()) {
+      if (node.printHandle >= 0) {
+        Cell c = node.getCell(node.printHandle, Integer.parseInt(m.group(2)), Integer.parseInt(m.group(3)));
+        c.options = Integer.parseInt(m.group(1), 16);
+        c.neighbor = Integer.parseInt(m.group(4));
+      }
+    } else if ((m = ADD_LINK.matcher(msg)).find()) {
+      Cell c = node.getCell(Integer.parseInt(m.group(1)), Integer.parseInt(m.group(3)), Integer.parseInt(m.group(4)));
+      c.options = Integer.parseInt(m.group(2));
+      c.neighbor = Integer.parseInt(m.group(5));
+    } else if ((m = REMOVE_LINK.matcher(msg)).find()) {
+      Cell c = node.getCell(Integer.parseInt(m.group(1)), Integer.parseInt(m.group(3)), Integer.parseInt(m.group(4)));
+      c.options = -1;
+    }
+  }
+
+  /* Counts a conflict in both cells when two motes transmit in the
+   * same ASN on the same channel */
+  private void findConflict(NodeSchedule node, Cell c, long asn, int channel) {
+    long key = (asn << 5) | (channel & 0x1f);
+    Cell other = recentTx.get(key);
+    if (other == null) {
+      recentTx.put(key, c);
+    } else if (other.node != node) {
+      other.conflicts++;
+      c.conflicts++;
+    }
+
+    if (asn > maxAsn) {
+      maxAsn = asn;
+      if (maxAsn > CONFLICT_WINDOW) {
+        recentTx.headMap((maxAsn - CONFLICT_WINDOW) << 5).clear();
+      }
+    }
+  }
+
+  private void updateMoteBox() {
+    if (moteBox == null) {
+      return;
+    }
+    java.awt.EventQueue.invokeLater(new Runnable() {
+      public void run() {
+        Object selected = moteBox.getSelectedItem();
+        moteBox.removeAllItems();
+        for (Mote m: simulation.getMotes()) {
+          moteBox.addItem(m);
+        }
+        if (selected != null) {
+          moteBox.setSelectedItem(selected);
+        }
+      }
+    });
+  }
+
+  /* Slotframes of the selected mote, one row of cells per ROW_CELLS
+   * timeslots. The channel offsets of a timeslot are stacked */
+  private class SchedulePanel extends JPanel {
+    private ArrayList<Object[]> layout = new ArrayList<Object[]>();
+
+    public SchedulePanel() {
+      setToolTipText("");
+      setBackground(Color.WHITE);
+    }
+
+    private NodeSchedule selectedNode() {
+      Object mote = moteBox.getSelectedItem();
+      return mote == null ? null : nodes.get(mote);
+    }
+
+    private int rowsOf(int size) {
+      return (size + ROW_CELLS - 1) / ROW_CELLS;
+    }
+
+    public Dimension getPreferredSize() {
+      int height = 0;
+      synchronized (TSCHScheduleViewer.this) {
+        NodeSchedule node = selectedNode();
+        if (node != null) {
+          for (int handle: node.slotframes.keySet()) {
+            height += CELL_SIZE * 2 + rowsOf(node.slotframes.get(handle)) * (CELL_SIZE + 2);
+          }
+        }
+      }
+      return new Dimension(ROW_CELLS * CELL_SIZE + 20, height + 10);
+    }
+
+    protected void paintComponent(Graphics g) {
+      super.paintComponent(g);
+      layout.clear();
+      synchronized (TSCHScheduleViewer.this) {
+        NodeSchedule node = selectedNode();
+        if (node == null) {
+          return;
+        }
+        int y = 5;
+        for (int handle: node.slotframes.keySet()) {
+          int size = node.slotframes.get(handle);
+          g.setColor(Color.BLACK);
+          g.drawString("Slotframe " + handle + ", size " + size +
+              ", " + node.cycles(handle) + " cycles", 5, y + CELL_SIZE);
+          y += CELL_SIZE * 2;
+          for (int ts = 0; ts < size; ts++) {
+            int x = 5 + (ts % ROW_CELLS) * CELL_SIZE;
+            int cy = y + (ts / ROW_CELLS) * (CELL_SIZE + 2);
+            paintTimeslot(g, node, handle, ts, x, cy);
+          }
+          y += rowsOf(size) * (CELL_SIZE + 2);
+        }
+      }
+    }
+
+    private void paintTimeslot(Graphics g, NodeSchedule node, int handle, int ts, int x, int y) {
+      long from = ((long)handle << 32) | ((long)ts << 16);
+      Collection<Cell> cells = node.cells.subMap(from, from + 0x10000).values();
+      int n = cells.size();
+      int i = 0;
+
+      g.setColor(Color.LIGHT_GRAY);
+      g.drawRect(x, y, CELL_SIZE - 1, CELL_SIZE - 1);
+      for (Cell c: cells) {
+        int h = Math.max(1, (CELL_SIZE - 2) / n);
+        int cy = y + 1 + i * h;
+        if (c.used() > 0) {
+          /* Greener when used more */
+          float u = Math.max(0.2f, (float)node.utilization(c));
+          g.setColor(c.options < 0 ? Color.ORANGE : new Color(1.0f - u, 1.0f - 0.5f * u, 1.0f - u));
+        } else if (c.options >= 0) {
+          g.setColor(new Color(0.75f, 0.85f, 1.0f));
+        } else {
+          i++;
+          continue;
+        }
+        g.fillRect(x + 1, cy, CELL_SIZE - 2, h);
+        if (c.conflicts > 0 || c.txCollision > 0) {
+          g.setColor(Color.RED);
+          g.drawRect(x, y, CELL_SIZE - 1, CELL_SIZE - 1);
+        }
+        layout.add(new Object[] { new java.awt.Rectangle(x, y, CELL_SIZE, CELL_SIZE), node, c });
+        i++;
+      }
+    }
+
+    public String getToolTipText(MouseEvent e) {
+      StringBuilder sb = new StringBuilder();
+      synchronized (TSCHScheduleViewer.this) {
+        for (Object[] o: layout) {
+          if (((java.awt.Rectangle)o[0]).contains(e.getPoint())) {
+            sb.append(cellString((NodeSchedule)o[1], (Cell)o[2]) + "\n");
+          }
+        }
+      }
+      if (sb.length() == 0) {
+        return null;
+      }
+      return "<html><pre>" + sb.toString() + "</html>";
+    }
+  }
+
+  private static String cellString(NodeSchedule node, Cell c) {
+    return String.format("sf %d ts %d choff %d opt %s nbr %d: tx %d ok %d col %d noack %d rx %d conflicts %d util %2.2f%%",
+        c.handle, c.timeslot, c.channelOffset, c.optionString(), c.neighbor,
+        c.tx, c.txOk, c.txCollision, c.txNoAck, c.rx, c.conflicts,
+        100.0 * node.utilization(c));
+  }
+
+  /**
+   * One line per cell of every mote, scheduled or used, with its counts.
+   */
+  public synchronized String statistics() {
+    StringBuilder sb = new StringBuilder();
+    for (NodeSchedule node: nodes.values()) {
+      for (Cell c: node.cells.values()) {
+        if (c.options >= 0 || c.used() > 0) {
+          sb.append(node.mote.getID() + " " + cellString(node, c) + "\n");
+        }
+      }
+    }
+    return sb.toString();
+  }
+
+  private Action resetAction = new AbstractAction("Reset") {
+    public void actionPerformed(ActionEvent e) {
+      synchronized (TSCHScheduleViewer.this) {
+        /* Keep the schedules, clear the counts */
+        for (NodeSchedule node: nodes.values()) {
+          for (Cell c: node.cells.values()) {
+            c.tx = c.txOk = c.txCollision = c.txNoAck = c.rx = c.conflicts = 0;
+          }
+          node.firstAsn = node.lastAsn = -1;
+        }
+        recentTx.clear();
+      }
+    }
+  };
+
+  private Action printAction = new AbstractAction("Print to console/Copy to clipboard") {
+    public void actionPerformed(ActionEvent e) {
+      String output = statistics();
+      logger.info("TSCH schedule output:\n\n" + output);
+
+      Clipboard clipboard = Toolkit.getDefaultToolkit().getSystemClipboard();
+      StringSelection stringSelection = new StringSelection(output);
+      clipboard.setContents(stringSelection, null);
+    }
+  };
+
+  private Timer repaintTimer = new Timer(UPDATE_INTERVAL, new ActionListener() {
+    public void actionPerformed(ActionEvent e) {
+      schedulePanel.revalidate();
+      schedulePanel.repaint();
+    }
+  });
+
+  public void closePlugin() {
+    repaintTimer.stop();
+    simulation.getEventCentral().removeLogOutputListener(logOutputListener);
+  }
+
+  public Collection<Element> getConfigXML() {
+    return null;
+  }
+  public boolean setConfigXML(Collection<Element> configXML, boolean visAvailable) {
+    return true;
+  }
+
+}
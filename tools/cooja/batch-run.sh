@@ -0,0 +1,198 @@
+#!/bin/bash
+#
+# Runs a parameter sweep of Cooja simulations, headless and in parallel.
+#
+# Usage: batch-run.sh [-j jobs] [-o outdir] sweep.conf
+#
+# The sweep is a shell file that sets:
+#   APP_DIR     the application directory, relative to the Contiki root
+#   APP         the firmware to build in it, e.g. app-rpl-collect-only
+#   TARGET      the platform of the motes (default sky)
+#   TOPOLOGIES  the simulations to run, .csc files of APP_DIR
+#   SEEDS       the random seeds, every topology is run once per seed
+#   DURATION    the simulated time of a run, in seconds
+#   PARAM_<X>   the values of the define X, e.g.
+#               PARAM_ORCHESTRA_CONF_UNICAST_PERIOD="7 11 17"
+# See examples/tsch-testbed/orchestra-sweep.conf.
+#
+# The firmware is built once per combination of PARAM_ values, in a copy
+# of APP_DIR, and every (build, topology, seed) is run by its own Cooja,
+# with up to jobs (default: the number of CPUs) at a time. A topology
+# without a ScriptRunner gets one that logs all mote output and ends the
+# run after DURATION. The results are in outdir (default sweep-<date>):
+#   build-<n>/        the firmware of a combination, and build.log
+#   runs/<name>/      COOJA.testlog, COOJA.log and stats.csv of a run
+#   runs.csv          the topology, seed and defines of every run
+#   results.csv       the rows of tools/tsch-testbed-stats for all runs,
+#                     every one prefixed with the run name
+#
+# Runs that already have a stats.csv are skipped, so that an interrupted
+# sweep can be resumed by running it again with the same outdir.
+
+CONTIKI=$(cd "$(dirname "$0")/../.." && pwd)
+COOJA_JAR=$CONTIKI/tools/cooja/dist/cooja.jar
+STATS=$CONTIKI/tools/tsch-testbed-stats
+
+# Internal: runs the simulation of a run directory
+if [ "$1" = "--run" ]; then
+  cd "$2" || exit 1
+  seed=$(cat seed)
+  rm -f COOJA.testlog
+  java $JAVA_OPTS -jar "$COOJA_JAR" -nogui=run.csc -contiki="$CONTIKI" \
+    -random-seed=$seed > cooja.out 2>&1
+  if [ ! -f COOJA.testlog ]; then
+    echo "$(basename "$2"): failed, see $2/COOJA.log"
+    exit 0
+  fi
+  "$STATS" COOJA.testlog > stats.csv.tmp && mv stats.csv.tmp stats.csv
+  echo "$(basename "$2"): done"
+  exit 0
+fi
+
+# Internal: builds the firmware of a build directory
+if [ "$1" = "--build" ]; then
+  cd "$2" || exit 1
+  if ! make CONTIKI="$CONTIKI" TARGET=$3 DEFINES="$(cat defines)" $4.$3 > build.log 2>&1; then
+    echo "$(basename "$2"): build failed, see $2/build.log"
+    exit 0
+  fi
+  echo "$(basename "$2"): built with $(cat defines)"
+  exit 0
+fi
+
+JOBS=$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)
+OUT=sweep-$(date +%Y%m%d-%H%M%S)
+
+while getopts "j:o:" opt; do
+  case $opt in
+    j) JOBS=$OPTARG ;;
+    o) OUT=$OPTARG ;;
+    *) echo "Usage: $0 [-j jobs] [-o outdir] sweep.conf" >&2; exit 1 ;;
+  esac
+done
+shift $((OPTIND - 1))
+if [ $# -ne 1 ]; then
+  echo "Usage: $0 [-j jobs] [-o outdir] sweep.conf" >&2
+  exit 1
+fi
+
+TARGET=sky
+SEEDS=1
+DURATION=3600
+. "$1" || exit 1
+if [ -z "$APP_DIR" ] || [ -z "$APP" ] || [ -z "$TOPOLOGIES" ]; then
+  echo "$1: APP_DIR, APP and TOPOLOGIES must be set" >&2
+  exit 1
+fi
+
+if [ ! -f "$COOJA_JAR" ]; then
+  (cd "$CONTIKI/tools/cooja" && ant jar) || exit 1
+fi
+make -s -C "$CONTIKI/tools" tsch-testbed-stats || exit 1
+
+mkdir -p "$OUT/runs" || exit 1
+OUT=$(cd "$OUT" && pwd)
+
+# All combinations of the PARAM_ values, one DEFINES per line
+combinations() {
+  local name=$1
+  shift
+  local value rest
+  if [ -z "$name" ]; then
+    echo
+    return
+  fi
+  combinations "$@" | while read -r rest; do
+    for value in $(eval echo \$PARAM_$name); do
+      echo "$name=$value${rest:+,$rest}"
+    done
+  done
+}
+
+# The simulation of a run: firmware of the build, a logging script if the
+# topology has none
+make_csc() {
+  local build=$1 csc=$2
+  sed -e "s|\[CONFIG_DIR\]|$build|g" -e "s|\[CONTIKI_DIR\]|$CONTIKI|g" "$build/$csc" |
+  if grep -q "org.contikios.cooja.plugins.ScriptRunner" "$build/$csc"; then
+    cat
+  else
+    sed -e '/<\/simconf>/d'
+    cat <<EOF
+  <plugin>
+    org.contikios.cooja.plugins.ScriptRunner
+    <plugin_config>
+      <script>TIMEOUT($((DURATION * 1000)), log.testOK());
+while(true) {
+  YIELD();
+  log.log(time + " ID:" + id + " " + msg + "\n");
+}</script>
+      <active>true</active>
+    </plugin_config>
+    <width>600</width>
+    <z>-1</z>
+    <height>400</height>
+    <location_x>0</location_x>
+    <location_y>0</location_y>
+  </plugin>
+</simconf>
+EOF
+  fi
+}
+
+PARAMS=$(compgen -v PARAM_ | sed 's/^PARAM_//')
+combinations $PARAMS > "$OUT/combinations"
+
+# Builds, in parallel as they are independent copies of APP_DIR
+n=0
+builds=
+while read -r defines; do
+  build=$OUT/build-$n
+  if [ ! -f "$build/$APP.$TARGET" ]; then
+    rm -rf "$build"
+    cp -r "$CONTIKI/$APP_DIR" "$build"
+    rm -rf "$build"/obj_* "$build"/contiki-*.a "$build"/Makefile.*.defines \
+      "$build"/Makefile.target "$build/$APP.$TARGET"
+    echo "$defines" > "$build/defines"
+    builds="$builds $build"
+  fi
+  n=$((n + 1))
+done < "$OUT/combinations"
+for build in $builds; do
+  echo "$build"
+done | xargs -r -P "$JOBS" -I{} "$0" --build {} $TARGET $APP
+
+# Runs
+echo "run,topology,seed,defines" > "$OUT/runs.csv"
+runs=
+n=0
+while read -r defines; do
+  build=$OUT/build-$n
+  if [ -f "$build/$APP.$TARGET" ]; then
+    for csc in $TOPOLOGIES; do
+      for seed in $SEEDS; do
+        name=b$n-$(basename "$csc" .csc)-s$seed
+        run=$OUT/runs/$name
+        echo "$name,$csc,$seed,\"$defines\"" >> "$OUT/runs.csv"
+        if [ ! -f "$run/stats.csv" ]; then
+          mkdir -p "$run"
+          echo $seed > "$run/seed"
+          make_csc "$build" "$csc" > "$run/run.csc"
+          runs="$runs $run"
+        fi
+      done
+    done
+  fi
+  n=$((n + 1))
+done < "$OUT/combinations"
+for run in $runs; do
+  echo "$run"
+done | xargs -r -P "$JOBS" -I{} "$0" --run {}
+
+# Results of all runs
+for stats in "$OUT"/runs/*/stats.csv; do
+  [ -f "$stats" ] || continue
+  name=$(basename "$(dirname "$stats")")
+  sed "s/^/$name,/" "$stats"
+done > "$OUT/results.csv"
+echo "Results in $OUT/results.csv, runs in $OUT/runs.csv"
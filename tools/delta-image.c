@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Makes a delta between two firmware images, for the delta updates of
+ * apps/deployment/delta-patch.h, or applies one to check it. Images are
+ * raw binaries, e.g. from msp430-objcopy -O binary. The delta copies the
+ * runs of at least MIN_MATCH bytes found in the old image and adds the
+ * rest, so that its size follows the size of the change.
+ *
+ * Usage: delta-image old.bin new.bin delta.bin
+ *        delta-image -p old.bin delta.bin new.bin
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DELTA_HEADER_LEN 16
+#define DELTA_COPY 0
+#define DELTA_ADD 1
+#define MAX_LEN 0xffff
+
+/* A copy costs 7 bytes, against 1 per byte added */
+#define MIN_MATCH 8
+#define HASH_BITS 16
+/* Candidates tried per position */
+#define MAX_CHAIN 256
+
+static uint8_t *old_image, *new_image;
+static long old_size, new_size;
+static FILE *out;
+static long copies, copied, adds, added;
+
+/*---------------------------------------------------------------------------*/
+/* As core/lib/crc16.c */
+static uint16_t
+crc16(const uint8_t *data, long len)
+{
+  uint16_t acc = 0;
+  while(len-- > 0) {
+    acc ^= *data++;
+    acc = (acc >> 8) | (acc << 8);
+    acc ^= (acc & 0xff00) << 4;
+    acc ^= (acc >> 8) >> 4;
+    acc ^= (acc & 0xff00) >> 5;
+  }
+  return acc;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+load(const char *name, long *size)
+{
+  FILE *f = fopen(name, "rb");
+  uint8_t *data;
+  if(f == NULL) {
+    perror(name);
+    exit(1);
+  }
+  fseek(f, 0, SEEK_END);
+  *size = ftell(f);
+  rewind(f);
+  data = malloc(*size + 1);
+  if(data == NULL || fread(data, 1, *size, f) != (size_t)*size) {
+    fprintf(stderr, "%s: read error\n", name);
+    exit(1);
+  }
+  fclose(f);
+  return data;
+}
+/*---------------------------------------------------------------------------*/
+static void
+put(uint32_t v, int bytes)
+{
+  while(bytes-- > 0) {
+    fputc((v >> (8 * bytes)) & 0xff, out);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+get(const uint8_t *p, int bytes)
+{
+  uint32_t v = 0;
+  while(bytes-- > 0) {
+    v = (v << 8) | *p++;
+  }
+  return v;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned
+hash(const uint8_t *p)
+{
+  uint32_t h = get(p, 4) * 2654435761u ^ get(p + 4, 4) * 40503u;
+  return h >> (32 - HASH_BITS);
+}
+/*---------------------------------------------------------------------------*/
+static void
+emit_add(long from, long to)
+{
+  while(from < to) {
+    long len = to - from > MAX_LEN ? MAX_LEN : to - from;
+    put(DELTA_ADD, 1);
+    put(len, 2);
+    fwrite(new_image + from, 1, len, out);
+    adds++;
+    added += len;
+    from += len;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+make_delta(void)
+{
+  long *head = malloc(sizeof(long) << HASH_BITS);
+  long *next = malloc(sizeof(long) * (old_size + 1));
+  long pos, pending = 0;
+  long i;
+
+  for(i = 0; i < 1 << HASH_BITS; i++) {
+    head[i] = -1;
+  }
+  /* Chains from the last position, so that the first found are the
+   * closest to the start */
+  for(i = old_size - MIN_MATCH; i >= 0; i--) {
+    unsigned h = hash(old_image + i);
+    next[i] = head[h];
+    head[h] = i;
+  }
+
+  put('D', 1);
+  put('L', 1);
+  put('T', 1);
+  put('1', 1);
+  put(old_size, 4);
+  put(new_size, 4);
+  put(crc16(old_image, old_size), 2);
+  put(crc16(new_image, new_size), 2);
+
+  for(pos = 0; pos + MIN_MATCH <= new_size;) {
+    long best = -1, best_len = 0;
+    long cand;
+    int chain = 0;
+
+    for(cand = head[hash(new_image + pos)]; cand >= 0 && chain < MAX_CHAIN;
+        cand = next[cand], chain++) {
+      long len = 0;
+      while(pos + len < new_size && cand + len < old_size && len < MAX_LEN
+            && old_image[cand + len] == new_image[pos + len]) {
+        len++;
+      }
+      if(len > best_len) {
+        best = cand;
+        best_len = len;
+      }
+    }
+    if(best_len < MIN_MATCH) {
+      pos++;
+      continue;
+    }
+    emit_add(pending, pos);
+    put(DELTA_COPY, 1);
+    put(best, 4);
+    put(best_len, 2);
+    copies++;
+    copied += best_len;
+    pos += best_len;
+    pending = pos;
+  }
+  emit_add(pending, new_size);
+  free(head);
+  free(next);
+}
+/*---------------------------------------------------------------------------*/
+/* Applies a delta as the node does. Returns 0 if the result checks */
+static int
+patch(const uint8_t *delta, long delta_size)
+{
+  long pos = DELTA_HEADER_LEN;
+  long written = 0;
+  uint8_t *result;
+
+  if(delta_size < DELTA_HEADER_LEN || memcmp(delta, "DLT1", 4) != 0) {
+    fprintf(stderr, "bad header\n");
+    return 1;
+  }
+  if(get(delta + 4, 4) != old_size || get(delta + 12, 2) != crc16(old_image, old_size)) {
+    fprintf(stderr, "delta for another base\n");
+    return 1;
+  }
+  new_size = get(delta + 8, 4);
+  result = malloc(new_size + 1);
+  while(written < new_size && pos + 3 <= delta_size) {
+    long len;
+    if(delta[pos] == DELTA_COPY && pos + 7 <= delta_size) {
+      long offset = get(delta + pos + 1, 4);
+      len = get(delta + pos + 5, 2);
+      if(offset + len > old_size || written + len > new_size) {
+        break;
+      }
+      memcpy(result + written, old_image + offset, len);
+      pos += 7;
+    } else if(delta[pos] == DELTA_ADD) {
+      len = get(delta + pos + 1, 2);
+      if(pos + 3 + len > delta_size || written + len > new_size) {
+        break;
+      }
+      memcpy(result + written, delta + pos + 3, len);
+      pos += 3 + len;
+    } else {
+      break;
+    }
+    written += len;
+  }
+  if(written != new_size || crc16(result, new_size) != get(delta + 14, 2)) {
+    fprintf(stderr, "patch failed\n");
+    return 1;
+  }
+  fwrite(result, 1, new_size, out);
+  free(result);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  if(argc == 5 && !strcmp(argv[1], "-p")) {
+    uint8_t *delta;
+    long delta_size;
+    int r;
+    old_image = load(argv[2], &old_size);
+    delta = load(argv[3], &delta_size);
+    if((out = fopen(argv[4], "wb")) == NULL) {
+      perror(argv[4]);
+      return 1;
+    }
+    r = patch(delta, delta_size);
+    fclose(out);
+    return r;
+  }
+  if(argc != 4) {
+    fprintf(stderr, "usage: %s old.bin new.bin delta.bin\n"
+            "       %s -p old.bin delta.bin new.bin\n", argv[0], argv[0]);
+    return 1;
+  }
+  old_image = load(argv[1], &old_size);
+  new_image = load(argv[2], &new_size);
+  if((out = fopen(argv[3], "wb")) == NULL) {
+    perror(argv[3]);
+    return 1;
+  }
+  make_delta();
+  printf("%s: %ld bytes for %ld, %ld copies (%ld bytes), %ld adds (%ld bytes)\n",
+         argv[3], ftell(out), new_size, copies, copied, adds, added);
+  fclose(out);
+  return 0;
+}
@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Decoder for the binary deployment logs (DEPLOYMENT_LOG_CONF_BINARY, see
+ * apps/deployment/deployment-log.c). Reads a node's serial output from a
+ * file or stdin and prints the logs as the text logs. With -a, every
+ * decoded line is prefixed with its ASN (clock time without TSCH).
+ * Anything outside of binary records is copied through unchanged, so that
+ * binary TSCH logs can be piped on to tsch-log-decode.
+ *
+ * Usage: deployment-log-decode [-a] [file]
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+
+#define SLIP_END     0300
+#define SLIP_ESC     0333
+#define SLIP_ESC_END 0334
+#define SLIP_ESC_ESC 0335
+
+/* Must match apps/deployment/deployment-log.h */
+#define MAGIC 0xa6
+#define LOG_EVENT 0
+#define LOG_STRING 1
+#define LOG_DROPPED 2
+#define FLAG_APPDATA 0x01
+#define FLAG_LATENCY 0x02
+/* Must match core/net/mac/tsch/tsch-log.h */
+#define TSCH_LOG_BINARY_MAGIC 0xa5
+
+/* Length of the event header, before the arguments */
+#define EVENT_HEADER_LEN 10
+/* Length of the appdata and latency at the end of an event */
+#define APPDATA_LEN 9
+#define LATENCY_LEN 4
+
+/* Strings sent by the node, by id */
+static char *strings[256];
+static int print_asn;
+
+static unsigned
+get_u16(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static unsigned long
+get_u32(const uint8_t *p)
+{
+  return get_u16(p) | ((unsigned long)get_u16(p + 2) << 16);
+}
+
+/* Print fmt with the arguments of an event, one conversion at a time */
+static void
+print_event(const char *fmt, const uint8_t *args, int nargs)
+{
+  char spec[32];
+  int n = 0;
+
+  while(*fmt != '\0') {
+    const char *start;
+    int len;
+    uint32_t v;
+
+    if(*fmt != '%') {
+      putchar(*fmt++);
+      continue;
+    }
+    start = fmt++;
+    if(*fmt == '%') {
+      putchar('%');
+      fmt++;
+      continue;
+    }
+    while(*fmt != '\0' && strchr("-+ #0123456789.", *fmt) != NULL) {
+      fmt++;
+    }
+    /* Copy the flags and width, the length modifier is ours */
+    len = fmt - start;
+    if(len > (int)sizeof(spec) - 3) {
+      len = sizeof(spec) - 3;
+    }
+    memcpy(spec, start, len);
+    while(*fmt == 'l') {
+      fmt++;
+    }
+    if(*fmt == '\0') {
+      break;
+    }
+    v = n < nargs ? get_u32(args + 4 * n) : 0;
+    n++;
+    switch(*fmt) {
+      case 'd':
+      case 'i':
+        spec[len] = 'l';
+        spec[len + 1] = *fmt;
+        spec[len + 2] = '\0';
+        printf(spec, (long)(int32_t)v);
+        break;
+      case 'u':
+      case 'x':
+      case 'X':
+      case 'o':
+        spec[len] = 'l';
+        spec[len + 1] = *fmt;
+        spec[len + 2] = '\0';
+        printf(spec, (unsigned long)v);
+        break;
+      case 'c':
+        spec[len] = 'c';
+        spec[len + 1] = '\0';
+        printf(spec, (int)v);
+        break;
+      case 's':
+        spec[len] = 's';
+        spec[len + 1] = '\0';
+        printf(spec, v < 256 && strings[v] != NULL ? strings[v] : "?");
+        break;
+      default:
+        /* Not a conversion the node stores an argument for */
+        n--;
+        break;
+    }
+    fmt++;
+  }
+}
+
+/* Print a record. Returns 1 if the buffer was a valid record, 0 otherwise */
+static int
+decode(const uint8_t *buf, int len)
+{
+  int nargs;
+  const uint8_t *p;
+
+  if(len < 2 || buf[0] != MAGIC) {
+    return 0;
+  }
+  switch(buf[1]) {
+    case LOG_STRING:
+      if(len < 3) {
+        return 0;
+      }
+      free(strings[buf[2]]);
+      strings[buf[2]] = malloc(len - 3 + 1);
+      if(strings[buf[2]] == NULL) {
+        err(1, "malloc");
+      }
+      memcpy(strings[buf[2]], buf + 3, len - 3);
+      strings[buf[2]][len - 3] = '\0';
+      return 1;
+    case LOG_DROPPED:
+      if(len != 4) {
+        return 0;
+      }
+      printf("Log:! dropped %u\n", get_u16(buf + 2));
+      return 1;
+    case LOG_EVENT:
+      if(len < EVENT_HEADER_LEN) {
+        return 0;
+      }
+      nargs = buf[9];
+      if(len != EVENT_HEADER_LEN + 4 * nargs
+         + ((buf[8] & FLAG_APPDATA) ? APPDATA_LEN : 0)
+         + ((buf[8] & FLAG_LATENCY) ? LATENCY_LEN : 0)) {
+        return 0;
+      }
+      break;
+    default:
+      return 0;
+  }
+
+  if(print_asn) {
+    printf("{asn-%x.%lx} ", buf[2], get_u32(buf + 3));
+  }
+  if(strings[buf[7]] != NULL) {
+    print_event(strings[buf[7]], buf + EVENT_HEADER_LEN, nargs);
+  } else {
+    printf("Log:! unknown format %u", buf[7]);
+  }
+  p = buf + EVENT_HEADER_LEN + 4 * nargs;
+  if(buf[8] & FLAG_APPDATA) {
+    printf(" [%lx %u %u->%u]", get_u32(p), p[4], get_u16(p + 5), get_u16(p + 7));
+    p += APPDATA_LEN;
+  }
+  if(buf[8] & FLAG_LATENCY) {
+    printf(" lat %lu", get_u32(p));
+  }
+  printf("\n");
+  return 1;
+}
+
+/* Undo the SLIP escaping of a frame and decode it.
+ * Returns 1 if it was a valid record, 0 otherwise */
+static int
+unescape_and_decode(const uint8_t *raw, int len)
+{
+  static uint8_t buf[4096];
+  int i, n = 0;
+
+  for(i = 0; i < len; i++) {
+    if(raw[i] == SLIP_ESC && i + 1 < len) {
+      i++;
+      buf[n++] = raw[i] == SLIP_ESC_END ? SLIP_END : (raw[i] == SLIP_ESC_ESC ? SLIP_ESC : raw[i]);
+    } else {
+      buf[n++] = raw[i];
+    }
+  }
+  return decode(buf, n);
+}
+
+int
+main(int argc, char **argv)
+{
+  static uint8_t raw[4096];
+  FILE *in = stdin;
+  int len = 0;
+  int c;
+
+  while((c = getopt(argc, argv, "a")) != -1) {
+    if(c == 'a') {
+      print_asn = 1;
+    } else {
+      fprintf(stderr, "usage: %s [-a] [file]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if(argc - optind > 1) {
+    fprintf(stderr, "usage: %s [-a] [file]\n", argv[0]);
+    exit(1);
+  }
+  if(argc - optind == 1 && (in = fopen(argv[optind], "rb")) == NULL) {
+    err(1, "%s", argv[optind]);
+  }
+
+  while((c = getc(in)) != EOF) {
+    if(c == SLIP_END) {
+      /* Other frames, such as binary TSCH logs, are passed through */
+      if(len > 0 && !unescape_and_decode(raw, len)) {
+        putchar(SLIP_END);
+        fwrite(raw, 1, len, stdout);
+        putchar(SLIP_END);
+      }
+      len = 0;
+      fflush(stdout);
+      continue;
+    }
+    if(len == sizeof(raw)) {
+      fwrite(raw, 1, len, stdout);
+      len = 0;
+    }
+    raw[len++] = c;
+    /* Flush complete text lines right away */
+    if(c == '\n' && raw[0] != MAGIC && raw[0] != TSCH_LOG_BINARY_MAGIC) {
+      fwrite(raw, 1, len, stdout);
+      len = 0;
+    }
+  }
+  if(len > 0) {
+    fwrite(raw, 1, len, stdout);
+  }
+
+  return 0;
+}
@@ -127,6 +127,13 @@ public class MSP430Core extends Chip implements MSP430Constants {
 
   private EventQueue cycleEventQueue = new EventQueue();
   private long nextCycleEventCycles;
+
+  /* Horizon of an empty event queue. A CPU in LPM is woken by events or
+   * by external stimuli only, so it can skip this far at once instead of
+   * returning to the simulator every few milliseconds. */
+  private static final long NO_EVENT_CYCLES = 1L << 32;
+  /* Longest skip in LPM when free running, as run() throttles by cycles */
+  private static final long RUN_IDLE_CYCLES = 10000;
   
   private ArrayList<Chip> chips = new ArrayList<Chip>();
 
@@ -590,6 +597,13 @@ public class MSP430Core extends Chip implements MSP430Constants {
 
     currentDCOFactor = 1.0 * bcs.getMaxDCOFrequency() / frequency;
 
+    /* The pending virtual time event is now at another cycle count */
+    if (vTimeEventQueue.eventCount > 0) {
+      nextVTimeEventCycles = convertVTime(vTimeEventQueue.nextTime);
+      nextEventCycles = nextCycleEventCycles < nextVTimeEventCycles ?
+          nextCycleEventCycles : nextVTimeEventCycles;
+    }
+
     /*    System.out.println("*** DCO: MAX:" + bcs.getMaxDCOFrequency() +
 	  " current: " + frequency + " DCO_FAC = " + currentDCOFactor);*/
     if (DEBUG)
@@ -623,7 +637,7 @@ public class MSP430Core extends Chip implements MSP430Constants {
   private void executeEvents() {
     if (cycles >= nextVTimeEventCycles) {
       if (vTimeEventQueue.eventCount == 0) {
-        nextVTimeEventCycles = cycles + 10000;
+        nextVTimeEventCycles = cycles + NO_EVENT_CYCLES;
       } else {
         TimeEvent te = vTimeEventQueue.popFirst();
         long now = getTime();
@@ -635,21 +649,21 @@ public class MSP430Core extends Chip implements MSP430Constants {
         if (vTimeEventQueue.eventCount > 0) {
           nextVTimeEventCycles = convertVTime(vTimeEventQueue.nextTime);
         } else {
-          nextVTimeEventCycles = cycles + 10000;          
+          nextVTimeEventCycles = cycles + NO_EVENT_CYCLES;          
         }
       }
     }
     
     if (cycles >= nextCycleEventCycles) {
       if (cycleEventQueue.eventCount == 0) {
-        nextCycleEventCycles = cycles + 10000;
+        nextCycleEventCycles = cycles + NO_EVENT_CYCLES;
       } else {
         TimeEvent te = cycleEventQueue.popFirst();
         te.execute(cycles);
         if (cycleEventQueue.eventCount > 0) {
           nextCycleEventCycles = cycleEventQueue.nextTime;
         } else {
-          nextCycleEventCycles = cycles + 10000;          
+          nextCycleEventCycles = cycles + NO_EVENT_CYCLES;          
         }
       }
     }
@@ -993,6 +1007,8 @@ public class MSP430Core extends Chip implements MSP430Constants {
       if (maxCycles >= 0 && maxCycles < nextEventCycles) {
         // Should it just freeze or take on extra cycle step if cycles > max?
         cycles = cycles < maxCycles ? maxCycles : cycles;
+      } else if (maxCycles < 0 && nextEventCycles - cycles > RUN_IDLE_CYCLES) {
+        cycles += RUN_IDLE_CYCLES;
       } else {
         cycles = nextEventCycles;
       }
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Picks Orchestra slotframe lengths (see apps/orchestra/orchestra-conf.h).
+ * Lengths must be pairwise co-prime, so that overlapping links rotate
+ * instead of hitting the same timeslots every cycle. Given the number of
+ * nodes, the unicast traffic and the minimum EB and common lengths, it
+ * suggests the shortest lengths that carry the traffic, and prints them as
+ * project-conf.h defines along with the expected overlap loss and worst-case
+ * latency. With -C, it only checks a set of lengths, as orchestra_init does.
+ *
+ * Usage: orchestra-slotframes [-s|-b] [-n nodes] [-d density] [-r rate]
+ *          [-k children] [-e eb-min] [-c common-min] [-u util] [-t slot-ms]
+ *        orchestra-slotframes -C length...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define MAX_LENGTH 0xffff
+
+static unsigned
+gcd(unsigned a, unsigned b)
+{
+  while(b != 0) {
+    unsigned r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+/* Returns 1 if len is co-prime with the n lengths of lens */
+static int
+is_coprime(unsigned len, const unsigned *lens, int n)
+{
+  int i;
+  for(i = 0; i < n; i++) {
+    if(gcd(len, lens[i]) > 1) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* Returns 1 if len is prime and co-prime with the n lengths of lens.
+ * Lengths are picked prime, so that later ones need not avoid their factors */
+static int
+is_candidate(unsigned len, const unsigned *lens, int n)
+{
+  unsigned d;
+  for(d = 2; d * d <= len && len % d != 0; d++);
+  return len >= 2 && d * d > len && is_coprime(len, lens, n);
+}
+
+/* The smallest candidate length from min on, 0 if none */
+static unsigned
+pick_above(unsigned min, const unsigned *lens, int n)
+{
+  unsigned len;
+  for(len = min; len <= MAX_LENGTH; len++) {
+    if(is_candidate(len, lens, n)) {
+      return len;
+    }
+  }
+  return 0;
+}
+
+/* The largest candidate length up to max, 0 if none */
+static unsigned
+pick_below(unsigned max, const unsigned *lens, int n)
+{
+  unsigned len;
+  for(len = max; len >= 2; len--) {
+    if(is_candidate(len, lens, n)) {
+      return len;
+    }
+  }
+  return 0;
+}
+
+/* Prints the pairs of lengths with a common factor. Returns their number */
+static int
+check(const unsigned *lens, int n)
+{
+  int count = 0;
+  int i, j;
+  for(i = 0; i < n; i++) {
+    for(j = i + 1; j < n; j++) {
+      unsigned factor = gcd(lens[i], lens[j]);
+      if(factor > 1) {
+        printf("lengths %u and %u share factor %u\n", lens[i], lens[j], factor);
+        count++;
+      }
+    }
+  }
+  return count;
+}
+
+static void
+usage(const char *name)
+{
+  fprintf(stderr, "usage: %s [-s|-b] [-n nodes] [-d density] [-r rate] [-k children]\n"
+          "         [-e eb-min] [-c common-min] [-u util] [-t slot-ms]\n"
+          "       %s -C length...\n"
+          "  -s          sender-based unicast (default)\n"
+          "  -b          receiver-based unicast\n"
+          "  -n nodes    nodes in the deployment, i.e. MAX_NODES (default 25)\n"
+          "  -d density  neighbors per node (default 8)\n"
+          "  -r rate     unicast packets sent per node and minute (default 6)\n"
+          "  -k children children per node, receiver-based only (default 4)\n"
+          "  -e eb-min   minimum EB slotframe length (default 397)\n"
+          "  -c common-min minimum common shared slotframe length (default 31)\n"
+          "  -u util     maximum use of a dedicated cell, in percent (default 50)\n"
+          "  -t slot-ms  timeslot duration (default 15)\n"
+          "  -C          check that the lengths are pairwise co-prime\n",
+          name, name);
+  exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+  int sender_based = 1;
+  unsigned nodes = 25;
+  unsigned density = 8;
+  double rate = 6;
+  unsigned children = 4;
+  unsigned eb_min = 397;
+  unsigned common_min = 31;
+  unsigned util = 50;
+  double slot_ms = 15;
+  int check_only = 0;
+  unsigned lens[3];
+  unsigned unicast_min;
+  unsigned unicast_max;
+  double load;
+  double loss;
+  int c;
+
+  while((c = getopt(argc, argv, "sbn:d:r:k:e:c:u:t:C")) != -1) {
+    switch(c) {
+      case 's': sender_based = 1; break;
+      case 'b': sender_based = 0; break;
+      case 'n': nodes = atoi(optarg); break;
+      case 'd': density = atoi(optarg); break;
+      case 'r': rate = atof(optarg); break;
+      case 'k': children = atoi(optarg); break;
+      case 'e': eb_min = atoi(optarg); break;
+      case 'c': common_min = atoi(optarg); break;
+      case 'u': util = atoi(optarg); break;
+      case 't': slot_ms = atof(optarg); break;
+      case 'C': check_only = 1; break;
+      default: usage(argv[0]);
+    }
+  }
+
+  if(check_only) {
+    unsigned all[64];
+    int n = 0;
+    for(; optind < argc && n < 64; optind++) {
+      all[n++] = atoi(argv[optind]);
+    }
+    if(n < 2) {
+      usage(argv[0]);
+    }
+    return check(all, n) > 0;
+  }
+  if(optind != argc || rate <= 0 || slot_ms <= 0 || util == 0 || util > 100) {
+    usage(argv[0]);
+  }
+
+  /* Packets per minute in a dedicated cell: its sender's own traffic when
+   * sender-based, that of all children when receiver-based */
+  load = sender_based ? rate : rate * children;
+  /* The longest slotframe whose cells carry the load */
+  unicast_max = (unsigned)(60000.0 / slot_ms * util / 100 / load);
+  /* The shortest slotframe that avoids sharing cells: sender-based slots
+   * are per node, receiver-based ones only need to differ among neighbors */
+  unicast_min = sender_based ? nodes : density + 1;
+
+  lens[0] = pick_above(eb_min, lens, 0);
+  lens[1] = pick_above(common_min, lens, 1);
+  lens[2] = pick_above(unicast_min, lens, 2);
+  if(lens[2] > unicast_max) {
+    /* Sharing cells beats not carrying the load */
+    printf("# a slotframe of %u cannot carry %.1f packets a minute per cell\n",
+           lens[2], load);
+    lens[2] = pick_below(unicast_max, lens, 2);
+  }
+  if(lens[0] == 0 || lens[1] == 0 || lens[2] == 0) {
+    fprintf(stderr, "no co-prime lengths found\n");
+    return 1;
+  }
+
+  /* Unicast cells lose to the EB (one Tx and one Rx link) and common links */
+  loss = 2.0 / lens[0] + 1.0 / lens[1];
+
+  printf("#define ORCHESTRA_CONF_EBSF_PERIOD %u\n", lens[0]);
+  printf("#define ORCHESTRA_CONF_COMMON_SHARED_PERIOD %u\n", lens[1]);
+  printf("#define ORCHESTRA_CONF_%s_PERIOD %u\n", sender_based ? "SB" : "RB", lens[2]);
+  printf("# unicast cell use %.0f%%, lost to overlaps %.1f%%\n",
+         100.0 * load * lens[2] * slot_ms / 60000, 100 * loss);
+  printf("# worst-case unicast latency %.0f ms, %.0f ms when preempted\n",
+         lens[2] * slot_ms, 2 * lens[2] * slot_ms);
+  if(sender_based && lens[2] < nodes) {
+    printf("# %u nodes share %u slots, see ORCHESTRA_CONF_SB_NACK\n",
+           nodes, lens[2]);
+  }
+  return 0;
+}
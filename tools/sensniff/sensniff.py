@@ -30,6 +30,8 @@
 # them to wireshark. At the same time, the frames can be logged to a file for
 # subsequent offline processing
 # In interactive mode, the user can also input commands from stdin
+# In TSCH mode, frames are annotated with their ASN, timeslot and channel
+# offset, derived from the EBs of the network, and written as pcap-ng
 
 # ToDo:
 # * Python 3 support
@@ -82,6 +84,25 @@ pcap_global_hdr = bytearray(struct.pack(PCAP_GLOBAL_HDR_FMT, MAGIC_NUMBER,
                                         VERSION_MAJOR, VERSION_MINOR,
                                         THISZONE, SIGFIGS, SNAPLEN, NETWORK))
 
+# pcap-ng, used in TSCH mode for its per-packet comments: Section Header,
+# Interface Description and Enhanced Packet blocks
+PCAPNG_SHB_TYPE = 0x0A0D0D0A
+PCAPNG_IDB_TYPE = 0x00000001
+PCAPNG_EPB_TYPE = 0x00000006
+PCAPNG_BYTE_ORDER_MAGIC = 0x1A2B3C4D
+PCAPNG_OPT_ENDOFOPT = 0
+PCAPNG_OPT_COMMENT = 1
+
+PCAPNG_SHB_FMT = '<LLLHHqL'
+PCAPNG_IDB_FMT = '<LLHHLL'
+PCAPNG_EPB_HDR_FMT = '<LLLLLLL'
+
+pcapng_global_hdr = (bytearray(struct.pack(PCAPNG_SHB_FMT, PCAPNG_SHB_TYPE, 28,
+                                           PCAPNG_BYTE_ORDER_MAGIC, 1, 0,
+                                           -1, 28)) +
+                     bytearray(struct.pack(PCAPNG_IDB_FMT, PCAPNG_IDB_TYPE, 20,
+                                           NETWORK, 0, SNAPLEN, 20)))
+
 CMD_FRAME             = 0x00
 CMD_CHANNEL           = 0x01
 CMD_CHANNEL_MIN       = 0x02
@@ -93,20 +114,39 @@ CMD_GET_CHANNEL_MAX   = 0x83
 CMD_SET_CHANNEL       = 0x84
 SNIFFER_PROTO_VERSION = 2
 #####################################
+### TSCH constants
+#####################################
+# Contiki's default hopping sequence (TSCH_HOPPING_SEQUENCE_INDRIYA),
+# timeslot length in usec (TSCH_DEFAULT_TS_TIMESLOT_LENGTH) and the lengths
+# of Orchestra's EB and common slotframes
+TSCH_DEFAULT_HOPPING_SEQUENCE = '26,15,25,20,16,19,14,24,18,17,17,11,21,23,12,22,13'
+TSCH_DEFAULT_TIMESLOT = 15000
+TSCH_DEFAULT_SLOTFRAMES = '397,31'
+# Frames received more than this many seconds after the last EB are not
+# annotated: by then, the host clock may be off by more than half a slot
+TSCH_SYNC_TIMEOUT = 60
+# On-air overhead of a frame (preamble, SFD, length) and duration of a
+# byte, in seconds. Used to get the start of a frame from its timestamp
+PHY_HDR_LEN = 6
+PHY_BYTE_DURATION = 32e-6
+#####################################
 ### Globals
 #####################################
 logger = logging.getLogger(__name__)
 stats = {}
 #####################################
 class Frame(object):
-    def __init__(self, raw, timestamp):
+    def __init__(self, raw, timestamp, pcapng = False, comment = None):
         self.__raw = raw
         self.__t = timestamp
         self.len = len(self.__raw)
+        self.comment = comment
 
-        self.__pcap_hdr = self.__generate_frame_hdr()
-
-        self.pcap = bytearray(self.__pcap_hdr) + self.__raw
+        if pcapng is True:
+            self.pcap = self.__generate_epb()
+        else:
+            self.__pcap_hdr = self.__generate_frame_hdr()
+            self.pcap = bytearray(self.__pcap_hdr) + self.__raw
         self.hex = ''.join('%02x ' % c for c in self.__raw).rstrip()
 
     def __generate_frame_hdr(self):
@@ -115,6 +155,25 @@ class Frame(object):
         return struct.pack(PCAP_FRAME_HDR_FMT,
                            sec, usec, self.len, self.len)
 
+    @staticmethod
+    def __pad(b):
+        return b + bytearray((4 - len(b) % 4) % 4)
+
+    def __generate_epb(self):
+        usec = int(self.__t * 1000000)
+        body = self.__pad(bytearray(self.__raw))
+        if self.comment is not None:
+            c = bytearray(self.comment.encode('utf-8'))
+            body += bytearray(struct.pack('<HH', PCAPNG_OPT_COMMENT, len(c)))
+            body += self.__pad(c)
+            body += bytearray(struct.pack('<HH', PCAPNG_OPT_ENDOFOPT, 0))
+        total = 32 + len(body)
+        return (bytearray(struct.pack(PCAPNG_EPB_HDR_FMT, PCAPNG_EPB_TYPE,
+                                      total, 0, usec >> 32,
+                                      usec & 0xFFFFFFFF, self.len,
+                                      self.len)) +
+                body + bytearray(struct.pack('<L', total)))
+
     def get_pcap(self):
         return self.pcap
 
@@ -128,6 +187,7 @@ class SerialInputHandler(object):
                  rts_cts = False):
         self.__sensniff_magic_legacy = bytearray((0x53, 0x6E, 0x69, 0x66))
         self.__sensniff_magic = bytearray((0xC1, 0x1F, 0xFE, 0x72))
+        self.channel = None
         stats['Captured'] = 0
         stats['Non-Frame'] = 0
         try:
@@ -242,8 +302,9 @@ class SerialInputHandler(object):
         b = bytearray(b)
         logger.debug('Received a command response: [%02x %02x]' % (cmd, b[0]))
         # We'll only ever see one of these if the user asked for it, so we are
-        # running interactive. Print away
+        # running interactive or in TSCH mode. Print away
         if cmd == CMD_CHANNEL:
+            self.channel = b[0]
             print('Sniffing in channel: %d' % (b[0],))
         elif cmd == CMD_CHANNEL_MIN:
             print('Min channel: %d' % (b[0],))
@@ -281,6 +342,182 @@ class SerialInputHandler(object):
         self.__write_command(CMD_GET_CHANNEL_MAX)
 
 #####################################
+class TschTracker(object):
+    # Follows the ASN of a TSCH network from its EBs, and annotates every
+    # captured frame with its ASN, timeslot and channel offset. The
+    # peripheral does not hop: it listens to one channel, which carries a
+    # given cell only in the slots where the hopping sequence maps the
+    # cell's channel offset to it. Between EBs, the ASN is extrapolated
+    # from the host timestamps
+    def __init__(self, hopping_sequence, timeslot, slotframes, channel):
+        self.default_hopping = hopping_sequence
+        self.hopping = hopping_sequence
+        self.next_hopping = None
+        self.timeslot = timeslot / 1000000.0
+        self.slotframes = slotframes
+        self.channel = None
+        self.positions = []
+        self.sync_asn = None
+        self.sync_t = None
+        self.last_asn = None
+        self.last_frame_asn = None
+        # Frames, and slots in which the cell was on our channel, keyed by
+        # (slotframe length, timeslot, channel offset)
+        self.cells = {}
+        self.opportunities = {}
+        stats['TSCH EBs'] = 0
+        stats['TSCH Annotated'] = 0
+        stats['TSCH Not Synced'] = 0
+        self.set_channel(channel)
+
+    def set_channel(self, channel):
+        if channel == self.channel:
+            return
+        self.channel = channel
+        self.__update_positions()
+        # What was on the air in the meantime is unknown
+        self.last_asn = None
+
+    def __update_positions(self):
+        if self.channel is None:
+            self.positions = []
+        else:
+            self.positions = [i for i, c in enumerate(self.hopping)
+                              if c == self.channel]
+
+    def __set_hopping(self, sequence):
+        if sequence != self.hopping:
+            logger.info('TSCH: hopping sequence %s'
+                        % (','.join('%d' % c for c in sequence),))
+            self.hopping = sequence
+            self.__update_positions()
+
+    def __channel_offsets(self, asn):
+        return [(p - asn) % len(self.hopping) for p in self.positions]
+
+    def __parse_eb(self, raw, t):
+        # Contiki's EBs: frame version 2 beacon, no security, no destination
+        # address, long source address, followed by the MLME payload IE.
+        # raw ends with 2 bytes of RSSI and CRC/LQI instead of the FCS
+        if (len(raw) < 17 or (raw[0] & 0x0F) != 0x00 or raw[1] != 0xE2
+                or (raw[14] & 0xF8) != 0x88):
+            return
+        end = 15 + (raw[13] | (raw[14] & 0x07) << 8)
+        if end > len(raw) - 2:
+            return
+
+        asn = None
+        hopping = None
+        next_hopping = None
+        i = 15
+        while i + 2 <= end:
+            if raw[i + 1] & 0x80:
+                # Long IE: b0-10 length, b11-14 sub-ID
+                ie_len = raw[i] | (raw[i + 1] & 0x07) << 8
+                sub_id = (raw[i + 1] >> 3) & 0x0F
+                long_ie = True
+            else:
+                # Short IE: b0-7 length, b8-14 sub-ID
+                ie_len = raw[i]
+                sub_id = raw[i + 1] & 0x7F
+                long_ie = False
+            d = raw[i + 2:i + 2 + ie_len]
+            if len(d) != ie_len:
+                return
+            if long_ie is False and sub_id == 0x1A and ie_len == 6:
+                # Sync IE: ASN (5 bytes) and join priority
+                asn = (d[0] | d[1] << 8 | d[2] << 16 | d[3] << 24 |
+                       d[4] << 32)
+            elif long_ie is True and sub_id == 9 and ie_len in (1, 25):
+                # Timeslot template IE, the full form ends with the length
+                if ie_len == 25:
+                    self.timeslot = (d[23] | d[24] << 8) / 1000000.0
+            elif long_ie is True and sub_id == 9 and ie_len >= 12 and d[0] == 1:
+                # Channel hopping IE: hopping sequence, 2 bytes per channel
+                seq_len = d[8] | d[9] << 8
+                if ie_len == 12 + 2 * seq_len:
+                    hopping = [d[10 + 2 * k] for k in range(seq_len)]
+            elif long_ie is True and sub_id == 9 and ie_len >= 7 and d[0] == 2:
+                # Scheduled change of the hopping sequence: activation ASN,
+                # then the sequence, 1 byte per channel
+                seq_len = d[6]
+                if ie_len == 7 + seq_len:
+                    next_hopping = ((d[1] | d[2] << 8 | d[3] << 16 |
+                                     d[4] << 24 | d[5] << 32),
+                                    list(d[7:7 + seq_len]))
+            i += 2 + ie_len
+
+        if asn is None:
+            return
+        stats['TSCH EBs'] += 1
+        self.sync_asn = asn
+        self.sync_t = t
+        # Without a channel hopping IE, the network uses the default sequence
+        self.__set_hopping(hopping if hopping else self.default_hopping)
+        self.next_hopping = next_hopping
+
+    def __account(self, asn):
+        # Count, for every cell, the slots up to asn in which it was on our
+        # channel, i.e. in which we could have captured its frames
+        start = asn if self.last_asn is None else self.last_asn + 1
+        for a in range(start, asn + 1):
+            for off in self.__channel_offsets(a):
+                for sf in self.slotframes:
+                    key = (sf, a % sf, off)
+                    self.opportunities[key] = self.opportunities.get(key, 0) + 1
+        if self.last_asn is None or asn > self.last_asn:
+            self.last_asn = asn
+
+    def annotate(self, raw, t):
+        # Start of the frame, from the time the peripheral passed it to us
+        t = t - (len(raw) + PHY_HDR_LEN) * PHY_BYTE_DURATION
+        self.__parse_eb(raw, t)
+        if self.sync_t is None or t - self.sync_t > TSCH_SYNC_TIMEOUT:
+            stats['TSCH Not Synced'] += 1
+            self.last_asn = None
+            return None
+
+        asn = self.sync_asn + int(round((t - self.sync_t) / self.timeslot))
+        if self.next_hopping is not None and asn >= self.next_hopping[0]:
+            self.__set_hopping(self.next_hopping[1])
+            self.next_hopping = None
+            self.last_asn = None
+        self.__account(asn)
+        offsets = self.__channel_offsets(asn)
+        # A data frame and its ACK share the slot
+        if asn != self.last_frame_asn:
+            self.last_frame_asn = asn
+            for off in offsets:
+                for sf in self.slotframes:
+                    key = (sf, asn % sf, off)
+                    self.cells[key] = self.cells.get(key, 0) + 1
+        stats['TSCH Annotated'] += 1
+
+        comment = 'ASN 0x%010x' % (asn,)
+        if len(self.slotframes) > 0:
+            comment += ', timeslot ' + ' '.join('%d/%d' % (asn % sf, sf)
+                                                for sf in self.slotframes)
+        if self.channel is not None:
+            comment += ', channel %d' % (self.channel,)
+            if len(offsets) > 0:
+                comment += ', channel offset ' + '|'.join('%d' % (off,)
+                                                          for off in offsets)
+            else:
+                comment += ', not in the hopping sequence'
+        logger.info('TSCH: %s' % (comment,))
+        return comment
+
+    def dump_cells(self):
+        if len(self.cells) == 0:
+            return
+        print('TSCH Cell Occupancy (slotframe, timeslot, channel offset: '
+              'frames / slots on channel %s):' % (self.channel,))
+        for key in sorted(self.cells):
+            n = self.cells[key]
+            slots = max(self.opportunities.get(key, 0), n)
+            print('%8d %5d %3d: %6d / %6d (%5.1f%%)'
+                  % (key + (n, slots, 100.0 * n / slots)))
+#####################################
 class FifoOutHandler(object):
     def __init__(self, out_fifo):
         self.out_fifo = out_fifo
@@ -450,6 +687,35 @@ def arg_parser():
                            help = 'Disable piping (Mainly used for debugging) \
                                    (Default: Piping enabled)')
 
+    tsch_group = parser.add_argument_group('TSCH Options')
+    tsch_group.add_argument('-T', '--tsch', action = 'store_true',
+                            default = False,
+                            help = 'Annotate every frame with its ASN, \
+                                    timeslot and channel offset, derived \
+                                    from the EBs of the network, in a \
+                                    pcap-ng packet comment, and print the \
+                                    occupancy of every cell on exit. \
+                                    (Default: Disabled)')
+    tsch_group.add_argument('--hopping', action = 'store',
+                            default = TSCH_DEFAULT_HOPPING_SEQUENCE,
+                            help = 'Hopping sequence of the network, used \
+                                    unless EBs carry one (Default: %s)'
+                                    % (TSCH_DEFAULT_HOPPING_SEQUENCE,))
+    tsch_group.add_argument('--timeslot', type = int, action = 'store',
+                            default = TSCH_DEFAULT_TIMESLOT,
+                            help = 'Timeslot length in usec, used unless \
+                                    EBs carry a full timeslot template \
+                                    (Default: %d)' % (TSCH_DEFAULT_TIMESLOT,))
+    tsch_group.add_argument('--slotframes', action = 'store',
+                            default = TSCH_DEFAULT_SLOTFRAMES,
+                            help = 'Slotframe lengths to derive timeslots \
+                                    for, comma-separated (Default: %s)'
+                                    % (TSCH_DEFAULT_SLOTFRAMES,))
+    tsch_group.add_argument('--channel', type = int, action = 'store',
+                            default = None,
+                            help = 'Channel of the peripheral, if it cannot \
+                                    report it (Default: queried)')
+
     log_group = parser.add_argument_group('Verbosity and Logging')
     log_group.add_argument('-n', '--non-interactive', action = 'store_true',
                            default = False,
@@ -488,6 +754,8 @@ def dump_stats():
     print('Frame Stats:')
     for k, v in list(stats.items()):
         print('%20s: %d' % (k, v))
+    if tsch is not None:
+        tsch.dump_cells()
 #####################################
 def log_init():
     logger.setLevel(logging.DEBUG)
@@ -512,6 +780,19 @@ if __name__ == '__main__':
 
     logger.info('Started logging')
 
+    tsch = None
+    if args.tsch is True:
+        try:
+            tsch = TschTracker([int(c) for c in args.hopping.split(',')],
+                               args.timeslot,
+                               [int(sf) for sf in args.slotframes.split(',')
+                                if sf != ''],
+                               args.channel)
+        except ValueError:
+            logger.error('Invalid hopping sequence or slotframe lengths')
+            sys.exit(1)
+        pcap_global_hdr = pcapng_global_hdr
+
     in_handler = SerialInputHandler(port = args.device, baudrate = args.baud,
                                     rts_cts = args.rts_cts)
 
@@ -539,6 +820,8 @@ if __name__ == '__main__':
         print(h)
 
         in_handler.get_channel()
+    elif tsch is not None and args.channel is None:
+        in_handler.get_channel()
 
     while 1:
         if args.non_interactive is False:
@@ -576,7 +859,13 @@ if __name__ == '__main__':
             raw = in_handler.read_frame()
             if len(raw) > 0:
                 t = time.time()
-                frame = Frame(bytearray(raw), t)
+                if tsch is not None:
+                    if in_handler.channel is not None:
+                        tsch.set_channel(in_handler.channel)
+                    comment = tsch.annotate(bytearray(raw), t)
+                    frame = Frame(bytearray(raw), t, True, comment)
+                else:
+                    frame = Frame(bytearray(raw), t)
                 for h in out_handlers:
                     h.handle(frame)
         except (KeyboardInterrupt, SystemExit):
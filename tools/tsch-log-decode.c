@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Decoder for the binary TSCH logs (TSCH_LOG_CONF_BINARY, see
+ * core/net/mac/tsch/tsch-log.c). Reads a node's serial output from a file
+ * or stdin and prints the logs in the same format as the text logs.
+ * Anything outside of binary records is copied through unchanged.
+ *
+ * Usage: tsch-log-decode [file]
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <err.h>
+
+#define SLIP_END     0300
+#define SLIP_ESC     0333
+#define SLIP_ESC_END 0334
+#define SLIP_ESC_ESC 0335
+
+/* Must match core/net/mac/tsch/tsch-log.h */
+#define TSCH_LOG_BINARY_MAGIC 0xa5
+#define LOG_TX 0
+#define LOG_RX 1
+#define LOG_MESSAGE 2
+#define LOG_DROPPED 3
+#define FLAG_IS_DATA 0x01
+#define FLAG_DRIFT_USED 0x02
+#define FLAG_IS_UNICAST 0x04
+#define FLAG_APPDATA 0x08
+
+/* Length of the common record header */
+#define HEADER_LEN 15
+
+static unsigned
+get_u16(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static unsigned long
+get_u32(const uint8_t *p)
+{
+  return get_u16(p) | ((unsigned long)get_u16(p + 2) << 16);
+}
+
+static int
+get_s16(const uint8_t *p)
+{
+  return (int16_t)get_u16(p);
+}
+
+static void
+print_appdata(const uint8_t *p)
+{
+  printf(" [%lx %u %u->%u]", get_u32(p), p[4], get_u16(p + 5), get_u16(p + 7));
+}
+
+/* Print a record. Returns 1 if the buffer was a valid record, 0 otherwise */
+static int
+decode(const uint8_t *buf, int len)
+{
+  const uint8_t *p = buf + HEADER_LEN;
+  int flags = 0;
+
+  if(len < 2 || buf[0] != TSCH_LOG_BINARY_MAGIC) {
+    return 0;
+  }
+  if(buf[1] == LOG_DROPPED) {
+    if(len != 4) {
+      return 0;
+    }
+    printf("TSCH:! logs dropped %u\n", get_u16(buf + 2));
+    return 1;
+  }
+  if(len < HEADER_LEN) {
+    return 0;
+  }
+
+  switch(buf[1]) {
+    case LOG_TX:
+    case LOG_RX:
+      if(len < HEADER_LEN + 8) {
+        return 0;
+      }
+      flags = p[0];
+      if((flags & FLAG_APPDATA) && len < HEADER_LEN + 8 + 9) {
+        return 0;
+      }
+      break;
+    case LOG_MESSAGE:
+      break;
+    default:
+      return 0;
+  }
+
+  printf("TSCH: {asn-%x.%lx link-%u-%u-%u-%u ch-%u} ",
+         buf[2], get_u32(buf + 3),
+         buf[7], get_u16(buf + 8), get_u16(buf + 10), get_u16(buf + 12),
+         buf[14]);
+
+  switch(buf[1]) {
+    case LOG_TX:
+      printf("%s-%u %u tx %u, st %u-%u",
+             (flags & FLAG_IS_UNICAST) ? "uc" : "bc", flags & FLAG_IS_DATA,
+             p[1], get_u16(p + 2), p[4], p[5]);
+      if(flags & FLAG_DRIFT_USED) {
+        printf(", dr %d", get_s16(p + 6));
+      }
+      if(flags & FLAG_APPDATA) {
+        print_appdata(p + 8);
+      }
+      break;
+    case LOG_RX:
+      printf("%s-%u %u rx %u",
+             (flags & FLAG_IS_UNICAST) ? "uc" : "bc", flags & FLAG_IS_DATA,
+             p[1], get_u16(p + 2));
+      if(flags & FLAG_DRIFT_USED) {
+        printf(", dr %d", get_s16(p + 4));
+      }
+      printf(", edr %d", get_s16(p + 6));
+      if(flags & FLAG_APPDATA) {
+        print_appdata(p + 8);
+      }
+      break;
+    case LOG_MESSAGE:
+      fwrite(p, 1, len - HEADER_LEN, stdout);
+      break;
+  }
+  printf("\n");
+  return 1;
+}
+
+int
+main(int argc, char **argv)
+{
+  static uint8_t buf[4096];
+  FILE *in = stdin;
+  int len = 0;
+  int esc = 0;
+  int c;
+
+  if(argc > 2) {
+    fprintf(stderr, "usage: %s [file]\n", argv[0]);
+    exit(1);
+  }
+  if(argc == 2 && (in = fopen(argv[1], "rb")) == NULL) {
+    err(1, "%s", argv[1]);
+  }
+
+  while((c = getc(in)) != EOF) {
+    if(c == SLIP_END) {
+      /* Text between two records is not a record, print it unchanged */
+      if(len > 0 && !decode(buf, len)) {
+        fwrite(buf, 1, len, stdout);
+      }
+      len = 0;
+      esc = 0;
+      fflush(stdout);
+      continue;
+    }
+    if(esc) {
+      esc = 0;
+      if(c == SLIP_ESC_END) {
+        c = SLIP_END;
+      } else if(c == SLIP_ESC_ESC) {
+        c = SLIP_ESC;
+      }
+    } else if(c == SLIP_ESC) {
+      esc = 1;
+      continue;
+    }
+    if(len == sizeof(buf)) {
+      fwrite(buf, 1, len, stdout);
+      len = 0;
+    }
+    buf[len++] = c;
+    /* Flush complete text lines right away */
+    if(c == '\n' && buf[0] != TSCH_LOG_BINARY_MAGIC) {
+      fwrite(buf, 1, len, stdout);
+      len = 0;
+    }
+  }
+  if(len > 0 && !decode(buf, len)) {
+    fwrite(buf, 1, len, stdout);
+  }
+
+  return 0;
+}
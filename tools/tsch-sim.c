@@ -0,0 +1,446 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Runs a native simulation of TSCH networks: every node of the topology
+ * is a process running the same firmware, built for the native platform
+ * with NATIVE_SIM=1 (see platform/native/sim.h), e.g.
+ *   make TARGET=native NATIVE_SIM=1 app-rpl-collect-only
+ * in examples/tsch-testbed. Nodes run the real TSCH, Orchestra and RPL
+ * code in a virtual time of their own, advanced by this tool as a
+ * discrete-event simulation: it waits until every node is idle, moves the
+ * time to the earliest wakeup and lets the nodes due run. As frames start
+ * SIM_TX_DELAY after they are sent, all nodes due within SIM_TX_DELAY run
+ * at once, in parallel, with the frames starting meanwhile. Idle periods
+ * take no time at all, so that large networks run faster than in Cooja,
+ * and as fast as the host allows.
+ *
+ * Topology file, one directed link per line, # for comments:
+ *   <src id> <dst id> <pdr> [<rssi>]
+ * Frames from src reach dst with probability pdr (0 to 1), at rssi dBm
+ * (default -70). Every node listed is started. A node receiving a frame
+ * misses all frames that overlap it, which its radio decides.
+ *
+ * Node output is printed with Cooja's prefix, "<time in us>\tID:<id>\t",
+ * which tsch-testbed-stats reads.
+ *
+ * Build: cc -O2 -I../platform/native -o tsch-sim tsch-sim.c
+ * Usage: tsch-sim [-t seconds] [-s seed] topology firmware [args...]
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <err.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "sim-msg.h"
+
+#define MAX_NODE_ID 65536
+#define LINE_LEN 1024
+#define DEFAULT_RSSI -70
+
+struct link {
+  int dst;
+  double pdr;
+  int8_t rssi;
+};
+
+struct node {
+  uint16_t id;
+  pid_t pid;
+  /* Socket of the node, and pipe of its standard output */
+  int fd;
+  int out;
+  char line[LINE_LEN];
+  int line_len;
+  int alive;
+  /* Running until it waits for wake */
+  int running;
+  uint64_t wake;
+  struct link *links;
+  int link_count;
+  int link_size;
+};
+
+static struct node *nodes;
+static int node_count;
+static int index_of[MAX_NODE_ID];
+/* Frames sent, not delivered yet */
+static struct sim_msg *frames;
+static int *frame_src;
+static int frame_count;
+static int frame_size;
+static uint64_t now;
+static int running_count;
+static unsigned long stat_tx, stat_rx, stat_lost;
+
+static int
+get_node(unsigned id)
+{
+  if(id == 0 || id >= MAX_NODE_ID) {
+    errx(1, "invalid node id %u", id);
+  }
+  if(index_of[id] < 0) {
+    if((nodes = realloc(nodes, (node_count + 1) * sizeof(struct node))) == NULL) {
+      err(1, "realloc");
+    }
+    memset(&nodes[node_count], 0, sizeof(struct node));
+    nodes[node_count].id = id;
+    index_of[id] = node_count++;
+  }
+  return index_of[id];
+}
+
+static void
+read_topology(const char *file)
+{
+  FILE *in;
+  char line[LINE_LEN];
+  unsigned src, dst;
+  double pdr;
+  int rssi;
+  int d, n, lineno = 0;
+
+  if((in = fopen(file, "r")) == NULL) {
+    err(1, "%s", file);
+  }
+  while(fgets(line, sizeof(line), in) != NULL) {
+    struct node *s;
+    lineno++;
+    if(line[strspn(line, " \t\r\n")] == '#' || line[strspn(line, " \t\r\n")] == '\0') {
+      continue;
+    }
+    rssi = DEFAULT_RSSI;
+    n = sscanf(line, "%u %u %lf %d", &src, &dst, &pdr, &rssi);
+    if(n < 3 || pdr < 0 || pdr > 1) {
+      errx(1, "%s:%d: expected <src> <dst> <pdr> [<rssi>]", file, lineno);
+    }
+    d = get_node(dst);
+    s = &nodes[get_node(src)];
+    if(s->link_count == s->link_size) {
+      s->link_size = s->link_size ? 2 * s->link_size : 8;
+      if((s->links = realloc(s->links, s->link_size * sizeof(struct link))) == NULL) {
+        err(1, "realloc");
+      }
+    }
+    s->links[s->link_count].dst = d;
+    s->links[s->link_count].pdr = pdr;
+    s->links[s->link_count].rssi = rssi;
+    s->link_count++;
+  }
+  fclose(in);
+  if(node_count == 0) {
+    errx(1, "%s: no nodes", file);
+  }
+}
+
+static void
+start_node(struct node *n, char **argv)
+{
+  int sv[2], out[2];
+  char buf[16];
+
+  if(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0 || pipe(out) < 0) {
+    err(1, "node %u", n->id);
+  }
+  /* Not inherited by the next nodes */
+  fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+  fcntl(out[0], F_SETFD, FD_CLOEXEC);
+  if((n->pid = fork()) < 0) {
+    err(1, "fork");
+  }
+  if(n->pid == 0) {
+    dup2(out[1], STDOUT_FILENO);
+    close(out[1]);
+    snprintf(buf, sizeof(buf), "%d", sv[1]);
+    setenv(SIM_ENV_FD, buf, 1);
+    snprintf(buf, sizeof(buf), "%u", n->id);
+    setenv(SIM_ENV_NODE_ID, buf, 1);
+    execv(argv[0], argv);
+    err(1, "%s", argv[0]);
+  }
+  close(sv[1]);
+  close(out[1]);
+  fcntl(out[0], F_SETFL, O_NONBLOCK);
+  n->fd = sv[0];
+  n->out = out[0];
+  n->alive = 1;
+  n->running = 1;
+  running_count++;
+}
+
+/* Prints the complete lines the node wrote so far */
+static void
+read_output(struct node *n)
+{
+  ssize_t len;
+  char *p, *end;
+
+  while((len = read(n->out, n->line + n->line_len,
+                    sizeof(n->line) - n->line_len - 1)) > 0) {
+    n->line_len += len;
+    n->line[n->line_len] = '\0';
+    p = n->line;
+    while((end = strchr(p, '\n')) != NULL
+          || (p == n->line && n->line_len == sizeof(n->line) - 1)) {
+      if(end != NULL) {
+        *end = '\0';
+      }
+      printf("%llu\tID:%u\t%s\n",
+             (unsigned long long)(now * 1000000 / SIM_SECOND), n->id, p);
+      p = end != NULL ? end + 1 : n->line + n->line_len;
+    }
+    n->line_len -= p - n->line;
+    memmove(n->line, p, n->line_len);
+  }
+}
+
+static void
+stop_node(struct node *n)
+{
+  read_output(n);
+  close(n->fd);
+  close(n->out);
+  n->alive = 0;
+  if(n->running) {
+    n->running = 0;
+    running_count--;
+  }
+}
+
+static void
+send_msg(struct node *n, struct sim_msg *m)
+{
+  if(send(n->fd, m, sizeof(*m), MSG_NOSIGNAL) != sizeof(*m)) {
+    warnx("node %u is gone", n->id);
+    stop_node(n);
+  }
+}
+
+static void
+input(struct node *n)
+{
+  struct sim_msg m;
+
+  if(recv(n->fd, &m, sizeof(m), 0) != sizeof(m)) {
+    warnx("node %u exited", n->id);
+    stop_node(n);
+    return;
+  }
+  switch(m.type) {
+  case SIM_MSG_WAIT:
+    read_output(n);
+    n->wake = m.time > now ? m.time : now;
+    n->running = 0;
+    running_count--;
+    break;
+  case SIM_MSG_TX:
+    if(frame_count == frame_size) {
+      frame_size = frame_size ? 2 * frame_size : 64;
+      frames = realloc(frames, frame_size * sizeof(struct sim_msg));
+      frame_src = realloc(frame_src, frame_size * sizeof(int));
+      if(frames == NULL || frame_src == NULL) {
+        err(1, "realloc");
+      }
+    }
+    frames[frame_count] = m;
+    frame_src[frame_count] = n - nodes;
+    frame_count++;
+    stat_tx++;
+    break;
+  }
+}
+
+/* Lets all running nodes run until they wait */
+static void
+run_nodes(void)
+{
+  struct pollfd *fds;
+  int *index;
+  int i, count;
+
+  fds = malloc(node_count * sizeof(struct pollfd));
+  index = malloc(node_count * sizeof(int));
+  if(fds == NULL || index == NULL) {
+    err(1, "malloc");
+  }
+  while(running_count > 0) {
+    count = 0;
+    for(i = 0; i < node_count; i++) {
+      if(nodes[i].running) {
+        fds[count].fd = nodes[i].fd;
+        fds[count].events = POLLIN;
+        index[count++] = i;
+      }
+    }
+    if(poll(fds, count, -1) < 0) {
+      err(1, "poll");
+    }
+    for(i = 0; i < count; i++) {
+      if(fds[i].revents) {
+        input(&nodes[index[i]]);
+      }
+    }
+  }
+  free(fds);
+  free(index);
+}
+
+/* Delivers the frames starting before horizon to the neighbors, whose
+ * radio will tell if they listen */
+static void
+deliver_frames(uint64_t horizon)
+{
+  struct sim_msg m;
+  struct node *s, *d;
+  int i, j;
+
+  for(i = 0; i < frame_count; ) {
+    if(frames[i].time >= horizon) {
+      i++;
+      continue;
+    }
+    m = frames[i];
+    s = &nodes[frame_src[i]];
+    frames[i] = frames[frame_count - 1];
+    frame_src[i] = frame_src[frame_count - 1];
+    frame_count--;
+
+    m.type = SIM_MSG_RX;
+    for(j = 0; j < s->link_count; j++) {
+      d = &nodes[s->links[j].dst];
+      if(!d->alive) {
+        continue;
+      }
+      if(drand48() >= s->links[j].pdr) {
+        stat_lost++;
+        continue;
+      }
+      m.rssi = s->links[j].rssi;
+      send_msg(d, &m);
+      stat_rx++;
+    }
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  struct rlimit rl;
+  struct timespec t0, t1;
+  struct sim_msg go;
+  unsigned long duration = 3600;
+  long seed = 1;
+  uint64_t end, next, horizon;
+  int c, i;
+
+  while((c = getopt(argc, argv, "+t:s:")) != -1) {
+    if(c == 't') {
+      duration = strtoul(optarg, NULL, 0);
+    } else if(c == 's') {
+      seed = strtol(optarg, NULL, 0);
+    } else {
+      fprintf(stderr, "usage: %s [-t seconds] [-s seed] topology firmware [args...]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if(argc - optind < 2) {
+    fprintf(stderr, "usage: %s [-t seconds] [-s seed] topology firmware [args...]\n", argv[0]);
+    exit(1);
+  }
+  srand48(seed);
+  end = (uint64_t)duration * SIM_SECOND;
+  for(i = 0; i < MAX_NODE_ID; i++) {
+    index_of[i] = -1;
+  }
+  read_topology(argv[optind]);
+
+  /* Two descriptors per node */
+  if(getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for(i = 0; i < node_count; i++) {
+    start_node(&nodes[i], argv + optind + 1);
+  }
+
+  memset(&go, 0, sizeof(go));
+  go.type = SIM_MSG_GO;
+  for(;;) {
+    run_nodes();
+    next = UINT64_MAX;
+    for(i = 0; i < node_count; i++) {
+      if(nodes[i].alive && nodes[i].wake < next) {
+        next = nodes[i].wake;
+      }
+    }
+    if(next == UINT64_MAX || next > end) {
+      break;
+    }
+    now = next;
+    /* No node can send a frame starting before the horizon any more */
+    horizon = now + SIM_TX_DELAY;
+    deliver_frames(horizon);
+    go.horizon = horizon;
+    for(i = 0; i < node_count; i++) {
+      if(nodes[i].alive && nodes[i].wake < horizon) {
+        go.time = nodes[i].wake;
+        nodes[i].running = 1;
+        running_count++;
+        send_msg(&nodes[i], &go);
+      }
+    }
+  }
+
+  for(i = 0; i < node_count; i++) {
+    if(nodes[i].alive) {
+      stop_node(&nodes[i]);
+      kill(nodes[i].pid, SIGKILL);
+    }
+    waitpid(nodes[i].pid, NULL, 0);
+  }
+  fflush(stdout);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  fprintf(stderr, "tsch-sim: %d nodes, %llu s in %.1f s, frames %lu delivered %lu lost %lu\n",
+          node_count, (unsigned long long)(now / SIM_SECOND),
+          (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9,
+          stat_tx, stat_rx, stat_lost);
+  return 0;
+}
@@ -0,0 +1,544 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Statistics from tsch-testbed logs (examples/tsch-testbed). Reads the
+ * text logs of any number of nodes, from files or stdin, one line at a
+ * time, and keeps per-flow and per-node counters only, so that multi-day
+ * logs can be processed. Binary logs are first decoded with
+ * deployment-log-decode and tsch-log-decode.
+ *
+ * Uses the following lines:
+ *   App: sending/could not send/received [seqno hop src->dest] (lat N):
+ *     per-flow and per-node PDR, duplicates and latency distribution
+ *   Duty Cycle: [id cnt] tx +rx /time: per-node duty cycle
+ *   Duty Cycle TSCH: [id] sf handle tx rx idle: per-slotframe radio time
+ *   TSCH: {asn-.. link-sf-size-ts-choff ch-..} .. tx|rx: per-slotframe activity
+ *   RPL: parent switch: per-node parent switches
+ * The last two do not include the node id, which is then taken from the
+ * line prefix: "ID:<id>" as in Cooja logs, or the whitespace-separated
+ * field given with -f, counting from 0.
+ *
+ * Prints tables in CSV, every row starting with the table name, or JSON
+ * with -j. Latencies are in the unit of the logs: slots with TSCH.
+ *
+ * Usage: tsch-testbed-stats [-j] [-f field] [file...]
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+
+#define MAX_NODE_ID 65536
+#define MAX_SLOTFRAMES 8
+#define FLOW_HASH_SIZE 1024
+/* Log-linear latency histogram: values up to 15 have their own bucket,
+ * then 8 buckets per power of two */
+#define LAT_LINEAR 16
+#define LAT_BUCKETS (LAT_LINEAR + (32 - 4) * 8)
+/* Received sequence numbers we remember per flow, to detect duplicates */
+#define SEQNO_WINDOW 64
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+struct slotframe_stats {
+  int used;
+  unsigned handle;
+  unsigned long tx, rx;
+  unsigned long long radio_tx, radio_rx, radio_idle;
+};
+
+struct node {
+  unsigned long sent, failed, delivered;
+  unsigned long long dc_tx, dc_rx, dc_time;
+  unsigned long parent_switches;
+  struct slotframe_stats sf[MAX_SLOTFRAMES];
+};
+
+struct flow {
+  struct flow *next;
+  unsigned src, dest;
+  unsigned long sent, failed, received, duplicates;
+  /* Highest counter received, and bitmap of the previous ones,
+   * bit n set if last - n was received */
+  uint16_t last;
+  uint64_t seen;
+  unsigned long lat_count;
+  unsigned long long lat_sum;
+  unsigned long lat_max;
+  uint32_t lat[LAT_BUCKETS];
+};
+
+static struct node *nodes[MAX_NODE_ID];
+static struct flow *flows[FLOW_HASH_SIZE];
+static uint64_t lat_all[LAT_BUCKETS];
+static int id_field = -1;
+static int json;
+
+static struct node *
+get_node(unsigned id)
+{
+  if(id >= MAX_NODE_ID) {
+    id = 0;
+  }
+  if(nodes[id] == NULL && (nodes[id] = calloc(1, sizeof(struct node))) == NULL) {
+    err(1, "calloc");
+  }
+  return nodes[id];
+}
+
+static struct flow *
+get_flow(unsigned src, unsigned dest)
+{
+  unsigned h = (src * 31 + dest) % FLOW_HASH_SIZE;
+  struct flow *f;
+
+  for(f = flows[h]; f != NULL; f = f->next) {
+    if(f->src == src && f->dest == dest) {
+      return f;
+    }
+  }
+  if((f = calloc(1, sizeof(struct flow))) == NULL) {
+    err(1, "calloc");
+  }
+  f->src = src;
+  f->dest = dest;
+  f->next = flows[h];
+  flows[h] = f;
+  return f;
+}
+
+static struct slotframe_stats *
+get_slotframe(struct node *n, unsigned handle)
+{
+  int i;
+  for(i = 0; i < MAX_SLOTFRAMES; i++) {
+    if(!n->sf[i].used) {
+      n->sf[i].used = 1;
+      n->sf[i].handle = handle;
+    }
+    if(n->sf[i].handle == handle) {
+      return &n->sf[i];
+    }
+  }
+  return NULL;
+}
+
+static int
+lat_bucket(unsigned long v)
+{
+  int e = 4;
+  if(v < LAT_LINEAR) {
+    return v;
+  }
+  while(e < 31 && (v >> (e + 1)) != 0) {
+    e++;
+  }
+  return LAT_LINEAR + (e - 4) * 8 + ((v >> (e - 3)) & 7);
+}
+
+/* Largest value of a bucket */
+static unsigned long
+lat_bucket_max(int b)
+{
+  int e;
+  if(b < LAT_LINEAR) {
+    return b;
+  }
+  e = 4 + (b - LAT_LINEAR) / 8;
+  return ((8UL + (b - LAT_LINEAR) % 8 + 1) << (e - 3)) - 1;
+}
+
+/* Percentile p (0-100) of a histogram of count values */
+static unsigned long
+lat_percentile(const uint32_t *h, unsigned long count, int p)
+{
+  unsigned long long sum = 0;
+  int b;
+  for(b = 0; b < LAT_BUCKETS; b++) {
+    sum += h[b];
+    if(sum * 100 >= (unsigned long long)count * p && sum > 0) {
+      return lat_bucket_max(b);
+    }
+  }
+  return 0;
+}
+
+/* Record a received counter. Returns 1 if new, 0 if duplicate */
+static int
+seqno_update(struct flow *f, uint16_t counter)
+{
+  int16_t diff;
+
+  if(f->seen == 0) {
+    f->last = counter;
+    f->seen = 1;
+    return 1;
+  }
+  diff = (int16_t)(counter - f->last);
+  if(diff > 0) {
+    f->seen = diff < SEQNO_WINDOW ? (f->seen << diff) | 1 : 1;
+    f->last = counter;
+    return 1;
+  }
+  if(-diff >= SEQNO_WINDOW) {
+    /* Far behind: the source rebooted */
+    f->last = counter;
+    f->seen = 1;
+    return 1;
+  }
+  if(f->seen & ((uint64_t)1 << -diff)) {
+    return 0;
+  }
+  f->seen |= (uint64_t)1 << -diff;
+  return 1;
+}
+
+/* Node id of a line without one in the message */
+static unsigned
+line_node_id(const char *line)
+{
+  const char *p;
+  int i;
+
+  if(id_field >= 0) {
+    p = line;
+    for(i = 0; i < id_field; i++) {
+      p += strspn(p, " \t");
+      p += strcspn(p, " \t");
+    }
+    return strtoul(p, NULL, 10);
+  }
+  if((p = strstr(line, "ID:")) != NULL) {
+    return strtoul(p + 3, NULL, 10);
+  }
+  return 0;
+}
+
+static void
+parse_app(const char *p, int type)
+{
+  unsigned long seqno, lat;
+  unsigned hop, src, dest;
+  const char *l;
+  struct flow *f;
+
+  if((p = strchr(p, '[')) == NULL
+     || sscanf(p, "[%lx %u %u->%u]", &seqno, &hop, &src, &dest) != 4) {
+    return;
+  }
+  f = get_flow(src, dest);
+  switch(type) {
+    case 's':
+      f->sent++;
+      get_node(src)->sent++;
+      break;
+    case 'f':
+      f->failed++;
+      get_node(src)->failed++;
+      break;
+    case 'r':
+      if(!seqno_update(f, seqno & 0xffff)) {
+        f->duplicates++;
+        break;
+      }
+      f->received++;
+      get_node(src)->delivered++;
+      if((l = strstr(p, "] lat ")) != NULL) {
+        lat = strtoul(l + 6, NULL, 10);
+        f->lat[lat_bucket(lat)]++;
+        lat_all[lat_bucket(lat)]++;
+        f->lat_count++;
+        f->lat_sum += lat;
+        if(lat > f->lat_max) {
+          f->lat_max = lat;
+        }
+      }
+      break;
+  }
+}
+
+static void
+parse_line(const char *line)
+{
+  const char *p;
+  unsigned id, cnt, handle;
+  unsigned long tx, rx, idle, time;
+  struct slotframe_stats *sf;
+
+  if((p = strstr(line, "App: sending")) != NULL) {
+    parse_app(p, 's');
+  } else if((p = strstr(line, "App: could not send")) != NULL) {
+    parse_app(p, 'f');
+  } else if((p = strstr(line, "App: received")) != NULL) {
+    parse_app(p, 'r');
+  } else if((p = strstr(line, "Duty Cycle: [")) != NULL) {
+    if(sscanf(p, "Duty Cycle: [%u %u] %lu +%lu /%lu", &id, &cnt, &tx, &rx, &time) == 5) {
+      struct node *n = get_node(id);
+      n->dc_tx += tx;
+      n->dc_rx += rx;
+      n->dc_time += time;
+    }
+  } else if((p = strstr(line, "Duty Cycle TSCH: [")) != NULL) {
+    if(sscanf(p, "Duty Cycle TSCH: [%u] sf %u %lu %lu %lu", &id, &handle, &tx, &rx, &idle) == 5
+       && (sf = get_slotframe(get_node(id), handle)) != NULL) {
+      sf->radio_tx += tx;
+      sf->radio_rx += rx;
+      sf->radio_idle += idle;
+    }
+  } else if((p = strstr(line, "TSCH: {asn-")) != NULL) {
+    const char *link = strstr(p, " link-");
+    const char *op = strchr(p, '}');
+    if(link != NULL && op != NULL && sscanf(link, " link-%u-", &handle) == 1
+       && (sf = get_slotframe(get_node(line_node_id(line)), handle)) != NULL) {
+      if(strstr(op, " tx ") != NULL) {
+        sf->tx++;
+      } else if(strstr(op, " rx ") != NULL) {
+        sf->rx++;
+      }
+    }
+  } else if(strstr(line, "RPL: parent switch") != NULL) {
+    get_node(line_node_id(line))->parent_switches++;
+  }
+}
+
+static void
+read_file(FILE *in)
+{
+  char line[1024];
+  size_t len;
+  int partial = 0;
+
+  while(fgets(line, sizeof(line), in) != NULL) {
+    len = strlen(line);
+    /* Drop the end of overlong lines, the beginning has what we parse */
+    if(!partial) {
+      parse_line(line);
+    }
+    partial = len > 0 && line[len - 1] != '\n';
+  }
+}
+
+/* Print a table row of already formatted values: in CSV, prefixed with
+ * the table name, in JSON as an object with the names of the header */
+static void
+print_row(const char *table, const char *header, int first, int ncols, char cols[][32])
+{
+  char names[256];
+  char *name, *save;
+  int i;
+
+  if(!json) {
+    printf("%s", table);
+    for(i = 0; i < ncols; i++) {
+      printf(",%s", cols[i]);
+    }
+    printf("\n");
+    return;
+  }
+  strncpy(names, header, sizeof(names) - 1);
+  names[sizeof(names) - 1] = '\0';
+  printf("%s\n    {", first ? "" : ",");
+  for(i = 0, name = strtok_r(names, ",", &save); i < ncols && name != NULL;
+      i++, name = strtok_r(NULL, ",", &save)) {
+    printf("%s\"%s\": %s", i ? ", " : "", name, cols[i]);
+  }
+  printf("}");
+}
+
+static void
+print_table_start(const char *table, const char *header, int first)
+{
+  if(json) {
+    printf("%s  \"%s\": [", first ? "{\n" : ",\n", table);
+  } else {
+    printf("%s,%s\n", table, header);
+  }
+}
+
+static void
+print_table_end(void)
+{
+  if(json) {
+    printf("\n  ]");
+  }
+}
+
+static void
+print_ratio(char *buf, unsigned long long num, unsigned long long den)
+{
+  if(den == 0) {
+    strcpy(buf, json ? "null" : "");
+  } else {
+    snprintf(buf, 32, "%.3f", (double)num / den);
+  }
+}
+
+static void
+print_stats(void)
+{
+  static const char *flow_header =
+    "src,dest,sent,failed,received,duplicates,pdr,lat_avg,lat_p50,lat_p90,lat_p99,lat_max";
+  static const char *node_header =
+    "id,sent,failed,delivered,pdr,duty_cycle,parent_switches";
+  static const char *sf_header =
+    "id,handle,tx,rx,radio_tx,radio_rx,radio_idle,utilization";
+  static const char *cdf_header = "latency,fraction";
+  char cols[12][32];
+  struct flow *f;
+  uint64_t count = 0, sum = 0;
+  unsigned id;
+  int i, b, first;
+
+  print_table_start("flow", flow_header, 1);
+  first = 1;
+  for(i = 0; i < FLOW_HASH_SIZE; i++) {
+    for(f = flows[i]; f != NULL; f = f->next) {
+      snprintf(cols[0], 32, "%u", f->src);
+      snprintf(cols[1], 32, "%u", f->dest);
+      snprintf(cols[2], 32, "%lu", f->sent);
+      snprintf(cols[3], 32, "%lu", f->failed);
+      snprintf(cols[4], 32, "%lu", f->received);
+      snprintf(cols[5], 32, "%lu", f->duplicates);
+      print_ratio(cols[6], f->received, f->sent);
+      print_ratio(cols[7], f->lat_sum, f->lat_count);
+      if(f->lat_count) {
+        snprintf(cols[8], 32, "%lu", MIN(lat_percentile(f->lat, f->lat_count, 50), f->lat_max));
+        snprintf(cols[9], 32, "%lu", MIN(lat_percentile(f->lat, f->lat_count, 90), f->lat_max));
+        snprintf(cols[10], 32, "%lu", MIN(lat_percentile(f->lat, f->lat_count, 99), f->lat_max));
+        snprintf(cols[11], 32, "%lu", f->lat_max);
+      } else {
+        for(b = 8; b < 12; b++) {
+          strcpy(cols[b], json ? "null" : "");
+        }
+      }
+      print_row("flow", flow_header, first, 12, cols);
+      first = 0;
+    }
+  }
+  print_table_end();
+
+  print_table_start("node", node_header, 0);
+  first = 1;
+  for(id = 0; id < MAX_NODE_ID; id++) {
+    struct node *n = nodes[id];
+    if(n == NULL) {
+      continue;
+    }
+    snprintf(cols[0], 32, "%u", id);
+    snprintf(cols[1], 32, "%lu", n->sent);
+    snprintf(cols[2], 32, "%lu", n->failed);
+    snprintf(cols[3], 32, "%lu", n->delivered);
+    print_ratio(cols[4], n->delivered, n->sent);
+    print_ratio(cols[5], n->dc_tx + n->dc_rx, n->dc_time);
+    snprintf(cols[6], 32, "%lu", n->parent_switches);
+    print_row("node", node_header, first, 7, cols);
+    first = 0;
+  }
+  print_table_end();
+
+  print_table_start("slotframe", sf_header, 0);
+  first = 1;
+  for(id = 0; id < MAX_NODE_ID; id++) {
+    if(nodes[id] == NULL) {
+      continue;
+    }
+    for(i = 0; i < MAX_SLOTFRAMES && nodes[id]->sf[i].used; i++) {
+      struct slotframe_stats *sf = &nodes[id]->sf[i];
+      snprintf(cols[0], 32, "%u", id);
+      snprintf(cols[1], 32, "%u", sf->handle);
+      snprintf(cols[2], 32, "%lu", sf->tx);
+      snprintf(cols[3], 32, "%lu", sf->rx);
+      snprintf(cols[4], 32, "%llu", sf->radio_tx);
+      snprintf(cols[5], 32, "%llu", sf->radio_rx);
+      snprintf(cols[6], 32, "%llu", sf->radio_idle);
+      /* Share of the radio-on time spent in actual Tx or Rx */
+      print_ratio(cols[7], sf->radio_tx + sf->radio_rx,
+                  sf->radio_tx + sf->radio_rx + sf->radio_idle);
+      print_row("slotframe", sf_header, first, 8, cols);
+      first = 0;
+    }
+  }
+  print_table_end();
+
+  print_table_start("latency_cdf", cdf_header, 0);
+  for(b = 0; b < LAT_BUCKETS; b++) {
+    count += lat_all[b];
+  }
+  first = 1;
+  for(b = 0; b < LAT_BUCKETS; b++) {
+    if(lat_all[b] == 0) {
+      continue;
+    }
+    sum += lat_all[b];
+    snprintf(cols[0], 32, "%lu", lat_bucket_max(b));
+    print_ratio(cols[1], sum, count);
+    print_row("latency_cdf", cdf_header, first, 2, cols);
+    first = 0;
+  }
+  print_table_end();
+  if(json) {
+    printf("\n}\n");
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  FILE *in;
+  int c;
+
+  while((c = getopt(argc, argv, "jf:")) != -1) {
+    if(c == 'j') {
+      json = 1;
+    } else if(c == 'f') {
+      id_field = atoi(optarg);
+    } else {
+      fprintf(stderr, "usage: %s [-j] [-f field] [file...]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if(optind == argc) {
+    read_file(stdin);
+  }
+  for(; optind < argc; optind++) {
+    if((in = fopen(argv[optind], "r")) == NULL) {
+      err(1, "%s", argv[optind]);
+    }
+    read_file(in);
+    fclose(in);
+  }
+
+  print_stats();
+  return 0;
+}
@@ -41,6 +41,8 @@
 #include <string.h>
 #include <time.h>
 #include <sys/types.h>
+#include <sys/time.h>
+#include <pthread.h>
 
 #include <unistd.h>
 #include <errno.h>
@@ -48,6 +50,9 @@
 #include <signal.h>
 #include <termios.h>
 #include <sys/ioctl.h>
+#ifdef linux
+#include <linux/serial.h>
+#endif
 
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -67,16 +72,12 @@ int verbose = 1;
 const char *ipaddr;
 const char *netmask;
 int slipfd = 0;
-uint16_t basedelay=0,delaymsec=0;
-uint32_t startsec,startmsec,delaystartsec,delaystartmsec;
+uint16_t basedelay=0;
 int timestamp = 0, flowcontrol=0, showprogress=0, flowcontrol_xonxoff=0;
 
 int ssystem(const char *fmt, ...)
      __attribute__((__format__ (__printf__, 1, 2)));
-void write_to_serial(int outfd, void *inbuf, int len);
-
-void slip_send(int fd, unsigned char c);
-void slip_send_char(int fd, unsigned char c);
+void write_to_serial(void *inbuf, int len);
 
 #define PROGRESS(s) if(showprogress) fprintf(stderr, s)
 
@@ -165,255 +166,374 @@ is_sensible_string(const unsigned char *s, int len)
 }
 
 /*
- * Read from serial, when we have a packet write it to tun. No output
- * buffering, input buffered by stdio.
+ * Output queue. The tun reader and the control thread SLIP-encode whole
+ * frames into txq; the serial writer hands everything queued to write()
+ * at once. Positions are running byte counts, taken modulo TXQ_SIZE.
  */
-void
-serial_to_tun(FILE *inslip, int outfd)
+#define TXQ_SIZE   65536
+#define TXQ_FRAMES 256
+/* Worst case SLIP encoding of a 2000-byte packet */
+#define SLIP_MAX_FRAME (2 * 2000 + 1)
+
+static unsigned char txq[TXQ_SIZE];
+static unsigned long txq_head, txq_tail;
+/* End position and queuing time of every frame queued */
+static struct {
+  unsigned long end;
+  unsigned long long queued;
+} txq_frames[TXQ_FRAMES];
+static unsigned txq_frame_head, txq_frame_tail;
+/* Protects the output queue and the statistics */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t txq_data = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t txq_space = PTHREAD_COND_INITIALIZER;
+/* Time of the last write to serial */
+static unsigned long long last_tx;
+
+/* Statistics, printed every stats_interval seconds with -S */
+static struct {
+  unsigned long tx_packets, tx_bytes;   /* tun -> serial, SLIP bytes */
+  unsigned long rx_packets, rx_bytes;   /* serial -> tun, SLIP bytes */
+  unsigned long rx_dropped;
+  unsigned long long latency_sum;       /* us, since last print */
+  unsigned long latency_count;
+  unsigned long latency_max;
+  unsigned long queue_max;              /* bytes, since last print */
+} stats;
+int stats_interval = 0;
+
+static unsigned long long
+now_usec(void)
 {
-  static union {
-    unsigned char inbuf[2000];
-  } uip;
-  static int inbufptr = 0;
-  int ret,i;
-  unsigned char c;
+  struct timeval tv;
 
-#ifdef linux
-  ret = fread(&c, 1, 1, inslip);
-  if(ret == -1 || ret == 0) err(1, "serial_to_tun: read");
-  goto after_fread;
-#endif
+  gettimeofday(&tv, NULL);
+  return (unsigned long long)tv.tv_sec * 1000000 + tv.tv_usec;
+}
 
- read_more:
-  if(inbufptr >= sizeof(uip.inbuf)) {
-     if(timestamp) stamptime();
-     fprintf(stderr, "*** dropping large %d byte packet\n",inbufptr);
-	 inbufptr = 0;
-  }
-  ret = fread(&c, 1, 1, inslip);
-#ifdef linux
- after_fread:
-#endif
-  if(ret == -1) {
-    err(1, "serial_to_tun: read");
-  }
-  if(ret == 0) {
-    clearerr(inslip);
-    return;
-  }
-  PROGRESS(".");
-  switch(c) {
-  case SLIP_END:
-    if(inbufptr > 0) {
-      if(uip.inbuf[0] == '!') {
-	if(uip.inbuf[1] == 'M') {
-	  /* Read gateway MAC address and autoconfigure tap0 interface */
-	  char macs[24];
-	  int i, pos;
-	  for(i = 0, pos = 0; i < 16; i++) {
-	    macs[pos++] = uip.inbuf[2 + i];
-	    if((i & 1) == 1 && i < 14) {
-	      macs[pos++] = ':';
-	    }
-	  }
-          if(timestamp) stamptime();
-	  macs[pos] = '\0';
-//	  printf("*** Gateway's MAC address: %s\n", macs);
-	  fprintf(stderr,"*** Gateway's MAC address: %s\n", macs);
-          if (timestamp) stamptime();
-	  ssystem("ifconfig %s down", tundev);
-          if (timestamp) stamptime();
-	  ssystem("ifconfig %s hw ether %s", tundev, &macs[6]);
-          if (timestamp) stamptime();
-	  ssystem("ifconfig %s up", tundev);
-	}
-      } else if(uip.inbuf[0] == '?') {
-	if(uip.inbuf[1] == 'P') {
-          /* Prefix info requested */
-          struct in6_addr addr;
-	  int i;
-	  char *s = strchr(ipaddr, '/');
-	  if(s != NULL) {
-	    *s = '\0';
-	  }
-          inet_pton(AF_INET6, ipaddr, &addr);
-          if(timestamp) stamptime();
-          fprintf(stderr,"*** Address:%s => %02x%02x:%02x%02x:%02x%02x:%02x%02x\n",
-		 ipaddr,
-		 addr.s6_addr[0], addr.s6_addr[1],
-		 addr.s6_addr[2], addr.s6_addr[3],
-		 addr.s6_addr[4], addr.s6_addr[5],
-		 addr.s6_addr[6], addr.s6_addr[7]);
-	  slip_send(slipfd, '!');
-	  slip_send(slipfd, 'P');
-	  for(i = 0; i < 8; i++) {
-	    /* need to call the slip_send_char for stuffing */
-	    slip_send_char(slipfd, addr.s6_addr[i]);
-	  }
-	  slip_send(slipfd, SLIP_END);
-        }
-#define DEBUG_LINE_MARKER '\r'
-      } else if(uip.inbuf[0] == DEBUG_LINE_MARKER) {
-	fwrite(uip.inbuf + 1, inbufptr - 1, 1, stdout);
-      } else if(is_sensible_string(uip.inbuf, inbufptr)) {
-        if(verbose==1) {   /* strings already echoed below for verbose>1 */
-          if (timestamp) stamptime();
-          fwrite(uip.inbuf, inbufptr, 1, stdout);
-        }
-      } else {
-        if(verbose>2) {
-          if (timestamp) stamptime();
-          printf("Packet from SLIP of length %d - write TUN\n", inbufptr);
-          if (verbose>4) {
-#if WIRESHARK_IMPORT_FORMAT
-            printf("0000");
-	        for(i = 0; i < inbufptr; i++) printf(" %02x",uip.inbuf[i]);
-#else
-            printf("         ");
-            for(i = 0; i < inbufptr; i++) {
-              printf("%02x", uip.inbuf[i]);
-              if((i & 3) == 3) printf(" ");
-              if((i & 15) == 15) printf("\n         ");
-            }
-#endif
-            printf("\n");
-          }
-        }
-	if(write(outfd, uip.inbuf, inbufptr) != inbufptr) {
-	  err(1, "serial_to_tun: write");
-	}
-      }
-      inbufptr = 0;
-    }
-    break;
-
-  case SLIP_ESC:
-    if(fread(&c, 1, 1, inslip) != 1) {
-      clearerr(inslip);
-      /* Put ESC back and give up! */
-      ungetc(SLIP_ESC, inslip);
-      return;
-    }
+/* Encodes a packet as one SLIP frame; returns the length of the frame */
+int
+slip_encode(unsigned char *dst, const unsigned char *src, int len)
+{
+  unsigned char *p = dst;
+  int i;
 
-    switch(c) {
-    case SLIP_ESC_END:
-      c = SLIP_END;
-      break;
-    case SLIP_ESC_ESC:
-      c = SLIP_ESC;
-      break;
-    case SLIP_ESC_XON:
-      c = XON;
+  for(i = 0; i < len; i++) {
+    switch(src[i]) {
+    case SLIP_END:
+      *p++ = SLIP_ESC;
+      *p++ = SLIP_ESC_END;
       break;
-    case SLIP_ESC_XOFF:
-      c = XOFF;
+    case SLIP_ESC:
+      *p++ = SLIP_ESC;
+      *p++ = SLIP_ESC_ESC;
       break;
-    }
-    /* FALLTHROUGH */
-  default:
-    uip.inbuf[inbufptr++] = c;
-
-    /* Echo lines as they are received for verbose=2,3,5+ */
-    /* Echo all printable characters for verbose==4 */
-    if((verbose==2) || (verbose==3) || (verbose>4)) {
-      if(c=='\n') {
-        if(is_sensible_string(uip.inbuf, inbufptr)) {
-          if (timestamp) stamptime();
-          fwrite(uip.inbuf, inbufptr, 1, stdout);
-          inbufptr=0;
-        }
+    case XON:
+      if(flowcontrol_xonxoff) {
+        *p++ = SLIP_ESC;
+        *p++ = SLIP_ESC_XON;
+      } else {
+        *p++ = src[i];
       }
-    } else if(verbose==4) {
-      if(c == 0 || c == '\r' || c == '\n' || c == '\t' || (c >= ' ' && c <= '~')) {
-	fwrite(&c, 1, 1, stdout);
-        if(c=='\n') if(timestamp) stamptime();
+      break;
+    case XOFF:
+      if(flowcontrol_xonxoff) {
+        *p++ = SLIP_ESC;
+        *p++ = SLIP_ESC_XOFF;
+      } else {
+        *p++ = src[i];
       }
+      break;
+    default:
+      *p++ = src[i];
+      break;
     }
-
-    break;
   }
-
-  goto read_more;
+  *p++ = SLIP_END;
+  return p - dst;
 }
 
-unsigned char slip_buf[2000];
-int slip_end, slip_begin;
-
+/* Queues len bytes for serial as one frame, waiting for room if needed */
 void
-slip_send_char(int fd, unsigned char c)
+txq_put(const unsigned char *data, int len)
 {
-  switch(c) {
-  case SLIP_END:
-    slip_send(fd, SLIP_ESC);
-    slip_send(fd, SLIP_ESC_END);
-    break;
-  case SLIP_ESC:
-    slip_send(fd, SLIP_ESC);
-    slip_send(fd, SLIP_ESC_ESC);
-    break;
-  case XON:
-    if(flowcontrol_xonxoff) {
-      slip_send(fd, SLIP_ESC);
-      slip_send(fd, SLIP_ESC_XON);
-    } else {
-      slip_send(fd, c);
-    }
-    break;
-  case XOFF:
-    if(flowcontrol_xonxoff) {
-      slip_send(fd, SLIP_ESC);
-      slip_send(fd, SLIP_ESC_XOFF);
-    } else {
-      slip_send(fd, c);
-    }
-    break;
-  default:
-    slip_send(fd, c);
-    break;
+  unsigned long pos;
+  int n;
+
+  pthread_mutex_lock(&lock);
+  while(TXQ_SIZE - (txq_head - txq_tail) < len ||
+        txq_frame_head - txq_frame_tail == TXQ_FRAMES) {
+    PROGRESS("Q");		/* Outqueue is full! */
+    pthread_cond_wait(&txq_space, &lock);
+  }
+  pos = txq_head % TXQ_SIZE;
+  n = TXQ_SIZE - pos < len ? TXQ_SIZE - pos : len;
+  memcpy(txq + pos, data, n);
+  memcpy(txq, data + n, len - n);
+  txq_head += len;
+  txq_frames[txq_frame_head % TXQ_FRAMES].end = txq_head;
+  txq_frames[txq_frame_head % TXQ_FRAMES].queued = now_usec();
+  txq_frame_head++;
+  if(txq_head - txq_tail > stats.queue_max) {
+    stats.queue_max = txq_head - txq_tail;
   }
+  pthread_cond_signal(&txq_data);
+  pthread_mutex_unlock(&lock);
 }
 
+/* SLIP-encodes and queues a packet */
 void
-slip_send(int fd, unsigned char c)
+slip_send_packet(const void *data, int len)
 {
-  if(slip_end >= sizeof(slip_buf)) {
-    err(1, "slip_send overflow");
-  }
-  slip_buf[slip_end] = c;
-  slip_end++;
+  unsigned char frame[SLIP_MAX_FRAME];
+
+  txq_put(frame, slip_encode(frame, data, len));
 }
 
-int
-slip_empty()
+/*
+ * Serial writer thread. Writes as much of the queue as possible per
+ * write(), or one frame at a time when a delay between frames is set.
+ */
+void *
+serial_writer(void *arg)
 {
-  return slip_end == 0;
+  unsigned long pos, len;
+  unsigned long long now, latency;
+  int frame_done;
+  int n;
+
+  while(1) {
+    pthread_mutex_lock(&lock);
+    while(txq_head == txq_tail) {
+      pthread_cond_wait(&txq_data, &lock);
+    }
+    len = basedelay ? txq_frames[txq_frame_tail % TXQ_FRAMES].end - txq_tail
+                    : txq_head - txq_tail;
+    pthread_mutex_unlock(&lock);
+
+    /* The queued bytes are not touched by the producers until released */
+    pos = txq_tail % TXQ_SIZE;
+    if(len > TXQ_SIZE - pos) {
+      len = TXQ_SIZE - pos;
+    }
+    n = write(slipfd, txq + pos, len);
+    if(n == -1) {
+      if(errno == EINTR || errno == EAGAIN) {
+        continue;
+      }
+      err(1, "serial_writer: write");
+    }
+
+    now = now_usec();
+    frame_done = 0;
+    pthread_mutex_lock(&lock);
+    txq_tail += n;
+    stats.tx_bytes += n;
+    last_tx = now;
+    while(txq_frame_tail != txq_frame_head &&
+          txq_frames[txq_frame_tail % TXQ_FRAMES].end <= txq_tail) {
+      latency = now - txq_frames[txq_frame_tail % TXQ_FRAMES].queued;
+      stats.latency_sum += latency;
+      stats.latency_count++;
+      if(latency > stats.latency_max) {
+        stats.latency_max = latency;
+      }
+      txq_frame_tail++;
+      frame_done = 1;
+    }
+    pthread_cond_broadcast(&txq_space);
+    pthread_mutex_unlock(&lock);
+
+    /* Optional delay between outgoing packets */
+    if(frame_done && basedelay) {
+      usleep(basedelay * 1000);
+    }
+  }
+  return NULL;
 }
 
+/* Handles a complete frame received from serial */
 void
-slip_flushbuf(int fd)
+packet_input(int outfd, unsigned char *inbuf, int inbufptr)
 {
-  int n;
+  int i;
 
-  if(slip_empty()) {
-    return;
+  if(inbuf[0] == '!') {
+    if(inbuf[1] == 'M') {
+      /* Read gateway MAC address and autoconfigure tap0 interface */
+      char macs[24];
+      int pos;
+      for(i = 0, pos = 0; i < 16; i++) {
+        macs[pos++] = inbuf[2 + i];
+        if((i & 1) == 1 && i < 14) {
+          macs[pos++] = ':';
+        }
+      }
+      if(timestamp) stamptime();
+      macs[pos] = '\0';
+      fprintf(stderr,"*** Gateway's MAC address: %s\n", macs);
+      if (timestamp) stamptime();
+      ssystem("ifconfig %s down", tundev);
+      if (timestamp) stamptime();
+      ssystem("ifconfig %s hw ether %s", tundev, &macs[6]);
+      if (timestamp) stamptime();
+      ssystem("ifconfig %s up", tundev);
+    }
+  } else if(inbuf[0] == '?') {
+    if(inbuf[1] == 'P') {
+      /* Prefix info requested */
+      struct in6_addr addr;
+      unsigned char reply[2 + 8];
+      char prefix[INET6_ADDRSTRLEN];
+      char *s;
+      strncpy(prefix, ipaddr, sizeof(prefix) - 1);
+      prefix[sizeof(prefix) - 1] = '\0';
+      s = strchr(prefix, '/');
+      if(s != NULL) {
+        *s = '\0';
+      }
+      inet_pton(AF_INET6, prefix, &addr);
+      if(timestamp) stamptime();
+      fprintf(stderr,"*** Address:%s => %02x%02x:%02x%02x:%02x%02x:%02x%02x\n",
+              prefix,
+              addr.s6_addr[0], addr.s6_addr[1],
+              addr.s6_addr[2], addr.s6_addr[3],
+              addr.s6_addr[4], addr.s6_addr[5],
+              addr.s6_addr[6], addr.s6_addr[7]);
+      reply[0] = '!';
+      reply[1] = 'P';
+      memcpy(reply + 2, addr.s6_addr, 8);
+      slip_send_packet(reply, sizeof(reply));
+    }
+#define DEBUG_LINE_MARKER '\r'
+  } else if(inbuf[0] == DEBUG_LINE_MARKER) {
+    fwrite(inbuf + 1, inbufptr - 1, 1, stdout);
+  } else if(is_sensible_string(inbuf, inbufptr)) {
+    if(verbose==1) {   /* strings already echoed below for verbose>1 */
+      if (timestamp) stamptime();
+      fwrite(inbuf, inbufptr, 1, stdout);
+    }
+  } else {
+    if(verbose>2) {
+      if (timestamp) stamptime();
+      printf("Packet from SLIP of length %d - write TUN\n", inbufptr);
+      if (verbose>4) {
+#if WIRESHARK_IMPORT_FORMAT
+        printf("0000");
+        for(i = 0; i < inbufptr; i++) printf(" %02x",inbuf[i]);
+#else
+        printf("         ");
+        for(i = 0; i < inbufptr; i++) {
+          printf("%02x", inbuf[i]);
+          if((i & 3) == 3) printf(" ");
+          if((i & 15) == 15) printf("\n         ");
+        }
+#endif
+        printf("\n");
+      }
+    }
+    if(write(outfd, inbuf, inbufptr) != inbufptr) {
+      err(1, "serial_to_tun: write");
+    }
+    pthread_mutex_lock(&lock);
+    stats.rx_packets++;
+    pthread_mutex_unlock(&lock);
   }
+}
 
-  n = write(fd, slip_buf + slip_begin, (slip_end - slip_begin));
+/*
+ * Serial reader thread. Reads from serial in large chunks, when we have a
+ * packet write it to tun.
+ */
+void *
+serial_to_tun(void *arg)
+{
+  static unsigned char inbuf[2000];
+  static unsigned char readbuf[4096];
+  int outfd = *(int *)arg;
+  int inbufptr = 0;
+  int escaped = 0;
+  int n, i;
+  unsigned char c;
 
-  if(n == -1 && errno != EAGAIN) {
-    err(1, "slip_flushbuf write failed");
-  } else if(n == -1) {
-    PROGRESS("Q");		/* Outqueueis full! */
-  } else {
-    slip_begin += n;
-    if(slip_begin == slip_end) {
-      slip_begin = slip_end = 0;
+  while(1) {
+    n = read(slipfd, readbuf, sizeof(readbuf));
+    if(n == -1) {
+      if(errno == EINTR || errno == EAGAIN) {
+        continue;
+      }
+      err(1, "serial_to_tun: read");
+    }
+    if(n == 0) {
+      errx(1, "serial_to_tun: end of file");
+    }
+    pthread_mutex_lock(&lock);
+    stats.rx_bytes += n;
+    pthread_mutex_unlock(&lock);
+
+    for(i = 0; i < n; i++) {
+      c = readbuf[i];
+      PROGRESS(".");
+      if(escaped) {
+        escaped = 0;
+        switch(c) {
+        case SLIP_ESC_END:
+          c = SLIP_END;
+          break;
+        case SLIP_ESC_ESC:
+          c = SLIP_ESC;
+          break;
+        case SLIP_ESC_XON:
+          c = XON;
+          break;
+        case SLIP_ESC_XOFF:
+          c = XOFF;
+          break;
+        }
+      } else if(c == SLIP_END) {
+        if(inbufptr > 0) {
+          packet_input(outfd, inbuf, inbufptr);
+          inbufptr = 0;
+        }
+        continue;
+      } else if(c == SLIP_ESC) {
+        escaped = 1;
+        continue;
+      }
+
+      if(inbufptr >= sizeof(inbuf)) {
+        if(timestamp) stamptime();
+        fprintf(stderr, "*** dropping large %d byte packet\n", inbufptr);
+        inbufptr = 0;
+        pthread_mutex_lock(&lock);
+        stats.rx_dropped++;
+        pthread_mutex_unlock(&lock);
+      }
+      inbuf[inbufptr++] = c;
+
+      /* Echo lines as they are received for verbose=2,3,5+ */
+      /* Echo all printable characters for verbose==4 */
+      if((verbose==2) || (verbose==3) || (verbose>4)) {
+        if(c=='\n') {
+          if(is_sensible_string(inbuf, inbufptr)) {
+            if (timestamp) stamptime();
+            fwrite(inbuf, inbufptr, 1, stdout);
+            inbufptr=0;
+          }
+        }
+      } else if(verbose==4) {
+        if(c == 0 || c == '\r' || c == '\n' || c == '\t' || (c >= ' ' && c <= '~')) {
+          fwrite(&c, 1, 1, stdout);
+          if(c=='\n') if(timestamp) stamptime();
+        }
+      }
     }
   }
+  return NULL;
 }
 
 void
-write_to_serial(int outfd, void *inbuf, int len)
+write_to_serial(void *inbuf, int len)
 {
   u_int8_t *p = inbuf;
   int i;
@@ -437,62 +557,66 @@ write_to_serial(int outfd, void *inbuf, int len)
     }
   }
 
-  /* It would be ``nice'' to send a SLIP_END here but it's not
-   * really necessary.
-   */
-  /* slip_send(outfd, SLIP_END); */
-
-  for(i = 0; i < len; i++) {
-    switch(p[i]) {
-    case SLIP_END:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_END);
-      break;
-    case SLIP_ESC:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_ESC);
-      break;
-    case XON:
-      if(flowcontrol_xonxoff) {
-        slip_send(outfd, SLIP_ESC);
-        slip_send(outfd, SLIP_ESC_XON);
-      } else {
-        slip_send(outfd, p[i]);
-      }
-      break;
-    case XOFF:
-      if(flowcontrol_xonxoff) {
-        slip_send(outfd, SLIP_ESC);
-        slip_send(outfd, SLIP_ESC_XOFF);
-      } else {
-        slip_send(outfd, p[i]);
-      }
-      break;
-    default:
-      slip_send(outfd, p[i]);
-      break;
-    }
-  }
-  slip_send(outfd, SLIP_END);
+  slip_send_packet(p, len);
+  pthread_mutex_lock(&lock);
+  stats.tx_packets++;
+  pthread_mutex_unlock(&lock);
   PROGRESS("t");
 }
 
 
 /*
- * Read from tun, write to slip.
+ * Tun reader thread. Read from tun, queue for slip.
  */
-int
-tun_to_serial(int infd, int outfd)
+void *
+tun_to_serial(void *arg)
 {
-  struct {
-    unsigned char inbuf[2000];
-  } uip;
+  unsigned char inbuf[2000];
+  int infd = *(int *)arg;
   int size;
 
-  if((size = read(infd, uip.inbuf, 2000)) == -1) err(1, "tun_to_serial: read");
+  while(1) {
+    if((size = read(infd, inbuf, sizeof(inbuf))) == -1) {
+      if(errno == EINTR) {
+        continue;
+      }
+      err(1, "tun_to_serial: read");
+    }
+    write_to_serial(inbuf, size);
+  }
+  return NULL;
+}
+
+/* Prints the statistics of the last period; period in seconds */
+void
+print_stats(int period)
+{
+  unsigned long tx_bytes, rx_bytes;
+  static unsigned long last_tx_bytes, last_rx_bytes;
 
-  write_to_serial(outfd, uip.inbuf, size);
-  return size;
+  if(period <= 0) {
+    period = 1;
+  }
+  pthread_mutex_lock(&lock);
+  tx_bytes = stats.tx_bytes - last_tx_bytes;
+  rx_bytes = stats.rx_bytes - last_rx_bytes;
+  last_tx_bytes = stats.tx_bytes;
+  last_rx_bytes = stats.rx_bytes;
+  if (timestamp) stamptime();
+  fprintf(stderr, "*** Stats: tun->slip %lu packets %lu bytes %lu B/s"
+          " latency avg %lu max %lu us queue %lu max %lu bytes;"
+          " slip->tun %lu packets %lu bytes %lu B/s dropped %lu\n",
+          stats.tx_packets, stats.tx_bytes, tx_bytes / period,
+          stats.latency_count ?
+          (unsigned long)(stats.latency_sum / stats.latency_count) : 0,
+          stats.latency_max, txq_head - txq_tail, stats.queue_max,
+          stats.rx_packets, stats.rx_bytes, rx_bytes / period,
+          stats.rx_dropped);
+  stats.latency_sum = 0;
+  stats.latency_count = 0;
+  stats.latency_max = 0;
+  stats.queue_max = txq_head - txq_tail;
+  pthread_mutex_unlock(&lock);
 }
 
 void
@@ -508,9 +632,9 @@ stty_telos(int fd)
 
   cfmakeraw(&tty);
 
-  /* Nonblocking read. */
+  /* Blocking read, returning what is there as soon as a byte is */
   tty.c_cc[VTIME] = 0;
-  tty.c_cc[VMIN] = 0;
+  tty.c_cc[VMIN] = 1;
   if (flowcontrol)
     tty.c_cflag |= CRTSCTS;
   else
@@ -540,6 +664,17 @@ stty_telos(int fd)
   if(ioctl(fd, TIOCMBIS, &i) == -1) err(1, "ioctl");
 #endif
 
+#if defined(linux) && defined(ASYNC_LOW_LATENCY)
+  {
+    /* Do not let the driver hold received bytes back; not all support it */
+    struct serial_struct ss;
+    if(ioctl(fd, TIOCGSERIAL, &ss) == 0) {
+      ss.flags |= ASYNC_LOW_LATENCY;
+      ioctl(fd, TIOCSSERIAL, &ss);
+    }
+  }
+#endif
+
   usleep(10*1000);		/* Wait for hardware 10ms. */
 
   /* Flush input and output buffers. */
@@ -630,33 +765,13 @@ cleanup(void)
 #endif
 }
 
-void
-sigcleanup(int signo)
-{
-  fprintf(stderr, "signal %d\n", signo);
-  exit(0);			/* exit(0) will call cleanup() */
-}
-
-static int got_sigalarm;
-
-void
-sigalarm(int signo)
-{
-  got_sigalarm = 1;
-  return;
-}
 
-void
-sigalarm_reset()
-{
+/* "?IPA" is sent when nothing was written to serial for this long (us) */
 #ifdef linux
 #define TIMEOUT (997*1000)
 #else
 #define TIMEOUT (2451*1000)
 #endif
-  ualarm(TIMEOUT, TIMEOUT);
-  got_sigalarm = 0;
-}
 
 void
 ifconf(const char *tundev, const char *ipaddr)
@@ -746,10 +861,13 @@ int
 main(int argc, char **argv)
 {
   int c;
-  int tunfd, maxfd;
-  int ret;
-  fd_set rset, wset;
-  FILE *inslip;
+  int tunfd;
+  int signo, seconds;
+  int idle;
+  unsigned char end = SLIP_END;
+  sigset_t sigs;
+  struct itimerval timer;
+  pthread_t thread;
   const char *siodev = NULL;
   const char *host = NULL;
   const char *port = NULL;
@@ -762,7 +880,7 @@ main(int argc, char **argv)
   prog = argv[0];
   setvbuf(stdout, NULL, _IOLBF, 0); /* Line buffered output. */
 
-  while((c = getopt(argc, argv, "B:HILPhXM:s:t:v::d::a:p:T")) != -1) {
+  while((c = getopt(argc, argv, "B:HILPhXM:s:S:t:v::d::a:p:T")) != -1) {
     switch(c) {
     case 'B':
       baudrate = atoi(optarg);
@@ -785,6 +903,7 @@ main(int argc, char **argv)
       if(devmtu < MIN_DEVMTU) {
         devmtu = MIN_DEVMTU;
       }
+      break;
 
     case 'P':
       showprogress=1;
@@ -798,6 +917,10 @@ main(int argc, char **argv)
       }
       break;
 
+    case 'S':
+      stats_interval = atoi(optarg);
+      break;
+
     case 'I':
       ipa_enable = 1;
       fprintf(stderr, "Will inquire about IP address using IPA=\n");
@@ -840,7 +963,8 @@ fprintf(stderr,"usage:  %s [options] ipaddress\n", prog);
 fprintf(stderr,"example: tunslip6 -L -v2 -s ttyUSB1 fd00::1/64\n");
 fprintf(stderr,"Options are:\n");
 #ifndef __APPLE__
-fprintf(stderr," -B baudrate    9600,19200,38400,57600,115200 (default),230400,460800,921600\n");
+fprintf(stderr," -B baudrate    9600,19200,38400,57600,115200 (default),230400,460800,921600,\n");
+fprintf(stderr,"                1000000,1500000,2000000,3000000,4000000\n");
 #else
 fprintf(stderr," -B baudrate    9600,19200,38400,57600,115200 (default),230400\n");
 #endif
@@ -849,6 +973,8 @@ fprintf(stderr," -I             Inquire IP address\n");
 fprintf(stderr," -X             Software XON/XOFF flow control (default disabled)\n");
 fprintf(stderr," -L             Log output format (adds time stamps)\n");
 fprintf(stderr," -s siodev      Serial device (default /dev/ttyUSB0)\n");
+fprintf(stderr," -S seconds     Print throughput, latency and queue statistics periodically\n");
+fprintf(stderr,"                (and on SIGUSR1)\n");
 fprintf(stderr," -M             Interface MTU (default and min: 1280)\n");
 fprintf(stderr," -T             Make tap interface (default is tun interface)\n");
 fprintf(stderr," -t tundev      Name of interface (default tap0 or tun0)\n");
@@ -873,7 +999,7 @@ exit(1);
   argv += (optind - 1);
 
   if(argc != 2 && argc != 3) {
-    err(1, "usage: %s [-B baudrate] [-H] [-L] [-s siodev] [-t tundev] [-T] [-v verbosity] [-d delay] [-a serveraddress] [-p serverport] ipaddress", prog);
+    err(1, "usage: %s [-B baudrate] [-H] [-L] [-s siodev] [-S seconds] [-t tundev] [-T] [-v verbosity] [-d delay] [-a serveraddress] [-p serverport] ipaddress", prog);
   }
   ipaddr = argv[1];
 
@@ -921,8 +1047,6 @@ exit(1);
       err(1, "can't connect to ``%s:%s''", host, port);
     }
 
-    fcntl(slipfd, F_SETFL, O_NONBLOCK);
-
     inet_ntop(p->ai_family, get_in_addr((struct sockaddr *)p->ai_addr),
               s, sizeof(s));
     fprintf(stderr, "slip connected to ``%s:%s''\n", s, port);
@@ -954,11 +1078,11 @@ exit(1);
     }
     if (timestamp) stamptime();
     fprintf(stderr, "********SLIP started on ``/dev/%s''\n", siodev);
+    /* Every thread blocks on its own direction */
+    fcntl(slipfd, F_SETFL, fcntl(slipfd, F_GETFL) & ~O_NONBLOCK);
     stty_telos(slipfd);
   }
-  slip_send(slipfd, SLIP_END);
-  inslip = fdopen(slipfd, "r");
-  if(inslip == NULL) err(1, "main: fdopen");
+  txq_put(&end, 1);
 
   tunfd = tun_alloc(tundev, tap);
   if(tunfd == -1) err(1, "main: open /dev/tun");
@@ -967,79 +1091,58 @@ exit(1);
           tap ? "tap" : "tun", tundev);
 
   atexit(cleanup);
-  signal(SIGHUP, sigcleanup);
-  signal(SIGTERM, sigcleanup);
-  signal(SIGINT, sigcleanup);
-  signal(SIGALRM, sigalarm);
   ifconf(tundev, ipaddr);
 
-  while(1) {
-    maxfd = 0;
-    FD_ZERO(&rset);
-    FD_ZERO(&wset);
-
-    if(got_sigalarm && ipa_enable) {
-      /* Send "?IPA". */
-      slip_send(slipfd, '?');
-      slip_send(slipfd, 'I');
-      slip_send(slipfd, 'P');
-      slip_send(slipfd, 'A');
-      slip_send(slipfd, SLIP_END);
-      got_sigalarm = 0;
-    }
-
-    if(!slip_empty()) {		/* Anything to flush? */
-      FD_SET(slipfd, &wset);
-    }
+  /* Signals are only taken by the sigwait() below */
+  sigemptyset(&sigs);
+  sigaddset(&sigs, SIGHUP);
+  sigaddset(&sigs, SIGTERM);
+  sigaddset(&sigs, SIGINT);
+  sigaddset(&sigs, SIGALRM);
+  sigaddset(&sigs, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+
+  if(pthread_create(&thread, NULL, serial_to_tun, &tunfd) != 0 ||
+     pthread_create(&thread, NULL, serial_writer, NULL) != 0 ||
+     pthread_create(&thread, NULL, tun_to_serial, &tunfd) != 0) {
+    errx(1, "main: cannot start threads");
+  }
 
-    FD_SET(slipfd, &rset);	/* Read from slip ASAP! */
-    if(slipfd > maxfd) maxfd = slipfd;
+  /* Once a second: inquire about the IP address, print statistics */
+  timer.it_interval.tv_sec = 1;
+  timer.it_interval.tv_usec = 0;
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_REAL, &timer, NULL);
+  seconds = 0;
 
-    /* We only have one packet at a time queued for slip output. */
-    if(slip_empty()) {
-      FD_SET(tunfd, &rset);
-      if(tunfd > maxfd) maxfd = tunfd;
+  while(1) {
+    if(sigwait(&sigs, &signo) != 0) {
+      continue;
     }
-
-    ret = select(maxfd + 1, &rset, &wset, NULL, NULL);
-    if(ret == -1 && errno != EINTR) {
-      err(1, "select");
-    } else if(ret > 0) {
-      if(FD_ISSET(slipfd, &rset)) {
-        serial_to_tun(inslip, tunfd);
-      }
-
-      if(FD_ISSET(slipfd, &wset)) {
-	slip_flushbuf(slipfd);
-	if(ipa_enable) sigalarm_reset();
+    if(signo == SIGALRM) {
+      seconds++;
+      if(ipa_enable) {
+        pthread_mutex_lock(&lock);
+        idle = now_usec() - last_tx >= TIMEOUT;
+        pthread_mutex_unlock(&lock);
+        if(idle) {
+          /* Send "?IPA". */
+          slip_send_packet("?IPA", 4);
+        }
       }
-
-      /* Optional delay between outgoing packets */
-      /* Base delay times number of 6lowpan fragments to be sent */
-      if(delaymsec) {
-       struct timeval tv;
-       int dmsec;
-       gettimeofday(&tv, NULL) ;
-       dmsec=(tv.tv_sec-delaystartsec)*1000+tv.tv_usec/1000-delaystartmsec;
-       if(dmsec<0) delaymsec=0;
-       if(dmsec>delaymsec) delaymsec=0;
+      if(stats_interval > 0 && seconds >= stats_interval) {
+        print_stats(seconds);
+        seconds = 0;
       }
-      if(delaymsec==0) {
-        int size;
-        if(slip_empty() && FD_ISSET(tunfd, &rset)) {
-          size=tun_to_serial(tunfd, slipfd);
-          slip_flushbuf(slipfd);
-          if(ipa_enable) sigalarm_reset();
-          if(basedelay) {
-            struct timeval tv;
-            gettimeofday(&tv, NULL) ;
- //         delaymsec=basedelay*(1+(size/120));//multiply by # of 6lowpan packets?
-            delaymsec=basedelay;
-            delaystartsec =tv.tv_sec;
-            delaystartmsec=tv.tv_usec/1000;
-          }
-        }
+    } else if(signo == SIGUSR1) {
+      print_stats(seconds);
+      seconds = 0;
+    } else {
+      fprintf(stderr, "signal %d\n", signo);
+      if(stats_interval > 0) {
+        print_stats(seconds);
       }
+      exit(0);			/* exit(0) will call cleanup() */
     }
   }
 }